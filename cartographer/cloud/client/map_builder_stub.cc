@@ -28,6 +28,7 @@
 #include "cartographer/cloud/internal/mapping/serialization.h"
 #include "cartographer/cloud/internal/sensor/serialization.h"
 #include "cartographer/cloud/proto/map_builder_service.pb.h"
+#include "cartographer/common/port.h"
 #include "cartographer/io/proto_stream_deserializer.h"
 #include "glog/logging.h"
 
@@ -44,11 +45,15 @@ constexpr int kMaxRetries = 5;
 }  // namespace
 
 MapBuilderStub::MapBuilderStub(const std::string& server_address,
-                               const std::string& client_id)
+                               const std::string& client_id,
+                               const bool compress_state_transfers,
+                               const bool use_shared_memory)
     : client_channel_(::grpc::CreateChannel(
           server_address, ::grpc::InsecureChannelCredentials())),
       pose_graph_stub_(make_unique<PoseGraphStub>(client_channel_, client_id)),
-      client_id_(client_id) {
+      client_id_(client_id),
+      compress_state_transfers_(compress_state_transfers),
+      use_shared_memory_(use_shared_memory) {
   LOG(INFO) << "Connecting to SLAM process at " << server_address
             << " with client_id " << client_id;
   std::chrono::system_clock::time_point deadline(
@@ -82,7 +87,7 @@ int MapBuilderStub::AddTrajectoryBuilder(
       std::forward_as_tuple(client.response().trajectory_id()),
       std::forward_as_tuple(make_unique<TrajectoryBuilderStub>(
           client_channel_, client.response().trajectory_id(), client_id_,
-          local_slam_result_callback)));
+          local_slam_result_callback, use_shared_memory_)));
   return client.response().trajectory_id();
 }
 
@@ -102,6 +107,12 @@ mapping::TrajectoryBuilderInterface* MapBuilderStub::GetTrajectoryBuilder(
 }
 
 void MapBuilderStub::FinishTrajectory(int trajectory_id) {
+  // Sensor data passed through shared memory must have reached the server
+  // before the trajectory is finished.
+  auto it = trajectory_builder_stubs_.find(trajectory_id);
+  if (it != trajectory_builder_stubs_.end()) {
+    it->second->Flush();
+  }
   proto::FinishTrajectoryRequest request;
   request.set_client_id(client_id_);
   request.set_trajectory_id(trajectory_id);
@@ -135,7 +146,8 @@ void MapBuilderStub::SerializeState(bool include_unfinished_submaps,
     LOG(WARNING) << "Serializing unfinished submaps is currently unsupported. "
                     "Proceeding to write the state without them.";
   }
-  google::protobuf::Empty request;
+  proto::WriteStateRequest request;
+  request.set_compress_serialized_data(compress_state_transfers_);
   async_grpc::Client<handlers::WriteStateSignature> client(client_channel_);
   CHECK(client.Write(request));
   proto::WriteStateResponse response;
@@ -147,6 +159,15 @@ void MapBuilderStub::SerializeState(bool include_unfinished_submaps,
       case proto::WriteStateResponse::kSerializedData:
         writer->WriteProto(response.serialized_data());
         break;
+      case proto::WriteStateResponse::kCompressedSerializedData: {
+        std::string uncompressed_data;
+        common::FastGunzipString(response.compressed_serialized_data(),
+                                 &uncompressed_data);
+        mapping::proto::SerializedData serialized_data;
+        CHECK(serialized_data.ParseFromString(uncompressed_data));
+        writer->WriteProto(serialized_data);
+        break;
+      }
       default:
         LOG(FATAL) << "Unhandled message type";
     }
@@ -172,6 +193,13 @@ bool MapBuilderStub::SerializeStateToFile(bool include_unfinished_submaps,
   return client.response().success();
 }
 
+bool MapBuilderStub::WriteCheckpoint(bool include_unfinished_submaps,
+                                     const std::string& filename) {
+  LOG(WARNING) << "Incremental checkpoints are currently unsupported. "
+                  "Proceeding to write the complete state.";
+  return SerializeStateToFile(include_unfinished_submaps, filename);
+}
+
 std::map<int, int> MapBuilderStub::LoadState(
     io::ProtoStreamReaderInterface* reader, const bool load_frozen_state) {
   async_grpc::Client<handlers::LoadStateSignature> client(client_channel_);
@@ -206,10 +234,19 @@ std::map<int, int> MapBuilderStub::LoadState(
     request.set_load_frozen_state(load_frozen_state);
     CHECK(client.Write(request));
   }
-  // Multiple requests with SerializedData are sent after.
-  proto::LoadStateRequest request;
-  while (
-      deserializer.ReadNextSerializedData(request.mutable_serialized_data())) {
+  // Multiple requests with SerializedData are sent after. Each is written
+  // before the next one is read, so the state is never held in memory.
+  mapping::proto::SerializedData serialized_data;
+  while (deserializer.ReadNextSerializedData(&serialized_data)) {
+    proto::LoadStateRequest request;
+    if (compress_state_transfers_) {
+      std::string uncompressed_data;
+      serialized_data.SerializeToString(&uncompressed_data);
+      common::FastGzipString(uncompressed_data,
+                             request.mutable_compressed_serialized_data());
+    } else {
+      request.mutable_serialized_data()->Swap(&serialized_data);
+    }
     request.set_load_frozen_state(load_frozen_state);
     CHECK(client.Write(request));
   }
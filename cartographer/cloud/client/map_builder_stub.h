@@ -29,8 +29,16 @@ namespace cloud {
 
 class MapBuilderStub : public mapping::MapBuilderInterface {
  public:
+  // If 'compress_state_transfers' is set, serialized data is gzip compressed
+  // while it is transferred by SerializeState() and LoadState(), trading CPU
+  // time for bandwidth.
+  // If 'use_shared_memory' is set, trajectories pass sensor data and local
+  // SLAM results through shared memory if the server runs on the same host
+  // and allows it, and through gRPC streams otherwise.
   MapBuilderStub(const std::string& server_address,
-                 const std::string& client_id);
+                 const std::string& client_id,
+                 bool compress_state_transfers = false,
+                 bool use_shared_memory = false);
 
   MapBuilderStub(const MapBuilderStub&) = delete;
   MapBuilderStub& operator=(const MapBuilderStub&) = delete;
@@ -52,6 +60,8 @@ class MapBuilderStub : public mapping::MapBuilderInterface {
                       io::ProtoStreamWriterInterface* writer) override;
   bool SerializeStateToFile(bool include_unfinished_submaps,
                             const std::string& filename) override;
+  bool WriteCheckpoint(bool include_unfinished_submaps,
+                       const std::string& filename) override;
   std::map<int, int> LoadState(io::ProtoStreamReaderInterface* reader,
                                bool load_frozen_state) override;
   std::map<int, int> LoadStateFromFile(const std::string& filename,
@@ -67,6 +77,8 @@ class MapBuilderStub : public mapping::MapBuilderInterface {
   std::map<int, std::unique_ptr<mapping::TrajectoryBuilderInterface>>
       trajectory_builder_stubs_;
   const std::string client_id_;
+  const bool compress_state_transfers_;
+  const bool use_shared_memory_;
 };
 
 }  // namespace cloud
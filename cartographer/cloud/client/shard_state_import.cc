@@ -0,0 +1,60 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/cloud/client/shard_state_import.h"
+
+#include <memory>
+#include <queue>
+
+#include "cartographer/cloud/client/map_builder_stub.h"
+#include "cartographer/io/internal/in_memory_proto_stream.h"
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace cloud {
+
+std::map<int, int> CopyStateAsFrozen(mapping::MapBuilderInterface* source,
+                                     mapping::MapBuilderInterface* target) {
+  std::queue<std::unique_ptr<google::protobuf::Message>> state_chunks;
+  io::ForwardingProtoStreamWriter writer(
+      [&state_chunks](const google::protobuf::Message* proto) {
+        if (proto != nullptr) {
+          std::unique_ptr<google::protobuf::Message> chunk(proto->New());
+          chunk->CopyFrom(*proto);
+          state_chunks.push(std::move(chunk));
+        }
+        return true;
+      });
+  source->SerializeState(/*include_unfinished_submaps=*/false, &writer);
+  CHECK(writer.Close());
+  io::InMemoryProtoStreamReader reader(std::move(state_chunks));
+  return target->LoadState(&reader, /*load_frozen_state=*/true);
+}
+
+std::map<int, int> ImportFrozenStateFromShard(
+    const std::string& shard_server_address, const std::string& client_id,
+    mapping::MapBuilderInterface* map_builder) {
+  LOG(INFO) << "Importing frozen state from shard " << shard_server_address;
+  MapBuilderStub shard(shard_server_address, client_id);
+  const std::map<int, int> trajectory_remapping =
+      CopyStateAsFrozen(&shard, map_builder);
+  LOG(INFO) << "Imported " << trajectory_remapping.size()
+            << " trajectories from shard " << shard_server_address;
+  return trajectory_remapping;
+}
+
+}  // namespace cloud
+}  // namespace cartographer
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_CLOUD_CLIENT_SHARD_STATE_IMPORT_H_
+#define CARTOGRAPHER_CLOUD_CLIENT_SHARD_STATE_IMPORT_H_
+
+#include <map>
+#include <string>
+
+#include "cartographer/mapping/map_builder_interface.h"
+
+namespace cartographer {
+namespace cloud {
+
+// Loads the state of 'source' into 'target' as frozen trajectories, without
+// going through a file. Returns the mapping from trajectory ids in 'source' to
+// trajectory ids in 'target'.
+std::map<int, int> CopyStateAsFrozen(mapping::MapBuilderInterface* source,
+                                     mapping::MapBuilderInterface* target);
+
+// Imports the finished submaps and trajectories of the map builder shard
+// served at 'shard_server_address' into 'map_builder' as frozen trajectories.
+// This lets independent shards close loops against each other's submaps.
+std::map<int, int> ImportFrozenStateFromShard(
+    const std::string& shard_server_address, const std::string& client_id,
+    mapping::MapBuilderInterface* map_builder);
+
+}  // namespace cloud
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_CLOUD_CLIENT_SHARD_STATE_IMPORT_H_
@@ -35,6 +35,11 @@
 
 namespace cartographer {
 namespace cloud {
+namespace {
+
+constexpr int kMaxNumConstraintsPerRequest = 10000;
+
+}  // namespace
 
 PoseGraphStub::PoseGraphStub(std::shared_ptr<::grpc::Channel> client_channel,
                              const std::string& client_id)
@@ -47,6 +52,11 @@ void PoseGraphStub::RunFinalOptimization() {
   CHECK(client.Write(request));
 }
 
+void PoseGraphStub::RunFinalOptimizationAsync(
+    FinalOptimizationCallback callback) {
+  LOG(FATAL) << "Not implemented";
+}
+
 mapping::MapById<mapping::SubmapId, mapping::PoseGraphInterface::SubmapData>
 PoseGraphStub::GetAllSubmapData() const {
   LOG(FATAL) << "Not implemented";
@@ -201,12 +211,44 @@ PoseGraphStub::GetTrajectoryData() const {
 
 std::vector<mapping::PoseGraphInterface::Constraint>
 PoseGraphStub::constraints() const {
-  google::protobuf::Empty request;
-  async_grpc::Client<handlers::GetConstraintsSignature> client(client_channel_);
-  ::grpc::Status status;
-  CHECK(client.Write(request, &status))
-      << "Failed to get constraints: " << status.error_message();
-  return mapping::FromProto(client.response().constraints());
+  return *GetConstraintsSnapshot().constraints;
+}
+
+mapping::PoseGraphInterface::ConstraintsSnapshot
+PoseGraphStub::GetConstraintsSnapshot() const {
+  // Fetches the constraints in pages, starting over if the server publishes a
+  // new snapshot in between.
+  ::google::protobuf::RepeatedPtrField<mapping::proto::PoseGraph::Constraint>
+      constraints;
+  int64 snapshot_version = -1;
+  for (;;) {
+    proto::GetConstraintsRequest request;
+    request.set_start_index(constraints.size());
+    request.set_max_num_constraints(kMaxNumConstraintsPerRequest);
+    async_grpc::Client<handlers::GetConstraintsSignature> client(
+        client_channel_);
+    ::grpc::Status status;
+    CHECK(client.Write(request, &status))
+        << "Failed to get constraints: " << status.error_message();
+    const proto::GetConstraintsResponse& response = client.response();
+    if (response.snapshot_version() != snapshot_version) {
+      if (!constraints.empty()) {
+        constraints.Clear();
+        snapshot_version = -1;
+        continue;
+      }
+      snapshot_version = response.snapshot_version();
+    }
+    constraints.MergeFrom(response.constraints());
+    if (response.constraints_size() == 0 ||
+        constraints.size() >= response.num_constraints()) {
+      break;
+    }
+  }
+  return ConstraintsSnapshot{
+      snapshot_version,
+      std::make_shared<const std::vector<Constraint>>(
+          mapping::FromProto(constraints))};
 }
 
 mapping::proto::PoseGraph PoseGraphStub::ToProto(
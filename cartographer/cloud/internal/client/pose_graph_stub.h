@@ -32,6 +32,7 @@ class PoseGraphStub : public ::cartographer::mapping::PoseGraphInterface {
   PoseGraphStub& operator=(const PoseGraphStub&) = delete;
 
   void RunFinalOptimization() override;
+  void RunFinalOptimizationAsync(FinalOptimizationCallback callback) override;
   mapping::MapById<mapping::SubmapId, SubmapData> GetAllSubmapData()
       const override;
   SubmapData GetSubmapData(const mapping::SubmapId& submap_id) const override;
@@ -54,6 +55,7 @@ class PoseGraphStub : public ::cartographer::mapping::PoseGraphInterface {
   std::map<int, mapping::PoseGraphInterface::TrajectoryData> GetTrajectoryData()
       const override;
   std::vector<Constraint> constraints() const override;
+  ConstraintsSnapshot GetConstraintsSnapshot() const override;
   mapping::proto::PoseGraph ToProto(
       bool include_unfinished_submaps) const override;
   void SetGlobalSlamOptimizationCallback(
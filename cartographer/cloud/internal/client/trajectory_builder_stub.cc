@@ -16,6 +16,10 @@
 
 #include "cartographer/cloud/internal/client/trajectory_builder_stub.h"
 
+#include <unistd.h>
+
+#include "absl/strings/str_cat.h"
+#include "cartographer/cloud/internal/handlers/attach_shared_memory_handler.h"
 #include "cartographer/cloud/internal/sensor/serialization.h"
 #include "cartographer/cloud/proto/map_builder_service.pb.h"
 #include "cartographer/mapping/local_slam_result_data.h"
@@ -24,16 +28,62 @@
 
 namespace cartographer {
 namespace cloud {
+namespace {
+
+// Every record must fit into half of its ring, so these also bound the size
+// of a single point cloud or local SLAM result. The memory is only committed
+// as it is touched.
+constexpr size_t kSensorDataRingCapacity = 64 << 20;
+constexpr size_t kLocalSlamResultsRingCapacity = 32 << 20;
+const common::Duration kSensorDataWriteTimeout = common::FromSeconds(10.);
+const common::Duration kFlushTimeout = common::FromSeconds(10.);
+const common::Duration kLocalSlamResultsReadTimeout =
+    common::FromMilliseconds(100);
+
+void HandleLocalSlamResult(
+    const proto::ReceiveLocalSlamResultsResponse& response,
+    const mapping::TrajectoryBuilderInterface::LocalSlamResultCallback&
+        local_slam_result_callback) {
+  int trajectory_id = response.trajectory_id();
+  common::Time time = common::FromUniversal(response.timestamp());
+  transform::Rigid3d local_pose = transform::ToRigid3(response.local_pose());
+  sensor::RangeData range_data = sensor::FromProto(response.range_data());
+  auto insertion_result =
+      response.has_insertion_result()
+          ? absl::make_unique<
+                mapping::TrajectoryBuilderInterface::InsertionResult>(
+                mapping::TrajectoryBuilderInterface::InsertionResult{
+                    mapping::NodeId{
+                        response.insertion_result().node_id().trajectory_id(),
+                        response.insertion_result().node_id().node_index()}})
+          : nullptr;
+  local_slam_result_callback(trajectory_id, time, local_pose, range_data,
+                             std::move(insertion_result));
+}
+
+}  // namespace
 
 TrajectoryBuilderStub::TrajectoryBuilderStub(
     std::shared_ptr<::grpc::Channel> client_channel, const int trajectory_id,
     const std::string& client_id,
-    LocalSlamResultCallback local_slam_result_callback)
+    LocalSlamResultCallback local_slam_result_callback,
+    const bool use_shared_memory)
     : client_channel_(client_channel),
       trajectory_id_(trajectory_id),
       client_id_(client_id),
       receive_local_slam_results_client_(client_channel_) {
-  if (local_slam_result_callback) {
+  if (use_shared_memory &&
+      AttachSharedMemory(local_slam_result_callback != nullptr)) {
+    if (local_slam_results_ring_) {
+      SharedMemoryRing* const ring = local_slam_results_ring_.get();
+      const std::atomic<bool>* const stopping = &stopping_;
+      receive_local_slam_results_thread_ = absl::make_unique<std::thread>(
+          [ring, stopping, local_slam_result_callback]() {
+            RunSharedMemoryLocalSlamResultsReader(ring, stopping,
+                                                  local_slam_result_callback);
+          });
+    }
+  } else if (local_slam_result_callback) {
     proto::ReceiveLocalSlamResultsRequest request;
     request.set_trajectory_id(trajectory_id);
     receive_local_slam_results_client_.Write(request);
@@ -48,9 +98,18 @@ TrajectoryBuilderStub::TrajectoryBuilderStub(
 }
 
 TrajectoryBuilderStub::~TrajectoryBuilderStub() {
+  if (sensor_data_ring_) {
+    sensor_data_ring_->CloseForWriting();
+  }
+  // The shared memory reader still takes the results which are already
+  // there, the gRPC stream ends when the server finishes the trajectory.
+  stopping_ = true;
   if (receive_local_slam_results_thread_) {
     receive_local_slam_results_thread_->join();
   }
+  if (local_slam_results_ring_) {
+    local_slam_results_ring_->CloseForReading();
+  }
   if (add_rangefinder_client_) {
     CHECK(add_rangefinder_client_->StreamWritesDone());
     CHECK(add_rangefinder_client_->StreamFinish().ok());
@@ -76,6 +135,15 @@ TrajectoryBuilderStub::~TrajectoryBuilderStub() {
 void TrajectoryBuilderStub::AddSensorData(
     const std::string& sensor_id,
     const sensor::TimedPointCloudData& timed_point_cloud_data) {
+  if (sensor_data_ring_) {
+    proto::SensorData sensor_data;
+    CreateSensorMetadata(sensor_id, trajectory_id_, client_id_,
+                         sensor_data.mutable_sensor_metadata());
+    *sensor_data.mutable_timed_point_cloud_data() =
+        sensor::ToPackedProto(timed_point_cloud_data);
+    WriteSensorData(sensor_data);
+    return;
+  }
   if (!add_rangefinder_client_) {
     add_rangefinder_client_ = absl::make_unique<
         async_grpc::Client<handlers::AddRangefinderDataSignature>>(
@@ -83,13 +151,21 @@ void TrajectoryBuilderStub::AddSensorData(
   }
   proto::AddRangefinderDataRequest request;
   CreateAddRangeFinderDataRequest(sensor_id, trajectory_id_, client_id_,
-                                  sensor::ToProto(timed_point_cloud_data),
+                                  sensor::ToPackedProto(timed_point_cloud_data),
                                   &request);
   add_rangefinder_client_->Write(request);
 }
 
 void TrajectoryBuilderStub::AddSensorData(const std::string& sensor_id,
                                           const sensor::ImuData& imu_data) {
+  if (sensor_data_ring_) {
+    proto::SensorData sensor_data;
+    CreateSensorMetadata(sensor_id, trajectory_id_, client_id_,
+                         sensor_data.mutable_sensor_metadata());
+    *sensor_data.mutable_imu_data() = sensor::ToProto(imu_data);
+    WriteSensorData(sensor_data);
+    return;
+  }
   if (!add_imu_client_) {
     add_imu_client_ =
         absl::make_unique<async_grpc::Client<handlers::AddImuDataSignature>>(
@@ -103,6 +179,14 @@ void TrajectoryBuilderStub::AddSensorData(const std::string& sensor_id,
 
 void TrajectoryBuilderStub::AddSensorData(
     const std::string& sensor_id, const sensor::OdometryData& odometry_data) {
+  if (sensor_data_ring_) {
+    proto::SensorData sensor_data;
+    CreateSensorMetadata(sensor_id, trajectory_id_, client_id_,
+                         sensor_data.mutable_sensor_metadata());
+    *sensor_data.mutable_odometry_data() = sensor::ToProto(odometry_data);
+    WriteSensorData(sensor_data);
+    return;
+  }
   if (!add_odometry_client_) {
     add_odometry_client_ = absl::make_unique<
         async_grpc::Client<handlers::AddOdometryDataSignature>>(
@@ -117,6 +201,15 @@ void TrajectoryBuilderStub::AddSensorData(
 void TrajectoryBuilderStub::AddSensorData(
     const std::string& sensor_id,
     const sensor::FixedFramePoseData& fixed_frame_pose) {
+  if (sensor_data_ring_) {
+    proto::SensorData sensor_data;
+    CreateSensorMetadata(sensor_id, trajectory_id_, client_id_,
+                         sensor_data.mutable_sensor_metadata());
+    *sensor_data.mutable_fixed_frame_pose_data() =
+        sensor::ToProto(fixed_frame_pose);
+    WriteSensorData(sensor_data);
+    return;
+  }
   if (!add_fixed_frame_pose_client_) {
     add_fixed_frame_pose_client_ = absl::make_unique<
         async_grpc::Client<handlers::AddFixedFramePoseDataSignature>>(
@@ -131,6 +224,14 @@ void TrajectoryBuilderStub::AddSensorData(
 
 void TrajectoryBuilderStub::AddSensorData(
     const std::string& sensor_id, const sensor::LandmarkData& landmark_data) {
+  if (sensor_data_ring_) {
+    proto::SensorData sensor_data;
+    CreateSensorMetadata(sensor_id, trajectory_id_, client_id_,
+                         sensor_data.mutable_sensor_metadata());
+    *sensor_data.mutable_landmark_data() = sensor::ToProto(landmark_data);
+    WriteSensorData(sensor_data);
+    return;
+  }
   if (!add_landmark_client_) {
     add_landmark_client_ = absl::make_unique<
         async_grpc::Client<handlers::AddLandmarkDataSignature>>(
@@ -147,27 +248,91 @@ void TrajectoryBuilderStub::AddLocalSlamResultData(
   LOG(FATAL) << "Not implemented";
 }
 
+void TrajectoryBuilderStub::Flush() {
+  // The server flushes its own trajectory builder when it finishes the
+  // trajectory.
+  if (sensor_data_ring_ &&
+      !sensor_data_ring_->WaitUntilDrained(kFlushTimeout)) {
+    LOG(ERROR) << "Server did not take all sensor data of trajectory "
+               << trajectory_id_ << " from shared memory.";
+  }
+}
+
+bool TrajectoryBuilderStub::AttachSharedMemory(
+    const bool receive_local_slam_results) {
+  // Trajectory IDs are only unique per server, so the names also count the
+  // stubs of this process.
+  static std::atomic<int> num_attached_stubs{0};
+  const std::string name_prefix =
+      absl::StrCat("/cartographer_", getpid(), "_", num_attached_stubs++);
+  proto::AttachSharedMemoryRequest request;
+  request.set_trajectory_id(trajectory_id_);
+  request.set_client_id(client_id_);
+  auto sensor_data_ring = SharedMemoryRing::Create(
+      name_prefix + "_sensor_data", kSensorDataRingCapacity);
+  if (sensor_data_ring == nullptr) {
+    return false;
+  }
+  request.set_sensor_data_ring_name(sensor_data_ring->name());
+  std::unique_ptr<SharedMemoryRing> local_slam_results_ring;
+  if (receive_local_slam_results) {
+    local_slam_results_ring = SharedMemoryRing::Create(
+        name_prefix + "_local_slam_results", kLocalSlamResultsRingCapacity);
+    if (local_slam_results_ring == nullptr) {
+      return false;
+    }
+    request.set_local_slam_results_ring_name(local_slam_results_ring->name());
+  }
+  async_grpc::Client<handlers::AttachSharedMemorySignature> client(
+      client_channel_);
+  ::grpc::Status status;
+  client.Write(request, &status);
+  if (!status.ok()) {
+    LOG(WARNING) << "Using gRPC streams for trajectory " << trajectory_id_
+                 << ": " << status.error_message();
+    return false;
+  }
+  LOG(INFO) << "Using shared memory for trajectory " << trajectory_id_ << ".";
+  sensor_data_ring_ = std::move(sensor_data_ring);
+  local_slam_results_ring_ = std::move(local_slam_results_ring);
+  return true;
+}
+
+void TrajectoryBuilderStub::WriteSensorData(
+    const proto::SensorData& sensor_data) {
+  if (!sensor_data_ring_->WriteMessage(kSensorDataWriteTimeout, sensor_data)) {
+    LOG(ERROR) << "Server does not take sensor data from '"
+               << sensor_data_ring_->name() << "', dropping it.";
+  }
+}
+
 void TrajectoryBuilderStub::RunLocalSlamResultsReader(
     async_grpc::Client<handlers::ReceiveLocalSlamResultsSignature>* client,
     LocalSlamResultCallback local_slam_result_callback) {
   proto::ReceiveLocalSlamResultsResponse response;
   while (client->StreamRead(&response)) {
-    int trajectory_id = response.trajectory_id();
-    common::Time time = common::FromUniversal(response.timestamp());
-    transform::Rigid3d local_pose = transform::ToRigid3(response.local_pose());
-    sensor::RangeData range_data = sensor::FromProto(response.range_data());
-    auto insertion_result =
-        response.has_insertion_result()
-            ? absl::make_unique<InsertionResult>(
-                  InsertionResult{mapping::NodeId{
-                      response.insertion_result().node_id().trajectory_id(),
-                      response.insertion_result().node_id().node_index()}})
-            : nullptr;
-    local_slam_result_callback(trajectory_id, time, local_pose, range_data,
-                               std::move(insertion_result));
+    HandleLocalSlamResult(response, local_slam_result_callback);
   }
   client->StreamFinish();
 }
 
+void TrajectoryBuilderStub::RunSharedMemoryLocalSlamResultsReader(
+    SharedMemoryRing* const ring, const std::atomic<bool>* const stopping,
+    LocalSlamResultCallback local_slam_result_callback) {
+  proto::ReceiveLocalSlamResultsResponse response;
+  while (true) {
+    switch (ring->ReadMessage(kLocalSlamResultsReadTimeout, &response)) {
+      case SharedMemoryRing::ReadStatus::kRead:
+        HandleLocalSlamResult(response, local_slam_result_callback);
+        break;
+      case SharedMemoryRing::ReadStatus::kTimeout:
+        if (*stopping) return;
+        break;
+      case SharedMemoryRing::ReadStatus::kClosed:
+        return;
+    }
+  }
+}
+
 }  // namespace cloud
 }  // namespace cartographer
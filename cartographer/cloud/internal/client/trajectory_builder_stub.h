@@ -17,6 +17,7 @@
 #ifndef CARTOGRAPHER_CLOUD_INTERNAL_CLIENT_TRAJECTORY_BUILDER_STUB_H_
 #define CARTOGRAPHER_CLOUD_INTERNAL_CLIENT_TRAJECTORY_BUILDER_STUB_H_
 
+#include <atomic>
 #include <thread>
 
 #include "async_grpc/client.h"
@@ -26,6 +27,8 @@
 #include "cartographer/cloud/internal/handlers/add_odometry_data_handler.h"
 #include "cartographer/cloud/internal/handlers/add_rangefinder_data_handler.h"
 #include "cartographer/cloud/internal/handlers/receive_local_slam_results_handler.h"
+#include "cartographer/cloud/internal/shared_memory_ring.h"
+#include "cartographer/cloud/proto/map_builder_service.pb.h"
 #include "cartographer/mapping/local_slam_result_data.h"
 #include "cartographer/mapping/trajectory_builder_interface.h"
 #include "grpc++/grpc++.h"
@@ -37,9 +40,13 @@ namespace cloud {
 
 class TrajectoryBuilderStub : public mapping::TrajectoryBuilderInterface {
  public:
+  // If 'use_shared_memory' is set and the server, which must run on the same
+  // host, allows it, sensor data and local SLAM results are passed through
+  // shared memory instead of gRPC streams.
   TrajectoryBuilderStub(std::shared_ptr<::grpc::Channel> client_channel,
                         const int trajectory_id, const std::string& client_id,
-                        LocalSlamResultCallback local_slam_result_callback);
+                        LocalSlamResultCallback local_slam_result_callback,
+                        bool use_shared_memory = false);
   ~TrajectoryBuilderStub() override;
   TrajectoryBuilderStub(const TrajectoryBuilderStub&) = delete;
   TrajectoryBuilderStub& operator=(const TrajectoryBuilderStub&) = delete;
@@ -58,12 +65,23 @@ class TrajectoryBuilderStub : public mapping::TrajectoryBuilderInterface {
                      const sensor::LandmarkData& landmark_data) override;
   void AddLocalSlamResultData(std::unique_ptr<mapping::LocalSlamResultData>
                                   local_slam_result_data) override;
+  // Waits until the server has taken all sensor data sent through shared
+  // memory.
+  void Flush() override;
 
  private:
   static void RunLocalSlamResultsReader(
       async_grpc::Client<handlers::ReceiveLocalSlamResultsSignature>*
           client_reader,
       LocalSlamResultCallback local_slam_result_callback);
+  static void RunSharedMemoryLocalSlamResultsReader(
+      SharedMemoryRing* ring, const std::atomic<bool>* stopping,
+      LocalSlamResultCallback local_slam_result_callback);
+
+  // Creates the shared memory rings and asks the server to use them. Returns
+  // false if the server did not agree.
+  bool AttachSharedMemory(bool receive_local_slam_results);
+  void WriteSensorData(const proto::SensorData& sensor_data);
 
   std::shared_ptr<::grpc::Channel> client_channel_;
   const int trajectory_id_;
@@ -81,6 +99,10 @@ class TrajectoryBuilderStub : public mapping::TrajectoryBuilderInterface {
   async_grpc::Client<handlers::ReceiveLocalSlamResultsSignature>
       receive_local_slam_results_client_;
   std::unique_ptr<std::thread> receive_local_slam_results_thread_;
+  // Both nullptr unless shared memory is used.
+  std::unique_ptr<SharedMemoryRing> sensor_data_ring_;
+  std::unique_ptr<SharedMemoryRing> local_slam_results_ring_;
+  std::atomic<bool> stopping_{false};
 };
 
 }  // namespace cloud
@@ -380,6 +380,40 @@ TEST_P(ClientServerTestByGridType, LocalSlam2D) {
   server_->Shutdown();
 }
 
+TEST_P(ClientServerTestByGridType, LocalSlam2DThroughSharedMemory) {
+  if (GetParam() == ::cartographer::mapping::GridType::TSDF) {
+    SetOptionsToTSDF2D();
+  }
+  map_builder_server_options_.set_enable_shared_memory_transport(true);
+  InitializeRealServer();
+  server_->Start();
+  auto stub = absl::make_unique<MapBuilderStub>(
+      map_builder_server_options_.server_address(), kClientId,
+      false /* compress_state_transfers */, true /* use_shared_memory */);
+  int trajectory_id =
+      stub->AddTrajectoryBuilder({kRangeSensorId}, trajectory_builder_options_,
+                                 local_slam_result_callback_);
+  TrajectoryBuilderInterface* trajectory_stub =
+      stub->GetTrajectoryBuilder(trajectory_id);
+  const auto measurements = mapping::testing::GenerateFakeRangeMeasurements(
+      kTravelDistance, kDuration, kTimeStep);
+  for (const auto& measurement : measurements) {
+    trajectory_stub->AddSensorData(kRangeSensorId.id, measurement);
+  }
+  WaitForLocalSlamResults(measurements.size());
+  stub->FinishTrajectory(trajectory_id);
+  stub->pose_graph()->RunFinalOptimization();
+  EXPECT_EQ(stub->pose_graph()->GetTrajectoryStates().at(trajectory_id),
+            PoseGraphInterface::TrajectoryState::FINISHED);
+  EXPECT_EQ(local_slam_result_poses_.size(), measurements.size());
+  EXPECT_NEAR(kTravelDistance,
+              (local_slam_result_poses_.back().translation() -
+               local_slam_result_poses_.front().translation())
+                  .norm(),
+              0.1 * kTravelDistance);
+  server_->Shutdown();
+}
+
 TEST_P(ClientServerTestByGridType, LocalSlamAndDelete2D) {
   if (GetParam() == ::cartographer::mapping::GridType::TSDF) {
     SetOptionsToTSDF2D();
@@ -715,6 +749,52 @@ TEST_P(ClientServerTestByGridType, LoadUnfrozenStateAndDelete) {
   server_->Shutdown();
 }
 
+TEST_P(ClientServerTestByGridType, LoadAndSerializeCompressedState) {
+  if (GetParam() == ::cartographer::mapping::GridType::TSDF) {
+    SetOptionsToTSDF2D();
+  }
+  InitializeRealServer();
+  server_->Start();
+  auto stub = absl::make_unique<MapBuilderStub>(
+      map_builder_server_options_.server_address(), kClientId,
+      true /* compress_state_transfers */);
+
+  auto reader =
+      ProtoReaderFromStrings(kSerializationHeaderProtoString,
+                             {
+                                 kPoseGraphProtoString,
+                                 kAllTrajectoryBuilderOptionsProtoString,
+                                 kSubmapProtoString,
+                                 kNodeProtoString,
+                                 kImuDataProtoString,
+                                 kOdometryDataProtoString,
+                                 kLandmarkDataProtoString,
+                             });
+  const auto trajectory_remapping = stub->LoadState(reader.get(), true);
+  EXPECT_EQ(trajectory_remapping.size(), 1);
+  EXPECT_EQ(trajectory_remapping.at(0), 0);
+  stub->pose_graph()->RunFinalOptimization();
+  EXPECT_TRUE(stub->pose_graph()->IsTrajectoryFrozen(0));
+
+  std::queue<std::unique_ptr<google::protobuf::Message>> chunks;
+  io::ForwardingProtoStreamWriter writer(
+      [&chunks](const google::protobuf::Message* proto) -> bool {
+        if (!proto) {
+          return true;
+        }
+        std::unique_ptr<google::protobuf::Message> p(proto->New());
+        p->CopyFrom(*proto);
+        chunks.push(std::move(p));
+        return true;
+      });
+  stub->SerializeState(false, &writer);
+  CHECK(writer.Close());
+  io::InMemoryProtoStreamReader serialized_reader(std::move(chunks));
+  io::ProtoStreamDeserializer deserializer(&serialized_reader);
+  EXPECT_EQ(deserializer.pose_graph().trajectory_size(), 1);
+  server_->Shutdown();
+}
+
 // TODO(gaschler): Test-cover LoadStateFromFile.
 
 TEST_P(ClientServerTestByGridType, LocalSlam2DHandlesInvalidRequests) {
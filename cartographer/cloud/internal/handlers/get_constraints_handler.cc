@@ -16,6 +16,8 @@
 
 #include "cartographer/cloud/internal/handlers/get_constraints_handler.h"
 
+#include <algorithm>
+
 #include "absl/memory/memory.h"
 #include "async_grpc/rpc_handler.h"
 #include "cartographer/cloud/internal/map_builder_context_interface.h"
@@ -27,15 +29,31 @@ namespace cartographer {
 namespace cloud {
 namespace handlers {
 
-void GetConstraintsHandler::OnRequest(const google::protobuf::Empty& request) {
-  auto constraints = GetContext<MapBuilderContextInterface>()
-                         ->map_builder()
-                         .pose_graph()
-                         ->constraints();
+void GetConstraintsHandler::OnRequest(
+    const proto::GetConstraintsRequest& request) {
+  // The snapshot is read without waiting for the pose graph and shared with
+  // other requests instead of being copied.
+  const mapping::PoseGraphInterface::ConstraintsSnapshot snapshot =
+      GetUnsynchronizedContext<MapBuilderContextInterface>()
+          ->map_builder()
+          .pose_graph()
+          ->GetConstraintsSnapshot();
+  const std::vector<mapping::PoseGraphInterface::Constraint>& constraints =
+      *snapshot.constraints;
+  const int num_constraints = constraints.size();
+  const int start_index =
+      std::min(std::max(request.start_index(), 0), num_constraints);
+  const int end_index =
+      request.max_num_constraints() > 0
+          ? std::min(num_constraints,
+                     start_index + request.max_num_constraints())
+          : num_constraints;
   auto response = absl::make_unique<proto::GetConstraintsResponse>();
-  response->mutable_constraints()->Reserve(constraints.size());
-  for (const auto& constraint : constraints) {
-    *response->add_constraints() = mapping::ToProto(constraint);
+  response->set_snapshot_version(snapshot.version);
+  response->set_num_constraints(num_constraints);
+  response->mutable_constraints()->Reserve(end_index - start_index);
+  for (int i = start_index; i < end_index; ++i) {
+    *response->add_constraints() = mapping::ToProto(constraints[i]);
   }
   Send(std::move(response));
 }
@@ -26,14 +26,14 @@ namespace cloud {
 namespace handlers {
 
 DEFINE_HANDLER_SIGNATURE(
-    GetConstraintsSignature, google::protobuf::Empty,
+    GetConstraintsSignature, proto::GetConstraintsRequest,
     proto::GetConstraintsResponse,
     "/cartographer.cloud.proto.MapBuilderService/GetConstraints")
 
 class GetConstraintsHandler
     : public async_grpc::RpcHandler<GetConstraintsSignature> {
  public:
-  void OnRequest(const google::protobuf::Empty& request) override;
+  void OnRequest(const proto::GetConstraintsRequest& request) override;
 };
 
 }  // namespace handlers
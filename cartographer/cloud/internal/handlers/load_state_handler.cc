@@ -16,23 +16,66 @@
 
 #include "cartographer/cloud/internal/handlers/load_state_handler.h"
 
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
 #include "absl/memory/memory.h"
 #include "async_grpc/rpc_handler.h"
 #include "cartographer/cloud/internal/map_builder_context_interface.h"
 #include "cartographer/cloud/internal/mapping/serialization.h"
 #include "cartographer/cloud/proto/map_builder_service.pb.h"
+#include "glog/logging.h"
 
 namespace cartographer {
 namespace cloud {
 namespace handlers {
+namespace {
+
+// Creates an empty file in $TMPDIR, or /tmp if unset, and returns its name.
+std::string CreateSpoolFile() {
+  const char* const tmpdir = std::getenv("TMPDIR");
+  std::string pattern = std::string(tmpdir != nullptr ? tmpdir : "/tmp") +
+                        "/cartographer_load_state_XXXXXX";
+  std::vector<char> filename(pattern.begin(), pattern.end());
+  filename.push_back('\0');
+  const int fd = mkstemp(filename.data());
+  PCHECK(fd != -1) << "Failed to create '" << pattern << "'.";
+  close(fd);
+  return filename.data();
+}
+
+}  // namespace
+
+LoadStateHandler::~LoadStateHandler() {
+  if (!spool_filename_.empty()) {
+    spool_writer_.reset();
+    std::remove(spool_filename_.c_str());
+  }
+}
+
+io::ProtoStreamWriter* LoadStateHandler::GetSpoolWriter() {
+  if (spool_writer_ == nullptr) {
+    spool_filename_ = CreateSpoolFile();
+    spool_writer_ = absl::make_unique<io::ProtoStreamWriter>(spool_filename_);
+  }
+  return spool_writer_.get();
+}
 
 void LoadStateHandler::OnRequest(const proto::LoadStateRequest& request) {
   switch (request.state_chunk_case()) {
     case proto::LoadStateRequest::kSerializedData:
-      reader_.AddProto(request.serialized_data());
+      GetSpoolWriter()->WriteProto(request.serialized_data());
+      break;
+    case proto::LoadStateRequest::kCompressedSerializedData:
+      // The client compressed the chunk like ProtoStreamWriter does.
+      GetSpoolWriter()->WriteCompressedProto(
+          request.compressed_serialized_data());
       break;
     case proto::LoadStateRequest::kSerializationHeader:
-      reader_.AddProto(request.serialization_header());
+      GetSpoolWriter()->WriteProto(request.serialization_header());
       break;
     case proto::LoadStateRequest::kClientId:
       client_id_ = request.client_id();
@@ -44,9 +87,19 @@ void LoadStateHandler::OnRequest(const proto::LoadStateRequest& request) {
 }
 
 void LoadStateHandler::OnReadsDone() {
+  if (spool_writer_ == nullptr) {
+    Finish(::grpc::Status(::grpc::INVALID_ARGUMENT, "No state received"));
+    return;
+  }
+  if (!spool_writer_->Close()) {
+    LOG(ERROR) << "Failed to spool state to '" << spool_filename_ << "'.";
+    Finish(::grpc::Status(::grpc::INTERNAL, "Failed to spool state"));
+    return;
+  }
+  io::ProtoStreamReader reader(spool_filename_);
   auto trajectory_remapping =
       GetContext<MapBuilderContextInterface>()->map_builder().LoadState(
-          &reader_, load_frozen_state_);
+          &reader, load_frozen_state_);
   for (const auto& entry : trajectory_remapping) {
     GetContext<MapBuilderContextInterface>()->RegisterClientIdForTrajectory(
         client_id_, entry.second);
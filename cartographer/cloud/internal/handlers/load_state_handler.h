@@ -17,9 +17,12 @@
 #ifndef CARTOGRAPHER_CLOUD_INTERNAL_HANDLERS_LOAD_STATE_HANDLER_H
 #define CARTOGRAPHER_CLOUD_INTERNAL_HANDLERS_LOAD_STATE_HANDLER_H
 
+#include <memory>
+#include <string>
+
 #include "async_grpc/rpc_handler.h"
 #include "cartographer/cloud/proto/map_builder_service.pb.h"
-#include "cartographer/io/internal/in_memory_proto_stream.h"
+#include "cartographer/io/proto_stream.h"
 
 namespace cartographer {
 namespace cloud {
@@ -30,13 +33,21 @@ DEFINE_HANDLER_SIGNATURE(
     proto::LoadStateResponse,
     "/cartographer.cloud.proto.MapBuilderService/LoadState")
 
+// Spools the received state to a temporary pbstream file and loads it once
+// the client is done writing. Memory use does not grow with the size of the
+// state, and a slow disk throttles the client through gRPC flow control.
 class LoadStateHandler : public async_grpc::RpcHandler<LoadStateSignature> {
  public:
+  ~LoadStateHandler();
+
   void OnRequest(const proto::LoadStateRequest& request) override;
   void OnReadsDone() override;
 
  private:
-  io::InMemoryProtoStreamReader reader_;
+  io::ProtoStreamWriter* GetSpoolWriter();
+
+  std::string spool_filename_;
+  std::unique_ptr<io::ProtoStreamWriter> spool_writer_;
   std::string client_id_;
   bool load_frozen_state_;
 };
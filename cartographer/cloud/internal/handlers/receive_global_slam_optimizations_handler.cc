@@ -16,6 +16,9 @@
 
 #include "cartographer/cloud/internal/handlers/receive_global_slam_optimizations_handler.h"
 
+#include <map>
+#include <memory>
+
 #include "absl/memory/memory.h"
 #include "async_grpc/rpc_handler.h"
 #include "cartographer/cloud/internal/map_builder_context_interface.h"
@@ -43,20 +46,63 @@ std::unique_ptr<proto::ReceiveGlobalSlamOptimizationsResponse> GenerateResponse(
   return response;
 }
 
+// Returns the entries of 'ids' which differ from 'last_sent_ids' and
+// records them there.
+template <typename IdType>
+std::map<int, IdType> ExtractChangedIds(const std::map<int, IdType> &ids,
+                                        std::map<int, IdType> *last_sent_ids) {
+  std::map<int, IdType> changed_ids;
+  for (const auto &entry : ids) {
+    auto it = last_sent_ids->find(entry.first);
+    if (it != last_sent_ids->end() && it->second == entry.second) {
+      continue;
+    }
+    changed_ids.insert(entry);
+    (*last_sent_ids)[entry.first] = entry.second;
+  }
+  return changed_ids;
+}
+
+// Ids last sent on a stream in 'send_only_changes' mode.
+struct SentIds {
+  std::map<int, mapping::SubmapId> submap_ids;
+  std::map<int, mapping::NodeId> node_ids;
+};
+
 }  // namespace
 
 void ReceiveGlobalSlamOptimizationsHandler::OnRequest(
-    const google::protobuf::Empty &request) {
+    const proto::ReceiveGlobalSlamOptimizationsRequest &request) {
   auto writer = GetWriter();
+  // Callbacks are invoked one at a time, so 'sent_ids' needs no locking.
+  std::shared_ptr<SentIds> sent_ids;
+  if (request.send_only_changes()) {
+    sent_ids = std::make_shared<SentIds>();
+  }
   const int subscription_index =
       GetUnsynchronizedContext<MapBuilderContextInterface>()
           ->SubscribeGlobalSlamOptimizations(
-              [writer](const std::map<int, mapping::SubmapId>
-                           &last_optimized_submap_ids,
-                       const std::map<int, mapping::NodeId>
-                           &last_optimized_node_ids) {
-                if (!writer.Write(GenerateResponse(last_optimized_submap_ids,
-                                                   last_optimized_node_ids))) {
+              [writer, sent_ids](const std::map<int, mapping::SubmapId>
+                                     &last_optimized_submap_ids,
+                                 const std::map<int, mapping::NodeId>
+                                     &last_optimized_node_ids) {
+                std::unique_ptr<proto::ReceiveGlobalSlamOptimizationsResponse>
+                    response;
+                if (sent_ids) {
+                  const auto changed_submap_ids = ExtractChangedIds(
+                      last_optimized_submap_ids, &sent_ids->submap_ids);
+                  const auto changed_node_ids = ExtractChangedIds(
+                      last_optimized_node_ids, &sent_ids->node_ids);
+                  if (changed_submap_ids.empty() && changed_node_ids.empty()) {
+                    return true;
+                  }
+                  response =
+                      GenerateResponse(changed_submap_ids, changed_node_ids);
+                } else {
+                  response = GenerateResponse(last_optimized_submap_ids,
+                                              last_optimized_node_ids);
+                }
+                if (!writer.Write(std::move(response))) {
                   // Client closed connection.
                   LOG(INFO) << "Client closed connection.";
                   return false;
@@ -27,7 +27,8 @@ namespace cloud {
 namespace handlers {
 
 DEFINE_HANDLER_SIGNATURE(
-    ReceiveGlobalSlamOptimizationsSignature, google::protobuf::Empty,
+    ReceiveGlobalSlamOptimizationsSignature,
+    proto::ReceiveGlobalSlamOptimizationsRequest,
     async_grpc::Stream<proto::ReceiveGlobalSlamOptimizationsResponse>,
     "/cartographer.cloud.proto.MapBuilderService/"
     "ReceiveGlobalSlamOptimizations")
@@ -35,7 +36,8 @@ DEFINE_HANDLER_SIGNATURE(
 class ReceiveGlobalSlamOptimizationsHandler
     : public async_grpc::RpcHandler<ReceiveGlobalSlamOptimizationsSignature> {
  public:
-  void OnRequest(const google::protobuf::Empty &request) override;
+  void OnRequest(
+      const proto::ReceiveGlobalSlamOptimizationsRequest &request) override;
   void OnFinish() override;
 
  private:
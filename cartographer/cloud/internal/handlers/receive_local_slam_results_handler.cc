@@ -27,17 +27,17 @@ namespace cloud {
 namespace handlers {
 namespace {
 
-std::unique_ptr<proto::ReceiveLocalSlamResultsResponse> GenerateResponse(
-    std::unique_ptr<MapBuilderContextInterface::LocalSlamResult>
-        local_slam_result) {
-  auto response = absl::make_unique<proto::ReceiveLocalSlamResultsResponse>();
+std::unique_ptr<proto::SerializedReceiveLocalSlamResultsResponse>
+GenerateResponse(std::unique_ptr<MapBuilderContextInterface::LocalSlamResult>
+                     local_slam_result) {
+  auto response =
+      absl::make_unique<proto::SerializedReceiveLocalSlamResultsResponse>();
   response->set_trajectory_id(local_slam_result->trajectory_id);
   response->set_timestamp(common::ToUniversal(local_slam_result->time));
   *response->mutable_local_pose() =
       transform::ToProto(local_slam_result->local_pose);
-  if (local_slam_result->range_data) {
-    *response->mutable_range_data() =
-        sensor::ToProto(*local_slam_result->range_data);
+  if (local_slam_result->serialized_range_data) {
+    response->set_range_data(*local_slam_result->serialized_range_data);
   }
   if (local_slam_result->insertion_result) {
     local_slam_result->insertion_result->node_id.ToProto(
@@ -54,7 +54,7 @@ void ReceiveLocalSlamResultsHandler::OnRequest(
   MapBuilderContextInterface::LocalSlamSubscriptionId subscription_id =
       GetUnsynchronizedContext<MapBuilderContextInterface>()
           ->SubscribeLocalSlamResults(
-              request.trajectory_id(),
+              request.trajectory_id(), !request.omit_range_data(),
               [writer](
                   std::unique_ptr<MapBuilderContextInterface::LocalSlamResult>
                       local_slam_result) {
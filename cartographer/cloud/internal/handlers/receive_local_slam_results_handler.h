@@ -32,8 +32,17 @@ DEFINE_HANDLER_SIGNATURE(
     async_grpc::Stream<proto::ReceiveLocalSlamResultsResponse>,
     "/cartographer.cloud.proto.MapBuilderService/ReceiveLocalSlamResults")
 
+// The same method as seen by the server, which sends the range data already
+// serialized.
+DEFINE_HANDLER_SIGNATURE(
+    ReceiveSerializedLocalSlamResultsSignature,
+    proto::ReceiveLocalSlamResultsRequest,
+    async_grpc::Stream<proto::SerializedReceiveLocalSlamResultsResponse>,
+    "/cartographer.cloud.proto.MapBuilderService/ReceiveLocalSlamResults")
+
 class ReceiveLocalSlamResultsHandler
-    : public async_grpc::RpcHandler<ReceiveLocalSlamResultsSignature> {
+    : public async_grpc::RpcHandler<
+          ReceiveSerializedLocalSlamResultsSignature> {
  public:
   void OnRequest(const proto::ReceiveLocalSlamResultsRequest& request) override;
   void OnFinish() override;
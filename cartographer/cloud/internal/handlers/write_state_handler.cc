@@ -20,16 +20,18 @@
 #include "cartographer/cloud/internal/map_builder_context_interface.h"
 #include "cartographer/cloud/internal/map_builder_server.h"
 #include "cartographer/cloud/proto/map_builder_service.pb.h"
+#include "cartographer/common/port.h"
 #include "cartographer/io/internal/in_memory_proto_stream.h"
 
 namespace cartographer {
 namespace cloud {
 namespace handlers {
 
-void WriteStateHandler::OnRequest(const google::protobuf::Empty& request) {
+void WriteStateHandler::OnRequest(const proto::WriteStateRequest& request) {
   auto writer = GetWriter();
+  const bool compress = request.compress_serialized_data();
   io::ForwardingProtoStreamWriter proto_stream_writer(
-      [writer](const google::protobuf::Message* proto) {
+      [writer, compress](const google::protobuf::Message* proto) {
         if (!proto) {
           writer.WritesDone();
           return true;
@@ -41,7 +43,17 @@ void WriteStateHandler::OnRequest(const google::protobuf::Empty& request) {
           response->mutable_header()->CopyFrom(*proto);
         } else if (proto->GetTypeName() ==
                    "cartographer.mapping.proto.SerializedData") {
-          response->mutable_serialized_data()->CopyFrom(*proto);
+          if (compress) {
+            // Responses wait in memory until they are sent, compressing them
+            // keeps that buffer small.
+            std::string uncompressed_data;
+            proto->SerializeToString(&uncompressed_data);
+            common::FastGzipString(
+                uncompressed_data,
+                response->mutable_compressed_serialized_data());
+          } else {
+            response->mutable_serialized_data()->CopyFrom(*proto);
+          }
         } else {
           LOG(FATAL) << "Unsupported message type: " << proto->GetTypeName();
         }
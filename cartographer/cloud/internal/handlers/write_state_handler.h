@@ -19,20 +19,19 @@
 
 #include "async_grpc/rpc_handler.h"
 #include "cartographer/cloud/proto/map_builder_service.pb.h"
-#include "google/protobuf/empty.pb.h"
 
 namespace cartographer {
 namespace cloud {
 namespace handlers {
 
 DEFINE_HANDLER_SIGNATURE(
-    WriteStateSignature, google::protobuf::Empty,
+    WriteStateSignature, proto::WriteStateRequest,
     async_grpc::Stream<proto::WriteStateResponse>,
     "/cartographer.cloud.proto.MapBuilderService/WriteState")
 
 class WriteStateHandler : public async_grpc::RpcHandler<WriteStateSignature> {
  public:
-  void OnRequest(const google::protobuf::Empty& request) override;
+  void OnRequest(const proto::WriteStateRequest& request) override;
 };
 
 }  // namespace handlers
@@ -16,8 +16,13 @@
 
 #include "cartographer/cloud/internal/local_trajectory_uploader.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <map>
 #include <thread>
+#include <vector>
 
 #include "absl/memory/memory.h"
 #include "async_grpc/client.h"
@@ -39,6 +44,9 @@ constexpr int kConnectionTimeoutInSeconds = 10;
 constexpr int kConnectionRecoveryTimeoutInSeconds = 60;
 constexpr int kTokenRefreshIntervalInSeconds = 60;
 const common::Duration kPopTimeout = common::FromMilliseconds(100);
+// Number of finished batches that may wait for each upload thread before
+// batching blocks.
+constexpr size_t kMaxQueuedBatchesPerUploadThread = 2;
 
 // This defines the '::grpc::StatusCode's that are considered unrecoverable
 // errors and hence no retries will be attempted by the client.
@@ -65,9 +73,8 @@ class LocalTrajectoryUploader : public LocalTrajectoryUploaderInterface {
   };
 
  public:
-  LocalTrajectoryUploader(const std::string& uplink_server_address,
-                          int batch_size, bool enable_ssl_encryption,
-                          bool enable_google_auth);
+  explicit LocalTrajectoryUploader(
+      const proto::MapBuilderServerOptions& map_builder_server_options);
   ~LocalTrajectoryUploader();
 
   // Starts the upload thread.
@@ -92,31 +99,80 @@ class LocalTrajectoryUploader : public LocalTrajectoryUploaderInterface {
   }
 
  private:
+  // A finished batch waiting to be uploaded. 'recovery_generation' identifies
+  // the uplink trajectories its trajectory ids were translated to.
+  struct PendingBatch {
+    int recovery_generation;
+    proto::AddSensorDataBatchRequest request;
+  };
+
+  // Sensor data is assigned to an upload thread by sensor, so that data of
+  // one sensor is uploaded in order even with several batches in flight.
+  struct UploadLane {
+    UploadLane() : upload_queue(kMaxQueuedBatchesPerUploadThread) {}
+
+    proto::AddSensorDataBatchRequest batch_request;
+    int batch_bytes = 0;
+    std::chrono::steady_clock::time_point batch_start_time;
+    common::BlockingQueue<std::unique_ptr<PendingBatch>> upload_queue;
+    std::unique_ptr<std::thread> upload_thread;
+  };
+
   void ProcessSendQueue();
+  void ProcessUploadQueue(UploadLane* lane);
+  UploadLane* GetUploadLane(const proto::SensorMetadata& sensor_metadata);
+  void FlushBatch(UploadLane* lane);
+  void FlushExpiredBatches();
+  // Drops all batches not yet uploaded and re-establishes the uplink
+  // trajectories.
+  void Recover();
   // Returns 'false' for failure.
   bool TranslateTrajectoryId(proto::SensorMetadata* sensor_metadata);
   grpc::Status RegisterTrajectory(int local_trajectory_id);
 
   std::shared_ptr<::grpc::Channel> client_channel_;
-  int batch_size_;
+  const int batch_size_;
+  const int max_batch_bytes_;
+  const common::Duration max_batch_delay_;
   std::map<int, TrajectoryInfo> local_trajectory_id_to_trajectory_info_;
   common::BlockingQueue<std::unique_ptr<proto::SensorData>> send_queue_;
+  std::vector<std::unique_ptr<UploadLane>> upload_lanes_;
+  // Incremented by every recovery. Upload failures of batches from an earlier
+  // generation do not trigger another recovery.
+  std::atomic<int> recovery_generation_{0};
+  std::atomic<bool> recovery_requested_{false};
   bool shutting_down_ = false;
+  std::atomic<bool> upload_threads_shutting_down_{false};
   std::unique_ptr<std::thread> upload_thread_;
 };
 
 LocalTrajectoryUploader::LocalTrajectoryUploader(
-    const std::string& uplink_server_address, int batch_size,
-    bool enable_ssl_encryption, bool enable_google_auth)
-    : batch_size_(batch_size) {
+    const proto::MapBuilderServerOptions& map_builder_server_options)
+    : batch_size_(map_builder_server_options.upload_batch_size()),
+      max_batch_bytes_(map_builder_server_options.upload_max_batch_bytes()),
+      max_batch_delay_(common::FromSeconds(
+          map_builder_server_options.upload_max_batch_delay_seconds())) {
+  CHECK_GT(batch_size_, 0);
+  const int num_upload_threads =
+      std::max(1, map_builder_server_options.num_upload_rpcs_in_flight());
+  for (int i = 0; i < num_upload_threads; ++i) {
+    upload_lanes_.push_back(make_unique<UploadLane>());
+  }
+  const std::string& uplink_server_address =
+      map_builder_server_options.uplink_server_address();
   auto channel_creds =
-      enable_google_auth
+      map_builder_server_options.enable_google_auth()
           ? grpc::GoogleDefaultCredentials()
-          : (enable_ssl_encryption
+          : (map_builder_server_options.enable_ssl_encryption()
                  ? ::grpc::SslCredentials(::grpc::SslCredentialsOptions())
                  : ::grpc::InsecureChannelCredentials());
 
-  client_channel_ = ::grpc::CreateChannel(uplink_server_address, channel_creds);
+  ::grpc::ChannelArguments channel_arguments;
+  if (map_builder_server_options.enable_upload_compression()) {
+    channel_arguments.SetCompressionAlgorithm(GRPC_COMPRESS_GZIP);
+  }
+  client_channel_ = ::grpc::CreateCustomChannel(
+      uplink_server_address, channel_creds, channel_arguments);
   std::chrono::system_clock::time_point deadline =
       std::chrono::system_clock::now() +
       std::chrono::seconds(kConnectionTimeoutInSeconds);
@@ -131,6 +187,11 @@ LocalTrajectoryUploader::~LocalTrajectoryUploader() {}
 void LocalTrajectoryUploader::Start() {
   CHECK(!shutting_down_);
   CHECK(!upload_thread_);
+  for (auto& lane : upload_lanes_) {
+    UploadLane* const lane_ptr = lane.get();
+    lane->upload_thread = make_unique<std::thread>(
+        [this, lane_ptr]() { this->ProcessUploadQueue(lane_ptr); });
+  }
   upload_thread_ =
       make_unique<std::thread>([this]() { this->ProcessSendQueue(); });
 }
@@ -139,7 +200,13 @@ void LocalTrajectoryUploader::Shutdown() {
   CHECK(!shutting_down_);
   CHECK(upload_thread_);
   shutting_down_ = true;
+  // The batching thread may block on a full upload queue, so the upload
+  // threads are stopped only after it has finished.
   upload_thread_->join();
+  upload_threads_shutting_down_ = true;
+  for (auto& lane : upload_lanes_) {
+    lane->upload_thread->join();
+  }
 }
 
 void LocalTrajectoryUploader::TryRecovery() {
@@ -198,19 +265,42 @@ void LocalTrajectoryUploader::TryRecovery() {
   LOG(INFO) << "LocalTrajectoryUploader recovered.";
 }
 
+void LocalTrajectoryUploader::Recover() {
+  for (auto& lane : upload_lanes_) {
+    lane->batch_request.clear_sensor_data();
+    lane->batch_bytes = 0;
+    while (lane->upload_queue.PopWithTimeout(common::FromSeconds(0))) {
+    }
+  }
+  TryRecovery();
+  ++recovery_generation_;
+  recovery_requested_ = false;
+}
+
 void LocalTrajectoryUploader::ProcessSendQueue() {
   LOG(INFO) << "Starting uploader thread.";
-  proto::AddSensorDataBatchRequest batch_request;
+  const common::Duration pop_timeout =
+      max_batch_delay_ > common::Duration::zero()
+          ? std::min(kPopTimeout, max_batch_delay_)
+          : kPopTimeout;
   while (!shutting_down_) {
-    auto sensor_data = send_queue_.PopWithTimeout(kPopTimeout);
+    if (recovery_requested_) {
+      Recover();
+      continue;
+    }
+    auto sensor_data = send_queue_.PopWithTimeout(pop_timeout);
     if (sensor_data) {
+      UploadLane* const lane = GetUploadLane(sensor_data->sensor_metadata());
       if (!TranslateTrajectoryId(sensor_data->mutable_sensor_metadata())) {
-        batch_request.clear_sensor_data();
-        TryRecovery();
+        Recover();
         continue;
       }
-      proto::SensorData* added_sensor_data = batch_request.add_sensor_data();
-      *added_sensor_data = *sensor_data;
+      if (lane->batch_request.sensor_data_size() == 0) {
+        lane->batch_start_time = std::chrono::steady_clock::now();
+      }
+      proto::SensorData* added_sensor_data =
+          lane->batch_request.add_sensor_data();
+      added_sensor_data->Swap(sensor_data.get());
 
       // A submap also holds a trajectory id that must be translated to uplink's
       // trajectory id.
@@ -222,23 +312,74 @@ void LocalTrajectoryUploader::ProcessSendQueue() {
               added_sensor_data->sensor_metadata().trajectory_id());
         }
       }
+      lane->batch_bytes += added_sensor_data->ByteSize();
 
-      if (batch_request.sensor_data_size() == batch_size_) {
-        async_grpc::Client<handlers::AddSensorDataBatchSignature> client(
-            client_channel_, common::FromSeconds(kConnectionTimeoutInSeconds),
-            async_grpc::CreateUnlimitedConstantDelayStrategy(
-                common::FromSeconds(1), kUnrecoverableStatusCodes));
-        if (client.Write(batch_request)) {
-          LOG(INFO) << "Uploaded " << batch_request.ByteSize()
-                    << " bytes of sensor data.";
-          batch_request.clear_sensor_data();
-          continue;
-        }
-        // Unrecoverable error occurred. Attempt recovery.
-        batch_request.clear_sensor_data();
-        TryRecovery();
+      if (lane->batch_request.sensor_data_size() >= batch_size_ ||
+          (max_batch_bytes_ > 0 && lane->batch_bytes >= max_batch_bytes_)) {
+        FlushBatch(lane);
       }
     }
+    FlushExpiredBatches();
+  }
+}
+
+void LocalTrajectoryUploader::ProcessUploadQueue(UploadLane* lane) {
+  while (!upload_threads_shutting_down_) {
+    std::unique_ptr<PendingBatch> batch =
+        lane->upload_queue.PopWithTimeout(kPopTimeout);
+    // Batches translated before the last recovery, or queued while a
+    // recovery is pending, are dropped.
+    if (!batch || recovery_requested_ ||
+        batch->recovery_generation != recovery_generation_.load()) {
+      continue;
+    }
+    async_grpc::Client<handlers::AddSensorDataBatchSignature> client(
+        client_channel_, common::FromSeconds(kConnectionTimeoutInSeconds),
+        async_grpc::CreateUnlimitedConstantDelayStrategy(
+            common::FromSeconds(1), kUnrecoverableStatusCodes));
+    if (client.Write(batch->request)) {
+      LOG(INFO) << "Uploaded " << batch->request.ByteSize()
+                << " bytes of sensor data.";
+      continue;
+    }
+    // Unrecoverable error occurred. The batching thread attempts recovery
+    // unless this batch predates the last recovery.
+    if (batch->recovery_generation == recovery_generation_.load()) {
+      recovery_requested_ = true;
+    }
+  }
+}
+
+LocalTrajectoryUploader::UploadLane* LocalTrajectoryUploader::GetUploadLane(
+    const proto::SensorMetadata& sensor_metadata) {
+  if (upload_lanes_.size() == 1) {
+    return upload_lanes_.front().get();
+  }
+  const size_t hash = std::hash<std::string>()(sensor_metadata.sensor_id()) ^
+                      std::hash<int>()(sensor_metadata.trajectory_id());
+  return upload_lanes_[hash % upload_lanes_.size()].get();
+}
+
+void LocalTrajectoryUploader::FlushBatch(UploadLane* lane) {
+  auto batch = make_unique<PendingBatch>();
+  batch->recovery_generation = recovery_generation_.load();
+  batch->request.Swap(&lane->batch_request);
+  lane->batch_bytes = 0;
+  // Blocks while the upload thread is behind, so that at most a bounded
+  // number of batches per thread are waiting for the uplink.
+  lane->upload_queue.Push(std::move(batch));
+}
+
+void LocalTrajectoryUploader::FlushExpiredBatches() {
+  if (max_batch_delay_ <= common::Duration::zero()) {
+    return;
+  }
+  const auto now = std::chrono::steady_clock::now();
+  for (auto& lane : upload_lanes_) {
+    if (lane->batch_request.sensor_data_size() > 0 &&
+        now - lane->batch_start_time >= max_batch_delay_) {
+      FlushBatch(lane.get());
+    }
   }
 }
 
@@ -336,9 +477,18 @@ void LocalTrajectoryUploader::EnqueueSensorData(
 std::unique_ptr<LocalTrajectoryUploaderInterface> CreateLocalTrajectoryUploader(
     const std::string& uplink_server_address, int batch_size,
     bool enable_ssl_encryption, bool enable_google_auth) {
-  return make_unique<LocalTrajectoryUploader>(uplink_server_address, batch_size,
-                                              enable_ssl_encryption,
-                                              enable_google_auth);
+  proto::MapBuilderServerOptions map_builder_server_options;
+  map_builder_server_options.set_uplink_server_address(uplink_server_address);
+  map_builder_server_options.set_upload_batch_size(batch_size);
+  map_builder_server_options.set_enable_ssl_encryption(enable_ssl_encryption);
+  map_builder_server_options.set_enable_google_auth(enable_google_auth);
+  map_builder_server_options.set_num_upload_rpcs_in_flight(1);
+  return CreateLocalTrajectoryUploader(map_builder_server_options);
+}
+
+std::unique_ptr<LocalTrajectoryUploaderInterface> CreateLocalTrajectoryUploader(
+    const proto::MapBuilderServerOptions& map_builder_server_options) {
+  return make_unique<LocalTrajectoryUploader>(map_builder_server_options);
 }
 
 }  // namespace cloud
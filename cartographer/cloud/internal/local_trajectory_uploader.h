@@ -21,6 +21,7 @@
 #include <set>
 #include <string>
 
+#include "cartographer/cloud/proto/map_builder_server_options.pb.h"
 #include "cartographer/cloud/proto/map_builder_service.pb.h"
 #include "cartographer/mapping/proto/trajectory_builder_options.pb.h"
 #include "cartographer/mapping/trajectory_builder_interface.h"
@@ -30,7 +31,8 @@ namespace cartographer {
 namespace cloud {
 
 // Uploads sensor data batches to uplink server.
-// Gracefully handles interruptions of the connection.
+// Gracefully handles interruptions of the connection. Several batches may be
+// in flight at once, but data of a single sensor is always uploaded in order.
 class LocalTrajectoryUploaderInterface {
  public:
   using SensorId = mapping::TrajectoryBuilderInterface::SensorId;
@@ -66,6 +68,11 @@ std::unique_ptr<LocalTrajectoryUploaderInterface> CreateLocalTrajectoryUploader(
     const std::string& uplink_server_address, int batch_size,
     bool enable_ssl_encryption, bool enable_google_auth);
 
+// Like above, but also applies the batching, concurrency and compression
+// settings from 'map_builder_server_options'.
+std::unique_ptr<LocalTrajectoryUploaderInterface> CreateLocalTrajectoryUploader(
+    const proto::MapBuilderServerOptions& map_builder_server_options);
+
 }  // namespace cloud
 }  // namespace cartographer
 
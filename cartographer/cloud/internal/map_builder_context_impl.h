@@ -66,9 +66,10 @@ void MapBuilderContext<SubmapType>::AddSensorDataToTrajectory(
 template <class SubmapType>
 MapBuilderContextInterface::LocalSlamSubscriptionId
 MapBuilderContext<SubmapType>::SubscribeLocalSlamResults(
-    int trajectory_id, LocalSlamSubscriptionCallback callback) {
-  return map_builder_server_->SubscribeLocalSlamResults(trajectory_id,
-                                                        callback);
+    int trajectory_id, bool include_range_data,
+    LocalSlamSubscriptionCallback callback) {
+  return map_builder_server_->SubscribeLocalSlamResults(
+      trajectory_id, include_range_data, callback);
 }
 
 template <class SubmapType>
@@ -123,6 +124,15 @@ bool MapBuilderContext<SubmapType>::CheckClientIdForTrajectory(
           client_ids_[trajectory_id] == client_id);
 }
 
+template <class SubmapType>
+::grpc::Status MapBuilderContext<SubmapType>::AttachSharedMemory(
+    int trajectory_id, const std::string& sensor_data_ring_name,
+    const std::string& local_slam_results_ring_name, bool include_range_data) {
+  return map_builder_server_->AttachSharedMemory(
+      trajectory_id, sensor_data_ring_name, local_slam_results_ring_name,
+      include_range_data);
+}
+
 template <>
 void MapBuilderContext<mapping::Submap2D>::EnqueueLocalSlamResultData(
     int trajectory_id, const std::string& sensor_id,
@@ -38,6 +38,10 @@ class MapBuilderContextInterface : public async_grpc::ExecutionContext {
     common::Time time;
     transform::Rigid3d local_pose;
     std::shared_ptr<const sensor::RangeData> range_data;
+    // 'range_data' as a serialized 'sensor::proto::RangeData', shared by all
+    // subscriptions so that it is only serialized once. Both are nullptr for
+    // subscriptions without range data.
+    std::shared_ptr<const std::string> serialized_range_data;
     std::unique_ptr<const mapping::TrajectoryBuilderInterface::InsertionResult>
         insertion_result;
   };
@@ -78,8 +82,11 @@ class MapBuilderContextInterface : public async_grpc::ExecutionContext {
   virtual mapping::TrajectoryBuilderInterface::LocalSlamResultCallback
   GetLocalSlamResultCallbackForSubscriptions() = 0;
   virtual void AddSensorDataToTrajectory(const Data& sensor_data) = 0;
+  // If 'include_range_data' is false, results are passed to 'callback'
+  // without range data.
   virtual LocalSlamSubscriptionId SubscribeLocalSlamResults(
-      int trajectory_id, LocalSlamSubscriptionCallback callback) = 0;
+      int trajectory_id, bool include_range_data,
+      LocalSlamSubscriptionCallback callback) = 0;
   virtual void UnsubscribeLocalSlamResults(
       const LocalSlamSubscriptionId& subscription_id) = 0;
   virtual int SubscribeGlobalSlamOptimizations(
@@ -96,6 +103,13 @@ class MapBuilderContextInterface : public async_grpc::ExecutionContext {
                                              int trajectory_id) = 0;
   virtual bool CheckClientIdForTrajectory(const std::string& client_id,
                                           int trajectory_id) = 0;
+  // Starts passing sensor data and local SLAM results of 'trajectory_id'
+  // through the shared memory rings of the given names, which the client
+  // created. 'local_slam_results_ring_name' may be empty.
+  virtual ::grpc::Status AttachSharedMemory(
+      int trajectory_id, const std::string& sensor_data_ring_name,
+      const std::string& local_slam_results_ring_name,
+      bool include_range_data) = 0;
 };
 
 }  // namespace cloud
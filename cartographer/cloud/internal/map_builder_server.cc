@@ -23,6 +23,7 @@
 #include "cartographer/cloud/internal/handlers/add_rangefinder_data_handler.h"
 #include "cartographer/cloud/internal/handlers/add_sensor_data_batch_handler.h"
 #include "cartographer/cloud/internal/handlers/add_trajectory_handler.h"
+#include "cartographer/cloud/internal/handlers/attach_shared_memory_handler.h"
 #include "cartographer/cloud/internal/handlers/delete_trajectory_handler.h"
 #include "cartographer/cloud/internal/handlers/finish_trajectory_handler.h"
 #include "cartographer/cloud/internal/handlers/get_all_submap_poses.h"
@@ -43,6 +44,9 @@
 #include "cartographer/cloud/internal/handlers/write_state_handler.h"
 #include "cartographer/cloud/internal/handlers/write_state_to_file_handler.h"
 #include "cartographer/cloud/internal/sensor/serialization.h"
+#include "cartographer/cloud/internal/shared_memory_ring.h"
+#include "cartographer/common/task.h"
+#include "cartographer/sensor/range_data.h"
 #include "glog/logging.h"
 
 namespace cartographer {
@@ -52,13 +56,18 @@ namespace {
 static auto* kIncomingDataQueueMetric = metrics::Gauge::Null();
 constexpr int kMaxMessageSize = 100 * 1024 * 1024;  // 100 MB
 const common::Duration kPopTimeout = common::FromMilliseconds(100);
+// Sensor data added to a trajectory before its draining task yields its
+// thread to other trajectories.
+constexpr int kMaxSensorDataPerDrain = 16;
 
 }  // namespace
 
 MapBuilderServer::MapBuilderServer(
     const proto::MapBuilderServerOptions& map_builder_server_options,
     std::unique_ptr<mapping::MapBuilderInterface> map_builder)
-    : map_builder_(std::move(map_builder)) {
+    : enable_shared_memory_transport_(
+          map_builder_server_options.enable_shared_memory_transport()),
+      map_builder_(std::move(map_builder)) {
   async_grpc::Server::Builder server_builder;
   server_builder.SetServerAddress(map_builder_server_options.server_address());
   server_builder.SetNumGrpcThreads(
@@ -67,12 +76,18 @@ MapBuilderServer::MapBuilderServer(
       map_builder_server_options.num_event_threads());
   server_builder.SetMaxSendMessageSize(kMaxMessageSize);
   server_builder.SetMaxReceiveMessageSize(kMaxMessageSize);
+  if (map_builder_server_options.num_sensor_data_threads() > 1) {
+    CHECK(map_builder_server_options.map_builder_options()
+              .collate_by_trajectory())
+        << "Several sensor data threads require collate_by_trajectory.";
+    // Local SLAM runs on these threads, so they are not niced.
+    sensor_data_thread_pool_ = absl::make_unique<common::ThreadPool>(
+        map_builder_server_options.num_sensor_data_threads(),
+        0 /* nice_increment */, std::vector<int>() /* cpu_ids */);
+  }
   if (!map_builder_server_options.uplink_server_address().empty()) {
-    local_trajectory_uploader_ = CreateLocalTrajectoryUploader(
-        map_builder_server_options.uplink_server_address(),
-        map_builder_server_options.upload_batch_size(),
-        map_builder_server_options.enable_ssl_encryption(),
-        map_builder_server_options.enable_google_auth());
+    local_trajectory_uploader_ =
+        CreateLocalTrajectoryUploader(map_builder_server_options);
   }
   server_builder.RegisterHandler<handlers::AddTrajectoryHandler>();
   server_builder.RegisterHandler<handlers::AddOdometryDataHandler>();
@@ -86,6 +101,7 @@ MapBuilderServer::MapBuilderServer(
   server_builder
       .RegisterHandler<handlers::ReceiveGlobalSlamOptimizationsHandler>();
   server_builder.RegisterHandler<handlers::ReceiveLocalSlamResultsHandler>();
+  server_builder.RegisterHandler<handlers::AttachSharedMemoryHandler>();
   server_builder.RegisterHandler<handlers::GetSubmapHandler>();
   server_builder.RegisterHandler<handlers::GetTrajectoryNodePosesHandler>();
   server_builder.RegisterHandler<handlers::GetTrajectoryStatesHandler>();
@@ -144,6 +160,10 @@ void MapBuilderServer::WaitForShutdown() {
 void MapBuilderServer::Shutdown() {
   shutting_down_ = true;
   grpc_server_->Shutdown();
+  {
+    absl::MutexLock locker(&shared_memory_receivers_mutex_);
+    shared_memory_receivers_.clear();
+  }
   if (slam_thread_) {
     slam_thread_->join();
     slam_thread_.reset();
@@ -160,13 +180,65 @@ void MapBuilderServer::ProcessSensorDataQueue() {
     kIncomingDataQueueMetric->Set(incoming_data_queue_.Size());
     std::unique_ptr<MapBuilderContextInterface::Data> sensor_data =
         incoming_data_queue_.PopWithTimeout(kPopTimeout);
-    if (sensor_data) {
+    if (!sensor_data) {
+      continue;
+    }
+    if (sensor_data_thread_pool_) {
+      DispatchSensorData(std::move(sensor_data));
+    } else {
       grpc_server_->GetContext<MapBuilderContextInterface>()
           ->AddSensorDataToTrajectory(*sensor_data);
     }
   }
 }
 
+void MapBuilderServer::DispatchSensorData(
+    std::unique_ptr<MapBuilderContextInterface::Data> sensor_data) {
+  absl::MutexLock locker(&trajectory_data_queues_mutex_);
+  const int trajectory_id = sensor_data->trajectory_id;
+  TrajectoryDataQueue& queue = trajectory_data_queues_[trajectory_id];
+  queue.data.push_back(std::move(sensor_data));
+  ++num_dispatched_sensor_data_;
+  if (!queue.draining) {
+    queue.draining = true;
+    ScheduleDrainTrajectoryDataQueue(trajectory_id);
+  }
+}
+
+void MapBuilderServer::ScheduleDrainTrajectoryDataQueue(int trajectory_id) {
+  auto task = absl::make_unique<common::Task>();
+  task->SetWorkItem(
+      [this, trajectory_id]() { DrainTrajectoryDataQueue(trajectory_id); });
+  sensor_data_thread_pool_->Schedule(std::move(task));
+}
+
+void MapBuilderServer::DrainTrajectoryDataQueue(int trajectory_id) {
+  for (int i = 0; i < kMaxSensorDataPerDrain; ++i) {
+    std::unique_ptr<MapBuilderContextInterface::Data> sensor_data;
+    {
+      absl::MutexLock locker(&trajectory_data_queues_mutex_);
+      TrajectoryDataQueue& queue = trajectory_data_queues_.at(trajectory_id);
+      if (shutting_down_) {
+        num_dispatched_sensor_data_ -= queue.data.size();
+        queue.data.clear();
+      }
+      if (queue.data.empty()) {
+        queue.draining = false;
+        return;
+      }
+      sensor_data = std::move(queue.data.front());
+      queue.data.pop_front();
+    }
+    grpc_server_->GetContext<MapBuilderContextInterface>()
+        ->AddSensorDataToTrajectory(*sensor_data);
+    absl::MutexLock locker(&trajectory_data_queues_mutex_);
+    --num_dispatched_sensor_data_;
+  }
+  // Let other trajectories run before continuing with this one.
+  absl::MutexLock locker(&trajectory_data_queues_mutex_);
+  ScheduleDrainTrajectoryDataQueue(trajectory_id);
+}
+
 void MapBuilderServer::StartSlamThread() {
   CHECK(!slam_thread_);
 
@@ -183,6 +255,10 @@ void MapBuilderServer::OnLocalSlamResult(
   auto shared_range_data =
       std::make_shared<sensor::RangeData>(std::move(range_data));
 
+  // With several sensor data threads, local SLAM results of different
+  // trajectories arrive concurrently.
+  absl::MutexLock locker(&subscriptions_lock_);
+
   // If there is an uplink server and a submap insertion happened, enqueue this
   // local SLAM result for uploading.
   if (insertion_result &&
@@ -205,8 +281,19 @@ void MapBuilderServer::OnLocalSlamResult(
         ->EnqueueSensorData(std::move(sensor_data));
   }
 
-  absl::MutexLock locker(&subscriptions_lock_);
+  // The range data is serialized once and shared by all subscriptions which
+  // want it, instead of being converted for every subscribed client.
+  std::shared_ptr<const std::string> serialized_range_data;
+  for (const auto& entry : local_slam_subscriptions_[trajectory_id]) {
+    if (entry.second.include_range_data) {
+      serialized_range_data = std::make_shared<const std::string>(
+          sensor::ToProto(*shared_range_data).SerializeAsString());
+      break;
+    }
+  }
+
   for (auto& entry : local_slam_subscriptions_[trajectory_id]) {
+    const bool include_range_data = entry.second.include_range_data;
     auto copy_of_insertion_result =
         insertion_result
             ? absl::make_unique<
@@ -214,11 +301,13 @@ void MapBuilderServer::OnLocalSlamResult(
                   *insertion_result)
             : nullptr;
     MapBuilderContextInterface::LocalSlamSubscriptionCallback callback =
-        entry.second;
+        entry.second.callback;
     if (!callback(
             absl::make_unique<MapBuilderContextInterface::LocalSlamResult>(
                 MapBuilderContextInterface::LocalSlamResult{
-                    trajectory_id, time, local_pose, shared_range_data,
+                    trajectory_id, time, local_pose,
+                    include_range_data ? shared_range_data : nullptr,
+                    include_range_data ? serialized_range_data : nullptr,
                     std::move(copy_of_insertion_result)}))) {
       LOG(INFO) << "Removing subscription with index: " << entry.first;
       CHECK_EQ(local_slam_subscriptions_[trajectory_id].erase(entry.first), 1u);
@@ -240,11 +329,12 @@ void MapBuilderServer::OnGlobalSlamOptimizations(
 
 MapBuilderContextInterface::LocalSlamSubscriptionId
 MapBuilderServer::SubscribeLocalSlamResults(
-    int trajectory_id,
+    int trajectory_id, bool include_range_data,
     MapBuilderContextInterface::LocalSlamSubscriptionCallback callback) {
   absl::MutexLock locker(&subscriptions_lock_);
-  local_slam_subscriptions_[trajectory_id].emplace(current_subscription_index_,
-                                                   callback);
+  local_slam_subscriptions_[trajectory_id].emplace(
+      current_subscription_index_,
+      LocalSlamResultHandlerSubscription{include_range_data, callback});
   return MapBuilderContextInterface::LocalSlamSubscriptionId{
       trajectory_id, current_subscription_index_++};
 }
@@ -272,17 +362,81 @@ void MapBuilderServer::UnsubscribeGlobalSlamOptimizations(
 }
 
 void MapBuilderServer::NotifyFinishTrajectory(int trajectory_id) {
-  absl::MutexLock locker(&subscriptions_lock_);
-  for (auto& entry : local_slam_subscriptions_[trajectory_id]) {
-    MapBuilderContextInterface::LocalSlamSubscriptionCallback callback =
-        entry.second;
-    // 'nullptr' signals subscribers that the trajectory finished.
-    callback(nullptr);
+  {
+    absl::MutexLock locker(&subscriptions_lock_);
+    for (auto& entry : local_slam_subscriptions_[trajectory_id]) {
+      MapBuilderContextInterface::LocalSlamSubscriptionCallback callback =
+          entry.second.callback;
+      // 'nullptr' signals subscribers that the trajectory finished.
+      callback(nullptr);
+    }
   }
+  // The client waits until its sensor data was read before it finishes the
+  // trajectory, so nothing is lost here.
+  DetachSharedMemory(trajectory_id);
+}
+
+::grpc::Status MapBuilderServer::AttachSharedMemory(
+    int trajectory_id, const std::string& sensor_data_ring_name,
+    const std::string& local_slam_results_ring_name, bool include_range_data) {
+  if (!enable_shared_memory_transport_) {
+    return ::grpc::Status(::grpc::UNAVAILABLE,
+                          "Shared memory transport is disabled.");
+  }
+  std::unique_ptr<SharedMemoryRing> sensor_data_ring =
+      SharedMemoryRing::Open(sensor_data_ring_name);
+  if (sensor_data_ring == nullptr) {
+    return ::grpc::Status(::grpc::UNAVAILABLE,
+                          "Could not open " + sensor_data_ring_name);
+  }
+  std::unique_ptr<SharedMemoryRing> local_slam_results_ring;
+  if (!local_slam_results_ring_name.empty()) {
+    local_slam_results_ring =
+        SharedMemoryRing::Open(local_slam_results_ring_name);
+    if (local_slam_results_ring == nullptr) {
+      return ::grpc::Status(::grpc::UNAVAILABLE,
+                            "Could not open " + local_slam_results_ring_name);
+    }
+  }
+  absl::MutexLock locker(&shared_memory_receivers_mutex_);
+  if (shared_memory_receivers_.count(trajectory_id) > 0) {
+    return ::grpc::Status(::grpc::ALREADY_EXISTS,
+                          "Shared memory is already attached.");
+  }
+  shared_memory_receivers_[trajectory_id] =
+      absl::make_unique<SharedMemoryTrajectoryReceiver>(
+          grpc_server_->GetUnsynchronizedContext<MapBuilderContextInterface>(),
+          trajectory_id, std::move(sensor_data_ring),
+          std::move(local_slam_results_ring), include_range_data);
+  LOG(INFO) << "Receiving data of trajectory " << trajectory_id
+            << " through shared memory.";
+  return ::grpc::Status::OK;
+}
+
+void MapBuilderServer::DetachSharedMemory(int trajectory_id) {
+  std::unique_ptr<SharedMemoryTrajectoryReceiver> receiver;
+  {
+    absl::MutexLock locker(&shared_memory_receivers_mutex_);
+    auto it = shared_memory_receivers_.find(trajectory_id);
+    if (it == shared_memory_receivers_.end()) {
+      return;
+    }
+    receiver = std::move(it->second);
+    shared_memory_receivers_.erase(it);
+  }
+  // Destroyed outside the lock, since this joins its thread.
 }
 
 void MapBuilderServer::WaitUntilIdle() {
   incoming_data_queue_.WaitUntilEmpty();
+  {
+    const auto predicate = [this]() EXCLUSIVE_LOCKS_REQUIRED(
+                               trajectory_data_queues_mutex_) {
+      return num_dispatched_sensor_data_ == 0;
+    };
+    absl::MutexLock locker(&trajectory_data_queues_mutex_);
+    trajectory_data_queues_mutex_.Await(absl::Condition(&predicate));
+  }
   map_builder_->pose_graph()->RunFinalOptimization();
 }
 
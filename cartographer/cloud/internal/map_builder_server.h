@@ -17,13 +17,19 @@
 #ifndef CARTOGRAPHER_CLOUD_INTERNAL_MAP_BUILDER_SERVER_H
 #define CARTOGRAPHER_CLOUD_INTERNAL_MAP_BUILDER_SERVER_H
 
+#include <deque>
+#include <map>
+
+#include "absl/synchronization/mutex.h"
 #include "async_grpc/execution_context.h"
 #include "async_grpc/server.h"
 #include "cartographer/cloud/internal/local_trajectory_uploader.h"
 #include "cartographer/cloud/internal/map_builder_context_interface.h"
+#include "cartographer/cloud/internal/shared_memory_trajectory_receiver.h"
 #include "cartographer/cloud/map_builder_server_interface.h"
 #include "cartographer/cloud/proto/map_builder_server_options.pb.h"
 #include "cartographer/common/internal/blocking_queue.h"
+#include "cartographer/common/thread_pool.h"
 #include "cartographer/common/time.h"
 #include "cartographer/mapping/2d/submap_2d.h"
 #include "cartographer/mapping/3d/submap_3d.h"
@@ -49,7 +55,8 @@ class MapBuilderContext : public MapBuilderContextInterface {
   GetLocalSlamResultCallbackForSubscriptions() override;
   void AddSensorDataToTrajectory(const Data& sensor_data) override;
   MapBuilderContextInterface::LocalSlamSubscriptionId SubscribeLocalSlamResults(
-      int trajectory_id, LocalSlamSubscriptionCallback callback) override;
+      int trajectory_id, bool include_range_data,
+      LocalSlamSubscriptionCallback callback) override;
   void UnsubscribeLocalSlamResults(
       const LocalSlamSubscriptionId& subscription_id) override;
   int SubscribeGlobalSlamOptimizations(
@@ -67,6 +74,10 @@ class MapBuilderContext : public MapBuilderContextInterface {
                                      int trajectory_id) override;
   bool CheckClientIdForTrajectory(const std::string& client_id,
                                   int trajectory_id) override;
+  ::grpc::Status AttachSharedMemory(
+      int trajectory_id, const std::string& sensor_data_ring_name,
+      const std::string& local_slam_results_ring_name,
+      bool include_range_data) override;
 
  private:
   MapBuilderServer* map_builder_server_;
@@ -102,11 +113,29 @@ class MapBuilderServer : public MapBuilderServerInterface {
   static void RegisterMetrics(metrics::FamilyFactory* family_factory);
 
  private:
+  struct LocalSlamResultHandlerSubscription {
+    bool include_range_data;
+    MapBuilderContextInterface::LocalSlamSubscriptionCallback callback;
+  };
   using LocalSlamResultHandlerSubscriptions =
-      std::map<int /* subscription_index */,
-               MapBuilderContextInterface::LocalSlamSubscriptionCallback>;
+      std::map<int /* subscription_index */, LocalSlamResultHandlerSubscription>;
+
+  // Sensor data waiting to be added to one trajectory, if there are several
+  // sensor data threads.
+  struct TrajectoryDataQueue {
+    std::deque<std::unique_ptr<MapBuilderContextInterface::Data>> data;
+    // Whether a task draining 'data' is scheduled or running.
+    bool draining = false;
+  };
 
   void ProcessSensorDataQueue();
+  void DispatchSensorData(
+      std::unique_ptr<MapBuilderContextInterface::Data> sensor_data)
+      LOCKS_EXCLUDED(trajectory_data_queues_mutex_);
+  void ScheduleDrainTrajectoryDataQueue(int trajectory_id)
+      EXCLUSIVE_LOCKS_REQUIRED(trajectory_data_queues_mutex_);
+  void DrainTrajectoryDataQueue(int trajectory_id)
+      LOCKS_EXCLUDED(trajectory_data_queues_mutex_);
   void StartSlamThread();
   void OnLocalSlamResult(
       int trajectory_id, const std::string client_id, common::Time time,
@@ -118,7 +147,7 @@ class MapBuilderServer : public MapBuilderServerInterface {
       const std::map<int, mapping::SubmapId>& last_optimized_submap_ids,
       const std::map<int, mapping::NodeId>& last_optimized_node_ids);
   MapBuilderContextInterface::LocalSlamSubscriptionId SubscribeLocalSlamResults(
-      int trajectory_id,
+      int trajectory_id, bool include_range_data,
       MapBuilderContextInterface::LocalSlamSubscriptionCallback callback);
   void UnsubscribeLocalSlamResults(
       const MapBuilderContextInterface::LocalSlamSubscriptionId&
@@ -127,13 +156,27 @@ class MapBuilderServer : public MapBuilderServerInterface {
       MapBuilderContextInterface::GlobalSlamOptimizationCallback callback);
   void UnsubscribeGlobalSlamOptimizations(int subscription_index);
   void NotifyFinishTrajectory(int trajectory_id);
+  ::grpc::Status AttachSharedMemory(
+      int trajectory_id, const std::string& sensor_data_ring_name,
+      const std::string& local_slam_results_ring_name, bool include_range_data)
+      LOCKS_EXCLUDED(shared_memory_receivers_mutex_);
+  void DetachSharedMemory(int trajectory_id)
+      LOCKS_EXCLUDED(shared_memory_receivers_mutex_);
 
   bool shutting_down_ = false;
+  const bool enable_shared_memory_transport_;
   std::unique_ptr<std::thread> slam_thread_;
   std::unique_ptr<async_grpc::Server> grpc_server_;
   std::unique_ptr<mapping::MapBuilderInterface> map_builder_;
   common::BlockingQueue<std::unique_ptr<MapBuilderContextInterface::Data>>
       incoming_data_queue_;
+  // nullptr if sensor data is added by the SLAM thread itself.
+  std::unique_ptr<common::ThreadPool> sensor_data_thread_pool_;
+  absl::Mutex trajectory_data_queues_mutex_;
+  std::map<int /* trajectory ID */, TrajectoryDataQueue> trajectory_data_queues_
+      GUARDED_BY(trajectory_data_queues_mutex_);
+  int num_dispatched_sensor_data_ GUARDED_BY(trajectory_data_queues_mutex_) =
+      0;
   absl::Mutex subscriptions_lock_;
   int current_subscription_index_ = 0;
   std::map<int /* trajectory ID */, LocalSlamResultHandlerSubscriptions>
@@ -142,7 +185,11 @@ class MapBuilderServer : public MapBuilderServerInterface {
            MapBuilderContextInterface::GlobalSlamOptimizationCallback>
       global_slam_subscriptions_ GUARDED_BY(subscriptions_lock_);
   std::unique_ptr<LocalTrajectoryUploaderInterface> local_trajectory_uploader_;
-  int starting_submap_index_ = 0;
+  int starting_submap_index_ GUARDED_BY(subscriptions_lock_) = 0;
+  absl::Mutex shared_memory_receivers_mutex_;
+  std::map<int /* trajectory ID */,
+           std::unique_ptr<SharedMemoryTrajectoryReceiver>>
+      shared_memory_receivers_ GUARDED_BY(shared_memory_receivers_mutex_);
 };
 
 }  // namespace cloud
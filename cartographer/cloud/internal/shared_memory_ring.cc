@@ -0,0 +1,313 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/cloud/internal/shared_memory_ring.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <thread>
+
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace cloud {
+namespace {
+
+constexpr uint64 kMagic = 0x676e6952706d6143;  // "CmpRing" with a version.
+// Each record starts with its size, padded so that payloads stay aligned.
+constexpr size_t kRecordHeaderSize = 8;
+// Record size marking that the rest of the ring is unused and the next record
+// starts at the beginning.
+constexpr uint32 kWrapMarker = std::numeric_limits<uint32>::max();
+constexpr size_t kCacheLineSize = 64;
+constexpr int kNumSpinsBeforeSleeping = 100;
+
+size_t RoundUp(const size_t value, const size_t multiple) {
+  return (value + multiple - 1) / multiple * multiple;
+}
+
+size_t RecordSize(const size_t payload_size) {
+  return kRecordHeaderSize + RoundUp(payload_size, kRecordHeaderSize);
+}
+
+// Yields at first to keep the latency low while the other side is busy, then
+// backs off to not burn a core while it is idle.
+void Backoff(int* num_attempts) {
+  if (++*num_attempts < kNumSpinsBeforeSleeping) {
+    std::this_thread::yield();
+  } else {
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+}
+
+}  // namespace
+
+// Positions count bytes since creation and are only reduced modulo the
+// capacity to address the data, so that a full ring can be told apart from an
+// empty one. Each position is written by one side only and lives on its own
+// cache line.
+struct SharedMemoryRing::Header {
+  uint64 magic;
+  uint64 capacity;
+  alignas(kCacheLineSize) std::atomic<uint64> write_position;
+  std::atomic<uint32> writer_closed;
+  alignas(kCacheLineSize) std::atomic<uint64> read_position;
+  std::atomic<uint32> reader_closed;
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "Shared memory needs lock-free 64-bit atomics.");
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::Create(
+    const std::string& name, const size_t capacity) {
+  const size_t data_size = RoundUp(capacity, kRecordHeaderSize);
+  CHECK_GE(data_size, 2 * RecordSize(1));
+  const size_t data_offset = RoundUp(sizeof(Header), kCacheLineSize);
+  const size_t mapping_size = data_offset + data_size;
+  const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd == -1) {
+    PLOG(ERROR) << "Could not create shared memory '" << name << "'";
+    return nullptr;
+  }
+  void* mapping = MAP_FAILED;
+  if (ftruncate(fd, mapping_size) == 0) {
+    mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fd, 0);
+  }
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    PLOG(ERROR) << "Could not map shared memory '" << name << "'";
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+  Header* const header = new (mapping) Header();
+  header->capacity = data_size;
+  header->write_position.store(0);
+  header->writer_closed.store(0);
+  header->read_position.store(0);
+  header->reader_closed.store(0);
+  // Publishing the magic last lets 'Open()' reject a half initialized ring.
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = kMagic;
+  return std::unique_ptr<SharedMemoryRing>(
+      new SharedMemoryRing(name, true /* owner */, mapping, mapping_size));
+}
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::Open(
+    const std::string& name) {
+  const int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd == -1) {
+    PLOG(ERROR) << "Could not open shared memory '" << name << "'";
+    return nullptr;
+  }
+  struct stat status;
+  void* mapping = MAP_FAILED;
+  if (fstat(fd, &status) == 0 &&
+      static_cast<size_t>(status.st_size) > sizeof(Header)) {
+    mapping = mmap(nullptr, status.st_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    PLOG(ERROR) << "Could not map shared memory '" << name << "'";
+    return nullptr;
+  }
+  const Header* const header = static_cast<const Header*>(mapping);
+  if (header->magic != kMagic ||
+      RoundUp(sizeof(Header), kCacheLineSize) + header->capacity !=
+          static_cast<size_t>(status.st_size)) {
+    LOG(ERROR) << "Shared memory '" << name << "' is not a ring.";
+    munmap(mapping, status.st_size);
+    return nullptr;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return std::unique_ptr<SharedMemoryRing>(
+      new SharedMemoryRing(name, false /* owner */, mapping, status.st_size));
+}
+
+SharedMemoryRing::SharedMemoryRing(const std::string& name, const bool owner,
+                                   void* const mapping,
+                                   const size_t mapping_size)
+    : name_(name),
+      owner_(owner),
+      mapping_(mapping),
+      mapping_size_(mapping_size),
+      header_(static_cast<Header*>(mapping)),
+      data_(static_cast<uint8*>(mapping) +
+            RoundUp(sizeof(Header), kCacheLineSize)) {}
+
+SharedMemoryRing::~SharedMemoryRing() {
+  munmap(mapping_, mapping_size_);
+  if (owner_) {
+    shm_unlink(name_.c_str());
+  }
+}
+
+size_t SharedMemoryRing::max_record_size() const {
+  // Half the capacity, so that a record always fits after a wrap marker.
+  return header_->capacity / 2 - kRecordHeaderSize;
+}
+
+bool SharedMemoryRing::Write(const common::Duration timeout, const size_t size,
+                             const std::function<void(uint8*)>& fill) {
+  CHECK_LE(size, max_record_size()) << "Record does not fit into '" << name_
+                                    << "'.";
+  const uint64 capacity = header_->capacity;
+  const uint64 record_size = RecordSize(size);
+  uint64 write_position =
+      header_->write_position.load(std::memory_order_relaxed);
+  const uint64 contiguous = capacity - write_position % capacity;
+  const uint64 needed =
+      record_size <= contiguous ? record_size : contiguous + record_size;
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  int num_attempts = 0;
+  while (true) {
+    if (header_->reader_closed.load(std::memory_order_acquire)) {
+      return false;
+    }
+    const uint64 read_position =
+        header_->read_position.load(std::memory_order_acquire);
+    if (capacity - (write_position - read_position) >= needed) {
+      break;
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
+      return false;
+    }
+    Backoff(&num_attempts);
+  }
+  if (record_size > contiguous) {
+    const uint32 wrap_marker = kWrapMarker;
+    std::memcpy(data_ + write_position % capacity, &wrap_marker,
+                sizeof(wrap_marker));
+    write_position += contiguous;
+  }
+  uint8* const record = data_ + write_position % capacity;
+  const uint32 payload_size = size;
+  std::memcpy(record, &payload_size, sizeof(payload_size));
+  fill(record + kRecordHeaderSize);
+  header_->write_position.store(write_position + record_size,
+                                std::memory_order_release);
+  return true;
+}
+
+bool SharedMemoryRing::WriteMessage(
+    const common::Duration timeout,
+    const google::protobuf::MessageLite& message) {
+  return Write(timeout, message.ByteSizeLong(),
+               [&message](uint8* const buffer) {
+                 message.SerializeWithCachedSizesToArray(buffer);
+               });
+}
+
+SharedMemoryRing::ReadStatus SharedMemoryRing::Read(
+    const common::Duration timeout,
+    const std::function<void(const uint8*, size_t)>& consume) {
+  const uint64 capacity = header_->capacity;
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  uint64 read_position = header_->read_position.load(std::memory_order_relaxed);
+  int num_attempts = 0;
+  while (true) {
+    const uint64 write_position =
+        header_->write_position.load(std::memory_order_acquire);
+    if (write_position == read_position) {
+      // The writer closes after its last write, so checking again after
+      // seeing the flag does not miss records.
+      if (header_->writer_closed.load(std::memory_order_acquire) &&
+          header_->write_position.load(std::memory_order_acquire) ==
+              read_position) {
+        return ReadStatus::kClosed;
+      }
+      if (std::chrono::steady_clock::now() >= deadline) {
+        return ReadStatus::kTimeout;
+      }
+      Backoff(&num_attempts);
+      continue;
+    }
+    const uint8* const record = data_ + read_position % capacity;
+    uint32 payload_size;
+    std::memcpy(&payload_size, record, sizeof(payload_size));
+    if (payload_size == kWrapMarker) {
+      read_position += capacity - read_position % capacity;
+      header_->read_position.store(read_position, std::memory_order_release);
+      continue;
+    }
+    // The writer is another process, so a corrupt size must not make the
+    // reader access memory outside of the records it published.
+    if (payload_size > max_record_size() ||
+        RecordSize(payload_size) > write_position - read_position ||
+        RecordSize(payload_size) > capacity - read_position % capacity) {
+      LOG(ERROR) << "Closing '" << name_ << "' on a corrupt record of "
+                 << payload_size << " bytes.";
+      CloseForReading();
+      return ReadStatus::kClosed;
+    }
+    consume(record + kRecordHeaderSize, payload_size);
+    header_->read_position.store(read_position + RecordSize(payload_size),
+                                 std::memory_order_release);
+    return ReadStatus::kRead;
+  }
+}
+
+SharedMemoryRing::ReadStatus SharedMemoryRing::ReadMessage(
+    const common::Duration timeout, google::protobuf::MessageLite* message) {
+  while (true) {
+    bool parsed = false;
+    const ReadStatus status =
+        Read(timeout, [message, &parsed](const uint8* const buffer,
+                                         const size_t size) {
+          parsed = message->ParseFromArray(buffer, size);
+        });
+    if (status != ReadStatus::kRead || parsed) {
+      return status;
+    }
+    LOG(ERROR) << "Skipping unparsable record in '" << name_ << "'.";
+  }
+}
+
+void SharedMemoryRing::CloseForWriting() {
+  header_->writer_closed.store(1, std::memory_order_release);
+}
+
+void SharedMemoryRing::CloseForReading() {
+  header_->reader_closed.store(1, std::memory_order_release);
+}
+
+bool SharedMemoryRing::WaitUntilDrained(const common::Duration timeout) {
+  const uint64 write_position =
+      header_->write_position.load(std::memory_order_relaxed);
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  int num_attempts = 0;
+  while (header_->read_position.load(std::memory_order_acquire) !=
+             write_position &&
+         !header_->reader_closed.load(std::memory_order_acquire)) {
+    if (std::chrono::steady_clock::now() >= deadline) {
+      return false;
+    }
+    Backoff(&num_attempts);
+  }
+  return true;
+}
+
+}  // namespace cloud
+}  // namespace cartographer
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_CLOUD_INTERNAL_SHARED_MEMORY_RING_H
+#define CARTOGRAPHER_CLOUD_INTERNAL_SHARED_MEMORY_RING_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "cartographer/common/port.h"
+#include "cartographer/common/time.h"
+#include "google/protobuf/message_lite.h"
+
+namespace cartographer {
+namespace cloud {
+
+// A ring buffer of variable sized records in a POSIX shared memory segment,
+// used to pass sensor data and local SLAM results between processes on the
+// same host without going through the network stack.
+//
+// There must be exactly one writing and one reading process. Records are
+// written into and parsed from the shared memory in place, and each record is
+// stored contiguously. Both sides wait by polling, so that no cross-process
+// synchronization primitives are needed.
+class SharedMemoryRing {
+ public:
+  enum class ReadStatus { kRead, kTimeout, kClosed };
+
+  // Creates the segment 'name' with room for 'capacity' bytes of records.
+  // 'name' must start with a '/'. The segment is removed again when the
+  // returned ring is destroyed. Returns nullptr on failure, e.g. if the
+  // segment already exists.
+  static std::unique_ptr<SharedMemoryRing> Create(const std::string& name,
+                                                  size_t capacity);
+
+  // Maps the existing segment 'name' created by another process. Returns
+  // nullptr on failure.
+  static std::unique_ptr<SharedMemoryRing> Open(const std::string& name);
+
+  ~SharedMemoryRing();
+
+  SharedMemoryRing(const SharedMemoryRing&) = delete;
+  SharedMemoryRing& operator=(const SharedMemoryRing&) = delete;
+
+  const std::string& name() const { return name_; }
+
+  // Largest record which can be written.
+  size_t max_record_size() const;
+
+  // Writes a record of 'size' bytes which 'fill' stores at the given address,
+  // waiting up to 'timeout' while the ring is full. Returns false without
+  // writing on timeout or if the reader closed the ring.
+  bool Write(common::Duration timeout, size_t size,
+             const std::function<void(uint8*)>& fill);
+
+  // Serializes 'message' directly into the ring, see 'Write()'.
+  bool WriteMessage(common::Duration timeout,
+                    const google::protobuf::MessageLite& message);
+
+  // Passes the next record to 'consume', waiting up to 'timeout' for one to
+  // arrive. The record is only valid during the call. Returns 'kClosed' once
+  // the writer closed the ring and all records were read, or after closing the
+  // ring for reading because a record does not fit into it.
+  ReadStatus Read(common::Duration timeout,
+                  const std::function<void(const uint8*, size_t)>& consume);
+
+  // Parses the next record into 'message', see 'Read()'. A record which does
+  // not parse is logged and skipped.
+  ReadStatus ReadMessage(common::Duration timeout,
+                         google::protobuf::MessageLite* message);
+
+  // Signals the reader that no more records will be written.
+  void CloseForWriting();
+
+  // Signals the writer that no more records will be read.
+  void CloseForReading();
+
+  // Waits up to 'timeout' until the reader has consumed all records or closed
+  // the ring. Returns false on timeout.
+  bool WaitUntilDrained(common::Duration timeout);
+
+ private:
+  struct Header;
+
+  SharedMemoryRing(const std::string& name, bool owner, void* mapping,
+                   size_t mapping_size);
+
+  const std::string name_;
+  const bool owner_;
+  void* const mapping_;
+  const size_t mapping_size_;
+  Header* const header_;
+  uint8* const data_;
+};
+
+}  // namespace cloud
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_CLOUD_INTERNAL_SHARED_MEMORY_RING_H
@@ -0,0 +1,179 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/cloud/internal/shared_memory_ring.h"
+
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace cloud {
+namespace {
+
+std::string UniqueName(const std::string& suffix) {
+  return "/cartographer_shared_memory_ring_test_" + std::to_string(getpid()) +
+         "_" + suffix;
+}
+
+bool WriteString(const std::string& value, SharedMemoryRing* ring) {
+  return ring->Write(common::FromSeconds(1.), value.size(),
+                     [&value](uint8* const buffer) {
+                       std::memcpy(buffer, value.data(), value.size());
+                     });
+}
+
+SharedMemoryRing::ReadStatus ReadString(SharedMemoryRing* ring,
+                                        std::string* value) {
+  return ring->Read(common::FromSeconds(1.),
+                    [value](const uint8* const buffer, const size_t size) {
+                      value->assign(reinterpret_cast<const char*>(buffer),
+                                    size);
+                    });
+}
+
+TEST(SharedMemoryRingTest, OpenFailsForUnknownName) {
+  EXPECT_EQ(SharedMemoryRing::Open(UniqueName("unknown")), nullptr);
+}
+
+TEST(SharedMemoryRingTest, CreateFailsIfNameIsTaken) {
+  const std::string name = UniqueName("taken");
+  auto ring = SharedMemoryRing::Create(name, 1024);
+  ASSERT_NE(ring, nullptr);
+  EXPECT_EQ(SharedMemoryRing::Create(name, 1024), nullptr);
+}
+
+TEST(SharedMemoryRingTest, SegmentIsRemovedWithOwner) {
+  const std::string name = UniqueName("removed");
+  SharedMemoryRing::Create(name, 1024);
+  EXPECT_EQ(SharedMemoryRing::Open(name), nullptr);
+}
+
+TEST(SharedMemoryRingTest, ReadTimesOutOnEmptyRing) {
+  auto ring = SharedMemoryRing::Create(UniqueName("empty"), 1024);
+  ASSERT_NE(ring, nullptr);
+  EXPECT_EQ(ring->Read(common::FromSeconds(0.01),
+                       [](const uint8*, size_t) { FAIL(); }),
+            SharedMemoryRing::ReadStatus::kTimeout);
+}
+
+TEST(SharedMemoryRingTest, RecordsArriveInOrderAcrossMappings) {
+  const std::string name = UniqueName("order");
+  auto writer = SharedMemoryRing::Create(name, 1024);
+  ASSERT_NE(writer, nullptr);
+  auto reader = SharedMemoryRing::Open(name);
+  ASSERT_NE(reader, nullptr);
+  EXPECT_TRUE(WriteString("first", writer.get()));
+  EXPECT_TRUE(WriteString("", writer.get()));
+  EXPECT_TRUE(WriteString("third record", writer.get()));
+  writer->CloseForWriting();
+  std::string value;
+  EXPECT_EQ(ReadString(reader.get(), &value),
+            SharedMemoryRing::ReadStatus::kRead);
+  EXPECT_EQ(value, "first");
+  EXPECT_EQ(ReadString(reader.get(), &value),
+            SharedMemoryRing::ReadStatus::kRead);
+  EXPECT_EQ(value, "");
+  EXPECT_EQ(ReadString(reader.get(), &value),
+            SharedMemoryRing::ReadStatus::kRead);
+  EXPECT_EQ(value, "third record");
+  EXPECT_EQ(ReadString(reader.get(), &value),
+            SharedMemoryRing::ReadStatus::kClosed);
+}
+
+TEST(SharedMemoryRingTest, WrapsAroundWhileWriterWaits) {
+  const std::string name = UniqueName("wrap");
+  auto writer = SharedMemoryRing::Create(name, 256);
+  ASSERT_NE(writer, nullptr);
+  auto reader = SharedMemoryRing::Open(name);
+  ASSERT_NE(reader, nullptr);
+  constexpr int kNumRecords = 1000;
+  std::vector<std::string> written;
+  for (int i = 0; i < kNumRecords; ++i) {
+    written.push_back(
+        std::string(i % writer->max_record_size(), 'a' + i % 26));
+  }
+  std::thread writer_thread([&writer, &written]() {
+    for (const std::string& value : written) {
+      EXPECT_TRUE(WriteString(value, writer.get()));
+    }
+    writer->CloseForWriting();
+    EXPECT_TRUE(writer->WaitUntilDrained(common::FromSeconds(10.)));
+  });
+  std::vector<std::string> read;
+  std::string value;
+  SharedMemoryRing::ReadStatus status;
+  while ((status = ReadString(reader.get(), &value)) ==
+         SharedMemoryRing::ReadStatus::kRead) {
+    read.push_back(value);
+  }
+  writer_thread.join();
+  EXPECT_EQ(status, SharedMemoryRing::ReadStatus::kClosed);
+  EXPECT_EQ(read, written);
+}
+
+TEST(SharedMemoryRingTest, WriteFailsOnceReaderClosed) {
+  const std::string name = UniqueName("reader_closed");
+  auto writer = SharedMemoryRing::Create(name, 256);
+  ASSERT_NE(writer, nullptr);
+  auto reader = SharedMemoryRing::Open(name);
+  ASSERT_NE(reader, nullptr);
+  const std::string value(writer->max_record_size(), 'x');
+  EXPECT_TRUE(WriteString(value, writer.get()));
+  reader->CloseForReading();
+  EXPECT_FALSE(WriteString(value, writer.get()));
+  EXPECT_TRUE(writer->WaitUntilDrained(common::FromSeconds(0.)));
+}
+
+TEST(SharedMemoryRingTest, WriteTimesOutOnFullRing) {
+  auto ring = SharedMemoryRing::Create(UniqueName("full"), 256);
+  ASSERT_NE(ring, nullptr);
+  const std::string value(ring->max_record_size(), 'x');
+  EXPECT_TRUE(WriteString(value, ring.get()));
+  EXPECT_TRUE(WriteString(value, ring.get()));
+  EXPECT_FALSE(ring->Write(common::FromSeconds(0.01), 1,
+                           [](uint8*) { FAIL(); }));
+  EXPECT_FALSE(ring->WaitUntilDrained(common::FromSeconds(0.01)));
+}
+
+TEST(SharedMemoryRingTest, ReadClosesRingOnCorruptRecord) {
+  const std::string name = UniqueName("corrupt");
+  auto writer = SharedMemoryRing::Create(name, 256);
+  ASSERT_NE(writer, nullptr);
+  auto reader = SharedMemoryRing::Open(name);
+  ASSERT_NE(reader, nullptr);
+  // Overwrites the size at the start of the 8 byte record header, as a faulty
+  // writer would.
+  EXPECT_TRUE(writer->Write(common::FromSeconds(1.), 1,
+                            [](uint8* const buffer) {
+                              const uint32 payload_size = 1 << 30;
+                              std::memcpy(buffer - 8, &payload_size,
+                                          sizeof(payload_size));
+                            }));
+  EXPECT_EQ(reader->Read(common::FromSeconds(1.),
+                         [](const uint8*, size_t) { FAIL(); }),
+            SharedMemoryRing::ReadStatus::kClosed);
+  EXPECT_FALSE(WriteString("next", writer.get()));
+}
+
+}  // namespace
+}  // namespace cloud
+}  // namespace cartographer
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/cloud/internal/shared_memory_trajectory_receiver.h"
+
+#include "absl/memory/memory.h"
+#include "cartographer/sensor/fixed_frame_pose_data.h"
+#include "cartographer/sensor/imu_data.h"
+#include "cartographer/sensor/internal/dispatchable.h"
+#include "cartographer/sensor/landmark_data.h"
+#include "cartographer/sensor/odometry_data.h"
+#include "cartographer/sensor/timed_point_cloud_data.h"
+#include "cartographer/transform/transform.h"
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace cloud {
+namespace {
+
+// How often the sensor data thread checks whether it should stop.
+const common::Duration kReadTimeout = common::FromMilliseconds(100);
+// A client which does not take local SLAM results for this long is assumed
+// to be gone, so that it cannot stall local SLAM.
+const common::Duration kWriteTimeout = common::FromSeconds(1.);
+
+std::unique_ptr<sensor::Data> FromProto(const proto::SensorData& sensor_data) {
+  const std::string& sensor_id = sensor_data.sensor_metadata().sensor_id();
+  switch (sensor_data.sensor_data_case()) {
+    case proto::SensorData::kOdometryData:
+      return sensor::MakeDispatchable(
+          sensor_id, sensor::FromProto(sensor_data.odometry_data()));
+    case proto::SensorData::kImuData:
+      return sensor::MakeDispatchable(
+          sensor_id, sensor::FromProto(sensor_data.imu_data()));
+    case proto::SensorData::kTimedPointCloudData:
+      return sensor::MakeDispatchable(
+          sensor_id, sensor::FromProto(sensor_data.timed_point_cloud_data()));
+    case proto::SensorData::kFixedFramePoseData:
+      return sensor::MakeDispatchable(
+          sensor_id, sensor::FromProto(sensor_data.fixed_frame_pose_data()));
+    case proto::SensorData::kLandmarkData:
+      return sensor::MakeDispatchable(
+          sensor_id, sensor::FromProto(sensor_data.landmark_data()));
+    default:
+      return nullptr;
+  }
+}
+
+// Same as the 'ReceiveLocalSlamResultsHandler' responses, so that the range
+// data is not serialized again for every client.
+proto::SerializedReceiveLocalSlamResultsResponse ToProto(
+    const MapBuilderContextInterface::LocalSlamResult& local_slam_result) {
+  proto::SerializedReceiveLocalSlamResultsResponse response;
+  response.set_trajectory_id(local_slam_result.trajectory_id);
+  response.set_timestamp(common::ToUniversal(local_slam_result.time));
+  *response.mutable_local_pose() =
+      transform::ToProto(local_slam_result.local_pose);
+  if (local_slam_result.serialized_range_data) {
+    response.set_range_data(*local_slam_result.serialized_range_data);
+  }
+  if (local_slam_result.insertion_result) {
+    local_slam_result.insertion_result->node_id.ToProto(
+        response.mutable_insertion_result()->mutable_node_id());
+  }
+  return response;
+}
+
+}  // namespace
+
+SharedMemoryTrajectoryReceiver::SharedMemoryTrajectoryReceiver(
+    MapBuilderContextInterface* const context, const int trajectory_id,
+    std::unique_ptr<SharedMemoryRing> sensor_data_ring,
+    std::unique_ptr<SharedMemoryRing> local_slam_results_ring,
+    const bool include_range_data)
+    : context_(context),
+      trajectory_id_(trajectory_id),
+      sensor_data_ring_(std::move(sensor_data_ring)),
+      local_slam_results_ring_(std::move(local_slam_results_ring)) {
+  if (local_slam_results_ring_) {
+    std::shared_ptr<SharedMemoryRing> ring = local_slam_results_ring_;
+    auto callback =
+        [ring](std::unique_ptr<MapBuilderContextInterface::LocalSlamResult>
+                   local_slam_result) {
+          if (!local_slam_result) {
+            // The trajectory finished.
+            ring->CloseForWriting();
+            return true;
+          }
+          if (!ring->WriteMessage(kWriteTimeout, ToProto(*local_slam_result))) {
+            LOG(INFO) << "Client stopped reading '" << ring->name() << "'.";
+            ring->CloseForWriting();
+            return false;
+          }
+          return true;
+        };
+    subscription_id_ =
+        absl::make_unique<MapBuilderContextInterface::LocalSlamSubscriptionId>(
+            context_->SubscribeLocalSlamResults(
+                trajectory_id, include_range_data, callback));
+  }
+  sensor_data_thread_ = std::thread([this]() { ReadSensorData(); });
+}
+
+SharedMemoryTrajectoryReceiver::~SharedMemoryTrajectoryReceiver() {
+  stopping_ = true;
+  sensor_data_thread_.join();
+  sensor_data_ring_->CloseForReading();
+  if (subscription_id_) {
+    context_->UnsubscribeLocalSlamResults(*subscription_id_);
+    local_slam_results_ring_->CloseForWriting();
+  }
+}
+
+void SharedMemoryTrajectoryReceiver::ReadSensorData() {
+  proto::SensorData sensor_data;
+  while (!stopping_) {
+    switch (sensor_data_ring_->ReadMessage(kReadTimeout, &sensor_data)) {
+      case SharedMemoryRing::ReadStatus::kRead:
+        EnqueueSensorData(sensor_data);
+        break;
+      case SharedMemoryRing::ReadStatus::kTimeout:
+        break;
+      case SharedMemoryRing::ReadStatus::kClosed:
+        return;
+    }
+  }
+}
+
+void SharedMemoryTrajectoryReceiver::EnqueueSensorData(
+    const proto::SensorData& sensor_data) {
+  if (sensor_data.sensor_metadata().trajectory_id() != trajectory_id_) {
+    LOG(ERROR) << "Dropping sensor data for trajectory "
+               << sensor_data.sensor_metadata().trajectory_id()
+               << " received through '" << sensor_data_ring_->name() << "'.";
+    return;
+  }
+  std::unique_ptr<sensor::Data> data = FromProto(sensor_data);
+  if (data == nullptr) {
+    LOG(ERROR) << "Unsupported sensor data type: "
+               << sensor_data.sensor_data_case();
+    return;
+  }
+  context_->EnqueueSensorData(trajectory_id_, std::move(data));
+  if (context_->local_trajectory_uploader()) {
+    context_->local_trajectory_uploader()->EnqueueSensorData(
+        absl::make_unique<proto::SensorData>(sensor_data));
+  }
+}
+
+}  // namespace cloud
+}  // namespace cartographer
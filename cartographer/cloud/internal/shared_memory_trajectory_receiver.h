@@ -0,0 +1,69 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_CLOUD_INTERNAL_SHARED_MEMORY_TRAJECTORY_RECEIVER_H
+#define CARTOGRAPHER_CLOUD_INTERNAL_SHARED_MEMORY_TRAJECTORY_RECEIVER_H
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "cartographer/cloud/internal/map_builder_context_interface.h"
+#include "cartographer/cloud/internal/shared_memory_ring.h"
+#include "cartographer/cloud/proto/map_builder_service.pb.h"
+
+namespace cartographer {
+namespace cloud {
+
+// Server side of the shared memory transport of one trajectory: enqueues the
+// 'proto::SensorData' read from 'sensor_data_ring' like the sensor data
+// handlers do, and writes the local SLAM results of the trajectory into
+// 'local_slam_results_ring' until the trajectory is finished.
+class SharedMemoryTrajectoryReceiver {
+ public:
+  // 'local_slam_results_ring' may be nullptr if the client does not want
+  // local SLAM results.
+  SharedMemoryTrajectoryReceiver(
+      MapBuilderContextInterface* context, int trajectory_id,
+      std::unique_ptr<SharedMemoryRing> sensor_data_ring,
+      std::unique_ptr<SharedMemoryRing> local_slam_results_ring,
+      bool include_range_data);
+  ~SharedMemoryTrajectoryReceiver();
+
+  SharedMemoryTrajectoryReceiver(const SharedMemoryTrajectoryReceiver&) =
+      delete;
+  SharedMemoryTrajectoryReceiver& operator=(
+      const SharedMemoryTrajectoryReceiver&) = delete;
+
+ private:
+  void ReadSensorData();
+  void EnqueueSensorData(const proto::SensorData& sensor_data);
+
+  MapBuilderContextInterface* const context_;
+  const int trajectory_id_;
+  const std::unique_ptr<SharedMemoryRing> sensor_data_ring_;
+  // Shared with the local SLAM subscription callback.
+  const std::shared_ptr<SharedMemoryRing> local_slam_results_ring_;
+  std::unique_ptr<MapBuilderContextInterface::LocalSlamSubscriptionId>
+      subscription_id_;
+  std::atomic<bool> stopping_{false};
+  std::thread sensor_data_thread_;
+};
+
+}  // namespace cloud
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_CLOUD_INTERNAL_SHARED_MEMORY_TRAJECTORY_RECEIVER_H
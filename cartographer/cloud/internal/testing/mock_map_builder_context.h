@@ -38,9 +38,9 @@ class MockMapBuilderContext : public MapBuilderContextInterface {
                mapping::TrajectoryBuilderInterface::LocalSlamResultCallback());
   MOCK_METHOD1(AddSensorDataToTrajectory,
                void(const MapBuilderContextInterface::Data &));
-  MOCK_METHOD2(SubscribeLocalSlamResults,
+  MOCK_METHOD3(SubscribeLocalSlamResults,
                MapBuilderContextInterface::LocalSlamSubscriptionId(
-                   int,
+                   int, bool,
                    MapBuilderContextInterface::LocalSlamSubscriptionCallback));
   MOCK_METHOD1(
       UnsubscribeLocalSlamResults,
@@ -61,6 +61,9 @@ class MockMapBuilderContext : public MapBuilderContextInterface {
                     const mapping::proto::LocalSlamResultData &));
   MOCK_METHOD2(RegisterClientIdForTrajectory, void(const std::string &, int));
   MOCK_METHOD2(CheckClientIdForTrajectory, bool(const std::string &, int));
+  MOCK_METHOD4(AttachSharedMemory,
+               ::grpc::Status(int, const std::string &, const std::string &,
+                              bool));
 };
 
 }  // namespace testing
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include "cartographer/cloud/client/shard_state_import.h"
 #include "cartographer/cloud/map_builder_server_interface.h"
 #include "cartographer/cloud/map_builder_server_options.h"
 #include "cartographer/mapping/map_builder.h"
@@ -32,12 +33,16 @@ DEFINE_string(configuration_directory, "",
 DEFINE_string(configuration_basename, "",
               "Basename, i.e. not containing any directory prefix, of the "
               "configuration file.");
+DEFINE_string(options_cache_directory, "",
+              "If non-empty, existing directory in which the options computed "
+              "from the configuration are cached for later launches.");
 
 namespace cartographer {
 namespace cloud {
 
 void Run(const std::string& configuration_directory,
-         const std::string& configuration_basename) {
+         const std::string& configuration_basename,
+         const std::string& options_cache_directory) {
 #if USE_PROMETHEUS
   metrics::prometheus::FamilyFactory registry;
   ::cartographer::metrics::RegisterAllMetrics(&registry);
@@ -49,9 +54,15 @@ void Run(const std::string& configuration_directory,
 
   proto::MapBuilderServerOptions map_builder_server_options =
       LoadMapBuilderServerOptions(configuration_directory,
-                                  configuration_basename);
+                                  configuration_basename,
+                                  options_cache_directory);
   auto map_builder = mapping::CreateMapBuilder(
       map_builder_server_options.map_builder_options());
+  for (const std::string& shard_server_address :
+       map_builder_server_options.import_frozen_state_from_shards()) {
+    ImportFrozenStateFromShard(shard_server_address, "map_builder_server",
+                               map_builder.get());
+  }
   std::unique_ptr<MapBuilderServerInterface> map_builder_server =
       CreateMapBuilderServer(map_builder_server_options,
                              std::move(map_builder));
@@ -75,5 +86,6 @@ int main(int argc, char** argv) {
     return EXIT_FAILURE;
   }
   cartographer::cloud::Run(FLAGS_configuration_directory,
-                           FLAGS_configuration_basename);
+                           FLAGS_configuration_basename,
+                           FLAGS_options_cache_directory);
 }
@@ -18,6 +18,7 @@
 
 #include "absl/memory/memory.h"
 #include "cartographer/common/configuration_file_resolver.h"
+#include "cartographer/common/options_cache.h"
 #include "cartographer/mapping/map_builder_interface.h"
 
 namespace cartographer {
@@ -39,6 +40,25 @@ proto::MapBuilderServerOptions CreateMapBuilderServerOptions(
       lua_parameter_dictionary->GetString("uplink_server_address"));
   map_builder_server_options.set_upload_batch_size(
       lua_parameter_dictionary->GetInt("upload_batch_size"));
+  map_builder_server_options.set_upload_max_batch_bytes(
+      lua_parameter_dictionary->GetInt("upload_max_batch_bytes"));
+  map_builder_server_options.set_upload_max_batch_delay_seconds(
+      lua_parameter_dictionary->GetDouble("upload_max_batch_delay_seconds"));
+  map_builder_server_options.set_num_upload_rpcs_in_flight(
+      lua_parameter_dictionary->GetInt("num_upload_rpcs_in_flight"));
+  map_builder_server_options.set_enable_upload_compression(
+      lua_parameter_dictionary->GetBool("enable_upload_compression"));
+  for (const std::string& shard_server_address :
+       lua_parameter_dictionary
+           ->GetDictionary("import_frozen_state_from_shards")
+           ->GetArrayValuesAsStrings()) {
+    map_builder_server_options.add_import_frozen_state_from_shards(
+        shard_server_address);
+  }
+  map_builder_server_options.set_num_sensor_data_threads(
+      lua_parameter_dictionary->GetNonNegativeInt("num_sensor_data_threads"));
+  map_builder_server_options.set_enable_shared_memory_transport(
+      lua_parameter_dictionary->GetBool("enable_shared_memory_transport"));
   map_builder_server_options.set_enable_ssl_encryption(
       lua_parameter_dictionary->GetBool("enable_ssl_encryption"));
   map_builder_server_options.set_enable_google_auth(
@@ -58,5 +78,27 @@ proto::MapBuilderServerOptions LoadMapBuilderServerOptions(
   return CreateMapBuilderServerOptions(&lua_parameter_dictionary);
 }
 
+proto::MapBuilderServerOptions LoadMapBuilderServerOptions(
+    const std::string& configuration_directory,
+    const std::string& configuration_basename,
+    const std::string& options_cache_directory) {
+  if (options_cache_directory.empty()) {
+    return LoadMapBuilderServerOptions(configuration_directory,
+                                       configuration_basename);
+  }
+  proto::MapBuilderServerOptions map_builder_server_options;
+  common::OptionsCache(options_cache_directory)
+      .Load(configuration_basename,
+            absl::make_unique<common::ConfigurationFileResolver>(
+                std::vector<std::string>{configuration_directory}),
+            [&map_builder_server_options](
+                common::LuaParameterDictionary* lua_parameter_dictionary) {
+              map_builder_server_options =
+                  CreateMapBuilderServerOptions(lua_parameter_dictionary);
+            },
+            {&map_builder_server_options});
+  return map_builder_server_options;
+}
+
 }  // namespace cloud
 }  // namespace cartographer
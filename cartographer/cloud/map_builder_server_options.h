@@ -32,6 +32,13 @@ proto::MapBuilderServerOptions LoadMapBuilderServerOptions(
     const std::string& configuration_directory,
     const std::string& configuration_basename);
 
+// Like above, but reuses the options stored in 'options_cache_directory' by
+// an earlier launch if the configuration did not change since.
+proto::MapBuilderServerOptions LoadMapBuilderServerOptions(
+    const std::string& configuration_directory,
+    const std::string& configuration_basename,
+    const std::string& options_cache_directory);
+
 }  // namespace cloud
 }  // namespace cartographer
 
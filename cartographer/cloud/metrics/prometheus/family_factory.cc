@@ -16,12 +16,23 @@
 
 #include "cartographer/cloud/metrics/prometheus/family_factory.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <vector>
+
 #include "absl/container/flat_hash_map.h"
 #include "absl/memory/memory.h"
-#include "prometheus/counter.h"
+#include "prometheus/client_metric.h"
+#include "prometheus/collectable.h"
 #include "prometheus/family.h"
 #include "prometheus/gauge.h"
-#include "prometheus/histogram.h"
+#include "prometheus/metric_family.h"
+#include "prometheus/metric_type.h"
 
 namespace cartographer {
 namespace cloud {
@@ -31,6 +42,9 @@ namespace {
 
 using BucketBoundaries = ::cartographer::metrics::Histogram::BucketBoundaries;
 
+constexpr int kNumShards = 16;
+constexpr size_t kCacheLineSize = 64;
+
 // Creates or looks up already existing objects from a wrapper map.
 template <typename WrapperMap,
           typename ObjectPtr = typename WrapperMap::key_type,
@@ -48,34 +62,89 @@ Wrapper* GetOrCreateWrapper(ObjectPtr object_ptr, WrapperMap* wrapper_map,
   return wrappers_itr->second.get();
 }
 
+// Index of the shard the calling thread updates. Threads are spread over the
+// shards in the order they first update a metric.
+int GetShardIndex() {
+  static std::atomic<int> next_shard_index{0};
+  thread_local const int shard_index =
+      next_shard_index.fetch_add(1) % kNumShards;
+  return shard_index;
+}
+
+void AddToAtomic(const double value, std::atomic<double>* const sum) {
+  double old_sum = sum->load(std::memory_order_relaxed);
+  while (!sum->compare_exchange_weak(old_sum, old_sum + value,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+std::vector<::prometheus::ClientMetric::Label> ToLabels(
+    const std::map<std::string, std::string>& labels) {
+  std::vector<::prometheus::ClientMetric::Label> result;
+  for (const auto& label : labels) {
+    result.push_back({label.first, label.second});
+  }
+  return result;
+}
+
+// Keeps one value per shard, so that threads rarely update the same cache
+// line and never take a lock. The shards are summed up when collected.
 class Counter : public ::cartographer::metrics::Counter {
  public:
-  explicit Counter(::prometheus::Counter* prometheus)
-      : prometheus_(prometheus) {}
+  void Increment() override { Increment(1.); }
+  void Increment(double by_value) override {
+    AddToAtomic(by_value, &shards_[GetShardIndex()].value);
+  }
 
-  void Increment() override { prometheus_->Increment(); }
-  void Increment(double by_value) override { prometheus_->Increment(by_value); }
+  double Collect() const {
+    double value = 0.;
+    for (const Shard& shard : shards_) {
+      value += shard.value.load(std::memory_order_relaxed);
+    }
+    return value;
+  }
 
  private:
-  ::prometheus::Counter* prometheus_;
+  struct alignas(kCacheLineSize) Shard {
+    std::atomic<double> value{0.};
+  };
+
+  std::array<Shard, kNumShards> shards_;
 };
 
 class CounterFamily
     : public ::cartographer::metrics::Family<::cartographer::metrics::Counter> {
  public:
-  explicit CounterFamily(
-      ::prometheus::Family<::prometheus::Counter>* prometheus)
-      : prometheus_(prometheus) {}
+  CounterFamily(const std::string& name, const std::string& description)
+      : name_(name), description_(description) {}
 
   Counter* Add(const std::map<std::string, std::string>& labels) override {
-    ::prometheus::Counter* counter = &prometheus_->Add(labels);
-    return GetOrCreateWrapper<>(counter, &wrappers_, &wrappers_mutex_);
+    std::lock_guard<std::mutex> lock(wrappers_mutex_);
+    auto& wrapper = wrappers_[labels];
+    if (wrapper == nullptr) {
+      wrapper = absl::make_unique<Counter>();
+    }
+    return wrapper.get();
+  }
+
+  ::prometheus::MetricFamily Collect() {
+    ::prometheus::MetricFamily family{name_, description_,
+                                      ::prometheus::MetricType::Counter, {}};
+    std::lock_guard<std::mutex> lock(wrappers_mutex_);
+    for (const auto& entry : wrappers_) {
+      ::prometheus::ClientMetric metric;
+      metric.label = ToLabels(entry.first);
+      metric.counter.value = entry.second->Collect();
+      family.metric.push_back(std::move(metric));
+    }
+    return family;
   }
 
  private:
-  ::prometheus::Family<::prometheus::Counter>* prometheus_;
+  const std::string name_;
+  const std::string description_;
   std::mutex wrappers_mutex_;
-  absl::flat_hash_map<::prometheus::Counter*, std::unique_ptr<Counter>>
+  std::map<std::map<std::string, std::string>, std::unique_ptr<Counter>>
       wrappers_;
 };
 
@@ -110,51 +179,148 @@ class GaugeFamily
   absl::flat_hash_map<::prometheus::Gauge*, std::unique_ptr<Gauge>> wrappers_;
 };
 
+// Like 'Counter', keeps the bucket counts and the sum per shard.
 class Histogram : public ::cartographer::metrics::Histogram {
  public:
-  explicit Histogram(::prometheus::Histogram* prometheus)
-      : prometheus_(prometheus) {}
+  explicit Histogram(const BucketBoundaries& boundaries)
+      : boundaries_(boundaries) {
+    for (Shard& shard : shards_) {
+      // The last bucket is for values above all boundaries.
+      shard.bucket_counts =
+          std::vector<std::atomic<uint64_t>>(boundaries_.size() + 1);
+    }
+  }
 
-  void Observe(double value) override { prometheus_->Observe(value); }
+  void Observe(double value) override {
+    // Bucket 'i' counts the values up to 'boundaries_[i]', like Prometheus.
+    const size_t bucket_index =
+        std::lower_bound(boundaries_.begin(), boundaries_.end(), value) -
+        boundaries_.begin();
+    Shard& shard = shards_[GetShardIndex()];
+    shard.bucket_counts[bucket_index].fetch_add(1, std::memory_order_relaxed);
+    AddToAtomic(value, &shard.sum);
+  }
+
+  ::prometheus::ClientMetric::Histogram Collect() const {
+    ::prometheus::ClientMetric::Histogram histogram;
+    histogram.sample_count = 0;
+    histogram.sample_sum = 0.;
+    for (size_t i = 0; i != boundaries_.size() + 1; ++i) {
+      for (const Shard& shard : shards_) {
+        histogram.sample_count +=
+            shard.bucket_counts[i].load(std::memory_order_relaxed);
+      }
+      ::prometheus::ClientMetric::Bucket bucket;
+      bucket.cumulative_count = histogram.sample_count;
+      bucket.upper_bound = i < boundaries_.size()
+                               ? boundaries_[i]
+                               : std::numeric_limits<double>::infinity();
+      histogram.bucket.push_back(bucket);
+    }
+    for (const Shard& shard : shards_) {
+      histogram.sample_sum += shard.sum.load(std::memory_order_relaxed);
+    }
+    return histogram;
+  }
 
  private:
-  ::prometheus::Histogram* prometheus_;
+  struct alignas(kCacheLineSize) Shard {
+    std::atomic<double> sum{0.};
+    std::vector<std::atomic<uint64_t>> bucket_counts;
+  };
+
+  const BucketBoundaries boundaries_;
+  std::array<Shard, kNumShards> shards_;
 };
 
 class HistogramFamily : public ::cartographer::metrics::Family<
                             ::cartographer::metrics::Histogram> {
  public:
-  HistogramFamily(::prometheus::Family<::prometheus::Histogram>* prometheus,
+  HistogramFamily(const std::string& name, const std::string& description,
                   const BucketBoundaries& boundaries)
-      : prometheus_(prometheus), boundaries_(boundaries) {}
+      : name_(name), description_(description), boundaries_(boundaries) {}
 
   Histogram* Add(const std::map<std::string, std::string>& labels) override {
-    ::prometheus::Histogram* histogram = &prometheus_->Add(labels, boundaries_);
-    return GetOrCreateWrapper<>(histogram, &wrappers_, &wrappers_mutex_);
+    std::lock_guard<std::mutex> lock(wrappers_mutex_);
+    auto& wrapper = wrappers_[labels];
+    if (wrapper == nullptr) {
+      wrapper = absl::make_unique<Histogram>(boundaries_);
+    }
+    return wrapper.get();
+  }
+
+  ::prometheus::MetricFamily Collect() {
+    ::prometheus::MetricFamily family{name_, description_,
+                                      ::prometheus::MetricType::Histogram, {}};
+    std::lock_guard<std::mutex> lock(wrappers_mutex_);
+    for (const auto& entry : wrappers_) {
+      ::prometheus::ClientMetric metric;
+      metric.label = ToLabels(entry.first);
+      metric.histogram = entry.second->Collect();
+      family.metric.push_back(std::move(metric));
+    }
+    return family;
   }
 
  private:
-  ::prometheus::Family<::prometheus::Histogram>* prometheus_;
+  const std::string name_;
+  const std::string description_;
+  const BucketBoundaries boundaries_;
   std::mutex wrappers_mutex_;
-  absl::flat_hash_map<::prometheus::Histogram*, std::unique_ptr<Histogram>>
+  std::map<std::map<std::string, std::string>, std::unique_ptr<Histogram>>
       wrappers_;
-  const BucketBoundaries boundaries_;
 };
 
 }  // namespace
 
+// Collects the gauges from the Prometheus registry, and the counters and
+// histograms by summing up their shards.
+class FamilyFactory::Collector : public ::prometheus::Collectable {
+ public:
+  explicit Collector(std::shared_ptr<::prometheus::Registry> registry)
+      : registry_(std::move(registry)) {}
+
+  void AddCounterFamily(CounterFamily* family) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    counter_families_.push_back(family);
+  }
+
+  void AddHistogramFamily(HistogramFamily* family) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    histogram_families_.push_back(family);
+  }
+
+  std::vector<::prometheus::MetricFamily> Collect() override {
+    std::vector<::prometheus::MetricFamily> collected = registry_->Collect();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (CounterFamily* family : counter_families_) {
+      collected.push_back(family->Collect());
+    }
+    for (HistogramFamily* family : histogram_families_) {
+      collected.push_back(family->Collect());
+    }
+    return collected;
+  }
+
+ private:
+  const std::shared_ptr<::prometheus::Registry> registry_;
+  std::mutex mutex_;
+  std::vector<CounterFamily*> counter_families_;
+  std::vector<HistogramFamily*> histogram_families_;
+};
+
 FamilyFactory::FamilyFactory()
-    : registry_(std::make_shared<::prometheus::Registry>()) {}
+    : registry_(std::make_shared<::prometheus::Registry>()),
+      collector_(std::make_shared<Collector>(registry_)) {}
+
+FamilyFactory::~FamilyFactory() = default;
 
 ::cartographer::metrics::Family<::cartographer::metrics::Counter>*
 FamilyFactory::NewCounterFamily(const std::string& name,
                                 const std::string& description) {
-  auto& family = ::prometheus::BuildCounter()
-                     .Name(name)
-                     .Help(description)
-                     .Register(*registry_);
-  auto wrapper = absl::make_unique<CounterFamily>(&family);
+  auto wrapper = absl::make_unique<CounterFamily>(name, description);
   auto* ptr = wrapper.get();
+  collector_->AddCounterFamily(ptr);
   counters_.emplace_back(std::move(wrapper));
   return ptr;
 }
@@ -176,18 +342,16 @@ FamilyFactory::NewGaugeFamily(const std::string& name,
 FamilyFactory::NewHistogramFamily(const std::string& name,
                                   const std::string& description,
                                   const BucketBoundaries& boundaries) {
-  auto& family = ::prometheus::BuildHistogram()
-                     .Name(name)
-                     .Help(description)
-                     .Register(*registry_);
-  auto wrapper = absl::make_unique<HistogramFamily>(&family, boundaries);
+  auto wrapper =
+      absl::make_unique<HistogramFamily>(name, description, boundaries);
   auto* ptr = wrapper.get();
+  collector_->AddHistogramFamily(ptr);
   histograms_.emplace_back(std::move(wrapper));
   return ptr;
 }
 
 std::weak_ptr<::prometheus::Collectable> FamilyFactory::GetCollectable() const {
-  return registry_;
+  return collector_;
 }
 
 }  // namespace prometheus
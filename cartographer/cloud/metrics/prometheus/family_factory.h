@@ -28,9 +28,14 @@ namespace cloud {
 namespace metrics {
 namespace prometheus {
 
+// Counters and histograms are kept in shards updated by different threads,
+// which are summed up when collected, so that updating them takes no lock.
+// Gauges are kept in the Prometheus registry, since they are set rather than
+// accumulated.
 class FamilyFactory : public ::cartographer::metrics::FamilyFactory {
  public:
   FamilyFactory();
+  ~FamilyFactory() override;
 
   ::cartographer::metrics::Family<::cartographer::metrics::Counter>*
   NewCounterFamily(const std::string& name,
@@ -46,6 +51,8 @@ class FamilyFactory : public ::cartographer::metrics::FamilyFactory {
   std::weak_ptr<::prometheus::Collectable> GetCollectable() const;
 
  private:
+  class Collector;
+
   std::vector<std::unique_ptr<
       ::cartographer::metrics::Family<::cartographer::metrics::Counter>>>
       counters_;
@@ -56,6 +63,7 @@ class FamilyFactory : public ::cartographer::metrics::FamilyFactory {
       ::cartographer::metrics::Family<::cartographer::metrics::Histogram>>>
       histograms_;
   std::shared_ptr<::prometheus::Registry> registry_;
+  std::shared_ptr<Collector> collector_;
 };
 
 }  // namespace prometheus
@@ -15,6 +15,10 @@
  */
 
 #include "cartographer/cloud/metrics/prometheus/family_factory.h"
+
+#include <thread>
+#include <vector>
+
 #include "cartographer/metrics/family_factory.h"
 #include "cartographer/metrics/register.h"
 #include "glog/logging.h"
@@ -130,6 +134,53 @@ TEST(MetricsTest, CollectHistogram) {
             1);
 }
 
+TEST(MetricsTest, CollectFromManyThreads) {
+  FamilyFactory factory;
+  auto* counter = factory.NewCounterFamily("/test/hits", "Hits")->Add({});
+  auto* histogram =
+      factory
+          .NewHistogramFamily(
+              "/test/scores", "Scores",
+              ::cartographer::metrics::Histogram::FixedWidth(1., 2))
+          ->Add({});
+  constexpr int kNumThreads = 8;
+  constexpr int kNumUpdatesPerThread = 10000;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([counter, histogram]() {
+      for (int j = 0; j < kNumUpdatesPerThread; ++j) {
+        counter->Increment();
+        histogram->Observe(j % 4);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  std::vector<::prometheus::MetricFamily> collected;
+  {
+    std::shared_ptr<::prometheus::Collectable> collectable;
+    CHECK(collectable = factory.GetCollectable().lock());
+    collected = collectable->Collect();
+  }
+  ASSERT_EQ(collected.size(), 2);
+  EXPECT_THAT(collected[0].metric.at(0).counter.value,
+              testing::DoubleEq(kNumThreads * kNumUpdatesPerThread));
+  const auto& collected_histogram = collected[1].metric.at(0).histogram;
+  EXPECT_EQ(collected_histogram.sample_count,
+            kNumThreads * kNumUpdatesPerThread);
+  EXPECT_THAT(collected_histogram.sample_sum,
+              testing::DoubleEq(kNumThreads * kNumUpdatesPerThread * 1.5));
+  // Buckets up to 1, up to 2 and above 2.
+  ASSERT_EQ(collected_histogram.bucket.size(), 3);
+  EXPECT_EQ(collected_histogram.bucket.at(0).cumulative_count,
+            kNumThreads * kNumUpdatesPerThread / 2);
+  EXPECT_EQ(collected_histogram.bucket.at(1).cumulative_count,
+            kNumThreads * kNumUpdatesPerThread * 3 / 4);
+  EXPECT_EQ(collected_histogram.bucket.at(2).cumulative_count,
+            kNumThreads * kNumUpdatesPerThread);
+}
+
 TEST(MetricsTest, RunExposerServer) {
   FamilyFactory registry;
   Algorithm::RegisterMetrics(&registry);
@@ -27,6 +27,26 @@ proto::CeresSolverOptions CreateCeresSolverOptionsProto(
   proto.set_max_num_iterations(
       parameter_dictionary->GetNonNegativeInt("max_num_iterations"));
   proto.set_num_threads(parameter_dictionary->GetNonNegativeInt("num_threads"));
+  // An empty string selects the Ceres default.
+  proto.set_linear_solver_type(
+      parameter_dictionary->GetString("linear_solver_type"));
+  ceres::LinearSolverType linear_solver_type;
+  if (!proto.linear_solver_type().empty() &&
+      !ceres::StringToLinearSolverType(proto.linear_solver_type(),
+                                       &linear_solver_type)) {
+    LOG(FATAL) << "Unknown linear_solver_type: "
+               << proto.linear_solver_type();
+  }
+  proto.set_sparse_linear_algebra_library_type(
+      parameter_dictionary->GetString("sparse_linear_algebra_library_type"));
+  ceres::SparseLinearAlgebraLibraryType sparse_linear_algebra_library_type;
+  if (!proto.sparse_linear_algebra_library_type().empty() &&
+      !ceres::StringToSparseLinearAlgebraLibraryType(
+          proto.sparse_linear_algebra_library_type(),
+          &sparse_linear_algebra_library_type)) {
+    LOG(FATAL) << "Unknown sparse_linear_algebra_library_type: "
+               << proto.sparse_linear_algebra_library_type();
+  }
   CHECK_GT(proto.max_num_iterations(), 0);
   CHECK_GT(proto.num_threads(), 0);
   return proto;
@@ -38,6 +58,18 @@ ceres::Solver::Options CreateCeresSolverOptions(
   options.use_nonmonotonic_steps = proto.use_nonmonotonic_steps();
   options.max_num_iterations = proto.max_num_iterations();
   options.num_threads = proto.num_threads();
+  if (!proto.linear_solver_type().empty()) {
+    CHECK(ceres::StringToLinearSolverType(proto.linear_solver_type(),
+                                          &options.linear_solver_type))
+        << "Unknown linear solver type: " << proto.linear_solver_type();
+  }
+  if (!proto.sparse_linear_algebra_library_type().empty()) {
+    CHECK(ceres::StringToSparseLinearAlgebraLibraryType(
+        proto.sparse_linear_algebra_library_type(),
+        &options.sparse_linear_algebra_library_type))
+        << "Unknown sparse linear algebra library type: "
+        << proto.sparse_linear_algebra_library_type();
+  }
   return options;
 }
 
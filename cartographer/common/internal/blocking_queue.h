@@ -21,10 +21,10 @@ BlockingQueue类是线程安全的阻塞队列,(生产者消费者模式)
 #define CARTOGRAPHER_COMMON_BLOCKING_QUEUE_H_
 
 #include <cstddef>
-#include <deque>
 #include <memory>
 
 #include "absl/synchronization/mutex.h"
+#include "cartographer/common/internal/ring_buffer.h"
 #include "cartographer/common/port.h"
 #include "cartographer/common/time.h"
 #include "glog/logging.h"
@@ -57,7 +57,7 @@ class BlockingQueue {
     };
     absl::MutexLock lock(&mutex_);
     mutex_.Await(absl::Condition(&predicate));
-    deque_.push_back(std::move(t));
+    buffer_.push_back(std::move(t));
   }
 
   // Like push, but returns false if 'timeout' is reached.
@@ -71,7 +71,7 @@ class BlockingQueue {
                                  absl::FromChrono(timeout))) {
       return false;
     }
-    deque_.push_back(std::move(t));
+    buffer_.push_back(std::move(t));
     return true;
   }
 
@@ -84,8 +84,8 @@ class BlockingQueue {
     absl::MutexLock lock(&mutex_);
     mutex_.Await(absl::Condition(&predicate));
 
-    T t = std::move(deque_.front());
-    deque_.pop_front();
+    T t = std::move(buffer_.front());
+    buffer_.pop_front();
     return t;
   }
 
@@ -100,8 +100,8 @@ class BlockingQueue {
                                  absl::FromChrono(timeout))) {
       return nullptr;
     }
-    T t = std::move(deque_.front());
-    deque_.pop_front();
+    T t = std::move(buffer_.front());
+    buffer_.pop_front();
     return t;
   }
 
@@ -117,7 +117,7 @@ class BlockingQueue {
                                  absl::FromChrono(timeout))) {
       return nullptr;
     }
-    return deque_.front().get();
+    return buffer_.front().get();
   }
 
   // Returns the next value in the queue or nullptr if the queue is empty.
@@ -127,16 +127,16 @@ class BlockingQueue {
   template <typename R>
   const R* Peek() {
     absl::MutexLock lock(&mutex_);
-    if (deque_.empty()) {
+    if (buffer_.empty()) {
       return nullptr;
     }
-    return deque_.front().get();
+    return buffer_.front().get();
   }
 
   // Returns the number of items currently in the queue.
   size_t Size() {
     absl::MutexLock lock(&mutex_);
-    return deque_.size();
+    return buffer_.size();
   }
 
   // Blocks until the queue is empty.
@@ -151,17 +151,18 @@ class BlockingQueue {
  private:
   // Returns true iff the queue is empty.
   bool QueueEmptyCondition() EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
-    return deque_.empty();
+    return buffer_.empty();
   }
 
   // Returns true iff the queue is not full.
   bool QueueNotFullCondition() EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
-    return queue_size_ == kInfiniteQueueSize || deque_.size() < queue_size_;
+    return queue_size_ == kInfiniteQueueSize || buffer_.size() < queue_size_;
   }
 
   absl::Mutex mutex_;
   const size_t queue_size_ GUARDED_BY(mutex_);
-  std::deque<T> deque_ GUARDED_BY(mutex_);
+  // Does not allocate once it held the most values it is used with.
+  RingBuffer<T> buffer_ GUARDED_BY(mutex_);
 };
 
 }  // namespace common
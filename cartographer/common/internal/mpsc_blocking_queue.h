@@ -0,0 +1,243 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_COMMON_INTERNAL_MPSC_BLOCKING_QUEUE_H_
+#define CARTOGRAPHER_COMMON_INTERNAL_MPSC_BLOCKING_QUEUE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "cartographer/common/time.h"
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace common {
+
+// A bounded queue with the interface of 'BlockingQueue' for many producers and
+// a single consumer. Only one thread at a time may call Pop(), Peek() and
+// their variants.
+//
+// The values are kept in a ring buffer of 'capacity' cells, each with a
+// sequence number that tells producers and the consumer whose turn it is.
+// Producers claim cells with a compare-and-swap, so pushing and popping take
+// no lock while the queue is neither empty nor full. A producer waiting for a
+// free cell or the consumer waiting for a value first spins, and then waits
+// on a mutex which is only taken by the other side while someone waits.
+//
+// 'T' must be default constructible and movable. The capacity must be at
+// least 2.
+template <typename T>
+class MpscBlockingQueue {
+ public:
+  explicit MpscBlockingQueue(const size_t capacity)
+      : capacity_(capacity), cells_(new Cell[capacity]) {
+    // With a single cell, a full cell would look free for the next position.
+    CHECK_GE(capacity, 2);
+    for (size_t i = 0; i != capacity; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpscBlockingQueue(const MpscBlockingQueue&) = delete;
+  MpscBlockingQueue& operator=(const MpscBlockingQueue&) = delete;
+
+  // Pushes a value onto the queue. Blocks if the queue is full.
+  void Push(T t) {
+    Wait([this, &t]() { return TryPush(&t); }, [this]() { return CanPush(); },
+         absl::InfiniteFuture());
+  }
+
+  // Like push, but returns false if 'timeout' is reached.
+  bool PushWithTimeout(T t, const common::Duration timeout) {
+    return Wait([this, &t]() { return TryPush(&t); },
+                [this]() { return CanPush(); },
+                absl::Now() + absl::FromChrono(timeout));
+  }
+
+  // Pops the next value from the queue. Blocks until a value is available.
+  T Pop() {
+    T t;
+    Wait([this, &t]() { return TryPop(&t); }, [this]() { return CanPop(); },
+         absl::InfiniteFuture());
+    return t;
+  }
+
+  // Like Pop, but can timeout. Returns nullptr in this case.
+  T PopWithTimeout(const common::Duration timeout) {
+    T t;
+    if (!Wait([this, &t]() { return TryPop(&t); },
+              [this]() { return CanPop(); },
+              absl::Now() + absl::FromChrono(timeout))) {
+      return nullptr;
+    }
+    return t;
+  }
+
+  // Like Peek, but can timeout. Returns nullptr in this case.
+  template <typename R>
+  R* PeekWithTimeout(const common::Duration timeout) {
+    if (!Wait([this]() { return CanPop(); }, [this]() { return CanPop(); },
+              absl::Now() + absl::FromChrono(timeout))) {
+      return nullptr;
+    }
+    return FrontCell().value.get();
+  }
+
+  // Returns the next value in the queue or nullptr if the queue is empty.
+  // Maintains ownership. This assumes a member function get() that returns
+  // a pointer to the given type R.
+  template <typename R>
+  const R* Peek() {
+    if (!CanPop()) {
+      return nullptr;
+    }
+    return FrontCell().value.get();
+  }
+
+  // Returns the number of items currently in the queue.
+  size_t Size() { return std::max<int64_t>(size_.load(), 0); }
+
+  // Blocks until the queue is empty.
+  void WaitUntilEmpty() {
+    const auto is_empty = [this]() { return size_.load() <= 0; };
+    Wait(is_empty, is_empty, absl::InfiniteFuture());
+  }
+
+ private:
+  static constexpr int kNumSpins = 64;
+
+  struct Cell {
+    // Equal to the position of the cell if it is free for this position and
+    // one more if it holds the value of this position.
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  Cell& GetCell(const size_t position) {
+    return cells_[position % capacity_];
+  }
+
+  Cell& FrontCell() {
+    return GetCell(dequeue_position_.load(std::memory_order_relaxed));
+  }
+
+  bool CanPush() {
+    const size_t position = enqueue_position_.load(std::memory_order_relaxed);
+    return GetCell(position).sequence.load() == position;
+  }
+
+  bool CanPop() {
+    const size_t position = dequeue_position_.load(std::memory_order_relaxed);
+    return GetCell(position).sequence.load() == position + 1;
+  }
+
+  // Moves '*t' into the queue unless it is full.
+  bool TryPush(T* const t) {
+    size_t position = enqueue_position_.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& cell = GetCell(position);
+      const intptr_t difference = static_cast<intptr_t>(cell.sequence.load()) -
+                                  static_cast<intptr_t>(position);
+      if (difference < 0) {
+        return false;
+      }
+      if (difference == 0 && enqueue_position_.compare_exchange_weak(
+                                 position, position + 1,
+                                 std::memory_order_relaxed)) {
+        cell.value = std::move(*t);
+        cell.sequence.store(position + 1);
+        ++size_;
+        NotifyWaiters();
+        return true;
+      }
+      if (difference > 0) {
+        position = enqueue_position_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Moves the front value into '*t' unless the queue is empty.
+  bool TryPop(T* const t) {
+    const size_t position = dequeue_position_.load(std::memory_order_relaxed);
+    Cell& cell = GetCell(position);
+    if (cell.sequence.load() != position + 1) {
+      return false;
+    }
+    *t = std::move(cell.value);
+    cell.value = T();
+    dequeue_position_.store(position + 1, std::memory_order_relaxed);
+    cell.sequence.store(position + capacity_);
+    --size_;
+    NotifyWaiters();
+    return true;
+  }
+
+  // Calls 'try_operation' until it succeeds. Spins first, then waits for
+  // 'may_succeed'. Returns false if 'deadline' is reached.
+  template <typename TryOperation, typename MaySucceed>
+  bool Wait(const TryOperation& try_operation, const MaySucceed& may_succeed,
+            const absl::Time deadline) LOCKS_EXCLUDED(mutex_) {
+    for (int i = 0; i != kNumSpins; ++i) {
+      if (try_operation()) {
+        return true;
+      }
+    }
+    for (;;) {
+      {
+        absl::MutexLock locker(&mutex_);
+        ++num_waiters_;
+        const bool may_succeed_before_deadline =
+            mutex_.AwaitWithDeadline(absl::Condition(&may_succeed), deadline);
+        --num_waiters_;
+        if (!may_succeed_before_deadline) {
+          return false;
+        }
+      }
+      if (try_operation()) {
+        return true;
+      }
+    }
+  }
+
+  // Pairs with the order in Wait(): Either the waiter sees the change, or it
+  // is counted and woken by taking the mutex.
+  void NotifyWaiters() LOCKS_EXCLUDED(mutex_) {
+    if (num_waiters_.load() > 0) {
+      absl::MutexLock locker(&mutex_);
+    }
+  }
+
+  const size_t capacity_;
+  const std::unique_ptr<Cell[]> cells_;
+  std::atomic<size_t> enqueue_position_{0};
+  // Only changed by the consumer.
+  std::atomic<size_t> dequeue_position_{0};
+  // May briefly be off by the values being pushed or popped.
+  std::atomic<int64_t> size_{0};
+  std::atomic<int> num_waiters_{0};
+  // Waiters wait on this mutex, it is only taken to wake them.
+  absl::Mutex mutex_;
+};
+
+}  // namespace common
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_COMMON_INTERNAL_MPSC_BLOCKING_QUEUE_H_
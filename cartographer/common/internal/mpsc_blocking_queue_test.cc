@@ -0,0 +1,140 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/common/internal/mpsc_blocking_queue.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "cartographer/common/time.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace common {
+namespace {
+
+TEST(MpscBlockingQueueTest, PushPeekPop) {
+  MpscBlockingQueue<std::unique_ptr<int>> blocking_queue(4);
+  blocking_queue.Push(absl::make_unique<int>(42));
+  ASSERT_EQ(1, blocking_queue.Size());
+  blocking_queue.Push(absl::make_unique<int>(24));
+  ASSERT_EQ(2, blocking_queue.Size());
+  EXPECT_EQ(42, *blocking_queue.Peek<int>());
+  ASSERT_EQ(2, blocking_queue.Size());
+  EXPECT_EQ(42, *blocking_queue.Pop());
+  ASSERT_EQ(1, blocking_queue.Size());
+  EXPECT_EQ(24, *blocking_queue.Pop());
+  ASSERT_EQ(0, blocking_queue.Size());
+  EXPECT_EQ(nullptr, blocking_queue.Peek<int>());
+  ASSERT_EQ(0, blocking_queue.Size());
+}
+
+TEST(MpscBlockingQueueTest, WrapsAround) {
+  MpscBlockingQueue<std::unique_ptr<int>> blocking_queue(3);
+  for (int i = 0; i != 10; ++i) {
+    blocking_queue.Push(absl::make_unique<int>(i));
+    blocking_queue.Push(absl::make_unique<int>(-i));
+    EXPECT_EQ(i, *blocking_queue.Pop());
+    EXPECT_EQ(-i, *blocking_queue.Pop());
+  }
+  EXPECT_EQ(0, blocking_queue.Size());
+}
+
+TEST(MpscBlockingQueueTest, PopWithTimeout) {
+  MpscBlockingQueue<std::unique_ptr<int>> blocking_queue(2);
+  EXPECT_EQ(nullptr,
+            blocking_queue.PopWithTimeout(common::FromMilliseconds(150)));
+  EXPECT_EQ(nullptr,
+            blocking_queue.PeekWithTimeout<int>(common::FromMilliseconds(150)));
+}
+
+TEST(MpscBlockingQueueTest, PushWithTimeout) {
+  MpscBlockingQueue<std::unique_ptr<int>> blocking_queue(2);
+  EXPECT_TRUE(blocking_queue.PushWithTimeout(absl::make_unique<int>(42),
+                                             common::FromMilliseconds(150)));
+  EXPECT_TRUE(blocking_queue.PushWithTimeout(absl::make_unique<int>(24),
+                                             common::FromMilliseconds(150)));
+  EXPECT_FALSE(blocking_queue.PushWithTimeout(absl::make_unique<int>(15),
+                                              common::FromMilliseconds(150)));
+  EXPECT_EQ(42, *blocking_queue.Pop());
+  EXPECT_EQ(24, *blocking_queue.Pop());
+  EXPECT_EQ(0, blocking_queue.Size());
+}
+
+TEST(MpscBlockingQueueTest, BlockingPopWithTimeout) {
+  MpscBlockingQueue<std::unique_ptr<int>> blocking_queue(2);
+  int pop = 0;
+  std::thread thread([&blocking_queue, &pop] {
+    pop = *blocking_queue.PopWithTimeout(common::FromMilliseconds(2500));
+  });
+  std::this_thread::sleep_for(common::FromMilliseconds(100));
+  blocking_queue.Push(absl::make_unique<int>(42));
+  thread.join();
+  ASSERT_EQ(0, blocking_queue.Size());
+  EXPECT_EQ(42, pop);
+}
+
+TEST(MpscBlockingQueueTest, BlockingPushAndWaitUntilEmpty) {
+  MpscBlockingQueue<std::unique_ptr<int>> blocking_queue(2);
+  blocking_queue.Push(absl::make_unique<int>(1));
+  blocking_queue.Push(absl::make_unique<int>(2));
+  std::thread thread([&blocking_queue] {
+    blocking_queue.Push(absl::make_unique<int>(3));
+    blocking_queue.WaitUntilEmpty();
+  });
+  std::this_thread::sleep_for(common::FromMilliseconds(100));
+  EXPECT_EQ(1, *blocking_queue.Pop());
+  EXPECT_EQ(2, *blocking_queue.Pop());
+  EXPECT_EQ(3, *blocking_queue.Pop());
+  thread.join();
+  EXPECT_EQ(0, blocking_queue.Size());
+}
+
+TEST(MpscBlockingQueueTest, ManyProducers) {
+  constexpr int kNumProducers = 4;
+  constexpr int kNumValuesPerProducer = 10000;
+  MpscBlockingQueue<std::unique_ptr<int>> blocking_queue(16);
+  std::vector<std::thread> producers;
+  for (int i = 0; i != kNumProducers; ++i) {
+    producers.emplace_back([&blocking_queue, i] {
+      for (int j = 0; j != kNumValuesPerProducer; ++j) {
+        blocking_queue.Push(
+            absl::make_unique<int>(i * kNumValuesPerProducer + j));
+      }
+    });
+  }
+  // Values of each producer arrive in the order they were pushed.
+  std::vector<int> next_values(kNumProducers);
+  for (int i = 0; i != kNumProducers; ++i) {
+    next_values[i] = i * kNumValuesPerProducer;
+  }
+  for (int i = 0; i != kNumProducers * kNumValuesPerProducer; ++i) {
+    const int value = *blocking_queue.Pop();
+    const int producer = value / kNumValuesPerProducer;
+    EXPECT_EQ(next_values[producer], value);
+    ++next_values[producer];
+  }
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+  EXPECT_EQ(0, blocking_queue.Size());
+}
+
+}  // namespace
+}  // namespace common
+}  // namespace cartographer
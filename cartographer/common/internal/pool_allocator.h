@@ -0,0 +1,126 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_COMMON_INTERNAL_POOL_ALLOCATOR_H_
+#define CARTOGRAPHER_COMMON_INTERNAL_POOL_ALLOCATOR_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+namespace cartographer {
+namespace common {
+
+// A thread-safe pool of memory blocks of 'kBlockSize' bytes. Freed blocks are
+// kept in a free list for reuse and never returned to the heap, so that
+// objects which are created and destroyed at a high rate only touch the heap
+// until the pool has grown to the number of objects alive at the same time.
+template <size_t kBlockSize, size_t kAlignment>
+class FixedSizeBlockPool {
+ public:
+  // Returns the pool shared by all users of this block size and alignment. It
+  // is never destroyed, so that blocks may be freed during static destruction.
+  static FixedSizeBlockPool* Get() {
+    static FixedSizeBlockPool* const pool = new FixedSizeBlockPool();
+    return pool;
+  }
+
+  FixedSizeBlockPool(const FixedSizeBlockPool&) = delete;
+  FixedSizeBlockPool& operator=(const FixedSizeBlockPool&) = delete;
+
+  void* Allocate() LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock locker(&mutex_);
+    if (free_list_ == nullptr) {
+      slabs_.emplace_back(new Block[kBlocksPerSlab]);
+      for (size_t i = 0; i != kBlocksPerSlab; ++i) {
+        slabs_.back()[i].next = free_list_;
+        free_list_ = &slabs_.back()[i];
+      }
+    }
+    Block* const block = free_list_;
+    free_list_ = block->next;
+    return block->data;
+  }
+
+  void Deallocate(void* const pointer) LOCKS_EXCLUDED(mutex_) {
+    Block* const block = reinterpret_cast<Block*>(pointer);
+    absl::MutexLock locker(&mutex_);
+    block->next = free_list_;
+    free_list_ = block;
+  }
+
+ private:
+  static constexpr size_t kBlocksPerSlab = 64;
+
+  union Block {
+    Block* next;
+    alignas(kAlignment) char data[kBlockSize];
+  };
+
+  FixedSizeBlockPool() = default;
+
+  absl::Mutex mutex_;
+  Block* free_list_ GUARDED_BY(mutex_) = nullptr;
+  std::vector<std::unique_ptr<Block[]>> slabs_ GUARDED_BY(mutex_);
+};
+
+// An allocator which takes single objects from the 'FixedSizeBlockPool' of
+// their size. Arrays are taken from the heap. This allows e.g. to allocate the
+// control blocks of 'std::shared_ptr' from a pool.
+template <typename T>
+class PoolAllocator {
+ public:
+  using value_type = T;
+
+  PoolAllocator() = default;
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>&) {}
+
+  T* allocate(const size_t n) {
+    if (n == 1) {
+      return static_cast<T*>(Pool::Get()->Allocate());
+    }
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T* const pointer, const size_t n) {
+    if (n == 1) {
+      Pool::Get()->Deallocate(pointer);
+      return;
+    }
+    std::allocator<T>().deallocate(pointer, n);
+  }
+
+ private:
+  using Pool = FixedSizeBlockPool<sizeof(T), alignof(T)>;
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+  return false;
+}
+
+}  // namespace common
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_COMMON_INTERNAL_POOL_ALLOCATOR_H_
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/common/internal/pool_allocator.h"
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace common {
+namespace {
+
+TEST(FixedSizeBlockPoolTest, ReusesFreedBlocks) {
+  using Pool = FixedSizeBlockPool<24, 8>;
+  void* const block = Pool::Get()->Allocate();
+  Pool::Get()->Deallocate(block);
+  EXPECT_EQ(block, Pool::Get()->Allocate());
+  Pool::Get()->Deallocate(block);
+}
+
+TEST(FixedSizeBlockPoolTest, DistinctAlignedBlocks) {
+  using Pool = FixedSizeBlockPool<40, 16>;
+  std::set<void*> blocks;
+  for (int i = 0; i != 1000; ++i) {
+    void* const block = Pool::Get()->Allocate();
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(block) % 16, 0);
+    EXPECT_TRUE(blocks.insert(block).second);
+  }
+  for (void* const block : blocks) {
+    Pool::Get()->Deallocate(block);
+  }
+}
+
+TEST(PoolAllocatorTest, SharedPointer) {
+  int num_deleted = 0;
+  {
+    std::shared_ptr<int> shared(
+        new int(42), [&num_deleted](int* value) {
+          ++num_deleted;
+          delete value;
+        },
+        PoolAllocator<int>());
+    std::weak_ptr<int> weak = shared;
+    EXPECT_EQ(*weak.lock(), 42);
+  }
+  EXPECT_EQ(num_deleted, 1);
+}
+
+TEST(PoolAllocatorTest, ManyThreads) {
+  std::vector<std::thread> threads;
+  for (int i = 0; i != 4; ++i) {
+    threads.emplace_back([]() {
+      PoolAllocator<double> allocator;
+      std::vector<double*> values;
+      for (int j = 0; j != 10000; ++j) {
+        values.push_back(allocator.allocate(1));
+        *values.back() = j;
+        if (j % 3 == 0) {
+          allocator.deallocate(values.back(), 1);
+          values.pop_back();
+        }
+      }
+      for (double* value : values) {
+        allocator.deallocate(value, 1);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace
+}  // namespace common
+}  // namespace cartographer
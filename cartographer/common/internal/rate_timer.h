@@ -21,13 +21,13 @@
 #define CARTOGRAPHER_COMMON_RATE_TIMER_H_
 
 #include <chrono>
-#include <deque>
 #include <iomanip>
 #include <numeric>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include "cartographer/common/internal/ring_buffer.h"
 #include "cartographer/common/math.h"
 #include "cartographer/common/port.h"
 #include "cartographer/common/time.h"
@@ -134,7 +134,7 @@ class RateTimer {
     return out.str();
   }
 
-  std::deque<Event> events_;
+  RingBuffer<Event> events_;
   const common::Duration window_duration_;
 };
 
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_COMMON_INTERNAL_RING_BUFFER_H_
+#define CARTOGRAPHER_COMMON_INTERNAL_RING_BUFFER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace common {
+
+// A FIFO queue in a single buffer which doubles in size when full and never
+// shrinks. Unlike 'std::deque', which allocates and frees a block every few
+// values passing through, it does not touch the heap once it reached the
+// largest size it is used at. Popped values are overwritten with default
+// constructed ones to release what they own, so 'T' must be default
+// constructible and move assignable.
+template <typename T>
+class RingBuffer {
+ public:
+  RingBuffer() = default;
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+  size_t capacity() const { return values_.size(); }
+
+  // 'index' 0 is the front.
+  T& operator[](const size_t index) {
+    DCHECK_LT(index, size_);
+    return values_[(head_ + index) & (values_.size() - 1)];
+  }
+  const T& operator[](const size_t index) const {
+    DCHECK_LT(index, size_);
+    return values_[(head_ + index) & (values_.size() - 1)];
+  }
+
+  T& front() { return (*this)[0]; }
+  const T& front() const { return (*this)[0]; }
+  T& back() { return (*this)[size_ - 1]; }
+  const T& back() const { return (*this)[size_ - 1]; }
+
+  void push_back(T value) {
+    if (size_ == values_.size()) {
+      Grow();
+    }
+    values_[(head_ + size_) & (values_.size() - 1)] = std::move(value);
+    ++size_;
+  }
+
+  void pop_front() {
+    CHECK(!empty());
+    values_[head_] = T();
+    head_ = (head_ + 1) & (values_.size() - 1);
+    --size_;
+  }
+
+ private:
+  static constexpr size_t kInitialCapacity = 16;
+
+  void Grow() {
+    // The capacity stays a power of two, so that indices wrap by masking.
+    std::vector<T> values(std::max(kInitialCapacity, 2 * values_.size()));
+    for (size_t i = 0; i != size_; ++i) {
+      values[i] = std::move((*this)[i]);
+    }
+    values_.swap(values);
+    head_ = 0;
+  }
+
+  std::vector<T> values_;
+  size_t head_ = 0;
+  size_t size_ = 0;
+};
+
+template <typename T>
+constexpr size_t RingBuffer<T>::kInitialCapacity;
+
+}  // namespace common
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_COMMON_INTERNAL_RING_BUFFER_H_
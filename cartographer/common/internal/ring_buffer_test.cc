@@ -0,0 +1,71 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/common/internal/ring_buffer.h"
+
+#include <memory>
+
+#include "absl/memory/memory.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace common {
+namespace {
+
+TEST(RingBufferTest, KeepsOrderWhileWrappingAndGrowing) {
+  RingBuffer<std::unique_ptr<int>> ring_buffer;
+  int next_pushed = 0;
+  int next_popped = 0;
+  // Alternates between filling and draining, so that the values wrap around
+  // the end of the buffer before it grows.
+  for (int round = 0; round != 20; ++round) {
+    for (int i = 0; i != 3 * round + 5; ++i) {
+      ring_buffer.push_back(absl::make_unique<int>(next_pushed++));
+    }
+    ASSERT_EQ(ring_buffer.size(), next_pushed - next_popped);
+    EXPECT_EQ(*ring_buffer.back(), next_pushed - 1);
+    for (size_t i = 0; i != ring_buffer.size(); ++i) {
+      EXPECT_EQ(*ring_buffer[i], next_popped + static_cast<int>(i));
+    }
+    for (int i = 0; i != 2 * round + 4; ++i) {
+      EXPECT_EQ(*ring_buffer.front(), next_popped++);
+      ring_buffer.pop_front();
+    }
+  }
+  while (!ring_buffer.empty()) {
+    EXPECT_EQ(*ring_buffer.front(), next_popped++);
+    ring_buffer.pop_front();
+  }
+  EXPECT_EQ(next_popped, next_pushed);
+}
+
+TEST(RingBufferTest, DoesNotGrowAtConstantSize) {
+  RingBuffer<std::shared_ptr<int>> ring_buffer;
+  const auto value = std::make_shared<int>(1);
+  for (int i = 0; i != 1000; ++i) {
+    ring_buffer.push_back(value);
+    if (ring_buffer.size() > 5) {
+      ring_buffer.pop_front();
+    }
+  }
+  EXPECT_EQ(ring_buffer.capacity(), 16);
+  // Popped values are released.
+  EXPECT_EQ(value.use_count(), 6);
+}
+
+}  // namespace
+}  // namespace common
+}  // namespace cartographer
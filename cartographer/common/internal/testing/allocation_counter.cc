@@ -0,0 +1,103 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/common/internal/testing/allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace common {
+namespace testing {
+namespace {
+
+std::atomic<bool> counting_allocations(false);
+std::atomic<int64> num_counted_allocations(0);
+
+void* CountedAllocate(const size_t size) {
+  if (counting_allocations.load(std::memory_order_relaxed)) {
+    num_counted_allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  // malloc(0) may return nullptr, but 'operator new' must not.
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+void* CountedAllocateOrThrow(const size_t size) {
+  void* const pointer = CountedAllocate(size);
+  if (pointer == nullptr) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+}  // namespace
+
+ScopedAllocationCounter::ScopedAllocationCounter() {
+  num_counted_allocations.store(0);
+  CHECK(!counting_allocations.exchange(true))
+      << "Allocation counters must not overlap.";
+}
+
+ScopedAllocationCounter::~ScopedAllocationCounter() {
+  counting_allocations.store(false);
+}
+
+int64 ScopedAllocationCounter::num_allocations() const {
+  return num_counted_allocations.load();
+}
+
+}  // namespace testing
+}  // namespace common
+}  // namespace cartographer
+
+void* operator new(const size_t size) {
+  return ::cartographer::common::testing::CountedAllocateOrThrow(size);
+}
+
+void* operator new[](const size_t size) {
+  return ::cartographer::common::testing::CountedAllocateOrThrow(size);
+}
+
+void* operator new(const size_t size, const std::nothrow_t&) noexcept {
+  return ::cartographer::common::testing::CountedAllocate(size);
+}
+
+void* operator new[](const size_t size, const std::nothrow_t&) noexcept {
+  return ::cartographer::common::testing::CountedAllocate(size);
+}
+
+void operator delete(void* const pointer) noexcept { std::free(pointer); }
+
+void operator delete[](void* const pointer) noexcept { std::free(pointer); }
+
+void operator delete(void* const pointer, size_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void* const pointer, size_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void* const pointer, const std::nothrow_t&) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void* const pointer, const std::nothrow_t&) noexcept {
+  std::free(pointer);
+}
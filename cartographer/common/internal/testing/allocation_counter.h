@@ -0,0 +1,46 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_COMMON_INTERNAL_TESTING_ALLOCATION_COUNTER_H_
+#define CARTOGRAPHER_COMMON_INTERNAL_TESTING_ALLOCATION_COUNTER_H_
+
+#include "cartographer/common/port.h"
+
+namespace cartographer {
+namespace common {
+namespace testing {
+
+// Counts the heap allocations through the global 'operator new' of all
+// threads while it is alive, e.g. to check that a code path does not allocate
+// once it is warmed up. Linking this replaces the global 'operator new' and
+// 'operator delete' of the test binary. Counters must not overlap.
+class ScopedAllocationCounter {
+ public:
+  ScopedAllocationCounter();
+  ~ScopedAllocationCounter();
+
+  ScopedAllocationCounter(const ScopedAllocationCounter&) = delete;
+  ScopedAllocationCounter& operator=(const ScopedAllocationCounter&) = delete;
+
+  // Returns the number of allocations since construction.
+  int64 num_allocations() const;
+};
+
+}  // namespace testing
+}  // namespace common
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_COMMON_INTERNAL_TESTING_ALLOCATION_COUNTER_H_
@@ -0,0 +1,162 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/common/options_cache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "cartographer/common/port.h"
+#include "cartographer/common/proto/options_cache.pb.h"
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace common {
+namespace {
+
+// FNV-1a, which unlike std::hash is the same for every build, so entries
+// stay valid across launches of different binaries.
+uint64 HashString(const std::string& data,
+                  uint64 hash = 14695981039346656037ull) {
+  for (const char c : data) {
+    hash ^= static_cast<uint8>(c);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+void AddDependency(const std::string& basename, const std::string& content,
+                   proto::CachedOptions* cached_options) {
+  proto::CachedOptions::Dependency* const dependency =
+      cached_options->add_dependencies();
+  dependency->set_basename(basename);
+  dependency->set_content_hash(HashString(content));
+}
+
+// Forwards to 'file_resolver' and records every file read as a dependency.
+class RecordingFileResolver : public FileResolver {
+ public:
+  RecordingFileResolver(std::unique_ptr<FileResolver> file_resolver,
+                        proto::CachedOptions* cached_options)
+      : file_resolver_(std::move(file_resolver)),
+        cached_options_(cached_options) {}
+
+  std::string GetFullPathOrDie(const std::string& basename) override {
+    return file_resolver_->GetFullPathOrDie(basename);
+  }
+
+  std::string GetFileContentOrDie(const std::string& basename) override {
+    std::string content = file_resolver_->GetFileContentOrDie(basename);
+    AddDependency(basename, content, cached_options_);
+    return content;
+  }
+
+ private:
+  const std::unique_ptr<FileResolver> file_resolver_;
+  proto::CachedOptions* const cached_options_;
+};
+
+bool ReadCacheEntry(const std::string& filename,
+                    proto::CachedOptions* cached_options) {
+  std::ifstream stream(filename, std::ios::binary);
+  if (!stream.good()) return false;
+  const std::string data((std::istreambuf_iterator<char>(stream)),
+                         std::istreambuf_iterator<char>());
+  return cached_options->ParseFromString(data);
+}
+
+// Writes to a temporary file first, so that concurrent launches never read a
+// partially written entry.
+void WriteCacheEntry(const std::string& filename,
+                     const proto::CachedOptions& cached_options) {
+  const std::string temporary_filename = filename + ".tmp";
+  {
+    std::ofstream stream(temporary_filename,
+                         std::ios::binary | std::ios::trunc);
+    if (!stream.good() || !cached_options.SerializeToOstream(&stream)) {
+      LOG(WARNING) << "Failed to write options cache entry '"
+                   << temporary_filename << "'.";
+      return;
+    }
+  }
+  if (std::rename(temporary_filename.c_str(), filename.c_str()) != 0) {
+    LOG(WARNING) << "Failed to rename '" << temporary_filename << "' to '"
+                 << filename << "'.";
+    std::remove(temporary_filename.c_str());
+  }
+}
+
+}  // namespace
+
+OptionsCache::OptionsCache(const std::string& cache_directory)
+    : cache_directory_(cache_directory) {
+  CHECK(!cache_directory_.empty());
+}
+
+bool OptionsCache::Load(const std::string& configuration_basename,
+                        std::unique_ptr<FileResolver> file_resolver,
+                        const CreateOptionsFunction& create_options,
+                        const std::vector<google::protobuf::Message*>& options) {
+  const std::string code =
+      file_resolver->GetFileContentOrDie(configuration_basename);
+  uint64 key = HashString(code);
+  for (const google::protobuf::Message* message : options) {
+    key = HashString(message->GetDescriptor()->full_name(), key);
+  }
+  const std::string filename = absl::StrCat(
+      cache_directory_, "/", absl::Hex(key, absl::kZeroPad16), ".pb");
+
+  proto::CachedOptions cached_options;
+  if (ReadCacheEntry(filename, &cached_options) &&
+      cached_options.options_size() == static_cast<int>(options.size())) {
+    bool valid = true;
+    for (const auto& dependency : cached_options.dependencies()) {
+      if (HashString(file_resolver->GetFileContentOrDie(
+              dependency.basename())) != dependency.content_hash()) {
+        valid = false;
+        break;
+      }
+    }
+    for (size_t i = 0; valid && i != options.size(); ++i) {
+      valid = options[i]->ParseFromString(cached_options.options(i));
+    }
+    if (valid) {
+      LOG(INFO) << "Using cached options '" << filename << "' for '"
+                << configuration_basename << "'.";
+      return true;
+    }
+  }
+
+  cached_options.Clear();
+  AddDependency(configuration_basename, code, &cached_options);
+  {
+    LuaParameterDictionary lua_parameter_dictionary(
+        code, absl::make_unique<RecordingFileResolver>(std::move(file_resolver),
+                                                       &cached_options));
+    create_options(&lua_parameter_dictionary);
+  }
+  for (const google::protobuf::Message* message : options) {
+    cached_options.add_options(message->SerializeAsString());
+  }
+  WriteCacheEntry(filename, cached_options);
+  return false;
+}
+
+}  // namespace common
+}  // namespace cartographer
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_COMMON_OPTIONS_CACHE_H_
+#define CARTOGRAPHER_COMMON_OPTIONS_CACHE_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cartographer/common/lua_parameter_dictionary.h"
+#include "google/protobuf/message.h"
+
+namespace cartographer {
+namespace common {
+
+// Stores options protos computed from a Lua configuration on disk, so that
+// later launches and services can skip evaluating the configuration.
+//
+// Entries in 'cache_directory' are keyed by a hash of the configuration file
+// content and the types of the requested options. An entry records every file
+// read while evaluating the configuration together with a hash of its
+// content, and it is only used if none of these files changed.
+class OptionsCache {
+ public:
+  using CreateOptionsFunction =
+      std::function<void(LuaParameterDictionary* lua_parameter_dictionary)>;
+
+  explicit OptionsCache(const std::string& cache_directory);
+
+  OptionsCache(const OptionsCache&) = delete;
+  OptionsCache& operator=(const OptionsCache&) = delete;
+
+  // Fills 'options' from the cache entry for 'configuration_basename'. If
+  // there is no valid entry, evaluates the configuration, calls
+  // 'create_options' to fill 'options' and stores a new entry. Returns true
+  // if the entry was used.
+  bool Load(const std::string& configuration_basename,
+            std::unique_ptr<FileResolver> file_resolver,
+            const CreateOptionsFunction& create_options,
+            const std::vector<google::protobuf::Message*>& options);
+
+ private:
+  const std::string cache_directory_;
+};
+
+}  // namespace common
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_COMMON_OPTIONS_CACHE_H_
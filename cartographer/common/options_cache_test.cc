@@ -0,0 +1,113 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/common/options_cache.h"
+
+#include <stdlib.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "absl/memory/memory.h"
+#include "cartographer/common/ceres_solver_options.h"
+#include "cartographer/common/proto/ceres_solver_options.pb.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace common {
+namespace {
+
+class InMemoryFileResolver : public FileResolver {
+ public:
+  explicit InMemoryFileResolver(
+      const std::map<std::string, std::string>* files)
+      : files_(files) {}
+
+  std::string GetFullPathOrDie(const std::string& basename) override {
+    CHECK(files_->count(basename)) << basename;
+    return basename;
+  }
+
+  std::string GetFileContentOrDie(const std::string& basename) override {
+    return files_->at(GetFullPathOrDie(basename));
+  }
+
+ private:
+  const std::map<std::string, std::string>* const files_;
+};
+
+class OptionsCacheTest : public ::testing::Test {
+ protected:
+  OptionsCacheTest()
+      : files_{{"base.lua",
+                "CERES = { use_nonmonotonic_steps = true, "
+                "max_num_iterations = 10, num_threads = 1, "
+                "linear_solver_type = \"\", "
+                "sparse_linear_algebra_library_type = \"\" }"},
+               {"options.lua", "include \"base.lua\"\nreturn CERES"}},
+        options_cache_(MakeTemporaryDirectory()) {}
+
+  static std::string MakeTemporaryDirectory() {
+    std::string directory = ::testing::TempDir() + "options_cache_XXXXXX";
+    CHECK(mkdtemp(&directory[0]) != nullptr);
+    return directory;
+  }
+
+  // Returns true if the options were taken from the cache.
+  bool Load(proto::CeresSolverOptions* options) {
+    return options_cache_.Load(
+        "options.lua", absl::make_unique<InMemoryFileResolver>(&files_),
+        [this, options](LuaParameterDictionary* lua_parameter_dictionary) {
+          ++num_evaluations_;
+          *options = CreateCeresSolverOptionsProto(lua_parameter_dictionary);
+        },
+        {options});
+  }
+
+  std::map<std::string, std::string> files_;
+  OptionsCache options_cache_;
+  int num_evaluations_ = 0;
+};
+
+TEST_F(OptionsCacheTest, UsesCachedOptions) {
+  proto::CeresSolverOptions options;
+  EXPECT_FALSE(Load(&options));
+  EXPECT_EQ(options.max_num_iterations(), 10);
+  EXPECT_EQ(num_evaluations_, 1);
+
+  proto::CeresSolverOptions cached_options;
+  EXPECT_TRUE(Load(&cached_options));
+  EXPECT_EQ(num_evaluations_, 1);
+  EXPECT_EQ(cached_options.SerializeAsString(), options.SerializeAsString());
+}
+
+TEST_F(OptionsCacheTest, ReevaluatesIfIncludedFileChanged) {
+  proto::CeresSolverOptions options;
+  Load(&options);
+  files_["base.lua"] =
+      "CERES = { use_nonmonotonic_steps = true, max_num_iterations = 20, "
+      "num_threads = 1, linear_solver_type = \"\", "
+      "sparse_linear_algebra_library_type = \"\" }";
+  EXPECT_FALSE(Load(&options));
+  EXPECT_EQ(options.max_num_iterations(), 20);
+  EXPECT_TRUE(Load(&options));
+  EXPECT_EQ(options.max_num_iterations(), 20);
+}
+
+}  // namespace
+}  // namespace common
+}  // namespace cartographer
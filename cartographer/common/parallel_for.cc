@@ -0,0 +1,76 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "cartographer/common/parallel_for.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "cartographer/common/task.h"
+
+namespace cartographer {
+namespace common {
+namespace {
+
+// Work items shared by the tasks of a parallel computation. Each task takes
+// the next item until all are taken. Tasks may only start after the
+// computation is over, so 'work' is only touched after taking a valid index.
+struct ParallelWorkState {
+  explicit ParallelWorkState(const int num_items) : num_items(num_items) {}
+
+  const int num_items;
+  std::function<void(int index)> work;
+  std::atomic<int> next_index{0};
+  absl::Mutex mutex;
+  int num_done GUARDED_BY(mutex) = 0;
+};
+
+void DoWork(ParallelWorkState* const state) {
+  for (;;) {
+    const int index = state->next_index.fetch_add(1);
+    if (index >= state->num_items) return;
+    state->work(index);
+    absl::MutexLock locker(&state->mutex);
+    ++state->num_done;
+  }
+}
+
+}  // namespace
+
+void ParallelFor(const int num_items, const int num_tasks,
+                 ThreadPoolInterface* const thread_pool,
+                 const std::function<void(int index)>& work) {
+  const auto state = std::make_shared<ParallelWorkState>(num_items);
+  state->work = work;
+  for (int i = 1; i < std::min(num_tasks, num_items); ++i) {
+    auto task = absl::make_unique<Task>();
+    task->SetWorkItem([state]() { DoWork(state.get()); });
+    thread_pool->Schedule(std::move(task));
+  }
+  DoWork(state.get());
+  absl::MutexLock locker(&state->mutex);
+  const auto predicate = [&state]() EXCLUSIVE_LOCKS_REQUIRED(state->mutex) {
+    return state->num_done == state->num_items;
+  };
+  state->mutex.Await(absl::Condition(&predicate));
+}
+
+}  // namespace common
+}  // namespace cartographer
@@ -0,0 +1,39 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef CARTOGRAPHER_COMMON_PARALLEL_FOR_H_
+#define CARTOGRAPHER_COMMON_PARALLEL_FOR_H_
+
+#include <functional>
+
+#include "cartographer/common/thread_pool.h"
+
+namespace cartographer {
+namespace common {
+
+// Calls 'work' for all indices in [0, 'num_items') using up to 'num_tasks'
+// tasks, all but one scheduled on 'thread_pool'. The calling thread does its
+// share and only waits for items already being worked on. Returns when 'work'
+// was called for all indices.
+void ParallelFor(int num_items, int num_tasks,
+                 ThreadPoolInterface* thread_pool,
+                 const std::function<void(int index)>& work);
+
+}  // namespace common
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_COMMON_PARALLEL_FOR_H_
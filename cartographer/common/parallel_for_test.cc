@@ -0,0 +1,48 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "cartographer/common/parallel_for.h"
+
+#include <atomic>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace common {
+namespace {
+
+TEST(ParallelForTest, CallsWorkForEachIndexOnce) {
+  ThreadPool pool(3);
+  for (const int num_tasks : {1, 4, 100}) {
+    std::vector<std::atomic<int>> num_calls(1000);
+    ParallelFor(num_calls.size(), num_tasks, &pool,
+                [&num_calls](const int index) { ++num_calls[index]; });
+    for (const std::atomic<int>& count : num_calls) {
+      EXPECT_EQ(count.load(), 1);
+    }
+  }
+}
+
+TEST(ParallelForTest, NoItems) {
+  ThreadPool pool(1);
+  ParallelFor(0, 4, &pool, [](const int index) { FAIL(); });
+}
+
+}  // namespace
+}  // namespace common
+}  // namespace cartographer
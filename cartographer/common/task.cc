@@ -16,9 +16,24 @@
 
 #include "cartographer/common/task.h"
 
+#include <algorithm>
+
+#include "cartographer/common/internal/pool_allocator.h"
+
 namespace cartographer {
 namespace common {
 
+constexpr int Task::kNoAffinity;
+
+void* Task::operator new(const size_t size) {
+  CHECK_EQ(size, sizeof(Task));
+  return FixedSizeBlockPool<sizeof(Task), alignof(Task)>::Get()->Allocate();
+}
+
+void Task::operator delete(void* const pointer) {
+  FixedSizeBlockPool<sizeof(Task), alignof(Task)>::Get()->Deallocate(pointer);
+}
+
 Task::~Task() {
   // TODO(gaschler): Relax some checks after testing.
   if (state_ != NEW && state_ != COMPLETED) {
@@ -31,10 +46,10 @@ Task::State Task::GetState() {
   return state_;
 }
 
-void Task::SetWorkItem(const WorkItem& work_item) {
+void Task::SetWorkItem(WorkItem work_item) {
   absl::MutexLock locker(&mutex_);
   CHECK_EQ(state_, NEW);
-  work_item_ = work_item;
+  work_item_ = std::move(work_item);
 }
 
 void Task::AddDependency(std::weak_ptr<Task> dependency) {
@@ -51,6 +66,19 @@ void Task::AddDependency(std::weak_ptr<Task> dependency) {
   }
 }
 
+void Task::SetPriority(const Priority priority) {
+  absl::MutexLock locker(&mutex_);
+  CHECK_EQ(state_, NEW);
+  priority_ = priority;
+}
+
+void Task::SetAffinity(const int affinity) {
+  absl::MutexLock locker(&mutex_);
+  CHECK_EQ(state_, NEW);
+  CHECK_GE(affinity, kNoAffinity);
+  affinity_ = affinity;
+}
+
 void Task::SetThreadPool(ThreadPoolInterface* thread_pool) {
   absl::MutexLock locker(&mutex_);
   CHECK_EQ(state_, NEW);
@@ -69,8 +97,10 @@ void Task::AddDependentTask(Task* dependent_task) {
     dependent_task->OnDependenyCompleted();
     return;
   }
-  bool inserted = dependent_tasks_.insert(dependent_task).second;
-  CHECK(inserted) << "Given dependency is already a dependency.";
+  CHECK(std::find(dependent_tasks_.begin(), dependent_tasks_.end(),
+                  dependent_task) == dependent_tasks_.end())
+      << "Given dependency is already a dependency.";
+  dependent_tasks_.push_back(dependent_task);
 }
 
 void Task::OnDependenyCompleted() {
@@ -17,8 +17,10 @@
 #ifndef CARTOGRAPHER_COMMON_TASK_H_
 #define CARTOGRAPHER_COMMON_TASK_H_
 
-#include <set>
+#include <cstddef>
+#include <functional>
 
+#include "absl/container/inlined_vector.h"
 #include "absl/synchronization/mutex.h"
 #include "glog/logging.h"
 #include "thread_pool.h"
@@ -34,19 +36,42 @@ class Task {
 
   using WorkItem = std::function<void()>;
   enum State { NEW, DISPATCHED, DEPENDENCIES_COMPLETED, RUNNING, COMPLETED };
+  // Ready tasks of higher priority run before ready tasks of lower priority.
+  enum Priority { LOW, NORMAL, HIGH };
+  static constexpr int kNumPriorities = HIGH + 1;
 
   Task() = default;
   ~Task();
 
+  // Tasks are created at a high rate, so they are allocated from a pool.
+  static void* operator new(size_t size);
+  static void operator delete(void* pointer);
+
   State GetState() LOCKS_EXCLUDED(mutex_);
 
   // State must be 'NEW'.
-  void SetWorkItem(const WorkItem& work_item) LOCKS_EXCLUDED(mutex_);
+  void SetWorkItem(WorkItem work_item) LOCKS_EXCLUDED(mutex_);
 
   // State must be 'NEW'. 'dependency' may be nullptr, in which case it is
   // assumed completed.
   void AddDependency(std::weak_ptr<Task> dependency) LOCKS_EXCLUDED(mutex_);
 
+  // State must be 'NEW'. Defaults to 'NORMAL'.
+  void SetPriority(Priority priority) LOCKS_EXCLUDED(mutex_);
+
+  // Does not lock, since thread pools read it while the task notifies them.
+  // The priority does not change anymore once the task is scheduled.
+  Priority priority() const { return priority_; }
+
+  // State must be 'NEW'. Thread pools with groups of worker threads prefer to
+  // run tasks of the same non-negative affinity in the same group, e.g. to
+  // keep memory local to the threads using it. Defaults to 'kNoAffinity'.
+  static constexpr int kNoAffinity = -1;
+  void SetAffinity(int affinity) LOCKS_EXCLUDED(mutex_);
+
+  // Does not lock, like priority().
+  int affinity() const { return affinity_; }
+
  private:
   // Allowed in all states.
   void AddDependentTask(Task* dependent_task);
@@ -65,7 +90,10 @@ class Task {
   ThreadPoolInterface* thread_pool_to_notify_ GUARDED_BY(mutex_) = nullptr;
   State state_ GUARDED_BY(mutex_) = NEW;
   unsigned int uncompleted_dependencies_ GUARDED_BY(mutex_) = 0;
-  std::set<Task*> dependent_tasks_ GUARDED_BY(mutex_);
+  // Most tasks have a single dependent task, so it is kept inline.
+  absl::InlinedVector<Task*, 2> dependent_tasks_ GUARDED_BY(mutex_);
+  Priority priority_ = NORMAL;
+  int affinity_ = kNoAffinity;
 
   absl::Mutex mutex_;
 };
@@ -16,30 +16,126 @@
 
 #include "cartographer/common/thread_pool.h"
 
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
 #ifndef WIN32
 #include <unistd.h>
 #endif
 #include <algorithm>
 #include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <map>
 #include <numeric>
+#include <string>
 
 #include "absl/memory/memory.h"
+#include "absl/strings/str_split.h"
+#include "cartographer/common/internal/pool_allocator.h"
 #include "cartographer/common/task.h"
+#include "cartographer/common/tracing.h"
 #include "glog/logging.h"
 
 namespace cartographer {
 namespace common {
 
-void ThreadPoolInterface::Execute(Task* task) { task->Execute(); }
+void ThreadPoolInterface::Execute(Task* task) {
+  CARTOGRAPHER_TRACE_SPAN("ThreadPool::Execute", task->priority());
+  task->Execute();
+}
 
 void ThreadPoolInterface::SetThreadPool(Task* task) {
   task->SetThreadPool(this);
 }
 
-ThreadPool::ThreadPool(int num_threads) {
+std::shared_ptr<Task> ThreadPoolInterface::ToSharedTask(
+    std::unique_ptr<Task> task) {
+  return std::shared_ptr<Task>(task.release(), std::default_delete<Task>(),
+                               PoolAllocator<Task>());
+}
+
+void ConfigureBackgroundThread(const int nice_increment,
+                               const std::vector<int>& cpu_ids) {
+#ifdef __linux__
+  // This changes the per-thread nice level of the current thread on Linux.
+  if (nice_increment != 0) {
+    CHECK_NE(nice(nice_increment), -1);
+  }
+  if (!cpu_ids.empty()) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (const int cpu_id : cpu_ids) {
+      CHECK_GE(cpu_id, 0);
+      CHECK_LT(cpu_id, CPU_SETSIZE);
+      CPU_SET(cpu_id, &cpu_set);
+    }
+    CHECK_EQ(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set),
+             0);
+  }
+#endif
+}
+
+std::vector<std::vector<int>> GroupCpuIdsByNumaNode(
+    const std::vector<int>& cpu_ids) {
+  std::vector<std::vector<int>> result;
+#ifdef __linux__
+  const std::string kNodesDirectory = "/sys/devices/system/node";
+  DIR* const nodes_directory = opendir(kNodesDirectory.c_str());
+  if (nodes_directory == nullptr) {
+    return result;
+  }
+  // Node directories are named 'node<N>', they are ordered by N.
+  std::map<int, std::string> node_cpu_lists;
+  while (const dirent* const entry = readdir(nodes_directory)) {
+    const std::string name = entry->d_name;
+    if (name.compare(0, 4, "node") != 0 || name.size() == 4 ||
+        name.find_first_not_of("0123456789", 4) != std::string::npos) {
+      continue;
+    }
+    std::ifstream cpu_list_file(kNodesDirectory + "/" + name + "/cpulist");
+    std::string cpu_list;
+    if (std::getline(cpu_list_file, cpu_list)) {
+      node_cpu_lists[std::atoi(name.c_str() + 4)] = cpu_list;
+    }
+  }
+  closedir(nodes_directory);
+  // A CPU list looks like '0-3,8-11'.
+  for (const auto& node_cpu_list : node_cpu_lists) {
+    std::vector<int> node_cpu_ids;
+    for (const absl::string_view range :
+         absl::StrSplit(node_cpu_list.second, ',', absl::SkipWhitespace())) {
+      const std::vector<std::string> bounds = absl::StrSplit(range, '-');
+      const int first = std::atoi(bounds.front().c_str());
+      const int last = std::atoi(bounds.back().c_str());
+      for (int cpu_id = first; cpu_id <= last; ++cpu_id) {
+        if (cpu_ids.empty() || std::find(cpu_ids.begin(), cpu_ids.end(),
+                                         cpu_id) != cpu_ids.end()) {
+          node_cpu_ids.push_back(cpu_id);
+        }
+      }
+    }
+    if (!node_cpu_ids.empty()) {
+      result.push_back(std::move(node_cpu_ids));
+    }
+  }
+#endif
+  return result;
+}
+
+ThreadPool::ThreadPool(int num_threads)
+    : ThreadPool(num_threads, 10 /* nice_increment */, {} /* cpu_ids */) {}
+
+ThreadPool::ThreadPool(int num_threads, int nice_increment,
+                       const std::vector<int>& cpu_ids)
+    : task_queues_(Task::kNumPriorities) {
   absl::MutexLock locker(&mutex_);
   for (int i = 0; i != num_threads; ++i) {
-    pool_.emplace_back([this]() { ThreadPool::DoWork(); });
+    pool_.emplace_back([this, nice_increment, cpu_ids]() {
+      ThreadPool::DoWork(nice_increment, cpu_ids);
+    });
   }
 }
 
@@ -58,7 +154,7 @@ void ThreadPool::NotifyDependenciesCompleted(Task* task) {
   absl::MutexLock locker(&mutex_);
   auto it = tasks_not_ready_.find(task);
   CHECK(it != tasks_not_ready_.end());
-  task_queue_.push_back(it->second);
+  task_queues_[task->priority()].push_back(it->second);
   tasks_not_ready_.erase(it);
 }
 
@@ -66,8 +162,9 @@ std::weak_ptr<Task> ThreadPool::Schedule(std::unique_ptr<Task> task) {
   std::shared_ptr<Task> shared_task;
   {
     absl::MutexLock locker(&mutex_);
-    auto insert_result =
-        tasks_not_ready_.insert(std::make_pair(task.get(), std::move(task)));
+    Task* const task_pointer = task.get();
+    auto insert_result = tasks_not_ready_.insert(
+        std::make_pair(task_pointer, ToSharedTask(std::move(task))));
     CHECK(insert_result.second) << "Schedule called twice";
     shared_task = insert_result.first->second;
   }
@@ -75,25 +172,34 @@ std::weak_ptr<Task> ThreadPool::Schedule(std::unique_ptr<Task> task) {
   return shared_task;
 }
 
-void ThreadPool::DoWork() {
-#ifdef __linux__
-  // This changes the per-thread nice level of the current thread on Linux. We
-  // do this so that the background work done by the thread pool is not taking
-  // away CPU resources from more important foreground threads.
-  CHECK_NE(nice(10), -1);
-#endif
+bool ThreadPool::HasQueuedTask() const {
+  return std::any_of(
+      task_queues_.begin(), task_queues_.end(),
+      [](const std::deque<std::shared_ptr<Task>>& queue) {
+        return !queue.empty();
+      });
+}
+
+void ThreadPool::DoWork(const int nice_increment,
+                        const std::vector<int>& cpu_ids) {
+  ConfigureBackgroundThread(nice_increment, cpu_ids);
   const auto predicate = [this]() EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
-    return !task_queue_.empty() || !running_;
+    return HasQueuedTask() || !running_;
   };
   for (;;) {
     std::shared_ptr<Task> task;
     {
       absl::MutexLock locker(&mutex_);
       mutex_.Await(absl::Condition(&predicate));
-      if (!task_queue_.empty()) {
-        task = std::move(task_queue_.front());
-        task_queue_.pop_front();
-      } else if (!running_) {
+      for (auto queue = task_queues_.rbegin(); queue != task_queues_.rend();
+           ++queue) {
+        if (!queue->empty()) {
+          task = std::move(queue->front());
+          queue->pop_front();
+          break;
+        }
+      }
+      if (task == nullptr && !running_) {
         return;
       }
     }
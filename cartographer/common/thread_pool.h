@@ -53,6 +53,8 @@ class ThreadPoolInterface {
  protected:
   void Execute(Task* task);
   void SetThreadPool(Task* task);
+  // Takes ownership of 'task', with the reference count allocated from a pool.
+  static std::shared_ptr<Task> ToSharedTask(std::unique_ptr<Task> task);
 
  private:
   friend class Task;
@@ -60,15 +62,34 @@ class ThreadPoolInterface {
   virtual void NotifyDependenciesCompleted(Task* task) = 0;
 };
 
+// Lowers the scheduling priority of the calling thread by 'nice_increment' and,
+// if 'cpu_ids' is not empty, restricts it to these CPUs. This keeps background
+// work from taking CPU away from more important foreground threads, e.g. local
+// SLAM. Only has an effect on Linux.
+void ConfigureBackgroundThread(int nice_increment,
+                               const std::vector<int>& cpu_ids);
+
+// Returns the CPUs of each NUMA node, restricted to 'cpu_ids' unless it is
+// empty. Nodes without any of these CPUs are left out. Returns an empty vector
+// if the NUMA topology is unknown, which is the case if not on Linux.
+std::vector<std::vector<int>> GroupCpuIdsByNumaNode(
+    const std::vector<int>& cpu_ids);
+
 // A fixed number of threads working on tasks. Adding a task does not block.
 // Tasks may be added whether or not their dependencies are completed.
 // When all dependencies of a task are completed, it is queued up for execution
 // in a background thread. The queue must be empty before calling the
 // destructor. The thread pool will then wait for the currently executing work
-// items to finish and then destroy the threads.
+// items to finish and then destroy the threads. Ready tasks of higher priority
+// are executed first, tasks of the same priority in the order they became
+// ready.
 class ThreadPool : public ThreadPoolInterface {
  public:
+  // The threads are niced by 10 and may run on all CPUs.
   explicit ThreadPool(int num_threads);
+  // The threads are configured using ConfigureBackgroundThread().
+  ThreadPool(int num_threads, int nice_increment,
+             const std::vector<int>& cpu_ids);
   ~ThreadPool();
 
   ThreadPool(const ThreadPool&) = delete;
@@ -80,14 +101,18 @@ class ThreadPool : public ThreadPoolInterface {
       LOCKS_EXCLUDED(mutex_) override;
 
  private:
-  void DoWork();
+  void DoWork(int nice_increment, const std::vector<int>& cpu_ids)
+      LOCKS_EXCLUDED(mutex_);
+  bool HasQueuedTask() const EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   void NotifyDependenciesCompleted(Task* task) LOCKS_EXCLUDED(mutex_) override;
 
   absl::Mutex mutex_;//互斥锁，保证线程安全
   bool running_ GUARDED_BY(mutex_) = true;
   std::vector<std::thread> pool_ GUARDED_BY(mutex_);
-  std::deque<std::shared_ptr<Task>> task_queue_ GUARDED_BY(mutex_);
+  // Ready tasks indexed by their priority.
+  std::vector<std::deque<std::shared_ptr<Task>>> task_queues_
+      GUARDED_BY(mutex_);
   absl::flat_hash_map<Task*, std::shared_ptr<Task>> tasks_not_ready_
       GUARDED_BY(mutex_);
 };
@@ -19,6 +19,7 @@
 #include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/synchronization/notification.h"
 #include "gtest/gtest.h"
 
 namespace cartographer {
@@ -172,6 +173,52 @@ TEST(ThreadPoolTest, RunWithFinishedDependency) {
   receiver.WaitForNumberSequence({1, 2});
 }
 
+TEST(ThreadPoolTest, RunsHigherPriorityFirst) {
+  ThreadPool pool(1);
+  Receiver receiver;
+  absl::Notification release;
+  auto blocking_task = absl::make_unique<Task>();
+  blocking_task->SetWorkItem([&receiver, &release]() {
+    receiver.Receive(0);
+    release.WaitForNotification();
+  });
+  pool.Schedule(std::move(blocking_task));
+  receiver.WaitForNumberSequence({0});
+  for (const Task::Priority priority :
+       {Task::LOW, Task::NORMAL, Task::HIGH, Task::LOW}) {
+    auto task = absl::make_unique<Task>();
+    task->SetPriority(priority);
+    EXPECT_EQ(priority, task->priority());
+    task->SetWorkItem([&receiver, priority]() { receiver.Receive(priority); });
+    pool.Schedule(std::move(task));
+  }
+  release.Notify();
+  receiver.WaitForNumberSequence(
+      {0, Task::HIGH, Task::NORMAL, Task::LOW, Task::LOW});
+}
+
+TEST(ThreadPoolTest, ConfiguredThreads) {
+  ThreadPool pool(2, 1 /* nice_increment */, {} /* cpu_ids */);
+  Receiver receiver;
+  auto task = absl::make_unique<Task>();
+  task->SetWorkItem([&receiver]() { receiver.Receive(1); });
+  pool.Schedule(std::move(task));
+  receiver.WaitForNumberSequence({1});
+}
+
+TEST(ThreadPoolTest, GroupCpuIdsByNumaNode) {
+  const std::vector<std::vector<int>> all_groups = GroupCpuIdsByNumaNode({});
+  for (const std::vector<int>& group : all_groups) {
+    EXPECT_FALSE(group.empty());
+  }
+  // Restricted to CPU 0, at most the node of CPU 0 remains.
+  const std::vector<std::vector<int>> groups = GroupCpuIdsByNumaNode({0});
+  EXPECT_LE(groups.size(), 1);
+  for (const std::vector<int>& group : groups) {
+    EXPECT_EQ(group, std::vector<int>{0});
+  }
+}
+
 }  // namespace
 }  // namespace common
 }  // namespace cartographer
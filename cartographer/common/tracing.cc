@@ -0,0 +1,159 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/common/tracing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+
+namespace cartographer {
+namespace common {
+namespace tracing {
+namespace {
+
+constexpr size_t kNumSpansPerThread = 1 << 14;
+
+int64 NowNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Chrome trace timestamps are in microseconds.
+std::string Microseconds(const int64 nanoseconds) {
+  return absl::StrFormat("%d.%03d", nanoseconds / 1000, nanoseconds % 1000);
+}
+
+// The latest spans of one thread. Only that thread adds spans, so the lock is
+// only contended while spans are read.
+class ThreadBuffer {
+ public:
+  explicit ThreadBuffer(const int thread_index)
+      : thread_index_(thread_index), spans_(kNumSpansPerThread) {}
+
+  void Add(Span span) LOCKS_EXCLUDED(mutex_) {
+    span.thread_index = thread_index_;
+    absl::MutexLock locker(&mutex_);
+    spans_[num_added_spans_ % kNumSpansPerThread] = span;
+    ++num_added_spans_;
+  }
+
+  void AppendTo(std::vector<Span>* const spans) const LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock locker(&mutex_);
+    const size_t num_spans = std::min(num_added_spans_, kNumSpansPerThread);
+    for (size_t i = num_added_spans_ - num_spans; i != num_added_spans_;
+         ++i) {
+      spans->push_back(spans_[i % kNumSpansPerThread]);
+    }
+  }
+
+  void Clear() LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock locker(&mutex_);
+    num_added_spans_ = 0;
+  }
+
+ private:
+  const int thread_index_;
+  mutable absl::Mutex mutex_;
+  std::vector<Span> spans_ GUARDED_BY(mutex_);
+  size_t num_added_spans_ GUARDED_BY(mutex_) = 0;
+};
+
+// The buffers of all threads that recorded spans. Buffers are kept after their
+// thread exited, so that its spans can still be read.
+class Registry {
+ public:
+  std::shared_ptr<ThreadBuffer> AddThreadBuffer() LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock locker(&mutex_);
+    thread_buffers_.push_back(
+        std::make_shared<ThreadBuffer>(thread_buffers_.size()));
+    return thread_buffers_.back();
+  }
+
+  std::vector<std::shared_ptr<ThreadBuffer>> GetThreadBuffers()
+      LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock locker(&mutex_);
+    return thread_buffers_;
+  }
+
+ private:
+  absl::Mutex mutex_;
+  std::vector<std::shared_ptr<ThreadBuffer>> thread_buffers_
+      GUARDED_BY(mutex_);
+};
+
+// Never destroyed, so that threads may record spans during static destruction.
+Registry* GetRegistry() {
+  static Registry* const registry = new Registry();
+  return registry;
+}
+
+ThreadBuffer* GetThreadBuffer() {
+  thread_local const std::shared_ptr<ThreadBuffer> thread_buffer =
+      GetRegistry()->AddThreadBuffer();
+  return thread_buffer.get();
+}
+
+}  // namespace
+
+ScopedSpan::ScopedSpan(const char* const name, const int64 id)
+    : name_(name), id_(id), start_ns_(NowNanoseconds()) {}
+
+ScopedSpan::~ScopedSpan() {
+  GetThreadBuffer()->Add(Span{name_, id_, start_ns_,
+                              NowNanoseconds() - start_ns_,
+                              -1 /* thread_index */});
+}
+
+std::vector<Span> GetSpans() {
+  std::vector<Span> spans;
+  for (const auto& thread_buffer : GetRegistry()->GetThreadBuffers()) {
+    thread_buffer->AppendTo(&spans);
+  }
+  std::stable_sort(spans.begin(), spans.end(),
+                   [](const Span& lhs, const Span& rhs) {
+                     return lhs.start_ns < rhs.start_ns;
+                   });
+  return spans;
+}
+
+void ClearSpans() {
+  for (const auto& thread_buffer : GetRegistry()->GetThreadBuffers()) {
+    thread_buffer->Clear();
+  }
+}
+
+void WriteChromeTrace(const std::vector<Span>& spans, std::ostream* const out) {
+  *out << "{\"traceEvents\":[";
+  for (size_t i = 0; i != spans.size(); ++i) {
+    const Span& span = spans[i];
+    *out << (i == 0 ? "\n" : ",\n") << "{\"name\":\"" << span.name
+         << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << span.thread_index
+         << ",\"ts\":" << Microseconds(span.start_ns)
+         << ",\"dur\":" << Microseconds(span.duration_ns)
+         << ",\"args\":{\"id\":" << span.id << "}}";
+  }
+  *out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+}  // namespace tracing
+}  // namespace common
+}  // namespace cartographer
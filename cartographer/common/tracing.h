@@ -0,0 +1,90 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_COMMON_TRACING_H_
+#define CARTOGRAPHER_COMMON_TRACING_H_
+
+#include <ostream>
+#include <vector>
+
+#include "cartographer/common/port.h"
+
+namespace cartographer {
+namespace common {
+namespace tracing {
+
+// A span of time in which one thread worked on a stage of the pipeline.
+struct Span {
+  // Must outlive all uses of the span, usually a string literal.
+  const char* name;
+  // Ties spans of different stages to the same data, e.g. the time of a scan
+  // in universal time scale ticks.
+  int64 id;
+  int64 start_ns;
+  int64 duration_ns;
+  // Index of the thread in the order threads started recording.
+  int thread_index;
+};
+
+// Records the span from its construction to its destruction into a ring
+// buffer of the calling thread, which keeps the latest spans. Recording takes
+// an uncontended lock, so it costs little compared to the stages it measures.
+//
+// Use CARTOGRAPHER_TRACE_SPAN instead, which is removed at compile time unless
+// CARTOGRAPHER_ENABLE_TRACING is defined.
+class ScopedSpan {
+ public:
+  ScopedSpan(const char* name, int64 id);
+  ~ScopedSpan();
+
+  ScopedSpan(const ScopedSpan&) = delete;
+  ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+ private:
+  const char* const name_;
+  const int64 id_;
+  const int64 start_ns_;
+};
+
+// Returns the spans of all threads which are still in the ring buffers,
+// ordered by their start.
+std::vector<Span> GetSpans();
+
+// Removes the spans of all threads.
+void ClearSpans();
+
+// Writes 'spans' in the JSON trace event format which chrome://tracing and
+// Perfetto open. Span names are written as is.
+void WriteChromeTrace(const std::vector<Span>& spans, std::ostream* out);
+
+}  // namespace tracing
+}  // namespace common
+}  // namespace cartographer
+
+#define CARTOGRAPHER_TRACE_CONCAT_INNER(a, b) a##b
+#define CARTOGRAPHER_TRACE_CONCAT(a, b) CARTOGRAPHER_TRACE_CONCAT_INNER(a, b)
+
+// Traces the rest of the enclosing scope as a span named 'name'. 'id' is not
+// evaluated unless tracing is enabled.
+#ifdef CARTOGRAPHER_ENABLE_TRACING
+#define CARTOGRAPHER_TRACE_SPAN(name, id)                  \
+  const ::cartographer::common::tracing::ScopedSpan        \
+  CARTOGRAPHER_TRACE_CONCAT(cartographer_trace_span_, __LINE__)(name, id)
+#else
+#define CARTOGRAPHER_TRACE_SPAN(name, id) static_cast<void>(0)
+#endif
+
+#endif  // CARTOGRAPHER_COMMON_TRACING_H_
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/common/tracing.h"
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace common {
+namespace tracing {
+namespace {
+
+TEST(TracingTest, RecordsSpansOfAllThreads) {
+  ClearSpans();
+  {
+    ScopedSpan outer_span("outer", 1);
+    std::thread thread([]() { ScopedSpan span("other_thread", 2); });
+    thread.join();
+  }
+  const std::vector<Span> spans = GetSpans();
+  ASSERT_EQ(spans.size(), 2);
+  EXPECT_EQ(std::string(spans[0].name), "outer");
+  EXPECT_EQ(spans[0].id, 1);
+  EXPECT_EQ(std::string(spans[1].name), "other_thread");
+  EXPECT_EQ(spans[1].id, 2);
+  EXPECT_NE(spans[0].thread_index, spans[1].thread_index);
+  EXPECT_LE(spans[0].start_ns, spans[1].start_ns);
+  EXPECT_GE(spans[0].start_ns + spans[0].duration_ns,
+            spans[1].start_ns + spans[1].duration_ns);
+  ClearSpans();
+  EXPECT_TRUE(GetSpans().empty());
+}
+
+TEST(TracingTest, KeepsLatestSpans) {
+  ClearSpans();
+  constexpr int kNumSpans = 100000;
+  for (int i = 0; i != kNumSpans; ++i) {
+    ScopedSpan span("span", i);
+  }
+  const std::vector<Span> spans = GetSpans();
+  ASSERT_FALSE(spans.empty());
+  ASSERT_LT(spans.size(), kNumSpans);
+  EXPECT_EQ(spans.back().id, kNumSpans - 1);
+  EXPECT_EQ(spans.front().id, kNumSpans - static_cast<int>(spans.size()));
+  ClearSpans();
+}
+
+TEST(TracingTest, WriteChromeTrace) {
+  std::ostringstream out;
+  WriteChromeTrace({Span{"stage", 42, 1234567, 5, 3}}, &out);
+  EXPECT_EQ(out.str(),
+            "{\"traceEvents\":[\n"
+            "{\"name\":\"stage\",\"ph\":\"X\",\"pid\":0,\"tid\":3,"
+            "\"ts\":1234.567,\"dur\":0.005,\"args\":{\"id\":42}}\n"
+            "],\"displayTimeUnit\":\"ms\"}\n");
+}
+
+TEST(TracingTest, MacroCompiles) {
+  int num_evaluations = 0;
+  {
+    CARTOGRAPHER_TRACE_SPAN("macro", ++num_evaluations);
+  }
+#ifdef CARTOGRAPHER_ENABLE_TRACING
+  EXPECT_EQ(num_evaluations, 1);
+#else
+  EXPECT_EQ(num_evaluations, 0);
+#endif
+}
+
+}  // namespace
+}  // namespace tracing
+}  // namespace common
+}  // namespace cartographer
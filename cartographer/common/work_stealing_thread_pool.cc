@@ -0,0 +1,210 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/common/work_stealing_thread_pool.h"
+
+#include <functional>
+
+#include "absl/memory/memory.h"
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace common {
+namespace {
+
+// The pool and queue of the calling thread, if it is a worker.
+thread_local const WorkStealingThreadPool* current_thread_pool = nullptr;
+thread_local int current_worker_index = -1;
+
+}  // namespace
+
+constexpr int WorkStealingThreadPool::kNumNotReadyShards;
+
+WorkStealingThreadPool::WorkStealingThreadPool(const int num_threads)
+    : WorkStealingThreadPool(num_threads, 10 /* nice_increment */,
+                             std::vector<int>() /* cpu_ids */) {}
+
+WorkStealingThreadPool::WorkStealingThreadPool(
+    const int num_threads, const int nice_increment,
+    const std::vector<int>& cpu_ids)
+    : WorkStealingThreadPool(num_threads, nice_increment,
+                             std::vector<std::vector<int>>{cpu_ids}) {}
+
+WorkStealingThreadPool::WorkStealingThreadPool(
+    const int num_threads, const int nice_increment,
+    const std::vector<std::vector<int>>& worker_group_cpu_ids) {
+  CHECK_GT(num_threads, 0);
+  const int num_groups = worker_group_cpu_ids.size();
+  CHECK_GT(num_groups, 0);
+  CHECK_LE(num_groups, num_threads);
+  for (int i = 0; i != num_threads; ++i) {
+    worker_queues_.push_back(absl::make_unique<WorkerQueue>());
+  }
+  for (int group = 0; group != num_groups; ++group) {
+    worker_groups_.push_back(absl::make_unique<WorkerGroup>());
+  }
+  for (int i = 0; i != num_threads; ++i) {
+    const int group = i * num_groups / num_threads;
+    worker_groups_[group]->worker_indices.push_back(i);
+    worker_group_of_worker_.push_back(group);
+  }
+  for (int i = 0; i != num_threads; ++i) {
+    std::vector<int> queue_order;
+    for (int j = 0; j != num_groups; ++j) {
+      const std::vector<int>& group_worker_indices =
+          worker_groups_[(worker_group_of_worker_[i] + j) % num_groups]
+              ->worker_indices;
+      const int offset = j == 0 ? i - group_worker_indices.front() : 0;
+      for (size_t k = 0; k != group_worker_indices.size(); ++k) {
+        queue_order.push_back(
+            group_worker_indices[(offset + k) % group_worker_indices.size()]);
+      }
+    }
+    worker_queue_orders_.push_back(std::move(queue_order));
+  }
+  for (int i = 0; i != num_threads; ++i) {
+    const std::vector<int>& cpu_ids =
+        worker_group_cpu_ids[worker_group_of_worker_[i]];
+    threads_.emplace_back([this, i, nice_increment, cpu_ids]() {
+      DoWork(i, nice_increment, cpu_ids);
+    });
+  }
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool() {
+  CHECK(running_.exchange(false));
+  {
+    // Wakes the idle workers, which re-evaluate their condition on unlock.
+    absl::MutexLock locker(&idle_mutex_);
+  }
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+std::weak_ptr<Task> WorkStealingThreadPool::Schedule(
+    std::unique_ptr<Task> task) {
+  std::shared_ptr<Task> shared_task;
+  {
+    NotReadyShard& shard = GetNotReadyShard(task.get());
+    absl::MutexLock locker(&shard.mutex);
+    Task* const task_pointer = task.get();
+    auto insert_result = shard.tasks.insert(
+        std::make_pair(task_pointer, ToSharedTask(std::move(task))));
+    CHECK(insert_result.second) << "Schedule called twice";
+    shared_task = insert_result.first->second;
+  }
+  SetThreadPool(shared_task.get());
+  return shared_task;
+}
+
+void WorkStealingThreadPool::NotifyDependenciesCompleted(Task* task) {
+  std::shared_ptr<Task> shared_task;
+  {
+    NotReadyShard& shard = GetNotReadyShard(task);
+    absl::MutexLock locker(&shard.mutex);
+    auto it = shard.tasks.find(task);
+    CHECK(it != shard.tasks.end());
+    shared_task = std::move(it->second);
+    shard.tasks.erase(it);
+  }
+  Enqueue(std::move(shared_task));
+}
+
+WorkStealingThreadPool::NotReadyShard&
+WorkStealingThreadPool::GetNotReadyShard(const Task* task) {
+  return not_ready_shards_[std::hash<const Task*>()(task) %
+                           kNumNotReadyShards];
+}
+
+void WorkStealingThreadPool::Enqueue(std::shared_ptr<Task> task) {
+  const bool on_worker = current_thread_pool == this;
+  int worker_index;
+  if (task->affinity() != Task::kNoAffinity && worker_groups_.size() > 1) {
+    const int group = task->affinity() % worker_groups_.size();
+    if (on_worker && worker_group_of_worker_[current_worker_index] == group) {
+      worker_index = current_worker_index;
+    } else {
+      WorkerGroup& worker_group = *worker_groups_[group];
+      worker_index =
+          worker_group.worker_indices[worker_group.next_worker.fetch_add(1) %
+                                      worker_group.worker_indices.size()];
+    }
+  } else {
+    worker_index = on_worker
+                       ? current_worker_index
+                       : next_worker_queue_.fetch_add(1) % worker_queues_.size();
+  }
+  {
+    WorkerQueue& queue = *worker_queues_[worker_index];
+    absl::MutexLock locker(&queue.mutex);
+    queue.tasks[task->priority()].push_back(std::move(task));
+  }
+  // Pairs with the order in DoWork(): Either the idle worker sees the queued
+  // task, or it is counted here and woken.
+  num_queued_tasks_.fetch_add(1);
+  if (num_idle_workers_.load() > 0) {
+    absl::MutexLock locker(&idle_mutex_);
+  }
+}
+
+std::shared_ptr<Task> WorkStealingThreadPool::TakeTask(
+    const int worker_index) {
+  for (const int queue_index : worker_queue_orders_[worker_index]) {
+    WorkerQueue& queue = *worker_queues_[queue_index];
+    absl::MutexLock locker(&queue.mutex);
+    for (auto tasks = queue.tasks.rbegin(); tasks != queue.tasks.rend();
+         ++tasks) {
+      if (!tasks->empty()) {
+        std::shared_ptr<Task> task = std::move(tasks->front());
+        tasks->pop_front();
+        num_queued_tasks_.fetch_sub(1);
+        return task;
+      }
+    }
+  }
+  return nullptr;
+}
+
+void WorkStealingThreadPool::DoWork(const int worker_index,
+                                    const int nice_increment,
+                                    const std::vector<int>& cpu_ids) {
+  ConfigureBackgroundThread(nice_increment, cpu_ids);
+  current_thread_pool = this;
+  current_worker_index = worker_index;
+  const auto predicate = [this]() {
+    return num_queued_tasks_.load() > 0 || !running_.load();
+  };
+  for (;;) {
+    std::shared_ptr<Task> task = TakeTask(worker_index);
+    if (task != nullptr) {
+      CHECK_EQ(task->GetState(), common::Task::DEPENDENCIES_COMPLETED);
+      Execute(task.get());
+      continue;
+    }
+    absl::MutexLock locker(&idle_mutex_);
+    num_idle_workers_.fetch_add(1);
+    idle_mutex_.Await(absl::Condition(&predicate));
+    num_idle_workers_.fetch_sub(1);
+    // The queues are drained before stopping, like in 'ThreadPool'.
+    if (!running_.load() && num_queued_tasks_.load() <= 0) {
+      return;
+    }
+  }
+}
+
+}  // namespace common
+}  // namespace cartographer
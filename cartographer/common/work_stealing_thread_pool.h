@@ -0,0 +1,126 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_COMMON_WORK_STEALING_THREAD_POOL_H_
+#define CARTOGRAPHER_COMMON_WORK_STEALING_THREAD_POOL_H_
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "cartographer/common/task.h"
+#include "cartographer/common/thread_pool.h"
+
+namespace cartographer {
+namespace common {
+
+// A thread pool with the same semantics as 'ThreadPool', for many small tasks.
+//
+// Each thread has its own queue of tasks whose dependencies are completed.
+// Tasks which become ready on one of the threads, e.g. when a dependency has
+// just finished there, are queued to that thread, other tasks are spread
+// round-robin. Threads without queued tasks take the oldest task of another
+// queue. Tasks waiting for dependencies are kept in sharded maps. This way,
+// threads rarely wait for the same lock, and idle threads are only woken
+// through a shared mutex while there are any.
+//
+// Tasks of one queue run by priority and then in the order they became ready,
+// but there is no global order between the queues.
+//
+// The threads may be split into groups, e.g. one per NUMA node. Tasks with an
+// affinity, see Task::SetAffinity(), are then queued to a thread of the group
+// selected by their affinity, and threads take tasks from their own group
+// before taking them from other groups.
+class WorkStealingThreadPool : public ThreadPoolInterface {
+ public:
+  // The threads are niced by 10 and may run on all CPUs.
+  explicit WorkStealingThreadPool(int num_threads);
+  // The threads are configured using ConfigureBackgroundThread().
+  WorkStealingThreadPool(int num_threads, int nice_increment,
+                         const std::vector<int>& cpu_ids);
+  // The threads are split evenly into one group per entry of
+  // 'worker_group_cpu_ids' and configured using ConfigureBackgroundThread()
+  // with the CPUs of their group. There must not be more groups than threads.
+  WorkStealingThreadPool(
+      int num_threads, int nice_increment,
+      const std::vector<std::vector<int>>& worker_group_cpu_ids);
+  ~WorkStealingThreadPool();
+
+  WorkStealingThreadPool(const WorkStealingThreadPool&) = delete;
+  WorkStealingThreadPool& operator=(const WorkStealingThreadPool&) = delete;
+
+  // When the returned weak pointer is expired, 'task' has certainly completed,
+  // so dependants no longer need to add it as a dependency.
+  std::weak_ptr<Task> Schedule(std::unique_ptr<Task> task) override;
+
+ private:
+  static constexpr int kNumNotReadyShards = 16;
+
+  struct WorkerQueue {
+    absl::Mutex mutex;
+    // Indexed by the priority of the tasks.
+    std::array<std::deque<std::shared_ptr<Task>>, Task::kNumPriorities> tasks
+        GUARDED_BY(mutex);
+  };
+
+  struct NotReadyShard {
+    absl::Mutex mutex;
+    absl::flat_hash_map<Task*, std::shared_ptr<Task>> tasks GUARDED_BY(mutex);
+  };
+
+  struct WorkerGroup {
+    // Indices of the workers in this group.
+    std::vector<int> worker_indices;
+    std::atomic<unsigned> next_worker{0};
+  };
+
+  void DoWork(int worker_index, int nice_increment,
+              const std::vector<int>& cpu_ids) LOCKS_EXCLUDED(idle_mutex_);
+  // Returns the next task of 'worker_index' or one taken from another worker,
+  // or nullptr if all queues are empty.
+  std::shared_ptr<Task> TakeTask(int worker_index);
+  void Enqueue(std::shared_ptr<Task> task) LOCKS_EXCLUDED(idle_mutex_);
+  NotReadyShard& GetNotReadyShard(const Task* task);
+
+  void NotifyDependenciesCompleted(Task* task) override;
+
+  std::vector<std::unique_ptr<WorkerQueue>> worker_queues_;
+  std::vector<std::unique_ptr<WorkerGroup>> worker_groups_;
+  std::vector<int> worker_group_of_worker_;
+  // For each worker, the order in which it looks at the queues: its own
+  // queue, then the other queues of its group, then those of other groups.
+  std::vector<std::vector<int>> worker_queue_orders_;
+  std::array<NotReadyShard, kNumNotReadyShards> not_ready_shards_;
+  std::atomic<unsigned> next_worker_queue_{0};
+  // Tasks in all 'worker_queues_', may briefly be off by the tasks being
+  // queued or taken.
+  std::atomic<int> num_queued_tasks_{0};
+  std::atomic<int> num_idle_workers_{0};
+  std::atomic<bool> running_{true};
+  // Idle workers wait on this mutex, it is only taken to wake them.
+  absl::Mutex idle_mutex_;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace common
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_COMMON_WORK_STEALING_THREAD_POOL_H_
@@ -0,0 +1,214 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/common/work_stealing_thread_pool.h"
+
+#include <atomic>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace common {
+namespace {
+
+class Receiver {
+ public:
+  void Receive(int number) {
+    absl::MutexLock locker(&mutex_);
+    received_numbers_.push_back(number);
+  }
+
+  void WaitForNumberSequence(const std::vector<int>& expected_numbers) {
+    const auto predicate =
+        [this, &expected_numbers]() EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+          return (received_numbers_.size() >= expected_numbers.size());
+        };
+    absl::MutexLock locker(&mutex_);
+    mutex_.Await(absl::Condition(&predicate));
+    EXPECT_EQ(expected_numbers, received_numbers_);
+  }
+
+  absl::Mutex mutex_;
+  std::vector<int> received_numbers_ GUARDED_BY(mutex_);
+};
+
+TEST(WorkStealingThreadPoolTest, RunTask) {
+  WorkStealingThreadPool pool(1);
+  Receiver receiver;
+  auto task = absl::make_unique<Task>();
+  task->SetWorkItem([&receiver]() { receiver.Receive(1); });
+  pool.Schedule(std::move(task));
+  receiver.WaitForNumberSequence({1});
+}
+
+TEST(WorkStealingThreadPoolTest, ManyTasks) {
+  for (int a = 0; a < 5; ++a) {
+    WorkStealingThreadPool pool(3);
+    Receiver receiver;
+    int kNumTasks = 10;
+    for (int i = 0; i < kNumTasks; ++i) {
+      auto task = absl::make_unique<Task>();
+      task->SetWorkItem([&receiver]() { receiver.Receive(1); });
+      pool.Schedule(std::move(task));
+    }
+    receiver.WaitForNumberSequence(std::vector<int>(kNumTasks, 1));
+  }
+}
+
+TEST(WorkStealingThreadPoolTest, RunWithMultipleDependencies) {
+  WorkStealingThreadPool pool(2);
+  Receiver receiver;
+  auto task_1 = absl::make_unique<Task>();
+  task_1->SetWorkItem([&receiver]() { receiver.Receive(1); });
+  auto task_2a = absl::make_unique<Task>();
+  task_2a->SetWorkItem([&receiver]() { receiver.Receive(2); });
+  auto task_2b = absl::make_unique<Task>();
+  task_2b->SetWorkItem([&receiver]() { receiver.Receive(2); });
+  auto task_3 = absl::make_unique<Task>();
+  task_3->SetWorkItem([&receiver]() { receiver.Receive(3); });
+  /*          -> task_2a \
+   *  task_1 /-> task_2b --> task_3
+   */
+  auto weak_task_1 = pool.Schedule(std::move(task_1));
+  task_2a->AddDependency(weak_task_1);
+  auto weak_task_2a = pool.Schedule(std::move(task_2a));
+  task_3->AddDependency(weak_task_1);
+  task_3->AddDependency(weak_task_2a);
+  task_2b->AddDependency(weak_task_1);
+  auto weak_task_2b = pool.Schedule(std::move(task_2b));
+  task_3->AddDependency(weak_task_2b);
+  pool.Schedule(std::move(task_3));
+  receiver.WaitForNumberSequence({1, 2, 2, 3});
+}
+
+TEST(WorkStealingThreadPoolTest, RunWithFinishedDependency) {
+  WorkStealingThreadPool pool(2);
+  Receiver receiver;
+  auto task_1 = absl::make_unique<Task>();
+  task_1->SetWorkItem([&receiver]() { receiver.Receive(1); });
+  auto task_2 = absl::make_unique<Task>();
+  task_2->SetWorkItem([&receiver]() { receiver.Receive(2); });
+  auto weak_task_1 = pool.Schedule(std::move(task_1));
+  task_2->AddDependency(weak_task_1);
+  receiver.WaitForNumberSequence({1});
+  pool.Schedule(std::move(task_2));
+  receiver.WaitForNumberSequence({1, 2});
+}
+
+// Tasks scheduling more tasks from the worker threads, each waiting for a
+// task which is scheduled from the outside.
+TEST(WorkStealingThreadPoolTest, TasksScheduledByTasks) {
+  constexpr int kNumTasks = 1000;
+  WorkStealingThreadPool pool(4);
+  std::atomic<int> num_executed{0};
+  Receiver receiver;
+  for (int i = 0; i < kNumTasks; ++i) {
+    auto dependency_task = absl::make_unique<Task>();
+    dependency_task->SetWorkItem([&num_executed]() { ++num_executed; });
+    const std::weak_ptr<Task> dependency_handle =
+        pool.Schedule(std::move(dependency_task));
+    auto task = absl::make_unique<Task>();
+    task->SetWorkItem(
+        [&pool, &num_executed, &receiver, dependency_handle]() {
+          // Counted first, so that the last task to run is a dependent one.
+          ++num_executed;
+          auto dependent_task = absl::make_unique<Task>();
+          dependent_task->AddDependency(dependency_handle);
+          dependent_task->SetWorkItem([&num_executed, &receiver]() {
+            if (++num_executed == 3 * kNumTasks) {
+              receiver.Receive(1);
+            }
+          });
+          pool.Schedule(std::move(dependent_task));
+        });
+    pool.Schedule(std::move(task));
+  }
+  receiver.WaitForNumberSequence({1});
+  EXPECT_EQ(num_executed, 3 * kNumTasks);
+}
+
+TEST(WorkStealingThreadPoolTest, RunsHigherPriorityFirst) {
+  WorkStealingThreadPool pool(1);
+  Receiver receiver;
+  absl::Notification release;
+  auto blocking_task = absl::make_unique<Task>();
+  blocking_task->SetWorkItem([&receiver, &release]() {
+    receiver.Receive(0);
+    release.WaitForNotification();
+  });
+  pool.Schedule(std::move(blocking_task));
+  receiver.WaitForNumberSequence({0});
+  for (const Task::Priority priority :
+       {Task::LOW, Task::NORMAL, Task::HIGH, Task::LOW}) {
+    auto task = absl::make_unique<Task>();
+    task->SetPriority(priority);
+    EXPECT_EQ(priority, task->priority());
+    task->SetWorkItem([&receiver, priority]() { receiver.Receive(priority); });
+    pool.Schedule(std::move(task));
+  }
+  release.Notify();
+  receiver.WaitForNumberSequence(
+      {0, Task::HIGH, Task::NORMAL, Task::LOW, Task::LOW});
+}
+
+TEST(WorkStealingThreadPoolTest, ConfiguredThreads) {
+  WorkStealingThreadPool pool(2, 1 /* nice_increment */,
+                              std::vector<int>() /* cpu_ids */);
+  Receiver receiver;
+  auto task = absl::make_unique<Task>();
+  task->SetWorkItem([&receiver]() { receiver.Receive(1); });
+  pool.Schedule(std::move(task));
+  receiver.WaitForNumberSequence({1});
+}
+
+TEST(WorkStealingThreadPoolTest, WorkerGroups) {
+  WorkStealingThreadPool pool(4, 0 /* nice_increment */,
+                              std::vector<std::vector<int>>(2));
+  Receiver receiver;
+  for (int i = 0; i != 10; ++i) {
+    auto task = absl::make_unique<Task>();
+    if (i % 3 != 0) task->SetAffinity(i);
+    task->SetWorkItem([&receiver]() { receiver.Receive(1); });
+    pool.Schedule(std::move(task));
+  }
+  receiver.WaitForNumberSequence(std::vector<int>(10, 1));
+}
+
+TEST(WorkStealingThreadPoolTest, TasksWithAffinityScheduledByTasks) {
+  WorkStealingThreadPool pool(3, 0 /* nice_increment */,
+                              std::vector<std::vector<int>>(3));
+  Receiver receiver;
+  auto task = absl::make_unique<Task>();
+  task->SetAffinity(0);
+  task->SetWorkItem([&pool, &receiver]() {
+    for (int affinity = 0; affinity != 6; ++affinity) {
+      auto inner_task = absl::make_unique<Task>();
+      inner_task->SetAffinity(affinity);
+      inner_task->SetWorkItem([&receiver]() { receiver.Receive(1); });
+      pool.Schedule(std::move(inner_task));
+    }
+  });
+  pool.Schedule(std::move(task));
+  receiver.WaitForNumberSequence(std::vector<int>(6, 1));
+}
+
+}  // namespace
+}  // namespace common
+}  // namespace cartographer
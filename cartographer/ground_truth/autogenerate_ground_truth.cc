@@ -16,9 +16,12 @@
 
 #include "cartographer/ground_truth/autogenerate_ground_truth.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
+#include "cartographer/common/parallel_for.h"
+#include "cartographer/common/thread_pool.h"
 #include "cartographer/mapping/proto/trajectory.pb.h"
 #include "cartographer/transform/transform.h"
 #include "glog/logging.h"
@@ -70,12 +73,89 @@ std::vector<int> ComputeSubmapRepresentativeNode(
   return submap_to_node_index;
 }
 
+// Number of constraints evaluated by one task at a time.
+constexpr int kNumConstraintsPerChunk = 1024;
+
+struct ConstraintEvaluation {
+  enum class Result { kSkipped, kOutlier, kRelation };
+  Result result = Result::kSkipped;
+  // Only set if 'result' is kRelation.
+  proto::Relation relation;
+};
+
+ConstraintEvaluation EvaluateConstraint(
+    const mapping::proto::PoseGraph::Constraint& constraint,
+    const mapping::proto::Trajectory& trajectory,
+    const std::vector<double>& covered_distance,
+    const std::vector<int>& submap_to_node_index,
+    const double min_covered_distance, const double outlier_threshold_meters,
+    const double outlier_threshold_radians) {
+  ConstraintEvaluation evaluation;
+  // We're only interested in loop closure constraints.
+  if (constraint.tag() == mapping::proto::PoseGraph::Constraint::INTRA_SUBMAP) {
+    return evaluation;
+  }
+
+  // For some submaps at the very end, we have not chosen a representative
+  // node, but those should not be part of loop closure anyway.
+  CHECK_EQ(constraint.submap_id().trajectory_id(), 0);
+  CHECK_EQ(constraint.node_id().trajectory_id(), 0);
+  if (constraint.submap_id().submap_index() >=
+      static_cast<int>(submap_to_node_index.size())) {
+    return evaluation;
+  }
+  const int matched_node = constraint.node_id().node_index();
+  const int representative_node =
+      submap_to_node_index.at(constraint.submap_id().submap_index());
+
+  // Covered distance between the two should not be too small.
+  double covered_distance_in_constraint =
+      std::abs(covered_distance.at(matched_node) -
+               covered_distance.at(representative_node));
+  if (covered_distance_in_constraint < min_covered_distance) {
+    return evaluation;
+  }
+
+  // Compute the transform between the nodes according to the solution and
+  // the constraint.
+  const transform::Rigid3d solution_pose1 =
+      transform::ToRigid3(trajectory.node(representative_node).pose());
+  const transform::Rigid3d solution_pose2 =
+      transform::ToRigid3(trajectory.node(matched_node).pose());
+  const transform::Rigid3d solution = solution_pose1.inverse() * solution_pose2;
+
+  const transform::Rigid3d submap_solution = transform::ToRigid3(
+      trajectory.submap(constraint.submap_id().submap_index()).pose());
+  const transform::Rigid3d submap_solution_to_node_solution =
+      solution_pose1.inverse() * submap_solution;
+  const transform::Rigid3d node_to_submap_constraint =
+      transform::ToRigid3(constraint.relative_pose());
+  const transform::Rigid3d expected =
+      submap_solution_to_node_solution * node_to_submap_constraint;
+
+  const transform::Rigid3d error = solution * expected.inverse();
+
+  if (error.translation().norm() > outlier_threshold_meters ||
+      transform::GetAngle(error) > outlier_threshold_radians) {
+    evaluation.result = ConstraintEvaluation::Result::kOutlier;
+    return evaluation;
+  }
+  evaluation.result = ConstraintEvaluation::Result::kRelation;
+  evaluation.relation.set_timestamp1(
+      trajectory.node(representative_node).timestamp());
+  evaluation.relation.set_timestamp2(trajectory.node(matched_node).timestamp());
+  *evaluation.relation.mutable_expected() = transform::ToProto(expected);
+  evaluation.relation.set_covered_distance(covered_distance_in_constraint);
+  return evaluation;
+}
+
 }  // namespace
 
 proto::GroundTruth GenerateGroundTruth(
     const mapping::proto::PoseGraph& pose_graph,
     const double min_covered_distance, const double outlier_threshold_meters,
-    const double outlier_threshold_radians) {
+    const double outlier_threshold_radians, const int num_threads) {
+  CHECK_GT(num_threads, 0);
   const mapping::proto::Trajectory& trajectory = pose_graph.trajectory(0);
   const std::vector<double> covered_distance =
       ComputeCoveredDistance(trajectory);
@@ -83,66 +163,38 @@ proto::GroundTruth GenerateGroundTruth(
   const std::vector<int> submap_to_node_index =
       ComputeSubmapRepresentativeNode(pose_graph);
 
+  // Constraints are evaluated in parallel, each into its own entry, and then
+  // collected in order, so the output does not depend on 'num_threads'.
+  const int num_constraints = pose_graph.constraint_size();
+  std::vector<ConstraintEvaluation> evaluations(num_constraints);
+  common::ThreadPool thread_pool(num_threads);
+  common::ParallelFor(
+      (num_constraints + kNumConstraintsPerChunk - 1) / kNumConstraintsPerChunk,
+      num_threads, &thread_pool, [&](const int chunk_index) {
+        const int begin = chunk_index * kNumConstraintsPerChunk;
+        const int end =
+            std::min(begin + kNumConstraintsPerChunk, num_constraints);
+        for (int i = begin; i < end; ++i) {
+          evaluations[i] = EvaluateConstraint(
+              pose_graph.constraint(i), trajectory, covered_distance,
+              submap_to_node_index, min_covered_distance,
+              outlier_threshold_meters, outlier_threshold_radians);
+        }
+      });
+
   int num_outliers = 0;
   proto::GroundTruth ground_truth;
-  for (const auto& constraint : pose_graph.constraint()) {
-    // We're only interested in loop closure constraints.
-    if (constraint.tag() ==
-        mapping::proto::PoseGraph::Constraint::INTRA_SUBMAP) {
-      continue;
-    }
-
-    // For some submaps at the very end, we have not chosen a representative
-    // node, but those should not be part of loop closure anyway.
-    CHECK_EQ(constraint.submap_id().trajectory_id(), 0);
-    CHECK_EQ(constraint.node_id().trajectory_id(), 0);
-    if (constraint.submap_id().submap_index() >=
-        static_cast<int>(submap_to_node_index.size())) {
-      continue;
-    }
-    const int matched_node = constraint.node_id().node_index();
-    const int representative_node =
-        submap_to_node_index.at(constraint.submap_id().submap_index());
-
-    // Covered distance between the two should not be too small.
-    double covered_distance_in_constraint =
-        std::abs(covered_distance.at(matched_node) -
-                 covered_distance.at(representative_node));
-    if (covered_distance_in_constraint < min_covered_distance) {
-      continue;
-    }
-
-    // Compute the transform between the nodes according to the solution and
-    // the constraint.
-    const transform::Rigid3d solution_pose1 =
-        transform::ToRigid3(trajectory.node(representative_node).pose());
-    const transform::Rigid3d solution_pose2 =
-        transform::ToRigid3(trajectory.node(matched_node).pose());
-    const transform::Rigid3d solution =
-        solution_pose1.inverse() * solution_pose2;
-
-    const transform::Rigid3d submap_solution = transform::ToRigid3(
-        trajectory.submap(constraint.submap_id().submap_index()).pose());
-    const transform::Rigid3d submap_solution_to_node_solution =
-        solution_pose1.inverse() * submap_solution;
-    const transform::Rigid3d node_to_submap_constraint =
-        transform::ToRigid3(constraint.relative_pose());
-    const transform::Rigid3d expected =
-        submap_solution_to_node_solution * node_to_submap_constraint;
-
-    const transform::Rigid3d error = solution * expected.inverse();
-
-    if (error.translation().norm() > outlier_threshold_meters ||
-        transform::GetAngle(error) > outlier_threshold_radians) {
-      ++num_outliers;
-      continue;
+  for (ConstraintEvaluation& evaluation : evaluations) {
+    switch (evaluation.result) {
+      case ConstraintEvaluation::Result::kSkipped:
+        break;
+      case ConstraintEvaluation::Result::kOutlier:
+        ++num_outliers;
+        break;
+      case ConstraintEvaluation::Result::kRelation:
+        ground_truth.add_relation()->Swap(&evaluation.relation);
+        break;
     }
-    auto* const new_relation = ground_truth.add_relation();
-    new_relation->set_timestamp1(
-        trajectory.node(representative_node).timestamp());
-    new_relation->set_timestamp2(trajectory.node(matched_node).timestamp());
-    *new_relation->mutable_expected() = transform::ToProto(expected);
-    new_relation->set_covered_distance(covered_distance_in_constraint);
   }
   LOG(INFO) << "Generated " << ground_truth.relation_size()
             << " relations and ignored " << num_outliers << " outliers.";
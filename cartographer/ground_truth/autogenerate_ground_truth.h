@@ -26,10 +26,11 @@ namespace ground_truth {
 // Generates GroundTruth proto from the given pose graph using the specified
 // criteria parameters. See
 // 'https://google-cartographer.readthedocs.io/en/latest/evaluation.html' for
-// more details.
+// more details. Constraints are evaluated on 'num_threads' threads.
 proto::GroundTruth GenerateGroundTruth(
     const mapping::proto::PoseGraph& pose_graph, double min_covered_distance,
-    double outlier_threshold_meters, double outlier_threshold_radians);
+    double outlier_threshold_meters, double outlier_threshold_radians,
+    int num_threads = 1);
 
 }  // namespace ground_truth
 }  // namespace cartographer
@@ -41,6 +41,8 @@ DEFINE_double(outlier_threshold_meters, 0.15,
 DEFINE_double(outlier_threshold_radians, 0.02,
               "Distance in radians beyond which constraints are considered "
               "outliers.");
+DEFINE_int32(num_threads, 4,
+             "Number of threads evaluating the constraints of the pose graph.");
 
 namespace cartographer {
 namespace ground_truth {
@@ -49,7 +51,7 @@ namespace {
 void Run(const std::string& pose_graph_filename,
          const std::string& output_filename, const double min_covered_distance,
          const double outlier_threshold_meters,
-         const double outlier_threshold_radians) {
+         const double outlier_threshold_radians, const int num_threads) {
   LOG(INFO) << "Reading pose graph from '" << pose_graph_filename << "'...";
   mapping::proto::PoseGraph pose_graph =
       io::DeserializePoseGraphFromFile(pose_graph_filename);
@@ -57,7 +59,8 @@ void Run(const std::string& pose_graph_filename,
   LOG(INFO) << "Autogenerating ground truth relations...";
   const proto::GroundTruth ground_truth =
       GenerateGroundTruth(pose_graph, min_covered_distance,
-                          outlier_threshold_meters, outlier_threshold_radians);
+                          outlier_threshold_meters, outlier_threshold_radians,
+                          num_threads);
   LOG(INFO) << "Writing " << ground_truth.relation_size() << " relations to '"
             << output_filename << "'.";
   {
@@ -98,5 +101,5 @@ int main(int argc, char** argv) {
   ::cartographer::ground_truth::Run(
       FLAGS_pose_graph_filename, FLAGS_output_filename,
       FLAGS_min_covered_distance, FLAGS_outlier_threshold_meters,
-      FLAGS_outlier_threshold_radians);
+      FLAGS_outlier_threshold_radians, FLAGS_num_threads);
 }
@@ -24,7 +24,9 @@
 #include <vector>
 
 #include "cartographer/common/math.h"
+#include "cartographer/common/parallel_for.h"
 #include "cartographer/common/port.h"
+#include "cartographer/common/thread_pool.h"
 #include "cartographer/ground_truth/proto/relations.pb.h"
 #include "cartographer/ground_truth/relations_text_file.h"
 #include "cartographer/io/proto_stream.h"
@@ -47,11 +49,15 @@ DEFINE_bool(read_text_file_with_unix_timestamps, false,
 DEFINE_bool(write_relation_metrics, false,
             "Enable exporting relation metrics as comma-separated values to "
             "[pose_graph_filename].relation_metrics.csv");
+DEFINE_int32(num_threads, 4, "Number of threads evaluating the relations.");
 
 namespace cartographer {
 namespace ground_truth {
 namespace {
 
+// Number of relations evaluated by one task at a time.
+constexpr int kNumRelationsPerChunk = 1024;
+
 struct Error {
   double translational_squared;
   double rotational_squared;
@@ -171,7 +177,8 @@ transform::Rigid3d LookupTransform(
 void Run(const std::string& pose_graph_filename,
          const std::string& relations_filename,
          const bool read_text_file_with_unix_timestamps,
-         const bool write_relation_metrics) {
+         const bool write_relation_metrics, const int num_threads) {
+  CHECK_GT(num_threads, 0);
   LOG(INFO) << "Reading pose graph from '" << pose_graph_filename << "'...";
   mapping::proto::PoseGraph pose_graph =
       io::DeserializePoseGraphFromFile(pose_graph_filename);
@@ -190,18 +197,29 @@ void Run(const std::string& pose_graph_filename,
     CHECK(ground_truth.ParseFromIstream(&ground_truth_stream));
   }
 
-  std::vector<Error> errors;
-  for (const auto& relation : ground_truth.relation()) {
-    const auto pose1 =
-        LookupTransform(transform_interpolation_buffer,
-                        common::FromUniversal(relation.timestamp1()));
-    const auto pose2 =
-        LookupTransform(transform_interpolation_buffer,
-                        common::FromUniversal(relation.timestamp2()));
-    const transform::Rigid3d expected =
-        transform::ToRigid3(relation.expected());
-    errors.push_back(ComputeError(pose1, pose2, expected));
-  }
+  // Each relation is evaluated into its own entry, so that the errors keep the
+  // order of the relations.
+  const int num_relations = ground_truth.relation_size();
+  std::vector<Error> errors(num_relations);
+  common::ThreadPool thread_pool(num_threads);
+  common::ParallelFor(
+      (num_relations + kNumRelationsPerChunk - 1) / kNumRelationsPerChunk,
+      num_threads, &thread_pool, [&](const int chunk_index) {
+        const int begin = chunk_index * kNumRelationsPerChunk;
+        const int end = std::min(begin + kNumRelationsPerChunk, num_relations);
+        for (int i = begin; i < end; ++i) {
+          const proto::Relation& relation = ground_truth.relation(i);
+          const auto pose1 =
+              LookupTransform(transform_interpolation_buffer,
+                              common::FromUniversal(relation.timestamp1()));
+          const auto pose2 =
+              LookupTransform(transform_interpolation_buffer,
+                              common::FromUniversal(relation.timestamp2()));
+          const transform::Rigid3d expected =
+              transform::ToRigid3(relation.expected());
+          errors[i] = ComputeError(pose1, pose2, expected);
+        }
+      });
 
   const std::string relation_metrics_filename =
       pose_graph_filename + ".relation_metrics.csv";
@@ -234,5 +252,6 @@ int main(int argc, char** argv) {
 
   ::cartographer::ground_truth::Run(
       FLAGS_pose_graph_filename, FLAGS_relations_filename,
-      FLAGS_read_text_file_with_unix_timestamps, FLAGS_write_relation_metrics);
+      FLAGS_read_text_file_with_unix_timestamps, FLAGS_write_relation_metrics,
+      FLAGS_num_threads);
 }
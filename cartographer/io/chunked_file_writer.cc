@@ -0,0 +1,210 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/io/chunked_file_writer.h"
+
+#include <algorithm>
+
+#include "boost/iostreams/device/back_inserter.hpp"
+#include "boost/iostreams/filter/gzip.hpp"
+#include "boost/iostreams/filtering_stream.hpp"
+#include "cartographer/common/port.h"
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace io {
+namespace {
+
+std::string GzipWithoutCompression(const char* const data, const size_t len) {
+  std::string result;
+  {
+    boost::iostreams::filtering_ostream out;
+    out.push(boost::iostreams::gzip_compressor(
+        boost::iostreams::gzip_params(boost::iostreams::zlib::no_compression)));
+    out.push(boost::iostreams::back_inserter(result));
+    boost::iostreams::write(out, data, len);
+  }
+  return result;
+}
+
+}  // namespace
+
+ChunkedFileWriter::ChunkedFileWriter(std::unique_ptr<FileWriter> file_writer,
+                                     const Options& options)
+    : options_(options),
+      file_writer_(std::move(file_writer)),
+      // Bounds the memory used by chunks waiting to be compressed or written.
+      write_queue_(2 * options.num_compression_threads + 2) {
+  CHECK_GT(options_.chunk_size, 0);
+  current_chunk_.reserve(options_.chunk_size);
+  if (options_.compress) {
+    CHECK_GT(options_.num_compression_threads, 0);
+    for (int i = 0; i != options_.num_compression_threads; ++i) {
+      compression_threads_.emplace_back([this]() { CompressChunks(); });
+    }
+  }
+  write_thread_ = std::thread([this]() { WriteChunks(); });
+}
+
+ChunkedFileWriter::~ChunkedFileWriter() { StopThreads(); }
+
+bool ChunkedFileWriter::WriteHeader(const char* const data, const size_t len) {
+  WaitUntilWritten();
+  {
+    absl::MutexLock locker(&mutex_);
+    if (failed_) {
+      return false;
+    }
+  }
+  if (!options_.compress) {
+    return file_writer_->WriteHeader(data, len);
+  }
+  const std::string header = GzipWithoutCompression(data, len);
+  if (compressed_header_size_ == 0) {
+    compressed_header_size_ = header.size();
+  }
+  CHECK_EQ(header.size(), compressed_header_size_)
+      << "Headers must have a fixed size.";
+  return file_writer_->WriteHeader(header.data(), header.size());
+}
+
+bool ChunkedFileWriter::Write(const char* const data, const size_t len) {
+  {
+    absl::MutexLock locker(&mutex_);
+    if (failed_) {
+      return false;
+    }
+  }
+  current_chunk_.append(data, len);
+  if (current_chunk_.size() >= options_.chunk_size) {
+    SubmitChunk();
+  }
+  return true;
+}
+
+bool ChunkedFileWriter::Close() {
+  WaitUntilWritten();
+  StopThreads();
+  {
+    absl::MutexLock locker(&mutex_);
+    if (failed_) {
+      return false;
+    }
+  }
+  return file_writer_->Close();
+}
+
+std::string ChunkedFileWriter::GetFilename() {
+  return file_writer_->GetFilename();
+}
+
+void ChunkedFileWriter::SubmitChunk() {
+  if (current_chunk_.empty()) {
+    return;
+  }
+  auto chunk = std::make_shared<Chunk>();
+  {
+    absl::MutexLock locker(&chunk->mutex);
+    chunk->data = std::move(current_chunk_);
+    chunk->ready = !options_.compress;
+  }
+  current_chunk_ = std::string();
+  current_chunk_.reserve(options_.chunk_size);
+  {
+    absl::MutexLock locker(&mutex_);
+    ++num_pending_chunks_;
+  }
+  // The order in the write queue is the order in the file, no matter in which
+  // order the chunks are compressed.
+  write_queue_.Push(chunk);
+  if (options_.compress) {
+    compression_queue_.Push(std::move(chunk));
+  }
+}
+
+void ChunkedFileWriter::WaitUntilWritten() {
+  SubmitChunk();
+  const auto predicate = [this]() EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return num_pending_chunks_ == 0;
+  };
+  absl::MutexLock locker(&mutex_);
+  mutex_.Await(absl::Condition(&predicate));
+}
+
+void ChunkedFileWriter::StopThreads() {
+  if (threads_stopped_) {
+    return;
+  }
+  threads_stopped_ = true;
+  for (size_t i = 0; i != compression_threads_.size(); ++i) {
+    compression_queue_.Push(nullptr);
+  }
+  for (std::thread& thread : compression_threads_) {
+    thread.join();
+  }
+  write_queue_.Push(nullptr);
+  write_thread_.join();
+}
+
+void ChunkedFileWriter::CompressChunks() {
+  for (;;) {
+    const std::shared_ptr<Chunk> chunk = compression_queue_.Pop();
+    if (chunk == nullptr) {
+      return;
+    }
+    absl::MutexLock locker(&chunk->mutex);
+    std::string compressed;
+    common::FastGzipString(chunk->data, &compressed);
+    chunk->data = std::move(compressed);
+    chunk->ready = true;
+  }
+}
+
+void ChunkedFileWriter::WriteChunks() {
+  for (;;) {
+    const std::shared_ptr<Chunk> chunk = write_queue_.Pop();
+    if (chunk == nullptr) {
+      return;
+    }
+    bool success;
+    {
+      const auto predicate = [&chunk]() EXCLUSIVE_LOCKS_REQUIRED(
+                                 chunk->mutex) { return chunk->ready; };
+      absl::MutexLock locker(&chunk->mutex);
+      chunk->mutex.Await(absl::Condition(&predicate));
+      success = file_writer_->Write(chunk->data.data(), chunk->data.size());
+    }
+    absl::MutexLock locker(&mutex_);
+    failed_ |= !success;
+    --num_pending_chunks_;
+  }
+}
+
+ChunkedFileWriter::Options ChunkedFileWriterOptionsFromDictionary(
+    common::LuaParameterDictionary* const dictionary) {
+  ChunkedFileWriter::Options options;
+  options.compress =
+      dictionary->HasKey("compress") ? dictionary->GetBool("compress") : false;
+  options.num_compression_threads =
+      dictionary->HasKey("num_compression_threads")
+          ? dictionary->GetInt("num_compression_threads")
+          : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  CHECK_GT(options.num_compression_threads, 0);
+  return options;
+}
+
+}  // namespace io
+}  // namespace cartographer
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_IO_CHUNKED_FILE_WRITER_H_
+#define CARTOGRAPHER_IO_CHUNKED_FILE_WRITER_H_
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "cartographer/common/internal/blocking_queue.h"
+#include "cartographer/common/lua_parameter_dictionary.h"
+#include "cartographer/io/file_writer.h"
+
+namespace cartographer {
+namespace io {
+
+// Collects writes into large chunks, which a separate thread hands to the
+// wrapped 'file_writer' in order, so that callers do not wait for I/O.
+//
+// If 'compress' is set, every chunk is compressed into a gzip member of its
+// own on one of 'num_compression_threads' threads. The concatenated members
+// form a valid gzip file. The header is stored in a member without
+// compression, so that its size does not change when it is overwritten.
+class ChunkedFileWriter : public FileWriter {
+ public:
+  struct Options {
+    size_t chunk_size = 8 << 20;
+    bool compress = false;
+    int num_compression_threads = 1;
+  };
+
+  ChunkedFileWriter(std::unique_ptr<FileWriter> file_writer,
+                    const Options& options);
+  ~ChunkedFileWriter() override;
+
+  // Waits until all chunks written so far are out, then writes the header.
+  bool WriteHeader(const char* data, size_t len) override;
+  bool Write(const char* data, size_t len) override;
+  bool Close() override;
+  std::string GetFilename() override;
+
+ private:
+  struct Chunk {
+    absl::Mutex mutex;
+    std::string data GUARDED_BY(mutex);
+    bool ready GUARDED_BY(mutex) = false;
+  };
+
+  void SubmitChunk();
+  // Submits the current chunk and waits until all chunks have been written.
+  void WaitUntilWritten() LOCKS_EXCLUDED(mutex_);
+  void StopThreads();
+  void CompressChunks();
+  void WriteChunks() LOCKS_EXCLUDED(mutex_);
+
+  const Options options_;
+  std::unique_ptr<FileWriter> file_writer_;
+  std::string current_chunk_;
+  // Size of the compressed header, which must stay the same.
+  size_t compressed_header_size_ = 0;
+  bool threads_stopped_ = false;
+
+  // A nullptr in either queue tells the receiving threads to exit.
+  common::BlockingQueue<std::shared_ptr<Chunk>> compression_queue_;
+  common::BlockingQueue<std::shared_ptr<Chunk>> write_queue_;
+
+  absl::Mutex mutex_;
+  int num_pending_chunks_ GUARDED_BY(mutex_) = 0;
+  bool failed_ GUARDED_BY(mutex_) = false;
+
+  std::vector<std::thread> compression_threads_;
+  std::thread write_thread_;
+};
+
+// Reads the optional 'compress' and 'num_compression_threads' keys.
+ChunkedFileWriter::Options ChunkedFileWriterOptionsFromDictionary(
+    common::LuaParameterDictionary* dictionary);
+
+}  // namespace io
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_IO_CHUNKED_FILE_WRITER_H_
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/io/chunked_file_writer.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "cartographer/common/port.h"
+#include "cartographer/io/fake_file_writer.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace io {
+namespace {
+
+std::string CreateData() {
+  std::string data;
+  for (int i = 0; i != 10000; ++i) {
+    data += std::to_string(i);
+  }
+  return data;
+}
+
+// Writes a fixed size header, the data in pieces and the final header.
+void WriteFile(const std::string& data, FileWriter* const file_writer) {
+  EXPECT_TRUE(file_writer->WriteHeader("header 000\n", 11));
+  for (size_t i = 0; i < data.size(); i += 7) {
+    const std::string piece = data.substr(i, 7);
+    EXPECT_TRUE(file_writer->Write(piece.data(), piece.size()));
+  }
+  EXPECT_TRUE(file_writer->WriteHeader("header 123\n", 11));
+  EXPECT_TRUE(file_writer->Close());
+}
+
+TEST(ChunkedFileWriterTest, WritesInOrder) {
+  auto content = std::make_shared<std::vector<char>>();
+  ChunkedFileWriter::Options options;
+  options.chunk_size = 100;
+  ChunkedFileWriter file_writer(
+      absl::make_unique<FakeFileWriter>("file", content), options);
+  EXPECT_EQ(file_writer.GetFilename(), "file");
+  const std::string data = CreateData();
+  WriteFile(data, &file_writer);
+  EXPECT_EQ(std::string(content->begin(), content->end()),
+            "header 123\n" + data);
+}
+
+TEST(ChunkedFileWriterTest, CompressesChunks) {
+  auto content = std::make_shared<std::vector<char>>();
+  ChunkedFileWriter::Options options;
+  options.chunk_size = 1000;
+  options.compress = true;
+  options.num_compression_threads = 4;
+  ChunkedFileWriter file_writer(
+      absl::make_unique<FakeFileWriter>("file", content), options);
+  const std::string data = CreateData();
+  WriteFile(data, &file_writer);
+  EXPECT_LT(content->size(), data.size());
+  std::string decompressed;
+  common::FastGunzipString(std::string(content->begin(), content->end()),
+                           &decompressed);
+  EXPECT_EQ(decompressed, "header 123\n" + data);
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace cartographer
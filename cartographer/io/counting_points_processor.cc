@@ -33,7 +33,7 @@ CountingPointsProcessor::FromDictionary(
 }
 
 void CountingPointsProcessor::Process(std::unique_ptr<PointsBatch> batch) {
-  num_points_ += batch->points.size();
+  num_points_ += NumRemainingPoints(*batch);
   next_->Process(std::move(batch));
 }
 
@@ -42,13 +42,12 @@ FixedRatioSamplingPointsProcessor::FixedRatioSamplingPointsProcessor(
 
 void FixedRatioSamplingPointsProcessor::Process(
     std::unique_ptr<PointsBatch> batch) {
-  absl::flat_hash_set<int> to_remove;
   for (size_t i = 0; i < batch->points.size(); ++i) {
-    if (!sampler_->Pulse()) {
-      to_remove.insert(i);
+    // Only points which are still there count towards the sampling ratio.
+    if (!IsPointRemoved(*batch, i) && !sampler_->Pulse()) {
+      MarkPointRemoved(i, batch.get());
     }
   }
-  RemovePoints(to_remove, batch.get());
   next_->Process(std::move(batch));
 }
 
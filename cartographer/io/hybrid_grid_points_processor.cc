@@ -39,6 +39,7 @@ HybridGridPointsProcessor::FromDictionary(
 }
 
 void HybridGridPointsProcessor::Process(std::unique_ptr<PointsBatch> batch) {
+  CompactPoints(batch.get());
   range_data_inserter_.Insert(
       {batch->origin, sensor::PointCloud(batch->points), {}}, &hybrid_grid_,
       /*intensity_hybrid_grid=*/nullptr);
@@ -0,0 +1,202 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/io/internal/checkpoint_journal.h"
+
+#include <fstream>
+
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace io {
+
+using mapping::proto::SerializedData;
+
+std::string CheckpointJournalFilename(const std::string& filename) {
+  return filename + ".journal";
+}
+
+bool HasCheckpointJournal(const std::string& filename) {
+  return std::ifstream(CheckpointJournalFilename(filename)).good();
+}
+
+CheckpointJournalReader::CheckpointJournalReader(
+    ProtoStreamReaderInterface* const base, const std::string& journal_filename)
+    : base_(base), journal_(journal_filename) {
+  // A first pass finds the complete increments and the latest versions of the
+  // data in them.
+  ProtoStreamReader journal(journal_filename);
+  std::map<DataKey, int> pending_versions;
+  SerializedData pending_all_trajectory_builder_options;
+  SerializedData data;
+  int message_index = 0;
+  for (; journal.ReadProto(&data); ++message_index) {
+    DataKey key;
+    if (GetDataKey(data, &key)) {
+      pending_versions[key] = message_index;
+    } else if (data.has_all_trajectory_builder_options()) {
+      pending_all_trajectory_builder_options.Swap(&data);
+    } else if (data.has_pose_graph()) {
+      // The pose graph completes an increment.
+      CHECK(pending_all_trajectory_builder_options
+                .has_all_trajectory_builder_options())
+          << "Checkpoint journal '" << journal_filename << "' is corrupt.";
+      pose_graph_.Swap(&data);
+      all_trajectory_builder_options_.Swap(
+          &pending_all_trajectory_builder_options);
+      pending_all_trajectory_builder_options.Clear();
+      for (const auto& key_and_message_index : pending_versions) {
+        latest_versions_[key_and_message_index.first] =
+            key_and_message_index.second;
+      }
+      pending_versions.clear();
+      num_committed_messages_ = message_index + 1;
+      ++num_increments_;
+    }
+  }
+  if (message_index != num_committed_messages_) {
+    LOG(WARNING) << "Ignoring the incomplete last increment of checkpoint "
+                    "journal '"
+                 << journal_filename << "'.";
+  }
+
+  for (const auto& trajectory : pose_graph_.pose_graph().trajectory()) {
+    pose_graph_trajectory_ids_.insert(trajectory.trajectory_id());
+    for (const auto& submap : trajectory.submap()) {
+      pose_graph_data_.emplace(SerializedData::kSubmap,
+                               trajectory.trajectory_id(),
+                               submap.submap_index());
+    }
+    for (const auto& node : trajectory.node()) {
+      pose_graph_data_.emplace(SerializedData::kNode,
+                               trajectory.trajectory_id(), node.node_index());
+    }
+  }
+}
+
+bool CheckpointJournalReader::GetDataKey(const SerializedData& data,
+                                         DataKey* const key) {
+  switch (data.data_case()) {
+    case SerializedData::kSubmap:
+      *key = DataKey(data.data_case(),
+                     data.submap().submap_id().trajectory_id(),
+                     data.submap().submap_id().submap_index());
+      return true;
+    case SerializedData::kNode:
+      *key = DataKey(data.data_case(), data.node().node_id().trajectory_id(),
+                     data.node().node_id().node_index());
+      return true;
+    case SerializedData::kTrajectoryData:
+      *key = DataKey(data.data_case(), data.trajectory_data().trajectory_id(),
+                     0);
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool CheckpointJournalReader::IsInPoseGraph(const SerializedData& data) const {
+  DataKey key;
+  switch (data.data_case()) {
+    case SerializedData::kSubmap:
+    case SerializedData::kNode:
+      CHECK(GetDataKey(data, &key));
+      return pose_graph_data_.count(key) != 0;
+    case SerializedData::kTrajectoryData:
+      return pose_graph_trajectory_ids_.count(
+                 data.trajectory_data().trajectory_id()) != 0;
+    case SerializedData::kImuData:
+      return pose_graph_trajectory_ids_.count(
+                 data.imu_data().trajectory_id()) != 0;
+    case SerializedData::kOdometryData:
+      return pose_graph_trajectory_ids_.count(
+                 data.odometry_data().trajectory_id()) != 0;
+    case SerializedData::kFixedFramePoseData:
+      return pose_graph_trajectory_ids_.count(
+                 data.fixed_frame_pose_data().trajectory_id()) != 0;
+    case SerializedData::kLandmarkData:
+      return pose_graph_trajectory_ids_.count(
+                 data.landmark_data().trajectory_id()) != 0;
+    default:
+      return true;
+  }
+}
+
+bool CheckpointJournalReader::KeepFromBase(SerializedData* const data) {
+  if (num_increments_ == 0) {
+    return true;
+  }
+  if (data->has_pose_graph()) {
+    data->Swap(&pose_graph_);
+    return true;
+  }
+  if (data->has_all_trajectory_builder_options()) {
+    data->Swap(&all_trajectory_builder_options_);
+    return true;
+  }
+  DataKey key;
+  if (GetDataKey(*data, &key) && latest_versions_.count(key) != 0) {
+    return false;
+  }
+  return IsInPoseGraph(*data);
+}
+
+bool CheckpointJournalReader::KeepFromJournal(const SerializedData& data,
+                                              const int message_index) const {
+  if (data.has_pose_graph() || data.has_all_trajectory_builder_options()) {
+    return false;
+  }
+  DataKey key;
+  if (GetDataKey(data, &key) && latest_versions_.at(key) != message_index) {
+    return false;
+  }
+  return IsInPoseGraph(data);
+}
+
+bool CheckpointJournalReader::ReadProto(google::protobuf::Message* proto) {
+  if (!header_read_) {
+    header_read_ = true;
+    return base_->ReadProto(proto);
+  }
+  auto* const data = dynamic_cast<SerializedData*>(proto);
+  CHECK(data != nullptr) << "Expected SerializedData, got "
+                         << proto->GetTypeName() << ".";
+  while (!base_->eof()) {
+    if (!base_->ReadProto(data)) {
+      if (!base_->eof()) {
+        return false;
+      }
+      break;
+    }
+    if (KeepFromBase(data)) {
+      return true;
+    }
+  }
+  while (next_journal_message_index_ < num_committed_messages_) {
+    const int message_index = next_journal_message_index_++;
+    if (!journal_.ReadProto(data)) {
+      return false;
+    }
+    if (KeepFromJournal(*data, message_index)) {
+      return true;
+    }
+  }
+  eof_ = true;
+  return false;
+}
+
+}  // namespace io
+}  // namespace cartographer
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_IO_INTERNAL_CHECKPOINT_JOURNAL_H_
+#define CARTOGRAPHER_IO_INTERNAL_CHECKPOINT_JOURNAL_H_
+
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+
+#include "cartographer/io/proto_stream.h"
+#include "cartographer/io/proto_stream_interface.h"
+#include "cartographer/mapping/proto/serialization.pb.h"
+
+namespace cartographer {
+namespace io {
+
+// Returns the name of the journal of checkpoints of the state in 'filename'.
+std::string CheckpointJournalFilename(const std::string& filename);
+
+// Returns true if there is a journal of checkpoints of the state in
+// 'filename'.
+bool HasCheckpointJournal(const std::string& filename);
+
+// Reads the state in 'base', written by WritePbStream(), with the increments
+// in the journal 'journal_filename', written by WritePbStreamIncrement(),
+// applied. The result is a stream in the format of WritePbStream() with the
+// pose graph and trajectory builder options of the last increment, the latest
+// version of each submap, node and trajectory data and all sensor data. Data
+// that is not in the final pose graph, e.g. because it was trimmed, is
+// skipped. An increment at the end of the journal which was not completely
+// written is ignored.
+//
+// Only 'mapping::proto::SerializedData' can be read after the header.
+class CheckpointJournalReader : public ProtoStreamReaderInterface {
+ public:
+  // 'base' must outlive this reader.
+  CheckpointJournalReader(ProtoStreamReaderInterface* base,
+                          const std::string& journal_filename);
+  ~CheckpointJournalReader() = default;
+
+  CheckpointJournalReader(const CheckpointJournalReader&) = delete;
+  CheckpointJournalReader& operator=(const CheckpointJournalReader&) = delete;
+
+  bool ReadProto(google::protobuf::Message* proto) override;
+  bool eof() const override { return eof_; }
+
+  // Number of complete increments in the journal.
+  int num_increments() const { return num_increments_; }
+
+ private:
+  // Identifies data of which only the latest version is kept: submaps, nodes
+  // and trajectory data.
+  using DataKey = std::tuple<int, int, int>;
+
+  static bool GetDataKey(const mapping::proto::SerializedData& data,
+                         DataKey* key);
+
+  bool IsInPoseGraph(const mapping::proto::SerializedData& data) const;
+  // Return whether 'data' is part of the result. The pose graph and trajectory
+  // builder options of the base are replaced by those of the journal.
+  bool KeepFromBase(mapping::proto::SerializedData* data);
+  bool KeepFromJournal(const mapping::proto::SerializedData& data,
+                       int message_index) const;
+
+  ProtoStreamReaderInterface* const base_;
+  ProtoStreamReader journal_;
+  int num_increments_ = 0;
+  // Number of journal messages which belong to complete increments.
+  int num_committed_messages_ = 0;
+  // Of the last complete increment.
+  mapping::proto::SerializedData pose_graph_;
+  mapping::proto::SerializedData all_trajectory_builder_options_;
+  // Index in the journal of the latest version of the data.
+  std::map<DataKey, int> latest_versions_;
+  // The submaps, nodes and trajectories of 'pose_graph_'.
+  std::set<DataKey> pose_graph_data_;
+  std::set<int> pose_graph_trajectory_ids_;
+
+  bool header_read_ = false;
+  int next_journal_message_index_ = 0;
+  bool eof_ = false;
+};
+
+}  // namespace io
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_IO_INTERNAL_CHECKPOINT_JOURNAL_H_
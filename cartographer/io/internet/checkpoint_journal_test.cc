@@ -0,0 +1,153 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/io/internal/checkpoint_journal.h"
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "cartographer/io/internal/in_memory_proto_stream.h"
+#include "cartographer/io/proto_stream.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace io {
+namespace {
+
+using mapping::proto::SerializedData;
+
+SerializedData CreatePoseGraph(const std::vector<int>& submap_indices,
+                               const std::vector<int>& node_indices) {
+  SerializedData data;
+  auto* const trajectory = data.mutable_pose_graph()->add_trajectory();
+  trajectory->set_trajectory_id(0);
+  for (const int submap_index : submap_indices) {
+    trajectory->add_submap()->set_submap_index(submap_index);
+  }
+  for (const int node_index : node_indices) {
+    trajectory->add_node()->set_node_index(node_index);
+  }
+  return data;
+}
+
+SerializedData CreateTrajectoryBuilderOptions() {
+  SerializedData data;
+  data.mutable_all_trajectory_builder_options()->add_options_with_sensor_ids();
+  return data;
+}
+
+SerializedData CreateSubmap(const int submap_index, const int num_range_data) {
+  SerializedData data;
+  data.mutable_submap()->mutable_submap_id()->set_submap_index(submap_index);
+  data.mutable_submap()->mutable_submap_2d()->set_num_range_data(
+      num_range_data);
+  return data;
+}
+
+SerializedData CreateNode(const int node_index) {
+  SerializedData data;
+  data.mutable_node()->mutable_node_id()->set_node_index(node_index);
+  return data;
+}
+
+SerializedData CreateImuData(const int64 timestamp) {
+  SerializedData data;
+  data.mutable_imu_data()->mutable_imu_data()->set_timestamp(timestamp);
+  return data;
+}
+
+class CheckpointJournalTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    base_.AddProto(mapping::proto::SerializationHeader());
+    base_.AddProto(CreatePoseGraph({0, 1}, {0, 1}));
+    base_.AddProto(CreateTrajectoryBuilderOptions());
+    base_.AddProto(CreateSubmap(0, 10));
+    base_.AddProto(CreateSubmap(1, 5));
+    base_.AddProto(CreateNode(0));
+    base_.AddProto(CreateNode(1));
+    base_.AddProto(CreateImuData(1));
+  }
+
+  void TearDown() override { remove(journal_filename_.c_str()); }
+
+  InMemoryProtoStreamReader base_;
+  const std::string journal_filename_ = "./test_checkpoint.journal";
+};
+
+TEST_F(CheckpointJournalTest, ReplaysCompleteIncrements) {
+  {
+    AppendingProtoStreamWriter journal(journal_filename_, 0);
+    // Submap 1 changed, node 2 was added and node 0 was trimmed.
+    journal.WriteProto(CreateSubmap(1, 10));
+    journal.WriteProto(CreateNode(2));
+    journal.WriteProto(CreateImuData(2));
+    journal.WriteProto(CreateTrajectoryBuilderOptions());
+    journal.WriteProto(CreatePoseGraph({0, 1}, {1, 2}));
+    // An increment which was interrupted before its pose graph.
+    journal.WriteProto(CreateSubmap(1, 15));
+    journal.WriteProto(CreateNode(3));
+    ASSERT_TRUE(journal.Close());
+  }
+
+  CheckpointJournalReader reader(&base_, journal_filename_);
+  EXPECT_EQ(1, reader.num_increments());
+  mapping::proto::SerializationHeader header;
+  ASSERT_TRUE(reader.ReadProto(&header));
+  std::vector<SerializedData> actual;
+  SerializedData data;
+  while (reader.ReadProto(&data)) {
+    actual.push_back(data);
+  }
+  EXPECT_TRUE(reader.eof());
+
+  ASSERT_EQ(8, actual.size());
+  ASSERT_TRUE(actual[0].has_pose_graph());
+  EXPECT_EQ(2, actual[0].pose_graph().trajectory(0).node(1).node_index());
+  EXPECT_TRUE(actual[1].has_all_trajectory_builder_options());
+  EXPECT_EQ(0, actual[2].submap().submap_id().submap_index());
+  EXPECT_EQ(10, actual[2].submap().submap_2d().num_range_data());
+  EXPECT_EQ(1, actual[3].node().node_id().node_index());
+  EXPECT_EQ(1, actual[4].imu_data().imu_data().timestamp());
+  EXPECT_EQ(1, actual[5].submap().submap_id().submap_index());
+  EXPECT_EQ(10, actual[5].submap().submap_2d().num_range_data());
+  EXPECT_EQ(2, actual[6].node().node_id().node_index());
+  EXPECT_EQ(2, actual[7].imu_data().imu_data().timestamp());
+}
+
+TEST_F(CheckpointJournalTest, EmptyJournalReadsBase) {
+  {
+    AppendingProtoStreamWriter journal(journal_filename_, 0);
+    ASSERT_TRUE(journal.Close());
+  }
+
+  CheckpointJournalReader reader(&base_, journal_filename_);
+  EXPECT_EQ(0, reader.num_increments());
+  mapping::proto::SerializationHeader header;
+  ASSERT_TRUE(reader.ReadProto(&header));
+  int num_messages = 0;
+  SerializedData data;
+  while (reader.ReadProto(&data)) {
+    ++num_messages;
+  }
+  EXPECT_TRUE(reader.eof());
+  EXPECT_EQ(7, num_messages);
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace cartographer
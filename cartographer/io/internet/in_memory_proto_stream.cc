@@ -30,7 +30,10 @@ bool ForwardingProtoStreamWriter::Close() { return writer_callback_(nullptr); }
 
 bool InMemoryProtoStreamReader::ReadProto(google::protobuf::Message* proto) {
   if (eof()) return false;
-  proto->CopyFrom(*state_chunks_.front());
+  // Chunks are read only once, so their contents are moved instead of copied.
+  // Swapping copies if 'proto' lives on a different arena.
+  CHECK_EQ(proto->GetDescriptor(), state_chunks_.front()->GetDescriptor());
+  proto->GetReflection()->Swap(proto, state_chunks_.front().get());
   state_chunks_.pop();
   return true;
 }
@@ -55,6 +55,25 @@ std::vector<int> GetValidTrajectoryIds(
   return valid_trajectories;
 }
 
+// Returns whether sensor data of 'trajectory_id' at 'time' is newer than the
+// data serialized according to 'previous_times' and if so, updates the latest
+// serialized time in 'last_times'.
+bool IsNewSensorData(const std::map<int, common::Time>& previous_times,
+                     const int trajectory_id, const common::Time time,
+                     std::map<int, common::Time>* const last_times) {
+  const auto previous_time = previous_times.find(trajectory_id);
+  if (previous_time != previous_times.end() && time <= previous_time->second) {
+    return false;
+  }
+  const auto last_time = last_times->find(trajectory_id);
+  if (last_time == last_times->end()) {
+    last_times->emplace(trajectory_id, time);
+  } else if (last_time->second < time) {
+    last_time->second = time;
+  }
+  return true;
+}
+
 mapping::proto::SerializationHeader CreateHeader() {
   mapping::proto::SerializationHeader header;
   header.set_format_version(kMappingStateSerializationFormatVersion);
@@ -81,13 +100,24 @@ SerializedData SerializeTrajectoryBuilderOptions(
 
 void SerializeSubmaps(
     const MapById<SubmapId, PoseGraphInterface::SubmapData>& submap_data,
-    bool include_unfinished_submaps, ProtoStreamWriterInterface* const writer) {
+    bool include_unfinished_submaps,
+    std::map<SubmapId, std::pair<int, bool>>* const serialized_submaps,
+    ProtoStreamWriterInterface* const writer) {
   // Next serialize all submaps.
   for (const auto& submap_id_data : submap_data) {
     if (!include_unfinished_submaps &&
         !submap_id_data.data.submap->insertion_finished()) {
       continue;
     }
+    const std::pair<int, bool> version(
+        submap_id_data.data.submap->num_range_data(),
+        submap_id_data.data.submap->insertion_finished());
+    const auto serialized_submap = serialized_submaps->find(submap_id_data.id);
+    if (serialized_submap != serialized_submaps->end() &&
+        serialized_submap->second == version) {
+      continue;
+    }
+    (*serialized_submaps)[submap_id_data.id] = version;
     SerializedData proto;
     auto* const submap_proto = proto.mutable_submap();
     *submap_proto = submap_id_data.data.submap->ToProto(
@@ -102,8 +132,14 @@ void SerializeSubmaps(
 
 void SerializeTrajectoryNodes(
     const MapById<NodeId, TrajectoryNode>& trajectory_nodes,
+    std::map<int, int>* const next_node_index,
     ProtoStreamWriterInterface* const writer) {
   for (const auto& node_id_data : trajectory_nodes) {
+    int& next_index = (*next_node_index)[node_id_data.id.trajectory_id];
+    if (node_id_data.id.node_index < next_index) {
+      continue;
+    }
+    next_index = node_id_data.id.node_index + 1;
     SerializedData proto;
     auto* const node_proto = proto.mutable_node();
     node_proto->mutable_node_id()->set_trajectory_id(
@@ -140,9 +176,15 @@ void SerializeTrajectoryData(
 }
 
 void SerializeImuData(const sensor::MapByTime<sensor::ImuData>& all_imu_data,
+                      std::map<int, common::Time>* const last_times,
                       ProtoStreamWriterInterface* const writer) {
+  const std::map<int, common::Time> previous_times = *last_times;
   for (const int trajectory_id : all_imu_data.trajectory_ids()) {
     for (const auto& imu_data : all_imu_data.trajectory(trajectory_id)) {
+      if (!IsNewSensorData(previous_times, trajectory_id, imu_data.time,
+                           last_times)) {
+        continue;
+      }
       SerializedData proto;
       auto* const imu_data_proto = proto.mutable_imu_data();
       imu_data_proto->set_trajectory_id(trajectory_id);
@@ -154,10 +196,16 @@ void SerializeImuData(const sensor::MapByTime<sensor::ImuData>& all_imu_data,
 
 void SerializeOdometryData(
     const sensor::MapByTime<sensor::OdometryData>& all_odometry_data,
+    std::map<int, common::Time>* const last_times,
     ProtoStreamWriterInterface* const writer) {
+  const std::map<int, common::Time> previous_times = *last_times;
   for (const int trajectory_id : all_odometry_data.trajectory_ids()) {
     for (const auto& odometry_data :
          all_odometry_data.trajectory(trajectory_id)) {
+      if (!IsNewSensorData(previous_times, trajectory_id, odometry_data.time,
+                           last_times)) {
+        continue;
+      }
       SerializedData proto;
       auto* const odometry_data_proto = proto.mutable_odometry_data();
       odometry_data_proto->set_trajectory_id(trajectory_id);
@@ -171,10 +219,16 @@ void SerializeOdometryData(
 void SerializeFixedFramePoseData(
     const sensor::MapByTime<sensor::FixedFramePoseData>&
         all_fixed_frame_pose_data,
+    std::map<int, common::Time>* const last_times,
     ProtoStreamWriterInterface* const writer) {
+  const std::map<int, common::Time> previous_times = *last_times;
   for (const int trajectory_id : all_fixed_frame_pose_data.trajectory_ids()) {
     for (const auto& fixed_frame_pose_data :
          all_fixed_frame_pose_data.trajectory(trajectory_id)) {
+      if (!IsNewSensorData(previous_times, trajectory_id,
+                           fixed_frame_pose_data.time, last_times)) {
+        continue;
+      }
       SerializedData proto;
       auto* const fixed_frame_pose_data_proto =
           proto.mutable_fixed_frame_pose_data();
@@ -189,9 +243,15 @@ void SerializeFixedFramePoseData(
 void SerializeLandmarkNodes(
     const std::map<std::string, PoseGraphInterface::LandmarkNode>&
         all_landmark_nodes,
+    std::map<int, common::Time>* const last_times,
     ProtoStreamWriterInterface* const writer) {
+  const std::map<int, common::Time> previous_times = *last_times;
   for (const auto& node : all_landmark_nodes) {
     for (const auto& observation : node.second.landmark_observations) {
+      if (!IsNewSensorData(previous_times, observation.trajectory_id,
+                           observation.time, last_times)) {
+        continue;
+      }
       SerializedData proto;
       auto* landmark_data_proto = proto.mutable_landmark_data();
       landmark_data_proto->set_trajectory_id(observation.trajectory_id);
@@ -209,28 +269,68 @@ void SerializeLandmarkNodes(
   }
 }
 
+// Serializes everything following the pose graph and the trajectory builder
+// options which is not yet in 'checkpoint'.
+void SerializeMappingData(const mapping::PoseGraph& pose_graph,
+                          bool include_unfinished_submaps,
+                          SerializationCheckpoint* const checkpoint,
+                          ProtoStreamWriterInterface* const writer) {
+  SerializeSubmaps(pose_graph.GetAllSubmapData(), include_unfinished_submaps,
+                   &checkpoint->submaps, writer);
+  SerializeTrajectoryNodes(pose_graph.GetTrajectoryNodes(),
+                           &checkpoint->next_node_index, writer);
+  SerializeTrajectoryData(pose_graph.GetTrajectoryData(), writer);
+  SerializeImuData(pose_graph.GetImuData(), &checkpoint->last_imu_time,
+                   writer);
+  SerializeOdometryData(pose_graph.GetOdometryData(),
+                        &checkpoint->last_odometry_time, writer);
+  SerializeFixedFramePoseData(pose_graph.GetFixedFramePoseData(),
+                              &checkpoint->last_fixed_frame_pose_time, writer);
+  SerializeLandmarkNodes(pose_graph.GetLandmarkNodes(),
+                         &checkpoint->last_landmark_time, writer);
+}
+
 }  // namespace
 
 void WritePbStream(
     const mapping::PoseGraph& pose_graph,
     const std::vector<mapping::proto::TrajectoryBuilderOptionsWithSensorIds>&
         trajectory_builder_options,
-    ProtoStreamWriterInterface* const writer, bool include_unfinished_submaps) {
+    ProtoStreamWriterInterface* const writer, bool include_unfinished_submaps,
+    SerializationCheckpoint* checkpoint) {
+  SerializationCheckpoint local_checkpoint;
+  if (checkpoint == nullptr) {
+    checkpoint = &local_checkpoint;
+  }
+  *checkpoint = SerializationCheckpoint();
   writer->WriteProto(CreateHeader());
   writer->WriteProto(
       SerializePoseGraph(pose_graph, include_unfinished_submaps));
   writer->WriteProto(SerializeTrajectoryBuilderOptions(
       trajectory_builder_options,
       GetValidTrajectoryIds(pose_graph.GetTrajectoryStates())));
+  SerializeMappingData(pose_graph, include_unfinished_submaps, checkpoint,
+                       writer);
+}
 
-  SerializeSubmaps(pose_graph.GetAllSubmapData(), include_unfinished_submaps,
-                   writer);
-  SerializeTrajectoryNodes(pose_graph.GetTrajectoryNodes(), writer);
-  SerializeTrajectoryData(pose_graph.GetTrajectoryData(), writer);
-  SerializeImuData(pose_graph.GetImuData(), writer);
-  SerializeOdometryData(pose_graph.GetOdometryData(), writer);
-  SerializeFixedFramePoseData(pose_graph.GetFixedFramePoseData(), writer);
-  SerializeLandmarkNodes(pose_graph.GetLandmarkNodes(), writer);
+void WritePbStreamIncrement(
+    const mapping::PoseGraph& pose_graph,
+    const std::vector<mapping::proto::TrajectoryBuilderOptionsWithSensorIds>&
+        trajectory_builder_options,
+    ProtoStreamWriterInterface* const writer, bool include_unfinished_submaps,
+    SerializationCheckpoint* const checkpoint) {
+  // The pose graph is taken before the data it refers to, so that everything
+  // it contains is in this or an earlier increment even if mapping continues.
+  const SerializedData pose_graph_proto =
+      SerializePoseGraph(pose_graph, include_unfinished_submaps);
+  const SerializedData trajectory_builder_options_proto =
+      SerializeTrajectoryBuilderOptions(
+          trajectory_builder_options,
+          GetValidTrajectoryIds(pose_graph.GetTrajectoryStates()));
+  SerializeMappingData(pose_graph, include_unfinished_submaps, checkpoint,
+                       writer);
+  writer->WriteProto(trajectory_builder_options_proto);
+  writer->WriteProto(pose_graph_proto);
 }
 
 }  // namespace io
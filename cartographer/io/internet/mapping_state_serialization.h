@@ -17,6 +17,10 @@
 #ifndef CARTOGRAPHER_IO_INTERNAL_MAPPING_STATE_SERIALIZATION_H_
 #define CARTOGRAPHER_IO_INTERNAL_MAPPING_STATE_SERIALIZATION_H_
 
+#include <map>
+#include <utility>
+
+#include "cartographer/common/time.h"
 #include "cartographer/io/proto_stream_interface.h"
 #include "cartographer/mapping/pose_graph.h"
 #include "cartographer/mapping/proto/trajectory_builder_options.pb.h"
@@ -28,12 +32,42 @@ namespace io {
 static constexpr int kMappingStateSerializationFormatVersion = 2;
 static constexpr int kFormatVersionWithoutSubmapHistograms = 1;
 
-// Serialize mapping state to a pbstream.
+// What has been serialized of a mapping state, so that a later increment only
+// needs to contain what was added or changed since.
+struct SerializationCheckpoint {
+  // Number of inserted range data and whether insertion was finished of each
+  // serialized submap.
+  std::map<mapping::SubmapId, std::pair<int, bool>> submaps;
+  // Per trajectory, the index following the last serialized node.
+  std::map<int, int> next_node_index;
+  // Per trajectory, the time of the last serialized sensor data.
+  std::map<int, common::Time> last_imu_time;
+  std::map<int, common::Time> last_odometry_time;
+  std::map<int, common::Time> last_fixed_frame_pose_time;
+  std::map<int, common::Time> last_landmark_time;
+};
+
+// Serialize mapping state to a pbstream. If 'checkpoint' is not nullptr, it is
+// set to what was serialized.
 void WritePbStream(
     const mapping::PoseGraph& pose_graph,
     const std::vector<mapping::proto::TrajectoryBuilderOptionsWithSensorIds>&
         builder_options,
-    ProtoStreamWriterInterface* const writer, bool include_unfinished_submaps);
+    ProtoStreamWriterInterface* const writer, bool include_unfinished_submaps,
+    SerializationCheckpoint* checkpoint = nullptr);
+
+// Serializes what changed in the mapping state since 'checkpoint' and updates
+// it: submaps which are new or changed, new nodes and sensor data, and all
+// trajectory data. The pose graph, which is small compared to the rest, is
+// always written in full and comes last, so that an increment is complete iff
+// it ends with the pose graph. No header is written, the increments of a
+// stream written by WritePbStream() are read by CheckpointJournalReader.
+void WritePbStreamIncrement(
+    const mapping::PoseGraph& pose_graph,
+    const std::vector<mapping::proto::TrajectoryBuilderOptionsWithSensorIds>&
+        builder_options,
+    ProtoStreamWriterInterface* const writer, bool include_unfinished_submaps,
+    SerializationCheckpoint* checkpoint);
 
 }  // namespace io
 }  // namespace cartographer
@@ -16,10 +16,14 @@
 
 #include "cartographer/io/internal/pbstream_info.h"
 
+#include <algorithm>
 #include <map>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <thread>
 
+#include "absl/memory/memory.h"
 #include "cartographer/io/proto_stream.h"
 #include "cartographer/io/proto_stream_deserializer.h"
 #include "gflags/gflags.h"
@@ -36,8 +40,17 @@ namespace {
 
 void Run(const std::string& pbstream_filename, bool all_debug_strings) {
   LOG(INFO) << "Reading pbstream file from '" << pbstream_filename << "'...";
-  io::ProtoStreamReader reader(pbstream_filename);
-  io::ProtoStreamDeserializer deserializer(&reader);
+  // Messages are read one at a time, indexed streams are decompressed ahead
+  // on all cores.
+  std::unique_ptr<io::ProtoStreamReaderInterface> reader;
+  if (io::IsIndexedProtoStream(pbstream_filename)) {
+    reader = absl::make_unique<io::IndexedProtoStreamReader>(
+        pbstream_filename,
+        std::max<int>(1, std::thread::hardware_concurrency()));
+  } else {
+    reader = absl::make_unique<io::ProtoStreamReader>(pbstream_filename);
+  }
+  io::ProtoStreamDeserializer deserializer(reader.get());
   const auto header = deserializer.header();
   LOG(INFO) << "Header: " << header.DebugString();
   for (const mapping::proto::TrajectoryBuilderOptionsWithSensorIds&
@@ -14,8 +14,12 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <memory>
 #include <sstream>
+#include <thread>
 
+#include "absl/memory/memory.h"
 #include "cartographer/io/proto_stream.h"
 #include "cartographer/io/serialization_format_migration.h"
 #include "gflags/gflags.h"
@@ -23,6 +27,10 @@
 
 DEFINE_bool(include_unfinished_submaps, true,
             "Whether to include unfinished submaps in the output.");
+DEFINE_bool(in_memory, false,
+            "Load the whole state into a pose graph before writing it, instead "
+            "of reading the input twice and converting messages on the fly. "
+            "Needs memory in the order of the size of the uncompressed state.");
 
 namespace cartographer {
 namespace io {
@@ -41,12 +49,29 @@ int pbstream_migrate(int argc, char** argv) {
     google::ShowUsageWithFlagsRestrict(argv[0], "pbstream_migrate");
     return EXIT_FAILURE;
   }
-  cartographer::io::ProtoStreamReader input(argv[2]);
+  const std::string input_filename = argv[2];
+  const int num_threads =
+      std::max<int>(1, std::thread::hardware_concurrency());
+  const auto open_input =
+      [&input_filename,
+       num_threads]() -> std::unique_ptr<ProtoStreamReaderInterface> {
+    if (IsIndexedProtoStream(input_filename)) {
+      return absl::make_unique<IndexedProtoStreamReader>(input_filename,
+                                                         num_threads);
+    }
+    return absl::make_unique<ProtoStreamReader>(input_filename);
+  };
   cartographer::io::ProtoStreamWriter output(argv[3]);
   LOG(INFO) << "Migrating serialization format 1 in \"" << argv[2]
             << "\" to serialization format 2 in \"" << argv[3] << "\"";
-  cartographer::io::MigrateStreamVersion1ToVersion2(
-      &input, &output, FLAGS_include_unfinished_submaps);
+  if (FLAGS_in_memory) {
+    const std::unique_ptr<ProtoStreamReaderInterface> input = open_input();
+    cartographer::io::MigrateStreamVersion1ToVersion2(
+        input.get(), &output, FLAGS_include_unfinished_submaps);
+  } else {
+    cartographer::io::MigrateStreamVersion1ToVersion2Streaming(
+        open_input, &output, FLAGS_include_unfinished_submaps);
+  }
   CHECK(output.Close()) << "Could not write migrated pbstream file to: "
                         << argv[3];
 
@@ -40,16 +40,14 @@ MinMaxRangeFilteringPointsProcessor::MinMaxRangeFilteringPointsProcessor(
 
 void MinMaxRangeFilteringPointsProcessor::Process(
     std::unique_ptr<PointsBatch> batch) {
-  absl::flat_hash_set<int> to_remove;
   for (size_t i = 0; i < batch->points.size(); ++i) {
     const float range_squared =
         (batch->points[i].position - batch->origin).squaredNorm();
     if (!(min_range_squared_ <= range_squared &&
           range_squared <= max_range_squared_)) {
-      to_remove.insert(i);
+      MarkPointRemoved(i, batch.get());
     }
   }
-  RemovePoints(to_remove, batch.get());
   next_->Process(std::move(batch));
 }
 
@@ -17,19 +17,29 @@
 #ifndef CARTOGRAPHER_IO_NULL_POINTS_PROCESSOR_H_
 #define CARTOGRAPHER_IO_NULL_POINTS_PROCESSOR_H_
 
+#include "cartographer/io/points_batch_pool.h"
 #include "cartographer/io/points_processor.h"
 
 namespace cartographer {
 namespace io {
 
 // A points processor that just drops all points. The end of a pipeline usually.
+// If a 'pool' is given, the batches are handed back to it.
 class NullPointsProcessor : public PointsProcessor {
  public:
-  NullPointsProcessor() {}
+  NullPointsProcessor() : NullPointsProcessor(nullptr) {}
+  explicit NullPointsProcessor(PointsBatchPool* const pool) : pool_(pool) {}
   ~NullPointsProcessor() override {}
 
-  void Process(std::unique_ptr<PointsBatch> points_batch) override {}
+  void Process(std::unique_ptr<PointsBatch> points_batch) override {
+    if (pool_ != nullptr) {
+      pool_->Release(std::move(points_batch));
+    }
+  }
   FlushResult Flush() override { return FlushResult::kFinished; }
+
+ private:
+  PointsBatchPool* const pool_;
 };
 
 }  // namespace io
@@ -16,8 +16,14 @@
 
 #include "cartographer/io/outlier_removing_points_processor.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
 #include "absl/memory/memory.h"
 #include "cartographer/common/lua_parameter_dictionary.h"
+#include "cartographer/io/file_writer.h"
 #include "glog/logging.h"
 
 namespace cartographer {
@@ -35,23 +41,71 @@ OutlierRemovingPointsProcessor::FromDictionary(
       return dictionary->GetDouble("miss_per_hit_limit");
     }
   }();
+  TileOptions tile_options;
+  if (dictionary->HasKey("tile_size")) {
+    tile_options.tile_size = dictionary->GetNonNegativeInt("tile_size");
+    tile_options.max_buffered_bytes =
+        static_cast<size_t>(
+            dictionary->HasKey("max_buffered_tile_megabytes")
+                ? dictionary->GetNonNegativeInt("max_buffered_tile_megabytes")
+                : 1024)
+        << 20;
+    const char* const temporary_directory = std::getenv("TMPDIR");
+    tile_options.directory =
+        dictionary->HasKey("tile_directory")
+            ? dictionary->GetString("tile_directory")
+            : (temporary_directory != nullptr ? temporary_directory : "/tmp");
+    tile_options.num_threads =
+        dictionary->HasKey("num_tile_threads")
+            ? dictionary->GetNonNegativeInt("num_tile_threads")
+            : std::max<int>(1, std::thread::hardware_concurrency());
+  }
   return absl::make_unique<OutlierRemovingPointsProcessor>(
-      dictionary->GetDouble("voxel_size"), miss_per_hit_limit, next);
+      dictionary->GetDouble("voxel_size"), miss_per_hit_limit, tile_options,
+      next);
 }
 
 OutlierRemovingPointsProcessor::OutlierRemovingPointsProcessor(
     const double voxel_size, const double miss_per_hit_limit,
     PointsProcessor* next)
+    : OutlierRemovingPointsProcessor(voxel_size, miss_per_hit_limit,
+                                     TileOptions(), next) {}
+
+OutlierRemovingPointsProcessor::OutlierRemovingPointsProcessor(
+    const double voxel_size, const double miss_per_hit_limit,
+    const TileOptions& tile_options, PointsProcessor* next)
     : voxel_size_(voxel_size),
       miss_per_hit_limit_(miss_per_hit_limit),
+      tile_options_(tile_options),
       next_(next),
       state_(State::kPhase1),
       voxels_(voxel_size_) {
+  if (tile_options_.tile_size > 0) {
+    tile_store_ = absl::make_unique<OutlierTileStore>(
+        voxel_size_, tile_options_.tile_size, tile_options_.max_buffered_bytes,
+        tile_options_.directory);
+    points_cache_filename_ = tile_store_->directory() + "/points.cache";
+    points_cache_writer_ = absl::make_unique<PointsCacheWriter>(
+        absl::make_unique<StreamFileWriter>(points_cache_filename_));
+    LOG(INFO) << "Caching points and collecting rays in tiles...";
+    return;
+  }
   LOG(INFO) << "Marking hits...";
 }
 
+OutlierRemovingPointsProcessor::~OutlierRemovingPointsProcessor() {
+  if (tile_store_ != nullptr) {
+    points_cache_writer_.reset();
+    std::remove(points_cache_filename_.c_str());
+  }
+}
+
 void OutlierRemovingPointsProcessor::Process(
     std::unique_ptr<PointsBatch> batch) {
+  if (tile_store_ != nullptr) {
+    ProcessTiled(*batch);
+    return;
+  }
   switch (state_) {
     case State::kPhase1:
       ProcessInPhaseOne(*batch);
@@ -68,6 +122,9 @@ void OutlierRemovingPointsProcessor::Process(
 }
 
 PointsProcessor::FlushResult OutlierRemovingPointsProcessor::Flush() {
+  if (tile_store_ != nullptr) {
+    return FlushTiled();
+  }
   switch (state_) {
     case State::kPhase1:
       LOG(INFO) << "Counting rays...";
@@ -91,6 +148,9 @@ PointsProcessor::FlushResult OutlierRemovingPointsProcessor::Flush() {
 void OutlierRemovingPointsProcessor::ProcessInPhaseOne(
     const PointsBatch& batch) {
   for (size_t i = 0; i < batch.points.size(); ++i) {
+    if (IsPointRemoved(batch, i)) {
+      continue;
+    }
     ++voxels_.mutable_value(voxels_.GetCellIndex(batch.points[i].position))
           ->hits;
   }
@@ -102,9 +162,15 @@ void OutlierRemovingPointsProcessor::ProcessInPhaseTwo(
   // by better ray casting, and also by marking the hits of the current range
   // data to be excluded.
   for (size_t i = 0; i < batch.points.size(); ++i) {
+    if (IsPointRemoved(batch, i)) {
+      continue;
+    }
     const Eigen::Vector3f delta = batch.points[i].position - batch.origin;
     const float length = delta.norm();
-    for (float x = 0; x < length; x += voxel_size_) {
+    // Samples are computed from their index rather than accumulated, so that
+    // the OutlierTileStore can start in the middle of a ray.
+    for (int k = 0; k * voxel_size_ < length; ++k) {
+      const float x = k * voxel_size_;
       const Eigen::Array3i index =
           voxels_.GetCellIndex(batch.origin + (x / length) * delta);
       if (voxels_.value(index).hits > 0) {
@@ -116,17 +182,59 @@ void OutlierRemovingPointsProcessor::ProcessInPhaseTwo(
 
 void OutlierRemovingPointsProcessor::ProcessInPhaseThree(
     std::unique_ptr<PointsBatch> batch) {
-  absl::flat_hash_set<int> to_remove;
   for (size_t i = 0; i < batch->points.size(); ++i) {
     const VoxelData voxel =
         voxels_.value(voxels_.GetCellIndex(batch->points[i].position));
     if (!(voxel.rays < miss_per_hit_limit_ * voxel.hits)) {
-      to_remove.insert(i);
+      MarkPointRemoved(i, batch.get());
     }
   }
-  RemovePoints(to_remove, batch.get());
   next_->Process(std::move(batch));
 }
 
+void OutlierRemovingPointsProcessor::ProcessTiled(const PointsBatch& batch) {
+  CHECK(points_cache_writer_ != nullptr)
+      << "Points arrived after the tiled outlier removal was flushed.";
+  points_cache_writer_->Write(batch);
+  for (size_t i = 0; i < batch.points.size(); ++i) {
+    if (!IsPointRemoved(batch, i)) {
+      tile_store_->Insert(batch.origin, batch.points[i].position);
+    }
+  }
+}
+
+PointsProcessor::FlushResult OutlierRemovingPointsProcessor::FlushTiled() {
+  CHECK(points_cache_writer_->Close())
+      << "Failed to write " << points_cache_filename_;
+  points_cache_writer_.reset();
+  LOG(INFO) << "Filtering outliers of " << tile_store_->num_points()
+            << " points...";
+  const std::vector<bool> is_outlier = tile_store_->ComputeOutliers(
+      miss_per_hit_limit_, tile_options_.num_threads);
+  // The cache holds the points which were not removed before, in the same
+  // order as they were added to the tile store. Later stages which need
+  // another pass are served from the cache as well.
+  const PointsCacheReader points_cache_reader(points_cache_filename_);
+  FlushResult result;
+  do {
+    uint64 point_index = 0;
+    for (size_t chunk_index = 0;
+         chunk_index < points_cache_reader.chunks().size(); ++chunk_index) {
+      for (std::unique_ptr<PointsBatch>& batch :
+           points_cache_reader.ReadChunk(chunk_index, nullptr)) {
+        for (size_t i = 0; i < batch->points.size(); ++i) {
+          if (is_outlier[point_index++]) {
+            MarkPointRemoved(i, batch.get());
+          }
+        }
+        next_->Process(std::move(batch));
+      }
+    }
+    CHECK_EQ(point_index, tile_store_->num_points());
+    result = next_->Flush();
+  } while (result == FlushResult::kRestartStream);
+  return result;
+}
+
 }  // namespace io
 }  // namespace cartographer
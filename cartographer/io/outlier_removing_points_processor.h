@@ -17,7 +17,12 @@
 #ifndef CARTOGRAPHER_IO_OUTLIER_REMOVING_POINTS_PROCESSOR_H_
 #define CARTOGRAPHER_IO_OUTLIER_REMOVING_POINTS_PROCESSOR_H_
 
+#include <memory>
+#include <string>
+
 #include "cartographer/common/lua_parameter_dictionary.h"
+#include "cartographer/io/outlier_tile_store.h"
+#include "cartographer/io/points_cache.h"
 #include "cartographer/io/points_processor.h"
 #include "cartographer/mapping/3d/hybrid_grid.h"
 
@@ -31,13 +36,28 @@ class OutlierRemovingPointsProcessor : public PointsProcessor {
   constexpr static const char* kConfigurationFileActionName =
       "voxel_filter_and_remove_moving_objects";
 
+  // With a positive 'tile_size', the points are cached in 'directory' while
+  // they stream in and their rays are collected in an OutlierTileStore. On
+  // 'Flush', the tiles are filtered on 'num_threads' threads and the cached
+  // points are passed on, so the stream is only read once and the voxels of
+  // the whole map are never held in memory.
+  struct TileOptions {
+    int tile_size = 0;
+    size_t max_buffered_bytes = 0;
+    std::string directory;
+    int num_threads = 1;
+  };
+
   OutlierRemovingPointsProcessor(double voxel_size, double miss_per_hit_limit,
                                  PointsProcessor* next);
+  OutlierRemovingPointsProcessor(double voxel_size, double miss_per_hit_limit,
+                                 const TileOptions& tile_options,
+                                 PointsProcessor* next);
 
   static std::unique_ptr<OutlierRemovingPointsProcessor> FromDictionary(
       common::LuaParameterDictionary* dictionary, PointsProcessor* next);
 
-  ~OutlierRemovingPointsProcessor() override {}
+  ~OutlierRemovingPointsProcessor() override;
 
   OutlierRemovingPointsProcessor(const OutlierRemovingPointsProcessor&) =
       delete;
@@ -76,11 +96,20 @@ class OutlierRemovingPointsProcessor : public PointsProcessor {
   // hit-to-ray ratio.
   void ProcessInPhaseThree(std::unique_ptr<PointsBatch> batch);
 
+  // Tiled alternative to the three phases.
+  void ProcessTiled(const PointsBatch& batch);
+  FlushResult FlushTiled();
+
   const double voxel_size_;
   const double miss_per_hit_limit_;
+  const TileOptions tile_options_;
   PointsProcessor* const next_;
   State state_;
   mapping::HybridGridBase<VoxelData> voxels_;
+  // Only used with tiles.
+  std::unique_ptr<OutlierTileStore> tile_store_;
+  std::string points_cache_filename_;
+  std::unique_ptr<PointsCacheWriter> points_cache_writer_;
 };
 
 }  // namespace io
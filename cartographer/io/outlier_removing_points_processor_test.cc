@@ -0,0 +1,123 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/io/outlier_removing_points_processor.h"
+
+#include <random>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace io {
+namespace {
+
+// Records the points which were not removed, one vector per batch.
+class RecordingPointsProcessor : public PointsProcessor {
+ public:
+  void Process(std::unique_ptr<PointsBatch> batch) override {
+    std::vector<Eigen::Vector3f> points;
+    for (size_t i = 0; i < batch->points.size(); ++i) {
+      if (!IsPointRemoved(*batch, i)) {
+        points.push_back(batch->points[i].position);
+      }
+    }
+    batches_.push_back(points);
+  }
+  FlushResult Flush() override { return FlushResult::kFinished; }
+
+  const std::vector<std::vector<Eigen::Vector3f>>& batches() const {
+    return batches_;
+  }
+
+ private:
+  std::vector<std::vector<Eigen::Vector3f>> batches_;
+};
+
+// A sensor driving along a wall, passing a person who walks away.
+std::vector<PointsBatch> CreateBatches() {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> distribution(-0.5f, 0.5f);
+  std::vector<PointsBatch> batches;
+  for (int i = 0; i != 40; ++i) {
+    PointsBatch batch;
+    batch.start_time = common::FromUniversal(i);
+    batch.origin = Eigen::Vector3f(0.1f * i, 0.f, 1.f);
+    for (int j = 0; j != 200; ++j) {
+      batch.points.push_back({Eigen::Vector3f(
+          0.1f * i + 4.f * distribution(rng), 3.f, 1.f + distribution(rng))});
+    }
+    for (int j = 0; j != 20; ++j) {
+      batch.points.push_back(
+          {Eigen::Vector3f(0.1f * i + 0.2f * distribution(rng),
+                           1.f + 0.05f * i, 1.f + distribution(rng))});
+    }
+    // Already removed points are ignored.
+    batch.points.push_back({Eigen::Vector3f(0.1f * i, 2.f, 1.f)});
+    MarkPointRemoved(batch.points.size() - 1, &batch);
+    batches.push_back(batch);
+  }
+  return batches;
+}
+
+// Returns the number of times the data was streamed.
+int StreamBatches(const std::vector<PointsBatch>& batches,
+                  PointsProcessor* const processor) {
+  int num_passes = 0;
+  do {
+    ++num_passes;
+    for (const PointsBatch& batch : batches) {
+      processor->Process(absl::make_unique<PointsBatch>(batch));
+    }
+  } while (processor->Flush() == PointsProcessor::FlushResult::kRestartStream);
+  return num_passes;
+}
+
+TEST(OutlierRemovingPointsProcessorTest, TilesGiveSameResultInOnePass) {
+  const std::vector<PointsBatch> batches = CreateBatches();
+  RecordingPointsProcessor in_memory_result;
+  OutlierRemovingPointsProcessor in_memory(0.1 /* voxel_size */,
+                                           3. /* miss_per_hit_limit */,
+                                           &in_memory_result);
+  EXPECT_EQ(StreamBatches(batches, &in_memory), 3);
+
+  RecordingPointsProcessor tiled_result;
+  OutlierRemovingPointsProcessor::TileOptions tile_options;
+  tile_options.tile_size = 7;
+  // Spills the tiles many times.
+  tile_options.max_buffered_bytes = 1 << 14;
+  tile_options.directory = ::testing::TempDir();
+  tile_options.num_threads = 3;
+  OutlierRemovingPointsProcessor tiled(0.1 /* voxel_size */,
+                                       3. /* miss_per_hit_limit */,
+                                       tile_options, &tiled_result);
+  EXPECT_EQ(StreamBatches(batches, &tiled), 1);
+
+  ASSERT_EQ(tiled_result.batches().size(), batches.size());
+  size_t num_remaining_points = 0;
+  for (size_t i = 0; i != batches.size(); ++i) {
+    EXPECT_EQ(tiled_result.batches()[i], in_memory_result.batches()[i]);
+    num_remaining_points += tiled_result.batches()[i].size();
+  }
+  // Some points of the walking person are removed, but most remain.
+  EXPECT_LT(num_remaining_points, batches.size() * 220);
+  EXPECT_GT(num_remaining_points, batches.size() * 100);
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace cartographer
@@ -0,0 +1,279 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/io/outlier_tile_store.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "cartographer/common/math.h"
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace io {
+namespace {
+
+struct VoxelData {
+  int hits = 0;
+  int rays = 0;
+};
+
+int FloorDivide(const int value, const int divisor) {
+  return value >= 0 ? value / divisor : -((-value - 1) / divisor) - 1;
+}
+
+Eigen::Vector3f ToEigen(const std::array<float, 3>& value) {
+  return Eigen::Vector3f(value[0], value[1], value[2]);
+}
+
+}  // namespace
+
+OutlierTileStore::OutlierTileStore(const double voxel_size,
+                                   const int tile_size,
+                                   const size_t max_buffered_bytes,
+                                   const std::string& directory)
+    : voxel_size_(voxel_size),
+      resolution_(voxel_size),
+      tile_size_(tile_size),
+      max_buffered_bytes_(max_buffered_bytes),
+      directory_(directory + "/outlier_tiles_XXXXXX") {
+  CHECK_GT(voxel_size_, 0.);
+  CHECK_GT(tile_size_, 0);
+  CHECK(mkdtemp(&directory_[0]) != nullptr)
+      << "Cannot create a directory for outlier removal tiles below "
+      << directory;
+}
+
+OutlierTileStore::~OutlierTileStore() {
+  for (const TileIndex& tile_index : spilled_tiles_) {
+    std::remove(GetTileFilename(tile_index).c_str());
+  }
+  std::remove(directory_.c_str());
+}
+
+Eigen::Array3i OutlierTileStore::GetCellIndex(
+    const Eigen::Vector3f& point) const {
+  const Eigen::Array3f index = point.array() / resolution_;
+  return Eigen::Array3i(common::RoundToInt(index.x()),
+                        common::RoundToInt(index.y()),
+                        common::RoundToInt(index.z()));
+}
+
+OutlierTileStore::TileIndex OutlierTileStore::GetTileIndex(
+    const Eigen::Array3i& cell_index) const {
+  return TileIndex(FloorDivide(cell_index.x(), tile_size_),
+                   FloorDivide(cell_index.y(), tile_size_));
+}
+
+bool OutlierTileStore::ClipToTile(const Eigen::Vector3f& origin,
+                                  const Eigen::Vector3f& delta,
+                                  const TileIndex& tile_index,
+                                  float* const begin, float* const end) const {
+  // The cells of the tile cover [-0.5, tile_size - 0.5) voxels from its
+  // first cell. One more voxel on each side allows for rounding.
+  const Eigen::Array2f min =
+      (Eigen::Array2f(tile_index.first, tile_index.second) * tile_size_ -
+       1.5f) *
+      resolution_;
+  const Eigen::Array2f max = min + (tile_size_ + 2.f) * resolution_;
+  *begin = 0.f;
+  *end = 1.f;
+  for (int i = 0; i != 2; ++i) {
+    if (delta[i] == 0.f) {
+      if (origin[i] < min[i] || origin[i] > max[i]) {
+        return false;
+      }
+      continue;
+    }
+    float enter = (min[i] - origin[i]) / delta[i];
+    float leave = (max[i] - origin[i]) / delta[i];
+    if (enter > leave) {
+      std::swap(enter, leave);
+    }
+    *begin = std::max(*begin, enter);
+    *end = std::min(*end, leave);
+  }
+  return *begin <= *end;
+}
+
+void OutlierTileStore::Insert(const Eigen::Vector3f& origin,
+                              const Eigen::Vector3f& point) {
+  const Ray ray{{{origin.x(), origin.y(), origin.z()}},
+                {{point.x(), point.y(), point.z()}},
+                num_points_++};
+  const Eigen::Vector3f delta = point - origin;
+  const Eigen::Array3i origin_cell_index = GetCellIndex(origin);
+  const Eigen::Array3i point_cell_index = GetCellIndex(point);
+  const TileIndex min_tile_index =
+      GetTileIndex(origin_cell_index.min(point_cell_index) - 1);
+  const TileIndex max_tile_index =
+      GetTileIndex(origin_cell_index.max(point_cell_index) + 1);
+  for (int x = min_tile_index.first; x <= max_tile_index.first; ++x) {
+    for (int y = min_tile_index.second; y <= max_tile_index.second; ++y) {
+      float begin;
+      float end;
+      if (ClipToTile(origin, delta, TileIndex(x, y), &begin, &end)) {
+        tiles_[TileIndex(x, y)].push_back(ray);
+        num_buffered_bytes_ += sizeof(Ray);
+      }
+    }
+  }
+  if (num_buffered_bytes_ > max_buffered_bytes_) {
+    SpillTiles();
+  }
+}
+
+std::string OutlierTileStore::GetTileFilename(
+    const TileIndex& tile_index) const {
+  return absl::StrCat(directory_, "/", tile_index.first, "_",
+                      tile_index.second, ".rays");
+}
+
+void OutlierTileStore::SpillTiles() {
+  for (const auto& entry : tiles_) {
+    std::ofstream stream(GetTileFilename(entry.first),
+                         std::ios::binary | std::ios::app);
+    stream.write(reinterpret_cast<const char*>(entry.second.data()),
+                 entry.second.size() * sizeof(Ray));
+    CHECK(stream) << "Failed to write " << GetTileFilename(entry.first);
+    spilled_tiles_.insert(entry.first);
+  }
+  tiles_.clear();
+  num_buffered_bytes_ = 0;
+}
+
+std::vector<OutlierTileStore::Ray> OutlierTileStore::LoadTile(
+    const TileIndex& tile_index) const {
+  std::vector<Ray> rays;
+  if (spilled_tiles_.count(tile_index) != 0) {
+    std::ifstream stream(GetTileFilename(tile_index),
+                         std::ios::binary | std::ios::ate);
+    CHECK(stream) << "Failed to open " << GetTileFilename(tile_index);
+    const std::streamoff size = stream.tellg();
+    CHECK_EQ(size % sizeof(Ray), 0);
+    rays.resize(size / sizeof(Ray));
+    stream.seekg(0);
+    CHECK(stream.read(reinterpret_cast<char*>(rays.data()), size))
+        << "Failed to read " << GetTileFilename(tile_index);
+  }
+  const auto it = tiles_.find(tile_index);
+  if (it != tiles_.end()) {
+    rays.insert(rays.end(), it->second.begin(), it->second.end());
+  }
+  return rays;
+}
+
+void OutlierTileStore::ComputeTileOutliers(
+    const TileIndex& tile_index, const double miss_per_hit_limit,
+    std::vector<uint64>* const outliers) const {
+  const std::vector<Ray> rays = LoadTile(tile_index);
+  absl::flat_hash_map<std::array<int32, 3>, VoxelData> voxels;
+  const auto get_key = [](const Eigen::Array3i& cell_index) {
+    return std::array<int32, 3>{
+        {cell_index.x(), cell_index.y(), cell_index.z()}};
+  };
+  // Only hits in this tile are counted, each ray of a hit elsewhere is also
+  // stored in the tile of its hit.
+  for (const Ray& ray : rays) {
+    const Eigen::Array3i cell_index = GetCellIndex(ToEigen(ray.point));
+    if (GetTileIndex(cell_index) == tile_index) {
+      ++voxels[get_key(cell_index)].hits;
+    }
+  }
+  for (const Ray& ray : rays) {
+    const Eigen::Vector3f origin = ToEigen(ray.origin);
+    const Eigen::Vector3f delta = ToEigen(ray.point) - origin;
+    const float length = delta.norm();
+    float begin;
+    float end;
+    if (!ClipToTile(origin, delta, tile_index, &begin, &end)) {
+      continue;
+    }
+    // Samples are taken every 'voxel_size_' along the ray exactly like in
+    // OutlierRemovingPointsProcessor, but only near this tile.
+    const int begin_sample =
+        std::max(0, static_cast<int>(begin * length / voxel_size_) - 1);
+    const int end_sample = static_cast<int>(end * length / voxel_size_) + 2;
+    for (int k = begin_sample; k < end_sample && k * voxel_size_ < length;
+         ++k) {
+      const float x = k * voxel_size_;
+      const Eigen::Array3i cell_index =
+          GetCellIndex(origin + (x / length) * delta);
+      if (GetTileIndex(cell_index) != tile_index) {
+        continue;
+      }
+      const auto it = voxels.find(get_key(cell_index));
+      if (it != voxels.end()) {
+        ++it->second.rays;
+      }
+    }
+  }
+  for (const Ray& ray : rays) {
+    const Eigen::Array3i cell_index = GetCellIndex(ToEigen(ray.point));
+    if (GetTileIndex(cell_index) != tile_index) {
+      continue;
+    }
+    const VoxelData& voxel = voxels.at(get_key(cell_index));
+    if (!(voxel.rays < miss_per_hit_limit * voxel.hits)) {
+      outliers->push_back(ray.point_index);
+    }
+  }
+}
+
+std::vector<bool> OutlierTileStore::ComputeOutliers(
+    const double miss_per_hit_limit, const int num_threads) const {
+  std::vector<TileIndex> tile_indices(spilled_tiles_.begin(),
+                                      spilled_tiles_.end());
+  for (const auto& entry : tiles_) {
+    if (spilled_tiles_.count(entry.first) == 0) {
+      tile_indices.push_back(entry.first);
+    }
+  }
+
+  std::vector<bool> is_outlier(num_points_, false);
+  absl::Mutex mutex;
+  std::atomic<size_t> next_tile(0);
+  const auto process_tiles = [this, &tile_indices, &next_tile,
+                              miss_per_hit_limit, &mutex, &is_outlier]() {
+    std::vector<uint64> outliers;
+    for (size_t i = next_tile++; i < tile_indices.size(); i = next_tile++) {
+      ComputeTileOutliers(tile_indices[i], miss_per_hit_limit, &outliers);
+    }
+    absl::MutexLock lock(&mutex);
+    for (const uint64 point_index : outliers) {
+      is_outlier[point_index] = true;
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < num_threads; ++i) {
+    threads.emplace_back(process_tiles);
+  }
+  process_tiles();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return is_outlier;
+}
+
+}  // namespace io
+}  // namespace cartographer
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_IO_OUTLIER_TILE_STORE_H_
+#define CARTOGRAPHER_IO_OUTLIER_TILE_STORE_H_
+
+#include <array>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Eigen/Core"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "cartographer/common/port.h"
+
+namespace cartographer {
+namespace io {
+
+// Collects the rays from the sensor origin to each hit for the outlier
+// removal of OutlierRemovingPointsProcessor, sorted into tiles of
+// 'tile_size' x 'tile_size' voxel columns in the x-y plane. Every ray is kept
+// in each tile it passes through. Whenever more than 'max_buffered_bytes' are
+// held in memory, all tiles are appended to files in a temporary directory
+// below 'directory' and cleared, so the voxels of the whole map never need to
+// be in memory at once.
+class OutlierTileStore {
+ public:
+  OutlierTileStore(double voxel_size, int tile_size, size_t max_buffered_bytes,
+                   const std::string& directory);
+  ~OutlierTileStore();
+
+  OutlierTileStore(const OutlierTileStore&) = delete;
+  OutlierTileStore& operator=(const OutlierTileStore&) = delete;
+
+  // The temporary directory, which may also be used for other files that are
+  // removed before this store is destroyed.
+  const std::string& directory() const { return directory_; }
+
+  // Adds the ray from 'origin' to the hit 'point'. Hits are numbered in the
+  // order in which they are added.
+  void Insert(const Eigen::Vector3f& origin, const Eigen::Vector3f& point);
+  uint64 num_points() const { return num_points_; }
+
+  // Returns a flag for each hit which is set if it lies in a voxel which more
+  // than 'miss_per_hit_limit' rays per hit pass through, i.e. the same
+  // decision as OutlierRemovingPointsProcessor makes in memory. Tiles are
+  // handled independently on 'num_threads' threads.
+  std::vector<bool> ComputeOutliers(double miss_per_hit_limit,
+                                    int num_threads) const;
+
+ private:
+  struct Ray {
+    std::array<float, 3> origin;
+    std::array<float, 3> point;
+    uint64 point_index;
+  };
+  using TileIndex = std::pair<int, int>;
+
+  Eigen::Array3i GetCellIndex(const Eigen::Vector3f& point) const;
+  TileIndex GetTileIndex(const Eigen::Array3i& cell_index) const;
+  // Returns false if the ray does not get near the tile, otherwise the range
+  // of ray parameters in [0, 1] which may lie in it.
+  bool ClipToTile(const Eigen::Vector3f& origin, const Eigen::Vector3f& delta,
+                  const TileIndex& tile_index, float* begin, float* end) const;
+  std::string GetTileFilename(const TileIndex& tile_index) const;
+  void SpillTiles();
+  std::vector<Ray> LoadTile(const TileIndex& tile_index) const;
+  void ComputeTileOutliers(const TileIndex& tile_index,
+                           double miss_per_hit_limit,
+                           std::vector<uint64>* outliers) const;
+
+  const double voxel_size_;
+  // Same as the resolution of the 'HybridGrid' of the in memory filter.
+  const float resolution_;
+  const int tile_size_;
+  const size_t max_buffered_bytes_;
+  std::string directory_;
+  uint64 num_points_ = 0;
+  size_t num_buffered_bytes_ = 0;
+  absl::flat_hash_map<TileIndex, std::vector<Ray>> tiles_;
+  absl::flat_hash_set<TileIndex> spilled_tiles_;
+};
+
+}  // namespace io
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_IO_OUTLIER_TILE_STORE_H_
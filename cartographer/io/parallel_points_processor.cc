@@ -0,0 +1,119 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/io/parallel_points_processor.h"
+
+#include "absl/memory/memory.h"
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace io {
+
+void ParallelPointsProcessor::CollectingPointsProcessor::Process(
+    std::unique_ptr<PointsBatch> batch) {
+  CHECK(batch_ == nullptr)
+      << "Stages run in parallel must pass on at most one batch.";
+  batch_ = std::move(batch);
+}
+
+PointsProcessor::FlushResult
+ParallelPointsProcessor::CollectingPointsProcessor::Flush() {
+  LOG(FATAL) << "Stages run in parallel must not be flushed.";
+  return FlushResult::kFinished;
+}
+
+ParallelPointsProcessor::ParallelPointsProcessor(
+    const int num_workers, const size_t queue_size,
+    const StagesFactory& create_stages, PointsProcessor* const next)
+    : next_(next) {
+  CHECK_GT(num_workers, 0);
+  for (int i = 0; i != num_workers; ++i) {
+    auto worker = absl::make_unique<Worker>(queue_size);
+    worker->stages = create_stages(&worker->collector);
+    workers_.push_back(std::move(worker));
+  }
+  for (const auto& worker : workers_) {
+    Worker* const worker_ptr = worker.get();
+    worker->thread = std::thread([this, worker_ptr]() { DoWork(worker_ptr); });
+  }
+  forwarding_thread_ = std::thread([this]() { ForwardResults(); });
+}
+
+ParallelPointsProcessor::~ParallelPointsProcessor() {
+  for (const auto& worker : workers_) {
+    worker->input_queue.Push(nullptr);
+  }
+  for (const auto& worker : workers_) {
+    worker->thread.join();
+  }
+  // The forwarding thread exits on the nullptr result of the next worker in
+  // the round-robin order.
+  forwarding_thread_.join();
+}
+
+void ParallelPointsProcessor::Process(std::unique_ptr<PointsBatch> batch) {
+  {
+    absl::MutexLock locker(&mutex_);
+    ++num_pending_batches_;
+  }
+  workers_[next_worker_index_]->input_queue.Push(std::move(batch));
+  next_worker_index_ = (next_worker_index_ + 1) % workers_.size();
+}
+
+PointsProcessor::FlushResult ParallelPointsProcessor::Flush() {
+  {
+    const auto predicate = [this]() EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+      return num_pending_batches_ == 0;
+    };
+    absl::MutexLock locker(&mutex_);
+    mutex_.Await(absl::Condition(&predicate));
+  }
+  return next_->Flush();
+}
+
+void ParallelPointsProcessor::DoWork(Worker* const worker) {
+  PointsProcessor* const first_stage = worker->stages.empty()
+                                           ? &worker->collector
+                                           : worker->stages.back().get();
+  for (;;) {
+    std::unique_ptr<PointsBatch> batch = worker->input_queue.Pop();
+    if (batch == nullptr) {
+      worker->output_queue.Push(nullptr);
+      return;
+    }
+    first_stage->Process(std::move(batch));
+    worker->output_queue.Push(
+        absl::make_unique<Result>(Result{worker->collector.TakeBatch()}));
+  }
+}
+
+void ParallelPointsProcessor::ForwardResults() {
+  for (size_t worker_index = 0;;
+       worker_index = (worker_index + 1) % workers_.size()) {
+    std::unique_ptr<Result> result = workers_[worker_index]->output_queue.Pop();
+    if (result == nullptr) {
+      return;
+    }
+    if (result->batch != nullptr) {
+      next_->Process(std::move(result->batch));
+    }
+    absl::MutexLock locker(&mutex_);
+    --num_pending_batches_;
+  }
+}
+
+}  // namespace io
+}  // namespace cartographer
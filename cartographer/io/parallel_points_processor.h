@@ -0,0 +1,108 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_IO_PARALLEL_POINTS_PROCESSOR_H_
+#define CARTOGRAPHER_IO_PARALLEL_POINTS_PROCESSOR_H_
+
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "cartographer/common/internal/blocking_queue.h"
+#include "cartographer/io/points_processor.h"
+
+namespace cartographer {
+namespace io {
+
+// Runs a chain of stateless processors on several batches at once and hands
+// the results to 'next' in the order in which the batches arrived.
+//
+// Every worker gets its own copy of the chain from 'create_stages', which
+// builds it in the same back-to-front order as the pipeline builder, i.e. the
+// first stage is the last element. The stages may drop a batch or pass on a
+// single batch per call to 'Process', and must do no work in 'Flush', which
+// is not forwarded to them.
+class ParallelPointsProcessor : public PointsProcessor {
+ public:
+  using StagesFactory =
+      std::function<std::vector<std::unique_ptr<PointsProcessor>>(
+          PointsProcessor* next)>;
+
+  ParallelPointsProcessor(int num_workers, size_t queue_size,
+                          const StagesFactory& create_stages,
+                          PointsProcessor* next);
+  ~ParallelPointsProcessor() override;
+
+  ParallelPointsProcessor(const ParallelPointsProcessor&) = delete;
+  ParallelPointsProcessor& operator=(const ParallelPointsProcessor&) = delete;
+
+  // Must not be called concurrently.
+  void Process(std::unique_ptr<PointsBatch> batch) override;
+
+  // Waits until all batches have been handed to 'next' and flushes it on the
+  // calling thread.
+  FlushResult Flush() override;
+
+ private:
+  // Keeps the output of a worker's stages for one input batch.
+  class CollectingPointsProcessor : public PointsProcessor {
+   public:
+    void Process(std::unique_ptr<PointsBatch> batch) override;
+    FlushResult Flush() override;
+
+    std::unique_ptr<PointsBatch> TakeBatch() { return std::move(batch_); }
+
+   private:
+    std::unique_ptr<PointsBatch> batch_;
+  };
+
+  // What a worker produced from one input batch. 'batch' is nullptr if the
+  // input was dropped.
+  struct Result {
+    std::unique_ptr<PointsBatch> batch;
+  };
+
+  struct Worker {
+    explicit Worker(size_t queue_size)
+        : input_queue(queue_size), output_queue(queue_size) {}
+
+    CollectingPointsProcessor collector;
+    std::vector<std::unique_ptr<PointsProcessor>> stages;
+    // A nullptr in either queue tells the receiving thread to exit.
+    common::BlockingQueue<std::unique_ptr<PointsBatch>> input_queue;
+    common::BlockingQueue<std::unique_ptr<Result>> output_queue;
+    std::thread thread;
+  };
+
+  void DoWork(Worker* worker);
+  void ForwardResults();
+
+  PointsProcessor* const next_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  // Batches are distributed round-robin, so the results are collected in the
+  // same order to restore the input order.
+  size_t next_worker_index_ = 0;
+  absl::Mutex mutex_;
+  int num_pending_batches_ GUARDED_BY(mutex_) = 0;
+  std::thread forwarding_thread_;
+};
+
+}  // namespace io
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_IO_PARALLEL_POINTS_PROCESSOR_H_
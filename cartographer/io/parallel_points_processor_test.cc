@@ -0,0 +1,116 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/io/parallel_points_processor.h"
+
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "cartographer/io/frame_id_filtering_points_processor.h"
+#include "cartographer/io/min_max_range_filtering_points_processor.h"
+#include "cartographer/io/queued_points_processor.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace io {
+namespace {
+
+// Records the order of the batches it receives. Only called from one thread.
+class RecordingPointsProcessor : public PointsProcessor {
+ public:
+  void Process(std::unique_ptr<PointsBatch> batch) override {
+    trajectory_ids_.push_back(batch->trajectory_id);
+    num_points_.push_back(NumRemainingPoints(*batch));
+  }
+  FlushResult Flush() override {
+    ++num_flushes_;
+    return FlushResult::kFinished;
+  }
+
+  const std::vector<int>& trajectory_ids() const { return trajectory_ids_; }
+  const std::vector<size_t>& num_points() const { return num_points_; }
+  int num_flushes() const { return num_flushes_; }
+
+ private:
+  std::vector<int> trajectory_ids_;
+  std::vector<size_t> num_points_;
+  int num_flushes_ = 0;
+};
+
+std::unique_ptr<PointsBatch> CreateBatch(const int index) {
+  auto batch = absl::make_unique<PointsBatch>();
+  // The trajectory ID serves as a sequence number.
+  batch->trajectory_id = index;
+  batch->frame_id = index % 3 == 0 ? "dropped" : "kept";
+  batch->points.push_back({Eigen::Vector3f(1.f, 0.f, 0.f)});
+  batch->points.push_back({Eigen::Vector3f(10.f, 0.f, 0.f)});
+  return batch;
+}
+
+ParallelPointsProcessor::StagesFactory CreateFilteringStages() {
+  return [](PointsProcessor* const next) {
+    std::vector<std::unique_ptr<PointsProcessor>> stages;
+    stages.push_back(absl::make_unique<MinMaxRangeFilteringPointsProcessor>(
+        0., 5., next));
+    stages.push_back(absl::make_unique<FrameIdFilteringPointsProcessor>(
+        absl::flat_hash_set<std::string>{"kept"},
+        absl::flat_hash_set<std::string>(), stages.back().get()));
+    return stages;
+  };
+}
+
+TEST(ParallelPointsProcessorTest, PreservesOrder) {
+  constexpr int kNumBatches = 1000;
+  RecordingPointsProcessor recorder;
+  ParallelPointsProcessor parallel(4 /* num_workers */, 2 /* queue_size */,
+                                   CreateFilteringStages(), &recorder);
+  for (int i = 0; i != kNumBatches; ++i) {
+    parallel.Process(CreateBatch(i));
+  }
+  EXPECT_EQ(parallel.Flush(), PointsProcessor::FlushResult::kFinished);
+  EXPECT_EQ(recorder.num_flushes(), 1);
+
+  std::vector<int> expected_trajectory_ids;
+  for (int i = 0; i != kNumBatches; ++i) {
+    if (i % 3 != 0) {
+      expected_trajectory_ids.push_back(i);
+    }
+  }
+  EXPECT_EQ(recorder.trajectory_ids(), expected_trajectory_ids);
+  for (const size_t num_points : recorder.num_points()) {
+    EXPECT_EQ(num_points, 1);
+  }
+}
+
+TEST(ParallelPointsProcessorTest, FeedsQueuedStage) {
+  constexpr int kNumBatches = 100;
+  RecordingPointsProcessor recorder;
+  QueuedPointsProcessor queued(2 /* queue_size */, &recorder);
+  ParallelPointsProcessor parallel(3 /* num_workers */, 2 /* queue_size */,
+                                   CreateFilteringStages(), &queued);
+  for (int round = 1; round != 3; ++round) {
+    for (int i = 0; i != kNumBatches; ++i) {
+      parallel.Process(CreateBatch(i));
+    }
+    EXPECT_EQ(parallel.Flush(), PointsProcessor::FlushResult::kFinished);
+    EXPECT_EQ(recorder.num_flushes(), round);
+  }
+  EXPECT_EQ(recorder.trajectory_ids().size(), 2 * (kNumBatches * 2 / 3));
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace cartographer
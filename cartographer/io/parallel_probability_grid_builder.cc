@@ -0,0 +1,260 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/io/parallel_probability_grid_builder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+#include "Eigen/Geometry"
+#include "absl/memory/memory.h"
+#include "cartographer/common/math.h"
+#include "cartographer/mapping/2d/xy_index.h"
+#include "cartographer/mapping/internal/2d/ray_to_pixel_mask.h"
+#include "cartographer/mapping/probability_values.h"
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace io {
+namespace {
+
+// Factor for subpixel accuracy of start and end point for ray casts, same as
+// in ProbabilityGridRangeDataInserter2D.
+constexpr int kSubpixelScale = 1000;
+
+// Number of range data cast per thread in one round.
+constexpr size_t kRangeDataPerThreadAndRound = 16;
+
+int FloorDivide(const int value, const int divisor) {
+  return value >= 0 ? value / divisor : -((-value - 1) / divisor) - 1;
+}
+
+// Calls 'function' for every index in [0, 'num_tasks') on 'num_threads'
+// threads.
+template <typename FunctionType>
+void RunInParallel(const int num_threads, const size_t num_tasks,
+                   const FunctionType& function) {
+  std::atomic<size_t> next_task(0);
+  const auto run_tasks = [&next_task, num_tasks, &function]() {
+    for (size_t i = next_task++; i < num_tasks; i = next_task++) {
+      function(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < std::min<size_t>(num_threads, num_tasks); ++i) {
+    threads.emplace_back(run_tasks);
+  }
+  run_tasks();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace
+
+ParallelProbabilityGridBuilder::ParallelProbabilityGridBuilder(
+    const double resolution,
+    const mapping::proto::ProbabilityGridRangeDataInserterOptions2D& options,
+    const int tile_size, const int num_threads,
+    mapping::ValueConversionTables* const conversion_tables)
+    : resolution_(resolution),
+      insert_free_space_(options.insert_free_space()),
+      hit_table_(mapping::ComputeLookupTableToApplyCorrespondenceCostOdds(
+          mapping::Odds(options.hit_probability()))),
+      miss_table_(mapping::ComputeLookupTableToApplyCorrespondenceCostOdds(
+          mapping::Odds(options.miss_probability()))),
+      tile_size_(tile_size),
+      num_threads_(num_threads),
+      conversion_tables_(conversion_tables) {
+  CHECK_GT(tile_size_, 0);
+  CHECK_GT(num_threads_, 0);
+}
+
+void ParallelProbabilityGridBuilder::Insert(sensor::RangeData range_data) {
+  pending_range_data_.push_back(std::move(range_data));
+  if (pending_range_data_.size() >=
+      kRangeDataPerThreadAndRound * num_threads_) {
+    InsertPending();
+  }
+}
+
+mapping::ProbabilityGrid ParallelProbabilityGridBuilder::Finish() {
+  InsertPending();
+  if (tiles_.empty()) {
+    return mapping::ProbabilityGrid(GetTileLimits({0, 0}), conversion_tables_);
+  }
+
+  TileIndex min_tile = tiles_.begin()->first;
+  TileIndex max_tile = min_tile;
+  for (const auto& entry : tiles_) {
+    min_tile.first = std::min(min_tile.first, entry.first.first);
+    min_tile.second = std::min(min_tile.second, entry.first.second);
+    max_tile.first = std::max(max_tile.first, entry.first.first);
+    max_tile.second = std::max(max_tile.second, entry.first.second);
+  }
+  const mapping::MapLimits min_tile_limits = GetTileLimits(min_tile);
+  mapping::ProbabilityGrid probability_grid(
+      mapping::MapLimits(
+          resolution_, min_tile_limits.max(),
+          mapping::CellLimits(
+              (max_tile.first - min_tile.first + 1) * tile_size_,
+              (max_tile.second - min_tile.second + 1) * tile_size_)),
+      conversion_tables_);
+  for (const auto& entry : tiles_) {
+    const mapping::ProbabilityGrid& tile = *entry.second;
+    const Eigen::Array2i tile_offset(
+        (entry.first.first - min_tile.first) * tile_size_,
+        (entry.first.second - min_tile.second) * tile_size_);
+    Eigen::Array2i offset;
+    mapping::CellLimits cell_limits;
+    tile.ComputeCroppedLimits(&offset, &cell_limits);
+    for (const Eigen::Array2i& xy_index :
+         mapping::XYIndexRangeIterator(cell_limits)) {
+      const Eigen::Array2i index = xy_index + offset;
+      if (tile.IsKnown(index)) {
+        probability_grid.SetProbability(index + tile_offset,
+                                        tile.GetProbability(index));
+      }
+    }
+  }
+  tiles_.clear();
+  return probability_grid;
+}
+
+ParallelProbabilityGridBuilder::TileUpdates
+ParallelProbabilityGridBuilder::ComputeTileUpdates(
+    const sensor::RangeData& range_data) const {
+  // Cast the rays in limits around this range data which are aligned with the
+  // tiles, so that cell indices convert to tiles by an integer offset.
+  Eigen::AlignedBox2f bounding_box(range_data.origin.head<2>());
+  for (const sensor::RangefinderPoint& hit : range_data.returns) {
+    bounding_box.extend(hit.position.head<2>());
+  }
+  for (const sensor::RangefinderPoint& miss : range_data.misses) {
+    bounding_box.extend(miss.position.head<2>());
+  }
+  const Eigen::Array2i max_cell(
+      std::floor(bounding_box.max().y() / resolution_) + 2,
+      std::floor(bounding_box.max().x() / resolution_) + 2);
+  const Eigen::Array2i min_cell(
+      std::floor(bounding_box.min().y() / resolution_) - 1,
+      std::floor(bounding_box.min().x() / resolution_) - 1);
+  const Eigen::Vector2d max(max_cell.y() * resolution_,
+                            max_cell.x() * resolution_);
+  const mapping::CellLimits cell_limits(max_cell.x() - min_cell.x(),
+                                        max_cell.y() - min_cell.y());
+  const mapping::MapLimits superscaled_limits(
+      resolution_ / kSubpixelScale, max,
+      mapping::CellLimits(cell_limits.num_x_cells * kSubpixelScale,
+                          cell_limits.num_y_cells * kSubpixelScale));
+
+  TileUpdates tile_updates;
+  // Cell 'index' in the limits above is the cell 'index' - 'max_cell' of the
+  // global grid, in which tile 't' starts at cell 't' * 'tile_size_'.
+  const auto add_cell = [this, &max_cell, &tile_updates](
+                            const Eigen::Array2i& index, const bool is_hit) {
+    const Eigen::Array2i global_index = index - max_cell;
+    const TileIndex tile_index(FloorDivide(global_index.x(), tile_size_),
+                               FloorDivide(global_index.y(), tile_size_));
+    CellUpdates& updates = tile_updates[tile_index];
+    (is_hit ? updates.hits : updates.misses)
+        .push_back(global_index - tile_size_ * Eigen::Array2i(tile_index.first,
+                                                              tile_index.second));
+  };
+
+  const Eigen::Array2i begin =
+      superscaled_limits.GetCellIndex(range_data.origin.head<2>());
+  std::vector<Eigen::Array2i> ends;
+  ends.reserve(range_data.returns.size());
+  for (const sensor::RangefinderPoint& hit : range_data.returns) {
+    ends.push_back(superscaled_limits.GetCellIndex(hit.position.head<2>()));
+    add_cell(ends.back() / kSubpixelScale, true /* is_hit */);
+  }
+  if (!insert_free_space_) {
+    return tile_updates;
+  }
+
+  std::vector<Eigen::Array2i> ray;
+  for (const Eigen::Array2i& end : ends) {
+    mapping::RayToPixelMask(begin, end, kSubpixelScale, &ray);
+    for (const Eigen::Array2i& index : ray) {
+      add_cell(index, false /* is_hit */);
+    }
+  }
+  for (const sensor::RangefinderPoint& missing_echo : range_data.misses) {
+    mapping::RayToPixelMask(
+        begin, superscaled_limits.GetCellIndex(missing_echo.position.head<2>()),
+        kSubpixelScale, &ray);
+    for (const Eigen::Array2i& index : ray) {
+      add_cell(index, false /* is_hit */);
+    }
+  }
+  return tile_updates;
+}
+
+void ParallelProbabilityGridBuilder::InsertPending() {
+  std::vector<TileUpdates> tile_updates(pending_range_data_.size());
+  RunInParallel(num_threads_, pending_range_data_.size(),
+                [this, &tile_updates](const size_t i) {
+                  tile_updates[i] = ComputeTileUpdates(pending_range_data_[i]);
+                });
+  pending_range_data_.clear();
+
+  // The tiles updated in this round.
+  absl::flat_hash_map<TileIndex, mapping::ProbabilityGrid*> tiles_to_update;
+  for (const TileUpdates& updates : tile_updates) {
+    for (const auto& entry : updates) {
+      auto& tile = tiles_[entry.first];
+      if (tile == nullptr) {
+        tile = absl::make_unique<mapping::ProbabilityGrid>(
+            GetTileLimits(entry.first), conversion_tables_);
+      }
+      tiles_to_update[entry.first] = tile.get();
+    }
+  }
+  const std::vector<std::pair<TileIndex, mapping::ProbabilityGrid*>> tiles(
+      tiles_to_update.begin(), tiles_to_update.end());
+
+  // Each tile is only updated by a single thread. By not finishing the update
+  // after hits are inserted, we give hits priority like the inserter does.
+  RunInParallel(num_threads_, tiles.size(), [&tiles,
+                                             &tile_updates,
+                                             this](const size_t i) {
+    const TileIndex& tile_index = tiles[i].first;
+    mapping::ProbabilityGrid* const tile = tiles[i].second;
+    for (const TileUpdates& updates : tile_updates) {
+      const auto it = updates.find(tile_index);
+      if (it == updates.end()) continue;
+      tile->ApplyLookupTable(it->second.hits, hit_table_);
+      tile->ApplyLookupTable(it->second.misses, miss_table_);
+      tile->FinishUpdate();
+    }
+  });
+}
+
+mapping::MapLimits ParallelProbabilityGridBuilder::GetTileLimits(
+    const TileIndex& tile_index) const {
+  return mapping::MapLimits(
+      resolution_,
+      Eigen::Vector2d(-tile_index.second * tile_size_ * resolution_,
+                      -tile_index.first * tile_size_ * resolution_),
+      mapping::CellLimits(tile_size_, tile_size_));
+}
+
+}  // namespace io
+}  // namespace cartographer
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_IO_PARALLEL_PROBABILITY_GRID_BUILDER_H_
+#define CARTOGRAPHER_IO_PARALLEL_PROBABILITY_GRID_BUILDER_H_
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "Eigen/Core"
+#include "absl/container/flat_hash_map.h"
+#include "cartographer/common/port.h"
+#include "cartographer/mapping/2d/probability_grid.h"
+#include "cartographer/mapping/proto/probability_grid_range_data_inserter_options_2d.pb.h"
+#include "cartographer/mapping/value_conversion_tables.h"
+#include "cartographer/sensor/range_data.h"
+
+namespace cartographer {
+namespace io {
+
+// Builds a probability grid from range data on 'num_threads' threads. The
+// cells end up with the same probabilities as when inserting the range data
+// one after another using a ProbabilityGridRangeDataInserter2D.
+//
+// Range data is inserted in rounds. In each round, the rays of all pending
+// range data are cast in parallel and the resulting cell updates are sorted
+// into square tiles of 'tile_size' cells. Each tile then applies its updates
+// in the order of insertion. As tiles do not share cells, the result does not
+// depend on the number of threads.
+class ParallelProbabilityGridBuilder {
+ public:
+  ParallelProbabilityGridBuilder(
+      double resolution,
+      const mapping::proto::ProbabilityGridRangeDataInserterOptions2D& options,
+      int tile_size, int num_threads,
+      mapping::ValueConversionTables* conversion_tables);
+
+  ParallelProbabilityGridBuilder(const ParallelProbabilityGridBuilder&) =
+      delete;
+  ParallelProbabilityGridBuilder& operator=(
+      const ParallelProbabilityGridBuilder&) = delete;
+
+  void Insert(sensor::RangeData range_data);
+
+  // Inserts all pending range data and returns a grid covering all tiles.
+  // Afterwards, the builder is empty.
+  mapping::ProbabilityGrid Finish();
+
+ private:
+  using TileIndex = std::pair<int, int>;
+
+  struct CellUpdates {
+    std::vector<Eigen::Array2i> hits;
+    std::vector<Eigen::Array2i> misses;
+  };
+  using TileUpdates = absl::flat_hash_map<TileIndex, CellUpdates>;
+
+  TileUpdates ComputeTileUpdates(const sensor::RangeData& range_data) const;
+  void InsertPending();
+  mapping::MapLimits GetTileLimits(const TileIndex& tile_index) const;
+
+  const double resolution_;
+  const bool insert_free_space_;
+  const std::vector<uint16> hit_table_;
+  const std::vector<uint16> miss_table_;
+  const int tile_size_;
+  const int num_threads_;
+  mapping::ValueConversionTables* const conversion_tables_;
+
+  std::vector<sensor::RangeData> pending_range_data_;
+  absl::flat_hash_map<TileIndex, std::unique_ptr<mapping::ProbabilityGrid>>
+      tiles_;
+};
+
+}  // namespace io
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_IO_PARALLEL_PROBABILITY_GRID_BUILDER_H_
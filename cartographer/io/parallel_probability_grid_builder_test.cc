@@ -0,0 +1,122 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/io/parallel_probability_grid_builder.h"
+
+#include <random>
+
+#include "cartographer/mapping/2d/probability_grid_range_data_inserter_2d.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace io {
+namespace {
+
+constexpr double kResolution = 0.05;
+
+std::vector<sensor::RangeData> CreateRangeData() {
+  std::mt19937 prng(42);
+  std::uniform_real_distribution<float> distribution(-4.f, 4.f);
+  std::vector<sensor::RangeData> result;
+  for (int i = 0; i < 100; ++i) {
+    sensor::RangeData range_data;
+    range_data.origin =
+        Eigen::Vector3f(distribution(prng), distribution(prng), 0.f);
+    for (int j = 0; j < 40; ++j) {
+      range_data.returns.push_back(
+          {range_data.origin + Eigen::Vector3f(distribution(prng),
+                                               distribution(prng), 0.f)});
+    }
+    range_data.misses.push_back(
+        {range_data.origin +
+         Eigen::Vector3f(distribution(prng), distribution(prng), 0.f)});
+    result.push_back(range_data);
+  }
+  return result;
+}
+
+mapping::proto::ProbabilityGridRangeDataInserterOptions2D CreateOptions() {
+  mapping::proto::ProbabilityGridRangeDataInserterOptions2D options;
+  options.set_hit_probability(0.55);
+  options.set_miss_probability(0.49);
+  options.set_insert_free_space(true);
+  return options;
+}
+
+// Expects that 'actual' has the same known cells with the same probabilities
+// as 'expected'.
+void ExpectSameCells(const mapping::ProbabilityGrid& expected,
+                     const mapping::ProbabilityGrid& actual) {
+  int num_expected_known_cells = 0;
+  for (const Eigen::Array2i& xy_index :
+       mapping::XYIndexRangeIterator(expected.limits().cell_limits())) {
+    if (!expected.IsKnown(xy_index)) continue;
+    ++num_expected_known_cells;
+    const Eigen::Array2i actual_index = actual.limits().GetCellIndex(
+        expected.limits().GetCellCenter(xy_index));
+    ASSERT_TRUE(actual.IsKnown(actual_index));
+    EXPECT_EQ(expected.GetProbability(xy_index),
+              actual.GetProbability(actual_index));
+  }
+  int num_actual_known_cells = 0;
+  for (const Eigen::Array2i& xy_index :
+       mapping::XYIndexRangeIterator(actual.limits().cell_limits())) {
+    if (actual.IsKnown(xy_index)) ++num_actual_known_cells;
+  }
+  EXPECT_GT(num_expected_known_cells, 0);
+  EXPECT_EQ(num_expected_known_cells, num_actual_known_cells);
+}
+
+TEST(ParallelProbabilityGridBuilderTest, MatchesSequentialInsertion) {
+  const std::vector<sensor::RangeData> range_data = CreateRangeData();
+  mapping::ValueConversionTables conversion_tables;
+  mapping::ProbabilityGrid expected(
+      mapping::MapLimits(kResolution, Eigen::Vector2d(1., 1.),
+                         mapping::CellLimits(40, 40)),
+      &conversion_tables);
+  const mapping::ProbabilityGridRangeDataInserter2D range_data_inserter(
+      CreateOptions());
+  for (const sensor::RangeData& data : range_data) {
+    range_data_inserter.Insert(data, &expected);
+  }
+
+  for (const int num_threads : {1, 4}) {
+    ParallelProbabilityGridBuilder builder(kResolution, CreateOptions(),
+                                           16 /* tile_size */, num_threads,
+                                           &conversion_tables);
+    for (const sensor::RangeData& data : range_data) {
+      builder.Insert(data);
+    }
+    ExpectSameCells(expected, builder.Finish());
+  }
+}
+
+TEST(ParallelProbabilityGridBuilderTest, EmptyGrid) {
+  mapping::ValueConversionTables conversion_tables;
+  ParallelProbabilityGridBuilder builder(kResolution, CreateOptions(),
+                                         16 /* tile_size */,
+                                         2 /* num_threads */,
+                                         &conversion_tables);
+  const mapping::ProbabilityGrid probability_grid = builder.Finish();
+  for (const Eigen::Array2i& xy_index :
+       mapping::XYIndexRangeIterator(probability_grid.limits().cell_limits())) {
+    EXPECT_FALSE(probability_grid.IsKnown(xy_index));
+  }
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace cartographer
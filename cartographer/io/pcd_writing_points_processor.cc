@@ -16,12 +16,14 @@
 
 #include "cartographer/io/pcd_writing_points_processor.h"
 
+#include <cstring>
 #include <iomanip>
 #include <sstream>
 #include <string>
 
 #include "absl/memory/memory.h"
 #include "cartographer/common/lua_parameter_dictionary.h"
+#include "cartographer/io/chunked_file_writer.h"
 #include "cartographer/io/points_batch.h"
 #include "glog/logging.h"
 
@@ -56,23 +58,26 @@ void WriteBinaryPcdHeader(const bool has_color, const int64 num_points,
   file_writer->WriteHeader(out.data(), out.size());
 }
 
-void WriteBinaryPcdPointCoordinate(const Eigen::Vector3f& point,
-                                   FileWriter* const file_writer) {
-  char buffer[12];
-  memcpy(buffer, &point[0], sizeof(float));
-  memcpy(buffer + 4, &point[1], sizeof(float));
-  memcpy(buffer + 8, &point[2], sizeof(float));
-  CHECK(file_writer->Write(buffer, 12));
-}
-
-void WriteBinaryPcdPointColor(const Uint8Color& color,
-                              FileWriter* const file_writer) {
-  char buffer[4];
-  buffer[0] = color[2];
-  buffer[1] = color[1];
-  buffer[2] = color[0];
-  buffer[3] = 0;
-  CHECK(file_writer->Write(buffer, 4));
+// Encodes all points of 'batch' into 'buffer', so that they are handed to
+// the FileWriter at once.
+void EncodeBinaryPcdPoints(const PointsBatch& batch,
+                           std::string* const buffer) {
+  const bool has_colors = !batch.colors.empty();
+  const size_t point_size = 3 * sizeof(float) + (has_colors ? 4 : 0);
+  buffer->resize(batch.points.size() * point_size);
+  char* out = &(*buffer)[0];
+  for (size_t i = 0; i < batch.points.size(); ++i) {
+    memcpy(out, batch.points[i].position.data(), 3 * sizeof(float));
+    out += 3 * sizeof(float);
+    if (has_colors) {
+      const Uint8Color color = ToUint8Color(batch.colors[i]);
+      out[0] = color[2];
+      out[1] = color[1];
+      out[2] = color[0];
+      out[3] = 0;
+      out += 4;
+    }
+  }
 }
 
 }  // namespace
@@ -82,8 +87,12 @@ PcdWritingPointsProcessor::FromDictionary(
     FileWriterFactory file_writer_factory,
     common::LuaParameterDictionary* const dictionary,
     PointsProcessor* const next) {
+  const std::string filename = dictionary->GetString("filename");
   return absl::make_unique<PcdWritingPointsProcessor>(
-      file_writer_factory(dictionary->GetString("filename")), next);
+      absl::make_unique<ChunkedFileWriter>(
+          file_writer_factory(filename),
+          ChunkedFileWriterOptionsFromDictionary(dictionary)),
+      next);
 }
 
 PcdWritingPointsProcessor::PcdWritingPointsProcessor(
@@ -109,6 +118,7 @@ PointsProcessor::FlushResult PcdWritingPointsProcessor::Flush() {
 }
 
 void PcdWritingPointsProcessor::Process(std::unique_ptr<PointsBatch> batch) {
+  CompactPoints(batch.get());
   if (batch->points.empty()) {
     next_->Process(std::move(batch));
     return;
@@ -118,15 +128,9 @@ void PcdWritingPointsProcessor::Process(std::unique_ptr<PointsBatch> batch) {
     has_colors_ = !batch->colors.empty();
     WriteBinaryPcdHeader(has_colors_, 0, file_writer_.get());
   }
-  for (size_t i = 0; i < batch->points.size(); ++i) {
-    WriteBinaryPcdPointCoordinate(batch->points[i].position,
-                                  file_writer_.get());
-    if (!batch->colors.empty()) {
-      WriteBinaryPcdPointColor(ToUint8Color(batch->colors[i]),
-                               file_writer_.get());
-    }
-    ++num_points_;
-  }
+  EncodeBinaryPcdPoints(*batch, &buffer_);
+  CHECK(file_writer_->Write(buffer_.data(), buffer_.size()));
+  num_points_ += batch->points.size();
   next_->Process(std::move(batch));
 }
 
@@ -48,6 +48,8 @@ class PcdWritingPointsProcessor : public PointsProcessor {
 
   int64 num_points_;
   bool has_colors_;
+  // Reused for encoding each batch.
+  std::string buffer_;
   std::unique_ptr<FileWriter> file_writer_;
 };
 
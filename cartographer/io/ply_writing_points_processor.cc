@@ -16,12 +16,16 @@
 
 #include "cartographer/io/ply_writing_points_processor.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iomanip>
 #include <sstream>
 #include <string>
+#include <thread>
 
 #include "absl/memory/memory.h"
 #include "cartographer/common/lua_parameter_dictionary.h"
+#include "cartographer/io/chunked_file_writer.h"
 #include "cartographer/io/points_batch.h"
 #include "glog/logging.h"
 
@@ -59,27 +63,29 @@ void WriteBinaryPlyHeader(const bool has_color, const bool has_intensities,
   CHECK(file_writer->WriteHeader(out.data(), out.size()));
 }
 
-void WriteBinaryPlyPointCoordinate(const Eigen::Vector3f& point,
-                                   FileWriter* const file_writer) {
-  // TODO(sirver): This ignores endianness.
-  char buffer[12];
-  memcpy(buffer, &point[0], sizeof(float));
-  memcpy(buffer + 4, &point[1], sizeof(float));
-  memcpy(buffer + 8, &point[2], sizeof(float));
-  CHECK(file_writer->Write(buffer, 12));
-}
-
-void WriteBinaryIntensity(const float intensity,
-                          FileWriter* const file_writer) {
-  // TODO(sirver): This ignores endianness.
-  CHECK(file_writer->Write(reinterpret_cast<const char*>(&intensity),
-                           sizeof(float)));
-}
-
-void WriteBinaryPlyPointColor(const Uint8Color& color,
-                              FileWriter* const file_writer) {
-  CHECK(file_writer->Write(reinterpret_cast<const char*>(color.data()),
-                           color.size()));
+// Encodes all points of 'batch' into 'buffer', so that they are handed to
+// the FileWriter at once.
+void EncodeBinaryPlyPoints(const PointsBatch& batch, const bool has_colors,
+                           const bool has_intensities,
+                           std::string* const buffer) {
+  const size_t point_size = 3 * sizeof(float) + (has_colors ? 3 : 0) +
+                            (has_intensities ? sizeof(float) : 0);
+  buffer->resize(batch.points.size() * point_size);
+  char* out = &(*buffer)[0];
+  for (size_t i = 0; i < batch.points.size(); ++i) {
+    // TODO(sirver): This ignores endianness.
+    memcpy(out, batch.points[i].position.data(), 3 * sizeof(float));
+    out += 3 * sizeof(float);
+    if (has_colors) {
+      const Uint8Color color = ToUint8Color(batch.colors[i]);
+      memcpy(out, color.data(), color.size());
+      out += color.size();
+    }
+    if (has_intensities) {
+      memcpy(out, &batch.intensities[i], sizeof(float));
+      out += sizeof(float);
+    }
+  }
 }
 
 }  // namespace
@@ -89,8 +95,11 @@ PlyWritingPointsProcessor::FromDictionary(
     const FileWriterFactory& file_writer_factory,
     common::LuaParameterDictionary* const dictionary,
     PointsProcessor* const next) {
+  const std::string filename = dictionary->GetString("filename");
   return absl::make_unique<PlyWritingPointsProcessor>(
-      file_writer_factory(dictionary->GetString("filename")),
+      absl::make_unique<ChunkedFileWriter>(
+          file_writer_factory(filename),
+          ChunkedFileWriterOptionsFromDictionary(dictionary)),
       std::vector<std::string>(), next);
 }
 
@@ -120,6 +129,7 @@ PointsProcessor::FlushResult PlyWritingPointsProcessor::Flush() {
 }
 
 void PlyWritingPointsProcessor::Process(std::unique_ptr<PointsBatch> batch) {
+  CompactPoints(batch.get());
   if (batch->points.empty()) {
     next_->Process(std::move(batch));
     return;
@@ -144,16 +154,9 @@ void PlyWritingPointsProcessor::Process(std::unique_ptr<PointsBatch> batch) {
         << batch->frame_id;
   }
 
-  for (size_t i = 0; i < batch->points.size(); ++i) {
-    WriteBinaryPlyPointCoordinate(batch->points[i].position, file_.get());
-    if (has_colors_) {
-      WriteBinaryPlyPointColor(ToUint8Color(batch->colors[i]), file_.get());
-    }
-    if (has_intensities_) {
-      WriteBinaryIntensity(batch->intensities[i], file_.get());
-    }
-    ++num_points_;
-  }
+  EncodeBinaryPlyPoints(*batch, has_colors_, has_intensities_, &buffer_);
+  CHECK(file_->Write(buffer_.data(), buffer_.size()));
+  num_points_ += batch->points.size();
   next_->Process(std::move(batch));
 }
 
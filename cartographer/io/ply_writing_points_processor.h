@@ -49,6 +49,8 @@ class PlyWritingPointsProcessor : public PointsProcessor {
   int64 num_points_;
   bool has_colors_;
   bool has_intensities_;
+  // Reused for encoding each batch.
+  std::string buffer_;
   std::unique_ptr<FileWriter> file_;
 };
 
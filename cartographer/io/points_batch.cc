@@ -16,37 +16,66 @@
 
 #include "cartographer/io/points_batch.h"
 
+#include <algorithm>
+
+#include "glog/logging.h"
+
 namespace cartographer {
 namespace io {
 
-void RemovePoints(absl::flat_hash_set<int> to_remove, PointsBatch* batch) {
-  const int new_num_points = batch->points.size() - to_remove.size();
-  std::vector<sensor::RangefinderPoint> points;
-  points.reserve(new_num_points);
-  std::vector<float> intensities;
-  if (!batch->intensities.empty()) {
-    intensities.reserve(new_num_points);
+void MarkPointRemoved(const int index, PointsBatch* const batch) {
+  if (batch->removed_points.empty()) {
+    batch->removed_points.resize(batch->points.size(), false);
   }
-  std::vector<FloatColor> colors;
-  if (!batch->colors.empty()) {
-    colors.reserve(new_num_points);
+  batch->removed_points[index] = true;
+}
+
+size_t NumRemainingPoints(const PointsBatch& batch) {
+  if (batch.removed_points.empty()) {
+    return batch.points.size();
   }
+  return std::count(batch.removed_points.begin(), batch.removed_points.end(),
+                    false);
+}
 
+void CompactPoints(PointsBatch* const batch) {
+  if (batch->removed_points.empty()) {
+    return;
+  }
+  CHECK_EQ(batch->removed_points.size(), batch->points.size());
+  const bool has_intensities = !batch->intensities.empty();
+  const bool has_colors = !batch->colors.empty();
+  size_t new_num_points = 0;
   for (size_t i = 0; i < batch->points.size(); ++i) {
-    if (to_remove.count(i) == 1) {
+    if (batch->removed_points[i]) {
       continue;
     }
-    points.push_back(batch->points[i]);
-    if (!batch->colors.empty()) {
-      colors.push_back(batch->colors[i]);
-    }
-    if (!batch->intensities.empty()) {
-      intensities.push_back(batch->intensities[i]);
+    if (new_num_points != i) {
+      batch->points[new_num_points] = batch->points[i];
+      if (has_intensities) {
+        batch->intensities[new_num_points] = batch->intensities[i];
+      }
+      if (has_colors) {
+        batch->colors[new_num_points] = batch->colors[i];
+      }
     }
+    ++new_num_points;
+  }
+  batch->points.resize(new_num_points);
+  if (has_intensities) {
+    batch->intensities.resize(new_num_points);
+  }
+  if (has_colors) {
+    batch->colors.resize(new_num_points);
+  }
+  batch->removed_points.clear();
+}
+
+void RemovePoints(absl::flat_hash_set<int> to_remove, PointsBatch* batch) {
+  for (const int index : to_remove) {
+    MarkPointRemoved(index, batch);
   }
-  batch->points = std::move(points);
-  batch->intensities = std::move(intensities);
-  batch->colors = std::move(colors);
+  CompactPoints(batch);
 }
 
 }  // namespace io
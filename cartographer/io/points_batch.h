@@ -64,8 +64,29 @@ struct PointsBatch {
 
   // Colors are optional. If set, they are RGB values.
   std::vector<FloatColor> colors;
+
+  // Empty, or one flag per point which is set if a filter removed the point.
+  // Filters only mark points, and processors which consume the points either
+  // skip marked points or call 'CompactPoints' first, so that the data is
+  // moved at most once per batch.
+  std::vector<bool> removed_points;
 };
 
+// Marks the point at 'index' as removed without moving any data.
+void MarkPointRemoved(int index, PointsBatch* batch);
+
+// Returns true if the point at 'index' has been marked as removed.
+inline bool IsPointRemoved(const PointsBatch& batch, const int index) {
+  return !batch.removed_points.empty() && batch.removed_points[index];
+}
+
+// Returns the number of points which have not been marked as removed.
+size_t NumRemainingPoints(const PointsBatch& batch);
+
+// Drops the points marked as removed from 'batch', keeping the order of the
+// remaining points. Works in place without allocating.
+void CompactPoints(PointsBatch* batch);
+
 // Removes the indices in 'to_remove' from 'batch'.
 void RemovePoints(absl::flat_hash_set<int> to_remove, PointsBatch* batch);
 
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/io/points_batch_pool.h"
+
+#include "absl/memory/memory.h"
+
+namespace cartographer {
+namespace io {
+
+PointsBatchPool::PointsBatchPool(const size_t max_num_pooled_batches)
+    : max_num_pooled_batches_(max_num_pooled_batches) {}
+
+std::unique_ptr<PointsBatch> PointsBatchPool::Acquire() {
+  {
+    absl::MutexLock locker(&mutex_);
+    if (!batches_.empty()) {
+      std::unique_ptr<PointsBatch> batch = std::move(batches_.back());
+      batches_.pop_back();
+      return batch;
+    }
+  }
+  return absl::make_unique<PointsBatch>();
+}
+
+void PointsBatchPool::Release(std::unique_ptr<PointsBatch> batch) {
+  // Resets everything but the capacity of the vectors.
+  batch->start_time = common::Time();
+  batch->origin = Eigen::Vector3f::Zero();
+  batch->frame_id.clear();
+  batch->trajectory_id = 0;
+  batch->points.clear();
+  batch->intensities.clear();
+  batch->colors.clear();
+  batch->removed_points.clear();
+  absl::MutexLock locker(&mutex_);
+  if (batches_.size() < max_num_pooled_batches_) {
+    batches_.push_back(std::move(batch));
+  }
+}
+
+}  // namespace io
+}  // namespace cartographer
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_IO_POINTS_BATCH_POOL_H_
+#define CARTOGRAPHER_IO_POINTS_BATCH_POOL_H_
+
+#include <memory>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "cartographer/io/points_batch.h"
+
+namespace cartographer {
+namespace io {
+
+// Recycles PointsBatches, so that their vectors keep their capacity instead of
+// being allocated again for every batch. Thread-safe.
+class PointsBatchPool {
+ public:
+  // At most 'max_num_pooled_batches' released batches are kept.
+  explicit PointsBatchPool(size_t max_num_pooled_batches);
+
+  PointsBatchPool(const PointsBatchPool&) = delete;
+  PointsBatchPool& operator=(const PointsBatchPool&) = delete;
+
+  // Returns an empty batch, reusing a released one if possible.
+  std::unique_ptr<PointsBatch> Acquire() LOCKS_EXCLUDED(mutex_);
+
+  // Hands 'batch' back for reuse.
+  void Release(std::unique_ptr<PointsBatch> batch) LOCKS_EXCLUDED(mutex_);
+
+ private:
+  const size_t max_num_pooled_batches_;
+  absl::Mutex mutex_;
+  std::vector<std::unique_ptr<PointsBatch>> batches_ GUARDED_BY(mutex_);
+};
+
+}  // namespace io
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_IO_POINTS_BATCH_POOL_H_
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/io/points_batch.h"
+
+#include "absl/memory/memory.h"
+#include "cartographer/io/points_batch_pool.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace io {
+namespace {
+
+PointsBatch CreateBatch(const int num_points) {
+  PointsBatch batch;
+  for (int i = 0; i != num_points; ++i) {
+    batch.points.push_back({Eigen::Vector3f(i, 0.f, 0.f)});
+    batch.intensities.push_back(i);
+  }
+  return batch;
+}
+
+TEST(PointsBatchTest, CompactPointsKeepsOrder) {
+  PointsBatch batch = CreateBatch(5);
+  EXPECT_EQ(NumRemainingPoints(batch), 5);
+  MarkPointRemoved(1, &batch);
+  MarkPointRemoved(3, &batch);
+  MarkPointRemoved(3, &batch);
+  EXPECT_TRUE(IsPointRemoved(batch, 1));
+  EXPECT_FALSE(IsPointRemoved(batch, 2));
+  EXPECT_EQ(batch.points.size(), 5);
+  EXPECT_EQ(NumRemainingPoints(batch), 3);
+
+  CompactPoints(&batch);
+  EXPECT_TRUE(batch.removed_points.empty());
+  ASSERT_EQ(batch.points.size(), 3);
+  ASSERT_EQ(batch.intensities.size(), 3);
+  EXPECT_TRUE(batch.colors.empty());
+  EXPECT_EQ(batch.points[0].position.x(), 0.f);
+  EXPECT_EQ(batch.points[1].position.x(), 2.f);
+  EXPECT_EQ(batch.points[2].position.x(), 4.f);
+  EXPECT_EQ(batch.intensities[2], 4.f);
+}
+
+TEST(PointsBatchTest, RemovePoints) {
+  PointsBatch batch = CreateBatch(4);
+  RemovePoints({0, 2}, &batch);
+  ASSERT_EQ(batch.points.size(), 2);
+  EXPECT_EQ(batch.points[0].position.x(), 1.f);
+  EXPECT_EQ(batch.intensities[1], 3.f);
+}
+
+TEST(PointsBatchTest, PoolReusesBatches) {
+  PointsBatchPool pool(1 /* max_num_pooled_batches */);
+  std::unique_ptr<PointsBatch> batch = pool.Acquire();
+  *batch = CreateBatch(100);
+  batch->frame_id = "laser";
+  MarkPointRemoved(0, batch.get());
+  PointsBatch* const released = batch.get();
+  pool.Release(std::move(batch));
+  pool.Release(absl::make_unique<PointsBatch>());
+
+  batch = pool.Acquire();
+  EXPECT_EQ(batch.get(), released);
+  EXPECT_TRUE(batch->points.empty());
+  EXPECT_GE(batch->points.capacity(), 100);
+  EXPECT_TRUE(batch->intensities.empty());
+  EXPECT_TRUE(batch->removed_points.empty());
+  EXPECT_TRUE(batch->frame_id.empty());
+  EXPECT_NE(pool.Acquire(), nullptr);
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace cartographer
@@ -0,0 +1,235 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/io/points_cache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "absl/memory/memory.h"
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace io {
+namespace {
+
+// First eight bytes of a points cache. Its last eight bytes are 'kIndexMagic',
+// preceded by the offset of the index and the number of chunks.
+const uint64 kMagic = 0x3a1d1f7b5bf50201;
+const uint64 kIndexMagic = 0x5bf502013a1d1f7b;
+constexpr int kFooterSize = 24;
+
+const common::Duration kMaxChunkDuration = common::FromSeconds(10.);
+constexpr uint64 kMaxChunkBytes = 16 << 20;
+
+// Flags of a batch record telling which optional fields follow the points.
+constexpr uint32 kHasIntensities = 1;
+constexpr uint32 kHasColors = 2;
+
+static_assert(sizeof(sensor::RangefinderPoint) == 3 * sizeof(float),
+              "Points are copied as arrays of floats.");
+static_assert(sizeof(FloatColor) == 3 * sizeof(float),
+              "Colors are copied as arrays of floats.");
+
+template <typename T>
+void Append(const T& value, std::string* const out) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T Read(const char** const cursor) {
+  T value;
+  memcpy(&value, *cursor, sizeof(T));
+  *cursor += sizeof(T);
+  return value;
+}
+
+// Copies 'count' values from '*cursor' to 'values' and advances the cursor.
+template <typename T>
+void ReadArray(const size_t count, const char** const cursor,
+               std::vector<T>* const values) {
+  values->resize(count);
+  memcpy(values->data(), *cursor, count * sizeof(T));
+  *cursor += count * sizeof(T);
+}
+
+// A batch record starts with its start time, origin, trajectory ID, the size
+// of the frame ID, the number of points and the flags, followed by the frame
+// ID, the points and the optional intensities and colors.
+void EncodeBatch(const PointsBatch& batch, std::string* const out) {
+  const uint32 num_points = NumRemainingPoints(batch);
+  const uint32 flags = (batch.intensities.empty() ? 0 : kHasIntensities) |
+                       (batch.colors.empty() ? 0 : kHasColors);
+  Append(common::ToUniversal(batch.start_time), out);
+  Append(batch.origin.x(), out);
+  Append(batch.origin.y(), out);
+  Append(batch.origin.z(), out);
+  Append(static_cast<int32>(batch.trajectory_id), out);
+  Append(static_cast<uint32>(batch.frame_id.size()), out);
+  Append(num_points, out);
+  Append(flags, out);
+  out->append(batch.frame_id);
+  for (size_t i = 0; i < batch.points.size(); ++i) {
+    if (IsPointRemoved(batch, i)) continue;
+    Append(batch.points[i], out);
+  }
+  if (flags & kHasIntensities) {
+    for (size_t i = 0; i < batch.points.size(); ++i) {
+      if (IsPointRemoved(batch, i)) continue;
+      Append(batch.intensities[i], out);
+    }
+  }
+  if (flags & kHasColors) {
+    for (size_t i = 0; i < batch.points.size(); ++i) {
+      if (IsPointRemoved(batch, i)) continue;
+      Append(batch.colors[i], out);
+    }
+  }
+}
+
+void DecodeBatch(const char** const cursor, PointsBatch* const batch) {
+  batch->start_time = common::FromUniversal(Read<int64>(cursor));
+  batch->origin.x() = Read<float>(cursor);
+  batch->origin.y() = Read<float>(cursor);
+  batch->origin.z() = Read<float>(cursor);
+  batch->trajectory_id = Read<int32>(cursor);
+  const uint32 frame_id_size = Read<uint32>(cursor);
+  const uint32 num_points = Read<uint32>(cursor);
+  const uint32 flags = Read<uint32>(cursor);
+  batch->frame_id.assign(*cursor, frame_id_size);
+  *cursor += frame_id_size;
+  ReadArray(num_points, cursor, &batch->points);
+  if (flags & kHasIntensities) {
+    ReadArray(num_points, cursor, &batch->intensities);
+  }
+  if (flags & kHasColors) {
+    ReadArray(num_points, cursor, &batch->colors);
+  }
+}
+
+}  // namespace
+
+PointsCacheWriter::PointsCacheWriter(std::unique_ptr<FileWriter> file_writer)
+    : file_writer_(std::move(file_writer)) {
+  buffer_.clear();
+  Append(kMagic, &buffer_);
+  WriteData(buffer_);
+}
+
+void PointsCacheWriter::Write(const PointsBatch& batch) {
+  if (chunks_.empty() || batch.start_time < chunks_.back().start_time ||
+      batch.start_time - chunks_.back().start_time > kMaxChunkDuration ||
+      chunks_.back().size >= kMaxChunkBytes) {
+    chunks_.push_back(
+        Chunk{batch.start_time, batch.start_time, offset_, 0 /* size */,
+              0 /* num_batches */});
+  }
+  buffer_.clear();
+  EncodeBatch(batch, &buffer_);
+  WriteData(buffer_);
+  Chunk& chunk = chunks_.back();
+  chunk.end_time = std::max(chunk.end_time, batch.start_time);
+  chunk.size += buffer_.size();
+  ++chunk.num_batches;
+}
+
+bool PointsCacheWriter::Close() {
+  const uint64 index_offset = offset_;
+  buffer_.clear();
+  for (const Chunk& chunk : chunks_) {
+    Append(common::ToUniversal(chunk.start_time), &buffer_);
+    Append(common::ToUniversal(chunk.end_time), &buffer_);
+    Append(chunk.offset, &buffer_);
+    Append(chunk.size, &buffer_);
+    Append(chunk.num_batches, &buffer_);
+  }
+  Append(index_offset, &buffer_);
+  Append(static_cast<uint64>(chunks_.size()), &buffer_);
+  Append(kIndexMagic, &buffer_);
+  WriteData(buffer_);
+  return file_writer_->Close() && ok_;
+}
+
+void PointsCacheWriter::WriteData(const std::string& data) {
+  ok_ = file_writer_->Write(data.data(), data.size()) && ok_;
+  offset_ += data.size();
+}
+
+PointsCacheReader::PointsCacheReader(const std::string& filename) {
+  const int fd = open(filename.c_str(), O_RDONLY);
+  PCHECK(fd != -1) << "Failed to open points cache '" << filename << "'.";
+  struct stat file_stat;
+  PCHECK(fstat(fd, &file_stat) == 0);
+  const size_t size = file_stat.st_size;
+  CHECK_GE(size, sizeof(kMagic) + kFooterSize)
+      << "Points cache '" << filename << "' is truncated.";
+  void* const data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  PCHECK(data != MAP_FAILED) << "Failed to map '" << filename << "'.";
+  data_ = static_cast<const char*>(data);
+  size_ = size;
+
+  const char* cursor = data_;
+  CHECK_EQ(Read<uint64>(&cursor), kMagic)
+      << "'" << filename << "' is not a points cache.";
+  cursor = data_ + size_ - kFooterSize;
+  const uint64 index_offset = Read<uint64>(&cursor);
+  const uint64 num_chunks = Read<uint64>(&cursor);
+  CHECK_EQ(Read<uint64>(&cursor), kIndexMagic)
+      << "Points cache '" << filename << "' is missing its index.";
+  constexpr uint64 kChunkEntrySize = 5 * sizeof(uint64);
+  CHECK_EQ(index_offset + num_chunks * kChunkEntrySize, size_ - kFooterSize)
+      << "Points cache '" << filename << "' has a corrupt index.";
+  cursor = data_ + index_offset;
+  for (uint64 i = 0; i != num_chunks; ++i) {
+    Chunk chunk;
+    chunk.start_time = common::FromUniversal(Read<int64>(&cursor));
+    chunk.end_time = common::FromUniversal(Read<int64>(&cursor));
+    const uint64 offset = Read<uint64>(&cursor);
+    const uint64 chunk_size = Read<uint64>(&cursor);
+    chunk.num_batches = Read<uint64>(&cursor);
+    CHECK_LE(offset + chunk_size, index_offset);
+    chunks_.push_back(chunk);
+    chunk_offsets_and_sizes_.emplace_back(offset, chunk_size);
+  }
+}
+
+PointsCacheReader::~PointsCacheReader() {
+  munmap(const_cast<char*>(data_), size_);
+}
+
+std::vector<std::unique_ptr<PointsBatch>> PointsCacheReader::ReadChunk(
+    const int chunk_index, PointsBatchPool* const points_batch_pool) const {
+  const auto& offset_and_size = chunk_offsets_and_sizes_.at(chunk_index);
+  const char* cursor = data_ + offset_and_size.first;
+  std::vector<std::unique_ptr<PointsBatch>> batches;
+  for (int i = 0; i != chunks_[chunk_index].num_batches; ++i) {
+    batches.push_back(points_batch_pool != nullptr
+                          ? points_batch_pool->Acquire()
+                          : absl::make_unique<PointsBatch>());
+    DecodeBatch(&cursor, batches.back().get());
+  }
+  CHECK_EQ(cursor, data_ + offset_and_size.first + offset_and_size.second);
+  return batches;
+}
+
+}  // namespace io
+}  // namespace cartographer
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_IO_POINTS_CACHE_H_
+#define CARTOGRAPHER_IO_POINTS_CACHE_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cartographer/common/port.h"
+#include "cartographer/common/time.h"
+#include "cartographer/io/file_writer.h"
+#include "cartographer/io/points_batch.h"
+#include "cartographer/io/points_batch_pool.h"
+
+namespace cartographer {
+namespace io {
+
+// Writes points batches to a cache file, so that later runs can read the
+// points from there instead of assembling them again from the sensor data.
+//
+// Batches are stored uncompressed in chunks which each cover at most
+// 'kMaxChunkDuration' and roughly 'kMaxChunkBytes', followed by an index of
+// the chunks. Values are stored in the byte order of the machine, the cache is
+// not meant to be moved to other architectures.
+class PointsCacheWriter {
+ public:
+  explicit PointsCacheWriter(std::unique_ptr<FileWriter> file_writer);
+
+  PointsCacheWriter(const PointsCacheWriter&) = delete;
+  PointsCacheWriter& operator=(const PointsCacheWriter&) = delete;
+
+  // Points marked as removed are not written.
+  void Write(const PointsBatch& batch);
+  bool Close();
+
+ private:
+  struct Chunk {
+    common::Time start_time;
+    common::Time end_time;
+    uint64 offset;
+    uint64 size;
+    uint64 num_batches;
+  };
+
+  void WriteData(const std::string& data);
+
+  std::unique_ptr<FileWriter> file_writer_;
+  bool ok_ = true;
+  uint64 offset_ = 0;
+  std::vector<Chunk> chunks_;
+  std::string buffer_;
+};
+
+// Reads a cache written by PointsCacheWriter. The file is memory mapped and
+// chunks are decoded on request.
+class PointsCacheReader {
+ public:
+  struct Chunk {
+    // Range of the 'start_time' of the batches in this chunk.
+    common::Time start_time;
+    common::Time end_time;
+    int num_batches;
+  };
+
+  explicit PointsCacheReader(const std::string& filename);
+  ~PointsCacheReader();
+
+  PointsCacheReader(const PointsCacheReader&) = delete;
+  PointsCacheReader& operator=(const PointsCacheReader&) = delete;
+
+  const std::vector<Chunk>& chunks() const { return chunks_; }
+
+  // Decodes the batches of the chunk at 'chunk_index' in the order they were
+  // written. If 'points_batch_pool' is not nullptr, batches are acquired from
+  // it.
+  std::vector<std::unique_ptr<PointsBatch>> ReadChunk(
+      int chunk_index, PointsBatchPool* points_batch_pool) const;
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+  std::vector<Chunk> chunks_;
+  std::vector<std::pair<uint64, uint64>> chunk_offsets_and_sizes_;
+};
+
+}  // namespace io
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_IO_POINTS_CACHE_H_
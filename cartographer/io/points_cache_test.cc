@@ -0,0 +1,89 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/io/points_cache.h"
+
+#include <stdio.h>
+
+#include "absl/memory/memory.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace io {
+namespace {
+
+class PointsCacheTest : public ::testing::Test {
+ protected:
+  ~PointsCacheTest() override { remove(filename_.c_str()); }
+
+  const std::string filename_ = "./test_points.cache";
+};
+
+std::unique_ptr<PointsBatch> CreateBatch(const double seconds,
+                                         const int num_points) {
+  auto batch = absl::make_unique<PointsBatch>();
+  batch->start_time = common::FromUniversal(0) + common::FromSeconds(seconds);
+  batch->origin = Eigen::Vector3f(1.f, 2.f, 3.f);
+  batch->frame_id = "laser";
+  batch->trajectory_id = 1;
+  for (int i = 0; i < num_points; ++i) {
+    batch->points.push_back({Eigen::Vector3f(i, -i, 0.5f * i)});
+    batch->intensities.push_back(10.f * i);
+  }
+  return batch;
+}
+
+TEST_F(PointsCacheTest, RoundTrip) {
+  {
+    PointsCacheWriter writer(absl::make_unique<StreamFileWriter>(filename_));
+    auto batch = CreateBatch(0., 4);
+    MarkPointRemoved(1, batch.get());
+    writer.Write(*batch);
+    writer.Write(*CreateBatch(1., 3));
+    // More than the maximum duration of a chunk later.
+    writer.Write(*CreateBatch(100., 2));
+    ASSERT_TRUE(writer.Close());
+  }
+
+  PointsCacheReader reader(filename_);
+  ASSERT_EQ(2, reader.chunks().size());
+  EXPECT_EQ(2, reader.chunks()[0].num_batches);
+  EXPECT_EQ(common::FromUniversal(0) + common::FromSeconds(1.),
+            reader.chunks()[0].end_time);
+  EXPECT_EQ(1, reader.chunks()[1].num_batches);
+
+  const auto first_chunk = reader.ReadChunk(0, nullptr /* pool */);
+  ASSERT_EQ(2, first_chunk.size());
+  const PointsBatch& batch = *first_chunk[0];
+  EXPECT_EQ(common::FromUniversal(0), batch.start_time);
+  EXPECT_EQ("laser", batch.frame_id);
+  EXPECT_EQ(1, batch.trajectory_id);
+  EXPECT_EQ(Eigen::Vector3f(1.f, 2.f, 3.f), batch.origin);
+  ASSERT_EQ(3, batch.points.size());
+  EXPECT_EQ(Eigen::Vector3f(2.f, -2.f, 1.f), batch.points[1].position);
+  ASSERT_EQ(3, batch.intensities.size());
+  EXPECT_EQ(30.f, batch.intensities[2]);
+  EXPECT_TRUE(batch.colors.empty());
+
+  PointsBatchPool pool(1);
+  const auto second_chunk = reader.ReadChunk(1, &pool);
+  ASSERT_EQ(1, second_chunk.size());
+  EXPECT_EQ(2, second_chunk[0]->points.size());
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace cartographer
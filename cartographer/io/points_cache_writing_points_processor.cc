@@ -0,0 +1,56 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/io/points_cache_writing_points_processor.h"
+
+#include "absl/memory/memory.h"
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace io {
+
+PointsCacheWritingPointsProcessor::PointsCacheWritingPointsProcessor(
+    std::unique_ptr<FileWriter> file_writer, PointsProcessor* const next)
+    : next_(next),
+      writer_(absl::make_unique<PointsCacheWriter>(std::move(file_writer))) {}
+
+std::unique_ptr<PointsCacheWritingPointsProcessor>
+PointsCacheWritingPointsProcessor::FromDictionary(
+    const FileWriterFactory& file_writer_factory,
+    common::LuaParameterDictionary* const dictionary,
+    PointsProcessor* const next) {
+  return absl::make_unique<PointsCacheWritingPointsProcessor>(
+      file_writer_factory(dictionary->GetString("filename")), next);
+}
+
+void PointsCacheWritingPointsProcessor::Process(
+    std::unique_ptr<PointsBatch> batch) {
+  if (writer_ != nullptr) {
+    writer_->Write(*batch);
+  }
+  next_->Process(std::move(batch));
+}
+
+PointsProcessor::FlushResult PointsCacheWritingPointsProcessor::Flush() {
+  if (writer_ != nullptr) {
+    CHECK(writer_->Close()) << "Writing the points cache failed.";
+    writer_.reset();
+  }
+  return next_->Flush();
+}
+
+}  // namespace io
+}  // namespace cartographer
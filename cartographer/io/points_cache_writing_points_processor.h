@@ -0,0 +1,64 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_IO_POINTS_CACHE_WRITING_POINTS_PROCESSOR_H_
+#define CARTOGRAPHER_IO_POINTS_CACHE_WRITING_POINTS_PROCESSOR_H_
+
+#include <memory>
+
+#include "cartographer/common/lua_parameter_dictionary.h"
+#include "cartographer/io/file_writer.h"
+#include "cartographer/io/points_cache.h"
+#include "cartographer/io/points_processor.h"
+
+namespace cartographer {
+namespace io {
+
+// Writes all points passing through into a points cache, which later runs can
+// process instead of the original sensor data. Only the first pass is
+// written if a later stage restarts the stream.
+class PointsCacheWritingPointsProcessor : public PointsProcessor {
+ public:
+  constexpr static const char* kConfigurationFileActionName =
+      "write_points_cache";
+
+  PointsCacheWritingPointsProcessor(std::unique_ptr<FileWriter> file_writer,
+                                    PointsProcessor* next);
+
+  static std::unique_ptr<PointsCacheWritingPointsProcessor> FromDictionary(
+      const FileWriterFactory& file_writer_factory,
+      common::LuaParameterDictionary* dictionary, PointsProcessor* next);
+
+  ~PointsCacheWritingPointsProcessor() override {}
+
+  PointsCacheWritingPointsProcessor(const PointsCacheWritingPointsProcessor&) =
+      delete;
+  PointsCacheWritingPointsProcessor& operator=(
+      const PointsCacheWritingPointsProcessor&) = delete;
+
+  void Process(std::unique_ptr<PointsBatch> batch) override;
+  FlushResult Flush() override;
+
+ private:
+  PointsProcessor* const next_;
+  // Reset once the cache is complete.
+  std::unique_ptr<PointsCacheWriter> writer_;
+};
+
+}  // namespace io
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_IO_POINTS_CACHE_WRITING_POINTS_PROCESSOR_H_
@@ -26,9 +26,12 @@
 #include "cartographer/io/min_max_range_filtering_points_processor.h"
 #include "cartographer/io/null_points_processor.h"
 #include "cartographer/io/outlier_removing_points_processor.h"
+#include "cartographer/io/parallel_points_processor.h"
 #include "cartographer/io/pcd_writing_points_processor.h"
+#include "cartographer/io/points_cache_writing_points_processor.h"
 #include "cartographer/io/ply_writing_points_processor.h"
 #include "cartographer/io/probability_grid_points_processor.h"
+#include "cartographer/io/queued_points_processor.h"
 #include "cartographer/io/vertical_range_filtering_points_processor.h"
 #include "cartographer/io/xray_points_processor.h"
 #include "cartographer/io/xyz_writing_points_processor.h"
@@ -36,6 +39,12 @@
 
 namespace cartographer {
 namespace io {
+namespace {
+
+// Number of batches buffered between two stages of a concurrent pipeline.
+constexpr size_t kQueueSize = 16;
+
+}  // namespace
 
 template <typename PointsProcessorType>
 void RegisterPlainPointsProcessor(
@@ -48,6 +57,17 @@ void RegisterPlainPointsProcessor(
       });
 }
 
+template <typename PointsProcessorType>
+void RegisterStatelessPointsProcessor(
+    PointsProcessorPipelineBuilder* const builder) {
+  builder->RegisterStateless(
+      PointsProcessorType::kConfigurationFileActionName,
+      [](common::LuaParameterDictionary* const dictionary,
+         PointsProcessor* const next) -> std::unique_ptr<PointsProcessor> {
+        return PointsProcessorType::FromDictionary(dictionary, next);
+      });
+}
+
 template <typename PointsProcessorType>
 void RegisterFileWritingPointsProcessor(
     const FileWriterFactory& file_writer_factory,
@@ -83,12 +103,13 @@ void RegisterBuiltInPointsProcessors(
     PointsProcessorPipelineBuilder* builder) {
   RegisterPlainPointsProcessor<CountingPointsProcessor>(builder);
   RegisterPlainPointsProcessor<FixedRatioSamplingPointsProcessor>(builder);
-  RegisterPlainPointsProcessor<FrameIdFilteringPointsProcessor>(builder);
-  RegisterPlainPointsProcessor<MinMaxRangeFilteringPointsProcessor>(builder);
+  RegisterStatelessPointsProcessor<FrameIdFilteringPointsProcessor>(builder);
+  RegisterStatelessPointsProcessor<MinMaxRangeFilteringPointsProcessor>(
+      builder);
   RegisterPlainPointsProcessor<VerticalRangeFilteringPointsProcessor>(builder);
   RegisterPlainPointsProcessor<OutlierRemovingPointsProcessor>(builder);
   RegisterPlainPointsProcessor<ColoringPointsProcessor>(builder);
-  RegisterPlainPointsProcessor<IntensityToColorPointsProcessor>(builder);
+  RegisterStatelessPointsProcessor<IntensityToColorPointsProcessor>(builder);
   RegisterFileWritingPointsProcessor<PcdWritingPointsProcessor>(
       file_writer_factory, builder);
   RegisterFileWritingPointsProcessor<PlyWritingPointsProcessor>(
@@ -97,6 +118,8 @@ void RegisterBuiltInPointsProcessors(
       file_writer_factory, builder);
   RegisterFileWritingPointsProcessor<HybridGridPointsProcessor>(
       file_writer_factory, builder);
+  RegisterFileWritingPointsProcessor<PointsCacheWritingPointsProcessor>(
+      file_writer_factory, builder);
   RegisterFileWritingPointsProcessorWithTrajectories<XRayPointsProcessor>(
       trajectories, file_writer_factory, builder);
   RegisterFileWritingPointsProcessorWithTrajectories<
@@ -111,6 +134,12 @@ void PointsProcessorPipelineBuilder::Register(const std::string& name,
   factories_[name] = std::move(factory);
 }
 
+void PointsProcessorPipelineBuilder::RegisterStateless(
+    const std::string& name, FactoryFunction factory) {
+  Register(name, std::move(factory));
+  stateless_actions_.insert(name);
+}
+
 PointsProcessorPipelineBuilder::PointsProcessorPipelineBuilder() {}
 
 std::vector<std::unique_ptr<PointsProcessor>>
@@ -120,22 +149,94 @@ PointsProcessorPipelineBuilder::CreatePipeline(
   // The last consumer in the pipeline must exist, so that the one created after
   // it (and being before it in the pipeline) has a valid 'next' to point to.
   // The last consumer will just drop all points.
-  pipeline.emplace_back(absl::make_unique<NullPointsProcessor>());
+  pipeline.emplace_back(
+      absl::make_unique<NullPointsProcessor>(points_batch_pool_));
 
   std::vector<std::unique_ptr<common::LuaParameterDictionary>> configurations =
       dictionary->GetArrayValuesAsDictionaries();
 
   // We construct the pipeline starting at the back.
   for (auto it = configurations.rbegin(); it != configurations.rend(); it++) {
-    const std::string action = (*it)->GetString("action");
-    auto factory_it = factories_.find(action);
-    CHECK(factory_it != factories_.end())
-        << "Unknown action '" << action
-        << "'. Did you register the correspoinding PointsProcessor?";
-    pipeline.push_back(factory_it->second(it->get(), pipeline.back().get()));
+    pipeline.push_back(CreatePointsProcessor((*it)->GetString("action"),
+                                             it->get(), pipeline.back().get()));
   }
   return pipeline;
 }
 
+std::vector<std::unique_ptr<PointsProcessor>>
+PointsProcessorPipelineBuilder::CreateConcurrentPipeline(
+    common::LuaParameterDictionary* const dictionary,
+    const int num_parallel_workers) const {
+  CHECK_GT(num_parallel_workers, 0);
+  std::vector<std::unique_ptr<PointsProcessor>> pipeline;
+  pipeline.emplace_back(
+      absl::make_unique<NullPointsProcessor>(points_batch_pool_));
+
+  std::vector<std::unique_ptr<common::LuaParameterDictionary>> configurations =
+      dictionary->GetArrayValuesAsDictionaries();
+  std::vector<std::string> actions;
+  for (const auto& configuration : configurations) {
+    actions.push_back(configuration->GetString("action"));
+  }
+  const auto is_stateless = [this, &actions](const int index) {
+    return stateless_actions_.count(actions[index]) != 0;
+  };
+
+  // We construct the pipeline starting at the back. Each stateful
+  // PointsProcessor gets a queue in front of it, unless a run of stateless
+  // PointsProcessors, which comes with its own threads, precedes it.
+  for (int i = static_cast<int>(configurations.size()) - 1; i >= 0;) {
+    if (!is_stateless(i)) {
+      pipeline.push_back(CreatePointsProcessor(
+          actions[i], configurations[i].get(), pipeline.back().get()));
+      --i;
+      if (i < 0 || !is_stateless(i)) {
+        pipeline.push_back(absl::make_unique<QueuedPointsProcessor>(
+            kQueueSize, pipeline.back().get()));
+      }
+      continue;
+    }
+    std::vector<int> stateless_indices;
+    for (; i >= 0 && is_stateless(i); --i) {
+      stateless_indices.push_back(i);
+    }
+    int num_created = 0;
+    pipeline.push_back(absl::make_unique<ParallelPointsProcessor>(
+        num_parallel_workers, kQueueSize,
+        [this, &configurations, &actions, &stateless_indices, &num_created,
+         num_parallel_workers](PointsProcessor* const next) {
+          std::vector<std::unique_ptr<PointsProcessor>> stages;
+          // Each key of a configuration must be used exactly once, so all but
+          // the last worker read from copies without reference counting.
+          const bool use_copies = ++num_created < num_parallel_workers;
+          for (const int index : stateless_indices) {
+            std::unique_ptr<common::LuaParameterDictionary> copy;
+            if (use_copies) {
+              copy = common::LuaParameterDictionary::NonReferenceCounted(
+                  "return " + configurations[index]->ToString(), nullptr);
+            }
+            stages.push_back(CreatePointsProcessor(
+                actions[index],
+                use_copies ? copy.get() : configurations[index].get(),
+                stages.empty() ? next : stages.back().get()));
+          }
+          return stages;
+        },
+        pipeline.back().get()));
+  }
+  return pipeline;
+}
+
+std::unique_ptr<PointsProcessor>
+PointsProcessorPipelineBuilder::CreatePointsProcessor(
+    const std::string& action, common::LuaParameterDictionary* const dictionary,
+    PointsProcessor* const next) const {
+  auto factory_it = factories_.find(action);
+  CHECK(factory_it != factories_.end())
+      << "Unknown action '" << action
+      << "'. Did you register the correspoinding PointsProcessor?";
+  return factory_it->second(dictionary, next);
+}
+
 }  // namespace io
 }  // namespace cartographer
@@ -21,8 +21,10 @@
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "cartographer/common/lua_parameter_dictionary.h"
 #include "cartographer/io/file_writer.h"
+#include "cartographer/io/points_batch_pool.h"
 #include "cartographer/io/points_processor.h"
 #include "cartographer/mapping/proto/trajectory.pb.h"
 
@@ -51,11 +53,37 @@ class PointsProcessorPipelineBuilder {
   // be created using 'factory'.
   void Register(const std::string& name, FactoryFunction factory);
 
+  // Like 'Register', for PointsProcessors which keep no state across batches
+  // and do no work in 'Flush'. These may process several batches at once in
+  // pipelines created by 'CreateConcurrentPipeline'.
+  void RegisterStateless(const std::string& name, FactoryFunction factory);
+
+  // If set, batches reaching the end of pipelines created afterwards are
+  // handed back to 'pool'. The pool must outlive these pipelines.
+  void set_points_batch_pool(PointsBatchPool* pool) {
+    points_batch_pool_ = pool;
+  }
+
   std::vector<std::unique_ptr<PointsProcessor>> CreatePipeline(
       common::LuaParameterDictionary* dictionary) const;
 
+  // Like 'CreatePipeline', but runs each stateful PointsProcessor on a thread
+  // of its own, connected by bounded queues. Consecutive stateless
+  // PointsProcessors are run on 'num_parallel_workers' batches at once. The
+  // order of batches is preserved. The pipeline must have been flushed before
+  // it is destroyed.
+  std::vector<std::unique_ptr<PointsProcessor>> CreateConcurrentPipeline(
+      common::LuaParameterDictionary* dictionary,
+      int num_parallel_workers) const;
+
  private:
+  std::unique_ptr<PointsProcessor> CreatePointsProcessor(
+      const std::string& action, common::LuaParameterDictionary* dictionary,
+      PointsProcessor* next) const;
+
   absl::flat_hash_map<std::string, FactoryFunction> factories_;
+  absl::flat_hash_set<std::string> stateless_actions_;
+  PointsBatchPool* points_batch_pool_ = nullptr;
 };
 
 // Register all 'PointsProcessor' that ship with Cartographer with this
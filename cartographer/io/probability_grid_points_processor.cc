@@ -30,6 +30,9 @@ namespace cartographer {
 namespace io {
 namespace {
 
+// Size of the tiles used to build the grid in parallel, in cells.
+constexpr int kParallelTileSize = 256;
+
 void DrawTrajectoriesIntoImage(
     const mapping::ProbabilityGrid& probability_grid,
     const Eigen::Array2i& offset,
@@ -83,7 +86,7 @@ ProbabilityGridPointsProcessor::ProbabilityGridPointsProcessor(
     const mapping::proto::ProbabilityGridRangeDataInserterOptions2D&
         probability_grid_range_data_inserter_options,
     const DrawTrajectories& draw_trajectories, const OutputType& output_type,
-    std::unique_ptr<FileWriter> file_writer,
+    const int num_threads, std::unique_ptr<FileWriter> file_writer,
     const std::vector<mapping::proto::Trajectory>& trajectories,
     PointsProcessor* const next)
     : draw_trajectories_(draw_trajectories),
@@ -94,6 +97,12 @@ ProbabilityGridPointsProcessor::ProbabilityGridPointsProcessor(
       range_data_inserter_(probability_grid_range_data_inserter_options),
       probability_grid_(
           CreateProbabilityGrid(resolution, &conversion_tables_)) {
+  CHECK_GT(num_threads, 0);
+  if (num_threads > 1) {
+    parallel_builder_ = absl::make_unique<ParallelProbabilityGridBuilder>(
+        resolution, probability_grid_range_data_inserter_options,
+        kParallelTileSize, num_threads, &conversion_tables_);
+  }
   LOG_IF(WARNING, output_type == OutputType::kPb &&
                       draw_trajectories_ == DrawTrajectories::kYes)
       << "Drawing the trajectories is not supported when writing the "
@@ -114,11 +123,14 @@ ProbabilityGridPointsProcessor::FromDictionary(
       dictionary->HasKey("output_type")
           ? OutputTypeFromString(dictionary->GetString("output_type"))
           : OutputType::kPng;
+  const int num_threads = dictionary->HasKey("num_threads")
+                              ? dictionary->GetInt("num_threads")
+                              : 1;
   return absl::make_unique<ProbabilityGridPointsProcessor>(
       dictionary->GetDouble("resolution"),
       mapping::CreateProbabilityGridRangeDataInserterOptions2D(
           dictionary->GetDictionary("range_data_inserter").get()),
-      draw_trajectories, output_type,
+      draw_trajectories, output_type, num_threads,
       file_writer_factory(dictionary->GetString("filename") +
                           FileExtensionFromOutputType(output_type)),
       trajectories, next);
@@ -126,28 +138,56 @@ ProbabilityGridPointsProcessor::FromDictionary(
 
 void ProbabilityGridPointsProcessor::Process(
     std::unique_ptr<PointsBatch> batch) {
-  range_data_inserter_.Insert(
-      {batch->origin, sensor::PointCloud(batch->points), {}},
-      &probability_grid_);
+  CompactPoints(batch.get());
+  if (parallel_builder_ != nullptr) {
+    parallel_builder_->Insert(
+        {batch->origin, sensor::PointCloud(batch->points), {}});
+  } else {
+    range_data_inserter_.Insert(
+        {batch->origin, sensor::PointCloud(batch->points), {}},
+        &probability_grid_);
+  }
   next_->Process(std::move(batch));
 }
 
 PointsProcessor::FlushResult ProbabilityGridPointsProcessor::Flush() {
+  if (parallel_builder_ != nullptr) {
+    WriteProbabilityGrid(parallel_builder_->Finish());
+  } else {
+    WriteProbabilityGrid(probability_grid_);
+  }
+
+  switch (next_->Flush()) {
+    case FlushResult::kRestartStream:
+      LOG(FATAL) << "ProbabilityGrid generation must be configured to occur "
+                    "after any stages that require multiple passes.";
+
+    case FlushResult::kFinished:
+      return FlushResult::kFinished;
+  }
+  LOG(FATAL);
+  // The following unreachable return statement is needed to avoid a GCC bug
+  // described at https://gcc.gnu.org/bugzilla/show_bug.cgi?id=81508
+  return FlushResult::kFinished;
+}
+
+void ProbabilityGridPointsProcessor::WriteProbabilityGrid(
+    const mapping::ProbabilityGrid& probability_grid) {
   if (output_type_ == OutputType::kPng) {
     Eigen::Array2i offset;
     std::unique_ptr<Image> image =
-        DrawProbabilityGrid(probability_grid_, &offset);
+        DrawProbabilityGrid(probability_grid, &offset);
     if (image != nullptr) {
       if (draw_trajectories_ ==
           ProbabilityGridPointsProcessor::DrawTrajectories::kYes) {
-        DrawTrajectoriesIntoImage(probability_grid_, offset, trajectories_,
+        DrawTrajectoriesIntoImage(probability_grid, offset, trajectories_,
                                   image->GetCairoSurface().get());
       }
       image->WritePng(file_writer_.get());
       CHECK(file_writer_->Close());
     }
   } else if (output_type_ == OutputType::kPb) {
-    const auto probability_grid_proto = probability_grid_.ToProto();
+    const auto probability_grid_proto = probability_grid.ToProto();
     std::string probability_grid_serialized;
     probability_grid_proto.SerializeToString(&probability_grid_serialized);
     file_writer_->Write(probability_grid_serialized.data(),
@@ -157,19 +197,6 @@ PointsProcessor::FlushResult ProbabilityGridPointsProcessor::Flush() {
     LOG(FATAL) << "Output Type " << FileExtensionFromOutputType(output_type_)
                << " is not supported.";
   }
-
-  switch (next_->Flush()) {
-    case FlushResult::kRestartStream:
-      LOG(FATAL) << "ProbabilityGrid generation must be configured to occur "
-                    "after any stages that require multiple passes.";
-
-    case FlushResult::kFinished:
-      return FlushResult::kFinished;
-  }
-  LOG(FATAL);
-  // The following unreachable return statement is needed to avoid a GCC bug
-  // described at https://gcc.gnu.org/bugzilla/show_bug.cgi?id=81508
-  return FlushResult::kFinished;
 }
 
 std::unique_ptr<Image> DrawProbabilityGrid(
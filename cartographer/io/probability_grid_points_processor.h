@@ -21,6 +21,7 @@
 
 #include "cartographer/io/file_writer.h"
 #include "cartographer/io/image.h"
+#include "cartographer/io/parallel_probability_grid_builder.h"
 #include "cartographer/io/points_batch.h"
 #include "cartographer/io/points_processor.h"
 #include "cartographer/mapping/2d/probability_grid.h"
@@ -35,7 +36,8 @@ namespace io {
 // Creates a probability grid with the specified 'resolution'. As all points are
 // projected into the x-y plane the z component of the data is ignored.
 // 'range_data_inserter' options are used to configure the range data ray
-// tracing through the probability grid.
+// tracing through the probability grid. If 'num_threads' is larger than 1,
+// the grid is built by a ParallelProbabilityGridBuilder on that many threads.
 class ProbabilityGridPointsProcessor : public PointsProcessor {
  public:
   constexpr static const char* kConfigurationFileActionName =
@@ -47,7 +49,7 @@ class ProbabilityGridPointsProcessor : public PointsProcessor {
       const mapping::proto::ProbabilityGridRangeDataInserterOptions2D&
           probability_grid_range_data_inserter_options,
       const DrawTrajectories& draw_trajectories, const OutputType& output_type,
-      std::unique_ptr<FileWriter> file_writer,
+      int num_threads, std::unique_ptr<FileWriter> file_writer,
       const std::vector<mapping::proto::Trajectory>& trajectories,
       PointsProcessor* next);
   ProbabilityGridPointsProcessor(const ProbabilityGridPointsProcessor&) =
@@ -66,6 +68,8 @@ class ProbabilityGridPointsProcessor : public PointsProcessor {
   FlushResult Flush() override;
 
  private:
+  void WriteProbabilityGrid(const mapping::ProbabilityGrid& probability_grid);
+
   const DrawTrajectories draw_trajectories_;
   const OutputType output_type_;
   const std::vector<mapping::proto::Trajectory> trajectories_;
@@ -74,6 +78,9 @@ class ProbabilityGridPointsProcessor : public PointsProcessor {
   mapping::ProbabilityGridRangeDataInserter2D range_data_inserter_;
   mapping::ValueConversionTables conversion_tables_;
   mapping::ProbabilityGrid probability_grid_;
+  // Only set if the grid is built in parallel, 'probability_grid_' stays
+  // empty then.
+  std::unique_ptr<ParallelProbabilityGridBuilder> parallel_builder_;
 };
 
 // Draws 'probability_grid' into an image and fills in 'offset' with the cropped
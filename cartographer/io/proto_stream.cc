@@ -16,6 +16,17 @@
 
 #include "cartographer/io/proto_stream.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "cartographer/mapping/proto/serialization.pb.h"
 #include "glog/logging.h"
 
 namespace cartographer {
@@ -25,6 +36,16 @@ namespace {
 
 // First eight bytes to identify our proto stream format.
 const uint64 kMagic = 0x7b1d1f7b5bf501db;
+// First eight bytes of the indexed format. Its last eight bytes are
+// 'kIndexMagic', preceded by the offset of the index record.
+const uint64 kIndexedMagic = 0x7b1d1f7b5bf501dc;
+const uint64 kIndexMagic = 0x5bf501dc7b1d1f7b;
+constexpr int kFooterSize = 16;
+
+// Number of messages decompressed ahead per thread by sequential reads.
+constexpr int kMessagesAheadPerThread = 8;
+// Number of messages compressed per thread and batch by indexed writes.
+constexpr int kMessagesPerWriteBatchPerThread = 8;
 
 void WriteSizeAsLittleEndian(uint64 size, std::ostream* out) {
   for (int i = 0; i != 8; ++i) {
@@ -42,18 +63,90 @@ bool ReadSizeAsLittleEndian(std::istream* in, uint64* size) {
   return !in->fail();
 }
 
+uint64 ReadLittleEndian(const char* data) {
+  uint64 value = 0;
+  for (int i = 7; i >= 0; --i) {
+    value = (value << 8) | static_cast<unsigned char>(data[i]);
+  }
+  return value;
+}
+
+void SetIndexKey(const mapping::proto::SerializedData& data,
+                 proto::ProtoStreamIndex::Entry* entry) {
+  entry->set_data_case(data.data_case());
+  switch (data.data_case()) {
+    case mapping::proto::SerializedData::kSubmap:
+      entry->set_trajectory_id(data.submap().submap_id().trajectory_id());
+      entry->set_index(data.submap().submap_id().submap_index());
+      break;
+    case mapping::proto::SerializedData::kNode:
+      entry->set_trajectory_id(data.node().node_id().trajectory_id());
+      entry->set_index(data.node().node_id().node_index());
+      break;
+    case mapping::proto::SerializedData::kTrajectoryData:
+      entry->set_trajectory_id(data.trajectory_data().trajectory_id());
+      break;
+    case mapping::proto::SerializedData::kImuData:
+      entry->set_trajectory_id(data.imu_data().trajectory_id());
+      break;
+    case mapping::proto::SerializedData::kOdometryData:
+      entry->set_trajectory_id(data.odometry_data().trajectory_id());
+      break;
+    case mapping::proto::SerializedData::kFixedFramePoseData:
+      entry->set_trajectory_id(data.fixed_frame_pose_data().trajectory_id());
+      break;
+    case mapping::proto::SerializedData::kLandmarkData:
+      entry->set_trajectory_id(data.landmark_data().trajectory_id());
+      break;
+    default:
+      break;
+  }
+}
+
+std::ofstream OpenForAppending(const std::string& filename,
+                               const uint64 valid_size) {
+  if (valid_size == 0) {
+    std::ofstream out(filename, std::ios::out | std::ios::binary);
+    WriteSizeAsLittleEndian(kMagic, &out);
+    return out;
+  }
+  std::ofstream out;
+  if (truncate(filename.c_str(), valid_size) != 0) {
+    PLOG(ERROR) << "Failed to truncate '" << filename << "'.";
+    out.setstate(std::ios::failbit);
+    return out;
+  }
+  out.open(filename, std::ios::out | std::ios::binary | std::ios::app);
+  return out;
+}
+
 }  // namespace
 
 ProtoStreamWriter::ProtoStreamWriter(const std::string& filename)
+    : ProtoStreamWriter(filename, kMagic) {}
+
+ProtoStreamWriter::ProtoStreamWriter(const std::string& filename,
+                                     const uint64 magic)
     : out_(filename, std::ios::out | std::ios::binary) {
-  WriteSizeAsLittleEndian(kMagic, &out_);
+  WriteSizeAsLittleEndian(magic, &out_);
 }
 
-void ProtoStreamWriter::Write(const std::string& uncompressed_data) {
+ProtoStreamWriter::ProtoStreamWriter(std::ofstream out)
+    : out_(std::move(out)) {}
+
+std::pair<uint64, uint64> ProtoStreamWriter::Write(
+    const std::string& uncompressed_data) {
   std::string compressed_data;
   common::FastGzipString(uncompressed_data, &compressed_data);
+  return WriteCompressed(compressed_data);
+}
+
+std::pair<uint64, uint64> ProtoStreamWriter::WriteCompressed(
+    const std::string& compressed_data) {
   WriteSizeAsLittleEndian(compressed_data.size(), &out_);
+  const uint64 offset = out_.tellp();
   out_.write(compressed_data.data(), compressed_data.size());
+  return {offset, compressed_data.size()};
 }
 
 void ProtoStreamWriter::WriteProto(const google::protobuf::Message& proto) {
@@ -62,21 +155,129 @@ void ProtoStreamWriter::WriteProto(const google::protobuf::Message& proto) {
   Write(uncompressed_data);
 }
 
+void ProtoStreamWriter::WriteCompressedProto(
+    const std::string& compressed_data) {
+  WriteCompressed(compressed_data);
+}
+
 bool ProtoStreamWriter::Close() {
   out_.close();
   return !out_.fail();
 }
 
+IndexedProtoStreamWriter::IndexedProtoStreamWriter(const std::string& filename,
+                                                   const int num_threads)
+    : ProtoStreamWriter(filename, kIndexedMagic), num_threads_(num_threads) {
+  CHECK_GE(num_threads_, 1);
+}
+
+void IndexedProtoStreamWriter::WriteProto(
+    const google::protobuf::Message& proto) {
+  pending_data_.emplace_back();
+  proto.SerializeToString(&pending_data_.back());
+  pending_entries_.emplace_back();
+  const auto* const serialized_data =
+      dynamic_cast<const mapping::proto::SerializedData*>(&proto);
+  if (serialized_data != nullptr) {
+    SetIndexKey(*serialized_data, &pending_entries_.back());
+  }
+  if (static_cast<int>(pending_data_.size()) >=
+      num_threads_ * kMessagesPerWriteBatchPerThread) {
+    WritePending();
+  }
+}
+
+void IndexedProtoStreamWriter::WritePending() {
+  const int num_pending = pending_data_.size();
+  // Compresses in place, the uncompressed data is not needed anymore.
+  const auto compress = [this, num_pending](const int thread_index) {
+    for (int i = thread_index; i < num_pending; i += num_threads_) {
+      std::string compressed_data;
+      common::FastGzipString(pending_data_[i], &compressed_data);
+      pending_data_[i].swap(compressed_data);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int thread_index = 1; thread_index < num_threads_; ++thread_index) {
+    threads.emplace_back(compress, thread_index);
+  }
+  compress(0);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  for (int i = 0; i != num_pending; ++i) {
+    const std::pair<uint64, uint64> offset_and_size =
+        WriteCompressed(pending_data_[i]);
+    proto::ProtoStreamIndex::Entry* const entry = index_.add_entry();
+    *entry = pending_entries_[i];
+    entry->set_offset(offset_and_size.first);
+    entry->set_size(offset_and_size.second);
+  }
+  pending_data_.clear();
+  pending_entries_.clear();
+}
+
+bool IndexedProtoStreamWriter::Close() {
+  WritePending();
+  const uint64 index_offset = out_.tellp();
+  std::string uncompressed_index;
+  index_.SerializeToString(&uncompressed_index);
+  Write(uncompressed_index);
+  WriteSizeAsLittleEndian(index_offset, &out_);
+  WriteSizeAsLittleEndian(kIndexMagic, &out_);
+  return ProtoStreamWriter::Close();
+}
+
+AppendingProtoStreamWriter::AppendingProtoStreamWriter(
+    const std::string& filename, const uint64 valid_size)
+    : ProtoStreamWriter(OpenForAppending(filename, valid_size)),
+      filename_(filename) {}
+
+bool AppendingProtoStreamWriter::Close() {
+  if (!ProtoStreamWriter::Close()) {
+    return false;
+  }
+  struct stat file_stat;
+  if (stat(filename_.c_str(), &file_stat) != 0) {
+    return false;
+  }
+  size_ = file_stat.st_size;
+  return true;
+}
+
+bool IsIndexedProtoStream(const std::string& filename) {
+  std::ifstream in(filename, std::ios::in | std::ios::binary);
+  uint64 magic;
+  return ReadSizeAsLittleEndian(&in, &magic) && magic == kIndexedMagic;
+}
+
 ProtoStreamReader::ProtoStreamReader(const std::string& filename)
     : in_(filename, std::ios::in | std::ios::binary) {
   uint64 magic;
-  if (!ReadSizeAsLittleEndian(&in_, &magic) || magic != kMagic) {
+  if (!ReadSizeAsLittleEndian(&in_, &magic) ||
+      (magic != kMagic && magic != kIndexedMagic)) {
     in_.setstate(std::ios::failbit);
   }
+  if (in_.good() && magic == kIndexedMagic) {
+    // Messages end where the index starts.
+    uint64 index_magic;
+    in_.seekg(-kFooterSize, std::ios::end);
+    if (!ReadSizeAsLittleEndian(&in_, &end_of_messages_) ||
+        !ReadSizeAsLittleEndian(&in_, &index_magic) ||
+        index_magic != kIndexMagic) {
+      in_.setstate(std::ios::failbit);
+    }
+    in_.seekg(sizeof(kIndexedMagic));
+  }
   CHECK(in_.good()) << "Failed to open proto stream '" << filename << "'.";
 }
 
 bool ProtoStreamReader::Read(std::string* decompressed_data) {
+  if (end_of_messages_ != 0 &&
+      static_cast<uint64>(in_.tellg()) >= end_of_messages_) {
+    in_.setstate(std::ios::eofbit);
+    return false;
+  }
   uint64 compressed_size;
   if (!ReadSizeAsLittleEndian(&in_, &compressed_size)) {
     return false;
@@ -96,5 +297,96 @@ bool ProtoStreamReader::ReadProto(google::protobuf::Message* proto) {
 
 bool ProtoStreamReader::eof() const { return in_.eof(); }
 
+IndexedProtoStreamReader::IndexedProtoStreamReader(const std::string& filename,
+                                                   const int num_threads)
+    : num_threads_(std::max(num_threads, 1)) {
+  const int fd = open(filename.c_str(), O_RDONLY);
+  PCHECK(fd != -1) << "Failed to open proto stream '" << filename << "'.";
+  struct stat file_stat;
+  PCHECK(fstat(fd, &file_stat) == 0);
+  size_t size = file_stat.st_size;
+  CHECK_GE(size, sizeof(kIndexedMagic) + kFooterSize)
+      << "Proto stream '" << filename << "' is truncated.";
+  void* const data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  PCHECK(data != MAP_FAILED) << "Failed to map '" << filename << "'.";
+  data_ = static_cast<const char*>(data);
+  size_ = size;
+
+  CHECK_EQ(ReadLittleEndian(data_), kIndexedMagic)
+      << "'" << filename << "' is not an indexed proto stream.";
+  const char* const footer = data_ + size_ - kFooterSize;
+  CHECK_EQ(ReadLittleEndian(footer + 8), kIndexMagic)
+      << "Proto stream '" << filename << "' is missing its index.";
+  const uint64 index_offset = ReadLittleEndian(footer);
+  CHECK_LE(index_offset + 8, size_ - kFooterSize);
+  const uint64 index_size = ReadLittleEndian(data_ + index_offset);
+  CHECK_EQ(index_offset + 8 + index_size, size_ - kFooterSize);
+  std::string uncompressed_index;
+  common::FastGunzipString(
+      std::string(data_ + index_offset + 8, index_size), &uncompressed_index);
+  CHECK(index_.ParseFromString(uncompressed_index))
+      << "Failed to parse the index of '" << filename << "'.";
+  for (const auto& entry : index_.entry()) {
+    CHECK_LE(entry.offset() + entry.size(), index_offset);
+  }
+}
+
+IndexedProtoStreamReader::~IndexedProtoStreamReader() {
+  munmap(const_cast<char*>(data_), size_);
+}
+
+void IndexedProtoStreamReader::Decompress(
+    const int entry_index, std::string* const decompressed_data) const {
+  const proto::ProtoStreamIndex::Entry& entry = index_.entry(entry_index);
+  common::FastGunzipString(std::string(data_ + entry.offset(), entry.size()),
+                           decompressed_data);
+}
+
+void IndexedProtoStreamReader::DecompressAhead() {
+  const int begin = next_entry_index_;
+  const int end = std::min(begin + num_threads_ * kMessagesAheadPerThread,
+                           index_.entry_size());
+  decompressed_ahead_.resize(end - begin);
+  std::vector<std::thread> threads;
+  for (int thread_index = 1; thread_index < num_threads_; ++thread_index) {
+    threads.emplace_back([this, begin, end, thread_index]() {
+      for (int i = begin + thread_index; i < end; i += num_threads_) {
+        Decompress(i, &decompressed_ahead_[i - begin]);
+      }
+    });
+  }
+  for (int i = begin; i < end; i += num_threads_) {
+    Decompress(i, &decompressed_ahead_[i - begin]);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+bool IndexedProtoStreamReader::ReadProto(google::protobuf::Message* proto) {
+  if (eof()) {
+    return false;
+  }
+  if (decompressed_ahead_.empty()) {
+    DecompressAhead();
+  }
+  const bool success = proto->ParseFromString(decompressed_ahead_.front());
+  decompressed_ahead_.pop_front();
+  ++next_entry_index_;
+  return success;
+}
+
+bool IndexedProtoStreamReader::eof() const {
+  return next_entry_index_ == index_.entry_size();
+}
+
+bool IndexedProtoStreamReader::ReadProto(
+    const int entry_index, google::protobuf::Message* proto) const {
+  std::string decompressed_data;
+  Decompress(entry_index, &decompressed_data);
+  return proto->ParseFromString(decompressed_data);
+}
+
 }  // namespace io
 }  // namespace cartographer
@@ -17,9 +17,12 @@
 #ifndef CARTOGRAPHER_IO_PROTO_STREAM_H_
 #define CARTOGRAPHER_IO_PROTO_STREAM_H_
 
+#include <deque>
 #include <fstream>
+#include <vector>
 
 #include "cartographer/common/port.h"
+#include "cartographer/io/proto/proto_stream_index.pb.h"
 #include "cartographer/io/proto_stream_interface.h"
 #include "google/protobuf/message.h"
 
@@ -41,15 +44,75 @@ class ProtoStreamWriter : public ProtoStreamWriterInterface {
   ProtoStreamWriter& operator=(const ProtoStreamWriter&) = delete;
 
   void WriteProto(const google::protobuf::Message& proto) override;
+  // Writes a message which was already serialized and compressed with
+  // common::FastGzipString(), e.g. as received over the network. Not supported
+  // by IndexedProtoStreamWriter, which needs to index the message.
+  void WriteCompressedProto(const std::string& compressed_data);
   bool Close() override;
 
- private:
-  void Write(const std::string& uncompressed_data);
+ protected:
+  // Writes the 'magic' identifying the format.
+  ProtoStreamWriter(const std::string& filename, uint64 magic);
+  explicit ProtoStreamWriter(std::ofstream out);
+
+  // Returns the offset of the compressed data and its size.
+  std::pair<uint64, uint64> Write(const std::string& uncompressed_data);
+  std::pair<uint64, uint64> WriteCompressed(const std::string& compressed_data);
 
   std::ofstream out_;
 };
 
-// A reader of the format produced by ProtoStreamWriter.
+// Writes the same compressed messages as ProtoStreamWriter followed by an
+// index, so that IndexedProtoStreamReader can access messages randomly. Since
+// each message is compressed independently, they can also be decompressed in
+// parallel. ProtoStreamReader can read this format as well.
+//
+// Messages are compressed in batches in parallel on 'num_threads' threads and
+// written to the file after each batch.
+class IndexedProtoStreamWriter : public ProtoStreamWriter {
+ public:
+  explicit IndexedProtoStreamWriter(const std::string& filename,
+                                    int num_threads = 1);
+  ~IndexedProtoStreamWriter() = default;
+
+  void WriteProto(const google::protobuf::Message& proto) override;
+  bool Close() override;
+
+ private:
+  // Compresses the pending messages in parallel and writes them.
+  void WritePending();
+
+  const int num_threads_;
+  // Serialized messages and their index entries, not yet written.
+  std::vector<std::string> pending_data_;
+  std::vector<proto::ProtoStreamIndex::Entry> pending_entries_;
+  proto::ProtoStreamIndex index_;
+};
+
+// Appends messages in the format of ProtoStreamWriter to 'filename'. The file
+// is first truncated to 'valid_size', discarding anything written after it, so
+// that an interrupted append can be undone. A 'valid_size' of 0 starts a new
+// stream.
+class AppendingProtoStreamWriter : public ProtoStreamWriter {
+ public:
+  AppendingProtoStreamWriter(const std::string& filename, uint64 valid_size);
+  ~AppendingProtoStreamWriter() = default;
+
+  bool Close() override;
+
+  // The size of the file, valid after a successful Close().
+  uint64 size() const { return size_; }
+
+ private:
+  const std::string filename_;
+  uint64 size_ = 0;
+};
+
+// Returns true if 'filename' was written by IndexedProtoStreamWriter.
+bool IsIndexedProtoStream(const std::string& filename);
+
+// A reader of the format produced by ProtoStreamWriter or
+// IndexedProtoStreamWriter.
 class ProtoStreamReader : public ProtoStreamReaderInterface {
  public:
   explicit ProtoStreamReader(const std::string& filename);
@@ -65,6 +128,42 @@ class ProtoStreamReader : public ProtoStreamReaderInterface {
   bool Read(std::string* decompressed_data);
 
   std::ifstream in_;
+  // End of the messages if the stream is indexed, 0 otherwise.
+  uint64 end_of_messages_ = 0;
+};
+
+// A reader of the format produced by IndexedProtoStreamWriter. The file is
+// memory mapped. Sequential reads decompress the following messages in
+// parallel on 'num_threads' threads.
+class IndexedProtoStreamReader : public ProtoStreamReaderInterface {
+ public:
+  IndexedProtoStreamReader(const std::string& filename, int num_threads);
+  ~IndexedProtoStreamReader();
+
+  IndexedProtoStreamReader(const IndexedProtoStreamReader&) = delete;
+  IndexedProtoStreamReader& operator=(const IndexedProtoStreamReader&) =
+      delete;
+
+  bool ReadProto(google::protobuf::Message* proto) override;
+  bool eof() const override;
+
+  const proto::ProtoStreamIndex& index() const { return index_; }
+
+  // Reads the message of the given 'index()' entry. Thread-safe.
+  bool ReadProto(int entry_index, google::protobuf::Message* proto) const;
+
+ private:
+  void Decompress(int entry_index, std::string* decompressed_data) const;
+  // Decompresses the next batch of messages in parallel.
+  void DecompressAhead();
+
+  const int num_threads_;
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+  proto::ProtoStreamIndex index_;
+  // Index of the next message returned by sequential reads.
+  int next_entry_index_ = 0;
+  std::deque<std::string> decompressed_ahead_;
 };
 
 }  // namespace io
@@ -22,6 +22,7 @@
 #include <string.h>
 
 #include "cartographer/common/port.h"
+#include "cartographer/mapping/proto/serialization.pb.h"
 #include "cartographer/mapping/proto/trajectory.pb.h"
 #include "gtest/gtest.h"
 
@@ -61,6 +62,174 @@ TEST_F(ProtoStreamTest, WriteAndReadBack) {
   remove(test_file.c_str());
 }
 
+TEST_F(ProtoStreamTest, WriteCompressedAndReadBack) {
+  const std::string test_file = test_directory_ + "/test_compressed.pbstream";
+  {
+    ProtoStreamWriter writer(test_file);
+    for (int i = 0; i != 10; ++i) {
+      mapping::proto::Trajectory trajectory;
+      trajectory.add_node()->set_timestamp(i);
+      if (i % 2 == 0) {
+        writer.WriteProto(trajectory);
+        continue;
+      }
+      std::string uncompressed_data;
+      std::string compressed_data;
+      trajectory.SerializeToString(&uncompressed_data);
+      common::FastGzipString(uncompressed_data, &compressed_data);
+      writer.WriteCompressedProto(compressed_data);
+    }
+    ASSERT_TRUE(writer.Close());
+  }
+  {
+    ProtoStreamReader reader(test_file);
+    for (int i = 0; i != 10; ++i) {
+      mapping::proto::Trajectory trajectory;
+      ASSERT_TRUE(reader.ReadProto(&trajectory));
+      ASSERT_EQ(1, trajectory.node_size());
+      EXPECT_EQ(i, trajectory.node(0).timestamp());
+    }
+    mapping::proto::Trajectory trajectory;
+    EXPECT_FALSE(reader.ReadProto(&trajectory));
+  }
+  remove(test_file.c_str());
+}
+
+TEST_F(ProtoStreamTest, WriteIndexedAndReadBack) {
+  const std::string test_file = test_directory_ + "/test_indexed.pbstream";
+  {
+    IndexedProtoStreamWriter writer(test_file);
+    mapping::proto::SerializationHeader header;
+    header.set_format_version(2);
+    writer.WriteProto(header);
+    for (int i = 0; i != 10; ++i) {
+      mapping::proto::SerializedData data;
+      auto* const node_id = data.mutable_node()->mutable_node_id();
+      node_id->set_trajectory_id(i % 2);
+      node_id->set_node_index(i);
+      writer.WriteProto(data);
+    }
+    ASSERT_TRUE(writer.Close());
+  }
+  EXPECT_TRUE(IsIndexedProtoStream(test_file));
+  {
+    ProtoStreamReader reader(test_file);
+    mapping::proto::SerializationHeader header;
+    ASSERT_TRUE(reader.ReadProto(&header));
+    EXPECT_EQ(2, header.format_version());
+    for (int i = 0; i != 10; ++i) {
+      mapping::proto::SerializedData data;
+      ASSERT_TRUE(reader.ReadProto(&data));
+      EXPECT_EQ(i, data.node().node_id().node_index());
+    }
+    mapping::proto::SerializedData data;
+    EXPECT_FALSE(reader.ReadProto(&data));
+    EXPECT_TRUE(reader.eof());
+  }
+  {
+    IndexedProtoStreamReader reader(test_file, 3 /* num_threads */);
+    ASSERT_EQ(11, reader.index().entry_size());
+    EXPECT_EQ(0, reader.index().entry(0).data_case());
+    mapping::proto::SerializationHeader header;
+    ASSERT_TRUE(reader.ReadProto(&header));
+    EXPECT_EQ(2, header.format_version());
+    for (int i = 0; i != 10; ++i) {
+      const auto& entry = reader.index().entry(i + 1);
+      EXPECT_EQ(mapping::proto::SerializedData::kNode, entry.data_case());
+      EXPECT_EQ(i % 2, entry.trajectory_id());
+      EXPECT_EQ(i, entry.index());
+      mapping::proto::SerializedData data;
+      ASSERT_TRUE(reader.ReadProto(&data));
+      EXPECT_EQ(i, data.node().node_id().node_index());
+    }
+    EXPECT_TRUE(reader.eof());
+    mapping::proto::SerializedData data;
+    EXPECT_FALSE(reader.ReadProto(&data));
+
+    ASSERT_TRUE(reader.ReadProto(7, &data));
+    EXPECT_EQ(6, data.node().node_id().node_index());
+  }
+  remove(test_file.c_str());
+}
+
+TEST_F(ProtoStreamTest, WriteIndexedInParallelAndReadBack) {
+  const std::string test_file = test_directory_ + "/test_parallel.pbstream";
+  constexpr int kNumMessages = 100;
+  {
+    IndexedProtoStreamWriter writer(test_file, 3 /* num_threads */);
+    for (int i = 0; i != kNumMessages; ++i) {
+      mapping::proto::SerializedData data;
+      auto* const node_id = data.mutable_node()->mutable_node_id();
+      node_id->set_trajectory_id(0);
+      node_id->set_node_index(i);
+      writer.WriteProto(data);
+    }
+    ASSERT_TRUE(writer.Close());
+  }
+  {
+    ProtoStreamReader reader(test_file);
+    for (int i = 0; i != kNumMessages; ++i) {
+      mapping::proto::SerializedData data;
+      ASSERT_TRUE(reader.ReadProto(&data));
+      EXPECT_EQ(i, data.node().node_id().node_index());
+    }
+    mapping::proto::SerializedData data;
+    EXPECT_FALSE(reader.ReadProto(&data));
+  }
+  {
+    IndexedProtoStreamReader reader(test_file, 1 /* num_threads */);
+    ASSERT_EQ(kNumMessages, reader.index().entry_size());
+    for (int i = kNumMessages - 1; i >= 0; --i) {
+      EXPECT_EQ(i, reader.index().entry(i).index());
+      mapping::proto::SerializedData data;
+      ASSERT_TRUE(reader.ReadProto(i, &data));
+      EXPECT_EQ(i, data.node().node_id().node_index());
+    }
+  }
+  remove(test_file.c_str());
+}
+
+TEST_F(ProtoStreamTest, UnindexedStreamIsNotIndexed) {
+  const std::string test_file = test_directory_ + "/test_unindexed.pbstream";
+  {
+    ProtoStreamWriter writer(test_file);
+    writer.WriteProto(mapping::proto::Trajectory());
+    ASSERT_TRUE(writer.Close());
+  }
+  EXPECT_FALSE(IsIndexedProtoStream(test_file));
+  remove(test_file.c_str());
+}
+
+TEST_F(ProtoStreamTest, AppendAndDiscardInterruptedAppend) {
+  const std::string test_file = test_directory_ + "/test_appending.pbstream";
+  const auto write_nodes = [&test_file](const uint64 valid_size,
+                                        const int begin,
+                                        const int end) -> uint64 {
+    AppendingProtoStreamWriter writer(test_file, valid_size);
+    for (int i = begin; i != end; ++i) {
+      mapping::proto::Trajectory trajectory;
+      trajectory.add_node()->set_timestamp(i);
+      writer.WriteProto(trajectory);
+    }
+    EXPECT_TRUE(writer.Close());
+    return writer.size();
+  };
+  const uint64 size = write_nodes(0, 0, 3);
+  // Appends are discarded unless their size is passed to the next writer.
+  write_nodes(size, 3, 5);
+  write_nodes(size, 5, 7);
+  ProtoStreamReader reader(test_file);
+  for (const int i : {0, 1, 2, 5, 6}) {
+    mapping::proto::Trajectory trajectory;
+    ASSERT_TRUE(reader.ReadProto(&trajectory));
+    EXPECT_EQ(i, trajectory.node(0).timestamp());
+  }
+  mapping::proto::Trajectory trajectory;
+  EXPECT_FALSE(reader.ReadProto(&trajectory));
+  EXPECT_TRUE(reader.eof());
+  remove(test_file.c_str());
+}
+
 }  // namespace
 }  // namespace io
 }  // namespace cartographer
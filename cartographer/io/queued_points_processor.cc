@@ -0,0 +1,66 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/io/queued_points_processor.h"
+
+namespace cartographer {
+namespace io {
+
+QueuedPointsProcessor::QueuedPointsProcessor(const size_t queue_size,
+                                             PointsProcessor* const next)
+    : next_(next),
+      queue_(queue_size),
+      thread_([this]() { DoWork(); }) {}
+
+QueuedPointsProcessor::~QueuedPointsProcessor() {
+  // A nullptr tells the thread to exit.
+  queue_.Push(nullptr);
+  thread_.join();
+}
+
+void QueuedPointsProcessor::Process(std::unique_ptr<PointsBatch> batch) {
+  {
+    absl::MutexLock locker(&mutex_);
+    ++num_pending_batches_;
+  }
+  queue_.Push(std::move(batch));
+}
+
+PointsProcessor::FlushResult QueuedPointsProcessor::Flush() {
+  {
+    const auto predicate = [this]() EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+      return num_pending_batches_ == 0;
+    };
+    absl::MutexLock locker(&mutex_);
+    mutex_.Await(absl::Condition(&predicate));
+  }
+  return next_->Flush();
+}
+
+void QueuedPointsProcessor::DoWork() {
+  for (;;) {
+    std::unique_ptr<PointsBatch> batch = queue_.Pop();
+    if (batch == nullptr) {
+      return;
+    }
+    next_->Process(std::move(batch));
+    absl::MutexLock locker(&mutex_);
+    --num_pending_batches_;
+  }
+}
+
+}  // namespace io
+}  // namespace cartographer
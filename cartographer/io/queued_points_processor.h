@@ -0,0 +1,60 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_IO_QUEUED_POINTS_PROCESSOR_H_
+#define CARTOGRAPHER_IO_QUEUED_POINTS_PROCESSOR_H_
+
+#include <memory>
+#include <thread>
+
+#include "absl/synchronization/mutex.h"
+#include "cartographer/common/internal/blocking_queue.h"
+#include "cartographer/io/points_processor.h"
+
+namespace cartographer {
+namespace io {
+
+// Hands batches to 'next' on a thread of its own, so that the processors
+// before and after it in the pipeline run concurrently. At most 'queue_size'
+// batches are buffered before 'Process' blocks.
+class QueuedPointsProcessor : public PointsProcessor {
+ public:
+  QueuedPointsProcessor(size_t queue_size, PointsProcessor* next);
+  ~QueuedPointsProcessor() override;
+
+  QueuedPointsProcessor(const QueuedPointsProcessor&) = delete;
+  QueuedPointsProcessor& operator=(const QueuedPointsProcessor&) = delete;
+
+  void Process(std::unique_ptr<PointsBatch> batch) override;
+
+  // Waits until all queued batches have been processed by 'next' and flushes
+  // it on the calling thread.
+  FlushResult Flush() override;
+
+ private:
+  void DoWork();
+
+  PointsProcessor* const next_;
+  common::BlockingQueue<std::unique_ptr<PointsBatch>> queue_;
+  absl::Mutex mutex_;
+  int num_pending_batches_ GUARDED_BY(mutex_) = 0;
+  std::thread thread_;
+};
+
+}  // namespace io
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_IO_QUEUED_POINTS_PROCESSOR_H_
@@ -0,0 +1,190 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/io/sensor_log.h"
+
+#include "cartographer/mapping/local_slam_result_data.h"
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace io {
+namespace {
+
+constexpr int kFormatVersion = 1;
+
+}  // namespace
+
+SensorLogWriter::SensorLogWriter(
+    const mapping::proto::TrajectoryBuilderOptionsWithSensorIds&
+        trajectory_builder_options,
+    ProtoStreamWriterInterface* const writer)
+    : writer_(writer) {
+  proto::SensorLogHeader header;
+  header.set_format_version(kFormatVersion);
+  *header.mutable_trajectory_builder_options() = trajectory_builder_options;
+  writer_->WriteProto(header);
+}
+
+void SensorLogWriter::Write(
+    const std::string& sensor_id,
+    const sensor::TimedPointCloudData& timed_point_cloud_data) {
+  entry_.set_sensor_id(sensor_id);
+  *entry_.mutable_timed_point_cloud_data() =
+      sensor::ToPackedProto(timed_point_cloud_data);
+  writer_->WriteProto(entry_);
+}
+
+void SensorLogWriter::Write(const std::string& sensor_id,
+                            const sensor::ImuData& imu_data) {
+  entry_.set_sensor_id(sensor_id);
+  *entry_.mutable_imu_data() = sensor::ToProto(imu_data);
+  writer_->WriteProto(entry_);
+}
+
+void SensorLogWriter::Write(const std::string& sensor_id,
+                            const sensor::OdometryData& odometry_data) {
+  entry_.set_sensor_id(sensor_id);
+  *entry_.mutable_odometry_data() = sensor::ToProto(odometry_data);
+  writer_->WriteProto(entry_);
+}
+
+void SensorLogWriter::Write(
+    const std::string& sensor_id,
+    const sensor::FixedFramePoseData& fixed_frame_pose_data) {
+  entry_.set_sensor_id(sensor_id);
+  *entry_.mutable_fixed_frame_pose_data() =
+      sensor::ToProto(fixed_frame_pose_data);
+  writer_->WriteProto(entry_);
+}
+
+void SensorLogWriter::Write(const std::string& sensor_id,
+                            const sensor::LandmarkData& landmark_data) {
+  entry_.set_sensor_id(sensor_id);
+  *entry_.mutable_landmark_data() = sensor::ToProto(landmark_data);
+  writer_->WriteProto(entry_);
+}
+
+SensorLogRecordingTrajectoryBuilder::SensorLogRecordingTrajectoryBuilder(
+    mapping::TrajectoryBuilderInterface* const trajectory_builder,
+    SensorLogWriter* const sensor_log_writer)
+    : trajectory_builder_(trajectory_builder),
+      sensor_log_writer_(sensor_log_writer) {}
+
+void SensorLogRecordingTrajectoryBuilder::AddSensorData(
+    const std::string& sensor_id,
+    const sensor::TimedPointCloudData& timed_point_cloud_data) {
+  sensor_log_writer_->Write(sensor_id, timed_point_cloud_data);
+  trajectory_builder_->AddSensorData(sensor_id, timed_point_cloud_data);
+}
+
+void SensorLogRecordingTrajectoryBuilder::AddSensorData(
+    const std::string& sensor_id,
+    sensor::TimedPointCloudData&& timed_point_cloud_data) {
+  sensor_log_writer_->Write(sensor_id, timed_point_cloud_data);
+  trajectory_builder_->AddSensorData(sensor_id,
+                                     std::move(timed_point_cloud_data));
+}
+
+void SensorLogRecordingTrajectoryBuilder::AddSensorData(
+    const std::string& sensor_id, const sensor::ImuData& imu_data) {
+  sensor_log_writer_->Write(sensor_id, imu_data);
+  trajectory_builder_->AddSensorData(sensor_id, imu_data);
+}
+
+void SensorLogRecordingTrajectoryBuilder::AddSensorData(
+    const std::string& sensor_id, const sensor::OdometryData& odometry_data) {
+  sensor_log_writer_->Write(sensor_id, odometry_data);
+  trajectory_builder_->AddSensorData(sensor_id, odometry_data);
+}
+
+void SensorLogRecordingTrajectoryBuilder::AddSensorData(
+    const std::string& sensor_id,
+    const sensor::FixedFramePoseData& fixed_frame_pose) {
+  sensor_log_writer_->Write(sensor_id, fixed_frame_pose);
+  trajectory_builder_->AddSensorData(sensor_id, fixed_frame_pose);
+}
+
+void SensorLogRecordingTrajectoryBuilder::AddSensorData(
+    const std::string& sensor_id, const sensor::LandmarkData& landmark_data) {
+  sensor_log_writer_->Write(sensor_id, landmark_data);
+  trajectory_builder_->AddSensorData(sensor_id, landmark_data);
+}
+
+void SensorLogRecordingTrajectoryBuilder::AddLocalSlamResultData(
+    std::unique_ptr<mapping::LocalSlamResultData> local_slam_result_data) {
+  trajectory_builder_->AddLocalSlamResultData(
+      std::move(local_slam_result_data));
+}
+
+void SensorLogRecordingTrajectoryBuilder::Flush() {
+  trajectory_builder_->Flush();
+}
+
+SensorLogReader::SensorLogReader(ProtoStreamReaderInterface* const reader)
+    : reader_(reader) {
+  CHECK(reader_->ReadProto(&header_)) << "Failed to read sensor log header.";
+  CHECK_EQ(header_.format_version(), kFormatVersion)
+      << "Unsupported sensor log format version.";
+}
+
+bool SensorLogReader::ReadEntry(proto::SensorLogEntry* const entry) {
+  return !reader_->eof() && reader_->ReadProto(entry);
+}
+
+common::Time AddSensorLogEntry(
+    const proto::SensorLogEntry& entry,
+    mapping::TrajectoryBuilderInterface* const trajectory_builder) {
+  switch (entry.data_case()) {
+    case proto::SensorLogEntry::kTimedPointCloudData: {
+      sensor::TimedPointCloudData timed_point_cloud_data =
+          sensor::FromProto(entry.timed_point_cloud_data());
+      const common::Time time = timed_point_cloud_data.time;
+      trajectory_builder->AddSensorData(entry.sensor_id(),
+                                        std::move(timed_point_cloud_data));
+      return time;
+    }
+    case proto::SensorLogEntry::kImuData: {
+      const sensor::ImuData imu_data = sensor::FromProto(entry.imu_data());
+      trajectory_builder->AddSensorData(entry.sensor_id(), imu_data);
+      return imu_data.time;
+    }
+    case proto::SensorLogEntry::kOdometryData: {
+      const sensor::OdometryData odometry_data =
+          sensor::FromProto(entry.odometry_data());
+      trajectory_builder->AddSensorData(entry.sensor_id(), odometry_data);
+      return odometry_data.time;
+    }
+    case proto::SensorLogEntry::kFixedFramePoseData: {
+      const sensor::FixedFramePoseData fixed_frame_pose_data =
+          sensor::FromProto(entry.fixed_frame_pose_data());
+      trajectory_builder->AddSensorData(entry.sensor_id(),
+                                        fixed_frame_pose_data);
+      return fixed_frame_pose_data.time;
+    }
+    case proto::SensorLogEntry::kLandmarkData: {
+      const sensor::LandmarkData landmark_data =
+          sensor::FromProto(entry.landmark_data());
+      trajectory_builder->AddSensorData(entry.sensor_id(), landmark_data);
+      return landmark_data.time;
+    }
+    case proto::SensorLogEntry::DATA_NOT_SET:
+      break;
+  }
+  LOG(FATAL) << "Sensor log entry without data.";
+}
+
+}  // namespace io
+}  // namespace cartographer
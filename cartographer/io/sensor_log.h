@@ -0,0 +1,123 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_IO_SENSOR_LOG_H_
+#define CARTOGRAPHER_IO_SENSOR_LOG_H_
+
+#include <memory>
+#include <string>
+
+#include "cartographer/common/time.h"
+#include "cartographer/io/proto/sensor_log.pb.h"
+#include "cartographer/io/proto_stream_interface.h"
+#include "cartographer/mapping/proto/trajectory_builder_options.pb.h"
+#include "cartographer/mapping/trajectory_builder_interface.h"
+
+namespace cartographer {
+namespace io {
+
+// Writes the sensor data of one trajectory to a proto stream, so that it can
+// be replayed without the sensors or the frontend which produced it, e.g. to
+// benchmark the 'MapBuilder'.
+class SensorLogWriter {
+ public:
+  // Writes the header. 'writer' must outlive this object.
+  SensorLogWriter(
+      const mapping::proto::TrajectoryBuilderOptionsWithSensorIds&
+          trajectory_builder_options,
+      ProtoStreamWriterInterface* writer);
+
+  SensorLogWriter(const SensorLogWriter&) = delete;
+  SensorLogWriter& operator=(const SensorLogWriter&) = delete;
+
+  void Write(const std::string& sensor_id,
+             const sensor::TimedPointCloudData& timed_point_cloud_data);
+  void Write(const std::string& sensor_id, const sensor::ImuData& imu_data);
+  void Write(const std::string& sensor_id,
+             const sensor::OdometryData& odometry_data);
+  void Write(const std::string& sensor_id,
+             const sensor::FixedFramePoseData& fixed_frame_pose_data);
+  void Write(const std::string& sensor_id,
+             const sensor::LandmarkData& landmark_data);
+
+ private:
+  ProtoStreamWriterInterface* const writer_;
+  proto::SensorLogEntry entry_;
+};
+
+// Passes all sensor data on to 'trajectory_builder' and writes it to
+// 'sensor_log_writer'. Local SLAM results are passed on, but not recorded.
+class SensorLogRecordingTrajectoryBuilder
+    : public mapping::TrajectoryBuilderInterface {
+ public:
+  SensorLogRecordingTrajectoryBuilder(
+      mapping::TrajectoryBuilderInterface* trajectory_builder,
+      SensorLogWriter* sensor_log_writer);
+  ~SensorLogRecordingTrajectoryBuilder() override {}
+
+  void AddSensorData(
+      const std::string& sensor_id,
+      const sensor::TimedPointCloudData& timed_point_cloud_data) override;
+  void AddSensorData(
+      const std::string& sensor_id,
+      sensor::TimedPointCloudData&& timed_point_cloud_data) override;
+  void AddSensorData(const std::string& sensor_id,
+                     const sensor::ImuData& imu_data) override;
+  void AddSensorData(const std::string& sensor_id,
+                     const sensor::OdometryData& odometry_data) override;
+  void AddSensorData(
+      const std::string& sensor_id,
+      const sensor::FixedFramePoseData& fixed_frame_pose) override;
+  void AddSensorData(const std::string& sensor_id,
+                     const sensor::LandmarkData& landmark_data) override;
+  void AddLocalSlamResultData(std::unique_ptr<mapping::LocalSlamResultData>
+                                  local_slam_result_data) override;
+  void Flush() override;
+
+ private:
+  mapping::TrajectoryBuilderInterface* const trajectory_builder_;
+  SensorLogWriter* const sensor_log_writer_;
+};
+
+// Reads a sensor log written by 'SensorLogWriter'.
+class SensorLogReader {
+ public:
+  // Reads and checks the header. 'reader' must outlive this object.
+  explicit SensorLogReader(ProtoStreamReaderInterface* reader);
+
+  SensorLogReader(const SensorLogReader&) = delete;
+  SensorLogReader& operator=(const SensorLogReader&) = delete;
+
+  const proto::SensorLogHeader& header() const { return header_; }
+
+  // Returns false at the end of the log.
+  bool ReadEntry(proto::SensorLogEntry* entry);
+
+ private:
+  ProtoStreamReaderInterface* const reader_;
+  proto::SensorLogHeader header_;
+};
+
+// Adds the sensor data of 'entry' to 'trajectory_builder' and returns its
+// time.
+common::Time AddSensorLogEntry(
+    const proto::SensorLogEntry& entry,
+    mapping::TrajectoryBuilderInterface* trajectory_builder);
+
+}  // namespace io
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_IO_SENSOR_LOG_H_
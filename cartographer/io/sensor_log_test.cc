@@ -0,0 +1,101 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/io/sensor_log.h"
+
+#include <queue>
+
+#include "cartographer/io/internal/in_memory_proto_stream.h"
+#include "cartographer/mapping/internal/testing/mock_trajectory_builder.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace io {
+namespace {
+
+using ::testing::An;
+using ::testing::Field;
+using ::testing::InSequence;
+using ::testing::Matcher;
+
+TEST(SensorLogTest, RecordAndReplay) {
+  mapping::proto::TrajectoryBuilderOptionsWithSensorIds options;
+  options.add_sensor_id()->set_id("range");
+  options.add_sensor_id()->set_id("imu");
+  std::queue<std::unique_ptr<google::protobuf::Message>> written_protos;
+  ForwardingProtoStreamWriter writer(
+      [&written_protos](const google::protobuf::Message* proto) {
+        if (proto != nullptr) {
+          written_protos.emplace(proto->New());
+          written_protos.back()->CopyFrom(*proto);
+        }
+        return true;
+      });
+
+  const common::Time range_time = common::FromUniversal(1000);
+  const common::Time imu_time = common::FromUniversal(2000);
+  {
+    mapping::testing::MockTrajectoryBuilder recorded_trajectory_builder;
+    EXPECT_CALL(recorded_trajectory_builder,
+                AddSensorData("range",
+                              An<const sensor::TimedPointCloudData&>()));
+    EXPECT_CALL(recorded_trajectory_builder,
+                AddSensorData("imu", An<const sensor::ImuData&>()));
+    SensorLogWriter sensor_log_writer(options, &writer);
+    SensorLogRecordingTrajectoryBuilder trajectory_builder(
+        &recorded_trajectory_builder, &sensor_log_writer);
+    sensor::TimedPointCloudData range_data;
+    range_data.time = range_time;
+    range_data.origin = Eigen::Vector3f(1.f, 2.f, 3.f);
+    range_data.ranges.push_back({Eigen::Vector3f(4.f, 5.f, 6.f), -0.1f});
+    trajectory_builder.AddSensorData("range", range_data);
+    trajectory_builder.AddSensorData(
+        "imu", sensor::ImuData{imu_time, Eigen::Vector3d::UnitZ(),
+                               Eigen::Vector3d::Zero()});
+  }
+
+  InMemoryProtoStreamReader reader(std::move(written_protos));
+  SensorLogReader sensor_log_reader(&reader);
+  ASSERT_EQ(2, sensor_log_reader.header().trajectory_builder_options()
+                   .sensor_id_size());
+  EXPECT_EQ("imu", sensor_log_reader.header()
+                       .trajectory_builder_options()
+                       .sensor_id(1)
+                       .id());
+  mapping::testing::MockTrajectoryBuilder replayed_trajectory_builder;
+  {
+    InSequence sequence;
+    EXPECT_CALL(replayed_trajectory_builder,
+                AddSensorData("range",
+                              Matcher<const sensor::TimedPointCloudData&>(
+                                  Field(&sensor::TimedPointCloudData::time,
+                                        range_time))));
+    EXPECT_CALL(replayed_trajectory_builder,
+                AddSensorData("imu", Matcher<const sensor::ImuData&>(Field(
+                                         &sensor::ImuData::time, imu_time))));
+  }
+  proto::SensorLogEntry entry;
+  ASSERT_TRUE(sensor_log_reader.ReadEntry(&entry));
+  EXPECT_EQ(range_time, AddSensorLogEntry(entry, &replayed_trajectory_builder));
+  ASSERT_TRUE(sensor_log_reader.ReadEntry(&entry));
+  EXPECT_EQ(imu_time, AddSensorLogEntry(entry, &replayed_trajectory_builder));
+  EXPECT_FALSE(sensor_log_reader.ReadEntry(&entry));
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace cartographer
@@ -16,6 +16,9 @@
 
 #include "cartographer/io/serialization_format_migration.h"
 
+#include <algorithm>
+#include <map>
+#include <set>
 #include <vector>
 
 #include "cartographer/common/config.h"
@@ -37,6 +40,52 @@
 
 namespace cartographer {
 namespace io {
+namespace {
+
+// Adds the rotational scan matcher histogram of the node with 'node_data',
+// rotated into the submap frame, to the histogram of 'submap_3d_proto'.
+void AddNodeHistogramToSubmap(
+    const mapping::proto::TrajectoryNodeData& node_data,
+    mapping::proto::Submap3D* const submap_3d_proto) {
+  const Eigen::VectorXf rotational_scan_matcher_histogram_in_gravity =
+      Eigen::Map<const Eigen::VectorXf>(
+          node_data.rotational_scan_matcher_histogram().data(),
+          node_data.rotational_scan_matcher_histogram_size());
+  const double submap_yaw_from_gravity = transform::GetYaw(
+      transform::ToRigid3(submap_3d_proto->local_pose()).inverse().rotation() *
+      transform::ToRigid3(node_data.local_pose()).rotation() *
+      transform::ToEigen(node_data.gravity_alignment()).inverse());
+  const Eigen::VectorXf rotational_scan_matcher_histogram_in_submap =
+      mapping::scan_matching::RotationalScanMatcher::RotateHistogram(
+          rotational_scan_matcher_histogram_in_gravity,
+          submap_yaw_from_gravity);
+
+  if (submap_3d_proto->rotational_scan_matcher_histogram_size() == 0) {
+    for (Eigen::VectorXf::Index i = 0;
+         i != rotational_scan_matcher_histogram_in_submap.size(); ++i) {
+      submap_3d_proto->add_rotational_scan_matcher_histogram(
+          rotational_scan_matcher_histogram_in_submap(i));
+    }
+  } else {
+    auto submap_histogram =
+        submap_3d_proto->mutable_rotational_scan_matcher_histogram();
+    for (Eigen::VectorXf::Index i = 0;
+         i != rotational_scan_matcher_histogram_in_submap.size(); ++i) {
+      *submap_histogram->Mutable(i) +=
+          rotational_scan_matcher_histogram_in_submap(i);
+    }
+  }
+}
+
+mapping::SubmapId ToSubmapId(const mapping::proto::SubmapId& proto) {
+  return mapping::SubmapId{proto.trajectory_id(), proto.submap_index()};
+}
+
+mapping::NodeId ToNodeId(const mapping::proto::NodeId& proto) {
+  return mapping::NodeId{proto.trajectory_id(), proto.node_index()};
+}
+
+}  // namespace
 
 using mapping::proto::SerializedData;
 
@@ -211,6 +260,133 @@ void MigrateStreamVersion1ToVersion2(
                 include_unfinished_submaps);
 }
 
+void MigrateStreamVersion1ToVersion2Streaming(
+    const std::function<std::unique_ptr<ProtoStreamReaderInterface>()>&
+        open_input,
+    ProtoStreamWriterInterface* const output,
+    bool include_unfinished_submaps) {
+  // The first pass only keeps the local pose, the finished flag and the
+  // accumulated histogram of each submap. Grids and node data are dropped as
+  // soon as they have been looked at.
+  std::map<mapping::SubmapId, mapping::proto::Submap> submap_summaries;
+  std::map<mapping::NodeId, std::vector<mapping::SubmapId>> node_to_submaps;
+  bool migrate_histograms = false;
+  {
+    const std::unique_ptr<ProtoStreamReaderInterface> input = open_input();
+    ProtoStreamDeserializer deserializer(input.get());
+    migrate_histograms = deserializer.header().format_version() ==
+                         kFormatVersionWithoutSubmapHistograms;
+    for (const auto& constraint_proto :
+         deserializer.pose_graph().constraint()) {
+      if (constraint_proto.tag() ==
+          mapping::proto::PoseGraph::Constraint::INTRA_SUBMAP) {
+        node_to_submaps[ToNodeId(constraint_proto.node_id())].push_back(
+            ToSubmapId(constraint_proto.submap_id()));
+      }
+    }
+
+    SerializedData proto;
+    std::set<mapping::NodeId> seen_nodes;
+    while (deserializer.ReadNextSerializedData(&proto)) {
+      if (proto.has_submap()) {
+        CHECK(proto.submap().has_submap_3d())
+            << "Converting to the new submap format only makes sense for 3D.";
+        const mapping::proto::Submap3D& submap_3d = proto.submap().submap_3d();
+        mapping::proto::Submap& summary =
+            submap_summaries[ToSubmapId(proto.submap().submap_id())];
+        mapping::proto::Submap3D* const summary_3d =
+            summary.mutable_submap_3d();
+        *summary_3d->mutable_local_pose() = submap_3d.local_pose();
+        summary_3d->set_finished(submap_3d.finished());
+        *summary_3d->mutable_rotational_scan_matcher_histogram() =
+            submap_3d.rotational_scan_matcher_histogram();
+      } else if (proto.has_node() && migrate_histograms) {
+        const mapping::NodeId node_id = ToNodeId(proto.node().node_id());
+        seen_nodes.insert(node_id);
+        const auto it = node_to_submaps.find(node_id);
+        if (it == node_to_submaps.end()) continue;
+        for (const mapping::SubmapId& submap_id : it->second) {
+          CHECK(submap_summaries.count(submap_id))
+              << "Submap " << submap_id << " must precede node " << node_id
+              << " in the stream.";
+          AddNodeHistogramToSubmap(
+              proto.node().node_data(),
+              submap_summaries.at(submap_id).mutable_submap_3d());
+        }
+      }
+    }
+    CHECK(input->eof());
+    if (migrate_histograms) {
+      for (const auto& node_id_submaps : node_to_submaps) {
+        CHECK(seen_nodes.count(node_id_submaps.first))
+            << "Missing node " << node_id_submaps.first;
+      }
+    }
+  }
+
+  // The second pass writes the migrated stream, replacing the histogram of
+  // every submap by the one accumulated above.
+  const std::unique_ptr<ProtoStreamReaderInterface> input = open_input();
+  ProtoStreamDeserializer deserializer(input.get());
+  const auto is_skipped = [&](const mapping::SubmapId& submap_id) {
+    if (include_unfinished_submaps) return false;
+    const auto it = submap_summaries.find(submap_id);
+    return it != submap_summaries.end() &&
+           !it->second.submap_3d().finished();
+  };
+
+  mapping::proto::SerializationHeader header;
+  header.set_format_version(kMappingStateSerializationFormatVersion);
+  output->WriteProto(header);
+
+  SerializedData proto;
+  mapping::proto::PoseGraph* const pose_graph_proto =
+      proto.mutable_pose_graph();
+  *pose_graph_proto = deserializer.pose_graph();
+  for (mapping::proto::Trajectory& trajectory_proto :
+       *pose_graph_proto->mutable_trajectory()) {
+    auto* const submaps = trajectory_proto.mutable_submap();
+    submaps->erase(
+        std::remove_if(submaps->begin(), submaps->end(),
+                       [&](const mapping::proto::Trajectory::Submap& submap) {
+                         return is_skipped(mapping::SubmapId{
+                             trajectory_proto.trajectory_id(),
+                             submap.submap_index()});
+                       }),
+        submaps->end());
+  }
+  auto* const constraints = pose_graph_proto->mutable_constraint();
+  constraints->erase(
+      std::remove_if(
+          constraints->begin(), constraints->end(),
+          [&](const mapping::proto::PoseGraph::Constraint& constraint) {
+            return is_skipped(ToSubmapId(constraint.submap_id()));
+          }),
+      constraints->end());
+  output->WriteProto(proto);
+
+  proto.Clear();
+  *proto.mutable_all_trajectory_builder_options() =
+      deserializer.all_trajectory_builder_options();
+  output->WriteProto(proto);
+
+  while (deserializer.ReadNextSerializedData(&proto)) {
+    if (proto.has_submap()) {
+      const mapping::SubmapId submap_id =
+          ToSubmapId(proto.submap().submap_id());
+      if (is_skipped(submap_id)) continue;
+      *proto.mutable_submap()
+           ->mutable_submap_3d()
+           ->mutable_rotational_scan_matcher_histogram() =
+          submap_summaries.at(submap_id)
+              .submap_3d()
+              .rotational_scan_matcher_histogram();
+    }
+    output->WriteProto(proto);
+  }
+  CHECK(input->eof());
+}
+
 mapping::MapById<mapping::SubmapId, mapping::proto::Submap>
 MigrateSubmapFormatVersion1ToVersion2(
     const mapping::MapById<mapping::SubmapId, mapping::proto::Submap>&
@@ -230,45 +406,12 @@ MigrateSubmapFormatVersion1ToVersion2(
       NodeId node_id{constraint_proto.node_id().trajectory_id(),
                      constraint_proto.node_id().node_index()};
       CHECK(node_id_to_node.Contains(node_id));
-      const TrajectoryNode::Data node_data =
-          FromProto(node_id_to_node.at(node_id).node_data());
-      const Eigen::VectorXf& rotational_scan_matcher_histogram_in_gravity =
-          node_data.rotational_scan_matcher_histogram;
-
-      SubmapId submap_id{constraint_proto.submap_id().trajectory_id(),
-                         constraint_proto.submap_id().submap_index()};
+      const SubmapId submap_id = ToSubmapId(constraint_proto.submap_id());
       CHECK(migrated_submaps.Contains(submap_id));
       proto::Submap& migrated_submap_proto = migrated_submaps.at(submap_id);
       CHECK(migrated_submap_proto.has_submap_3d());
-
-      proto::Submap3D* submap_3d_proto =
-          migrated_submap_proto.mutable_submap_3d();
-      const double submap_yaw_from_gravity =
-          transform::GetYaw(transform::ToRigid3(submap_3d_proto->local_pose())
-                                .inverse()
-                                .rotation() *
-                            node_data.local_pose.rotation() *
-                            node_data.gravity_alignment.inverse());
-      const Eigen::VectorXf rotational_scan_matcher_histogram_in_submap =
-          scan_matching::RotationalScanMatcher::RotateHistogram(
-              rotational_scan_matcher_histogram_in_gravity,
-              submap_yaw_from_gravity);
-
-      if (submap_3d_proto->rotational_scan_matcher_histogram_size() == 0) {
-        for (Eigen::VectorXf::Index i = 0;
-             i != rotational_scan_matcher_histogram_in_submap.size(); ++i) {
-          submap_3d_proto->add_rotational_scan_matcher_histogram(
-              rotational_scan_matcher_histogram_in_submap(i));
-        }
-      } else {
-        auto submap_histogram =
-            submap_3d_proto->mutable_rotational_scan_matcher_histogram();
-        for (Eigen::VectorXf::Index i = 0;
-             i != rotational_scan_matcher_histogram_in_submap.size(); ++i) {
-          *submap_histogram->Mutable(i) +=
-              rotational_scan_matcher_histogram_in_submap(i);
-        }
-      }
+      AddNodeHistogramToSubmap(node_id_to_node.at(node_id).node_data(),
+                               migrated_submap_proto.mutable_submap_3d());
     }
   }
   return migrated_submaps;
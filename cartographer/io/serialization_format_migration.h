@@ -17,6 +17,9 @@
 #ifndef CARTOGRAPHER_IO_SERIALIZATION_FORMAT_MIGRATION_H_
 #define CARTOGRAPHER_IO_SERIALIZATION_FORMAT_MIGRATION_H_
 
+#include <functional>
+#include <memory>
+
 #include "cartographer/io/proto_stream_interface.h"
 #include "cartographer/mapping/id.h"
 #include "cartographer/mapping/proto/serialization.pb.h"
@@ -32,6 +35,16 @@ void MigrateStreamVersion1ToVersion2(
     cartographer::io::ProtoStreamWriterInterface* const output,
     bool include_unfinished_submaps);
 
+// Same as above, but converts the messages on the fly instead of loading the
+// whole state into a pose graph. Memory use is bounded by the pose graph
+// proto and one histogram per submap, independent of the size of grids and
+// sensor data. 'open_input' is called twice, the first pass accumulates the
+// submap histograms and the second one writes the migrated stream.
+void MigrateStreamVersion1ToVersion2Streaming(
+    const std::function<std::unique_ptr<ProtoStreamReaderInterface>()>&
+        open_input,
+    ProtoStreamWriterInterface* output, bool include_unfinished_submaps);
+
 mapping::MapById<mapping::SubmapId, mapping::proto::Submap>
 MigrateSubmapFormatVersion1ToVersion2(
     const mapping::MapById<mapping::SubmapId, mapping::proto::Submap>&
@@ -18,7 +18,9 @@
 
 #include <functional>
 #include <memory>
+#include <vector>
 
+#include "absl/memory/memory.h"
 #include "cartographer/io/internal/in_memory_proto_stream.h"
 #include "cartographer/mapping/internal/testing/test_helpers.h"
 #include "cartographer/mapping/proto/pose_graph.pb.h"
@@ -106,6 +108,73 @@ TEST_F(SubmapHistogramMigrationTest,
   }
 }
 
+TEST_F(SubmapHistogramMigrationTest, StreamingMigrationAddsHistograms) {
+  const mapping::proto::Submap unfinished_submap =
+      mapping::testing::CreateFakeSubmap3D(
+          submap_.submap_id().trajectory_id(),
+          submap_.submap_id().submap_index() + 1, false /* finished */);
+  const auto open_input = [this, &unfinished_submap]() {
+    auto input = absl::make_unique<InMemoryProtoStreamReader>();
+    mapping::proto::SerializationHeader header;
+    header.set_format_version(1);
+    input->AddProto(header);
+    mapping::proto::SerializedData pose_graph;
+    *pose_graph.mutable_pose_graph() = pose_graph_;
+    mapping::proto::PoseGraph::Constraint* const constraint =
+        pose_graph.mutable_pose_graph()->add_constraint();
+    *constraint = pose_graph_.constraint(0);
+    *constraint->mutable_submap_id() = unfinished_submap.submap_id();
+    input->AddProto(pose_graph);
+    mapping::proto::SerializedData options;
+    options.mutable_all_trajectory_builder_options();
+    input->AddProto(options);
+    mapping::proto::SerializedData data;
+    *data.mutable_submap() = submap_;
+    input->AddProto(data);
+    *data.mutable_submap() = unfinished_submap;
+    input->AddProto(data);
+    *data.mutable_node() = node_;
+    input->AddProto(data);
+    return std::unique_ptr<ProtoStreamReaderInterface>(std::move(input));
+  };
+
+  // The first message written is the header, all others are SerializedData.
+  std::unique_ptr<mapping::proto::SerializationHeader> output_header;
+  std::vector<mapping::proto::SerializedData> output_protos;
+  ForwardingProtoStreamWriter output(
+      [&output_header, &output_protos](const google::protobuf::Message* proto) {
+        if (proto == nullptr) return true;
+        if (output_header == nullptr) {
+          output_header =
+              absl::make_unique<mapping::proto::SerializationHeader>();
+          output_header->CopyFrom(*proto);
+        } else {
+          output_protos.emplace_back();
+          output_protos.back().CopyFrom(*proto);
+        }
+        return true;
+      });
+  MigrateStreamVersion1ToVersion2Streaming(
+      open_input, &output, false /* include_unfinished_submaps */);
+  ASSERT_TRUE(output.Close());
+
+  ASSERT_NE(output_header, nullptr);
+  EXPECT_EQ(output_header->format_version(), 2);
+  ASSERT_EQ(output_protos.size(), 4);
+  EXPECT_EQ(output_protos[0].pose_graph().constraint_size(), 1);
+  EXPECT_TRUE(output_protos[1].has_all_trajectory_builder_options());
+  const mapping::proto::Submap3D& migrated_submap_3d =
+      output_protos[2].submap().submap_3d();
+  const mapping::proto::TrajectoryNodeData& node_data = node_.node_data();
+  ASSERT_EQ(migrated_submap_3d.rotational_scan_matcher_histogram_size(),
+            node_data.rotational_scan_matcher_histogram_size());
+  for (int i = 0; i < node_data.rotational_scan_matcher_histogram_size(); ++i) {
+    EXPECT_EQ(migrated_submap_3d.rotational_scan_matcher_histogram(i),
+              node_data.rotational_scan_matcher_histogram(i));
+  }
+  EXPECT_TRUE(output_protos[3].has_node());
+}
+
 }  // namespace
 }  // namespace io
 }  // namespace cartographer
@@ -16,6 +16,10 @@
 
 #include "cartographer/io/submap_painter.h"
 
+#include <algorithm>
+#include <thread>
+#include <vector>
+
 #include "cartographer/mapping/2d/submap_2d.h"
 #include "cartographer/mapping/3d/submap_3d.h"
 
@@ -27,34 +31,43 @@ Eigen::Affine3d ToEigen(const ::cartographer::transform::Rigid3d& rigid3) {
   return Eigen::Translation3d(rigid3.translation()) * rigid3.rotation();
 }
 
-void CairoPaintSubmapSlices(
-    const double scale,
-    const std::map<::cartographer::mapping::SubmapId, SubmapSlice>& submaps,
-    cairo_t* cr, std::function<void(const SubmapSlice&)> draw_callback) {
-  cairo_scale(cr, scale, scale);
+// Transforms from the pixel coordinates of 'submap_slice' into the map frame
+// coordinates of 'cr'.
+void ApplySliceTransform(const SubmapSlice& submap_slice, cairo_t* cr) {
+  const Eigen::Matrix4d homo =
+      ToEigen(submap_slice.pose * submap_slice.slice_pose).matrix();
+  cairo_matrix_t matrix;
+  cairo_matrix_init(&matrix, homo(1, 0), homo(0, 0), -homo(1, 1), -homo(0, 1),
+                    homo(0, 3), -homo(1, 3));
+  cairo_transform(cr, &matrix);
+  cairo_scale(cr, submap_slice.resolution, submap_slice.resolution);
+}
 
-  for (auto& pair : submaps) {
-    const auto& submap_slice = pair.second;
-    if (submap_slice.surface == nullptr) {
-      return;
-    }
-    const Eigen::Matrix4d homo =
-        ToEigen(submap_slice.pose * submap_slice.slice_pose).matrix();
-
-    cairo_save(cr);
-    cairo_matrix_t matrix;
-    cairo_matrix_init(&matrix, homo(1, 0), homo(0, 0), -homo(1, 1), -homo(0, 1),
-                      homo(0, 3), -homo(1, 3));
-    cairo_transform(cr, &matrix);
-
-    const double submap_resolution = submap_slice.resolution;
-    cairo_scale(cr, submap_resolution, submap_resolution);
-
-    // Invokes caller's callback to utilize slice data in global cooridnate
-    // frame. e.g. finds bounding box, paints slices.
-    draw_callback(submap_slice);
-    cairo_restore(cr);
+// Returns the version of 'proto' as reported by ToResponseProto().
+int GetSubmapVersion(const mapping::proto::Submap& proto) {
+  return proto.has_submap_3d() ? proto.submap_3d().num_range_data()
+                               : proto.submap_2d().num_range_data();
+}
+
+// Paints 'submap_slices' into 'surface', whose top left pixel is at
+// 'pixel_min' in the coordinates of GetSubmapSliceBoundingBox().
+void PaintSubmapSlicesIntoSurface(
+    const std::vector<const SubmapSlice*>& submap_slices,
+    const double resolution, const Eigen::Vector2i& pixel_min,
+    cairo_surface_t* const surface) {
+  auto cr = MakeUniqueCairoPtr(cairo_create(surface));
+  cairo_set_source_rgba(cr.get(), 0.5, 0.0, 0.0, 1.);
+  cairo_paint(cr.get());
+  cairo_translate(cr.get(), -pixel_min.x(), -pixel_min.y());
+  cairo_scale(cr.get(), 1. / resolution, 1. / resolution);
+  for (const SubmapSlice* const submap_slice : submap_slices) {
+    cairo_save(cr.get());
+    ApplySliceTransform(*submap_slice, cr.get());
+    cairo_set_source_surface(cr.get(), submap_slice->surface.get(), 0., 0.);
+    cairo_paint(cr.get());
+    cairo_restore(cr.get());
   }
+  cairo_surface_flush(surface);
 }
 
 bool Has2DGrid(const mapping::proto::Submap& submap) {
@@ -71,49 +84,117 @@ bool Has3DGrids(const mapping::proto::Submap& submap) {
 
 PaintSubmapSlicesResult PaintSubmapSlices(
     const std::map<::cartographer::mapping::SubmapId, SubmapSlice>& submaps,
-    const double resolution) {
+    const double resolution, const int num_threads) {
   Eigen::AlignedBox2f bounding_box;
-  {
-    auto surface = MakeUniqueCairoSurfacePtr(
-        cairo_image_surface_create(kCairoFormat, 1, 1));
-    auto cr = MakeUniqueCairoPtr(cairo_create(surface.get()));
-    const auto update_bounding_box = [&bounding_box, &cr](double x, double y) {
-      cairo_user_to_device(cr.get(), &x, &y);
-      bounding_box.extend(Eigen::Vector2f(x, y));
-    };
-
-    CairoPaintSubmapSlices(
-        1. / resolution, submaps, cr.get(),
-        [&update_bounding_box](const SubmapSlice& submap_slice) {
-          update_bounding_box(0, 0);
-          update_bounding_box(submap_slice.width, 0);
-          update_bounding_box(0, submap_slice.height);
-          update_bounding_box(submap_slice.width, submap_slice.height);
-        });
+  for (const auto& pair : submaps) {
+    if (pair.second.surface == nullptr) {
+      continue;
+    }
+    bounding_box.extend(GetSubmapSliceBoundingBox(pair.second, resolution));
   }
 
   const int kPaddingPixel = 5;
-  const Eigen::Array2i size(
-      std::ceil(bounding_box.sizes().x()) + 2 * kPaddingPixel,
-      std::ceil(bounding_box.sizes().y()) + 2 * kPaddingPixel);
-  const Eigen::Array2f origin(-bounding_box.min().x() + kPaddingPixel,
-                              -bounding_box.min().y() + kPaddingPixel);
+  // Pixel boundaries are aligned so that partial repaints of the same map
+  // line up with a full repaint.
+  const Eigen::Vector2i min(std::floor(bounding_box.min().x()) - kPaddingPixel,
+                            std::floor(bounding_box.min().y()) - kPaddingPixel);
+  const Eigen::Vector2i max(std::ceil(bounding_box.max().x()) + kPaddingPixel,
+                            std::ceil(bounding_box.max().y()) + kPaddingPixel);
+  return PaintSubmapSlicesInBox(submaps, resolution,
+                                Eigen::AlignedBox2i(min, max), num_threads);
+}
+
+Eigen::AlignedBox2f GetSubmapSliceBoundingBox(const SubmapSlice& submap_slice,
+                                              const double resolution) {
+  Eigen::AlignedBox2f bounding_box;
+  auto surface = MakeUniqueCairoSurfacePtr(
+      cairo_image_surface_create(kCairoFormat, 1, 1));
+  auto cr = MakeUniqueCairoPtr(cairo_create(surface.get()));
+  cairo_scale(cr.get(), 1. / resolution, 1. / resolution);
+  ApplySliceTransform(submap_slice, cr.get());
+  const auto update_bounding_box = [&bounding_box, &cr](double x, double y) {
+    cairo_user_to_device(cr.get(), &x, &y);
+    bounding_box.extend(Eigen::Vector2f(x, y));
+  };
+  update_bounding_box(0, 0);
+  update_bounding_box(submap_slice.width, 0);
+  update_bounding_box(0, submap_slice.height);
+  update_bounding_box(submap_slice.width, submap_slice.height);
+  return bounding_box;
+}
+
+PaintSubmapSlicesResult PaintSubmapSlicesInBox(
+    const std::map<::cartographer::mapping::SubmapId, SubmapSlice>& submaps,
+    const double resolution, const Eigen::AlignedBox2i& pixel_box,
+    const int num_threads) {
+  const Eigen::Vector2i size = pixel_box.sizes();
+  const Eigen::Array2f origin(-pixel_box.min().x(), -pixel_box.min().y());
+
+  std::vector<const SubmapSlice*> submap_slices;
+  std::vector<Eigen::AlignedBox2f> bounding_boxes;
+  for (const auto& pair : submaps) {
+    const SubmapSlice& submap_slice = pair.second;
+    if (submap_slice.surface == nullptr) {
+      continue;
+    }
+    const Eigen::AlignedBox2f bounding_box =
+        GetSubmapSliceBoundingBox(submap_slice, resolution);
+    if (bounding_box.intersects(
+            Eigen::AlignedBox2f(pixel_box.min().cast<float>(),
+                                pixel_box.max().cast<float>()))) {
+      submap_slices.push_back(&submap_slice);
+      bounding_boxes.push_back(bounding_box);
+    }
+  }
 
   auto surface = MakeUniqueCairoSurfacePtr(
       cairo_image_surface_create(kCairoFormat, size.x(), size.y()));
-  {
-    auto cr = MakeUniqueCairoPtr(cairo_create(surface.get()));
-    cairo_set_source_rgba(cr.get(), 0.5, 0.0, 0.0, 1.);
-    cairo_paint(cr.get());
-    cairo_translate(cr.get(), origin.x(), origin.y());
-    CairoPaintSubmapSlices(1. / resolution, submaps, cr.get(),
-                           [&cr](const SubmapSlice& submap_slice) {
-                             cairo_set_source_surface(
-                                 cr.get(), submap_slice.surface.get(), 0., 0.);
-                             cairo_paint(cr.get());
-                           });
-    cairo_surface_flush(surface.get());
+  const int num_bands = std::max(1, std::min(num_threads, size.y()));
+  if (num_bands == 1) {
+    PaintSubmapSlicesIntoSurface(submap_slices, resolution, pixel_box.min(),
+                                 surface.get());
+    return PaintSubmapSlicesResult(std::move(surface), origin);
+  }
+
+  // Each band is a surface of its own sharing the rows of 'surface', so that
+  // the bands can be painted concurrently.
+  cairo_surface_flush(surface.get());
+  unsigned char* const data = cairo_image_surface_get_data(surface.get());
+  const int stride = cairo_image_surface_get_stride(surface.get());
+  const int rows_per_band = (size.y() + num_bands - 1) / num_bands;
+  const auto paint_band = [&](const int band) {
+    const int begin_row = band * rows_per_band;
+    const int end_row = std::min(size.y(), begin_row + rows_per_band);
+    if (begin_row >= end_row) {
+      return;
+    }
+    const Eigen::Vector2i band_min =
+        pixel_box.min() + Eigen::Vector2i(0, begin_row);
+    const Eigen::AlignedBox2f band_box(
+        band_min.cast<float>(),
+        (pixel_box.min() + Eigen::Vector2i(size.x(), end_row)).cast<float>());
+    std::vector<const SubmapSlice*> band_submap_slices;
+    for (size_t i = 0; i < submap_slices.size(); ++i) {
+      if (band_box.intersects(bounding_boxes[i])) {
+        band_submap_slices.push_back(submap_slices[i]);
+      }
+    }
+    auto band_surface =
+        MakeUniqueCairoSurfacePtr(cairo_image_surface_create_for_data(
+            data + begin_row * stride, kCairoFormat, size.x(),
+            end_row - begin_row, stride));
+    PaintSubmapSlicesIntoSurface(band_submap_slices, resolution, band_min,
+                                 band_surface.get());
+  };
+  std::vector<std::thread> threads;
+  for (int band = 1; band < num_bands; ++band) {
+    threads.emplace_back(paint_band, band);
+  }
+  paint_band(0);
+  for (std::thread& thread : threads) {
+    thread.join();
   }
+  cairo_surface_mark_dirty(surface.get());
   return PaintSubmapSlicesResult(std::move(surface), origin);
 }
 
@@ -122,6 +203,11 @@ void FillSubmapSlice(
     const ::cartographer::mapping::proto::Submap& proto,
     SubmapSlice* const submap_slice,
     mapping::ValueConversionTables* conversion_tables) {
+  const int version = GetSubmapVersion(proto);
+  if (submap_slice->surface != nullptr && submap_slice->version == version) {
+    submap_slice->pose = global_submap_pose;
+    return;
+  }
   ::cartographer::mapping::proto::SubmapQuery::Response response;
   ::cartographer::transform::Rigid3d local_pose;
   if (proto.has_submap_3d()) {
@@ -135,6 +221,7 @@ void FillSubmapSlice(
     submap.ToResponseProto(global_submap_pose, &response);
   }
   submap_slice->pose = global_submap_pose;
+  submap_slice->version = version;
 
   auto& texture_proto = response.textures(0);
   const SubmapTexture::Pixels pixels = UnpackTextureData(
@@ -144,6 +231,7 @@ void FillSubmapSlice(
   submap_slice->resolution = texture_proto.resolution();
   submap_slice->slice_pose =
       ::cartographer::transform::ToRigid3(texture_proto.slice_pose());
+  submap_slice->cairo_data.clear();
   submap_slice->surface =
       DrawTexture(pixels.intensity, pixels.alpha, texture_proto.width(),
                   texture_proto.height(), &submap_slice->cairo_data);
@@ -174,6 +262,43 @@ void DeserializeAndFillSubmapSlices(
   }
 }
 
+void FillSubmapSlicesFromIndexedProtoStream(
+    const IndexedProtoStreamReader& reader,
+    std::map<mapping::SubmapId, SubmapSlice>* submap_slices,
+    mapping::ValueConversionTables* conversion_tables) {
+  const auto& entries = reader.index().entry();
+  const auto pose_graph_entry = std::find_if(
+      entries.begin(), entries.end(),
+      [](const proto::ProtoStreamIndex::Entry& entry) {
+        return entry.data_case() == mapping::proto::SerializedData::kPoseGraph;
+      });
+  CHECK(pose_graph_entry != entries.end())
+      << "Serialized stream misses PoseGraph.";
+  mapping::proto::SerializedData proto;
+  CHECK(reader.ReadProto(pose_graph_entry - entries.begin(), &proto));
+  std::map<mapping::SubmapId, transform::Rigid3d> submap_poses;
+  for (const auto& trajectory : proto.pose_graph().trajectory()) {
+    for (const auto& submap : trajectory.submap()) {
+      submap_poses[mapping::SubmapId(trajectory.trajectory_id(),
+                                     submap.submap_index())] =
+          transform::ToRigid3(submap.pose());
+    }
+  }
+  for (int i = 0; i != entries.size(); ++i) {
+    if (entries.Get(i).data_case() != mapping::proto::SerializedData::kSubmap) {
+      continue;
+    }
+    CHECK(reader.ReadProto(i, &proto));
+    if (Has2DGrid(proto.submap()) || Has3DGrids(proto.submap())) {
+      const auto& submap = proto.submap();
+      const mapping::SubmapId id{submap.submap_id().trajectory_id(),
+                                 submap.submap_id().submap_index()};
+      FillSubmapSlice(submap_poses.at(id), submap, &(*submap_slices)[id],
+                      conversion_tables);
+    }
+  }
+}
+
 SubmapTexture::Pixels UnpackTextureData(const std::string& compressed_cells,
                                         const int width, const int height) {
   SubmapTexture::Pixels pixels;
@@ -20,6 +20,7 @@
 #include "Eigen/Geometry"
 #include "cairo/cairo.h"
 #include "cartographer/io/image.h"
+#include "cartographer/io/proto_stream.h"
 #include "cartographer/io/proto_stream_deserializer.h"
 #include "cartographer/mapping/id.h"
 #include "cartographer/mapping/proto/serialization.pb.h"
@@ -75,10 +76,30 @@ struct SubmapTextures {
   std::vector<SubmapTexture> textures;
 };
 
+// Paints all 'submaps' into one surface. With 'num_threads' larger than 1,
+// horizontal bands of the surface are painted on that many threads.
 PaintSubmapSlicesResult PaintSubmapSlices(
     const std::map<::cartographer::mapping::SubmapId, SubmapSlice>& submaps,
-    double resolution);
+    double resolution, int num_threads = 1);
+
+// Returns the pixel bounding box of 'submap_slice' when painted at
+// 'resolution'. Pixel coordinates are those of PaintSubmapSlices() before
+// 'origin' is applied, so boxes of different slices can be combined.
+Eigen::AlignedBox2f GetSubmapSliceBoundingBox(const SubmapSlice& submap_slice,
+                                              double resolution);
+
+// Paints only the pixels of 'submaps' that fall into 'pixel_box', given in the
+// coordinates of GetSubmapSliceBoundingBox(). Slices not overlapping the box
+// are skipped. The resulting surface covers exactly 'pixel_box'. Bands of it
+// are painted on 'num_threads' threads.
+PaintSubmapSlicesResult PaintSubmapSlicesInBox(
+    const std::map<::cartographer::mapping::SubmapId, SubmapSlice>& submaps,
+    double resolution, const Eigen::AlignedBox2i& pixel_box,
+    int num_threads = 1);
 
+// Updates 'submap_slice' from 'proto'. The texture is only drawn again if the
+// version of the submap differs from the one 'submap_slice' was drawn from,
+// otherwise only the pose is updated.
 void FillSubmapSlice(
     const ::cartographer::transform::Rigid3d& global_submap_pose,
     const ::cartographer::mapping::proto::Submap& proto,
@@ -90,6 +111,13 @@ void DeserializeAndFillSubmapSlices(
     std::map<::cartographer::mapping::SubmapId, SubmapSlice>* submap_slices,
     mapping::ValueConversionTables* conversion_tables);
 
+// Like DeserializeAndFillSubmapSlices(), but uses the index to read only the
+// pose graph and the submaps.
+void FillSubmapSlicesFromIndexedProtoStream(
+    const IndexedProtoStreamReader& reader,
+    std::map<::cartographer::mapping::SubmapId, SubmapSlice>* submap_slices,
+    mapping::ValueConversionTables* conversion_tables);
+
 // Unpacks cell data as provided by the backend into 'intensity' and 'alpha'.
 SubmapTexture::Pixels UnpackTextureData(const std::string& compressed_cells,
                                         int width, int height);
@@ -40,14 +40,12 @@ VerticalRangeFilteringPointsProcessor::VerticalRangeFilteringPointsProcessor(
 
 void VerticalRangeFilteringPointsProcessor::Process(
     std::unique_ptr<PointsBatch> batch) {
-  absl::flat_hash_set<int> to_remove;
   for (size_t i = 0; i < batch->points.size(); ++i) {
     const float distance_z = batch->points[i].position.z() - batch->origin.z();
     if (!(min_z_ <= distance_z && distance_z <= max_z_) ) {
-      to_remove.insert(i);
+      MarkPointRemoved(i, batch.get());
     }
   }
-  RemovePoints(to_remove, batch.get());
   next_->Process(std::move(batch));
 }
 
@@ -17,7 +17,9 @@
 #include "cartographer/io/xray_points_processor.h"
 
 #include <cmath>
+#include <cstdlib>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "Eigen/Core"
@@ -119,11 +121,13 @@ XRayPointsProcessor::XRayPointsProcessor(
     const double voxel_size, const double saturation_factor,
     const transform::Rigid3f& transform,
     const std::vector<mapping::Floor>& floors,
-    const DrawTrajectories& draw_trajectories,
+    const DrawTrajectories& draw_trajectories, const TileOptions& tile_options,
     const std::string& output_filename,
     const std::vector<mapping::proto::Trajectory>& trajectories,
     FileWriterFactory file_writer_factory, PointsProcessor* const next)
-    : draw_trajectories_(draw_trajectories),
+    : voxel_size_(voxel_size),
+      draw_trajectories_(draw_trajectories),
+      tile_options_(tile_options),
       trajectories_(trajectories),
       file_writer_factory_(file_writer_factory),
       next_(next),
@@ -132,8 +136,14 @@ XRayPointsProcessor::XRayPointsProcessor(
       transform_(transform),
       saturation_factor_(saturation_factor) {
   for (size_t i = 0; i < (floors_.empty() ? 1 : floors.size()); ++i) {
-    aggregations_.emplace_back(
-        Aggregation{mapping::HybridGridBase<bool>(voxel_size), {}});
+    if (tile_options_.tile_size > 0) {
+      tile_stores_.push_back(absl::make_unique<XRayTileStore>(
+          tile_options_.tile_size, tile_options_.max_buffered_bytes,
+          tile_options_.directory));
+    } else {
+      aggregations_.emplace_back(
+          Aggregation{mapping::HybridGridBase<bool>(voxel_size), {}});
+    }
   }
 }
 
@@ -153,21 +163,51 @@ std::unique_ptr<XRayPointsProcessor> XRayPointsProcessor::FromDictionary(
       dictionary->HasKey("saturation_factor")
           ? dictionary->GetDouble("saturation_factor")
           : 1.;
+  TileOptions tile_options;
+  if (dictionary->HasKey("tile_size")) {
+    tile_options.tile_size = dictionary->GetNonNegativeInt("tile_size");
+    tile_options.max_buffered_bytes =
+        static_cast<size_t>(
+            dictionary->HasKey("max_buffered_tile_megabytes")
+                ? dictionary->GetNonNegativeInt("max_buffered_tile_megabytes")
+                : 1024)
+        << 20;
+    const char* const temporary_directory = std::getenv("TMPDIR");
+    tile_options.directory =
+        dictionary->HasKey("tile_directory")
+            ? dictionary->GetString("tile_directory")
+            : (temporary_directory != nullptr ? temporary_directory : "/tmp");
+    tile_options.num_threads =
+        dictionary->HasKey("num_tile_threads")
+            ? dictionary->GetNonNegativeInt("num_tile_threads")
+            : std::max<int>(1, std::thread::hardware_concurrency());
+  }
   if (separate_floor) {
     CHECK_EQ(trajectories.size(), 1)
         << "Can only detect floors with a single trajectory.";
-    floors = mapping::DetectFloors(trajectories.at(0));
+    floors = mapping::DetectFloors(
+        trajectories.at(0),
+        std::max<int>(1, std::thread::hardware_concurrency()));
   }
 
   return absl::make_unique<XRayPointsProcessor>(
       dictionary->GetDouble("voxel_size"), saturation_factor,
       transform::FromDictionary(dictionary->GetDictionary("transform").get())
           .cast<float>(),
-      floors, draw_trajectories, dictionary->GetString("filename"),
+      floors, draw_trajectories, tile_options,
+      dictionary->GetString("filename"),
       trajectories, file_writer_factory, next);
 }
 
-void XRayPointsProcessor::WriteVoxels(const Aggregation& aggregation,
+Eigen::Array3i XRayPointsProcessor::GetCellIndex(
+    const Eigen::Vector3f& point) const {
+  const Eigen::Array3f index = point.array() / voxel_size_;
+  return Eigen::Array3i(common::RoundToInt(index.x()),
+                        common::RoundToInt(index.y()),
+                        common::RoundToInt(index.z()));
+}
+
+void XRayPointsProcessor::WriteVoxels(const size_t index,
                                       FileWriter* const file_writer) {
   if (bounding_box_.isEmpty()) {
     LOG(WARNING) << "Not writing output: bounding box is empty.";
@@ -187,17 +227,34 @@ void XRayPointsProcessor::WriteVoxels(const Aggregation& aggregation,
   const int xsize = bounding_box_.sizes()[1] + 1;
   const int ysize = bounding_box_.sizes()[2] + 1;
   PixelDataMatrix pixel_data_matrix(xsize, ysize);
-  for (mapping::HybridGridBase<bool>::Iterator it(aggregation.voxels);
-       !it.Done(); it.Next()) {
-    const Eigen::Array3i cell_index = it.GetCellIndex();
-    const Eigen::Array2i pixel = voxel_index_to_pixel(cell_index);
-    PixelData& pixel_data = pixel_data_matrix(pixel.x(), pixel.y());
-    const auto& column_data = aggregation.column_data.at(
-        std::make_pair(cell_index[1], cell_index[2]));
-    pixel_data.mean_r = column_data.sum_r / column_data.count;
-    pixel_data.mean_g = column_data.sum_g / column_data.count;
-    pixel_data.mean_b = column_data.sum_b / column_data.count;
-    ++pixel_data.num_occupied_cells_in_column;
+  if (tile_stores_.empty()) {
+    const Aggregation& aggregation = aggregations_.at(index);
+    for (mapping::HybridGridBase<bool>::Iterator it(aggregation.voxels);
+         !it.Done(); it.Next()) {
+      const Eigen::Array3i cell_index = it.GetCellIndex();
+      const Eigen::Array2i pixel = voxel_index_to_pixel(cell_index);
+      PixelData& pixel_data = pixel_data_matrix(pixel.x(), pixel.y());
+      const auto& column_data = aggregation.column_data.at(
+          std::make_pair(cell_index[1], cell_index[2]));
+      pixel_data.mean_r = column_data.sum_r / column_data.count;
+      pixel_data.mean_g = column_data.sum_g / column_data.count;
+      pixel_data.mean_b = column_data.sum_b / column_data.count;
+      ++pixel_data.num_occupied_cells_in_column;
+    }
+  } else {
+    // Each column maps to its own pixel, so tiles can be written concurrently.
+    tile_stores_.at(index)->ForEachColumn(
+        tile_options_.num_threads,
+        [&voxel_index_to_pixel,
+         &pixel_data_matrix](const XRayTileStore::Column& column) {
+          const Eigen::Array2i pixel =
+              voxel_index_to_pixel(Eigen::Array3i(0, column.y, column.z));
+          PixelData& pixel_data = pixel_data_matrix(pixel.x(), pixel.y());
+          pixel_data.mean_r = column.mean_r;
+          pixel_data.mean_g = column.mean_g;
+          pixel_data.mean_b = column.mean_b;
+          pixel_data.num_occupied_cells_in_column = column.num_occupied_cells;
+        });
   }
 
   Image image = IntoImage(pixel_data_matrix, saturation_factor_);
@@ -205,9 +262,9 @@ void XRayPointsProcessor::WriteVoxels(const Aggregation& aggregation,
     for (size_t i = 0; i < trajectories_.size(); ++i) {
       DrawTrajectory(
           trajectories_[i], GetColor(i),
-          [&voxel_index_to_pixel, &aggregation,
+          [&voxel_index_to_pixel,
            this](const transform::Rigid3d& pose) -> Eigen::Array2i {
-            return voxel_index_to_pixel(aggregation.voxels.GetCellIndex(
+            return voxel_index_to_pixel(GetCellIndex(
                 (transform_ * pose.cast<float>()).translation()));
           },
           image.GetCairoSurface().get());
@@ -218,19 +275,22 @@ void XRayPointsProcessor::WriteVoxels(const Aggregation& aggregation,
   CHECK(file_writer->Close());
 }
 
-void XRayPointsProcessor::Insert(const PointsBatch& batch,
-                                 Aggregation* const aggregation) {
+void XRayPointsProcessor::Insert(const PointsBatch& batch, const size_t index) {
   constexpr FloatColor kDefaultColor = {{0.f, 0.f, 0.f}};
   for (size_t i = 0; i < batch.points.size(); ++i) {
     const sensor::RangefinderPoint camera_point = transform_ * batch.points[i];
-    const Eigen::Array3i cell_index =
-        aggregation->voxels.GetCellIndex(camera_point.position);
-    *aggregation->voxels.mutable_value(cell_index) = true;
+    const Eigen::Array3i cell_index = GetCellIndex(camera_point.position);
     bounding_box_.extend(cell_index.matrix());
-    ColumnData& column_data =
-        aggregation->column_data[std::make_pair(cell_index[1], cell_index[2])];
     const auto& color =
         batch.colors.empty() ? kDefaultColor : batch.colors.at(i);
+    if (!tile_stores_.empty()) {
+      tile_stores_.at(index)->Insert(cell_index, color);
+      continue;
+    }
+    Aggregation* const aggregation = &aggregations_.at(index);
+    *aggregation->voxels.mutable_value(cell_index) = true;
+    ColumnData& column_data =
+        aggregation->column_data[std::make_pair(cell_index[1], cell_index[2])];
     column_data.sum_r += color[0];
     column_data.sum_g += color[1];
     column_data.sum_b += color[2];
@@ -239,15 +299,15 @@ void XRayPointsProcessor::Insert(const PointsBatch& batch,
 }
 
 void XRayPointsProcessor::Process(std::unique_ptr<PointsBatch> batch) {
+  CompactPoints(batch.get());
   if (floors_.empty()) {
-    CHECK_EQ(aggregations_.size(), 1);
-    Insert(*batch, &aggregations_[0]);
+    Insert(*batch, 0);
   } else {
     for (size_t i = 0; i < floors_.size(); ++i) {
       if (!ContainedIn(batch->start_time, floors_[i].timespans)) {
         continue;
       }
-      Insert(*batch, &aggregations_[i]);
+      Insert(*batch, i);
     }
   }
   next_->Process(std::move(batch));
@@ -255,13 +315,11 @@ void XRayPointsProcessor::Process(std::unique_ptr<PointsBatch> batch) {
 
 PointsProcessor::FlushResult XRayPointsProcessor::Flush() {
   if (floors_.empty()) {
-    CHECK_EQ(aggregations_.size(), 1);
-    WriteVoxels(aggregations_[0],
-                file_writer_factory_(output_filename_ + ".png").get());
+    WriteVoxels(0, file_writer_factory_(output_filename_ + ".png").get());
   } else {
     for (size_t i = 0; i < floors_.size(); ++i) {
       WriteVoxels(
-          aggregations_[i],
+          i,
           file_writer_factory_(absl::StrCat(output_filename_, i, ".png"))
               .get());
     }
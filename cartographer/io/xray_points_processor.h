@@ -18,11 +18,14 @@
 #define CARTOGRAPHER_IO_XRAY_POINTS_PROCESSOR_H_
 
 #include <map>
+#include <memory>
+#include <string>
 
 #include "Eigen/Core"
 #include "cartographer/common/lua_parameter_dictionary.h"
 #include "cartographer/io/file_writer.h"
 #include "cartographer/io/points_processor.h"
+#include "cartographer/io/xray_tile_store.h"
 #include "cartographer/mapping/3d/hybrid_grid.h"
 #include "cartographer/mapping/detect_floors.h"
 #include "cartographer/mapping/proto/trajectory.pb.h"
@@ -37,12 +40,23 @@ class XRayPointsProcessor : public PointsProcessor {
   constexpr static const char* kConfigurationFileActionName =
       "write_xray_image";
   enum class DrawTrajectories { kNo, kYes };
+
+  // With a positive 'tile_size', voxels are accumulated in an XRayTileStore
+  // instead of in memory, and the image is rasterized tile by tile on
+  // 'num_threads' threads.
+  struct TileOptions {
+    int tile_size = 0;
+    size_t max_buffered_bytes = 0;
+    std::string directory;
+    int num_threads = 1;
+  };
+
   XRayPointsProcessor(
       double voxel_size, double saturation_factor,
       const transform::Rigid3f& transform,
       const std::vector<mapping::Floor>& floors,
       const DrawTrajectories& draw_trajectories,
-      const std::string& output_filename,
+      const TileOptions& tile_options, const std::string& output_filename,
       const std::vector<mapping::proto::Trajectory>& trajectories,
       FileWriterFactory file_writer_factory, PointsProcessor* next);
 
@@ -71,11 +85,14 @@ class XRayPointsProcessor : public PointsProcessor {
     std::map<std::pair<int, int>, ColumnData> column_data;
   };
 
-  void WriteVoxels(const Aggregation& aggregation,
-                   FileWriter* const file_writer);
-  void Insert(const PointsBatch& batch, Aggregation* aggregation);
+  // Returns the voxel containing 'point', like HybridGridBase::GetCellIndex.
+  Eigen::Array3i GetCellIndex(const Eigen::Vector3f& point) const;
+  void WriteVoxels(size_t index, FileWriter* const file_writer);
+  void Insert(const PointsBatch& batch, size_t index);
 
+  const double voxel_size_;
   const DrawTrajectories draw_trajectories_;
+  const TileOptions tile_options_;
   const std::vector<mapping::proto::Trajectory> trajectories_;
   FileWriterFactory file_writer_factory_;
   PointsProcessor* const next_;
@@ -86,8 +103,10 @@ class XRayPointsProcessor : public PointsProcessor {
   const std::string output_filename_;
   const transform::Rigid3f transform_;
 
-  // Only has one entry if we do not separate into floors.
+  // Only has one entry if we do not separate into floors. Exactly one of these
+  // is used, depending on the 'tile_options_'.
   std::vector<Aggregation> aggregations_;
+  std::vector<std::unique_ptr<XRayTileStore>> tile_stores_;
 
   // Bounding box containing all cells with data in all 'aggregations_'.
   Eigen::AlignedBox3i bounding_box_;
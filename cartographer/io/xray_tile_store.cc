@@ -0,0 +1,207 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/io/xray_tile_store.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace io {
+namespace {
+
+// Rough memory cost of an entry in the hash containers of a tile.
+constexpr size_t kBytesPerVoxel = 16;
+constexpr size_t kBytesPerColumn = 32;
+
+int FloorDivide(const int value, const int divisor) {
+  return value >= 0 ? value / divisor : -((-value - 1) / divisor) - 1;
+}
+
+template <typename T>
+void WriteValue(const T& value, std::ofstream* const stream) {
+  stream->write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool ReadValue(std::ifstream* const stream, T* const value) {
+  return static_cast<bool>(
+      stream->read(reinterpret_cast<char*>(value), sizeof(T)));
+}
+
+}  // namespace
+
+XRayTileStore::XRayTileStore(const int tile_size,
+                             const size_t max_buffered_bytes,
+                             const std::string& directory)
+    : tile_size_(tile_size),
+      max_buffered_bytes_(max_buffered_bytes),
+      directory_(directory + "/xray_tiles_XXXXXX") {
+  CHECK_GT(tile_size_, 0);
+  CHECK(mkdtemp(&directory_[0]) != nullptr)
+      << "Cannot create a directory for X-ray tiles below " << directory;
+}
+
+XRayTileStore::~XRayTileStore() {
+  for (const auto& tile_index : spilled_tiles_) {
+    std::remove(GetTileFilename(tile_index).c_str());
+  }
+  std::remove(directory_.c_str());
+}
+
+void XRayTileStore::Insert(const Eigen::Array3i& cell_index,
+                           const FloatColor& color) {
+  Tile& tile = tiles_[std::make_pair(FloorDivide(cell_index[1], tile_size_),
+                                     FloorDivide(cell_index[2], tile_size_))];
+  const std::array<int32, 3> voxel = {
+      {cell_index[0], cell_index[1], cell_index[2]}};
+  if (tile.voxels.insert(voxel).second) {
+    num_buffered_bytes_ += kBytesPerVoxel;
+  }
+  auto it = tile.columns.find(std::make_pair(cell_index[1], cell_index[2]));
+  if (it == tile.columns.end()) {
+    it = tile.columns
+             .emplace(std::make_pair(cell_index[1], cell_index[2]),
+                      ColumnData())
+             .first;
+    num_buffered_bytes_ += kBytesPerColumn;
+  }
+  it->second.sum_r += color[0];
+  it->second.sum_g += color[1];
+  it->second.sum_b += color[2];
+  ++it->second.count;
+  if (num_buffered_bytes_ > max_buffered_bytes_) {
+    SpillTiles();
+  }
+}
+
+std::string XRayTileStore::GetTileFilename(
+    const std::pair<int, int>& tile_index) const {
+  return absl::StrCat(directory_, "/", tile_index.first, "_",
+                      tile_index.second, ".tile");
+}
+
+// Appends every tile as a chunk of voxels followed by a chunk of columns to
+// its file.
+void XRayTileStore::SpillTiles() {
+  for (const auto& entry : tiles_) {
+    std::ofstream stream(GetTileFilename(entry.first),
+                         std::ios::binary | std::ios::app);
+    const Tile& tile = entry.second;
+    WriteValue<uint64>(tile.voxels.size(), &stream);
+    for (const auto& voxel : tile.voxels) {
+      WriteValue(voxel, &stream);
+    }
+    WriteValue<uint64>(tile.columns.size(), &stream);
+    for (const auto& column : tile.columns) {
+      WriteValue(column.first.first, &stream);
+      WriteValue(column.first.second, &stream);
+      WriteValue(column.second, &stream);
+    }
+    CHECK(stream) << "Failed to write " << GetTileFilename(entry.first);
+    spilled_tiles_.insert(entry.first);
+  }
+  tiles_.clear();
+  num_buffered_bytes_ = 0;
+}
+
+void XRayTileStore::MergeSpilledTile(const std::pair<int, int>& tile_index,
+                                     Tile* const tile) const {
+  std::ifstream stream(GetTileFilename(tile_index), std::ios::binary);
+  CHECK(stream) << "Failed to open " << GetTileFilename(tile_index);
+  uint64 num_voxels;
+  while (ReadValue(&stream, &num_voxels)) {
+    for (uint64 i = 0; i != num_voxels; ++i) {
+      std::array<int32, 3> voxel;
+      CHECK(ReadValue(&stream, &voxel));
+      tile->voxels.insert(voxel);
+    }
+    uint64 num_columns;
+    CHECK(ReadValue(&stream, &num_columns));
+    for (uint64 i = 0; i != num_columns; ++i) {
+      std::pair<int32, int32> key;
+      ColumnData data;
+      CHECK(ReadValue(&stream, &key.first));
+      CHECK(ReadValue(&stream, &key.second));
+      CHECK(ReadValue(&stream, &data));
+      tile->columns[key].Add(data);
+    }
+  }
+}
+
+void XRayTileStore::ForEachColumn(
+    const int num_threads,
+    const std::function<void(const Column&)>& callback) const {
+  std::vector<std::pair<int, int>> tile_indices(spilled_tiles_.begin(),
+                                                spilled_tiles_.end());
+  for (const auto& entry : tiles_) {
+    if (spilled_tiles_.count(entry.first) == 0) {
+      tile_indices.push_back(entry.first);
+    }
+  }
+
+  std::atomic<size_t> next_tile(0);
+  const auto process_tiles = [this, &tile_indices, &next_tile, &callback]() {
+    for (size_t i = next_tile++; i < tile_indices.size(); i = next_tile++) {
+      const std::pair<int, int>& tile_index = tile_indices[i];
+      Tile merged_tile;
+      const Tile* tile = &merged_tile;
+      const auto it = tiles_.find(tile_index);
+      if (spilled_tiles_.count(tile_index) == 0) {
+        tile = &it->second;
+      } else {
+        MergeSpilledTile(tile_index, &merged_tile);
+        if (it != tiles_.end()) {
+          merged_tile.voxels.insert(it->second.voxels.begin(),
+                                    it->second.voxels.end());
+          for (const auto& column : it->second.columns) {
+            merged_tile.columns[column.first].Add(column.second);
+          }
+        }
+      }
+      absl::flat_hash_map<std::pair<int32, int32>, int> num_occupied_cells;
+      for (const auto& voxel : tile->voxels) {
+        ++num_occupied_cells[std::make_pair(voxel[1], voxel[2])];
+      }
+      for (const auto& column : tile->columns) {
+        const ColumnData& data = column.second;
+        callback(Column{column.first.first, column.first.second,
+                        num_occupied_cells.at(column.first),
+                        data.sum_r / data.count, data.sum_g / data.count,
+                        data.sum_b / data.count});
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 1; i < num_threads; ++i) {
+    threads.emplace_back(process_tiles);
+  }
+  process_tiles();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace io
+}  // namespace cartographer
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_IO_XRAY_TILE_STORE_H_
+#define CARTOGRAPHER_IO_XRAY_TILE_STORE_H_
+
+#include <array>
+#include <functional>
+#include <string>
+#include <utility>
+
+#include "Eigen/Core"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "cartographer/common/port.h"
+#include "cartographer/io/color.h"
+
+namespace cartographer {
+namespace io {
+
+// Accumulates the occupied voxels and the colors of the columns of an X-ray
+// in tiles of 'tile_size' x 'tile_size' columns. A column is identified by
+// the y and z coordinates of its voxels. Whenever more than
+// 'max_buffered_bytes' are held in memory, all tiles are appended to files in
+// a temporary directory below 'directory' and cleared, which bounds the memory
+// needed for large maps.
+class XRayTileStore {
+ public:
+  struct Column {
+    int y;
+    int z;
+    int num_occupied_cells;
+    float mean_r;
+    float mean_g;
+    float mean_b;
+  };
+
+  XRayTileStore(int tile_size, size_t max_buffered_bytes,
+                const std::string& directory);
+  ~XRayTileStore();
+
+  XRayTileStore(const XRayTileStore&) = delete;
+  XRayTileStore& operator=(const XRayTileStore&) = delete;
+
+  void Insert(const Eigen::Array3i& cell_index, const FloatColor& color);
+
+  // Merges each tile in turn and calls 'callback' once for every column with
+  // data. Tiles are handled by 'num_threads' threads, so 'callback' is called
+  // concurrently, but never twice for the same column.
+  void ForEachColumn(int num_threads,
+                     const std::function<void(const Column&)>& callback) const;
+
+ private:
+  struct ColumnData {
+    float sum_r = 0.f;
+    float sum_g = 0.f;
+    float sum_b = 0.f;
+    uint32 count = 0;
+
+    void Add(const ColumnData& other) {
+      sum_r += other.sum_r;
+      sum_g += other.sum_g;
+      sum_b += other.sum_b;
+      count += other.count;
+    }
+  };
+
+  struct Tile {
+    absl::flat_hash_set<std::array<int32, 3>> voxels;
+    absl::flat_hash_map<std::pair<int32, int32>, ColumnData> columns;
+  };
+
+  std::string GetTileFilename(const std::pair<int, int>& tile_index) const;
+  void SpillTiles();
+  void MergeSpilledTile(const std::pair<int, int>& tile_index,
+                        Tile* tile) const;
+
+  const int tile_size_;
+  const size_t max_buffered_bytes_;
+  std::string directory_;
+  size_t num_buffered_bytes_ = 0;
+  absl::flat_hash_map<std::pair<int, int>, Tile> tiles_;
+  absl::flat_hash_set<std::pair<int, int>> spilled_tiles_;
+};
+
+}  // namespace io
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_IO_XRAY_TILE_STORE_H_
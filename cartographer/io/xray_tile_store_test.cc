@@ -0,0 +1,82 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/io/xray_tile_store.h"
+
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace io {
+namespace {
+
+using ColumnMap = std::map<std::pair<int, int>, XRayTileStore::Column>;
+
+ColumnMap CollectColumns(const XRayTileStore& store, const int num_threads) {
+  ColumnMap columns;
+  std::mutex mutex;
+  store.ForEachColumn(num_threads, [&columns, &mutex](
+                                       const XRayTileStore::Column& column) {
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_TRUE(
+        columns.emplace(std::make_pair(column.y, column.z), column).second);
+  });
+  return columns;
+}
+
+void InsertTestData(XRayTileStore* const store) {
+  for (int x = 0; x != 3; ++x) {
+    for (int y = -20; y != 20; ++y) {
+      for (int z = -5; z != 5; ++z) {
+        // Every voxel is hit twice, and columns with y < 0 only have 2 voxels.
+        if (y < 0 && x == 2) {
+          continue;
+        }
+        store->Insert(Eigen::Array3i(x, y, z), {{1.f, 0.f, 0.f}});
+        store->Insert(Eigen::Array3i(x, y, z), {{0.f, 0.f, 1.f}});
+      }
+    }
+  }
+}
+
+TEST(XRayTileStoreTest, SpillingDoesNotChangeColumns) {
+  XRayTileStore in_memory(8 /* tile_size */, 1 << 30 /* max_buffered_bytes */,
+                          ::testing::TempDir());
+  XRayTileStore spilling(8 /* tile_size */, 256 /* max_buffered_bytes */,
+                         ::testing::TempDir());
+  InsertTestData(&in_memory);
+  InsertTestData(&spilling);
+
+  const ColumnMap expected = CollectColumns(in_memory, 1);
+  const ColumnMap actual = CollectColumns(spilling, 4);
+  ASSERT_EQ(expected.size(), 40 * 10);
+  ASSERT_EQ(actual.size(), expected.size());
+  for (const auto& entry : expected) {
+    const XRayTileStore::Column& column = actual.at(entry.first);
+    EXPECT_EQ(column.num_occupied_cells, entry.first.first < 0 ? 2 : 3);
+    EXPECT_EQ(column.num_occupied_cells, entry.second.num_occupied_cells);
+    EXPECT_NEAR(column.mean_r, 0.5f, 1e-6);
+    EXPECT_NEAR(column.mean_g, 0.f, 1e-6);
+    EXPECT_NEAR(column.mean_b, 0.5f, 1e-6);
+  }
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace cartographer
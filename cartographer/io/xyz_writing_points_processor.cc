@@ -48,6 +48,7 @@ PointsProcessor::FlushResult XyzWriterPointsProcessor::Flush() {
 }
 
 void XyzWriterPointsProcessor::Process(std::unique_ptr<PointsBatch> batch) {
+  CompactPoints(batch.get());
   for (const sensor::RangefinderPoint& point : batch->points) {
     WriteXyzPoint(point.position, file_writer_.get());
   }
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/2d/cell_encoding.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+void AppendVarint(uint32 value, std::string* const out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+bool ReadVarint(const std::string& in, size_t* const position,
+                uint32* const value) {
+  *value = 0;
+  for (int shift = 0; shift < 32; shift += 7) {
+    if (*position >= in.size()) {
+      return false;
+    }
+    const uint8 byte = in[(*position)++];
+    *value |= static_cast<uint32>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint32 ZigZagEncode(const int32 value) {
+  return (static_cast<uint32>(value) << 1) ^ static_cast<uint32>(value >> 31);
+}
+
+int32 ZigZagDecode(const uint32 value) {
+  return static_cast<int32>(value >> 1) ^ -static_cast<int32>(value & 1);
+}
+
+}  // namespace
+
+void EncodeCells(const google::protobuf::RepeatedField<int32>& cells,
+                 const int32 unknown_value, std::string* const encoded) {
+  encoded->clear();
+  int32 previous_value = 0;
+  int i = 0;
+  while (i != cells.size()) {
+    const int unknown_begin = i;
+    while (i != cells.size() && cells.Get(i) == unknown_value) ++i;
+    const int known_begin = i;
+    while (i != cells.size() && cells.Get(i) != unknown_value) ++i;
+    AppendVarint(known_begin - unknown_begin, encoded);
+    AppendVarint(i - known_begin, encoded);
+    for (int j = known_begin; j != i; ++j) {
+      AppendVarint(ZigZagEncode(cells.Get(j) - previous_value), encoded);
+      previous_value = cells.Get(j);
+    }
+  }
+}
+
+bool DecodeCells(const std::string& encoded, const int32 unknown_value,
+                 const int max_num_cells,
+                 google::protobuf::RepeatedField<int32>* const cells) {
+  cells->Clear();
+  int32 previous_value = 0;
+  size_t position = 0;
+  while (position != encoded.size()) {
+    uint32 num_unknown;
+    uint32 num_known;
+    if (!ReadVarint(encoded, &position, &num_unknown) ||
+        !ReadVarint(encoded, &position, &num_known) ||
+        num_unknown + static_cast<uint64>(num_known) >
+            static_cast<uint64>(max_num_cells - cells->size())) {
+      return false;
+    }
+    cells->Resize(cells->size() + num_unknown, unknown_value);
+    for (uint32 j = 0; j != num_known; ++j) {
+      uint32 delta;
+      if (!ReadVarint(encoded, &position, &delta)) {
+        return false;
+      }
+      previous_value += ZigZagDecode(delta);
+      cells->Add(previous_value);
+    }
+  }
+  return true;
+}
+
+}  // namespace mapping
+}  // namespace cartographer
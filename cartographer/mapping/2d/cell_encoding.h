@@ -0,0 +1,46 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_MAPPING_2D_CELL_ENCODING_H_
+#define CARTOGRAPHER_MAPPING_2D_CELL_ENCODING_H_
+
+#include <string>
+
+#include "cartographer/common/port.h"
+#include "google/protobuf/repeated_field.h"
+
+namespace cartographer {
+namespace mapping {
+
+// Encodes grid cells compactly for serialization. The cells are split into
+// alternating runs of unknown and known cells, each stored as its length. The
+// value of a known cell is stored as the zig-zag encoded difference to the
+// previous known cell. All numbers are varints. Grids are mostly unknown and
+// their known values change slowly, so this is much smaller than one varint
+// per cell and compresses better.
+void EncodeCells(const google::protobuf::RepeatedField<int32>& cells,
+                 int32 unknown_value, std::string* encoded);
+
+// Decodes cells written by EncodeCells(). Returns false if 'encoded' is
+// malformed or contains more than 'max_num_cells' cells.
+bool DecodeCells(const std::string& encoded, int32 unknown_value,
+                 int max_num_cells,
+                 google::protobuf::RepeatedField<int32>* cells);
+
+}  // namespace mapping
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_MAPPING_2D_CELL_ENCODING_H_
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/2d/cell_encoding.h"
+
+#include <random>
+
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+constexpr int32 kUnknownValue = 0;
+
+TEST(CellEncodingTest, EncodeAndDecode) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int32> value_distribution(1, 32767);
+  google::protobuf::RepeatedField<int32> cells;
+  for (int i = 0; i != 1000; ++i) {
+    // Runs of known and unknown cells, with the known cells at both ends.
+    cells.Add((i / 100) % 2 == 0 ? value_distribution(rng) : kUnknownValue);
+  }
+  cells.Set(999, value_distribution(rng));
+
+  std::string encoded;
+  EncodeCells(cells, kUnknownValue, &encoded);
+  google::protobuf::RepeatedField<int32> decoded;
+  ASSERT_TRUE(DecodeCells(encoded, kUnknownValue, cells.size(), &decoded));
+  ASSERT_EQ(decoded.size(), cells.size());
+  for (int i = 0; i != cells.size(); ++i) {
+    EXPECT_EQ(decoded.Get(i), cells.Get(i));
+  }
+}
+
+TEST(CellEncodingTest, UnknownCellsAreRunLengthEncoded) {
+  google::protobuf::RepeatedField<int32> cells;
+  cells.Resize(100000, kUnknownValue);
+  std::string encoded;
+  EncodeCells(cells, kUnknownValue, &encoded);
+  EXPECT_LE(encoded.size(), 4u);
+  google::protobuf::RepeatedField<int32> decoded;
+  ASSERT_TRUE(DecodeCells(encoded, kUnknownValue, cells.size(), &decoded));
+  EXPECT_EQ(decoded.size(), cells.size());
+}
+
+TEST(CellEncodingTest, RejectsMalformedData) {
+  google::protobuf::RepeatedField<int32> cells;
+  cells.Resize(10, 5);
+  std::string encoded;
+  EncodeCells(cells, kUnknownValue, &encoded);
+  google::protobuf::RepeatedField<int32> decoded;
+  EXPECT_FALSE(DecodeCells(encoded, kUnknownValue, 9, &decoded));
+  EXPECT_FALSE(DecodeCells(encoded.substr(0, encoded.size() - 1),
+                           kUnknownValue, 10, &decoded));
+}
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
@@ -15,6 +15,12 @@
  */
 #include "cartographer/mapping/2d/grid_2d.h"
 
+#include <algorithm>
+#include <limits>
+
+#include "absl/memory/memory.h"
+#include "cartographer/mapping/2d/cell_encoding.h"
+
 namespace cartographer {
 namespace mapping {
 namespace {
@@ -54,6 +60,10 @@ proto::GridOptions2D CreateGridOptions2D(
       << "Unknown GridOptions2D_GridType kind: " << grid_type_string;
   options.set_grid_type(grid_type);
   options.set_resolution(parameter_dictionary->GetDouble("resolution"));
+  options.set_compact_finished_grid(
+      parameter_dictionary->GetBool("compact_finished_grid"));
+  options.set_encode_serialized_cells(
+      parameter_dictionary->GetBool("encode_serialized_cells"));
   return options;
 }
 
@@ -61,11 +71,11 @@ Grid2D::Grid2D(const MapLimits& limits, float min_correspondence_cost,
                float max_correspondence_cost,
                ValueConversionTables* conversion_tables)
     : limits_(limits),
-      correspondence_cost_cells_(
-          limits_.cell_limits().num_x_cells * limits_.cell_limits().num_y_cells,
-          kUnknownCorrespondenceValue),
+      correspondence_cost_cells_(limits_.cell_limits(),
+                                 kUnknownCorrespondenceValue),
       min_correspondence_cost_(min_correspondence_cost),
       max_correspondence_cost_(max_correspondence_cost),
+      update_generation_cells_(limits_.cell_limits(), 0),
       value_to_correspondence_cost_table_(conversion_tables->GetConversionTable(
           max_correspondence_cost, min_correspondence_cost,
           max_correspondence_cost)) {
@@ -75,9 +85,11 @@ Grid2D::Grid2D(const MapLimits& limits, float min_correspondence_cost,
 Grid2D::Grid2D(const proto::Grid2D& proto,
                ValueConversionTables* conversion_tables)
     : limits_(proto.limits()),
-      correspondence_cost_cells_(),
+      correspondence_cost_cells_(limits_.cell_limits(),
+                                 kUnknownCorrespondenceValue),
       min_correspondence_cost_(MinCorrespondenceCostFromProto(proto)),
       max_correspondence_cost_(MaxCorrespondenceCostFromProto(proto)),
+      update_generation_cells_(limits_.cell_limits(), 0),
       value_to_correspondence_cost_table_(conversion_tables->GetConversionTable(
           max_correspondence_cost_, min_correspondence_cost_,
           max_correspondence_cost_)) {
@@ -88,20 +100,59 @@ Grid2D::Grid2D(const proto::Grid2D& proto,
         Eigen::AlignedBox2i(Eigen::Vector2i(box.min_x(), box.min_y()),
                             Eigen::Vector2i(box.max_x(), box.max_y()));
   }
-  correspondence_cost_cells_.reserve(proto.cells_size());
-  for (const auto& cell : proto.cells()) {
+  encode_cells_ = !proto.encoded_cells().empty();
+  ReadCellsFromProto(proto.cells(), proto.encoded_cells(),
+                     &correspondence_cost_cells_);
+}
+
+void Grid2D::ReadCellsFromProto(
+    const google::protobuf::RepeatedField<int32>& proto_cells,
+    const std::string& encoded_proto_cells,
+    TiledCells2D<uint16>* const cells) const {
+  const int num_x_cells = limits_.cell_limits().num_x_cells;
+  const int max_num_cells = num_x_cells * limits_.cell_limits().num_y_cells;
+  google::protobuf::RepeatedField<int32> decoded_cells;
+  if (!encoded_proto_cells.empty()) {
+    CHECK(DecodeCells(encoded_proto_cells, cells->unknown_value(),
+                      max_num_cells, &decoded_cells))
+        << "Malformed encoded cells.";
+  }
+  const google::protobuf::RepeatedField<int32>& all_cells =
+      encoded_proto_cells.empty() ? proto_cells : decoded_cells;
+  const int num_cells = std::min(all_cells.size(), max_num_cells);
+  for (int i = 0; i != num_cells; ++i) {
+    const auto cell = all_cells.Get(i);
     CHECK_LE(cell, std::numeric_limits<uint16>::max());
-    correspondence_cost_cells_.push_back(cell);
+    if (cell == cells->unknown_value()) continue;
+    *cells->mutable_value(
+        ToFlatIndex(Eigen::Array2i(i % num_x_cells, i / num_x_cells))) = cell;
+  }
+}
+
+void Grid2D::WriteCellsToProto(
+    const std::function<uint16(int)>& cell_value, const uint16 unknown_value,
+    google::protobuf::RepeatedField<int32>* const proto_cells,
+    std::string* const encoded_proto_cells) const {
+  google::protobuf::RepeatedField<int32> cells;
+  const CellLimits& cell_limits = limits_.cell_limits();
+  cells.Reserve(cell_limits.num_x_cells * cell_limits.num_y_cells);
+  for (const Eigen::Array2i& xy_index : XYIndexRangeIterator(cell_limits)) {
+    cells.Add(cell_value(ToFlatIndex(xy_index)));
+  }
+  if (encode_cells_) {
+    EncodeCells(cells, unknown_value, encoded_proto_cells);
+  } else {
+    proto_cells->Swap(&cells);
   }
 }
 
 // Finishes the update sequence.
 void Grid2D::FinishUpdate() {
-  while (!update_indices_.empty()) {
-    DCHECK_GE(correspondence_cost_cells_[update_indices_.back()],
-              kUpdateMarker);
-    correspondence_cost_cells_[update_indices_.back()] -= kUpdateMarker;
-    update_indices_.pop_back();
+  if (++update_generation_ == 0) {
+    // Generation 0 marks cells which were never updated, so after a wrap
+    // around all cells have to be reset.
+    update_generation_cells_.Clear();
+    update_generation_ = 1;
   }
 }
 
@@ -120,17 +171,14 @@ void Grid2D::ComputeCroppedLimits(Eigen::Array2i* const offset,
 }
 
 // Grows the map as necessary to include 'point'. This changes the meaning of
-// these coordinates going forward. This method must be called immediately
-// after 'FinishUpdate', before any calls to 'ApplyLookupTable'.
+// these coordinates going forward.
 void Grid2D::GrowLimits(const Eigen::Vector2f& point) {
-  GrowLimits(point, {mutable_correspondence_cost_cells()},
-             {kUnknownCorrespondenceValue});
+  GrowLimits(point, {});
 }
 
 void Grid2D::GrowLimits(const Eigen::Vector2f& point,
-                        const std::vector<std::vector<uint16>*>& grids,
-                        const std::vector<uint16>& grids_unknown_cell_values) {
-  CHECK(update_indices_.empty());
+                        const std::vector<TiledCells2D<uint16>*>& grids) {
+  CHECK(!is_compact()) << "Compact grids cannot be grown.";
   while (!limits_.Contains(limits_.GetCellIndex(point))) {
     const int x_offset = limits_.cell_limits().num_x_cells / 2;
     const int y_offset = limits_.cell_limits().num_y_cells / 2;
@@ -140,21 +188,11 @@ void Grid2D::GrowLimits(const Eigen::Vector2f& point,
             limits_.resolution() * Eigen::Vector2d(y_offset, x_offset),
         CellLimits(2 * limits_.cell_limits().num_x_cells,
                    2 * limits_.cell_limits().num_y_cells));
-    const int stride = new_limits.cell_limits().num_x_cells;
-    const int offset = x_offset + stride * y_offset;
-    const int new_size = new_limits.cell_limits().num_x_cells *
-                         new_limits.cell_limits().num_y_cells;
-
-    for (size_t grid_index = 0; grid_index < grids.size(); ++grid_index) {
-      std::vector<uint16> new_cells(new_size,
-                                    grids_unknown_cell_values[grid_index]);
-      for (int i = 0; i < limits_.cell_limits().num_y_cells; ++i) {
-        for (int j = 0; j < limits_.cell_limits().num_x_cells; ++j) {
-          new_cells[offset + j + i * stride] =
-              (*grids[grid_index])[j + i * limits_.cell_limits().num_x_cells];
-        }
-      }
-      *grids[grid_index] = new_cells;
+    const Eigen::Array2i offset(x_offset, y_offset);
+    correspondence_cost_cells_.Grow(offset, new_limits.cell_limits());
+    update_generation_cells_.Grow(offset, new_limits.cell_limits());
+    for (TiledCells2D<uint16>* const grid : grids) {
+      grid->Grow(offset, new_limits.cell_limits());
     }
     limits_ = new_limits;
     if (!known_cells_box_.isEmpty()) {
@@ -163,13 +201,61 @@ void Grid2D::GrowLimits(const Eigen::Vector2f& point,
   }
 }
 
+void Grid2D::CompactCorrespondenceCostCells() {
+  if (is_compact()) return;
+  compact_correspondence_cost_cells_ =
+      absl::make_unique<const TiledCells2D<uint8>>(
+          correspondence_cost_cells_.Transform(uint8{0}, ValueToCompactValue));
+  correspondence_cost_cells_.Clear();
+  update_generation_cells_.Clear();
+}
+
+int Grid2D::GetCorrespondenceCostValueRow(const Eigen::Array2i& cell_index,
+                                          const int max_num_values,
+                                          uint16* const values) const {
+  int num_values;
+  if (is_compact()) {
+    const uint8* compact_values;
+    num_values = std::min(max_num_values,
+                          compact_correspondence_cost_cells_->GetTileRow(
+                              cell_index, &compact_values));
+    if (compact_values != nullptr) {
+      std::transform(compact_values, compact_values + num_values, values,
+                     CompactValueToValue);
+      return num_values;
+    }
+  } else {
+    const uint16* cell_values;
+    num_values = std::min(
+        max_num_values,
+        correspondence_cost_cells_.GetTileRow(cell_index, &cell_values));
+    if (cell_values != nullptr) {
+      std::copy(cell_values, cell_values + num_values, values);
+      return num_values;
+    }
+  }
+  std::fill(values, values + num_values, kUnknownCorrespondenceValue);
+  return num_values;
+}
+
+size_t Grid2D::MemoryUsageInBytes() const {
+  size_t result = correspondence_cost_cells_.MemoryUsageInBytes() +
+                  update_generation_cells_.MemoryUsageInBytes();
+  if (is_compact()) {
+    result += compact_correspondence_cost_cells_->MemoryUsageInBytes();
+  }
+  return result;
+}
+
 proto::Grid2D Grid2D::ToProto() const {
   proto::Grid2D result;
   *result.mutable_limits() = mapping::ToProto(limits_);
-  *result.mutable_cells() = {correspondence_cost_cells_.begin(),
-                             correspondence_cost_cells_.end()};
-  CHECK(update_indices().empty()) << "Serializing a grid during an update is "
-                                     "not supported. Finish the update first.";
+  WriteCellsToProto(
+      [this](const int flat_index) {
+        return correspondence_cost_value(flat_index);
+      },
+      kUnknownCorrespondenceValue, result.mutable_cells(),
+      result.mutable_encoded_cells());
   if (!known_cells_box().isEmpty()) {
     auto* const box = result.mutable_known_cells_box();
     box->set_max_x(known_cells_box().max().x());
@@ -17,9 +17,13 @@
 #ifndef CARTOGRAPHER_MAPPING_2D_GRID_2D_H_
 #define CARTOGRAPHER_MAPPING_2D_GRID_2D_H_
 
+#include <functional>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "cartographer/mapping/2d/map_limits.h"
+#include "cartographer/mapping/2d/tiled_cells_2d.h"
 #include "cartographer/mapping/grid_interface.h"
 #include "cartographer/mapping/probability_values.h"
 #include "cartographer/mapping/proto/grid_2d.pb.h"
@@ -46,14 +50,34 @@ class Grid2D : public GridInterface {
   // Returns the limits of this Grid2D.
   const MapLimits& limits() const { return limits_; }
 
-  // Finishes the update sequence.
+  // Finishes the update sequence. Cells updated afterwards belong to the next
+  // update. This only starts a new update generation, it does not touch the
+  // updated cells.
   void FinishUpdate();
 
   // Returns the correspondence cost of the cell with 'cell_index'.
   float GetCorrespondenceCost(const Eigen::Array2i& cell_index) const {
     if (!limits().Contains(cell_index)) return max_correspondence_cost_;
-    return (*value_to_correspondence_cost_table_)
-        [correspondence_cost_cells()[ToFlatIndex(cell_index)]];
+    return (*value_to_correspondence_cost_table_)[correspondence_cost_value(
+        ToFlatIndex(cell_index))];
+  }
+
+  // Like GetCorrespondenceCost(), but if 'kDefaultBounds' is true, reads the
+  // static lookup table of the default bounds, which lets the compiler inline
+  // the lookup into loops over many cells. 'kDefaultBounds' must only be true
+  // if HasDefaultCorrespondenceCostBounds().
+  template <bool kDefaultBounds>
+  float GetCorrespondenceCost(const Eigen::Array2i& cell_index) const {
+    if (!kDefaultBounds) return GetCorrespondenceCost(cell_index);
+    if (!limits().Contains(cell_index)) return kMaxCorrespondenceCost;
+    return ValueToCorrespondenceCost(
+        correspondence_cost_value(ToFlatIndex(cell_index)));
+  }
+
+  // Returns true if the correspondence costs are bounded by
+  // 'kMinCorrespondenceCost' and 'kMaxCorrespondenceCost'.
+  bool HasDefaultCorrespondenceCostBounds() const {
+    return value_to_correspondence_cost_table_ == kValueToCorrespondenceCost;
   }
 
   virtual GridType GetGridType() const = 0;
@@ -67,7 +91,7 @@ class Grid2D : public GridInterface {
   // Returns true if the probability at the specified index is known.
   bool IsKnown(const Eigen::Array2i& cell_index) const {
     return limits_.Contains(cell_index) &&
-           correspondence_cost_cells_[ToFlatIndex(cell_index)] !=
+           correspondence_cost_value(ToFlatIndex(cell_index)) !=
                kUnknownCorrespondenceValue;
   }
 
@@ -77,12 +101,37 @@ class Grid2D : public GridInterface {
                             CellLimits* const limits) const;
 
   // Grows the map as necessary to include 'point'. This changes the meaning of
-  // these coordinates going forward. This method must be called immediately
-  // after 'FinishUpdate', before any calls to 'ApplyLookupTable'.
+  // these coordinates going forward. Only tiles are moved, not cells, so
+  // growing is cheap.
   virtual void GrowLimits(const Eigen::Vector2f& point);
 
+  // Returns a copy of this grid cropped to its known cells. This scans all
+  // cells, so it is only done once by Submap2D::Finish(), which keeps the
+  // cropped grid. Serialization, submap textures and scan matchers of finished
+  // submaps all read that grid.
   virtual std::unique_ptr<Grid2D> ComputeCroppedGrid() const = 0;
 
+  // Requantizes the cells of a finished grid to 8 bits, which halves their
+  // memory. All reads work as before, but with the coarser values. The grid
+  // can no longer be updated or grown. Returns false if the grid type does not
+  // support compact storage.
+  virtual bool Compact() { return false; }
+
+  // Returns true if the cells are stored compact.
+  bool is_compact() const {
+    return compact_correspondence_cost_cells_ != nullptr;
+  }
+
+  // Whether ToProto() encodes the cells, see EncodeCells(). Grids read from
+  // a proto keep the encoding of the proto.
+  bool encode_cells() const { return encode_cells_; }
+  void set_encode_cells(const bool encode_cells) {
+    encode_cells_ = encode_cells;
+  }
+
+  // Returns an estimate of the bytes held by the cells of this grid.
+  virtual size_t MemoryUsageInBytes() const;
+
   virtual proto::Grid2D ToProto() const;
 
   virtual bool DrawToSubmapTexture(
@@ -90,41 +139,98 @@ class Grid2D : public GridInterface {
       transform::Rigid3d local_pose) const = 0;
 
  protected:
+  // Grows the limits together with additional layers of cells, e.g. the
+  // weights of a TSDF.
   void GrowLimits(const Eigen::Vector2f& point,
-                  const std::vector<std::vector<uint16>*>& grids,
-                  const std::vector<uint16>& grids_unknown_cell_values);
+                  const std::vector<TiledCells2D<uint16>*>& grids);
 
-  const std::vector<uint16>& correspondence_cost_cells() const {
+  // Requires that the grid is not compact, see correspondence_cost_value().
+  const TiledCells2D<uint16>& correspondence_cost_cells() const {
+    DCHECK(!is_compact());
     return correspondence_cost_cells_;
   }
-  const std::vector<int>& update_indices() const { return update_indices_; }
+  // Returns the value of the cell at 'flat_index', whether stored compact or
+  // not.
+  uint16 correspondence_cost_value(const int flat_index) const {
+    return is_compact() ? CompactValueToValue(
+                              compact_correspondence_cost_cells_->value(
+                                  flat_index))
+                        : correspondence_cost_cells_.value(flat_index);
+  }
+  // Copies the values of up to 'max_num_values' cells in row 'cell_index.y()'
+  // starting at 'cell_index.x()' to 'values', stopping early at the end of the
+  // row or of the tile. Returns the number of cells copied.
+  int GetCorrespondenceCostValueRow(const Eigen::Array2i& cell_index,
+                                    int max_num_values, uint16* values) const;
+  // Returns true if the cell at 'flat_index' was already updated since the
+  // last FinishUpdate().
+  bool IsUpdated(const int flat_index) const {
+    return update_generation_cells_.value(flat_index) == update_generation_;
+  }
   const Eigen::AlignedBox2i& known_cells_box() const {
     return known_cells_box_;
   }
 
-  std::vector<uint16>* mutable_correspondence_cost_cells() {
+  TiledCells2D<uint16>* mutable_correspondence_cost_cells() {
+    CHECK(!is_compact()) << "Compact grids cannot be updated.";
     return &correspondence_cost_cells_;
   }
 
-  std::vector<int>* mutable_update_indices() { return &update_indices_; }
+  // Marks the cell at 'flat_index' as updated until the next FinishUpdate().
+  // Returns false if it already was.
+  bool MarkUpdated(const int flat_index) {
+    uint16* const generation =
+        update_generation_cells_.mutable_value(flat_index);
+    if (*generation == update_generation_) return false;
+    *generation = update_generation_;
+    return true;
+  }
   Eigen::AlignedBox2i* mutable_known_cells_box() { return &known_cells_box_; }
 
-  // Converts a 'cell_index' into an index into 'cells_'.
+  // Reads row-major 'proto_cells', or 'encoded_proto_cells' if not empty,
+  // into 'cells', which must have the layout of this grid. Only tiles with
+  // known cells are allocated.
+  void ReadCellsFromProto(
+      const google::protobuf::RepeatedField<int32>& proto_cells,
+      const std::string& encoded_proto_cells,
+      TiledCells2D<uint16>* cells) const;
+  // Writes the values returned by 'cell_value' for each flat index in
+  // row-major order to 'proto_cells', or to 'encoded_proto_cells' if
+  // encode_cells().
+  void WriteCellsToProto(
+      const std::function<uint16(int)>& cell_value, uint16 unknown_value,
+      google::protobuf::RepeatedField<int32>* proto_cells,
+      std::string* encoded_proto_cells) const;
+
+  // Moves the correspondence cost cells into compact storage.
+  void CompactCorrespondenceCostCells();
+
+  // Converts a 'cell_index' into a flat index into the cells. Flat indices
+  // are invalidated by GrowLimits().
   int ToFlatIndex(const Eigen::Array2i& cell_index) const {
     CHECK(limits_.Contains(cell_index)) << cell_index;
-    return limits_.cell_limits().num_x_cells * cell_index.y() + cell_index.x();
+    return correspondence_cost_cells_.ToFlatIndex(cell_index);
   }
 
  private:
   MapLimits limits_;
-  std::vector<uint16> correspondence_cost_cells_;
+  TiledCells2D<uint16> correspondence_cost_cells_;
+  // Used instead of 'correspondence_cost_cells_' once compact.
+  std::unique_ptr<const TiledCells2D<uint8>> compact_correspondence_cost_cells_;
   float min_correspondence_cost_;
   float max_correspondence_cost_;
-  std::vector<int> update_indices_;
+  // For each cell the last update generation in which it was updated, so that
+  // each cell is only updated once per update. Using generations instead of a
+  // marker bit in the cells means that FinishUpdate() does not need to revisit
+  // the updated cells. Tiles are only allocated where cells were updated, and
+  // freed once the generation counter wraps around.
+  TiledCells2D<uint16> update_generation_cells_;
+  uint16 update_generation_ = 1;
 
   // Bounding box of known cells to efficiently compute cropping limits.
   Eigen::AlignedBox2i known_cells_box_;
   const std::vector<float>* value_to_correspondence_cost_table_;
+  bool encode_cells_ = false;
 };
 
 }  // namespace mapping
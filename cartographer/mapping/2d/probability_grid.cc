@@ -15,6 +15,7 @@
  */
 #include "cartographer/mapping/2d/probability_grid.h"
 
+#include <algorithm>
 #include <limits>
 
 #include "absl/memory/memory.h"
@@ -40,10 +41,10 @@ ProbabilityGrid::ProbabilityGrid(const proto::Grid2D& proto,
 // 'probability'. Only allowed if the cell was unknown before.
 void ProbabilityGrid::SetProbability(const Eigen::Array2i& cell_index,
                                      const float probability) {
-  uint16& cell =
-      (*mutable_correspondence_cost_cells())[ToFlatIndex(cell_index)];
-  CHECK_EQ(cell, kUnknownProbabilityValue);
-  cell =
+  uint16* const cell =
+      mutable_correspondence_cost_cells()->mutable_value(ToFlatIndex(cell_index));
+  CHECK_EQ(*cell, kUnknownProbabilityValue);
+  *cell =
       CorrespondenceCostToValue(ProbabilityToCorrespondenceCost(probability));
   mutable_known_cells_box()->extend(cell_index.matrix());
 }
@@ -59,17 +60,26 @@ bool ProbabilityGrid::ApplyLookupTable(const Eigen::Array2i& cell_index,
                                        const std::vector<uint16>& table) {
   DCHECK_EQ(table.size(), kUpdateMarker);
   const int flat_index = ToFlatIndex(cell_index);
-  uint16* cell = &(*mutable_correspondence_cost_cells())[flat_index];
-  if (*cell >= kUpdateMarker) {
+  if (!MarkUpdated(flat_index)) {
     return false;
   }
-  mutable_update_indices()->push_back(flat_index);
-  *cell = table[*cell];
-  DCHECK_GE(*cell, kUpdateMarker);
+  uint16* cell = mutable_correspondence_cost_cells()->mutable_value(flat_index);
+  // The tables set the update marker, which this grid does not keep in its
+  // cells.
+  DCHECK_GE(table[*cell], kUpdateMarker);
+  *cell = table[*cell] - kUpdateMarker;
   mutable_known_cells_box()->extend(cell_index.matrix());
   return true;
 }
 
+void ProbabilityGrid::ApplyLookupTable(
+    const std::vector<Eigen::Array2i>& cell_indices,
+    const std::vector<uint16>& table) {
+  for (const Eigen::Array2i& cell_index : cell_indices) {
+    ApplyLookupTable(cell_index, table);
+  }
+}
+
 GridType ProbabilityGrid::GetGridType() const {
   return GridType::PROBABILITY_GRID;
 }
@@ -78,7 +88,37 @@ GridType ProbabilityGrid::GetGridType() const {
 float ProbabilityGrid::GetProbability(const Eigen::Array2i& cell_index) const {
   if (!limits().Contains(cell_index)) return kMinProbability;
   return CorrespondenceCostToProbability(ValueToCorrespondenceCost(
-      correspondence_cost_cells()[ToFlatIndex(cell_index)]));
+      correspondence_cost_value(ToFlatIndex(cell_index))));
+}
+
+void ProbabilityGrid::GetCorrespondenceCostValues(const Eigen::Array2i& offset,
+                                                  const CellLimits& window,
+                                                  uint16* values) const {
+  constexpr uint16 kMaxCorrespondenceCostValue = kUpdateMarker - 1;
+  const CellLimits& cell_limits = limits().cell_limits();
+  const int begin_x = std::max(0, offset.x());
+  const int end_x =
+      std::min(cell_limits.num_x_cells, offset.x() + window.num_x_cells);
+  for (int y = 0; y != window.num_y_cells; ++y) {
+    uint16* const row = values + y * window.num_x_cells;
+    std::fill(row, row + window.num_x_cells, kMaxCorrespondenceCostValue);
+    const int grid_y = offset.y() + y;
+    if (grid_y < 0 || grid_y >= cell_limits.num_y_cells || begin_x >= end_x) {
+      continue;
+    }
+    uint16* const values_begin = row + begin_x - offset.x();
+    uint16* const values_end = row + end_x - offset.x();
+    for (uint16* value = values_begin; value != values_end;) {
+      value += GetCorrespondenceCostValueRow(
+          Eigen::Array2i(offset.x() + (value - row), grid_y),
+          values_end - value, value);
+    }
+    for (uint16* value = values_begin; value != values_end; ++value) {
+      if (*value == kUnknownCorrespondenceValue) {
+        *value = kMaxCorrespondenceCostValue;
+      }
+    }
+  }
 }
 
 proto::Grid2D ProbabilityGrid::ToProto() const {
@@ -106,6 +146,11 @@ std::unique_ptr<Grid2D> ProbabilityGrid::ComputeCroppedGrid() const {
   return std::unique_ptr<Grid2D>(cropped_grid.release());
 }
 
+bool ProbabilityGrid::Compact() {
+  CompactCorrespondenceCostCells();
+  return true;
+}
+
 bool ProbabilityGrid::DrawToSubmapTexture(
     proto::SubmapQuery::Response::SubmapTexture* const texture,
     transform::Rigid3d local_pose) const {
@@ -114,6 +159,7 @@ bool ProbabilityGrid::DrawToSubmapTexture(
   ComputeCroppedLimits(&offset, &cell_limits);
 
   std::string cells;
+  cells.reserve(2 * cell_limits.num_x_cells * cell_limits.num_y_cells);
   for (const Eigen::Array2i& xy_index : XYIndexRangeIterator(cell_limits)) {
     if (!IsKnown(xy_index + offset)) {
       cells.push_back(0 /* unknown log odds value */);
@@ -50,13 +50,27 @@ class ProbabilityGrid : public Grid2D {
   bool ApplyLookupTable(const Eigen::Array2i& cell_index,
                         const std::vector<uint16>& table);
 
+  // Same as above for all cells in 'cell_indices', e.g. the cells of a ray.
+  void ApplyLookupTable(const std::vector<Eigen::Array2i>& cell_indices,
+                        const std::vector<uint16>& table);
+
   GridType GetGridType() const override;
 
   // Returns the probability of the cell with 'cell_index'.
   float GetProbability(const Eigen::Array2i& cell_index) const;
 
+  // Copies the correspondence cost values of the 'window' sized block of cells
+  // starting at 'offset' into 'values' in row-major order. Unknown cells and
+  // cells outside of the grid are written as the value of
+  // 'kMaxCorrespondenceCost', i.e. they convert to the same probability which
+  // GetProbability() returns for them.
+  void GetCorrespondenceCostValues(const Eigen::Array2i& offset,
+                                   const CellLimits& window,
+                                   uint16* values) const;
+
   proto::Grid2D ToProto() const override;
   std::unique_ptr<Grid2D> ComputeCroppedGrid() const override;
+  bool Compact() override;
   bool DrawToSubmapTexture(
       proto::SubmapQuery::Response::SubmapTexture* const texture,
       transform::Rigid3d local_pose) const override;
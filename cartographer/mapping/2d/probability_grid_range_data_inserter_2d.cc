@@ -75,23 +75,19 @@ void CastRays(const sensor::RangeData& range_data,
     return;
   }
 
-  // Now add the misses.
+  // Now add the misses. The same buffer is used for all rays.
+  std::vector<Eigen::Array2i> ray;
   for (const Eigen::Array2i& end : ends) {
-    std::vector<Eigen::Array2i> ray =
-        RayToPixelMask(begin, end, kSubpixelScale);
-    for (const Eigen::Array2i& cell_index : ray) {
-      probability_grid->ApplyLookupTable(cell_index, miss_table);
-    }
+    RayToPixelMask(begin, end, kSubpixelScale, &ray);
+    probability_grid->ApplyLookupTable(ray, miss_table);
   }
 
   // Finally, compute and add empty rays based on misses in the range data.
   for (const sensor::RangefinderPoint& missing_echo : range_data.misses) {
-    std::vector<Eigen::Array2i> ray = RayToPixelMask(
+    RayToPixelMask(
         begin, superscaled_limits.GetCellIndex(missing_echo.position.head<2>()),
-        kSubpixelScale);
-    for (const Eigen::Array2i& cell_index : ray) {
-      probability_grid->ApplyLookupTable(cell_index, miss_table);
-    }
+        kSubpixelScale, &ray);
+    probability_grid->ApplyLookupTable(ray, miss_table);
   }
 }
 }  // namespace
@@ -72,6 +72,35 @@ TEST(ProbabilityGridTest, ToProto) {
   // {min, max}_{x, y}_ gracefully.
 }
 
+TEST(ProbabilityGridTest, EncodedCellsToProto) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> value_distribution(kMinProbability,
+                                                           kMaxProbability);
+  ValueConversionTables conversion_tables;
+  ProbabilityGrid probability_grid(
+      MapLimits(0.05, Eigen::Vector2d(1., 1.), CellLimits(40, 40)),
+      &conversion_tables);
+  for (const Array2i& xy_index :
+       XYIndexRangeIterator(Array2i(10, 10), Array2i(29, 29))) {
+    probability_grid.SetProbability(xy_index, value_distribution(rng));
+  }
+  probability_grid.set_encode_cells(true);
+
+  const proto::Grid2D proto = probability_grid.ToProto();
+  EXPECT_EQ(proto.cells_size(), 0);
+  EXPECT_FALSE(proto.encoded_cells().empty());
+  ProbabilityGrid grid_from_proto(proto, &conversion_tables);
+  EXPECT_TRUE(grid_from_proto.encode_cells());
+  const CellLimits& cell_limits = probability_grid.limits().cell_limits();
+  for (const Array2i& xy_index : XYIndexRangeIterator(cell_limits)) {
+    ASSERT_EQ(probability_grid.IsKnown(xy_index),
+              grid_from_proto.IsKnown(xy_index));
+    if (!probability_grid.IsKnown(xy_index)) continue;
+    EXPECT_EQ(probability_grid.GetProbability(xy_index),
+              grid_from_proto.GetProbability(xy_index));
+  }
+}
+
 TEST(ProbabilityGridTest, ApplyOdds) {
   ValueConversionTables conversion_tables;
   ProbabilityGrid probability_grid(
@@ -121,6 +150,35 @@ TEST(ProbabilityGridTest, ApplyOdds) {
   EXPECT_GT(probability_grid.GetProbability(Array2i(1, 1)), 0.42);
 }
 
+TEST(ProbabilityGridTest, UpdatesEachCellOncePerUpdate) {
+  ValueConversionTables conversion_tables;
+  ProbabilityGrid probability_grid(
+      MapLimits(1., Eigen::Vector2d(1., 1.), CellLimits(2, 2)),
+      &conversion_tables);
+  const std::vector<uint16> table =
+      ComputeLookupTableToApplyCorrespondenceCostOdds(Odds(0.6));
+  EXPECT_TRUE(probability_grid.ApplyLookupTable(Array2i(0, 0), table));
+  EXPECT_FALSE(probability_grid.ApplyLookupTable(Array2i(0, 0), table));
+
+  // Growing during an update keeps the updated cells.
+  probability_grid.GrowLimits(Vector2f(-10.f, -10.f));
+  const Array2i cell_index =
+      probability_grid.limits().GetCellIndex(Vector2f(0.5f, 0.5f));
+  EXPECT_FALSE(probability_grid.ApplyLookupTable(cell_index, table));
+  EXPECT_NEAR(probability_grid.GetProbability(cell_index), 0.6, 1e-4);
+
+  // Each cell is still updated once per update after the update generations
+  // wrapped around.
+  for (int i = 0; i != 70000; ++i) {
+    probability_grid.FinishUpdate();
+    if (i % 10000 == 0 || i >= 65530) {
+      EXPECT_TRUE(probability_grid.ApplyLookupTable(cell_index, table));
+      EXPECT_FALSE(probability_grid.ApplyLookupTable(cell_index, table));
+    }
+  }
+  EXPECT_GT(probability_grid.GetProbability(cell_index), 0.9);
+}
+
 TEST(ProbabilityGridTest, GetProbability) {
   ValueConversionTables conversion_tables;
   ProbabilityGrid probability_grid(
@@ -148,6 +206,48 @@ TEST(ProbabilityGridTest, GetProbability) {
   }
 }
 
+TEST(ProbabilityGridTest, GetCorrespondenceCostValues) {
+  ValueConversionTables conversion_tables;
+  ProbabilityGrid probability_grid(
+      MapLimits(1., Eigen::Vector2d(1., 1.), CellLimits(2, 2)),
+      &conversion_tables);
+  probability_grid.SetProbability(Array2i(1, 0), 0.7f);
+  probability_grid.SetProbability(Array2i(0, 1), 0.2f);
+
+  // A 4x3 window which overlaps the grid by one column on each side.
+  const CellLimits window(4, 3);
+  std::vector<uint16> values(window.num_x_cells * window.num_y_cells);
+  probability_grid.GetCorrespondenceCostValues(Array2i(-1, -1), window,
+                                               values.data());
+  for (int y = 0; y != window.num_y_cells; ++y) {
+    for (int x = 0; x != window.num_x_cells; ++x) {
+      const Array2i cell_index(x - 1, y - 1);
+      EXPECT_NEAR(
+          probability_grid.GetProbability(cell_index),
+          CorrespondenceCostToProbability(ValueToCorrespondenceCost(
+              values[y * window.num_x_cells + x])),
+          1e-6);
+    }
+  }
+}
+
+TEST(ProbabilityGridTest, GetCorrespondenceCostWithDefaultBounds) {
+  ValueConversionTables conversion_tables;
+  ProbabilityGrid probability_grid(
+      MapLimits(1., Eigen::Vector2d(1., 1.), CellLimits(2, 2)),
+      &conversion_tables);
+  ASSERT_TRUE(probability_grid.HasDefaultCorrespondenceCostBounds());
+  probability_grid.SetProbability(Array2i(1, 0), 0.7f);
+  probability_grid.SetProbability(Array2i(0, 1), 0.2f);
+  for (int y = -1; y != 3; ++y) {
+    for (int x = -1; x != 3; ++x) {
+      const Array2i cell_index(x, y);
+      EXPECT_EQ(probability_grid.GetCorrespondenceCost<true>(cell_index),
+                probability_grid.GetCorrespondenceCost(cell_index));
+    }
+  }
+}
+
 TEST(ProbabilityGridTest, GetCellIndex) {
   ValueConversionTables conversion_tables;
   ProbabilityGrid probability_grid(
@@ -201,6 +301,57 @@ TEST(ProbabilityGridTest, CorrectCropping) {
   EXPECT_EQ(limits.num_y_cells, 200);
 }
 
+TEST(ProbabilityGridTest, Compact) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> value_distribution(kMinProbability,
+                                                           kMaxProbability);
+  ValueConversionTables conversion_tables;
+  ProbabilityGrid probability_grid(
+      MapLimits(0.05, Eigen::Vector2d(1., 1.), CellLimits(40, 40)),
+      &conversion_tables);
+  for (const Array2i& xy_index :
+       XYIndexRangeIterator(Array2i(10, 10), Array2i(29, 29))) {
+    probability_grid.SetProbability(xy_index, value_distribution(rng));
+  }
+  ProbabilityGrid compact_grid(probability_grid.ToProto(), &conversion_tables);
+  EXPECT_FALSE(compact_grid.is_compact());
+  EXPECT_TRUE(compact_grid.Compact());
+  EXPECT_TRUE(compact_grid.is_compact());
+
+  // The quantization error is at most half a step of 0.8 / 254.
+  constexpr float kMaxError = 2e-3f;
+  const proto::Grid2D proto = compact_grid.ToProto();
+  ASSERT_EQ(proto.cells_size(), 40 * 40);
+  ProbabilityGrid grid_from_proto(proto, &conversion_tables);
+  const CellLimits& cell_limits = probability_grid.limits().cell_limits();
+  for (const Array2i& xy_index : XYIndexRangeIterator(cell_limits)) {
+    ASSERT_EQ(probability_grid.IsKnown(xy_index),
+              compact_grid.IsKnown(xy_index));
+    EXPECT_EQ(probability_grid.IsKnown(xy_index),
+              grid_from_proto.IsKnown(xy_index));
+    if (!probability_grid.IsKnown(xy_index)) continue;
+    EXPECT_NEAR(probability_grid.GetProbability(xy_index),
+                compact_grid.GetProbability(xy_index), kMaxError);
+    EXPECT_NEAR(probability_grid.GetCorrespondenceCost(xy_index),
+                compact_grid.GetCorrespondenceCost(xy_index), kMaxError);
+    EXPECT_EQ(compact_grid.GetProbability(xy_index),
+              grid_from_proto.GetProbability(xy_index));
+  }
+
+  Array2i offset(0, 0);
+  const CellLimits window(40, 40);
+  std::vector<uint16> values(window.num_x_cells * window.num_y_cells);
+  std::vector<uint16> compact_values(values.size());
+  probability_grid.GetCorrespondenceCostValues(offset, window, values.data());
+  compact_grid.GetCorrespondenceCostValues(offset, window,
+                                           compact_values.data());
+  for (size_t i = 0; i != values.size(); ++i) {
+    EXPECT_EQ(values[i] == kUnknownCorrespondenceValue,
+              compact_values[i] == kUnknownCorrespondenceValue);
+    EXPECT_NEAR(values[i], compact_values[i], 65);
+  }
+}
+
 }  // namespace
 }  // namespace mapping
 }  // namespace cartographer
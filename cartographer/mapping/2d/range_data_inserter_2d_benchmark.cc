@@ -0,0 +1,66 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "benchmark/benchmark.h"
+#include "cartographer/mapping/2d/probability_grid.h"
+#include "cartographer/mapping/2d/probability_grid_range_data_inserter_2d.h"
+#include "cartographer/mapping/internal/testing/test_helpers.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+sensor::RangeData CreateRangeData() {
+  const sensor::TimedPointCloudData timed_point_cloud_data =
+      testing::GenerateFakeRangeMeasurements(0. /* travel_distance */,
+                                             1. /* duration */,
+                                             1. /* time_step */)
+          .front();
+  sensor::RangeData range_data{timed_point_cloud_data.origin, {}, {}};
+  for (const sensor::TimedRangefinderPoint& point :
+       timed_point_cloud_data.ranges) {
+    range_data.returns.push_back({point.position});
+  }
+  return range_data;
+}
+
+// Inserts a scan of a half circle of radius 5 m, the argument tells whether
+// free space is inserted.
+void BM_ProbabilityGridRangeDataInserter2DInsert(benchmark::State& state) {
+  const sensor::RangeData range_data = CreateRangeData();
+  proto::ProbabilityGridRangeDataInserterOptions2D options;
+  options.set_insert_free_space(state.range(0) != 0);
+  options.set_hit_probability(0.55);
+  options.set_miss_probability(0.49);
+  const ProbabilityGridRangeDataInserter2D range_data_inserter(options);
+  ValueConversionTables conversion_tables;
+  ProbabilityGrid probability_grid(
+      MapLimits(0.05, Eigen::Vector2d(7.5, 7.5), CellLimits(300, 300)),
+      &conversion_tables);
+  for (auto _ : state) {
+    range_data_inserter.Insert(range_data, &probability_grid);
+    probability_grid.FinishUpdate();
+  }
+  state.SetItemsProcessed(state.iterations() * range_data.returns.size());
+}
+BENCHMARK(BM_ProbabilityGridRangeDataInserter2DInsert)->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
+
+BENCHMARK_MAIN();
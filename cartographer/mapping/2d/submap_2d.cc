@@ -24,6 +24,8 @@
 
 #include "Eigen/Geometry"
 #include "absl/memory/memory.h"
+#include "absl/synchronization/notification.h"
+#include "cartographer/common/task.h"
 #include "cartographer/common/port.h"
 #include "cartographer/mapping/2d/probability_grid_range_data_inserter_2d.h"
 #include "cartographer/mapping/internal/2d/tsdf_range_data_inserter_2d.h"
@@ -32,6 +34,20 @@
 
 namespace cartographer {
 namespace mapping {
+namespace {
+
+std::unique_ptr<Grid2D> CreateGridFromProto(
+    const proto::Grid2D& proto, ValueConversionTables* conversion_tables) {
+  if (proto.has_probability_grid_2d()) {
+    return absl::make_unique<ProbabilityGrid>(proto, conversion_tables);
+  }
+  if (proto.has_tsdf_2d()) {
+    return absl::make_unique<TSDF2D>(proto, conversion_tables);
+  }
+  LOG(FATAL) << "proto::Submap2D has grid with unknown type.";
+}
+
+}  // namespace
 
 proto::SubmapsOptions2D CreateSubmapsOptions2D(
     common::LuaParameterDictionary* const parameter_dictionary) {
@@ -43,6 +59,8 @@ proto::SubmapsOptions2D CreateSubmapsOptions2D(
   *options.mutable_range_data_inserter_options() =
       CreateRangeDataInserterOptions(
           parameter_dictionary->GetDictionary("range_data_inserter").get());
+  options.set_insert_in_parallel(
+      parameter_dictionary->GetBool("insert_in_parallel"));
 
   bool valid_range_data_inserter_grid_combination = false;
   const proto::GridOptions2D_GridType& grid_type =
@@ -80,19 +98,24 @@ Submap2D::Submap2D(const proto::Submap2D& proto,
     : Submap(transform::ToRigid3(proto.local_pose())),
       conversion_tables_(conversion_tables) {
   if (proto.has_grid()) {
-    if (proto.grid().has_probability_grid_2d()) {
-      grid_ =
-          absl::make_unique<ProbabilityGrid>(proto.grid(), conversion_tables_);
-    } else if (proto.grid().has_tsdf_2d()) {
-      grid_ = absl::make_unique<TSDF2D>(proto.grid(), conversion_tables_);
-    } else {
-      LOG(FATAL) << "proto::Submap2D has grid with unknown type.";
-    }
+    grid_ = CreateGridFromProto(proto.grid(), conversion_tables_);
   }
   set_num_range_data(proto.num_range_data());
   set_insertion_finished(proto.finished());
 }
 
+Submap2D::Submap2D(const proto::Submap2D& proto, GridLoader grid_loader,
+                   const bool compact_loaded_grid,
+                   ValueConversionTables* conversion_tables)
+    : Submap(transform::ToRigid3(proto.local_pose())),
+      conversion_tables_(conversion_tables),
+      grid_loader_(std::move(grid_loader)),
+      compact_loaded_grid_(compact_loaded_grid) {
+  CHECK(grid_loader_);
+  set_num_range_data(proto.num_range_data());
+  set_insertion_finished(proto.finished());
+}
+
 proto::Submap Submap2D::ToProto(const bool include_grid_data) const {
   proto::Submap proto;
   auto* const submap_2d = proto.mutable_submap_2d();
@@ -100,8 +123,9 @@ proto::Submap Submap2D::ToProto(const bool include_grid_data) const {
   submap_2d->set_num_range_data(num_range_data());
   submap_2d->set_finished(insertion_finished());
   if (include_grid_data) {
-    CHECK(grid_);
-    *submap_2d->mutable_grid() = grid_->ToProto();
+    const std::shared_ptr<const Grid2D> grid = LoadGrid();
+    CHECK(grid);
+    *submap_2d->mutable_grid() = grid->ToProto();
   }
   return proto;
 }
@@ -112,26 +136,54 @@ void Submap2D::UpdateFromProto(const proto::Submap& proto) {
   set_num_range_data(submap_2d.num_range_data());
   set_insertion_finished(submap_2d.finished());
   if (proto.submap_2d().has_grid()) {
-    if (proto.submap_2d().grid().has_probability_grid_2d()) {
-      grid_ = absl::make_unique<ProbabilityGrid>(proto.submap_2d().grid(),
-                                                 conversion_tables_);
-    } else if (proto.submap_2d().grid().has_tsdf_2d()) {
-      grid_ = absl::make_unique<TSDF2D>(proto.submap_2d().grid(),
-                                        conversion_tables_);
-    } else {
-      LOG(FATAL) << "proto::Submap2D has grid with unknown type.";
-    }
+    grid_ = CreateGridFromProto(proto.submap_2d().grid(), conversion_tables_);
+    grid_loader_ = nullptr;
+    absl::MutexLock locker(&finished_texture_mutex_);
+    finished_texture_.reset();
   }
 }
 
 void Submap2D::ToResponseProto(
     const transform::Rigid3d&,
     proto::SubmapQuery::Response* const response) const {
-  if (!grid_) return;
+  if (!insertion_finished()) {
+    const std::shared_ptr<const Grid2D> grid = LoadGrid();
+    if (!grid) return;
+    response->set_submap_version(num_range_data());
+    grid->DrawToSubmapTexture(response->add_textures(), local_pose());
+    return;
+  }
+  // The grid of a finished submap no longer changes, so its texture is only
+  // generated once.
+  absl::MutexLock locker(&finished_texture_mutex_);
+  if (finished_texture_ == nullptr) {
+    const std::shared_ptr<const Grid2D> grid = LoadGrid();
+    if (!grid) return;
+    auto texture =
+        absl::make_unique<proto::SubmapQuery::Response::SubmapTexture>();
+    grid->DrawToSubmapTexture(texture.get(), local_pose());
+    finished_texture_ = std::move(texture);
+  }
   response->set_submap_version(num_range_data());
-  proto::SubmapQuery::Response::SubmapTexture* const texture =
-      response->add_textures();
-  grid()->DrawToSubmapTexture(texture, local_pose());
+  *response->add_textures() = *finished_texture_;
+}
+
+std::shared_ptr<const Grid2D> Submap2D::LoadGrid() const {
+  if (!grid_loader_) {
+    return grid_;
+  }
+  absl::MutexLock locker(&loaded_grid_mutex_);
+  std::shared_ptr<const Grid2D> grid = loaded_grid_.lock();
+  if (grid == nullptr) {
+    std::unique_ptr<Grid2D> loaded_grid =
+        CreateGridFromProto(grid_loader_(), conversion_tables_);
+    if (compact_loaded_grid_) {
+      loaded_grid->Compact();
+    }
+    grid = std::move(loaded_grid);
+    loaded_grid_ = grid;
+  }
+  return grid;
 }
 
 void Submap2D::InsertRangeData(
@@ -143,15 +195,32 @@ void Submap2D::InsertRangeData(
   set_num_range_data(num_range_data() + 1);
 }
 
-void Submap2D::Finish() {
+void Submap2D::Finish(const bool compact_grid) {
   CHECK(grid_);
   CHECK(!insertion_finished());
   grid_ = grid_->ComputeCroppedGrid();
+  if (compact_grid) {
+    grid_->Compact();
+  }
   set_insertion_finished(true);
 }
 
+void Submap2D::CompactGrid() {
+  CHECK(grid_);
+  CHECK(insertion_finished());
+  grid_->Compact();
+}
+
 ActiveSubmaps2D::ActiveSubmaps2D(const proto::SubmapsOptions2D& options)
-    : options_(options), range_data_inserter_(CreateRangeDataInserter()) {}
+    : options_(options),
+      range_data_inserter_(CreateRangeDataInserter()),
+      // Inserting is on the critical path of local SLAM, so the thread is not
+      // niced like background work.
+      insertion_thread_pool_(
+          options.insert_in_parallel()
+              ? absl::make_unique<common::ThreadPool>(
+                    1, 0 /* nice_increment */, std::vector<int>())
+              : nullptr) {}
 
 std::vector<std::shared_ptr<const Submap2D>> ActiveSubmaps2D::submaps() const {
   return std::vector<std::shared_ptr<const Submap2D>>(submaps_.begin(),
@@ -164,15 +233,37 @@ std::vector<std::shared_ptr<const Submap2D>> ActiveSubmaps2D::InsertRangeData(
       submaps_.back()->num_range_data() == options_.num_range_data()) {
     AddSubmap(range_data.origin.head<2>());
   }
-  for (auto& submap : submaps_) {
-    submap->InsertRangeData(range_data, range_data_inserter_.get());
-  }
-  if (submaps_.front()->num_range_data() == 2 * options_.num_range_data()) {
-    submaps_.front()->Finish();
+  // The submaps have separate grids, and the inserter only reads its options,
+  // so the older submap can be updated on another thread.
+  const auto insert_into_front = [this, &range_data]() {
+    submaps_.front()->InsertRangeData(range_data, range_data_inserter_.get());
+    if (submaps_.front()->num_range_data() == 2 * options_.num_range_data()) {
+      FinishSubmap();
+    }
+  };
+  if (insertion_thread_pool_ != nullptr && submaps_.size() == 2) {
+    absl::Notification front_inserted;
+    auto task = absl::make_unique<common::Task>();
+    task->SetWorkItem([&insert_into_front, &front_inserted]() {
+      insert_into_front();
+      front_inserted.Notify();
+    });
+    insertion_thread_pool_->Schedule(std::move(task));
+    submaps_.back()->InsertRangeData(range_data, range_data_inserter_.get());
+    front_inserted.WaitForNotification();
+  } else {
+    insert_into_front();
+    for (size_t i = 1; i < submaps_.size(); ++i) {
+      submaps_[i]->InsertRangeData(range_data, range_data_inserter_.get());
+    }
   }
   return submaps();
 }
 
+void ActiveSubmaps2D::FinishSubmap() {
+  submaps_.front()->Finish(options_.grid_options_2d().compact_finished_grid());
+}
+
 std::unique_ptr<RangeDataInserterInterface>
 ActiveSubmaps2D::CreateRangeDataInserter() {
   switch (options_.range_data_inserter_options().range_data_inserter_type()) {
@@ -228,11 +319,11 @@ void ActiveSubmaps2D::AddSubmap(const Eigen::Vector2f& origin) {
     CHECK(submaps_.front()->insertion_finished());
     submaps_.erase(submaps_.begin());
   }
-  submaps_.push_back(absl::make_unique<Submap2D>(
-      origin,
-      std::unique_ptr<Grid2D>(
-          static_cast<Grid2D*>(CreateGrid(origin).release())),
-      &conversion_tables_));
+  std::unique_ptr<Grid2D> grid(
+      static_cast<Grid2D*>(CreateGrid(origin).release()));
+  grid->set_encode_cells(options_.grid_options_2d().encode_serialized_cells());
+  submaps_.push_back(absl::make_unique<Submap2D>(origin, std::move(grid),
+                                                 &conversion_tables_));
 }
 
 }  // namespace mapping
@@ -17,11 +17,14 @@
 #ifndef CARTOGRAPHER_MAPPING_2D_SUBMAP_2D_H_
 #define CARTOGRAPHER_MAPPING_2D_SUBMAP_2D_H_
 
+#include <functional>
 #include <memory>
 #include <vector>
 
 #include "Eigen/Core"
+#include "absl/synchronization/mutex.h"
 #include "cartographer/common/lua_parameter_dictionary.h"
+#include "cartographer/common/thread_pool.h"
 #include "cartographer/mapping/2d/grid_2d.h"
 #include "cartographer/mapping/2d/map_limits.h"
 #include "cartographer/mapping/proto/serialization.pb.h"
@@ -42,28 +45,67 @@ proto::SubmapsOptions2D CreateSubmapsOptions2D(
 
 class Submap2D : public Submap {
  public:
+  // Reads the grid of a lazily loaded submap.
+  using GridLoader = std::function<proto::Grid2D()>;
+
   Submap2D(const Eigen::Vector2f& origin, std::unique_ptr<Grid2D> grid,
            ValueConversionTables* conversion_tables);
   explicit Submap2D(const proto::Submap2D& proto,
                     ValueConversionTables* conversion_tables);
+  // Creates a submap from 'proto', ignoring its grid, which is not held in
+  // memory. Instead, LoadGrid() reads it using 'grid_loader' when needed. If
+  // 'compact_loaded_grid' is true, loaded grids are compacted, see
+  // CompactGrid().
+  Submap2D(const proto::Submap2D& proto, GridLoader grid_loader,
+           bool compact_loaded_grid, ValueConversionTables* conversion_tables);
 
   proto::Submap ToProto(bool include_grid_data) const override;
-  void UpdateFromProto(const proto::Submap& proto) override;
+  void UpdateFromProto(const proto::Submap& proto)
+      LOCKS_EXCLUDED(finished_texture_mutex_) override;
 
+  // Once insertion is finished, the texture is only generated for the first
+  // query and copied for later ones. Thread-safe.
   void ToResponseProto(const transform::Rigid3d& global_submap_pose,
-                       proto::SubmapQuery::Response* response) const override;
+                       proto::SubmapQuery::Response* response) const
+      LOCKS_EXCLUDED(finished_texture_mutex_) override;
 
+  // Returns nullptr for lazily loaded submaps, see LoadGrid().
   const Grid2D* grid() const { return grid_.get(); }
 
+  // Returns the grid, which is loaded first if this submap was loaded lazily.
+  // A loaded grid is shared until the last user releases it. Thread-safe.
+  std::shared_ptr<const Grid2D> LoadGrid() const
+      LOCKS_EXCLUDED(loaded_grid_mutex_);
+
   // Insert 'range_data' into this submap using 'range_data_inserter'. The
   // submap must not be finished yet.
   void InsertRangeData(const sensor::RangeData& range_data,
                        const RangeDataInserterInterface* range_data_inserter);
-  void Finish();
+  // Crops the grid and marks insertion as finished. If 'compact_grid' is true,
+  // the grid is compacted before, see CompactGrid(), so that it no longer
+  // changes once the submap is seen as finished.
+  void Finish(bool compact_grid);
+
+  // Moves the grid of this finished submap into compact storage, see
+  // Grid2D::Compact().
+  void CompactGrid();
 
  private:
-  std::unique_ptr<Grid2D> grid_;
+  std::shared_ptr<Grid2D> grid_;
   ValueConversionTables* conversion_tables_;
+
+  // Only set for lazily loaded submaps.
+  GridLoader grid_loader_;
+  bool compact_loaded_grid_ = false;
+  mutable absl::Mutex loaded_grid_mutex_;
+  mutable std::weak_ptr<const Grid2D> loaded_grid_
+      GUARDED_BY(loaded_grid_mutex_);
+
+  // Texture of the finished grid, generated by the first ToResponseProto()
+  // after insertion finished.
+  mutable absl::Mutex finished_texture_mutex_;
+  mutable std::unique_ptr<proto::SubmapQuery::Response::SubmapTexture>
+      finished_texture_ GUARDED_BY(finished_texture_mutex_);
 };
 
 // The first active submap will be created on the insertion of the first range
@@ -92,6 +134,7 @@ class ActiveSubmaps2D {
  private:
   std::unique_ptr<RangeDataInserterInterface> CreateRangeDataInserter();
   std::unique_ptr<GridInterface> CreateGrid(const Eigen::Vector2f& origin);
+  // Finishes the oldest submap.
   void FinishSubmap();
   void AddSubmap(const Eigen::Vector2f& origin);
 
@@ -99,6 +142,9 @@ class ActiveSubmaps2D {
   std::vector<std::shared_ptr<Submap2D>> submaps_;
   std::unique_ptr<RangeDataInserterInterface> range_data_inserter_;
   ValueConversionTables conversion_tables_;
+  // Inserts into the older of two submaps with 'insert_in_parallel', nullptr
+  // otherwise.
+  std::unique_ptr<common::ThreadPool> insertion_thread_pool_;
 };
 
 }  // namespace mapping
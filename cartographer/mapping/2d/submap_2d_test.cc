@@ -16,13 +16,16 @@
 
 #include "cartographer/mapping/2d/submap_2d.h"
 
+#include <cmath>
 #include <map>
 #include <memory>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "cartographer/common/lua_parameter_dictionary.h"
 #include "cartographer/common/lua_parameter_dictionary_test_helpers.h"
+#include "cartographer/common/math.h"
 #include "cartographer/common/port.h"
 #include "cartographer/mapping/2d/probability_grid.h"
 #include "cartographer/transform/transform.h"
@@ -39,9 +42,12 @@ TEST(Submap2DTest, TheRightNumberOfRangeDataAreInserted) {
       "num_range_data = " +
       std::to_string(kNumRangeData) +
       ", "
+      "insert_in_parallel = false, "
       "grid_options_2d = {"
       "grid_type = \"PROBABILITY_GRID\","
       "resolution = 0.05, "
+      "compact_finished_grid = false, "
+      "encode_serialized_cells = false, "
       "},"
       "range_data_inserter = {"
       "range_data_inserter_type = \"PROBABILITY_GRID_INSERTER_2D\","
@@ -95,6 +101,67 @@ TEST(Submap2DTest, TheRightNumberOfRangeDataAreInserted) {
   EXPECT_EQ(1, num_unfinished_submaps);
 }
 
+TEST(Submap2DTest, ParallelInsertionMatchesSequentialInsertion) {
+  constexpr int kNumRangeData = 5;
+  std::vector<std::vector<proto::Grid2D>> grid_protos;
+  for (const bool insert_in_parallel : {false, true}) {
+    auto parameter_dictionary = common::MakeDictionary(
+        "return {"
+        "num_range_data = " +
+        std::to_string(kNumRangeData) +
+        ", "
+        "insert_in_parallel = " +
+        (insert_in_parallel ? "true" : "false") +
+        ", "
+        "grid_options_2d = {"
+        "grid_type = \"PROBABILITY_GRID\","
+        "resolution = 0.05, "
+        "compact_finished_grid = false, "
+        "encode_serialized_cells = false, "
+        "},"
+        "range_data_inserter = {"
+        "range_data_inserter_type = \"PROBABILITY_GRID_INSERTER_2D\","
+        "probability_grid_range_data_inserter = {"
+        "insert_free_space = true, "
+        "hit_probability = 0.53, "
+        "miss_probability = 0.495, "
+        "},"
+        "},"
+        "}");
+    ActiveSubmaps2D submaps{
+        CreateSubmapsOptions2D(parameter_dictionary.get())};
+    std::set<std::shared_ptr<const Submap2D>> all_submaps;
+    for (int i = 0; i != 4 * kNumRangeData; ++i) {
+      sensor::RangeData range_data;
+      range_data.origin = Eigen::Vector3f(0.1f * i, 0.f, 0.f);
+      for (int j = 0; j != 36; ++j) {
+        const float angle = common::DegToRad(10. * j);
+        const float range = 2.f + 0.1f * j;
+        range_data.returns.push_back(
+            {range_data.origin +
+             range * Eigen::Vector3f(std::cos(angle), std::sin(angle), 0.f)});
+      }
+      for (const auto& submap : submaps.InsertRangeData(range_data)) {
+        all_submaps.insert(submap);
+      }
+    }
+    grid_protos.emplace_back();
+    for (const auto& submap : all_submaps) {
+      EXPECT_EQ(submap->insertion_finished(),
+                submap->num_range_data() == 2 * kNumRangeData);
+      grid_protos.back().push_back(submap->grid()->ToProto());
+    }
+  }
+  ASSERT_EQ(grid_protos[0].size(), grid_protos[1].size());
+  std::multiset<std::string> sequential_grids;
+  std::multiset<std::string> parallel_grids;
+  for (size_t i = 0; i != grid_protos[0].size(); ++i) {
+    sequential_grids.insert(grid_protos[0][i].SerializeAsString());
+    parallel_grids.insert(grid_protos[1][i].SerializeAsString());
+  }
+  EXPECT_TRUE(sequential_grids == parallel_grids);
+}
+
 TEST(Submap2DTest, ToFromProto) {
   MapLimits expected_map_limits(1., Eigen::Vector2d(2., 3.),
                                 CellLimits(100, 110));
@@ -107,7 +174,7 @@ TEST(Submap2DTest, ToFromProto) {
       expected.ToProto(true /* include_probability_grid_data */);
   EXPECT_TRUE(proto.has_submap_2d());
   EXPECT_FALSE(proto.has_submap_3d());
-  const auto actual = Submap2D(proto.submap_2d(), &conversion_tables);
+  const Submap2D actual(proto.submap_2d(), &conversion_tables);
   EXPECT_TRUE(expected.local_pose().translation().isApprox(
       actual.local_pose().translation(), 1e-6));
   EXPECT_TRUE(expected.local_pose().rotation().isApprox(
@@ -122,6 +189,73 @@ TEST(Submap2DTest, ToFromProto) {
             actual.grid()->limits().cell_limits().num_x_cells);
 }
 
+TEST(Submap2DTest, LazilyLoadedGridIsSharedUntilReleased) {
+  MapLimits map_limits(1., Eigen::Vector2d(2., 3.), CellLimits(100, 110));
+  ValueConversionTables conversion_tables;
+  Submap2D expected(
+      Eigen::Vector2f(4.f, 5.f),
+      absl::make_unique<ProbabilityGrid>(map_limits, &conversion_tables),
+      &conversion_tables);
+  expected.Finish(false /* compact_grid */);
+  const proto::Submap proto =
+      expected.ToProto(true /* include_probability_grid_data */);
+  int num_loads = 0;
+  const Submap2D actual(
+      proto.submap_2d(),
+      [&proto, &num_loads]() {
+        ++num_loads;
+        return proto.submap_2d().grid();
+      },
+      false /* compact_loaded_grid */, &conversion_tables);
+  EXPECT_EQ(nullptr, actual.grid());
+  EXPECT_TRUE(actual.insertion_finished());
+  EXPECT_EQ(0, num_loads);
+  {
+    const std::shared_ptr<const Grid2D> grid = actual.LoadGrid();
+    EXPECT_EQ(grid, actual.LoadGrid());
+    EXPECT_EQ(1, num_loads);
+    EXPECT_EQ(proto.submap_2d().grid().SerializeAsString(),
+              grid->ToProto().SerializeAsString());
+  }
+  EXPECT_EQ(proto.SerializeAsString(),
+            actual.ToProto(true /* include_probability_grid_data */)
+                .SerializeAsString());
+  EXPECT_EQ(2, num_loads);
+}
+
+TEST(Submap2DTest, TextureOfFinishedSubmapIsGeneratedOnce) {
+  MapLimits map_limits(1., Eigen::Vector2d(2., 3.), CellLimits(100, 110));
+  ValueConversionTables conversion_tables;
+  auto grid =
+      absl::make_unique<ProbabilityGrid>(map_limits, &conversion_tables);
+  grid->SetProbability(Eigen::Array2i(10, 20), 0.7f);
+  grid->SetProbability(Eigen::Array2i(12, 25), 0.2f);
+  Submap2D expected(Eigen::Vector2f(4.f, 5.f), std::move(grid),
+                    &conversion_tables);
+  expected.Finish(false /* compact_grid */);
+  proto::SubmapQuery::Response expected_response;
+  expected.ToResponseProto(transform::Rigid3d::Identity(), &expected_response);
+  ASSERT_EQ(1, expected_response.textures_size());
+
+  const proto::Submap proto =
+      expected.ToProto(true /* include_probability_grid_data */);
+  int num_loads = 0;
+  const Submap2D actual(
+      proto.submap_2d(),
+      [&proto, &num_loads]() {
+        ++num_loads;
+        return proto.submap_2d().grid();
+      },
+      false /* compact_loaded_grid */, &conversion_tables);
+  for (int i = 0; i < 2; ++i) {
+    proto::SubmapQuery::Response response;
+    actual.ToResponseProto(transform::Rigid3d::Identity(), &response);
+    EXPECT_EQ(expected_response.SerializeAsString(),
+              response.SerializeAsString());
+  }
+  EXPECT_EQ(1, num_loads);
+}
+
 }  // namespace
 }  // namespace mapping
 }  // namespace cartographer
@@ -0,0 +1,201 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_MAPPING_2D_TILED_CELLS_2D_H_
+#define CARTOGRAPHER_MAPPING_2D_TILED_CELLS_2D_H_
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "Eigen/Core"
+#include "cartographer/mapping/2d/xy_index.h"
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace mapping {
+
+// The cells of one layer of a 2D grid, stored in square tiles of
+// 'kTileSize' x 'kTileSize' cells. Tiles are allocated on the first write, so
+// unexplored space only costs a pointer per tile and reads as 'unknown_value'.
+//
+// Cells are addressed by flat indices which are only valid until the next
+// call to Grow(). Growing moves the tiles as a whole, so its cost depends on
+// the number of tiles but not on the number of cells.
+template <typename TValueType>
+class TiledCells2D {
+ public:
+  using ValueType = TValueType;
+
+  static constexpr int kTileBits = 5;
+  static constexpr int kTileSize = 1 << kTileBits;
+  static constexpr int kTileCells = kTileSize * kTileSize;
+
+  TiledCells2D(const CellLimits& cell_limits, const ValueType unknown_value)
+      : unknown_value_(unknown_value),
+        cell_limits_(cell_limits),
+        origin_(Eigen::Array2i::Zero()),
+        num_x_tiles_(NumTiles(cell_limits.num_x_cells)),
+        tiles_(num_x_tiles_ * NumTiles(cell_limits.num_y_cells)) {}
+
+  TiledCells2D(TiledCells2D&&) = default;
+  TiledCells2D& operator=(TiledCells2D&&) = default;
+
+  ValueType unknown_value() const { return unknown_value_; }
+  const CellLimits& cell_limits() const { return cell_limits_; }
+
+  // Converts a 'cell_index' inside the cell limits into a flat index.
+  int ToFlatIndex(const Eigen::Array2i& cell_index) const {
+    DCHECK((cell_index >= 0).all() &&
+           cell_index.x() < cell_limits_.num_x_cells &&
+           cell_index.y() < cell_limits_.num_y_cells)
+        << cell_index;
+    const Eigen::Array2i index = cell_index + origin_;
+    const int tile =
+        (index.y() >> kTileBits) * num_x_tiles_ + (index.x() >> kTileBits);
+    return (tile << (2 * kTileBits)) +
+           ((index.y() & (kTileSize - 1)) << kTileBits) +
+           (index.x() & (kTileSize - 1));
+  }
+
+  ValueType value(const int flat_index) const {
+    const ValueType* const tile = tiles_[flat_index >> (2 * kTileBits)].get();
+    return tile == nullptr ? unknown_value_
+                           : tile[flat_index & (kTileCells - 1)];
+  }
+
+  // Returns a pointer to the cell, allocating its tile if needed. The pointer
+  // stays valid across Grow().
+  ValueType* mutable_value(const int flat_index) {
+    std::unique_ptr<ValueType[]>& tile = tiles_[flat_index >> (2 * kTileBits)];
+    if (tile == nullptr) {
+      tile.reset(new ValueType[kTileCells]);
+      std::fill(tile.get(), tile.get() + kTileCells, unknown_value_);
+    }
+    return &tile[flat_index & (kTileCells - 1)];
+  }
+
+  // Returns the number of cells from 'cell_index' to the end of its row in the
+  // current tile, but at most to the end of the row of the cell limits. If the
+  // tile is allocated, '*values' points to these cells, otherwise it is set to
+  // nullptr and all of them are unknown.
+  int GetTileRow(const Eigen::Array2i& cell_index,
+                 const ValueType** const values) const {
+    const int flat_index = ToFlatIndex(cell_index);
+    const ValueType* const tile = tiles_[flat_index >> (2 * kTileBits)].get();
+    *values =
+        tile == nullptr ? nullptr : tile + (flat_index & (kTileCells - 1));
+    return std::min(
+        kTileSize - ((cell_index.x() + origin_.x()) & (kTileSize - 1)),
+        cell_limits_.num_x_cells - cell_index.x());
+  }
+
+  // Enlarges the cell limits to 'cell_limits', such that the cell which had
+  // index 'c' before has index 'c' + 'offset' afterwards. The old cells must
+  // fit into the new limits.
+  void Grow(const Eigen::Array2i& offset, const CellLimits& cell_limits) {
+    CHECK((offset >= 0).all());
+    CHECK_GE(cell_limits.num_x_cells, offset.x() + cell_limits_.num_x_cells);
+    CHECK_GE(cell_limits.num_y_cells, offset.y() + cell_limits_.num_y_cells);
+    // Keep 'origin_' in [0, kTileSize) by moving the old tiles by a whole
+    // number of tiles.
+    const Eigen::Array2i unwrapped_origin = origin_ - offset;
+    const Eigen::Array2i tile_offset =
+        (kTileSize - 1 - unwrapped_origin) / kTileSize;
+    const Eigen::Array2i origin = unwrapped_origin + kTileSize * tile_offset;
+    const int num_x_tiles = NumTiles(origin.x() + cell_limits.num_x_cells);
+    const int num_y_tiles = NumTiles(origin.y() + cell_limits.num_y_cells);
+    std::vector<std::unique_ptr<ValueType[]>> tiles(num_x_tiles * num_y_tiles);
+    for (size_t i = 0; i != tiles_.size(); ++i) {
+      if (tiles_[i] == nullptr) continue;
+      const int x = i % num_x_tiles_ + tile_offset.x();
+      const int y = i / num_x_tiles_ + tile_offset.y();
+      tiles[y * num_x_tiles + x] = std::move(tiles_[i]);
+    }
+    cell_limits_ = cell_limits;
+    origin_ = origin;
+    num_x_tiles_ = num_x_tiles;
+    tiles_ = std::move(tiles);
+  }
+
+  // Frees all tiles. Afterwards all cells are unknown.
+  void Clear() {
+    for (std::unique_ptr<ValueType[]>& tile : tiles_) {
+      tile.reset();
+    }
+  }
+
+  // Returns cells with the same layout, with each value converted by
+  // 'function'. Only allocated tiles are converted.
+  template <typename OtherValueType, typename FunctionType>
+  TiledCells2D<OtherValueType> Transform(const OtherValueType unknown_value,
+                                         FunctionType function) const {
+    TiledCells2D<OtherValueType> result(*this, unknown_value);
+    for (size_t i = 0; i != tiles_.size(); ++i) {
+      if (tiles_[i] == nullptr) continue;
+      result.tiles_[i].reset(new OtherValueType[kTileCells]);
+      std::transform(tiles_[i].get(), tiles_[i].get() + kTileCells,
+                     result.tiles_[i].get(), function);
+    }
+    return result;
+  }
+
+  int num_allocated_tiles() const {
+    return std::count_if(
+        tiles_.begin(), tiles_.end(),
+        [](const std::unique_ptr<ValueType[]>& tile) { return tile != nullptr; });
+  }
+
+  // Returns the number of bytes held by the allocated tiles and the tile
+  // pointers.
+  size_t MemoryUsageInBytes() const {
+    return tiles_.capacity() * sizeof(std::unique_ptr<ValueType[]>) +
+           static_cast<size_t>(num_allocated_tiles()) * kTileCells *
+               sizeof(ValueType);
+  }
+
+ private:
+  template <typename OtherValueType>
+  friend class TiledCells2D;
+
+  // Creates cells with the layout of 'other' and no allocated tiles.
+  template <typename OtherValueType>
+  TiledCells2D(const TiledCells2D<OtherValueType>& other,
+               const ValueType unknown_value)
+      : unknown_value_(unknown_value),
+        cell_limits_(other.cell_limits_),
+        origin_(other.origin_),
+        num_x_tiles_(other.num_x_tiles_),
+        tiles_(other.tiles_.size()) {}
+
+  static int NumTiles(const int num_cells) {
+    return (num_cells + kTileSize - 1) >> kTileBits;
+  }
+
+  ValueType unknown_value_;
+  CellLimits cell_limits_;
+  // Position of the cell with index (0, 0) in the tile with index (0, 0).
+  Eigen::Array2i origin_;
+  int num_x_tiles_;
+  // Row-major, 'num_x_tiles_' wide.
+  std::vector<std::unique_ptr<ValueType[]>> tiles_;
+};
+
+}  // namespace mapping
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_MAPPING_2D_TILED_CELLS_2D_H_
@@ -0,0 +1,151 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/2d/tiled_cells_2d.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "cartographer/common/port.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+using Eigen::Array2i;
+
+constexpr uint16 kUnknownValue = 7;
+
+TEST(TiledCells2DTest, UnknownUntilWritten) {
+  TiledCells2D<uint16> cells(CellLimits(100, 50), kUnknownValue);
+  for (const Array2i& xy_index : XYIndexRangeIterator(CellLimits(100, 50))) {
+    EXPECT_EQ(cells.value(cells.ToFlatIndex(xy_index)), kUnknownValue);
+  }
+  EXPECT_EQ(cells.num_allocated_tiles(), 0);
+
+  *cells.mutable_value(cells.ToFlatIndex(Array2i(99, 49))) = 42;
+  EXPECT_EQ(cells.num_allocated_tiles(), 1);
+  EXPECT_EQ(cells.value(cells.ToFlatIndex(Array2i(99, 49))), 42);
+  EXPECT_EQ(cells.value(cells.ToFlatIndex(Array2i(98, 49))), kUnknownValue);
+}
+
+TEST(TiledCells2DTest, FlatIndicesAreUnique) {
+  const CellLimits cell_limits(70, 45);
+  TiledCells2D<uint16> cells(cell_limits, kUnknownValue);
+  std::vector<int> flat_indices;
+  for (const Array2i& xy_index : XYIndexRangeIterator(cell_limits)) {
+    flat_indices.push_back(cells.ToFlatIndex(xy_index));
+  }
+  std::sort(flat_indices.begin(), flat_indices.end());
+  EXPECT_TRUE(std::adjacent_find(flat_indices.begin(), flat_indices.end()) ==
+              flat_indices.end());
+}
+
+TEST(TiledCells2DTest, GrowKeepsValues) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> value_distribution(0, 1000);
+  CellLimits cell_limits(37, 21);
+  TiledCells2D<uint16> cells(cell_limits, kUnknownValue);
+  std::vector<uint16> expected_values;
+  for (const Array2i& xy_index : XYIndexRangeIterator(cell_limits)) {
+    expected_values.push_back(value_distribution(rng));
+    *cells.mutable_value(cells.ToFlatIndex(xy_index)) = expected_values.back();
+  }
+  const uint16* const pointer = cells.mutable_value(0);
+
+  // Grow like Grid2D::GrowLimits() does, which moves the old cells by half of
+  // their size.
+  Array2i total_offset = Array2i::Zero();
+  for (int i = 0; i != 4; ++i) {
+    const Array2i offset(cell_limits.num_x_cells / 2,
+                         cell_limits.num_y_cells / 2);
+    cell_limits =
+        CellLimits(2 * cell_limits.num_x_cells, 2 * cell_limits.num_y_cells);
+    cells.Grow(offset, cell_limits);
+    total_offset += offset;
+  }
+  EXPECT_EQ(cells.cell_limits().num_x_cells, 37 * 16);
+  EXPECT_EQ(cells.cell_limits().num_y_cells, 21 * 16);
+  EXPECT_EQ(cells.mutable_value(cells.ToFlatIndex(total_offset)), pointer);
+
+  int num_known_cells = 0;
+  for (const Array2i& xy_index : XYIndexRangeIterator(cell_limits)) {
+    const Array2i old_index = xy_index - total_offset;
+    const uint16 value = cells.value(cells.ToFlatIndex(xy_index));
+    if ((old_index >= 0).all() && (old_index < Array2i(37, 21)).all()) {
+      EXPECT_EQ(value, expected_values[old_index.y() * 37 + old_index.x()]);
+      ++num_known_cells;
+    } else {
+      EXPECT_EQ(value, kUnknownValue);
+    }
+  }
+  EXPECT_EQ(num_known_cells, 37 * 21);
+}
+
+TEST(TiledCells2DTest, GetTileRow) {
+  const CellLimits cell_limits(80, 40);
+  TiledCells2D<uint16> cells(cell_limits, kUnknownValue);
+  for (int x = 0; x != cell_limits.num_x_cells; ++x) {
+    *cells.mutable_value(cells.ToFlatIndex(Array2i(x, 35))) = x;
+  }
+  const uint16* values;
+  EXPECT_EQ(cells.GetTileRow(Array2i(0, 0), &values),
+            TiledCells2D<uint16>::kTileSize);
+  EXPECT_EQ(values, nullptr);
+  int x = 3;
+  while (x != cell_limits.num_x_cells) {
+    const int num_values = cells.GetTileRow(Array2i(x, 35), &values);
+    ASSERT_NE(values, nullptr);
+    for (int i = 0; i != num_values; ++i) {
+      EXPECT_EQ(values[i], x + i);
+    }
+    x += num_values;
+  }
+}
+
+TEST(TiledCells2DTest, Transform) {
+  const CellLimits cell_limits(50, 50);
+  TiledCells2D<uint16> cells(cell_limits, kUnknownValue);
+  *cells.mutable_value(cells.ToFlatIndex(Array2i(10, 20))) = 500;
+  const TiledCells2D<uint8> transformed_cells = cells.Transform(
+      uint8{0}, [](const uint16 value) { return static_cast<uint8>(value / 4); });
+  EXPECT_EQ(transformed_cells.num_allocated_tiles(), 1);
+  EXPECT_EQ(transformed_cells.value(cells.ToFlatIndex(Array2i(10, 20))), 125);
+  EXPECT_EQ(transformed_cells.value(cells.ToFlatIndex(Array2i(11, 20))),
+            kUnknownValue / 4);
+  EXPECT_EQ(transformed_cells.value(cells.ToFlatIndex(Array2i(40, 40))), 0);
+}
+
+TEST(TiledCells2DTest, MemoryUsageInBytes) {
+  const CellLimits cell_limits(50, 50);
+  TiledCells2D<uint16> cells(cell_limits, kUnknownValue);
+  const size_t empty_memory_in_bytes = cells.MemoryUsageInBytes();
+  *cells.mutable_value(cells.ToFlatIndex(Array2i(10, 20))) = 500;
+  *cells.mutable_value(cells.ToFlatIndex(Array2i(11, 20))) = 500;
+  EXPECT_EQ(cells.MemoryUsageInBytes(),
+            empty_memory_in_bytes +
+                TiledCells2D<uint16>::kTileCells * sizeof(uint16));
+  *cells.mutable_value(cells.ToFlatIndex(Array2i(40, 40))) = 500;
+  EXPECT_EQ(cells.MemoryUsageInBytes(),
+            empty_memory_in_bytes +
+                2 * TiledCells2D<uint16>::kTileCells * sizeof(uint16));
+}
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
@@ -28,42 +28,37 @@ TSDF2D::TSDF2D(const MapLimits& limits, float truncation_distance,
       conversion_tables_(conversion_tables),
       value_converter_(absl::make_unique<TSDValueConverter>(
           truncation_distance, max_weight, conversion_tables_)),
-      weight_cells_(
-          limits.cell_limits().num_x_cells * limits.cell_limits().num_y_cells,
-          value_converter_->getUnknownWeightValue()) {}
+      weight_cells_(limits.cell_limits(),
+                    value_converter_->getUnknownWeightValue()) {}
 
 TSDF2D::TSDF2D(const proto::Grid2D& proto,
                ValueConversionTables* conversion_tables)
-    : Grid2D(proto, conversion_tables), conversion_tables_(conversion_tables) {
+    : Grid2D(proto, conversion_tables),
+      conversion_tables_(conversion_tables),
+      value_converter_(absl::make_unique<TSDValueConverter>(
+          proto.tsdf_2d().truncation_distance(), proto.tsdf_2d().max_weight(),
+          conversion_tables_)),
+      weight_cells_(limits().cell_limits(),
+                    value_converter_->getUnknownWeightValue()) {
   CHECK(proto.has_tsdf_2d());
-  value_converter_ = absl::make_unique<TSDValueConverter>(
-      proto.tsdf_2d().truncation_distance(), proto.tsdf_2d().max_weight(),
-      conversion_tables_);
-  weight_cells_.reserve(proto.tsdf_2d().weight_cells_size());
-  for (const auto& cell : proto.tsdf_2d().weight_cells()) {
-    CHECK_LE(cell, std::numeric_limits<uint16>::max());
-    weight_cells_.push_back(cell);
-  }
+  ReadCellsFromProto(proto.tsdf_2d().weight_cells(),
+                     proto.tsdf_2d().encoded_weight_cells(), &weight_cells_);
 }
 
 bool TSDF2D::CellIsUpdated(const Eigen::Array2i& cell_index) const {
-  const int flat_index = ToFlatIndex(cell_index);
-  uint16 tsdf_cell = correspondence_cost_cells()[flat_index];
-  return tsdf_cell >= value_converter_->getUpdateMarker();
+  return IsUpdated(ToFlatIndex(cell_index));
 }
 
 void TSDF2D::SetCell(const Eigen::Array2i& cell_index, float tsd,
                      float weight) {
   const int flat_index = ToFlatIndex(cell_index);
-  uint16* tsdf_cell = &(*mutable_correspondence_cost_cells())[flat_index];
-  if (*tsdf_cell >= value_converter_->getUpdateMarker()) {
+  if (!MarkUpdated(flat_index)) {
     return;
   }
-  mutable_update_indices()->push_back(flat_index);
   mutable_known_cells_box()->extend(cell_index.matrix());
-  *tsdf_cell =
-      value_converter_->TSDToValue(tsd) + value_converter_->getUpdateMarker();
-  uint16* weight_cell = &weight_cells_[flat_index];
+  *mutable_correspondence_cost_cells()->mutable_value(flat_index) =
+      value_converter_->TSDToValue(tsd);
+  uint16* weight_cell = weight_cells_.mutable_value(flat_index);
   *weight_cell = value_converter_->WeightToValue(weight);
 }
 
@@ -72,7 +67,7 @@ GridType TSDF2D::GetGridType() const { return GridType::TSDF; }
 float TSDF2D::GetTSD(const Eigen::Array2i& cell_index) const {
   if (limits().Contains(cell_index)) {
     return value_converter_->ValueToTSD(
-        correspondence_cost_cells()[ToFlatIndex(cell_index)]);
+        correspondence_cost_cells().value(ToFlatIndex(cell_index)));
   }
   return value_converter_->getMinTSD();
 }
@@ -80,7 +75,7 @@ float TSDF2D::GetTSD(const Eigen::Array2i& cell_index) const {
 float TSDF2D::GetWeight(const Eigen::Array2i& cell_index) const {
   if (limits().Contains(cell_index)) {
     return value_converter_->ValueToWeight(
-        weight_cells_[ToFlatIndex(cell_index)]);
+        weight_cells_.value(ToFlatIndex(cell_index)));
   }
   return value_converter_->getMinWeight();
 }
@@ -90,25 +85,30 @@ std::pair<float, float> TSDF2D::GetTSDAndWeight(
   if (limits().Contains(cell_index)) {
     int flat_index = ToFlatIndex(cell_index);
     return std::make_pair(
-        value_converter_->ValueToTSD(correspondence_cost_cells()[flat_index]),
-        value_converter_->ValueToWeight(weight_cells_[flat_index]));
+        value_converter_->ValueToTSD(
+            correspondence_cost_cells().value(flat_index)),
+        value_converter_->ValueToWeight(weight_cells_.value(flat_index)));
   }
   return std::make_pair(value_converter_->getMinTSD(),
                         value_converter_->getMinWeight());
 }
 
 void TSDF2D::GrowLimits(const Eigen::Vector2f& point) {
-  Grid2D::GrowLimits(point,
-                     {mutable_correspondence_cost_cells(), &weight_cells_},
-                     {value_converter_->getUnknownTSDValue(),
-                      value_converter_->getUnknownWeightValue()});
+  Grid2D::GrowLimits(point, {&weight_cells_});
+}
+
+size_t TSDF2D::MemoryUsageInBytes() const {
+  return Grid2D::MemoryUsageInBytes() + weight_cells_.MemoryUsageInBytes();
 }
 
 proto::Grid2D TSDF2D::ToProto() const {
   proto::Grid2D result;
   result = Grid2D::ToProto();
-  *result.mutable_tsdf_2d()->mutable_weight_cells() = {weight_cells_.begin(),
-                                                       weight_cells_.end()};
+  WriteCellsToProto(
+      [this](const int flat_index) { return weight_cells_.value(flat_index); },
+      weight_cells_.unknown_value(),
+      result.mutable_tsdf_2d()->mutable_weight_cells(),
+      result.mutable_tsdf_2d()->mutable_encoded_weight_cells());
   result.mutable_tsdf_2d()->set_truncation_distance(
       value_converter_->getMaxTSD());
   result.mutable_tsdf_2d()->set_max_weight(value_converter_->getMaxWeight());
@@ -142,6 +142,7 @@ bool TSDF2D::DrawToSubmapTexture(
   ComputeCroppedLimits(&offset, &cell_limits);
 
   std::string cells;
+  cells.reserve(2 * cell_limits.num_x_cells * cell_limits.num_y_cells);
   for (const Eigen::Array2i& xy_index : XYIndexRangeIterator(cell_limits)) {
     if (!IsKnown(xy_index + offset)) {
       cells.push_back(0);  // value
@@ -22,6 +22,7 @@
 #include "cartographer/common/port.h"
 #include "cartographer/mapping/2d/grid_2d.h"
 #include "cartographer/mapping/2d/map_limits.h"
+#include "cartographer/mapping/2d/tiled_cells_2d.h"
 #include "cartographer/mapping/2d/tsd_value_converter.h"
 #include "cartographer/mapping/2d/xy_index.h"
 namespace cartographer {
@@ -44,6 +45,7 @@ class TSDF2D : public Grid2D {
       const Eigen::Array2i& cell_index) const;
 
   void GrowLimits(const Eigen::Vector2f& point) override;
+  size_t MemoryUsageInBytes() const override;
   proto::Grid2D ToProto() const override;
   std::unique_ptr<Grid2D> ComputeCroppedGrid() const override;
   bool DrawToSubmapTexture(
@@ -54,7 +56,7 @@ class TSDF2D : public Grid2D {
  private:
   ValueConversionTables* conversion_tables_;
   std::unique_ptr<TSDValueConverter> value_converter_;
-  std::vector<uint16> weight_cells_;  // Highest bit is update marker.
+  TiledCells2D<uint16> weight_cells_;
 };
 
 }  // namespace mapping
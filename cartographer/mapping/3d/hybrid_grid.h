@@ -17,9 +17,11 @@
 #ifndef CARTOGRAPHER_MAPPING_3D_HYBRID_GRID_H_
 #define CARTOGRAPHER_MAPPING_3D_HYBRID_GRID_H_
 
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <limits>
+#include <memory>
 #include <utility>
 #include <vector>
 
@@ -63,8 +65,26 @@ bool IsDefaultValue(const std::vector<TElementType>& v) {
   return v.empty();
 }
 
+// Returns the index of the lowest set bit of 'word', which must not be 0.
+inline int CountTrailingZeros(const uint64 word) {
+  DCHECK_NE(word, 0);
+#if defined(__GNUC__)
+  return __builtin_ctzll(word);
+#else
+  int count = 0;
+  while (((word >> count) & 1) == 0) {
+    ++count;
+  }
+  return count;
+#endif
+}
+
 // A flat grid of '2^kBits' x '2^kBits' x '2^kBits' voxels storing values of
 // type 'ValueType' in contiguous memory. Indices in each dimension are 0-based.
+//
+// A bit per voxel records whether it was ever accessed through
+// 'mutable_value()', so that iterating over sparse grids only visits those
+// voxels instead of all of them.
 template <typename TValueType, int kBits>
 class FlatGrid {
  public:
@@ -75,13 +95,17 @@ class FlatGrid {
     for (ValueType& value : cells_) {
       value = ValueType();
     }
+    touched_.fill(0);
   }
 
   FlatGrid(const FlatGrid&) = delete;
   FlatGrid& operator=(const FlatGrid&) = delete;
 
+  // Returns the number of bits of the index in each dimension.
+  static constexpr int grid_bits() { return kBits; }
+
   // Returns the number of voxels per dimension.
-  static int grid_size() { return 1 << kBits; }
+  static constexpr int grid_size() { return 1 << kBits; }
 
   // Returns the value stored at 'index', each dimension of 'index' being
   // between 0 and grid_size() - 1.
@@ -91,223 +115,236 @@ class FlatGrid {
 
   // Returns a pointer to a value to allow changing it.
   ValueType* mutable_value(const Eigen::Array3i& index) {
-    return &cells_[ToFlatIndex(index, kBits)];
+    const int flat_index = ToFlatIndex(index, kBits);
+    touched_[flat_index / 64] |= uint64{1} << (flat_index % 64);
+    return &cells_[flat_index];
+  }
+
+  // Returns the values at 'index' + (i & 1, (i >> 1) & 1, (i >> 2) & 1) in
+  // '(*values)[i]', each dimension of 'index' being between 0 and
+  // grid_size() - 2.
+  void GetOctantValues(const Eigen::Array3i& index,
+                       std::array<ValueType, 8>* const values) const {
+    constexpr int kStrideY = 1 << kBits;
+    constexpr int kStrideZ = 1 << (2 * kBits);
+    DCHECK((index < grid_size() - 1).all()) << index;
+    const ValueType* const cell = &cells_[ToFlatIndex(index, kBits)];
+    (*values)[0] = cell[0];
+    (*values)[1] = cell[1];
+    (*values)[2] = cell[kStrideY];
+    (*values)[3] = cell[kStrideY + 1];
+    (*values)[4] = cell[kStrideZ];
+    (*values)[5] = cell[kStrideZ + 1];
+    (*values)[6] = cell[kStrideZ + kStrideY];
+    (*values)[7] = cell[kStrideZ + kStrideY + 1];
   }
 
   // An iterator for iterating over all values not comparing equal to the
-  // default constructed value.
+  // default constructed value. Only voxels which were accessed through
+  // 'mutable_value()' are looked at.
   class Iterator {
    public:
-    Iterator() : current_(nullptr), end_(nullptr) {}
+    Iterator() : flat_grid_(nullptr), word_index_(kNumWords), word_(0) {}
 
     explicit Iterator(const FlatGrid& flat_grid)
-        : current_(flat_grid.cells_.data()),
-          end_(flat_grid.cells_.data() + flat_grid.cells_.size()) {
-      while (!Done() && IsDefaultValue(*current_)) {
-        ++current_;
-      }
+        : flat_grid_(&flat_grid),
+          word_index_(0),
+          word_(flat_grid.touched_[0]) {
+      AdvanceToNonDefaultValue();
     }
 
     void Next() {
       DCHECK(!Done());
-      do {
-        ++current_;
-      } while (!Done() && IsDefaultValue(*current_));
+      word_ &= word_ - 1;
+      AdvanceToNonDefaultValue();
     }
 
-    bool Done() const { return current_ == end_; }
+    bool Done() const { return word_index_ == kNumWords; }
 
     Eigen::Array3i GetCellIndex() const {
       DCHECK(!Done());
-      const int index = (1 << (3 * kBits)) - (end_ - current_);
-      return To3DIndex(index, kBits);
+      return To3DIndex(flat_index(), kBits);
     }
 
     const ValueType& GetValue() const {
       DCHECK(!Done());
-      return *current_;
+      return flat_grid_->cells_[flat_index()];
     }
 
    private:
-    const ValueType* current_;
-    const ValueType* end_;
-  };
-
- private:
-  std::array<ValueType, 1 << (3 * kBits)> cells_;
-};
-
-// A grid consisting of '2^kBits' x '2^kBits' x '2^kBits' grids of type
-// 'WrappedGrid'. Wrapped grids are constructed on first access via
-// 'mutable_value()'.
-template <typename WrappedGrid, int kBits>
-class NestedGrid {
- public:
-  using ValueType = typename WrappedGrid::ValueType;
-
-  // Returns the number of voxels per dimension.
-  static int grid_size() { return WrappedGrid::grid_size() << kBits; }
-
-  // Returns the value stored at 'index', each dimension of 'index' being
-  // between 0 and grid_size() - 1.
-  ValueType value(const Eigen::Array3i& index) const {
-    const Eigen::Array3i meta_index = GetMetaIndex(index);
-    const WrappedGrid* const meta_cell =
-        meta_cells_[ToFlatIndex(meta_index, kBits)].get();
-    if (meta_cell == nullptr) {
-      return ValueType();
-    }
-    const Eigen::Array3i inner_index =
-        index - meta_index * WrappedGrid::grid_size();
-    return meta_cell->value(inner_index);
-  }
-
-  // Returns a pointer to the value at 'index' to allow changing it. If
-  // necessary a new wrapped grid is constructed to contain that value.
-  ValueType* mutable_value(const Eigen::Array3i& index) {
-    const Eigen::Array3i meta_index = GetMetaIndex(index);
-    std::unique_ptr<WrappedGrid>& meta_cell =
-        meta_cells_[ToFlatIndex(meta_index, kBits)];
-    if (meta_cell == nullptr) {
-      meta_cell = absl::make_unique<WrappedGrid>();
-    }
-    const Eigen::Array3i inner_index =
-        index - meta_index * WrappedGrid::grid_size();
-    return meta_cell->mutable_value(inner_index);
-  }
-
-  // An iterator for iterating over all values not comparing equal to the
-  // default constructed value.
-  class Iterator {
-   public:
-    Iterator() : current_(nullptr), end_(nullptr), nested_iterator_() {}
-
-    explicit Iterator(const NestedGrid& nested_grid)
-        : current_(nested_grid.meta_cells_.data()),
-          end_(nested_grid.meta_cells_.data() + nested_grid.meta_cells_.size()),
-          nested_iterator_() {
-      AdvanceToValidNestedIterator();
-    }
-
-    void Next() {
-      DCHECK(!Done());
-      nested_iterator_.Next();
-      if (!nested_iterator_.Done()) {
-        return;
-      }
-      ++current_;
-      AdvanceToValidNestedIterator();
-    }
-
-    bool Done() const { return current_ == end_; }
-
-    Eigen::Array3i GetCellIndex() const {
-      DCHECK(!Done());
-      const int index = (1 << (3 * kBits)) - (end_ - current_);
-      return To3DIndex(index, kBits) * WrappedGrid::grid_size() +
-             nested_iterator_.GetCellIndex();
-    }
-
-    const ValueType& GetValue() const {
-      DCHECK(!Done());
-      return nested_iterator_.GetValue();
+    int flat_index() const {
+      return word_index_ * 64 + CountTrailingZeros(word_);
     }
 
-   private:
-    void AdvanceToValidNestedIterator() {
-      for (; !Done(); ++current_) {
-        if (*current_ != nullptr) {
-          nested_iterator_ = typename WrappedGrid::Iterator(**current_);
-          if (!nested_iterator_.Done()) {
-            break;
+    // Skips to the lowest set bit of 'word_', or of the following words if
+    // it is 0, whose value is not the default value.
+    void AdvanceToNonDefaultValue() {
+      while (true) {
+        while (word_ == 0) {
+          if (++word_index_ == kNumWords) {
+            return;
           }
+          word_ = flat_grid_->touched_[word_index_];
+        }
+        if (!IsDefaultValue(flat_grid_->cells_[flat_index()])) {
+          return;
         }
+        word_ &= word_ - 1;
       }
     }
 
-    const std::unique_ptr<WrappedGrid>* current_;
-    const std::unique_ptr<WrappedGrid>* end_;
-    typename WrappedGrid::Iterator nested_iterator_;
+    const FlatGrid* flat_grid_;
+    int word_index_;
+    // Bits of the voxels in word 'word_index_' which were not visited yet.
+    uint64 word_;
   };
 
  private:
-  // Returns the Eigen::Array3i (meta) index of the meta cell containing
-  // 'index'.
-  Eigen::Array3i GetMetaIndex(const Eigen::Array3i& index) const {
-    DCHECK((index >= 0).all()) << index;
-    const Eigen::Array3i meta_index = index / WrappedGrid::grid_size();
-    DCHECK((meta_index < (1 << kBits)).all()) << index;
-    return meta_index;
-  }
+  static constexpr int kNumWords = ((1 << (3 * kBits)) + 63) / 64;
 
-  std::array<std::unique_ptr<WrappedGrid>, 1 << (3 * kBits)> meta_cells_;
+  std::array<ValueType, 1 << (3 * kBits)> cells_;
+  // Bit 'i % 64' of word 'i / 64' is set once voxel 'i' was accessed through
+  // 'mutable_value()'.
+  std::array<uint64, kNumWords> touched_;
 };
 
-// A grid consisting of 2x2x2 grids of type 'WrappedGrid' initially. Wrapped
-// grids are constructed on first access via 'mutable_value()'. If necessary,
-// the grid grows to twice the size in each dimension. The range of indices is
-// (almost) symmetric around the origin, i.e. negative indices are allowed.
+// A grid consisting of blocks of type 'WrappedGrid' which are constructed on
+// first access via 'mutable_value()'. Blocks are found through an open
+// addressing hash table, which takes a single probe for most lookups. They are
+// allocated in chunks, so that blocks constructed one after the other, which
+// are usually close to each other, are also close in memory. Blocks never
+// move, so pointers to values stay valid for the lifetime of the grid.
+//
+// The range of indices is symmetric around the origin, i.e. negative indices
+// are allowed.
 template <typename WrappedGrid>
-class DynamicGrid {
+class HashedGrid {
  public:
   using ValueType = typename WrappedGrid::ValueType;
 
-  DynamicGrid() : bits_(1), meta_cells_(8) {}
-  DynamicGrid(DynamicGrid&&) = default;
-  DynamicGrid& operator=(DynamicGrid&&) = default;
+  HashedGrid()
+      : num_slot_bits_(kMinNumSlotBits), slots_(1 << kMinNumSlotBits) {}
+  // A moved-from grid is left empty, as if default constructed, since lookups
+  // require a non-empty slot table.
+  HashedGrid(HashedGrid&& other) : HashedGrid() { Swap(&other); }
+  HashedGrid& operator=(HashedGrid&& other) {
+    HashedGrid(std::move(other)).Swap(this);
+    return *this;
+  }
 
-  // Returns the current number of voxels per dimension.
-  int grid_size() const { return WrappedGrid::grid_size() << bits_; }
+  // Returns the number of voxels per dimension of the smallest cube which is
+  // centered at the origin and contains all blocks.
+  int grid_size() const {
+    return 2 * WrappedGrid::grid_size() * max_block_extent_;
+  }
+
+  // Returns the memory used by the blocks and the hash table.
+  size_t MemoryUsageInBytes() const {
+    size_t memory_usage_in_bytes =
+        slots_.capacity() * sizeof(Slot) +
+        blocks_.capacity() * sizeof(typename decltype(blocks_)::value_type);
+    for (const auto& chunk : chunks_) {
+      memory_usage_in_bytes += chunk.second * sizeof(WrappedGrid);
+    }
+    return memory_usage_in_bytes;
+  }
 
   // Returns the value stored at 'index'.
   ValueType value(const Eigen::Array3i& index) const {
-    const Eigen::Array3i shifted_index = index + (grid_size() >> 1);
-    // The cast to unsigned is for performance to check with 3 comparisons
-    // shifted_index.[xyz] >= 0 and shifted_index.[xyz] < grid_size.
-    if ((shifted_index.cast<unsigned int>() >= grid_size()).any()) {
-      return ValueType();
-    }
-    const Eigen::Array3i meta_index = GetMetaIndex(shifted_index);
-    const WrappedGrid* const meta_cell =
-        meta_cells_[ToFlatIndex(meta_index, bits_)].get();
-    if (meta_cell == nullptr) {
+    const WrappedGrid* const block = FindBlock(GetBlockIndex(index));
+    if (block == nullptr) {
       return ValueType();
     }
-    const Eigen::Array3i inner_index =
-        shifted_index - meta_index * WrappedGrid::grid_size();
-    return meta_cell->value(inner_index);
+    return block->value(GetInnerIndex(index));
   }
 
-  // Returns a pointer to the value at 'index' to allow changing it, dynamically
-  // growing the DynamicGrid and constructing new WrappedGrids as needed.
+  // Returns a pointer to the value at 'index' to allow changing it,
+  // constructing a new block as needed.
   ValueType* mutable_value(const Eigen::Array3i& index) {
-    const Eigen::Array3i shifted_index = index + (grid_size() >> 1);
-    // The cast to unsigned is for performance to check with 3 comparisons
-    // shifted_index.[xyz] >= 0 and shifted_index.[xyz] < grid_size.
-    if ((shifted_index.cast<unsigned int>() >= grid_size()).any()) {
-      Grow();
-      return mutable_value(index);
+    const Eigen::Array3i block_index = GetBlockIndex(index);
+    WrappedGrid* block = FindBlock(block_index);
+    if (block == nullptr) {
+      block = AddBlock(block_index);
+    }
+    return block->mutable_value(GetInnerIndex(index));
+  }
+
+  // Returns the values at 'index' + (i & 1, (i >> 1) & 1, (i >> 2) & 1) in
+  // '(*values)[i]', i.e. the 2x2x2 voxels used for interpolation. If all of
+  // them are in the same block, which is the common case, the block is only
+  // looked up once.
+  void GetOctantValues(const Eigen::Array3i& index,
+                       std::array<ValueType, 8>* const values) const {
+    const Eigen::Array3i inner_index = GetInnerIndex(index);
+    if ((inner_index < WrappedGrid::grid_size() - 1).all()) {
+      const WrappedGrid* const block = FindBlock(GetBlockIndex(index));
+      if (block == nullptr) {
+        values->fill(ValueType());
+      } else {
+        block->GetOctantValues(inner_index, values);
+      }
+      return;
     }
-    const Eigen::Array3i meta_index = GetMetaIndex(shifted_index);
-    std::unique_ptr<WrappedGrid>& meta_cell =
-        meta_cells_[ToFlatIndex(meta_index, bits_)];
-    if (meta_cell == nullptr) {
-      meta_cell = absl::make_unique<WrappedGrid>();
+    for (int i = 0; i != 8; ++i) {
+      (*values)[i] =
+          value(index + Eigen::Array3i(i & 1, (i >> 1) & 1, (i >> 2) & 1));
     }
-    const Eigen::Array3i inner_index =
-        shifted_index - meta_index * WrappedGrid::grid_size();
-    return meta_cell->mutable_value(inner_index);
+  }
+
+  // Rebuilds the grid in its most compact form, meant for grids which are not
+  // changed anymore: blocks holding only default values are dropped, the
+  // others are copied into a single chunk sorted by block index, and the hash
+  // table is shrunk to the smallest size that is at most half full. Pointers to
+  // values are invalidated.
+  void Compact() {
+    std::vector<std::pair<Eigen::Array3i, WrappedGrid*>> blocks;
+    for (const auto& block : blocks_) {
+      if (!typename WrappedGrid::Iterator(*block.second).Done()) {
+        blocks.push_back(block);
+      }
+    }
+    std::sort(blocks.begin(), blocks.end(),
+              [](const std::pair<Eigen::Array3i, WrappedGrid*>& lhs,
+                 const std::pair<Eigen::Array3i, WrappedGrid*>& rhs) {
+                return ToKey(lhs.first) < ToKey(rhs.first);
+              });
+    std::vector<std::pair<std::unique_ptr<WrappedGrid[]>, size_t>> chunks;
+    if (!blocks.empty()) {
+      chunks.emplace_back(absl::make_unique<WrappedGrid[]>(blocks.size()),
+                          blocks.size());
+    }
+    max_block_extent_ = 0;
+    for (size_t i = 0; i != blocks.size(); ++i) {
+      WrappedGrid* const block = chunks.back().first.get() + i;
+      for (typename WrappedGrid::Iterator it(*blocks[i].second); !it.Done();
+           it.Next()) {
+        *block->mutable_value(it.GetCellIndex()) = it.GetValue();
+      }
+      blocks[i].second = block;
+      max_block_extent_ = std::max(
+          max_block_extent_, std::max((-blocks[i].first).maxCoeff(),
+                                      (blocks[i].first + 1).maxCoeff()));
+    }
+    blocks_ = std::move(blocks);
+    chunks_ = std::move(chunks);
+    num_free_blocks_in_chunk_ = 0;
+    int num_slot_bits = kMinNumSlotBits;
+    while ((size_t{1} << num_slot_bits) < 2 * blocks_.size()) {
+      ++num_slot_bits;
+    }
+    // Releases the memory of the old table before rehashing.
+    slots_ = std::vector<Slot>();
+    Rehash(num_slot_bits);
   }
 
   // An iterator for iterating over all values not comparing equal to the
-  // default constructed value.
+  // default constructed value. Blocks are visited in the order in which they
+  // were constructed, or sorted by block index after Compact().
   class Iterator {
    public:
-    explicit Iterator(const DynamicGrid& dynamic_grid)
-        : bits_(dynamic_grid.bits_),
-          current_(dynamic_grid.meta_cells_.data()),
-          end_(dynamic_grid.meta_cells_.data() +
-               dynamic_grid.meta_cells_.size()),
+    explicit Iterator(const HashedGrid& hashed_grid)
+        : current_(hashed_grid.blocks_.data()),
+          end_(hashed_grid.blocks_.data() + hashed_grid.blocks_.size()),
           nested_iterator_() {
       AdvanceToValidNestedIterator();
     }
@@ -326,11 +363,8 @@ class DynamicGrid {
 
     Eigen::Array3i GetCellIndex() const {
       DCHECK(!Done());
-      const int outer_index = (1 << (3 * bits_)) - (end_ - current_);
-      const Eigen::Array3i shifted_index =
-          To3DIndex(outer_index, bits_) * WrappedGrid::grid_size() +
-          nested_iterator_.GetCellIndex();
-      return shifted_index - ((1 << (bits_ - 1)) * WrappedGrid::grid_size());
+      return current_->first * WrappedGrid::grid_size() +
+             nested_iterator_.GetCellIndex();
     }
 
     const ValueType& GetValue() const {
@@ -356,60 +390,149 @@ class DynamicGrid {
    private:
     void AdvanceToValidNestedIterator() {
       for (; !Done(); ++current_) {
-        if (*current_ != nullptr) {
-          nested_iterator_ = typename WrappedGrid::Iterator(**current_);
-          if (!nested_iterator_.Done()) {
-            break;
-          }
+        nested_iterator_ = typename WrappedGrid::Iterator(*current_->second);
+        if (!nested_iterator_.Done()) {
+          break;
         }
       }
     }
 
-    int bits_;
-    const std::unique_ptr<WrappedGrid>* current_;
-    const std::unique_ptr<WrappedGrid>* const end_;
+    const std::pair<Eigen::Array3i, WrappedGrid*>* current_;
+    const std::pair<Eigen::Array3i, WrappedGrid*>* end_;
     typename WrappedGrid::Iterator nested_iterator_;
   };
 
  private:
-  // Returns the Eigen::Array3i (meta) index of the meta cell containing
-  // 'index'.
-  Eigen::Array3i GetMetaIndex(const Eigen::Array3i& index) const {
-    DCHECK((index >= 0).all()) << index;
-    const Eigen::Array3i meta_index = index / WrappedGrid::grid_size();
-    DCHECK((meta_index < (1 << bits_)).all()) << index;
-    return meta_index;
-  }
-
-  // Grows this grid by a factor of 2 in each of the 3 dimensions.
-  void Grow() {
-    const int new_bits = bits_ + 1;
-    CHECK_LE(new_bits, 8);
-    std::vector<std::unique_ptr<WrappedGrid>> new_meta_cells_(
-        8 * meta_cells_.size());
-    for (int z = 0; z != (1 << bits_); ++z) {
-      for (int y = 0; y != (1 << bits_); ++y) {
-        for (int x = 0; x != (1 << bits_); ++x) {
-          const Eigen::Array3i original_meta_index(x, y, z);
-          const Eigen::Array3i new_meta_index =
-              original_meta_index + (1 << (bits_ - 1));
-          new_meta_cells_[ToFlatIndex(new_meta_index, new_bits)] =
-              std::move(meta_cells_[ToFlatIndex(original_meta_index, bits_)]);
-        }
+  // Block indices are limited to 21 bits per dimension by the key.
+  static constexpr int kMaxBlockExtent = 1 << 20;
+  static constexpr int kMinNumSlotBits = 6;
+  // Blocks per chunk are doubled until a chunk has about this size.
+  static constexpr size_t kMaxChunkSizeInBytes = 1 << 16;
+
+  struct Slot {
+    uint64 key;
+    // 'nullptr' if the slot is empty.
+    WrappedGrid* block;
+  };
+
+  static Eigen::Array3i GetBlockIndex(const Eigen::Array3i& index) {
+    // Arithmetic shifts round towards negative infinity.
+    return Eigen::Array3i(index.x() >> WrappedGrid::grid_bits(),
+                          index.y() >> WrappedGrid::grid_bits(),
+                          index.z() >> WrappedGrid::grid_bits());
+  }
+
+  static Eigen::Array3i GetInnerIndex(const Eigen::Array3i& index) {
+    return Eigen::Array3i(index.x() & (WrappedGrid::grid_size() - 1),
+                          index.y() & (WrappedGrid::grid_size() - 1),
+                          index.z() & (WrappedGrid::grid_size() - 1));
+  }
+
+  static bool IsInRange(const Eigen::Array3i& block_index) {
+    // The cast to unsigned is for performance to check with 3 comparisons
+    // block_index.[xyz] >= -kMaxBlockExtent and < kMaxBlockExtent.
+    return ((block_index + kMaxBlockExtent).cast<unsigned int>() <
+            2 * kMaxBlockExtent)
+        .all();
+  }
+
+  // Packs the 21 bits of each coordinate of an in range 'block_index'.
+  static uint64 ToKey(const Eigen::Array3i& block_index) {
+    const Eigen::Array3i shifted_index = block_index + kMaxBlockExtent;
+    return static_cast<uint64>(shifted_index.x()) |
+           static_cast<uint64>(shifted_index.y()) << 21 |
+           static_cast<uint64>(shifted_index.z()) << 42;
+  }
+
+  // Fibonacci hashing, which spreads the keys of neighbouring blocks over the
+  // whole table.
+  size_t GetSlotIndex(const uint64 key) const {
+    return (key * 0x9e3779b97f4a7c15) >> (64 - num_slot_bits_);
+  }
+
+  WrappedGrid* FindBlock(const Eigen::Array3i& block_index) const {
+    if (!IsInRange(block_index)) {
+      return nullptr;
+    }
+    const uint64 key = ToKey(block_index);
+    const size_t mask = slots_.size() - 1;
+    for (size_t i = GetSlotIndex(key);; i = (i + 1) & mask) {
+      const Slot& slot = slots_[i];
+      if (slot.block == nullptr || slot.key == key) {
+        return slot.block;
       }
     }
-    meta_cells_ = std::move(new_meta_cells_);
-    bits_ = new_bits;
   }
 
-  int bits_;
-  std::vector<std::unique_ptr<WrappedGrid>> meta_cells_;
+  WrappedGrid* AddBlock(const Eigen::Array3i& block_index) {
+    CHECK(IsInRange(block_index)) << block_index;
+    if (2 * (blocks_.size() + 1) > slots_.size()) {
+      Rehash(num_slot_bits_ + 1);
+    }
+    if (num_free_blocks_in_chunk_ == 0) {
+      const size_t max_blocks_per_chunk = std::max<size_t>(
+          1, kMaxChunkSizeInBytes / sizeof(WrappedGrid));
+      const size_t num_blocks = std::min(
+          max_blocks_per_chunk,
+          chunks_.empty() ? size_t{1} : 2 * chunks_.back().second);
+      chunks_.emplace_back(absl::make_unique<WrappedGrid[]>(num_blocks),
+                           num_blocks);
+      num_free_blocks_in_chunk_ = num_blocks;
+    }
+    WrappedGrid* const block =
+        chunks_.back().first.get() +
+        (chunks_.back().second - num_free_blocks_in_chunk_);
+    --num_free_blocks_in_chunk_;
+    blocks_.emplace_back(block_index, block);
+    InsertIntoSlots(ToKey(block_index), block);
+    max_block_extent_ = std::max(
+        max_block_extent_,
+        std::max((-block_index).maxCoeff(), (block_index + 1).maxCoeff()));
+    return block;
+  }
+
+  void Swap(HashedGrid* const other) {
+    std::swap(num_slot_bits_, other->num_slot_bits_);
+    slots_.swap(other->slots_);
+    blocks_.swap(other->blocks_);
+    chunks_.swap(other->chunks_);
+    std::swap(num_free_blocks_in_chunk_, other->num_free_blocks_in_chunk_);
+    std::swap(max_block_extent_, other->max_block_extent_);
+  }
+
+  void Rehash(const int num_slot_bits) {
+    num_slot_bits_ = num_slot_bits;
+    slots_.assign(size_t{1} << num_slot_bits, Slot{0, nullptr});
+    for (const auto& block : blocks_) {
+      InsertIntoSlots(ToKey(block.first), block.second);
+    }
+  }
+
+  void InsertIntoSlots(const uint64 key, WrappedGrid* const block) {
+    const size_t mask = slots_.size() - 1;
+    size_t i = GetSlotIndex(key);
+    while (slots_[i].block != nullptr) {
+      i = (i + 1) & mask;
+    }
+    slots_[i] = Slot{key, block};
+  }
+
+  // There are 2^'num_slot_bits_' slots, at most half of them are used.
+  int num_slot_bits_;
+  std::vector<Slot> slots_;
+  // Block indices and blocks in the order of construction.
+  std::vector<std::pair<Eigen::Array3i, WrappedGrid*>> blocks_;
+  // Memory of the blocks and the number of blocks in each chunk.
+  std::vector<std::pair<std::unique_ptr<WrappedGrid[]>, size_t>> chunks_;
+  size_t num_free_blocks_in_chunk_ = 0;
+  // All blocks have indices in [-'max_block_extent_', 'max_block_extent_').
+  int max_block_extent_ = 0;
 };
 
 template <typename ValueType>
-using GridBase = DynamicGrid<NestedGrid<FlatGrid<ValueType, 3>, 3>>;
+using GridBase = HashedGrid<FlatGrid<ValueType, 3>>;
 
-// Represents a 3D grid as a wide, shallow tree.
+// Represents a 3D grid as a hash table of small dense blocks.
 template <typename ValueType>
 class HybridGridBase : public GridBase<ValueType> {
  public:
@@ -461,10 +584,9 @@ class HybridGridBase : public GridBase<ValueType> {
 
 // A grid containing probability values stored using 15 bits, and an update
 // marker per voxel.
-// Points are expected to be close to the origin. Points far from the origin
-// require the grid to grow dynamically. For centimeter resolution, points
-// can only be tens of meters from the origin.
-// The hard limit of cell indexes is +/- 8192 around the origin.
+// Only blocks of 8x8x8 voxels containing values use memory, so points can be
+// far from the origin. The hard limit of cell indexes is +/- 2^23 around the
+// origin.
 class HybridGrid : public HybridGridBase<uint16> {
  public:
   explicit HybridGrid(const float resolution)
@@ -497,6 +619,15 @@ class HybridGrid : public HybridGridBase<uint16> {
     }
   }
 
+  // Compacts the grid once no more updates are expected. See
+  // HashedGrid::Compact().
+  void Compact() {
+    CHECK(update_indices_.empty())
+        << "Compacting a grid during an update is not supported.";
+    update_indices_.shrink_to_fit();
+    HybridGridBase<uint16>::Compact();
+  }
+
   // Applies the 'odds' specified when calling ComputeLookupTableToApplyOdds()
   // to the probability of the cell at 'index' if the cell has not already been
   // updated. Multiple updates of the same cell will be ignored until
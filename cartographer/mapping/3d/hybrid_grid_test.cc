@@ -16,9 +16,11 @@
 
 #include "cartographer/mapping/3d/hybrid_grid.h"
 
+#include <array>
 #include <map>
 #include <random>
 #include <tuple>
+#include <utility>
 
 #include "gmock/gmock.h"
 
@@ -137,6 +139,97 @@ TEST(HybridGridTest, GetCenterOfCell) {
   EXPECT_THAT(hybrid_grid.GetCellIndex(center), AllCwiseEqual(index));
 }
 
+TEST(HybridGridTest, FarFromOrigin) {
+  HybridGrid hybrid_grid(0.05f);
+  EXPECT_EQ(hybrid_grid.grid_size(), 0);
+
+  const Eigen::Array3i near_index(-1, 0, 7);
+  const Eigen::Array3i far_index(100000, -2000000, 4000000);
+  hybrid_grid.SetProbability(near_index, 0.7f);
+  EXPECT_EQ(hybrid_grid.grid_size(), 16);
+  uint16* const near_value = hybrid_grid.mutable_value(near_index);
+
+  hybrid_grid.SetProbability(far_index, 0.6f);
+  for (int i = 1; i < 1000; ++i) {
+    hybrid_grid.SetProbability(Eigen::Array3i(i * 8, 0, 0), 0.5f);
+  }
+  EXPECT_EQ(hybrid_grid.grid_size(), 2 * (4000000 + 8));
+  // Values never move.
+  EXPECT_EQ(hybrid_grid.mutable_value(near_index), near_value);
+  EXPECT_NEAR(hybrid_grid.GetProbability(near_index), 0.7f, 1e-4);
+  EXPECT_NEAR(hybrid_grid.GetProbability(far_index), 0.6f, 1e-4);
+  EXPECT_FALSE(hybrid_grid.IsKnown(far_index + Eigen::Array3i(0, 0, 1)));
+  EXPECT_FALSE(hybrid_grid.IsKnown(Eigen::Array3i(-100000000, 0, 0)));
+}
+
+TEST(HybridGridTest, GetOctantValues) {
+  HybridGrid hybrid_grid(0.05f);
+  for (int z = -9; z < 9; ++z) {
+    for (int y = -9; y < 9; ++y) {
+      for (int x = -9; x < 9; ++x) {
+        *hybrid_grid.mutable_value(Eigen::Array3i(x, y, z)) =
+            (x + 9) + 18 * (y + 9) + 18 * 18 * (z + 9) + 1;
+      }
+    }
+  }
+  std::array<uint16, 8> values;
+  for (int z = -12; z < 12; ++z) {
+    for (int y = -12; y < 12; ++y) {
+      for (int x = -12; x < 12; ++x) {
+        const Eigen::Array3i index(x, y, z);
+        hybrid_grid.GetOctantValues(index, &values);
+        for (int i = 0; i != 8; ++i) {
+          EXPECT_EQ(values[i],
+                    hybrid_grid.value(index + HybridGrid::GetOctant(i)));
+        }
+      }
+    }
+  }
+}
+
+TEST(HybridGridTest, IterationSkipsValuesResetToDefault) {
+  HybridGrid hybrid_grid(0.05f);
+  // Cells are in the same block, in different words of its bitmask and in
+  // a different block.
+  const std::vector<Eigen::Array3i> indices = {
+      {0, 0, 0}, {1, 0, 0}, {7, 7, 0}, {0, 0, 7}, {7, 7, 7}, {8, 0, 0}};
+  for (const Eigen::Array3i& index : indices) {
+    *hybrid_grid.mutable_value(index) = 1;
+  }
+  *hybrid_grid.mutable_value(Eigen::Array3i(1, 0, 0)) = 0;
+  *hybrid_grid.mutable_value(Eigen::Array3i(8, 0, 0)) = 0;
+  // Only accessing a cell must not make it visible either.
+  hybrid_grid.mutable_value(Eigen::Array3i(3, 3, 3));
+
+  std::vector<Eigen::Array3i> visited;
+  for (auto it = HybridGrid::Iterator(hybrid_grid); !it.Done(); it.Next()) {
+    EXPECT_EQ(it.GetValue(), 1);
+    visited.push_back(it.GetCellIndex());
+  }
+  ASSERT_EQ(visited.size(), 4);
+  EXPECT_THAT(visited[0], AllCwiseEqual(Eigen::Array3i(0, 0, 0)));
+  EXPECT_THAT(visited[1], AllCwiseEqual(Eigen::Array3i(7, 7, 0)));
+  EXPECT_THAT(visited[2], AllCwiseEqual(Eigen::Array3i(0, 0, 7)));
+  EXPECT_THAT(visited[3], AllCwiseEqual(Eigen::Array3i(7, 7, 7)));
+}
+
+TEST(HybridGridTest, MovedFromGridIsEmpty) {
+  GridBase<int> grid;
+  *grid.mutable_value(Eigen::Array3i(1, 2, 3)) = 1;
+  GridBase<int> moved_to(std::move(grid));
+  EXPECT_EQ(moved_to.value(Eigen::Array3i(1, 2, 3)), 1);
+  EXPECT_EQ(grid.value(Eigen::Array3i(1, 2, 3)), 0);
+  EXPECT_TRUE(GridBase<int>::Iterator(grid).Done());
+  *grid.mutable_value(Eigen::Array3i(4, 5, 6)) = 2;
+  EXPECT_EQ(grid.value(Eigen::Array3i(4, 5, 6)), 2);
+
+  moved_to = std::move(grid);
+  EXPECT_EQ(moved_to.value(Eigen::Array3i(1, 2, 3)), 0);
+  EXPECT_EQ(moved_to.value(Eigen::Array3i(4, 5, 6)), 2);
+  EXPECT_EQ(grid.value(Eigen::Array3i(4, 5, 6)), 0);
+  EXPECT_TRUE(GridBase<int>::Iterator(grid).Done());
+}
+
 class RandomHybridGridTest : public ::testing::Test {
  public:
   RandomHybridGridTest() : hybrid_grid_(2.f), values_() {
@@ -218,6 +311,35 @@ TEST_F(RandomHybridGridTest, ToProto) {
   EXPECT_EQ(proto_map, hybrid_grid_map);
 }
 
+TEST_F(RandomHybridGridTest, Compact) {
+  // A block which only holds default values is dropped.
+  *hybrid_grid_.mutable_value(Eigen::Array3i(4000, 4000, 4000)) = 0;
+  const size_t memory_usage_in_bytes = hybrid_grid_.MemoryUsageInBytes();
+  hybrid_grid_.Compact();
+  EXPECT_LT(hybrid_grid_.MemoryUsageInBytes(), memory_usage_in_bytes);
+
+  for (const auto& pair : values_) {
+    const Eigen::Array3i cell_index(std::get<0>(pair.first),
+                                    std::get<1>(pair.first),
+                                    std::get<2>(pair.first));
+    EXPECT_NEAR(pair.second, hybrid_grid_.GetProbability(cell_index), 1e-4);
+  }
+  size_t num_cells = 0;
+  for (const auto& cell : hybrid_grid_) {
+    EXPECT_TRUE(values_.count(
+        std::make_tuple(cell.first.x(), cell.first.y(), cell.first.z())));
+    ++num_cells;
+  }
+  EXPECT_EQ(values_.size(), num_cells);
+  EXPECT_FALSE(hybrid_grid_.IsKnown(Eigen::Array3i(4000, 4000, 4000)));
+
+  // The grid can still be changed.
+  hybrid_grid_.SetProbability(Eigen::Array3i(4000, 4000, 4000), 0.7f);
+  EXPECT_NEAR(0.7f,
+              hybrid_grid_.GetProbability(Eigen::Array3i(4000, 4000, 4000)),
+              1e-4);
+}
+
 struct EigenComparator {
   bool operator()(const Eigen::Vector3i& lhs,
                   const Eigen::Vector3i& rhs) const {
@@ -24,6 +24,27 @@ namespace cartographer {
 namespace mapping {
 namespace {
 
+void InsertMissesOfRay(const std::vector<uint16>& miss_table,
+                       const Eigen::Array3i& origin_cell,
+                       const Eigen::Array3i& hit_cell, HybridGrid* hybrid_grid,
+                       const int num_free_space_voxels) {
+  const Eigen::Array3i delta = hit_cell - origin_cell;
+  const int num_samples = delta.cwiseAbs().maxCoeff();
+  CHECK_LT(num_samples, 1 << 15);
+  // 'num_samples' is the number of samples we equi-distantly place on the
+  // line between 'origin' and 'hit'. (including a fractional part for sub-
+  // voxels) It is chosen so that between two samples we change from one voxel
+  // to the next on the fastest changing dimension.
+  //
+  // Only the last 'num_free_space_voxels' are updated for performance.
+  for (int position = std::max(0, num_samples - num_free_space_voxels);
+       position < num_samples; ++position) {
+    const Eigen::Array3i miss_cell =
+        origin_cell + delta * position / num_samples;
+    hybrid_grid->ApplyLookupTable(miss_cell, miss_table);
+  }
+}
+
 void InsertMissesIntoGrid(const std::vector<uint16>& miss_table,
                           const Eigen::Vector3f& origin,
                           const sensor::PointCloud& returns,
@@ -31,23 +52,9 @@ void InsertMissesIntoGrid(const std::vector<uint16>& miss_table,
                           const int num_free_space_voxels) {
   const Eigen::Array3i origin_cell = hybrid_grid->GetCellIndex(origin);
   for (const sensor::RangefinderPoint& hit : returns) {
-    const Eigen::Array3i hit_cell = hybrid_grid->GetCellIndex(hit.position);
-
-    const Eigen::Array3i delta = hit_cell - origin_cell;
-    const int num_samples = delta.cwiseAbs().maxCoeff();
-    CHECK_LT(num_samples, 1 << 15);
-    // 'num_samples' is the number of samples we equi-distantly place on the
-    // line between 'origin' and 'hit'. (including a fractional part for sub-
-    // voxels) It is chosen so that between two samples we change from one voxel
-    // to the next on the fastest changing dimension.
-    //
-    // Only the last 'num_free_space_voxels' are updated for performance.
-    for (int position = std::max(0, num_samples - num_free_space_voxels);
-         position < num_samples; ++position) {
-      const Eigen::Array3i miss_cell =
-          origin_cell + delta * position / num_samples;
-      hybrid_grid->ApplyLookupTable(miss_cell, miss_table);
-    }
+    InsertMissesOfRay(miss_table, origin_cell,
+                      hybrid_grid->GetCellIndex(hit.position), hybrid_grid,
+                      num_free_space_voxels);
   }
 }
 
@@ -113,5 +120,66 @@ void RangeDataInserter3D::Insert(
   hybrid_grid->FinishUpdate();
 }
 
+void RangeDataInserter3D::Insert(
+    const sensor::RangeData& range_data, const transform::Rigid3f& transform,
+    const float high_resolution_max_range,
+    HybridGrid* const high_resolution_hybrid_grid,
+    IntensityHybridGrid* const high_resolution_intensity_hybrid_grid,
+    HybridGrid* const low_resolution_hybrid_grid) const {
+  CHECK_NOTNULL(high_resolution_hybrid_grid);
+  CHECK_NOTNULL(low_resolution_hybrid_grid);
+  const Eigen::Vector3f origin = transform * range_data.origin;
+  const sensor::PointCloud& returns = range_data.returns;
+  const auto is_in_high_resolution_range =
+      [&origin, high_resolution_max_range](const Eigen::Vector3f& position) {
+        return (position - origin).norm() <= high_resolution_max_range;
+      };
+
+  // As in Insert() above, all hits of a grid are inserted before its misses.
+  for (const sensor::RangefinderPoint& hit : returns) {
+    const Eigen::Vector3f position = transform * hit.position;
+    if (is_in_high_resolution_range(position)) {
+      high_resolution_hybrid_grid->ApplyLookupTable(
+          high_resolution_hybrid_grid->GetCellIndex(position), hit_table_);
+    }
+    low_resolution_hybrid_grid->ApplyLookupTable(
+        low_resolution_hybrid_grid->GetCellIndex(position), hit_table_);
+  }
+
+  const Eigen::Array3i high_resolution_origin_cell =
+      high_resolution_hybrid_grid->GetCellIndex(origin);
+  const Eigen::Array3i low_resolution_origin_cell =
+      low_resolution_hybrid_grid->GetCellIndex(origin);
+  for (const sensor::RangefinderPoint& hit : returns) {
+    const Eigen::Vector3f position = transform * hit.position;
+    if (is_in_high_resolution_range(position)) {
+      InsertMissesOfRay(miss_table_, high_resolution_origin_cell,
+                        high_resolution_hybrid_grid->GetCellIndex(position),
+                        high_resolution_hybrid_grid,
+                        options_.num_free_space_voxels());
+    }
+    InsertMissesOfRay(miss_table_, low_resolution_origin_cell,
+                      low_resolution_hybrid_grid->GetCellIndex(position),
+                      low_resolution_hybrid_grid,
+                      options_.num_free_space_voxels());
+  }
+
+  if (high_resolution_intensity_hybrid_grid != nullptr) {
+    for (size_t i = 0; i < returns.intensities().size(); ++i) {
+      if (returns.intensities()[i] > options_.intensity_threshold()) {
+        continue;
+      }
+      const Eigen::Vector3f position = transform * returns[i].position;
+      if (is_in_high_resolution_range(position)) {
+        high_resolution_intensity_hybrid_grid->AddIntensity(
+            high_resolution_intensity_hybrid_grid->GetCellIndex(position),
+            returns.intensities()[i]);
+      }
+    }
+  }
+  high_resolution_hybrid_grid->FinishUpdate();
+  low_resolution_hybrid_grid->FinishUpdate();
+}
+
 }  // namespace mapping
 }  // namespace cartographer
@@ -21,6 +21,7 @@
 #include "cartographer/mapping/proto/range_data_inserter_options_3d.pb.h"
 #include "cartographer/sensor/point_cloud.h"
 #include "cartographer/sensor/range_data.h"
+#include "cartographer/transform/rigid_transform.h"
 
 namespace cartographer {
 namespace mapping {
@@ -41,6 +42,20 @@ class RangeDataInserter3D {
   void Insert(const sensor::RangeData& range_data, HybridGrid* hybrid_grid,
               IntensityHybridGrid* intensity_hybrid_grid) const;
 
+  // Inserts 'range_data' transformed by 'transform' into the grids of a
+  // submap. Only returns within 'high_resolution_max_range' of the origin are
+  // inserted into 'high_resolution_hybrid_grid' and optionally into
+  // 'high_resolution_intensity_hybrid_grid', all returns are inserted into
+  // 'low_resolution_hybrid_grid'. The result is the same as of calling
+  // Insert() for each resolution, but the returns are transformed on the fly
+  // and both grids are updated in the same passes over them.
+  void Insert(const sensor::RangeData& range_data,
+              const transform::Rigid3f& transform,
+              float high_resolution_max_range,
+              HybridGrid* high_resolution_hybrid_grid,
+              IntensityHybridGrid* high_resolution_intensity_hybrid_grid,
+              HybridGrid* low_resolution_hybrid_grid) const;
+
  private:
   const proto::RangeDataInserterOptions3D options_;
   const std::vector<uint16> hit_table_;
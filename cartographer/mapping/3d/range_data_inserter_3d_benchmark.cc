@@ -0,0 +1,91 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "benchmark/benchmark.h"
+#include "cartographer/mapping/3d/hybrid_grid.h"
+#include "cartographer/mapping/3d/range_data_inserter_3d.h"
+#include "cartographer/mapping/internal/testing/test_helpers.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+constexpr float kHighResolution = 0.1f;
+constexpr float kLowResolution = 0.45f;
+
+sensor::RangeData CreateRangeData() {
+  const sensor::TimedPointCloudData timed_point_cloud_data =
+      testing::GenerateFakeRangeMeasurements(0. /* travel_distance */,
+                                             1. /* duration */,
+                                             1. /* time_step */)
+          .front();
+  sensor::RangeData range_data{timed_point_cloud_data.origin, {}, {}};
+  for (const sensor::TimedRangefinderPoint& point :
+       timed_point_cloud_data.ranges) {
+    range_data.returns.push_back({point.position});
+  }
+  return range_data;
+}
+
+proto::RangeDataInserterOptions3D CreateRangeDataInserterOptions() {
+  proto::RangeDataInserterOptions3D options;
+  options.set_hit_probability(0.55);
+  options.set_miss_probability(0.49);
+  options.set_num_free_space_voxels(2);
+  return options;
+}
+
+// Inserts a scan of a half cylinder of radius 5 m into one grid.
+void BM_RangeDataInserter3DInsert(benchmark::State& state) {
+  const sensor::RangeData range_data = CreateRangeData();
+  const RangeDataInserter3D range_data_inserter(
+      CreateRangeDataInserterOptions());
+  HybridGrid hybrid_grid(kHighResolution);
+  for (auto _ : state) {
+    range_data_inserter.Insert(range_data, &hybrid_grid,
+                               nullptr /* intensity_hybrid_grid */);
+    hybrid_grid.FinishUpdate();
+  }
+  state.SetItemsProcessed(state.iterations() * range_data.returns.size());
+}
+BENCHMARK(BM_RangeDataInserter3DInsert);
+
+// Inserts the same scan into both grids of a submap, as 'Submap3D' does.
+void BM_RangeDataInserter3DInsertIntoSubmap(benchmark::State& state) {
+  const sensor::RangeData range_data = CreateRangeData();
+  const RangeDataInserter3D range_data_inserter(
+      CreateRangeDataInserterOptions());
+  HybridGrid high_resolution_hybrid_grid(kHighResolution);
+  HybridGrid low_resolution_hybrid_grid(kLowResolution);
+  for (auto _ : state) {
+    range_data_inserter.Insert(
+        range_data, transform::Rigid3f::Identity(),
+        20.f /* high_resolution_max_range */, &high_resolution_hybrid_grid,
+        nullptr /* high_resolution_intensity_hybrid_grid */,
+        &low_resolution_hybrid_grid);
+    high_resolution_hybrid_grid.FinishUpdate();
+    low_resolution_hybrid_grid.FinishUpdate();
+  }
+  state.SetItemsProcessed(state.iterations() * range_data.returns.size());
+}
+BENCHMARK(BM_RangeDataInserter3DInsertIntoSubmap);
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
+
+BENCHMARK_MAIN();
@@ -16,7 +16,10 @@
 
 #include "cartographer/mapping/3d/range_data_inserter_3d.h"
 
+#include <map>
 #include <memory>
+#include <random>
+#include <tuple>
 #include <vector>
 
 #include "cartographer/common/lua_parameter_dictionary_test_helpers.h"
@@ -149,6 +152,87 @@ TEST_F(RangeDataInserter3DTest, ProbabilityProgression) {
   EXPECT_NEAR(kMinProbability, GetProbability(0.f, 0.f, -3.f), 1e-3);
 }
 
+std::map<std::tuple<int, int, int>, uint16> GetCells(const HybridGrid& grid) {
+  std::map<std::tuple<int, int, int>, uint16> cells;
+  for (auto it = HybridGrid::Iterator(grid); !it.Done(); it.Next()) {
+    const Eigen::Array3i cell_index = it.GetCellIndex();
+    cells[std::make_tuple(cell_index.x(), cell_index.y(), cell_index.z())] =
+        it.GetValue();
+  }
+  return cells;
+}
+
+TEST(RangeDataInserter3DGridsTest, InsertIntoSubmapGridsAtOnce) {
+  auto parameter_dictionary = common::MakeDictionary(
+      "return { "
+      "hit_probability = 0.55, "
+      "miss_probability = 0.49, "
+      "num_free_space_voxels = 2, "
+      "intensity_threshold = 80, "
+      "}");
+  const RangeDataInserter3D range_data_inserter(
+      CreateRangeDataInserterOptions3D(parameter_dictionary.get()));
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> distribution(-10.f, 10.f);
+  sensor::RangeData range_data{Eigen::Vector3f(0.5f, -0.3f, 0.2f), {}, {}};
+  std::vector<sensor::RangefinderPoint> returns;
+  std::vector<float> intensities;
+  for (int i = 0; i < 2000; ++i) {
+    returns.push_back({Eigen::Vector3f(distribution(rng), distribution(rng),
+                                       0.2f * distribution(rng))});
+    intensities.push_back(5.f * (distribution(rng) + 10.f));
+  }
+  range_data.returns = sensor::PointCloud(returns, intensities);
+  const transform::Rigid3f transform(
+      Eigen::Vector3f(1.f, 2.f, -0.5f),
+      Eigen::Quaternionf(Eigen::AngleAxisf(0.3f, Eigen::Vector3f::UnitZ())));
+  constexpr float kHighResolutionMaxRange = 6.f;
+
+  HybridGrid high_resolution_grid(0.1f);
+  IntensityHybridGrid high_resolution_intensity_grid(0.1f);
+  HybridGrid low_resolution_grid(0.45f);
+  range_data_inserter.Insert(range_data, transform, kHighResolutionMaxRange,
+                             &high_resolution_grid,
+                             &high_resolution_intensity_grid,
+                             &low_resolution_grid);
+
+  const sensor::RangeData transformed_range_data =
+      sensor::TransformRangeData(range_data, transform);
+  const sensor::RangeData high_resolution_range_data{
+      transformed_range_data.origin,
+      transformed_range_data.returns.copy_if(
+          [&](const sensor::RangefinderPoint& point) {
+            return (point.position - transformed_range_data.origin).norm() <=
+                   kHighResolutionMaxRange;
+          }),
+      {}};
+  HybridGrid expected_high_resolution_grid(0.1f);
+  IntensityHybridGrid expected_high_resolution_intensity_grid(0.1f);
+  HybridGrid expected_low_resolution_grid(0.45f);
+  range_data_inserter.Insert(high_resolution_range_data,
+                             &expected_high_resolution_grid,
+                             &expected_high_resolution_intensity_grid);
+  range_data_inserter.Insert(transformed_range_data,
+                             &expected_low_resolution_grid,
+                             /*intensity_hybrid_grid=*/nullptr);
+
+  EXPECT_EQ(GetCells(high_resolution_grid),
+            GetCells(expected_high_resolution_grid));
+  EXPECT_EQ(GetCells(low_resolution_grid),
+            GetCells(expected_low_resolution_grid));
+  int num_cells_with_intensity = 0;
+  for (const sensor::RangefinderPoint& point : transformed_range_data.returns) {
+    const Eigen::Array3i cell_index =
+        expected_high_resolution_intensity_grid.GetCellIndex(point.position);
+    EXPECT_EQ(high_resolution_intensity_grid.GetIntensity(cell_index),
+              expected_high_resolution_intensity_grid.GetIntensity(cell_index));
+    if (high_resolution_intensity_grid.GetIntensity(cell_index) > 0.f) {
+      ++num_cells_with_intensity;
+    }
+  }
+  EXPECT_GT(num_cells_with_intensity, 0);
+}
+
 }  // namespace
 }  // namespace mapping
 }  // namespace cartographer
@@ -36,18 +36,6 @@ struct PixelData {
   float max_probability = 0.5f;
 };
 
-// Filters 'range_data', retaining only the returns that have no more than
-// 'max_range' distance from the origin. Removes misses.
-sensor::RangeData FilterRangeDataByMaxRange(const sensor::RangeData& range_data,
-                                            const float max_range) {
-  sensor::RangeData result{range_data.origin, {}, {}};
-  result.returns =
-      range_data.returns.copy_if([&](const sensor::RangefinderPoint& point) {
-        return (point.position - range_data.origin).norm() <= max_range;
-      });
-  return result;
-}
-
 std::vector<PixelData> AccumulatePixelData(
     const int width, const int height, const Eigen::Array2i& min_index,
     const Eigen::Array2i& max_index,
@@ -248,6 +236,11 @@ void Submap3D::UpdateFromProto(const proto::Submap3D& submap_3d) {
     low_resolution_hybrid_grid_ =
         absl::make_unique<HybridGrid>(submap_3d.low_resolution_hybrid_grid());
   }
+  if (submap_3d.finished() && high_resolution_hybrid_grid_ != nullptr &&
+      low_resolution_hybrid_grid_ != nullptr) {
+    high_resolution_hybrid_grid_->Compact();
+    low_resolution_hybrid_grid_->Compact();
+  }
   rotational_scan_matcher_histogram_ =
       Eigen::VectorXf::Zero(submap_3d.rotational_scan_matcher_histogram_size());
   for (Eigen::VectorXf::Index i = 0;
@@ -274,17 +267,12 @@ void Submap3D::InsertData(const sensor::RangeData& range_data_in_local,
                           const Eigen::Quaterniond& local_from_gravity_aligned,
                           const Eigen::VectorXf& scan_histogram_in_gravity) {
   CHECK(!insertion_finished());
-  // Transform range data into submap frame.
-  const sensor::RangeData transformed_range_data = sensor::TransformRangeData(
-      range_data_in_local, local_pose().inverse().cast<float>());
+  // Insert range data in submap frame.
   range_data_inserter.Insert(
-      FilterRangeDataByMaxRange(transformed_range_data,
-                                high_resolution_max_range),
-      high_resolution_hybrid_grid_.get(),
-      high_resolution_intensity_hybrid_grid_.get());
-  range_data_inserter.Insert(transformed_range_data,
-                             low_resolution_hybrid_grid_.get(),
-                             /*intensity_hybrid_grid=*/nullptr);
+      range_data_in_local, local_pose().inverse().cast<float>(),
+      high_resolution_max_range, high_resolution_hybrid_grid_.get(),
+      high_resolution_intensity_hybrid_grid_.get(),
+      low_resolution_hybrid_grid_.get());
   set_num_range_data(num_range_data() + 1);
   const float yaw_in_submap_from_gravity = transform::GetYaw(
       local_pose().inverse().rotation() * local_from_gravity_aligned);
@@ -296,10 +284,14 @@ void Submap3D::InsertData(const sensor::RangeData& range_data_in_local,
 void Submap3D::Finish() {
   CHECK(!insertion_finished());
   set_insertion_finished(true);
+  high_resolution_hybrid_grid_->Compact();
+  low_resolution_hybrid_grid_->Compact();
 }
 
-ActiveSubmaps3D::ActiveSubmaps3D(const proto::SubmapsOptions3D& options)
+ActiveSubmaps3D::ActiveSubmaps3D(const proto::SubmapsOptions3D& options,
+                                 const bool use_intensities)
     : options_(options),
+      use_intensities_(use_intensities),
       range_data_inserter_(options.range_data_inserter_options()) {}
 
 std::vector<std::shared_ptr<const Submap3D>> ActiveSubmaps3D::submaps() const {
@@ -348,6 +340,9 @@ void ActiveSubmaps3D::AddSubmap(
   submaps_.emplace_back(new Submap3D(
       options_.high_resolution(), options_.low_resolution(), local_submap_pose,
       initial_rotational_scan_matcher_histogram));
+  if (!use_intensities_) {
+    submaps_.back()->ForgetIntensityHybridGrid();
+  }
 }
 
 }  // namespace mapping
@@ -80,6 +80,8 @@ class Submap3D : public Submap {
                   const Eigen::Quaterniond& local_from_gravity_aligned,
                   const Eigen::VectorXf& scan_histogram_in_gravity);
 
+  // Marks the submap as finished and compacts its grids, which are not changed
+  // anymore.
   void Finish();
 
  private:
@@ -103,7 +105,9 @@ class Submap3D : public Submap {
 // "new" submap gets created. The "old" submap is forgotten by this object.
 class ActiveSubmaps3D {
  public:
-  explicit ActiveSubmaps3D(const proto::SubmapsOptions3D& options);
+  // Intensities are only accumulated in the submaps if 'use_intensities' is
+  // set, i.e. if they are used for scan matching.
+  ActiveSubmaps3D(const proto::SubmapsOptions3D& options, bool use_intensities);
 
   ActiveSubmaps3D(const ActiveSubmaps3D&) = delete;
   ActiveSubmaps3D& operator=(const ActiveSubmaps3D&) = delete;
@@ -125,6 +129,7 @@ class ActiveSubmaps3D {
                  int rotational_scan_matcher_histogram_size);
 
   const proto::SubmapsOptions3D options_;
+  const bool use_intensities_;
   std::vector<std::shared_ptr<Submap3D>> submaps_;
   RangeDataInserter3D range_data_inserter_;
 };
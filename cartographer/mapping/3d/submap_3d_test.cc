@@ -35,7 +35,7 @@ TEST(SubmapsTest, ToFromProto) {
       expected.ToProto(true /* include_probability_grid_data */);
   EXPECT_FALSE(proto.has_submap_2d());
   EXPECT_TRUE(proto.has_submap_3d());
-  const auto actual = Submap3D(proto.submap_3d());
+  const Submap3D actual(proto.submap_3d());
   EXPECT_TRUE(expected.local_pose().translation().isApprox(
       actual.local_pose().translation(), 1e-6));
   EXPECT_TRUE(expected.local_pose().rotation().isApprox(
@@ -17,7 +17,11 @@
 #include "cartographer/mapping/detect_floors.h"
 
 #include <algorithm>
-#include <fstream>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <queue>
+#include <thread>
 #include <vector>
 
 #include "Eigen/Core"
@@ -43,12 +47,41 @@ constexpr double kMinLevelSeparationMeters = 1.;
 struct Span {
   int start_index;
   int end_index;
+  // Unsorted z-values of the nodes in this span and their median.
   std::vector<double> z_values;
+  double median_z;
+};
+
+// Median of a growing set of values, kept in two heaps so that 'Add' is
+// O(log n). 'Median' is the element at index size / 2 of the sorted values.
+class RunningMedian {
+ public:
+  void Add(const double value) {
+    if (upper_.empty() || value >= upper_.top()) {
+      upper_.push(value);
+    } else {
+      lower_.push(value);
+    }
+    const size_t num_lower = (lower_.size() + upper_.size()) / 2;
+    if (lower_.size() > num_lower) {
+      upper_.push(lower_.top());
+      lower_.pop();
+    } else if (lower_.size() < num_lower) {
+      lower_.push(upper_.top());
+      upper_.pop();
+    }
+  }
 
-  bool operator<(const Span& other) const {
-    return std::forward_as_tuple(start_index, end_index) <
-           std::forward_as_tuple(other.start_index, other.end_index);
+  double Median() const {
+    CHECK(!upper_.empty());
+    return upper_.top();
   }
+
+ private:
+  // The smaller half of the values, all of them <= the values in 'upper_'.
+  std::priority_queue<double> lower_;
+  std::priority_queue<double, std::vector<double>, std::greater<double>>
+      upper_;
 };
 
 // Union-find implementation for classifying spans into levels.
@@ -67,31 +100,58 @@ void LevelUnion(int i, int j, Levels* levels) {
   (*levels)[repr_i] = repr_j;
 }
 
-void InsertSorted(const double val, std::vector<double>* vals) {
-  vals->insert(std::upper_bound(vals->begin(), vals->end(), val), val);
+// Returns the element at index size / 2 of the sorted 'values', reordering
+// them.
+double Median(std::vector<double>* values) {
+  CHECK(!values->empty());
+  const auto median = values->begin() + values->size() / 2;
+  std::nth_element(values->begin(), median, values->end());
+  return *median;
 }
 
-double Median(const std::vector<double>& sorted) {
-  CHECK(!sorted.empty());
-  return sorted.at(sorted.size() / 2);
+// Calls 'function(i)' for all 0 <= i < 'size' on up to 'num_threads' threads.
+template <typename Function>
+void ParallelFor(const int size, const int num_threads,
+                 const Function& function) {
+  std::atomic<int> next_index(0);
+  const auto work = [&]() {
+    for (int i = next_index++; i < size; i = next_index++) {
+      function(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < std::min(num_threads, size); ++i) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
 }
 
 // Cut the trajectory at jumps in z. A new span is started when the current
 // node's z differes by more than kLevelHeightMeters from the median z values.
+// This has to be a single pass since every cut depends on the span before it.
 std::vector<Span> SliceByAltitudeChange(const proto::Trajectory& trajectory) {
   CHECK_GT(trajectory.node_size(), 0);
 
   std::vector<Span> spans;
-  spans.push_back(Span{0, 0, {trajectory.node(0).pose().translation().z()}});
-  for (int i = 1; i < trajectory.node_size(); ++i) {
+  spans.push_back(Span{0, 0, {}, 0.});
+  RunningMedian running_median;
+  for (int i = 0; i < trajectory.node_size(); ++i) {
     const auto& node = trajectory.node(i);
     const double z = node.pose().translation().z();
-    if (std::abs(Median(spans.back().z_values) - z) > kLevelHeightMeters) {
-      spans.push_back(Span{i, i, {}});
+    if (i > 0 &&
+        std::abs(running_median.Median() - z) > kLevelHeightMeters) {
+      spans.back().median_z = running_median.Median();
+      spans.push_back(Span{i, i, {}, 0.});
+      running_median = RunningMedian();
     }
-    InsertSorted(z, &spans.back().z_values);
+    running_median.Add(z);
+    spans.back().z_values.push_back(z);
     spans.back().end_index = i + 1;
   }
+  spans.back().median_z = running_median.Median();
   return spans;
 }
 
@@ -107,18 +167,24 @@ double SpanLength(const proto::Trajectory& trajectory, const Span& span) {
   return length;
 }
 
-// True if 'span' is considered to be short, i.e. not interesting on its own,
-// but should be folded into the levels before and after entering it.
-bool IsShort(const proto::Trajectory& trajectory, const Span& span) {
-  return SpanLength(trajectory, span) < kMaxShortSpanLengthMeters;
+// True for every span that is considered to be short, i.e. not interesting on
+// its own, but should be folded into the levels before and after entering it.
+// Spans are measured concurrently.
+std::vector<bool> FindShortSpans(const proto::Trajectory& trajectory,
+                                 const std::vector<Span>& spans,
+                                 const int num_threads) {
+  std::vector<char> is_short(spans.size());
+  ParallelFor(spans.size(), num_threads, [&](const int i) {
+    is_short[i] = SpanLength(trajectory, spans[i]) < kMaxShortSpanLengthMeters;
+  });
+  return std::vector<bool>(is_short.begin(), is_short.end());
 }
 
 // Merges all 'spans' that have similar median z value into the same level.
-void GroupSegmentsByAltitude(const proto::Trajectory& trajectory,
-                             const std::vector<Span>& spans, Levels* levels) {
+void GroupSegmentsByAltitude(const std::vector<Span>& spans, Levels* levels) {
   for (size_t i = 0; i < spans.size(); ++i) {
     for (size_t j = i + 1; j < spans.size(); ++j) {
-      if (std::abs(Median(spans[i].z_values) - Median(spans[j].z_values)) <
+      if (std::abs(spans[i].median_z - spans[j].median_z) <
           kMinLevelSeparationMeters) {
         LevelUnion(i, j, levels);
       }
@@ -128,20 +194,19 @@ void GroupSegmentsByAltitude(const proto::Trajectory& trajectory,
 
 std::vector<Floor> FindFloors(const proto::Trajectory& trajectory,
                               const std::vector<Span>& spans,
-                              const Levels& levels) {
-  std::map<int, std::vector<Span>> level_spans;
+                              const std::vector<bool>& is_short,
+                              const Levels& levels, const int num_threads) {
+  std::map<int, std::vector<int>> level_spans;
 
   // Initialize the levels to start out with only long spans.
   for (size_t i = 0; i < spans.size(); ++i) {
-    const Span& span = spans[i];
-    if (!IsShort(trajectory, span)) {
-      level_spans[LevelFind(i, levels)].push_back(span);
+    if (!is_short[i]) {
+      level_spans[LevelFind(i, levels)].push_back(i);
     }
   }
 
   for (size_t i = 0; i < spans.size(); ++i) {
-    const Span& span = spans[i];
-    if (!IsShort(trajectory, span)) {
+    if (!is_short[i]) {
       continue;
     }
 
@@ -149,7 +214,7 @@ std::vector<Floor> FindFloors(const proto::Trajectory& trajectory,
     // into it.
     int level = LevelFind(i, levels);
     if (!level_spans[level].empty()) {
-      level_spans[level].push_back(span);
+      level_spans[level].push_back(i);
       continue;
     }
 
@@ -157,59 +222,74 @@ std::vector<Floor> FindFloors(const proto::Trajectory& trajectory,
     // likely some intermediate level on stairs.
     size_t index = i - 1;
     if (index < spans.size()) {
-      level_spans[LevelFind(index, levels)].push_back(span);
+      level_spans[LevelFind(index, levels)].push_back(i);
     }
     index = i + 1;
     if (index < spans.size()) {
-      level_spans[LevelFind(index, levels)].push_back(span);
+      level_spans[LevelFind(index, levels)].push_back(i);
     }
   }
 
-  // Convert the level_spans structure to 'Floor'.
-  std::vector<Floor> floors;
+  std::vector<std::vector<int>> levels_to_convert;
   for (auto& level : level_spans) {
-    if (level.second.empty()) {
-      continue;
+    if (!level.second.empty()) {
+      levels_to_convert.push_back(std::move(level.second));
     }
+  }
 
+  // Convert the level_spans structure to 'Floor', one level per task.
+  std::vector<Floor> floors(levels_to_convert.size());
+  std::vector<char> valid(levels_to_convert.size());
+  ParallelFor(levels_to_convert.size(), num_threads, [&](const int k) {
+    std::vector<int>& span_indices = levels_to_convert[k];
+    std::sort(span_indices.begin(), span_indices.end());
     std::vector<double> z_values;
-    std::sort(level.second.begin(), level.second.end());
-    floors.emplace_back();
-    for (const auto& span : level.second) {
-      if (!IsShort(trajectory, span)) {
+    for (const int i : span_indices) {
+      const Span& span = spans[i];
+      if (!is_short[i]) {
         // To figure out the median height of this floor, we only care for the
         // long pieces that are guaranteed to be in the structure. This is a
         // heuristic to leave out intermediate (short) levels.
         z_values.insert(z_values.end(), span.z_values.begin(),
                         span.z_values.end());
       }
-      floors.back().timespans.push_back(Timespan{
+      floors[k].timespans.push_back(Timespan{
           common::FromUniversal(trajectory.node(span.start_index).timestamp()),
           common::FromUniversal(
               trajectory.node(span.end_index - 1).timestamp())});
     }
     if (!z_values.empty()) {
-      std::sort(z_values.begin(), z_values.end());
-      floors.back().z = Median(z_values);
+      floors[k].z = Median(&z_values);
+      valid[k] = true;
+    }
+  });
+
+  std::vector<Floor> result;
+  for (size_t k = 0; k < floors.size(); ++k) {
+    if (valid[k]) {
+      result.push_back(std::move(floors[k]));
     } else {
       LOG(ERROR) << "All spans in level are short";
-      floors.pop_back();
     }
   }
-  return floors;
+  return result;
 }
 
 }  // namespace
 
-std::vector<Floor> DetectFloors(const proto::Trajectory& trajectory) {
+std::vector<Floor> DetectFloors(const proto::Trajectory& trajectory,
+                                const int num_threads) {
   const std::vector<Span> spans = SliceByAltitudeChange(trajectory);
   Levels levels;
   for (size_t i = 0; i < spans.size(); ++i) {
     levels[i] = i;
   }
-  GroupSegmentsByAltitude(trajectory, spans, &levels);
+  GroupSegmentsByAltitude(spans, &levels);
 
-  std::vector<Floor> floors = FindFloors(trajectory, spans, levels);
+  const std::vector<bool> is_short =
+      FindShortSpans(trajectory, spans, num_threads);
+  std::vector<Floor> floors =
+      FindFloors(trajectory, spans, is_short, levels, num_threads);
   std::sort(floors.begin(), floors.end(),
             [](const Floor& a, const Floor& b) { return a.z < b.z; });
   return floors;
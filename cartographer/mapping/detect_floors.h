@@ -17,6 +17,8 @@
 #ifndef CARTOGRAPHER_MAPPING_DETECT_FLOORS_H_
 #define CARTOGRAPHER_MAPPING_DETECT_FLOORS_H_
 
+#include <vector>
+
 #include "cartographer/common/time.h"
 #include "cartographer/mapping/proto/trajectory.pb.h"
 
@@ -42,7 +44,12 @@ struct Floor {
 // floors of a building. This requires that floors are *mostly* on the same
 // z-height and that level changes happen *relatively* abrubtly, e.g. by taking
 // the stairs.
-std::vector<Floor> DetectFloors(const proto::Trajectory& trajectory);
+//
+// The trajectory is sliced in a single pass using running medians, the spans
+// and floors are then evaluated on up to 'num_threads' threads. The result
+// does not depend on 'num_threads'.
+std::vector<Floor> DetectFloors(const proto::Trajectory& trajectory,
+                                int num_threads = 1);
 
 }  // namespace mapping
 }  // namespace cartographer
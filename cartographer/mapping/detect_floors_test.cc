@@ -0,0 +1,81 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/detect_floors.h"
+
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+// Walks 'length' meters along x in steps of 0.1 m at height 'z'.
+void Walk(const double length, const double z, proto::Trajectory* trajectory) {
+  for (double x = 0.; x < length; x += 0.1) {
+    auto* const node = trajectory->add_node();
+    node->set_timestamp(trajectory->node_size());
+    node->mutable_pose()->mutable_translation()->set_x(x);
+    node->mutable_pose()->mutable_translation()->set_z(
+        z + 0.01 * (trajectory->node_size() % 7));
+  }
+}
+
+// Two floors connected by a short landing, visited twice.
+proto::Trajectory CreateTrajectory() {
+  proto::Trajectory trajectory;
+  Walk(40., 0., &trajectory);
+  Walk(5., 3., &trajectory);
+  Walk(40., 6., &trajectory);
+  Walk(5., 3., &trajectory);
+  Walk(30., 0., &trajectory);
+  return trajectory;
+}
+
+TEST(DetectFloorsTest, FindsFloors) {
+  const std::vector<Floor> floors = DetectFloors(CreateTrajectory());
+  ASSERT_EQ(floors.size(), 2);
+  EXPECT_NEAR(floors[0].z, 0., 0.1);
+  EXPECT_NEAR(floors[1].z, 6., 0.1);
+  // Both landings are folded into both floors.
+  EXPECT_EQ(floors[0].timespans.size(), 4);
+  EXPECT_EQ(floors[1].timespans.size(), 3);
+}
+
+TEST(DetectFloorsTest, SameResultWithThreads) {
+  const proto::Trajectory trajectory = CreateTrajectory();
+  const std::vector<Floor> expected = DetectFloors(trajectory);
+  const std::vector<Floor> actual = DetectFloors(trajectory, 4);
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i].z, actual[i].z);
+    ASSERT_EQ(expected[i].timespans.size(), actual[i].timespans.size());
+    for (size_t j = 0; j < expected[i].timespans.size(); ++j) {
+      EXPECT_EQ(expected[i].timespans[j].start, actual[i].timespans[j].start);
+      EXPECT_EQ(expected[i].timespans[j].end, actual[i].timespans[j].end);
+    }
+  }
+}
+
+TEST(DetectFloorsTest, SingleNode) {
+  proto::Trajectory trajectory;
+  trajectory.add_node()->mutable_pose()->mutable_translation()->set_z(1.);
+  // A single short span is not a floor.
+  EXPECT_TRUE(DetectFloors(trajectory).empty());
+}
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
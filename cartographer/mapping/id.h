@@ -18,6 +18,7 @@
 #define CARTOGRAPHER_MAPPING_ID_H_
 
 #include <algorithm>
+#include <deque>
 #include <iostream>
 #include <iterator>
 #include <limits>
@@ -28,6 +29,7 @@
 #include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/types/optional.h"
 #include "cartographer/common/port.h"
 #include "cartographer/common/time.h"
 #include "cartographer/mapping/proto/pose_graph.pb.h"
@@ -132,6 +134,11 @@ class Range {
 // 'SubmapId'.
 // Note: This container will only ever contain non-empty trajectories. Trimming
 // the last remaining node of a trajectory drops the trajectory.
+//
+// Since indices are dense and mostly appended, the data of each trajectory is
+// stored contiguously, indexed by its position. Trimmed entries are left empty
+// unless they are at the front or back. References to the data stay valid
+// until it is trimmed, but iterators are invalidated by Insert() and Trim().
 template <typename IdType, typename DataType>
 class MapById {
  private:
@@ -154,20 +161,15 @@ class MapById {
     explicit ConstIterator(const MapById& map_by_id, const int trajectory_id)
         : current_trajectory_(
               map_by_id.trajectories_.lower_bound(trajectory_id)),
-          end_trajectory_(map_by_id.trajectories_.end()) {
-      if (current_trajectory_ != end_trajectory_) {
-        current_data_ = current_trajectory_->second.data_.begin();
-        AdvanceToValidDataIterator();
-      }
-    }
+          end_trajectory_(map_by_id.trajectories_.end()) {}
 
     explicit ConstIterator(const MapById& map_by_id, const IdType& id)
         : current_trajectory_(map_by_id.trajectories_.find(id.trajectory_id)),
           end_trajectory_(map_by_id.trajectories_.end()) {
       if (current_trajectory_ != end_trajectory_) {
-        current_data_ =
-            current_trajectory_->second.data_.find(MapById::GetIndex(id));
-        if (current_data_ == current_trajectory_->second.data_.end()) {
+        const MapByIndex& trajectory = current_trajectory_->second;
+        current_position_ = trajectory.GetPosition(MapById::GetIndex(id));
+        if (!trajectory.Contains(MapById::GetIndex(id))) {
           current_trajectory_ = end_trajectory_;
         }
       }
@@ -175,9 +177,11 @@ class MapById {
 
     IdDataReference operator*() const {
       CHECK(current_trajectory_ != end_trajectory_);
+      const MapByIndex& trajectory = current_trajectory_->second;
       return IdDataReference{
-          IdType{current_trajectory_->first, current_data_->first},
-          current_data_->second};
+          IdType{current_trajectory_->first,
+                 trajectory.first_index_ + static_cast<int>(current_position_)},
+          *trajectory.data_[current_position_]};
     }
 
     std::unique_ptr<const IdDataReference> operator->() const {
@@ -186,18 +190,20 @@ class MapById {
 
     ConstIterator& operator++() {
       CHECK(current_trajectory_ != end_trajectory_);
-      ++current_data_;
-      AdvanceToValidDataIterator();
+      ++current_position_;
+      AdvanceToValidPosition();
       return *this;
     }
 
     ConstIterator& operator--() {
-      while (current_trajectory_ == end_trajectory_ ||
-             current_data_ == current_trajectory_->second.data_.begin()) {
-        --current_trajectory_;
-        current_data_ = current_trajectory_->second.data_.end();
-      }
-      --current_data_;
+      do {
+        while (current_trajectory_ == end_trajectory_ ||
+               current_position_ == 0) {
+          --current_trajectory_;
+          current_position_ = current_trajectory_->second.data_.size();
+        }
+        --current_position_;
+      } while (!current_trajectory_->second.data_[current_position_]);
       return *this;
     }
 
@@ -207,26 +213,32 @@ class MapById {
         return current_trajectory_ == it.current_trajectory_;
       }
       return current_trajectory_ == it.current_trajectory_ &&
-             current_data_ == it.current_data_;
+             current_position_ == it.current_position_;
     }
 
     bool operator!=(const ConstIterator& it) const { return !operator==(it); }
 
    private:
-    void AdvanceToValidDataIterator() {
+    // Skips trimmed entries and moves on to the next trajectory at the end of
+    // the current one.
+    void AdvanceToValidPosition() {
       CHECK(current_trajectory_ != end_trajectory_);
-      while (current_data_ == current_trajectory_->second.data_.end()) {
+      const auto* data = &current_trajectory_->second.data_;
+      while (current_position_ != data->size() &&
+             !(*data)[current_position_]) {
+        ++current_position_;
+      }
+      if (current_position_ == data->size()) {
         ++current_trajectory_;
-        if (current_trajectory_ == end_trajectory_) {
-          return;
-        }
-        current_data_ = current_trajectory_->second.data_.begin();
+        current_position_ = 0;
       }
     }
 
     typename std::map<int, MapByIndex>::const_iterator current_trajectory_;
     typename std::map<int, MapByIndex>::const_iterator end_trajectory_;
-    typename std::map<int, DataType>::const_iterator current_data_;
+    // Position in the 'data_' of 'current_trajectory_'. Trajectories neither
+    // start nor end with a trimmed entry, so position 0 is always valid.
+    size_t current_position_ = 0;
   };
 
   class ConstTrajectoryIterator {
@@ -270,9 +282,12 @@ class MapById {
     CHECK_GE(trajectory_id, 0);
     auto& trajectory = trajectories_[trajectory_id];
     CHECK(trajectory.can_append_);
-    const int index =
-        trajectory.data_.empty() ? 0 : trajectory.data_.rbegin()->first + 1;
-    trajectory.data_.emplace(index, data);
+    const int index = trajectory.data_.empty()
+                          ? 0
+                          : trajectory.first_index_ +
+                                static_cast<int>(trajectory.data_.size());
+    trajectory.data_.emplace_back(data);
+    ++trajectory.size_;
     return IdType{trajectory_id, index};
   }
 
@@ -285,41 +300,82 @@ class MapById {
   // Inserts data (which must not exist already) into a trajectory.
   void Insert(const IdType& id, const DataType& data) {
     CHECK_GE(id.trajectory_id, 0);
-    CHECK_GE(GetIndex(id), 0);
+    const int index = GetIndex(id);
+    CHECK_GE(index, 0);
     auto& trajectory = trajectories_[id.trajectory_id];
     trajectory.can_append_ = false;
-    CHECK(trajectory.data_.emplace(GetIndex(id), data).second);
+    if (trajectory.data_.empty()) {
+      trajectory.first_index_ = index;
+    }
+    while (index < trajectory.first_index_) {
+      trajectory.data_.emplace_front();
+      --trajectory.first_index_;
+    }
+    while (trajectory.GetPosition(index) >= trajectory.data_.size()) {
+      trajectory.data_.emplace_back();
+    }
+    auto& entry = trajectory.data_[trajectory.GetPosition(index)];
+    CHECK(!entry) << id;
+    entry.emplace(data);
+    ++trajectory.size_;
   }
 
   // Removes the data for 'id' which must exist.
   void Trim(const IdType& id) {
     auto& trajectory = trajectories_.at(id.trajectory_id);
-    const auto it = trajectory.data_.find(GetIndex(id));
-    CHECK(it != trajectory.data_.end()) << id;
-    if (std::next(it) == trajectory.data_.end()) {
+    const int index = GetIndex(id);
+    CHECK(trajectory.Contains(index)) << id;
+    const size_t position = trajectory.GetPosition(index);
+    if (position + 1 == trajectory.data_.size()) {
       // We are removing the data with the highest index from this trajectory.
       // We assume that we will never append to it anymore. If we did, we would
       // have to make sure that gaps in indices are properly chosen to maintain
       // correct connectivity.
       trajectory.can_append_ = false;
     }
-    trajectory.data_.erase(it);
-    if (trajectory.data_.empty()) {
+    trajectory.data_[position].reset();
+    --trajectory.size_;
+    if (trajectory.size_ == 0) {
       trajectories_.erase(id.trajectory_id);
+      return;
+    }
+    while (!trajectory.data_.front()) {
+      trajectory.data_.pop_front();
+      ++trajectory.first_index_;
+    }
+    while (!trajectory.data_.back()) {
+      trajectory.data_.pop_back();
+    }
+  }
+
+  // Removes all data of 'trajectory_id' and returns it, so that the caller
+  // can choose where to free it. Returns an empty map if the trajectory does
+  // not exist.
+  MapById ExtractTrajectory(const int trajectory_id) {
+    MapById result;
+    const auto it = trajectories_.find(trajectory_id);
+    if (it != trajectories_.end()) {
+      result.trajectories_.emplace(trajectory_id, std::move(it->second));
+      trajectories_.erase(it);
     }
+    return result;
   }
 
   bool Contains(const IdType& id) const {
     return trajectories_.count(id.trajectory_id) != 0 &&
-           trajectories_.at(id.trajectory_id).data_.count(GetIndex(id)) != 0;
+           trajectories_.at(id.trajectory_id).Contains(GetIndex(id));
   }
 
   const DataType& at(const IdType& id) const {
-    return trajectories_.at(id.trajectory_id).data_.at(GetIndex(id));
+    const MapByIndex& trajectory = trajectories_.at(id.trajectory_id);
+    CHECK(trajectory.Contains(GetIndex(id))) << id;
+    return *trajectory.data_[trajectory.GetPosition(GetIndex(id))];
   }
 
   DataType& at(const IdType& id) {
-    return trajectories_.at(id.trajectory_id).data_.at(GetIndex(id));
+    MapByIndex& trajectory = trajectories_.at(id.trajectory_id);
+    CHECK(trajectory.Contains(GetIndex(id))) << id;
+    return *trajectory.data_[trajectory.GetPosition(GetIndex(id))];
   }
 
   // Support querying by trajectory.
@@ -333,7 +389,7 @@ class MapById {
   // Returns 0 if 'trajectory_id' does not exist.
   size_t SizeOfTrajectoryOrZero(const int trajectory_id) const {
     return trajectories_.count(trajectory_id)
-               ? trajectories_.at(trajectory_id).data_.size()
+               ? trajectories_.at(trajectory_id).size_
                : 0;
   }
 
@@ -341,7 +397,7 @@ class MapById {
   size_t size() const {
     size_t size = 0;
     for (const auto& item : trajectories_) {
-      size += item.second.data_.size();
+      size += item.second.size_;
     }
     return size;
   }
@@ -376,39 +432,59 @@ class MapById {
       return EndOfTrajectory(trajectory_id);
     }
 
-    const std::map<int, DataType>& trajectory =
-        trajectories_.at(trajectory_id).data_;
+    const MapByIndex& trajectory = trajectories_.at(trajectory_id);
+    const auto& data = trajectory.data_;
 
-    if (internal::GetTime(std::prev(trajectory.end())->second) < time) {
+    if (internal::GetTime(*data.back()) < time) {
       return EndOfTrajectory(trajectory_id);
     }
 
-    auto left = trajectory.begin();
-    auto right = std::prev(trajectory.end());
+    // 'left' and 'right' are always positions of data which was not trimmed.
+    size_t left = 0;
+    size_t right = data.size() - 1;
     while (left != right) {
-      // This is never 'right' which is important to guarantee progress.
-      const int middle = left->first + (right->first - left->first) / 2;
-      // This could be 'right' in the presence of gaps, so we need to use the
-      // previous element in this case.
-      auto lower_bound_middle = trajectory.lower_bound(middle);
-      if (lower_bound_middle->first > middle) {
-        CHECK(lower_bound_middle != left);
-        lower_bound_middle = std::prev(lower_bound_middle);
+      // This is never 'right' which is important to guarantee progress. In the
+      // presence of gaps, we use the previous data which was not trimmed.
+      size_t middle = left + (right - left) / 2;
+      while (!data[middle]) {
+        --middle;
       }
-      if (internal::GetTime(lower_bound_middle->second) < time) {
-        left = std::next(lower_bound_middle);
+      if (internal::GetTime(*data[middle]) < time) {
+        left = middle + 1;
+        while (!data[left]) {
+          ++left;
+        }
       } else {
-        right = lower_bound_middle;
+        right = middle;
       }
     }
 
-    return ConstIterator(*this, IdType{trajectory_id, left->first});
+    return ConstIterator(
+        *this, IdType{trajectory_id,
+                      trajectory.first_index_ + static_cast<int>(left)});
   }
 
  private:
   struct MapByIndex {
+    // Returns the position in 'data_' of 'index', which is only meaningful if
+    // 'index' is at least 'first_index_'.
+    size_t GetPosition(const int index) const {
+      return static_cast<size_t>(index - first_index_);
+    }
+
+    bool Contains(const int index) const {
+      return index >= first_index_ && GetPosition(index) < data_.size() &&
+             data_[GetPosition(index)].has_value();
+    }
+
     bool can_append_ = true;
-    std::map<int, DataType> data_;
+    // Index of the data at the front of 'data_'.
+    int first_index_ = 0;
+    // Data by position, empty if trimmed. The front and back are never empty.
+    // A deque keeps references valid when growing at either end.
+    std::deque<absl::optional<DataType>> data_;
+    // Number of entries in 'data_' which are not empty.
+    size_t size_ = 0;
   };
 
   static int GetIndex(const NodeId& id) { return id.node_index; }
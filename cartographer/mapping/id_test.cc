@@ -93,6 +93,20 @@ TEST(IdTest, DeleteTrajectory) {
   EXPECT_FALSE(map_by_id.empty());
 }
 
+TEST(IdTest, ExtractTrajectory) {
+  MapById<NodeId, int> map_by_id = CreateTestMapById<NodeId>();
+  const MapById<NodeId, int> extracted = map_by_id.ExtractTrajectory(7);
+  EXPECT_EQ(3, map_by_id.size());
+  EXPECT_EQ(0, map_by_id.SizeOfTrajectoryOrZero(7));
+  EXPECT_EQ(1, extracted.size());
+  EXPECT_EQ(2, extracted.BeginOfTrajectory(7)->data);
+  EXPECT_EQ(1, std::distance(extracted.trajectory_ids().begin(),
+                             extracted.trajectory_ids().end()));
+  EXPECT_TRUE(map_by_id.ExtractTrajectory(7).empty());
+  // Appending to the extracted trajectory starts it anew.
+  EXPECT_EQ((NodeId{7, 0}), map_by_id.Append(7, 1));
+}
+
 TEST(IdTest, MapByIdIterator) {
   MapById<NodeId, int> map_by_id = CreateTestMapById<NodeId>();
   EXPECT_EQ(4, map_by_id.size());
@@ -176,6 +190,57 @@ TEST(IdTest, InsertIntoMapById) {
   EXPECT_EQ(2, map_by_id.SizeOfTrajectoryOrZero(42));
 }
 
+TEST(IdTest, TrimmedEntriesAreSkipped) {
+  MapById<NodeId, int> map_by_id;
+  for (int i = 0; i != 6; ++i) {
+    map_by_id.Append(3, i);
+  }
+  map_by_id.Trim(NodeId{3, 0});
+  map_by_id.Trim(NodeId{3, 2});
+  map_by_id.Trim(NodeId{3, 3});
+  map_by_id.Trim(NodeId{3, 5});
+  EXPECT_EQ(2, map_by_id.size());
+  EXPECT_EQ(2, map_by_id.SizeOfTrajectoryOrZero(3));
+  EXPECT_FALSE(map_by_id.Contains(NodeId{3, 2}));
+  EXPECT_TRUE(map_by_id.find(NodeId{3, 3}) == map_by_id.end());
+  std::deque<std::pair<NodeId, int>> expected_id_data = {
+      {NodeId{3, 1}, 1},
+      {NodeId{3, 4}, 4},
+  };
+  for (const auto& id_data : map_by_id) {
+    ASSERT_FALSE(expected_id_data.empty());
+    EXPECT_EQ(expected_id_data.front().first, id_data.id);
+    EXPECT_EQ(expected_id_data.front().second, id_data.data);
+    expected_id_data.pop_front();
+  }
+  EXPECT_TRUE(expected_id_data.empty());
+  EXPECT_EQ(NodeId(3, 4), std::prev(map_by_id.end())->id);
+  EXPECT_EQ(NodeId(3, 1), std::prev(map_by_id.end(), 2)->id);
+}
+
+TEST(IdTest, InsertBeforeFirstIndex) {
+  MapById<SubmapId, int> map_by_id;
+  map_by_id.Insert(SubmapId{0, 5}, 5);
+  map_by_id.Insert(SubmapId{0, 2}, 2);
+  map_by_id.Insert(SubmapId{0, 8}, 8);
+  EXPECT_EQ(3, map_by_id.size());
+  EXPECT_FALSE(map_by_id.Contains(SubmapId{0, 3}));
+  EXPECT_EQ(SubmapId(0, 2), map_by_id.begin()->id);
+  EXPECT_EQ(5, map_by_id.at(SubmapId{0, 5}));
+  EXPECT_EQ(8, std::prev(map_by_id.end())->data);
+}
+
+TEST(IdTest, ReferencesStayValidWhenAppending) {
+  MapById<NodeId, int> map_by_id;
+  const NodeId first_id = map_by_id.Append(0, 42);
+  const int& first_data = map_by_id.at(first_id);
+  for (int i = 0; i != 10000; ++i) {
+    map_by_id.Append(0, i);
+  }
+  map_by_id.Trim(NodeId{0, 1});
+  EXPECT_EQ(42, first_data);
+}
+
 TEST(IdTest, FindNodeId) {
   MapById<NodeId, int> map_by_id;
   map_by_id.Append(42, 42);
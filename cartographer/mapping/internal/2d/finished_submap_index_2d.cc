@@ -0,0 +1,103 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/2d/finished_submap_index_2d.h"
+
+#include <cmath>
+
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace mapping {
+
+FinishedSubmapIndex2D::FinishedSubmapIndex2D(const double cell_size)
+    : cell_size_(cell_size) {
+  CHECK_GT(cell_size_, 0.);
+}
+
+void FinishedSubmapIndex2D::Clear() { trajectories_.clear(); }
+
+void FinishedSubmapIndex2D::Insert(const SubmapId& submap_id,
+                                   const Eigen::Vector2d& position,
+                                   const common::Time last_node_time) {
+  TrajectoryIndex& trajectory_index = trajectories_[submap_id.trajectory_id];
+  trajectory_index.submap_ids.push_back(submap_id);
+  trajectory_index.cells[GetCellIndex(position)].push_back(submap_id);
+  trajectory_index.by_last_node_time.emplace(last_node_time, submap_id);
+}
+
+std::vector<int> FinishedSubmapIndex2D::trajectory_ids() const {
+  std::vector<int> trajectory_ids;
+  for (const auto& trajectory : trajectories_) {
+    trajectory_ids.push_back(trajectory.first);
+  }
+  return trajectory_ids;
+}
+
+void FinishedSubmapIndex2D::GetAll(const int trajectory_id,
+                                   std::vector<SubmapId>* submap_ids) const {
+  const auto it = trajectories_.find(trajectory_id);
+  if (it == trajectories_.end()) {
+    return;
+  }
+  submap_ids->insert(submap_ids->end(), it->second.submap_ids.begin(),
+                     it->second.submap_ids.end());
+}
+
+void FinishedSubmapIndex2D::GetNear(const int trajectory_id,
+                                    const Eigen::Vector2d& position,
+                                    std::vector<SubmapId>* submap_ids) const {
+  const auto it = trajectories_.find(trajectory_id);
+  if (it == trajectories_.end()) {
+    return;
+  }
+  const std::pair<int, int> min_cell_index =
+      GetCellIndex(position - Eigen::Vector2d::Constant(cell_size_));
+  const std::pair<int, int> max_cell_index =
+      GetCellIndex(position + Eigen::Vector2d::Constant(cell_size_));
+  for (int x = min_cell_index.first; x <= max_cell_index.first; ++x) {
+    for (int y = min_cell_index.second; y <= max_cell_index.second; ++y) {
+      const auto cell_it = it->second.cells.find(std::make_pair(x, y));
+      if (cell_it != it->second.cells.end()) {
+        submap_ids->insert(submap_ids->end(), cell_it->second.begin(),
+                           cell_it->second.end());
+      }
+    }
+  }
+}
+
+void FinishedSubmapIndex2D::GetWithLastNodeNotBefore(
+    const int trajectory_id, const common::Time time,
+    std::vector<SubmapId>* submap_ids) const {
+  const auto it = trajectories_.find(trajectory_id);
+  if (it == trajectories_.end()) {
+    return;
+  }
+  for (auto time_it = it->second.by_last_node_time.lower_bound(time);
+       time_it != it->second.by_last_node_time.end(); ++time_it) {
+    submap_ids->push_back(time_it->second);
+  }
+}
+
+std::pair<int, int> FinishedSubmapIndex2D::GetCellIndex(
+    const Eigen::Vector2d& position) const {
+  return std::make_pair(
+      static_cast<int>(std::floor(position.x() / cell_size_)),
+      static_cast<int>(std::floor(position.y() / cell_size_)));
+}
+
+}  // namespace mapping
+}  // namespace cartographer
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_MAPPING_INTERNAL_2D_FINISHED_SUBMAP_INDEX_2D_H_
+#define CARTOGRAPHER_MAPPING_INTERNAL_2D_FINISHED_SUBMAP_INDEX_2D_H_
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "Eigen/Core"
+#include "cartographer/common/time.h"
+#include "cartographer/mapping/id.h"
+
+namespace cartographer {
+namespace mapping {
+
+// Index of finished submaps by trajectory, by global position and by the time
+// of their last node. It lets the constraint search only look at the submaps
+// which can be matched against a node, instead of at all finished submaps.
+//
+// Positions are hashed into a uniform grid with cells of 'cell_size', so
+// queries for submaps near a position may also return submaps which are up to
+// about two cells away.
+class FinishedSubmapIndex2D {
+ public:
+  explicit FinishedSubmapIndex2D(double cell_size);
+
+  void Clear();
+
+  // 'submap_id' must not be in the index yet.
+  void Insert(const SubmapId& submap_id, const Eigen::Vector2d& position,
+              common::Time last_node_time);
+
+  std::vector<int> trajectory_ids() const;
+
+  // The following functions append to 'submap_ids' and may append the same
+  // submap more than once.
+  //
+  // Appends all submaps of 'trajectory_id'.
+  void GetAll(int trajectory_id, std::vector<SubmapId>* submap_ids) const;
+  // Appends at least the submaps of 'trajectory_id' within 'cell_size' of
+  // 'position'.
+  void GetNear(int trajectory_id, const Eigen::Vector2d& position,
+               std::vector<SubmapId>* submap_ids) const;
+  // Appends the submaps of 'trajectory_id' whose last node is not before
+  // 'time'.
+  void GetWithLastNodeNotBefore(int trajectory_id, common::Time time,
+                                std::vector<SubmapId>* submap_ids) const;
+
+ private:
+  struct TrajectoryIndex {
+    std::vector<SubmapId> submap_ids;
+    std::map<std::pair<int, int>, std::vector<SubmapId>> cells;
+    std::multimap<common::Time, SubmapId> by_last_node_time;
+  };
+
+  std::pair<int, int> GetCellIndex(const Eigen::Vector2d& position) const;
+
+  const double cell_size_;
+  std::map<int, TrajectoryIndex> trajectories_;
+};
+
+}  // namespace mapping
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_MAPPING_INTERNAL_2D_FINISHED_SUBMAP_INDEX_2D_H_
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/2d/finished_submap_index_2d.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "cartographer/common/time.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+TEST(FinishedSubmapIndex2DTest, EmptyIndex) {
+  FinishedSubmapIndex2D index(10.);
+  std::vector<SubmapId> submap_ids;
+  index.GetAll(0, &submap_ids);
+  index.GetNear(0, Eigen::Vector2d::Zero(), &submap_ids);
+  index.GetWithLastNodeNotBefore(0, common::FromUniversal(0), &submap_ids);
+  EXPECT_THAT(submap_ids, IsEmpty());
+  EXPECT_THAT(index.trajectory_ids(), IsEmpty());
+}
+
+TEST(FinishedSubmapIndex2DTest, GetAllAndLastNodeTime) {
+  FinishedSubmapIndex2D index(10.);
+  index.Insert(SubmapId{0, 0}, Eigen::Vector2d(0., 0.),
+               common::FromUniversal(10));
+  index.Insert(SubmapId{0, 1}, Eigen::Vector2d(100., 0.),
+               common::FromUniversal(20));
+  index.Insert(SubmapId{2, 0}, Eigen::Vector2d(0., 0.),
+               common::FromUniversal(30));
+  EXPECT_THAT(index.trajectory_ids(), ElementsAre(0, 2));
+
+  std::vector<SubmapId> submap_ids;
+  index.GetAll(0, &submap_ids);
+  EXPECT_THAT(submap_ids, ElementsAre(SubmapId{0, 0}, SubmapId{0, 1}));
+
+  submap_ids.clear();
+  index.GetWithLastNodeNotBefore(0, common::FromUniversal(20), &submap_ids);
+  EXPECT_THAT(submap_ids, ElementsAre(SubmapId{0, 1}));
+
+  index.Clear();
+  EXPECT_THAT(index.trajectory_ids(), IsEmpty());
+}
+
+TEST(FinishedSubmapIndex2DTest, GetNearReturnsAllSubmapsWithinCellSize) {
+  constexpr double kCellSize = 5.;
+  FinishedSubmapIndex2D index(kCellSize);
+  std::mt19937 prng(42);
+  std::uniform_real_distribution<double> distribution(-50., 50.);
+  std::vector<Eigen::Vector2d> positions;
+  for (int i = 0; i != 1000; ++i) {
+    positions.emplace_back(distribution(prng), distribution(prng));
+    index.Insert(SubmapId{0, i}, positions.back(), common::FromUniversal(i));
+  }
+  for (int j = 0; j != 100; ++j) {
+    const Eigen::Vector2d query(distribution(prng), distribution(prng));
+    std::vector<SubmapId> submap_ids;
+    index.GetNear(0, query, &submap_ids);
+    EXPECT_LT(submap_ids.size(), positions.size());
+    std::sort(submap_ids.begin(), submap_ids.end());
+    for (int i = 0; i != static_cast<int>(positions.size()); ++i) {
+      if ((positions[i] - query).norm() <= kCellSize) {
+        EXPECT_TRUE(std::binary_search(submap_ids.begin(), submap_ids.end(),
+                                       SubmapId{0, i}));
+      }
+    }
+  }
+  std::vector<SubmapId> submap_ids;
+  index.GetNear(1, Eigen::Vector2d::Zero(), &submap_ids);
+  EXPECT_THAT(submap_ids, IsEmpty());
+}
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
@@ -16,10 +16,15 @@
 
 #include "cartographer/mapping/internal/2d/local_trajectory_builder_2d.h"
 
+#include <algorithm>
 #include <limits>
 #include <memory>
 
 #include "absl/memory/memory.h"
+#include "cartographer/common/math.h"
+#include "cartographer/common/task.h"
+#include "cartographer/common/tracing.h"
+#include "cartographer/mapping/internal/motion_compensation.h"
 #include "cartographer/metrics/family_factory.h"
 #include "cartographer/sensor/range_data.h"
 
@@ -29,11 +34,44 @@ namespace mapping {
 static auto* kLocalSlamLatencyMetric = metrics::Gauge::Null();
 static auto* kLocalSlamRealTimeRatio = metrics::Gauge::Null();
 static auto* kLocalSlamCpuRealTimeRatio = metrics::Gauge::Null();
+static auto* kLocalSlamDurationMetric = metrics::Histogram::Null();
 static auto* kRealTimeCorrelativeScanMatcherScoreMetric =
     metrics::Histogram::Null();
 static auto* kCeresScanMatcherCostMetric = metrics::Histogram::Null();
+static auto* kCeresScanMatcherIterationsMetric = metrics::Histogram::Null();
 static auto* kScanMatcherResidualDistanceMetric = metrics::Histogram::Null();
 static auto* kScanMatcherResidualAngleMetric = metrics::Histogram::Null();
+static auto* kReducedSearchWindowMetric = metrics::Counter::Null();
+static auto* kCappedCeresIterationsMetric = metrics::Counter::Null();
+static auto* kSkippedInsertionMetric = metrics::Counter::Null();
+static auto* kStationaryRangeDataMetric = metrics::Counter::Null();
+static auto* kScratchMemoryMetric = metrics::Gauge::Null();
+
+namespace {
+
+uint64 GetCellKey(const Eigen::Vector3f& position, const float cell_size) {
+  const int32 x = common::RoundToInt(position.x() / cell_size);
+  const int32 y = common::RoundToInt(position.y() / cell_size);
+  return (static_cast<uint64>(static_cast<uint32>(x)) << 32) |
+         static_cast<uint32>(y);
+}
+
+absl::flat_hash_set<uint64> ComputeOccupiedCells(
+    const sensor::PointCloud& point_cloud, const float cell_size) {
+  absl::flat_hash_set<uint64> cells;
+  cells.reserve(point_cloud.size());
+  for (const sensor::RangefinderPoint& point : point_cloud) {
+    cells.insert(GetCellKey(point.position, cell_size));
+  }
+  return cells;
+}
+
+size_t MemoryUsageInBytes(const sensor::RangeData& range_data) {
+  return range_data.returns.MemoryUsageInBytes() +
+         range_data.misses.MemoryUsageInBytes();
+}
+
+}  // namespace
 
 LocalTrajectoryBuilder2D::LocalTrajectoryBuilder2D(
     const proto::LocalTrajectoryBuilderOptions2D& options,
@@ -44,27 +82,111 @@ LocalTrajectoryBuilder2D::LocalTrajectoryBuilder2D(
       real_time_correlative_scan_matcher_(
           options_.real_time_correlative_scan_matcher_options()),
       ceres_scan_matcher_(options_.ceres_scan_matcher_options()),
-      range_data_collator_(expected_range_sensor_ids) {}
+      range_data_collator_(expected_range_sensor_ids) {
+  if (options_.pipeline_submap_insertion()) {
+    // Inserting is on the critical path of local SLAM, so the thread is not
+    // niced like background work.
+    insertion_thread_pool_ = absl::make_unique<common::ThreadPool>(
+        1, 0 /* nice_increment */, std::vector<int>());
+  }
+  const auto& deadline_options = options_.scan_matching_deadline_options();
+  if (deadline_options.time_budget() > 0.) {
+    auto real_time_correlative_scan_matcher_options =
+        options_.real_time_correlative_scan_matcher_options();
+    real_time_correlative_scan_matcher_options.set_linear_search_window(
+        deadline_options.search_window_factor() *
+        real_time_correlative_scan_matcher_options.linear_search_window());
+    real_time_correlative_scan_matcher_options.set_angular_search_window(
+        deadline_options.search_window_factor() *
+        real_time_correlative_scan_matcher_options.angular_search_window());
+    degraded_real_time_correlative_scan_matcher_ =
+        absl::make_unique<scan_matching::RealTimeCorrelativeScanMatcher2D>(
+            real_time_correlative_scan_matcher_options);
+    auto ceres_scan_matcher_options = options_.ceres_scan_matcher_options();
+    auto* const ceres_solver_options =
+        ceres_scan_matcher_options.mutable_ceres_solver_options();
+    ceres_solver_options->set_max_num_iterations(
+        std::min(ceres_solver_options->max_num_iterations(),
+                 deadline_options.max_num_ceres_iterations()));
+    degraded_ceres_scan_matcher_ =
+        absl::make_unique<scan_matching::CeresScanMatcher2D>(
+            ceres_scan_matcher_options);
+  }
+}
 
-LocalTrajectoryBuilder2D::~LocalTrajectoryBuilder2D() {}
+LocalTrajectoryBuilder2D::~LocalTrajectoryBuilder2D() {
+  if (pending_insertion_ != nullptr) {
+    pending_insertion_->WaitForNotification();
+  }
+}
 
-sensor::RangeData
+const sensor::RangeData&
 LocalTrajectoryBuilder2D::TransformToGravityAlignedFrameAndFilter(
     const transform::Rigid3f& transform_to_gravity_aligned_frame,
-    const sensor::RangeData& range_data) const {
-  const sensor::RangeData cropped =
-      sensor::CropRangeData(sensor::TransformRangeData(
-                                range_data, transform_to_gravity_aligned_frame),
-                            options_.min_z(), options_.max_z());
-  return sensor::RangeData{
-      cropped.origin,
-      sensor::VoxelFilter(cropped.returns, options_.voxel_filter_size()),
-      sensor::VoxelFilter(cropped.misses, options_.voxel_filter_size())};
+    const sensor::RangeData& range_data) {
+  sensor::TransformAndCropPointCloud(
+      range_data.returns, transform_to_gravity_aligned_frame, options_.min_z(),
+      options_.max_z(), &scan_buffers_.cropped_returns);
+  sensor::TransformAndCropPointCloud(
+      range_data.misses, transform_to_gravity_aligned_frame, options_.min_z(),
+      options_.max_z(), &scan_buffers_.cropped_misses);
+  sensor::RangeData& result = scan_buffers_.gravity_aligned_range_data;
+  result.origin = transform_to_gravity_aligned_frame * range_data.origin;
+  sensor::VoxelFilter(scan_buffers_.cropped_returns,
+                      options_.voxel_filter_size(),
+                      &scan_buffers_.voxel_filter_scratch, &result.returns);
+  sensor::VoxelFilter(scan_buffers_.cropped_misses,
+                      options_.voxel_filter_size(),
+                      &scan_buffers_.voxel_filter_scratch, &result.misses);
+  return result;
+}
+
+bool LocalTrajectoryBuilder2D::IsOverTimeBudget(
+    const std::chrono::steady_clock::time_point start_time) const {
+  const double time_budget =
+      options_.scan_matching_deadline_options().time_budget();
+  return time_budget > 0. &&
+         common::ToSeconds(std::chrono::steady_clock::now() - start_time) >
+             time_budget;
+}
+
+bool LocalTrajectoryBuilder2D::IsStationary(
+    const transform::Rigid2d& pose_prediction,
+    const sensor::PointCloud& filtered_gravity_aligned_point_cloud) const {
+  // Without points there is no evidence that the scene did not change.
+  if (!options_.use_stationary_detection() ||
+      !last_scan_matched_pose_.has_value() ||
+      filtered_gravity_aligned_point_cloud.empty()) {
+    return false;
+  }
+  const auto& stationary_detection_options =
+      options_.stationary_detection_options();
+  const transform::Rigid2d motion =
+      last_scan_matched_pose_.value().inverse() * pose_prediction;
+  if (motion.translation().norm() >
+          stationary_detection_options.max_translation() ||
+      std::abs(motion.rotation().angle()) >
+          stationary_detection_options.max_angle_radians()) {
+    return false;
+  }
+  const float cell_size = stationary_detection_options.cell_size();
+  int num_overlapping_points = 0;
+  for (const sensor::RangefinderPoint& point :
+       filtered_gravity_aligned_point_cloud) {
+    if (last_scan_matched_cells_.contains(
+            GetCellKey(point.position, cell_size))) {
+      ++num_overlapping_points;
+    }
+  }
+  return num_overlapping_points >=
+         stationary_detection_options.min_overlap() *
+             filtered_gravity_aligned_point_cloud.size();
 }
 
 std::unique_ptr<transform::Rigid2d> LocalTrajectoryBuilder2D::ScanMatch(
     const common::Time time, const transform::Rigid2d& pose_prediction,
-    const sensor::PointCloud& filtered_gravity_aligned_point_cloud) {
+    const sensor::PointCloud& filtered_gravity_aligned_point_cloud,
+    const std::chrono::steady_clock::time_point start_time) {
   if (active_submaps_.submaps().empty()) {
     return absl::make_unique<transform::Rigid2d>(pose_prediction);
   }
@@ -75,20 +197,35 @@ std::unique_ptr<transform::Rigid2d> LocalTrajectoryBuilder2D::ScanMatch(
   transform::Rigid2d initial_ceres_pose = pose_prediction;
 
   if (options_.use_online_correlative_scan_matching()) {
-    const double score = real_time_correlative_scan_matcher_.Match(
+    const scan_matching::RealTimeCorrelativeScanMatcher2D&
+        real_time_correlative_scan_matcher =
+            over_time_budget_ ? *degraded_real_time_correlative_scan_matcher_
+                              : real_time_correlative_scan_matcher_;
+    if (over_time_budget_) kReducedSearchWindowMetric->Increment();
+    const double score = real_time_correlative_scan_matcher.Match(
         pose_prediction, filtered_gravity_aligned_point_cloud,
         *matching_submap->grid(), &initial_ceres_pose);
     kRealTimeCorrelativeScanMatcherScoreMetric->Observe(score);
   }
 
+  // Caps the Ceres iterations if the correlative scan matcher alone already
+  // used up the budget.
+  const bool cap_ceres_iterations =
+      over_time_budget_ || IsOverTimeBudget(start_time);
+  const scan_matching::CeresScanMatcher2D& ceres_scan_matcher =
+      cap_ceres_iterations ? *degraded_ceres_scan_matcher_
+                           : ceres_scan_matcher_;
+  if (cap_ceres_iterations) kCappedCeresIterationsMetric->Increment();
   auto pose_observation = absl::make_unique<transform::Rigid2d>();
   ceres::Solver::Summary summary;
-  ceres_scan_matcher_.Match(pose_prediction.translation(), initial_ceres_pose,
-                            filtered_gravity_aligned_point_cloud,
-                            *matching_submap->grid(), pose_observation.get(),
-                            &summary);
+  ceres_scan_matcher.Match(pose_prediction.translation(), initial_ceres_pose,
+                           filtered_gravity_aligned_point_cloud,
+                           *matching_submap->grid(), pose_observation.get(),
+                           &summary, &ceres_warm_start_state_);
   if (pose_observation) {
     kCeresScanMatcherCostMetric->Observe(summary.final_cost);
+    kCeresScanMatcherIterationsMetric->Observe(
+        summary.num_successful_steps + summary.num_unsuccessful_steps);
     const double residual_distance =
         (pose_observation->translation() - pose_prediction.translation())
             .norm();
@@ -104,15 +241,18 @@ std::unique_ptr<transform::Rigid2d> LocalTrajectoryBuilder2D::ScanMatch(
 std::unique_ptr<LocalTrajectoryBuilder2D::MatchingResult>
 LocalTrajectoryBuilder2D::AddRangeData(
     const std::string& sensor_id,
-    const sensor::TimedPointCloudData& unsynchronized_data) {
-  auto synchronized_data =
-      range_data_collator_.AddRangeData(sensor_id, unsynchronized_data);
+    sensor::TimedPointCloudData unsynchronized_data) {
+  sensor::TimedPointCloudOriginData& synchronized_data = synchronized_data_;
+  range_data_collator_.AddRangeData(sensor_id, std::move(unsynchronized_data),
+                                    &synchronized_data);
   if (synchronized_data.ranges.empty()) {
     LOG(INFO) << "Range data collator filling buffer.";
     return nullptr;
   }
 
   const common::Time& time = synchronized_data.time;
+  CARTOGRAPHER_TRACE_SPAN("LocalTrajectoryBuilder2D::AddRangeData",
+                          common::ToUniversal(time));
   // Initialize extrapolator now if we do not ever use an IMU.
   if (!options_.use_imu_data()) {
     InitializeExtrapolator(time);
@@ -136,22 +276,46 @@ LocalTrajectoryBuilder2D::AddRangeData(
     return nullptr;
   }
 
-  std::vector<transform::Rigid3f> range_data_poses;
-  range_data_poses.reserve(synchronized_data.ranges.size());
+  std::vector<common::Time>& point_times = scan_buffers_.point_times;
+  point_times.clear();
+  point_times.reserve(synchronized_data.ranges.size());
   bool warned = false;
+  common::Time prev_time_point = extrapolator_->GetLastExtrapolatedTime();
   for (const auto& range : synchronized_data.ranges) {
     common::Time time_point = time + common::FromSeconds(range.point_time.time);
-    if (time_point < extrapolator_->GetLastExtrapolatedTime()) {
+    if (time_point < prev_time_point) {
       if (!warned) {
         LOG(ERROR)
             << "Timestamp of individual range data point jumps backwards from "
-            << extrapolator_->GetLastExtrapolatedTime() << " to " << time_point;
+            << prev_time_point << " to " << time_point;
         warned = true;
       }
-      time_point = extrapolator_->GetLastExtrapolatedTime();
+      time_point = prev_time_point;
+    }
+    point_times.push_back(time_point);
+    prev_time_point = time_point;
+  }
+
+  std::vector<transform::Rigid3f> range_data_poses;
+  if (options_.motion_compensation_interval() > 0.) {
+    SelectMotionCompensationSampleTimes(
+        point_times,
+        common::FromSeconds(options_.motion_compensation_interval()),
+        &scan_buffers_.sample_times);
+    scan_buffers_.sample_poses.clear();
+    for (const common::Time sample_time : scan_buffers_.sample_times) {
+      scan_buffers_.sample_poses.push_back(
+          extrapolator_->ExtrapolatePose(sample_time).cast<float>());
+    }
+    InterpolateMotionCompensationPoses(scan_buffers_.sample_times,
+                                       scan_buffers_.sample_poses, point_times,
+                                       &range_data_poses);
+  } else {
+    range_data_poses.reserve(point_times.size());
+    for (const common::Time time_point : point_times) {
+      range_data_poses.push_back(
+          extrapolator_->ExtrapolatePose(time_point).cast<float>());
     }
-    range_data_poses.push_back(
-        extrapolator_->ExtrapolatePose(time_point).cast<float>());
   }
 
   if (num_accumulated_ == 0) {
@@ -198,12 +362,17 @@ LocalTrajectoryBuilder2D::AddRangeData(
     // TODO(gaschler): This assumes that 'range_data_poses.back()' is at time
     // 'time'.
     accumulated_range_data_.origin = range_data_poses.back().translation();
-    return AddAccumulatedRangeData(
+    const auto start_time = std::chrono::steady_clock::now();
+    std::unique_ptr<MatchingResult> matching_result = AddAccumulatedRangeData(
         time,
         TransformToGravityAlignedFrameAndFilter(
             gravity_alignment.cast<float>() * range_data_poses.back().inverse(),
             accumulated_range_data_),
         gravity_alignment, sensor_duration);
+    kLocalSlamDurationMetric->Observe(
+        common::ToSeconds(std::chrono::steady_clock::now() - start_time));
+    kScratchMemoryMetric->Set(ScratchMemoryUsageInBytes());
+    return matching_result;
   }
   return nullptr;
 }
@@ -214,9 +383,13 @@ LocalTrajectoryBuilder2D::AddAccumulatedRangeData(
     const sensor::RangeData& gravity_aligned_range_data,
     const transform::Rigid3d& gravity_alignment,
     const absl::optional<common::Duration>& sensor_duration) {
+  const auto start_time = std::chrono::steady_clock::now();
+  // Scan matching needs the submaps with the previous range data inserted.
+  std::unique_ptr<MatchingResult> previous_matching_result =
+      FinishPendingInsertion();
   if (gravity_aligned_range_data.returns.empty()) {
     LOG(WARNING) << "Dropped empty horizontal range data.";
-    return nullptr;
+    return previous_matching_result;
   }
 
   // Computes a gravity aligned pose prediction.
@@ -229,28 +402,69 @@ LocalTrajectoryBuilder2D::AddAccumulatedRangeData(
       sensor::AdaptiveVoxelFilter(gravity_aligned_range_data.returns,
                                   options_.adaptive_voxel_filter_options());
   if (filtered_gravity_aligned_point_cloud.empty()) {
-    return nullptr;
+    return previous_matching_result;
   }
 
   // local map frame <- gravity-aligned frame
-  std::unique_ptr<transform::Rigid2d> pose_estimate_2d =
-      ScanMatch(time, pose_prediction, filtered_gravity_aligned_point_cloud);
-  if (pose_estimate_2d == nullptr) {
-    LOG(WARNING) << "Scan matching failed.";
-    return nullptr;
+  std::unique_ptr<transform::Rigid2d> pose_estimate_2d;
+  if (IsStationary(pose_prediction, filtered_gravity_aligned_point_cloud)) {
+    kStationaryRangeDataMetric->Increment();
+    pose_estimate_2d = absl::make_unique<transform::Rigid2d>(pose_prediction);
+  } else {
+    pose_estimate_2d =
+        ScanMatch(time, pose_prediction, filtered_gravity_aligned_point_cloud,
+                  start_time);
+    if (pose_estimate_2d == nullptr) {
+      LOG(WARNING) << "Scan matching failed.";
+      return previous_matching_result;
+    }
+    if (options_.use_stationary_detection()) {
+      last_scan_matched_pose_ = *pose_estimate_2d;
+      last_scan_matched_cells_ = ComputeOccupiedCells(
+          filtered_gravity_aligned_point_cloud,
+          options_.stationary_detection_options().cell_size());
+    }
   }
   const transform::Rigid3d pose_estimate =
       transform::Embed3D(*pose_estimate_2d) * gravity_alignment;
   extrapolator_->AddPose(time, pose_estimate);
 
-  sensor::RangeData range_data_in_local =
+  auto matching_result = absl::make_unique<MatchingResult>(MatchingResult{
+      time, pose_estimate,
       TransformRangeData(gravity_aligned_range_data,
-                         transform::Embed3D(pose_estimate_2d->cast<float>()));
-  std::unique_ptr<InsertionResult> insertion_result = InsertIntoSubmap(
-      time, range_data_in_local, filtered_gravity_aligned_point_cloud,
-      pose_estimate, gravity_alignment.rotation());
+                         transform::Embed3D(pose_estimate_2d->cast<float>())),
+      nullptr});
+  if (IsOverTimeBudget(start_time) && !active_submaps_.submaps().empty()) {
+    // Skips the insertion to catch up with the sensor, the range data is
+    // reported like one dropped by the motion filter.
+    kSkippedInsertionMetric->Increment();
+    if (options_.pipeline_submap_insertion()) {
+      pending_matching_result_ = std::move(matching_result);
+      matching_result = std::move(previous_matching_result);
+    }
+  } else if (options_.pipeline_submap_insertion()) {
+    StartPendingInsertion(std::move(matching_result),
+                          filtered_gravity_aligned_point_cloud,
+                          gravity_alignment.rotation());
+    matching_result = std::move(previous_matching_result);
+  } else {
+    matching_result->insertion_result = InsertIntoSubmap(
+        time, matching_result->range_data_in_local,
+        filtered_gravity_aligned_point_cloud, pose_estimate,
+        gravity_alignment.rotation());
+  }
 
   const auto wall_time = std::chrono::steady_clock::now();
+  const double time_budget =
+      options_.scan_matching_deadline_options().time_budget();
+  if (time_budget > 0.) {
+    const double duration = common::ToSeconds(wall_time - start_time);
+    if (duration > time_budget) {
+      over_time_budget_ = true;
+    } else if (duration < 0.5 * time_budget) {
+      over_time_budget_ = false;
+    }
+  }
   if (last_wall_time_.has_value()) {
     const auto wall_time_duration = wall_time - last_wall_time_.value();
     kLocalSlamLatencyMetric->Set(common::ToSeconds(wall_time_duration));
@@ -271,9 +485,36 @@ LocalTrajectoryBuilder2D::AddAccumulatedRangeData(
   }
   last_wall_time_ = wall_time;
   last_thread_cpu_time_seconds_ = thread_cpu_time_seconds;
-  return absl::make_unique<MatchingResult>(
-      MatchingResult{time, pose_estimate, std::move(range_data_in_local),
-                     std::move(insertion_result)});
+  return matching_result;
+}
+
+void LocalTrajectoryBuilder2D::StartPendingInsertion(
+    std::unique_ptr<MatchingResult> matching_result,
+    const sensor::PointCloud& filtered_gravity_aligned_point_cloud,
+    const Eigen::Quaterniond& gravity_alignment) {
+  CHECK(pending_insertion_ == nullptr);
+  pending_matching_result_ = std::move(matching_result);
+  pending_insertion_ = absl::make_unique<absl::Notification>();
+  auto task = absl::make_unique<common::Task>();
+  task->SetWorkItem([this, filtered_gravity_aligned_point_cloud,
+                     gravity_alignment]() {
+    pending_matching_result_->insertion_result = InsertIntoSubmap(
+        pending_matching_result_->time,
+        pending_matching_result_->range_data_in_local,
+        filtered_gravity_aligned_point_cloud,
+        pending_matching_result_->local_pose, gravity_alignment);
+    pending_insertion_->Notify();
+  });
+  insertion_thread_pool_->Schedule(std::move(task));
+}
+
+std::unique_ptr<LocalTrajectoryBuilder2D::MatchingResult>
+LocalTrajectoryBuilder2D::FinishPendingInsertion() {
+  if (pending_insertion_ != nullptr) {
+    pending_insertion_->WaitForNotification();
+    pending_insertion_.reset();
+  }
+  return std::move(pending_matching_result_);
 }
 
 std::unique_ptr<LocalTrajectoryBuilder2D::InsertionResult>
@@ -331,6 +572,20 @@ void LocalTrajectoryBuilder2D::InitializeExtrapolator(const common::Time time) {
   extrapolator_->AddPose(time, transform::Rigid3d::Identity());
 }
 
+size_t LocalTrajectoryBuilder2D::ScratchMemoryUsageInBytes() const {
+  return MemoryUsageInBytes(accumulated_range_data_) +
+         scan_buffers_.voxel_filter_scratch.MemoryUsageInBytes() +
+         scan_buffers_.cropped_returns.MemoryUsageInBytes() +
+         scan_buffers_.cropped_misses.MemoryUsageInBytes() +
+         MemoryUsageInBytes(scan_buffers_.gravity_aligned_range_data) +
+         scan_buffers_.point_times.capacity() * sizeof(common::Time) +
+         scan_buffers_.sample_times.capacity() * sizeof(common::Time) +
+         scan_buffers_.sample_poses.capacity() * sizeof(transform::Rigid3f) +
+         synchronized_data_.origins.capacity() * sizeof(Eigen::Vector3f) +
+         synchronized_data_.ranges.capacity() *
+             sizeof(sensor::TimedPointCloudOriginData::RangeMeasurement);
+}
+
 void LocalTrajectoryBuilder2D::RegisterMetrics(
     metrics::FamilyFactory* family_factory) {
   auto* latency = family_factory->NewGaugeFamily(
@@ -347,6 +602,11 @@ void LocalTrajectoryBuilder2D::RegisterMetrics(
       "mapping_2d_local_trajectory_builder_cpu_real_time_ratio",
       "sensor duration / cpu duration.");
   kLocalSlamCpuRealTimeRatio = cpu_real_time_ratio->Add({});
+  auto* duration = family_factory->NewHistogramFamily(
+      "mapping_2d_local_trajectory_builder_duration",
+      "Wall time in seconds to match and insert accumulated range data",
+      metrics::Histogram::ScaledPowersOf(2, 1e-4, 100));
+  kLocalSlamDurationMetric = duration->Add({});
   auto score_boundaries = metrics::Histogram::FixedWidth(0.05, 20);
   auto* scores = family_factory->NewHistogramFamily(
       "mapping_2d_local_trajectory_builder_scores", "Local scan matcher scores",
@@ -358,6 +618,11 @@ void LocalTrajectoryBuilder2D::RegisterMetrics(
       "mapping_2d_local_trajectory_builder_costs", "Local scan matcher costs",
       cost_boundaries);
   kCeresScanMatcherCostMetric = costs->Add({{"scan_matcher", "ceres"}});
+  auto* iterations = family_factory->NewHistogramFamily(
+      "mapping_2d_local_trajectory_builder_ceres_iterations",
+      "Iterations of the local Ceres scan matcher",
+      metrics::Histogram::FixedWidth(1, 20));
+  kCeresScanMatcherIterationsMetric = iterations->Add({});
   auto distance_boundaries = metrics::Histogram::ScaledPowersOf(2, 0.01, 10);
   auto* residuals = family_factory->NewHistogramFamily(
       "mapping_2d_local_trajectory_builder_residuals",
@@ -365,6 +630,23 @@ void LocalTrajectoryBuilder2D::RegisterMetrics(
   kScanMatcherResidualDistanceMetric =
       residuals->Add({{"component", "distance"}});
   kScanMatcherResidualAngleMetric = residuals->Add({{"component", "angle"}});
+  auto* degradations = family_factory->NewCounterFamily(
+      "mapping_2d_local_trajectory_builder_scan_matching_degradations",
+      "Range data degraded to meet the scan matching time budget");
+  kReducedSearchWindowMetric =
+      degradations->Add({{"degradation", "reduced_search_window"}});
+  kCappedCeresIterationsMetric =
+      degradations->Add({{"degradation", "capped_ceres_iterations"}});
+  kSkippedInsertionMetric =
+      degradations->Add({{"degradation", "skipped_insertion"}});
+  auto* stationary = family_factory->NewCounterFamily(
+      "mapping_2d_local_trajectory_builder_stationary_range_data",
+      "Range data whose pose was extrapolated instead of scan matched");
+  kStationaryRangeDataMetric = stationary->Add({});
+  auto* scratch_memory = family_factory->NewGaugeFamily(
+      "mapping_2d_local_trajectory_builder_scratch_memory",
+      "Bytes of the buffers reused between range data by local SLAM");
+  kScratchMemoryMetric = scratch_memory->Add({});
 }
 
 }  // namespace mapping
@@ -20,6 +20,10 @@
 #include <chrono>
 #include <memory>
 
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/notification.h"
+#include "cartographer/common/port.h"
+#include "cartographer/common/thread_pool.h"
 #include "cartographer/common/time.h"
 #include "cartographer/mapping/2d/submap_2d.h"
 #include "cartographer/mapping/internal/2d/scan_matching/ceres_scan_matcher_2d.h"
@@ -68,9 +72,14 @@ class LocalTrajectoryBuilder2D {
   // for 2D SLAM. `TimedPointCloudData::time` is when the last point in
   // `range_data` was acquired, `TimedPointCloudData::ranges` contains the
   // relative time of point with respect to `TimedPointCloudData::time`.
+  // With 'pipeline_submap_insertion', the returned 'MatchingResult' is the one
+  // of the previously accumulated range data instead.
   std::unique_ptr<MatchingResult> AddRangeData(
-      const std::string& sensor_id,
-      const sensor::TimedPointCloudData& range_data);
+      const std::string& sensor_id, sensor::TimedPointCloudData range_data);
+  // Waits until the last accumulated range data has been inserted into the
+  // submaps and returns its 'MatchingResult'. Returns 'nullptr' if there is
+  // none, which is always the case without 'pipeline_submap_insertion'.
+  std::unique_ptr<MatchingResult> FinishPendingInsertion();
   void AddImuData(const sensor::ImuData& imu_data);
   void AddOdometryData(const sensor::OdometryData& odometry_data);
 
@@ -81,24 +90,49 @@ class LocalTrajectoryBuilder2D {
       common::Time time, const sensor::RangeData& gravity_aligned_range_data,
       const transform::Rigid3d& gravity_alignment,
       const absl::optional<common::Duration>& sensor_duration);
-  sensor::RangeData TransformToGravityAlignedFrameAndFilter(
+  // Returns a reference to 'scan_buffers_.gravity_aligned_range_data', which
+  // is valid until the next call.
+  const sensor::RangeData& TransformToGravityAlignedFrameAndFilter(
       const transform::Rigid3f& transform_to_gravity_aligned_frame,
-      const sensor::RangeData& range_data) const;
+      const sensor::RangeData& range_data);
   std::unique_ptr<InsertionResult> InsertIntoSubmap(
       common::Time time, const sensor::RangeData& range_data_in_local,
       const sensor::PointCloud& filtered_gravity_aligned_point_cloud,
       const transform::Rigid3d& pose_estimate,
       const Eigen::Quaterniond& gravity_alignment);
+  // Starts inserting 'matching_result' into the submaps on
+  // 'insertion_thread_pool_'.
+  void StartPendingInsertion(
+      std::unique_ptr<MatchingResult> matching_result,
+      const sensor::PointCloud& filtered_gravity_aligned_point_cloud,
+      const Eigen::Quaterniond& gravity_alignment);
 
   // Scan matches 'filtered_gravity_aligned_point_cloud' and returns the
-  // observed pose, or nullptr on failure.
+  // observed pose, or nullptr on failure. 'start_time' is when work on the
+  // accumulated range data started, for the scan matching deadline.
   std::unique_ptr<transform::Rigid2d> ScanMatch(
       common::Time time, const transform::Rigid2d& pose_prediction,
-      const sensor::PointCloud& filtered_gravity_aligned_point_cloud);
+      const sensor::PointCloud& filtered_gravity_aligned_point_cloud,
+      std::chrono::steady_clock::time_point start_time);
+
+  // Returns true if 'use_stationary_detection' is set and the range data
+  // with 'pose_prediction' and 'filtered_gravity_aligned_point_cloud' is
+  // considered stationary. Always false for an empty point cloud.
+  bool IsStationary(
+      const transform::Rigid2d& pose_prediction,
+      const sensor::PointCloud& filtered_gravity_aligned_point_cloud) const;
+
+  // Returns true if more than the scan matching time budget passed since
+  // 'start_time'. Always false without a budget.
+  bool IsOverTimeBudget(std::chrono::steady_clock::time_point start_time) const;
 
   // Lazily constructs a PoseExtrapolator.
   void InitializeExtrapolator(common::Time time);
 
+  // Returns the number of bytes allocated for the buffers kept between range
+  // data.
+  size_t ScratchMemoryUsageInBytes() const;
+
   const proto::LocalTrajectoryBuilderOptions2D options_;
   ActiveSubmaps2D active_submaps_;
 
@@ -106,17 +140,55 @@ class LocalTrajectoryBuilder2D {
   scan_matching::RealTimeCorrelativeScanMatcher2D
       real_time_correlative_scan_matcher_;
   scan_matching::CeresScanMatcher2D ceres_scan_matcher_;
+  // Only with a scan matching time budget. Used instead of the scan matchers
+  // above while 'over_time_budget_'.
+  std::unique_ptr<scan_matching::RealTimeCorrelativeScanMatcher2D>
+      degraded_real_time_correlative_scan_matcher_;
+  std::unique_ptr<scan_matching::CeresScanMatcher2D>
+      degraded_ceres_scan_matcher_;
+  // Carried between the Ceres solves of consecutive range data.
+  scan_matching::CeresScanMatcher2D::WarmStartState ceres_warm_start_state_;
+  // Whether recent range data exceeded the scan matching time budget.
+  bool over_time_budget_ = false;
+
+  // Only with 'use_stationary_detection'. The pose and the keys of the
+  // cells occupied by the filtered points of the last scan matched range data.
+  absl::optional<transform::Rigid2d> last_scan_matched_pose_;
+  absl::flat_hash_set<uint64> last_scan_matched_cells_;
 
   std::unique_ptr<PoseExtrapolator> extrapolator_;
 
   int num_accumulated_ = 0;
   sensor::RangeData accumulated_range_data_;
 
+  // Intermediate results of gravity aligning, cropping and filtering the
+  // accumulated range data. They are kept to reuse their storage for the next
+  // range data.
+  struct ScanBuffers {
+    sensor::VoxelFilterScratch voxel_filter_scratch;
+    sensor::PointCloud cropped_returns;
+    sensor::PointCloud cropped_misses;
+    sensor::RangeData gravity_aligned_range_data;
+    // Times and extrapolated poses for motion compensation.
+    std::vector<common::Time> point_times;
+    std::vector<common::Time> sample_times;
+    std::vector<transform::Rigid3f> sample_poses;
+  };
+  ScanBuffers scan_buffers_;
+
   absl::optional<std::chrono::steady_clock::time_point> last_wall_time_;
   absl::optional<double> last_thread_cpu_time_seconds_;
   absl::optional<common::Time> last_sensor_time_;
 
   RangeDataCollator range_data_collator_;
+  // Output of 'range_data_collator_', kept to reuse its storage.
+  sensor::TimedPointCloudOriginData synchronized_data_;
+
+  // Only used with 'pipeline_submap_insertion'. Until 'pending_insertion_' is
+  // notified, the insertion owns 'active_submaps_' and 'motion_filter_'.
+  std::unique_ptr<MatchingResult> pending_matching_result_;
+  std::unique_ptr<absl::Notification> pending_insertion_;
+  std::unique_ptr<common::ThreadPool> insertion_thread_pool_;
 };
 
 }  // namespace mapping
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/2d/local_trajectory_builder_2d.h"
+
+#include <memory>
+#include <vector>
+
+#include "cartographer/mapping/internal/2d/local_trajectory_builder_options_2d.h"
+#include "cartographer/mapping/internal/testing/test_helpers.h"
+#include "cartographer/sensor/timed_point_cloud_data.h"
+#include "gmock/gmock.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+constexpr char kSensorId[] = "sensor_id";
+
+class LocalTrajectoryBuilder2DTest : public ::testing::Test {
+ protected:
+  LocalTrajectoryBuilder2DTest() {
+    auto parameter_dictionary = testing::ResolveLuaParameters(R"text(
+        include "trajectory_builder_2d.lua"
+        TRAJECTORY_BUILDER_2D.use_imu_data = false
+        return TRAJECTORY_BUILDER_2D)text");
+    options_ =
+        CreateLocalTrajectoryBuilderOptions2D(parameter_dictionary.get());
+  }
+
+  // Adds 'measurements' and returns the matching result of each.
+  std::vector<std::unique_ptr<LocalTrajectoryBuilder2D::MatchingResult>>
+  AddRangeData(const std::vector<sensor::TimedPointCloudData>& measurements) {
+    LocalTrajectoryBuilder2D local_trajectory_builder(options_, {kSensorId});
+    std::vector<std::unique_ptr<LocalTrajectoryBuilder2D::MatchingResult>>
+        matching_results;
+    for (const sensor::TimedPointCloudData& measurement : measurements) {
+      auto matching_result =
+          local_trajectory_builder.AddRangeData(kSensorId, measurement);
+      EXPECT_THAT(matching_result, ::testing::NotNull());
+      matching_results.push_back(std::move(matching_result));
+    }
+    return matching_results;
+  }
+
+  proto::LocalTrajectoryBuilderOptions2D options_;
+};
+
+TEST_F(LocalTrajectoryBuilder2DTest, KeepsPoseOfStationaryRangeData) {
+  options_.set_use_stationary_detection(true);
+  // Moves by 2 mm between range data, which leaves most points in the cells
+  // they occupied for the first range data.
+  const auto matching_results =
+      AddRangeData(testing::GenerateFakeRangeMeasurements(0.005, 0.25, 0.1));
+  ASSERT_EQ(matching_results.size(), 3);
+  const transform::Rigid3d& first_pose = matching_results.front()->local_pose;
+  for (const auto& matching_result : matching_results) {
+    ASSERT_THAT(matching_result, ::testing::NotNull());
+    EXPECT_NEAR(matching_result->local_pose.translation().x(),
+                first_pose.translation().x(), 1e-9);
+    EXPECT_NEAR(matching_result->local_pose.translation().y(),
+                first_pose.translation().y(), 1e-9);
+  }
+}
+
+TEST_F(LocalTrajectoryBuilder2DTest, SkipsInsertionOverTimeBudget) {
+  // No range data can be processed within this budget.
+  options_.mutable_scan_matching_deadline_options()->set_time_budget(1e-9);
+  const auto matching_results =
+      AddRangeData(testing::GenerateFakeRangeMeasurements(0.5, 1., 0.1));
+  ASSERT_GE(matching_results.size(), 10);
+  // The first range data starts the first submap, the other range data is
+  // only scan matched with degraded scan matchers.
+  ASSERT_THAT(matching_results.front(), ::testing::NotNull());
+  EXPECT_THAT(matching_results.front()->insertion_result,
+              ::testing::NotNull());
+  for (size_t i = 1; i != matching_results.size(); ++i) {
+    ASSERT_THAT(matching_results[i], ::testing::NotNull());
+    EXPECT_THAT(matching_results[i]->insertion_result, ::testing::IsNull());
+  }
+}
+
+TEST_F(LocalTrajectoryBuilder2DTest, InsertsWithinTimeBudget) {
+  options_.mutable_scan_matching_deadline_options()->set_time_budget(60.);
+  // Inserts all range data which is not skipped.
+  options_.mutable_motion_filter_options()->set_max_time_seconds(0.);
+  const auto matching_results =
+      AddRangeData(testing::GenerateFakeRangeMeasurements(0.5, 1., 0.1));
+  ASSERT_GE(matching_results.size(), 10);
+  for (const auto& matching_result : matching_results) {
+    ASSERT_THAT(matching_result, ::testing::NotNull());
+    EXPECT_THAT(matching_result->insertion_result, ::testing::NotNull());
+  }
+}
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
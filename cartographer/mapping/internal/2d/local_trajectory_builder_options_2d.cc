@@ -22,6 +22,7 @@
 #include "cartographer/mapping/internal/scan_matching/real_time_correlative_scan_matcher.h"
 #include "cartographer/mapping/pose_extrapolator_interface.h"
 #include "cartographer/sensor/internal/voxel_filter.h"
+#include "glog/logging.h"
 
 namespace cartographer {
 namespace mapping {
@@ -66,6 +67,38 @@ proto::LocalTrajectoryBuilderOptions2D CreateLocalTrajectoryBuilderOptions2D(
   *options.mutable_submaps_options() = CreateSubmapsOptions2D(
       parameter_dictionary->GetDictionary("submaps").get());
   options.set_use_imu_data(parameter_dictionary->GetBool("use_imu_data"));
+  options.set_pipeline_submap_insertion(
+      parameter_dictionary->GetBool("pipeline_submap_insertion"));
+  const auto deadline_dictionary =
+      parameter_dictionary->GetDictionary("scan_matching_deadline");
+  auto* const deadline_options =
+      options.mutable_scan_matching_deadline_options();
+  deadline_options->set_time_budget(
+      deadline_dictionary->GetDouble("time_budget"));
+  deadline_options->set_search_window_factor(
+      deadline_dictionary->GetDouble("search_window_factor"));
+  deadline_options->set_max_num_ceres_iterations(
+      deadline_dictionary->GetNonNegativeInt("max_num_ceres_iterations"));
+  CHECK_GT(deadline_options->search_window_factor(), 0.);
+  CHECK_LE(deadline_options->search_window_factor(), 1.);
+  CHECK_GT(deadline_options->max_num_ceres_iterations(), 0);
+  options.set_use_stationary_detection(
+      parameter_dictionary->GetBool("use_stationary_detection"));
+  const auto stationary_dictionary =
+      parameter_dictionary->GetDictionary("stationary_detection");
+  auto* const stationary_options =
+      options.mutable_stationary_detection_options();
+  stationary_options->set_max_translation(
+      stationary_dictionary->GetDouble("max_translation"));
+  stationary_options->set_max_angle_radians(
+      stationary_dictionary->GetDouble("max_angle_radians"));
+  stationary_options->set_cell_size(
+      stationary_dictionary->GetDouble("cell_size"));
+  stationary_options->set_min_overlap(
+      stationary_dictionary->GetDouble("min_overlap"));
+  CHECK_GT(stationary_options->cell_size(), 0.);
+  options.set_motion_compensation_interval(
+      parameter_dictionary->GetDouble("motion_compensation_interval"));
   return options;
 }
 
@@ -81,23 +81,25 @@ std::vector<float> EstimateNormals(
   std::vector<float> normals;
   normals.reserve(range_data.returns.size());
   const size_t max_num_samples = normal_estimation_options.num_normal_samples();
+  const size_t max_num_samples_before = max_num_samples / 2;
+  const size_t max_num_samples_after = (max_num_samples + 1) / 2 + 1;
   const float sample_radius = normal_estimation_options.sample_radius();
+  const float squared_sample_radius = sample_radius * sample_radius;
   for (size_t current_point = 0; current_point < range_data.returns.size();
        ++current_point) {
     const Eigen::Vector3f& hit = range_data.returns[current_point].position;
     size_t sample_window_begin = current_point;
     for (; sample_window_begin > 0 &&
-           current_point - sample_window_begin < max_num_samples / 2 &&
-           (hit - range_data.returns[sample_window_begin - 1].position).norm() <
-               sample_radius;
+           current_point - sample_window_begin < max_num_samples_before &&
+           (hit - range_data.returns[sample_window_begin - 1].position)
+                   .squaredNorm() < squared_sample_radius;
          --sample_window_begin) {
     }
     size_t sample_window_end = current_point;
-    for (;
-         sample_window_end < range_data.returns.size() &&
-         sample_window_end - current_point < ceil(max_num_samples / 2.0) + 1 &&
-         (hit - range_data.returns[sample_window_end].position).norm() <
-             sample_radius;
+    for (; sample_window_end < range_data.returns.size() &&
+           sample_window_end - current_point < max_num_samples_after &&
+           (hit - range_data.returns[sample_window_end].position)
+                   .squaredNorm() < squared_sample_radius;
          ++sample_window_end) {
     }
     const float normal_estimate =
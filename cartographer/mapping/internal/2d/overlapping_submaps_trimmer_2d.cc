@@ -17,88 +17,43 @@
 #include "cartographer/mapping/internal/2d/overlapping_submaps_trimmer_2d.h"
 
 #include <algorithm>
+#include <numeric>
 
+#include "absl/memory/memory.h"
+#include "cartographer/common/parallel_for.h"
+#include "cartographer/common/task.h"
 #include "cartographer/mapping/2d/submap_2d.h"
+#include "cartographer/transform/transform.h"
 
 namespace cartographer {
 namespace mapping {
 namespace {
 
-class SubmapCoverageGrid2D {
- public:
-  // Aliases for documentation only (no type-safety).
-  using CellId = std::pair<int64 /* x cells */, int64 /* y cells */>;
-  using StoredType = std::vector<std::pair<SubmapId, common::Time>>;
+constexpr int kNumRasterizationTasks = 4;
 
-  SubmapCoverageGrid2D(const MapLimits& map_limits)
-      : offset_(map_limits.max()), resolution_(map_limits.resolution()) {}
-
-  void AddPoint(const Eigen::Vector2d& point, const SubmapId& submap_id,
-                const common::Time& time) {
-    CellId cell_id{common::RoundToInt64((offset_(0) - point(0)) / resolution_),
-                   common::RoundToInt64((offset_(1) - point(1)) / resolution_)};
-    cells_[cell_id].emplace_back(submap_id, time);
-  }
-
-  const std::map<CellId, StoredType>& cells() const { return cells_; }
-  double resolution() const { return resolution_; }
-
- private:
-  Eigen::Vector2d offset_;
-  double resolution_;
-  std::map<CellId, StoredType> cells_;
+// A finished submap as seen by the pose graph when the snapshot was taken.
+struct SubmapSnapshot {
+  SubmapId id;
+  std::shared_ptr<const Submap2D> submap;
+  transform::Rigid3d global_pose;
+  // Time of the most recent range data insertion into the submap.
+  common::Time freshness;
 };
 
-// Iterates over every cell in a submap, transforms the center of the cell to
-// the global frame and then adds the submap id and the timestamp of the most
-// recent range data insertion into the global grid.
-std::set<SubmapId> AddSubmapsToSubmapCoverageGrid2D(
-    const std::map<SubmapId, common::Time>& submap_freshness,
-    const MapById<SubmapId, PoseGraphInterface::SubmapData>& submap_data,
-    SubmapCoverageGrid2D* coverage_grid) {
-  std::set<SubmapId> all_submap_ids;
-
-  for (const auto& submap : submap_data) {
-    auto freshness = submap_freshness.find(submap.id);
-    if (freshness == submap_freshness.end()) continue;
-    if (!submap.data.submap->insertion_finished()) continue;
-    all_submap_ids.insert(submap.id);
-    const Grid2D& grid =
-        *std::static_pointer_cast<const Submap2D>(submap.data.submap)->grid();
-    // Iterate over every cell in a submap.
-    Eigen::Array2i offset;
-    CellLimits cell_limits;
-    grid.ComputeCroppedLimits(&offset, &cell_limits);
-    if (cell_limits.num_x_cells == 0 || cell_limits.num_y_cells == 0) {
-      LOG(WARNING) << "Empty grid found in submap ID = " << submap.id;
-      continue;
-    }
+// The submaps to compute the coverage of, copied from the pose graph so that
+// the coverage can be computed without holding its lock.
+struct CoverageSnapshot {
+  // Its grid defines the cells of the global coverage grid.
+  std::shared_ptr<const Submap2D> first_submap;
+  std::vector<SubmapSnapshot> submaps;
+};
 
-    const transform::Rigid3d& global_frame_from_submap_frame = submap.data.pose;
-    const transform::Rigid3d submap_frame_from_local_frame =
-        submap.data.submap->local_pose().inverse();
-    for (const Eigen::Array2i& xy_index : XYIndexRangeIterator(cell_limits)) {
-      const Eigen::Array2i index = xy_index + offset;
-      if (!grid.IsKnown(index)) continue;
-
-      const transform::Rigid3d center_of_cell_in_local_frame =
-          transform::Rigid3d::Translation(Eigen::Vector3d(
-              grid.limits().max().x() -
-                  grid.limits().resolution() * (index.y() + 0.5),
-              grid.limits().max().y() -
-                  grid.limits().resolution() * (index.x() + 0.5),
-              0));
-
-      const transform::Rigid2d center_of_cell_in_global_frame =
-          transform::Project2D(global_frame_from_submap_frame *
-                               submap_frame_from_local_frame *
-                               center_of_cell_in_local_frame);
-      coverage_grid->AddPoint(center_of_cell_in_global_frame.translation(),
-                              submap.id, freshness->second);
-    }
-  }
-  return all_submap_ids;
-}
+// Global cells covered by the known cells of a submap, without duplicates.
+struct RasterizedSubmap {
+  std::vector<Eigen::Array2i> cells;
+  Eigen::Array2i min_cell;
+  Eigen::Array2i max_cell;
+};
 
 // Uses intra-submap constraints and trajectory node timestamps to identify time
 // of the last range data insertion to the submap.
@@ -140,72 +95,231 @@ std::map<SubmapId, common::Time> ComputeSubmapFreshness(
   return submap_freshness;
 }
 
-// Returns IDs of submaps that have less than 'min_covered_cells_count' cells
-// not overlapped by at least 'fresh_submaps_count' submaps.
+CoverageSnapshot CreateCoverageSnapshot(
+    const MapById<SubmapId, PoseGraphInterface::SubmapData>& submap_data,
+    const MapById<NodeId, TrajectoryNode>& trajectory_nodes,
+    const std::vector<PoseGraphInterface::Constraint>& constraints) {
+  const std::map<SubmapId, common::Time> submap_freshness =
+      ComputeSubmapFreshness(submap_data, trajectory_nodes, constraints);
+  CoverageSnapshot snapshot;
+  snapshot.first_submap = std::static_pointer_cast<const Submap2D>(
+      submap_data.begin()->data.submap);
+  for (const auto& submap : submap_data) {
+    auto freshness = submap_freshness.find(submap.id);
+    if (freshness == submap_freshness.end()) continue;
+    if (!submap.data.submap->insertion_finished()) continue;
+    snapshot.submaps.push_back(
+        SubmapSnapshot{submap.id,
+                       std::static_pointer_cast<const Submap2D>(
+                           submap.data.submap),
+                       submap.data.pose, freshness->second});
+  }
+  return snapshot;
+}
+
+// Transforms the center of every known cell of 'submap' into the global frame
+// and returns the cells of the global grid, defined by its maximum 'offset'
+// and 'resolution', that contain them.
+RasterizedSubmap RasterizeSubmap(const SubmapSnapshot& submap,
+                                 const Eigen::Vector2d& offset,
+                                 const double resolution) {
+  RasterizedSubmap result;
+  const std::shared_ptr<const Grid2D> loaded_grid = submap.submap->LoadGrid();
+  const Grid2D& grid = *loaded_grid;
+  Eigen::Array2i cropped_offset;
+  CellLimits cell_limits;
+  grid.ComputeCroppedLimits(&cropped_offset, &cell_limits);
+  if (cell_limits.num_x_cells == 0 || cell_limits.num_y_cells == 0) {
+    LOG(WARNING) << "Empty grid found in submap ID = " << submap.id;
+    return result;
+  }
+
+  const transform::Rigid2d global_frame_from_local_frame =
+      transform::Project2D(submap.global_pose *
+                           submap.submap->local_pose().inverse());
+  const MapLimits& limits = grid.limits();
+  for (const Eigen::Array2i& xy_index : XYIndexRangeIterator(cell_limits)) {
+    const Eigen::Array2i index = xy_index + cropped_offset;
+    if (!grid.IsKnown(index)) continue;
+    const Eigen::Vector2d center_of_cell_in_local_frame(
+        limits.max().x() - limits.resolution() * (index.y() + 0.5),
+        limits.max().y() - limits.resolution() * (index.x() + 0.5));
+    const Eigen::Vector2d point =
+        global_frame_from_local_frame * center_of_cell_in_local_frame;
+    result.cells.emplace_back(
+        common::RoundToInt((offset.x() - point.x()) / resolution),
+        common::RoundToInt((offset.y() - point.y()) / resolution));
+  }
+  if (result.cells.empty()) return result;
+
+  const auto less = [](const Eigen::Array2i& lhs, const Eigen::Array2i& rhs) {
+    return std::make_pair(lhs.x(), lhs.y()) < std::make_pair(rhs.x(), rhs.y());
+  };
+  std::sort(result.cells.begin(), result.cells.end(), less);
+  result.cells.erase(
+      std::unique(result.cells.begin(), result.cells.end(),
+                  [](const Eigen::Array2i& lhs, const Eigen::Array2i& rhs) {
+                    return (lhs == rhs).all();
+                  }),
+      result.cells.end());
+  result.min_cell = result.max_cell = result.cells.front();
+  for (const Eigen::Array2i& cell : result.cells) {
+    result.min_cell = result.min_cell.min(cell);
+    result.max_cell = result.max_cell.max(cell);
+  }
+  return result;
+}
+
+// Returns IDs of submaps that have less than 'min_covered_area' not overlapped
+// by at least 'fresh_submaps_count' fresher submaps. The submaps are
+// rasterized in parallel on 'thread_pool' if it is not nullptr. Then, in
+// order of decreasing freshness, each submap counts the cells of a flat grid
+// over their bounding box which are covered by less than
+// 'fresh_submaps_count' submaps so far.
 std::vector<SubmapId> FindSubmapIdsToTrim(
-    const SubmapCoverageGrid2D& coverage_grid,
-    const std::set<SubmapId>& all_submap_ids, uint16 fresh_submaps_count,
-    uint16 min_covered_cells_count) {
-  std::map<SubmapId, uint16> submap_to_covered_cells_count;
-  for (const auto& cell : coverage_grid.cells()) {
-    std::vector<std::pair<SubmapId, common::Time>> submaps_per_cell(
-        cell.second);
-
-    // In case there are several submaps covering the cell, only the freshest
-    // submaps are kept.
-    if (submaps_per_cell.size() > fresh_submaps_count) {
-      // Sort by time in descending order.
-      std::sort(submaps_per_cell.begin(), submaps_per_cell.end(),
-                [](const std::pair<SubmapId, common::Time>& left,
-                   const std::pair<SubmapId, common::Time>& right) {
-                  return left.second > right.second;
-                });
-      submaps_per_cell.erase(submaps_per_cell.begin() + fresh_submaps_count,
-                             submaps_per_cell.end());
-    }
-    for (const std::pair<SubmapId, common::Time>& submap : submaps_per_cell) {
-      ++submap_to_covered_cells_count[submap.first];
-    }
+    const CoverageSnapshot& snapshot, const uint16 fresh_submaps_count,
+    const double min_covered_area,
+    common::ThreadPoolInterface* const thread_pool) {
+  const MapLimits first_submap_map_limits =
+      snapshot.first_submap->LoadGrid()->limits();
+  const Eigen::Vector2d offset = first_submap_map_limits.max();
+  const double resolution = first_submap_map_limits.resolution();
+  const uint16 min_covered_cells_count =
+      min_covered_area / common::Pow2(resolution);
+
+  const int num_submaps = snapshot.submaps.size();
+  std::vector<RasterizedSubmap> rasterized_submaps(num_submaps);
+  const auto rasterize = [&](const int index) {
+    rasterized_submaps[index] =
+        RasterizeSubmap(snapshot.submaps[index], offset, resolution);
+  };
+  if (thread_pool == nullptr) {
+    for (int i = 0; i != num_submaps; ++i) rasterize(i);
+  } else {
+    common::ParallelFor(num_submaps, kNumRasterizationTasks, thread_pool,
+                        rasterize);
   }
-  std::vector<SubmapId> submap_ids_to_keep;
-  for (const auto& id_to_cells_count : submap_to_covered_cells_count) {
-    if (id_to_cells_count.second < min_covered_cells_count) continue;
-    submap_ids_to_keep.push_back(id_to_cells_count.first);
+
+  Eigen::Array2i min_cell = Eigen::Array2i::Zero();
+  Eigen::Array2i max_cell = Eigen::Array2i::Constant(-1);
+  bool found_cells = false;
+  for (const RasterizedSubmap& rasterized_submap : rasterized_submaps) {
+    if (rasterized_submap.cells.empty()) continue;
+    min_cell = found_cells ? min_cell.min(rasterized_submap.min_cell)
+                           : rasterized_submap.min_cell;
+    max_cell = found_cells ? max_cell.max(rasterized_submap.max_cell)
+                           : rasterized_submap.max_cell;
+    found_cells = true;
+  }
+  const int64 num_x_cells = max_cell.x() - min_cell.x() + 1;
+  const int64 num_y_cells = max_cell.y() - min_cell.y() + 1;
+  // Number of submaps covering each cell, up to 'fresh_submaps_count'.
+  std::vector<uint16> num_covering_submaps(num_x_cells * num_y_cells, 0);
+
+  std::vector<int> submap_indices(num_submaps);
+  std::iota(submap_indices.begin(), submap_indices.end(), 0);
+  std::stable_sort(submap_indices.begin(), submap_indices.end(),
+                   [&snapshot](const int lhs, const int rhs) {
+                     return snapshot.submaps[lhs].freshness >
+                            snapshot.submaps[rhs].freshness;
+                   });
+  std::vector<bool> keep_submap(num_submaps, false);
+  for (const int index : submap_indices) {
+    int covered_cells_count = 0;
+    for (const Eigen::Array2i& cell : rasterized_submaps[index].cells) {
+      uint16& num_covering = num_covering_submaps
+          [(cell.x() - min_cell.x()) * num_y_cells + cell.y() - min_cell.y()];
+      if (num_covering < fresh_submaps_count) {
+        ++num_covering;
+        ++covered_cells_count;
+      }
+    }
+    keep_submap[index] = covered_cells_count > 0 &&
+                         covered_cells_count >= min_covered_cells_count;
   }
 
-  DCHECK(std::is_sorted(submap_ids_to_keep.begin(), submap_ids_to_keep.end()));
   std::vector<SubmapId> result;
-  std::set_difference(all_submap_ids.begin(), all_submap_ids.end(),
-                      submap_ids_to_keep.begin(), submap_ids_to_keep.end(),
-                      std::back_inserter(result));
+  for (int i = 0; i != num_submaps; ++i) {
+    if (!keep_submap[i]) result.push_back(snapshot.submaps[i].id);
+  }
   return result;
 }
 
 }  // namespace
 
+struct OverlappingSubmapsTrimmer2D::PendingTrimming {
+  // Number of submaps in the snapshot the computation started from.
+  size_t num_submaps;
+  absl::Mutex mutex;
+  bool done GUARDED_BY(mutex) = false;
+  std::vector<SubmapId> submap_ids_to_trim GUARDED_BY(mutex);
+};
+
+OverlappingSubmapsTrimmer2D::~OverlappingSubmapsTrimmer2D() {
+  if (pending_trimming_ == nullptr) return;
+  absl::MutexLock locker(&pending_trimming_->mutex);
+  pending_trimming_->mutex.Await(absl::Condition(&pending_trimming_->done));
+}
+
 void OverlappingSubmapsTrimmer2D::Trim(Trimmable* pose_graph) {
+  if (!MaybeTrimPendingSubmaps(pose_graph)) return;
   const auto submap_data = pose_graph->GetOptimizedSubmapData();
   if (submap_data.size() - current_submap_count_ <= min_added_submaps_count_) {
     return;
   }
 
-  const MapLimits first_submap_map_limits =
-      std::static_pointer_cast<const Submap2D>(submap_data.begin()->data.submap)
-          ->grid()
-          ->limits();
-  SubmapCoverageGrid2D coverage_grid(first_submap_map_limits);
-  const std::map<SubmapId, common::Time> submap_freshness =
-      ComputeSubmapFreshness(submap_data, pose_graph->GetTrajectoryNodes(),
-                             pose_graph->GetConstraints());
-  const std::set<SubmapId> all_submap_ids = AddSubmapsToSubmapCoverageGrid2D(
-      submap_freshness, submap_data, &coverage_grid);
-  const std::vector<SubmapId> submap_ids_to_remove = FindSubmapIdsToTrim(
-      coverage_grid, all_submap_ids, fresh_submaps_count_,
-      min_covered_area_ / common::Pow2(coverage_grid.resolution()));
-  current_submap_count_ = submap_data.size() - submap_ids_to_remove.size();
-  for (const SubmapId& id : submap_ids_to_remove) {
+  auto snapshot = std::make_shared<const CoverageSnapshot>(
+      CreateCoverageSnapshot(submap_data, pose_graph->GetTrajectoryNodes(),
+                             pose_graph->GetConstraints()));
+  if (thread_pool_ == nullptr) {
+    const std::vector<SubmapId> submap_ids_to_remove = FindSubmapIdsToTrim(
+        *snapshot, fresh_submaps_count_, min_covered_area_,
+        nullptr /* thread_pool */);
+    current_submap_count_ = submap_data.size() - submap_ids_to_remove.size();
+    for (const SubmapId& id : submap_ids_to_remove) {
+      pose_graph->TrimSubmap(id);
+    }
+    return;
+  }
+
+  pending_trimming_ = std::make_shared<PendingTrimming>();
+  pending_trimming_->num_submaps = submap_data.size();
+  auto task = absl::make_unique<common::Task>();
+  task->SetWorkItem([pending_trimming = pending_trimming_, snapshot,
+                     fresh_submaps_count = fresh_submaps_count_,
+                     min_covered_area = min_covered_area_,
+                     thread_pool = thread_pool_]() {
+    std::vector<SubmapId> submap_ids_to_trim = FindSubmapIdsToTrim(
+        *snapshot, fresh_submaps_count, min_covered_area, thread_pool);
+    absl::MutexLock locker(&pending_trimming->mutex);
+    pending_trimming->submap_ids_to_trim = std::move(submap_ids_to_trim);
+    pending_trimming->done = true;
+  });
+  thread_pool_->Schedule(std::move(task));
+}
+
+bool OverlappingSubmapsTrimmer2D::MaybeTrimPendingSubmaps(
+    Trimmable* pose_graph) {
+  if (pending_trimming_ == nullptr) return true;
+  std::vector<SubmapId> submap_ids_to_trim;
+  {
+    absl::MutexLock locker(&pending_trimming_->mutex);
+    if (!pending_trimming_->done) return false;
+    submap_ids_to_trim = std::move(pending_trimming_->submap_ids_to_trim);
+  }
+  const size_t num_submaps = pending_trimming_->num_submaps;
+  pending_trimming_.reset();
+
+  // Submaps of the snapshot may have been trimmed in the meantime.
+  const auto submap_data = pose_graph->GetOptimizedSubmapData();
+  size_t num_trimmed_submaps = 0;
+  for (const SubmapId& id : submap_ids_to_trim) {
+    if (!submap_data.Contains(id)) continue;
     pose_graph->TrimSubmap(id);
+    ++num_trimmed_submaps;
   }
+  current_submap_count_ = num_submaps - num_trimmed_submaps;
+  return true;
 }
 
 }  // namespace mapping
@@ -17,7 +17,11 @@
 #ifndef CARTOGRAPHER_MAPPING_INTERNAL_2D_OVERLAPPING_SUBMAPS_TRIMMER_H_
 #define CARTOGRAPHER_MAPPING_INTERNAL_2D_OVERLAPPING_SUBMAPS_TRIMMER_H_
 
+#include <memory>
+#include <vector>
+
 #include "cartographer/common/port.h"
+#include "cartographer/common/thread_pool.h"
 #include "cartographer/mapping/pose_graph_trimmer.h"
 
 namespace cartographer {
@@ -25,20 +29,35 @@ namespace mapping {
 
 // Trims submaps that have less than 'min_covered_cells_count' cells not
 // overlapped by at least 'fresh_submaps_count` submaps.
+//
+// If a 'thread_pool' is given, the coverage is computed on it from a snapshot
+// of the pose graph, so that Trim() does not hold up the pose graph while the
+// submaps are rasterized. The submaps found are then trimmed by the next call
+// to Trim() after the computation finished. Without a 'thread_pool', Trim()
+// trims right away.
 class OverlappingSubmapsTrimmer2D : public PoseGraphTrimmer {
  public:
-  OverlappingSubmapsTrimmer2D(uint16 fresh_submaps_count,
-                              double min_covered_area,
-                              uint16 min_added_submaps_count)
+  OverlappingSubmapsTrimmer2D(
+      uint16 fresh_submaps_count, double min_covered_area,
+      uint16 min_added_submaps_count,
+      common::ThreadPoolInterface* thread_pool = nullptr)
       : fresh_submaps_count_(fresh_submaps_count),
         min_covered_area_(min_covered_area),
-        min_added_submaps_count_(min_added_submaps_count) {}
-  ~OverlappingSubmapsTrimmer2D() override = default;
+        min_added_submaps_count_(min_added_submaps_count),
+        thread_pool_(thread_pool) {}
+  // Waits for a computation still running on the 'thread_pool'.
+  ~OverlappingSubmapsTrimmer2D() override;
 
   void Trim(Trimmable* pose_graph) override;
   bool IsFinished() override { return finished_; }
 
  private:
+  struct PendingTrimming;
+
+  // Trims the submaps found by the computation on the 'thread_pool_' if it
+  // has finished. Returns false if it is still running.
+  bool MaybeTrimPendingSubmaps(Trimmable* pose_graph);
+
   // Number of the most recent submaps to keep.
   const uint16 fresh_submaps_count_;
   // Minimum area of covered space to keep submap from trimming measured in m^2.
@@ -47,6 +66,8 @@ class OverlappingSubmapsTrimmer2D : public PoseGraphTrimmer {
   const uint16 min_added_submaps_count_;
   // Current finished submap count.
   uint16 current_submap_count_ = 0;
+  common::ThreadPoolInterface* const thread_pool_;
+  std::shared_ptr<PendingTrimming> pending_trimming_;
 
   bool finished_ = false;
 };
@@ -31,7 +31,10 @@
 #include "Eigen/Eigenvalues"
 #include "absl/memory/memory.h"
 #include "cartographer/common/math.h"
+#include "cartographer/common/tracing.h"
 #include "cartographer/mapping/internal/2d/overlapping_submaps_trimmer_2d.h"
+#include "cartographer/mapping/internal/constraint_sparsification.h"
+#include "cartographer/mapping/internal/constraints/loop_closure_consistency_2d.h"
 #include "cartographer/mapping/proto/pose_graph/constraint_builder_options.pb.h"
 #include "cartographer/sensor/compressed_point_cloud.h"
 #include "cartographer/sensor/internal/voxel_filter.h"
@@ -48,21 +51,55 @@ static auto* kConstraintsDifferentTrajectoryMetric = metrics::Gauge::Null();
 static auto* kActiveSubmapsMetric = metrics::Gauge::Null();
 static auto* kFrozenSubmapsMetric = metrics::Gauge::Null();
 static auto* kDeletedSubmapsMetric = metrics::Gauge::Null();
+static auto* kOptimizationDurationMetric = metrics::Histogram::Null();
+static auto* kLoadSheddingFactorMetric = metrics::Gauge::Null();
+static auto* kEvictedNodesMetric = metrics::Gauge::Null();
+static auto* kSubmapsMemoryMetric = metrics::Gauge::Null();
+static auto* kNodesMemoryMetric = metrics::Gauge::Null();
+static auto* kOptimizationMemoryMetric = metrics::Gauge::Null();
+static auto* kRejectedLoopClosuresMetric = metrics::Counter::Null();
+
+// Parameters of the descriptors used to prune global searches.
+constexpr float kSubmapDescriptorResolution = 0.1f;
+constexpr int kSubmapDescriptorNumRings = 30;
 
 PoseGraph2D::PoseGraph2D(
     const proto::PoseGraphOptions& options,
     std::unique_ptr<optimization::OptimizationProblem2D> optimization_problem,
-    common::ThreadPool* thread_pool)
+    common::ThreadPoolInterface* thread_pool)
     : options_(options),
+      load_shedding_controller_(options_.max_work_queue_delay(),
+                                options_.min_load_shedding_factor()),
       optimization_problem_(std::move(optimization_problem)),
-      constraint_builder_(options_.constraint_builder_options(), thread_pool),
+      constraint_builder_(options_.constraint_builder_options(), thread_pool,
+                          &trajectory_cpu_time_metrics_),
       thread_pool_(thread_pool) {
+  if (options_.constraint_builder_options().max_constraint_distance() > 0.) {
+    finished_submap_index_ = absl::make_unique<FinishedSubmapIndex2D>(
+        options_.constraint_builder_options().max_constraint_distance());
+  }
+  if (options_.constraint_builder_options().global_search_num_candidates() >
+      0) {
+    submap_descriptor_index_ =
+        absl::make_unique<constraints::SubmapDescriptorIndex2D>(
+            kSubmapDescriptorResolution, kSubmapDescriptorNumRings,
+            options_.constraint_builder_options()
+                .global_search_descriptor_max_range());
+  }
   if (options.has_overlapping_submaps_trimmer_2d()) {
     const auto& trimmer_options = options.overlapping_submaps_trimmer_2d();
     AddTrimmer(absl::make_unique<OverlappingSubmapsTrimmer2D>(
         trimmer_options.fresh_submaps_count(),
         trimmer_options.min_covered_area(),
-        trimmer_options.min_added_submaps_count()));
+        trimmer_options.min_added_submaps_count(), thread_pool_));
+  }
+  if (!options_.evicted_node_data_directory().empty()) {
+    node_data_store_ = absl::make_unique<TrajectoryNodeDataStore>(
+        options_.evicted_node_data_directory());
+  }
+  if (!options_.optimized_pose_table_name().empty()) {
+    pose_table_writer_ =
+        PoseTableWriter::Create(options_.optimized_pose_table_name());
   }
 }
 
@@ -136,6 +173,11 @@ NodeId PoseGraph2D::AppendNode(
   const NodeId node_id = data_.trajectory_nodes.Append(
       trajectory_id, TrajectoryNode{constant_data, optimized_pose});
   ++data_.num_trajectory_nodes;
+  snapshot_.AddNode(node_id,
+                    TrajectoryNodePose{optimized_pose,
+                                       TrajectoryNodePose::ConstantPoseData{
+                                           constant_data->time,
+                                           constant_data->local_pose}});
   // Test if the 'insertion_submap.back()' is one we never saw before.
   if (data_.submap_data.SizeOfTrajectoryOrZero(trajectory_id) == 0 ||
       std::prev(data_.submap_data.EndOfTrajectory(trajectory_id))
@@ -145,6 +187,8 @@ NodeId PoseGraph2D::AppendNode(
     const SubmapId submap_id =
         data_.submap_data.Append(trajectory_id, InternalSubmapData());
     data_.submap_data.at(submap_id).submap = insertion_submaps.back();
+    snapshot_.AddSubmap(submap_id, PoseGraphSnapshot::SubmapEntry{
+                                       insertion_submaps.back(), {}});
     LOG(INFO) << "Inserted submap " << submap_id << ".";
     kActiveSubmapsMetric->Increment();
   }
@@ -155,6 +199,8 @@ NodeId PoseGraph2D::AddNode(
     std::shared_ptr<const TrajectoryNode::Data> constant_data,
     const int trajectory_id,
     const std::vector<std::shared_ptr<const Submap2D>>& insertion_submaps) {
+  CARTOGRAPHER_TRACE_SPAN("PoseGraph2D::AddNode",
+                          common::ToUniversal(constant_data->time));
   const transform::Rigid3d optimized_pose(
       GetLocalToGlobalTransform(trajectory_id) * constant_data->local_pose);
 
@@ -164,24 +210,45 @@ NodeId PoseGraph2D::AddNode(
   // execute the lambda.
   const bool newly_finished_submap =
       insertion_submaps.front()->insertion_finished();
-  AddWorkItem([=]() LOCKS_EXCLUDED(mutex_) {
-    return ComputeConstraintsForNode(node_id, insertion_submaps,
-                                     newly_finished_submap);
-  });
+  const auto constraint_search =
+      std::make_shared<absl::optional<ConstraintSearchForNode>>();
+  AddWorkItem(
+      [=]() LOCKS_EXCLUDED(mutex_) {
+        CARTOGRAPHER_TRACE_SPAN("PoseGraph2D::PrepareConstraintsForNode",
+                                common::ToUniversal(constant_data->time));
+        *constraint_search = PrepareConstraintsForNode(
+            node_id, insertion_submaps, newly_finished_submap);
+        return WorkItem::Result::kDoNotRunOptimization;
+      },
+      trajectory_id,
+      [=]() LOCKS_EXCLUDED(mutex_) {
+        CARTOGRAPHER_TRACE_SPAN("PoseGraph2D::ComputeConstraintsForNode",
+                                common::ToUniversal(constant_data->time));
+        return ComputeConstraintsForNode(constraint_search->value());
+      });
   return node_id;
 }
 
 void PoseGraph2D::AddWorkItem(
     const std::function<WorkItem::Result()>& work_item) {
+  AddWorkItem(work_item, -1, nullptr);
+}
+
+void PoseGraph2D::AddWorkItem(
+    const std::function<WorkItem::Result()>& task, const int trajectory_id,
+    const std::function<WorkItem::Result()>& concurrent_task) {
   absl::MutexLock locker(&work_queue_mutex_);
   if (work_queue_ == nullptr) {
     work_queue_ = absl::make_unique<WorkQueue>();
-    auto task = absl::make_unique<common::Task>();
-    task->SetWorkItem([this]() { DrainWorkQueue(); });
-    thread_pool_->Schedule(std::move(task));
+    auto drain_task = absl::make_unique<common::Task>();
+    drain_task->SetWorkItem([this]() { DrainWorkQueue(); });
+    // Draining the work queue adds the nodes of local SLAM, it must not wait
+    // behind queued constraint searches.
+    drain_task->SetPriority(common::Task::HIGH);
+    thread_pool_->Schedule(std::move(drain_task));
   }
   const auto now = std::chrono::steady_clock::now();
-  work_queue_->push_back({now, work_item});
+  work_queue_->push_back({now, task, trajectory_id, concurrent_task});
   kWorkQueueSizeMetric->Set(work_queue_->size());
   kWorkQueueDelayMetric->Set(
       std::chrono::duration_cast<std::chrono::duration<double>>(
@@ -258,11 +325,12 @@ void PoseGraph2D::AddLandmarkData(int trajectory_id,
   });
 }
 
-void PoseGraph2D::ComputeConstraint(const NodeId& node_id,
-                                    const SubmapId& submap_id) {
+void PoseGraph2D::ComputeConstraint(
+    const NodeId& node_id, const SubmapId& submap_id,
+    const constraints::GlobalLocalizationGrid2D* global_localization_grid,
+    const std::set<SubmapId>* global_search_candidates) {
   bool maybe_add_local_constraint = false;
   bool maybe_add_global_constraint = false;
-  const TrajectoryNode::Data* constant_data;
   const Submap2D* submap;
   {
     absl::MutexLock locker(&mutex_);
@@ -287,35 +355,270 @@ void PoseGraph2D::ComputeConstraint(const NodeId& node_id,
       // the submap's trajectory, it suffices to do a match constrained to a
       // local search window.
       maybe_add_local_constraint = true;
+    } else if (global_localization_grid != nullptr &&
+               global_localization_grid->Contains(submap_id)) {
+      // The global search against this submap is part of the search in the
+      // global localization grid.
+      return;
+    } else if (global_search_candidates != nullptr &&
+               global_search_candidates->count(submap_id) == 0) {
+      // The descriptor of this submap is too different from the node's.
+      return;
     } else if (global_localization_samplers_[node_id.trajectory_id]->Pulse()) {
       maybe_add_global_constraint = true;
     }
-    constant_data = data_.trajectory_nodes.at(node_id).constant_data.get();
     submap = static_cast<const Submap2D*>(
         data_.submap_data.at(submap_id).submap.get());
   }
 
+  if ((maybe_add_local_constraint || maybe_add_global_constraint) &&
+      !load_shedding_controller_.Pulse()) {
+    return;
+  }
+
   if (maybe_add_local_constraint) {
     const transform::Rigid2d initial_relative_pose =
         optimization_problem_->submap_data()
             .at(submap_id)
             .global_pose.inverse() *
         optimization_problem_->node_data().at(node_id).global_pose_2d;
+    if (initial_relative_pose.translation().norm() >
+        options_.constraint_builder_options().max_constraint_distance()) {
+      // The constraint builder would not search, so do not restore the point
+      // clouds of an evicted node.
+      return;
+    }
     constraint_builder_.MaybeAddConstraint(
-        submap_id, submap, node_id, constant_data, initial_relative_pose);
+        submap_id, submap, node_id, GetNodeDataForConstraintSearch(node_id),
+        initial_relative_pose);
   } else if (maybe_add_global_constraint) {
-    constraint_builder_.MaybeAddGlobalConstraint(submap_id, submap, node_id,
-                                                 constant_data);
+    constraint_builder_.MaybeAddGlobalConstraint(
+        submap_id, submap, node_id, GetNodeDataForConstraintSearch(node_id));
   }
 }
 
-WorkItem::Result PoseGraph2D::ComputeConstraintsForNode(
+std::shared_ptr<const constraints::GlobalLocalizationGrid2D>
+PoseGraph2D::GetGlobalLocalizationGrid() {
+  std::vector<constraints::GlobalLocalizationGrid2D::SubmapData> submaps;
+  {
+    absl::MutexLock locker(&mutex_);
+    for (const auto& submap_id_data : data_.submap_data) {
+      if (submap_id_data.data.state != SubmapState::kFinished ||
+          !IsTrajectoryFrozen(submap_id_data.id.trajectory_id) ||
+          !submap_id_data.data.submap->insertion_finished()) {
+        continue;
+      }
+      submaps.push_back(
+          {submap_id_data.id,
+           optimization_problem_->submap_data()
+               .at(submap_id_data.id)
+               .global_pose,
+           std::static_pointer_cast<const Submap2D>(
+               submap_id_data.data.submap)});
+    }
+  }
+
+  absl::MutexLock locker(&global_localization_grid_mutex_);
+  if (submaps.empty()) {
+    global_localization_grid_.reset();
+    return nullptr;
+  }
+  if (global_localization_grid_ != nullptr &&
+      global_localization_grid_->source_submap_ids().size() ==
+          submaps.size() &&
+      std::equal(submaps.begin(), submaps.end(),
+                 global_localization_grid_->source_submap_ids().begin(),
+                 [](const constraints::GlobalLocalizationGrid2D::SubmapData&
+                        submap,
+                    const SubmapId& submap_id) {
+                   return submap.submap_id == submap_id;
+                 })) {
+    return global_localization_grid_;
+  }
+  global_localization_grid_ =
+      std::make_shared<const constraints::GlobalLocalizationGrid2D>(
+          submaps,
+          options_.constraint_builder_options()
+              .fast_correlative_scan_matcher_options(),
+          options_.constraint_builder_options()
+              .global_localization_grid_linear_search_window());
+  return global_localization_grid_;
+}
+
+std::shared_ptr<const constraints::GlobalLocalizationGrid2D>
+PoseGraph2D::MaybeAddGlobalLocalizationGridConstraint(const NodeId& node_id) {
+  std::shared_ptr<const constraints::GlobalLocalizationGrid2D>
+      global_localization_grid = GetGlobalLocalizationGrid();
+  if (global_localization_grid == nullptr ||
+      global_localization_grid->empty()) {
+    return global_localization_grid;
+  }
+
+  transform::Rigid2d global_node_pose;
+  {
+    absl::MutexLock locker(&mutex_);
+    // Same decision as in ComputeConstraint(), but the sampler is pulsed once
+    // per node instead of once per submap.
+    const common::Time node_time =
+        data_.trajectory_nodes.at(node_id).constant_data->time;
+    bool global_search_due = false;
+    for (const int trajectory_id : global_localization_grid->trajectory_ids()) {
+      if (trajectory_id == node_id.trajectory_id) continue;
+      if (node_time >=
+          data_.trajectory_connectivity_state.LastConnectionTime(
+              node_id.trajectory_id, trajectory_id) +
+              common::FromSeconds(
+                  options_.global_constraint_search_after_n_seconds())) {
+        global_search_due = true;
+        break;
+      }
+    }
+    if (!global_search_due ||
+        !global_localization_samplers_[node_id.trajectory_id]->Pulse()) {
+      return global_localization_grid;
+    }
+    global_node_pose =
+        optimization_problem_->node_data().at(node_id).global_pose_2d;
+  }
+
+  if (!load_shedding_controller_.Pulse()) {
+    return global_localization_grid;
+  }
+  constraint_builder_.MaybeAddGlobalLocalizationGridConstraint(
+      global_localization_grid, node_id,
+      GetNodeDataForConstraintSearch(node_id), global_node_pose);
+  return global_localization_grid;
+}
+
+absl::optional<std::set<SubmapId>> PoseGraph2D::GetGlobalSearchCandidates(
+    const NodeId& node_id, const std::vector<SubmapId>& submap_ids,
+    const constraints::GlobalLocalizationGrid2D* global_localization_grid) {
+  const int num_candidates =
+      options_.constraint_builder_options().global_search_num_candidates();
+  if (num_candidates == 0) {
+    return absl::nullopt;
+  }
+
+  std::vector<SubmapId> global_search_submap_ids;
+  std::vector<std::shared_ptr<const Submap2D>> global_search_submaps;
+  {
+    absl::MutexLock locker(&mutex_);
+    // Same decision as in ComputeConstraint().
+    for (const SubmapId& submap_id : submap_ids) {
+      if (submap_id.trajectory_id == node_id.trajectory_id ||
+          (global_localization_grid != nullptr &&
+           global_localization_grid->Contains(submap_id))) {
+        continue;
+      }
+      const common::Time node_time = GetLatestNodeTime(node_id, submap_id);
+      if (node_time <
+          data_.trajectory_connectivity_state.LastConnectionTime(
+              node_id.trajectory_id, submap_id.trajectory_id) +
+              common::FromSeconds(
+                  options_.global_constraint_search_after_n_seconds())) {
+        continue;
+      }
+      global_search_submap_ids.push_back(submap_id);
+      global_search_submaps.push_back(std::static_pointer_cast<const Submap2D>(
+          data_.submap_data.at(submap_id).submap));
+    }
+  }
+  if (global_search_submap_ids.size() <=
+      static_cast<size_t>(num_candidates)) {
+    return absl::nullopt;
+  }
+
+  const TrajectoryNode::Data* const constant_data =
+      GetNodeDataForConstraintSearch(node_id);
+  absl::MutexLock locker(&submap_descriptor_index_mutex_);
+  for (size_t i = 0; i != global_search_submap_ids.size(); ++i) {
+    if (submap_descriptor_index_->Contains(global_search_submap_ids[i])) {
+      continue;
+    }
+    const Submap2D& submap = *global_search_submaps[i];
+    const std::shared_ptr<const Grid2D> grid = submap.LoadGrid();
+    submap_descriptor_index_->Insert(
+        global_search_submap_ids[i], *grid,
+        submap.local_pose().translation().head<2>().cast<float>());
+  }
+  const std::vector<SubmapId> closest_submap_ids =
+      submap_descriptor_index_->GetClosest(
+          submap_descriptor_index_->ComputeDescriptor(
+              constant_data->filtered_gravity_aligned_point_cloud),
+          global_search_submap_ids, num_candidates);
+  return std::set<SubmapId>(closest_submap_ids.begin(),
+                            closest_submap_ids.end());
+}
+
+const TrajectoryNode::Data* PoseGraph2D::GetNodeDataForConstraintSearch(
+    const NodeId& node_id) {
+  absl::MutexLock locker(&mutex_);
+  TrajectoryNode& node = data_.trajectory_nodes.at(node_id);
+  if (node_data_store_ != nullptr) {
+    node_data_store_->Restore(node_id, &node);
+    AddNodeToEvict(node_id);
+  }
+  // Stays valid until the next eviction, which waits for all constraint
+  // searches to finish.
+  return node.constant_data.get();
+}
+
+void PoseGraph2D::AddNodeToEvict(const NodeId& node_id) {
+  if (node_data_store_ == nullptr) return;
+  const int keep_every_n_nodes = options_.keep_node_data_every_n_nodes();
+  if (keep_every_n_nodes > 0 && node_id.node_index % keep_every_n_nodes == 0) {
+    return;
+  }
+  nodes_to_evict_.insert(node_id);
+}
+
+void PoseGraph2D::EvictNodeData() {
+  if (node_data_store_ == nullptr) return;
+  std::set<NodeId> nodes_in_unfinished_submaps;
+  for (const auto& submap_id_data : data_.submap_data) {
+    if (submap_id_data.data.state != SubmapState::kFinished) {
+      nodes_in_unfinished_submaps.insert(submap_id_data.data.node_ids.begin(),
+                                         submap_id_data.data.node_ids.end());
+    }
+  }
+  for (auto it = nodes_to_evict_.begin(); it != nodes_to_evict_.end();) {
+    if (nodes_in_unfinished_submaps.count(*it) != 0) {
+      ++it;
+      continue;
+    }
+    if (data_.trajectory_nodes.Contains(*it)) {
+      node_data_store_->Evict(*it, &data_.trajectory_nodes.at(*it));
+    }
+    it = nodes_to_evict_.erase(it);
+  }
+  kEvictedNodesMetric->Set(node_data_store_->num_evicted_nodes());
+}
+
+void PoseGraph2D::UpdateMemoryMetrics() {
+  size_t submaps_bytes = 0;
+  for (const auto& submap_id_data : data_.submap_data) {
+    // Grids of submaps loaded lazily are not held in memory.
+    const Grid2D* const grid =
+        static_cast<const Submap2D*>(submap_id_data.data.submap.get())->grid();
+    if (grid != nullptr) submaps_bytes += grid->MemoryUsageInBytes();
+  }
+  size_t nodes_bytes = 0;
+  for (const auto& node_id_data : data_.trajectory_nodes) {
+    if (node_id_data.data.constant_data != nullptr) {
+      nodes_bytes += MemoryUsageInBytes(*node_id_data.data.constant_data);
+    }
+  }
+  kSubmapsMemoryMetric->Set(submaps_bytes);
+  kNodesMemoryMetric->Set(nodes_bytes);
+  kOptimizationMemoryMetric->Set(optimization_problem_->MemoryUsageInBytes());
+}
+
+PoseGraph2D::ConstraintSearchForNode PoseGraph2D::PrepareConstraintsForNode(
     const NodeId& node_id,
     std::vector<std::shared_ptr<const Submap2D>> insertion_submaps,
     const bool newly_finished_submap) {
+  ConstraintSearchForNode constraint_search{node_id, {}, absl::nullopt, {}};
   std::vector<SubmapId> submap_ids;
-  std::vector<SubmapId> finished_submap_ids;
-  std::set<NodeId> newly_finished_submap_node_ids;
   {
     absl::MutexLock locker(&mutex_);
     const auto& constant_data =
@@ -355,47 +658,160 @@ WorkItem::Result PoseGraph2D::ComputeConstraintsForNode(
                       options_.matcher_rotation_weight()},
                      Constraint::INTRA_SUBMAP});
     }
+    AddNodeToEvict(node_id);
 
     // TODO(gaschler): Consider not searching for constraints against
     // trajectories scheduled for deletion.
-    // TODO(danielsievers): Add a member variable and avoid having to copy
-    // them out here.
-    for (const auto& submap_id_data : data_.submap_data) {
-      if (submap_id_data.data.state == SubmapState::kFinished) {
-        CHECK_EQ(submap_id_data.data.node_ids.count(node_id), 0);
-        finished_submap_ids.emplace_back(submap_id_data.id);
-      }
-    }
+    constraint_search.finished_submap_ids =
+        GetFinishedSubmapIdsForConstraintSearch(node_id);
     if (newly_finished_submap) {
       const SubmapId newly_finished_submap_id = submap_ids.front();
       InternalSubmapData& finished_submap_data =
           data_.submap_data.at(newly_finished_submap_id);
       CHECK(finished_submap_data.state == SubmapState::kNoConstraintSearch);
       finished_submap_data.state = SubmapState::kFinished;
-      newly_finished_submap_node_ids = finished_submap_data.node_ids;
+      if (finished_submap_index_ != nullptr && !finished_submap_index_dirty_) {
+        finished_submap_index_->Insert(
+            newly_finished_submap_id,
+            optimization_problem_->submap_data()
+                .at(newly_finished_submap_id)
+                .global_pose.translation(),
+            data_.trajectory_nodes.at(*finished_submap_data.node_ids.rbegin())
+                .constant_data->time);
+      }
+      // We have a new completed submap, so we look into adding constraints
+      // for old nodes. The nodes are collected here, so that nodes added
+      // afterwards are not matched twice.
+      constraint_search.newly_finished_submap_id = newly_finished_submap_id;
+      for (const auto& node_id_data : optimization_problem_->node_data()) {
+        if (finished_submap_data.node_ids.count(node_id_data.id) == 0) {
+          constraint_search.node_ids_for_newly_finished_submap.push_back(
+              node_id_data.id);
+        }
+      }
     }
   }
+  return constraint_search;
+}
 
-  for (const auto& submap_id : finished_submap_ids) {
-    ComputeConstraint(node_id, submap_id);
+std::vector<SubmapId> PoseGraph2D::GetFinishedSubmapIdsForConstraintSearch(
+    const NodeId& node_id) {
+  std::vector<SubmapId> submap_ids;
+  if (finished_submap_index_ == nullptr) {
+    for (const auto& submap_id_data : data_.submap_data) {
+      if (submap_id_data.data.state == SubmapState::kFinished) {
+        CHECK_EQ(submap_id_data.data.node_ids.count(node_id), 0);
+        submap_ids.push_back(submap_id_data.id);
+      }
+    }
+    return submap_ids;
   }
 
-  if (newly_finished_submap) {
-    const SubmapId newly_finished_submap_id = submap_ids.front();
-    // We have a new completed submap, so we look into adding constraints for
-    // old nodes.
-    for (const auto& node_id_data : optimization_problem_->node_data()) {
-      const NodeId& node_id = node_id_data.id;
-      if (newly_finished_submap_node_ids.count(node_id) == 0) {
-        ComputeConstraint(node_id, newly_finished_submap_id);
+  if (finished_submap_index_dirty_) {
+    finished_submap_index_->Clear();
+    for (const auto& submap_id_data : data_.submap_data) {
+      if (submap_id_data.data.state != SubmapState::kFinished) {
+        continue;
       }
+      // Matches the time used in ComputeConstraint() for nodes of other
+      // trajectories.
+      const common::Time last_node_time =
+          submap_id_data.data.node_ids.empty()
+              ? common::Time::min()
+              : data_.trajectory_nodes
+                    .at(*submap_id_data.data.node_ids.rbegin())
+                    .constant_data->time;
+      finished_submap_index_->Insert(submap_id_data.id,
+                                     optimization_problem_->submap_data()
+                                         .at(submap_id_data.id)
+                                         .global_pose.translation(),
+                                     last_node_time);
+    }
+    finished_submap_index_dirty_ = false;
+  }
+
+  // This mirrors the decision in ComputeConstraint(): Submaps of the node's
+  // trajectory and of trajectories recently connected to it are only matched
+  // if they are within the maximum constraint distance, other submaps are all
+  // candidates for a global search.
+  const common::Time node_time =
+      data_.trajectory_nodes.at(node_id).constant_data->time;
+  const Eigen::Vector2d node_position = optimization_problem_->node_data()
+                                            .at(node_id)
+                                            .global_pose_2d.translation();
+  for (const int trajectory_id : finished_submap_index_->trajectory_ids()) {
+    if (trajectory_id == node_id.trajectory_id) {
+      finished_submap_index_->GetNear(trajectory_id, node_position,
+                                      &submap_ids);
+      continue;
+    }
+    const common::Time global_search_time =
+        data_.trajectory_connectivity_state.LastConnectionTime(
+            node_id.trajectory_id, trajectory_id) +
+        common::FromSeconds(
+            options_.global_constraint_search_after_n_seconds());
+    if (node_time >= global_search_time) {
+      finished_submap_index_->GetAll(trajectory_id, &submap_ids);
+    } else {
+      finished_submap_index_->GetNear(trajectory_id, node_position,
+                                      &submap_ids);
+      finished_submap_index_->GetWithLastNodeNotBefore(
+          trajectory_id, global_search_time, &submap_ids);
+    }
+  }
+
+  // Keep the order of 'data_.submap_data', so that the global localization
+  // samplers are pulsed for the same submaps as without the index.
+  std::sort(submap_ids.begin(), submap_ids.end());
+  submap_ids.erase(std::unique(submap_ids.begin(), submap_ids.end()),
+                   submap_ids.end());
+  std::vector<SubmapId> finished_submap_ids;
+  for (const SubmapId& submap_id : submap_ids) {
+    if (data_.submap_data.Contains(submap_id) &&
+        data_.submap_data.at(submap_id).state == SubmapState::kFinished) {
+      CHECK_EQ(data_.submap_data.at(submap_id).node_ids.count(node_id), 0);
+      finished_submap_ids.push_back(submap_id);
+    }
+  }
+  return finished_submap_ids;
+}
+
+WorkItem::Result PoseGraph2D::ComputeConstraintsForNode(
+    const ConstraintSearchForNode& constraint_search) {
+  std::shared_ptr<const constraints::GlobalLocalizationGrid2D>
+      global_localization_grid;
+  if (options_.constraint_builder_options().use_global_localization_grid()) {
+    global_localization_grid =
+        MaybeAddGlobalLocalizationGridConstraint(constraint_search.node_id);
+  }
+  const absl::optional<std::set<SubmapId>> global_search_candidates =
+      GetGlobalSearchCandidates(constraint_search.node_id,
+                                constraint_search.finished_submap_ids,
+                                global_localization_grid.get());
+  for (const auto& submap_id : constraint_search.finished_submap_ids) {
+    ComputeConstraint(constraint_search.node_id, submap_id,
+                      global_localization_grid.get(),
+                      global_search_candidates.has_value()
+                          ? &global_search_candidates.value()
+                          : nullptr);
+  }
+
+  if (constraint_search.newly_finished_submap_id.has_value()) {
+    for (const NodeId& node_id :
+         constraint_search.node_ids_for_newly_finished_submap) {
+      ComputeConstraint(node_id,
+                        constraint_search.newly_finished_submap_id.value(),
+                        global_localization_grid.get(),
+                        nullptr /* global_search_candidates */);
     }
   }
   constraint_builder_.NotifyEndOfNode();
   absl::MutexLock locker(&mutex_);
   ++num_nodes_since_last_loop_closure_;
   if (options_.optimize_every_n_nodes() > 0 &&
-      num_nodes_since_last_loop_closure_ > options_.optimize_every_n_nodes()) {
+      num_nodes_since_last_loop_closure_ >
+          load_shedding_controller_.ScaleOptimizeEveryNNodes(
+              options_.optimize_every_n_nodes())) {
     return WorkItem::Result::kRunOptimization;
   }
   return WorkItem::Result::kDoNotRunOptimization;
@@ -425,26 +841,96 @@ void PoseGraph2D::UpdateTrajectoryConnectivity(const Constraint& constraint) {
 }
 
 void PoseGraph2D::DeleteTrajectoriesIfNeeded() {
-  TrimmingHandle trimming_handle(this);
   for (auto& it : data_.trajectories_state) {
     if (it.second.deletion_state ==
         InternalTrajectoryState::DeletionState::WAIT_FOR_DELETION) {
-      // TODO(gaschler): Consider directly deleting from data_, which may be
-      // more complete.
-      auto submap_ids = trimming_handle.GetSubmapIds(it.first);
-      for (auto& submap_id : submap_ids) {
-        trimming_handle.TrimSubmap(submap_id);
-      }
+      DeleteTrajectoryData(it.first);
       it.second.state = TrajectoryState::DELETED;
       it.second.deletion_state = InternalTrajectoryState::DeletionState::NORMAL;
     }
   }
 }
 
+void PoseGraph2D::DeleteTrajectoryData(const int trajectory_id) {
+  // Remove all constraints of the trajectory. Like in
+  // 'TrimmingHandle::TrimSubmap', submaps of other trajectories which lose
+  // all their inter-submap constraints also lose their scan matchers.
+  std::set<SubmapId> other_submap_ids_losing_constraints;
+  {
+    std::vector<Constraint> constraints;
+    for (const Constraint& constraint : data_.constraints) {
+      if (constraint.submap_id.trajectory_id != trajectory_id &&
+          constraint.node_id.trajectory_id != trajectory_id) {
+        constraints.push_back(constraint);
+      } else if (constraint.submap_id.trajectory_id != trajectory_id) {
+        other_submap_ids_losing_constraints.insert(constraint.submap_id);
+      }
+    }
+    data_.constraints = std::move(constraints);
+  }
+  for (const Constraint& constraint : data_.constraints) {
+    if (constraint.tag == Constraint::Tag::INTER_SUBMAP) {
+      other_submap_ids_losing_constraints.erase(constraint.submap_id);
+    }
+  }
+  for (const SubmapId& submap_id : other_submap_ids_losing_constraints) {
+    constraint_builder_.DeleteScanMatcher(submap_id);
+  }
+
+  int num_submaps = 0;
+  for (const auto& submap_id_data :
+       data_.submap_data.trajectory(trajectory_id)) {
+    constraint_builder_.DeleteScanMatcher(submap_id_data.id);
+    ++num_submaps;
+  }
+  kDeletedSubmapsMetric->Increment(num_submaps);
+  if (IsTrajectoryFrozen(trajectory_id)) {
+    kFrozenSubmapsMetric->Decrement(num_submaps);
+  } else {
+    kActiveSubmapsMetric->Decrement(num_submaps);
+  }
+  if (node_data_store_ != nullptr) {
+    for (const auto& node_id_data :
+         data_.trajectory_nodes.trajectory(trajectory_id)) {
+      node_data_store_->Erase(node_id_data.id);
+      nodes_to_evict_.erase(node_id_data.id);
+    }
+  }
+
+  // Detach the submaps and nodes as a whole, they are freed later without
+  // holding 'mutex_'.
+  trimmed_data_.push_back(
+      std::make_shared<MapById<SubmapId, InternalSubmapData>>(
+          data_.submap_data.ExtractTrajectory(trajectory_id)));
+  trimmed_data_.push_back(std::make_shared<MapById<NodeId, TrajectoryNode>>(
+      data_.trajectory_nodes.ExtractTrajectory(trajectory_id)));
+  optimization_problem_->TrimTrajectory(trajectory_id);
+}
+
 void PoseGraph2D::HandleWorkQueue(
-    const constraints::ConstraintBuilder2D::Result& result) {
+    const constraints::ConstraintBuilder2D::Result& unfiltered_result) {
+  constraints::ConstraintBuilder2D::Result result = unfiltered_result;
   {
     absl::MutexLock locker(&mutex_);
+    const auto& constraint_builder_options =
+        options_.constraint_builder_options();
+    if (constraint_builder_options
+            .loop_closure_consistency_max_translation_error() > 0.) {
+      const int num_rejected = constraints::RemoveInconsistentLoopClosures2D(
+          optimization_problem_->submap_data(),
+          optimization_problem_->node_data(),
+          constraint_builder_options
+              .loop_closure_consistency_max_translation_error(),
+          constraint_builder_options
+              .loop_closure_consistency_max_rotation_error(),
+          &result);
+      if (num_rejected > 0) {
+        kRejectedLoopClosuresMetric->Increment(num_rejected);
+        VLOG(1) << "Rejected " << num_rejected << " of "
+                << unfiltered_result.size()
+                << " new loop closures as inconsistent.";
+      }
+    }
     data_.constraints.insert(data_.constraints.end(), result.begin(),
                              result.end());
   }
@@ -475,11 +961,14 @@ void PoseGraph2D::HandleWorkQueue(
         trajectory_id_to_last_optimized_node_id);
   }
 
+  std::vector<std::shared_ptr<const void>> trimmed_data;
   {
     absl::MutexLock locker(&mutex_);
     for (const Constraint& constraint : result) {
       UpdateTrajectoryConnectivity(constraint);
     }
+    const size_t num_nodes = data_.trajectory_nodes.size();
+    const size_t num_submaps = data_.submap_data.size();
     DeleteTrajectoriesIfNeeded();
     TrimmingHandle trimming_handle(this);
     for (auto& trimmer : trimmers_) {
@@ -491,6 +980,15 @@ void PoseGraph2D::HandleWorkQueue(
                          return trimmer->IsFinished();
                        }),
         trimmers_.end());
+    // No constraint search is running, so point clouds can be evicted.
+    EvictNodeData();
+    UpdateMemoryMetrics();
+    if (data_.trajectory_nodes.size() != num_nodes ||
+        data_.submap_data.size() != num_submaps) {
+      PublishSnapshot();
+    }
+    // Submap poses changed with the optimization.
+    finished_submap_index_dirty_ = true;
 
     num_nodes_since_last_loop_closure_ = 0;
 
@@ -512,30 +1010,100 @@ void PoseGraph2D::HandleWorkQueue(
     kConstraintsSameTrajectoryMetric->Set(inter_constraints_same_trajectory);
     kConstraintsDifferentTrajectoryMetric->Set(
         inter_constraints_different_trajectory);
+    trimmed_data.swap(trimmed_data_);
+  }
+  // Free what was trimmed without holding 'mutex_', and without delaying the
+  // work queue, since deleting a trajectory may free a whole map.
+  if (!trimmed_data.empty()) {
+    auto release_task = absl::make_unique<common::Task>();
+    release_task->SetWorkItem(
+        [trimmed_data = std::move(trimmed_data)]() mutable {
+          trimmed_data.clear();
+        });
+    thread_pool_->Schedule(std::move(release_task));
   }
+  constraint_builder_.ReleaseDeletedScanMatchers();
 
   DrainWorkQueue();
 }
 
 void PoseGraph2D::DrainWorkQueue() {
   bool process_work_queue = true;
-  size_t work_queue_size;
   while (process_work_queue) {
-    std::function<WorkItem::Result()> work_item;
+    std::vector<WorkItem> work_items;
     {
       absl::MutexLock locker(&work_queue_mutex_);
       if (work_queue_->empty()) {
         work_queue_.reset();
         return;
       }
-      work_item = work_queue_->front().task;
-      work_queue_->pop_front();
-      work_queue_size = work_queue_->size();
-      kWorkQueueSizeMetric->Set(work_queue_size);
+      work_items = PopWorkItems();
+      kWorkQueueSizeMetric->Set(work_queue_->size());
+    }
+    load_shedding_controller_.SetWorkQueueDelay(common::ToSeconds(
+        std::chrono::steady_clock::now() - work_items.front().time));
+    kLoadSheddingFactorMetric->Set(load_shedding_controller_.factor());
+    for (const WorkItem& work_item : work_items) {
+      process_work_queue &=
+          work_item.task() == WorkItem::Result::kDoNotRunOptimization;
+    }
+    if (work_items.size() > 1) {
+      ScheduleConcurrentTasks(work_items);
+      return;
+    }
+    if (work_items.front().concurrent_task) {
+      process_work_queue = work_items.front().concurrent_task() ==
+                           WorkItem::Result::kDoNotRunOptimization;
     }
-    process_work_queue = work_item() == WorkItem::Result::kDoNotRunOptimization;
   }
-  LOG(INFO) << "Remaining work items in queue: " << work_queue_size;
+  ScheduleOptimization();
+}
+
+std::vector<WorkItem> PoseGraph2D::PopWorkItems() {
+  std::vector<WorkItem> work_items;
+  std::set<int> trajectory_ids;
+  do {
+    work_items.push_back(std::move(work_queue_->front()));
+    work_queue_->pop_front();
+  } while (work_items.back().concurrent_task &&
+           trajectory_ids.insert(work_items.back().trajectory_id).second &&
+           !work_queue_->empty() && work_queue_->front().concurrent_task &&
+           trajectory_ids.count(work_queue_->front().trajectory_id) == 0);
+  return work_items;
+}
+
+void PoseGraph2D::ScheduleConcurrentTasks(
+    const std::vector<WorkItem>& work_items) {
+  const auto results =
+      std::make_shared<std::vector<WorkItem::Result>>(work_items.size());
+  auto continuation_task = absl::make_unique<common::Task>();
+  for (size_t i = 0; i != work_items.size(); ++i) {
+    auto task = absl::make_unique<common::Task>();
+    task->SetWorkItem([results, i, work_item = work_items[i]]() {
+      (*results)[i] = work_item.concurrent_task();
+    });
+    task->SetPriority(common::Task::HIGH);
+    continuation_task->AddDependency(thread_pool_->Schedule(std::move(task)));
+  }
+  continuation_task->SetWorkItem([this, results]() {
+    if (std::all_of(results->begin(), results->end(),
+                    [](const WorkItem::Result result) {
+                      return result == WorkItem::Result::kDoNotRunOptimization;
+                    })) {
+      DrainWorkQueue();
+    } else {
+      ScheduleOptimization();
+    }
+  });
+  continuation_task->SetPriority(common::Task::HIGH);
+  thread_pool_->Schedule(std::move(continuation_task));
+}
+
+void PoseGraph2D::ScheduleOptimization() {
+  {
+    absl::MutexLock locker(&work_queue_mutex_);
+    LOG(INFO) << "Remaining work items in queue: " << work_queue_->size();
+  }
   // We have to optimize again.
   constraint_builder_.WhenDone(
       [this](const constraints::ConstraintBuilder2D::Result& result) {
@@ -641,6 +1209,7 @@ void PoseGraph2D::FinishTrajectory(const int trajectory_id) {
     for (const auto& submap : data_.submap_data.trajectory(trajectory_id)) {
       data_.submap_data.at(submap.id).state = SubmapState::kFinished;
     }
+    finished_submap_index_dirty_ = true;
     return WorkItem::Result::kRunOptimization;
   });
 }
@@ -688,20 +1257,46 @@ bool PoseGraph2D::IsTrajectoryFrozen(const int trajectory_id) const {
 
 void PoseGraph2D::AddSubmapFromProto(
     const transform::Rigid3d& global_submap_pose, const proto::Submap& submap) {
+  AddSubmapFromProto(global_submap_pose,
+                     SubmapId{submap.submap_id().trajectory_id(),
+                              submap.submap_id().submap_index()},
+                     SubmapFromProto(submap));
+}
+
+std::shared_ptr<const Submap> PoseGraph2D::SubmapFromProto(
+    const proto::Submap& submap) {
   if (!submap.has_submap_2d()) {
-    return;
+    return nullptr;
+  }
+  const auto submap_ptr =
+      std::make_shared<Submap2D>(submap.submap_2d(), &conversion_tables_);
+  if (options_.compact_loaded_submaps() && submap_ptr->insertion_finished()) {
+    submap_ptr->CompactGrid();
+  }
+  return submap_ptr;
+}
+
+std::shared_ptr<const Submap> PoseGraph2D::LazySubmapFromProto(
+    const proto::Submap& submap, Submap2D::GridLoader grid_loader) {
+  if (!submap.has_submap_2d() || !submap.submap_2d().finished()) {
+    return SubmapFromProto(submap);
   }
+  return std::make_shared<Submap2D>(submap.submap_2d(), std::move(grid_loader),
+                                    options_.compact_loaded_submaps(),
+                                    &conversion_tables_);
+}
 
-  const SubmapId submap_id = {submap.submap_id().trajectory_id(),
-                              submap.submap_id().submap_index()};
+void PoseGraph2D::AddSubmapFromProto(
+    const transform::Rigid3d& global_submap_pose, const SubmapId& submap_id,
+    std::shared_ptr<const Submap> submap_ptr) {
+  if (submap_ptr == nullptr) {
+    return;
+  }
 
   const transform::Rigid2d global_submap_pose_2d =
       transform::Project2D(global_submap_pose);
   {
     absl::MutexLock locker(&mutex_);
-    const std::shared_ptr<const Submap2D> submap_ptr =
-        std::make_shared<const Submap2D>(submap.submap_2d(),
-                                         &conversion_tables_);
     AddTrajectoryIfNeeded(submap_id.trajectory_id);
     if (!CanAddWorkItemModifying(submap_id.trajectory_id)) return;
     data_.submap_data.Insert(submap_id, InternalSubmapData());
@@ -709,6 +1304,10 @@ void PoseGraph2D::AddSubmapFromProto(
     // Immediately show the submap at the 'global_submap_pose'.
     data_.global_submap_poses_2d.Insert(
         submap_id, optimization::SubmapSpec2D{global_submap_pose_2d});
+    snapshot_.AddSubmap(
+        submap_id, PoseGraphSnapshot::SubmapEntry{
+                       submap_ptr, transform::Embed3D(global_submap_pose_2d)});
+    snapshot_.InvalidateLocalToGlobalTransform(submap_id.trajectory_id);
   }
 
   // TODO(MichaelGrupp): MapBuilder does freezing before deserializing submaps,
@@ -724,23 +1323,34 @@ void PoseGraph2D::AddSubmapFromProto(
         absl::MutexLock locker(&mutex_);
         data_.submap_data.at(submap_id).state = SubmapState::kFinished;
         optimization_problem_->InsertSubmap(submap_id, global_submap_pose_2d);
+        finished_submap_index_dirty_ = true;
         return WorkItem::Result::kDoNotRunOptimization;
       });
 }
 
 void PoseGraph2D::AddNodeFromProto(const transform::Rigid3d& global_pose,
                                    const proto::Node& node) {
-  const NodeId node_id = {node.node_id().trajectory_id(),
-                          node.node_id().node_index()};
-  std::shared_ptr<const TrajectoryNode::Data> constant_data =
-      std::make_shared<const TrajectoryNode::Data>(FromProto(node.node_data()));
+  AddNodeFromProto(
+      global_pose,
+      NodeId{node.node_id().trajectory_id(), node.node_id().node_index()},
+      std::make_shared<const TrajectoryNode::Data>(
+          FromProto(node.node_data())));
+}
 
+void PoseGraph2D::AddNodeFromProto(
+    const transform::Rigid3d& global_pose, const NodeId& node_id,
+    std::shared_ptr<const TrajectoryNode::Data> constant_data) {
   {
     absl::MutexLock locker(&mutex_);
     AddTrajectoryIfNeeded(node_id.trajectory_id);
     if (!CanAddWorkItemModifying(node_id.trajectory_id)) return;
     data_.trajectory_nodes.Insert(node_id,
                                   TrajectoryNode{constant_data, global_pose});
+    snapshot_.AddNode(
+        node_id, TrajectoryNodePose{global_pose,
+                                    TrajectoryNodePose::ConstantPoseData{
+                                        constant_data->time,
+                                        constant_data->local_pose}});
   }
 
   AddWorkItem([this, node_id, global_pose]() LOCKS_EXCLUDED(mutex_) {
@@ -757,6 +1367,7 @@ void PoseGraph2D::AddNodeFromProto(const transform::Rigid3d& global_pose,
                                  gravity_alignment_inverse),
             transform::Project2D(global_pose * gravity_alignment_inverse),
             constant_data->gravity_alignment});
+    AddNodeToEvict(node_id);
     return WorkItem::Result::kDoNotRunOptimization;
   });
 }
@@ -789,6 +1400,7 @@ void PoseGraph2D::AddNodeToSubmap(const NodeId& node_id,
     absl::MutexLock locker(&mutex_);
     if (CanAddWorkItemModifying(submap_id.trajectory_id)) {
       data_.submap_data.at(submap_id).node_ids.insert(node_id);
+      finished_submap_index_dirty_ = true;
     }
     return WorkItem::Result::kDoNotRunOptimization;
   });
@@ -828,6 +1440,132 @@ void PoseGraph2D::AddSerializedConstraints(
   });
 }
 
+void PoseGraph2D::SearchCrossTrajectoryConstraints(
+    const CrossTrajectorySearchOptions& search_options) {
+  CHECK_GT(search_options.node_stride, 0);
+  AddWorkItem([this, search_options]() LOCKS_EXCLUDED(mutex_) {
+    std::vector<std::pair<SubmapId, std::shared_ptr<const Submap2D>>> submaps;
+    // The submaps each trajectory's nodes are matched against.
+    std::map<int, std::vector<SubmapId>> candidate_submap_ids;
+    std::vector<NodeId> node_ids;
+    {
+      absl::MutexLock locker(&mutex_);
+      for (const auto& submap_id_data : data_.submap_data) {
+        if (submap_id_data.data.state != SubmapState::kFinished ||
+            !submap_id_data.data.submap->insertion_finished()) {
+          continue;
+        }
+        submaps.emplace_back(submap_id_data.id,
+                             std::static_pointer_cast<const Submap2D>(
+                                 submap_id_data.data.submap));
+      }
+      for (const int trajectory_id : data_.trajectory_nodes.trajectory_ids()) {
+        std::vector<SubmapId>& submap_ids = candidate_submap_ids[trajectory_id];
+        for (const auto& submap : submaps) {
+          if (submap.first.trajectory_id != trajectory_id &&
+              !(IsTrajectoryFrozen(trajectory_id) &&
+                IsTrajectoryFrozen(submap.first.trajectory_id))) {
+            submap_ids.push_back(submap.first);
+          }
+        }
+        if (submap_ids.empty()) continue;
+        int i = 0;
+        for (const auto& node_id_data :
+             data_.trajectory_nodes.trajectory(trajectory_id)) {
+          if (i++ % search_options.node_stride == 0 &&
+              node_id_data.data.constant_data != nullptr) {
+            node_ids.push_back(node_id_data.id);
+          }
+        }
+      }
+    }
+
+    struct Search {
+      float distance;
+      NodeId node_id;
+      SubmapId submap_id;
+    };
+    std::vector<Search> searches;
+    std::map<NodeId, const TrajectoryNode::Data*> node_data;
+    {
+      absl::MutexLock locker(&submap_descriptor_index_mutex_);
+      if (submap_descriptor_index_ == nullptr) {
+        submap_descriptor_index_ =
+            absl::make_unique<constraints::SubmapDescriptorIndex2D>(
+                kSubmapDescriptorResolution, kSubmapDescriptorNumRings,
+                options_.constraint_builder_options()
+                    .global_search_descriptor_max_range());
+      }
+      for (const auto& submap : submaps) {
+        if (!submap_descriptor_index_->Contains(submap.first)) {
+          const Submap2D& submap_2d = *submap.second;
+          const std::shared_ptr<const Grid2D> grid = submap_2d.LoadGrid();
+          submap_descriptor_index_->Insert(
+              submap.first, *grid,
+              submap_2d.local_pose().translation().head<2>().cast<float>());
+        }
+      }
+    }
+    for (const NodeId& node_id : node_ids) {
+      const TrajectoryNode::Data* const constant_data =
+          GetNodeDataForConstraintSearch(node_id);
+      node_data.emplace(node_id, constant_data);
+      absl::MutexLock locker(&submap_descriptor_index_mutex_);
+      const Eigen::VectorXf node_descriptor =
+          submap_descriptor_index_->ComputeDescriptor(
+              constant_data->filtered_gravity_aligned_point_cloud);
+      for (const SubmapId& submap_id : submap_descriptor_index_->GetClosest(
+               node_descriptor, candidate_submap_ids.at(node_id.trajectory_id),
+               search_options.num_candidates_per_node)) {
+        searches.push_back(Search{
+            submap_descriptor_index_->GetDistance(node_descriptor, submap_id),
+            node_id, submap_id});
+      }
+    }
+    std::sort(searches.begin(), searches.end(),
+              [](const Search& lhs, const Search& rhs) {
+                return lhs.distance < rhs.distance;
+              });
+    const size_t max_num_searches =
+        std::max(search_options.max_num_searches, 0);
+    if (searches.size() > max_num_searches) {
+      searches.erase(searches.begin() + max_num_searches, searches.end());
+    }
+    LOG(INFO) << "Searching " << searches.size()
+              << " cross-trajectory constraints of " << node_ids.size()
+              << " nodes.";
+
+    // The searches of a node share its rotated scans, so they are added
+    // together, starting with the node of the closest pair.
+    std::vector<NodeId> ordered_node_ids;
+    std::map<NodeId, std::vector<SubmapId>> submap_ids_by_node;
+    for (const Search& search : searches) {
+      std::vector<SubmapId>& submap_ids = submap_ids_by_node[search.node_id];
+      if (submap_ids.empty()) {
+        ordered_node_ids.push_back(search.node_id);
+      }
+      submap_ids.push_back(search.submap_id);
+    }
+    for (const NodeId& node_id : ordered_node_ids) {
+      for (const SubmapId& submap_id : submap_ids_by_node.at(node_id)) {
+        const Submap2D* submap;
+        {
+          absl::MutexLock locker(&mutex_);
+          submap = static_cast<const Submap2D*>(
+              data_.submap_data.at(submap_id).submap.get());
+        }
+        constraint_builder_.MaybeAddGlobalConstraint(
+            submap_id, submap, node_id, node_data.at(node_id));
+      }
+      // Loaded nodes are not counted by 'num_trajectory_nodes', so the searches
+      // must not count them as finished either.
+      constraint_builder_.NotifyEndOfAdditionalSearches();
+    }
+    return searches.empty() ? WorkItem::Result::kDoNotRunOptimization
+                            : WorkItem::Result::kRunOptimization;
+  });
+}
+
 void PoseGraph2D::AddTrimmer(std::unique_ptr<PoseGraphTrimmer> trimmer) {
   // C++11 does not allow us to move a unique_ptr into a lambda.
   PoseGraphTrimmer* const trimmer_ptr = trimmer.release();
@@ -844,6 +1582,7 @@ void PoseGraph2D::RunFinalOptimization() {
       absl::MutexLock locker(&mutex_);
       optimization_problem_->SetMaxNumIterations(
           options_.max_num_final_iterations());
+      optimization_problem_->RequestFullOptimization();
       return WorkItem::Result::kRunOptimization;
     });
     AddWorkItem([this]() LOCKS_EXCLUDED(mutex_) {
@@ -858,6 +1597,49 @@ void PoseGraph2D::RunFinalOptimization() {
   WaitForAllComputations();
 }
 
+void PoseGraph2D::RunFinalOptimizationAsync(
+    FinalOptimizationCallback callback) {
+  AddFinalOptimizationRound(0, std::move(callback));
+}
+
+void PoseGraph2D::AddFinalOptimizationRound(
+    const int num_iterations, FinalOptimizationCallback callback) {
+  const int max_num_iterations = options_.optimization_problem_options()
+                                     .ceres_solver_options()
+                                     .max_num_iterations();
+  const int round_num_iterations = std::max(
+      1, std::min(max_num_iterations,
+                  options_.max_num_final_iterations() - num_iterations));
+  AddWorkItem([this, round_num_iterations]() LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock locker(&mutex_);
+    optimization_problem_->SetMaxNumIterations(round_num_iterations);
+    optimization_problem_->RequestFullOptimization();
+    return WorkItem::Result::kRunOptimization;
+  });
+  AddWorkItem([this, num_iterations, max_num_iterations,
+               callback]() LOCKS_EXCLUDED(mutex_) {
+    optimization::SolveSummary summary;
+    {
+      absl::MutexLock locker(&mutex_);
+      optimization_problem_->SetMaxNumIterations(max_num_iterations);
+      summary = optimization_problem_->last_solve_summary();
+    }
+    const int total_num_iterations = num_iterations + summary.num_iterations;
+    const bool done =
+        summary.converged || summary.num_iterations == 0 ||
+        total_num_iterations >= options_.max_num_final_iterations();
+    LOG(INFO) << "Final optimization: " << total_num_iterations
+              << " iterations, cost " << summary.final_cost
+              << (done ? ", done." : ".");
+    if (callback(FinalOptimizationProgress{total_num_iterations,
+                                           summary.final_cost, done}) &&
+        !done) {
+      AddFinalOptimizationRound(total_num_iterations, callback);
+    }
+    return WorkItem::Result::kDoNotRunOptimization;
+  });
+}
+
 void PoseGraph2D::RunOptimization() {
   if (optimization_problem_->submap_data().empty()) {
     return;
@@ -867,8 +1649,36 @@ void PoseGraph2D::RunOptimization() {
   // data_.constraints, data_.frozen_trajectories and data_.landmark_nodes
   // when executing the Solve. Solve is time consuming, so not taking the mutex
   // before Solve to avoid blocking foreground processing.
-  optimization_problem_->Solve(data_.constraints, GetTrajectoryStates(),
-                               data_.landmark_nodes);
+  const std::map<int, TrajectoryState> trajectory_states =
+      GetTrajectoryStates();
+  const int intra_submap_constraint_stride =
+      options_.finished_submap_intra_constraint_stride();
+  std::vector<Constraint> sparsified_constraints;
+  if (intra_submap_constraint_stride > 0) {
+    sparsified_constraints =
+        SparsifyConstraints(data_.constraints, trajectory_states,
+                            intra_submap_constraint_stride);
+  }
+  const auto start_time = std::chrono::steady_clock::now();
+  const double start_cpu_time_seconds = common::GetThreadCpuTimeSeconds();
+  optimization_problem_->Solve(intra_submap_constraint_stride > 0
+                                   ? sparsified_constraints
+                                   : data_.constraints,
+                               trajectory_states, data_.landmark_nodes);
+  kOptimizationDurationMetric->Observe(
+      common::ToSeconds(std::chrono::steady_clock::now() - start_time));
+  // Only counts the CPU time of this thread, not that of the solver threads.
+  std::map<int, int> num_nodes_per_trajectory;
+  for (const int trajectory_id :
+       optimization_problem_->node_data().trajectory_ids()) {
+    num_nodes_per_trajectory[trajectory_id] =
+        optimization_problem_->node_data().SizeOfTrajectoryOrZero(
+            trajectory_id);
+  }
+  trajectory_cpu_time_metrics_.AddShares(
+      num_nodes_per_trajectory,
+      TrajectoryCpuTimeMetrics::Activity::kOptimization,
+      common::GetThreadCpuTimeSeconds() - start_cpu_time_seconds);
   absl::MutexLock locker(&mutex_);
 
   const auto& submap_data = optimization_problem_->submap_data();
@@ -906,6 +1716,7 @@ void PoseGraph2D::RunOptimization() {
     data_.landmark_nodes[landmark.first].global_landmark_pose = landmark.second;
   }
   data_.global_submap_poses_2d = submap_data;
+  PublishSnapshot();
 }
 
 bool PoseGraph2D::CanAddWorkItemModifying(int trajectory_id) {
@@ -938,25 +1749,25 @@ bool PoseGraph2D::CanAddWorkItemModifying(int trajectory_id) {
 
 MapById<NodeId, TrajectoryNode> PoseGraph2D::GetTrajectoryNodes() const {
   absl::MutexLock locker(&mutex_);
-  return data_.trajectory_nodes;
+  if (node_data_store_ == nullptr) {
+    return data_.trajectory_nodes;
+  }
+  // Evicted nodes are returned with their point clouds, e.g. for
+  // serialization, but stay evicted in the pose graph.
+  MapById<NodeId, TrajectoryNode> trajectory_nodes;
+  for (const auto& node_id_data : data_.trajectory_nodes) {
+    trajectory_nodes.Insert(
+        node_id_data.id,
+        TrajectoryNode{node_data_store_->GetFullData(node_id_data.id,
+                                                     node_id_data.data),
+                       node_id_data.data.global_pose});
+  }
+  return trajectory_nodes;
 }
 
 MapById<NodeId, TrajectoryNodePose> PoseGraph2D::GetTrajectoryNodePoses()
     const {
-  MapById<NodeId, TrajectoryNodePose> node_poses;
-  absl::MutexLock locker(&mutex_);
-  for (const auto& node_id_data : data_.trajectory_nodes) {
-    absl::optional<TrajectoryNodePose::ConstantPoseData> constant_pose_data;
-    if (node_id_data.data.constant_data != nullptr) {
-      constant_pose_data = TrajectoryNodePose::ConstantPoseData{
-          node_id_data.data.constant_data->time,
-          node_id_data.data.constant_data->local_pose};
-    }
-    node_poses.Insert(
-        node_id_data.id,
-        TrajectoryNodePose{node_id_data.data.global_pose, constant_pose_data});
-  }
-  return node_poses;
+  return snapshot_.GetTrajectoryNodePoses();
 }
 
 std::map<int, PoseGraphInterface::TrajectoryState>
@@ -1022,8 +1833,19 @@ PoseGraph2D::GetFixedFramePoseData() const {
 }
 
 std::vector<PoseGraphInterface::Constraint> PoseGraph2D::constraints() const {
-  std::vector<PoseGraphInterface::Constraint> result;
   absl::MutexLock locker(&mutex_);
+  return ComputeConstraints();
+}
+
+PoseGraphInterface::ConstraintsSnapshot PoseGraph2D::GetConstraintsSnapshot()
+    const {
+  return snapshot_.GetConstraints();
+}
+
+std::vector<PoseGraphInterface::Constraint> PoseGraph2D::ComputeConstraints()
+    const {
+  std::vector<PoseGraphInterface::Constraint> result;
+  result.reserve(data_.constraints.size());
   for (const Constraint& constraint : data_.constraints) {
     result.push_back(Constraint{
         constraint.submap_id, constraint.node_id,
@@ -1070,6 +1892,11 @@ transform::Rigid3d PoseGraph2D::GetInterpolatedGlobalTrajectoryPose(
 
 transform::Rigid3d PoseGraph2D::GetLocalToGlobalTransform(
     const int trajectory_id) const {
+  const absl::optional<transform::Rigid3d> local_to_global =
+      snapshot_.GetLocalToGlobalTransform(trajectory_id);
+  if (local_to_global.has_value()) {
+    return local_to_global.value();
+  }
   absl::MutexLock locker(&mutex_);
   return ComputeLocalToGlobalTransform(data_.global_submap_poses_2d,
                                        trajectory_id);
@@ -1094,16 +1921,12 @@ PoseGraph2D::GetAllSubmapData() const {
 
 MapById<SubmapId, PoseGraphInterface::SubmapPose>
 PoseGraph2D::GetAllSubmapPoses() const {
-  absl::MutexLock locker(&mutex_);
-  MapById<SubmapId, SubmapPose> submap_poses;
-  for (const auto& submap_id_data : data_.submap_data) {
-    auto submap_data = GetSubmapDataUnderLock(submap_id_data.id);
-    submap_poses.Insert(
-        submap_id_data.id,
-        PoseGraph::SubmapPose{submap_data.submap->num_range_data(),
-                              submap_data.pose});
-  }
-  return submap_poses;
+  return snapshot_.GetAllSubmapPoses(
+      [this](const int trajectory_id) LOCKS_EXCLUDED(mutex_) {
+        absl::MutexLock locker(&mutex_);
+        return ComputeLocalToGlobalTransform(data_.global_submap_poses_2d,
+                                             trajectory_id);
+      });
 }
 
 transform::Rigid3d PoseGraph2D::ComputeLocalToGlobalTransform(
@@ -1149,6 +1972,54 @@ PoseGraphInterface::SubmapData PoseGraph2D::GetSubmapDataUnderLock(
                       submap->local_pose()};
 }
 
+void PoseGraph2D::PublishSnapshot() {
+  MapById<NodeId, TrajectoryNodePose> trajectory_node_poses;
+  for (const auto& node_id_data : data_.trajectory_nodes) {
+    absl::optional<TrajectoryNodePose::ConstantPoseData> constant_pose_data;
+    if (node_id_data.data.constant_data != nullptr) {
+      constant_pose_data = TrajectoryNodePose::ConstantPoseData{
+          node_id_data.data.constant_data->time,
+          node_id_data.data.constant_data->local_pose};
+    }
+    trajectory_node_poses.Insert(
+        node_id_data.id,
+        TrajectoryNodePose{node_id_data.data.global_pose, constant_pose_data});
+  }
+  MapById<SubmapId, PoseGraphSnapshot::SubmapEntry> submaps;
+  for (const auto& submap_id_data : data_.submap_data) {
+    absl::optional<transform::Rigid3d> global_pose;
+    if (data_.global_submap_poses_2d.Contains(submap_id_data.id)) {
+      global_pose = transform::Embed3D(
+          data_.global_submap_poses_2d.at(submap_id_data.id).global_pose);
+    }
+    submaps.Insert(submap_id_data.id,
+                   PoseGraphSnapshot::SubmapEntry{submap_id_data.data.submap,
+                                                   global_pose});
+  }
+  // Only trajectories with optimized submaps are included, the transform of
+  // other trajectories can change with the initial trajectory poses.
+  std::map<int, transform::Rigid3d> local_to_global_transforms;
+  const auto& global_submap_poses = data_.global_submap_poses_2d;
+  for (const int trajectory_id : global_submap_poses.trajectory_ids()) {
+    if (global_submap_poses.SizeOfTrajectoryOrZero(trajectory_id) > 0) {
+      local_to_global_transforms.emplace(
+          trajectory_id,
+          ComputeLocalToGlobalTransform(global_submap_poses, trajectory_id));
+    }
+  }
+  if (pose_table_writer_ != nullptr) {
+    MapById<SubmapId, transform::Rigid3d> submap_poses;
+    for (const auto& submap_id_pose : global_submap_poses) {
+      submap_poses.Insert(submap_id_pose.id,
+                          transform::Embed3D(submap_id_pose.data.global_pose));
+    }
+    pose_table_writer_->Write(trajectory_node_poses, submap_poses);
+  }
+  snapshot_.Publish(std::move(trajectory_node_poses), std::move(submaps),
+                    std::move(local_to_global_transforms),
+                    ComputeConstraints());
+}
+
 PoseGraph2D::TrimmingHandle::TrimmingHandle(PoseGraph2D* const parent)
     : parent_(parent) {}
 
@@ -1278,6 +2149,8 @@ void PoseGraph2D::TrimmingHandle::TrimSubmap(const SubmapId& submap_id) {
   // Mark the submap with 'submap_id' as trimmed and remove its data.
   CHECK(parent_->data_.submap_data.at(submap_id).state ==
         SubmapState::kFinished);
+  parent_->trimmed_data_.push_back(
+      parent_->data_.submap_data.at(submap_id).submap);
   parent_->data_.submap_data.Trim(submap_id);
   parent_->constraint_builder_.DeleteScanMatcher(submap_id);
   parent_->optimization_problem_->TrimSubmap(submap_id);
@@ -1293,8 +2166,14 @@ void PoseGraph2D::TrimmingHandle::TrimSubmap(const SubmapId& submap_id) {
   // Remove the 'nodes_to_remove' from the pose graph and the optimization
   // problem.
   for (const NodeId& node_id : nodes_to_remove) {
+    parent_->trimmed_data_.push_back(
+        parent_->data_.trajectory_nodes.at(node_id).constant_data);
     parent_->data_.trajectory_nodes.Trim(node_id);
     parent_->optimization_problem_->TrimTrajectoryNode(node_id);
+    if (parent_->node_data_store_ != nullptr) {
+      parent_->node_data_store_->Erase(node_id);
+      parent_->nodes_to_evict_.erase(node_id);
+    }
   }
 }
 
@@ -1334,6 +2213,29 @@ void PoseGraph2D::RegisterMetrics(metrics::FamilyFactory* family_factory) {
   kActiveSubmapsMetric = submaps->Add({{"state", "active"}});
   kFrozenSubmapsMetric = submaps->Add({{"state", "frozen"}});
   kDeletedSubmapsMetric = submaps->Add({{"state", "deleted"}});
+  auto* optimization_duration = family_factory->NewHistogramFamily(
+      "mapping_2d_pose_graph_optimization_duration",
+      "Wall time in seconds to solve the optimization problem",
+      metrics::Histogram::ScaledPowersOf(2, 1e-3, 1000));
+  kOptimizationDurationMetric = optimization_duration->Add({});
+  auto* load_shedding_factor = family_factory->NewGaugeFamily(
+      "mapping_2d_pose_graph_load_shedding_factor",
+      "Factor by which loop closure sampling ratios are currently scaled");
+  kLoadSheddingFactorMetric = load_shedding_factor->Add({});
+  auto* evicted_nodes = family_factory->NewGaugeFamily(
+      "mapping_2d_pose_graph_evicted_nodes",
+      "Number of nodes whose point clouds are not held in memory");
+  kEvictedNodesMetric = evicted_nodes->Add({});
+  auto* memory = family_factory->NewGaugeFamily(
+      "mapping_2d_pose_graph_memory",
+      "Estimated bytes held by the pose graph, by subsystem");
+  kSubmapsMemoryMetric = memory->Add({{"kind", "submaps"}});
+  kNodesMemoryMetric = memory->Add({{"kind", "nodes"}});
+  kOptimizationMemoryMetric = memory->Add({{"kind", "optimization"}});
+  auto* rejected_loop_closures = family_factory->NewCounterFamily(
+      "mapping_2d_pose_graph_rejected_loop_closures",
+      "Number of loop closures rejected as inconsistent with the others");
+  kRejectedLoopClosuresMetric = rejected_loop_closures->Add({});
 }
 
 }  // namespace mapping
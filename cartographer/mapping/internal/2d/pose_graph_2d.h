@@ -29,16 +29,25 @@
 #include "Eigen/Geometry"
 #include "absl/container/flat_hash_map.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
 #include "cartographer/common/fixed_ratio_sampler.h"
 #include "cartographer/common/thread_pool.h"
 #include "cartographer/common/time.h"
 #include "cartographer/mapping/2d/submap_2d.h"
+#include "cartographer/mapping/internal/2d/finished_submap_index_2d.h"
 #include "cartographer/mapping/internal/constraints/constraint_builder_2d.h"
+#include "cartographer/mapping/internal/constraints/global_localization_grid_2d.h"
+#include "cartographer/mapping/internal/constraints/submap_descriptor_index_2d.h"
+#include "cartographer/mapping/internal/load_shedding_controller.h"
 #include "cartographer/mapping/internal/optimization/optimization_problem_2d.h"
 #include "cartographer/mapping/internal/pose_graph_data.h"
+#include "cartographer/mapping/internal/pose_graph_snapshot.h"
 #include "cartographer/mapping/internal/trajectory_connectivity_state.h"
+#include "cartographer/mapping/internal/trajectory_cpu_time_metrics.h"
+#include "cartographer/mapping/internal/trajectory_node_data_store.h"
 #include "cartographer/mapping/internal/work_queue.h"
 #include "cartographer/mapping/pose_graph.h"
+#include "cartographer/mapping/pose_table.h"
 #include "cartographer/mapping/pose_graph_trimmer.h"
 #include "cartographer/mapping/value_conversion_tables.h"
 #include "cartographer/metrics/family_factory.h"
@@ -66,7 +75,7 @@ class PoseGraph2D : public PoseGraph {
   PoseGraph2D(
       const proto::PoseGraphOptions& options,
       std::unique_ptr<optimization::OptimizationProblem2D> optimization_problem,
-      common::ThreadPool* thread_pool);
+      common::ThreadPoolInterface* thread_pool);
   ~PoseGraph2D() override;
 
   PoseGraph2D(const PoseGraph2D&) = delete;
@@ -107,13 +116,49 @@ class PoseGraph2D : public PoseGraph {
                           const proto::Submap& submap) override;
   void AddNodeFromProto(const transform::Rigid3d& global_pose,
                         const proto::Node& node) override;
+  std::shared_ptr<const Submap> SubmapFromProto(
+      const proto::Submap& submap) override;
+  // Like SubmapFromProto(), but the grid of a finished submap is only read
+  // using 'grid_loader' when it is used, see Submap2D::LoadGrid().
+  std::shared_ptr<const Submap> LazySubmapFromProto(
+      const proto::Submap& submap, Submap2D::GridLoader grid_loader);
+  void AddSubmapFromProto(const transform::Rigid3d& global_submap_pose,
+                          const SubmapId& submap_id,
+                          std::shared_ptr<const Submap> submap) override;
+  void AddNodeFromProto(
+      const transform::Rigid3d& global_pose, const NodeId& node_id,
+      std::shared_ptr<const TrajectoryNode::Data> constant_data) override;
   void SetTrajectoryDataFromProto(const proto::TrajectoryData& data) override;
   void AddNodeToSubmap(const NodeId& node_id,
                        const SubmapId& submap_id) override;
   void AddSerializedConstraints(
       const std::vector<Constraint>& constraints) override;
+
+  // Limits the search of SearchCrossTrajectoryConstraints().
+  struct CrossTrajectorySearchOptions {
+    // Only every n-th node of each trajectory is matched.
+    int node_stride = 1;
+    // Number of submaps of other trajectories each node is matched against,
+    // those with the closest descriptors.
+    int num_candidates_per_node = 3;
+    // Total number of full submap matches, which bounds the CPU time of the
+    // search. The node and submap pairs with the closest descriptors are
+    // matched.
+    int max_num_searches = 10000;
+  };
+
+  // Searches global constraints between the nodes and the finished submaps
+  // of different trajectories in a single batch, e.g. to merge the maps of
+  // several loaded states. Pairs of frozen trajectories are left out. All
+  // scan matchers are built concurrently, then the constraints found are
+  // optimized together. Restores the point clouds of evicted nodes which are
+  // matched until the next optimization.
+  void SearchCrossTrajectoryConstraints(
+      const CrossTrajectorySearchOptions& search_options)
+      LOCKS_EXCLUDED(mutex_);
   void AddTrimmer(std::unique_ptr<PoseGraphTrimmer> trimmer) override;
   void RunFinalOptimization() override;
+  void RunFinalOptimizationAsync(FinalOptimizationCallback callback) override;
   std::vector<std::vector<int>> GetConnectedTrajectories() const override
       LOCKS_EXCLUDED(mutex_);
   PoseGraphInterface::SubmapData GetSubmapData(const SubmapId& submap_id) const
@@ -147,6 +192,7 @@ class PoseGraph2D : public PoseGraph {
   std::map<int, TrajectoryData> GetTrajectoryData() const override
       LOCKS_EXCLUDED(mutex_);
   std::vector<Constraint> constraints() const override LOCKS_EXCLUDED(mutex_);
+  ConstraintsSnapshot GetConstraintsSnapshot() const override;
   void SetInitialTrajectoryPose(int from_trajectory_id, int to_trajectory_id,
                                 const transform::Rigid3d& pose,
                                 const common::Time time) override
@@ -165,7 +211,14 @@ class PoseGraph2D : public PoseGraph {
 
   // Handles a new work item.
   void AddWorkItem(const std::function<WorkItem::Result()>& work_item)
-      LOCKS_EXCLUDED(mutex_) LOCKS_EXCLUDED(work_queue_mutex_);
+      LOCKS_EXCLUDED(mutex_, work_queue_mutex_);
+
+  // Handles a new work item of 'trajectory_id' which is split into 'task',
+  // run in queue order, and 'concurrent_task'. See WorkItem.
+  void AddWorkItem(const std::function<WorkItem::Result()>& task,
+                   int trajectory_id,
+                   const std::function<WorkItem::Result()>& concurrent_task)
+      LOCKS_EXCLUDED(mutex_, work_queue_mutex_);
 
   // Adds connectivity and sampler for a trajectory if it does not exist.
   void AddTrajectoryIfNeeded(int trajectory_id)
@@ -186,34 +239,115 @@ class PoseGraph2D : public PoseGraph {
       const std::vector<std::shared_ptr<const Submap2D>>& insertion_submaps)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-  // Adds constraints for a node, and starts scan matching in the background.
-  WorkItem::Result ComputeConstraintsForNode(
+  // The constraint search for a node, which is determined in queue order.
+  struct ConstraintSearchForNode {
+    NodeId node_id;
+    std::vector<SubmapId> finished_submap_ids;
+    // Set if the node finished a submap. Then all other nodes are matched
+    // against it.
+    absl::optional<SubmapId> newly_finished_submap_id;
+    std::vector<NodeId> node_ids_for_newly_finished_submap;
+  };
+
+  // Adds a node and its intra submap constraints to the optimization problem
+  // and returns the constraint search for it.
+  ConstraintSearchForNode PrepareConstraintsForNode(
       const NodeId& node_id,
       std::vector<std::shared_ptr<const Submap2D>> insertion_submaps,
       bool newly_finished_submap) LOCKS_EXCLUDED(mutex_);
 
-  // Computes constraints for a node and submap pair.
-  void ComputeConstraint(const NodeId& node_id, const SubmapId& submap_id)
+  // Returns the finished submaps which 'node_id' may be matched against in
+  // ComputeConstraint(), in the order of 'data_.submap_data'. Only submaps
+  // near the node are returned unless a global search is done against their
+  // trajectory.
+  std::vector<SubmapId> GetFinishedSubmapIdsForConstraintSearch(
+      const NodeId& node_id) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Adds constraints for a node, and starts scan matching in the background.
+  // Only reads the optimization problem, so it may run concurrently for nodes
+  // of different trajectories.
+  WorkItem::Result ComputeConstraintsForNode(
+      const ConstraintSearchForNode& constraint_search) LOCKS_EXCLUDED(mutex_);
+
+  // Computes constraints for a node and submap pair. Global searches against
+  // submaps fused into 'global_localization_grid' are skipped, they are done
+  // by MaybeAddGlobalLocalizationGridConstraint(). If
+  // 'global_search_candidates' is not nullptr, global searches are only done
+  // against the submaps in it. Both may be nullptr.
+  void ComputeConstraint(
+      const NodeId& node_id, const SubmapId& submap_id,
+      const constraints::GlobalLocalizationGrid2D* global_localization_grid,
+      const std::set<SubmapId>* global_search_candidates)
+      LOCKS_EXCLUDED(mutex_);
+
+  // Returns the submaps of 'submap_ids' which 'node_id' is due to be globally
+  // matched against and which have the descriptors closest to the one of the
+  // node, see 'global_search_num_candidates'. Returns nullopt if all global
+  // searches should be done.
+  absl::optional<std::set<SubmapId>> GetGlobalSearchCandidates(
+      const NodeId& node_id, const std::vector<SubmapId>& submap_ids,
+      const constraints::GlobalLocalizationGrid2D* global_localization_grid)
+      LOCKS_EXCLUDED(mutex_) LOCKS_EXCLUDED(submap_descriptor_index_mutex_);
+
+  // Returns the grid fusing the finished submaps of all frozen trajectories,
+  // rebuilding it if these changed. Returns nullptr if there are none.
+  std::shared_ptr<const constraints::GlobalLocalizationGrid2D>
+  GetGlobalLocalizationGrid() LOCKS_EXCLUDED(mutex_)
+      LOCKS_EXCLUDED(global_localization_grid_mutex_);
+
+  // Schedules a single search of 'node_id' in the global localization grid if
+  // the node is due for a global search against one of its trajectories.
+  // Returns the grid, or nullptr if there is none.
+  std::shared_ptr<const constraints::GlobalLocalizationGrid2D>
+  MaybeAddGlobalLocalizationGridConstraint(const NodeId& node_id)
       LOCKS_EXCLUDED(mutex_);
 
   // Deletes trajectories waiting for deletion. Must not be called during
   // constraint search.
   void DeleteTrajectoriesIfNeeded() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Removes all submaps, nodes and constraints of 'trajectory_id' at once,
+  // instead of trimming its submaps one by one. Its submaps and nodes are
+  // moved to 'trimmed_data_'.
+  void DeleteTrajectoryData(int trajectory_id)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   // Runs the optimization, executes the trimmers and processes the work queue.
   void HandleWorkQueue(const constraints::ConstraintBuilder2D::Result& result)
-      LOCKS_EXCLUDED(mutex_) LOCKS_EXCLUDED(work_queue_mutex_);
+      LOCKS_EXCLUDED(mutex_, work_queue_mutex_);
 
   // Process pending tasks in the work queue on the calling thread, until the
-  // queue is either empty or an optimization is required.
+  // queue is either empty or an optimization is required. Work items which
+  // can run concurrently are scheduled on the thread pool, which continues
+  // draining the work queue once they are done.
   void DrainWorkQueue() LOCKS_EXCLUDED(mutex_)
       LOCKS_EXCLUDED(work_queue_mutex_);
 
+  // Removes the next work items to run from the work queue. Either a single
+  // work item or adjacent work items with a 'concurrent_task' of different
+  // trajectories.
+  std::vector<WorkItem> PopWorkItems()
+      EXCLUSIVE_LOCKS_REQUIRED(work_queue_mutex_);
+
+  // Schedules the 'concurrent_task' of 'work_items' on the thread pool,
+  // followed by either draining the work queue or the optimization.
+  void ScheduleConcurrentTasks(const std::vector<WorkItem>& work_items)
+      LOCKS_EXCLUDED(mutex_, work_queue_mutex_);
+
+  // Runs the optimization once all constraints are computed.
+  void ScheduleOptimization() LOCKS_EXCLUDED(mutex_)
+      LOCKS_EXCLUDED(work_queue_mutex_);
+
   // Waits until we caught up (i.e. nothing is waiting to be scheduled), and
   // all computations have finished.
   void WaitForAllComputations() LOCKS_EXCLUDED(mutex_)
       LOCKS_EXCLUDED(work_queue_mutex_);
 
+  // Adds the work items for a round of 'RunFinalOptimizationAsync' after
+  // 'num_iterations' solver iterations.
+  void AddFinalOptimizationRound(int num_iterations,
+                                 FinalOptimizationCallback callback)
+      LOCKS_EXCLUDED(mutex_, work_queue_mutex_);
+
   // Runs the optimization. Callers have to make sure, that there is only one
   // optimization being run at a time.
   void RunOptimization() LOCKS_EXCLUDED(mutex_);
@@ -230,6 +364,12 @@ class PoseGraph2D : public PoseGraph {
   SubmapData GetSubmapDataUnderLock(const SubmapId& submap_id) const
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Publishes the current poses to 'snapshot_'.
+  void PublishSnapshot() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Converts 'data_.constraints' into the format of constraints().
+  std::vector<Constraint> ComputeConstraints() const
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   common::Time GetLatestNodeTime(const NodeId& node_id,
                                  const SubmapId& submap_id) const
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
@@ -238,6 +378,22 @@ class PoseGraph2D : public PoseGraph {
   void UpdateTrajectoryConnectivity(const Constraint& constraint)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Marks the point clouds of 'node_id' for eviction unless it is a keyframe.
+  void AddNodeToEvict(const NodeId& node_id) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Evicts the point clouds of marked nodes which are no longer inserted into
+  // unfinished submaps. Must only be called while no constraint search runs.
+  void EvictNodeData() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Updates the gauges of the memory held by submaps, nodes and the
+  // optimization problem.
+  void UpdateMemoryMetrics() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Returns the data of 'node_id' for a constraint search, restoring its point
+  // clouds until the next eviction if needed.
+  const TrajectoryNode::Data* GetNodeDataForConstraintSearch(
+      const NodeId& node_id) LOCKS_EXCLUDED(mutex_);
+
   const proto::PoseGraphOptions options_;
   GlobalSlamOptimizationCallback global_slam_optimization_callback_;
   mutable absl::Mutex mutex_;
@@ -251,21 +407,66 @@ class PoseGraph2D : public PoseGraph {
   absl::flat_hash_map<int, std::unique_ptr<common::FixedRatioSampler>>
       global_localization_samplers_ GUARDED_BY(mutex_);
 
+  // Thins out loop closure searches and optimizations while the work queue is
+  // delayed.
+  LoadSheddingController load_shedding_controller_;
+
   // Number of nodes added since last loop closure.
   int num_nodes_since_last_loop_closure_ GUARDED_BY(mutex_) = 0;
 
   // Current optimization problem.
   std::unique_ptr<optimization::OptimizationProblem2D> optimization_problem_;
+  // Declared before 'constraint_builder_', which adds to it.
+  TrajectoryCpuTimeMetrics trajectory_cpu_time_metrics_;
   constraints::ConstraintBuilder2D constraint_builder_;
 
   // Thread pool used for handling the work queue.
-  common::ThreadPool* const thread_pool_;
+  common::ThreadPoolInterface* const thread_pool_;
 
   // List of all trimmers to consult when optimizations finish.
   std::vector<std::unique_ptr<PoseGraphTrimmer>> trimmers_ GUARDED_BY(mutex_);
 
   PoseGraphData data_ GUARDED_BY(mutex_);
 
+  // Finished submaps by their global position, used to only look at nearby
+  // submaps when searching for constraints. Null if the constraint distance
+  // is not limited. Rebuilt on the next constraint search once 'dirty'.
+  std::unique_ptr<FinishedSubmapIndex2D> finished_submap_index_
+      GUARDED_BY(mutex_);
+  bool finished_submap_index_dirty_ GUARDED_BY(mutex_) = true;
+
+  // Fused submaps of the frozen trajectories, see
+  // 'use_global_localization_grid'. Replaced, never modified, so searches
+  // already scheduled keep using the grid they were scheduled with.
+  absl::Mutex global_localization_grid_mutex_;
+  std::shared_ptr<const constraints::GlobalLocalizationGrid2D>
+      global_localization_grid_ GUARDED_BY(global_localization_grid_mutex_);
+
+  // Descriptors of finished submaps, added when they are first considered for
+  // a global search. Null if 'global_search_num_candidates' is 0, until
+  // SearchCrossTrajectoryConstraints() creates it.
+  absl::Mutex submap_descriptor_index_mutex_;
+  std::unique_ptr<constraints::SubmapDescriptorIndex2D> submap_descriptor_index_
+      GUARDED_BY(submap_descriptor_index_mutex_);
+
+  // Submaps and node data removed by trimming. They are released on the
+  // thread pool once 'mutex_' is no longer held, so that freeing their grids
+  // and point clouds does not block other users of the pose graph.
+  std::vector<std::shared_ptr<const void>> trimmed_data_ GUARDED_BY(mutex_);
+
+  // Holds the point clouds of evicted nodes. Null if nodes keep their point
+  // clouds in memory.
+  std::unique_ptr<TrajectoryNodeDataStore> node_data_store_ GUARDED_BY(mutex_);
+
+  // Publishes the optimized poses to other processes. Null if disabled.
+  std::unique_ptr<PoseTableWriter> pose_table_writer_ GUARDED_BY(mutex_);
+  // Nodes holding point clouds which are evicted by EvictNodeData().
+  std::set<NodeId> nodes_to_evict_ GUARDED_BY(mutex_);
+
+  // Poses which are read without taking 'mutex_'. Updated while holding
+  // 'mutex_' whenever poses change.
+  PoseGraphSnapshot snapshot_;
+
   ValueConversionTables conversion_tables_;
 
   // Allows querying and manipulating the pose graph by the 'trimmers_'. The
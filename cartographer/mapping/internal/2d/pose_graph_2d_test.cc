@@ -19,8 +19,10 @@
 #include <cmath>
 #include <memory>
 #include <random>
+#include <set>
 
 #include "absl/memory/memory.h"
+#include "absl/synchronization/notification.h"
 #include "cartographer/common/lua_parameter_dictionary_test_helpers.h"
 #include "cartographer/common/thread_pool.h"
 #include "cartographer/common/time.h"
@@ -52,9 +54,12 @@ class PoseGraph2DTest : public ::testing::Test {
       auto parameter_dictionary = common::MakeDictionary(R"text(
           return {
             num_range_data = 1,
+            insert_in_parallel = false,
             grid_options_2d = {
               grid_type = "PROBABILITY_GRID",
               resolution = 0.05,
+              compact_finished_grid = false,
+              encode_serialized_cells = false,
             },
             range_data_inserter = {
               range_data_inserter_type = "PROBABILITY_GRID_INSERTER_2D",
@@ -78,8 +83,9 @@ class PoseGraph2DTest : public ::testing::Test {
             },
           },
         })text");
-      active_submaps_ = absl::make_unique<ActiveSubmaps2D>(
-          mapping::CreateSubmapsOptions2D(parameter_dictionary.get()));
+      submaps_options_ =
+          mapping::CreateSubmapsOptions2D(parameter_dictionary.get());
+      active_submaps_ = absl::make_unique<ActiveSubmaps2D>(submaps_options_);
     }
 
     {
@@ -94,19 +100,34 @@ class PoseGraph2DTest : public ::testing::Test {
               loop_closure_translation_weight = 1.,
               loop_closure_rotation_weight = 1.,
               log_matches = true,
+              max_submap_scan_matchers_memory_in_mb = 0,
+              scan_matcher_cells_pool_size_in_mb = 0,
+              early_termination_score = 0.,
+              use_global_localization_grid = false,
+              global_localization_grid_linear_search_window = 0.,
+              global_search_num_candidates = 0,
+              global_search_descriptor_max_range = 30.,
+              loop_closure_consistency_max_translation_error = 0.,
+              loop_closure_consistency_max_rotation_error = 0.,
               fast_correlative_scan_matcher = {
                 linear_search_window = 3.,
                 angular_search_window = 0.1,
                 branch_and_bound_depth = 3,
+                full_submap_match_num_tasks = 1,
+                precomputation_num_tasks = 1,
               },
               ceres_scan_matcher = {
                 occupied_space_weight = 20.,
                 translation_weight = 10.,
                 rotation_weight = 1.,
+                warm_start = false,
+                function_tolerance = 0.,
                 ceres_solver_options = {
                   use_nonmonotonic_steps = true,
                   max_num_iterations = 50,
                   num_threads = 1,
+                  linear_solver_type = "",
+                  sparse_linear_algebra_library_type = "",
                 },
               },
               fast_correlative_scan_matcher_3d = {
@@ -123,10 +144,13 @@ class PoseGraph2DTest : public ::testing::Test {
                 translation_weight = 10.,
                 rotation_weight = 1.,
                 only_optimize_yaw = true,
+                num_points_per_residual_block = 0,
                 ceres_solver_options = {
                   use_nonmonotonic_steps = true,
                   max_num_iterations = 50,
                   num_threads = 1,
+                  linear_solver_type = "",
+                  sparse_linear_algebra_library_type = "",
                 },
               },
             },
@@ -148,22 +172,38 @@ class PoseGraph2DTest : public ::testing::Test {
               log_solver_summary = true,
               use_online_imu_extrinsics_in_3d = true,
               fix_z_in_3d = false,
+              incremental_optimization_num_hops = 0,
+              incremental_optimization_radius = 0.,
+              full_optimization_every_n_optimizations = 0,
+              eliminate_submaps_first = false,
+              use_analytical_jacobians_in_3d = false,
+              imu_aggregation_duration_in_3d = 0.,
               ceres_solver_options = {
                 use_nonmonotonic_steps = false,
                 max_num_iterations = 200,
                 num_threads = 1,
+                linear_solver_type = "",
+                sparse_linear_algebra_library_type = "",
               },
             },
             max_num_final_iterations = 200,
             global_sampling_ratio = 0.01,
             log_residual_histograms = true,
             global_constraint_search_after_n_seconds = 10.0,
+            compact_loaded_submaps = false,
+            lazy_load_frozen_submaps = false,
+            max_work_queue_delay = 0.,
+            min_load_shedding_factor = 0.1,
+            finished_submap_intra_constraint_stride = 0,
+            evicted_node_data_directory = "",
+            keep_node_data_every_n_nodes = 0,
+            optimized_pose_table_name = "",
           })text");
-      auto options = CreatePoseGraphOptions(parameter_dictionary.get());
+      pose_graph_options_ = CreatePoseGraphOptions(parameter_dictionary.get());
       pose_graph_ = absl::make_unique<PoseGraph2D>(
-          options,
+          pose_graph_options_,
           absl::make_unique<optimization::OptimizationProblem2D>(
-              options.optimization_problem_options()),
+              pose_graph_options_.optimization_problem_options()),
           &thread_pool_);
     }
 
@@ -173,20 +213,28 @@ class PoseGraph2DTest : public ::testing::Test {
   void MoveRelativeWithNoise(const transform::Rigid2d& movement,
                              const transform::Rigid2d& noise) {
     current_pose_ = current_pose_ * movement;
+    constexpr int kTrajectoryId = 0;
+    AddNode(current_pose_, noise * current_pose_, kTrajectoryId,
+            active_submaps_.get(), pose_graph_.get());
+  }
+
+  // Adds a node observed at 'pose' with 'pose_estimate' to 'trajectory_id' of
+  // 'pose_graph', after inserting its range data into 'active_submaps'.
+  void AddNode(const transform::Rigid2d& pose,
+               const transform::Rigid2d& pose_estimate, const int trajectory_id,
+               ActiveSubmaps2D* const active_submaps,
+               PoseGraph2D* const pose_graph) {
     const sensor::PointCloud new_point_cloud = sensor::TransformPointCloud(
-        point_cloud_,
-        transform::Embed3D(current_pose_.inverse().cast<float>()));
+        point_cloud_, transform::Embed3D(pose.inverse().cast<float>()));
     const sensor::RangeData range_data{
         Eigen::Vector3f::Zero(), new_point_cloud, {}};
-    const transform::Rigid2d pose_estimate = noise * current_pose_;
-    constexpr int kTrajectoryId = 0;
-    active_submaps_->InsertRangeData(TransformRangeData(
+    active_submaps->InsertRangeData(TransformRangeData(
         range_data, transform::Embed3D(pose_estimate.cast<float>())));
     std::vector<std::shared_ptr<const Submap2D>> insertion_submaps;
-    for (const auto& submap : active_submaps_->submaps()) {
+    for (const auto& submap : active_submaps->submaps()) {
       insertion_submaps.push_back(submap);
     }
-    pose_graph_->AddNode(
+    pose_graph->AddNode(
         std::make_shared<const TrajectoryNode::Data>(
             TrajectoryNode::Data{common::FromUniversal(0),
                                  Eigen::Quaterniond::Identity(),
@@ -195,7 +243,7 @@ class PoseGraph2DTest : public ::testing::Test {
                                  {},
                                  {},
                                  transform::Embed3D(pose_estimate)}),
-        kTrajectoryId, insertion_submaps);
+        trajectory_id, insertion_submaps);
   }
 
   void MoveRelative(const transform::Rigid2d& movement) {
@@ -208,7 +256,9 @@ class PoseGraph2DTest : public ::testing::Test {
   }
 
   sensor::PointCloud point_cloud_;
+  proto::SubmapsOptions2D submaps_options_;
   std::unique_ptr<ActiveSubmaps2D> active_submaps_;
+  proto::PoseGraphOptions pose_graph_options_;
   common::ThreadPool thread_pool_;
   std::unique_ptr<PoseGraph2D> pose_graph_;
   transform::Rigid2d current_pose_;
@@ -237,6 +287,28 @@ TEST_F(PoseGraph2DTest, NoMovement) {
               transform::IsNearly(transform::Rigid3d::Identity(), 1e-2));
 }
 
+TEST_F(PoseGraph2DTest, AsyncFinalOptimization) {
+  MoveRelative(transform::Rigid2d::Identity());
+  MoveRelative(transform::Rigid2d::Identity());
+  absl::Notification done;
+  int num_calls = 0;
+  pose_graph_->RunFinalOptimizationAsync(
+      [&done, &num_calls](
+          const PoseGraphInterface::FinalOptimizationProgress& progress) {
+        ++num_calls;
+        EXPECT_LE(progress.num_iterations, 200);
+        if (progress.done) {
+          done.Notify();
+        }
+        return true;
+      });
+  done.WaitForNotification();
+  EXPECT_GE(num_calls, 1);
+  const auto nodes = pose_graph_->GetTrajectoryNodes();
+  EXPECT_THAT(nodes.at(NodeId{0, 1}).global_pose,
+              transform::IsNearly(transform::Rigid3d::Identity(), 1e-2));
+}
+
 TEST_F(PoseGraph2DTest, NoOverlappingNodes) {
   std::mt19937 rng(0);
   std::uniform_real_distribution<double> distribution(-1., 1.);
@@ -313,6 +385,54 @@ TEST_F(PoseGraph2DTest, OverlappingNodes) {
               ::testing::Lt(error_before.translation().norm()));
 }
 
+TEST_F(PoseGraph2DTest, DrainsWorkQueueOfConcurrentTrajectories) {
+  // Optimizations are scheduled while nodes of both trajectories are added.
+  pose_graph_options_.set_optimize_every_n_nodes(3);
+  common::ThreadPool thread_pool(4);
+  PoseGraph2D pose_graph(
+      pose_graph_options_,
+      absl::make_unique<optimization::OptimizationProblem2D>(
+          pose_graph_options_.optimization_problem_options()),
+      &thread_pool);
+  // Interleaving the nodes of both trajectories lets the work queue compute
+  // their constraints concurrently, two at a time.
+  constexpr size_t kNumNodes = 10;
+  ActiveSubmaps2D active_submaps_0(submaps_options_);
+  ActiveSubmaps2D active_submaps_1(submaps_options_);
+  for (size_t i = 0; i != kNumNodes; ++i) {
+    const transform::Rigid2d pose({0., 0.1 * i}, 0.);
+    AddNode(pose, pose, 0, &active_submaps_0, &pose_graph);
+    AddNode(pose, pose, 1, &active_submaps_1, &pose_graph);
+  }
+  // Runs alone, after the constraints of all nodes of trajectory 0.
+  pose_graph.FinishTrajectory(0);
+  AddNode(transform::Rigid2d({0., 0.1 * kNumNodes}, 0.),
+          transform::Rigid2d({0., 0.1 * kNumNodes}, 0.), 1, &active_submaps_1,
+          &pose_graph);
+  pose_graph.RunFinalOptimization();
+
+  const auto nodes = pose_graph.GetTrajectoryNodes();
+  ASSERT_THAT(ToVectorInt(nodes.trajectory_ids()),
+              ::testing::ElementsAre(0, 1));
+  EXPECT_EQ(nodes.SizeOfTrajectoryOrZero(0), kNumNodes);
+  EXPECT_EQ(nodes.SizeOfTrajectoryOrZero(1), kNumNodes + 1);
+  // Each node was prepared after its submaps were added and has an
+  // intra-submap constraint.
+  std::set<NodeId> constrained_node_ids;
+  for (const auto& constraint : pose_graph.constraints()) {
+    if (constraint.tag == PoseGraphInterface::Constraint::INTRA_SUBMAP) {
+      constrained_node_ids.insert(constraint.node_id);
+    }
+  }
+  for (const auto& node_id_data : nodes) {
+    EXPECT_THAT(constrained_node_ids, ::testing::Contains(node_id_data.id));
+  }
+  EXPECT_EQ(pose_graph.GetTrajectoryStates().at(0),
+            PoseGraphInterface::TrajectoryState::FINISHED);
+  EXPECT_EQ(pose_graph.GetTrajectoryStates().at(1),
+            PoseGraphInterface::TrajectoryState::ACTIVE);
+}
+
 }  // namespace
 }  // namespace mapping
 }  // namespace cartographer
@@ -32,6 +32,12 @@ std::vector<Eigen::Array2i> RayToPixelMask(const Eigen::Array2i& scaled_begin,
                                            const Eigen::Array2i& scaled_end,
                                            int subpixel_scale);
 
+// Same as above, but replaces the contents of 'pixel_mask', so that its memory
+// can be reused when casting many rays.
+void RayToPixelMask(const Eigen::Array2i& scaled_begin,
+                    const Eigen::Array2i& scaled_end, int subpixel_scale,
+                    std::vector<Eigen::Array2i>* pixel_mask);
+
 }  // namespace mapping
 }  // namespace cartographer
 
@@ -202,6 +202,23 @@ TEST(RayToPixelMaskTest, MultiScaleSkewedLine) {
                                PixelMaskEqual(Eigen::Array2i({9, 9}))));
 }
 
+TEST(RayToPixelMaskTest, ReusesBuffer) {
+  const int subpixel_scale = 10;
+  std::vector<Eigen::Array2i> ray = {{100, 100}};
+  for (const Eigen::Array2i& end :
+       {Eigen::Array2i(95, 3), Eigen::Array2i(3, 95), Eigen::Array2i(47, 47),
+        Eigen::Array2i(15, 60)}) {
+    const Eigen::Array2i begin(45, 55);
+    RayToPixelMask(begin, end, subpixel_scale, &ray);
+    const std::vector<Eigen::Array2i> expected_ray =
+        RayToPixelMask(begin, end, subpixel_scale);
+    ASSERT_EQ(ray.size(), expected_ray.size());
+    for (size_t i = 0; i != ray.size(); ++i) {
+      EXPECT_THAT(ray[i], PixelMaskEqual(expected_ray[i]));
+    }
+  }
+}
+
 }  // namespace
 }  // namespace mapping
 }  // namespace cartographer
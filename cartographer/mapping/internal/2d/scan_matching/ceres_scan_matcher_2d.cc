@@ -16,6 +16,7 @@
 
 #include "cartographer/mapping/internal/2d/scan_matching/ceres_scan_matcher_2d.h"
 
+#include <algorithm>
 #include <utility>
 #include <vector>
 
@@ -47,6 +48,9 @@ proto::CeresScanMatcherOptions2D CreateCeresScanMatcherOptions2D(
   *options.mutable_ceres_solver_options() =
       common::CreateCeresSolverOptionsProto(
           parameter_dictionary->GetDictionary("ceres_solver_options").get());
+  options.set_warm_start(parameter_dictionary->GetBool("warm_start"));
+  options.set_function_tolerance(
+      parameter_dictionary->GetDouble("function_tolerance"));
   return options;
 }
 
@@ -56,6 +60,9 @@ CeresScanMatcher2D::CeresScanMatcher2D(
       ceres_solver_options_(
           common::CreateCeresSolverOptions(options.ceres_solver_options())) {
   ceres_solver_options_.linear_solver_type = ceres::DENSE_QR;
+  if (options_.function_tolerance() > 0.) {
+    ceres_solver_options_.function_tolerance = options_.function_tolerance();
+  }
 }
 
 CeresScanMatcher2D::~CeresScanMatcher2D() {}
@@ -65,30 +72,59 @@ void CeresScanMatcher2D::Match(const Eigen::Vector2d& target_translation,
                                const sensor::PointCloud& point_cloud,
                                const Grid2D& grid,
                                transform::Rigid2d* const pose_estimate,
-                               ceres::Solver::Summary* const summary) const {
-  double ceres_pose_estimate[3] = {initial_pose_estimate.translation().x(),
-                                   initial_pose_estimate.translation().y(),
-                                   initial_pose_estimate.rotation().angle()};
-  ceres::Problem problem;
+                               ceres::Solver::Summary* const summary,
+                               WarmStartState* const warm_start_state) const {
   CHECK_GT(options_.occupied_space_weight(), 0.);
+  const double occupied_space_scaling_factor =
+      options_.occupied_space_weight() /
+      std::sqrt(static_cast<double>(point_cloud.size()));
+  ceres::CostFunction* occupied_space_cost_function = nullptr;
   switch (grid.GetGridType()) {
     case GridType::PROBABILITY_GRID:
-      problem.AddResidualBlock(
-          CreateOccupiedSpaceCostFunction2D(
-              options_.occupied_space_weight() /
-                  std::sqrt(static_cast<double>(point_cloud.size())),
-              point_cloud, grid),
-          nullptr /* loss function */, ceres_pose_estimate);
+      occupied_space_cost_function =
+          CreateAnalyticalOccupiedSpaceCostFunction2D(
+              occupied_space_scaling_factor, point_cloud, grid);
       break;
     case GridType::TSDF:
-      problem.AddResidualBlock(
-          CreateTSDFMatchCostFunction2D(
-              options_.occupied_space_weight() /
-                  std::sqrt(static_cast<double>(point_cloud.size())),
-              point_cloud, static_cast<const TSDF2D&>(grid)),
-          nullptr /* loss function */, ceres_pose_estimate);
+      occupied_space_cost_function = CreateTSDFMatchCostFunction2D(
+          occupied_space_scaling_factor, point_cloud,
+          static_cast<const TSDF2D&>(grid));
       break;
   }
+  Solve(target_translation, initial_pose_estimate,
+        occupied_space_cost_function, pose_estimate, summary,
+        warm_start_state);
+}
+
+void CeresScanMatcher2D::Match(const Eigen::Vector2d& target_translation,
+                               const transform::Rigid2d& initial_pose_estimate,
+                               const sensor::PointCloud& point_cloud,
+                               const TSDFField2D& tsdf_field,
+                               transform::Rigid2d* const pose_estimate,
+                               ceres::Solver::Summary* const summary,
+                               WarmStartState* const warm_start_state) const {
+  CHECK_GT(options_.occupied_space_weight(), 0.);
+  Solve(target_translation, initial_pose_estimate,
+        CreateTSDFMatchCostFunction2D(
+            options_.occupied_space_weight() /
+                std::sqrt(static_cast<double>(point_cloud.size())),
+            point_cloud, tsdf_field),
+        pose_estimate, summary, warm_start_state);
+}
+
+void CeresScanMatcher2D::Solve(
+    const Eigen::Vector2d& target_translation,
+    const transform::Rigid2d& initial_pose_estimate,
+    ceres::CostFunction* const occupied_space_cost_function,
+    transform::Rigid2d* const pose_estimate,
+    ceres::Solver::Summary* const summary,
+    WarmStartState* const warm_start_state) const {
+  double ceres_pose_estimate[3] = {initial_pose_estimate.translation().x(),
+                                   initial_pose_estimate.translation().y(),
+                                   initial_pose_estimate.rotation().angle()};
+  ceres::Problem problem;
+  problem.AddResidualBlock(occupied_space_cost_function,
+                           nullptr /* loss function */, ceres_pose_estimate);
   CHECK_GT(options_.translation_weight(), 0.);
   problem.AddResidualBlock(
       TranslationDeltaCostFunctor2D::CreateAutoDiffCostFunction(
@@ -100,7 +136,22 @@ void CeresScanMatcher2D::Match(const Eigen::Vector2d& target_translation,
           options_.rotation_weight(), ceres_pose_estimate[2]),
       nullptr /* loss function */, ceres_pose_estimate);
 
-  ceres::Solve(ceres_solver_options_, &problem, summary);
+  if (options_.warm_start() && warm_start_state != nullptr) {
+    // Only ever widen the initial trust region: if the last solve ended with a
+    // small radius, starting this one as cautiously is not worth it.
+    ceres::Solver::Options solver_options = ceres_solver_options_;
+    solver_options.initial_trust_region_radius = std::min(
+        std::max(solver_options.initial_trust_region_radius,
+                 warm_start_state->trust_region_radius),
+        solver_options.max_trust_region_radius);
+    ceres::Solve(solver_options, &problem, summary);
+    if (!summary->iterations.empty()) {
+      warm_start_state->trust_region_radius =
+          summary->iterations.back().trust_region_radius;
+    }
+  } else {
+    ceres::Solve(ceres_solver_options_, &problem, summary);
+  }
 
   *pose_estimate = transform::Rigid2d(
       {ceres_pose_estimate[0], ceres_pose_estimate[1]}, ceres_pose_estimate[2]);
@@ -23,6 +23,7 @@
 #include "Eigen/Core"
 #include "cartographer/common/lua_parameter_dictionary.h"
 #include "cartographer/mapping/2d/grid_2d.h"
+#include "cartographer/mapping/internal/2d/scan_matching/tsdf_field_2d.h"
 #include "cartographer/mapping/proto/scan_matching/ceres_scan_matcher_options_2d.pb.h"
 #include "cartographer/sensor/point_cloud.h"
 #include "ceres/ceres.h"
@@ -43,16 +44,42 @@ class CeresScanMatcher2D {
   CeresScanMatcher2D(const CeresScanMatcher2D&) = delete;
   CeresScanMatcher2D& operator=(const CeresScanMatcher2D&) = delete;
 
+  // Carried from one solve to the next by callers matching consecutive scans.
+  // Only used with 'warm_start'.
+  struct WarmStartState {
+    // Trust region radius the last solve ended with, 0 before the first one.
+    double trust_region_radius = 0.;
+  };
+
   // Aligns 'point_cloud' within the 'grid' given an
   // 'initial_pose_estimate' and returns a 'pose_estimate' and the solver
-  // 'summary'.
+  // 'summary'. If 'warm_start_state' is given, the solve starts from and
+  // updates it.
   void Match(const Eigen::Vector2d& target_translation,
              const transform::Rigid2d& initial_pose_estimate,
              const sensor::PointCloud& point_cloud, const Grid2D& grid,
              transform::Rigid2d* pose_estimate,
-             ceres::Solver::Summary* summary) const;
+             ceres::Solver::Summary* summary,
+             WarmStartState* warm_start_state = nullptr) const;
+
+  // Like above, but matches in the 'tsdf_field' of a finished TSDF.
+  void Match(const Eigen::Vector2d& target_translation,
+             const transform::Rigid2d& initial_pose_estimate,
+             const sensor::PointCloud& point_cloud,
+             const TSDFField2D& tsdf_field, transform::Rigid2d* pose_estimate,
+             ceres::Solver::Summary* summary,
+             WarmStartState* warm_start_state = nullptr) const;
 
  private:
+  // Solves for the pose with the 'occupied_space_cost_function' and the
+  // translation and rotation delta costs.
+  void Solve(const Eigen::Vector2d& target_translation,
+             const transform::Rigid2d& initial_pose_estimate,
+             ceres::CostFunction* occupied_space_cost_function,
+             transform::Rigid2d* pose_estimate,
+             ceres::Solver::Summary* summary,
+             WarmStartState* warm_start_state) const;
+
   const proto::CeresScanMatcherOptions2D options_;
   ceres::Solver::Options ceres_solver_options_;
 };
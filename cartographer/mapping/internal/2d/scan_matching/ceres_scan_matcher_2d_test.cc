@@ -49,10 +49,14 @@ class CeresScanMatcherTest : public ::testing::Test {
           occupied_space_weight = 1.,
           translation_weight = 0.1,
           rotation_weight = 1.5,
+          warm_start = false,
+          function_tolerance = 0.,
           ceres_solver_options = {
             use_nonmonotonic_steps = true,
             max_num_iterations = 50,
             num_threads = 1,
+            linear_solver_type = "",
+            sparse_linear_algebra_library_type = "",
           },
         })text");
     const proto::CeresScanMatcherOptions2D options =
@@ -96,6 +100,44 @@ TEST_F(CeresScanMatcherTest, testOptimizeAlongXY) {
   TestFromInitialPose(transform::Rigid2d::Translation({-0.3, 0.3}));
 }
 
+TEST_F(CeresScanMatcherTest, WarmStart) {
+  auto parameter_dictionary = common::MakeDictionary(R"text(
+      return {
+        occupied_space_weight = 1.,
+        translation_weight = 0.1,
+        rotation_weight = 1.5,
+        warm_start = true,
+        function_tolerance = 1e-4,
+        ceres_solver_options = {
+          use_nonmonotonic_steps = true,
+          max_num_iterations = 50,
+          num_threads = 1,
+          linear_solver_type = "",
+          sparse_linear_algebra_library_type = "",
+        },
+      })text");
+  const proto::CeresScanMatcherOptions2D options =
+      CreateCeresScanMatcherOptions2D(parameter_dictionary.get());
+  EXPECT_TRUE(options.warm_start());
+  EXPECT_DOUBLE_EQ(1e-4, options.function_tolerance());
+  const CeresScanMatcher2D ceres_scan_matcher(options);
+  const transform::Rigid2d expected_pose =
+      transform::Rigid2d::Translation({-0.5, 0.5});
+  CeresScanMatcher2D::WarmStartState warm_start_state;
+  for (const transform::Rigid2d& initial_pose :
+       {transform::Rigid2d::Translation({-0.3, 0.3}),
+        transform::Rigid2d::Translation({-0.45, 0.45})}) {
+    transform::Rigid2d pose;
+    ceres::Solver::Summary summary;
+    ceres_scan_matcher.Match(initial_pose.translation(), initial_pose,
+                             point_cloud_, probability_grid_, &pose, &summary,
+                             &warm_start_state);
+    EXPECT_GT(warm_start_state.trust_region_radius, 0.);
+    EXPECT_THAT(pose, transform::IsNearly(expected_pose, 1e-2))
+        << "Actual: " << transform::ToProto(pose).DebugString();
+  }
+}
+
 }  // namespace
 }  // namespace scan_matching
 }  // namespace mapping
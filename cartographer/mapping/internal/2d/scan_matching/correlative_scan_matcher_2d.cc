@@ -108,6 +108,23 @@ std::vector<sensor::PointCloud> GenerateRotatedScans(
   return rotated_scans;
 }
 
+std::vector<sensor::AlignedPointCloud> GenerateRotatedScans(
+    const sensor::AlignedPointCloud& point_cloud,
+    const SearchParameters& search_parameters) {
+  std::vector<sensor::AlignedPointCloud> rotated_scans(
+      search_parameters.num_scans, point_cloud);
+  double delta_theta = -search_parameters.num_angular_perturbations *
+                       search_parameters.angular_perturbation_step_size;
+  for (sensor::AlignedPointCloud& rotated_scan : rotated_scans) {
+    sensor::TransformAlignedPointCloud(
+        transform::Rigid3f::Rotation(
+            Eigen::AngleAxisf(delta_theta, Eigen::Vector3f::UnitZ())),
+        &rotated_scan);
+    delta_theta += search_parameters.angular_perturbation_step_size;
+  }
+  return rotated_scans;
+}
+
 std::vector<DiscreteScan2D> DiscretizeScans(
     const MapLimits& map_limits, const std::vector<sensor::PointCloud>& scans,
     const Eigen::Translation2f& initial_translation) {
@@ -126,6 +143,27 @@ std::vector<DiscreteScan2D> DiscretizeScans(
   return discrete_scans;
 }
 
+std::vector<DiscreteScan2D> DiscretizeScans(
+    const MapLimits& map_limits,
+    const std::vector<sensor::AlignedPointCloud>& scans,
+    const Eigen::Translation2f& initial_translation) {
+  std::vector<DiscreteScan2D> discrete_scans;
+  discrete_scans.reserve(scans.size());
+  for (const sensor::AlignedPointCloud& scan : scans) {
+    discrete_scans.emplace_back();
+    DiscreteScan2D& discrete_scan = discrete_scans.back();
+    discrete_scan.reserve(scan.size());
+    const float* const x = scan.x();
+    const float* const y = scan.y();
+    for (size_t i = 0; i < scan.size(); ++i) {
+      discrete_scan.push_back(
+          map_limits.GetCellIndex(Eigen::Vector2f(x[i], y[i]) +
+                                  initial_translation.translation()));
+    }
+  }
+  return discrete_scans;
+}
+
 }  // namespace scan_matching
 }  // namespace mapping
 }  // namespace cartographer
@@ -23,6 +23,7 @@
 #include "cartographer/common/lua_parameter_dictionary.h"
 #include "cartographer/mapping/2d/map_limits.h"
 #include "cartographer/mapping/2d/xy_index.h"
+#include "cartographer/sensor/aligned_point_cloud.h"
 #include "cartographer/sensor/point_cloud.h"
 
 namespace cartographer {
@@ -64,11 +65,20 @@ std::vector<sensor::PointCloud> GenerateRotatedScans(
     const sensor::PointCloud& point_cloud,
     const SearchParameters& search_parameters);
 
+// Same as above for an 'AlignedPointCloud', rotating the coordinate arrays.
+std::vector<sensor::AlignedPointCloud> GenerateRotatedScans(
+    const sensor::AlignedPointCloud& point_cloud,
+    const SearchParameters& search_parameters);
+
 // Translates and discretizes the rotated scans into a vector of integer
 // indices.
 std::vector<DiscreteScan2D> DiscretizeScans(
     const MapLimits& map_limits, const std::vector<sensor::PointCloud>& scans,
     const Eigen::Translation2f& initial_translation);
+std::vector<DiscreteScan2D> DiscretizeScans(
+    const MapLimits& map_limits,
+    const std::vector<sensor::AlignedPointCloud>& scans,
+    const Eigen::Translation2f& initial_translation);
 
 // A possible solution.
 struct Candidate2D {
@@ -15,6 +15,9 @@
  */
 
 #include "cartographer/mapping/internal/2d/scan_matching/correlative_scan_matcher_2d.h"
+
+#include <random>
+
 #include "cartographer/sensor/point_cloud.h"
 #include "gtest/gtest.h"
 
@@ -95,6 +98,35 @@ TEST(DiscretizeScans, DiscretizeScans) {
   EXPECT_TRUE((Eigen::Array2i(4, 3) == discrete_scans[0][6]).all());
 }
 
+TEST(DiscretizeScans, AlignedPointCloudGivesSameCells) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> distribution(-4.f, 4.f);
+  sensor::PointCloud point_cloud;
+  for (int i = 0; i < 500; ++i) {
+    point_cloud.push_back(
+        {Eigen::Vector3f{distribution(rng), distribution(rng), 0.f}});
+  }
+  const MapLimits map_limits(0.05, Eigen::Vector2d(5., 5.),
+                             CellLimits(200, 200));
+  const SearchParameters search_parameters(2, 10, 0.01, 0.05);
+  const Eigen::Translation2f initial_translation(0.31f, -0.47f);
+  const std::vector<DiscreteScan2D> expected = DiscretizeScans(
+      map_limits, GenerateRotatedScans(point_cloud, search_parameters),
+      initial_translation);
+  const std::vector<DiscreteScan2D> actual = DiscretizeScans(
+      map_limits,
+      GenerateRotatedScans(sensor::ToAlignedPointCloud(point_cloud),
+                           search_parameters),
+      initial_translation);
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_EQ(expected[i].size(), actual[i].size());
+    for (size_t j = 0; j < expected[i].size(); ++j) {
+      EXPECT_TRUE((expected[i][j] == actual[i][j]).all());
+    }
+  }
+}
+
 }  // namespace
 }  // namespace scan_matching
 }  // namespace mapping
@@ -24,7 +24,9 @@
 
 #include "Eigen/Geometry"
 #include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
 #include "cartographer/common/math.h"
+#include "cartographer/common/parallel_for.h"
 #include "cartographer/mapping/2d/grid_2d.h"
 #include "cartographer/sensor/point_cloud.h"
 #include "cartographer/transform/transform.h"
@@ -37,11 +39,12 @@ namespace {
 
 // A collection of values which can be added and later removed, and the maximum
 // of the current values in the collection can be retrieved.
-// All of it in (amortized) O(1).
+// All of it in (amortized) O(1). Reset() keeps the storage, so that one
+// instance serves all rows and columns of a precomputation grid.
 class SlidingWindowMaximum {
  public:
   void AddValue(const float value) {
-    while (!non_ascending_maxima_.empty() &&
+    while (non_ascending_maxima_.size() > front_ &&
            value > non_ascending_maxima_.back()) {
       non_ascending_maxima_.pop_back();
     }
@@ -51,28 +54,114 @@ class SlidingWindowMaximum {
   void RemoveValue(const float value) {
     // DCHECK for performance, since this is done for every value in the
     // precomputation grid.
-    DCHECK(!non_ascending_maxima_.empty());
-    DCHECK_LE(value, non_ascending_maxima_.front());
-    if (value == non_ascending_maxima_.front()) {
-      non_ascending_maxima_.pop_front();
+    DCHECK_LT(front_, non_ascending_maxima_.size());
+    DCHECK_LE(value, non_ascending_maxima_[front_]);
+    if (value == non_ascending_maxima_[front_]) {
+      ++front_;
     }
   }
 
   float GetMaximum() const {
     // DCHECK for performance, since this is done for every value in the
     // precomputation grid.
-    DCHECK_GT(non_ascending_maxima_.size(), 0);
-    return non_ascending_maxima_.front();
+    DCHECK_LT(front_, non_ascending_maxima_.size());
+    return non_ascending_maxima_[front_];
   }
 
-  void CheckIsEmpty() const { CHECK_EQ(non_ascending_maxima_.size(), 0); }
+  void CheckIsEmpty() const {
+    CHECK_EQ(non_ascending_maxima_.size(), front_);
+  }
+
+  void Reset() {
+    non_ascending_maxima_.clear();
+    front_ = 0;
+  }
 
  private:
-  // Maximum of the current sliding window at the front. Then the maximum of the
+  // Maximum of the current sliding window at 'front_'. Then the maximum of the
   // remaining window that came after this values first occurrence, and so on.
-  std::deque<float> non_ascending_maxima_;
+  // Values before 'front_' have left the window.
+  std::vector<float> non_ascending_maxima_;
+  size_t front_ = 0;
 };
 
+// Raises 'best_score' to 'score' unless it is higher already.
+void UpdateBestScore(const float score, std::atomic<float>* const best_score) {
+  float current = best_score->load(std::memory_order_relaxed);
+  while (score > current && !best_score->compare_exchange_weak(
+                                current, score, std::memory_order_relaxed)) {
+  }
+}
+
+// Number of lowest resolution candidates scored by one task at a time.
+constexpr int kNumCandidatesPerScoringChunk = 1024;
+
+// Number of rows or columns of a precomputation grid computed by one task at a
+// time.
+constexpr int kNumLinesPerPrecomputationBand = 64;
+
+// Calls 'work' with the bounds of bands of at most
+// 'kNumLinesPerPrecomputationBand' of the 'num_lines', using up to 'num_tasks'
+// tasks of 'thread_pool', or sequentially if 'thread_pool' is nullptr.
+void ForEachBand(const int num_lines, const int num_tasks,
+                 common::ThreadPoolInterface* const thread_pool,
+                 const std::function<void(int begin, int end)>& work) {
+  if (thread_pool == nullptr || num_tasks <= 1 ||
+      num_lines <= kNumLinesPerPrecomputationBand) {
+    work(0, num_lines);
+    return;
+  }
+  const int num_bands =
+      (num_lines + kNumLinesPerPrecomputationBand - 1) /
+      kNumLinesPerPrecomputationBand;
+  common::ParallelFor(num_bands, num_tasks, thread_pool,
+                      [&](const int band_index) {
+                        const int begin =
+                            band_index * kNumLinesPerPrecomputationBand;
+                        work(begin,
+                             std::min(begin + kNumLinesPerPrecomputationBand,
+                                      num_lines));
+                      });
+}
+
+// For each (x0, y) with 'y_begin' <= y < 'y_end', computes the maximum
+// probability achieved in the span defined by x0 <= x < x0 + width into
+// 'intermediate'.
+template <bool kDefaultBounds>
+void ComputeRowMaxima(const Grid2D& grid, const CellLimits& limits,
+                      const int width, const int stride, const int y_begin,
+                      const int y_end, std::vector<float>* const intermediate) {
+  const auto get_probability = [&grid](const int x, const int y) {
+    return 1.f - std::abs(grid.GetCorrespondenceCost<kDefaultBounds>(
+                     Eigen::Array2i(x, y)));
+  };
+  SlidingWindowMaximum current_values;
+  for (int y = y_begin; y != y_end; ++y) {
+    current_values.Reset();
+    current_values.AddValue(get_probability(0, y));
+    for (int x = -width + 1; x != 0; ++x) {
+      (*intermediate)[x + width - 1 + y * stride] =
+          current_values.GetMaximum();
+      if (x + width < limits.num_x_cells) {
+        current_values.AddValue(get_probability(x + width, y));
+      }
+    }
+    for (int x = 0; x < limits.num_x_cells - width; ++x) {
+      (*intermediate)[x + width - 1 + y * stride] =
+          current_values.GetMaximum();
+      current_values.RemoveValue(get_probability(x, y));
+      current_values.AddValue(get_probability(x + width, y));
+    }
+    for (int x = std::max(limits.num_x_cells - width, 0);
+         x != limits.num_x_cells; ++x) {
+      (*intermediate)[x + width - 1 + y * stride] =
+          current_values.GetMaximum();
+      current_values.RemoveValue(get_probability(x, y));
+    }
+    current_values.CheckIsEmpty();
+  }
+}
+
 }  // namespace
 
 proto::FastCorrelativeScanMatcherOptions2D
@@ -85,18 +174,66 @@ CreateFastCorrelativeScanMatcherOptions2D(
       parameter_dictionary->GetDouble("angular_search_window"));
   options.set_branch_and_bound_depth(
       parameter_dictionary->GetInt("branch_and_bound_depth"));
+  options.set_full_submap_match_num_tasks(
+      parameter_dictionary->GetInt("full_submap_match_num_tasks"));
+  options.set_precomputation_num_tasks(
+      parameter_dictionary->GetInt("precomputation_num_tasks"));
   return options;
 }
 
+PrecomputationCellsPool2D::PrecomputationCellsPool2D(
+    const size_t max_pooled_bytes)
+    : max_pooled_bytes_(max_pooled_bytes) {}
+
+std::vector<uint8> PrecomputationCellsPool2D::Acquire(const size_t num_cells) {
+  std::vector<uint8> cells;
+  {
+    absl::MutexLock locker(&mutex_);
+    // Cells much larger than needed are left for a larger grid.
+    auto it = cells_.lower_bound(num_cells);
+    if (it != cells_.end() && it->first <= 2 * num_cells) {
+      pooled_bytes_ -= it->first;
+      cells = std::move(it->second);
+      cells_.erase(it);
+    }
+  }
+  cells.resize(num_cells);
+  return cells;
+}
+
+void PrecomputationCellsPool2D::Release(std::vector<uint8> cells) {
+  const size_t capacity = cells.capacity();
+  if (capacity == 0) return;
+  absl::MutexLock locker(&mutex_);
+  if (pooled_bytes_ + capacity > max_pooled_bytes_) {
+    // 'cells' is freed after 'mutex_' is released.
+    return;
+  }
+  pooled_bytes_ += capacity;
+  cells_.emplace(capacity, std::move(cells));
+}
+
+size_t PrecomputationCellsPool2D::pooled_bytes() {
+  absl::MutexLock locker(&mutex_);
+  return pooled_bytes_;
+}
+
 PrecomputationGrid2D::PrecomputationGrid2D(
     const Grid2D& grid, const CellLimits& limits, const int width,
-    std::vector<float>* reusable_intermediate_grid)
+    std::vector<float>* reusable_intermediate_grid,
+    PrecomputationCellsPool2D* const cells_pool,
+    common::ThreadPoolInterface* const thread_pool, const int num_tasks)
     : offset_(-width + 1, -width + 1),
       wide_limits_(limits.num_x_cells + width - 1,
                    limits.num_y_cells + width - 1),
       min_score_(1.f - grid.GetMaxCorrespondenceCost()),
       max_score_(1.f - grid.GetMinCorrespondenceCost()),
-      cells_(wide_limits_.num_x_cells * wide_limits_.num_y_cells) {
+      cells_pool_(cells_pool),
+      cells_(cells_pool == nullptr
+                 ? std::vector<uint8>(wide_limits_.num_x_cells *
+                                      wide_limits_.num_y_cells)
+                 : cells_pool->Acquire(wide_limits_.num_x_cells *
+                                       wide_limits_.num_y_cells)) {
   CHECK_GE(width, 1);
   CHECK_GE(limits.num_x_cells, 1);
   CHECK_GE(limits.num_y_cells, 1);
@@ -105,37 +242,37 @@ PrecomputationGrid2D::PrecomputationGrid2D(
   // span defined by x0 <= x < x0 + width.
   std::vector<float>& intermediate = *reusable_intermediate_grid;
   intermediate.resize(wide_limits_.num_x_cells * limits.num_y_cells);
-  for (int y = 0; y != limits.num_y_cells; ++y) {
-    SlidingWindowMaximum current_values;
-    current_values.AddValue(
-        1.f - std::abs(grid.GetCorrespondenceCost(Eigen::Array2i(0, y))));
-    for (int x = -width + 1; x != 0; ++x) {
-      intermediate[x + width - 1 + y * stride] = current_values.GetMaximum();
-      if (x + width < limits.num_x_cells) {
-        current_values.AddValue(1.f - std::abs(grid.GetCorrespondenceCost(
-                                          Eigen::Array2i(x + width, y))));
-      }
-    }
-    for (int x = 0; x < limits.num_x_cells - width; ++x) {
-      intermediate[x + width - 1 + y * stride] = current_values.GetMaximum();
-      current_values.RemoveValue(
-          1.f - std::abs(grid.GetCorrespondenceCost(Eigen::Array2i(x, y))));
-      current_values.AddValue(1.f - std::abs(grid.GetCorrespondenceCost(
-                                        Eigen::Array2i(x + width, y))));
-    }
-    for (int x = std::max(limits.num_x_cells - width, 0);
-         x != limits.num_x_cells; ++x) {
-      intermediate[x + width - 1 + y * stride] = current_values.GetMaximum();
-      current_values.RemoveValue(
-          1.f - std::abs(grid.GetCorrespondenceCost(Eigen::Array2i(x, y))));
-    }
-    current_values.CheckIsEmpty();
-  }
-  // For each (x, y), we compute the maximum probability in the width x width
-  // region starting at each (x, y) and precompute the resulting bound on the
-  // score.
-  for (int x = 0; x != wide_limits_.num_x_cells; ++x) {
-    SlidingWindowMaximum current_values;
+  // Rows and then columns are independent of each other, so bands of them are
+  // computed in parallel.
+  const bool default_bounds = grid.HasDefaultCorrespondenceCostBounds();
+  ForEachBand(limits.num_y_cells, num_tasks, thread_pool,
+              [&](const int y_begin, const int y_end) {
+                if (default_bounds) {
+                  ComputeRowMaxima<true>(grid, limits, width, stride, y_begin,
+                                         y_end, &intermediate);
+                } else {
+                  ComputeRowMaxima<false>(grid, limits, width, stride, y_begin,
+                                          y_end, &intermediate);
+                }
+              });
+  ForEachBand(wide_limits_.num_x_cells, num_tasks, thread_pool,
+              [&](const int x_begin, const int x_end) {
+                ComputeColumnMaxima(limits, width, intermediate, x_begin,
+                                    x_end);
+              });
+}
+
+// For each (x, y), we compute the maximum probability in the width x width
+// region starting at each (x, y) and precompute the resulting bound on the
+// score.
+void PrecomputationGrid2D::ComputeColumnMaxima(
+    const CellLimits& limits, const int width,
+    const std::vector<float>& intermediate, const int x_begin,
+    const int x_end) {
+  const int stride = wide_limits_.num_x_cells;
+  SlidingWindowMaximum current_values;
+  for (int x = x_begin; x != x_end; ++x) {
+    current_values.Reset();
     current_values.AddValue(intermediate[x]);
     for (int y = -width + 1; y != 0; ++y) {
       cells_[x + (y + width - 1) * stride] =
@@ -160,6 +297,12 @@ PrecomputationGrid2D::PrecomputationGrid2D(
   }
 }
 
+PrecomputationGrid2D::~PrecomputationGrid2D() {
+  if (cells_pool_ != nullptr) {
+    cells_pool_->Release(std::move(cells_));
+  }
+}
+
 uint8 PrecomputationGrid2D::ComputeCellValue(const float probability) const {
   const int cell_value = common::RoundToInt(
       (probability - min_score_) * (255.f / (max_score_ - min_score_)));
@@ -170,31 +313,125 @@ uint8 PrecomputationGrid2D::ComputeCellValue(const float probability) const {
 
 PrecomputationGridStack2D::PrecomputationGridStack2D(
     const Grid2D& grid,
-    const proto::FastCorrelativeScanMatcherOptions2D& options) {
+    const proto::FastCorrelativeScanMatcherOptions2D& options,
+    PrecomputationCellsPool2D* const cells_pool)
+    : grid_(grid),
+      num_grids_(options.branch_and_bound_depth()),
+      cells_pool_(cells_pool),
+      computed_grids_(options.branch_and_bound_depth()),
+      grid_mutexes_(options.branch_and_bound_depth()),
+      precomputation_grids_(options.branch_and_bound_depth()) {
   CHECK_GE(options.branch_and_bound_depth(), 1);
-  const int max_width = 1 << (options.branch_and_bound_depth() - 1);
-  precomputation_grids_.reserve(options.branch_and_bound_depth());
-  std::vector<float> reusable_intermediate_grid;
-  const CellLimits limits = grid.limits().cell_limits();
-  reusable_intermediate_grid.reserve((limits.num_x_cells + max_width - 1) *
-                                     limits.num_y_cells);
-  for (int i = 0; i != options.branch_and_bound_depth(); ++i) {
-    const int width = 1 << i;
-    precomputation_grids_.emplace_back(grid, limits, width,
-                                       &reusable_intermediate_grid);
+}
+
+const PrecomputationGrid2D& PrecomputationGridStack2D::Get(const int index) {
+  return GetOrCompute(index, nullptr /* thread_pool */, 1 /* num_tasks */);
+}
+
+void PrecomputationGridStack2D::ComputeAll(
+    common::ThreadPoolInterface* const thread_pool, const int num_tasks) {
+  if (thread_pool == nullptr || num_tasks <= 1) {
+    for (int index = max_depth(); index >= 0; --index) {
+      Get(index);
+    }
+    return;
   }
+  // The lowest resolution grid is started first, a search needs it first.
+  common::ParallelFor(num_grids_, num_tasks, thread_pool,
+                      [this, thread_pool, num_tasks](const int i) {
+                        GetOrCompute(max_depth() - i, thread_pool, num_tasks);
+                      });
 }
 
+const PrecomputationGrid2D& PrecomputationGridStack2D::GetOrCompute(
+    const int index, common::ThreadPoolInterface* const thread_pool,
+    const int num_tasks) {
+  const PrecomputationGrid2D* precomputation_grid =
+      computed_grids_[index].load(std::memory_order_acquire);
+  if (precomputation_grid != nullptr) {
+    return *precomputation_grid;
+  }
+  absl::MutexLock grid_locker(&grid_mutexes_[index]);
+  if (precomputation_grids_[index] == nullptr) {
+    const CellLimits limits = grid_.limits().cell_limits();
+    std::vector<float> intermediate_grid;
+    {
+      absl::MutexLock locker(&mutex_);
+      if (!reusable_intermediate_grids_.empty()) {
+        intermediate_grid = std::move(reusable_intermediate_grids_.back());
+        reusable_intermediate_grids_.pop_back();
+      }
+    }
+    if (intermediate_grid.capacity() == 0) {
+      // Reserved for the lowest resolution grid, which needs the largest
+      // intermediate grid, so that it can be reused for all others.
+      const int max_width = 1 << (num_grids_ - 1);
+      intermediate_grid.reserve((limits.num_x_cells + max_width - 1) *
+                                limits.num_y_cells);
+    }
+    precomputation_grids_[index] = absl::make_unique<PrecomputationGrid2D>(
+        grid_, limits, 1 << index, &intermediate_grid, cells_pool_,
+        thread_pool, num_tasks);
+    {
+      absl::MutexLock locker(&mutex_);
+      if (++num_computed_grids_ == num_grids_) {
+        reusable_intermediate_grids_.clear();
+      } else {
+        reusable_intermediate_grids_.push_back(std::move(intermediate_grid));
+      }
+    }
+    computed_grids_[index].store(precomputation_grids_[index].get(),
+                                 std::memory_order_release);
+  }
+  return *precomputation_grids_[index];
+}
+
+size_t PrecomputationGridStack2D::MemoryUsageInBytes() {
+  size_t memory_usage_in_bytes = sizeof(*this);
+  for (const auto& computed_grid : computed_grids_) {
+    const PrecomputationGrid2D* const precomputation_grid =
+        computed_grid.load(std::memory_order_acquire);
+    if (precomputation_grid != nullptr) {
+      memory_usage_in_bytes += precomputation_grid->MemoryUsageInBytes();
+    }
+  }
+  absl::MutexLock locker(&mutex_);
+  for (const std::vector<float>& intermediate_grid :
+       reusable_intermediate_grids_) {
+    memory_usage_in_bytes += intermediate_grid.capacity() * sizeof(float);
+  }
+  return memory_usage_in_bytes;
+}
+
+FullSubmapMatchScans2D::FullSubmapMatchScans2D(
+    const sensor::PointCloud& point_cloud, const double resolution)
+    : search_parameters(
+          1e6 * resolution,  // Linear search window, 1e6 cells/direction.
+          M_PI,  // Angular search window, 180 degrees in both directions.
+          point_cloud, resolution),
+      rotated_scans(GenerateRotatedScans(
+          sensor::ToAlignedPointCloud(point_cloud), search_parameters)) {}
+
 FastCorrelativeScanMatcher2D::FastCorrelativeScanMatcher2D(
     const Grid2D& grid,
-    const proto::FastCorrelativeScanMatcherOptions2D& options)
+    const proto::FastCorrelativeScanMatcherOptions2D& options,
+    PrecomputationCellsPool2D* const cells_pool)
     : options_(options),
       limits_(grid.limits()),
-      precomputation_grid_stack_(
-          absl::make_unique<PrecomputationGridStack2D>(grid, options)) {}
+      precomputation_grid_stack_(absl::make_unique<PrecomputationGridStack2D>(
+          grid, options, cells_pool)) {}
 
 FastCorrelativeScanMatcher2D::~FastCorrelativeScanMatcher2D() {}
 
+void FastCorrelativeScanMatcher2D::PrecomputeGrids(
+    common::ThreadPoolInterface* const thread_pool, const int num_tasks) const {
+  precomputation_grid_stack_->ComputeAll(thread_pool, num_tasks);
+}
+
+size_t FastCorrelativeScanMatcher2D::MemoryUsageInBytes() const {
+  return sizeof(*this) + precomputation_grid_stack_->MemoryUsageInBytes();
+}
+
 bool FastCorrelativeScanMatcher2D::Match(
     const transform::Rigid2d& initial_pose_estimate,
     const sensor::PointCloud& point_cloud, const float min_score, float* score,
@@ -203,31 +440,49 @@ bool FastCorrelativeScanMatcher2D::Match(
                                            options_.angular_search_window(),
                                            point_cloud, limits_.resolution());
   return MatchWithSearchParameters(search_parameters, initial_pose_estimate,
-                                   point_cloud, min_score, score,
+                                   point_cloud, min_score,
+                                   nullptr /* thread_pool */, score,
                                    pose_estimate);
 }
 
 bool FastCorrelativeScanMatcher2D::MatchFullSubmap(
     const sensor::PointCloud& point_cloud, float min_score, float* score,
     transform::Rigid2d* pose_estimate) const {
-  // Compute a search window around the center of the submap that includes it
-  // fully.
-  const SearchParameters search_parameters(
-      1e6 * limits_.resolution(),  // Linear search window, 1e6 cells/direction.
-      M_PI,  // Angular search window, 180 degrees in both directions.
-      point_cloud, limits_.resolution());
+  return MatchFullSubmap(point_cloud, min_score, nullptr /* thread_pool */,
+                         score, pose_estimate);
+}
+
+bool FastCorrelativeScanMatcher2D::MatchFullSubmap(
+    const sensor::PointCloud& point_cloud, float min_score,
+    common::ThreadPoolInterface* const thread_pool, float* score,
+    transform::Rigid2d* pose_estimate) const {
+  return MatchFullSubmap(
+      FullSubmapMatchScans2D(point_cloud, limits_.resolution()), min_score,
+      thread_pool, score, pose_estimate);
+}
+
+bool FastCorrelativeScanMatcher2D::MatchFullSubmap(
+    const FullSubmapMatchScans2D& scans, const float min_score,
+    common::ThreadPoolInterface* const thread_pool, float* score,
+    transform::Rigid2d* pose_estimate) const {
+  CHECK_EQ(scans.search_parameters.resolution, limits_.resolution());
+  // Search a window around the center of the submap that includes it fully.
+  // The rotation of the center is the identity, so 'scans' only need to be
+  // rotated for the search.
   const transform::Rigid2d center = transform::Rigid2d::Translation(
       limits_.max() - 0.5 * limits_.resolution() *
                           Eigen::Vector2d(limits_.cell_limits().num_y_cells,
                                           limits_.cell_limits().num_x_cells));
-  return MatchWithSearchParameters(search_parameters, center, point_cloud,
-                                   min_score, score, pose_estimate);
+  return MatchRotatedScans(scans.search_parameters, center,
+                           scans.rotated_scans, min_score, thread_pool, score,
+                           pose_estimate);
 }
 
 bool FastCorrelativeScanMatcher2D::MatchWithSearchParameters(
     SearchParameters search_parameters,
     const transform::Rigid2d& initial_pose_estimate,
-    const sensor::PointCloud& point_cloud, float min_score, float* score,
+    const sensor::PointCloud& point_cloud, float min_score,
+    common::ThreadPoolInterface* const thread_pool, float* score,
     transform::Rigid2d* pose_estimate) const {
   CHECK(score != nullptr);
   CHECK(pose_estimate != nullptr);
@@ -237,19 +492,43 @@ bool FastCorrelativeScanMatcher2D::MatchWithSearchParameters(
       point_cloud,
       transform::Rigid3f::Rotation(Eigen::AngleAxisf(
           initial_rotation.cast<float>().angle(), Eigen::Vector3f::UnitZ())));
-  const std::vector<sensor::PointCloud> rotated_scans =
-      GenerateRotatedScans(rotated_point_cloud, search_parameters);
+  return MatchRotatedScans(
+      search_parameters, initial_pose_estimate,
+      GenerateRotatedScans(sensor::ToAlignedPointCloud(rotated_point_cloud),
+                           search_parameters),
+      min_score, thread_pool, score, pose_estimate);
+}
+
+bool FastCorrelativeScanMatcher2D::MatchRotatedScans(
+    SearchParameters search_parameters,
+    const transform::Rigid2d& initial_pose_estimate,
+    const std::vector<sensor::AlignedPointCloud>& rotated_scans,
+    const float min_score, common::ThreadPoolInterface* const thread_pool,
+    float* score, transform::Rigid2d* pose_estimate) const {
+  CHECK(score != nullptr);
+  CHECK(pose_estimate != nullptr);
+
+  const Eigen::Rotation2Dd initial_rotation = initial_pose_estimate.rotation();
   const std::vector<DiscreteScan2D> discrete_scans = DiscretizeScans(
       limits_, rotated_scans,
       Eigen::Translation2f(initial_pose_estimate.translation().x(),
                            initial_pose_estimate.translation().y()));
   search_parameters.ShrinkToFit(discrete_scans, limits_.cell_limits());
 
+  common::ThreadPoolInterface* const parallel_thread_pool =
+      options_.full_submap_match_num_tasks() > 1 ? thread_pool : nullptr;
   const std::vector<Candidate2D> lowest_resolution_candidates =
-      ComputeLowestResolutionCandidates(discrete_scans, search_parameters);
-  const Candidate2D best_candidate = BranchAndBound(
-      discrete_scans, search_parameters, lowest_resolution_candidates,
-      precomputation_grid_stack_->max_depth(), min_score);
+      ComputeLowestResolutionCandidates(discrete_scans, search_parameters,
+                                        parallel_thread_pool);
+  const Candidate2D best_candidate =
+      parallel_thread_pool != nullptr
+          ? ParallelBranchAndBound(discrete_scans, search_parameters,
+                                   lowest_resolution_candidates, min_score,
+                                   parallel_thread_pool)
+          : BranchAndBound(discrete_scans, search_parameters,
+                           lowest_resolution_candidates,
+                           precomputation_grid_stack_->max_depth(), min_score,
+                           nullptr /* best_score */);
   if (best_candidate.score > min_score) {
     *score = best_candidate.score;
     *pose_estimate = transform::Rigid2d(
@@ -264,12 +543,37 @@ bool FastCorrelativeScanMatcher2D::MatchWithSearchParameters(
 std::vector<Candidate2D>
 FastCorrelativeScanMatcher2D::ComputeLowestResolutionCandidates(
     const std::vector<DiscreteScan2D>& discrete_scans,
-    const SearchParameters& search_parameters) const {
+    const SearchParameters& search_parameters,
+    common::ThreadPoolInterface* const thread_pool) const {
   std::vector<Candidate2D> lowest_resolution_candidates =
       GenerateLowestResolutionCandidates(search_parameters);
-  ScoreCandidates(
-      precomputation_grid_stack_->Get(precomputation_grid_stack_->max_depth()),
-      discrete_scans, search_parameters, &lowest_resolution_candidates);
+  const PrecomputationGrid2D& precomputation_grid =
+      precomputation_grid_stack_->Get(precomputation_grid_stack_->max_depth());
+  if (thread_pool == nullptr) {
+    ScoreCandidates(precomputation_grid, discrete_scans, search_parameters,
+                    &lowest_resolution_candidates);
+    return lowest_resolution_candidates;
+  }
+  // Scoring all lowest resolution candidates of a full submap match costs
+  // about as much as the branch and bound, so it is shared as well. Scores do
+  // not depend on the order, and sorting afterwards gives the same result as
+  // the sequential search.
+  const int num_candidates = lowest_resolution_candidates.size();
+  const int num_chunks =
+      (num_candidates + kNumCandidatesPerScoringChunk - 1) /
+      kNumCandidatesPerScoringChunk;
+  common::ParallelFor(
+      num_chunks, options_.full_submap_match_num_tasks(), thread_pool,
+      [&](const int chunk_index) {
+        const int begin = chunk_index * kNumCandidatesPerScoringChunk;
+        const int end =
+            std::min(begin + kNumCandidatesPerScoringChunk, num_candidates);
+        ScoreCandidatesUnsorted(precomputation_grid, discrete_scans,
+                                lowest_resolution_candidates.data() + begin,
+                                lowest_resolution_candidates.data() + end);
+      });
+  std::sort(lowest_resolution_candidates.begin(),
+            lowest_resolution_candidates.end(), std::greater<Candidate2D>());
   return lowest_resolution_candidates;
 }
 
@@ -316,28 +620,41 @@ void FastCorrelativeScanMatcher2D::ScoreCandidates(
     const std::vector<DiscreteScan2D>& discrete_scans,
     const SearchParameters& search_parameters,
     std::vector<Candidate2D>* const candidates) const {
-  for (Candidate2D& candidate : *candidates) {
+  ScoreCandidatesUnsorted(precomputation_grid, discrete_scans,
+                          candidates->data(),
+                          candidates->data() + candidates->size());
+  std::sort(candidates->begin(), candidates->end(),
+            std::greater<Candidate2D>());
+}
+
+void FastCorrelativeScanMatcher2D::ScoreCandidatesUnsorted(
+    const PrecomputationGrid2D& precomputation_grid,
+    const std::vector<DiscreteScan2D>& discrete_scans,
+    Candidate2D* const begin, Candidate2D* const end) const {
+  for (Candidate2D* candidate = begin; candidate != end; ++candidate) {
     int sum = 0;
     for (const Eigen::Array2i& xy_index :
-         discrete_scans[candidate.scan_index]) {
+         discrete_scans[candidate->scan_index]) {
       const Eigen::Array2i proposed_xy_index(
-          xy_index.x() + candidate.x_index_offset,
-          xy_index.y() + candidate.y_index_offset);
+          xy_index.x() + candidate->x_index_offset,
+          xy_index.y() + candidate->y_index_offset);
       sum += precomputation_grid.GetValue(proposed_xy_index);
     }
-    candidate.score = precomputation_grid.ToScore(
-        sum / static_cast<float>(discrete_scans[candidate.scan_index].size()));
+    candidate->score = precomputation_grid.ToScore(
+        sum /
+        static_cast<float>(discrete_scans[candidate->scan_index].size()));
   }
-  std::sort(candidates->begin(), candidates->end(),
-            std::greater<Candidate2D>());
 }
 
 Candidate2D FastCorrelativeScanMatcher2D::BranchAndBound(
     const std::vector<DiscreteScan2D>& discrete_scans,
     const SearchParameters& search_parameters,
     const std::vector<Candidate2D>& candidates, const int candidate_depth,
-    float min_score) const {
+    float min_score, std::atomic<float>* const best_score) const {
   if (candidate_depth == 0) {
+    if (best_score != nullptr) {
+      UpdateBestScore(candidates.begin()->score, best_score);
+    }
     // Return the best candidate.
     return *candidates.begin();
   }
@@ -348,6 +665,12 @@ Candidate2D FastCorrelativeScanMatcher2D::BranchAndBound(
     if (candidate.score <= min_score) {
       break;
     }
+    // Equality is not pruned here, so that ties are resolved the same way as
+    // in the sequential search, whichever task finds them first.
+    if (best_score != nullptr &&
+        candidate.score < best_score->load(std::memory_order_relaxed)) {
+      break;
+    }
     std::vector<Candidate2D> higher_resolution_candidates;
     const int half_width = 1 << (candidate_depth - 1);
     for (int x_offset : {0, half_width}) {
@@ -372,11 +695,48 @@ Candidate2D FastCorrelativeScanMatcher2D::BranchAndBound(
         best_high_resolution_candidate,
         BranchAndBound(discrete_scans, search_parameters,
                        higher_resolution_candidates, candidate_depth - 1,
-                       best_high_resolution_candidate.score));
+                       best_high_resolution_candidate.score, best_score));
   }
   return best_high_resolution_candidate;
 }
 
+Candidate2D FastCorrelativeScanMatcher2D::ParallelBranchAndBound(
+    const std::vector<DiscreteScan2D>& discrete_scans,
+    const SearchParameters& search_parameters,
+    const std::vector<Candidate2D>& lowest_resolution_candidates,
+    const float min_score,
+    common::ThreadPoolInterface* const thread_pool) const {
+  // The sequential search keeps the first of equally good candidates in
+  // depth-first order. Every lowest resolution candidate is searched on its
+  // own, and the results are merged in the same order.
+  Candidate2D no_candidate(0, 0, 0, search_parameters);
+  no_candidate.score = min_score;
+  // Indexed like the candidates, each written by the task which took it.
+  std::vector<Candidate2D> results(lowest_resolution_candidates.size(),
+                                   no_candidate);
+  std::atomic<float> best_score(min_score);
+  common::ParallelFor(
+      lowest_resolution_candidates.size(),
+      options_.full_submap_match_num_tasks(), thread_pool,
+      [&](const int index) {
+        const Candidate2D& candidate = lowest_resolution_candidates[index];
+        // Candidates are sorted, so all remaining ones would be pruned as well.
+        if (candidate.score <= min_score ||
+            candidate.score < best_score.load(std::memory_order_relaxed)) {
+          return;
+        }
+        results[index] = BranchAndBound(
+            discrete_scans, search_parameters, {candidate},
+            precomputation_grid_stack_->max_depth(), min_score, &best_score);
+      });
+
+  Candidate2D best_candidate = no_candidate;
+  for (const Candidate2D& candidate : results) {
+    best_candidate = std::max(best_candidate, candidate);
+  }
+  return best_candidate;
+}
+
 }  // namespace scan_matching
 }  // namespace mapping
 }  // namespace cartographer
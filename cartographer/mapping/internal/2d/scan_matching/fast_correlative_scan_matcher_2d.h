@@ -25,14 +25,19 @@
 #ifndef CARTOGRAPHER_MAPPING_INTERNAL_2D_SCAN_MATCHING_FAST_CORRELATIVE_SCAN_MATCHER_2D_H_
 #define CARTOGRAPHER_MAPPING_INTERNAL_2D_SCAN_MATCHING_FAST_CORRELATIVE_SCAN_MATCHER_2D_H_
 
+#include <atomic>
+#include <map>
 #include <memory>
 #include <vector>
 
 #include "Eigen/Core"
+#include "absl/synchronization/mutex.h"
 #include "cartographer/common/port.h"
+#include "cartographer/common/thread_pool.h"
 #include "cartographer/mapping/2d/grid_2d.h"
 #include "cartographer/mapping/internal/2d/scan_matching/correlative_scan_matcher_2d.h"
 #include "cartographer/mapping/proto/scan_matching/fast_correlative_scan_matcher_options_2d.pb.h"
+#include "cartographer/sensor/aligned_point_cloud.h"
 #include "cartographer/sensor/point_cloud.h"
 
 namespace cartographer {
@@ -43,13 +48,54 @@ proto::FastCorrelativeScanMatcherOptions2D
 CreateFastCorrelativeScanMatcherOptions2D(
     common::LuaParameterDictionary* parameter_dictionary);
 
+// Recycles the cells of precomputation grids, so that the scan matchers of
+// new submaps reuse the memory of deleted ones instead of allocating it again.
+// This keeps the heap from fragmenting when submaps are continuously created
+// and trimmed, e.g. in pure localization. Thread-safe.
+class PrecomputationCellsPool2D {
+ public:
+  // At most 'max_pooled_bytes' of released cells are kept.
+  explicit PrecomputationCellsPool2D(size_t max_pooled_bytes);
+
+  PrecomputationCellsPool2D(const PrecomputationCellsPool2D&) = delete;
+  PrecomputationCellsPool2D& operator=(const PrecomputationCellsPool2D&) =
+      delete;
+
+  // Returns 'num_cells' cells with unspecified values, reusing released cells
+  // of a similar capacity if possible.
+  std::vector<uint8> Acquire(size_t num_cells) LOCKS_EXCLUDED(mutex_);
+
+  // Hands 'cells' back for reuse.
+  void Release(std::vector<uint8> cells) LOCKS_EXCLUDED(mutex_);
+
+  size_t pooled_bytes() LOCKS_EXCLUDED(mutex_);
+
+ private:
+  const size_t max_pooled_bytes_;
+  absl::Mutex mutex_;
+  // Released cells by their capacity.
+  std::multimap<size_t, std::vector<uint8>> cells_ GUARDED_BY(mutex_);
+  size_t pooled_bytes_ GUARDED_BY(mutex_) = 0;
+};
+
 // A precomputed grid that contains in each cell (x0, y0) the maximum
 // probability in the width x width area defined by x0 <= x < x0 + width and
 // y0 <= y < y0.
 class PrecomputationGrid2D {
  public:
+  // If 'cells_pool' is not nullptr, the cells are acquired from it and
+  // released to it on destruction, so it must outlive the grid. If
+  // 'thread_pool' is not nullptr, bands of rows and columns are computed by up
+  // to 'num_tasks' tasks, all but one scheduled on 'thread_pool'.
   PrecomputationGrid2D(const Grid2D& grid, const CellLimits& limits, int width,
-                       std::vector<float>* reusable_intermediate_grid);
+                       std::vector<float>* reusable_intermediate_grid,
+                       PrecomputationCellsPool2D* cells_pool = nullptr,
+                       common::ThreadPoolInterface* thread_pool = nullptr,
+                       int num_tasks = 1);
+  ~PrecomputationGrid2D();
+
+  PrecomputationGrid2D(const PrecomputationGrid2D&) = delete;
+  PrecomputationGrid2D& operator=(const PrecomputationGrid2D&) = delete;
 
   // Returns a value between 0 and 255 to represent probabilities between
   // min_score and max_score.
@@ -75,8 +121,17 @@ class PrecomputationGrid2D {
     return min_score_ + value * ((max_score_ - min_score_) / 255.f);
   }
 
+  size_t MemoryUsageInBytes() const {
+    return sizeof(*this) + cells_.capacity() * sizeof(uint8);
+  }
+
  private:
   uint8 ComputeCellValue(float probability) const;
+  // Computes the cells of the columns 'x_begin' <= x < 'x_end' from the row
+  // maxima in 'intermediate'.
+  void ComputeColumnMaxima(const CellLimits& limits, int width,
+                           const std::vector<float>& intermediate,
+                           int x_begin, int x_end);
 
   // Offset of the precomputation grid in relation to the 'grid'
   // including the additional 'width' - 1 cells.
@@ -88,32 +143,86 @@ class PrecomputationGrid2D {
   const float min_score_;
   const float max_score_;
 
+  PrecomputationCellsPool2D* const cells_pool_;
+
   // Probabilites mapped to 0 to 255.
   std::vector<uint8> cells_;
 };
 
+// The precomputation grids of all depths of the branch and bound. Each one is
+// computed when it is first used, so depths the search never reaches cost
+// nothing, unless 'ComputeAll' computes them up front. 'grid' and
+// 'cells_pool', if not nullptr, must outlive the stack.
 class PrecomputationGridStack2D {
  public:
   PrecomputationGridStack2D(
       const Grid2D& grid,
-      const proto::FastCorrelativeScanMatcherOptions2D& options);
+      const proto::FastCorrelativeScanMatcherOptions2D& options,
+      PrecomputationCellsPool2D* cells_pool = nullptr);
 
-  const PrecomputationGrid2D& Get(int index) {
-    return precomputation_grids_[index];
-  }
+  // Thread-safe. Concurrent first uses of a depth wait for the same
+  // computation, different depths are computed concurrently.
+  const PrecomputationGrid2D& Get(int index) LOCKS_EXCLUDED(mutex_);
+
+  // Computes all grids which are not computed yet. Up to 'num_tasks' tasks,
+  // all but one scheduled on 'thread_pool', share the depths and the bands of
+  // rows and columns of each depth. The calling thread does its share and only
+  // waits for work already being done, so it may be a task of 'thread_pool'.
+  void ComputeAll(common::ThreadPoolInterface* thread_pool, int num_tasks)
+      LOCKS_EXCLUDED(mutex_);
+
+  int max_depth() const { return num_grids_ - 1; }
 
-  int max_depth() const { return precomputation_grids_.size() - 1; }
+  // Returns the memory used by the grids computed so far.
+  size_t MemoryUsageInBytes() LOCKS_EXCLUDED(mutex_);
 
  private:
-  std::vector<PrecomputationGrid2D> precomputation_grids_;
+  const PrecomputationGrid2D& GetOrCompute(
+      int index, common::ThreadPoolInterface* thread_pool, int num_tasks)
+      LOCKS_EXCLUDED(mutex_);
+
+  const Grid2D& grid_;
+  const int num_grids_;
+  PrecomputationCellsPool2D* const cells_pool_;
+  // Published once computed, so that lookups of computed grids are lock-free.
+  std::vector<std::atomic<const PrecomputationGrid2D*>> computed_grids_;
+  // Each grid in 'precomputation_grids_' is guarded by its mutex.
+  std::vector<absl::Mutex> grid_mutexes_;
+  std::vector<std::unique_ptr<PrecomputationGrid2D>> precomputation_grids_;
+
+  absl::Mutex mutex_;
+  int num_computed_grids_ GUARDED_BY(mutex_) = 0;
+  // Intermediate grids of finished computations, one for each depth computed
+  // concurrently at most. Released after the last grid is computed.
+  std::vector<std::vector<float>> reusable_intermediate_grids_
+      GUARDED_BY(mutex_);
+};
+
+// The rotated scans of a full submap match of a point cloud. They only depend
+// on the point cloud and the grid resolution, so the full submap matches of a
+// point cloud against all grids of that resolution can share them instead of
+// rotating the point cloud again for each grid.
+struct FullSubmapMatchScans2D {
+  FullSubmapMatchScans2D(const sensor::PointCloud& point_cloud,
+                         double resolution);
+
+  SearchParameters search_parameters;
+  // Kept as arrays of coordinates, which are cheaper to discretize for each of
+  // the grids.
+  std::vector<sensor::AlignedPointCloud> rotated_scans;
 };
 
 // An implementation of "Real-Time Correlative Scan Matching" by Olson.
+//
+// 'grid' must outlive the scan matcher. If 'cells_pool' is not nullptr, the
+// precomputation grids are recycled through it, and it must outlive the scan
+// matcher as well.
 class FastCorrelativeScanMatcher2D {
  public:
   FastCorrelativeScanMatcher2D(
       const Grid2D& grid,
-      const proto::FastCorrelativeScanMatcherOptions2D& options);
+      const proto::FastCorrelativeScanMatcherOptions2D& options,
+      PrecomputationCellsPool2D* cells_pool = nullptr);
   ~FastCorrelativeScanMatcher2D();
 
   FastCorrelativeScanMatcher2D(const FastCorrelativeScanMatcher2D&) = delete;
@@ -135,28 +244,79 @@ class FastCorrelativeScanMatcher2D {
   bool MatchFullSubmap(const sensor::PointCloud& point_cloud, float min_score,
                        float* score, transform::Rigid2d* pose_estimate) const;
 
+  // Same as above, but the lowest resolution candidates are scored and
+  // searched by up to 'full_submap_match_num_tasks' tasks, all but one
+  // scheduled on 'thread_pool'. The calling thread does its share and only
+  // waits for candidates already being worked on, so it may be a task of
+  // 'thread_pool' itself. The result is the same as the one of the sequential
+  // search.
+  bool MatchFullSubmap(const sensor::PointCloud& point_cloud, float min_score,
+                       common::ThreadPoolInterface* thread_pool, float* score,
+                       transform::Rigid2d* pose_estimate) const;
+
+  // Same as above, using 'scans' computed for the resolution of the 'grid'.
+  bool MatchFullSubmap(const FullSubmapMatchScans2D& scans, float min_score,
+                       common::ThreadPoolInterface* thread_pool, float* score,
+                       transform::Rigid2d* pose_estimate) const;
+
+  // Computes all precomputation grids now instead of on first use, see
+  // PrecomputationGridStack2D::ComputeAll.
+  void PrecomputeGrids(common::ThreadPoolInterface* thread_pool,
+                       int num_tasks) const;
+
+  // Returns the memory used by the precomputation grids, which grows as
+  // matching needs more of them.
+  size_t MemoryUsageInBytes() const;
+
  private:
   // The actual implementation of the scan matcher, called by Match() and
   // MatchFullSubmap() with appropriate 'initial_pose_estimate' and
   // 'search_parameters'.
+  // 'thread_pool' may be nullptr for a sequential search.
   bool MatchWithSearchParameters(
       SearchParameters search_parameters,
       const transform::Rigid2d& initial_pose_estimate,
-      const sensor::PointCloud& point_cloud, float min_score, float* score,
+      const sensor::PointCloud& point_cloud, float min_score,
+      common::ThreadPoolInterface* thread_pool, float* score,
+      transform::Rigid2d* pose_estimate) const;
+  // Same as above, with the point cloud already rotated by the rotation of
+  // 'initial_pose_estimate' and then for each scan of 'search_parameters'.
+  bool MatchRotatedScans(
+      SearchParameters search_parameters,
+      const transform::Rigid2d& initial_pose_estimate,
+      const std::vector<sensor::AlignedPointCloud>& rotated_scans,
+      float min_score, common::ThreadPoolInterface* thread_pool, float* score,
       transform::Rigid2d* pose_estimate) const;
+  // 'thread_pool' may be nullptr to score the candidates sequentially.
   std::vector<Candidate2D> ComputeLowestResolutionCandidates(
       const std::vector<DiscreteScan2D>& discrete_scans,
-      const SearchParameters& search_parameters) const;
+      const SearchParameters& search_parameters,
+      common::ThreadPoolInterface* thread_pool) const;
   std::vector<Candidate2D> GenerateLowestResolutionCandidates(
       const SearchParameters& search_parameters) const;
   void ScoreCandidates(const PrecomputationGrid2D& precomputation_grid,
                        const std::vector<DiscreteScan2D>& discrete_scans,
                        const SearchParameters& search_parameters,
                        std::vector<Candidate2D>* const candidates) const;
+  // Scores the candidates in ['begin', 'end') without sorting them.
+  void ScoreCandidatesUnsorted(
+      const PrecomputationGrid2D& precomputation_grid,
+      const std::vector<DiscreteScan2D>& discrete_scans, Candidate2D* begin,
+      Candidate2D* end) const;
+  // If not nullptr, 'best_score' is the best score found by any task so far.
+  // Candidates with a lower bound are pruned, and it is raised on scores
+  // found here.
   Candidate2D BranchAndBound(const std::vector<DiscreteScan2D>& discrete_scans,
                              const SearchParameters& search_parameters,
                              const std::vector<Candidate2D>& candidates,
-                             int candidate_depth, float min_score) const;
+                             int candidate_depth, float min_score,
+                             std::atomic<float>* best_score) const;
+  // Searches the sorted 'lowest_resolution_candidates' on 'thread_pool'.
+  Candidate2D ParallelBranchAndBound(
+      const std::vector<DiscreteScan2D>& discrete_scans,
+      const SearchParameters& search_parameters,
+      const std::vector<Candidate2D>& lowest_resolution_candidates,
+      float min_score, common::ThreadPoolInterface* thread_pool) const;
 
   const proto::FastCorrelativeScanMatcherOptions2D options_;
   MapLimits limits_;
@@ -23,6 +23,7 @@
 #include <string>
 
 #include "cartographer/common/lua_parameter_dictionary_test_helpers.h"
+#include "cartographer/common/thread_pool.h"
 #include "cartographer/mapping/2d/probability_grid.h"
 #include "cartographer/mapping/2d/probability_grid_range_data_inserter_2d.h"
 #include "cartographer/transform/rigid_transform_test_helpers.h"
@@ -116,6 +117,130 @@ TEST(PrecomputationGridTest, TinyProbabilityGrid) {
   }
 }
 
+TEST(PrecomputationGridStackTest, ComputesGridsOnFirstUse) {
+  std::mt19937 prng(42);
+  std::uniform_real_distribution<float> distribution(0.1f, 0.9f);
+  ValueConversionTables conversion_tables;
+  ProbabilityGrid probability_grid(
+      MapLimits(0.05, Eigen::Vector2d(5., 5.), CellLimits(30, 20)),
+      &conversion_tables);
+  for (const Eigen::Array2i& xy_index :
+       XYIndexRangeIterator(Eigen::Array2i(3, 2), Eigen::Array2i(25, 17))) {
+    probability_grid.SetProbability(xy_index, distribution(prng));
+  }
+  proto::FastCorrelativeScanMatcherOptions2D options;
+  options.set_branch_and_bound_depth(4);
+  PrecomputationGridStack2D precomputation_grid_stack(probability_grid,
+                                                      options);
+  EXPECT_EQ(3, precomputation_grid_stack.max_depth());
+
+  // Depths in the order a branch and bound would first use them, and again.
+  std::vector<float> reusable_intermediate_grid;
+  for (const int depth : {3, 2, 0, 1, 3, 0}) {
+    const int width = 1 << depth;
+    const PrecomputationGrid2D expected_grid(
+        probability_grid, probability_grid.limits().cell_limits(), width,
+        &reusable_intermediate_grid);
+    const PrecomputationGrid2D& precomputation_grid =
+        precomputation_grid_stack.Get(depth);
+    EXPECT_EQ(&precomputation_grid, &precomputation_grid_stack.Get(depth));
+    for (const Eigen::Array2i& xy_index : XYIndexRangeIterator(
+             Eigen::Array2i(-width, -width), Eigen::Array2i(30, 20))) {
+      EXPECT_EQ(expected_grid.GetValue(xy_index),
+                precomputation_grid.GetValue(xy_index));
+    }
+  }
+}
+
+TEST(PrecomputationGridStackTest, ComputesAllGridsInParallel) {
+  std::mt19937 prng(42);
+  std::uniform_real_distribution<float> distribution(0.1f, 0.9f);
+  ValueConversionTables conversion_tables;
+  // Large enough for several bands of rows and columns.
+  ProbabilityGrid probability_grid(
+      MapLimits(0.05, Eigen::Vector2d(5., 5.), CellLimits(200, 150)),
+      &conversion_tables);
+  for (const Eigen::Array2i& xy_index :
+       XYIndexRangeIterator(Eigen::Array2i(3, 2), Eigen::Array2i(190, 140))) {
+    probability_grid.SetProbability(xy_index, distribution(prng));
+  }
+  proto::FastCorrelativeScanMatcherOptions2D options;
+  options.set_branch_and_bound_depth(4);
+  PrecomputationGridStack2D precomputation_grid_stack(probability_grid,
+                                                      options);
+  common::ThreadPool thread_pool(3);
+  precomputation_grid_stack.ComputeAll(&thread_pool, 4);
+
+  std::vector<float> reusable_intermediate_grid;
+  for (int depth = 0; depth <= precomputation_grid_stack.max_depth();
+       ++depth) {
+    const int width = 1 << depth;
+    const PrecomputationGrid2D expected_grid(
+        probability_grid, probability_grid.limits().cell_limits(), width,
+        &reusable_intermediate_grid);
+    const PrecomputationGrid2D& precomputation_grid =
+        precomputation_grid_stack.Get(depth);
+    for (const Eigen::Array2i& xy_index : XYIndexRangeIterator(
+             Eigen::Array2i(-width, -width), Eigen::Array2i(200, 150))) {
+      EXPECT_EQ(expected_grid.GetValue(xy_index),
+                precomputation_grid.GetValue(xy_index));
+    }
+  }
+}
+
+TEST(PrecomputationGridStackTest, RecyclesCellsThroughPool) {
+  ValueConversionTables conversion_tables;
+  ProbabilityGrid probability_grid(
+      MapLimits(0.05, Eigen::Vector2d(5., 5.), CellLimits(30, 20)),
+      &conversion_tables);
+  probability_grid.SetProbability(Eigen::Array2i(10, 10), 0.8f);
+  proto::FastCorrelativeScanMatcherOptions2D options;
+  options.set_branch_and_bound_depth(3);
+  PrecomputationCellsPool2D cells_pool(1 << 20);
+
+  std::vector<float> reusable_intermediate_grid;
+  const PrecomputationGrid2D expected_grid(
+      probability_grid, probability_grid.limits().cell_limits(), 4,
+      &reusable_intermediate_grid);
+  size_t pooled_bytes = 0;
+  for (int i = 0; i != 2; ++i) {
+    {
+      PrecomputationGridStack2D precomputation_grid_stack(
+          probability_grid, options, &cells_pool);
+      for (int depth = 0; depth <= precomputation_grid_stack.max_depth();
+           ++depth) {
+        precomputation_grid_stack.Get(depth);
+      }
+      // The second stack reuses all cells released by the first one.
+      EXPECT_EQ(cells_pool.pooled_bytes(), 0);
+      for (const Eigen::Array2i& xy_index : XYIndexRangeIterator(
+               Eigen::Array2i(-4, -4), Eigen::Array2i(30, 20))) {
+        EXPECT_EQ(expected_grid.GetValue(xy_index),
+                  precomputation_grid_stack.Get(2).GetValue(xy_index));
+      }
+    }
+    EXPECT_GT(cells_pool.pooled_bytes(), 0);
+    if (i == 0) {
+      pooled_bytes = cells_pool.pooled_bytes();
+    } else {
+      EXPECT_EQ(pooled_bytes, cells_pool.pooled_bytes());
+    }
+  }
+}
+
+TEST(PrecomputationCellsPoolTest, KeepsAtMostMaxPooledBytes) {
+  PrecomputationCellsPool2D cells_pool(150);
+  cells_pool.Release(std::vector<uint8>(100));
+  cells_pool.Release(std::vector<uint8>(100));
+  EXPECT_EQ(cells_pool.pooled_bytes(), 100);
+  // Too large to be served from 100 cells, and too small to use them up.
+  EXPECT_EQ(cells_pool.Acquire(120).size(), 120);
+  EXPECT_EQ(cells_pool.Acquire(40).size(), 40);
+  EXPECT_EQ(cells_pool.pooled_bytes(), 100);
+  EXPECT_EQ(cells_pool.Acquire(80).size(), 80);
+  EXPECT_EQ(cells_pool.pooled_bytes(), 0);
+}
+
 proto::FastCorrelativeScanMatcherOptions2D
 CreateFastCorrelativeScanMatcherTestOptions2D(
     const int branch_and_bound_depth) {
@@ -124,6 +249,8 @@ CreateFastCorrelativeScanMatcherTestOptions2D(
       return {
          linear_search_window = 3.,
          angular_search_window = 1.,
+         full_submap_match_num_tasks = 1,
+         precomputation_num_tasks = 1,
          branch_and_bound_depth = )text" +
                              std::to_string(branch_and_bound_depth) + "}");
   return CreateFastCorrelativeScanMatcherOptions2D(parameter_dictionary.get());
@@ -245,6 +372,121 @@ TEST(FastCorrelativeScanMatcherTest, FullSubmapMatching) {
   }
 }
 
+TEST(FastCorrelativeScanMatcherTest,
+     ParallelFullSubmapMatchingIsDeterministic) {
+  std::mt19937 prng(42);
+  std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+  ProbabilityGridRangeDataInserter2D range_data_inserter(
+      CreateRangeDataInserterTestOptions2D());
+  constexpr float kMinScore = 0.1f;
+  const auto sequential_options =
+      CreateFastCorrelativeScanMatcherTestOptions2D(6);
+  auto parallel_options = sequential_options;
+  parallel_options.set_full_submap_match_num_tasks(4);
+  common::ThreadPool thread_pool(3);
+
+  // A symmetric point cloud, so that there are equally good matches.
+  sensor::PointCloud point_cloud;
+  point_cloud.push_back({Eigen::Vector3f{-1.f, -1.f, 0.f}});
+  point_cloud.push_back({Eigen::Vector3f{-1.f, 1.f, 0.f}});
+  point_cloud.push_back({Eigen::Vector3f{1.f, -1.f, 0.f}});
+  point_cloud.push_back({Eigen::Vector3f{1.f, 1.f, 0.f}});
+  point_cloud.push_back({Eigen::Vector3f{0.f, 2.f, 0.f}});
+
+  for (int i = 0; i != 5; ++i) {
+    const transform::Rigid2f expected_pose(
+        {2. * distribution(prng), 2. * distribution(prng)},
+        0.5 * distribution(prng));
+    ValueConversionTables conversion_tables;
+    ProbabilityGrid probability_grid(
+        MapLimits(0.05, Eigen::Vector2d(5., 5.), CellLimits(200, 200)),
+        &conversion_tables);
+    range_data_inserter.Insert(
+        sensor::RangeData{
+            Eigen::Vector3f(expected_pose.translation().x(),
+                            expected_pose.translation().y(), 0.f),
+            sensor::TransformPointCloud(
+                point_cloud, transform::Embed3D(expected_pose.cast<float>())),
+            {}},
+        &probability_grid);
+    probability_grid.FinishUpdate();
+
+    FastCorrelativeScanMatcher2D sequential_matcher(probability_grid,
+                                                    sequential_options);
+    FastCorrelativeScanMatcher2D parallel_matcher(probability_grid,
+                                                  parallel_options);
+    transform::Rigid2d sequential_pose_estimate;
+    float sequential_score;
+    ASSERT_TRUE(sequential_matcher.MatchFullSubmap(
+        point_cloud, kMinScore, &sequential_score, &sequential_pose_estimate));
+    for (int j = 0; j != 3; ++j) {
+      transform::Rigid2d parallel_pose_estimate;
+      float parallel_score;
+      ASSERT_TRUE(parallel_matcher.MatchFullSubmap(
+          point_cloud, kMinScore, &thread_pool, &parallel_score,
+          &parallel_pose_estimate));
+      EXPECT_EQ(sequential_score, parallel_score);
+      EXPECT_EQ(sequential_pose_estimate.translation(),
+                parallel_pose_estimate.translation());
+      EXPECT_EQ(sequential_pose_estimate.rotation().angle(),
+                parallel_pose_estimate.rotation().angle());
+    }
+  }
+}
+
+TEST(FastCorrelativeScanMatcherTest, SharedFullSubmapMatchScans) {
+  ProbabilityGridRangeDataInserter2D range_data_inserter(
+      CreateRangeDataInserterTestOptions2D());
+  constexpr float kMinScore = 0.1f;
+  const auto options = CreateFastCorrelativeScanMatcherTestOptions2D(6);
+
+  sensor::PointCloud point_cloud;
+  point_cloud.push_back({Eigen::Vector3f{-2.5f, 0.5f, 0.f}});
+  point_cloud.push_back({Eigen::Vector3f{-2.25f, 0.5f, 0.f}});
+  point_cloud.push_back({Eigen::Vector3f{0.f, 0.5f, 0.f}});
+  point_cloud.push_back({Eigen::Vector3f{0.25f, 1.6f, 0.f}});
+  point_cloud.push_back({Eigen::Vector3f{2.5f, 0.5f, 0.f}});
+  point_cloud.push_back({Eigen::Vector3f{2.f, 1.8f, 0.f}});
+  const FullSubmapMatchScans2D scans(point_cloud, 0.05);
+
+  // Grids of the same resolution with different limits share the scans.
+  const std::vector<MapLimits> map_limits = {
+      MapLimits(0.05, Eigen::Vector2d(5., 5.), CellLimits(200, 200)),
+      MapLimits(0.05, Eigen::Vector2d(7.3, 4.1), CellLimits(230, 190))};
+  const transform::Rigid2f expected_pose({0.4f, -0.3f}, 0.2f);
+  ValueConversionTables conversion_tables;
+  for (const MapLimits& limits : map_limits) {
+    ProbabilityGrid probability_grid(limits, &conversion_tables);
+    range_data_inserter.Insert(
+        sensor::RangeData{
+            Eigen::Vector3f(expected_pose.translation().x(),
+                            expected_pose.translation().y(), 0.f),
+            sensor::TransformPointCloud(point_cloud,
+                                        transform::Embed3D(expected_pose)),
+            {}},
+        &probability_grid);
+    probability_grid.FinishUpdate();
+
+    FastCorrelativeScanMatcher2D fast_correlative_scan_matcher(probability_grid,
+                                                               options);
+    transform::Rigid2d pose_estimate;
+    float score;
+    ASSERT_TRUE(fast_correlative_scan_matcher.MatchFullSubmap(
+        point_cloud, kMinScore, &score, &pose_estimate));
+    transform::Rigid2d shared_pose_estimate;
+    float shared_score;
+    ASSERT_TRUE(fast_correlative_scan_matcher.MatchFullSubmap(
+        scans, kMinScore, nullptr /* thread_pool */, &shared_score,
+        &shared_pose_estimate));
+    EXPECT_EQ(score, shared_score);
+    EXPECT_EQ(pose_estimate.translation(), shared_pose_estimate.translation());
+    EXPECT_EQ(pose_estimate.rotation().angle(),
+              shared_pose_estimate.rotation().angle());
+    EXPECT_THAT(expected_pose,
+                transform::IsNearly(pose_estimate.cast<float>(), 0.03f));
+  }
+}
+
 }  // namespace
 }  // namespace scan_matching
 }  // namespace mapping
@@ -16,6 +16,9 @@
 
 #include "cartographer/mapping/internal/2d/scan_matching/occupied_space_cost_function_2d.h"
 
+#include <climits>
+#include <cmath>
+
 #include "cartographer/mapping/probability_values.h"
 #include "ceres/cubic_interpolation.h"
 
@@ -24,6 +27,38 @@ namespace mapping {
 namespace scan_matching {
 namespace {
 
+constexpr int kPadding = INT_MAX / 4;
+
+// Exposes the correspondence costs of a 'grid' to ceres::BiCubicInterpolator,
+// with a padding of 'kPadding' unknown cells on each side.
+class GridArrayAdapter {
+ public:
+  enum { DATA_DIMENSION = 1 };
+
+  explicit GridArrayAdapter(const Grid2D& grid) : grid_(grid) {}
+
+  void GetValue(const int row, const int column, double* const value) const {
+    if (row < kPadding || column < kPadding || row >= NumRows() - kPadding ||
+        column >= NumCols() - kPadding) {
+      *value = kMaxCorrespondenceCost;
+    } else {
+      *value = static_cast<double>(grid_.GetCorrespondenceCost(
+          Eigen::Array2i(column - kPadding, row - kPadding)));
+    }
+  }
+
+  int NumRows() const {
+    return grid_.limits().cell_limits().num_y_cells + 2 * kPadding;
+  }
+
+  int NumCols() const {
+    return grid_.limits().cell_limits().num_x_cells + 2 * kPadding;
+  }
+
+ private:
+  const Grid2D& grid_;
+};
+
 // Computes a cost for matching the 'point_cloud' to the 'grid' with
 // a 'pose'. The cost increases with poorer correspondence of the grid and the
 // point observation (e.g. points falling into less occupied space).
@@ -66,42 +101,91 @@ class OccupiedSpaceCostFunction2D {
   }
 
  private:
-  static constexpr int kPadding = INT_MAX / 4;
-  class GridArrayAdapter {
-   public:
-    enum { DATA_DIMENSION = 1 };
-
-    explicit GridArrayAdapter(const Grid2D& grid) : grid_(grid) {}
-
-    void GetValue(const int row, const int column, double* const value) const {
-      if (row < kPadding || column < kPadding || row >= NumRows() - kPadding ||
-          column >= NumCols() - kPadding) {
-        *value = kMaxCorrespondenceCost;
-      } else {
-        *value = static_cast<double>(grid_.GetCorrespondenceCost(
-            Eigen::Array2i(column - kPadding, row - kPadding)));
-      }
-    }
+  OccupiedSpaceCostFunction2D(const OccupiedSpaceCostFunction2D&) = delete;
+  OccupiedSpaceCostFunction2D& operator=(const OccupiedSpaceCostFunction2D&) =
+      delete;
 
-    int NumRows() const {
-      return grid_.limits().cell_limits().num_y_cells + 2 * kPadding;
-    }
+  const double scaling_factor_;
+  const sensor::PointCloud& point_cloud_;
+  const Grid2D& grid_;
+};
 
-    int NumCols() const {
-      return grid_.limits().cell_limits().num_x_cells + 2 * kPadding;
-    }
+// Same cost as OccupiedSpaceCostFunction2D with analytically computed
+// Jacobians. The interpolator returns the gradient of the grid together with
+// the value, so each point is only evaluated once per iteration and without
+// the overhead of Jets.
+class AnalyticalOccupiedSpaceCostFunction2D : public ceres::CostFunction {
+ public:
+  AnalyticalOccupiedSpaceCostFunction2D(const double scaling_factor,
+                                        const sensor::PointCloud& point_cloud,
+                                        const Grid2D& grid)
+      : scaling_factor_(scaling_factor),
+        point_cloud_(point_cloud),
+        grid_(grid),
+        adapter_(grid),
+        interpolator_(adapter_) {
+    set_num_residuals(point_cloud.size());
+    mutable_parameter_block_sizes()->push_back(3 /* pose variables */);
+  }
 
-   private:
-    const Grid2D& grid_;
-  };
+  bool Evaluate(double const* const* parameters, double* residuals,
+                double** jacobians) const override {
+    const double* const pose = parameters[0];
+    const double cos_rotation = std::cos(pose[2]);
+    const double sin_rotation = std::sin(pose[2]);
+    double* const jacobian = jacobians == nullptr ? nullptr : jacobians[0];
+    const MapLimits& limits = grid_.limits();
+    // The grid rows and columns decrease with the world x and y coordinates.
+    const double scaled_inverse_resolution =
+        -scaling_factor_ / limits.resolution();
 
-  OccupiedSpaceCostFunction2D(const OccupiedSpaceCostFunction2D&) = delete;
-  OccupiedSpaceCostFunction2D& operator=(const OccupiedSpaceCostFunction2D&) =
-      delete;
+    for (size_t i = 0; i < point_cloud_.size(); ++i) {
+      const double x = point_cloud_[i].position.x();
+      const double y = point_cloud_[i].position.y();
+      const double rotated_x = cos_rotation * x - sin_rotation * y;
+      const double rotated_y = sin_rotation * x + cos_rotation * y;
+      const double row = (limits.max().x() - (rotated_x + pose[0])) /
+                             limits.resolution() -
+                         0.5 + static_cast<double>(kPadding);
+      const double column = (limits.max().y() - (rotated_y + pose[1])) /
+                                limits.resolution() -
+                            0.5 + static_cast<double>(kPadding);
+      if (jacobian == nullptr) {
+        interpolator_.Evaluate(row, column, &residuals[i]);
+        residuals[i] *= scaling_factor_;
+        continue;
+      }
+      double value;
+      double value_derivative_row;
+      double value_derivative_column;
+      interpolator_.Evaluate(row, column, &value, &value_derivative_row,
+                             &value_derivative_column);
+      residuals[i] = scaling_factor_ * value;
+      // Jacobians in Ceres are row-major: jacobian[3 * i + j] is the derivative
+      // of residual i with respect to pose variable j.
+      const double derivative_x =
+          scaled_inverse_resolution * value_derivative_row;
+      const double derivative_y =
+          scaled_inverse_resolution * value_derivative_column;
+      jacobian[3 * i] = derivative_x;
+      jacobian[3 * i + 1] = derivative_y;
+      jacobian[3 * i + 2] =
+          derivative_y * rotated_x - derivative_x * rotated_y;
+    }
+    return true;
+  }
+
+ private:
+  AnalyticalOccupiedSpaceCostFunction2D(
+      const AnalyticalOccupiedSpaceCostFunction2D&) = delete;
+  AnalyticalOccupiedSpaceCostFunction2D& operator=(
+      const AnalyticalOccupiedSpaceCostFunction2D&) = delete;
 
   const double scaling_factor_;
   const sensor::PointCloud& point_cloud_;
   const Grid2D& grid_;
+  const GridArrayAdapter adapter_;
+  const ceres::BiCubicInterpolator<GridArrayAdapter> interpolator_;
 };
 
 }  // namespace
@@ -116,6 +200,13 @@ ceres::CostFunction* CreateOccupiedSpaceCostFunction2D(
       point_cloud.size());
 }
 
+ceres::CostFunction* CreateAnalyticalOccupiedSpaceCostFunction2D(
+    const double scaling_factor, const sensor::PointCloud& point_cloud,
+    const Grid2D& grid) {
+  return new AnalyticalOccupiedSpaceCostFunction2D(scaling_factor, point_cloud,
+                                                   grid);
+}
+
 }  // namespace scan_matching
 }  // namespace mapping
 }  // namespace cartographer
@@ -32,6 +32,12 @@ ceres::CostFunction* CreateOccupiedSpaceCostFunction2D(
     const double scaling_factor, const sensor::PointCloud& point_cloud,
     const Grid2D& grid);
 
+// Same as above, but with analytical Jacobians instead of automatic
+// differentiation, which is faster.
+ceres::CostFunction* CreateAnalyticalOccupiedSpaceCostFunction2D(
+    const double scaling_factor, const sensor::PointCloud& point_cloud,
+    const Grid2D& grid);
+
 }  // namespace scan_matching
 }  // namespace mapping
 }  // namespace cartographer
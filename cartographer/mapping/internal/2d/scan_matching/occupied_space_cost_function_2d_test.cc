@@ -51,6 +51,59 @@ TEST(OccupiedSpaceCostFunction2DTest, SmokeTest) {
   EXPECT_THAT(residuals, ElementsAre(DoubleEq(kMaxProbability)));
 }
 
+TEST(OccupiedSpaceCostFunction2DTest, AnalyticalMatchesAutoDiff) {
+  ValueConversionTables conversion_tables;
+  ProbabilityGrid grid(
+      MapLimits(0.1, Eigen::Vector2d(1., 1.), CellLimits(20, 20)),
+      &conversion_tables);
+  for (int x = 0; x < 20; ++x) {
+    for (int y = 0; y < 20; ++y) {
+      grid.SetProbability(
+          Eigen::Array2i(x, y),
+          kMinProbability + (kMaxProbability - kMinProbability) *
+                                ((3 * x + 7 * y) % 11) / 10.f);
+    }
+  }
+  const sensor::PointCloud point_cloud(
+      {{Eigen::Vector3f{0.03f, 0.11f, 0.f}},
+       {Eigen::Vector3f{-0.27f, 0.42f, 0.f}},
+       {Eigen::Vector3f{0.58f, -0.33f, 0.f}},
+       {Eigen::Vector3f{5.f, 5.f, 0.f}}});
+  std::unique_ptr<ceres::CostFunction> auto_diff_cost_function(
+      CreateOccupiedSpaceCostFunction2D(0.5, point_cloud, grid));
+  std::unique_ptr<ceres::CostFunction> analytical_cost_function(
+      CreateAnalyticalOccupiedSpaceCostFunction2D(0.5, point_cloud, grid));
+
+  const std::array<double, 3> pose_estimate{{0.12, -0.07, 0.3}};
+  const std::array<const double*, 1> parameter_blocks{{pose_estimate.data()}};
+  std::array<double, 4> auto_diff_residuals;
+  std::array<double, 4 * 3> auto_diff_jacobian;
+  std::array<double*, 1> auto_diff_jacobians{{auto_diff_jacobian.data()}};
+  auto_diff_cost_function->Evaluate(parameter_blocks.data(),
+                                    auto_diff_residuals.data(),
+                                    auto_diff_jacobians.data());
+  std::array<double, 4> analytical_residuals;
+  std::array<double, 4 * 3> analytical_jacobian;
+  std::array<double*, 1> analytical_jacobians{{analytical_jacobian.data()}};
+  analytical_cost_function->Evaluate(parameter_blocks.data(),
+                                     analytical_residuals.data(),
+                                     analytical_jacobians.data());
+
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_NEAR(auto_diff_residuals[i], analytical_residuals[i], 1e-12);
+  }
+  for (int i = 0; i < 4 * 3; ++i) {
+    EXPECT_NEAR(auto_diff_jacobian[i], analytical_jacobian[i], 1e-9);
+  }
+
+  // Residuals only.
+  analytical_cost_function->Evaluate(parameter_blocks.data(),
+                                     analytical_residuals.data(), nullptr);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_NEAR(auto_diff_residuals[i], analytical_residuals[i], 1e-12);
+  }
+}
+
 }  // namespace
 }  // namespace scan_matching
 }  // namespace mapping
@@ -28,29 +28,118 @@
 #include "cartographer/mapping/2d/tsdf_2d.h"
 #include "cartographer/sensor/point_cloud.h"
 #include "cartographer/transform/transform.h"
+#include "cartographer/mapping/probability_values.h"
 #include "glog/logging.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 namespace cartographer {
 namespace mapping {
 namespace scan_matching {
 namespace {
 
-float ComputeCandidateScore(const TSDF2D& tsdf,
-                            const DiscreteScan2D& discrete_scan,
-                            int x_index_offset, int y_index_offset) {
+// Returns per scan the bounding box of the offsets of its 'candidates'. Scans
+// without candidates get an empty box.
+std::vector<Eigen::AlignedBox2i> ComputeOffsetBoxes(
+    const int num_scans, const std::vector<Candidate2D>& candidates) {
+  std::vector<Eigen::AlignedBox2i> offset_boxes(num_scans);
+  for (const Candidate2D& candidate : candidates) {
+    CHECK_LT(candidate.scan_index, num_scans);
+    offset_boxes[candidate.scan_index].extend(
+        Eigen::Vector2i(candidate.x_index_offset, candidate.y_index_offset));
+  }
+  return offset_boxes;
+}
+
+// Returns the cell box reachable by 'discrete_scans' shifted by the offsets in
+// 'offset_boxes'.
+Eigen::AlignedBox2i ComputeWindowBox(
+    const std::vector<DiscreteScan2D>& discrete_scans,
+    const std::vector<Eigen::AlignedBox2i>& offset_boxes) {
+  CHECK_EQ(offset_boxes.size(), discrete_scans.size());
+  Eigen::AlignedBox2i window_box;
+  for (size_t scan_index = 0; scan_index != discrete_scans.size();
+       ++scan_index) {
+    if (offset_boxes[scan_index].isEmpty()) continue;
+    for (const Eigen::Array2i& xy_index : discrete_scans[scan_index]) {
+      window_box.extend(xy_index.matrix() + offset_boxes[scan_index].min());
+      window_box.extend(xy_index.matrix() + offset_boxes[scan_index].max());
+    }
+  }
+  CHECK(!window_box.isEmpty()) << "Cannot score candidates of empty scans.";
+  return window_box;
+}
+
+// The block of cells of a TSDF reachable by a set of candidates, with the
+// weighted normalized TSD score and the weight of every cell looked up once.
+// Equivalent to calling GetTSDAndWeight() for every point of every candidate,
+// but scoring then reads plain arrays without bounds checks or conversions.
+class TSDFWindow {
+ public:
+  TSDFWindow(const TSDF2D& tsdf,
+             const std::vector<DiscreteScan2D>& discrete_scans,
+             const std::vector<Eigen::AlignedBox2i>& offset_boxes);
+
+  // Returns the weighted mean of the normalized TSD scores of 'candidate'.
+  float ComputeScore(const Candidate2D& candidate) const;
+
+ private:
+  int num_x_cells_;
+  std::vector<float> weighted_scores_;
+  std::vector<float> weights_;
+  // Per scan, the indices of the points into the window without offset.
+  std::vector<std::vector<int>> flat_indices_;
+};
+
+TSDFWindow::TSDFWindow(const TSDF2D& tsdf,
+                       const std::vector<DiscreteScan2D>& discrete_scans,
+                       const std::vector<Eigen::AlignedBox2i>& offset_boxes) {
+  const Eigen::AlignedBox2i window_box =
+      ComputeWindowBox(discrete_scans, offset_boxes);
+  const Eigen::Array2i offset = window_box.min().array();
+  num_x_cells_ = window_box.sizes().x() + 1;
+  const int num_y_cells = window_box.sizes().y() + 1;
+  weighted_scores_.reserve(num_x_cells_ * num_y_cells);
+  weights_.reserve(num_x_cells_ * num_y_cells);
+  const float max_correspondence_cost = tsdf.GetMaxCorrespondenceCost();
+  for (int y = 0; y != num_y_cells; ++y) {
+    for (int x = 0; x != num_x_cells_; ++x) {
+      const std::pair<float, float> tsd_and_weight =
+          tsdf.GetTSDAndWeight(offset + Eigen::Array2i(x, y));
+      const float normalized_tsd_score =
+          (max_correspondence_cost - std::abs(tsd_and_weight.first)) /
+          max_correspondence_cost;
+      weighted_scores_.push_back(normalized_tsd_score * tsd_and_weight.second);
+      weights_.push_back(tsd_and_weight.second);
+    }
+  }
+
+  flat_indices_.resize(discrete_scans.size());
+  for (size_t scan_index = 0; scan_index != discrete_scans.size();
+       ++scan_index) {
+    if (offset_boxes[scan_index].isEmpty()) continue;
+    flat_indices_[scan_index].reserve(discrete_scans[scan_index].size());
+    for (const Eigen::Array2i& xy_index : discrete_scans[scan_index]) {
+      const Eigen::Array2i window_index = xy_index - offset;
+      flat_indices_[scan_index].push_back(window_index.y() * num_x_cells_ +
+                                          window_index.x());
+    }
+  }
+}
+
+float TSDFWindow::ComputeScore(const Candidate2D& candidate) const {
+  const int candidate_offset =
+      candidate.y_index_offset * num_x_cells_ + candidate.x_index_offset;
+  const float* const weighted_scores =
+      weighted_scores_.data() + candidate_offset;
+  const float* const weights = weights_.data() + candidate_offset;
   float candidate_score = 0.f;
   float summed_weight = 0.f;
-  for (const Eigen::Array2i& xy_index : discrete_scan) {
-    const Eigen::Array2i proposed_xy_index(xy_index.x() + x_index_offset,
-                                           xy_index.y() + y_index_offset);
-    const std::pair<float, float> tsd_and_weight =
-        tsdf.GetTSDAndWeight(proposed_xy_index);
-    const float normalized_tsd_score =
-        (tsdf.GetMaxCorrespondenceCost() - std::abs(tsd_and_weight.first)) /
-        tsdf.GetMaxCorrespondenceCost();
-    const float weight = tsd_and_weight.second;
-    candidate_score += normalized_tsd_score * weight;
-    summed_weight += weight;
+  for (const int index : flat_indices_[candidate.scan_index]) {
+    candidate_score += weighted_scores[index];
+    summed_weight += weights[index];
   }
   if (summed_weight == 0.f) return 0.f;
   candidate_score /= summed_weight;
@@ -58,20 +147,283 @@ float ComputeCandidateScore(const TSDF2D& tsdf,
   return candidate_score;
 }
 
-float ComputeCandidateScore(const ProbabilityGrid& probability_grid,
-                            const DiscreteScan2D& discrete_scan,
-                            int x_index_offset, int y_index_offset) {
-  float candidate_score = 0.f;
-  for (const Eigen::Array2i& xy_index : discrete_scan) {
-    const Eigen::Array2i proposed_xy_index(xy_index.x() + x_index_offset,
-                                           xy_index.y() + y_index_offset);
-    const float probability =
-        probability_grid.GetProbability(proposed_xy_index);
-    candidate_score += probability;
-  }
-  candidate_score /= static_cast<float>(discrete_scan.size());
-  CHECK_GT(candidate_score, 0.f);
-  return candidate_score;
+void ScoreTSDFCandidates(const TSDF2D& tsdf,
+                         const std::vector<DiscreteScan2D>& discrete_scans,
+                         std::vector<Candidate2D>* const candidates) {
+  if (candidates->empty()) return;
+  const TSDFWindow window(
+      tsdf, discrete_scans,
+      ComputeOffsetBoxes(discrete_scans.size(), *candidates));
+  for (Candidate2D& candidate : *candidates) {
+    candidate.score = window.ComputeScore(candidate);
+  }
+}
+
+// Returns the sum of 'cells[indices[i]]' for all 'num_indices' indices. With
+// AVX2, 8 cells are gathered per instruction as 32-bit words whose upper half
+// is the neighboring cell, so 'cells' must be readable one element past the
+// largest index.
+uint64 SumCellValues(const int* const indices, const int num_indices,
+                     const uint16* const cells) {
+  int i = 0;
+  uint64 sum = 0;
+#if defined(__AVX2__)
+  const __m256i low_mask = _mm256_set1_epi32(0xffff);
+  __m256i sum_a = _mm256_setzero_si256();
+  __m256i sum_b = _mm256_setzero_si256();
+  const int* const base = reinterpret_cast<const int*>(cells);
+  for (; i + 16 <= num_indices; i += 16) {
+    const __m256i indices_a =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + i));
+    const __m256i indices_b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + i + 8));
+    sum_a = _mm256_add_epi32(
+        sum_a,
+        _mm256_and_si256(_mm256_i32gather_epi32(base, indices_a, 2), low_mask));
+    sum_b = _mm256_add_epi32(
+        sum_b,
+        _mm256_and_si256(_mm256_i32gather_epi32(base, indices_b, 2), low_mask));
+  }
+  for (; i + 8 <= num_indices; i += 8) {
+    const __m256i indices_a =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + i));
+    sum_a = _mm256_add_epi32(
+        sum_a,
+        _mm256_and_si256(_mm256_i32gather_epi32(base, indices_a, 2), low_mask));
+  }
+  // Each lane holds at most num_indices / 8 values below 2^15, widen to 64 bit
+  // before adding the two accumulators.
+  alignas(32) uint32 lanes[16];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sum_a);
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes + 8), sum_b);
+  for (const uint32 lane : lanes) {
+    sum += lane;
+  }
+#endif
+  for (; i != num_indices; ++i) {
+    sum += cells[indices[i]];
+  }
+  return sum;
+}
+
+// The block of cells of a probability grid reachable by a set of candidates.
+// Equivalent to summing GetProbability() over the scan for every candidate, but
+// the block is copied once, with unknown and out-of-bounds cells set to the
+// value of 'kMaxCorrespondenceCost'. Scoring then needs neither bounds checks
+// nor table lookups: known values map affinely to probabilities, so raw values
+// are summed as integers and converted once per candidate.
+//
+// Like the PrecomputationGridStack2D of the FastCorrelativeScanMatcher2D, level
+// 'depth' holds for every cell the best value in the block of 2^depth x 2^depth
+// cells starting at that cell. Since values are not quantized, the scores on
+// coarser levels are exact upper bounds.
+class CorrespondenceCostWindow {
+ public:
+  // 'offset_boxes' bounds the offsets of the candidates per scan.
+  CorrespondenceCostWindow(const ProbabilityGrid& probability_grid,
+                           const std::vector<DiscreteScan2D>& discrete_scans,
+                           const std::vector<Eigen::AlignedBox2i>& offset_boxes,
+                           int num_levels);
+
+  int max_depth() const { return levels_.size() - 1; }
+
+  // Returns the mean probability of 'candidate' at 'depth' 0, and an upper
+  // bound of it for all candidates of the same scan with offsets in
+  // [x_index_offset, x_index_offset + 2^depth) x
+  // [y_index_offset, y_index_offset + 2^depth) at larger depths.
+  float ComputeScore(int depth, const Candidate2D& candidate) const;
+
+ private:
+  void AddCoarserLevel();
+
+  Eigen::Array2i offset_;
+  CellLimits limits_;
+  // One extra cell per level since the gathers read two cells at a time.
+  std::vector<std::vector<uint16>> levels_;
+  // Per scan, the indices of the points into a level without offset.
+  std::vector<std::vector<int>> flat_indices_;
+};
+
+CorrespondenceCostWindow::CorrespondenceCostWindow(
+    const ProbabilityGrid& probability_grid,
+    const std::vector<DiscreteScan2D>& discrete_scans,
+    const std::vector<Eigen::AlignedBox2i>& offset_boxes,
+    const int num_levels) {
+  CHECK_GE(num_levels, 1);
+  const int num_scans = discrete_scans.size();
+  const Eigen::AlignedBox2i window_box =
+      ComputeWindowBox(discrete_scans, offset_boxes);
+
+  offset_ = window_box.min().array();
+  limits_ = CellLimits(window_box.sizes().x() + 1, window_box.sizes().y() + 1);
+  levels_.reserve(num_levels);
+  levels_.emplace_back(limits_.num_x_cells * limits_.num_y_cells + 1,
+                       kUnknownCorrespondenceValue);
+  probability_grid.GetCorrespondenceCostValues(offset_, limits_,
+                                               levels_.front().data());
+  while (static_cast<int>(levels_.size()) < num_levels) {
+    AddCoarserLevel();
+  }
+
+  flat_indices_.resize(num_scans);
+  for (int scan_index = 0; scan_index != num_scans; ++scan_index) {
+    if (offset_boxes[scan_index].isEmpty()) continue;
+    flat_indices_[scan_index].reserve(discrete_scans[scan_index].size());
+    for (const Eigen::Array2i& xy_index : discrete_scans[scan_index]) {
+      const Eigen::Array2i window_index = xy_index - offset_;
+      flat_indices_[scan_index].push_back(
+          window_index.y() * limits_.num_x_cells + window_index.x());
+    }
+  }
+}
+
+void CorrespondenceCostWindow::AddCoarserLevel() {
+  // The block of the new level is made of four blocks of the previous one.
+  // Cells outside the window do not lower the minimum, which keeps the bound
+  // valid since no candidate reaches them.
+  const int step = 1 << (levels_.size() - 1);
+  const int stride = limits_.num_x_cells;
+  const std::vector<uint16>& previous = levels_.back();
+  std::vector<uint16> level(previous.size(), kUnknownCorrespondenceValue);
+  for (int y = 0; y != limits_.num_y_cells; ++y) {
+    const bool has_y = y + step < limits_.num_y_cells;
+    for (int x = 0; x != limits_.num_x_cells; ++x) {
+      const bool has_x = x + step < limits_.num_x_cells;
+      const int i = y * stride + x;
+      uint16 value = previous[i];
+      if (has_x) value = std::min(value, previous[i + step]);
+      if (has_y) {
+        value = std::min(value, previous[i + step * stride]);
+        if (has_x) value = std::min(value, previous[i + step * stride + step]);
+      }
+      level[i] = value;
+    }
+  }
+  levels_.push_back(std::move(level));
+}
+
+float CorrespondenceCostWindow::ComputeScore(
+    const int depth, const Candidate2D& candidate) const {
+  const std::vector<int>& indices = flat_indices_[candidate.scan_index];
+  const int num_points = indices.size();
+  const uint64 sum = SumCellValues(
+      indices.data(), num_points,
+      levels_[depth].data() + candidate.y_index_offset * limits_.num_x_cells +
+          candidate.x_index_offset);
+  // The probability of a known value v is kMaxProbability - (v - 1) * kScale.
+  constexpr float kScale =
+      (kMaxCorrespondenceCost - kMinCorrespondenceCost) / 32766.f;
+  return kMaxProbability -
+         kScale * static_cast<float>(static_cast<double>(sum - num_points) /
+                                     num_points);
+}
+
+void ScoreProbabilityGridCandidates(
+    const ProbabilityGrid& probability_grid,
+    const std::vector<DiscreteScan2D>& discrete_scans,
+    std::vector<Candidate2D>* const candidates) {
+  if (candidates->empty()) return;
+  const CorrespondenceCostWindow window(
+      probability_grid, discrete_scans,
+      ComputeOffsetBoxes(discrete_scans.size(), *candidates),
+      1 /* num_levels */);
+  for (Candidate2D& candidate : *candidates) {
+    candidate.score = window.ComputeScore(0, candidate);
+    CHECK_GT(candidate.score, 0.f);
+  }
+}
+
+// Returns the factor applied to the score of 'candidate' for its distance from
+// the initial pose estimate.
+double ComputeDeltaCostFactor(
+    const Candidate2D& candidate,
+    const proto::RealTimeCorrelativeScanMatcherOptions& options) {
+  return std::exp(-common::Pow2(
+      std::hypot(candidate.x, candidate.y) *
+          options.translation_delta_cost_weight() +
+      std::abs(candidate.orientation) * options.rotation_delta_cost_weight()));
+}
+
+// Returns the offset in [begin, end] closest to zero.
+int ClosestToZero(const int begin, const int end) {
+  return std::min(std::max(0, begin), end);
+}
+
+// Scores 'candidates' of width 2^'depth' with an upper bound of the scores of
+// all candidates they cover and sorts them, best first.
+void ScoreCoarseCandidates(
+    const CorrespondenceCostWindow& window, const int depth,
+    const SearchParameters& search_parameters,
+    const proto::RealTimeCorrelativeScanMatcherOptions& options,
+    std::vector<Candidate2D>* const candidates) {
+  const int width = 1 << depth;
+  for (Candidate2D& candidate : *candidates) {
+    const SearchParameters::LinearBounds& bounds =
+        search_parameters.linear_bounds[candidate.scan_index];
+    // The covered candidate closest to the initial pose gets the largest
+    // factor.
+    const Candidate2D closest(
+        candidate.scan_index,
+        ClosestToZero(candidate.x_index_offset,
+                      std::min(candidate.x_index_offset + width - 1,
+                               bounds.max_x)),
+        ClosestToZero(candidate.y_index_offset,
+                      std::min(candidate.y_index_offset + width - 1,
+                               bounds.max_y)),
+        search_parameters);
+    candidate.score = window.ComputeScore(depth, candidate);
+    candidate.score *= ComputeDeltaCostFactor(closest, options);
+  }
+  std::sort(candidates->begin(), candidates->end(),
+            std::greater<Candidate2D>());
+}
+
+// Same as in the FastCorrelativeScanMatcher2D, but since the bounds are exact
+// the result has the score of the best candidate of the exhaustive search.
+Candidate2D BranchAndBound(
+    const CorrespondenceCostWindow& window,
+    const SearchParameters& search_parameters,
+    const proto::RealTimeCorrelativeScanMatcherOptions& options,
+    const std::vector<Candidate2D>& candidates, const int candidate_depth,
+    float min_score) {
+  if (candidate_depth == 0) {
+    // Return the best candidate.
+    return *candidates.begin();
+  }
+
+  Candidate2D best_high_resolution_candidate(0, 0, 0, search_parameters);
+  best_high_resolution_candidate.score = min_score;
+  for (const Candidate2D& candidate : candidates) {
+    if (candidate.score <= min_score) {
+      break;
+    }
+    std::vector<Candidate2D> higher_resolution_candidates;
+    const int half_width = 1 << (candidate_depth - 1);
+    for (int x_offset : {0, half_width}) {
+      if (candidate.x_index_offset + x_offset >
+          search_parameters.linear_bounds[candidate.scan_index].max_x) {
+        break;
+      }
+      for (int y_offset : {0, half_width}) {
+        if (candidate.y_index_offset + y_offset >
+            search_parameters.linear_bounds[candidate.scan_index].max_y) {
+          break;
+        }
+        higher_resolution_candidates.emplace_back(
+            candidate.scan_index, candidate.x_index_offset + x_offset,
+            candidate.y_index_offset + y_offset, search_parameters);
+      }
+    }
+    ScoreCoarseCandidates(window, candidate_depth - 1, search_parameters,
+                          options, &higher_resolution_candidates);
+    best_high_resolution_candidate = std::max(
+        best_high_resolution_candidate,
+        BranchAndBound(window, search_parameters, options,
+                       higher_resolution_candidates, candidate_depth - 1,
+                       best_high_resolution_candidate.score));
+    min_score = best_high_resolution_candidate.score;
+  }
+  return best_high_resolution_candidate;
 }
 
 }  // namespace
@@ -114,6 +466,60 @@ RealTimeCorrelativeScanMatcher2D::GenerateExhaustiveSearchCandidates(
   return candidates;
 }
 
+std::vector<Candidate2D>
+RealTimeCorrelativeScanMatcher2D::GenerateLowestResolutionCandidates(
+    const SearchParameters& search_parameters) const {
+  const int linear_step_size = 1 << (options_.branch_and_bound_depth() - 1);
+  std::vector<Candidate2D> candidates;
+  for (int scan_index = 0; scan_index != search_parameters.num_scans;
+       ++scan_index) {
+    for (int x_index_offset = search_parameters.linear_bounds[scan_index].min_x;
+         x_index_offset <= search_parameters.linear_bounds[scan_index].max_x;
+         x_index_offset += linear_step_size) {
+      for (int y_index_offset =
+               search_parameters.linear_bounds[scan_index].min_y;
+           y_index_offset <= search_parameters.linear_bounds[scan_index].max_y;
+           y_index_offset += linear_step_size) {
+        candidates.emplace_back(scan_index, x_index_offset, y_index_offset,
+                                search_parameters);
+      }
+    }
+  }
+  return candidates;
+}
+
+Candidate2D RealTimeCorrelativeScanMatcher2D::ExhaustiveSearch(
+    const Grid2D& grid, const std::vector<DiscreteScan2D>& discrete_scans,
+    const SearchParameters& search_parameters) const {
+  std::vector<Candidate2D> candidates =
+      GenerateExhaustiveSearchCandidates(search_parameters);
+  ScoreCandidates(grid, discrete_scans, search_parameters, &candidates);
+  return *std::max_element(candidates.begin(), candidates.end());
+}
+
+Candidate2D RealTimeCorrelativeScanMatcher2D::BranchAndBoundSearch(
+    const ProbabilityGrid& probability_grid,
+    const std::vector<DiscreteScan2D>& discrete_scans,
+    const SearchParameters& search_parameters) const {
+  std::vector<Eigen::AlignedBox2i> offset_boxes;
+  offset_boxes.reserve(search_parameters.num_scans);
+  for (const SearchParameters::LinearBounds& bounds :
+       search_parameters.linear_bounds) {
+    offset_boxes.emplace_back(Eigen::Vector2i(bounds.min_x, bounds.min_y),
+                              Eigen::Vector2i(bounds.max_x, bounds.max_y));
+  }
+  const CorrespondenceCostWindow window(probability_grid, discrete_scans,
+                                        offset_boxes,
+                                        options_.branch_and_bound_depth());
+  std::vector<Candidate2D> lowest_resolution_candidates =
+      GenerateLowestResolutionCandidates(search_parameters);
+  ScoreCoarseCandidates(window, window.max_depth(), search_parameters,
+                        options_, &lowest_resolution_candidates);
+  return BranchAndBound(window, search_parameters, options_,
+                        lowest_resolution_candidates, window.max_depth(),
+                        std::numeric_limits<float>::lowest());
+}
+
 double RealTimeCorrelativeScanMatcher2D::Match(
     const transform::Rigid2d& initial_pose_estimate,
     const sensor::PointCloud& point_cloud, const Grid2D& grid,
@@ -129,18 +535,18 @@ double RealTimeCorrelativeScanMatcher2D::Match(
       options_.linear_search_window(), options_.angular_search_window(),
       rotated_point_cloud, grid.limits().resolution());
 
-  const std::vector<sensor::PointCloud> rotated_scans =
-      GenerateRotatedScans(rotated_point_cloud, search_parameters);
   const std::vector<DiscreteScan2D> discrete_scans = DiscretizeScans(
-      grid.limits(), rotated_scans,
+      grid.limits(),
+      GenerateRotatedScans(sensor::ToAlignedPointCloud(rotated_point_cloud),
+                           search_parameters),
       Eigen::Translation2f(initial_pose_estimate.translation().x(),
                            initial_pose_estimate.translation().y()));
-  std::vector<Candidate2D> candidates =
-      GenerateExhaustiveSearchCandidates(search_parameters);
-  ScoreCandidates(grid, discrete_scans, search_parameters, &candidates);
-
-  const Candidate2D& best_candidate =
-      *std::max_element(candidates.begin(), candidates.end());
+  const Candidate2D best_candidate =
+      options_.branch_and_bound_depth() > 1 &&
+              grid.GetGridType() == GridType::PROBABILITY_GRID
+          ? BranchAndBoundSearch(static_cast<const ProbabilityGrid&>(grid),
+                                 discrete_scans, search_parameters)
+          : ExhaustiveSearch(grid, discrete_scans, search_parameters);
   *pose_estimate = transform::Rigid2d(
       {initial_pose_estimate.translation().x() + best_candidate.x,
        initial_pose_estimate.translation().y() + best_candidate.y},
@@ -152,26 +558,18 @@ void RealTimeCorrelativeScanMatcher2D::ScoreCandidates(
     const Grid2D& grid, const std::vector<DiscreteScan2D>& discrete_scans,
     const SearchParameters& search_parameters,
     std::vector<Candidate2D>* const candidates) const {
+  switch (grid.GetGridType()) {
+    case GridType::PROBABILITY_GRID:
+      ScoreProbabilityGridCandidates(static_cast<const ProbabilityGrid&>(grid),
+                                     discrete_scans, candidates);
+      break;
+    case GridType::TSDF:
+      ScoreTSDFCandidates(static_cast<const TSDF2D&>(grid), discrete_scans,
+                          candidates);
+      break;
+  }
   for (Candidate2D& candidate : *candidates) {
-    switch (grid.GetGridType()) {
-      case GridType::PROBABILITY_GRID:
-        candidate.score = ComputeCandidateScore(
-            static_cast<const ProbabilityGrid&>(grid),
-            discrete_scans[candidate.scan_index], candidate.x_index_offset,
-            candidate.y_index_offset);
-        break;
-      case GridType::TSDF:
-        candidate.score = ComputeCandidateScore(
-            static_cast<const TSDF2D&>(grid),
-            discrete_scans[candidate.scan_index], candidate.x_index_offset,
-            candidate.y_index_offset);
-        break;
-    }
-    candidate.score *=
-        std::exp(-common::Pow2(std::hypot(candidate.x, candidate.y) *
-                                   options_.translation_delta_cost_weight() +
-                               std::abs(candidate.orientation) *
-                                   options_.rotation_delta_cost_weight()));
+    candidate.score *= ComputeDeltaCostFactor(candidate, options_);
   }
 }
 
@@ -35,6 +35,10 @@
 //
 // This can be made even faster by transforming the scan exactly once over some
 // discretized range.
+//
+// By default the window is searched exhaustively at full resolution. With
+// 'branch_and_bound_depth' > 1 and a probability grid, the steps above are done
+// over that many resolutions, as in the FastCorrelativeScanMatcher2D.
 
 #include <iostream>
 #include <memory>
@@ -42,6 +46,7 @@
 
 #include "Eigen/Core"
 #include "cartographer/mapping/2d/grid_2d.h"
+#include "cartographer/mapping/2d/probability_grid.h"
 #include "cartographer/mapping/internal/2d/scan_matching/correlative_scan_matcher_2d.h"
 #include "cartographer/mapping/proto/scan_matching/real_time_correlative_scan_matcher_options.pb.h"
 
@@ -80,6 +85,18 @@ class RealTimeCorrelativeScanMatcher2D {
  private:
   std::vector<Candidate2D> GenerateExhaustiveSearchCandidates(
       const SearchParameters& search_parameters) const;
+  std::vector<Candidate2D> GenerateLowestResolutionCandidates(
+      const SearchParameters& search_parameters) const;
+
+  Candidate2D ExhaustiveSearch(
+      const Grid2D& grid, const std::vector<DiscreteScan2D>& discrete_scans,
+      const SearchParameters& search_parameters) const;
+  // Finds the same best score as ExhaustiveSearch() by pruning with upper
+  // bounds at 'branch_and_bound_depth' resolutions.
+  Candidate2D BranchAndBoundSearch(
+      const ProbabilityGrid& probability_grid,
+      const std::vector<DiscreteScan2D>& discrete_scans,
+      const SearchParameters& search_parameters) const;
 
   const proto::RealTimeCorrelativeScanMatcherOptions options_;
 };
@@ -18,6 +18,7 @@
 
 #include <cmath>
 #include <memory>
+#include <string>
 
 #include "Eigen/Geometry"
 #include "absl/memory/memory.h"
@@ -44,11 +45,26 @@ CreateRealTimeCorrelativeScanMatcherTestOptions2D() {
       "angular_search_window = 0.16, "
       "translation_delta_cost_weight = 0., "
       "rotation_delta_cost_weight = 0., "
+      "branch_and_bound_depth = 1, "
       "}");
   return CreateRealTimeCorrelativeScanMatcherOptions(
       parameter_dictionary.get());
 }
 
+proto::RealTimeCorrelativeScanMatcherOptions
+CreateBranchAndBoundTestOptions2D(const int branch_and_bound_depth) {
+  auto parameter_dictionary = common::MakeDictionary(
+      "return {"
+      "linear_search_window = 0.6, "
+      "angular_search_window = 0.3, "
+      "translation_delta_cost_weight = 0.1, "
+      "rotation_delta_cost_weight = 0.2, "
+      "branch_and_bound_depth = " +
+      std::to_string(branch_and_bound_depth) + ", }");
+  return CreateRealTimeCorrelativeScanMatcherOptions(
+      parameter_dictionary.get());
+}
+
 class RealTimeCorrelativeScanMatcherTest : public ::testing::Test {
  protected:
   RealTimeCorrelativeScanMatcherTest() {
@@ -197,6 +213,87 @@ TEST_F(RealTimeCorrelativeScanMatcherTest,
   EXPECT_GT(1.0, candidates[0].score);
 }
 
+TEST_F(RealTimeCorrelativeScanMatcherTest,
+       ScoreCandidatesMatchesGetProbabilityProbabilityGrid) {
+  SetUpProbabilityGrid();
+  // Points and offsets reaching outside of the 6x6 grid, and 19 points per
+  // scan to exercise both the vectorized and the remainder loop.
+  std::vector<DiscreteScan2D> discrete_scans(2);
+  for (int i = 0; i != 19; ++i) {
+    discrete_scans[0].push_back(Eigen::Array2i(i % 8 - 1, i / 3 - 1));
+    discrete_scans[1].push_back(Eigen::Array2i(5 - i % 6, i % 7));
+  }
+  const SearchParameters search_parameters(0, 0, 0., 0.05);
+  std::vector<Candidate2D> candidates;
+  for (int scan_index = 0; scan_index != 2; ++scan_index) {
+    for (int x = -3; x <= 3; ++x) {
+      for (int y = -2; y <= 4; ++y) {
+        candidates.emplace_back(scan_index, x, y, search_parameters);
+      }
+    }
+  }
+  real_time_correlative_scan_matcher_->ScoreCandidates(
+      *grid_, discrete_scans, search_parameters, &candidates);
+  const ProbabilityGrid& probability_grid =
+      static_cast<const ProbabilityGrid&>(*grid_);
+  for (const Candidate2D& candidate : candidates) {
+    float expected_score = 0.f;
+    for (const Eigen::Array2i& xy_index :
+         discrete_scans[candidate.scan_index]) {
+      expected_score += probability_grid.GetProbability(
+          xy_index +
+          Eigen::Array2i(candidate.x_index_offset, candidate.y_index_offset));
+    }
+    expected_score /= discrete_scans[candidate.scan_index].size();
+    EXPECT_NEAR(expected_score, candidate.score, 1e-5);
+  }
+}
+
+TEST_F(RealTimeCorrelativeScanMatcherTest,
+       BranchAndBoundMatchesExhaustiveSearchProbabilityGrid) {
+  SetUpProbabilityGrid();
+  // A grid larger than the search window, so that coarse candidates get
+  // pruned, with an L-shaped wall and a post.
+  ProbabilityGrid probability_grid(
+      MapLimits(0.05, Eigen::Vector2d(1., 1.), CellLimits(40, 40)),
+      &conversion_tables_);
+  sensor::PointCloud map_points;
+  for (int i = -10; i <= 10; ++i) {
+    map_points.push_back({Eigen::Vector3f{0.05f * i, 0.5f, 0.f}});
+    map_points.push_back({Eigen::Vector3f{-0.5f, 0.05f * i, 0.f}});
+  }
+  map_points.push_back({Eigen::Vector3f{0.3f, -0.3f, 0.f}});
+  for (int i = 0; i != 3; ++i) {
+    range_data_inserter_->Insert(
+        sensor::RangeData{Eigen::Vector3f::Zero(), map_points, {}},
+        &probability_grid);
+    probability_grid.FinishUpdate();
+  }
+
+  const RealTimeCorrelativeScanMatcher2D exhaustive_matcher(
+      CreateBranchAndBoundTestOptions2D(1));
+  for (const int branch_and_bound_depth : {2, 3, 5}) {
+    const RealTimeCorrelativeScanMatcher2D branch_and_bound_matcher(
+        CreateBranchAndBoundTestOptions2D(branch_and_bound_depth));
+    for (const transform::Rigid2d& initial_pose_estimate :
+         {transform::Rigid2d::Identity(),
+          transform::Rigid2d({0.12, -0.07}, 0.1),
+          transform::Rigid2d({-0.2, 0.15}, -0.2)}) {
+      transform::Rigid2d exhaustive_pose_estimate;
+      transform::Rigid2d branch_and_bound_pose_estimate;
+      const double exhaustive_score = exhaustive_matcher.Match(
+          initial_pose_estimate, map_points, probability_grid,
+          &exhaustive_pose_estimate);
+      const double branch_and_bound_score = branch_and_bound_matcher.Match(
+          initial_pose_estimate, map_points, probability_grid,
+          &branch_and_bound_pose_estimate);
+      EXPECT_EQ(exhaustive_score, branch_and_bound_score)
+          << "depth " << branch_and_bound_depth << ", initial pose "
+          << initial_pose_estimate;
+    }
+  }
+}
+
 }  // namespace
 }  // namespace scan_matching
 }  // namespace mapping
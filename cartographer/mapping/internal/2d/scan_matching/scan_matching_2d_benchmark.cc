@@ -0,0 +1,191 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Benchmarks of the 2D scan matchers and of the precomputation grids used by
+// the fast correlative scan matcher, on a synthetic scan of a half circle.
+
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "cartographer/mapping/2d/probability_grid.h"
+#include "cartographer/mapping/2d/probability_grid_range_data_inserter_2d.h"
+#include "cartographer/mapping/internal/2d/scan_matching/ceres_scan_matcher_2d.h"
+#include "cartographer/mapping/internal/2d/scan_matching/fast_correlative_scan_matcher_2d.h"
+#include "cartographer/mapping/internal/2d/scan_matching/real_time_correlative_scan_matcher_2d.h"
+#include "cartographer/mapping/internal/testing/test_helpers.h"
+#include "cartographer/transform/transform.h"
+
+namespace cartographer {
+namespace mapping {
+namespace scan_matching {
+namespace {
+
+constexpr float kMinScore = 0.1f;
+
+sensor::PointCloud CreateScan() {
+  const sensor::TimedPointCloudData range_data =
+      testing::GenerateFakeRangeMeasurements(0. /* travel_distance */,
+                                             1. /* duration */,
+                                             1. /* time_step */)
+          .front();
+  sensor::PointCloud scan;
+  for (const sensor::TimedRangefinderPoint& point : range_data.ranges) {
+    scan.push_back({point.position});
+  }
+  return scan;
+}
+
+// A 15 m x 15 m grid into which 'scan' was inserted from ten poses along a
+// short path.
+class ScanMatching2DBenchmarkData {
+ public:
+  ScanMatching2DBenchmarkData()
+      : scan_(CreateScan()),
+        probability_grid_(
+            MapLimits(0.05, Eigen::Vector2d(7.5, 7.5), CellLimits(300, 300)),
+            &conversion_tables_) {
+    mapping::proto::ProbabilityGridRangeDataInserterOptions2D options;
+    options.set_insert_free_space(true);
+    options.set_hit_probability(0.55);
+    options.set_miss_probability(0.49);
+    const ProbabilityGridRangeDataInserter2D range_data_inserter(options);
+    for (int i = 0; i != 10; ++i) {
+      const transform::Rigid3f pose = transform::Rigid3f::Translation(
+          Eigen::Vector3f(0.05f * i, -0.02f * i, 0.f));
+      range_data_inserter.Insert(
+          sensor::RangeData{pose.translation(),
+                            sensor::TransformPointCloud(scan_, pose),
+                            {}},
+          &probability_grid_);
+      probability_grid_.FinishUpdate();
+    }
+  }
+
+  const sensor::PointCloud& scan() const { return scan_; }
+  const ProbabilityGrid& probability_grid() const { return probability_grid_; }
+
+  // Offset from the poses the scan was inserted at, as left by local SLAM.
+  static transform::Rigid2d InitialPoseEstimate() {
+    return transform::Rigid2d({0.28, -0.05}, 0.03);
+  }
+
+ private:
+  const sensor::PointCloud scan_;
+  ValueConversionTables conversion_tables_;
+  ProbabilityGrid probability_grid_;
+};
+
+const ScanMatching2DBenchmarkData& GetBenchmarkData() {
+  static const ScanMatching2DBenchmarkData* const data =
+      new ScanMatching2DBenchmarkData();
+  return *data;
+}
+
+proto::FastCorrelativeScanMatcherOptions2D
+CreateFastCorrelativeScanMatcherOptions(const int branch_and_bound_depth) {
+  proto::FastCorrelativeScanMatcherOptions2D options;
+  options.set_linear_search_window(3.);
+  options.set_angular_search_window(0.5);
+  options.set_branch_and_bound_depth(branch_and_bound_depth);
+  return options;
+}
+
+// Computes all grids of a stack, the argument is the branch and bound depth.
+void BM_PrecomputationGridStack2D(benchmark::State& state) {
+  const ScanMatching2DBenchmarkData& data = GetBenchmarkData();
+  const auto options = CreateFastCorrelativeScanMatcherOptions(state.range(0));
+  for (auto _ : state) {
+    PrecomputationGridStack2D precomputation_grid_stack(
+        data.probability_grid(), options);
+    for (int depth = 0; depth <= precomputation_grid_stack.max_depth();
+         ++depth) {
+      benchmark::DoNotOptimize(&precomputation_grid_stack.Get(depth));
+    }
+  }
+}
+BENCHMARK(BM_PrecomputationGridStack2D)->Arg(4)->Arg(7);
+
+// Matches with precomputed grids, the argument is the branch and bound depth.
+void BM_FastCorrelativeScanMatcher2DMatch(benchmark::State& state) {
+  const ScanMatching2DBenchmarkData& data = GetBenchmarkData();
+  const FastCorrelativeScanMatcher2D fast_correlative_scan_matcher(
+      data.probability_grid(),
+      CreateFastCorrelativeScanMatcherOptions(state.range(0)));
+  float score;
+  transform::Rigid2d pose_estimate;
+  // Computes the precomputation grids, which are benchmarked separately.
+  CHECK(fast_correlative_scan_matcher.Match(
+      ScanMatching2DBenchmarkData::InitialPoseEstimate(), data.scan(),
+      kMinScore, &score, &pose_estimate));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fast_correlative_scan_matcher.Match(
+        ScanMatching2DBenchmarkData::InitialPoseEstimate(), data.scan(),
+        kMinScore, &score, &pose_estimate));
+  }
+}
+BENCHMARK(BM_FastCorrelativeScanMatcher2DMatch)->Arg(4)->Arg(7);
+
+// The argument is the branch and bound depth, 1 searches exhaustively.
+void BM_RealTimeCorrelativeScanMatcher2DMatch(benchmark::State& state) {
+  const ScanMatching2DBenchmarkData& data = GetBenchmarkData();
+  proto::RealTimeCorrelativeScanMatcherOptions options;
+  options.set_linear_search_window(0.1);
+  options.set_angular_search_window(0.35);
+  options.set_translation_delta_cost_weight(0.1);
+  options.set_rotation_delta_cost_weight(0.1);
+  options.set_branch_and_bound_depth(state.range(0));
+  const RealTimeCorrelativeScanMatcher2D real_time_correlative_scan_matcher(
+      options);
+  transform::Rigid2d pose_estimate;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(real_time_correlative_scan_matcher.Match(
+        ScanMatching2DBenchmarkData::InitialPoseEstimate(), data.scan(),
+        data.probability_grid(), &pose_estimate));
+  }
+}
+BENCHMARK(BM_RealTimeCorrelativeScanMatcher2DMatch)->Arg(1)->Arg(3);
+
+void BM_CeresScanMatcher2DMatch(benchmark::State& state) {
+  const ScanMatching2DBenchmarkData& data = GetBenchmarkData();
+  proto::CeresScanMatcherOptions2D options;
+  options.set_occupied_space_weight(1.);
+  options.set_translation_weight(10.);
+  options.set_rotation_weight(40.);
+  options.mutable_ceres_solver_options()->set_use_nonmonotonic_steps(false);
+  options.mutable_ceres_solver_options()->set_max_num_iterations(20);
+  options.mutable_ceres_solver_options()->set_num_threads(1);
+  const CeresScanMatcher2D ceres_scan_matcher(options);
+  const transform::Rigid2d initial_pose_estimate =
+      ScanMatching2DBenchmarkData::InitialPoseEstimate();
+  transform::Rigid2d pose_estimate;
+  ceres::Solver::Summary summary;
+  for (auto _ : state) {
+    ceres_scan_matcher.Match(initial_pose_estimate.translation(),
+                             initial_pose_estimate, data.scan(),
+                             data.probability_grid(), &pose_estimate,
+                             &summary);
+    benchmark::DoNotOptimize(pose_estimate);
+  }
+}
+BENCHMARK(BM_CeresScanMatcher2DMatch);
+
+}  // namespace
+}  // namespace scan_matching
+}  // namespace mapping
+}  // namespace cartographer
+
+BENCHMARK_MAIN();
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/2d/scan_matching/tsdf_field_2d.h"
+
+#include <cmath>
+
+namespace cartographer {
+namespace mapping {
+namespace scan_matching {
+
+TSDFField2D::TSDFField2D(const TSDF2D& tsdf)
+    : max_(tsdf.limits().max()),
+      inverse_resolution_(1. / tsdf.limits().resolution()),
+      unknown_cell_(MakeCell(tsdf, Eigen::Array2i(-1, -1))) {
+  CellLimits cell_limits;
+  tsdf.ComputeCroppedLimits(&offset_, &cell_limits);
+  // The lower pixels of positions next to the known cells have neighbors
+  // among them, so the field extends one cell beyond the known cells.
+  size_ = Eigen::Array2i(cell_limits.num_x_cells + 1,
+                         cell_limits.num_y_cells + 1);
+  cells_.reserve(size_.prod());
+  for (int y = 0; y < size_.x(); ++y) {
+    for (int x = 0; x < size_.y(); ++x) {
+      cells_.push_back(MakeCell(tsdf, offset_ + Eigen::Array2i(y, x)));
+    }
+  }
+}
+
+TSDFField2D::Sample TSDFField2D::GetSample(const double x,
+                                           const double y) const {
+  double nx, ny;
+  const Cell& cell = GetCell(x, y, &nx, &ny);
+  Sample sample;
+  const auto interpolate = [nx, ny, this](const float* q, double* value,
+                                          Eigen::Vector2d* gradient) {
+    const double q1 = (q[1] - q[0]) * ny + q[0];
+    const double q2 = (q[3] - q[2]) * ny + q[2];
+    *value = (q2 - q1) * nx + q1;
+    *gradient = inverse_resolution_ *
+                Eigen::Vector2d(q2 - q1, (q[1] - q[0]) * (1. - nx) +
+                                             (q[3] - q[2]) * nx);
+  };
+  interpolate(cell.correspondence_costs, &sample.correspondence_cost,
+              &sample.correspondence_cost_gradient);
+  interpolate(cell.weights, &sample.weight, &sample.weight_gradient);
+  return sample;
+}
+
+TSDFField2D::Cell TSDFField2D::MakeCell(const TSDF2D& tsdf,
+                                        const Eigen::Array2i& cell_index) {
+  const Eigen::Array2i neighbors[4] = {
+      cell_index, cell_index + Eigen::Array2i(-1, 0),
+      cell_index + Eigen::Array2i(0, -1), cell_index + Eigen::Array2i(-1, -1)};
+  Cell cell;
+  bool known = true;
+  for (int i = 0; i < 4; ++i) {
+    cell.weights[i] = tsdf.GetWeight(neighbors[i]);
+    cell.correspondence_costs[i] = tsdf.GetCorrespondenceCost(neighbors[i]);
+    known = known && cell.weights[i] != 0.f;
+  }
+  if (!known) {
+    for (float& correspondence_cost : cell.correspondence_costs) {
+      correspondence_cost = tsdf.GetMaxCorrespondenceCost();
+    }
+  }
+  return cell;
+}
+
+const TSDFField2D::Cell& TSDFField2D::GetCell(
+    const double x, const double y, double* const normalized_x,
+    double* const normalized_y) const {
+  // Continuous cell indices, integral at pixel centers. The lower pixel is the
+  // one with the largest center at most (x, y), i.e. the smallest index.
+  const double index_x = (max_.x() - x) * inverse_resolution_ - 0.5;
+  const double index_y = (max_.y() - y) * inverse_resolution_ - 0.5;
+  const double lower_index_x = std::ceil(index_x);
+  const double lower_index_y = std::ceil(index_y);
+  *normalized_x = lower_index_x - index_x;
+  *normalized_y = lower_index_y - index_y;
+  const double field_y = lower_index_y - offset_.x();
+  const double field_x = lower_index_x - offset_.y();
+  if (!(field_y >= 0. && field_y < size_.x() && field_x >= 0. &&
+        field_x < size_.y())) {
+    return unknown_cell_;
+  }
+  return cells_[static_cast<int>(field_y) * size_.y() +
+                static_cast<int>(field_x)];
+}
+
+}  // namespace scan_matching
+}  // namespace mapping
+}  // namespace cartographer
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_MAPPING_INTERNAL_2D_SCAN_MATCHING_TSDF_FIELD_2D_H_
+#define CARTOGRAPHER_MAPPING_INTERNAL_2D_SCAN_MATCHING_TSDF_FIELD_2D_H_
+
+#include <vector>
+
+#include "Eigen/Core"
+#include "cartographer/mapping/2d/map_limits.h"
+#include "cartographer/mapping/2d/tsdf_2d.h"
+
+namespace cartographer {
+namespace mapping {
+namespace scan_matching {
+
+// A copy of a TSDF2D laid out for scan matching. For every pixel, the
+// correspondence costs and weights of the four pixels which are interpolated
+// between are stored next to each other in 32 bytes. An interpolation thus
+// reads a single cache line instead of two rows of two grids.
+//
+// Interpolates like InterpolatedTSDF2D, but the TSDF2D must not change after
+// the field was built, e.g. because its submap is finished. The field covers
+// the known cells and uses 32 bytes per cell.
+class TSDFField2D {
+ public:
+  explicit TSDFField2D(const TSDF2D& tsdf);
+
+  TSDFField2D(const TSDFField2D&) = delete;
+  TSDFField2D& operator=(const TSDFField2D&) = delete;
+
+  // Interpolated correspondence cost and weight at a position, and their
+  // gradients with respect to the position.
+  struct Sample {
+    double correspondence_cost;
+    double weight;
+    Eigen::Vector2d correspondence_cost_gradient;
+    Eigen::Vector2d weight_gradient;
+  };
+
+  // Returns the interpolated correspondence cost at (x,y). Cells with at least
+  // one 'unknown' interpolation point result in "MaxCorrespondenceCost()" with
+  // zero gradient.
+  template <typename T>
+  T GetCorrespondenceCost(const T& x, const T& y) const {
+    double normalized_x, normalized_y;
+    const Cell& cell =
+        GetCell(Scalar(x), Scalar(y), &normalized_x, &normalized_y);
+    return InterpolateBilinear(x, y, normalized_x, normalized_y,
+                               cell.correspondence_costs);
+  }
+
+  // Returns the interpolated weight at (x,y).
+  template <typename T>
+  T GetWeight(const T& x, const T& y) const {
+    double normalized_x, normalized_y;
+    const Cell& cell =
+        GetCell(Scalar(x), Scalar(y), &normalized_x, &normalized_y);
+    return InterpolateBilinear(x, y, normalized_x, normalized_y, cell.weights);
+  }
+
+  // Returns the correspondence cost and weight at (x,y) with their gradients
+  // from a single cell lookup, for analytic Jacobians.
+  Sample GetSample(double x, double y) const;
+
+  size_t MemoryUsageInBytes() const { return cells_.size() * sizeof(Cell); }
+
+ private:
+  // Values of the lower pixel (q11), of its neighbors in y (q12) and in x
+  // (q21) and of its diagonal neighbor (q22). If one of the weights is zero,
+  // all correspondence costs are the maximum correspondence cost.
+  struct alignas(32) Cell {
+    float correspondence_costs[4];
+    float weights[4];
+  };
+
+  static Cell MakeCell(const TSDF2D& tsdf, const Eigen::Array2i& cell_index);
+
+  // Returns the cell of the lower pixel of (x,y) and the position of (x,y)
+  // relative to it in pixels.
+  const Cell& GetCell(double x, double y, double* normalized_x,
+                      double* normalized_y) const;
+
+  static double Scalar(double value) { return value; }
+
+  // Uses the scalar part of a Ceres Jet.
+  template <typename T>
+  static double Scalar(const T& jet) {
+    return jet.a;
+  }
+
+  template <typename T>
+  T InterpolateBilinear(const T& x, const T& y, double normalized_x,
+                        double normalized_y, const float* q) const {
+    // Adds the derivatives of 'x' and 'y' for Ceres Jets.
+    const T nx = T(normalized_x) + (x - T(Scalar(x))) * inverse_resolution_;
+    const T ny = T(normalized_y) + (y - T(Scalar(y))) * inverse_resolution_;
+    const T q1 = T(q[1] - q[0]) * ny + T(q[0]);
+    const T q2 = T(q[3] - q[2]) * ny + T(q[2]);
+    return (q2 - q1) * nx + q1;
+  }
+
+  const Eigen::Vector2d max_;
+  const double inverse_resolution_;
+  // Cell index of the lower pixel of the first cell, and the number of cells
+  // in both directions.
+  Eigen::Array2i offset_;
+  Eigen::Array2i size_;
+  std::vector<Cell> cells_;
+  // Returned for positions outside of 'cells_'.
+  const Cell unknown_cell_;
+};
+
+}  // namespace scan_matching
+}  // namespace mapping
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_MAPPING_INTERNAL_2D_SCAN_MATCHING_TSDF_FIELD_2D_H_
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/2d/scan_matching/tsdf_field_2d.h"
+
+#include <random>
+
+#include "cartographer/mapping/internal/2d/scan_matching/interpolated_tsdf_2d.h"
+#include "ceres/jet.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace scan_matching {
+namespace {
+
+constexpr double kPrecision = 1e-5;
+
+class TSDFField2DTest : public ::testing::Test {
+ protected:
+  TSDFField2DTest()
+      : tsdf_(MapLimits(0.5, Eigen::Vector2d(5., 5.), CellLimits(20, 20)),
+              1.0f, 10.0f, &conversion_tables_) {
+    std::mt19937 prng(42);
+    std::uniform_real_distribution<float> tsd_distribution(-1.f, 1.f);
+    std::uniform_real_distribution<float> weight_distribution(0.5f, 10.f);
+    // Leaves a border of unknown cells and a hole.
+    for (int y = 3; y < 15; ++y) {
+      for (int x = 2; x < 16; ++x) {
+        if (x == 8 && y == 8) continue;
+        tsdf_.SetCell(Eigen::Array2i(y, x), tsd_distribution(prng),
+                      weight_distribution(prng));
+      }
+    }
+    tsdf_.FinishUpdate();
+  }
+
+  ValueConversionTables conversion_tables_;
+  TSDF2D tsdf_;
+};
+
+TEST_F(TSDFField2DTest, MatchesInterpolatedTSDF) {
+  const InterpolatedTSDF2D interpolated_tsdf(tsdf_);
+  const TSDFField2D tsdf_field(tsdf_);
+  for (double x = -6.; x < 6.; x += 0.0731) {
+    for (double y = -6.; y < 6.; y += 0.0917) {
+      EXPECT_NEAR(interpolated_tsdf.GetCorrespondenceCost(x, y),
+                  tsdf_field.GetCorrespondenceCost(x, y), kPrecision);
+      EXPECT_NEAR(interpolated_tsdf.GetWeight(x, y),
+                  tsdf_field.GetWeight(x, y), kPrecision);
+    }
+  }
+}
+
+TEST_F(TSDFField2DTest, SampleMatchesJets) {
+  using Jet = ceres::Jet<double, 2>;
+  const InterpolatedTSDF2D interpolated_tsdf(tsdf_);
+  const TSDFField2D tsdf_field(tsdf_);
+  for (double x = -6.; x < 6.; x += 0.0731) {
+    for (double y = -6.; y < 6.; y += 0.0917) {
+      const Jet jet_x(x, 0);
+      const Jet jet_y(y, 1);
+      const Jet expected_cost =
+          interpolated_tsdf.GetCorrespondenceCost(jet_x, jet_y);
+      const Jet expected_weight = interpolated_tsdf.GetWeight(jet_x, jet_y);
+      const Jet cost = tsdf_field.GetCorrespondenceCost(jet_x, jet_y);
+      const Jet weight = tsdf_field.GetWeight(jet_x, jet_y);
+      const TSDFField2D::Sample sample = tsdf_field.GetSample(x, y);
+      for (int i = 0; i < 2; ++i) {
+        EXPECT_NEAR(expected_cost.v[i], cost.v[i], kPrecision);
+        EXPECT_NEAR(expected_weight.v[i], weight.v[i], kPrecision);
+        EXPECT_NEAR(expected_cost.v[i],
+                    sample.correspondence_cost_gradient[i], kPrecision);
+        EXPECT_NEAR(expected_weight.v[i], sample.weight_gradient[i],
+                    kPrecision);
+      }
+      EXPECT_NEAR(expected_cost.a, sample.correspondence_cost, kPrecision);
+      EXPECT_NEAR(expected_weight.a, sample.weight, kPrecision);
+    }
+  }
+}
+
+TEST(TSDFField2DEmptyTest, ReturnsMaxCorrespondenceCost) {
+  ValueConversionTables conversion_tables;
+  const TSDF2D tsdf(MapLimits(0.5, Eigen::Vector2d(5., 5.), CellLimits(20, 20)),
+                    1.0f, 10.0f, &conversion_tables);
+  const TSDFField2D tsdf_field(tsdf);
+  EXPECT_NEAR(tsdf.GetMaxCorrespondenceCost(),
+              tsdf_field.GetCorrespondenceCost(1., 2.), kPrecision);
+  EXPECT_NEAR(0., tsdf_field.GetWeight(1., 2.), kPrecision);
+}
+
+}  // namespace
+}  // namespace scan_matching
+}  // namespace mapping
+}  // namespace cartographer
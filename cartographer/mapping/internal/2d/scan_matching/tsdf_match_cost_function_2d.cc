@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include "cartographer/mapping/internal/2d/scan_matching/tsdf_match_cost_function_2d.h"
+
 #include "Eigen/Core"
 #include "Eigen/Geometry"
 #include "cartographer/mapping/internal/2d/scan_matching/interpolated_tsdf_2d.h"
@@ -23,15 +25,21 @@
 namespace cartographer {
 namespace mapping {
 namespace scan_matching {
+namespace {
 
 // Computes a cost for matching the 'point_cloud' in the 'grid' at
 // a 'pose'. The cost increases with the signed distance of the matched point
 // location in the 'grid'.
+//
+// 'InterpolatedGrid' is InterpolatedTSDF2D, which is built from a TSDF2D, or a
+// reference to a TSDFField2D.
+template <typename InterpolatedGrid>
 class TSDFMatchCostFunction2D {
  public:
+  template <typename Grid>
   TSDFMatchCostFunction2D(const double residual_scaling_factor,
                           const sensor::PointCloud& point_cloud,
-                          const TSDF2D& grid)
+                          const Grid& grid)
       : residual_scaling_factor_(residual_scaling_factor),
         point_cloud_(point_cloud),
         interpolated_grid_(grid) {}
@@ -71,17 +79,34 @@ class TSDFMatchCostFunction2D {
 
   const double residual_scaling_factor_;
   const sensor::PointCloud& point_cloud_;
-  const InterpolatedTSDF2D interpolated_grid_;
+  const InterpolatedGrid interpolated_grid_;
 };
 
+template <typename InterpolatedGrid, typename Grid>
+ceres::CostFunction* CreateAutoDiffTSDFMatchCostFunction2D(
+    const double scaling_factor, const sensor::PointCloud& point_cloud,
+    const Grid& grid) {
+  return new ceres::AutoDiffCostFunction<
+      TSDFMatchCostFunction2D<InterpolatedGrid>, ceres::DYNAMIC /* residuals */,
+      3 /* pose variables */>(new TSDFMatchCostFunction2D<InterpolatedGrid>(
+                                  scaling_factor, point_cloud, grid),
+                              point_cloud.size());
+}
+
+}  // namespace
+
 ceres::CostFunction* CreateTSDFMatchCostFunction2D(
     const double scaling_factor, const sensor::PointCloud& point_cloud,
     const TSDF2D& tsdf) {
-  return new ceres::AutoDiffCostFunction<TSDFMatchCostFunction2D,
-                                         ceres::DYNAMIC /* residuals */,
-                                         3 /* pose variables */>(
-      new TSDFMatchCostFunction2D(scaling_factor, point_cloud, tsdf),
-      point_cloud.size());
+  return CreateAutoDiffTSDFMatchCostFunction2D<InterpolatedTSDF2D>(
+      scaling_factor, point_cloud, tsdf);
+}
+
+ceres::CostFunction* CreateTSDFMatchCostFunction2D(
+    const double scaling_factor, const sensor::PointCloud& point_cloud,
+    const TSDFField2D& tsdf_field) {
+  return CreateAutoDiffTSDFMatchCostFunction2D<const TSDFField2D&>(
+      scaling_factor, point_cloud, tsdf_field);
 }
 
 }  // namespace scan_matching
@@ -18,6 +18,7 @@
 #define CARTOGRAPHER_MAPPING_INTERNAL_2D_SCAN_MATCHING_TSDF_MATCH_COST_FUNCTION_2D_H_
 
 #include "cartographer/mapping/2d/tsdf_2d.h"
+#include "cartographer/mapping/internal/2d/scan_matching/tsdf_field_2d.h"
 #include "cartographer/sensor/point_cloud.h"
 #include "ceres/ceres.h"
 
@@ -32,6 +33,12 @@ ceres::CostFunction* CreateTSDFMatchCostFunction2D(
     const double scaling_factor, const sensor::PointCloud& point_cloud,
     const TSDF2D& grid);
 
+// Like above, but interpolates in the 'tsdf_field' of a finished TSDF, which
+// has to outlive the cost function.
+ceres::CostFunction* CreateTSDFMatchCostFunction2D(
+    const double scaling_factor, const sensor::PointCloud& point_cloud,
+    const TSDFField2D& tsdf_field);
+
 }  // namespace scan_matching
 }  // namespace mapping
 }  // namespace cartographer
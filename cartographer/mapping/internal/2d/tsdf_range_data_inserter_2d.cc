@@ -16,6 +16,8 @@
 
 #include "cartographer/mapping/internal/2d/tsdf_range_data_inserter_2d.h"
 
+#include <algorithm>
+
 #include "cartographer/mapping/internal/2d/normal_estimation_2d.h"
 #include "cartographer/mapping/internal/2d/ray_to_pixel_mask.h"
 
@@ -50,42 +52,38 @@ float GaussianKernel(const float x, const float sigma) {
   return 1.0 / (kSqrtTwoPi * sigma) * std::exp(-0.5 * x * x / (sigma * sigma));
 }
 
-std::pair<Eigen::Array2i, Eigen::Array2i> SuperscaleRay(
-    const Eigen::Vector2f& begin, const Eigen::Vector2f& end,
-    TSDF2D* const tsdf) {
-  const MapLimits& limits = tsdf->limits();
-  const double superscaled_resolution = limits.resolution() / kSubpixelScale;
-  const MapLimits superscaled_limits(
-      superscaled_resolution, limits.max(),
-      CellLimits(limits.cell_limits().num_x_cells * kSubpixelScale,
-                 limits.cell_limits().num_y_cells * kSubpixelScale));
-
-  const Eigen::Array2i superscaled_begin =
-      superscaled_limits.GetCellIndex(begin);
-  const Eigen::Array2i superscaled_end = superscaled_limits.GetCellIndex(end);
-  return std::make_pair(superscaled_begin, superscaled_end);
+MapLimits SuperscaleLimits(const MapLimits& limits) {
+  const CellLimits& cell_limits = limits.cell_limits();
+  return MapLimits(limits.resolution() / kSubpixelScale, limits.max(),
+                   CellLimits(cell_limits.num_x_cells * kSubpixelScale,
+                              cell_limits.num_y_cells * kSubpixelScale));
 }
 
-struct RangeDataSorter {
-  RangeDataSorter(Eigen::Vector3f origin) { origin_ = origin.head<2>(); }
-  bool operator()(const sensor::RangefinderPoint& lhs,
-                  const sensor::RangefinderPoint& rhs) {
-    const Eigen::Vector2f delta_lhs =
-        (lhs.position.head<2>() - origin_).normalized();
-    const Eigen::Vector2f delta_rhs =
-        (rhs.position.head<2>() - origin_).normalized();
-    if ((delta_lhs[1] < 0.f) != (delta_rhs[1] < 0.f)) {
-      return delta_lhs[1] < 0.f;
-    } else if (delta_lhs[1] < 0.f) {
-      return delta_lhs[0] < delta_rhs[0];
-    } else {
-      return delta_lhs[0] > delta_rhs[0];
-    }
+// Returns the returns of 'range_data' sorted by the angle of their direction
+// from the origin, from -pi to pi. The sort key of each return is computed
+// once instead of in every comparison.
+sensor::PointCloud SortReturnsByAngle(const sensor::RangeData& range_data) {
+  const Eigen::Vector2f origin = range_data.origin.head<2>();
+  // Returns with negative y come first, ordered by increasing x of their
+  // normalized direction, followed by the others with decreasing x.
+  std::vector<std::pair<std::pair<bool, float>, size_t>> keys;
+  keys.reserve(range_data.returns.size());
+  for (size_t i = 0; i < range_data.returns.size(); ++i) {
+    const Eigen::Vector2f direction =
+        (range_data.returns[i].position.head<2>() - origin).normalized();
+    const bool upper_half = !(direction[1] < 0.f);
+    keys.emplace_back(
+        std::make_pair(upper_half, upper_half ? -direction[0] : direction[0]),
+        i);
   }
-
- private:
-  Eigen::Vector2f origin_;
-};
+  std::sort(keys.begin(), keys.end());
+  std::vector<sensor::RangefinderPoint> returns;
+  returns.reserve(keys.size());
+  for (const auto& key : keys) {
+    returns.push_back(range_data.returns[key.second]);
+  }
+  return sensor::PointCloud(std::move(returns));
+}
 
 float ComputeRangeWeightFactor(float range, int exponent) {
   float weight = 0.f;
@@ -135,39 +133,37 @@ void TSDFRangeDataInserter2D::Insert(const sensor::RangeData& range_data,
   TSDF2D* tsdf = static_cast<TSDF2D*>(grid);
   GrowAsNeeded(range_data, truncation_distance, tsdf);
 
-  // Compute normals if needed.
+  // Compute normals if needed. Only then the returns need to be sorted.
   bool scale_update_weight_angle_scan_normal_to_ray =
       options_.update_weight_angle_scan_normal_to_ray_kernel_bandwidth() != 0.f;
-  sensor::RangeData sorted_range_data = range_data;
+  sensor::RangeData sorted_range_data;
   std::vector<float> normals;
   if (options_.project_sdf_distance_to_scan_normal() ||
       scale_update_weight_angle_scan_normal_to_ray) {
-    std::vector<sensor::RangefinderPoint> returns =
-        sorted_range_data.returns.points();
-    std::sort(returns.begin(), returns.end(),
-              RangeDataSorter(sorted_range_data.origin));
-    sorted_range_data.returns = sensor::PointCloud(std::move(returns));
+    sorted_range_data.origin = range_data.origin;
+    sorted_range_data.returns = SortReturnsByAngle(range_data);
     normals = EstimateNormals(sorted_range_data,
                               options_.normal_estimation_options());
   }
+  const sensor::PointCloud& returns =
+      normals.empty() ? range_data.returns : sorted_range_data.returns;
 
-  const Eigen::Vector2f origin = sorted_range_data.origin.head<2>();
-  for (size_t hit_index = 0; hit_index < sorted_range_data.returns.size();
-       ++hit_index) {
-    const Eigen::Vector2f hit =
-        sorted_range_data.returns[hit_index].position.head<2>();
+  const MapLimits superscaled_limits = SuperscaleLimits(tsdf->limits());
+  const Eigen::Vector2f origin = range_data.origin.head<2>();
+  for (size_t hit_index = 0; hit_index < returns.size(); ++hit_index) {
+    const Eigen::Vector2f hit = returns[hit_index].position.head<2>();
     const float normal = normals.empty()
                              ? std::numeric_limits<float>::quiet_NaN()
                              : normals[hit_index];
-    InsertHit(options_, hit, origin, normal, tsdf);
+    InsertHit(options_, superscaled_limits, hit, origin, normal, tsdf);
   }
   tsdf->FinishUpdate();
 }
 
 void TSDFRangeDataInserter2D::InsertHit(
     const proto::TSDFRangeDataInserterOptions2D& options,
-    const Eigen::Vector2f& hit, const Eigen::Vector2f& origin, float normal,
-    TSDF2D* tsdf) const {
+    const MapLimits& superscaled_limits, const Eigen::Vector2f& hit,
+    const Eigen::Vector2f& origin, float normal, TSDF2D* tsdf) const {
   const Eigen::Vector2f ray = hit - origin;
   const float range = ray.norm();
   const float truncation_distance =
@@ -178,10 +174,17 @@ void TSDFRangeDataInserter2D::InsertHit(
       options_.update_free_space() ? origin
                                    : origin + (1.0f - truncation_ratio) * ray;
   const Eigen::Vector2f ray_end = origin + (1.0f + truncation_ratio) * ray;
-  std::pair<Eigen::Array2i, Eigen::Array2i> superscaled_ray =
-      SuperscaleRay(ray_begin, ray_end, tsdf);
-  std::vector<Eigen::Array2i> ray_mask = RayToPixelMask(
-      superscaled_ray.first, superscaled_ray.second, kSubpixelScale);
+  std::vector<Eigen::Array2i> ray_mask =
+      RayToPixelMask(superscaled_limits.GetCellIndex(ray_begin),
+                     superscaled_limits.GetCellIndex(ray_end), kSubpixelScale);
+  // Cells which were already updated by another ray of this range data are
+  // left alone.
+  ray_mask.erase(std::remove_if(ray_mask.begin(), ray_mask.end(),
+                                [tsdf](const Eigen::Array2i& cell_index) {
+                                  return tsdf->CellIsUpdated(cell_index);
+                                }),
+                 ray_mask.end());
+  if (ray_mask.empty()) return;
 
   // Precompute weight factors.
   float weight_factor_angle_ray_normal = 1.f;
@@ -200,27 +203,39 @@ void TSDFRangeDataInserter2D::InsertHit(
         range, options_.update_weight_range_exponent());
   }
 
+  // Compute the updates of all cells along the ray at once, so that Eigen can
+  // vectorize them.
+  const int num_cells = ray_mask.size();
+  Eigen::ArrayXf cell_centers_x(num_cells);
+  Eigen::ArrayXf cell_centers_y(num_cells);
+  for (int i = 0; i < num_cells; ++i) {
+    const Eigen::Vector2f cell_center =
+        tsdf->limits().GetCellCenter(ray_mask[i]);
+    cell_centers_x[i] = cell_center.x();
+    cell_centers_y[i] = cell_center.y();
+  }
+  Eigen::ArrayXf update_tsd;
+  if (options_.project_sdf_distance_to_scan_normal()) {
+    update_tsd = (cell_centers_x - hit.x()) * std::cos(normal) +
+                 (cell_centers_y - hit.y()) * std::sin(normal);
+  } else {
+    update_tsd = range - ((cell_centers_x - origin.x()).square() +
+                          (cell_centers_y - origin.y()).square())
+                             .sqrt();
+  }
+  update_tsd = update_tsd.max(-truncation_distance).min(truncation_distance);
+  Eigen::ArrayXf update_weight = Eigen::ArrayXf::Constant(
+      num_cells, weight_factor_range * weight_factor_angle_ray_normal);
+  const float sigma =
+      options_.update_weight_distance_cell_to_hit_kernel_bandwidth();
+  if (sigma != 0.f) {
+    update_weight *= (1.f / (kSqrtTwoPi * sigma)) *
+                     (-0.5f / (sigma * sigma) * update_tsd.square()).exp();
+  }
+
   // Update Cells.
-  for (const Eigen::Array2i& cell_index : ray_mask) {
-    if (tsdf->CellIsUpdated(cell_index)) continue;
-    Eigen::Vector2f cell_center = tsdf->limits().GetCellCenter(cell_index);
-    float distance_cell_to_origin = (cell_center - origin).norm();
-    float update_tsd = range - distance_cell_to_origin;
-    if (options_.project_sdf_distance_to_scan_normal()) {
-      float normal_orientation = normal;
-      update_tsd = (cell_center - hit)
-                       .dot(Eigen::Vector2f{std::cos(normal_orientation),
-                                            std::sin(normal_orientation)});
-    }
-    update_tsd =
-        common::Clamp(update_tsd, -truncation_distance, truncation_distance);
-    float update_weight = weight_factor_range * weight_factor_angle_ray_normal;
-    if (options_.update_weight_distance_cell_to_hit_kernel_bandwidth() != 0.f) {
-      update_weight *= GaussianKernel(
-          update_tsd,
-          options_.update_weight_distance_cell_to_hit_kernel_bandwidth());
-    }
-    UpdateCell(cell_index, update_tsd, update_weight, tsdf);
+  for (int i = 0; i < num_cells; ++i) {
+    UpdateCell(ray_mask[i], update_tsd[i], update_weight[i], tsdf);
   }
 }
 
@@ -47,6 +47,7 @@ class TSDFRangeDataInserter2D : public RangeDataInserterInterface {
 
  private:
   void InsertHit(const proto::TSDFRangeDataInserterOptions2D& options,
+                 const MapLimits& superscaled_limits,
                  const Eigen::Vector2f& hit, const Eigen::Vector2f& origin,
                  float normal, TSDF2D* tsdf) const;
   void UpdateCell(const Eigen::Array2i& cell, float update_sdf,
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/3d/imu_aggregator.h"
+
+#include "cartographer/transform/transform.h"
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace mapping {
+
+ImuAggregator::ImuAggregator(const common::Duration chunk_duration)
+    : chunk_duration_(chunk_duration) {
+  CHECK_GT(chunk_duration_, common::Duration::zero());
+}
+
+absl::optional<sensor::ImuData> ImuAggregator::Add(
+    const sensor::ImuData& imu_data) {
+  if (!last_imu_data_.has_value()) {
+    last_imu_data_ = imu_data;
+    chunk_start_ = imu_data.time;
+    chunk_end_ = imu_data.time;
+    return absl::nullopt;
+  }
+  CHECK_GE(imu_data.time, last_imu_data_->time);
+  // After a split past its time, 'imu_data' only applies from the split on.
+  if (imu_data.time > chunk_end_) {
+    Advance(imu_data.time);
+  }
+  last_imu_data_ = imu_data;
+  if (chunk_end_ - chunk_start_ >= chunk_duration_) {
+    return EndChunk();
+  }
+  return absl::nullopt;
+}
+
+absl::optional<sensor::ImuData> ImuAggregator::Split(const common::Time time) {
+  if (!last_imu_data_.has_value() || time < chunk_end_) {
+    return absl::nullopt;
+  }
+  Advance(time);
+  if (chunk_end_ == chunk_start_) {
+    return absl::nullopt;
+  }
+  return EndChunk();
+}
+
+void ImuAggregator::Advance(const common::Time time) {
+  // Same step as in IntegrateImu().
+  const double duration = common::ToSeconds(time - chunk_end_);
+  const Eigen::Quaterniond step_rotation =
+      transform::AngleAxisVectorToRotationQuaternion(
+          Eigen::Vector3d(last_imu_data_->angular_velocity * duration));
+  delta_velocity_ += delta_rotation_ * (step_rotation *
+                                        (last_imu_data_->linear_acceleration *
+                                         duration));
+  delta_rotation_ = (delta_rotation_ * step_rotation).normalized();
+  chunk_end_ = time;
+}
+
+sensor::ImuData ImuAggregator::EndChunk() {
+  const double duration = common::ToSeconds(chunk_end_ - chunk_start_);
+  // Integrating these constant values over 'duration' gives back
+  // 'delta_rotation_' and 'delta_velocity_'.
+  const sensor::ImuData chunk{
+      chunk_start_,
+      delta_rotation_.conjugate() * delta_velocity_ / duration,
+      transform::RotationQuaternionToAngleAxisVector(delta_rotation_) /
+          duration};
+  chunk_start_ = chunk_end_;
+  delta_rotation_ = Eigen::Quaterniond::Identity();
+  delta_velocity_ = Eigen::Vector3d::Zero();
+  return chunk;
+}
+
+}  // namespace mapping
+}  // namespace cartographer
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_MAPPING_INTERNAL_3D_IMU_AGGREGATOR_H_
+#define CARTOGRAPHER_MAPPING_INTERNAL_3D_IMU_AGGREGATOR_H_
+
+#include "Eigen/Core"
+#include "Eigen/Geometry"
+#include "absl/types/optional.h"
+#include "cartographer/common/time.h"
+#include "cartographer/sensor/imu_data.h"
+
+namespace cartographer {
+namespace mapping {
+
+// Replaces a stream of IMU data by one IMU data per chunk of at least
+// 'chunk_duration', so that storing IMU data for the optimization does not
+// scale with the IMU rate.
+//
+// Each chunk is preintegrated while IMU data is added, and returned as an IMU
+// data at the start of the chunk whose constant angular velocity and linear
+// acceleration integrate to the same rotation and velocity change over the
+// chunk as in IntegrateImu(). Integrals over whole chunks are therefore kept
+// up to floating point rounding, only integrals starting or ending inside a
+// chunk are approximated. Chunks can additionally be ended at the times of
+// trajectory nodes by Split(), which makes the integrals between consecutive
+// nodes exact.
+class ImuAggregator {
+ public:
+  explicit ImuAggregator(common::Duration chunk_duration);
+
+  // Adds 'imu_data' and returns the chunk which got complete, if any.
+  // 'imu_data' must not be before the last added IMU data.
+  absl::optional<sensor::ImuData> Add(const sensor::ImuData& imu_data);
+
+  // Ends the current chunk at 'time' and returns it, if 'time' is not before
+  // the last added IMU data. The last added IMU data is assumed to stay
+  // constant until 'time'.
+  absl::optional<sensor::ImuData> Split(common::Time time);
+
+ private:
+  // Integrates the last IMU data up to 'time'.
+  void Advance(common::Time time);
+  sensor::ImuData EndChunk();
+
+  const common::Duration chunk_duration_;
+  absl::optional<sensor::ImuData> last_imu_data_;
+  common::Time chunk_start_;
+  // The time up to which the current chunk is integrated.
+  common::Time chunk_end_;
+  // Integral of the current chunk, starting with zero velocity.
+  Eigen::Quaterniond delta_rotation_ = Eigen::Quaterniond::Identity();
+  Eigen::Vector3d delta_velocity_ = Eigen::Vector3d::Zero();
+};
+
+}  // namespace mapping
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_MAPPING_INTERNAL_3D_IMU_AGGREGATOR_H_
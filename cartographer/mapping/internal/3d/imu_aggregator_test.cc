@@ -0,0 +1,103 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/3d/imu_aggregator.h"
+
+#include <random>
+#include <vector>
+
+#include "cartographer/mapping/internal/3d/imu_preintegration.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+TEST(ImuAggregatorTest, KeepsIntegralsBetweenSplits) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> angular_velocity(-1., 1.);
+  std::uniform_real_distribution<double> linear_acceleration(-2., 2.);
+  ImuAggregator aggregator(common::FromSeconds(0.05));
+  ImuPreintegration raw;
+  ImuPreintegration aggregated;
+  std::vector<common::Time> split_times;
+  int num_imu_data = 0;
+  common::Time time = common::FromUniversal(123);
+  // 400 Hz IMU data for 10 seconds, split about every 0.13 seconds.
+  for (int i = 0; i != 4000; ++i) {
+    const sensor::ImuData imu_data{
+        time,
+        Eigen::Vector3d(linear_acceleration(rng), linear_acceleration(rng),
+                        9.81 + linear_acceleration(rng)),
+        Eigen::Vector3d(angular_velocity(rng), angular_velocity(rng),
+                        angular_velocity(rng))};
+    raw.Append(imu_data);
+    const absl::optional<sensor::ImuData> chunk = aggregator.Add(imu_data);
+    if (chunk.has_value()) {
+      aggregated.Append(*chunk);
+      ++num_imu_data;
+    }
+    time += common::FromMilliseconds(2.5);
+    if (i % 52 == 51) {
+      const common::Time split_time = time - common::FromMilliseconds(1);
+      const absl::optional<sensor::ImuData> split_chunk =
+          aggregator.Split(split_time);
+      ASSERT_TRUE(split_chunk.has_value());
+      aggregated.Append(*split_chunk);
+      ++num_imu_data;
+      split_times.push_back(split_time);
+    }
+  }
+  EXPECT_LT(num_imu_data, 4000 / 15);
+  // Splitting again at the same time, or before it, does not add a chunk.
+  EXPECT_FALSE(aggregator.Split(split_times.back()).has_value());
+  EXPECT_FALSE(
+      aggregator.Split(split_times.back() - common::FromSeconds(1.))
+          .has_value());
+
+  // Integrals between consecutive splits are kept.
+  for (size_t i = 1; i < split_times.size(); ++i) {
+    const IntegrateImuResult<double> expected =
+        raw.Integrate(split_times[i - 1], split_times[i]);
+    const IntegrateImuResult<double> actual =
+        aggregated.Integrate(split_times[i - 1], split_times[i]);
+    EXPECT_NEAR(expected.delta_rotation.angularDistance(actual.delta_rotation),
+                0., 1e-9);
+    EXPECT_TRUE(expected.delta_velocity.isApprox(actual.delta_velocity, 1e-9))
+        << expected.delta_velocity.transpose() << " vs. "
+        << actual.delta_velocity.transpose();
+  }
+  // Integrals between the centers of these intervals, as used for the
+  // acceleration cost, are approximated.
+  for (size_t i = 2; i < split_times.size(); ++i) {
+    const common::Time first_center =
+        split_times[i - 2] + (split_times[i - 1] - split_times[i - 2]) / 2;
+    const common::Time second_center =
+        split_times[i - 1] + (split_times[i] - split_times[i - 1]) / 2;
+    const IntegrateImuResult<double> expected =
+        raw.Integrate(first_center, second_center);
+    const IntegrateImuResult<double> actual =
+        aggregated.Integrate(first_center, second_center);
+    EXPECT_NEAR(expected.delta_rotation.angularDistance(actual.delta_rotation),
+                0., 1e-2);
+    EXPECT_NEAR((expected.delta_velocity - actual.delta_velocity).norm(), 0.,
+                1e-2);
+  }
+}
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/3d/imu_preintegration.h"
+
+#include <algorithm>
+
+#include "cartographer/transform/transform.h"
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace mapping {
+
+void ImuPreintegration::Append(const sensor::ImuData& imu_data) {
+  if (imu_data_.empty()) {
+    integrals_in_block_.push_back(Identity());
+  } else {
+    CHECK_GT(imu_data.time, imu_data_.back().time);
+    const Integral to_imu_data =
+        Compose(integrals_in_block_.back(),
+                Step(imu_data_.back(),
+                     common::ToSeconds(imu_data.time - imu_data_.back().time)));
+    if (imu_data_.size() % kBlockSize == 0) {
+      block_integrals_.push_back(to_imu_data);
+      integrals_in_block_.push_back(Identity());
+    } else {
+      integrals_in_block_.push_back(to_imu_data);
+    }
+  }
+  imu_data_.push_back(imu_data);
+}
+
+IntegrateImuResult<double> ImuPreintegration::Integrate(
+    const common::Time start_time, const common::Time end_time) const {
+  CHECK_LE(start_time, end_time);
+  const size_t first_index = FindIndex(start_time);
+  const size_t last_index = FindIndex(end_time);
+  Integral integral;
+  if (first_index == last_index) {
+    integral = Step(imu_data_[first_index],
+                    common::ToSeconds(end_time - start_time));
+  } else {
+    // Integrate up to the next IMU data, over all IMU data in between and
+    // from the last IMU data to 'end_time'.
+    integral = Compose(
+        Compose(Step(imu_data_[first_index],
+                     common::ToSeconds(imu_data_[first_index + 1].time -
+                                       start_time)),
+                IntegrateBetween(first_index + 1, last_index)),
+        Step(imu_data_[last_index],
+             common::ToSeconds(end_time - imu_data_[last_index].time)));
+  }
+  return IntegrateImuResult<double>{integral.delta_velocity,
+                                    integral.delta_translation,
+                                    integral.delta_rotation};
+}
+
+ImuPreintegration::Integral ImuPreintegration::Identity() {
+  return Integral{Eigen::Quaterniond::Identity(), Eigen::Vector3d::Zero(),
+                  Eigen::Vector3d::Zero(), 0.};
+}
+
+ImuPreintegration::Integral ImuPreintegration::Step(
+    const sensor::ImuData& imu_data, const double duration) {
+  const Eigen::Quaterniond delta_rotation =
+      transform::AngleAxisVectorToRotationQuaternion(
+          Eigen::Vector3d(imu_data.angular_velocity * duration));
+  const Eigen::Vector3d delta_velocity =
+      delta_rotation * (imu_data.linear_acceleration * duration);
+  return Integral{delta_rotation, delta_velocity, duration * delta_velocity,
+                  duration};
+}
+
+ImuPreintegration::Integral ImuPreintegration::Compose(
+    const Integral& first, const Integral& second) {
+  return Integral{
+      first.delta_rotation * second.delta_rotation,
+      first.delta_velocity + first.delta_rotation * second.delta_velocity,
+      first.delta_translation + second.duration * first.delta_velocity +
+          first.delta_rotation * second.delta_translation,
+      first.duration + second.duration};
+}
+
+ImuPreintegration::Integral ImuPreintegration::IntegrateBetween(
+    const size_t first_index, const size_t last_index) const {
+  CHECK_LE(first_index, last_index);
+  // Removes the integral up to 'first' from the integral up to 'last', both
+  // starting at the same time.
+  const auto difference = [](const Integral& first, const Integral& last) {
+    const Eigen::Quaterniond inverse_rotation =
+        first.delta_rotation.conjugate();
+    const double duration = last.duration - first.duration;
+    return Integral{
+        inverse_rotation * last.delta_rotation,
+        inverse_rotation * (last.delta_velocity - first.delta_velocity),
+        inverse_rotation * (last.delta_translation - first.delta_translation -
+                            duration * first.delta_velocity),
+        duration};
+  };
+  const size_t first_block = first_index / kBlockSize;
+  const size_t last_block = last_index / kBlockSize;
+  if (first_block == last_block) {
+    return difference(integrals_in_block_[first_index],
+                      integrals_in_block_[last_index]);
+  }
+  Integral integral = difference(integrals_in_block_[first_index],
+                                 block_integrals_[first_block]);
+  for (size_t block = first_block + 1; block != last_block; ++block) {
+    integral = Compose(integral, block_integrals_[block]);
+  }
+  return Compose(integral, integrals_in_block_[last_index]);
+}
+
+size_t ImuPreintegration::FindIndex(const common::Time time) const {
+  const auto it = std::upper_bound(
+      imu_data_.begin(), imu_data_.end(), time,
+      [](const common::Time time, const sensor::ImuData& imu_data) {
+        return time < imu_data.time;
+      });
+  CHECK(it != imu_data_.begin()) << "No IMU data at or before " << time;
+  return std::distance(imu_data_.begin(), it) - 1;
+}
+
+}  // namespace mapping
+}  // namespace cartographer
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_MAPPING_INTERNAL_3D_IMU_PREINTEGRATION_H_
+#define CARTOGRAPHER_MAPPING_INTERNAL_3D_IMU_PREINTEGRATION_H_
+
+#include <vector>
+
+#include "Eigen/Core"
+#include "Eigen/Geometry"
+#include "cartographer/common/time.h"
+#include "cartographer/mapping/internal/3d/imu_integration.h"
+#include "cartographer/sensor/imu_data.h"
+
+namespace cartographer {
+namespace mapping {
+
+// Keeps IMU data together with integrals of it, so that integrating over an
+// interval does not need to step through all IMU data in the interval.
+//
+// Integrate() gives the same result as IntegrateImu() without calibration up
+// to floating point rounding: The integral over consecutive IMU data is
+// composed from integrals which are relative to the start of a block of
+// 'kBlockSize' IMU data, so it takes a binary search plus the number of
+// blocks in the interval. Keeping the integrals relative to a block start
+// limits their magnitude, which would otherwise grow quadratically with time
+// since gravity is not removed.
+//
+// IMU data can only be appended. Callers that remove IMU data should rebuild
+// the preintegration from the remaining data.
+class ImuPreintegration {
+ public:
+  static constexpr int kBlockSize = 1024;
+
+  ImuPreintegration() = default;
+
+  // 'imu_data' must be after the last appended IMU data.
+  void Append(const sensor::ImuData& imu_data);
+
+  bool empty() const { return imu_data_.empty(); }
+  size_t size() const { return imu_data_.size(); }
+
+  // Integrates the IMU data from 'start_time' to 'end_time'. There must be IMU
+  // data at or before 'start_time'. The last IMU data is assumed to stay
+  // constant after its time.
+  IntegrateImuResult<double> Integrate(common::Time start_time,
+                                       common::Time end_time) const;
+
+ private:
+  // The integral over a time interval of 'duration' seconds, starting with
+  // zero velocity.
+  struct Integral {
+    Eigen::Quaterniond delta_rotation;
+    Eigen::Vector3d delta_velocity;
+    Eigen::Vector3d delta_translation;
+    double duration;
+  };
+
+  static Integral Identity();
+  // Integrates 'imu_data' over 'duration' seconds, as one step of
+  // IntegrateImu().
+  static Integral Step(const sensor::ImuData& imu_data, double duration);
+  // Returns the integral over the interval of 'first' followed by the one of
+  // 'second'.
+  static Integral Compose(const Integral& first, const Integral& second);
+  // Returns the integral from the time of 'imu_data_[first_index]' to the one
+  // of 'imu_data_[last_index]'.
+  Integral IntegrateBetween(size_t first_index, size_t last_index) const;
+  // Returns the index of the last IMU data at or before 'time'.
+  size_t FindIndex(common::Time time) const;
+
+  std::vector<sensor::ImuData> imu_data_;
+  // For each IMU data, the integral from the first IMU data of its block.
+  std::vector<Integral> integrals_in_block_;
+  // For each completed block, the integral from its first IMU data to the
+  // first IMU data of the next block.
+  std::vector<Integral> block_integrals_;
+};
+
+}  // namespace mapping
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_MAPPING_INTERNAL_3D_IMU_PREINTEGRATION_H_
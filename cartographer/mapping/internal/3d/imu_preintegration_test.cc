@@ -0,0 +1,120 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/3d/imu_preintegration.h"
+
+#include <random>
+
+#include "cartographer/sensor/map_by_time.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+constexpr int kTrajectoryId = 0;
+
+class ImuPreintegrationTest : public ::testing::Test {
+ protected:
+  ImuPreintegrationTest() {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> angular_velocity(-1., 1.);
+    std::uniform_real_distribution<double> linear_acceleration(-2., 2.);
+    std::uniform_int_distribution<int> interval_us(2000, 8000);
+    common::Time time = common::FromUniversal(123);
+    for (int i = 0; i != 3 * ImuPreintegration::kBlockSize + 100; ++i) {
+      const sensor::ImuData imu_data{
+          time,
+          Eigen::Vector3d(linear_acceleration(rng), linear_acceleration(rng),
+                          9.81 + linear_acceleration(rng)),
+          Eigen::Vector3d(angular_velocity(rng), angular_velocity(rng),
+                          angular_velocity(rng))};
+      imu_data_.Append(kTrajectoryId, imu_data);
+      preintegration_.Append(imu_data);
+      time += common::FromSeconds(1e-6 * interval_us(rng));
+    }
+    end_time_ = time;
+  }
+
+  void ExpectSameAsIntegrateImu(const common::Time start_time,
+                                const common::Time end_time) {
+    const auto trajectory = imu_data_.trajectory(kTrajectoryId);
+    auto it = trajectory.begin();
+    while (std::next(it) != trajectory.end() &&
+           std::next(it)->time <= start_time) {
+      ++it;
+    }
+    const IntegrateImuResult<double> expected =
+        IntegrateImu(trajectory, start_time, end_time, &it);
+    const IntegrateImuResult<double> actual =
+        preintegration_.Integrate(start_time, end_time);
+    EXPECT_NEAR(
+        expected.delta_rotation.angularDistance(actual.delta_rotation), 0.,
+        1e-9);
+    EXPECT_TRUE(
+        expected.delta_velocity.isApprox(actual.delta_velocity, 1e-9))
+        << expected.delta_velocity.transpose() << " vs. "
+        << actual.delta_velocity.transpose();
+    EXPECT_TRUE(
+        expected.delta_translation.isApprox(actual.delta_translation, 1e-9))
+        << expected.delta_translation.transpose() << " vs. "
+        << actual.delta_translation.transpose();
+  }
+
+  sensor::MapByTime<sensor::ImuData> imu_data_;
+  ImuPreintegration preintegration_;
+  common::Time end_time_;
+};
+
+TEST_F(ImuPreintegrationTest, EmptyInterval) {
+  const common::Time time =
+      common::FromUniversal(123) + common::FromMilliseconds(10);
+  const IntegrateImuResult<double> result =
+      preintegration_.Integrate(time, time);
+  EXPECT_NEAR(result.delta_rotation.w(), 1., 1e-12);
+  EXPECT_TRUE(result.delta_velocity.isZero());
+  EXPECT_TRUE(result.delta_translation.isZero());
+}
+
+TEST_F(ImuPreintegrationTest, MatchesIntegrateImu) {
+  const common::Time start_time = common::FromUniversal(123);
+  const double duration = common::ToSeconds(end_time_ - start_time) + 0.1;
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> seconds(0., duration);
+  for (int i = 0; i != 200; ++i) {
+    common::Time first = start_time + common::FromSeconds(seconds(rng));
+    common::Time second = start_time + common::FromSeconds(seconds(rng));
+    if (second < first) {
+      std::swap(first, second);
+    }
+    ExpectSameAsIntegrateImu(first, second);
+  }
+  // Intervals starting and ending exactly at IMU data and block boundaries.
+  const auto trajectory = imu_data_.trajectory(kTrajectoryId);
+  auto it = trajectory.begin();
+  const common::Time first_time = it->time;
+  std::advance(it, ImuPreintegration::kBlockSize);
+  const common::Time second_time = it->time;
+  std::advance(it, ImuPreintegration::kBlockSize);
+  ExpectSameAsIntegrateImu(first_time, second_time);
+  ExpectSameAsIntegrateImu(first_time, it->time);
+  ExpectSameAsIntegrateImu(second_time, it->time);
+  ExpectSameAsIntegrateImu(second_time, end_time_);
+}
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
@@ -21,6 +21,7 @@
 #include "absl/memory/memory.h"
 #include "cartographer/common/time.h"
 #include "cartographer/mapping/internal/3d/scan_matching/rotational_scan_matcher.h"
+#include "cartographer/mapping/internal/motion_compensation.h"
 #include "cartographer/mapping/proto/local_trajectory_builder_options_3d.pb.h"
 #include "cartographer/mapping/proto/scan_matching/ceres_scan_matcher_options_3d.pb.h"
 #include "cartographer/mapping/proto/scan_matching/real_time_correlative_scan_matcher_options.pb.h"
@@ -39,6 +40,7 @@ static auto* kLocalSlamScanMatcherFraction = metrics::Gauge::Null();
 static auto* kLocalSlamInsertIntoSubmapFraction = metrics::Gauge::Null();
 static auto* kLocalSlamRealTimeRatio = metrics::Gauge::Null();
 static auto* kLocalSlamCpuRealTimeRatio = metrics::Gauge::Null();
+static auto* kLocalSlamDurationMetric = metrics::Histogram::Null();
 static auto* kRealTimeCorrelativeScanMatcherScoreMetric =
     metrics::Histogram::Null();
 static auto* kCeresScanMatcherCostMetric = metrics::Histogram::Null();
@@ -49,7 +51,7 @@ LocalTrajectoryBuilder3D::LocalTrajectoryBuilder3D(
     const mapping::proto::LocalTrajectoryBuilderOptions3D& options,
     const std::vector<std::string>& expected_range_sensor_ids)
     : options_(options),
-      active_submaps_(options.submaps_options()),
+      active_submaps_(options.submaps_options(), options.use_intensities()),
       motion_filter_(options.motion_filter_options()),
       real_time_correlative_scan_matcher_(
           absl::make_unique<scan_matching::RealTimeCorrelativeScanMatcher3D>(
@@ -129,7 +131,7 @@ void LocalTrajectoryBuilder3D::AddImuData(const sensor::ImuData& imu_data) {
 std::unique_ptr<LocalTrajectoryBuilder3D::MatchingResult>
 LocalTrajectoryBuilder3D::AddRangeData(
     const std::string& sensor_id,
-    const sensor::TimedPointCloudData& unsynchronized_data) {
+    sensor::TimedPointCloudData unsynchronized_data) {
   if (options_.use_intensities()) {
     CHECK_EQ(unsynchronized_data.ranges.size(),
              unsynchronized_data.intensities.size())
@@ -137,7 +139,8 @@ LocalTrajectoryBuilder3D::AddRangeData(
            "ranges.";
   }
   auto synchronized_data =
-      range_data_collator_.AddRangeData(sensor_id, unsynchronized_data);
+      range_data_collator_.AddRangeData(sensor_id,
+                                        std::move(unsynchronized_data));
   if (synchronized_data.ranges.empty()) {
     LOG(INFO) << "Range data collator filling buffer.";
     return nullptr;
@@ -164,8 +167,9 @@ LocalTrajectoryBuilder3D::AddRangeData(
     accumulated_point_cloud_origin_data_.clear();
   }
 
-  synchronized_data.ranges = sensor::VoxelFilter(
-      synchronized_data.ranges, 0.5f * options_.voxel_filter_size());
+  sensor::VoxelFilter(0.5f * options_.voxel_filter_size(),
+                      &scan_buffers_.voxel_filter_scratch,
+                      &synchronized_data.ranges);
   accumulated_point_cloud_origin_data_.emplace_back(
       std::move(synchronized_data));
   ++num_accumulated_;
@@ -176,7 +180,8 @@ LocalTrajectoryBuilder3D::AddRangeData(
   num_accumulated_ = 0;
 
   bool warned = false;
-  std::vector<common::Time> hit_times;
+  std::vector<common::Time>& hit_times = scan_buffers_.hit_times;
+  hit_times.clear();
   common::Time prev_time_point = extrapolator_->GetLastExtrapolatedTime();
   for (const auto& point_cloud_origin_data :
        accumulated_point_cloud_origin_data_) {
@@ -199,21 +204,33 @@ LocalTrajectoryBuilder3D::AddRangeData(
   }
   hit_times.push_back(accumulated_point_cloud_origin_data_.back().time);
 
-  const PoseExtrapolatorInterface::ExtrapolationResult extrapolation_result =
-      extrapolator_->ExtrapolatePosesWithGravity(hit_times);
-  std::vector<transform::Rigid3f> hits_poses(
-      std::move(extrapolation_result.previous_poses));
-  hits_poses.push_back(extrapolation_result.current_pose.cast<float>());
+  std::vector<transform::Rigid3f> hits_poses;
+  PoseExtrapolatorInterface::ExtrapolationResult extrapolation_result;
+  if (options_.motion_compensation_interval() > 0.) {
+    std::vector<common::Time>& sample_times = scan_buffers_.sample_times;
+    SelectMotionCompensationSampleTimes(
+        hit_times, common::FromSeconds(options_.motion_compensation_interval()),
+        &sample_times);
+    extrapolation_result =
+        extrapolator_->ExtrapolatePosesWithGravity(sample_times);
+    std::vector<transform::Rigid3f> sample_poses(
+        std::move(extrapolation_result.previous_poses));
+    sample_poses.push_back(extrapolation_result.current_pose.cast<float>());
+    InterpolateMotionCompensationPoses(sample_times, sample_poses, hit_times,
+                                       &hits_poses);
+  } else {
+    extrapolation_result =
+        extrapolator_->ExtrapolatePosesWithGravity(hit_times);
+    hits_poses = std::move(extrapolation_result.previous_poses);
+    hits_poses.push_back(extrapolation_result.current_pose.cast<float>());
+  }
   CHECK_EQ(hits_poses.size(), hit_times.size());
 
-  const size_t max_possible_number_of_accumulated_points = hit_times.size();
-  std::vector<sensor::RangefinderPoint> accumulated_points;
-  std::vector<float> accumulated_intensities;
-  accumulated_points.reserve(max_possible_number_of_accumulated_points);
-  if (options_.use_intensities()) {
-    accumulated_intensities.reserve(max_possible_number_of_accumulated_points);
-  }
-  sensor::PointCloud misses;
+  sensor::PointCloud& returns = scan_buffers_.accumulated_returns;
+  sensor::PointCloud& misses = scan_buffers_.accumulated_misses;
+  returns.clear();
+  misses.clear();
+  returns.reserve(hit_times.size());
   std::vector<transform::Rigid3f>::const_iterator hits_poses_it =
       hits_poses.begin();
   for (const auto& point_cloud_origin_data :
@@ -227,9 +244,11 @@ LocalTrajectoryBuilder3D::AddRangeData(
       const float range = delta.norm();
       if (range >= options_.min_range()) {
         if (range <= options_.max_range()) {
-          accumulated_points.push_back(sensor::RangefinderPoint{hit_in_local});
           if (options_.use_intensities()) {
-            accumulated_intensities.push_back(hit.intensity);
+            returns.push_back(sensor::RangefinderPoint{hit_in_local},
+                              hit.intensity);
+          } else {
+            returns.push_back(sensor::RangefinderPoint{hit_in_local});
           }
         } else {
           // We insert a ray cropped to 'max_range' as a miss for hits beyond
@@ -245,8 +264,6 @@ LocalTrajectoryBuilder3D::AddRangeData(
     }
   }
   CHECK(std::next(hits_poses_it) == hits_poses.end());
-  const sensor::PointCloud returns(std::move(accumulated_points),
-                                   std::move(accumulated_intensities));
 
   const common::Time current_sensor_time = synchronized_data.time;
   absl::optional<common::Duration> sensor_duration;
@@ -257,10 +274,16 @@ LocalTrajectoryBuilder3D::AddRangeData(
 
   const common::Time current_time = hit_times.back();
   const auto voxel_filter_start = std::chrono::steady_clock::now();
-  const sensor::RangeData filtered_range_data = {
-      extrapolation_result.current_pose.translation().cast<float>(),
-      sensor::VoxelFilter(returns, options_.voxel_filter_size()),
-      sensor::VoxelFilter(misses, options_.voxel_filter_size())};
+  sensor::RangeData& filtered_range_data =
+      scan_buffers_.filtered_range_data_in_local;
+  filtered_range_data.origin =
+      extrapolation_result.current_pose.translation().cast<float>();
+  sensor::VoxelFilter(returns, options_.voxel_filter_size(),
+                      &scan_buffers_.voxel_filter_scratch,
+                      &filtered_range_data.returns);
+  sensor::VoxelFilter(misses, options_.voxel_filter_size(),
+                      &scan_buffers_.voxel_filter_scratch,
+                      &filtered_range_data.misses);
   const auto voxel_filter_stop = std::chrono::steady_clock::now();
   const auto voxel_filter_duration = voxel_filter_stop - voxel_filter_start;
 
@@ -271,13 +294,18 @@ LocalTrajectoryBuilder3D::AddRangeData(
     kLocalSlamVoxelFilterFraction->Set(voxel_filter_fraction);
   }
 
-  return AddAccumulatedRangeData(
-      current_time,
-      sensor::TransformRangeData(
-          filtered_range_data,
-          extrapolation_result.current_pose.inverse().cast<float>()),
+  sensor::TransformRangeData(
+      filtered_range_data,
+      extrapolation_result.current_pose.inverse().cast<float>(),
+      &scan_buffers_.filtered_range_data_in_tracking);
+  const auto start_time = std::chrono::steady_clock::now();
+  std::unique_ptr<MatchingResult> matching_result = AddAccumulatedRangeData(
+      current_time, scan_buffers_.filtered_range_data_in_tracking,
       sensor_duration, extrapolation_result.current_pose,
       extrapolation_result.gravity_from_tracking);
+  kLocalSlamDurationMetric->Observe(
+      common::ToSeconds(std::chrono::steady_clock::now() - start_time));
+  return matching_result;
 }
 
 std::unique_ptr<LocalTrajectoryBuilder3D::MatchingResult>
@@ -294,18 +322,24 @@ LocalTrajectoryBuilder3D::AddAccumulatedRangeData(
 
   const auto scan_matcher_start = std::chrono::steady_clock::now();
 
-  const sensor::PointCloud high_resolution_point_cloud_in_tracking =
-      sensor::AdaptiveVoxelFilter(
-          filtered_range_data_in_tracking.returns,
-          options_.high_resolution_adaptive_voxel_filter_options());
+  const sensor::PointCloud& high_resolution_point_cloud_in_tracking =
+      scan_buffers_.high_resolution_point_cloud_in_tracking;
+  sensor::AdaptiveVoxelFilter(
+      filtered_range_data_in_tracking.returns,
+      options_.high_resolution_adaptive_voxel_filter_options(),
+      &scan_buffers_.voxel_filter_scratch,
+      &scan_buffers_.high_resolution_point_cloud_in_tracking);
   if (high_resolution_point_cloud_in_tracking.empty()) {
     LOG(WARNING) << "Dropped empty high resolution point cloud data.";
     return nullptr;
   }
-  const sensor::PointCloud low_resolution_point_cloud_in_tracking =
-      sensor::AdaptiveVoxelFilter(
-          filtered_range_data_in_tracking.returns,
-          options_.low_resolution_adaptive_voxel_filter_options());
+  const sensor::PointCloud& low_resolution_point_cloud_in_tracking =
+      scan_buffers_.low_resolution_point_cloud_in_tracking;
+  sensor::AdaptiveVoxelFilter(
+      filtered_range_data_in_tracking.returns,
+      options_.low_resolution_adaptive_voxel_filter_options(),
+      &scan_buffers_.voxel_filter_scratch,
+      &scan_buffers_.low_resolution_point_cloud_in_tracking);
   if (low_resolution_point_cloud_in_tracking.empty()) {
     LOG(WARNING) << "Dropped empty low resolution point cloud data.";
     return nullptr;
@@ -396,11 +430,13 @@ LocalTrajectoryBuilder3D::InsertIntoSubmap(
   if (motion_filter_.IsSimilar(time, pose_estimate)) {
     return nullptr;
   }
+  sensor::TransformPointCloud(
+      filtered_range_data_in_tracking.returns,
+      transform::Rigid3f::Rotation(gravity_alignment.cast<float>()),
+      &scan_buffers_.returns_in_gravity);
   const Eigen::VectorXf rotational_scan_matcher_histogram_in_gravity =
       scan_matching::RotationalScanMatcher::ComputeHistogram(
-          sensor::TransformPointCloud(
-              filtered_range_data_in_tracking.returns,
-              transform::Rigid3f::Rotation(gravity_alignment.cast<float>())),
+          scan_buffers_.returns_in_gravity,
           options_.rotational_histogram_size());
 
   const Eigen::Quaterniond local_from_gravity_aligned =
@@ -454,6 +490,11 @@ void LocalTrajectoryBuilder3D::RegisterMetrics(
       "mapping_3d_local_trajectory_builder_cpu_real_time_ratio",
       "sensor duration / cpu duration.");
   kLocalSlamCpuRealTimeRatio = cpu_real_time_ratio->Add({});
+  auto* duration = family_factory->NewHistogramFamily(
+      "mapping_3d_local_trajectory_builder_duration",
+      "Wall time in seconds to match and insert accumulated range data",
+      metrics::Histogram::ScaledPowersOf(2, 1e-4, 100));
+  kLocalSlamDurationMetric = duration->Add({});
 
   auto score_boundaries = metrics::Histogram::FixedWidth(0.05, 20);
   auto* scores = family_factory->NewHistogramFamily(
@@ -19,6 +19,7 @@
 
 #include <chrono>
 #include <memory>
+#include <vector>
 
 #include "cartographer/common/time.h"
 #include "cartographer/mapping/3d/submap_3d.h"
@@ -69,8 +70,7 @@ class LocalTrajectoryBuilder3D {
   // `range_data` was acquired, `TimedPointCloudData::ranges` contains the
   // relative time of point with respect to `TimedPointCloudData::time`.
   std::unique_ptr<MatchingResult> AddRangeData(
-      const std::string& sensor_id,
-      const sensor::TimedPointCloudData& range_data);
+      const std::string& sensor_id, sensor::TimedPointCloudData range_data);
   void AddOdometryData(const sensor::OdometryData& odometry_data);
 
   static void RegisterMetrics(metrics::FamilyFactory* family_factory);
@@ -111,6 +111,24 @@ class LocalTrajectoryBuilder3D {
   int num_accumulated_ = 0;
   std::vector<sensor::TimedPointCloudOriginData>
       accumulated_point_cloud_origin_data_;
+
+  // Intermediate results of processing a scan. They are kept to reuse their
+  // storage for the next scan, so that in steady state only the data which is
+  // handed out in the 'MatchingResult' is allocated.
+  struct ScanBuffers {
+    sensor::VoxelFilterScratch voxel_filter_scratch;
+    std::vector<common::Time> hit_times;
+    // Only with 'motion_compensation_interval'.
+    std::vector<common::Time> sample_times;
+    sensor::PointCloud accumulated_returns;
+    sensor::PointCloud accumulated_misses;
+    sensor::RangeData filtered_range_data_in_local;
+    sensor::RangeData filtered_range_data_in_tracking;
+    sensor::PointCloud high_resolution_point_cloud_in_tracking;
+    sensor::PointCloud low_resolution_point_cloud_in_tracking;
+    sensor::PointCloud returns_in_gravity;
+  };
+  ScanBuffers scan_buffers_;
   absl::optional<std::chrono::steady_clock::time_point> last_wall_time_;
 
   absl::optional<double> last_thread_cpu_time_seconds_;
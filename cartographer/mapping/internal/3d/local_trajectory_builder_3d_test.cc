@@ -73,6 +73,7 @@ class LocalTrajectoryBuilderTest : public ::testing::Test {
             angular_search_window = math.rad(1.),
             translation_delta_cost_weight = 1e-1,
             rotation_delta_cost_weight = 1.,
+            branch_and_bound_depth = 1,
           },
 
           ceres_scan_matcher = {
@@ -81,10 +82,13 @@ class LocalTrajectoryBuilderTest : public ::testing::Test {
             translation_weight = 0.1,
             rotation_weight = 0.3,
             only_optimize_yaw = false,
+            num_points_per_residual_block = 0,
             ceres_solver_options = {
               use_nonmonotonic_steps = true,
               max_num_iterations = 20,
               num_threads = 1,
+              linear_solver_type = "",
+              sparse_linear_algebra_library_type = "",
             },
           },
 
@@ -116,7 +120,10 @@ class LocalTrajectoryBuilderTest : public ::testing::Test {
                 use_nonmonotonic_steps = false;
                 max_num_iterations = 10;
                 num_threads = 1;
+                linear_solver_type = "";
+                sparse_linear_algebra_library_type = "";
               },
+              solve_every_n_poses = 1,
             },
           },
           
@@ -134,6 +141,7 @@ class LocalTrajectoryBuilderTest : public ::testing::Test {
           },
 
           use_intensities = false,
+          motion_compensation_interval = 0.,
         }
         )text");
     return mapping::CreateLocalTrajectoryBuilderOptions3D(
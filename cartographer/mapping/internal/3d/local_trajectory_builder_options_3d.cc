@@ -67,6 +67,8 @@ proto::LocalTrajectoryBuilderOptions3D CreateLocalTrajectoryBuilderOptions3D(
   *options.mutable_submaps_options() = CreateSubmapsOptions3D(
       parameter_dictionary->GetDictionary("submaps").get());
   options.set_use_intensities(parameter_dictionary->GetBool("use_intensities"));
+  options.set_motion_compensation_interval(
+      parameter_dictionary->GetDouble("motion_compensation_interval"));
   return options;
 }
 
@@ -30,6 +30,7 @@
 #include "Eigen/Eigenvalues"
 #include "absl/memory/memory.h"
 #include "cartographer/common/math.h"
+#include "cartographer/mapping/internal/constraint_sparsification.h"
 #include "cartographer/mapping/proto/pose_graph/constraint_builder_options.pb.h"
 #include "cartographer/sensor/compressed_point_cloud.h"
 #include "cartographer/sensor/internal/voxel_filter.h"
@@ -46,15 +47,30 @@ static auto* kConstraintsDifferentTrajectoryMetric = metrics::Gauge::Null();
 static auto* kActiveSubmapsMetric = metrics::Gauge::Null();
 static auto* kFrozenSubmapsMetric = metrics::Gauge::Null();
 static auto* kDeletedSubmapsMetric = metrics::Gauge::Null();
+static auto* kOptimizationDurationMetric = metrics::Histogram::Null();
+static auto* kLoadSheddingFactorMetric = metrics::Gauge::Null();
+static auto* kEvictedNodesMetric = metrics::Gauge::Null();
 
 PoseGraph3D::PoseGraph3D(
     const proto::PoseGraphOptions& options,
     std::unique_ptr<optimization::OptimizationProblem3D> optimization_problem,
-    common::ThreadPool* thread_pool)
+    common::ThreadPoolInterface* thread_pool)
     : options_(options),
+      load_shedding_controller_(options_.max_work_queue_delay(),
+                                options_.min_load_shedding_factor()),
       optimization_problem_(std::move(optimization_problem)),
-      constraint_builder_(options_.constraint_builder_options(), thread_pool),
-      thread_pool_(thread_pool) {}
+      constraint_builder_(options_.constraint_builder_options(), thread_pool,
+                          &trajectory_cpu_time_metrics_),
+      thread_pool_(thread_pool) {
+  if (!options_.evicted_node_data_directory().empty()) {
+    node_data_store_ = absl::make_unique<TrajectoryNodeDataStore>(
+        options_.evicted_node_data_directory());
+  }
+  if (!options_.optimized_pose_table_name().empty()) {
+    pose_table_writer_ =
+        PoseTableWriter::Create(options_.optimized_pose_table_name());
+  }
+}
 
 PoseGraph3D::~PoseGraph3D() {
   WaitForAllComputations();
@@ -124,6 +140,11 @@ NodeId PoseGraph3D::AppendNode(
   const NodeId node_id = data_.trajectory_nodes.Append(
       trajectory_id, TrajectoryNode{constant_data, optimized_pose});
   ++data_.num_trajectory_nodes;
+  snapshot_.AddNode(node_id,
+                    TrajectoryNodePose{optimized_pose,
+                                       TrajectoryNodePose::ConstantPoseData{
+                                           constant_data->time,
+                                           constant_data->local_pose}});
   // Test if the 'insertion_submap.back()' is one we never saw before.
   if (data_.submap_data.SizeOfTrajectoryOrZero(trajectory_id) == 0 ||
       std::prev(data_.submap_data.EndOfTrajectory(trajectory_id))
@@ -133,6 +154,8 @@ NodeId PoseGraph3D::AppendNode(
     const SubmapId submap_id =
         data_.submap_data.Append(trajectory_id, InternalSubmapData());
     data_.submap_data.at(submap_id).submap = insertion_submaps.back();
+    snapshot_.AddSubmap(submap_id, PoseGraphSnapshot::SubmapEntry{
+                                       insertion_submaps.back(), {}});
     LOG(INFO) << "Inserted submap " << submap_id << ".";
     kActiveSubmapsMetric->Increment();
   }
@@ -166,6 +189,9 @@ void PoseGraph3D::AddWorkItem(
     work_queue_ = absl::make_unique<WorkQueue>();
     auto task = absl::make_unique<common::Task>();
     task->SetWorkItem([this]() { DrainWorkQueue(); });
+    // Draining the work queue adds the nodes of local SLAM, it must not wait
+    // behind queued constraint searches.
+    task->SetPriority(common::Task::HIGH);
     thread_pool_->Schedule(std::move(task));
   }
   const auto now = std::chrono::steady_clock::now();
@@ -256,7 +282,6 @@ void PoseGraph3D::ComputeConstraint(const NodeId& node_id,
 
   bool maybe_add_local_constraint = false;
   bool maybe_add_global_constraint = false;
-  const TrajectoryNode::Data* constant_data;
   const Submap3D* submap;
   {
     absl::MutexLock locker(&mutex_);
@@ -289,20 +314,75 @@ void PoseGraph3D::ComputeConstraint(const NodeId& node_id,
       // is essentially ignored.
       maybe_add_global_constraint = true;
     }
-    constant_data = data_.trajectory_nodes.at(node_id).constant_data.get();
     submap = static_cast<const Submap3D*>(
         data_.submap_data.at(submap_id).submap.get());
   }
 
+  if ((maybe_add_local_constraint || maybe_add_global_constraint) &&
+      !load_shedding_controller_.Pulse()) {
+    return;
+  }
+
   if (maybe_add_local_constraint) {
-    constraint_builder_.MaybeAddConstraint(submap_id, submap, node_id,
-                                           constant_data, global_node_pose,
-                                           global_submap_pose);
+    if ((global_node_pose.translation() - global_submap_pose.translation())
+            .norm() >
+        options_.constraint_builder_options().max_constraint_distance()) {
+      // The constraint builder would not search, so do not restore the point
+      // clouds of an evicted node.
+      return;
+    }
+    constraint_builder_.MaybeAddConstraint(
+        submap_id, submap, node_id, GetNodeDataForConstraintSearch(node_id),
+        global_node_pose, global_submap_pose);
   } else if (maybe_add_global_constraint) {
     constraint_builder_.MaybeAddGlobalConstraint(
-        submap_id, submap, node_id, constant_data, global_node_pose.rotation(),
-        global_submap_pose.rotation());
+        submap_id, submap, node_id, GetNodeDataForConstraintSearch(node_id),
+        global_node_pose.rotation(), global_submap_pose.rotation());
+  }
+}
+
+const TrajectoryNode::Data* PoseGraph3D::GetNodeDataForConstraintSearch(
+    const NodeId& node_id) {
+  absl::MutexLock locker(&mutex_);
+  TrajectoryNode& node = data_.trajectory_nodes.at(node_id);
+  if (node_data_store_ != nullptr) {
+    node_data_store_->Restore(node_id, &node);
+    AddNodeToEvict(node_id);
   }
+  // Stays valid until the next eviction, which waits for all constraint
+  // searches to finish.
+  return node.constant_data.get();
+}
+
+void PoseGraph3D::AddNodeToEvict(const NodeId& node_id) {
+  if (node_data_store_ == nullptr) return;
+  const int keep_every_n_nodes = options_.keep_node_data_every_n_nodes();
+  if (keep_every_n_nodes > 0 && node_id.node_index % keep_every_n_nodes == 0) {
+    return;
+  }
+  nodes_to_evict_.insert(node_id);
+}
+
+void PoseGraph3D::EvictNodeData() {
+  if (node_data_store_ == nullptr) return;
+  std::set<NodeId> nodes_in_unfinished_submaps;
+  for (const auto& submap_id_data : data_.submap_data) {
+    if (submap_id_data.data.state != SubmapState::kFinished) {
+      nodes_in_unfinished_submaps.insert(submap_id_data.data.node_ids.begin(),
+                                         submap_id_data.data.node_ids.end());
+    }
+  }
+  for (auto it = nodes_to_evict_.begin(); it != nodes_to_evict_.end();) {
+    if (nodes_in_unfinished_submaps.count(*it) != 0) {
+      ++it;
+      continue;
+    }
+    if (data_.trajectory_nodes.Contains(*it)) {
+      node_data_store_->Evict(*it, &data_.trajectory_nodes.at(*it));
+    }
+    it = nodes_to_evict_.erase(it);
+  }
+  kEvictedNodesMetric->Set(node_data_store_->num_evicted_nodes());
 }
 
 WorkItem::Result PoseGraph3D::ComputeConstraintsForNode(
@@ -343,6 +423,7 @@ WorkItem::Result PoseGraph3D::ComputeConstraintsForNode(
            options_.matcher_rotation_weight()},
           Constraint::INTRA_SUBMAP});
     }
+    AddNodeToEvict(node_id);
     // TODO(gaschler): Consider not searching for constraints against
     // trajectories scheduled for deletion.
     // TODO(danielsievers): Add a member variable and avoid having to copy
@@ -382,7 +463,9 @@ WorkItem::Result PoseGraph3D::ComputeConstraintsForNode(
   absl::MutexLock locker(&mutex_);
   ++num_nodes_since_last_loop_closure_;
   if (options_.optimize_every_n_nodes() > 0 &&
-      num_nodes_since_last_loop_closure_ > options_.optimize_every_n_nodes()) {
+      num_nodes_since_last_loop_closure_ >
+          load_shedding_controller_.ScaleOptimizeEveryNNodes(
+              options_.optimize_every_n_nodes())) {
     return WorkItem::Result::kRunOptimization;
   }
   return WorkItem::Result::kDoNotRunOptimization;
@@ -467,6 +550,8 @@ void PoseGraph3D::HandleWorkQueue(
     for (const Constraint& constraint : result) {
       UpdateTrajectoryConnectivity(constraint);
     }
+    const size_t num_nodes = data_.trajectory_nodes.size();
+    const size_t num_submaps = data_.submap_data.size();
     DeleteTrajectoriesIfNeeded();
     TrimmingHandle trimming_handle(this);
     for (auto& trimmer : trimmers_) {
@@ -478,6 +563,12 @@ void PoseGraph3D::HandleWorkQueue(
                          return trimmer->IsFinished();
                        }),
         trimmers_.end());
+    // No constraint search is running, so point clouds can be evicted.
+    EvictNodeData();
+    if (data_.trajectory_nodes.size() != num_nodes ||
+        data_.submap_data.size() != num_submaps) {
+      PublishSnapshot();
+    }
 
     num_nodes_since_last_loop_closure_ = 0;
 
@@ -509,6 +600,7 @@ void PoseGraph3D::DrainWorkQueue() {
   size_t work_queue_size;
   while (process_work_queue) {
     std::function<WorkItem::Result()> work_item;
+    std::chrono::steady_clock::time_point work_item_time;
     {
       absl::MutexLock locker(&work_queue_mutex_);
       if (work_queue_->empty()) {
@@ -516,10 +608,14 @@ void PoseGraph3D::DrainWorkQueue() {
         return;
       }
       work_item = work_queue_->front().task;
+      work_item_time = work_queue_->front().time;
       work_queue_->pop_front();
       work_queue_size = work_queue_->size();
       kWorkQueueSizeMetric->Set(work_queue_size);
     }
+    load_shedding_controller_.SetWorkQueueDelay(common::ToSeconds(
+        std::chrono::steady_clock::now() - work_item_time));
+    kLoadSheddingFactorMetric->Set(load_shedding_controller_.factor());
     process_work_queue = work_item() == WorkItem::Result::kDoNotRunOptimization;
   }
   LOG(INFO) << "Remaining work items in queue: " << work_queue_size;
@@ -675,14 +771,26 @@ bool PoseGraph3D::IsTrajectoryFrozen(const int trajectory_id) const {
 
 void PoseGraph3D::AddSubmapFromProto(
     const transform::Rigid3d& global_submap_pose, const proto::Submap& submap) {
+  AddSubmapFromProto(global_submap_pose,
+                     SubmapId{submap.submap_id().trajectory_id(),
+                              submap.submap_id().submap_index()},
+                     SubmapFromProto(submap));
+}
+
+std::shared_ptr<const Submap> PoseGraph3D::SubmapFromProto(
+    const proto::Submap& submap) {
   if (!submap.has_submap_3d()) {
-    return;
+    return nullptr;
   }
+  return std::make_shared<const Submap3D>(submap.submap_3d());
+}
 
-  const SubmapId submap_id = {submap.submap_id().trajectory_id(),
-                              submap.submap_id().submap_index()};
-  std::shared_ptr<const Submap3D> submap_ptr =
-      std::make_shared<const Submap3D>(submap.submap_3d());
+void PoseGraph3D::AddSubmapFromProto(
+    const transform::Rigid3d& global_submap_pose, const SubmapId& submap_id,
+    std::shared_ptr<const Submap> submap_ptr) {
+  if (submap_ptr == nullptr) {
+    return;
+  }
 
   {
     absl::MutexLock locker(&mutex_);
@@ -693,6 +801,9 @@ void PoseGraph3D::AddSubmapFromProto(
     // Immediately show the submap at the 'global_submap_pose'.
     data_.global_submap_poses_3d.Insert(
         submap_id, optimization::SubmapSpec3D{global_submap_pose});
+    snapshot_.AddSubmap(submap_id, PoseGraphSnapshot::SubmapEntry{
+                                       submap_ptr, global_submap_pose});
+    snapshot_.InvalidateLocalToGlobalTransform(submap_id.trajectory_id);
   }
 
   // TODO(MichaelGrupp): MapBuilder does freezing before deserializing submaps,
@@ -713,17 +824,27 @@ void PoseGraph3D::AddSubmapFromProto(
 
 void PoseGraph3D::AddNodeFromProto(const transform::Rigid3d& global_pose,
                                    const proto::Node& node) {
-  const NodeId node_id = {node.node_id().trajectory_id(),
-                          node.node_id().node_index()};
-  std::shared_ptr<const TrajectoryNode::Data> constant_data =
-      std::make_shared<const TrajectoryNode::Data>(FromProto(node.node_data()));
+  AddNodeFromProto(
+      global_pose,
+      NodeId{node.node_id().trajectory_id(), node.node_id().node_index()},
+      std::make_shared<const TrajectoryNode::Data>(
+          FromProto(node.node_data())));
+}
 
+void PoseGraph3D::AddNodeFromProto(
+    const transform::Rigid3d& global_pose, const NodeId& node_id,
+    std::shared_ptr<const TrajectoryNode::Data> constant_data) {
   {
     absl::MutexLock locker(&mutex_);
     AddTrajectoryIfNeeded(node_id.trajectory_id);
     if (!CanAddWorkItemModifying(node_id.trajectory_id)) return;
     data_.trajectory_nodes.Insert(node_id,
                                   TrajectoryNode{constant_data, global_pose});
+    snapshot_.AddNode(
+        node_id, TrajectoryNodePose{global_pose,
+                                    TrajectoryNodePose::ConstantPoseData{
+                                        constant_data->time,
+                                        constant_data->local_pose}});
   }
 
   AddWorkItem([this, node_id, global_pose]() LOCKS_EXCLUDED(mutex_) {
@@ -734,6 +855,7 @@ void PoseGraph3D::AddNodeFromProto(const transform::Rigid3d& global_pose,
         node_id,
         optimization::NodeSpec3D{constant_data->time, constant_data->local_pose,
                                  global_pose});
+    AddNodeToEvict(node_id);
     return WorkItem::Result::kDoNotRunOptimization;
   });
 }
@@ -828,6 +950,48 @@ void PoseGraph3D::RunFinalOptimization() {
   WaitForAllComputations();
 }
 
+void PoseGraph3D::RunFinalOptimizationAsync(
+    FinalOptimizationCallback callback) {
+  AddFinalOptimizationRound(0, std::move(callback));
+}
+
+void PoseGraph3D::AddFinalOptimizationRound(
+    const int num_iterations, FinalOptimizationCallback callback) {
+  const int max_num_iterations = options_.optimization_problem_options()
+                                     .ceres_solver_options()
+                                     .max_num_iterations();
+  const int round_num_iterations = std::max(
+      1, std::min(max_num_iterations,
+                  options_.max_num_final_iterations() - num_iterations));
+  AddWorkItem([this, round_num_iterations]() LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock locker(&mutex_);
+    optimization_problem_->SetMaxNumIterations(round_num_iterations);
+    return WorkItem::Result::kRunOptimization;
+  });
+  AddWorkItem([this, num_iterations, max_num_iterations,
+               callback]() LOCKS_EXCLUDED(mutex_) {
+    optimization::SolveSummary summary;
+    {
+      absl::MutexLock locker(&mutex_);
+      optimization_problem_->SetMaxNumIterations(max_num_iterations);
+      summary = optimization_problem_->last_solve_summary();
+    }
+    const int total_num_iterations = num_iterations + summary.num_iterations;
+    const bool done =
+        summary.converged || summary.num_iterations == 0 ||
+        total_num_iterations >= options_.max_num_final_iterations();
+    LOG(INFO) << "Final optimization: " << total_num_iterations
+              << " iterations, cost " << summary.final_cost
+              << (done ? ", done." : ".");
+    if (callback(FinalOptimizationProgress{total_num_iterations,
+                                           summary.final_cost, done}) &&
+        !done) {
+      AddFinalOptimizationRound(total_num_iterations, callback);
+    }
+    return WorkItem::Result::kDoNotRunOptimization;
+  });
+}
+
 void PoseGraph3D::LogResidualHistograms() const {
   common::Histogram rotational_residual;
   common::Histogram translational_residual;
@@ -863,8 +1027,36 @@ void PoseGraph3D::RunOptimization() {
   // data_.frozen_trajectories and data_.landmark_nodes when executing the
   // Solve. Solve is time consuming, so not taking the mutex before Solve to
   // avoid blocking foreground processing.
-  optimization_problem_->Solve(data_.constraints, GetTrajectoryStates(),
-                               data_.landmark_nodes);
+  const std::map<int, TrajectoryState> trajectory_states =
+      GetTrajectoryStates();
+  const int intra_submap_constraint_stride =
+      options_.finished_submap_intra_constraint_stride();
+  std::vector<Constraint> sparsified_constraints;
+  if (intra_submap_constraint_stride > 0) {
+    sparsified_constraints =
+        SparsifyConstraints(data_.constraints, trajectory_states,
+                            intra_submap_constraint_stride);
+  }
+  const auto start_time = std::chrono::steady_clock::now();
+  const double start_cpu_time_seconds = common::GetThreadCpuTimeSeconds();
+  optimization_problem_->Solve(intra_submap_constraint_stride > 0
+                                   ? sparsified_constraints
+                                   : data_.constraints,
+                               trajectory_states, data_.landmark_nodes);
+  kOptimizationDurationMetric->Observe(
+      common::ToSeconds(std::chrono::steady_clock::now() - start_time));
+  // Only counts the CPU time of this thread, not that of the solver threads.
+  std::map<int, int> num_nodes_per_trajectory;
+  for (const int trajectory_id :
+       optimization_problem_->node_data().trajectory_ids()) {
+    num_nodes_per_trajectory[trajectory_id] =
+        optimization_problem_->node_data().SizeOfTrajectoryOrZero(
+            trajectory_id);
+  }
+  trajectory_cpu_time_metrics_.AddShares(
+      num_nodes_per_trajectory,
+      TrajectoryCpuTimeMetrics::Activity::kOptimization,
+      common::GetThreadCpuTimeSeconds() - start_cpu_time_seconds);
   absl::MutexLock locker(&mutex_);
 
   const auto& submap_data = optimization_problem_->submap_data();
@@ -898,6 +1090,7 @@ void PoseGraph3D::RunOptimization() {
     data_.landmark_nodes[landmark.first].global_landmark_pose = landmark.second;
   }
   data_.global_submap_poses_3d = submap_data;
+  PublishSnapshot();
 
   // Log the histograms for the pose residuals.
   if (options_.log_residual_histograms()) {
@@ -935,25 +1128,25 @@ bool PoseGraph3D::CanAddWorkItemModifying(int trajectory_id) {
 
 MapById<NodeId, TrajectoryNode> PoseGraph3D::GetTrajectoryNodes() const {
   absl::MutexLock locker(&mutex_);
-  return data_.trajectory_nodes;
+  if (node_data_store_ == nullptr) {
+    return data_.trajectory_nodes;
+  }
+  // Evicted nodes are returned with their point clouds, e.g. for
+  // serialization, but stay evicted in the pose graph.
+  MapById<NodeId, TrajectoryNode> trajectory_nodes;
+  for (const auto& node_id_data : data_.trajectory_nodes) {
+    trajectory_nodes.Insert(
+        node_id_data.id,
+        TrajectoryNode{node_data_store_->GetFullData(node_id_data.id,
+                                                     node_id_data.data),
+                       node_id_data.data.global_pose});
+  }
+  return trajectory_nodes;
 }
 
 MapById<NodeId, TrajectoryNodePose> PoseGraph3D::GetTrajectoryNodePoses()
     const {
-  MapById<NodeId, TrajectoryNodePose> node_poses;
-  absl::MutexLock locker(&mutex_);
-  for (const auto& node_id_data : data_.trajectory_nodes) {
-    absl::optional<TrajectoryNodePose::ConstantPoseData> constant_pose_data;
-    if (node_id_data.data.constant_data != nullptr) {
-      constant_pose_data = TrajectoryNodePose::ConstantPoseData{
-          node_id_data.data.constant_data->time,
-          node_id_data.data.constant_data->local_pose};
-    }
-    node_poses.Insert(
-        node_id_data.id,
-        TrajectoryNodePose{node_id_data.data.global_pose, constant_pose_data});
-  }
-  return node_poses;
+  return snapshot_.GetTrajectoryNodePoses();
 }
 
 std::map<int, PoseGraphInterface::TrajectoryState>
@@ -1023,6 +1216,11 @@ std::vector<PoseGraphInterface::Constraint> PoseGraph3D::constraints() const {
   return data_.constraints;
 }
 
+PoseGraphInterface::ConstraintsSnapshot PoseGraph3D::GetConstraintsSnapshot()
+    const {
+  return snapshot_.GetConstraints();
+}
+
 void PoseGraph3D::SetInitialTrajectoryPose(const int from_trajectory_id,
                                            const int to_trajectory_id,
                                            const transform::Rigid3d& pose,
@@ -1055,6 +1253,11 @@ transform::Rigid3d PoseGraph3D::GetInterpolatedGlobalTrajectoryPose(
 
 transform::Rigid3d PoseGraph3D::GetLocalToGlobalTransform(
     const int trajectory_id) const {
+  const absl::optional<transform::Rigid3d> local_to_global =
+      snapshot_.GetLocalToGlobalTransform(trajectory_id);
+  if (local_to_global.has_value()) {
+    return local_to_global.value();
+  }
   absl::MutexLock locker(&mutex_);
   return ComputeLocalToGlobalTransform(data_.global_submap_poses_3d,
                                        trajectory_id);
@@ -1079,16 +1282,12 @@ PoseGraph3D::GetAllSubmapData() const {
 
 MapById<SubmapId, PoseGraphInterface::SubmapPose>
 PoseGraph3D::GetAllSubmapPoses() const {
-  absl::MutexLock locker(&mutex_);
-  MapById<SubmapId, SubmapPose> submap_poses;
-  for (const auto& submap_id_data : data_.submap_data) {
-    auto submap_data = GetSubmapDataUnderLock(submap_id_data.id);
-    submap_poses.Insert(
-        submap_id_data.id,
-        PoseGraphInterface::SubmapPose{submap_data.submap->num_range_data(),
-                                       submap_data.pose});
-  }
-  return submap_poses;
+  return snapshot_.GetAllSubmapPoses(
+      [this](const int trajectory_id) LOCKS_EXCLUDED(mutex_) {
+        absl::MutexLock locker(&mutex_);
+        return ComputeLocalToGlobalTransform(data_.global_submap_poses_3d,
+                                             trajectory_id);
+      });
 }
 
 transform::Rigid3d PoseGraph3D::ComputeLocalToGlobalTransform(
@@ -1131,6 +1330,52 @@ PoseGraphInterface::SubmapData PoseGraph3D::GetSubmapDataUnderLock(
                       submap->local_pose()};
 }
 
+void PoseGraph3D::PublishSnapshot() {
+  MapById<NodeId, TrajectoryNodePose> trajectory_node_poses;
+  for (const auto& node_id_data : data_.trajectory_nodes) {
+    absl::optional<TrajectoryNodePose::ConstantPoseData> constant_pose_data;
+    if (node_id_data.data.constant_data != nullptr) {
+      constant_pose_data = TrajectoryNodePose::ConstantPoseData{
+          node_id_data.data.constant_data->time,
+          node_id_data.data.constant_data->local_pose};
+    }
+    trajectory_node_poses.Insert(
+        node_id_data.id,
+        TrajectoryNodePose{node_id_data.data.global_pose, constant_pose_data});
+  }
+  MapById<SubmapId, PoseGraphSnapshot::SubmapEntry> submaps;
+  for (const auto& submap_id_data : data_.submap_data) {
+    absl::optional<transform::Rigid3d> global_pose;
+    if (data_.global_submap_poses_3d.Contains(submap_id_data.id)) {
+      global_pose =
+          data_.global_submap_poses_3d.at(submap_id_data.id).global_pose;
+    }
+    submaps.Insert(submap_id_data.id,
+                   PoseGraphSnapshot::SubmapEntry{submap_id_data.data.submap,
+                                                   global_pose});
+  }
+  // Only trajectories with optimized submaps are included, the transform of
+  // other trajectories can change with the initial trajectory poses.
+  std::map<int, transform::Rigid3d> local_to_global_transforms;
+  const auto& global_submap_poses = data_.global_submap_poses_3d;
+  for (const int trajectory_id : global_submap_poses.trajectory_ids()) {
+    if (global_submap_poses.SizeOfTrajectoryOrZero(trajectory_id) > 0) {
+      local_to_global_transforms.emplace(
+          trajectory_id,
+          ComputeLocalToGlobalTransform(global_submap_poses, trajectory_id));
+    }
+  }
+  if (pose_table_writer_ != nullptr) {
+    MapById<SubmapId, transform::Rigid3d> submap_poses;
+    for (const auto& submap_id_pose : global_submap_poses) {
+      submap_poses.Insert(submap_id_pose.id, submap_id_pose.data.global_pose);
+    }
+    pose_table_writer_->Write(trajectory_node_poses, submap_poses);
+  }
+  snapshot_.Publish(std::move(trajectory_node_poses), std::move(submaps),
+                    std::move(local_to_global_transforms), data_.constraints);
+}
+
 PoseGraph3D::TrimmingHandle::TrimmingHandle(PoseGraph3D* const parent)
     : parent_(parent) {}
 
@@ -1275,6 +1520,10 @@ void PoseGraph3D::TrimmingHandle::TrimSubmap(const SubmapId& submap_id) {
   for (const NodeId& node_id : nodes_to_remove) {
     parent_->data_.trajectory_nodes.Trim(node_id);
     parent_->optimization_problem_->TrimTrajectoryNode(node_id);
+    if (parent_->node_data_store_ != nullptr) {
+      parent_->node_data_store_->Erase(node_id);
+      parent_->nodes_to_evict_.erase(node_id);
+    }
   }
 }
 
@@ -1314,6 +1563,19 @@ void PoseGraph3D::RegisterMetrics(metrics::FamilyFactory* family_factory) {
   kActiveSubmapsMetric = submaps->Add({{"state", "active"}});
   kFrozenSubmapsMetric = submaps->Add({{"state", "frozen"}});
   kDeletedSubmapsMetric = submaps->Add({{"state", "deleted"}});
+  auto* optimization_duration = family_factory->NewHistogramFamily(
+      "mapping_3d_pose_graph_optimization_duration",
+      "Wall time in seconds to solve the optimization problem",
+      metrics::Histogram::ScaledPowersOf(2, 1e-3, 1000));
+  kOptimizationDurationMetric = optimization_duration->Add({});
+  auto* load_shedding_factor = family_factory->NewGaugeFamily(
+      "mapping_3d_pose_graph_load_shedding_factor",
+      "Factor by which loop closure sampling ratios are currently scaled");
+  kLoadSheddingFactorMetric = load_shedding_factor->Add({});
+  auto* evicted_nodes = family_factory->NewGaugeFamily(
+      "mapping_3d_pose_graph_evicted_nodes",
+      "Number of nodes whose point clouds are not held in memory");
+  kEvictedNodesMetric = evicted_nodes->Add({});
 }
 
 }  // namespace mapping
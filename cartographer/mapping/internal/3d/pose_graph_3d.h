@@ -34,11 +34,16 @@
 #include "cartographer/common/time.h"
 #include "cartographer/mapping/3d/submap_3d.h"
 #include "cartographer/mapping/internal/constraints/constraint_builder_3d.h"
+#include "cartographer/mapping/internal/load_shedding_controller.h"
 #include "cartographer/mapping/internal/optimization/optimization_problem_3d.h"
 #include "cartographer/mapping/internal/trajectory_connectivity_state.h"
+#include "cartographer/mapping/internal/trajectory_cpu_time_metrics.h"
+#include "cartographer/mapping/internal/trajectory_node_data_store.h"
 #include "cartographer/mapping/internal/pose_graph_data.h"
+#include "cartographer/mapping/internal/pose_graph_snapshot.h"
 #include "cartographer/mapping/internal/work_queue.h"
 #include "cartographer/mapping/pose_graph.h"
+#include "cartographer/mapping/pose_table.h"
 #include "cartographer/mapping/pose_graph_trimmer.h"
 #include "cartographer/metrics/family_factory.h"
 #include "cartographer/sensor/fixed_frame_pose_data.h"
@@ -64,7 +69,7 @@ class PoseGraph3D : public PoseGraph {
   PoseGraph3D(
       const proto::PoseGraphOptions& options,
       std::unique_ptr<optimization::OptimizationProblem3D> optimization_problem,
-      common::ThreadPool* thread_pool);
+      common::ThreadPoolInterface* thread_pool);
   ~PoseGraph3D() override;
 
   PoseGraph3D(const PoseGraph3D&) = delete;
@@ -105,6 +110,14 @@ class PoseGraph3D : public PoseGraph {
                           const proto::Submap& submap) override;
   void AddNodeFromProto(const transform::Rigid3d& global_pose,
                         const proto::Node& node) override;
+  std::shared_ptr<const Submap> SubmapFromProto(
+      const proto::Submap& submap) override;
+  void AddSubmapFromProto(const transform::Rigid3d& global_submap_pose,
+                          const SubmapId& submap_id,
+                          std::shared_ptr<const Submap> submap) override;
+  void AddNodeFromProto(
+      const transform::Rigid3d& global_pose, const NodeId& node_id,
+      std::shared_ptr<const TrajectoryNode::Data> constant_data) override;
   void SetTrajectoryDataFromProto(const proto::TrajectoryData& data) override;
   void AddNodeToSubmap(const NodeId& node_id,
                        const SubmapId& submap_id) override;
@@ -112,6 +125,7 @@ class PoseGraph3D : public PoseGraph {
       const std::vector<Constraint>& constraints) override;
   void AddTrimmer(std::unique_ptr<PoseGraphTrimmer> trimmer) override;
   void RunFinalOptimization() override;
+  void RunFinalOptimizationAsync(FinalOptimizationCallback callback) override;
   std::vector<std::vector<int>> GetConnectedTrajectories() const override
       LOCKS_EXCLUDED(mutex_);
   PoseGraph::SubmapData GetSubmapData(const SubmapId& submap_id) const
@@ -145,6 +159,7 @@ class PoseGraph3D : public PoseGraph {
   std::map<int, TrajectoryData> GetTrajectoryData() const override;
 
   std::vector<Constraint> constraints() const override LOCKS_EXCLUDED(mutex_);
+  ConstraintsSnapshot GetConstraintsSnapshot() const override;
   void SetInitialTrajectoryPose(int from_trajectory_id, int to_trajectory_id,
                                 const transform::Rigid3d& pose,
                                 const common::Time time) override
@@ -169,7 +184,7 @@ class PoseGraph3D : public PoseGraph {
 
   // Handles a new work item.
   void AddWorkItem(const std::function<WorkItem::Result()>& work_item)
-      LOCKS_EXCLUDED(mutex_) LOCKS_EXCLUDED(work_queue_mutex_);
+      LOCKS_EXCLUDED(mutex_, work_queue_mutex_);
 
   // Adds connectivity and sampler for a trajectory if it does not exist.
   void AddTrajectoryIfNeeded(int trajectory_id)
@@ -205,13 +220,19 @@ class PoseGraph3D : public PoseGraph {
 
   // Runs the optimization, executes the trimmers and processes the work queue.
   void HandleWorkQueue(const constraints::ConstraintBuilder3D::Result& result)
-      LOCKS_EXCLUDED(mutex_) LOCKS_EXCLUDED(work_queue_mutex_);
+      LOCKS_EXCLUDED(mutex_, work_queue_mutex_);
 
   // Process pending tasks in the work queue on the calling thread, until the
   // queue is either empty or an optimization is required.
   void DrainWorkQueue() LOCKS_EXCLUDED(mutex_)
       LOCKS_EXCLUDED(work_queue_mutex_);
 
+  // Adds the work items for a round of 'RunFinalOptimizationAsync' after
+  // 'num_iterations' solver iterations.
+  void AddFinalOptimizationRound(int num_iterations,
+                                 FinalOptimizationCallback callback)
+      LOCKS_EXCLUDED(mutex_, work_queue_mutex_);
+
   // Runs the optimization. Callers have to make sure, that there is only one
   // optimization being run at a time.
   void RunOptimization() LOCKS_EXCLUDED(mutex_);
@@ -228,6 +249,9 @@ class PoseGraph3D : public PoseGraph {
   PoseGraph::SubmapData GetSubmapDataUnderLock(const SubmapId& submap_id) const
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Publishes the current poses to 'snapshot_'.
+  void PublishSnapshot() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   common::Time GetLatestNodeTime(const NodeId& node_id,
                                  const SubmapId& submap_id) const
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
@@ -240,6 +264,18 @@ class PoseGraph3D : public PoseGraph {
   void UpdateTrajectoryConnectivity(const Constraint& constraint)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Marks the point clouds of 'node_id' for eviction unless it is a keyframe.
+  void AddNodeToEvict(const NodeId& node_id) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Evicts the point clouds of marked nodes which are no longer inserted into
+  // unfinished submaps. Must only be called while no constraint search runs.
+  void EvictNodeData() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Returns the data of 'node_id' for a constraint search, restoring its point
+  // clouds until the next eviction if needed.
+  const TrajectoryNode::Data* GetNodeDataForConstraintSearch(
+      const NodeId& node_id) LOCKS_EXCLUDED(mutex_);
+
   const proto::PoseGraphOptions options_;
   GlobalSlamOptimizationCallback global_slam_optimization_callback_;
   mutable absl::Mutex mutex_;
@@ -253,21 +289,40 @@ class PoseGraph3D : public PoseGraph {
   absl::flat_hash_map<int, std::unique_ptr<common::FixedRatioSampler>>
       global_localization_samplers_ GUARDED_BY(mutex_);
 
+  // Thins out loop closure searches and optimizations while the work queue is
+  // delayed.
+  LoadSheddingController load_shedding_controller_;
+
   // Number of nodes added since last loop closure.
   int num_nodes_since_last_loop_closure_ GUARDED_BY(mutex_) = 0;
 
   // Current optimization problem.
   std::unique_ptr<optimization::OptimizationProblem3D> optimization_problem_;
+  // Declared before 'constraint_builder_', which adds to it.
+  TrajectoryCpuTimeMetrics trajectory_cpu_time_metrics_;
   constraints::ConstraintBuilder3D constraint_builder_;
 
   // Thread pool used for handling the work queue.
-  common::ThreadPool* const thread_pool_;
+  common::ThreadPoolInterface* const thread_pool_;
 
   // List of all trimmers to consult when optimizations finish.
   std::vector<std::unique_ptr<PoseGraphTrimmer>> trimmers_ GUARDED_BY(mutex_);
 
   PoseGraphData data_ GUARDED_BY(mutex_);
 
+  // Holds the point clouds of evicted nodes. Null if nodes keep their point
+  // clouds in memory.
+  std::unique_ptr<TrajectoryNodeDataStore> node_data_store_ GUARDED_BY(mutex_);
+
+  // Publishes the optimized poses to other processes. Null if disabled.
+  std::unique_ptr<PoseTableWriter> pose_table_writer_ GUARDED_BY(mutex_);
+  // Nodes holding point clouds which are evicted by EvictNodeData().
+  std::set<NodeId> nodes_to_evict_ GUARDED_BY(mutex_);
+
+  // Poses which are read without taking 'mutex_'. Updated while holding
+  // 'mutex_' whenever poses change.
+  PoseGraphSnapshot snapshot_;
+
   // Allows querying and manipulating the pose graph by the 'trimmers_'. The
   // 'mutex_' of the pose graph is held while this class is used.
   class TrimmingHandle : public Trimmable {
@@ -16,6 +16,7 @@
 
 #include "cartographer/mapping/internal/3d/scan_matching/ceres_scan_matcher_3d.h"
 
+#include <algorithm>
 #include <string>
 #include <utility>
 #include <vector>
@@ -73,6 +74,8 @@ proto::CeresScanMatcherOptions3D CreateCeresScanMatcherOptions3D(
       parameter_dictionary->GetDouble("rotation_weight"));
   options.set_only_optimize_yaw(
       parameter_dictionary->GetBool("only_optimize_yaw"));
+  options.set_num_points_per_residual_block(
+      parameter_dictionary->GetNonNegativeInt("num_points_per_residual_block"));
   *options.mutable_ceres_solver_options() =
       common::CreateCeresSolverOptionsProto(
           parameter_dictionary->GetDictionary("ceres_solver_options").get());
@@ -113,13 +116,26 @@ void CeresScanMatcher3D::Match(
         *point_clouds_and_hybrid_grids[i].point_cloud;
     const HybridGrid& hybrid_grid =
         *point_clouds_and_hybrid_grids[i].hybrid_grid;
-    problem.AddResidualBlock(
-        OccupiedSpaceCostFunction3D::CreateAutoDiffCostFunction(
-            options_.occupied_space_weight(i) /
-                std::sqrt(static_cast<double>(point_cloud.size())),
-            point_cloud, hybrid_grid),
-        nullptr /* loss function */, ceres_pose.translation(),
-        ceres_pose.rotation());
+    const double scaling_factor =
+        options_.occupied_space_weight(i) /
+        std::sqrt(static_cast<double>(point_cloud.size()));
+    // Splitting the points into several residual blocks does not change the
+    // cost, but lets Ceres evaluate them in parallel.
+    const size_t num_points_per_residual_block =
+        options_.num_points_per_residual_block() > 0
+            ? options_.num_points_per_residual_block()
+            : point_cloud.size();
+    for (size_t begin_index = 0; begin_index < point_cloud.size();
+         begin_index += num_points_per_residual_block) {
+      problem.AddResidualBlock(
+          new AnalyticalOccupiedSpaceCostFunction3D(
+              scaling_factor, point_cloud, begin_index,
+              std::min(begin_index + num_points_per_residual_block,
+                       point_cloud.size()),
+              hybrid_grid),
+          nullptr /* loss function */, ceres_pose.translation(),
+          ceres_pose.rotation());
+    }
     if (point_clouds_and_hybrid_grids[i].intensity_hybrid_grid) {
       CHECK_GT(options_.intensity_cost_function_options(i).huber_scale(), 0.);
       CHECK_GT(options_.intensity_cost_function_options(i).weight(), 0.);
@@ -67,10 +67,13 @@ class CeresScanMatcher3DTest : public ::testing::Test {
           translation_weight = 0.01,
           rotation_weight = 0.1,
           only_optimize_yaw = false,
+          num_points_per_residual_block = 0,
           ceres_solver_options = {
             use_nonmonotonic_steps = true,
             max_num_iterations = 10,
             num_threads = 1,
+            linear_solver_type = "",
+            sparse_linear_algebra_library_type = "",
           },
         })text");
     options_ = CreateCeresScanMatcherOptions3D(parameter_dictionary.get());
@@ -122,6 +125,14 @@ TEST_F(CeresScanMatcher3DTest, AlongXYZ) {
       transform::Rigid3d::Translation(Eigen::Vector3d(-0.9, -0.2, 0.2)));
 }
 
+TEST_F(CeresScanMatcher3DTest, SplitResidualBlocks) {
+  options_.set_num_points_per_residual_block(3);
+  options_.mutable_ceres_solver_options()->set_num_threads(2);
+  ceres_scan_matcher_.reset(new CeresScanMatcher3D(options_));
+  TestFromInitialPose(
+      transform::Rigid3d::Translation(Eigen::Vector3d(-0.9, -0.2, 0.2)));
+}
+
 TEST_F(CeresScanMatcher3DTest, FullPoseCorrection) {
   // We try to find the rotation around z...
   const auto additional_transform = transform::Rigid3d::Rotation(
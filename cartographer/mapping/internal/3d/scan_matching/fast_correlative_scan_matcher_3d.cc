@@ -20,6 +20,7 @@
 #include <cmath>
 #include <functional>
 #include <limits>
+#include <utility>
 
 #include "Eigen/Geometry"
 #include "absl/memory/memory.h"
@@ -32,6 +33,14 @@
 namespace cartographer {
 namespace mapping {
 namespace scan_matching {
+namespace {
+
+// Maximum number of leaf candidates checked against the low resolution grid at
+// once. This matches the children of a candidate and the lanes of the batched
+// scoring in LowResolutionMatcher.
+constexpr size_t kLowResolutionBatchSize = 8;
+
+}  // namespace
 
 proto::FastCorrelativeScanMatcherOptions3D
 CreateFastCorrelativeScanMatcherOptions3D(
@@ -56,11 +65,18 @@ CreateFastCorrelativeScanMatcherOptions3D(
 
 PrecomputationGridStack3D::PrecomputationGridStack3D(
     const HybridGrid& hybrid_grid,
-    const proto::FastCorrelativeScanMatcherOptions3D& options) {
+    const proto::FastCorrelativeScanMatcherOptions3D& options)
+    : hybrid_grid_(hybrid_grid),
+      value_table_(GetHybridGridToPrecomputationValueTable()) {
   CHECK_GE(options.branch_and_bound_depth(), 1);
   CHECK_GE(options.full_resolution_depth(), 1);
-  precomputation_grids_.reserve(options.branch_and_bound_depth());
-  precomputation_grids_.push_back(ConvertToPrecomputationGrid(hybrid_grid));
+  if (options.branch_and_bound_depth() == 1) {
+    return;
+  }
+  precomputation_grids_.reserve(options.branch_and_bound_depth() - 1);
+  // The converted grid of depth 0 is only needed to compute depth 1.
+  const PrecomputationGrid3D original_grid =
+      ConvertToPrecomputationGrid(hybrid_grid);
   Eigen::Array3i last_width = Eigen::Array3i::Ones();
   for (int depth = 1; depth != options.branch_and_bound_depth(); ++depth) {
     const bool half_resolution = depth >= options.full_resolution_depth();
@@ -70,16 +86,21 @@ PrecomputationGridStack3D::PrecomputationGridStack3D(
     const Eigen::Array3i shift = (next_width - last_width +
                                   (full_voxels_per_high_resolution_voxel - 1)) /
                                  full_voxels_per_high_resolution_voxel;
-    precomputation_grids_.push_back(
-        PrecomputeGrid(precomputation_grids_.back(), half_resolution, shift));
+    precomputation_grids_.push_back(PrecomputeGrid(
+        depth == 1 ? original_grid : precomputation_grids_.back(),
+        half_resolution, shift));
     last_width = next_width;
   }
 }
 
 struct DiscreteScan3D {
   transform::Rigid3f pose;
-  // Contains a vector of discretized scans for each 'depth'.
-  std::vector<std::vector<Eigen::Array3i>> cell_indices_per_depth;
+  // Contains a vector of discretized scans for each reduction of the
+  // resolution, starting with the full resolution. All depths up to the
+  // 'full_resolution_depth' share the first one.
+  std::vector<std::vector<Eigen::Array3i>> cell_indices_per_reduction;
+  // The low resolution point cloud transformed by 'pose'.
+  std::vector<Eigen::Vector3f> low_resolution_points;
   float rotational_score;
 };
 
@@ -119,22 +140,27 @@ FastCorrelativeScanMatcher3D::FastCorrelativeScanMatcher3D(
       width_in_voxels_(hybrid_grid.grid_size()),
       precomputation_grid_stack_(
           absl::make_unique<PrecomputationGridStack3D>(hybrid_grid, options)),
-      low_resolution_hybrid_grid_(low_resolution_hybrid_grid),
+      low_resolution_matcher_(
+          absl::make_unique<LowResolutionMatcher>(*low_resolution_hybrid_grid)),
       rotational_scan_matcher_(rotational_scan_matcher_histogram) {}
 
 FastCorrelativeScanMatcher3D::~FastCorrelativeScanMatcher3D() {}
 
+size_t FastCorrelativeScanMatcher3D::MemoryUsageInBytes() const {
+  return sizeof(*this) + precomputation_grid_stack_->MemoryUsageInBytes() +
+         low_resolution_matcher_->MemoryUsageInBytes();
+}
+
 std::unique_ptr<FastCorrelativeScanMatcher3D::Result>
 FastCorrelativeScanMatcher3D::Match(
     const transform::Rigid3d& global_node_pose,
     const transform::Rigid3d& global_submap_pose,
     const TrajectoryNode::Data& constant_data, const float min_score) const {
-  const auto low_resolution_matcher = scan_matching::CreateLowResolutionMatcher(
-      low_resolution_hybrid_grid_, &constant_data.low_resolution_point_cloud);
   const SearchParameters search_parameters{
       common::RoundToInt(options_.linear_xy_search_window() / resolution_),
       common::RoundToInt(options_.linear_z_search_window() / resolution_),
-      options_.angular_search_window(), &low_resolution_matcher};
+      options_.angular_search_window(),
+      &constant_data.low_resolution_point_cloud};
   return MatchWithSearchParameters(
       search_parameters, global_node_pose.cast<float>(),
       global_submap_pose.cast<float>(),
@@ -156,10 +182,9 @@ FastCorrelativeScanMatcher3D::MatchFullSubmap(
   const int linear_window_size =
       (width_in_voxels_ + 1) / 2 +
       common::RoundToInt(max_point_distance / resolution_ + 0.5f);
-  const auto low_resolution_matcher = scan_matching::CreateLowResolutionMatcher(
-      low_resolution_hybrid_grid_, &constant_data.low_resolution_point_cloud);
   const SearchParameters search_parameters{
-      linear_window_size, linear_window_size, M_PI, &low_resolution_matcher};
+      linear_window_size, linear_window_size, M_PI,
+      &constant_data.low_resolution_point_cloud};
   return MatchWithSearchParameters(
       search_parameters,
       transform::Rigid3f::Rotation(global_node_rotation.cast<float>()),
@@ -201,46 +226,53 @@ DiscreteScan3D FastCorrelativeScanMatcher3D::DiscretizeScan(
     const FastCorrelativeScanMatcher3D::SearchParameters& search_parameters,
     const sensor::PointCloud& point_cloud, const transform::Rigid3f& pose,
     const float rotational_score) const {
-  std::vector<std::vector<Eigen::Array3i>> cell_indices_per_depth;
-  const PrecomputationGrid3D& original_grid =
-      precomputation_grid_stack_->Get(0);
-  std::vector<Eigen::Array3i> full_resolution_cell_indices;
-  for (const sensor::RangefinderPoint& point :
-       sensor::TransformPointCloud(point_cloud, pose)) {
-    full_resolution_cell_indices.push_back(
-        original_grid.GetCellIndex(point.position));
-  }
   const int full_resolution_depth = std::min(options_.full_resolution_depth(),
                                              options_.branch_and_bound_depth());
   CHECK_GE(full_resolution_depth, 1);
-  for (int i = 0; i != full_resolution_depth; ++i) {
-    cell_indices_per_depth.push_back(full_resolution_cell_indices);
-  }
   const int low_resolution_depth =
       options_.branch_and_bound_depth() - full_resolution_depth;
   CHECK_GE(low_resolution_depth, 0);
+  std::vector<std::vector<Eigen::Array3i>> cell_indices_per_reduction(
+      1 + low_resolution_depth);
+  std::vector<Eigen::Array3i>& full_resolution_cell_indices =
+      cell_indices_per_reduction[0];
+  full_resolution_cell_indices.reserve(point_cloud.size());
+  for (const sensor::RangefinderPoint& point : point_cloud) {
+    full_resolution_cell_indices.push_back(
+        precomputation_grid_stack_->GetCellIndex(pose * point.position));
+  }
   const Eigen::Array3i search_window_start(
       -search_parameters.linear_xy_window_size,
       -search_parameters.linear_xy_window_size,
       -search_parameters.linear_z_window_size);
-  for (int i = 0; i != low_resolution_depth; ++i) {
-    const int reduction_exponent = i + 1;
+  for (int reduction_exponent = 1; reduction_exponent <= low_resolution_depth;
+       ++reduction_exponent) {
     const Eigen::Array3i low_resolution_search_window_start(
         search_window_start[0] >> reduction_exponent,
         search_window_start[1] >> reduction_exponent,
         search_window_start[2] >> reduction_exponent);
-    cell_indices_per_depth.emplace_back();
+    std::vector<Eigen::Array3i>& low_resolution_cell_indices =
+        cell_indices_per_reduction[reduction_exponent];
+    low_resolution_cell_indices.reserve(full_resolution_cell_indices.size());
     for (const Eigen::Array3i& cell_index : full_resolution_cell_indices) {
       const Eigen::Array3i cell_at_start = cell_index + search_window_start;
       const Eigen::Array3i low_resolution_cell_at_start(
           cell_at_start[0] >> reduction_exponent,
           cell_at_start[1] >> reduction_exponent,
           cell_at_start[2] >> reduction_exponent);
-      cell_indices_per_depth.back().push_back(
-          low_resolution_cell_at_start - low_resolution_search_window_start);
+      low_resolution_cell_indices.push_back(low_resolution_cell_at_start -
+                                            low_resolution_search_window_start);
     }
   }
-  return DiscreteScan3D{pose, cell_indices_per_depth, rotational_score};
+  std::vector<Eigen::Vector3f> low_resolution_points;
+  low_resolution_points.reserve(
+      search_parameters.low_resolution_point_cloud->size());
+  for (const sensor::RangefinderPoint& point :
+       *search_parameters.low_resolution_point_cloud) {
+    low_resolution_points.push_back(pose * point.position);
+  }
+  return DiscreteScan3D{pose, std::move(cell_indices_per_reduction),
+                        std::move(low_resolution_points), rotational_score};
 }
 
 std::vector<DiscreteScan3D> FastCorrelativeScanMatcher3D::GenerateDiscreteScans(
@@ -275,6 +307,7 @@ std::vector<DiscreteScan3D> FastCorrelativeScanMatcher3D::GenerateDiscreteScans(
       transform::GetYaw(node_to_submap.rotation() *
                         gravity_alignment.inverse().cast<float>()),
       angles);
+  result.reserve(angles.size());
   for (size_t i = 0; i != angles.size(); ++i) {
     if (scores[i] < options_.min_rotational_score()) {
       continue;
@@ -340,15 +373,16 @@ void FastCorrelativeScanMatcher3D::ScoreCandidates(
     const Eigen::Array3i offset(candidate.offset[0] >> reduction_exponent,
                                 candidate.offset[1] >> reduction_exponent,
                                 candidate.offset[2] >> reduction_exponent);
-    CHECK_LT(depth, discrete_scan.cell_indices_per_depth.size());
-    for (const Eigen::Array3i& cell_index :
-         discrete_scan.cell_indices_per_depth[depth]) {
+    CHECK_LT(reduction_exponent,
+             discrete_scan.cell_indices_per_reduction.size());
+    const std::vector<Eigen::Array3i>& cell_indices =
+        discrete_scan.cell_indices_per_reduction[reduction_exponent];
+    for (const Eigen::Array3i& cell_index : cell_indices) {
       const Eigen::Array3i proposed_cell_index = cell_index + offset;
-      sum += precomputation_grid_stack_->Get(depth).value(proposed_cell_index);
+      sum += precomputation_grid_stack_->GetValue(depth, proposed_cell_index);
     }
     candidate.score = PrecomputationGrid3D::ToProbability(
-        sum /
-        static_cast<float>(discrete_scan.cell_indices_per_depth[depth].size()));
+        sum / static_cast<float>(cell_indices.size()));
   }
   std::sort(candidates->begin(), candidates->end(),
             std::greater<Candidate3D>());
@@ -380,24 +414,37 @@ Candidate3D FastCorrelativeScanMatcher3D::BranchAndBound(
     const std::vector<Candidate3D>& candidates, const int candidate_depth,
     float min_score) const {
   if (candidate_depth == 0) {
-    for (const Candidate3D& candidate : candidates) {
-      if (candidate.score <= min_score) {
-        // Return if the candidate is bad because the following candidate will
-        // not have better score.
-        return Candidate3D::Unsuccessful();
+    // Candidates are sorted, so only those before the first bad one can be
+    // returned. These are checked against the low resolution grid in batches
+    // of consecutive candidates sharing a discrete scan, which are all children
+    // of the same candidate unless the search has only a single depth.
+    auto begin = candidates.begin();
+    while (begin != candidates.end() && begin->score > min_score) {
+      auto end = begin;
+      std::vector<Eigen::Vector3f> translations;
+      while (end != candidates.end() && end->score > min_score &&
+             end->scan_index == begin->scan_index &&
+             translations.size() != kLowResolutionBatchSize) {
+        translations.push_back(resolution_ *
+                               end->offset.matrix().cast<float>());
+        ++end;
       }
-      const float low_resolution_score =
-          (*search_parameters.low_resolution_matcher)(
-              GetPoseFromCandidate(discrete_scans, candidate));
-      if (low_resolution_score >= options_.min_low_resolution_score()) {
-        // We found the best candidate that passes the matching function.
-        Candidate3D best_candidate = candidate;
-        best_candidate.low_resolution_score = low_resolution_score;
-        return best_candidate;
+      const std::vector<float> low_resolution_scores =
+          low_resolution_matcher_->ScoreTranslations(
+              discrete_scans[begin->scan_index].low_resolution_points,
+              translations);
+      for (size_t i = 0; i != low_resolution_scores.size(); ++i) {
+        if (low_resolution_scores[i] >= options_.min_low_resolution_score()) {
+          // We found the best candidate that passes the matching function.
+          Candidate3D best_candidate = begin[i];
+          best_candidate.low_resolution_score = low_resolution_scores[i];
+          return best_candidate;
+        }
       }
+      begin = end;
     }
 
-    // All candidates have good scores but none passes the matching function.
+    // No candidate has a good score and passes the matching function.
     return Candidate3D::Unsuccessful();
   }
 
@@ -41,27 +41,49 @@ proto::FastCorrelativeScanMatcherOptions3D
 CreateFastCorrelativeScanMatcherOptions3D(
     common::LuaParameterDictionary* parameter_dictionary);
 
+// The precomputation grids for each depth of the branch-and-bound search.
+// Depth 0 is not stored, its values are converted from the 'hybrid_grid' which
+// has to outlive this object.
 class PrecomputationGridStack3D {
  public:
   PrecomputationGridStack3D(
       const HybridGrid& hybrid_grid,
       const proto::FastCorrelativeScanMatcherOptions3D& options);
 
-  const PrecomputationGrid3D& Get(int depth) const {
-    return precomputation_grids_.at(depth);
+  // Returns the value of the precomputation grid at 'depth' at 'cell_index'.
+  int GetValue(const int depth, const Eigen::Array3i& cell_index) const {
+    if (depth == 0) {
+      return value_table_[hybrid_grid_.value(cell_index)];
+    }
+    return precomputation_grids_[depth - 1].value(cell_index);
   }
 
-  int max_depth() const { return precomputation_grids_.size() - 1; }
+  // Returns the cell index of 'point' at depth 0.
+  Eigen::Array3i GetCellIndex(const Eigen::Vector3f& point) const {
+    return hybrid_grid_.GetCellIndex(point);
+  }
+
+  int max_depth() const { return precomputation_grids_.size(); }
+
+  size_t MemoryUsageInBytes() const {
+    size_t memory_usage_in_bytes = sizeof(*this);
+    for (const PrecomputationGrid3D& precomputation_grid :
+         precomputation_grids_) {
+      memory_usage_in_bytes += precomputation_grid.MemoryUsageInBytes();
+    }
+    return memory_usage_in_bytes;
+  }
 
  private:
+  const HybridGrid& hybrid_grid_;
+  const std::vector<uint8>& value_table_;
+  // Grids for depth 1 and higher.
   std::vector<PrecomputationGrid3D> precomputation_grids_;
 };
 
 struct DiscreteScan3D;
 struct Candidate3D;
-
-// Used to compute scores between 0 and 1 how well the given pose matches.
-using MatchingFunction = std::function<float(const transform::Rigid3f&)>;
+class LowResolutionMatcher;
 
 class FastCorrelativeScanMatcher3D {
  public:
@@ -100,12 +122,16 @@ class FastCorrelativeScanMatcher3D {
       const Eigen::Quaterniond& global_submap_rotation,
       const TrajectoryNode::Data& constant_data, float min_score) const;
 
+  // Returns the memory used by the precomputation grids and the copy of the
+  // low resolution grid.
+  size_t MemoryUsageInBytes() const;
+
  private:
   struct SearchParameters {
     const int linear_xy_window_size;     // voxels
     const int linear_z_window_size;      // voxels
     const double angular_search_window;  // radians
-    const MatchingFunction* const low_resolution_matcher;
+    const sensor::PointCloud* const low_resolution_point_cloud;
   };
 
   std::unique_ptr<Result> MatchWithSearchParameters(
@@ -146,7 +172,7 @@ class FastCorrelativeScanMatcher3D {
   const float resolution_;
   const int width_in_voxels_;
   std::unique_ptr<PrecomputationGridStack3D> precomputation_grid_stack_;
-  const HybridGrid* const low_resolution_hybrid_grid_;
+  std::unique_ptr<LowResolutionMatcher> low_resolution_matcher_;
   RotationalScanMatcher rotational_scan_matcher_;
 };
 
@@ -24,6 +24,7 @@
 #include "absl/memory/memory.h"
 #include "cartographer/common/lua_parameter_dictionary_test_helpers.h"
 #include "cartographer/mapping/3d/range_data_inserter_3d.h"
+#include "cartographer/mapping/internal/3d/scan_matching/precomputation_grid_3d.h"
 #include "cartographer/transform/rigid_transform_test_helpers.h"
 #include "cartographer/transform/transform.h"
 #include "gtest/gtest.h"
@@ -203,6 +204,35 @@ TEST_F(FastCorrelativeScanMatcher3DTest, CorrectPoseForMatchFullSubmap) {
       << low_resolution_result->low_resolution_score;
 }
 
+TEST_F(FastCorrelativeScanMatcher3DTest, PrecomputationGridStack) {
+  proto::FastCorrelativeScanMatcherOptions3D options = options_;
+  options.set_full_resolution_depth(3);
+  const transform::Rigid3f pose = GetRandomPose();
+  GetFastCorrelativeScanMatcher(options, pose);
+  const PrecomputationGridStack3D precomputation_grid_stack(*hybrid_grid_,
+                                                            options);
+  EXPECT_EQ(precomputation_grid_stack.max_depth(), 5);
+
+  const PrecomputationGrid3D original_grid =
+      ConvertToPrecomputationGrid(*hybrid_grid_);
+  const PrecomputationGrid3D first_grid =
+      PrecomputeGrid(original_grid, false, Eigen::Array3i::Ones());
+  int num_occupied_cells = 0;
+  for (const auto& cell : *hybrid_grid_) {
+    for (int i = 0; i != 8; ++i) {
+      const Eigen::Array3i cell_index = cell.first - HybridGrid::GetOctant(i);
+      EXPECT_EQ(precomputation_grid_stack.GetValue(0, cell_index),
+                original_grid.value(cell_index));
+      EXPECT_EQ(precomputation_grid_stack.GetValue(1, cell_index),
+                first_grid.value(cell_index));
+    }
+    if (precomputation_grid_stack.GetValue(0, cell.first) > 128) {
+      ++num_occupied_cells;
+    }
+  }
+  EXPECT_GT(num_occupied_cells, 0);
+}
+
 }  // namespace
 }  // namespace scan_matching
 }  // namespace mapping
@@ -17,9 +17,13 @@
 #ifndef CARTOGRAPHER_MAPPING_INTERNAL_3D_SCAN_MATCHING_INTERPOLATED_GRID_H_
 #define CARTOGRAPHER_MAPPING_INTERNAL_3D_SCAN_MATCHING_INTERPOLATED_GRID_H_
 
+#include <array>
 #include <cmath>
+#include <vector>
 
+#include "Eigen/Core"
 #include "cartographer/mapping/3d/hybrid_grid.h"
+#include "cartographer/mapping/probability_values.h"
 
 namespace cartographer {
 namespace mapping {
@@ -53,23 +57,18 @@ class InterpolatedGrid {
     double x1, y1, z1, x2, y2, z2;
     ComputeInterpolationDataPoints(x, y, z, &x1, &y1, &z1, &x2, &y2, &z2);
 
-    const Eigen::Array3i index1 =
-        hybrid_grid_.GetCellIndex(Eigen::Vector3f(x1, y1, z1));
-    const double q111 = GetValue(hybrid_grid_, index1);
-    const double q112 =
-        GetValue(hybrid_grid_, index1 + Eigen::Array3i(0, 0, 1));
-    const double q121 =
-        GetValue(hybrid_grid_, index1 + Eigen::Array3i(0, 1, 0));
-    const double q122 =
-        GetValue(hybrid_grid_, index1 + Eigen::Array3i(0, 1, 1));
-    const double q211 =
-        GetValue(hybrid_grid_, index1 + Eigen::Array3i(1, 0, 0));
-    const double q212 =
-        GetValue(hybrid_grid_, index1 + Eigen::Array3i(1, 0, 1));
-    const double q221 =
-        GetValue(hybrid_grid_, index1 + Eigen::Array3i(1, 1, 0));
-    const double q222 =
-        GetValue(hybrid_grid_, index1 + Eigen::Array3i(1, 1, 1));
+    std::array<float, 8> values;
+    GetOctantValues(hybrid_grid_,
+                    hybrid_grid_.GetCellIndex(Eigen::Vector3f(x1, y1, z1)),
+                    &values);
+    const double q111 = values[0];
+    const double q112 = values[4];
+    const double q121 = values[2];
+    const double q122 = values[6];
+    const double q211 = values[1];
+    const double q212 = values[5];
+    const double q221 = values[3];
+    const double q222 = values[7];
 
     const T normalized_x = (x - x1) / (x2 - x1);
     const T normalized_y = (y - y1) / (y2 - y1);
@@ -103,6 +102,67 @@ class InterpolatedGrid {
            q1;
   }
 
+  // Computes GetInterpolatedValue() at all 'points' into 'values' and, unless
+  // 'gradients' is nullptr, its gradients with respect to the point, i.e. what
+  // Ceres Jets would give as derivatives. Both outputs have to have room for
+  // 'points.size()' elements. This is a lot faster than evaluating each point
+  // on Jets.
+  void GetInterpolatedValues(const std::vector<Eigen::Vector3d>& points,
+                             double* const values,
+                             Eigen::Vector3d* const gradients) const {
+    std::array<float, 8> q;
+    for (size_t i = 0; i != points.size(); ++i) {
+      const Eigen::Vector3d& point = points[i];
+      double x1, y1, z1, x2, y2, z2;
+      ComputeInterpolationDataPoints(point.x(), point.y(), point.z(), &x1, &y1,
+                                     &z1, &x2, &y2, &z2);
+      GetOctantValues(hybrid_grid_,
+                      hybrid_grid_.GetCellIndex(Eigen::Vector3f(x1, y1, z1)),
+                      &q);
+
+      const Eigen::Array3d size(x2 - x1, y2 - y1, z2 - z1);
+      const Eigen::Array3d normalized =
+          (point.array() - Eigen::Array3d(x1, y1, z1)) / size;
+      const Eigen::Array3d normalized_squared = normalized * normalized;
+      const Eigen::Array3d normalized_cubed = normalized * normalized_squared;
+
+      // The same scheme as in GetInterpolatedValue(), but the 4 interpolations
+      // in z and the 2 in y are each done on one Eigen array, so that they are
+      // vectorized. Entries are ordered by the x and y indices: 11, 12, 21, 22
+      // in z, then 1, 2 in y.
+      const Eigen::Array4d lower_z(q[0], q[2], q[1], q[3]);
+      const Eigen::Array4d upper_z(q[4], q[6], q[5], q[7]);
+      const Eigen::Array4d q_z =
+          (lower_z - upper_z) * normalized_cubed.z() * 2. +
+          (upper_z - lower_z) * normalized_squared.z() * 3. + lower_z;
+      const Eigen::Array2d lower_y(q_z[0], q_z[2]);
+      const Eigen::Array2d upper_y(q_z[1], q_z[3]);
+      const Eigen::Array2d q_y =
+          (lower_y - upper_y) * normalized_cubed.y() * 2. +
+          (upper_y - lower_y) * normalized_squared.y() * 3. + lower_y;
+      values[i] = (q_y[0] - q_y[1]) * normalized_cubed.x() * 2. +
+                  (q_y[1] - q_y[0]) * normalized_squared.x() * 3. + q_y[0];
+      if (gradients == nullptr) {
+        continue;
+      }
+
+      // A * (2t^3 - 3t^2 + 1) + B * (-2t^3 + 3t^2) has the derivative
+      // (A - B) * (6t^2 - 6t) with respect to t, and 1 - s and s with respect
+      // to A and B, where s = 3t^2 - 2t^3.
+      const Eigen::Array3d derivative =
+          6. * (normalized_squared - normalized) / size;
+      const Eigen::Array3d s = 3. * normalized_squared - 2. * normalized_cubed;
+      const Eigen::Array2d weights_x(1. - s.x(), s.x());
+      const Eigen::Array4d weights_xy(
+          weights_x[0] * (1. - s.y()), weights_x[0] * s.y(),
+          weights_x[1] * (1. - s.y()), weights_x[1] * s.y());
+      gradients[i] = Eigen::Vector3d(
+          (q_y[0] - q_y[1]) * derivative.x(),
+          (weights_x * (lower_y - upper_y)).sum() * derivative.y(),
+          (weights_xy * (lower_z - upper_z)).sum() * derivative.z());
+    }
+  }
+
  private:
   template <typename T>
   void ComputeInterpolationDataPoints(const T& x, const T& y, const T& z,
@@ -146,14 +206,26 @@ class InterpolatedGrid {
     return CenterOfLowerVoxel(jet_x.a, jet_y.a, jet_z.a);
   }
 
-  static float GetValue(const HybridGrid& probability_grid,
-                        const Eigen::Array3i& index) {
-    return probability_grid.GetProbability(index);
+  // Returns the values at 'index' + HybridGridBase::GetOctant(i) in
+  // '(*values)[i]'.
+  static void GetOctantValues(const HybridGrid& probability_grid,
+                              const Eigen::Array3i& index,
+                              std::array<float, 8>* const values) {
+    std::array<uint16, 8> cell_values;
+    probability_grid.GetOctantValues(index, &cell_values);
+    for (int i = 0; i != 8; ++i) {
+      (*values)[i] = ValueToProbability(cell_values[i]);
+    }
   }
 
-  static float GetValue(const IntensityHybridGrid& intensity_grid,
-                        const Eigen::Array3i& index) {
-    return intensity_grid.GetIntensity(index);
+  static void GetOctantValues(const IntensityHybridGrid& intensity_grid,
+                              const Eigen::Array3i& index,
+                              std::array<float, 8>* const values) {
+    std::array<AverageIntensityData, 8> cells;
+    intensity_grid.GetOctantValues(index, &cells);
+    for (int i = 0; i != 8; ++i) {
+      (*values)[i] = cells[i].count == 0 ? 0.f : cells[i].sum / cells[i].count;
+    }
   }
 
   const HybridGridType& hybrid_grid_;
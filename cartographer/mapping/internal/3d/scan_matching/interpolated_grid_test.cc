@@ -16,6 +16,8 @@
 
 #include "cartographer/mapping/internal/3d/scan_matching/interpolated_grid.h"
 
+#include <vector>
+
 #include "Eigen/Core"
 #include "cartographer/mapping/3d/hybrid_grid.h"
 #include "gtest/gtest.h"
@@ -84,6 +86,46 @@ TEST_F(InterpolatedGridTest, MonotonicBehaviorBetweenGridPointsInX) {
   }
 }
 
+TEST_F(InterpolatedGridTest, BatchMatchesSinglePointsAndHasGradients) {
+  std::vector<Eigen::Vector3d> points;
+  for (double z = -1.; z < 3.; z += 0.37) {
+    for (double y = 1.; y < 5.; y += 0.23) {
+      for (double x = -8.; x < -2.; x += 0.17) {
+        points.emplace_back(x, y, z);
+      }
+    }
+  }
+  std::vector<double> values(points.size());
+  std::vector<Eigen::Vector3d> gradients(points.size());
+  interpolated_grid_.GetInterpolatedValues(points, values.data(),
+                                           gradients.data());
+  std::vector<double> values_only(points.size());
+  interpolated_grid_.GetInterpolatedValues(points, values_only.data(),
+                                           nullptr);
+
+  constexpr double kDelta = 1e-5;
+  const Eigen::Matrix3d deltas = kDelta * Eigen::Matrix3d::Identity();
+  for (size_t i = 0; i != points.size(); ++i) {
+    const Eigen::Vector3d& point = points[i];
+    EXPECT_NEAR(values[i],
+                interpolated_grid_.GetInterpolatedValue(point.x(), point.y(),
+                                                        point.z()),
+                1e-12);
+    EXPECT_EQ(values[i], values_only[i]);
+    for (int j = 0; j != 3; ++j) {
+      const Eigen::Vector3d upper = point + deltas.col(j);
+      const Eigen::Vector3d lower = point - deltas.col(j);
+      const double derivative =
+          (interpolated_grid_.GetInterpolatedValue(upper.x(), upper.y(),
+                                                   upper.z()) -
+           interpolated_grid_.GetInterpolatedValue(lower.x(), lower.y(),
+                                                   lower.z())) /
+          (2. * kDelta);
+      EXPECT_NEAR(derivative, gradients[i][j], 1e-4);
+    }
+  }
+}
+
 }  // namespace
 }  // namespace scan_matching
 }  // namespace mapping
@@ -16,9 +16,30 @@
 
 #include "cartographer/mapping/internal/3d/scan_matching/low_resolution_matcher.h"
 
+#include <algorithm>
+#include <limits>
+
+#include "cartographer/common/math.h"
+#include "cartographer/mapping/probability_values.h"
+#include "glog/logging.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 namespace cartographer {
 namespace mapping {
 namespace scan_matching {
+namespace {
+
+// Number of lanes of the AVX2 path, and at the same time the number of
+// translations summed together.
+constexpr int kNumTranslationsPerBatch = 8;
+
+// Values are below 2^15, so 32-bit sums can hold this many of them.
+constexpr int kMaxPointsPerSum = 1 << 16;
+
+}  // namespace
 
 std::function<float(const transform::Rigid3f&)> CreateLowResolutionMatcher(
     const HybridGrid* low_resolution_grid, const sensor::PointCloud* points) {
@@ -34,6 +55,162 @@ std::function<float(const transform::Rigid3f&)> CreateLowResolutionMatcher(
   };
 }
 
+LowResolutionMatcher::LowResolutionMatcher(
+    const HybridGrid& low_resolution_grid)
+    : resolution_(low_resolution_grid.resolution()),
+      offset_(Eigen::Array3i::Zero()),
+      size_(Eigen::Array3i::Zero()) {
+  Eigen::Array3i min_index =
+      Eigen::Array3i::Constant(std::numeric_limits<int>::max());
+  Eigen::Array3i max_index =
+      Eigen::Array3i::Constant(std::numeric_limits<int>::min());
+  for (auto it = HybridGrid::Iterator(low_resolution_grid); !it.Done();
+       it.Next()) {
+    min_index = min_index.min(it.GetCellIndex());
+    max_index = max_index.max(it.GetCellIndex());
+  }
+  if ((min_index <= max_index).all()) {
+    offset_ = min_index;
+    size_ = max_index - min_index + 1;
+  }
+  const int64 num_cells = static_cast<int64>(size_.x()) * size_.y() * size_.z();
+  CHECK_LT(num_cells, std::numeric_limits<int>::max() - 2);
+  // Unknown cells are scored like 'kMinProbability' which is the value 1.
+  values_.assign(num_cells + 2, 1);
+  for (auto it = HybridGrid::Iterator(low_resolution_grid); !it.Done();
+       it.Next()) {
+    const uint16 value = it.GetValue() & (kUpdateMarker - 1);
+    values_[GetFlatIndex(it.GetCellIndex())] = std::max<uint16>(value, 1);
+  }
+}
+
+std::vector<float> LowResolutionMatcher::ScoreTranslations(
+    const std::vector<Eigen::Vector3f>& points,
+    const std::vector<Eigen::Vector3f>& translations) const {
+  std::vector<float> scores(translations.size(), 0.f);
+  if (points.empty()) {
+    return scores;
+  }
+  // Inverts the mapping of values in [1, 32767] to probabilities in
+  // [kMinProbability, kMaxProbability] done by ValueToProbability().
+  const float scale = (kMaxProbability - kMinProbability) / 32766.f;
+  const float num_points = points.size();
+  uint64 sums[kNumTranslationsPerBatch];
+  for (size_t begin = 0; begin < translations.size();
+       begin += kNumTranslationsPerBatch) {
+    const int num_translations = std::min<int>(
+        kNumTranslationsPerBatch, translations.size() - begin);
+    SumValues(points, translations.data() + begin, num_translations, sums);
+    for (int i = 0; i != num_translations; ++i) {
+      scores[begin + i] =
+          (sums[i] - num_points) * scale / num_points + kMinProbability;
+    }
+  }
+  return scores;
+}
+
+void LowResolutionMatcher::SumValues(const std::vector<Eigen::Vector3f>& points,
+                                     const Eigen::Vector3f* const translations,
+                                     const int num_translations,
+                                     uint64* const sums) const {
+  CHECK_LE(num_translations, kNumTranslationsPerBatch);
+  std::fill(sums, sums + num_translations, 0);
+#if defined(__AVX2__)
+  // Lanes past 'num_translations' repeat the last translation and are ignored.
+  alignas(32) float translation_x[kNumTranslationsPerBatch];
+  alignas(32) float translation_y[kNumTranslationsPerBatch];
+  alignas(32) float translation_z[kNumTranslationsPerBatch];
+  for (int i = 0; i != kNumTranslationsPerBatch; ++i) {
+    const Eigen::Vector3f& translation =
+        translations[std::min(i, num_translations - 1)];
+    translation_x[i] = translation.x();
+    translation_y[i] = translation.y();
+    translation_z[i] = translation.z();
+  }
+  const __m256 tx = _mm256_load_ps(translation_x);
+  const __m256 ty = _mm256_load_ps(translation_y);
+  const __m256 tz = _mm256_load_ps(translation_z);
+  const __m256 resolution = _mm256_set1_ps(resolution_);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const __m256 sign_mask = _mm256_set1_ps(-0.f);
+  const __m256i offset_x = _mm256_set1_epi32(offset_.x());
+  const __m256i offset_y = _mm256_set1_epi32(offset_.y());
+  const __m256i offset_z = _mm256_set1_epi32(offset_.z());
+  const __m256i size_x = _mm256_set1_epi32(size_.x());
+  const __m256i size_y = _mm256_set1_epi32(size_.y());
+  const __m256i size_z = _mm256_set1_epi32(size_.z());
+  const __m256i minus_one = _mm256_set1_epi32(-1);
+  const __m256i outside_index = _mm256_set1_epi32(values_.size() - 2);
+  const __m256i low_mask = _mm256_set1_epi32(0xffff);
+  const int* const base = reinterpret_cast<const int*>(values_.data());
+  // Rounds half away from zero like common::RoundToInt().
+  const auto round_to_int = [&half, &sign_mask](const __m256 value) {
+    return _mm256_cvttps_epi32(
+        _mm256_add_ps(value, _mm256_or_ps(half, _mm256_and_ps(value,
+                                                               sign_mask))));
+  };
+  const auto in_range = [&minus_one](const __m256i index, const __m256i size) {
+    return _mm256_and_si256(_mm256_cmpgt_epi32(index, minus_one),
+                            _mm256_cmpgt_epi32(size, index));
+  };
+  for (size_t begin = 0; begin < points.size(); begin += kMaxPointsPerSum) {
+    const size_t end = std::min(points.size(), begin + kMaxPointsPerSum);
+    __m256i sum = _mm256_setzero_si256();
+    for (size_t i = begin; i != end; ++i) {
+      const Eigen::Vector3f& point = points[i];
+      const __m256i x = _mm256_sub_epi32(
+          round_to_int(_mm256_div_ps(
+              _mm256_add_ps(_mm256_set1_ps(point.x()), tx), resolution)),
+          offset_x);
+      const __m256i y = _mm256_sub_epi32(
+          round_to_int(_mm256_div_ps(
+              _mm256_add_ps(_mm256_set1_ps(point.y()), ty), resolution)),
+          offset_y);
+      const __m256i z = _mm256_sub_epi32(
+          round_to_int(_mm256_div_ps(
+              _mm256_add_ps(_mm256_set1_ps(point.z()), tz), resolution)),
+          offset_z);
+      const __m256i inside =
+          _mm256_and_si256(_mm256_and_si256(in_range(x, size_x),
+                                            in_range(y, size_y)),
+                           in_range(z, size_z));
+      const __m256i flat_index = _mm256_add_epi32(
+          x, _mm256_mullo_epi32(
+                 size_x,
+                 _mm256_add_epi32(y, _mm256_mullo_epi32(size_y, z))));
+      const __m256i index =
+          _mm256_blendv_epi8(outside_index, flat_index, inside);
+      sum = _mm256_add_epi32(
+          sum, _mm256_and_si256(_mm256_i32gather_epi32(base, index, 2),
+                                low_mask));
+    }
+    alignas(32) uint32 lanes[kNumTranslationsPerBatch];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sum);
+    for (int i = 0; i != num_translations; ++i) {
+      sums[i] += lanes[i];
+    }
+  }
+#else
+  for (int i = 0; i != num_translations; ++i) {
+    for (const Eigen::Vector3f& point : points) {
+      const Eigen::Array3f index = (point + translations[i]).array() /
+                                   resolution_;
+      sums[i] += values_[GetFlatIndex(Eigen::Array3i(
+          common::RoundToInt(index.x()), common::RoundToInt(index.y()),
+          common::RoundToInt(index.z())))];
+    }
+  }
+#endif
+}
+
+int LowResolutionMatcher::GetFlatIndex(const Eigen::Array3i& cell_index) const {
+  const Eigen::Array3i index = cell_index - offset_;
+  if ((index < 0).any() || (index >= size_).any()) {
+    return values_.size() - 2;
+  }
+  return index.x() + size_.x() * (index.y() + size_.y() * index.z());
+}
+
 }  // namespace scan_matching
 }  // namespace mapping
 }  // namespace cartographer
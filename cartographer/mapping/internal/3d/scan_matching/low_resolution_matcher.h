@@ -18,7 +18,10 @@
 #define CARTOGRAPHER_MAPPING_INTERNAL_3D_SCAN_MATCHING_LOW_RESOLUTION_MATCHER_H_
 
 #include <functional>
+#include <vector>
 
+#include "Eigen/Core"
+#include "cartographer/common/port.h"
 #include "cartographer/mapping/3d/hybrid_grid.h"
 #include "cartographer/sensor/point_cloud.h"
 #include "cartographer/transform/rigid_transform.h"
@@ -30,6 +33,49 @@ namespace scan_matching {
 std::function<float(const transform::Rigid3f&)> CreateLowResolutionMatcher(
     const HybridGrid* low_resolution_grid, const sensor::PointCloud* points);
 
+// Scores many poses of a low resolution point cloud at once, with the same
+// result as the function returned by CreateLowResolutionMatcher(). The grid is
+// copied into a dense block covering its known cells, where unknown cells and
+// cells outside the block have the value of 'kMinProbability', so scoring needs
+// no hash lookups, and since known values map affinely to probabilities, raw
+// values are summed as integers. With AVX2, 8 poses are scored per instruction,
+// one per lane.
+class LowResolutionMatcher {
+ public:
+  explicit LowResolutionMatcher(const HybridGrid& low_resolution_grid);
+
+  LowResolutionMatcher(const LowResolutionMatcher&) = delete;
+  LowResolutionMatcher& operator=(const LowResolutionMatcher&) = delete;
+
+  // Returns for each of 'translations' the score of 'points', which are already
+  // in the frame of the grid up to these translations.
+  std::vector<float> ScoreTranslations(
+      const std::vector<Eigen::Vector3f>& points,
+      const std::vector<Eigen::Vector3f>& translations) const;
+
+  size_t MemoryUsageInBytes() const {
+    return sizeof(*this) + values_.capacity() * sizeof(uint16);
+  }
+
+ private:
+  // Returns the sum of the values of the cells of 'points' shifted by each of
+  // the 'num_translations' translations, which must be at most 8.
+  void SumValues(const std::vector<Eigen::Vector3f>& points,
+                 const Eigen::Vector3f* translations, int num_translations,
+                 uint64* sums) const;
+
+  // Returns the index into 'values_' of the cell at 'cell_index', or of the
+  // cell past the block if it is outside.
+  int GetFlatIndex(const Eigen::Array3i& cell_index) const;
+
+  const float resolution_;
+  Eigen::Array3i offset_;
+  Eigen::Array3i size_;
+  // The block of cells in x-major order, followed by an unknown cell standing
+  // for all cells outside and a padding cell for 32-bit gathers.
+  std::vector<uint16> values_;
+};
+
 }  // namespace scan_matching
 }  // namespace mapping
 }  // namespace cartographer
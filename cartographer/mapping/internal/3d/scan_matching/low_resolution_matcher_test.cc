@@ -0,0 +1,83 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/3d/scan_matching/low_resolution_matcher.h"
+
+#include <random>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+namespace cartographer {
+namespace mapping {
+namespace scan_matching {
+namespace {
+
+TEST(LowResolutionMatcherTest, ScoresTranslationsLikeMatchingFunction) {
+  HybridGrid hybrid_grid(0.5f);
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> coordinate_distribution(-20, 19);
+  std::uniform_real_distribution<float> value_distribution(kMinProbability,
+                                                           kMaxProbability);
+  for (int i = 0; i < 2000; ++i) {
+    hybrid_grid.SetProbability(Eigen::Array3i(coordinate_distribution(rng),
+                                              coordinate_distribution(rng),
+                                              coordinate_distribution(rng)),
+                               value_distribution(rng));
+  }
+  // Points reach outside of the known cells to cover unknown cells as well.
+  std::uniform_real_distribution<float> point_distribution(-15.f, 15.f);
+  sensor::PointCloud point_cloud;
+  std::vector<Eigen::Vector3f> points;
+  for (int i = 0; i < 500; ++i) {
+    const Eigen::Vector3f point(point_distribution(rng),
+                                point_distribution(rng),
+                                point_distribution(rng));
+    point_cloud.push_back({point});
+    points.push_back(point);
+  }
+  std::vector<Eigen::Vector3f> translations;
+  for (int i = 0; i < 19; ++i) {
+    translations.emplace_back(point_distribution(rng), point_distribution(rng),
+                              point_distribution(rng));
+  }
+
+  const auto matching_function =
+      CreateLowResolutionMatcher(&hybrid_grid, &point_cloud);
+  const LowResolutionMatcher low_resolution_matcher(hybrid_grid);
+  const std::vector<float> scores =
+      low_resolution_matcher.ScoreTranslations(points, translations);
+  ASSERT_EQ(scores.size(), translations.size());
+  for (size_t i = 0; i != translations.size(); ++i) {
+    EXPECT_NEAR(
+        matching_function(transform::Rigid3f::Translation(translations[i])),
+        scores[i], 1e-4f);
+  }
+}
+
+TEST(LowResolutionMatcherTest, EmptyGrid) {
+  const HybridGrid hybrid_grid(0.5f);
+  const LowResolutionMatcher low_resolution_matcher(hybrid_grid);
+  const std::vector<float> scores = low_resolution_matcher.ScoreTranslations(
+      {Eigen::Vector3f(1.f, 2.f, 3.f)}, {Eigen::Vector3f::Zero()});
+  ASSERT_EQ(scores.size(), 1);
+  EXPECT_NEAR(kMinProbability, scores[0], 1e-6f);
+}
+
+}  // namespace
+}  // namespace scan_matching
+}  // namespace mapping
+}  // namespace cartographer
@@ -17,12 +17,16 @@
 #ifndef CARTOGRAPHER_MAPPING_INTERNAL_3D_SCAN_MATCHING_OCCUPIED_SPACE_COST_FUNCTION_3D_H_
 #define CARTOGRAPHER_MAPPING_INTERNAL_3D_SCAN_MATCHING_OCCUPIED_SPACE_COST_FUNCTION_3D_H_
 
+#include <vector>
+
 #include "Eigen/Core"
+#include "Eigen/Geometry"
 #include "cartographer/mapping/3d/hybrid_grid.h"
 #include "cartographer/mapping/internal/3d/scan_matching/interpolated_grid.h"
 #include "cartographer/sensor/point_cloud.h"
 #include "cartographer/transform/rigid_transform.h"
 #include "cartographer/transform/transform.h"
+#include "ceres/ceres.h"
 
 namespace cartographer {
 namespace mapping {
@@ -84,6 +88,103 @@ class OccupiedSpaceCostFunction3D {
   const InterpolatedProbabilityGrid interpolated_grid_;
 };
 
+// Same cost as OccupiedSpaceCostFunction3D, but with analytical Jacobians. All
+// points are interpolated in one batch on doubles instead of one by one on
+// Ceres Jets, which is a lot faster.
+//
+// Only the points with indices in ['begin_index', 'end_index') get residuals,
+// so that a point cloud can be split up into several residual blocks.
+class AnalyticalOccupiedSpaceCostFunction3D : public ceres::CostFunction {
+ public:
+  AnalyticalOccupiedSpaceCostFunction3D(const double scaling_factor,
+                                        const sensor::PointCloud& point_cloud,
+                                        const mapping::HybridGrid& hybrid_grid)
+      : AnalyticalOccupiedSpaceCostFunction3D(
+            scaling_factor, point_cloud, 0, point_cloud.size(), hybrid_grid) {}
+
+  AnalyticalOccupiedSpaceCostFunction3D(const double scaling_factor,
+                                        const sensor::PointCloud& point_cloud,
+                                        const size_t begin_index,
+                                        const size_t end_index,
+                                        const mapping::HybridGrid& hybrid_grid)
+      : scaling_factor_(scaling_factor),
+        point_cloud_(point_cloud),
+        begin_index_(begin_index),
+        num_points_(end_index - begin_index),
+        interpolated_grid_(hybrid_grid) {
+    CHECK_LE(begin_index, end_index);
+    CHECK_LE(end_index, point_cloud.size());
+    set_num_residuals(num_points_);
+    mutable_parameter_block_sizes()->push_back(3 /* translation variables */);
+    mutable_parameter_block_sizes()->push_back(4 /* rotation variables */);
+  }
+
+  AnalyticalOccupiedSpaceCostFunction3D(
+      const AnalyticalOccupiedSpaceCostFunction3D&) = delete;
+  AnalyticalOccupiedSpaceCostFunction3D& operator=(
+      const AnalyticalOccupiedSpaceCostFunction3D&) = delete;
+
+  bool Evaluate(double const* const* parameters, double* residuals,
+                double** jacobians) const override {
+    const Eigen::Map<const Eigen::Vector3d> translation(parameters[0]);
+    // Like the autodiff version, the rotation is applied with Eigen's formula
+    // for unit quaternions, v + 2w (u x v) + 2u x (u x v), also if the
+    // parameters are not normalized.
+    const Eigen::Quaterniond rotation(parameters[1][0], parameters[1][1],
+                                      parameters[1][2], parameters[1][3]);
+    std::vector<Eigen::Vector3d> points(num_points_);
+    std::vector<Eigen::Vector3d> world(num_points_);
+    for (size_t i = 0; i < num_points_; ++i) {
+      points[i] = point_cloud_[begin_index_ + i].position.cast<double>();
+      world[i] = rotation * points[i] + translation;
+    }
+
+    double* const translation_jacobian =
+        jacobians == nullptr ? nullptr : jacobians[0];
+    double* const rotation_jacobian =
+        jacobians == nullptr ? nullptr : jacobians[1];
+    std::vector<Eigen::Vector3d> gradients;
+    if (translation_jacobian != nullptr || rotation_jacobian != nullptr) {
+      gradients.resize(num_points_);
+    }
+    interpolated_grid_.GetInterpolatedValues(
+        world, residuals, gradients.empty() ? nullptr : gradients.data());
+    for (size_t i = 0; i < num_points_; ++i) {
+      residuals[i] = scaling_factor_ * (1. - residuals[i]);
+    }
+    if (gradients.empty()) {
+      return true;
+    }
+
+    const double w = rotation.w();
+    const Eigen::Vector3d u = rotation.vec();
+    for (size_t i = 0; i < num_points_; ++i) {
+      // Jacobians in Ceres are row-major, one row per residual.
+      const Eigen::Vector3d gradient = -scaling_factor_ * gradients[i];
+      if (translation_jacobian != nullptr) {
+        Eigen::Map<Eigen::Vector3d>(translation_jacobian + 3 * i) = gradient;
+      }
+      if (rotation_jacobian != nullptr) {
+        const Eigen::Vector3d& v = points[i];
+        double* const row = rotation_jacobian + 4 * i;
+        row[0] = 2. * gradient.dot(u.cross(v));
+        Eigen::Map<Eigen::Vector3d>(row + 1) =
+            2. * w * v.cross(gradient) +
+            2. * (u.dot(v) * gradient + gradient.dot(u) * v -
+                  2. * gradient.dot(v) * u);
+      }
+    }
+    return true;
+  }
+
+ private:
+  const double scaling_factor_;
+  const sensor::PointCloud& point_cloud_;
+  const size_t begin_index_;
+  const size_t num_points_;
+  const InterpolatedProbabilityGrid interpolated_grid_;
+};
+
 }  // namespace scan_matching
 }  // namespace mapping
 }  // namespace cartographer
@@ -0,0 +1,156 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/3d/scan_matching/occupied_space_cost_function_3d.h"
+
+#include <array>
+#include <memory>
+
+#include "cartographer/mapping/3d/hybrid_grid.h"
+#include "cartographer/mapping/probability_values.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace scan_matching {
+namespace {
+
+TEST(OccupiedSpaceCostFunction3DTest, AnalyticalMatchesAutoDiff) {
+  HybridGrid hybrid_grid(0.1f);
+  for (int z = -10; z < 10; ++z) {
+    for (int y = -10; y < 10; ++y) {
+      for (int x = -10; x < 10; ++x) {
+        hybrid_grid.SetProbability(
+            Eigen::Array3i(x, y, z),
+            kMinProbability + (kMaxProbability - kMinProbability) *
+                                  ((3 * x + 7 * y + 5 * z + 300) % 11) / 10.f);
+      }
+    }
+  }
+  constexpr int kNumPoints = 5;
+  const sensor::PointCloud point_cloud({{Eigen::Vector3f{0.03f, 0.11f, 0.2f}},
+                                        {Eigen::Vector3f{-0.27f, 0.42f, 0.f}},
+                                        {Eigen::Vector3f{0.58f, -0.33f, 0.31f}},
+                                        {Eigen::Vector3f{0.4f, 0.4f, -0.6f}},
+                                        {Eigen::Vector3f{5.f, 5.f, 5.f}}});
+  std::unique_ptr<ceres::CostFunction> auto_diff_cost_function(
+      OccupiedSpaceCostFunction3D::CreateAutoDiffCostFunction(0.5, point_cloud,
+                                                              hybrid_grid));
+  std::unique_ptr<ceres::CostFunction> analytical_cost_function(
+      new AnalyticalOccupiedSpaceCostFunction3D(0.5, point_cloud, hybrid_grid));
+
+  const std::array<double, 3> translation{{0.12, -0.07, 0.05}};
+  // Deliberately not normalized.
+  const std::array<double, 4> rotation{{0.98, 0.1, -0.15, 0.2}};
+  const std::array<const double*, 2> parameter_blocks{
+      {translation.data(), rotation.data()}};
+  std::array<double, kNumPoints> auto_diff_residuals;
+  std::array<double, kNumPoints * 3> auto_diff_translation_jacobian;
+  std::array<double, kNumPoints * 4> auto_diff_rotation_jacobian;
+  std::array<double*, 2> auto_diff_jacobians{
+      {auto_diff_translation_jacobian.data(),
+       auto_diff_rotation_jacobian.data()}};
+  auto_diff_cost_function->Evaluate(parameter_blocks.data(),
+                                    auto_diff_residuals.data(),
+                                    auto_diff_jacobians.data());
+  std::array<double, kNumPoints> analytical_residuals;
+  std::array<double, kNumPoints * 3> analytical_translation_jacobian;
+  std::array<double, kNumPoints * 4> analytical_rotation_jacobian;
+  std::array<double*, 2> analytical_jacobians{
+      {analytical_translation_jacobian.data(),
+       analytical_rotation_jacobian.data()}};
+  analytical_cost_function->Evaluate(parameter_blocks.data(),
+                                     analytical_residuals.data(),
+                                     analytical_jacobians.data());
+
+  for (int i = 0; i < kNumPoints; ++i) {
+    EXPECT_NEAR(auto_diff_residuals[i], analytical_residuals[i], 1e-12);
+  }
+  for (int i = 0; i < kNumPoints * 3; ++i) {
+    EXPECT_NEAR(auto_diff_translation_jacobian[i],
+                analytical_translation_jacobian[i], 1e-9);
+  }
+  for (int i = 0; i < kNumPoints * 4; ++i) {
+    EXPECT_NEAR(auto_diff_rotation_jacobian[i],
+                analytical_rotation_jacobian[i], 1e-9);
+  }
+
+  // Residuals only.
+  analytical_cost_function->Evaluate(parameter_blocks.data(),
+                                     analytical_residuals.data(), nullptr);
+  for (int i = 0; i < kNumPoints; ++i) {
+    EXPECT_NEAR(auto_diff_residuals[i], analytical_residuals[i], 1e-12);
+  }
+}
+
+TEST(OccupiedSpaceCostFunction3DTest, RangeOfPoints) {
+  HybridGrid hybrid_grid(0.1f);
+  for (int x = -10; x < 10; ++x) {
+    hybrid_grid.SetProbability(
+        Eigen::Array3i(x, 0, 0),
+        kMinProbability + (kMaxProbability - kMinProbability) *
+                              ((x + 10) % 7) / 6.f);
+  }
+  constexpr int kNumPoints = 5;
+  constexpr int kBeginIndex = 1;
+  constexpr int kEndIndex = 4;
+  const sensor::PointCloud point_cloud({{Eigen::Vector3f{-0.83f, 0.f, 0.f}},
+                                        {Eigen::Vector3f{-0.42f, 0.01f, 0.f}},
+                                        {Eigen::Vector3f{0.05f, 0.f, 0.02f}},
+                                        {Eigen::Vector3f{0.37f, 0.f, 0.f}},
+                                        {Eigen::Vector3f{0.71f, 0.f, 0.f}}});
+  AnalyticalOccupiedSpaceCostFunction3D cost_function(0.5, point_cloud,
+                                                      hybrid_grid);
+  AnalyticalOccupiedSpaceCostFunction3D range_cost_function(
+      0.5, point_cloud, kBeginIndex, kEndIndex, hybrid_grid);
+  EXPECT_EQ(range_cost_function.num_residuals(), kEndIndex - kBeginIndex);
+
+  const std::array<double, 3> translation{{0.02, -0.01, 0.}};
+  const std::array<double, 4> rotation{{0.99, 0.01, 0.02, 0.1}};
+  const std::array<const double*, 2> parameter_blocks{
+      {translation.data(), rotation.data()}};
+  std::array<double, kNumPoints> residuals;
+  std::array<double, kNumPoints * 3> translation_jacobian;
+  std::array<double, kNumPoints * 4> rotation_jacobian;
+  std::array<double*, 2> jacobians{
+      {translation_jacobian.data(), rotation_jacobian.data()}};
+  cost_function.Evaluate(parameter_blocks.data(), residuals.data(),
+                         jacobians.data());
+  std::array<double, kNumPoints> range_residuals;
+  std::array<double, kNumPoints * 3> range_translation_jacobian;
+  std::array<double, kNumPoints * 4> range_rotation_jacobian;
+  std::array<double*, 2> range_jacobians{
+      {range_translation_jacobian.data(), range_rotation_jacobian.data()}};
+  range_cost_function.Evaluate(parameter_blocks.data(), range_residuals.data(),
+                               range_jacobians.data());
+
+  for (int i = 0; i < kEndIndex - kBeginIndex; ++i) {
+    EXPECT_EQ(range_residuals[i], residuals[kBeginIndex + i]);
+    for (int j = 0; j < 3; ++j) {
+      EXPECT_EQ(range_translation_jacobian[3 * i + j],
+                translation_jacobian[3 * (kBeginIndex + i) + j]);
+    }
+    for (int j = 0; j < 4; ++j) {
+      EXPECT_EQ(range_rotation_jacobian[4 * i + j],
+                rotation_jacobian[4 * (kBeginIndex + i) + j]);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace scan_matching
+}  // namespace mapping
+}  // namespace cartographer
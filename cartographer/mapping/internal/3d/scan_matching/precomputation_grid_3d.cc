@@ -17,6 +17,7 @@
 #include "cartographer/mapping/internal/3d/scan_matching/precomputation_grid_3d.h"
 
 #include <algorithm>
+#include <vector>
 
 #include "Eigen/Core"
 #include "cartographer/common/math.h"
@@ -44,18 +45,35 @@ Eigen::Array3i CellIndexAtHalfResolution(const Eigen::Array3i& cell_index) {
       DivideByTwoRoundingTowardsNegativeInfinity(cell_index[2]));
 }
 
+std::vector<uint8> ComputeHybridGridToPrecomputationValueTable() {
+  std::vector<uint8> result;
+  result.reserve(2 * kUpdateMarker);
+  for (int value = 0; value != 2 * kUpdateMarker; ++value) {
+    const int cell_value = common::RoundToInt(
+        (ValueToProbability(value) - kMinProbability) *
+        (255.f / (kMaxProbability - kMinProbability)));
+    CHECK_GE(cell_value, 0);
+    CHECK_LE(cell_value, 255);
+    result.push_back(cell_value);
+  }
+  return result;
+}
+
 }  // namespace
 
+const std::vector<uint8>& GetHybridGridToPrecomputationValueTable() {
+  static const std::vector<uint8>* const kTable =
+      new std::vector<uint8>(ComputeHybridGridToPrecomputationValueTable());
+  return *kTable;
+}
+
 PrecomputationGrid3D ConvertToPrecomputationGrid(
     const HybridGrid& hybrid_grid) {
+  const std::vector<uint8>& value_table =
+      GetHybridGridToPrecomputationValueTable();
   PrecomputationGrid3D result(hybrid_grid.resolution());
   for (auto it = HybridGrid::Iterator(hybrid_grid); !it.Done(); it.Next()) {
-    const int cell_value = common::RoundToInt(
-        (ValueToProbability(it.GetValue()) - kMinProbability) *
-        (255.f / (kMaxProbability - kMinProbability)));
-    CHECK_GE(cell_value, 0);
-    CHECK_LE(cell_value, 255);
-    *result.mutable_value(it.GetCellIndex()) = cell_value;
+    *result.mutable_value(it.GetCellIndex()) = value_table[it.GetValue()];
   }
   return result;
 }
@@ -17,6 +17,9 @@
 #ifndef CARTOGRAPHER_MAPPING_INTERNAL_3D_SCAN_MATCHING_PRECOMPUTATION_GRID_3D_H_
 #define CARTOGRAPHER_MAPPING_INTERNAL_3D_SCAN_MATCHING_PRECOMPUTATION_GRID_3D_H_
 
+#include <vector>
+
+#include "cartographer/common/port.h"
 #include "cartographer/mapping/3d/hybrid_grid.h"
 
 namespace cartographer {
@@ -35,6 +38,11 @@ class PrecomputationGrid3D : public HybridGridBase<uint8> {
   }
 };
 
+// Returns a table which maps HybridGrid values (which may or may not have the
+// update marker set) to the values of a PrecomputationGrid3D representing the
+// same probability.
+const std::vector<uint8>& GetHybridGridToPrecomputationValueTable();
+
 // Converts a HybridGrid to a PrecomputationGrid3D representing the same data,
 // but only using 8 bit instead of 2 x 16 bit.
 PrecomputationGrid3D ConvertToPrecomputationGrid(const HybridGrid& hybrid_grid);
@@ -55,6 +55,7 @@ class RealTimeCorrelativeScanMatcher3DTest : public ::testing::Test {
           angular_search_window = math.rad(1.),
           translation_delta_cost_weight = 1e-1,
           rotation_delta_cost_weight = 1.,
+          branch_and_bound_depth = 1,
         })text");
     real_time_correlative_scan_matcher_.reset(
         new RealTimeCorrelativeScanMatcher3D(
@@ -16,6 +16,7 @@
 
 #include "cartographer/mapping/internal/3d/scan_matching/rotational_scan_matcher.h"
 
+#include <cmath>
 #include <map>
 #include <vector>
 
@@ -118,19 +119,6 @@ sensor::PointCloud SortSlice(const sensor::PointCloud& slice) {
   return result;
 }
 
-float MatchHistograms(const Eigen::VectorXf& submap_histogram,
-                      const Eigen::VectorXf& scan_histogram) {
-  // We compute the dot product of normalized histograms as a measure of
-  // similarity.
-  const float scan_histogram_norm = scan_histogram.norm();
-  const float submap_histogram_norm = submap_histogram.norm();
-  const float normalization = scan_histogram_norm * submap_histogram_norm;
-  if (normalization < 1e-3f) {
-    return 1.f;
-  }
-  return submap_histogram.dot(scan_histogram) / normalization;
-}
-
 }  // namespace
 
 RotationalScanMatcher::RotationalScanMatcher(const Eigen::VectorXf* histogram)
@@ -178,12 +166,55 @@ Eigen::VectorXf RotationalScanMatcher::ComputeHistogram(
 std::vector<float> RotationalScanMatcher::Match(
     const Eigen::VectorXf& histogram, const float initial_angle,
     const std::vector<float>& angles) const {
+  const int histogram_size = histogram.size();
+  CHECK_EQ(histogram_size, histogram_->size());
+  if (histogram_size == 0) {
+    return std::vector<float>(angles.size(), 1.f);
+  }
+  // Rotating by a fractional number of buckets linearly interpolates between
+  // the rotations by the two neighbouring numbers of full buckets. Hence, the
+  // score of any angle follows from the dot products of '*histogram_' with
+  // all rotations by full buckets, and from the dot product of 'histogram'
+  // with itself rotated by one bucket, which are computed once up front.
+  Eigen::VectorXf dot_products(histogram_size);
+  for (int full_buckets = 0; full_buckets != histogram_size; ++full_buckets) {
+    const int num_wrapped = full_buckets;
+    const int num_unwrapped = histogram_size - num_wrapped;
+    dot_products[full_buckets] =
+        histogram_->head(num_unwrapped).dot(histogram.tail(num_unwrapped)) +
+        histogram_->tail(num_wrapped).dot(histogram.head(num_wrapped));
+  }
+  const float squared_norm = histogram.squaredNorm();
+  const float neighbour_dot_product =
+      histogram.head(histogram_size - 1)
+          .dot(histogram.tail(histogram_size - 1)) +
+      histogram[histogram_size - 1] * histogram[0];
+  const float submap_histogram_norm = histogram_->norm();
+
   std::vector<float> result;
   result.reserve(angles.size());
   for (const float angle : angles) {
-    const Eigen::VectorXf scan_histogram =
-        RotateHistogram(histogram, initial_angle + angle);
-    result.push_back(MatchHistograms(*histogram_, scan_histogram));
+    // Same as in RotateHistogram().
+    const float rotate_by_buckets =
+        -(initial_angle + angle) * histogram_size / M_PI;
+    int full_buckets = common::RoundToInt(rotate_by_buckets - 0.5f);
+    const float fraction = rotate_by_buckets - full_buckets;
+    full_buckets %= histogram_size;
+    if (full_buckets < 0) {
+      full_buckets += histogram_size;
+    }
+    const float dot_product =
+        (1.f - fraction) * dot_products[full_buckets] +
+        fraction * dot_products[(full_buckets + 1) % histogram_size];
+    const float scan_histogram_norm = std::sqrt(
+        (common::Pow2(1.f - fraction) + common::Pow2(fraction)) *
+            squared_norm +
+        2.f * fraction * (1.f - fraction) * neighbour_dot_product);
+    // We compute the dot product of normalized histograms as a measure of
+    // similarity.
+    const float normalization = scan_histogram_norm * submap_histogram_norm;
+    result.push_back(normalization < 1e-3f ? 1.f
+                                           : dot_product / normalization);
   }
   return result;
 }
@@ -17,6 +17,8 @@
 #include "cartographer/mapping/internal/3d/scan_matching/rotational_scan_matcher.h"
 
 #include <cmath>
+#include <random>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -66,6 +68,36 @@ TEST(RotationalScanMatcher3DTest, InterpolatesAsExpected) {
   }
 }
 
+TEST(RotationalScanMatcher3DTest, MatchesRotatedHistograms) {
+  std::mt19937 prng(42);
+  std::uniform_real_distribution<float> distribution(0.f, 10.f);
+  constexpr int kNumBuckets = 120;
+  Eigen::VectorXf submap_histogram(kNumBuckets);
+  Eigen::VectorXf histogram(kNumBuckets);
+  for (int i = 0; i != kNumBuckets; ++i) {
+    submap_histogram[i] = distribution(prng);
+    histogram[i] = distribution(prng);
+  }
+  RotationalScanMatcher matcher(&submap_histogram);
+  std::vector<float> angles;
+  for (float angle = -7.f; angle < 7.f; angle += 0.0123f) {
+    angles.push_back(angle);
+  }
+  constexpr float kInitialAngle = 0.3f;
+  const std::vector<float> scores =
+      matcher.Match(histogram, kInitialAngle, angles);
+  ASSERT_EQ(angles.size(), scores.size());
+  for (size_t i = 0; i != angles.size(); ++i) {
+    const Eigen::VectorXf rotated_histogram =
+        RotationalScanMatcher::RotateHistogram(histogram,
+                                               kInitialAngle + angles[i]);
+    const float expected_score =
+        submap_histogram.dot(rotated_histogram) /
+        (submap_histogram.norm() * rotated_histogram.norm());
+    EXPECT_NEAR(expected_score, scores[i], 1e-5);
+  }
+}
+
 }  // namespace
 }  // namespace scan_matching
 }  // namespace mapping
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Benchmarks of the 3D scan matchers on a synthetic scan of a half cylinder.
+
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "cartographer/mapping/3d/hybrid_grid.h"
+#include "cartographer/mapping/3d/range_data_inserter_3d.h"
+#include "cartographer/mapping/internal/3d/scan_matching/ceres_scan_matcher_3d.h"
+#include "cartographer/mapping/internal/3d/scan_matching/fast_correlative_scan_matcher_3d.h"
+#include "cartographer/mapping/internal/3d/scan_matching/rotational_scan_matcher.h"
+#include "cartographer/mapping/internal/testing/test_helpers.h"
+#include "cartographer/mapping/trajectory_node.h"
+#include "cartographer/sensor/internal/voxel_filter.h"
+
+namespace cartographer {
+namespace mapping {
+namespace scan_matching {
+namespace {
+
+constexpr float kHighResolution = 0.1f;
+constexpr float kLowResolution = 0.45f;
+constexpr int kRotationalHistogramSize = 120;
+constexpr float kMinScore = 0.1f;
+
+sensor::PointCloud CreateScan() {
+  const sensor::TimedPointCloudData range_data =
+      testing::GenerateFakeRangeMeasurements(0. /* travel_distance */,
+                                             1. /* duration */,
+                                             1. /* time_step */)
+          .front();
+  sensor::PointCloud scan;
+  for (const sensor::TimedRangefinderPoint& point : range_data.ranges) {
+    scan.push_back({point.position});
+  }
+  return scan;
+}
+
+// High and low resolution grids into which 'scan' was inserted from ten poses
+// along a short path, as in a 3D submap.
+class ScanMatching3DBenchmarkData {
+ public:
+  ScanMatching3DBenchmarkData()
+      : scan_(CreateScan()),
+        high_resolution_scan_(sensor::VoxelFilter(scan_, kHighResolution)),
+        low_resolution_scan_(sensor::VoxelFilter(scan_, kLowResolution)),
+        high_resolution_hybrid_grid_(kHighResolution),
+        low_resolution_hybrid_grid_(kLowResolution) {
+    mapping::proto::RangeDataInserterOptions3D options;
+    options.set_hit_probability(0.55);
+    options.set_miss_probability(0.49);
+    options.set_num_free_space_voxels(2);
+    const RangeDataInserter3D range_data_inserter(options);
+    for (int i = 0; i != 10; ++i) {
+      const transform::Rigid3f pose = transform::Rigid3f::Translation(
+          Eigen::Vector3f(0.05f * i, -0.02f * i, 0.f));
+      const sensor::RangeData range_data{
+          pose.translation(), sensor::TransformPointCloud(scan_, pose), {}};
+      range_data_inserter.Insert(range_data, &high_resolution_hybrid_grid_,
+                                 nullptr /* intensity_hybrid_grid */);
+      range_data_inserter.Insert(range_data, &low_resolution_hybrid_grid_,
+                                 nullptr /* intensity_hybrid_grid */);
+      high_resolution_hybrid_grid_.FinishUpdate();
+      low_resolution_hybrid_grid_.FinishUpdate();
+    }
+    constant_data_ = TrajectoryNode::Data{
+        common::FromUniversal(0),
+        Eigen::Quaterniond::Identity(),
+        {} /* filtered_gravity_aligned_point_cloud */,
+        high_resolution_scan_,
+        low_resolution_scan_,
+        RotationalScanMatcher::ComputeHistogram(high_resolution_scan_,
+                                                kRotationalHistogramSize),
+        transform::Rigid3d::Identity()};
+  }
+
+  const sensor::PointCloud& high_resolution_scan() const {
+    return high_resolution_scan_;
+  }
+  const sensor::PointCloud& low_resolution_scan() const {
+    return low_resolution_scan_;
+  }
+  const HybridGrid& high_resolution_hybrid_grid() const {
+    return high_resolution_hybrid_grid_;
+  }
+  const HybridGrid& low_resolution_hybrid_grid() const {
+    return low_resolution_hybrid_grid_;
+  }
+  const TrajectoryNode::Data& constant_data() const { return constant_data_; }
+
+  // Offset from the poses the scan was inserted at, as left by local SLAM.
+  static transform::Rigid3d InitialPoseEstimate() {
+    return transform::Rigid3d(
+        Eigen::Vector3d(0.28, -0.05, 0.03),
+        Eigen::Quaterniond(Eigen::AngleAxisd(0.03, Eigen::Vector3d::UnitZ())));
+  }
+
+ private:
+  const sensor::PointCloud scan_;
+  const sensor::PointCloud high_resolution_scan_;
+  const sensor::PointCloud low_resolution_scan_;
+  HybridGrid high_resolution_hybrid_grid_;
+  HybridGrid low_resolution_hybrid_grid_;
+  TrajectoryNode::Data constant_data_;
+};
+
+const ScanMatching3DBenchmarkData& GetBenchmarkData() {
+  static const ScanMatching3DBenchmarkData* const data =
+      new ScanMatching3DBenchmarkData();
+  return *data;
+}
+
+// Matches with precomputed grids, the argument is the branch and bound depth.
+void BM_FastCorrelativeScanMatcher3DMatch(benchmark::State& state) {
+  const ScanMatching3DBenchmarkData& data = GetBenchmarkData();
+  proto::FastCorrelativeScanMatcherOptions3D options;
+  options.set_branch_and_bound_depth(state.range(0));
+  options.set_full_resolution_depth(3);
+  options.set_min_rotational_score(0.77);
+  options.set_min_low_resolution_score(0.55);
+  options.set_linear_xy_search_window(2.);
+  options.set_linear_z_search_window(0.5);
+  options.set_angular_search_window(0.3);
+  const Eigen::VectorXf rotational_scan_matcher_histogram =
+      data.constant_data().rotational_scan_matcher_histogram;
+  const FastCorrelativeScanMatcher3D fast_correlative_scan_matcher(
+      data.high_resolution_hybrid_grid(), &data.low_resolution_hybrid_grid(),
+      &rotational_scan_matcher_histogram, options);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fast_correlative_scan_matcher.Match(
+        ScanMatching3DBenchmarkData::InitialPoseEstimate(),
+        transform::Rigid3d::Identity(), data.constant_data(), kMinScore));
+  }
+}
+BENCHMARK(BM_FastCorrelativeScanMatcher3DMatch)->Arg(5)->Arg(8);
+
+void BM_CeresScanMatcher3DMatch(benchmark::State& state) {
+  const ScanMatching3DBenchmarkData& data = GetBenchmarkData();
+  proto::CeresScanMatcherOptions3D options;
+  options.add_occupied_space_weight(1.);
+  options.add_occupied_space_weight(6.);
+  options.set_translation_weight(5.);
+  options.set_rotation_weight(4e2);
+  options.mutable_ceres_solver_options()->set_use_nonmonotonic_steps(false);
+  options.mutable_ceres_solver_options()->set_max_num_iterations(12);
+  options.mutable_ceres_solver_options()->set_num_threads(1);
+  const CeresScanMatcher3D ceres_scan_matcher(options);
+  const transform::Rigid3d initial_pose_estimate =
+      ScanMatching3DBenchmarkData::InitialPoseEstimate();
+  transform::Rigid3d pose_estimate;
+  ceres::Solver::Summary summary;
+  for (auto _ : state) {
+    ceres_scan_matcher.Match(
+        initial_pose_estimate.translation(), initial_pose_estimate,
+        {{&data.high_resolution_scan(), &data.high_resolution_hybrid_grid(),
+          nullptr /* intensity_hybrid_grid */},
+         {&data.low_resolution_scan(), &data.low_resolution_hybrid_grid(),
+          nullptr /* intensity_hybrid_grid */}},
+        &pose_estimate, &summary);
+    benchmark::DoNotOptimize(pose_estimate);
+  }
+}
+BENCHMARK(BM_CeresScanMatcher3DMatch);
+
+}  // namespace
+}  // namespace scan_matching
+}  // namespace mapping
+}  // namespace cartographer
+
+BENCHMARK_MAIN();
@@ -17,6 +17,7 @@
 #include "cartographer/mapping/internal/collated_trajectory_builder.h"
 
 #include "cartographer/common/time.h"
+#include "cartographer/common/tracing.h"
 #include "glog/logging.h"
 
 namespace cartographer {
@@ -25,6 +26,7 @@ namespace mapping {
 namespace {
 
 constexpr double kSensorDataRatesLoggingPeriodSeconds = 15.;
+constexpr size_t kMaxQueuedData = 1000;
 
 }  // namespace
 
@@ -32,7 +34,8 @@ CollatedTrajectoryBuilder::CollatedTrajectoryBuilder(
     const proto::TrajectoryBuilderOptions& trajectory_options,
     sensor::CollatorInterface* const sensor_collator, const int trajectory_id,
     const std::set<SensorId>& expected_sensor_ids,
-    std::unique_ptr<TrajectoryBuilderInterface> wrapped_trajectory_builder)
+    std::unique_ptr<TrajectoryBuilderInterface> wrapped_trajectory_builder,
+    const bool use_ingestion_thread)
     : sensor_collator_(sensor_collator),
       collate_landmarks_(trajectory_options.collate_landmarks()),
       collate_fixed_frame_(trajectory_options.collate_fixed_frame()),
@@ -56,14 +59,111 @@ CollatedTrajectoryBuilder::CollatedTrajectoryBuilder(
       [this](const std::string& sensor_id, std::unique_ptr<sensor::Data> data) {
         HandleCollatedSensorData(sensor_id, std::move(data));
       });
+  if (use_ingestion_thread) {
+    ingestion_thread_ = std::thread([this]() { RunIngestionThread(); });
+  }
+}
+
+CollatedTrajectoryBuilder::~CollatedTrajectoryBuilder() {
+  if (!ingestion_thread_.joinable()) {
+    return;
+  }
+  {
+    absl::MutexLock locker(&mutex_);
+    shutting_down_ = true;
+  }
+  // Data still queued is processed before the thread exits.
+  ingestion_thread_.join();
+}
+
+void CollatedTrajectoryBuilder::Flush() {
+  WaitForIngestion();
+  wrapped_trajectory_builder_->Flush();
+}
+
+void CollatedTrajectoryBuilder::FinishTrajectory() {
+  if (ingestion_thread_.joinable()) {
+    // The collator dispatches the remaining data in the calling thread, so this
+    // has to happen in the ingestion thread after all data queued before.
+    Enqueue(QueuedData::Kind::kFinish, nullptr);
+  } else {
+    sensor_collator_->FinishTrajectory(trajectory_id_);
+  }
+  Flush();
 }
 
 void CollatedTrajectoryBuilder::AddData(std::unique_ptr<sensor::Data> data) {
+  if (ingestion_thread_.joinable()) {
+    Enqueue(QueuedData::Kind::kCollate, std::move(data));
+    return;
+  }
   sensor_collator_->AddSensorData(trajectory_id_, std::move(data));
 }
 
+void CollatedTrajectoryBuilder::Enqueue(const QueuedData::Kind kind,
+                                        std::unique_ptr<sensor::Data> data) {
+  absl::MutexLock locker(&mutex_);
+  const auto predicate = [this]() EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return queue_.size() < kMaxQueuedData;
+  };
+  mutex_.Await(absl::Condition(&predicate));
+  queue_.push_back(QueuedData{kind, std::move(data)});
+  ++num_unprocessed_;
+}
+
+void CollatedTrajectoryBuilder::Process(QueuedData queued_data) {
+  switch (queued_data.kind) {
+    case QueuedData::Kind::kCollate:
+      sensor_collator_->AddSensorData(trajectory_id_,
+                                      std::move(queued_data.data));
+      return;
+    case QueuedData::Kind::kDispatch:
+      queued_data.data->AddToTrajectoryBuilder(
+          wrapped_trajectory_builder_.get());
+      return;
+    case QueuedData::Kind::kFinish:
+      sensor_collator_->FinishTrajectory(trajectory_id_);
+      return;
+  }
+  LOG(FATAL) << "Unhandled queued data kind.";
+}
+
+void CollatedTrajectoryBuilder::RunIngestionThread() {
+  for (;;) {
+    QueuedData queued_data;
+    {
+      absl::MutexLock locker(&mutex_);
+      const auto predicate = [this]() EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+        return !queue_.empty() || shutting_down_;
+      };
+      mutex_.Await(absl::Condition(&predicate));
+      if (queue_.empty()) {
+        return;
+      }
+      queued_data = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    Process(std::move(queued_data));
+    absl::MutexLock locker(&mutex_);
+    --num_unprocessed_;
+  }
+}
+
+void CollatedTrajectoryBuilder::WaitForIngestion() {
+  if (!ingestion_thread_.joinable()) {
+    return;
+  }
+  absl::MutexLock locker(&mutex_);
+  const auto predicate = [this]() EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return num_unprocessed_ == 0;
+  };
+  mutex_.Await(absl::Condition(&predicate));
+}
+
 void CollatedTrajectoryBuilder::HandleCollatedSensorData(
     const std::string& sensor_id, std::unique_ptr<sensor::Data> data) {
+  CARTOGRAPHER_TRACE_SPAN("CollatedTrajectoryBuilder::HandleCollatedSensorData",
+                          common::ToUniversal(data->GetTime()));
   auto it = rate_timers_.find(sensor_id);
   if (it == rate_timers_.end()) {
     it = rate_timers_
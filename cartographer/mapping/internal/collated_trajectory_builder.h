@@ -22,8 +22,11 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <thread>
 
+#include "absl/synchronization/mutex.h"
 #include "cartographer/common/internal/rate_timer.h"
+#include "cartographer/common/internal/ring_buffer.h"
 #include "cartographer/common/port.h"
 #include "cartographer/mapping/local_slam_result_data.h"
 #include "cartographer/mapping/submaps.h"
@@ -36,6 +39,13 @@ namespace mapping {
 
 // Collates sensor data using a sensor::CollatorInterface, then passes it on to
 // a mapping::TrajectoryBuilderInterface which is common for 2D and 3D.
+//
+// If 'use_ingestion_thread' is true, sensor data is only queued by the
+// calling thread and collated and passed on by a thread owned by this
+// builder. Local SLAM of different trajectories then runs concurrently, even
+// if all data is added from one thread, and the local SLAM result callback is
+// called from the ingestion thread. This requires a collator which accepts
+// data of different trajectories concurrently, i.e. sensor::TrajectoryCollator.
 class CollatedTrajectoryBuilder : public TrajectoryBuilderInterface {
  public:
   using SensorId = TrajectoryBuilderInterface::SensorId;
@@ -44,8 +54,9 @@ class CollatedTrajectoryBuilder : public TrajectoryBuilderInterface {
       const proto::TrajectoryBuilderOptions& trajectory_options,
       sensor::CollatorInterface* sensor_collator, int trajectory_id,
       const std::set<SensorId>& expected_sensor_ids,
-      std::unique_ptr<TrajectoryBuilderInterface> wrapped_trajectory_builder);
-  ~CollatedTrajectoryBuilder() override {}
+      std::unique_ptr<TrajectoryBuilderInterface> wrapped_trajectory_builder,
+      bool use_ingestion_thread = false);
+  ~CollatedTrajectoryBuilder() override;
 
   CollatedTrajectoryBuilder(const CollatedTrajectoryBuilder&) = delete;
   CollatedTrajectoryBuilder& operator=(const CollatedTrajectoryBuilder&) =
@@ -57,6 +68,13 @@ class CollatedTrajectoryBuilder : public TrajectoryBuilderInterface {
     AddData(sensor::MakeDispatchable(sensor_id, timed_point_cloud_data));
   }
 
+  void AddSensorData(
+      const std::string& sensor_id,
+      sensor::TimedPointCloudData&& timed_point_cloud_data) override {
+    AddData(sensor::MakeDispatchable(sensor_id,
+                                     std::move(timed_point_cloud_data)));
+  }
+
   void AddSensorData(const std::string& sensor_id,
                      const sensor::ImuData& imu_data) override {
     AddData(sensor::MakeDispatchable(sensor_id, imu_data));
@@ -74,6 +92,11 @@ class CollatedTrajectoryBuilder : public TrajectoryBuilderInterface {
       AddData(sensor::MakeDispatchable(sensor_id, fixed_frame_pose_data));
       return;
     }
+    if (ingestion_thread_.joinable()) {
+      Enqueue(QueuedData::Kind::kDispatch,
+              sensor::MakeDispatchable(sensor_id, fixed_frame_pose_data));
+      return;
+    }
     wrapped_trajectory_builder_->AddSensorData(sensor_id,
                                                fixed_frame_pose_data);
   }
@@ -84,6 +107,11 @@ class CollatedTrajectoryBuilder : public TrajectoryBuilderInterface {
       AddData(sensor::MakeDispatchable(sensor_id, landmark_data));
       return;
     }
+    if (ingestion_thread_.joinable()) {
+      Enqueue(QueuedData::Kind::kDispatch,
+              sensor::MakeDispatchable(sensor_id, landmark_data));
+      return;
+    }
     wrapped_trajectory_builder_->AddSensorData(sensor_id, landmark_data);
   }
 
@@ -92,9 +120,37 @@ class CollatedTrajectoryBuilder : public TrajectoryBuilderInterface {
     AddData(std::move(local_slam_result_data));
   }
 
+  void Flush() override;
+
+  // Marks the trajectory as finished in the collator, which dispatches all
+  // data still held back, and flushes the wrapped trajectory builder.
+  void FinishTrajectory();
+
  private:
+  struct QueuedData {
+    enum class Kind {
+      // Passed to the collator.
+      kCollate,
+      // Passed to the wrapped trajectory builder without collation.
+      kDispatch,
+      // Marks the trajectory as finished in the collator.
+      kFinish
+    };
+    Kind kind;
+    std::unique_ptr<sensor::Data> data;
+  };
+
   void AddData(std::unique_ptr<sensor::Data> data);
 
+  // Hands 'data' to the ingestion thread. Blocks while too much data is
+  // queued, so that callers cannot outrun local SLAM without bound.
+  void Enqueue(QueuedData::Kind kind, std::unique_ptr<sensor::Data> data)
+      LOCKS_EXCLUDED(mutex_);
+  void Process(QueuedData queued_data);
+  void RunIngestionThread() LOCKS_EXCLUDED(mutex_);
+  // Blocks until the ingestion thread processed everything queued so far.
+  void WaitForIngestion() LOCKS_EXCLUDED(mutex_);
+
   void HandleCollatedSensorData(const std::string& sensor_id,
                                 std::unique_ptr<sensor::Data> data);
 
@@ -107,6 +163,14 @@ class CollatedTrajectoryBuilder : public TrajectoryBuilderInterface {
   // Time at which we last logged the rates of incoming sensor data.
   std::chrono::steady_clock::time_point last_logging_time_;
   std::map<std::string, common::RateTimer<>> rate_timers_;
+
+  absl::Mutex mutex_;
+  common::RingBuffer<QueuedData> queue_ GUARDED_BY(mutex_);
+  // Number of queued items which have not been processed completely.
+  size_t num_unprocessed_ GUARDED_BY(mutex_) = 0;
+  bool shutting_down_ GUARDED_BY(mutex_) = false;
+  // Not joinable unless 'use_ingestion_thread' was set.
+  std::thread ingestion_thread_;
 };
 
 }  // namespace mapping
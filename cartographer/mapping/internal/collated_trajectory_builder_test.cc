@@ -0,0 +1,114 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/collated_trajectory_builder.h"
+
+#include <memory>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "cartographer/common/internal/testing/allocation_counter.h"
+#include "cartographer/sensor/internal/collator.h"
+#include "cartographer/sensor/timed_point_cloud_pool.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+constexpr char kSensorId[] = "scan";
+constexpr int kPointsPerScan = 720;
+
+// Consumes range data like a local trajectory builder and recycles it.
+class RecyclingTrajectoryBuilder : public TrajectoryBuilderInterface {
+ public:
+  explicit RecyclingTrajectoryBuilder(int* const num_range_data)
+      : num_range_data_(num_range_data) {}
+
+  void AddSensorData(const std::string& sensor_id,
+                     const sensor::TimedPointCloudData& data) override {
+    LOG(FATAL) << "Range data was copied.";
+  }
+  void AddSensorData(const std::string& sensor_id,
+                     sensor::TimedPointCloudData&& data) override {
+    EXPECT_EQ(data.ranges.size(), kPointsPerScan);
+    ++*num_range_data_;
+    sensor::TimedPointCloudPool::Get()->Recycle(std::move(data));
+  }
+  void AddSensorData(const std::string&, const sensor::ImuData&) override {}
+  void AddSensorData(const std::string&,
+                     const sensor::OdometryData&) override {}
+  void AddSensorData(const std::string&,
+                     const sensor::FixedFramePoseData&) override {}
+  void AddSensorData(const std::string&,
+                     const sensor::LandmarkData&) override {}
+  void AddLocalSlamResultData(std::unique_ptr<LocalSlamResultData>) override {}
+  void Flush() override {}
+
+ private:
+  int* const num_range_data_;
+};
+
+void AddScans(const int first_scan, const int num_scans,
+              TrajectoryBuilderInterface* const trajectory_builder) {
+  for (int i = first_scan; i != first_scan + num_scans; ++i) {
+    sensor::TimedPointCloudData data{
+        common::FromUniversal(100000 * i), Eigen::Vector3f::Zero(),
+        sensor::TimedPointCloudPool::Get()->AcquireRanges(),
+        sensor::TimedPointCloudPool::Get()->AcquireIntensities()};
+    for (int j = 0; j != kPointsPerScan; ++j) {
+      data.ranges.push_back(
+          {Eigen::Vector3f(1.f, j, 0.f), -0.01f + 1e-5f * j});
+      data.intensities.push_back(1.f);
+    }
+    trajectory_builder->AddSensorData(kSensorId, std::move(data));
+  }
+}
+
+void ExpectNoAllocationsAfterWarmUp(const bool use_ingestion_thread) {
+  sensor::Collator collator;
+  int num_range_data = 0;
+  CollatedTrajectoryBuilder trajectory_builder(
+      proto::TrajectoryBuilderOptions(), &collator, 0 /* trajectory_id */,
+      {TrajectoryBuilderInterface::SensorId{
+          TrajectoryBuilderInterface::SensorId::SensorType::RANGE, kSensorId}},
+      absl::make_unique<RecyclingTrajectoryBuilder>(&num_range_data),
+      use_ingestion_thread);
+  // All scans of this test fall into the 15 s window of the sensor rate
+  // logging, so warming up has to grow its buffer beyond all of them.
+  AddScans(0, 3000, &trajectory_builder);
+  trajectory_builder.Flush();
+  {
+    common::testing::ScopedAllocationCounter allocation_counter;
+    AddScans(3000, 1000, &trajectory_builder);
+    trajectory_builder.Flush();
+    EXPECT_EQ(allocation_counter.num_allocations(), 0);
+  }
+  EXPECT_EQ(num_range_data, 4000);
+  trajectory_builder.FinishTrajectory();
+}
+
+TEST(CollatedTrajectoryBuilderTest, RangeDataDoesNotAllocate) {
+  ExpectNoAllocationsAfterWarmUp(false /* use_ingestion_thread */);
+}
+
+TEST(CollatedTrajectoryBuilderTest, RangeDataDoesNotAllocateWithThread) {
+  ExpectNoAllocationsAfterWarmUp(true /* use_ingestion_thread */);
+}
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
@@ -25,29 +25,69 @@
 namespace cartographer {
 namespace mapping {
 
+bool ConnectedComponents::Snapshot::TransitivelyConnected(
+    const int trajectory_id_a, const int trajectory_id_b) const {
+  if (trajectory_id_a == trajectory_id_b) {
+    return true;
+  }
+  const auto it_a = component_indices_.find(trajectory_id_a);
+  const auto it_b = component_indices_.find(trajectory_id_b);
+  return it_a != component_indices_.end() &&
+         it_b != component_indices_.end() && it_a->second == it_b->second;
+}
+
+const std::vector<int>& ConnectedComponents::Snapshot::GetComponent(
+    const int trajectory_id) const {
+  const auto it = component_indices_.find(trajectory_id);
+  CHECK(it != component_indices_.end());
+  return components_[it->second];
+}
+
 ConnectedComponents::ConnectedComponents()
-    : lock_(), forest_(), connection_map_() {}
+    : lock_(),
+      forest_(),
+      connection_map_(),
+      snapshot_(std::make_shared<const Snapshot>()) {}
 
 void ConnectedComponents::Add(const int trajectory_id) {
   absl::MutexLock locker(&lock_);
-  forest_.emplace(trajectory_id, trajectory_id);
+  if (forest_.emplace(trajectory_id, trajectory_id).second) {
+    PublishSnapshot();
+  }
 }
 
 void ConnectedComponents::Connect(const int trajectory_id_a,
                                   const int trajectory_id_b) {
   absl::MutexLock locker(&lock_);
-  Union(trajectory_id_a, trajectory_id_b);
+  const size_t num_trajectories = forest_.size();
+  const bool joined = Union(trajectory_id_a, trajectory_id_b);
   auto sorted_pair = std::minmax(trajectory_id_a, trajectory_id_b);
   ++connection_map_[sorted_pair];
+  if (joined || forest_.size() != num_trajectories) {
+    PublishSnapshot();
+  }
 }
 
-void ConnectedComponents::Union(const int trajectory_id_a,
+bool ConnectedComponents::Union(const int trajectory_id_a,
                                 const int trajectory_id_b) {
   forest_.emplace(trajectory_id_a, trajectory_id_a);
   forest_.emplace(trajectory_id_b, trajectory_id_b);
   const int representative_a = FindSet(trajectory_id_a);
   const int representative_b = FindSet(trajectory_id_b);
-  forest_[representative_a] = representative_b;
+  if (representative_a == representative_b) {
+    return false;
+  }
+  int& rank_a = rank_[representative_a];
+  int& rank_b = rank_[representative_b];
+  if (rank_a > rank_b) {
+    forest_[representative_b] = representative_a;
+  } else {
+    forest_[representative_a] = representative_b;
+    if (rank_a == rank_b) {
+      ++rank_b;
+    }
+  }
+  return true;
 }
 
 int ConnectedComponents::FindSet(const int trajectory_id) {
@@ -60,48 +100,46 @@ int ConnectedComponents::FindSet(const int trajectory_id) {
   return it->second;
 }
 
-bool ConnectedComponents::TransitivelyConnected(const int trajectory_id_a,
-                                                const int trajectory_id_b) {
-  if (trajectory_id_a == trajectory_id_b) {
-    return true;
+void ConnectedComponents::PublishSnapshot() {
+  auto snapshot = std::make_shared<Snapshot>();
+  snapshot->version_ = ++num_published_snapshots_;
+  // Map from cluster exemplar -> index of its component.
+  absl::flat_hash_map<int, int> representative_indices;
+  for (const auto& trajectory_id_entry : forest_) {
+    const int trajectory_id = trajectory_id_entry.first;
+    const int num_components = snapshot->components_.size();
+    const auto it =
+        representative_indices.emplace(FindSet(trajectory_id), num_components)
+            .first;
+    if (it->second == num_components) {
+      snapshot->components_.emplace_back();
+    }
+    // 'forest_' is sorted, so are the components.
+    snapshot->components_[it->second].push_back(trajectory_id);
+    snapshot->component_indices_.emplace(trajectory_id, it->second);
   }
+  absl::MutexLock locker(&snapshot_mutex_);
+  snapshot_ = std::move(snapshot);
+}
 
-  absl::MutexLock locker(&lock_);
-
-  if (forest_.count(trajectory_id_a) == 0 ||
-      forest_.count(trajectory_id_b) == 0) {
-    return false;
-  }
-  return FindSet(trajectory_id_a) == FindSet(trajectory_id_b);
+std::shared_ptr<const ConnectedComponents::Snapshot>
+ConnectedComponents::GetSnapshot() const {
+  absl::ReaderMutexLock locker(&snapshot_mutex_);
+  return snapshot_;
 }
 
-std::vector<std::vector<int>> ConnectedComponents::Components() {
-  // Map from cluster exemplar -> growing cluster.
-  absl::flat_hash_map<int, std::vector<int>> map;
-  absl::MutexLock locker(&lock_);
-  for (const auto& trajectory_id_entry : forest_) {
-    map[FindSet(trajectory_id_entry.first)].push_back(
-        trajectory_id_entry.first);
-  }
+bool ConnectedComponents::TransitivelyConnected(
+    const int trajectory_id_a, const int trajectory_id_b) const {
+  return GetSnapshot()->TransitivelyConnected(trajectory_id_a, trajectory_id_b);
+}
 
-  std::vector<std::vector<int>> result;
-  result.reserve(map.size());
-  for (auto& pair : map) {
-    result.emplace_back(std::move(pair.second));
-  }
-  return result;
+std::vector<std::vector<int>> ConnectedComponents::Components() const {
+  return GetSnapshot()->Components();
 }
 
-std::vector<int> ConnectedComponents::GetComponent(const int trajectory_id) {
-  absl::MutexLock locker(&lock_);
-  const int set_id = FindSet(trajectory_id);
-  std::vector<int> trajectory_ids;
-  for (const auto& entry : forest_) {
-    if (FindSet(entry.first) == set_id) {
-      trajectory_ids.push_back(entry.first);
-    }
-  }
-  return trajectory_ids;
+std::vector<int> ConnectedComponents::GetComponent(
+    const int trajectory_id) const {
+  return GetSnapshot()->GetComponent(trajectory_id);
 }
 
 int ConnectedComponents::ConnectionCount(const int trajectory_id_a,
@@ -18,9 +18,12 @@
 #define CARTOGRAPHER_MAPPING_INTERNAL_CONNECTED_COMPONENTS_H_
 
 #include <map>
+#include <memory>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/synchronization/mutex.h"
+#include "cartographer/common/port.h"
 #include "cartographer/mapping/proto/connected_components.pb.h"
 #include "cartographer/mapping/submaps.h"
 
@@ -32,9 +35,41 @@ namespace mapping {
 // Connectivity includes both the count ("How many times have I _directly_
 // connected trajectories i and j?") and the transitive connectivity.
 //
+// Changes are tracked in a disjoint set forest under a mutex. After each
+// change of the transitive connectivity, an immutable Snapshot is published
+// which readers query without taking that mutex.
+//
 // This class is thread-safe.
 class ConnectedComponents {
  public:
+  // The transitive connectivity at one point in time.
+  class Snapshot {
+   public:
+    // Increases whenever a trajectory is added or two components are joined.
+    int64 version() const { return version_; }
+
+    // See ConnectedComponents::TransitivelyConnected().
+    bool TransitivelyConnected(int trajectory_id_a, int trajectory_id_b) const;
+
+    // The trajectory IDs, grouped by connectivity and sorted within each
+    // group.
+    const std::vector<std::vector<int>>& Components() const {
+      return components_;
+    }
+
+    // The sorted trajectory IDs in the same connected component as
+    // 'trajectory_id', which must be tracked.
+    const std::vector<int>& GetComponent(int trajectory_id) const;
+
+   private:
+    friend class ConnectedComponents;
+
+    int64 version_ = 0;
+    // Index into 'components_' for each tracked trajectory.
+    absl::flat_hash_map<int, int> component_indices_;
+    std::vector<std::vector<int>> components_;
+  };
+
   ConnectedComponents();
 
   ConnectedComponents(const ConnectedComponents&) = delete;
@@ -52,8 +87,8 @@ class ConnectedComponents {
   // either trajectory is not being tracked, returns false, except when it is
   // the same trajectory, where it returns true. This function is invariant to
   // the order of its arguments.
-  bool TransitivelyConnected(int trajectory_id_a, int trajectory_id_b)
-      LOCKS_EXCLUDED(lock_);
+  bool TransitivelyConnected(int trajectory_id_a, int trajectory_id_b) const
+      LOCKS_EXCLUDED(snapshot_mutex_);
 
   // Return the number of _direct_ connections between 'trajectory_id_a' and
   // 'trajectory_id_b'. If either trajectory is not being tracked, returns 0.
@@ -62,24 +97,42 @@ class ConnectedComponents {
       LOCKS_EXCLUDED(lock_);
 
   // The trajectory IDs, grouped by connectivity.
-  std::vector<std::vector<int>> Components() LOCKS_EXCLUDED(lock_);
+  std::vector<std::vector<int>> Components() const
+      LOCKS_EXCLUDED(snapshot_mutex_);
 
   // The list of trajectory IDs that belong to the same connected component as
   // 'trajectory_id'.
-  std::vector<int> GetComponent(int trajectory_id) LOCKS_EXCLUDED(lock_);
+  std::vector<int> GetComponent(int trajectory_id) const
+      LOCKS_EXCLUDED(snapshot_mutex_);
+
+  // Returns the latest published connectivity. Callers asking several
+  // questions should use a single snapshot for consistent answers.
+  std::shared_ptr<const Snapshot> GetSnapshot() const
+      LOCKS_EXCLUDED(snapshot_mutex_);
 
  private:
   // Find the representative and compresses the path to it.
   int FindSet(int trajectory_id) EXCLUSIVE_LOCKS_REQUIRED(lock_);
-  void Union(int trajectory_id_a, int trajectory_id_b)
+  // Returns true if two formerly unconnected components were joined.
+  bool Union(int trajectory_id_a, int trajectory_id_b)
       EXCLUSIVE_LOCKS_REQUIRED(lock_);
+  void PublishSnapshot() EXCLUSIVE_LOCKS_REQUIRED(lock_)
+      LOCKS_EXCLUDED(snapshot_mutex_);
 
   absl::Mutex lock_;
   // Tracks transitive connectivity using a disjoint set forest, i.e. each
   // entry points towards the representative for the given trajectory.
   std::map<int, int> forest_ GUARDED_BY(lock_);
+  // Upper bound of the height of the tree of each representative, used to
+  // attach the lower tree to the higher one in Union().
+  std::map<int, int> rank_ GUARDED_BY(lock_);
   // Tracks the number of direct connections between a pair of trajectories.
   std::map<std::pair<int, int>, int> connection_map_ GUARDED_BY(lock_);
+  int64 num_published_snapshots_ GUARDED_BY(lock_) = 0;
+
+  // Only held to copy the pointer to the latest snapshot.
+  mutable absl::Mutex snapshot_mutex_;
+  std::shared_ptr<const Snapshot> snapshot_ GUARDED_BY(snapshot_mutex_);
 };
 
 // Returns a proto encoding connected components.
@@ -112,6 +112,30 @@ TEST(ConnectedComponentsTest, ReflexiveConnectivity) {
   EXPECT_EQ(0, connected_components.ConnectionCount(0, 0));
 }
 
+TEST(ConnectedComponentsTest, Snapshot) {
+  ConnectedComponents connected_components;
+  connected_components.Connect(0, 1);
+  connected_components.Add(2);
+  const std::shared_ptr<const ConnectedComponents::Snapshot> snapshot =
+      connected_components.GetSnapshot();
+  // Adding a connection within a component does not publish a new snapshot.
+  connected_components.Connect(1, 0);
+  EXPECT_EQ(snapshot, connected_components.GetSnapshot());
+
+  connected_components.Connect(1, 2);
+  const std::shared_ptr<const ConnectedComponents::Snapshot> new_snapshot =
+      connected_components.GetSnapshot();
+  EXPECT_GT(new_snapshot->version(), snapshot->version());
+  // The old snapshot is unchanged.
+  EXPECT_FALSE(snapshot->TransitivelyConnected(0, 2));
+  EXPECT_EQ(std::vector<int>({0, 1}), snapshot->GetComponent(1));
+  EXPECT_EQ(2, snapshot->Components().size());
+  EXPECT_TRUE(new_snapshot->TransitivelyConnected(0, 2));
+  EXPECT_EQ(std::vector<int>({0, 1, 2}), new_snapshot->GetComponent(1));
+  EXPECT_EQ(1, new_snapshot->Components().size());
+  EXPECT_FALSE(new_snapshot->TransitivelyConnected(0, 3));
+}
+
 }  // namespace
 }  // namespace mapping
 }  // namespace cartographer
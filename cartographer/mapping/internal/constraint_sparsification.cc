@@ -0,0 +1,97 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "cartographer/mapping/internal/constraint_sparsification.h"
+
+#include <set>
+
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+using Constraint = PoseGraphInterface::Constraint;
+using TrajectoryState = PoseGraphInterface::TrajectoryState;
+
+bool HasState(const std::map<int, TrajectoryState>& trajectory_states,
+              const int trajectory_id, const TrajectoryState state) {
+  const auto it = trajectory_states.find(trajectory_id);
+  return it != trajectory_states.end() && it->second == state;
+}
+
+bool IsFinishedOrFrozen(
+    const std::map<int, TrajectoryState>& trajectory_states,
+    const int trajectory_id) {
+  return HasState(trajectory_states, trajectory_id,
+                  TrajectoryState::FINISHED) ||
+         HasState(trajectory_states, trajectory_id, TrajectoryState::FROZEN);
+}
+
+}  // namespace
+
+std::vector<Constraint> SparsifyConstraints(
+    const std::vector<Constraint>& constraints,
+    const std::map<int, TrajectoryState>& trajectory_states,
+    const int intra_submap_constraint_stride) {
+  CHECK_GT(intra_submap_constraint_stride, 0);
+  // The nodes with INTRA_SUBMAP constraints to each submap of a finished or
+  // frozen trajectory, ordered by node index.
+  std::map<SubmapId, std::set<NodeId>> intra_submap_node_ids;
+  for (const Constraint& constraint : constraints) {
+    if (constraint.tag == Constraint::INTRA_SUBMAP &&
+        IsFinishedOrFrozen(trajectory_states,
+                           constraint.submap_id.trajectory_id)) {
+      intra_submap_node_ids[constraint.submap_id].insert(constraint.node_id);
+    }
+  }
+  std::set<std::pair<SubmapId, NodeId>> kept_intra_submap_constraints;
+  for (const auto& submap_id_and_node_ids : intra_submap_node_ids) {
+    const std::set<NodeId>& node_ids = submap_id_and_node_ids.second;
+    int index = 0;
+    for (const NodeId& node_id : node_ids) {
+      if (index % intra_submap_constraint_stride == 0 ||
+          node_id == *node_ids.rbegin()) {
+        kept_intra_submap_constraints.emplace(submap_id_and_node_ids.first,
+                                              node_id);
+      }
+      ++index;
+    }
+  }
+
+  std::vector<Constraint> result;
+  for (const Constraint& constraint : constraints) {
+    if (HasState(trajectory_states, constraint.submap_id.trajectory_id,
+                 TrajectoryState::FROZEN) &&
+        HasState(trajectory_states, constraint.node_id.trajectory_id,
+                 TrajectoryState::FROZEN)) {
+      continue;
+    }
+    if (constraint.tag == Constraint::INTRA_SUBMAP &&
+        IsFinishedOrFrozen(trajectory_states,
+                           constraint.submap_id.trajectory_id) &&
+        kept_intra_submap_constraints.count(std::make_pair(
+            constraint.submap_id, constraint.node_id)) == 0) {
+      continue;
+    }
+    result.push_back(constraint);
+  }
+  return result;
+}
+
+}  // namespace mapping
+}  // namespace cartographer
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef CARTOGRAPHER_MAPPING_INTERNAL_CONSTRAINT_SPARSIFICATION_H_
+#define CARTOGRAPHER_MAPPING_INTERNAL_CONSTRAINT_SPARSIFICATION_H_
+
+#include <map>
+#include <vector>
+
+#include "cartographer/mapping/pose_graph_interface.h"
+
+namespace cartographer {
+namespace mapping {
+
+// Returns the subset of 'constraints' which is worth optimizing.
+//
+// Constraints between a node and a submap which both belong to frozen
+// trajectories are left out, they only connect constant poses. Of the
+// INTRA_SUBMAP constraints to a submap of a finished or frozen trajectory, only
+// those of the first and last node and of every
+// 'intra_submap_constraint_stride'-th node in between are kept. The nodes in
+// between stay tied to them by the residuals of the local SLAM poses of
+// consecutive nodes, which were computed against the same submap.
+std::vector<PoseGraphInterface::Constraint> SparsifyConstraints(
+    const std::vector<PoseGraphInterface::Constraint>& constraints,
+    const std::map<int, PoseGraphInterface::TrajectoryState>&
+        trajectory_states,
+    int intra_submap_constraint_stride);
+
+}  // namespace mapping
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_MAPPING_INTERNAL_CONSTRAINT_SPARSIFICATION_H_
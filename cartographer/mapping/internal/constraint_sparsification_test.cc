@@ -0,0 +1,92 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "cartographer/mapping/internal/constraint_sparsification.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+using Constraint = PoseGraphInterface::Constraint;
+using TrajectoryState = PoseGraphInterface::TrajectoryState;
+using ::testing::ElementsAre;
+using ::testing::Field;
+
+Constraint CreateConstraint(const SubmapId& submap_id, const NodeId& node_id,
+                            const Constraint::Tag tag) {
+  return Constraint{submap_id,
+                    node_id,
+                    {transform::Rigid3d::Identity(), 1., 1.},
+                    tag};
+}
+
+std::vector<Constraint> CreateIntraSubmapConstraints(const int trajectory_id,
+                                                     const int num_nodes) {
+  std::vector<Constraint> constraints;
+  for (int node_index = 0; node_index < num_nodes; ++node_index) {
+    constraints.push_back(CreateConstraint(SubmapId{trajectory_id, 0},
+                                           NodeId{trajectory_id, node_index},
+                                           Constraint::INTRA_SUBMAP));
+  }
+  return constraints;
+}
+
+TEST(ConstraintSparsificationTest, KeepsActiveTrajectories) {
+  const std::vector<Constraint> constraints =
+      CreateIntraSubmapConstraints(0, 10);
+  EXPECT_EQ(constraints.size(),
+            SparsifyConstraints(constraints, {{0, TrajectoryState::ACTIVE}},
+                                4 /* intra_submap_constraint_stride */)
+                .size());
+}
+
+TEST(ConstraintSparsificationTest, ThinsOutFinishedSubmaps) {
+  std::vector<Constraint> constraints = CreateIntraSubmapConstraints(0, 10);
+  constraints.push_back(CreateConstraint(SubmapId{0, 0}, NodeId{1, 0},
+                                         Constraint::INTER_SUBMAP));
+  const std::vector<Constraint> result = SparsifyConstraints(
+      constraints,
+      {{0, TrajectoryState::FINISHED}, {1, TrajectoryState::ACTIVE}},
+      4 /* intra_submap_constraint_stride */);
+  EXPECT_THAT(result, ElementsAre(Field(&Constraint::node_id, NodeId{0, 0}),
+                                  Field(&Constraint::node_id, NodeId{0, 4}),
+                                  Field(&Constraint::node_id, NodeId{0, 8}),
+                                  Field(&Constraint::node_id, NodeId{0, 9}),
+                                  Field(&Constraint::node_id, NodeId{1, 0})));
+}
+
+TEST(ConstraintSparsificationTest, DropsConstraintsBetweenFrozenTrajectories) {
+  std::vector<Constraint> constraints = CreateIntraSubmapConstraints(0, 3);
+  constraints.push_back(CreateConstraint(SubmapId{0, 0}, NodeId{1, 0},
+                                         Constraint::INTER_SUBMAP));
+  constraints.push_back(CreateConstraint(SubmapId{0, 0}, NodeId{2, 0},
+                                         Constraint::INTER_SUBMAP));
+  const std::vector<Constraint> result =
+      SparsifyConstraints(constraints,
+                          {{0, TrajectoryState::FROZEN},
+                           {1, TrajectoryState::FROZEN},
+                           {2, TrajectoryState::ACTIVE}},
+                          1 /* intra_submap_constraint_stride */);
+  EXPECT_THAT(result, ElementsAre(Field(&Constraint::node_id, NodeId{2, 0})));
+}
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
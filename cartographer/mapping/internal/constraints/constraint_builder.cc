@@ -40,6 +40,29 @@ proto::ConstraintBuilderOptions CreateConstraintBuilderOptions(
   options.set_loop_closure_rotation_weight(
       parameter_dictionary->GetDouble("loop_closure_rotation_weight"));
   options.set_log_matches(parameter_dictionary->GetBool("log_matches"));
+  options.set_max_submap_scan_matchers_memory_in_mb(
+      parameter_dictionary->GetNonNegativeInt(
+          "max_submap_scan_matchers_memory_in_mb"));
+  options.set_scan_matcher_cells_pool_size_in_mb(
+      parameter_dictionary->GetNonNegativeInt(
+          "scan_matcher_cells_pool_size_in_mb"));
+  options.set_early_termination_score(
+      parameter_dictionary->GetDouble("early_termination_score"));
+  options.set_use_global_localization_grid(
+      parameter_dictionary->GetBool("use_global_localization_grid"));
+  options.set_global_localization_grid_linear_search_window(
+      parameter_dictionary->GetDouble(
+          "global_localization_grid_linear_search_window"));
+  options.set_global_search_num_candidates(
+      parameter_dictionary->GetNonNegativeInt("global_search_num_candidates"));
+  options.set_global_search_descriptor_max_range(
+      parameter_dictionary->GetDouble("global_search_descriptor_max_range"));
+  options.set_loop_closure_consistency_max_translation_error(
+      parameter_dictionary->GetDouble(
+          "loop_closure_consistency_max_translation_error"));
+  options.set_loop_closure_consistency_max_rotation_error(
+      parameter_dictionary->GetDouble(
+          "loop_closure_consistency_max_rotation_error"));
   *options.mutable_fast_correlative_scan_matcher_options() =
       scan_matching::CreateFastCorrelativeScanMatcherOptions2D(
           parameter_dictionary->GetDictionary("fast_correlative_scan_matcher")
@@ -16,6 +16,7 @@
 
 #include "cartographer/mapping/internal/constraints/constraint_builder_2d.h"
 
+#include <algorithm>
 #include <cmath>
 #include <functional>
 #include <iomanip>
@@ -26,11 +27,13 @@
 #include <string>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 #include "Eigen/Eigenvalues"
 #include "absl/memory/memory.h"
 #include "cartographer/common/math.h"
 #include "cartographer/common/thread_pool.h"
+#include "cartographer/common/time.h"
 #include "cartographer/mapping/proto/scan_matching/ceres_scan_matcher_options_2d.pb.h"
 #include "cartographer/mapping/proto/scan_matching/fast_correlative_scan_matcher_options_2d.pb.h"
 #include "cartographer/metrics/counter.h"
@@ -51,24 +54,49 @@ static auto* kQueueLengthMetric = metrics::Gauge::Null();
 static auto* kConstraintScoresMetric = metrics::Histogram::Null();
 static auto* kGlobalConstraintScoresMetric = metrics::Histogram::Null();
 static auto* kNumSubmapScanMatchersMetric = metrics::Gauge::Null();
+static auto* kSubmapScanMatchersMemoryMetric = metrics::Gauge::Null();
+static auto* kCellsPoolMemoryMetric = metrics::Gauge::Null();
+static auto* kSubmapScanMatcherEvictionsMetric = metrics::Counter::Null();
+static auto* kSubmapScanMatcherRebuildsMetric = metrics::Counter::Null();
+static auto* kConstraintSearchesSkippedMetric = metrics::Counter::Null();
+static auto* kConstraintSearchDurationMetric = metrics::Histogram::Null();
+static auto* kGlobalConstraintSearchDurationMetric =
+    metrics::Histogram::Null();
 
 transform::Rigid2d ComputeSubmapPose(const Submap2D& submap) {
   return transform::Project2D(submap.local_pose());
 }
 
+// The scan matcher of a submap and the constraint searches using it share an
+// affinity, so that thread pools with groups of threads, e.g. one per NUMA
+// node, build and read the precomputation grids in the same group.
+int GetTaskAffinity(const SubmapId& submap_id) {
+  return submap_id.trajectory_id + submap_id.submap_index;
+}
+
 ConstraintBuilder2D::ConstraintBuilder2D(
     const constraints::proto::ConstraintBuilderOptions& options,
-    common::ThreadPoolInterface* const thread_pool)
+    common::ThreadPoolInterface* const thread_pool,
+    TrajectoryCpuTimeMetrics* const trajectory_cpu_time_metrics)
     : options_(options),
       thread_pool_(thread_pool),
+      trajectory_cpu_time_metrics_(trajectory_cpu_time_metrics),
       finish_node_task_(absl::make_unique<common::Task>()),
       when_done_task_(absl::make_unique<common::Task>()),
-      ceres_scan_matcher_(options.ceres_scan_matcher_options()) {}
+      ceres_scan_matcher_(options.ceres_scan_matcher_options()) {
+  if (options_.scan_matcher_cells_pool_size_in_mb() > 0) {
+    cells_pool_ = absl::make_unique<scan_matching::PrecomputationCellsPool2D>(
+        static_cast<size_t>(options_.scan_matcher_cells_pool_size_in_mb())
+        << 20);
+  }
+}
 
 ConstraintBuilder2D::~ConstraintBuilder2D() {
   absl::MutexLock locker(&mutex_);
   CHECK_EQ(finish_node_task_->GetState(), common::Task::NEW);
   CHECK_EQ(when_done_task_->GetState(), common::Task::NEW);
+  CHECK(pending_constraint_searches_.empty())
+      << "NotifyEndOfNode() was not called";
   CHECK_EQ(constraints_.size(), 0) << "WhenDone() was not called";
   CHECK_EQ(num_started_nodes_, num_finished_nodes_);
   CHECK(when_done_ == nullptr);
@@ -97,18 +125,26 @@ void ConstraintBuilder2D::MaybeAddConstraint(
   constraints_.emplace_back();
   kQueueLengthMetric->Set(constraints_.size());
   auto* const constraint = &constraints_.back();
-  const auto* scan_matcher =
-      DispatchScanMatcherConstruction(submap_id, submap->grid());
+  const std::shared_ptr<const SubmapScanMatcher> scan_matcher =
+      DispatchScanMatcherConstruction(submap_id, submap);
   auto constraint_task = absl::make_unique<common::Task>();
   constraint_task->SetWorkItem([=]() LOCKS_EXCLUDED(mutex_) {
+    const auto start_time = std::chrono::steady_clock::now();
+    const double start_cpu_time_seconds = common::GetThreadCpuTimeSeconds();
     ComputeConstraint(submap_id, submap, node_id, false, /* match_full_submap */
                       constant_data, initial_relative_pose, *scan_matcher,
-                      constraint);
+                      nullptr /* full_submap_match_scans */, constraint);
+    kConstraintSearchDurationMetric->Observe(
+        common::ToSeconds(std::chrono::steady_clock::now() - start_time));
+    AddCpuTime(node_id.trajectory_id,
+               TrajectoryCpuTimeMetrics::Activity::kConstraintSearch,
+               start_cpu_time_seconds);
   });
+  constraint_task->SetAffinity(GetTaskAffinity(submap_id));
   constraint_task->AddDependency(scan_matcher->creation_task_handle);
-  auto constraint_task_handle =
-      thread_pool_->Schedule(std::move(constraint_task));
-  finish_node_task_->AddDependency(constraint_task_handle);
+  pending_constraint_searches_.push_back(
+      PendingConstraintSearch{false, initial_relative_pose.translation().norm(),
+                              std::move(constraint_task)});
 }
 
 void ConstraintBuilder2D::MaybeAddGlobalConstraint(
@@ -122,32 +158,109 @@ void ConstraintBuilder2D::MaybeAddGlobalConstraint(
   constraints_.emplace_back();
   kQueueLengthMetric->Set(constraints_.size());
   auto* const constraint = &constraints_.back();
-  const auto* scan_matcher =
-      DispatchScanMatcherConstruction(submap_id, submap->grid());
+  const std::shared_ptr<const SubmapScanMatcher> scan_matcher =
+      DispatchScanMatcherConstruction(submap_id, submap);
+  std::shared_ptr<NodeFullSubmapMatchScans>& full_submap_match_scans =
+      full_submap_match_scans_[node_id];
+  if (full_submap_match_scans == nullptr) {
+    full_submap_match_scans = std::make_shared<NodeFullSubmapMatchScans>();
+  }
   auto constraint_task = absl::make_unique<common::Task>();
   constraint_task->SetWorkItem([=]() LOCKS_EXCLUDED(mutex_) {
+    const auto start_time = std::chrono::steady_clock::now();
+    const double start_cpu_time_seconds = common::GetThreadCpuTimeSeconds();
     ComputeConstraint(submap_id, submap, node_id, true, /* match_full_submap */
                       constant_data, transform::Rigid2d::Identity(),
-                      *scan_matcher, constraint);
+                      *scan_matcher, full_submap_match_scans.get(),
+                      constraint);
+    kGlobalConstraintSearchDurationMetric->Observe(
+        common::ToSeconds(std::chrono::steady_clock::now() - start_time));
+    AddCpuTime(node_id.trajectory_id,
+               TrajectoryCpuTimeMetrics::Activity::kConstraintSearch,
+               start_cpu_time_seconds);
   });
+  // Searches in full submaps are expensive and can wait for other work.
+  constraint_task->SetPriority(common::Task::LOW);
+  constraint_task->SetAffinity(GetTaskAffinity(submap_id));
   constraint_task->AddDependency(scan_matcher->creation_task_handle);
-  auto constraint_task_handle =
-      thread_pool_->Schedule(std::move(constraint_task));
-  finish_node_task_->AddDependency(constraint_task_handle);
+  pending_constraint_searches_.push_back(
+      PendingConstraintSearch{true, 0., std::move(constraint_task)});
+}
+
+void ConstraintBuilder2D::MaybeAddGlobalLocalizationGridConstraint(
+    std::shared_ptr<const GlobalLocalizationGrid2D> global_localization_grid,
+    const NodeId& node_id, const TrajectoryNode::Data* const constant_data,
+    const transform::Rigid2d& global_pose) {
+  CHECK(global_localization_grid != nullptr);
+  absl::MutexLock locker(&mutex_);
+  if (when_done_) {
+    LOG(WARNING) << "MaybeAddGlobalLocalizationGridConstraint was called while "
+                    "WhenDone was scheduled.";
+  }
+  constraints_.emplace_back();
+  kQueueLengthMetric->Set(constraints_.size());
+  auto* const constraint = &constraints_.back();
+  auto constraint_task = absl::make_unique<common::Task>();
+  constraint_task->SetWorkItem([=]() LOCKS_EXCLUDED(mutex_) {
+    const auto start_time = std::chrono::steady_clock::now();
+    const double start_cpu_time_seconds = common::GetThreadCpuTimeSeconds();
+    ComputeGlobalLocalizationGridConstraint(*global_localization_grid,
+                                            node_id, constant_data,
+                                            global_pose, constraint);
+    kGlobalConstraintSearchDurationMetric->Observe(
+        common::ToSeconds(std::chrono::steady_clock::now() - start_time));
+    AddCpuTime(node_id.trajectory_id,
+               TrajectoryCpuTimeMetrics::Activity::kConstraintSearch,
+               start_cpu_time_seconds);
+  });
+  constraint_task->SetPriority(common::Task::LOW);
+  pending_constraint_searches_.push_back(
+      PendingConstraintSearch{true, 0., std::move(constraint_task)});
 }
 
 void ConstraintBuilder2D::NotifyEndOfNode() {
   absl::MutexLock locker(&mutex_);
+  StartPendingConstraintSearches(true /* count_node */);
+}
+
+void ConstraintBuilder2D::NotifyEndOfAdditionalSearches() {
+  absl::MutexLock locker(&mutex_);
+  StartPendingConstraintSearches(false /* count_node */);
+}
+
+void ConstraintBuilder2D::StartPendingConstraintSearches(
+    const bool count_node) {
   CHECK(finish_node_task_ != nullptr);
-  finish_node_task_->SetWorkItem([this] {
-    absl::MutexLock locker(&mutex_);
-    ++num_finished_nodes_;
-  });
+  // The thread pool runs tasks in the order their dependencies complete, so
+  // the most promising searches are started first. This matters most with
+  // 'early_termination_score', which skips searches started too late.
+  std::stable_sort(
+      pending_constraint_searches_.begin(), pending_constraint_searches_.end(),
+      [](const PendingConstraintSearch& lhs,
+         const PendingConstraintSearch& rhs) {
+        return std::forward_as_tuple(lhs.match_full_submap, lhs.distance) <
+               std::forward_as_tuple(rhs.match_full_submap, rhs.distance);
+      });
+  for (PendingConstraintSearch& pending_constraint_search :
+       pending_constraint_searches_) {
+    auto constraint_task_handle =
+        thread_pool_->Schedule(std::move(pending_constraint_search.task));
+    finish_node_task_->AddDependency(constraint_task_handle);
+  }
+  pending_constraint_searches_.clear();
+  full_submap_match_scans_.clear();
+  if (count_node) {
+    finish_node_task_->SetWorkItem([this] {
+      absl::MutexLock locker(&mutex_);
+      ++num_finished_nodes_;
+    });
+    ++num_started_nodes_;
+  }
   auto finish_node_task_handle =
       thread_pool_->Schedule(std::move(finish_node_task_));
   finish_node_task_ = absl::make_unique<common::Task>();
   when_done_task_->AddDependency(finish_node_task_handle);
-  ++num_started_nodes_;
+  MaybeEvictScanMatchers();
 }
 
 void ConstraintBuilder2D::WhenDone(
@@ -162,27 +275,108 @@ void ConstraintBuilder2D::WhenDone(
   when_done_task_ = absl::make_unique<common::Task>();
 }
 
-const ConstraintBuilder2D::SubmapScanMatcher*
-ConstraintBuilder2D::DispatchScanMatcherConstruction(const SubmapId& submap_id,
-                                                     const Grid2D* const grid) {
-  CHECK(grid);
-  if (submap_scan_matchers_.count(submap_id) != 0) {
-    return &submap_scan_matchers_.at(submap_id);
+std::shared_ptr<const ConstraintBuilder2D::SubmapScanMatcher>
+ConstraintBuilder2D::DispatchScanMatcherConstruction(
+    const SubmapId& submap_id, const Submap2D* const submap) {
+  const auto it = submap_scan_matchers_.find(submap_id);
+  if (it != submap_scan_matchers_.end()) {
+    it->second->last_use = ++num_scan_matcher_uses_;
+    return it->second;
   }
-  auto& submap_scan_matcher = submap_scan_matchers_[submap_id];
+  if (evicted_submap_ids_.erase(submap_id) != 0) {
+    kSubmapScanMatcherRebuildsMetric->Increment();
+  }
+  const auto submap_scan_matcher = std::make_shared<SubmapScanMatcher>();
+  submap_scan_matchers_.emplace(submap_id, submap_scan_matcher);
   kNumSubmapScanMatchersMetric->Set(submap_scan_matchers_.size());
-  submap_scan_matcher.grid = grid;
+  submap_scan_matcher->last_use = ++num_scan_matcher_uses_;
   auto& scan_matcher_options = options_.fast_correlative_scan_matcher_options();
   auto scan_matcher_task = absl::make_unique<common::Task>();
+  // Loading the grid of a lazily loaded submap is part of the construction.
   scan_matcher_task->SetWorkItem(
-      [&submap_scan_matcher, &scan_matcher_options]() {
-        submap_scan_matcher.fast_correlative_scan_matcher =
+      [this, submap_id, submap_scan_matcher, submap, &scan_matcher_options]() {
+        const double start_cpu_time_seconds =
+            common::GetThreadCpuTimeSeconds();
+        submap_scan_matcher->grid = submap->LoadGrid();
+        CHECK(submap_scan_matcher->grid);
+        submap_scan_matcher->fast_correlative_scan_matcher =
             absl::make_unique<scan_matching::FastCorrelativeScanMatcher2D>(
-                *submap_scan_matcher.grid, scan_matcher_options);
+                *submap_scan_matcher->grid, scan_matcher_options,
+                cells_pool_.get());
+        if (scan_matcher_options.precomputation_num_tasks() > 1) {
+          // The searches against the submap wait for this task, so all grids
+          // are computed in parallel instead of one by one by the first
+          // search needing them.
+          submap_scan_matcher->fast_correlative_scan_matcher->PrecomputeGrids(
+              thread_pool_, scan_matcher_options.precomputation_num_tasks());
+        }
+        if (submap_scan_matcher->grid->GetGridType() == GridType::TSDF) {
+          submap_scan_matcher->tsdf_field =
+              absl::make_unique<scan_matching::TSDFField2D>(
+                  static_cast<const TSDF2D&>(*submap_scan_matcher->grid));
+        }
+        AddCpuTime(submap_id.trajectory_id,
+                   TrajectoryCpuTimeMetrics::Activity::kScanMatcherConstruction,
+                   start_cpu_time_seconds);
       });
-  submap_scan_matcher.creation_task_handle =
+  scan_matcher_task->SetAffinity(GetTaskAffinity(submap_id));
+  submap_scan_matcher->creation_task_handle =
       thread_pool_->Schedule(std::move(scan_matcher_task));
-  return &submap_scan_matchers_.at(submap_id);
+  return submap_scan_matcher;
+}
+
+void ConstraintBuilder2D::AddCpuTime(
+    const int trajectory_id, const TrajectoryCpuTimeMetrics::Activity activity,
+    const double start_cpu_time_seconds) const {
+  if (trajectory_cpu_time_metrics_ == nullptr) return;
+  trajectory_cpu_time_metrics_->Add(
+      trajectory_id, activity,
+      common::GetThreadCpuTimeSeconds() - start_cpu_time_seconds);
+}
+
+void ConstraintBuilder2D::MaybeEvictScanMatchers() {
+  const uint64 max_memory_in_bytes =
+      static_cast<uint64>(options_.max_submap_scan_matchers_memory_in_mb())
+      << 20;
+  // Scan matchers still being constructed are neither counted nor evicted.
+  std::vector<std::tuple<uint64, SubmapId, size_t>> constructed_scan_matchers;
+  uint64 memory_in_bytes = 0;
+  for (const auto& submap_id_scan_matcher : submap_scan_matchers_) {
+    const SubmapScanMatcher& submap_scan_matcher =
+        *submap_id_scan_matcher.second;
+    const std::shared_ptr<common::Task> creation_task =
+        submap_scan_matcher.creation_task_handle.lock();
+    if (creation_task != nullptr &&
+        creation_task->GetState() != common::Task::COMPLETED) {
+      continue;
+    }
+    const size_t scan_matcher_memory_in_bytes =
+        submap_scan_matcher.fast_correlative_scan_matcher
+            ->MemoryUsageInBytes() +
+        (submap_scan_matcher.tsdf_field != nullptr
+             ? submap_scan_matcher.tsdf_field->MemoryUsageInBytes()
+             : 0);
+    memory_in_bytes += scan_matcher_memory_in_bytes;
+    constructed_scan_matchers.emplace_back(submap_scan_matcher.last_use,
+                                           submap_id_scan_matcher.first,
+                                           scan_matcher_memory_in_bytes);
+  }
+  if (max_memory_in_bytes != 0 && memory_in_bytes > max_memory_in_bytes) {
+    std::sort(constructed_scan_matchers.begin(),
+              constructed_scan_matchers.end());
+    for (const auto& scan_matcher : constructed_scan_matchers) {
+      if (memory_in_bytes <= max_memory_in_bytes) {
+        break;
+      }
+      const SubmapId& submap_id = std::get<1>(scan_matcher);
+      submap_scan_matchers_.erase(submap_id);
+      evicted_submap_ids_.insert(submap_id);
+      memory_in_bytes -= std::get<2>(scan_matcher);
+      kSubmapScanMatcherEvictionsMetric->Increment();
+    }
+    kNumSubmapScanMatchersMetric->Set(submap_scan_matchers_.size());
+  }
+  kSubmapScanMatchersMemoryMetric->Set(memory_in_bytes);
 }
 
 void ConstraintBuilder2D::ComputeConstraint(
@@ -191,8 +385,17 @@ void ConstraintBuilder2D::ComputeConstraint(
     const TrajectoryNode::Data* const constant_data,
     const transform::Rigid2d& initial_relative_pose,
     const SubmapScanMatcher& submap_scan_matcher,
+    NodeFullSubmapMatchScans* const full_submap_match_scans,
     std::unique_ptr<ConstraintBuilder2D::Constraint>* constraint) {
   CHECK(submap_scan_matcher.fast_correlative_scan_matcher);
+  if (options_.early_termination_score() > 0.) {
+    absl::MutexLock locker(&mutex_);
+    if (terminated_constraint_searches_.count(
+            std::make_pair(node_id, submap_id.trajectory_id)) != 0) {
+      kConstraintSearchesSkippedMetric->Increment();
+      return;
+    }
+  }
   const transform::Rigid2d initial_pose =
       ComputeSubmapPose(*submap) * initial_relative_pose;
 
@@ -210,9 +413,26 @@ void ConstraintBuilder2D::ComputeConstraint(
   // 3. Refine.
   if (match_full_submap) {
     kGlobalConstraintsSearchedMetric->Increment();
+    CHECK(full_submap_match_scans != nullptr);
+    const scan_matching::FullSubmapMatchScans2D* scans;
+    {
+      // Other searches of this node wait for the scans they need as well.
+      absl::MutexLock locker(&full_submap_match_scans->mutex);
+      const double resolution =
+          submap_scan_matcher.grid->limits().resolution();
+      auto& resolution_scans =
+          full_submap_match_scans->scans_by_resolution[resolution];
+      if (resolution_scans == nullptr) {
+        resolution_scans =
+            absl::make_unique<scan_matching::FullSubmapMatchScans2D>(
+                constant_data->filtered_gravity_aligned_point_cloud,
+                resolution);
+      }
+      scans = resolution_scans.get();
+    }
     if (submap_scan_matcher.fast_correlative_scan_matcher->MatchFullSubmap(
-            constant_data->filtered_gravity_aligned_point_cloud,
-            options_.global_localization_min_score(), &score, &pose_estimate)) {
+            *scans, options_.global_localization_min_score(), thread_pool_,
+            &score, &pose_estimate)) {
       CHECK_GT(score, options_.global_localization_min_score());
       CHECK_GE(node_id.trajectory_id, 0);
       CHECK_GE(submap_id.trajectory_id, 0);
@@ -237,16 +457,28 @@ void ConstraintBuilder2D::ComputeConstraint(
   {
     absl::MutexLock locker(&mutex_);
     score_histogram_.Add(score);
+    if (options_.early_termination_score() > 0. &&
+        score >= options_.early_termination_score()) {
+      terminated_constraint_searches_.emplace(node_id,
+                                              submap_id.trajectory_id);
+    }
   }
 
   // Use the CSM estimate as both the initial and previous pose. This has the
   // effect that, in the absence of better information, we prefer the original
   // CSM estimate.
   ceres::Solver::Summary unused_summary;
-  ceres_scan_matcher_.Match(pose_estimate.translation(), pose_estimate,
-                            constant_data->filtered_gravity_aligned_point_cloud,
-                            *submap_scan_matcher.grid, &pose_estimate,
-                            &unused_summary);
+  if (submap_scan_matcher.tsdf_field != nullptr) {
+    ceres_scan_matcher_.Match(
+        pose_estimate.translation(), pose_estimate,
+        constant_data->filtered_gravity_aligned_point_cloud,
+        *submap_scan_matcher.tsdf_field, &pose_estimate, &unused_summary);
+  } else {
+    ceres_scan_matcher_.Match(
+        pose_estimate.translation(), pose_estimate,
+        constant_data->filtered_gravity_aligned_point_cloud,
+        *submap_scan_matcher.grid, &pose_estimate, &unused_summary);
+  }
 
   const transform::Rigid2d constraint_transform =
       ComputeSubmapPose(*submap).inverse() * pose_estimate;
@@ -276,6 +508,59 @@ void ConstraintBuilder2D::ComputeConstraint(
   }
 }
 
+void ConstraintBuilder2D::ComputeGlobalLocalizationGridConstraint(
+    const GlobalLocalizationGrid2D& global_localization_grid,
+    const NodeId& node_id, const TrajectoryNode::Data* const constant_data,
+    const transform::Rigid2d& global_pose,
+    std::unique_ptr<ConstraintBuilder2D::Constraint>* constraint) {
+  kGlobalConstraintsSearchedMetric->Increment();
+  float score = 0.;
+  transform::Rigid2d pose_estimate = transform::Rigid2d::Identity();
+  if (!global_localization_grid.Match(
+          global_pose, constant_data->filtered_gravity_aligned_point_cloud,
+          options_.global_localization_min_score(), thread_pool_, &score,
+          &pose_estimate)) {
+    return;
+  }
+  CHECK_GT(score, options_.global_localization_min_score());
+  kGlobalConstraintsFoundMetric->Increment();
+  kGlobalConstraintScoresMetric->Observe(score);
+  {
+    absl::MutexLock locker(&mutex_);
+    score_histogram_.Add(score);
+  }
+
+  ceres::Solver::Summary unused_summary;
+  ceres_scan_matcher_.Match(pose_estimate.translation(), pose_estimate,
+                            constant_data->filtered_gravity_aligned_point_cloud,
+                            global_localization_grid.grid(), &pose_estimate,
+                            &unused_summary);
+
+  // The fused grid is in the global map frame, so the constraint (submap i <-
+  // node j) follows from the global pose of the nearest submap.
+  transform::Rigid2d submap_global_pose;
+  const SubmapId submap_id = global_localization_grid.GetNearestSubmap(
+      pose_estimate.translation(), &submap_global_pose);
+  const transform::Rigid2d constraint_transform =
+      submap_global_pose.inverse() * pose_estimate;
+  constraint->reset(new Constraint{submap_id,
+                                   node_id,
+                                   {transform::Embed3D(constraint_transform),
+                                    options_.loop_closure_translation_weight(),
+                                    options_.loop_closure_rotation_weight()},
+                                   Constraint::INTER_SUBMAP});
+
+  if (options_.log_matches()) {
+    std::ostringstream info;
+    info << "Node " << node_id << " with "
+         << constant_data->filtered_gravity_aligned_point_cloud.size()
+         << " points matches the global localization grid near submap "
+         << submap_id << std::fixed << " with score " << std::setprecision(1)
+         << 100. * score << "%.";
+    LOG(INFO) << info.str();
+  }
+}
+
 void ConstraintBuilder2D::RunWhenDoneCallback() {
   Result result;
   std::unique_ptr<std::function<void(const Result&)>> callback;
@@ -292,6 +577,7 @@ void ConstraintBuilder2D::RunWhenDoneCallback() {
       LOG(INFO) << "Score histogram:\n" << score_histogram_.ToString(10);
     }
     constraints_.clear();
+    terminated_constraint_searches_.clear();
     callback = std::move(when_done_);
     when_done_.reset();
     kQueueLengthMetric->Set(constraints_.size());
@@ -304,17 +590,44 @@ int ConstraintBuilder2D::GetNumFinishedNodes() {
   return num_finished_nodes_;
 }
 
+std::vector<SubmapId> ConstraintBuilder2D::GetScanMatcherSubmapIds() {
+  absl::MutexLock locker(&mutex_);
+  std::vector<SubmapId> submap_ids;
+  for (const auto& submap_id_scan_matcher : submap_scan_matchers_) {
+    submap_ids.push_back(submap_id_scan_matcher.first);
+  }
+  return submap_ids;
+}
+
 void ConstraintBuilder2D::DeleteScanMatcher(const SubmapId& submap_id) {
   absl::MutexLock locker(&mutex_);
   if (when_done_) {
     LOG(WARNING)
         << "DeleteScanMatcher was called while WhenDone was scheduled.";
   }
-  submap_scan_matchers_.erase(submap_id);
+  const auto it = submap_scan_matchers_.find(submap_id);
+  if (it != submap_scan_matchers_.end()) {
+    deleted_scan_matchers_.push_back(std::move(it->second));
+    submap_scan_matchers_.erase(it);
+  }
+  evicted_submap_ids_.erase(submap_id);
   per_submap_sampler_.erase(submap_id);
   kNumSubmapScanMatchersMetric->Set(submap_scan_matchers_.size());
 }
 
+void ConstraintBuilder2D::ReleaseDeletedScanMatchers() {
+  std::vector<std::shared_ptr<SubmapScanMatcher>> deleted_scan_matchers;
+  {
+    absl::MutexLock locker(&mutex_);
+    deleted_scan_matchers.swap(deleted_scan_matchers_);
+  }
+  // Scan matchers still used by a computation are freed when it finishes.
+  deleted_scan_matchers.clear();
+  if (cells_pool_ != nullptr) {
+    kCellsPoolMemoryMetric->Set(cells_pool_->pooled_bytes());
+  }
+}
+
 void ConstraintBuilder2D::RegisterMetrics(metrics::FamilyFactory* factory) {
   auto* counts = factory->NewCounterFamily(
       "mapping_constraints_constraint_builder_2d_constraints",
@@ -340,6 +653,34 @@ void ConstraintBuilder2D::RegisterMetrics(metrics::FamilyFactory* factory) {
       "mapping_constraints_constraint_builder_2d_num_submap_scan_matchers",
       "Current number of constructed submap scan matchers");
   kNumSubmapScanMatchersMetric = num_matchers->Add({});
+  auto* matchers_memory = factory->NewGaugeFamily(
+      "mapping_constraints_constraint_builder_2d_submap_scan_matchers_memory",
+      "Memory used by constructed submap scan matchers in bytes");
+  kSubmapScanMatchersMemoryMetric = matchers_memory->Add({});
+  auto* cells_pool_memory = factory->NewGaugeFamily(
+      "mapping_constraints_constraint_builder_2d_cells_pool_memory",
+      "Memory held by the pool of precomputation grid cells in bytes");
+  kCellsPoolMemoryMetric = cells_pool_memory->Add({});
+  auto* matcher_cache = factory->NewCounterFamily(
+      "mapping_constraints_constraint_builder_2d_submap_scan_matcher_cache",
+      "Submap scan matchers evicted for the memory limit or rebuilt");
+  kSubmapScanMatcherEvictionsMetric =
+      matcher_cache->Add({{"event", "evicted"}});
+  kSubmapScanMatcherRebuildsMetric =
+      matcher_cache->Add({{"event", "rebuilt"}});
+  auto* skipped = factory->NewCounterFamily(
+      "mapping_constraints_constraint_builder_2d_skipped_searches",
+      "Constraint searches skipped since a good constraint was found for the "
+      "node and submap trajectory");
+  kConstraintSearchesSkippedMetric = skipped->Add({});
+  auto* search_duration = factory->NewHistogramFamily(
+      "mapping_constraints_constraint_builder_2d_search_duration",
+      "Wall time in seconds to search for a constraint",
+      metrics::Histogram::ScaledPowersOf(2, 1e-4, 100));
+  kConstraintSearchDurationMetric =
+      search_duration->Add({{"search_region", "local"}});
+  kGlobalConstraintSearchDurationMetric =
+      search_duration->Add({{"search_region", "global"}});
 }
 
 }  // namespace constraints
@@ -22,6 +22,9 @@
 #include <functional>
 #include <limits>
 #include <map>
+#include <memory>
+#include <set>
+#include <utility>
 #include <vector>
 
 #include "Eigen/Core"
@@ -35,6 +38,9 @@
 #include "cartographer/mapping/2d/submap_2d.h"
 #include "cartographer/mapping/internal/2d/scan_matching/ceres_scan_matcher_2d.h"
 #include "cartographer/mapping/internal/2d/scan_matching/fast_correlative_scan_matcher_2d.h"
+#include "cartographer/mapping/internal/2d/scan_matching/tsdf_field_2d.h"
+#include "cartographer/mapping/internal/constraints/global_localization_grid_2d.h"
+#include "cartographer/mapping/internal/trajectory_cpu_time_metrics.h"
 #include "cartographer/mapping/pose_graph_interface.h"
 #include "cartographer/mapping/proto/pose_graph/constraint_builder_options.pb.h"
 #include "cartographer/metrics/family_factory.h"
@@ -62,8 +68,13 @@ class ConstraintBuilder2D {
   using Constraint = PoseGraphInterface::Constraint;
   using Result = std::vector<Constraint>;
 
-  ConstraintBuilder2D(const proto::ConstraintBuilderOptions& options,
-                      common::ThreadPoolInterface* thread_pool);
+  // If 'trajectory_cpu_time_metrics' is not nullptr, the thread CPU time of
+  // constraint searches and scan matcher construction is attributed to
+  // trajectories there.
+  ConstraintBuilder2D(
+      const proto::ConstraintBuilderOptions& options,
+      common::ThreadPoolInterface* thread_pool,
+      TrajectoryCpuTimeMetrics* trajectory_cpu_time_metrics = nullptr);
   ~ConstraintBuilder2D();
 
   ConstraintBuilder2D(const ConstraintBuilder2D&) = delete;
@@ -90,9 +101,29 @@ class ConstraintBuilder2D {
       const SubmapId& submap_id, const Submap2D* submap, const NodeId& node_id,
       const TrajectoryNode::Data* const constant_data);
 
+  // Schedules one search of 'node_id' in 'global_localization_grid' instead
+  // of full-submap matches against each of its submaps. The search starts at
+  // the node's 'global_pose', see
+  // 'global_localization_grid_linear_search_window'. A found constraint is
+  // relative to the fused submap nearest to the match.
+  //
+  // The pointee of 'constant_data' must stay valid until all computations are
+  // finished.
+  void MaybeAddGlobalLocalizationGridConstraint(
+      std::shared_ptr<const GlobalLocalizationGrid2D> global_localization_grid,
+      const NodeId& node_id, const TrajectoryNode::Data* const constant_data,
+      const transform::Rigid2d& global_pose);
+
   // Must be called after all computations related to one node have been added.
+  // Starts the computations added since the last call, nearby local searches
+  // first and global searches last.
   void NotifyEndOfNode();
 
+  // Like NotifyEndOfNode(), for additional searches of a node which was
+  // already finished, e.g. one loaded from a serialized state. The node is not
+  // counted again by GetNumFinishedNodes().
+  void NotifyEndOfAdditionalSearches();
+
   // Registers the 'callback' to be called with the results, after all
   // computations triggered by 'MaybeAdd*Constraint' have finished.
   // 'callback' is executed in the 'ThreadPool'.
@@ -101,40 +132,101 @@ class ConstraintBuilder2D {
   // Returns the number of consecutive finished nodes.
   int GetNumFinishedNodes();
 
-  // Delete data related to 'submap_id'.
+  // Returns the submaps with a dispatched or constructed scan matcher.
+  // Visible for testing.
+  std::vector<SubmapId> GetScanMatcherSubmapIds() LOCKS_EXCLUDED(mutex_);
+
+  // Delete data related to 'submap_id'. The scan matcher itself is only
+  // freed by the next ReleaseDeletedScanMatchers().
   void DeleteScanMatcher(const SubmapId& submap_id);
 
+  // Frees the scan matchers deleted since the last call. Their precomputation
+  // grids go to the cells pool if 'scan_matcher_cells_pool_size_in_mb' is
+  // set. Meant to be called while no lock of the caller is held.
+  void ReleaseDeletedScanMatchers() LOCKS_EXCLUDED(mutex_);
+
   static void RegisterMetrics(metrics::FamilyFactory* family_factory);
 
  private:
   struct SubmapScanMatcher {
-    const Grid2D* grid = nullptr;
+    // Keeps the grid of a lazily loaded submap in memory while the scan
+    // matcher exists, see Submap2D::LoadGrid().
+    std::shared_ptr<const Grid2D> grid;
     std::unique_ptr<scan_matching::FastCorrelativeScanMatcher2D>
         fast_correlative_scan_matcher;
+    // Only for TSDF submaps, refines the matches of the fast correlative scan
+    // matcher.
+    std::unique_ptr<const scan_matching::TSDFField2D> tsdf_field;
     std::weak_ptr<common::Task> creation_task_handle;
+    // Value of 'num_scan_matcher_uses_' when the scan matcher was last used.
+    // Guarded by 'mutex_'.
+    uint64 last_use = 0;
   };
 
   // The returned 'grid' and 'fast_correlative_scan_matcher' must only be
   // accessed after 'creation_task_handle' has completed.
-  const SubmapScanMatcher* DispatchScanMatcherConstruction(
-      const SubmapId& submap_id, const Grid2D* grid)
+  std::shared_ptr<const SubmapScanMatcher> DispatchScanMatcherConstruction(
+      const SubmapId& submap_id, const Submap2D* submap)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Attributes the thread CPU time since 'start_cpu_time_seconds' to
+  // 'trajectory_id'.
+  void AddCpuTime(int trajectory_id,
+                  TrajectoryCpuTimeMetrics::Activity activity,
+                  double start_cpu_time_seconds) const;
+
+  // The rotated scans of a node for its full submap matches, by grid
+  // resolution. Computed by the first search which needs them.
+  struct NodeFullSubmapMatchScans {
+    absl::Mutex mutex;
+    std::map<double,
+             std::unique_ptr<const scan_matching::FullSubmapMatchScans2D>>
+        scans_by_resolution GUARDED_BY(mutex);
+  };
+
+  // A computation which is started by the next NotifyEndOfNode().
+  struct PendingConstraintSearch {
+    bool match_full_submap;
+    // Distance between node and submap, 0 for global searches.
+    double distance;
+    std::unique_ptr<common::Task> task;
+  };
+
+  // Updates the memory gauge of the constructed scan matchers and deletes the
+  // least recently used ones while they use more than
+  // 'max_submap_scan_matchers_memory_in_mb', unless it is 0.
+  void MaybeEvictScanMatchers() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   // Runs in a background thread and does computations for an additional
   // constraint, assuming 'submap' and 'compressed_point_cloud' do not change
   // anymore. As output, it may create a new Constraint in 'constraint'.
+  // 'full_submap_match_scans' must be set if 'match_full_submap' is.
   void ComputeConstraint(const SubmapId& submap_id, const Submap2D* submap,
                          const NodeId& node_id, bool match_full_submap,
                          const TrajectoryNode::Data* const constant_data,
                          const transform::Rigid2d& initial_relative_pose,
                          const SubmapScanMatcher& submap_scan_matcher,
+                         NodeFullSubmapMatchScans* full_submap_match_scans,
                          std::unique_ptr<Constraint>* constraint)
       LOCKS_EXCLUDED(mutex_);
 
+  // Like ComputeConstraint(), for a search in 'global_localization_grid'.
+  void ComputeGlobalLocalizationGridConstraint(
+      const GlobalLocalizationGrid2D& global_localization_grid,
+      const NodeId& node_id, const TrajectoryNode::Data* const constant_data,
+      const transform::Rigid2d& global_pose,
+      std::unique_ptr<Constraint>* constraint) LOCKS_EXCLUDED(mutex_);
+
+  // Starts the computations added since the last call. If 'count_node', the
+  // node is counted by GetNumFinishedNodes() once they are done.
+  void StartPendingConstraintSearches(bool count_node)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   void RunWhenDoneCallback() LOCKS_EXCLUDED(mutex_);
 
   const constraints::proto::ConstraintBuilderOptions options_;
   common::ThreadPoolInterface* thread_pool_;
+  TrajectoryCpuTimeMetrics* const trajectory_cpu_time_metrics_;
   absl::Mutex mutex_;
 
   // 'callback' set by WhenDone().
@@ -153,14 +245,41 @@ class ConstraintBuilder2D {
 
   std::unique_ptr<common::Task> when_done_task_ GUARDED_BY(mutex_);
 
+  std::vector<PendingConstraintSearch> pending_constraint_searches_
+      GUARDED_BY(mutex_);
+
+  // Shared by the full submap matches of each node since the last
+  // NotifyEndOfNode(), so that a node's point cloud is rotated once instead
+  // of once per submap.
+  std::map<NodeId, std::shared_ptr<NodeFullSubmapMatchScans>>
+      full_submap_match_scans_ GUARDED_BY(mutex_);
+
+  // Node and submap trajectory pairs for which a constraint with at least
+  // 'early_termination_score' was found, so that further searches are
+  // skipped.
+  std::set<std::pair<NodeId, int>> terminated_constraint_searches_
+      GUARDED_BY(mutex_);
+
   // Constraints currently being computed in the background. A deque is used to
   // keep pointers valid when adding more entries. Constraint search results
   // with below-threshold scores are also 'nullptr'.
   std::deque<std::unique_ptr<Constraint>> constraints_ GUARDED_BY(mutex_);
 
-  // Map of dispatched or constructed scan matchers by 'submap_id'.
-  std::map<SubmapId, SubmapScanMatcher> submap_scan_matchers_
+  // Recycles the precomputation grids of deleted scan matchers. Declared
+  // before the scan matchers, which release their grids to it. May be null.
+  std::unique_ptr<scan_matching::PrecomputationCellsPool2D> cells_pool_;
+
+  // Map of dispatched or constructed scan matchers by 'submap_id'. They are
+  // shared with the computations using them, so that deleting or evicting
+  // them does not affect computations in progress.
+  std::map<SubmapId, std::shared_ptr<SubmapScanMatcher>> submap_scan_matchers_
+      GUARDED_BY(mutex_);
+  uint64 num_scan_matcher_uses_ GUARDED_BY(mutex_) = 0;
+  // Scan matchers deleted with their submaps, see ReleaseDeletedScanMatchers().
+  std::vector<std::shared_ptr<SubmapScanMatcher>> deleted_scan_matchers_
       GUARDED_BY(mutex_);
+  // Submaps whose scan matchers were evicted and not constructed again yet.
+  std::set<SubmapId> evicted_submap_ids_ GUARDED_BY(mutex_);
   std::map<SubmapId, common::FixedRatioSampler> per_submap_sampler_;
 
   scan_matching::CeresScanMatcher2D ceres_scan_matcher_;
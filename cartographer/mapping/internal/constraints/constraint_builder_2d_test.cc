@@ -17,6 +17,7 @@
 #include "cartographer/mapping/internal/constraints/constraint_builder_2d.h"
 
 #include <functional>
+#include <vector>
 
 #include "cartographer/common/internal/testing/thread_pool_for_testing.h"
 #include "cartographer/mapping/2d/probability_grid.h"
@@ -45,11 +46,13 @@ class ConstraintBuilder2DTest : public ::testing::Test {
             POSE_GRAPH.constraint_builder.min_score = 0
             POSE_GRAPH.constraint_builder.global_localization_min_score = 0
             return POSE_GRAPH.constraint_builder)text");
-    constraint_builder_ = absl::make_unique<ConstraintBuilder2D>(
-        CreateConstraintBuilderOptions(constraint_builder_parameters.get()),
-        &thread_pool_);
+    options_ =
+        CreateConstraintBuilderOptions(constraint_builder_parameters.get());
+    constraint_builder_ =
+        absl::make_unique<ConstraintBuilder2D>(options_, &thread_pool_);
   }
 
+  proto::ConstraintBuilderOptions options_;
   std::unique_ptr<ConstraintBuilder2D> constraint_builder_;
   MockCallback mock_;
   common::testing::ThreadPoolForTesting thread_pool_;
@@ -67,6 +70,33 @@ TEST_F(ConstraintBuilder2DTest, CallsBack) {
   EXPECT_EQ(constraint_builder_->GetNumFinishedNodes(), 1);
 }
 
+TEST_F(ConstraintBuilder2DTest, AdditionalSearchesAreNotCountedAsNodes) {
+  TrajectoryNode::Data node_data;
+  node_data.filtered_gravity_aligned_point_cloud.push_back(
+      {Eigen::Vector3f(0.1, 0.2, 0.3)});
+  node_data.gravity_alignment = Eigen::Quaterniond::Identity();
+  node_data.local_pose = transform::Rigid3d::Identity();
+  SubmapId submap_id{0, 1};
+  MapLimits map_limits(1., Eigen::Vector2d(2., 3.), CellLimits(100, 110));
+  ValueConversionTables conversion_tables;
+  Submap2D submap(
+      Eigen::Vector2f(4.f, 5.f),
+      absl::make_unique<ProbabilityGrid>(map_limits, &conversion_tables),
+      &conversion_tables);
+  constraint_builder_->NotifyEndOfNode();
+  constraint_builder_->MaybeAddGlobalConstraint(submap_id, &submap,
+                                                NodeId{0, 0}, &node_data);
+  constraint_builder_->NotifyEndOfAdditionalSearches();
+  EXPECT_CALL(mock_, Run(::testing::SizeIs(1)));
+  constraint_builder_->WhenDone(
+      [this](const constraints::ConstraintBuilder2D::Result& result) {
+        mock_.Run(result);
+      });
+  thread_pool_.WaitUntilIdle();
+  EXPECT_EQ(constraint_builder_->GetNumFinishedNodes(), 1);
+  constraint_builder_->DeleteScanMatcher(submap_id);
+}
+
 TEST_F(ConstraintBuilder2DTest, FindsConstraints) {
   TrajectoryNode::Data node_data;
   node_data.filtered_gravity_aligned_point_cloud.push_back(
@@ -111,6 +141,110 @@ TEST_F(ConstraintBuilder2DTest, FindsConstraints) {
   }
 }
 
+TEST_F(ConstraintBuilder2DTest, SkipsSearchesAfterGoodConstraint) {
+  options_.set_early_termination_score(1e-6);
+  constraint_builder_ =
+      absl::make_unique<ConstraintBuilder2D>(options_, &thread_pool_);
+  TrajectoryNode::Data node_data;
+  node_data.filtered_gravity_aligned_point_cloud.push_back(
+      {Eigen::Vector3f(0.1, 0.2, 0.3)});
+  node_data.gravity_alignment = Eigen::Quaterniond::Identity();
+  node_data.local_pose = transform::Rigid3d::Identity();
+  SubmapId submap_id{0, 1};
+  MapLimits map_limits(1., Eigen::Vector2d(2., 3.), CellLimits(100, 110));
+  ValueConversionTables conversion_tables;
+  Submap2D submap(
+      Eigen::Vector2f(4.f, 5.f),
+      absl::make_unique<ProbabilityGrid>(map_limits, &conversion_tables),
+      &conversion_tables);
+  // The single thread of the thread pool runs one of the searches, which
+  // finds a constraint, and skips the others.
+  constraint_builder_->MaybeAddGlobalConstraint(submap_id, &submap,
+                                                NodeId{0, 0}, &node_data);
+  for (int j = 0; j < 2; ++j) {
+    constraint_builder_->MaybeAddConstraint(submap_id, &submap, NodeId{0, 0},
+                                            &node_data,
+                                            transform::Rigid2d::Identity());
+  }
+  constraint_builder_->NotifyEndOfNode();
+  EXPECT_CALL(mock_,
+              Run(::testing::ElementsAre(::testing::Field(
+                  &PoseGraphInterface::Constraint::node_id, NodeId{0, 0}))));
+  constraint_builder_->WhenDone(
+      [this](const constraints::ConstraintBuilder2D::Result& result) {
+        mock_.Run(result);
+      });
+  thread_pool_.WaitUntilIdle();
+  EXPECT_EQ(constraint_builder_->GetNumFinishedNodes(), 1);
+}
+
+TEST_F(ConstraintBuilder2DTest, EvictsLeastRecentlyUsedScanMatchers) {
+  // Each precomputation grid uses 800 * 800 bytes, so only one of them fits.
+  options_.set_max_submap_scan_matchers_memory_in_mb(1);
+  options_.mutable_fast_correlative_scan_matcher_options()
+      ->set_branch_and_bound_depth(1);
+  constraint_builder_ =
+      absl::make_unique<ConstraintBuilder2D>(options_, &thread_pool_);
+  TrajectoryNode::Data node_data;
+  node_data.filtered_gravity_aligned_point_cloud.push_back(
+      {Eigen::Vector3f(0.1, 0.2, 0.3)});
+  node_data.gravity_alignment = Eigen::Quaterniond::Identity();
+  node_data.local_pose = transform::Rigid3d::Identity();
+  MapLimits map_limits(1., Eigen::Vector2d(400., 400.), CellLimits(800, 800));
+  ValueConversionTables conversion_tables;
+  const SubmapId submap_id_a{0, 0};
+  Submap2D submap_a(
+      Eigen::Vector2f(0.f, 0.f),
+      absl::make_unique<ProbabilityGrid>(map_limits, &conversion_tables),
+      &conversion_tables);
+  const SubmapId submap_id_b{0, 1};
+  Submap2D submap_b(
+      Eigen::Vector2f(0.f, 0.f),
+      absl::make_unique<ProbabilityGrid>(map_limits, &conversion_tables),
+      &conversion_tables);
+  int node_index = 0;
+  const auto add_node = [&](const std::vector<SubmapId>& submap_ids) {
+    for (const SubmapId& submap_id : submap_ids) {
+      constraint_builder_->MaybeAddConstraint(
+          submap_id, submap_id == submap_id_a ? &submap_a : &submap_b,
+          NodeId{0, node_index}, &node_data, transform::Rigid2d::Identity());
+    }
+    ++node_index;
+    // Evicts scan matchers whose grids were computed by previous searches.
+    constraint_builder_->NotifyEndOfNode();
+  };
+
+  add_node({submap_id_a});
+  thread_pool_.WaitUntilIdle();
+  add_node({submap_id_b});
+  thread_pool_.WaitUntilIdle();
+  EXPECT_THAT(constraint_builder_->GetScanMatcherSubmapIds(),
+              ::testing::ElementsAre(submap_id_a, submap_id_b));
+  // 'submap_id_a' was used last, so the scan matcher of 'submap_id_b' is
+  // evicted even though it was constructed last.
+  add_node({submap_id_a});
+  EXPECT_THAT(constraint_builder_->GetScanMatcherSubmapIds(),
+              ::testing::ElementsAre(submap_id_a));
+  thread_pool_.WaitUntilIdle();
+  // The scan matcher of 'submap_id_b' is constructed again.
+  add_node({submap_id_b});
+  thread_pool_.WaitUntilIdle();
+  EXPECT_THAT(constraint_builder_->GetScanMatcherSubmapIds(),
+              ::testing::ElementsAre(submap_id_a, submap_id_b));
+  // The scan matcher of 'submap_id_b' is evicted while the search of this
+  // node against it is still pending, which keeps using it.
+  add_node({submap_id_b, submap_id_a});
+  EXPECT_THAT(constraint_builder_->GetScanMatcherSubmapIds(),
+              ::testing::ElementsAre(submap_id_a));
+  EXPECT_CALL(mock_, Run(::testing::SizeIs(6)));
+  constraint_builder_->WhenDone(
+      [this](const constraints::ConstraintBuilder2D::Result& result) {
+        mock_.Run(result);
+      });
+  thread_pool_.WaitUntilIdle();
+  EXPECT_EQ(constraint_builder_->GetNumFinishedNodes(), 5);
+}
+
 }  // namespace
 }  // namespace constraints
 }  // namespace mapping
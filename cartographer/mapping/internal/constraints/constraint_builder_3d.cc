@@ -16,6 +16,7 @@
 
 #include "cartographer/mapping/internal/constraints/constraint_builder_3d.h"
 
+#include <algorithm>
 #include <cmath>
 #include <functional>
 #include <iomanip>
@@ -26,11 +27,13 @@
 #include <string>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 #include "Eigen/Eigenvalues"
 #include "absl/memory/memory.h"
 #include "cartographer/common/math.h"
 #include "cartographer/common/thread_pool.h"
+#include "cartographer/common/time.h"
 #include "cartographer/mapping/proto/scan_matching/ceres_scan_matcher_options_3d.pb.h"
 #include "cartographer/mapping/proto/scan_matching/fast_correlative_scan_matcher_options_3d.pb.h"
 #include "cartographer/metrics/counter.h"
@@ -57,12 +60,20 @@ static auto* kGlobalConstraintRotationalScoresMetric =
 static auto* kGlobalConstraintLowResolutionScoresMetric =
     metrics::Histogram::Null();
 static auto* kNumSubmapScanMatchersMetric = metrics::Gauge::Null();
+static auto* kSubmapScanMatchersMemoryMetric = metrics::Gauge::Null();
+static auto* kSubmapScanMatcherEvictionsMetric = metrics::Counter::Null();
+static auto* kSubmapScanMatcherRebuildsMetric = metrics::Counter::Null();
+static auto* kConstraintSearchDurationMetric = metrics::Histogram::Null();
+static auto* kGlobalConstraintSearchDurationMetric =
+    metrics::Histogram::Null();
 
 ConstraintBuilder3D::ConstraintBuilder3D(
     const proto::ConstraintBuilderOptions& options,
-    common::ThreadPoolInterface* const thread_pool)
+    common::ThreadPoolInterface* const thread_pool,
+    TrajectoryCpuTimeMetrics* const trajectory_cpu_time_metrics)
     : options_(options),
       thread_pool_(thread_pool),
+      trajectory_cpu_time_metrics_(trajectory_cpu_time_metrics),
       finish_node_task_(absl::make_unique<common::Task>()),
       when_done_task_(absl::make_unique<common::Task>()),
       ceres_scan_matcher_(options.ceres_scan_matcher_options_3d()) {}
@@ -100,12 +111,20 @@ void ConstraintBuilder3D::MaybeAddConstraint(
   constraints_.emplace_back();
   kQueueLengthMetric->Set(constraints_.size());
   auto* const constraint = &constraints_.back();
-  const auto* scan_matcher = DispatchScanMatcherConstruction(submap_id, submap);
+  const std::shared_ptr<const SubmapScanMatcher> scan_matcher =
+      DispatchScanMatcherConstruction(submap_id, submap);
   auto constraint_task = absl::make_unique<common::Task>();
   constraint_task->SetWorkItem([=]() LOCKS_EXCLUDED(mutex_) {
+    const auto start_time = std::chrono::steady_clock::now();
+    const double start_cpu_time_seconds = common::GetThreadCpuTimeSeconds();
     ComputeConstraint(submap_id, node_id, false, /* match_full_submap */
                       constant_data, global_node_pose, global_submap_pose,
                       *scan_matcher, constraint);
+    kConstraintSearchDurationMetric->Observe(
+        common::ToSeconds(std::chrono::steady_clock::now() - start_time));
+    AddCpuTime(node_id.trajectory_id,
+               TrajectoryCpuTimeMetrics::Activity::kConstraintSearch,
+               start_cpu_time_seconds);
   });
   constraint_task->AddDependency(scan_matcher->creation_task_handle);
   auto constraint_task_handle =
@@ -126,15 +145,25 @@ void ConstraintBuilder3D::MaybeAddGlobalConstraint(
   constraints_.emplace_back();
   kQueueLengthMetric->Set(constraints_.size());
   auto* const constraint = &constraints_.back();
-  const auto* scan_matcher = DispatchScanMatcherConstruction(submap_id, submap);
+  const std::shared_ptr<const SubmapScanMatcher> scan_matcher =
+      DispatchScanMatcherConstruction(submap_id, submap);
   auto constraint_task = absl::make_unique<common::Task>();
   constraint_task->SetWorkItem([=]() LOCKS_EXCLUDED(mutex_) {
+    const auto start_time = std::chrono::steady_clock::now();
+    const double start_cpu_time_seconds = common::GetThreadCpuTimeSeconds();
     ComputeConstraint(submap_id, node_id, true, /* match_full_submap */
                       constant_data,
                       transform::Rigid3d::Rotation(global_node_rotation),
                       transform::Rigid3d::Rotation(global_submap_rotation),
                       *scan_matcher, constraint);
+    kGlobalConstraintSearchDurationMetric->Observe(
+        common::ToSeconds(std::chrono::steady_clock::now() - start_time));
+    AddCpuTime(node_id.trajectory_id,
+               TrajectoryCpuTimeMetrics::Activity::kConstraintSearch,
+               start_cpu_time_seconds);
   });
+  // Searches in full submaps are expensive and can wait for other work.
+  constraint_task->SetPriority(common::Task::LOW);
   constraint_task->AddDependency(scan_matcher->creation_task_handle);
   auto constraint_task_handle =
       thread_pool_->Schedule(std::move(constraint_task));
@@ -153,6 +182,7 @@ void ConstraintBuilder3D::NotifyEndOfNode() {
   finish_node_task_ = absl::make_unique<common::Task>();
   when_done_task_->AddDependency(finish_node_task_handle);
   ++num_started_nodes_;
+  MaybeEvictScanMatchers();
 }
 
 void ConstraintBuilder3D::WhenDone(
@@ -167,34 +197,99 @@ void ConstraintBuilder3D::WhenDone(
   when_done_task_ = absl::make_unique<common::Task>();
 }
 
-const ConstraintBuilder3D::SubmapScanMatcher*
+std::shared_ptr<const ConstraintBuilder3D::SubmapScanMatcher>
 ConstraintBuilder3D::DispatchScanMatcherConstruction(const SubmapId& submap_id,
                                                      const Submap3D* submap) {
-  if (submap_scan_matchers_.count(submap_id) != 0) {
-    return &submap_scan_matchers_.at(submap_id);
+  const auto it = submap_scan_matchers_.find(submap_id);
+  if (it != submap_scan_matchers_.end()) {
+    it->second->last_use = ++num_scan_matcher_uses_;
+    return it->second;
+  }
+  if (evicted_submap_ids_.erase(submap_id) != 0) {
+    kSubmapScanMatcherRebuildsMetric->Increment();
   }
-  auto& submap_scan_matcher = submap_scan_matchers_[submap_id];
+  const auto submap_scan_matcher = std::make_shared<SubmapScanMatcher>();
+  submap_scan_matchers_.emplace(submap_id, submap_scan_matcher);
   kNumSubmapScanMatchersMetric->Set(submap_scan_matchers_.size());
-  submap_scan_matcher.high_resolution_hybrid_grid =
+  submap_scan_matcher->high_resolution_hybrid_grid =
       &submap->high_resolution_hybrid_grid();
-  submap_scan_matcher.low_resolution_hybrid_grid =
+  submap_scan_matcher->low_resolution_hybrid_grid =
       &submap->low_resolution_hybrid_grid();
+  submap_scan_matcher->last_use = ++num_scan_matcher_uses_;
   auto& scan_matcher_options =
       options_.fast_correlative_scan_matcher_options_3d();
   const Eigen::VectorXf* histogram =
       &submap->rotational_scan_matcher_histogram();
   auto scan_matcher_task = absl::make_unique<common::Task>();
-  scan_matcher_task->SetWorkItem(
-      [&submap_scan_matcher, &scan_matcher_options, histogram]() {
-        submap_scan_matcher.fast_correlative_scan_matcher =
-            absl::make_unique<scan_matching::FastCorrelativeScanMatcher3D>(
-                *submap_scan_matcher.high_resolution_hybrid_grid,
-                submap_scan_matcher.low_resolution_hybrid_grid, histogram,
-                scan_matcher_options);
-      });
-  submap_scan_matcher.creation_task_handle =
+  scan_matcher_task->SetWorkItem([this, submap_id, submap_scan_matcher,
+                                  &scan_matcher_options, histogram]() {
+    const double start_cpu_time_seconds = common::GetThreadCpuTimeSeconds();
+    submap_scan_matcher->fast_correlative_scan_matcher =
+        absl::make_unique<scan_matching::FastCorrelativeScanMatcher3D>(
+            *submap_scan_matcher->high_resolution_hybrid_grid,
+            submap_scan_matcher->low_resolution_hybrid_grid, histogram,
+            scan_matcher_options);
+    AddCpuTime(submap_id.trajectory_id,
+               TrajectoryCpuTimeMetrics::Activity::kScanMatcherConstruction,
+               start_cpu_time_seconds);
+  });
+  submap_scan_matcher->creation_task_handle =
       thread_pool_->Schedule(std::move(scan_matcher_task));
-  return &submap_scan_matchers_.at(submap_id);
+  return submap_scan_matcher;
+}
+
+void ConstraintBuilder3D::AddCpuTime(
+    const int trajectory_id, const TrajectoryCpuTimeMetrics::Activity activity,
+    const double start_cpu_time_seconds) const {
+  if (trajectory_cpu_time_metrics_ == nullptr) return;
+  trajectory_cpu_time_metrics_->Add(
+      trajectory_id, activity,
+      common::GetThreadCpuTimeSeconds() - start_cpu_time_seconds);
+}
+
+void ConstraintBuilder3D::MaybeEvictScanMatchers() {
+  const uint64 max_memory_in_bytes =
+      static_cast<uint64>(options_.max_submap_scan_matchers_memory_in_mb())
+      << 20;
+  if (max_memory_in_bytes == 0) {
+    return;
+  }
+  // Scan matchers still being constructed are neither counted nor evicted.
+  std::vector<std::tuple<uint64, SubmapId, size_t>> constructed_scan_matchers;
+  uint64 memory_in_bytes = 0;
+  for (const auto& submap_id_scan_matcher : submap_scan_matchers_) {
+    const SubmapScanMatcher& submap_scan_matcher =
+        *submap_id_scan_matcher.second;
+    const std::shared_ptr<common::Task> creation_task =
+        submap_scan_matcher.creation_task_handle.lock();
+    if (creation_task != nullptr &&
+        creation_task->GetState() != common::Task::COMPLETED) {
+      continue;
+    }
+    const size_t scan_matcher_memory_in_bytes =
+        submap_scan_matcher.fast_correlative_scan_matcher
+            ->MemoryUsageInBytes();
+    memory_in_bytes += scan_matcher_memory_in_bytes;
+    constructed_scan_matchers.emplace_back(submap_scan_matcher.last_use,
+                                           submap_id_scan_matcher.first,
+                                           scan_matcher_memory_in_bytes);
+  }
+  if (memory_in_bytes > max_memory_in_bytes) {
+    std::sort(constructed_scan_matchers.begin(),
+              constructed_scan_matchers.end());
+    for (const auto& scan_matcher : constructed_scan_matchers) {
+      if (memory_in_bytes <= max_memory_in_bytes) {
+        break;
+      }
+      const SubmapId& submap_id = std::get<1>(scan_matcher);
+      submap_scan_matchers_.erase(submap_id);
+      evicted_submap_ids_.insert(submap_id);
+      memory_in_bytes -= std::get<2>(scan_matcher);
+      kSubmapScanMatcherEvictionsMetric->Increment();
+    }
+    kNumSubmapScanMatchersMetric->Set(submap_scan_matchers_.size());
+  }
+  kSubmapScanMatchersMemoryMetric->Set(memory_in_bytes);
 }
 
 void ConstraintBuilder3D::ComputeConstraint(
@@ -344,6 +439,7 @@ void ConstraintBuilder3D::DeleteScanMatcher(const SubmapId& submap_id) {
         << "DeleteScanMatcher was called while WhenDone was scheduled.";
   }
   submap_scan_matchers_.erase(submap_id);
+  evicted_submap_ids_.erase(submap_id);
   per_submap_sampler_.erase(submap_id);
   kNumSubmapScanMatchersMetric->Set(submap_scan_matchers_.size());
 }
@@ -383,6 +479,26 @@ void ConstraintBuilder3D::RegisterMetrics(metrics::FamilyFactory* factory) {
       "mapping_constraints_constraint_builder_3d_num_submap_scan_matchers",
       "Current number of constructed submap scan matchers");
   kNumSubmapScanMatchersMetric = num_matchers->Add({});
+  auto* matchers_memory = factory->NewGaugeFamily(
+      "mapping_constraints_constraint_builder_3d_submap_scan_matchers_memory",
+      "Memory used by constructed submap scan matchers in bytes, only "
+      "measured if their memory is limited");
+  kSubmapScanMatchersMemoryMetric = matchers_memory->Add({});
+  auto* matcher_cache = factory->NewCounterFamily(
+      "mapping_constraints_constraint_builder_3d_submap_scan_matcher_cache",
+      "Submap scan matchers evicted for the memory limit or rebuilt");
+  kSubmapScanMatcherEvictionsMetric =
+      matcher_cache->Add({{"event", "evicted"}});
+  kSubmapScanMatcherRebuildsMetric =
+      matcher_cache->Add({{"event", "rebuilt"}});
+  auto* search_duration = factory->NewHistogramFamily(
+      "mapping_constraints_constraint_builder_3d_search_duration",
+      "Wall time in seconds to search for a constraint",
+      metrics::Histogram::ScaledPowersOf(2, 1e-4, 100));
+  kConstraintSearchDurationMetric =
+      search_duration->Add({{"search_region", "local"}});
+  kGlobalConstraintSearchDurationMetric =
+      search_duration->Add({{"search_region", "global"}});
 }
 
 }  // namespace constraints
@@ -22,6 +22,8 @@
 #include <functional>
 #include <limits>
 #include <map>
+#include <memory>
+#include <set>
 #include <vector>
 
 #include "Eigen/Core"
@@ -36,6 +38,7 @@
 #include "cartographer/mapping/3d/submap_3d.h"
 #include "cartographer/mapping/internal/3d/scan_matching/ceres_scan_matcher_3d.h"
 #include "cartographer/mapping/internal/3d/scan_matching/fast_correlative_scan_matcher_3d.h"
+#include "cartographer/mapping/internal/trajectory_cpu_time_metrics.h"
 #include "cartographer/mapping/pose_graph_interface.h"
 #include "cartographer/mapping/proto/pose_graph/constraint_builder_options.pb.h"
 #include "cartographer/mapping/trajectory_node.h"
@@ -61,8 +64,13 @@ class ConstraintBuilder3D {
   using Constraint = mapping::PoseGraphInterface::Constraint;
   using Result = std::vector<Constraint>;
 
-  ConstraintBuilder3D(const proto::ConstraintBuilderOptions& options,
-                      common::ThreadPoolInterface* thread_pool);
+  // If 'trajectory_cpu_time_metrics' is not nullptr, the thread CPU time of
+  // constraint searches and scan matcher construction is attributed to
+  // trajectories there.
+  ConstraintBuilder3D(
+      const proto::ConstraintBuilderOptions& options,
+      common::ThreadPoolInterface* thread_pool,
+      TrajectoryCpuTimeMetrics* trajectory_cpu_time_metrics = nullptr);
   ~ConstraintBuilder3D();
 
   ConstraintBuilder3D(const ConstraintBuilder3D&) = delete;
@@ -120,14 +128,27 @@ class ConstraintBuilder3D {
     std::unique_ptr<scan_matching::FastCorrelativeScanMatcher3D>
         fast_correlative_scan_matcher;
     std::weak_ptr<common::Task> creation_task_handle;
+    // Value of 'num_scan_matcher_uses_' when the scan matcher was last used.
+    // Guarded by 'mutex_'.
+    uint64 last_use = 0;
   };
 
   // The returned 'grid' and 'fast_correlative_scan_matcher' must only be
   // accessed after 'creation_task_handle' has completed.
-  const SubmapScanMatcher* DispatchScanMatcherConstruction(
+  std::shared_ptr<const SubmapScanMatcher> DispatchScanMatcherConstruction(
       const SubmapId& submap_id, const Submap3D* submap)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Attributes the thread CPU time since 'start_cpu_time_seconds' to
+  // 'trajectory_id'.
+  void AddCpuTime(int trajectory_id,
+                  TrajectoryCpuTimeMetrics::Activity activity,
+                  double start_cpu_time_seconds) const;
+
+  // Deletes the least recently used constructed scan matchers while they use
+  // more than 'max_submap_scan_matchers_memory_in_mb'.
+  void MaybeEvictScanMatchers() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   // Runs in a background thread and does computations for an additional
   // constraint.
   // As output, it may create a new Constraint in 'constraint'.
@@ -144,6 +165,7 @@ class ConstraintBuilder3D {
 
   const proto::ConstraintBuilderOptions options_;
   common::ThreadPoolInterface* thread_pool_;
+  TrajectoryCpuTimeMetrics* const trajectory_cpu_time_metrics_;
   absl::Mutex mutex_;
 
   // 'callback' set by WhenDone().
@@ -167,9 +189,14 @@ class ConstraintBuilder3D {
   // with below-threshold scores are also 'nullptr'.
   std::deque<std::unique_ptr<Constraint>> constraints_ GUARDED_BY(mutex_);
 
-  // Map of dispatched or constructed scan matchers by 'submap_id'.
-  std::map<SubmapId, SubmapScanMatcher> submap_scan_matchers_
+  // Map of dispatched or constructed scan matchers by 'submap_id'. They are
+  // shared with the computations using them, so that deleting or evicting
+  // them does not affect computations in progress.
+  std::map<SubmapId, std::shared_ptr<SubmapScanMatcher>> submap_scan_matchers_
       GUARDED_BY(mutex_);
+  uint64 num_scan_matcher_uses_ GUARDED_BY(mutex_) = 0;
+  // Submaps whose scan matchers were evicted and not constructed again yet.
+  std::set<SubmapId> evicted_submap_ids_ GUARDED_BY(mutex_);
   std::map<SubmapId, common::FixedRatioSampler> per_submap_sampler_;
 
   scan_matching::CeresScanMatcher3D ceres_scan_matcher_;
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "cartographer/mapping/internal/constraints/global_localization_grid_2d.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#include "Eigen/Geometry"
+#include "absl/memory/memory.h"
+#include "cartographer/mapping/2d/xy_index.h"
+#include "cartographer/transform/transform.h"
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace mapping {
+namespace constraints {
+namespace {
+
+// Returns the corners of the area covered by the cells of 'limits'.
+std::array<Eigen::Vector2d, 4> GetCorners(const MapLimits& limits) {
+  const Eigen::Vector2d& max = limits.max();
+  const Eigen::Vector2d min =
+      max - limits.resolution() *
+                Eigen::Vector2d(limits.cell_limits().num_y_cells,
+                                limits.cell_limits().num_x_cells);
+  return {{min, Eigen::Vector2d(min.x(), max.y()),
+           Eigen::Vector2d(max.x(), min.y()), max}};
+}
+
+}  // namespace
+
+GlobalLocalizationGrid2D::GlobalLocalizationGrid2D(
+    const std::vector<SubmapData>& submaps,
+    const scan_matching::proto::FastCorrelativeScanMatcherOptions2D& options,
+    const double linear_search_window)
+    : linear_search_window_(linear_search_window) {
+  struct SourceGrid {
+    std::shared_ptr<const Grid2D> grid;
+    // (map <- grid), the grid is in the local map frame of its submap.
+    transform::Rigid2d grid_to_map;
+  };
+  std::vector<SourceGrid> source_grids;
+  Eigen::AlignedBox2d bounding_box;
+  double resolution = 0.;
+  for (const SubmapData& submap_data : submaps) {
+    source_submap_ids_.push_back(submap_data.submap_id);
+    std::shared_ptr<const Grid2D> grid = submap_data.submap->LoadGrid();
+    if (grid == nullptr || grid->GetGridType() != GridType::PROBABILITY_GRID) {
+      continue;
+    }
+    if (resolution == 0.) {
+      resolution = grid->limits().resolution();
+    }
+    if (grid->limits().resolution() != resolution) {
+      LOG(WARNING) << "Submap " << submap_data.submap_id
+                   << " is not added to the global localization grid, its "
+                      "resolution differs.";
+      continue;
+    }
+    // See ComputeSubmapPose() for the submap frame.
+    const transform::Rigid2d grid_to_map =
+        submap_data.global_pose *
+        transform::Project2D(submap_data.submap->local_pose()).inverse();
+    for (const Eigen::Vector2d& corner : GetCorners(grid->limits())) {
+      bounding_box.extend(grid_to_map * corner);
+    }
+    submap_ids_.insert(submap_data.submap_id);
+    trajectory_ids_.insert(submap_data.submap_id.trajectory_id);
+    submap_global_poses_.emplace_back(submap_data.submap_id,
+                                      submap_data.global_pose);
+    source_grids.push_back({std::move(grid), grid_to_map});
+  }
+  if (source_grids.empty()) {
+    return;
+  }
+
+  const Eigen::Vector2d extent = bounding_box.sizes();
+  const MapLimits limits(
+      resolution, bounding_box.max(),
+      CellLimits(common::RoundToInt(std::ceil(extent.y() / resolution)) + 1,
+                 common::RoundToInt(std::ceil(extent.x() / resolution)) + 1));
+  const CellLimits& cell_limits = limits.cell_limits();
+  // Sampled at the cell centers of the fused grid, so that rotated submaps
+  // leave no gaps. 0 marks cells which are unknown in all submaps.
+  std::vector<float> probabilities(
+      cell_limits.num_x_cells * cell_limits.num_y_cells, 0.f);
+  for (const SourceGrid& source_grid : source_grids) {
+    const auto& probability_grid =
+        static_cast<const ProbabilityGrid&>(*source_grid.grid);
+    const MapLimits& source_limits = probability_grid.limits();
+    const transform::Rigid2f map_to_grid =
+        source_grid.grid_to_map.inverse().cast<float>();
+    Eigen::Array2i min_xy_index =
+        Eigen::Array2i::Constant(std::numeric_limits<int>::max());
+    Eigen::Array2i max_xy_index =
+        Eigen::Array2i::Constant(std::numeric_limits<int>::min());
+    for (const Eigen::Vector2d& corner : GetCorners(source_limits)) {
+      const Eigen::Array2i xy_index =
+          limits.GetCellIndex((source_grid.grid_to_map * corner).cast<float>());
+      min_xy_index = min_xy_index.min(xy_index);
+      max_xy_index = max_xy_index.max(xy_index);
+    }
+    min_xy_index = min_xy_index.max(Eigen::Array2i::Zero());
+    max_xy_index = max_xy_index.min(Eigen::Array2i(
+        cell_limits.num_x_cells - 1, cell_limits.num_y_cells - 1));
+    for (const Eigen::Array2i& xy_index :
+         XYIndexRangeIterator(min_xy_index, max_xy_index)) {
+      const Eigen::Array2i source_xy_index = source_limits.GetCellIndex(
+          map_to_grid * limits.GetCellCenter(xy_index));
+      if (!probability_grid.IsKnown(source_xy_index)) continue;
+      float& probability =
+          probabilities[xy_index.x() + xy_index.y() * cell_limits.num_x_cells];
+      probability = std::max(probability,
+                             probability_grid.GetProbability(source_xy_index));
+    }
+  }
+  source_grids.clear();
+
+  grid_ = absl::make_unique<ProbabilityGrid>(limits, &conversion_tables_);
+  for (const Eigen::Array2i& xy_index : XYIndexRangeIterator(cell_limits)) {
+    const float probability =
+        probabilities[xy_index.x() + xy_index.y() * cell_limits.num_x_cells];
+    if (probability > 0.f) {
+      grid_->SetProbability(xy_index, probability);
+    }
+  }
+  scan_matching::proto::FastCorrelativeScanMatcherOptions2D matcher_options =
+      options;
+  if (linear_search_window_ > 0.) {
+    matcher_options.set_linear_search_window(linear_search_window_);
+    matcher_options.set_angular_search_window(M_PI);
+  }
+  fast_correlative_scan_matcher_ =
+      absl::make_unique<scan_matching::FastCorrelativeScanMatcher2D>(
+          *grid_, matcher_options);
+}
+
+bool GlobalLocalizationGrid2D::Match(
+    const transform::Rigid2d& initial_pose_estimate,
+    const sensor::PointCloud& point_cloud, const float min_score,
+    common::ThreadPoolInterface* const thread_pool, float* const score,
+    transform::Rigid2d* const pose_estimate) const {
+  if (empty()) {
+    return false;
+  }
+  if (linear_search_window_ > 0.) {
+    return fast_correlative_scan_matcher_->Match(
+        initial_pose_estimate, point_cloud, min_score, score, pose_estimate);
+  }
+  return fast_correlative_scan_matcher_->MatchFullSubmap(
+      point_cloud, min_score, thread_pool, score, pose_estimate);
+}
+
+SubmapId GlobalLocalizationGrid2D::GetNearestSubmap(
+    const Eigen::Vector2d& position,
+    transform::Rigid2d* const global_pose) const {
+  CHECK(!empty());
+  const auto nearest = std::min_element(
+      submap_global_poses_.begin(), submap_global_poses_.end(),
+      [&position](const std::pair<SubmapId, transform::Rigid2d>& lhs,
+                  const std::pair<SubmapId, transform::Rigid2d>& rhs) {
+        return (lhs.second.translation() - position).squaredNorm() <
+               (rhs.second.translation() - position).squaredNorm();
+      });
+  *global_pose = nearest->second;
+  return nearest->first;
+}
+
+}  // namespace constraints
+}  // namespace mapping
+}  // namespace cartographer
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef CARTOGRAPHER_MAPPING_INTERNAL_CONSTRAINTS_GLOBAL_LOCALIZATION_GRID_2D_H_
+#define CARTOGRAPHER_MAPPING_INTERNAL_CONSTRAINTS_GLOBAL_LOCALIZATION_GRID_2D_H_
+
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "Eigen/Core"
+#include "cartographer/common/thread_pool.h"
+#include "cartographer/mapping/2d/probability_grid.h"
+#include "cartographer/mapping/2d/submap_2d.h"
+#include "cartographer/mapping/id.h"
+#include "cartographer/mapping/internal/2d/scan_matching/fast_correlative_scan_matcher_2d.h"
+#include "cartographer/mapping/proto/scan_matching/fast_correlative_scan_matcher_options_2d.pb.h"
+#include "cartographer/mapping/value_conversion_tables.h"
+#include "cartographer/sensor/point_cloud.h"
+#include "cartographer/transform/rigid_transform.h"
+
+namespace cartographer {
+namespace mapping {
+namespace constraints {
+
+// The probability grids of finished submaps fused into one grid in the global
+// map frame, with one fast correlative scan matcher for it. Global
+// localization against these submaps is then a single branch-and-bound search
+// per node instead of one full submap match per submap, and overlapping
+// submaps share one precomputation grid stack.
+//
+// Each cell holds the highest probability of the submap cells at its center.
+// Submaps with a grid which is not a probability grid or which has a
+// different resolution than the first submap are left out.
+class GlobalLocalizationGrid2D {
+ public:
+  struct SubmapData {
+    SubmapId submap_id;
+    // (map <- submap), see ComputeSubmapPose().
+    transform::Rigid2d global_pose;
+    std::shared_ptr<const Submap2D> submap;
+  };
+
+  // Loads and fuses the grids of 'submaps'. If 'linear_search_window' is
+  // positive, Match() only searches within it around the initial pose
+  // estimate, with any rotation. Otherwise, the whole grid is searched.
+  GlobalLocalizationGrid2D(
+      const std::vector<SubmapData>& submaps,
+      const scan_matching::proto::FastCorrelativeScanMatcherOptions2D& options,
+      double linear_search_window);
+
+  GlobalLocalizationGrid2D(const GlobalLocalizationGrid2D&) = delete;
+  GlobalLocalizationGrid2D& operator=(const GlobalLocalizationGrid2D&) =
+      delete;
+
+  // Aligns 'point_cloud' in the fused grid, see
+  // FastCorrelativeScanMatcher2D. 'initial_pose_estimate' and 'pose_estimate'
+  // are in the global map frame. The search of the whole grid is split into
+  // tasks on 'thread_pool'.
+  bool Match(const transform::Rigid2d& initial_pose_estimate,
+             const sensor::PointCloud& point_cloud, float min_score,
+             common::ThreadPoolInterface* thread_pool, float* score,
+             transform::Rigid2d* pose_estimate) const;
+
+  // Returns the ID of the fused submap whose origin is nearest to 'position'
+  // in the global map frame, and its 'global_pose'.
+  SubmapId GetNearestSubmap(const Eigen::Vector2d& position,
+                            transform::Rigid2d* global_pose) const;
+
+  // Whether the grid of 'submap_id' was fused.
+  bool Contains(const SubmapId& submap_id) const {
+    return submap_ids_.count(submap_id) != 0;
+  }
+
+  // IDs of all submaps this grid was created from, including the ones which
+  // were left out.
+  const std::vector<SubmapId>& source_submap_ids() const {
+    return source_submap_ids_;
+  }
+
+  // Trajectories with fused submaps.
+  const std::set<int>& trajectory_ids() const { return trajectory_ids_; }
+
+  // Empty if no submap was fused.
+  bool empty() const { return submap_ids_.empty(); }
+
+  const ProbabilityGrid& grid() const { return *grid_; }
+
+ private:
+  std::vector<SubmapId> source_submap_ids_;
+  std::set<SubmapId> submap_ids_;
+  std::set<int> trajectory_ids_;
+  std::vector<std::pair<SubmapId, transform::Rigid2d>> submap_global_poses_;
+  const double linear_search_window_;
+  ValueConversionTables conversion_tables_;
+  std::unique_ptr<ProbabilityGrid> grid_;
+  std::unique_ptr<scan_matching::FastCorrelativeScanMatcher2D>
+      fast_correlative_scan_matcher_;
+};
+
+}  // namespace constraints
+}  // namespace mapping
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_MAPPING_INTERNAL_CONSTRAINTS_GLOBAL_LOCALIZATION_GRID_2D_H_
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "cartographer/mapping/internal/constraints/global_localization_grid_2d.h"
+
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "cartographer/transform/rigid_transform_test_helpers.h"
+#include "cartographer/transform/transform.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace constraints {
+namespace {
+
+constexpr float kMinScore = 0.5f;
+
+scan_matching::proto::FastCorrelativeScanMatcherOptions2D CreateOptions() {
+  scan_matching::proto::FastCorrelativeScanMatcherOptions2D options;
+  options.set_linear_search_window(3.);
+  options.set_angular_search_window(1.);
+  options.set_branch_and_bound_depth(6);
+  return options;
+}
+
+sensor::PointCloud CreatePointCloud() {
+  sensor::PointCloud point_cloud;
+  point_cloud.push_back({Eigen::Vector3f{-2.5f, 0.5f, 0.f}});
+  point_cloud.push_back({Eigen::Vector3f{-2.25f, 0.5f, 0.f}});
+  point_cloud.push_back({Eigen::Vector3f{0.f, 0.5f, 0.f}});
+  point_cloud.push_back({Eigen::Vector3f{0.25f, 1.6f, 0.f}});
+  point_cloud.push_back({Eigen::Vector3f{2.5f, 0.5f, 0.f}});
+  point_cloud.push_back({Eigen::Vector3f{2.f, 1.8f, 0.f}});
+  point_cloud.push_back({Eigen::Vector3f{1.f, -1.5f, 0.f}});
+  return point_cloud;
+}
+
+// Creates a submap at 'origin' in which 'point_cloud' was observed at
+// 'local_pose'.
+std::shared_ptr<const Submap2D> CreateSubmap(
+    const Eigen::Vector2f& origin, const transform::Rigid2f& local_pose,
+    const sensor::PointCloud& point_cloud,
+    ValueConversionTables* conversion_tables) {
+  auto grid = absl::make_unique<ProbabilityGrid>(
+      MapLimits(0.05, origin.cast<double>() + Eigen::Vector2d(6., 6.),
+                CellLimits(240, 240)),
+      conversion_tables);
+  for (const sensor::RangefinderPoint& point :
+       sensor::TransformPointCloud(point_cloud,
+                                   transform::Embed3D(local_pose))) {
+    const Eigen::Array2i xy_index =
+        grid->limits().GetCellIndex(point.position.head<2>());
+    if (!grid->IsKnown(xy_index)) {
+      grid->SetProbability(xy_index, 0.9f);
+    }
+  }
+  return std::make_shared<const Submap2D>(origin, std::move(grid),
+                                          conversion_tables);
+}
+
+class GlobalLocalizationGrid2DTest : public ::testing::Test {
+ protected:
+  GlobalLocalizationGrid2DTest()
+      : point_cloud_(CreatePointCloud()),
+        local_pose_({1.5, -0.5}, 0.2),
+        global_pose_({10., 5.}, 0.7) {
+    submaps_.push_back(
+        {SubmapId{0, 0}, global_pose_,
+         CreateSubmap(Eigen::Vector2f(1.f, 0.f), local_pose_.cast<float>(),
+                      point_cloud_, &conversion_tables_)});
+    // Another submap far away which only saw a part of the points.
+    submaps_.push_back(
+        {SubmapId{0, 1}, transform::Rigid2d({40., 5.}, 0.),
+         CreateSubmap(Eigen::Vector2f::Zero(),
+                      transform::Rigid2f({0.f, 3.f}, 2.f),
+                      sensor::PointCloud({point_cloud_[0], point_cloud_[2]}),
+                      &conversion_tables_)});
+    // (map <- node) for the observation in the first submap.
+    expected_pose_ = global_pose_ *
+                     transform::Rigid2d::Translation({1., 0.}).inverse() *
+                     local_pose_;
+  }
+
+  ValueConversionTables conversion_tables_;
+  const sensor::PointCloud point_cloud_;
+  const transform::Rigid2d local_pose_;
+  const transform::Rigid2d global_pose_;
+  transform::Rigid2d expected_pose_;
+  std::vector<GlobalLocalizationGrid2D::SubmapData> submaps_;
+};
+
+TEST_F(GlobalLocalizationGrid2DTest, MatchesInWholeGrid) {
+  const GlobalLocalizationGrid2D global_localization_grid(
+      submaps_, CreateOptions(), 0. /* linear_search_window */);
+  EXPECT_TRUE(global_localization_grid.Contains(SubmapId{0, 0}));
+  EXPECT_TRUE(global_localization_grid.Contains(SubmapId{0, 1}));
+  float score = 0.f;
+  transform::Rigid2d pose_estimate;
+  ASSERT_TRUE(global_localization_grid.Match(
+      transform::Rigid2d::Identity(), point_cloud_, kMinScore,
+      nullptr /* thread_pool */, &score, &pose_estimate));
+  EXPECT_LT(kMinScore, score);
+  EXPECT_THAT(pose_estimate, transform::IsNearly(expected_pose_, 0.05));
+
+  transform::Rigid2d submap_global_pose;
+  EXPECT_EQ((SubmapId{0, 0}), global_localization_grid.GetNearestSubmap(
+                                  pose_estimate.translation(),
+                                  &submap_global_pose));
+  EXPECT_THAT(submap_global_pose, transform::IsNearly(global_pose_, 1e-9));
+}
+
+TEST_F(GlobalLocalizationGrid2DTest, MatchesInSearchWindow) {
+  const GlobalLocalizationGrid2D global_localization_grid(
+      submaps_, CreateOptions(), 1. /* linear_search_window */);
+  float score = 0.f;
+  transform::Rigid2d pose_estimate;
+  ASSERT_TRUE(global_localization_grid.Match(
+      expected_pose_ * transform::Rigid2d({0.5, -0.4}, 2.5), point_cloud_,
+      kMinScore, nullptr /* thread_pool */, &score, &pose_estimate));
+  EXPECT_THAT(pose_estimate, transform::IsNearly(expected_pose_, 0.05));
+  // The observation is too far from the initial pose estimate.
+  EXPECT_FALSE(global_localization_grid.Match(
+      transform::Rigid2d::Translation({5., 0.}) * expected_pose_,
+      point_cloud_, kMinScore, nullptr /* thread_pool */, &score,
+      &pose_estimate));
+}
+
+TEST_F(GlobalLocalizationGrid2DTest, LeavesOutOtherResolutions) {
+  submaps_.push_back(
+      {SubmapId{1, 0}, transform::Rigid2d::Identity(),
+       std::make_shared<const Submap2D>(
+           Eigen::Vector2f::Zero(),
+           absl::make_unique<ProbabilityGrid>(
+               MapLimits(0.1, Eigen::Vector2d(1., 1.), CellLimits(20, 20)),
+               &conversion_tables_),
+           &conversion_tables_)});
+  const GlobalLocalizationGrid2D global_localization_grid(
+      submaps_, CreateOptions(), 0. /* linear_search_window */);
+  EXPECT_EQ(3, global_localization_grid.source_submap_ids().size());
+  EXPECT_FALSE(global_localization_grid.Contains(SubmapId{1, 0}));
+  EXPECT_EQ(std::set<int>{0}, global_localization_grid.trajectory_ids());
+}
+
+TEST(GlobalLocalizationGrid2DEmptyTest, DoesNotMatch) {
+  const GlobalLocalizationGrid2D global_localization_grid(
+      {}, CreateOptions(), 0. /* linear_search_window */);
+  EXPECT_TRUE(global_localization_grid.empty());
+  float score = 0.f;
+  transform::Rigid2d pose_estimate;
+  EXPECT_FALSE(global_localization_grid.Match(
+      transform::Rigid2d::Identity(), CreatePointCloud(), kMinScore,
+      nullptr /* thread_pool */, &score, &pose_estimate));
+}
+
+}  // namespace
+}  // namespace constraints
+}  // namespace mapping
+}  // namespace cartographer
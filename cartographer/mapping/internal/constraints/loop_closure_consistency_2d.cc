@@ -0,0 +1,150 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/constraints/loop_closure_consistency_2d.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+
+#include "cartographer/common/math.h"
+#include "cartographer/transform/transform.h"
+
+namespace cartographer {
+namespace mapping {
+namespace constraints {
+namespace {
+
+struct LoopClosure {
+  size_t index;
+  // Correction of the global poses implied by the loop closure.
+  transform::Rigid2d correction;
+  Eigen::Vector2d node_position;
+};
+
+bool AreConsistent(const LoopClosure& a, const LoopClosure& b,
+                   const double max_translation_error,
+                   const double max_rotation_error) {
+  const Eigen::Vector2d point = 0.5 * (a.node_position + b.node_position);
+  return (a.correction * point - b.correction * point).norm() <=
+             max_translation_error &&
+         std::abs(common::NormalizeAngleDifference(
+             a.correction.normalized_angle() -
+             b.correction.normalized_angle())) <= max_rotation_error;
+}
+
+// Returns the indices into 'loop_closures' which are to be removed.
+std::vector<size_t> FindInconsistentLoopClosures(
+    const std::vector<LoopClosure>& loop_closures,
+    const double max_translation_error, const double max_rotation_error) {
+  const size_t num_loop_closures = loop_closures.size();
+  std::vector<std::vector<bool>> consistent(
+      num_loop_closures, std::vector<bool>(num_loop_closures, true));
+  std::vector<int> degrees(num_loop_closures, 0);
+  for (size_t i = 0; i < num_loop_closures; ++i) {
+    for (size_t j = i + 1; j < num_loop_closures; ++j) {
+      if (AreConsistent(loop_closures[i], loop_closures[j],
+                        max_translation_error, max_rotation_error)) {
+        ++degrees[i];
+        ++degrees[j];
+      } else {
+        consistent[i][j] = consistent[j][i] = false;
+      }
+    }
+  }
+
+  // Greedily grow a set of mutually consistent loop closures, starting with
+  // those which are consistent with the most others.
+  std::vector<size_t> order(num_loop_closures);
+  for (size_t i = 0; i < num_loop_closures; ++i) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&degrees](size_t a, size_t b) {
+    return degrees[a] > degrees[b];
+  });
+  std::vector<bool> kept(num_loop_closures, false);
+  std::vector<size_t> kept_indices;
+  for (const size_t candidate : order) {
+    if (std::all_of(kept_indices.begin(), kept_indices.end(),
+                    [&](size_t i) { return consistent[candidate][i]; })) {
+      kept[candidate] = true;
+      kept_indices.push_back(candidate);
+    }
+  }
+
+  std::vector<size_t> removed;
+  if (kept_indices.size() < 2 ||
+      2 * kept_indices.size() <= num_loop_closures) {
+    return removed;
+  }
+  for (size_t i = 0; i < num_loop_closures; ++i) {
+    if (!kept[i]) removed.push_back(i);
+  }
+  return removed;
+}
+
+}  // namespace
+
+int RemoveInconsistentLoopClosures2D(
+    const MapById<SubmapId, optimization::SubmapSpec2D>& submap_data,
+    const MapById<NodeId, optimization::NodeSpec2D>& node_data,
+    const double max_translation_error, const double max_rotation_error,
+    std::vector<PoseGraphInterface::Constraint>* constraints) {
+  // Loop closures grouped by the trajectories of their node and submap.
+  std::map<std::pair<int, int>, std::vector<LoopClosure>> groups;
+  for (size_t i = 0; i < constraints->size(); ++i) {
+    const PoseGraphInterface::Constraint& constraint = (*constraints)[i];
+    if (constraint.tag != PoseGraphInterface::Constraint::INTER_SUBMAP ||
+        !submap_data.Contains(constraint.submap_id) ||
+        !node_data.Contains(constraint.node_id)) {
+      continue;
+    }
+    const transform::Rigid2d& global_node_pose =
+        node_data.at(constraint.node_id).global_pose_2d;
+    groups[std::make_pair(constraint.node_id.trajectory_id,
+                          constraint.submap_id.trajectory_id)]
+        .push_back(LoopClosure{
+            i,
+            submap_data.at(constraint.submap_id).global_pose *
+                transform::Project2D(constraint.pose.zbar_ij) *
+                global_node_pose.inverse(),
+            global_node_pose.translation()});
+  }
+
+  std::vector<bool> removed(constraints->size(), false);
+  int num_removed = 0;
+  for (const auto& group : groups) {
+    for (const size_t i :
+         FindInconsistentLoopClosures(group.second, max_translation_error,
+                                      max_rotation_error)) {
+      removed[group.second[i].index] = true;
+      ++num_removed;
+    }
+  }
+  if (num_removed == 0) return 0;
+
+  size_t num_kept = 0;
+  for (size_t i = 0; i < constraints->size(); ++i) {
+    if (!removed[i]) {
+      (*constraints)[num_kept++] = std::move((*constraints)[i]);
+    }
+  }
+  constraints->erase(constraints->begin() + num_kept, constraints->end());
+  return num_removed;
+}
+
+}  // namespace constraints
+}  // namespace mapping
+}  // namespace cartographer
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_MAPPING_INTERNAL_CONSTRAINTS_LOOP_CLOSURE_CONSISTENCY_2D_H_
+#define CARTOGRAPHER_MAPPING_INTERNAL_CONSTRAINTS_LOOP_CLOSURE_CONSISTENCY_2D_H_
+
+#include <vector>
+
+#include "cartographer/mapping/id.h"
+#include "cartographer/mapping/internal/optimization/optimization_problem_2d.h"
+#include "cartographer/mapping/pose_graph_interface.h"
+
+namespace cartographer {
+namespace mapping {
+namespace constraints {
+
+// Removes the loop closures from 'constraints' which disagree with the
+// majority of the loop closures between the same pair of trajectories, in the
+// spirit of pairwise consistency maximization.
+//
+// A loop closure of node j to submap i implies the correction
+// 'global_submap_pose_i * zbar_ij * global_node_pose_j^-1' of the current
+// global poses. Two loop closures are consistent if their corrections move the
+// point halfway between their nodes to within 'max_translation_error' meters of
+// each other and their rotations differ by at most 'max_rotation_error'
+// radians. A greedily grown set of mutually consistent loop closures is kept,
+// and the others are only removed if this set has at least two members and is
+// larger than the rest, so that a single or an undecided loop closure is left
+// to the robust loss of the optimization. Intra submap constraints and
+// constraints whose submap or node is not in 'submap_data' or 'node_data' are
+// kept. Returns the number of removed loop closures.
+int RemoveInconsistentLoopClosures2D(
+    const MapById<SubmapId, optimization::SubmapSpec2D>& submap_data,
+    const MapById<NodeId, optimization::NodeSpec2D>& node_data,
+    double max_translation_error, double max_rotation_error,
+    std::vector<PoseGraphInterface::Constraint>* constraints);
+
+}  // namespace constraints
+}  // namespace mapping
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_MAPPING_INTERNAL_CONSTRAINTS_LOOP_CLOSURE_CONSISTENCY_2D_H_
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/constraints/loop_closure_consistency_2d.h"
+
+#include "cartographer/transform/transform.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace constraints {
+namespace {
+
+using Constraint = PoseGraphInterface::Constraint;
+
+constexpr double kMaxTranslationError = 0.5;
+constexpr double kMaxRotationError = 0.1;
+
+class LoopClosureConsistency2DTest : public ::testing::Test {
+ protected:
+  LoopClosureConsistency2DTest() {
+    // Submaps of trajectory 0 and nodes of trajectory 1 along a line. The
+    // global poses of trajectory 1 are off by 'kOffset' from the truth.
+    for (int i = 0; i < 10; ++i) {
+      submap_data_.Insert(
+          SubmapId{0, i},
+          optimization::SubmapSpec2D{
+              transform::Rigid2d::Translation(Eigen::Vector2d(i, 0.))});
+      node_data_.Insert(
+          NodeId{1, i},
+          optimization::NodeSpec2D{
+              common::FromUniversal(i), transform::Rigid2d::Identity(),
+              kOffset * TrueNodePose(i), Eigen::Quaterniond::Identity()});
+    }
+  }
+
+  static transform::Rigid2d TrueNodePose(const int index) {
+    return transform::Rigid2d(Eigen::Vector2d(index, 1.), 0.2 * index);
+  }
+
+  // A loop closure of node 'node_index' to submap 'submap_index', wrong by
+  // 'error'.
+  Constraint LoopClosure(const int submap_index, const int node_index,
+                         const transform::Rigid2d& error) {
+    const transform::Rigid2d relative_pose =
+        submap_data_.at(SubmapId{0, submap_index}).global_pose.inverse() *
+        TrueNodePose(node_index) * error;
+    return Constraint{SubmapId{0, submap_index},
+                      NodeId{1, node_index},
+                      {transform::Embed3D(relative_pose), 1., 1.},
+                      Constraint::INTER_SUBMAP};
+  }
+
+  int RemoveInconsistentLoopClosures(std::vector<Constraint>* constraints) {
+    return RemoveInconsistentLoopClosures2D(submap_data_, node_data_,
+                                            kMaxTranslationError,
+                                            kMaxRotationError, constraints);
+  }
+
+  const transform::Rigid2d kOffset{Eigen::Vector2d(2., -1.), 0.3};
+  MapById<SubmapId, optimization::SubmapSpec2D> submap_data_;
+  MapById<NodeId, optimization::NodeSpec2D> node_data_;
+};
+
+TEST_F(LoopClosureConsistency2DTest, KeepsConsistentLoopClosures) {
+  std::vector<Constraint> constraints;
+  for (int i = 0; i < 5; ++i) {
+    constraints.push_back(LoopClosure(
+        i, 2 * i, transform::Rigid2d(Eigen::Vector2d(0.05 * i, 0.), 0.01)));
+  }
+  EXPECT_EQ(0, RemoveInconsistentLoopClosures(&constraints));
+  EXPECT_EQ(5, constraints.size());
+}
+
+TEST_F(LoopClosureConsistency2DTest, RemovesOutliers) {
+  std::vector<Constraint> constraints;
+  for (int i = 0; i < 4; ++i) {
+    constraints.push_back(
+        LoopClosure(i, 2 * i, transform::Rigid2d::Identity()));
+  }
+  constraints.push_back(
+      LoopClosure(5, 9, transform::Rigid2d::Translation({3., 0.})));
+  constraints.push_back(LoopClosure(6, 1, transform::Rigid2d::Rotation(0.5)));
+  constraints.push_back(Constraint{SubmapId{0, 0},
+                                   NodeId{1, 0},
+                                   {transform::Rigid3d::Identity(), 1., 1.},
+                                   Constraint::INTRA_SUBMAP});
+  EXPECT_EQ(2, RemoveInconsistentLoopClosures(&constraints));
+  ASSERT_EQ(5, constraints.size());
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ((NodeId{1, 2 * i}), constraints[i].node_id);
+  }
+  EXPECT_EQ(Constraint::INTRA_SUBMAP, constraints[4].tag);
+}
+
+TEST_F(LoopClosureConsistency2DTest, KeepsUndecidedLoopClosures) {
+  std::vector<Constraint> constraints{
+      LoopClosure(0, 0, transform::Rigid2d::Identity()),
+      LoopClosure(1, 3, transform::Rigid2d::Identity()),
+      LoopClosure(2, 5, transform::Rigid2d::Translation({3., 0.})),
+      LoopClosure(3, 7, transform::Rigid2d::Translation({3., 0.}))};
+  EXPECT_EQ(0, RemoveInconsistentLoopClosures(&constraints));
+  EXPECT_EQ(4, constraints.size());
+
+  std::vector<Constraint> single_constraint{
+      LoopClosure(0, 0, transform::Rigid2d::Translation({3., 0.}))};
+  EXPECT_EQ(0, RemoveInconsistentLoopClosures(&single_constraint));
+  EXPECT_EQ(1, single_constraint.size());
+}
+
+}  // namespace
+}  // namespace constraints
+}  // namespace mapping
+}  // namespace cartographer
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "cartographer/mapping/internal/constraints/submap_descriptor_index_2d.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "cartographer/common/port.h"
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace mapping {
+namespace constraints {
+namespace {
+
+constexpr float kMaxOccupiedCorrespondenceCost = 0.5f;
+
+// Computes the descriptor from the offsets of occupied positions from the
+// center.
+Eigen::VectorXf ComputeDescriptorFromOffsets(
+    const std::vector<Eigen::Vector2f>& offsets, const float resolution,
+    const int num_rings, const float max_range) {
+  CHECK_GT(resolution, 0.f);
+  CHECK_GT(num_rings, 0);
+  CHECK_GT(max_range, 0.f);
+  std::vector<std::pair<int, int>> cells;
+  cells.reserve(offsets.size());
+  for (const Eigen::Vector2f& offset : offsets) {
+    cells.emplace_back(common::RoundToInt(offset.x() / resolution),
+                       common::RoundToInt(offset.y() / resolution));
+  }
+  std::sort(cells.begin(), cells.end());
+  cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+
+  Eigen::VectorXf descriptor = Eigen::VectorXf::Zero(num_rings);
+  for (const auto& cell : cells) {
+    const float distance =
+        resolution * std::hypot(static_cast<float>(cell.first),
+                                static_cast<float>(cell.second));
+    if (distance >= max_range) continue;
+    const int ring =
+        std::min(static_cast<int>(distance / max_range * num_rings),
+                 num_rings - 1);
+    descriptor[ring] += 1.f;
+  }
+  const float sum = descriptor.sum();
+  if (sum > 0.f) {
+    descriptor /= sum;
+  }
+  return descriptor;
+}
+
+}  // namespace
+
+Eigen::VectorXf ComputeNodeDescriptor(const sensor::PointCloud& point_cloud,
+                                      const float resolution,
+                                      const int num_rings,
+                                      const float max_range) {
+  std::vector<Eigen::Vector2f> offsets;
+  offsets.reserve(point_cloud.size());
+  for (const sensor::RangefinderPoint& point : point_cloud) {
+    offsets.push_back(point.position.head<2>());
+  }
+  return ComputeDescriptorFromOffsets(offsets, resolution, num_rings,
+                                      max_range);
+}
+
+Eigen::VectorXf ComputeSubmapDescriptor(const Grid2D& grid,
+                                        const Eigen::Vector2f& center,
+                                        const float resolution,
+                                        const int num_rings,
+                                        const float max_range) {
+  const MapLimits& limits = grid.limits();
+  // Cell indices grow with decreasing coordinates, see MapLimits.
+  const Eigen::Array2i min_index =
+      limits.GetCellIndex(center + Eigen::Vector2f(max_range, max_range))
+          .max(Eigen::Array2i::Zero());
+  const Eigen::Array2i max_index =
+      limits.GetCellIndex(center - Eigen::Vector2f(max_range, max_range))
+          .min(Eigen::Array2i(limits.cell_limits().num_x_cells - 1,
+                              limits.cell_limits().num_y_cells - 1));
+
+  std::vector<Eigen::Vector2f> offsets;
+  for (int y = min_index.y(); y <= max_index.y(); ++y) {
+    for (int x = min_index.x(); x <= max_index.x(); ++x) {
+      const Eigen::Array2i xy_index(x, y);
+      if (!grid.IsKnown(xy_index) ||
+          grid.GetCorrespondenceCost(xy_index) >=
+              kMaxOccupiedCorrespondenceCost) {
+        continue;
+      }
+      offsets.push_back(limits.GetCellCenter(xy_index) - center);
+    }
+  }
+  return ComputeDescriptorFromOffsets(offsets, resolution, num_rings,
+                                      max_range);
+}
+
+SubmapDescriptorIndex2D::SubmapDescriptorIndex2D(const float resolution,
+                                                 const int num_rings,
+                                                 const float max_range)
+    : resolution_(resolution), num_rings_(num_rings), max_range_(max_range) {
+  CHECK_GT(resolution_, 0.f);
+  CHECK_GT(num_rings_, 0);
+  CHECK_GT(max_range_, 0.f);
+}
+
+void SubmapDescriptorIndex2D::Insert(const SubmapId& submap_id,
+                                     const Grid2D& grid,
+                                     const Eigen::Vector2f& center) {
+  descriptors_[submap_id] =
+      ComputeSubmapDescriptor(grid, center, resolution_, num_rings_,
+                              max_range_);
+}
+
+Eigen::VectorXf SubmapDescriptorIndex2D::ComputeDescriptor(
+    const sensor::PointCloud& point_cloud) const {
+  return ComputeNodeDescriptor(point_cloud, resolution_, num_rings_,
+                               max_range_);
+}
+
+std::vector<SubmapId> SubmapDescriptorIndex2D::GetClosest(
+    const Eigen::VectorXf& node_descriptor,
+    const std::vector<SubmapId>& submap_ids, const int num_candidates) const {
+  CHECK_EQ(node_descriptor.size(), num_rings_);
+  std::vector<std::pair<float, SubmapId>> distances;
+  distances.reserve(submap_ids.size());
+  for (const SubmapId& submap_id : submap_ids) {
+    const auto it = descriptors_.find(submap_id);
+    if (it == descriptors_.end()) continue;
+    distances.emplace_back((it->second - node_descriptor).lpNorm<1>(),
+                           submap_id);
+  }
+  const int num_closest =
+      std::min(std::max(num_candidates, 0), static_cast<int>(distances.size()));
+  std::partial_sort(distances.begin(), distances.begin() + num_closest,
+                    distances.end());
+  std::vector<SubmapId> result;
+  result.reserve(num_closest);
+  for (int i = 0; i < num_closest; ++i) {
+    result.push_back(distances[i].second);
+  }
+  return result;
+}
+
+float SubmapDescriptorIndex2D::GetDistance(
+    const Eigen::VectorXf& node_descriptor, const SubmapId& submap_id) const {
+  CHECK_EQ(node_descriptor.size(), num_rings_);
+  return (descriptors_.at(submap_id) - node_descriptor).lpNorm<1>();
+}
+
+}  // namespace constraints
+}  // namespace mapping
+}  // namespace cartographer
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef CARTOGRAPHER_MAPPING_INTERNAL_CONSTRAINTS_SUBMAP_DESCRIPTOR_INDEX_2D_H_
+#define CARTOGRAPHER_MAPPING_INTERNAL_CONSTRAINTS_SUBMAP_DESCRIPTOR_INDEX_2D_H_
+
+#include <map>
+#include <vector>
+
+#include "Eigen/Core"
+#include "cartographer/mapping/2d/grid_2d.h"
+#include "cartographer/mapping/id.h"
+#include "cartographer/sensor/point_cloud.h"
+
+namespace cartographer {
+namespace mapping {
+namespace constraints {
+
+// Rotation invariant descriptors of the surroundings of a position, used to
+// pick the submaps which are worth a full submap match when globally
+// localizing a node. Occupied positions are counted once per cell of size
+// 'resolution', so that descriptors of point clouds and of grids of any
+// resolution are comparable. Bucket i of a descriptor then holds the fraction
+// of these cells within 'max_range' whose distance from the position is in
+// [i, i + 1) * 'max_range' / 'num_rings'. Like the histograms of the
+// RotationalScanMatcher, this does not depend on the unknown orientation.
+
+// Computes the descriptor of a gravity aligned 'point_cloud' in the frame of
+// the node.
+Eigen::VectorXf ComputeNodeDescriptor(const sensor::PointCloud& point_cloud,
+                                      float resolution, int num_rings,
+                                      float max_range);
+
+// Computes the descriptor of the cells of 'grid' around 'center', counting
+// cells with a correspondence cost below 0.5 as occupied.
+Eigen::VectorXf ComputeSubmapDescriptor(const Grid2D& grid,
+                                        const Eigen::Vector2f& center,
+                                        float resolution, int num_rings,
+                                        float max_range);
+
+// Descriptors of finished submaps, compared to a node descriptor by the L1
+// distance. Lookups scan the given candidates, which is cheap compared to a
+// single full submap match.
+class SubmapDescriptorIndex2D {
+ public:
+  SubmapDescriptorIndex2D(float resolution, int num_rings, float max_range);
+
+  SubmapDescriptorIndex2D(const SubmapDescriptorIndex2D&) = delete;
+  SubmapDescriptorIndex2D& operator=(const SubmapDescriptorIndex2D&) = delete;
+
+  bool Contains(const SubmapId& submap_id) const {
+    return descriptors_.count(submap_id) != 0;
+  }
+
+  // Computes and stores the descriptor of 'grid' around 'center', which is
+  // usually the origin of the submap.
+  void Insert(const SubmapId& submap_id, const Grid2D& grid,
+              const Eigen::Vector2f& center);
+
+  // Computes the descriptor of a node for GetClosest().
+  Eigen::VectorXf ComputeDescriptor(
+      const sensor::PointCloud& point_cloud) const;
+
+  // Returns the at most 'num_candidates' of 'submap_ids' with the descriptors
+  // closest to 'node_descriptor', closest first. Submaps without a descriptor
+  // are ignored, so entries of trimmed submaps do no harm.
+  std::vector<SubmapId> GetClosest(const Eigen::VectorXf& node_descriptor,
+                                   const std::vector<SubmapId>& submap_ids,
+                                   int num_candidates) const;
+
+  // Returns the distance of the descriptor of 'submap_id', which must have
+  // one, to 'node_descriptor'.
+  float GetDistance(const Eigen::VectorXf& node_descriptor,
+                    const SubmapId& submap_id) const;
+
+ private:
+  const float resolution_;
+  const int num_rings_;
+  const float max_range_;
+  std::map<SubmapId, Eigen::VectorXf> descriptors_;
+};
+
+}  // namespace constraints
+}  // namespace mapping
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_MAPPING_INTERNAL_CONSTRAINTS_SUBMAP_DESCRIPTOR_INDEX_2D_H_
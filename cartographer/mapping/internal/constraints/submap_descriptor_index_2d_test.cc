@@ -0,0 +1,133 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "cartographer/mapping/internal/constraints/submap_descriptor_index_2d.h"
+
+#include <cmath>
+
+#include "cartographer/mapping/2d/probability_grid.h"
+#include "cartographer/transform/transform.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace constraints {
+namespace {
+
+constexpr float kResolution = 0.05f;
+constexpr float kDescriptorResolution = 0.1f;
+constexpr int kNumRings = 10;
+constexpr float kMaxRange = 5.f;
+
+// A circle of points with 'radius' around the origin and a short wall.
+sensor::PointCloud CreatePointCloud(const float radius) {
+  sensor::PointCloud point_cloud;
+  for (int i = 0; i < 360; ++i) {
+    const float angle = i * M_PI / 180.f;
+    point_cloud.push_back(
+        {Eigen::Vector3f(radius * std::cos(angle), radius * std::sin(angle),
+                         0.f)});
+  }
+  for (float x = 0.f; x < 1.f; x += kResolution) {
+    point_cloud.push_back({Eigen::Vector3f(x, 0.5f, 0.f)});
+  }
+  return point_cloud;
+}
+
+// Creates a grid in which 'point_cloud' was observed at 'center'.
+ProbabilityGrid CreateGrid(const sensor::PointCloud& point_cloud,
+                           const Eigen::Vector2f& center,
+                           ValueConversionTables* conversion_tables) {
+  ProbabilityGrid grid(
+      MapLimits(kResolution, center.cast<double>() + Eigen::Vector2d(6., 6.),
+                CellLimits(240, 240)),
+      conversion_tables);
+  for (const sensor::RangefinderPoint& point : sensor::TransformPointCloud(
+           point_cloud, transform::Rigid3f::Translation(
+                            Eigen::Vector3f(center.x(), center.y(), 0.f)))) {
+    const Eigen::Array2i xy_index =
+        grid.limits().GetCellIndex(point.position.head<2>());
+    if (!grid.IsKnown(xy_index)) {
+      grid.SetProbability(xy_index, 0.9f);
+    }
+  }
+  return grid;
+}
+
+TEST(SubmapDescriptorIndex2DTest, NodeDescriptorIsRotationInvariant) {
+  const sensor::PointCloud point_cloud = CreatePointCloud(3.25f);
+  const Eigen::VectorXf descriptor = ComputeNodeDescriptor(
+      point_cloud, kDescriptorResolution, kNumRings, kMaxRange);
+  EXPECT_NEAR(descriptor.sum(), 1.f, 1e-5f);
+  const Eigen::VectorXf rotated_descriptor = ComputeNodeDescriptor(
+      sensor::TransformPointCloud(
+          point_cloud, transform::Rigid3f::Rotation(Eigen::AngleAxisf(
+                           1.2f, Eigen::Vector3f::UnitZ()))),
+      kDescriptorResolution, kNumRings, kMaxRange);
+  EXPECT_LT((descriptor - rotated_descriptor).lpNorm<1>(), 0.1f);
+}
+
+TEST(SubmapDescriptorIndex2DTest, NodeDescriptorMatchesSubmapDescriptor) {
+  ValueConversionTables conversion_tables;
+  const sensor::PointCloud point_cloud = CreatePointCloud(3.25f);
+  const Eigen::Vector2f center(1.f, -2.f);
+  const ProbabilityGrid grid =
+      CreateGrid(point_cloud, center, &conversion_tables);
+  const Eigen::VectorXf node_descriptor = ComputeNodeDescriptor(
+      point_cloud, kDescriptorResolution, kNumRings, kMaxRange);
+  const Eigen::VectorXf submap_descriptor = ComputeSubmapDescriptor(
+      grid, center, kDescriptorResolution, kNumRings, kMaxRange);
+  EXPECT_LT((node_descriptor - submap_descriptor).lpNorm<1>(), 0.2f);
+}
+
+TEST(SubmapDescriptorIndex2DTest, GetClosest) {
+  ValueConversionTables conversion_tables;
+  SubmapDescriptorIndex2D index(kDescriptorResolution, kNumRings, kMaxRange);
+  const Eigen::Vector2f center(0.f, 0.f);
+  for (int i = 0; i < 4; ++i) {
+    index.Insert(SubmapId{0, i},
+                 CreateGrid(CreatePointCloud(1.25f + i), center,
+                            &conversion_tables),
+                 center);
+  }
+  EXPECT_TRUE(index.Contains(SubmapId{0, 3}));
+  EXPECT_FALSE(index.Contains(SubmapId{1, 0}));
+
+  const Eigen::VectorXf node_descriptor =
+      index.ComputeDescriptor(CreatePointCloud(3.25f));
+  const std::vector<SubmapId> all_submap_ids = {
+      SubmapId{0, 0}, SubmapId{0, 1}, SubmapId{0, 2}, SubmapId{0, 3},
+      SubmapId{1, 0}};
+  const std::vector<SubmapId> closest =
+      index.GetClosest(node_descriptor, all_submap_ids, 2);
+  ASSERT_EQ(closest.size(), 2);
+  EXPECT_EQ(closest[0], (SubmapId{0, 2}));
+  EXPECT_LE(index.GetDistance(node_descriptor, closest[0]),
+            index.GetDistance(node_descriptor, closest[1]));
+  EXPECT_LE(index.GetDistance(node_descriptor, closest[1]),
+            index.GetDistance(node_descriptor, SubmapId{0, 0}));
+
+  // Only the given submaps are candidates.
+  EXPECT_EQ(index.GetClosest(node_descriptor, {SubmapId{0, 0}}, 2),
+            std::vector<SubmapId>{(SubmapId{0, 0})});
+  EXPECT_TRUE(index.GetClosest(node_descriptor, {SubmapId{1, 0}}, 2).empty());
+}
+
+}  // namespace
+}  // namespace constraints
+}  // namespace mapping
+}  // namespace cartographer
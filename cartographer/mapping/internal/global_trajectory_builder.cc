@@ -33,6 +33,18 @@ namespace {
 static auto* kLocalSlamMatchingResults = metrics::Counter::Null();
 static auto* kLocalSlamInsertionResults = metrics::Counter::Null();
 
+// Only the 2D local trajectory builder can hold back matching results.
+template <typename LocalTrajectoryBuilder>
+std::unique_ptr<typename LocalTrajectoryBuilder::MatchingResult>
+FinishPendingInsertion(LocalTrajectoryBuilder* local_trajectory_builder) {
+  return nullptr;
+}
+
+std::unique_ptr<LocalTrajectoryBuilder2D::MatchingResult>
+FinishPendingInsertion(LocalTrajectoryBuilder2D* local_trajectory_builder) {
+  return local_trajectory_builder->FinishPendingInsertion();
+}
+
 template <typename LocalTrajectoryBuilder, typename PoseGraph>
 class GlobalTrajectoryBuilder : public mapping::TrajectoryBuilderInterface {
  public:
@@ -56,35 +68,23 @@ class GlobalTrajectoryBuilder : public mapping::TrajectoryBuilderInterface {
   void AddSensorData(
       const std::string& sensor_id,
       const sensor::TimedPointCloudData& timed_point_cloud_data) override {
+    AddSensorData(sensor_id,
+                  sensor::TimedPointCloudData(timed_point_cloud_data));
+  }
+
+  void AddSensorData(
+      const std::string& sensor_id,
+      sensor::TimedPointCloudData&& timed_point_cloud_data) override {
     CHECK(local_trajectory_builder_)
         << "Cannot add TimedPointCloudData without a LocalTrajectoryBuilder.";
     std::unique_ptr<typename LocalTrajectoryBuilder::MatchingResult>
         matching_result = local_trajectory_builder_->AddRangeData(
-            sensor_id, timed_point_cloud_data);
+            sensor_id, std::move(timed_point_cloud_data));
     if (matching_result == nullptr) {
       // The range data has not been fully accumulated yet.
       return;
     }
-    kLocalSlamMatchingResults->Increment();
-    std::unique_ptr<InsertionResult> insertion_result;
-    if (matching_result->insertion_result != nullptr) {
-      kLocalSlamInsertionResults->Increment();
-      auto node_id = pose_graph_->AddNode(
-          matching_result->insertion_result->constant_data, trajectory_id_,
-          matching_result->insertion_result->insertion_submaps);
-      CHECK_EQ(node_id.trajectory_id, trajectory_id_);
-      insertion_result = absl::make_unique<InsertionResult>(InsertionResult{
-          node_id, matching_result->insertion_result->constant_data,
-          std::vector<std::shared_ptr<const Submap>>(
-              matching_result->insertion_result->insertion_submaps.begin(),
-              matching_result->insertion_result->insertion_submaps.end())});
-    }
-    if (local_slam_result_callback_) {
-      local_slam_result_callback_(
-          trajectory_id_, matching_result->time, matching_result->local_pose,
-          std::move(matching_result->range_data_in_local),
-          std::move(insertion_result));
-    }
+    AddMatchingResult(std::move(matching_result));
   }
 
   void AddSensorData(const std::string& sensor_id,
@@ -134,7 +134,44 @@ class GlobalTrajectoryBuilder : public mapping::TrajectoryBuilderInterface {
     local_slam_result_data->AddToPoseGraph(trajectory_id_, pose_graph_);
   }
 
+  void Flush() override {
+    if (!local_trajectory_builder_) {
+      return;
+    }
+    std::unique_ptr<typename LocalTrajectoryBuilder::MatchingResult>
+        matching_result =
+            FinishPendingInsertion(local_trajectory_builder_.get());
+    if (matching_result != nullptr) {
+      AddMatchingResult(std::move(matching_result));
+    }
+  }
+
  private:
+  void AddMatchingResult(
+      std::unique_ptr<typename LocalTrajectoryBuilder::MatchingResult>
+          matching_result) {
+    kLocalSlamMatchingResults->Increment();
+    std::unique_ptr<InsertionResult> insertion_result;
+    if (matching_result->insertion_result != nullptr) {
+      kLocalSlamInsertionResults->Increment();
+      auto node_id = pose_graph_->AddNode(
+          matching_result->insertion_result->constant_data, trajectory_id_,
+          matching_result->insertion_result->insertion_submaps);
+      CHECK_EQ(node_id.trajectory_id, trajectory_id_);
+      insertion_result = absl::make_unique<InsertionResult>(InsertionResult{
+          node_id, matching_result->insertion_result->constant_data,
+          std::vector<std::shared_ptr<const Submap>>(
+              matching_result->insertion_result->insertion_submaps.begin(),
+              matching_result->insertion_result->insertion_submaps.end())});
+    }
+    if (local_slam_result_callback_) {
+      local_slam_result_callback_(
+          trajectory_id_, matching_result->time, matching_result->local_pose,
+          std::move(matching_result->range_data_in_local),
+          std::move(insertion_result));
+    }
+  }
+
   const int trajectory_id_;
   PoseGraph* const pose_graph_;
   std::unique_ptr<LocalTrajectoryBuilder> local_trajectory_builder_;
@@ -39,7 +39,10 @@ ImuBasedPoseExtrapolator::ImuBasedPoseExtrapolator(
     const proto::ImuBasedPoseExtrapolatorOptions& options)
     : options_(options),
       solver_options_(
-          common::CreateCeresSolverOptions(options_.solver_options())) {}
+          common::CreateCeresSolverOptions(options_.solver_options())),
+      gravity_constant_(options_.gravity_constant() > 0
+                            ? options_.gravity_constant()
+                            : 9.8) {}
 
 ImuBasedPoseExtrapolator::~ImuBasedPoseExtrapolator() {
   LOG(INFO) << "Number of iterations for pose extrapolation:";
@@ -89,11 +92,18 @@ void ImuBasedPoseExtrapolator::AddPose(const common::Time time,
          timed_pose_queue_[1].time <=
              time - common::FromSeconds(options_.pose_queue_duration())) {
     if (!previous_solution_.empty()) {
-      CHECK_EQ(timed_pose_queue_.front().time, previous_solution_.front().time);
-      previous_solution_.pop_front();
+      if (timed_pose_queue_.front().time == previous_solution_.front().time) {
+        previous_solution_.pop_front();
+      } else {
+        // Poses were added without solving, see 'solve_every_n_poses'.
+        CHECK_GT(options_.solve_every_n_poses(), 1);
+        previous_solution_.clear();
+      }
     }
     timed_pose_queue_.pop_front();
   }
+  ++num_poses_since_last_solve_;
+  imu_integration_.reset();
   TrimImuData();
 }
 
@@ -129,6 +139,9 @@ ImuBasedPoseExtrapolator::ExtrapolatePosesWithGravity(
         timed_pose_queue_.back().transform, Eigen::Vector3d::Zero(),
         timed_pose_queue_.back().transform.rotation()};
   }
+  if (!IsSolveDue()) {
+    return ExtrapolatePosesWithoutSolving(times);
+  }
 
   ceres::Problem::Options problem_options;
   ceres::Problem problem(problem_options);
@@ -152,9 +165,9 @@ ImuBasedPoseExtrapolator::ExtrapolatePosesWithGravity(
     // initialization here instead of the last result from the optimization.
     // This keeps poses from slowly drifting apart due to lack of feedback
     // from the scan matching here.
-    if (!previous_solution_.empty() && !is_last) {
-      CHECK_GT(previous_solution_.size(), i);
-      CHECK_EQ(timed_pose.time, previous_solution_[i].time);
+    // Poses added since the last solve are not part of its solution.
+    if (i < previous_solution_.size() &&
+        timed_pose.time == previous_solution_[i].time && !is_last) {
       gravity_from_node = previous_solution_[i].transform;
     } else {
       gravity_from_node = gravity_from_local_ * timed_pose.transform;
@@ -328,6 +341,8 @@ ImuBasedPoseExtrapolator::ExtrapolatePosesWithGravity(
   num_iterations_hist_.Add(summary.iterations.size());
 
   gravity_from_local_ = gravity_from_local.ToRigid();
+  gravity_constant_ = gravity_constant;
+  num_poses_since_last_solve_ = 0;
 
   previous_solution_.clear();
   for (size_t i = 0; i < nodes.size(); ++i) {
@@ -346,6 +361,76 @@ ImuBasedPoseExtrapolator::ExtrapolatePosesWithGravity(
       extrapolated_pose.transform, current_velocity, gravity_estimate};
 }
 
+bool ImuBasedPoseExtrapolator::IsSolveDue() const {
+  return options_.solve_every_n_poses() <= 1 || previous_solution_.empty() ||
+         num_poses_since_last_solve_ >= options_.solve_every_n_poses();
+}
+
+ImuBasedPoseExtrapolator::ExtrapolationResult
+ImuBasedPoseExtrapolator::ExtrapolatePosesWithoutSolving(
+    const std::vector<common::Time>& times) {
+  const common::Time time = times.back();
+  const TimestampedTransform& last_pose = timed_pose_queue_.back();
+  const TimestampedTransform& prev_pose =
+      timed_pose_queue_.at(timed_pose_queue_.size() - 2);
+  if (!imu_integration_.has_value() ||
+      imu_integration_->start_time != last_pose.time ||
+      imu_integration_->end_time > time) {
+    imu_integration_ = ImuIntegration{
+        last_pose.time, last_pose.time,
+        IntegrateImuResult<double>{Eigen::Vector3d::Zero(),
+                                   Eigen::Vector3d::Zero(),
+                                   Eigen::Quaterniond::Identity()}};
+  }
+
+  // Continue the integration of the previous query.
+  auto imu_it = std::prev(std::upper_bound(
+      imu_data_.begin(), imu_data_.end(), imu_integration_->end_time,
+      [](const common::Time time, const sensor::ImuData& imu_data) {
+        return time < imu_data.time;
+      }));
+  const IntegrateImuResult<double> delta =
+      IntegrateImu(imu_data_, imu_integration_->end_time, time, &imu_it);
+  IntegrateImuResult<double>& result = imu_integration_->result;
+  result.delta_translation +=
+      common::ToSeconds(time - imu_integration_->end_time) *
+          result.delta_velocity +
+      result.delta_rotation * delta.delta_translation;
+  result.delta_velocity += result.delta_rotation * delta.delta_velocity;
+  result.delta_rotation = result.delta_rotation * delta.delta_rotation;
+  imu_integration_->end_time = time;
+
+  // Same as ExtrapolatePoseWithImu(), but with the IMU data integrated above.
+  const transform::Rigid3d gravity_from_last =
+      gravity_from_local_ * last_pose.transform;
+  const transform::Rigid3d gravity_from_prev =
+      gravity_from_local_ * prev_pose.transform;
+  const Eigen::Vector3d last_velocity_in_tracking =
+      gravity_from_last.rotation().inverse() *
+      (gravity_from_last.translation() - gravity_from_prev.translation()) /
+      common::ToSeconds(last_pose.time - prev_pose.time);
+  const double delta_t = common::ToSeconds(time - last_pose.time);
+  const transform::Rigid3d gravity_from_tracking(
+      gravity_from_last.translation() +
+          gravity_from_last.rotation() *
+              (delta_t * last_velocity_in_tracking +
+               result.delta_translation) -
+          .5 * delta_t * delta_t * gravity_constant_ * Eigen::Vector3d::UnitZ(),
+      gravity_from_last.rotation() * result.delta_rotation);
+
+  const auto extrapolated_pose = TimestampedTransform{
+      time, gravity_from_local_.inverse() * gravity_from_tracking};
+  const Eigen::Vector3d current_velocity =
+      (extrapolated_pose.transform.translation() -
+       last_pose.transform.translation()) /
+      delta_t;
+  return ExtrapolationResult{
+      InterpolatePoses(last_pose, extrapolated_pose, times.begin(),
+                       std::prev(times.end())),
+      extrapolated_pose.transform, current_velocity,
+      gravity_from_tracking.rotation()};
+}
+
 std::vector<transform::Rigid3f> ImuBasedPoseExtrapolator::InterpolatePoses(
     const TimestampedTransform& start, const TimestampedTransform& end,
     const std::vector<common::Time>::const_iterator times_begin,
@@ -22,7 +22,9 @@
 #include <vector>
 
 #include "cartographer/common/ceres_solver_options.h"
+#include "absl/types/optional.h"
 #include "cartographer/common/histogram.h"
+#include "cartographer/mapping/internal/3d/imu_integration.h"
 #include "cartographer/mapping/pose_extrapolator_interface.h"
 #include "cartographer/sensor/imu_data.h"
 #include "cartographer/transform/timestamped_transform.h"
@@ -74,6 +76,16 @@ class ImuBasedPoseExtrapolator : public PoseExtrapolatorInterface {
       const transform::Rigid3d& first_node_odometry,
       const transform::Rigid3d& second_node_odometry) const;
 
+  // Returns true if the Ceres problem has to be solved for the next query,
+  // see 'solve_every_n_poses'.
+  bool IsSolveDue() const;
+
+  // Extrapolates from the last added pose without solving. Its velocity is
+  // taken from the last two poses, and IMU data is integrated in the gravity
+  // frame of the last solution.
+  ExtrapolationResult ExtrapolatePosesWithoutSolving(
+      const std::vector<common::Time>& times);
+
   std::vector<transform::Rigid3f> InterpolatePoses(
       const ::cartographer::transform::TimestampedTransform& start,
       const ::cartographer::transform::TimestampedTransform& end,
@@ -89,6 +101,17 @@ class ImuBasedPoseExtrapolator : public PoseExtrapolatorInterface {
   common::Time last_extrapolated_time_ = common::Time::min();
 
   transform::Rigid3d gravity_from_local_ = transform::Rigid3d::Identity();
+  double gravity_constant_;
+  int num_poses_since_last_solve_ = 0;
+
+  // IMU data integrated from the last added pose to 'end_time'. Queries
+  // without solving continue from here if they are not earlier.
+  struct ImuIntegration {
+    common::Time start_time;
+    common::Time end_time;
+    IntegrateImuResult<double> result;
+  };
+  absl::optional<ImuIntegration> imu_integration_;
 
   const proto::ImuBasedPoseExtrapolatorOptions options_;
   const ceres::Solver::Options solver_options_;
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "cartographer/mapping/internal/load_shedding_controller.h"
+
+#include <algorithm>
+
+#include "cartographer/common/math.h"
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace mapping {
+
+LoadSheddingController::LoadSheddingController(
+    const double max_work_queue_delay, const double min_factor)
+    : max_work_queue_delay_(max_work_queue_delay), min_factor_(min_factor) {
+  if (max_work_queue_delay_ > 0.) {
+    CHECK_GT(min_factor_, 0.);
+    CHECK_LE(min_factor_, 1.);
+  }
+}
+
+void LoadSheddingController::SetWorkQueueDelay(const double work_queue_delay) {
+  if (max_work_queue_delay_ <= 0.) return;
+  const double factor =
+      work_queue_delay > max_work_queue_delay_
+          ? std::max(min_factor_, max_work_queue_delay_ / work_queue_delay)
+          : 1.;
+  absl::MutexLock locker(&mutex_);
+  if (factor_ == 1. && factor < 1.) {
+    LOG(WARNING) << "Work queue delayed by " << work_queue_delay
+                 << " s, shedding loop closure work.";
+  } else if (factor_ < 1. && factor == 1.) {
+    LOG(INFO) << "Work queue caught up, no longer shedding loop closure work.";
+  }
+  factor_ = factor;
+}
+
+double LoadSheddingController::factor() {
+  absl::MutexLock locker(&mutex_);
+  return factor_;
+}
+
+bool LoadSheddingController::Pulse() {
+  absl::MutexLock locker(&mutex_);
+  if (factor_ == 1.) return true;
+  budget_ += factor_;
+  if (budget_ < 1.) return false;
+  budget_ -= 1.;
+  return true;
+}
+
+int LoadSheddingController::ScaleOptimizeEveryNNodes(
+    const int optimize_every_n_nodes) {
+  absl::MutexLock locker(&mutex_);
+  return common::RoundToInt(optimize_every_n_nodes / factor_);
+}
+
+}  // namespace mapping
+}  // namespace cartographer
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef CARTOGRAPHER_MAPPING_INTERNAL_LOAD_SHEDDING_CONTROLLER_H_
+#define CARTOGRAPHER_MAPPING_INTERNAL_LOAD_SHEDDING_CONTROLLER_H_
+
+#include "absl/synchronization/mutex.h"
+
+namespace cartographer {
+namespace mapping {
+
+// Sheds loop closure work of the pose graph while its work queue falls
+// behind, so that the delay of global SLAM stays bounded on slow machines.
+//
+// While work items wait longer than 'max_work_queue_delay' seconds, the
+// factor is the ratio of 'max_work_queue_delay' to the delay, but at least
+// 'min_factor'. It is 1 otherwise, so that the configured sampling ratios are
+// restored as soon as the queue catches up again.
+//
+// This class is thread-safe.
+class LoadSheddingController {
+ public:
+  // A non-positive 'max_work_queue_delay' disables load shedding.
+  LoadSheddingController(double max_work_queue_delay, double min_factor);
+
+  LoadSheddingController(const LoadSheddingController&) = delete;
+  LoadSheddingController& operator=(const LoadSheddingController&) = delete;
+
+  // Updates the factor from the time the work item which is about to run
+  // waited in the work queue.
+  void SetWorkQueueDelay(double work_queue_delay) LOCKS_EXCLUDED(mutex_);
+
+  double factor() LOCKS_EXCLUDED(mutex_);
+
+  // Returns true for a fraction 'factor()' of the calls. Used to thin out
+  // constraint searches after their samplers.
+  bool Pulse() LOCKS_EXCLUDED(mutex_);
+
+  // Returns 'optimize_every_n_nodes' divided by 'factor()', so that
+  // optimizations run less often while shedding load.
+  int ScaleOptimizeEveryNNodes(int optimize_every_n_nodes)
+      LOCKS_EXCLUDED(mutex_);
+
+ private:
+  const double max_work_queue_delay_;
+  const double min_factor_;
+
+  absl::Mutex mutex_;
+  double factor_ GUARDED_BY(mutex_) = 1.;
+  // Sum of the factors of past pulses which did not result in a sample yet.
+  double budget_ GUARDED_BY(mutex_) = 0.;
+};
+
+}  // namespace mapping
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_MAPPING_INTERNAL_LOAD_SHEDDING_CONTROLLER_H_
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "cartographer/mapping/internal/load_shedding_controller.h"
+
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+int CountPulses(const int num_calls, LoadSheddingController* controller) {
+  int num_samples = 0;
+  for (int i = 0; i < num_calls; ++i) {
+    if (controller->Pulse()) ++num_samples;
+  }
+  return num_samples;
+}
+
+TEST(LoadSheddingControllerTest, DisabledByDefault) {
+  LoadSheddingController controller(0. /* max_work_queue_delay */,
+                                    0. /* min_factor */);
+  controller.SetWorkQueueDelay(100.);
+  EXPECT_EQ(1., controller.factor());
+  EXPECT_EQ(100, CountPulses(100, &controller));
+  EXPECT_EQ(90, controller.ScaleOptimizeEveryNNodes(90));
+}
+
+TEST(LoadSheddingControllerTest, ShedsInProportionToDelay) {
+  LoadSheddingController controller(2. /* max_work_queue_delay */,
+                                    0.1 /* min_factor */);
+  controller.SetWorkQueueDelay(1.);
+  EXPECT_EQ(1., controller.factor());
+  controller.SetWorkQueueDelay(8.);
+  EXPECT_DOUBLE_EQ(0.25, controller.factor());
+  EXPECT_NEAR(25, CountPulses(100, &controller), 1);
+  EXPECT_EQ(360, controller.ScaleOptimizeEveryNNodes(90));
+  controller.SetWorkQueueDelay(100.);
+  EXPECT_DOUBLE_EQ(0.1, controller.factor());
+  EXPECT_NEAR(10, CountPulses(100, &controller), 1);
+}
+
+TEST(LoadSheddingControllerTest, RestoresWhenCaughtUp) {
+  LoadSheddingController controller(2. /* max_work_queue_delay */,
+                                    0.1 /* min_factor */);
+  controller.SetWorkQueueDelay(4.);
+  EXPECT_DOUBLE_EQ(0.5, controller.factor());
+  controller.SetWorkQueueDelay(0.5);
+  EXPECT_EQ(1., controller.factor());
+  EXPECT_EQ(100, CountPulses(100, &controller));
+  EXPECT_EQ(90, controller.ScaleOptimizeEveryNNodes(90));
+}
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
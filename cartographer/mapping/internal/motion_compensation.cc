@@ -0,0 +1,79 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/motion_compensation.h"
+
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace mapping {
+
+void SelectMotionCompensationSampleTimes(
+    const std::vector<common::Time>& times, const common::Duration interval,
+    std::vector<common::Time>* const sample_times) {
+  sample_times->clear();
+  if (times.empty()) {
+    return;
+  }
+  sample_times->push_back(times.front());
+  for (const common::Time time : times) {
+    if (time - sample_times->back() >= interval) {
+      sample_times->push_back(time);
+    }
+  }
+  if (sample_times->back() != times.back()) {
+    sample_times->push_back(times.back());
+  }
+}
+
+void InterpolateMotionCompensationPoses(
+    const std::vector<common::Time>& sample_times,
+    const std::vector<transform::Rigid3f>& sample_poses,
+    const std::vector<common::Time>& times,
+    std::vector<transform::Rigid3f>* const poses) {
+  CHECK_EQ(sample_times.size(), sample_poses.size());
+  poses->clear();
+  if (times.empty()) {
+    return;
+  }
+  CHECK(!sample_times.empty());
+  CHECK_LE(sample_times.front(), times.front());
+  CHECK_GE(sample_times.back(), times.back());
+  poses->reserve(times.size());
+  size_t next_sample = 0;
+  for (const common::Time time : times) {
+    // The sample at 'next_sample' is the first one not before 'time'.
+    while (sample_times[next_sample] < time) {
+      ++next_sample;
+    }
+    if (sample_times[next_sample] == time) {
+      poses->push_back(sample_poses[next_sample]);
+      continue;
+    }
+    const transform::Rigid3f& start = sample_poses[next_sample - 1];
+    const transform::Rigid3f& end = sample_poses[next_sample];
+    const float factor =
+        common::ToSeconds(time - sample_times[next_sample - 1]) /
+        common::ToSeconds(sample_times[next_sample] -
+                          sample_times[next_sample - 1]);
+    poses->emplace_back(
+        start.translation() + factor * (end.translation() - start.translation()),
+        start.rotation().slerp(factor, end.rotation()));
+  }
+}
+
+}  // namespace mapping
+}  // namespace cartographer
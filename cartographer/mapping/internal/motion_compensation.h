@@ -0,0 +1,49 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_MAPPING_INTERNAL_MOTION_COMPENSATION_H_
+#define CARTOGRAPHER_MAPPING_INTERNAL_MOTION_COMPENSATION_H_
+
+#include <vector>
+
+#include "cartographer/common/time.h"
+#include "cartographer/transform/rigid_transform.h"
+
+namespace cartographer {
+namespace mapping {
+
+// Selects from the non-decreasing point 'times' those at which poses are
+// extrapolated for motion compensation: the first and the last time, and in
+// between each first time at least 'interval' after the previous sample.
+void SelectMotionCompensationSampleTimes(
+    const std::vector<common::Time>& times, common::Duration interval,
+    std::vector<common::Time>* sample_times);
+
+// Computes in 'poses' the pose at each of the non-decreasing 'times' from the
+// 'sample_poses' at the 'sample_times', which must cover the 'times', by
+// interpolating linearly in translation and spherically in rotation. Poses
+// between samples are only extrapolated over short intervals, so this is close
+// to extrapolating each of them.
+void InterpolateMotionCompensationPoses(
+    const std::vector<common::Time>& sample_times,
+    const std::vector<transform::Rigid3f>& sample_poses,
+    const std::vector<common::Time>& times,
+    std::vector<transform::Rigid3f>* poses);
+
+}  // namespace mapping
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_MAPPING_INTERNAL_MOTION_COMPENSATION_H_
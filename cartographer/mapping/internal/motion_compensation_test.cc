@@ -0,0 +1,77 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/motion_compensation.h"
+
+#include "cartographer/transform/rigid_transform_test_helpers.h"
+#include "cartographer/transform/transform.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+common::Time MillisecondsToTime(const int milliseconds) {
+  return common::FromUniversal(1000) + common::FromMilliseconds(milliseconds);
+}
+
+TEST(MotionCompensationTest, SelectsSampleTimes) {
+  std::vector<common::Time> times;
+  for (const int milliseconds : {0, 1, 2, 4, 5, 5, 9, 10, 11}) {
+    times.push_back(MillisecondsToTime(milliseconds));
+  }
+  std::vector<common::Time> sample_times;
+  SelectMotionCompensationSampleTimes(times, common::FromMilliseconds(4),
+                                      &sample_times);
+  std::vector<common::Time> expected_sample_times;
+  for (const int milliseconds : {0, 4, 9, 11}) {
+    expected_sample_times.push_back(MillisecondsToTime(milliseconds));
+  }
+  EXPECT_EQ(expected_sample_times, sample_times);
+
+  SelectMotionCompensationSampleTimes({times.front()},
+                                      common::FromMilliseconds(4),
+                                      &sample_times);
+  EXPECT_EQ(std::vector<common::Time>{times.front()}, sample_times);
+}
+
+TEST(MotionCompensationTest, InterpolatesPoses) {
+  const std::vector<common::Time> sample_times = {MillisecondsToTime(0),
+                                                  MillisecondsToTime(10)};
+  const std::vector<transform::Rigid3f> sample_poses = {
+      transform::Rigid3f::Identity(),
+      transform::Rigid3f(Eigen::Vector3f(1.f, 2.f, 0.f),
+                         transform::AngleAxisVectorToRotationQuaternion(
+                             Eigen::Vector3f(0.f, 0.f, 0.2f)))};
+  const std::vector<common::Time> times = {
+      MillisecondsToTime(0), MillisecondsToTime(5), MillisecondsToTime(10)};
+  std::vector<transform::Rigid3f> poses;
+  InterpolateMotionCompensationPoses(sample_times, sample_poses, times, &poses);
+  ASSERT_EQ(3, poses.size());
+  EXPECT_THAT(poses[0], transform::IsNearly(sample_poses[0], 1e-5f));
+  EXPECT_THAT(poses[1],
+              transform::IsNearly(
+                  transform::Rigid3f(
+                      Eigen::Vector3f(0.5f, 1.f, 0.f),
+                      transform::AngleAxisVectorToRotationQuaternion(
+                          Eigen::Vector3f(0.f, 0.f, 0.1f))),
+                  1e-5f));
+  EXPECT_THAT(poses[2], transform::IsNearly(sample_poses[1], 1e-5f));
+}
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
@@ -19,11 +19,112 @@
 
 #include "Eigen/Core"
 #include "Eigen/Geometry"
+#include "cartographer/mapping/internal/optimization/cost_functions/cost_helpers.h"
 #include "ceres/ceres.h"
 
 namespace cartographer {
 namespace mapping {
 
+// Computes the residuals of 'AccelerationCostFunction3D' with analytical
+// Jacobians.
+class AnalyticalAccelerationCostFunction3D
+    : public ceres::SizedCostFunction<
+          3 /* residuals */, 4 /* rotation variables */,
+          3 /* position variables */, 3 /* position variables */,
+          3 /* position variables */, 1 /* gravity variables */,
+          4 /* rotation variables */> {
+ public:
+  AnalyticalAccelerationCostFunction3D(
+      const double scaling_factor,
+      const Eigen::Vector3d& delta_velocity_imu_frame,
+      const double first_delta_time_seconds,
+      const double second_delta_time_seconds)
+      : scaling_factor_(scaling_factor),
+        delta_velocity_imu_frame_(delta_velocity_imu_frame),
+        first_delta_time_seconds_(first_delta_time_seconds),
+        second_delta_time_seconds_(second_delta_time_seconds) {}
+
+  AnalyticalAccelerationCostFunction3D(
+      const AnalyticalAccelerationCostFunction3D&) = delete;
+  AnalyticalAccelerationCostFunction3D& operator=(
+      const AnalyticalAccelerationCostFunction3D&) = delete;
+
+  bool Evaluate(double const* const* parameters, double* residuals,
+                double** jacobians) const override {
+    const Eigen::Quaterniond middle_rotation = ToEigen(parameters[0]);
+    const Eigen::Map<const Eigen::Vector3d> start_position(parameters[1]);
+    const Eigen::Map<const Eigen::Vector3d> middle_position(parameters[2]);
+    const Eigen::Map<const Eigen::Vector3d> end_position(parameters[3]);
+    const double gravity_constant = parameters[4][0];
+    const Eigen::Quaterniond imu_calibration = ToEigen(parameters[5]);
+    const Eigen::Quaterniond rotation = middle_rotation * imu_calibration;
+    const double mean_delta_time_seconds =
+        0.5 * (first_delta_time_seconds_ + second_delta_time_seconds_);
+    const Eigen::Vector3d imu_delta_velocity =
+        rotation * delta_velocity_imu_frame_ -
+        gravity_constant * mean_delta_time_seconds * Eigen::Vector3d::UnitZ();
+    const Eigen::Vector3d start_velocity =
+        (middle_position - start_position) / first_delta_time_seconds_;
+    const Eigen::Vector3d end_velocity =
+        (end_position - middle_position) / second_delta_time_seconds_;
+    (Eigen::Map<Eigen::Vector3d>(residuals) =
+         scaling_factor_ *
+         (imu_delta_velocity - (end_velocity - start_velocity)));
+    if (jacobians == nullptr) return true;
+
+    using RotationJacobian = Eigen::Matrix<double, 3, 4, Eigen::RowMajor>;
+    using PositionJacobian = Eigen::Matrix<double, 3, 3, Eigen::RowMajor>;
+    if (jacobians[0] != nullptr || jacobians[5] != nullptr) {
+      const Eigen::Matrix<double, 3, 4> jacobian_rotation =
+          scaling_factor_ * optimization::RotatedVectorJacobianWrtQuaternion(
+                                rotation, delta_velocity_imu_frame_);
+      if (jacobians[0] != nullptr) {
+        (Eigen::Map<RotationJacobian>(jacobians[0]) =
+             jacobian_rotation *
+             optimization::RightQuaternionProductMatrix(imu_calibration));
+      }
+      if (jacobians[5] != nullptr) {
+        (Eigen::Map<RotationJacobian>(jacobians[5]) =
+             jacobian_rotation *
+             optimization::LeftQuaternionProductMatrix(middle_rotation));
+      }
+    }
+    if (jacobians[1] != nullptr) {
+      (Eigen::Map<PositionJacobian>(jacobians[1]) =
+           -scaling_factor_ / first_delta_time_seconds_ *
+           Eigen::Matrix3d::Identity());
+    }
+    if (jacobians[2] != nullptr) {
+      (Eigen::Map<PositionJacobian>(jacobians[2]) =
+           scaling_factor_ *
+           (1. / first_delta_time_seconds_ + 1. / second_delta_time_seconds_) *
+           Eigen::Matrix3d::Identity());
+    }
+    if (jacobians[3] != nullptr) {
+      (Eigen::Map<PositionJacobian>(jacobians[3]) =
+           -scaling_factor_ / second_delta_time_seconds_ *
+           Eigen::Matrix3d::Identity());
+    }
+    if (jacobians[4] != nullptr) {
+      (Eigen::Map<Eigen::Vector3d>(jacobians[4]) = -scaling_factor_ *
+                                                   mean_delta_time_seconds *
+                                                   Eigen::Vector3d::UnitZ());
+    }
+    return true;
+  }
+
+ private:
+  static Eigen::Quaterniond ToEigen(const double* const quaternion) {
+    return Eigen::Quaterniond(quaternion[0], quaternion[1], quaternion[2],
+                              quaternion[3]);
+  }
+
+  const double scaling_factor_;
+  const Eigen::Vector3d delta_velocity_imu_frame_;
+  const double first_delta_time_seconds_;
+  const double second_delta_time_seconds_;
+};
+
 // Penalizes differences between IMU data and optimized accelerations.
 class AccelerationCostFunction3D {
  public:
@@ -42,6 +143,17 @@ class AccelerationCostFunction3D {
                                        second_delta_time_seconds));
   }
 
+  // Same residuals with analytically computed Jacobians.
+  static ceres::CostFunction* CreateAnalyticalCostFunction(
+      const double scaling_factor,
+      const Eigen::Vector3d& delta_velocity_imu_frame,
+      const double first_delta_time_seconds,
+      const double second_delta_time_seconds) {
+    return new AnalyticalAccelerationCostFunction3D(
+        scaling_factor, delta_velocity_imu_frame, first_delta_time_seconds,
+        second_delta_time_seconds);
+  }
+
   template <typename T>
   bool operator()(const T* const middle_rotation, const T* const start_position,
                   const T* const middle_position, const T* const end_position,
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/optimization/cost_functions/acceleration_cost_function_3d.h"
+
+#include <array>
+#include <memory>
+
+#include "cartographer/mapping/internal/optimization/cost_functions/cost_function_test_helpers.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+TEST(AccelerationCostFunction3DTest, AnalyticalMatchesAutoDiff) {
+  const Eigen::Vector3d delta_velocity_imu_frame(0.3, -0.1, 0.98);
+  std::unique_ptr<ceres::CostFunction> auto_diff_cost_function(
+      AccelerationCostFunction3D::CreateAutoDiffCostFunction(
+          2. /* scaling_factor */, delta_velocity_imu_frame,
+          0.1 /* first_delta_time_seconds */,
+          0.15 /* second_delta_time_seconds */));
+  std::unique_ptr<ceres::CostFunction> analytical_cost_function(
+      AccelerationCostFunction3D::CreateAnalyticalCostFunction(
+          2. /* scaling_factor */, delta_velocity_imu_frame,
+          0.1 /* first_delta_time_seconds */,
+          0.15 /* second_delta_time_seconds */));
+
+  // Deliberately not normalized.
+  const std::array<double, 4> middle_rotation{{0.98, 0.1, -0.15, 0.2}};
+  const std::array<double, 3> start_position{{0., 0.1, 0.}};
+  const std::array<double, 3> middle_position{{0.1, 0.2, 0.05}};
+  const std::array<double, 3> end_position{{0.25, 0.27, 0.02}};
+  const std::array<double, 1> gravity_constant{{9.8}};
+  const std::array<double, 4> imu_calibration{{0.99, -0.05, 0.02, 0.1}};
+  optimization::ExpectSameResidualsAndJacobians(
+      *auto_diff_cost_function, *analytical_cost_function,
+      {middle_rotation.data(), start_position.data(), middle_position.data(),
+       end_position.data(), gravity_constant.data(), imu_calibration.data()});
+}
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
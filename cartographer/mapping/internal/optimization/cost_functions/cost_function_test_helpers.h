@@ -0,0 +1,80 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_MAPPING_INTERNAL_OPTIMIZATION_COST_FUNCTIONS_COST_FUNCTION_TEST_HELPERS_H_
+#define CARTOGRAPHER_MAPPING_INTERNAL_OPTIMIZATION_COST_FUNCTIONS_COST_FUNCTION_TEST_HELPERS_H_
+
+#include <vector>
+
+#include "ceres/ceres.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace optimization {
+
+// Evaluates both cost functions at 'parameter_blocks' and expects the same
+// residuals and Jacobians.
+inline void ExpectSameResidualsAndJacobians(
+    const ceres::CostFunction& expected, const ceres::CostFunction& actual,
+    const std::vector<const double*>& parameter_blocks) {
+  const int num_residuals = expected.num_residuals();
+  ASSERT_EQ(num_residuals, actual.num_residuals());
+  const std::vector<int>& block_sizes = expected.parameter_block_sizes();
+  ASSERT_EQ(block_sizes, actual.parameter_block_sizes());
+  ASSERT_EQ(block_sizes.size(), parameter_blocks.size());
+
+  std::vector<double> expected_residuals(num_residuals);
+  std::vector<double> actual_residuals(num_residuals);
+  std::vector<std::vector<double>> expected_jacobians;
+  std::vector<std::vector<double>> actual_jacobians;
+  std::vector<double*> expected_jacobian_pointers;
+  std::vector<double*> actual_jacobian_pointers;
+  for (const int block_size : block_sizes) {
+    expected_jacobians.emplace_back(num_residuals * block_size);
+    actual_jacobians.emplace_back(num_residuals * block_size);
+    expected_jacobian_pointers.push_back(expected_jacobians.back().data());
+    actual_jacobian_pointers.push_back(actual_jacobians.back().data());
+  }
+  ASSERT_TRUE(expected.Evaluate(parameter_blocks.data(),
+                                expected_residuals.data(),
+                                expected_jacobian_pointers.data()));
+  ASSERT_TRUE(actual.Evaluate(parameter_blocks.data(), actual_residuals.data(),
+                              actual_jacobian_pointers.data()));
+  for (int i = 0; i < num_residuals; ++i) {
+    EXPECT_NEAR(expected_residuals[i], actual_residuals[i], 1e-12);
+  }
+  for (size_t block = 0; block < block_sizes.size(); ++block) {
+    for (int i = 0; i < num_residuals * block_sizes[block]; ++i) {
+      EXPECT_NEAR(expected_jacobians[block][i], actual_jacobians[block][i],
+                  1e-9)
+          << "parameter block " << block << ", entry " << i;
+    }
+  }
+
+  // Residuals only.
+  ASSERT_TRUE(actual.Evaluate(parameter_blocks.data(), actual_residuals.data(),
+                              nullptr));
+  for (int i = 0; i < num_residuals; ++i) {
+    EXPECT_NEAR(expected_residuals[i], actual_residuals[i], 1e-12);
+  }
+}
+
+}  // namespace optimization
+}  // namespace mapping
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_MAPPING_INTERNAL_OPTIMIZATION_COST_FUNCTIONS_COST_FUNCTION_TEST_HELPERS_H_
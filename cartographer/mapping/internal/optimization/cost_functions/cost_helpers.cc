@@ -0,0 +1,243 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/optimization/cost_functions/cost_helpers.h"
+
+#include <cmath>
+
+namespace cartographer {
+namespace mapping {
+namespace optimization {
+namespace {
+
+Eigen::Quaterniond ToEigen(const double* const quaternion) {
+  return Eigen::Quaterniond(quaternion[0], quaternion[1], quaternion[2],
+                            quaternion[3]);
+}
+
+Eigen::Matrix3d CrossProductMatrix(const Eigen::Vector3d& vector) {
+  Eigen::Matrix3d result;
+  // clang-format off
+  result <<          0., -vector.z(),  vector.y(),
+              vector.z(),          0., -vector.x(),
+             -vector.y(),  vector.x(),          0.;
+  // clang-format on
+  return result;
+}
+
+// Jacobian of the conjugate of a quaternion.
+Eigen::Matrix4d ConjugateMatrix() {
+  return Eigen::Vector4d(1., -1., -1., -1.).asDiagonal();
+}
+
+}  // namespace
+
+Eigen::Matrix4d LeftQuaternionProductMatrix(const Eigen::Quaterniond& a) {
+  Eigen::Matrix4d result;
+  // clang-format off
+  result << a.w(), -a.x(), -a.y(), -a.z(),
+            a.x(),  a.w(), -a.z(),  a.y(),
+            a.y(),  a.z(),  a.w(), -a.x(),
+            a.z(), -a.y(),  a.x(),  a.w();
+  // clang-format on
+  return result;
+}
+
+Eigen::Matrix4d RightQuaternionProductMatrix(const Eigen::Quaterniond& b) {
+  Eigen::Matrix4d result;
+  // clang-format off
+  result << b.w(), -b.x(), -b.y(), -b.z(),
+            b.x(),  b.w(),  b.z(), -b.y(),
+            b.y(), -b.z(),  b.w(),  b.x(),
+            b.z(),  b.y(), -b.x(),  b.w();
+  // clang-format on
+  return result;
+}
+
+// Eigen rotates 'v' by 'q' = [w, u] as v + 2 w (u x v) + 2 u x (u x v).
+Eigen::Matrix<double, 3, 4> RotatedVectorJacobianWrtQuaternion(
+    const Eigen::Quaterniond& quaternion, const Eigen::Vector3d& vector) {
+  const double w = quaternion.w();
+  const Eigen::Vector3d u = quaternion.vec();
+  Eigen::Matrix<double, 3, 4> result;
+  result.col(0) = 2. * u.cross(vector);
+  result.rightCols<3>() =
+      -2. * w * CrossProductMatrix(vector) +
+      2. * (u.dot(vector) * Eigen::Matrix3d::Identity() +
+            u * vector.transpose() - 2. * vector * u.transpose());
+  return result;
+}
+
+Eigen::Matrix3d RotatedVectorJacobianWrtVector(
+    const Eigen::Quaterniond& quaternion) {
+  const Eigen::Matrix3d u_cross = CrossProductMatrix(quaternion.vec());
+  return Eigen::Matrix3d::Identity() + 2. * quaternion.w() * u_cross +
+         2. * u_cross * u_cross;
+}
+
+Eigen::Matrix<double, 3, 4> RotationQuaternionToAngleAxisVectorJacobian(
+    const Eigen::Quaterniond& quaternion) {
+  // Like 'transform::RotationQuaternionToAngleAxisVector', we work with the
+  // normalized quaternion 'n' with positive 'w'.
+  const double norm = quaternion.norm();
+  const double sign = quaternion.w() < 0. ? -1. : 1.;
+  Eigen::Vector4d n(quaternion.w(), quaternion.x(), quaternion.y(),
+                    quaternion.z());
+  n *= sign / norm;
+  const Eigen::Matrix4d jacobian_normalization =
+      sign / norm * (Eigen::Matrix4d::Identity() - n * n.transpose());
+
+  const Eigen::Vector3d v = n.tail<3>();
+  const double v_norm = v.norm();
+  const double angle = 2. * std::atan2(v_norm, n[0]);
+  constexpr double kCutoffAngle = 1e-7;  // We linearize below this angle.
+  Eigen::Matrix<double, 3, 4> jacobian_angle_axis;
+  if (angle < kCutoffAngle) {
+    jacobian_angle_axis.col(0).setZero();
+    jacobian_angle_axis.rightCols<3>() = 2. * Eigen::Matrix3d::Identity();
+  } else {
+    // On the unit sphere, the angle axis vector is 'angle / |v| * v'.
+    jacobian_angle_axis.col(0) = -2. * v;
+    jacobian_angle_axis.rightCols<3>() =
+        angle / v_norm * Eigen::Matrix3d::Identity() +
+        (2. * n[0] / (v_norm * v_norm) - angle / (v_norm * v_norm * v_norm)) *
+            v * v.transpose();
+  }
+  return jacobian_angle_axis * jacobian_normalization;
+}
+
+std::array<double, 6> ComputeUnscaledErrorAndJacobians(
+    const transform::Rigid3d& relative_pose, const double* start_rotation,
+    const double* start_translation, const double* end_rotation,
+    const double* end_translation,
+    Eigen::Matrix<double, 6, 4>* jacobian_start_rotation,
+    Eigen::Matrix<double, 6, 3>* jacobian_start_translation,
+    Eigen::Matrix<double, 6, 4>* jacobian_end_rotation,
+    Eigen::Matrix<double, 6, 3>* jacobian_end_translation) {
+  const Eigen::Quaterniond start = ToEigen(start_rotation);
+  const Eigen::Quaterniond end = ToEigen(end_rotation);
+  const Eigen::Quaterniond start_inverse = start.conjugate();
+  const Eigen::Vector3d delta =
+      Eigen::Map<const Eigen::Vector3d>(end_translation) -
+      Eigen::Map<const Eigen::Vector3d>(start_translation);
+  const Eigen::Vector3d h_translation = start_inverse * delta;
+
+  const Eigen::Quaterniond end_inverse = end.conjugate();
+  const Eigen::Quaterniond start_times_relative =
+      start * relative_pose.rotation();
+  const Eigen::Quaterniond error_rotation = end_inverse * start_times_relative;
+  const Eigen::Vector3d angle_axis_difference =
+      transform::RotationQuaternionToAngleAxisVector(error_rotation);
+
+  if (jacobian_start_rotation != nullptr ||
+      jacobian_end_rotation != nullptr) {
+    const Eigen::Matrix<double, 3, 4> jacobian_angle_axis =
+        RotationQuaternionToAngleAxisVectorJacobian(error_rotation);
+    if (jacobian_start_rotation != nullptr) {
+      jacobian_start_rotation->topRows<3>() =
+          -RotatedVectorJacobianWrtQuaternion(start_inverse, delta) *
+          ConjugateMatrix();
+      jacobian_start_rotation->bottomRows<3>() =
+          jacobian_angle_axis * LeftQuaternionProductMatrix(end_inverse) *
+          RightQuaternionProductMatrix(relative_pose.rotation());
+    }
+    if (jacobian_end_rotation != nullptr) {
+      jacobian_end_rotation->topRows<3>().setZero();
+      jacobian_end_rotation->bottomRows<3>() =
+          jacobian_angle_axis *
+          RightQuaternionProductMatrix(start_times_relative) *
+          ConjugateMatrix();
+    }
+  }
+  if (jacobian_start_translation != nullptr ||
+      jacobian_end_translation != nullptr) {
+    const Eigen::Matrix3d jacobian_delta =
+        RotatedVectorJacobianWrtVector(start_inverse);
+    if (jacobian_start_translation != nullptr) {
+      jacobian_start_translation->topRows<3>() = jacobian_delta;
+      jacobian_start_translation->bottomRows<3>().setZero();
+    }
+    if (jacobian_end_translation != nullptr) {
+      jacobian_end_translation->topRows<3>() = -jacobian_delta;
+      jacobian_end_translation->bottomRows<3>().setZero();
+    }
+  }
+
+  return {{relative_pose.translation().x() - h_translation[0],
+           relative_pose.translation().y() - h_translation[1],
+           relative_pose.translation().z() - h_translation[2],
+           angle_axis_difference[0], angle_axis_difference[1],
+           angle_axis_difference[2]}};
+}
+
+std::array<double, 4> SlerpQuaternionsAndJacobians(
+    const double* start, const double* end, double factor,
+    Eigen::Matrix4d* jacobian_start, Eigen::Matrix4d* jacobian_end) {
+  const Eigen::Map<const Eigen::Vector4d> start_vector(start);
+  const Eigen::Map<const Eigen::Vector4d> end_vector(end);
+  const double cos_theta = start_vector.dot(end_vector);
+  const double sign = cos_theta < 0. ? -1. : 1.;
+  const double abs_cos_theta = std::abs(cos_theta);
+  double prev_scale = 1. - factor;
+  double next_scale = factor;
+  // Derivatives of the scales with respect to 'cos_theta'.
+  double prev_scale_derivative = 0.;
+  double next_scale_derivative = 0.;
+  if (abs_cos_theta < 1. - 1e-5) {
+    const double theta = std::acos(abs_cos_theta);
+    const double sin_theta = std::sin(theta);
+    const double prev_angle = (1. - factor) * theta;
+    const double next_angle = factor * theta;
+    prev_scale = std::sin(prev_angle) / sin_theta;
+    next_scale = std::sin(next_angle) / sin_theta;
+    // d(theta) / d(cos_theta) is -sign / sin(theta).
+    const double sin_theta_squared = sin_theta * sin_theta;
+    prev_scale_derivative =
+        -sign / sin_theta *
+        ((1. - factor) * std::cos(prev_angle) * sin_theta -
+         std::sin(prev_angle) * abs_cos_theta) /
+        sin_theta_squared;
+    next_scale_derivative =
+        -1. / sin_theta *
+        (factor * std::cos(next_angle) * sin_theta -
+         std::sin(next_angle) * abs_cos_theta) /
+        sin_theta_squared;
+  }
+  next_scale *= sign;
+
+  if (jacobian_start != nullptr || jacobian_end != nullptr) {
+    const Eigen::Vector4d scale_derivatives =
+        prev_scale_derivative * start_vector +
+        next_scale_derivative * end_vector;
+    if (jacobian_start != nullptr) {
+      *jacobian_start = prev_scale * Eigen::Matrix4d::Identity() +
+                        scale_derivatives * end_vector.transpose();
+    }
+    if (jacobian_end != nullptr) {
+      *jacobian_end = next_scale * Eigen::Matrix4d::Identity() +
+                      scale_derivatives * start_vector.transpose();
+    }
+  }
+
+  return {{prev_scale * start[0] + next_scale * end[0],
+           prev_scale * start[1] + next_scale * end[1],
+           prev_scale * start[2] + next_scale * end[2],
+           prev_scale * start[3] + next_scale * end[3]}};
+}
+
+}  // namespace optimization
+}  // namespace mapping
+}  // namespace cartographer
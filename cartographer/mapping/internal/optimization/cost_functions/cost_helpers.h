@@ -80,6 +80,54 @@ InterpolateNodes2D(const T* const prev_node_pose,
                    const Eigen::Quaterniond& next_node_gravity_alignment,
                    const double interpolation_parameter);
 
+// Scales the rows of the Jacobian of a 3D pose error like 'ScaleError' scales
+// the error.
+template <int N>
+Eigen::Matrix<double, 6, N> ScaleJacobian(
+    const Eigen::Matrix<double, 6, N>& jacobian, double translation_weight,
+    double rotation_weight);
+
+// The following functions compute Jacobians for cost functions with analytical
+// derivatives. Quaternions are differentiated with respect to their
+// coefficients in the format [w, n_1, n_2, n_3], like automatic
+// differentiation does for quaternion parameter blocks.
+
+// Returns 'M' with 'a * b = M * b' for quaternions 'a' and 'b'.
+Eigen::Matrix4d LeftQuaternionProductMatrix(const Eigen::Quaterniond& a);
+
+// Returns 'M' with 'a * b = M * a' for quaternions 'a' and 'b'.
+Eigen::Matrix4d RightQuaternionProductMatrix(const Eigen::Quaterniond& b);
+
+// Returns the Jacobian of 'quaternion * vector' with respect to 'quaternion'.
+// Like Eigen, the quaternion is not normalized.
+Eigen::Matrix<double, 3, 4> RotatedVectorJacobianWrtQuaternion(
+    const Eigen::Quaterniond& quaternion, const Eigen::Vector3d& vector);
+
+// Returns the Jacobian of 'quaternion * vector' with respect to 'vector'.
+Eigen::Matrix3d RotatedVectorJacobianWrtVector(
+    const Eigen::Quaterniond& quaternion);
+
+// Returns the Jacobian of 'transform::RotationQuaternionToAngleAxisVector'.
+Eigen::Matrix<double, 3, 4> RotationQuaternionToAngleAxisVectorJacobian(
+    const Eigen::Quaterniond& quaternion);
+
+// Computes the same error as 'ComputeUnscaledError' for 3D poses and the
+// Jacobians with respect to the given parameters which are not nullptr.
+std::array<double, 6> ComputeUnscaledErrorAndJacobians(
+    const transform::Rigid3d& relative_pose, const double* start_rotation,
+    const double* start_translation, const double* end_rotation,
+    const double* end_translation,
+    Eigen::Matrix<double, 6, 4>* jacobian_start_rotation,
+    Eigen::Matrix<double, 6, 3>* jacobian_start_translation,
+    Eigen::Matrix<double, 6, 4>* jacobian_end_rotation,
+    Eigen::Matrix<double, 6, 3>* jacobian_end_translation);
+
+// Computes the same as 'SlerpQuaternions' and the Jacobians with respect to
+// 'start' and 'end' which are not nullptr.
+std::array<double, 4> SlerpQuaternionsAndJacobians(
+    const double* start, const double* end, double factor,
+    Eigen::Matrix4d* jacobian_start, Eigen::Matrix4d* jacobian_end);
+
 }  // namespace optimization
 }  // namespace mapping
 }  // namespace cartographer
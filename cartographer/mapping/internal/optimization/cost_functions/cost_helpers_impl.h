@@ -100,6 +100,18 @@ std::array<T, 6> ScaleError(const std::array<T, 6>& error,
   // clang-format on
 }
 
+template <int N>
+Eigen::Matrix<double, 6, N> ScaleJacobian(
+    const Eigen::Matrix<double, 6, N>& jacobian, double translation_weight,
+    double rotation_weight) {
+  Eigen::Matrix<double, 6, N> result;
+  result.template topRows<3>() =
+      translation_weight * jacobian.template topRows<3>();
+  result.template bottomRows<3>() =
+      rotation_weight * jacobian.template bottomRows<3>();
+  return result;
+}
+
 //  Eigen implementation of slerp is not compatible with Ceres on all supported
 //  platforms. Our own implementation is used instead.
 template <typename T>
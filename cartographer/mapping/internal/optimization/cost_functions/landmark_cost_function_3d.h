@@ -31,6 +31,104 @@ namespace cartographer {
 namespace mapping {
 namespace optimization {
 
+// Computes the residuals of 'LandmarkCostFunction3D' with analytical
+// Jacobians.
+class AnalyticalLandmarkCostFunction3D
+    : public ceres::SizedCostFunction<
+          6 /* residuals */, 4 /* previous node rotation variables */,
+          3 /* previous node translation variables */,
+          4 /* next node rotation variables */,
+          3 /* next node translation variables */,
+          4 /* landmark rotation variables */,
+          3 /* landmark translation variables */> {
+ public:
+  AnalyticalLandmarkCostFunction3D(
+      const transform::Rigid3d& landmark_to_tracking_transform,
+      const double translation_weight, const double rotation_weight,
+      const double interpolation_parameter)
+      : landmark_to_tracking_transform_(landmark_to_tracking_transform),
+        translation_weight_(translation_weight),
+        rotation_weight_(rotation_weight),
+        interpolation_parameter_(interpolation_parameter) {}
+
+  bool Evaluate(double const* const* parameters, double* residuals,
+                double** jacobians) const override {
+    const auto wanted = [jacobians](int i) {
+      return jacobians != nullptr && jacobians[i] != nullptr;
+    };
+    const bool rotation_wanted = wanted(0) || wanted(2);
+    Eigen::Matrix4d jacobian_slerp_prev;
+    Eigen::Matrix4d jacobian_slerp_next;
+    const std::array<double, 4> interpolated_rotation =
+        SlerpQuaternionsAndJacobians(
+            parameters[0], parameters[2], interpolation_parameter_,
+            rotation_wanted ? &jacobian_slerp_prev : nullptr,
+            rotation_wanted ? &jacobian_slerp_next : nullptr);
+    const Eigen::Vector3d interpolated_translation =
+        (1. - interpolation_parameter_) *
+            Eigen::Map<const Eigen::Vector3d>(parameters[1]) +
+        interpolation_parameter_ *
+            Eigen::Map<const Eigen::Vector3d>(parameters[3]);
+
+    Eigen::Matrix<double, 6, 4> jacobian_interpolated_rotation;
+    Eigen::Matrix<double, 6, 3> jacobian_interpolated_translation;
+    Eigen::Matrix<double, 6, 4> jacobian_landmark_rotation;
+    Eigen::Matrix<double, 6, 3> jacobian_landmark_translation;
+    const std::array<double, 6> error = ScaleError(
+        ComputeUnscaledErrorAndJacobians(
+            landmark_to_tracking_transform_, interpolated_rotation.data(),
+            interpolated_translation.data(), parameters[4], parameters[5],
+            rotation_wanted ? &jacobian_interpolated_rotation : nullptr,
+            wanted(1) || wanted(3) ? &jacobian_interpolated_translation
+                                   : nullptr,
+            wanted(4) ? &jacobian_landmark_rotation : nullptr,
+            wanted(5) ? &jacobian_landmark_translation : nullptr),
+        translation_weight_, rotation_weight_);
+    std::copy(std::begin(error), std::end(error), residuals);
+
+    using RotationJacobian = Eigen::Matrix<double, 6, 4, Eigen::RowMajor>;
+    using TranslationJacobian = Eigen::Matrix<double, 6, 3, Eigen::RowMajor>;
+    if (wanted(0)) {
+      (Eigen::Map<RotationJacobian>(jacobians[0]) =
+           ScaleJacobian<4>(
+               jacobian_interpolated_rotation * jacobian_slerp_prev,
+               translation_weight_, rotation_weight_));
+    }
+    if (wanted(1)) {
+      (Eigen::Map<TranslationJacobian>(jacobians[1]) = ScaleJacobian<3>(
+           (1. - interpolation_parameter_) * jacobian_interpolated_translation,
+           translation_weight_, rotation_weight_));
+    }
+    if (wanted(2)) {
+      (Eigen::Map<RotationJacobian>(jacobians[2]) =
+           ScaleJacobian<4>(
+               jacobian_interpolated_rotation * jacobian_slerp_next,
+               translation_weight_, rotation_weight_));
+    }
+    if (wanted(3)) {
+      (Eigen::Map<TranslationJacobian>(jacobians[3]) = ScaleJacobian<3>(
+           interpolation_parameter_ * jacobian_interpolated_translation,
+           translation_weight_, rotation_weight_));
+    }
+    if (wanted(4)) {
+      (Eigen::Map<RotationJacobian>(jacobians[4]) = ScaleJacobian(
+           jacobian_landmark_rotation, translation_weight_, rotation_weight_));
+    }
+    if (wanted(5)) {
+      (Eigen::Map<TranslationJacobian>(jacobians[5]) =
+           ScaleJacobian(jacobian_landmark_translation, translation_weight_,
+                         rotation_weight_));
+    }
+    return true;
+  }
+
+ private:
+  const transform::Rigid3d landmark_to_tracking_transform_;
+  const double translation_weight_;
+  const double rotation_weight_;
+  const double interpolation_parameter_;
+};
+
 // Cost function measuring the weighted error between the observed pose given by
 // the landmark measurement and the linearly interpolated pose.
 class LandmarkCostFunction3D {
@@ -52,6 +150,18 @@ class LandmarkCostFunction3D {
         new LandmarkCostFunction3D(observation, prev_node, next_node));
   }
 
+  // Same residuals with analytically computed Jacobians.
+  static ceres::CostFunction* CreateAnalyticalCostFunction(
+      const LandmarkObservation& observation, const NodeSpec3D& prev_node,
+      const NodeSpec3D& next_node) {
+    const LandmarkCostFunction3D cost_function(observation, prev_node,
+                                               next_node);
+    return new AnalyticalLandmarkCostFunction3D(
+        cost_function.landmark_to_tracking_transform_,
+        cost_function.translation_weight_, cost_function.rotation_weight_,
+        cost_function.interpolation_parameter_);
+  }
+
   template <typename T>
   bool operator()(const T* const prev_node_rotation,
                   const T* const prev_node_translation,
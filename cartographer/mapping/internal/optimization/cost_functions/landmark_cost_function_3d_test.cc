@@ -18,6 +18,7 @@
 
 #include <memory>
 
+#include "cartographer/mapping/internal/optimization/cost_functions/cost_function_test_helpers.h"
 #include "cartographer/transform/rigid_transform.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -71,6 +72,45 @@ TEST(LandmarkCostFunction3DTest, SmokeTest) {
                                      DoubleEq(0.), DoubleEq(0.), DoubleEq(0.)));
 }
 
+TEST(LandmarkCostFunction3DTest, AnalyticalMatchesAutoDiff) {
+  NodeSpec3D prev_node;
+  prev_node.time = common::FromUniversal(0);
+  NodeSpec3D next_node;
+  next_node.time = common::FromUniversal(10);
+  const LandmarkObservation observation{
+      0 /* trajectory ID */,
+      common::FromUniversal(3) /* time */,
+      transform::Rigid3d(Eigen::Vector3d(1., -0.5, 0.2),
+                         Eigen::Quaterniond(0.9, 0.1, -0.3, 0.2).normalized()),
+      2. /* translation_weight */,
+      5. /* rotation_weight */,
+  };
+  std::unique_ptr<ceres::CostFunction> auto_diff_cost_function(
+      LandmarkCostFunction3D::CreateAutoDiffCostFunction(observation, prev_node,
+                                                         next_node));
+  std::unique_ptr<ceres::CostFunction> analytical_cost_function(
+      LandmarkCostFunction3D::CreateAnalyticalCostFunction(
+          observation, prev_node, next_node));
+
+  const std::array<double, 4> prev_node_rotation{{0.98, 0.1, -0.15, 0.2}};
+  const std::array<double, 3> prev_node_translation{{0.3, 0.1, -0.2}};
+  const std::array<double, 3> next_node_translation{{1.3, 0.4, -0.1}};
+  const std::array<double, 4> landmark_rotation{{0.8, 0.2, -0.4, 0.3}};
+  const std::array<double, 3> landmark_translation{{1.2, -0.4, 0.1}};
+  // The second next node rotation is on the other hemisphere, the third one
+  // almost equal to the previous node rotation.
+  for (const std::array<double, 4>& next_node_rotation :
+       {std::array<double, 4>{{0.9, 0.3, -0.1, 0.25}},
+        std::array<double, 4>{{-0.9, -0.3, 0.1, -0.25}},
+        std::array<double, 4>{{0.98, 0.1, -0.15, 0.2}}}) {
+    optimization::ExpectSameResidualsAndJacobians(
+        *auto_diff_cost_function, *analytical_cost_function,
+        {prev_node_rotation.data(), prev_node_translation.data(),
+         next_node_rotation.data(), next_node_translation.data(),
+         landmark_rotation.data(), landmark_translation.data()});
+  }
+}
+
 }  // namespace
 }  // namespace optimization
 }  // namespace mapping
@@ -19,11 +19,93 @@
 
 #include "Eigen/Core"
 #include "Eigen/Geometry"
+#include "cartographer/mapping/internal/optimization/cost_functions/cost_helpers.h"
 #include "ceres/ceres.h"
 
 namespace cartographer {
 namespace mapping {
 
+// Computes the residuals of 'RotationCostFunction3D' with analytical
+// Jacobians.
+class AnalyticalRotationCostFunction3D
+    : public ceres::SizedCostFunction<3 /* residuals */,
+                                      4 /* rotation variables */,
+                                      4 /* rotation variables */,
+                                      4 /* rotation variables */> {
+ public:
+  AnalyticalRotationCostFunction3D(
+      const double scaling_factor,
+      const Eigen::Quaterniond& delta_rotation_imu_frame)
+      : scaling_factor_(scaling_factor),
+        delta_rotation_imu_frame_(delta_rotation_imu_frame) {}
+
+  AnalyticalRotationCostFunction3D(const AnalyticalRotationCostFunction3D&) =
+      delete;
+  AnalyticalRotationCostFunction3D& operator=(
+      const AnalyticalRotationCostFunction3D&) = delete;
+
+  bool Evaluate(double const* const* parameters, double* residuals,
+                double** jacobians) const override {
+    const Eigen::Quaterniond start = ToEigen(parameters[0]);
+    const Eigen::Quaterniond end = ToEigen(parameters[1]);
+    const Eigen::Quaterniond imu_calibration = ToEigen(parameters[2]);
+    const Eigen::Quaterniond end_inverse_times_start = end.conjugate() * start;
+    const Eigen::Quaterniond delta_rotation_times_inverse_calibration =
+        delta_rotation_imu_frame_ * imu_calibration.conjugate();
+    const Eigen::Quaterniond calibrated_delta_rotation =
+        imu_calibration * delta_rotation_times_inverse_calibration;
+    const Eigen::Quaterniond error =
+        end_inverse_times_start * calibrated_delta_rotation;
+    residuals[0] = scaling_factor_ * error.x();
+    residuals[1] = scaling_factor_ * error.y();
+    residuals[2] = scaling_factor_ * error.z();
+    if (jacobians == nullptr) return true;
+
+    // The residuals are the scaled vector part of 'error'.
+    using RowMajorJacobian = Eigen::Matrix<double, 3, 4, Eigen::RowMajor>;
+    const Eigen::Vector4d conjugate(1., -1., -1., -1.);
+    if (jacobians[0] != nullptr) {
+      (Eigen::Map<RowMajorJacobian>(jacobians[0]) =
+           scaling_factor_ *
+           (optimization::LeftQuaternionProductMatrix(end.conjugate()) *
+            optimization::RightQuaternionProductMatrix(
+                calibrated_delta_rotation))
+               .bottomRows<3>());
+    }
+    if (jacobians[1] != nullptr) {
+      (Eigen::Map<RowMajorJacobian>(jacobians[1]) =
+           scaling_factor_ *
+           (optimization::RightQuaternionProductMatrix(
+                start * calibrated_delta_rotation) *
+            conjugate.asDiagonal())
+               .bottomRows<3>());
+    }
+    if (jacobians[2] != nullptr) {
+      // 'imu_calibration' appears once directly and once conjugated.
+      (Eigen::Map<RowMajorJacobian>(jacobians[2]) =
+           scaling_factor_ *
+           (optimization::LeftQuaternionProductMatrix(end_inverse_times_start) *
+                optimization::RightQuaternionProductMatrix(
+                    delta_rotation_times_inverse_calibration) +
+            optimization::LeftQuaternionProductMatrix(
+                end_inverse_times_start * imu_calibration *
+                delta_rotation_imu_frame_) *
+                conjugate.asDiagonal())
+               .bottomRows<3>());
+    }
+    return true;
+  }
+
+ private:
+  static Eigen::Quaterniond ToEigen(const double* const quaternion) {
+    return Eigen::Quaterniond(quaternion[0], quaternion[1], quaternion[2],
+                              quaternion[3]);
+  }
+
+  const double scaling_factor_;
+  const Eigen::Quaterniond delta_rotation_imu_frame_;
+};
+
 // Penalizes differences between IMU data and optimized orientations.
 class RotationCostFunction3D {
  public:
@@ -36,6 +118,14 @@ class RotationCostFunction3D {
         >(new RotationCostFunction3D(scaling_factor, delta_rotation_imu_frame));
   }
 
+  // Same residuals with analytically computed Jacobians.
+  static ceres::CostFunction* CreateAnalyticalCostFunction(
+      const double scaling_factor,
+      const Eigen::Quaterniond& delta_rotation_imu_frame) {
+    return new AnalyticalRotationCostFunction3D(scaling_factor,
+                                                delta_rotation_imu_frame);
+  }
+
   template <typename T>
   bool operator()(const T* const start_rotation, const T* const end_rotation,
                   const T* const imu_calibration, T* residual) const {
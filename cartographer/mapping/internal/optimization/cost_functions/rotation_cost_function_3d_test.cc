@@ -0,0 +1,50 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/optimization/cost_functions/rotation_cost_function_3d.h"
+
+#include <array>
+#include <memory>
+
+#include "cartographer/mapping/internal/optimization/cost_functions/cost_function_test_helpers.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+TEST(RotationCostFunction3DTest, AnalyticalMatchesAutoDiff) {
+  const Eigen::Quaterniond delta_rotation_imu_frame =
+      Eigen::Quaterniond(0.95, 0.05, -0.2, 0.1).normalized();
+  std::unique_ptr<ceres::CostFunction> auto_diff_cost_function(
+      RotationCostFunction3D::CreateAutoDiffCostFunction(
+          3. /* scaling_factor */, delta_rotation_imu_frame));
+  std::unique_ptr<ceres::CostFunction> analytical_cost_function(
+      RotationCostFunction3D::CreateAnalyticalCostFunction(
+          3. /* scaling_factor */, delta_rotation_imu_frame));
+
+  // Deliberately not normalized.
+  const std::array<double, 4> start_rotation{{0.98, 0.1, -0.15, 0.2}};
+  const std::array<double, 4> end_rotation{{0.8, 0.2, -0.4, 0.3}};
+  const std::array<double, 4> imu_calibration{{0.99, -0.05, 0.02, 0.1}};
+  optimization::ExpectSameResidualsAndJacobians(
+      *auto_diff_cost_function, *analytical_cost_function,
+      {start_rotation.data(), end_rotation.data(), imu_calibration.data()});
+}
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
@@ -33,6 +33,63 @@ namespace cartographer {
 namespace mapping {
 namespace optimization {
 
+// Computes the residuals of 'SpaCostFunction3D' with analytical Jacobians.
+class AnalyticalSpaCostFunction3D
+    : public ceres::SizedCostFunction<
+          6 /* residuals */, 4 /* rotation variables */,
+          3 /* translation variables */, 4 /* rotation variables */,
+          3 /* translation variables */> {
+ public:
+  explicit AnalyticalSpaCostFunction3D(const PoseGraph::Constraint::Pose& pose)
+      : pose_(pose) {}
+
+  bool Evaluate(double const* const* parameters, double* residuals,
+                double** jacobians) const override {
+    Eigen::Matrix<double, 6, 4> jacobian_start_rotation;
+    Eigen::Matrix<double, 6, 3> jacobian_start_translation;
+    Eigen::Matrix<double, 6, 4> jacobian_end_rotation;
+    Eigen::Matrix<double, 6, 3> jacobian_end_translation;
+    const auto wanted = [jacobians](int i) {
+      return jacobians != nullptr && jacobians[i] != nullptr;
+    };
+    const std::array<double, 6> error = ScaleError(
+        ComputeUnscaledErrorAndJacobians(
+            pose_.zbar_ij, parameters[0], parameters[1], parameters[2],
+            parameters[3], wanted(0) ? &jacobian_start_rotation : nullptr,
+            wanted(1) ? &jacobian_start_translation : nullptr,
+            wanted(2) ? &jacobian_end_rotation : nullptr,
+            wanted(3) ? &jacobian_end_translation : nullptr),
+        pose_.translation_weight, pose_.rotation_weight);
+    std::copy(std::begin(error), std::end(error), residuals);
+
+    // Jacobians in Ceres are row-major with one row per residual.
+    if (wanted(0)) {
+      (Eigen::Map<Eigen::Matrix<double, 6, 4, Eigen::RowMajor>>(jacobians[0]) =
+           ScaleJacobian(jacobian_start_rotation, pose_.translation_weight,
+                         pose_.rotation_weight));
+    }
+    if (wanted(1)) {
+      (Eigen::Map<Eigen::Matrix<double, 6, 3, Eigen::RowMajor>>(jacobians[1]) =
+           ScaleJacobian(jacobian_start_translation, pose_.translation_weight,
+                         pose_.rotation_weight));
+    }
+    if (wanted(2)) {
+      (Eigen::Map<Eigen::Matrix<double, 6, 4, Eigen::RowMajor>>(jacobians[2]) =
+           ScaleJacobian(jacobian_end_rotation, pose_.translation_weight,
+                         pose_.rotation_weight));
+    }
+    if (wanted(3)) {
+      (Eigen::Map<Eigen::Matrix<double, 6, 3, Eigen::RowMajor>>(jacobians[3]) =
+           ScaleJacobian(jacobian_end_translation, pose_.translation_weight,
+                         pose_.rotation_weight));
+    }
+    return true;
+  }
+
+ private:
+  const PoseGraph::Constraint::Pose pose_;
+};
+
 class SpaCostFunction3D {
  public:
   static ceres::CostFunction* CreateAutoDiffCostFunction(
@@ -43,6 +100,12 @@ class SpaCostFunction3D {
         3 /* translation variables */>(new SpaCostFunction3D(pose));
   }
 
+  // Same residuals with analytically computed Jacobians.
+  static ceres::CostFunction* CreateAnalyticalCostFunction(
+      const PoseGraph::Constraint::Pose& pose) {
+    return new AnalyticalSpaCostFunction3D(pose);
+  }
+
   template <typename T>
   bool operator()(const T* const c_i_rotation, const T* const c_i_translation,
                   const T* const c_j_rotation, const T* const c_j_translation,
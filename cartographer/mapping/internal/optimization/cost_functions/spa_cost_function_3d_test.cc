@@ -0,0 +1,57 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/optimization/cost_functions/spa_cost_function_3d.h"
+
+#include <array>
+#include <memory>
+
+#include "cartographer/mapping/internal/optimization/cost_functions/cost_function_test_helpers.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace optimization {
+namespace {
+
+TEST(SpaCostFunction3DTest, AnalyticalMatchesAutoDiff) {
+  const PoseGraph::Constraint::Pose pose{
+      transform::Rigid3d(Eigen::Vector3d(1., -0.5, 0.2),
+                         Eigen::Quaterniond(0.9, 0.1, -0.3, 0.2).normalized()),
+      2. /* translation_weight */, 5. /* rotation_weight */};
+  std::unique_ptr<ceres::CostFunction> auto_diff_cost_function(
+      SpaCostFunction3D::CreateAutoDiffCostFunction(pose));
+  std::unique_ptr<ceres::CostFunction> analytical_cost_function(
+      SpaCostFunction3D::CreateAnalyticalCostFunction(pose));
+
+  // Deliberately not normalized.
+  const std::array<double, 4> start_rotation{{0.98, 0.1, -0.15, 0.2}};
+  const std::array<double, 3> start_translation{{0.3, 0.1, -0.2}};
+  for (const std::array<double, 4>& end_rotation :
+       {std::array<double, 4>{{0.8, 0.2, -0.4, 0.3}},
+        std::array<double, 4>{{-0.5, 0.4, 0.6, -0.1}}}) {
+    const std::array<double, 3> end_translation{{1.2, -0.4, 0.1}};
+    ExpectSameResidualsAndJacobians(
+        *auto_diff_cost_function, *analytical_cost_function,
+        {start_rotation.data(), start_translation.data(), end_rotation.data(),
+         end_translation.data()});
+  }
+}
+
+}  // namespace
+}  // namespace optimization
+}  // namespace mapping
+}  // namespace cartographer
@@ -21,7 +21,9 @@
 #include <cmath>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "cartographer/common/ceres_solver_options.h"
@@ -106,70 +108,83 @@ transform::Rigid3d GetInitialLandmarkPose(
          observation.landmark_to_tracking_transform;
 }
 
-void AddLandmarkCostFunctions(
-    const std::map<std::string, LandmarkNode>& landmark_nodes,
-    const MapById<NodeId, NodeSpec2D>& node_data,
-    MapById<NodeId, std::array<double, 3>>* C_nodes,
-    std::map<std::string, CeresPose>* C_landmarks, ceres::Problem* problem,
-    double huber_scale) {
-  for (const auto& landmark_node : landmark_nodes) {
-    for (const auto& observation : landmark_node.second.landmark_observations) {
-      const std::string& landmark_id = landmark_node.first;
-      const auto& begin_of_trajectory =
-          node_data.BeginOfTrajectory(observation.trajectory_id);
-      // The landmark observation was made before the trajectory was created.
-      if (observation.time < begin_of_trajectory->data.time) {
-        continue;
-      }
-      // Find the trajectory nodes before and after the landmark observation.
-      auto next =
-          node_data.lower_bound(observation.trajectory_id, observation.time);
-      // The landmark observation was made, but the next trajectory node has
-      // not been added yet.
-      if (next == node_data.EndOfTrajectory(observation.trajectory_id)) {
-        continue;
-      }
-      if (next == begin_of_trajectory) {
-        next = std::next(next);
-      }
-      auto prev = std::prev(next);
-      // Add parameter blocks for the landmark ID if they were not added before.
-      std::array<double, 3>* prev_node_pose = &C_nodes->at(prev->id);
-      std::array<double, 3>* next_node_pose = &C_nodes->at(next->id);
-      if (!C_landmarks->count(landmark_id)) {
-        const transform::Rigid3d starting_point =
-            landmark_node.second.global_landmark_pose.has_value()
-                ? landmark_node.second.global_landmark_pose.value()
-                : GetInitialLandmarkPose(observation, prev->data, next->data,
-                                         *prev_node_pose, *next_node_pose);
-        C_landmarks->emplace(
-            landmark_id,
-            CeresPose(starting_point, nullptr /* translation_parametrization */,
-                      absl::make_unique<ceres::QuaternionParameterization>(),
-                      problem));
-        // Set landmark constant if it is frozen.
-        if (landmark_node.second.frozen) {
-          problem->SetParameterBlockConstant(
-              C_landmarks->at(landmark_id).translation());
-          problem->SetParameterBlockConstant(
-              C_landmarks->at(landmark_id).rotation());
-        }
-      }
-      problem->AddResidualBlock(
-          LandmarkCostFunction2D::CreateAutoDiffCostFunction(
-              observation, prev->data, next->data),
-          new ceres::HuberLoss(huber_scale), prev_node_pose->data(),
-          next_node_pose->data(), C_landmarks->at(landmark_id).rotation(),
-          C_landmarks->at(landmark_id).translation());
+// Finds the nodes before and after 'observation' in its trajectory. Returns
+// false if there are none (yet).
+bool FindEnclosingNodes(
+    const LandmarkNode::LandmarkObservation& observation,
+    const MapById<NodeId, NodeSpec2D>& node_data, NodeId* const prev_node_id,
+    NodeId* const next_node_id) {
+  if (node_data.SizeOfTrajectoryOrZero(observation.trajectory_id) < 2) {
+    return false;
+  }
+  const auto begin_of_trajectory =
+      node_data.BeginOfTrajectory(observation.trajectory_id);
+  const auto end_of_trajectory =
+      node_data.EndOfTrajectory(observation.trajectory_id);
+  // The landmark observation was made before the trajectory was created.
+  if (observation.time < begin_of_trajectory->data.time) {
+    return false;
+  }
+  auto next =
+      node_data.lower_bound(observation.trajectory_id, observation.time);
+  // The landmark observation was made, but the next trajectory node has not
+  // been added yet.
+  if (next == end_of_trajectory) {
+    return false;
+  }
+  if (next == begin_of_trajectory) {
+    next = std::next(next);
+  }
+  *prev_node_id = std::prev(next)->id;
+  *next_node_id = next->id;
+  return true;
+}
+
+bool IsSameConstraint(const PoseGraphInterface::Constraint& lhs,
+                      const PoseGraphInterface::Constraint& rhs) {
+  return lhs.tag == rhs.tag &&
+         lhs.pose.zbar_ij.translation() == rhs.pose.zbar_ij.translation() &&
+         lhs.pose.zbar_ij.rotation().coeffs() ==
+             rhs.pose.zbar_ij.rotation().coeffs() &&
+         lhs.pose.translation_weight == rhs.pose.translation_weight &&
+         lhs.pose.rotation_weight == rhs.pose.rotation_weight;
+}
+
+ceres::Problem::Options CreateProblemOptions() {
+  ceres::Problem::Options problem_options;
+  // Residual blocks of trimmed nodes and submaps are removed between solves.
+  problem_options.enable_fast_removal = true;
+  return problem_options;
+}
+
+// Returns an elimination ordering with the submap poses in the first group
+// and all other parameter blocks of 'problem' in the second.
+std::shared_ptr<ceres::ParameterBlockOrdering> CreateSubmapsFirstOrdering(
+    const MapById<SubmapId, std::array<double, 3>>& C_submaps,
+    ceres::Problem* problem) {
+  auto ordering = std::make_shared<ceres::ParameterBlockOrdering>();
+  std::vector<double*> parameter_blocks;
+  problem->GetParameterBlocks(&parameter_blocks);
+  for (double* const parameter_block : parameter_blocks) {
+    ordering->AddElementToGroup(parameter_block, 1);
+  }
+  for (const auto& C_submap_id_data : C_submaps) {
+    double* const submap_pose =
+        const_cast<double*>(C_submap_id_data.data.data());
+    // Submaps of frozen trajectories may not be in the problem.
+    if (problem->HasParameterBlock(submap_pose)) {
+      ordering->AddElementToGroup(submap_pose, 0);
     }
   }
+  return ordering;
 }
 
 }  // namespace
 
 OptimizationProblem2D::OptimizationProblem2D(
     const proto::OptimizationProblemOptions& options)
-    : options_(options) {}
+    : options_(options),
+      problem_(absl::make_unique<ceres::Problem>(CreateProblemOptions())) {}
 
 OptimizationProblem2D::~OptimizationProblem2D() {}
 
@@ -194,6 +209,10 @@ void OptimizationProblem2D::AddTrajectoryNode(const int trajectory_id,
                                               const NodeSpec2D& node_data) {
   node_data_.Append(trajectory_id, node_data);
   trajectory_data_[trajectory_id];
+  const NodeId node_id =
+      std::prev(node_data_.EndOfTrajectory(trajectory_id))->id;
+  added_node_ids_.insert(node_id);
+  AddPendingConsecutiveNodes(node_id);
 }
 
 void OptimizationProblem2D::SetTrajectoryData(
@@ -205,6 +224,8 @@ void OptimizationProblem2D::InsertTrajectoryNode(const NodeId& node_id,
                                                  const NodeSpec2D& node_data) {
   node_data_.Insert(node_id, node_data);
   trajectory_data_[node_id.trajectory_id];
+  added_node_ids_.insert(node_id);
+  AddPendingConsecutiveNodes(node_id);
 }
 
 void OptimizationProblem2D::TrimTrajectoryNode(const NodeId& node_id) {
@@ -212,23 +233,45 @@ void OptimizationProblem2D::TrimTrajectoryNode(const NodeId& node_id) {
   odometry_data_.Trim(node_data_, node_id);
   fixed_frame_pose_data_.Trim(node_data_, node_id);
   node_data_.Trim(node_id);
+  added_node_ids_.erase(node_id);
   if (node_data_.SizeOfTrajectoryOrZero(node_id.trajectory_id) == 0) {
     trajectory_data_.erase(node_id.trajectory_id);
+    pending_consecutive_nodes_.erase(node_id.trajectory_id);
   }
 }
 
 void OptimizationProblem2D::AddSubmap(
     const int trajectory_id, const transform::Rigid2d& global_submap_pose) {
   submap_data_.Append(trajectory_id, SubmapSpec2D{global_submap_pose});
+  added_submap_ids_.insert(
+      std::prev(submap_data_.EndOfTrajectory(trajectory_id))->id);
 }
 
 void OptimizationProblem2D::InsertSubmap(
     const SubmapId& submap_id, const transform::Rigid2d& global_submap_pose) {
   submap_data_.Insert(submap_id, SubmapSpec2D{global_submap_pose});
+  added_submap_ids_.insert(submap_id);
 }
 
 void OptimizationProblem2D::TrimSubmap(const SubmapId& submap_id) {
   submap_data_.Trim(submap_id);
+  added_submap_ids_.erase(submap_id);
+}
+
+void OptimizationProblem2D::TrimTrajectory(const int trajectory_id) {
+  empty_imu_data_.TrimTrajectory(trajectory_id);
+  odometry_data_.TrimTrajectory(trajectory_id);
+  fixed_frame_pose_data_.TrimTrajectory(trajectory_id);
+  node_data_.ExtractTrajectory(trajectory_id);
+  submap_data_.ExtractTrajectory(trajectory_id);
+  trajectory_data_.erase(trajectory_id);
+  pending_consecutive_nodes_.erase(trajectory_id);
+  added_node_ids_.erase(
+      added_node_ids_.lower_bound(NodeId{trajectory_id, 0}),
+      added_node_ids_.lower_bound(NodeId{trajectory_id + 1, 0}));
+  added_submap_ids_.erase(
+      added_submap_ids_.lower_bound(SubmapId{trajectory_id, 0}),
+      added_submap_ids_.lower_bound(SubmapId{trajectory_id + 1, 0}));
 }
 
 void OptimizationProblem2D::SetMaxNumIterations(
@@ -237,11 +280,150 @@ void OptimizationProblem2D::SetMaxNumIterations(
       max_num_iterations);
 }
 
+void OptimizationProblem2D::RequestFullOptimization() {
+  full_optimization_requested_ = true;
+}
+
+size_t OptimizationProblem2D::MemoryUsageInBytes() const {
+  size_t result =
+      node_data_.size() * (sizeof(NodeSpec2D) + sizeof(std::array<double, 3>)) +
+      submap_data_.size() *
+          (sizeof(SubmapSpec2D) + sizeof(std::array<double, 3>)) +
+      odometry_data_.size() * sizeof(sensor::OdometryData) +
+      fixed_frame_pose_data_.size() * sizeof(sensor::FixedFramePoseData) +
+      constraint_residual_blocks_.size() * sizeof(ConstraintResidualBlock) +
+      consecutive_nodes_residual_blocks_.size() *
+          sizeof(ConsecutiveNodesResidualBlocks);
+  for (const auto& entry : pending_consecutive_nodes_) {
+    // Roughly the size of a node of a red-black tree.
+    result += (entry.second.without_residual_blocks.size() +
+               entry.second.without_odometry.size()) *
+              (sizeof(int) + 4 * sizeof(void*));
+  }
+  for (const auto& entry : landmark_observation_residual_blocks_) {
+    result +=
+        entry.second.capacity() * sizeof(LandmarkObservationResidualBlock);
+  }
+  return result;
+}
+
+bool OptimizationProblem2D::IsFullOptimizationDue() const {
+  if ((options_.incremental_optimization_num_hops() == 0 &&
+       options_.incremental_optimization_radius() <= 0.) ||
+      full_optimization_requested_) {
+    return true;
+  }
+  return options_.full_optimization_every_n_optimizations() > 0 &&
+         num_optimizations_since_full_optimization_ + 1 >=
+             options_.full_optimization_every_n_optimizations();
+}
+
+OptimizationProblem2D::ActiveSet OptimizationProblem2D::ComputeActiveSet(
+    const std::vector<Constraint>& constraints) const {
+  std::map<NodeId, std::vector<SubmapId>> node_to_submap_ids;
+  std::map<SubmapId, std::vector<NodeId>> submap_to_node_ids;
+  for (const Constraint& constraint : constraints) {
+    node_to_submap_ids[constraint.node_id].push_back(constraint.submap_id);
+    submap_to_node_ids[constraint.submap_id].push_back(constraint.node_id);
+  }
+
+  ActiveSet active_set;
+  std::vector<NodeId> node_frontier;
+  std::vector<SubmapId> submap_frontier;
+  const auto activate_node = [&](const NodeId& node_id) {
+    if (node_data_.Contains(node_id) &&
+        active_set.node_ids.insert(node_id).second) {
+      node_frontier.push_back(node_id);
+    }
+  };
+  const auto activate_submap = [&](const SubmapId& submap_id) {
+    if (submap_data_.Contains(submap_id) &&
+        active_set.submap_ids.insert(submap_id).second) {
+      submap_frontier.push_back(submap_id);
+    }
+  };
+  for (const NodeId& node_id : added_node_ids_) {
+    activate_node(node_id);
+  }
+  for (const SubmapId& submap_id : added_submap_ids_) {
+    activate_submap(submap_id);
+  }
+  for (const Constraint& constraint : constraints) {
+    if (constraint_residual_blocks_.count(
+            std::make_pair(constraint.submap_id, constraint.node_id)) == 0) {
+      activate_node(constraint.node_id);
+      activate_submap(constraint.submap_id);
+    }
+  }
+
+  // Breadth-first search over constraints and consecutive nodes.
+  for (int hop = 0; hop != options_.incremental_optimization_num_hops();
+       ++hop) {
+    const std::vector<NodeId> node_ids = std::move(node_frontier);
+    const std::vector<SubmapId> submap_ids = std::move(submap_frontier);
+    node_frontier.clear();
+    submap_frontier.clear();
+    for (const NodeId& node_id : node_ids) {
+      activate_node(NodeId{node_id.trajectory_id, node_id.node_index - 1});
+      activate_node(NodeId{node_id.trajectory_id, node_id.node_index + 1});
+      const auto it = node_to_submap_ids.find(node_id);
+      if (it != node_to_submap_ids.end()) {
+        for (const SubmapId& submap_id : it->second) {
+          activate_submap(submap_id);
+        }
+      }
+    }
+    for (const SubmapId& submap_id : submap_ids) {
+      const auto it = submap_to_node_ids.find(submap_id);
+      if (it != submap_to_node_ids.end()) {
+        for (const NodeId& node_id : it->second) {
+          activate_node(node_id);
+        }
+      }
+    }
+  }
+
+  // Add the neighborhood of the last node of trajectories with added nodes.
+  const double radius = options_.incremental_optimization_radius();
+  if (radius > 0.) {
+    std::vector<Eigen::Vector2d> centers;
+    for (const int trajectory_id : node_data_.trajectory_ids()) {
+      const auto last_node_it =
+          std::prev(node_data_.EndOfTrajectory(trajectory_id));
+      if (added_node_ids_.count(last_node_it->id) != 0) {
+        centers.push_back(last_node_it->data.global_pose_2d.translation());
+      }
+    }
+    const auto is_near_center = [&](const Eigen::Vector2d& position) {
+      for (const Eigen::Vector2d& center : centers) {
+        if ((position - center).squaredNorm() <= radius * radius) {
+          return true;
+        }
+      }
+      return false;
+    };
+    if (!centers.empty()) {
+      for (const auto& node_id_data : node_data_) {
+        if (is_near_center(node_id_data.data.global_pose_2d.translation())) {
+          active_set.node_ids.insert(node_id_data.id);
+        }
+      }
+      for (const auto& submap_id_data : submap_data_) {
+        if (is_near_center(submap_id_data.data.global_pose.translation())) {
+          active_set.submap_ids.insert(submap_id_data.id);
+        }
+      }
+    }
+  }
+  return active_set;
+}
+
 void OptimizationProblem2D::Solve(
     const std::vector<Constraint>& constraints,
     const std::map<int, PoseGraphInterface::TrajectoryState>&
         trajectories_state,
     const std::map<std::string, LandmarkNode>& landmark_nodes) {
+  last_solve_summary_ = SolveSummary();
   if (node_data_.empty()) {
     // Nothing to optimize.
     return;
@@ -254,101 +436,460 @@ void OptimizationProblem2D::Solve(
     }
   }
 
-  ceres::Problem::Options problem_options;
-  ceres::Problem problem(problem_options);
-
-  // Set the starting point.
-  // TODO(hrapp): Move ceres data into SubmapSpec.
-  MapById<SubmapId, std::array<double, 3>> C_submaps;
-  MapById<NodeId, std::array<double, 3>> C_nodes;
-  std::map<std::string, CeresPose> C_landmarks;
+  // An incremental optimization holds all poses outside of the active set
+  // constant. Ceres leaves out residuals which only depend on such poses.
+  const bool full_optimization = IsFullOptimizationDue();
+  ActiveSet active_set;
+  if (!full_optimization) {
+    active_set = ComputeActiveSet(constraints);
+  }
+  const auto is_active_node = [&](const NodeId& node_id) {
+    return full_optimization || active_set.node_ids.count(node_id) != 0;
+  };
+  const auto is_active_submap = [&](const SubmapId& submap_id) {
+    return full_optimization || active_set.submap_ids.count(submap_id) != 0;
+  };
+
+  RemoveOutdatedLandmarkResidualBlocks(landmark_nodes);
+  RemoveOutdatedResidualBlocks(constraints);
+
+  // Set the starting point. Poses of frozen trajectories only become
+  // parameter blocks once a residual block connects them to other poses, so
+  // that solves do not grow with the size of a frozen map.
   bool first_submap = true;
   for (const auto& submap_id_data : submap_data_) {
     const bool frozen =
         frozen_trajectories.count(submap_id_data.id.trajectory_id) != 0;
-    C_submaps.Insert(submap_id_data.id,
-                     FromPose(submap_id_data.data.global_pose));
-    problem.AddParameterBlock(C_submaps.at(submap_id_data.id).data(), 3);
-    if (first_submap || frozen) {
-      first_submap = false;
-      // Fix the pose of the first submap or all submaps of a frozen
-      // trajectory.
-      problem.SetParameterBlockConstant(C_submaps.at(submap_id_data.id).data());
+    if (!C_submaps_.Contains(submap_id_data.id)) {
+      C_submaps_.Insert(submap_id_data.id, std::array<double, 3>());
+      if (!frozen) {
+        problem_->AddParameterBlock(C_submaps_.at(submap_id_data.id).data(),
+                                    3);
+      }
+    }
+    double* const submap_pose = C_submaps_.at(submap_id_data.id).data();
+    const std::array<double, 3> pose =
+        FromPose(submap_id_data.data.global_pose);
+    std::copy(pose.begin(), pose.end(), submap_pose);
+    // Fix the pose of the first submap or all submaps of a frozen trajectory.
+    if (!problem_->HasParameterBlock(submap_pose)) {
+      // A frozen submap which no residual block uses.
+    } else if (first_submap || frozen ||
+               !is_active_submap(submap_id_data.id)) {
+      problem_->SetParameterBlockConstant(submap_pose);
+    } else {
+      problem_->SetParameterBlockVariable(submap_pose);
     }
+    first_submap = false;
   }
   for (const auto& node_id_data : node_data_) {
     const bool frozen =
         frozen_trajectories.count(node_id_data.id.trajectory_id) != 0;
-    C_nodes.Insert(node_id_data.id, FromPose(node_id_data.data.global_pose_2d));
-    problem.AddParameterBlock(C_nodes.at(node_id_data.id).data(), 3);
-    if (frozen) {
-      problem.SetParameterBlockConstant(C_nodes.at(node_id_data.id).data());
+    if (!C_nodes_.Contains(node_id_data.id)) {
+      C_nodes_.Insert(node_id_data.id, std::array<double, 3>());
+      if (!frozen) {
+        problem_->AddParameterBlock(C_nodes_.at(node_id_data.id).data(), 3);
+      }
+    }
+    double* const node_pose = C_nodes_.at(node_id_data.id).data();
+    const std::array<double, 3> pose =
+        FromPose(node_id_data.data.global_pose_2d);
+    std::copy(pose.begin(), pose.end(), node_pose);
+    if (!problem_->HasParameterBlock(node_pose)) {
+      // A frozen node which no residual block uses.
+    } else if (frozen || !is_active_node(node_id_data.id)) {
+      problem_->SetParameterBlockConstant(node_pose);
+    } else {
+      problem_->SetParameterBlockVariable(node_pose);
     }
   }
-  // Add cost functions for intra- and inter-submap constraints.
+  // Add cost functions for new intra- and inter-submap constraints.
   for (const Constraint& constraint : constraints) {
-    problem.AddResidualBlock(
+    const auto key = std::make_pair(constraint.submap_id, constraint.node_id);
+    if (constraint_residual_blocks_.count(key) != 0) {
+      continue;
+    }
+    // Residuals between two constant poses do not change the solution.
+    if (frozen_trajectories.count(constraint.submap_id.trajectory_id) != 0 &&
+        frozen_trajectories.count(constraint.node_id.trajectory_id) != 0) {
+      constraint_residual_blocks_.emplace(
+          key, ConstraintResidualBlock{constraint, nullptr});
+      continue;
+    }
+    const ceres::ResidualBlockId residual_block_id = problem_->AddResidualBlock(
         CreateAutoDiffSpaCostFunction(constraint.pose),
         // Loop closure constraints should have a loss function.
         constraint.tag == Constraint::INTER_SUBMAP
             ? new ceres::HuberLoss(options_.huber_scale())
             : nullptr,
-        C_submaps.at(constraint.submap_id).data(),
-        C_nodes.at(constraint.node_id).data());
+        GetPoseParameterBlock(&C_submaps_.at(constraint.submap_id)),
+        GetPoseParameterBlock(&C_nodes_.at(constraint.node_id)));
+    constraint_residual_blocks_.emplace(
+        key, ConstraintResidualBlock{constraint, residual_block_id});
+  }
+  // Update the landmark poses. They are kept between solves like the residual
+  // blocks of their observations.
+  for (auto& C_landmark : C_landmarks_) {
+    const auto it = landmark_nodes.find(C_landmark.first);
+    if (it == landmark_nodes.end()) {
+      continue;
+    }
+    if (it->second.global_landmark_pose.has_value()) {
+      C_landmark.second.data() =
+          FromPose(it->second.global_landmark_pose.value());
+    }
+    if (it->second.frozen) {
+      problem_->SetParameterBlockConstant(C_landmark.second.translation());
+      problem_->SetParameterBlockConstant(C_landmark.second.rotation());
+    } else {
+      problem_->SetParameterBlockVariable(C_landmark.second.translation());
+      problem_->SetParameterBlockVariable(C_landmark.second.rotation());
+    }
+  }
+  AddLandmarkResidualBlocks(landmark_nodes);
+  AddConsecutiveNodesResidualBlocks(frozen_trajectories);
+  AddFixedFramePoseResidualBlocks();
+
+  // Solve.
+  ceres::Solver::Options ceres_solver_options =
+      common::CreateCeresSolverOptions(options_.ceres_solver_options());
+  if (options_.eliminate_submaps_first()) {
+    ceres_solver_options.linear_solver_ordering =
+        CreateSubmapsFirstOrdering(C_submaps_, problem_.get());
+  }
+  ceres::Solver::Summary summary;
+  ceres::Solve(ceres_solver_options, problem_.get(), &summary);
+  last_solve_summary_.num_iterations =
+      summary.num_successful_steps + summary.num_unsuccessful_steps;
+  last_solve_summary_.final_cost = summary.final_cost;
+  last_solve_summary_.converged =
+      summary.termination_type == ceres::CONVERGENCE;
+  if (options_.log_solver_summary()) {
+    LOG(INFO) << summary.FullReport();
+  }
+
+  // Store the result.
+  for (const auto& C_submap_id_data : C_submaps_) {
+    submap_data_.at(C_submap_id_data.id).global_pose =
+        ToPose(C_submap_id_data.data);
+  }
+  for (const auto& C_node_id_data : C_nodes_) {
+    node_data_.at(C_node_id_data.id).global_pose_2d =
+        ToPose(C_node_id_data.data);
   }
-  // Add cost functions for landmarks.
-  AddLandmarkCostFunctions(landmark_nodes, node_data_, &C_nodes, &C_landmarks,
-                           &problem, options_.huber_scale());
+  for (const auto& C_fixed_frame : C_fixed_frames_) {
+    trajectory_data_.at(C_fixed_frame.first).fixed_frame_origin_in_map =
+        transform::Embed3D(ToPose(C_fixed_frame.second));
+  }
+  for (const auto& C_landmark : C_landmarks_) {
+    landmark_data_[C_landmark.first] = C_landmark.second.ToRigid();
+  }
+
+  added_node_ids_.clear();
+  added_submap_ids_.clear();
+  if (full_optimization) {
+    num_optimizations_since_full_optimization_ = 0;
+    full_optimization_requested_ = false;
+  } else {
+    ++num_optimizations_since_full_optimization_;
+  }
+}
+
+void OptimizationProblem2D::RemoveOutdatedResidualBlocks(
+    const std::vector<Constraint>& constraints) {
+  // Fixed frame poses and their residuals are added again for every solve.
+  for (auto& C_fixed_frame : C_fixed_frames_) {
+    problem_->RemoveParameterBlock(C_fixed_frame.second.data());
+  }
+  C_fixed_frames_.clear();
+
+  // Remove constraints which were trimmed or changed.
+  std::map<std::pair<SubmapId, NodeId>, const Constraint*> current_constraints;
+  for (const Constraint& constraint : constraints) {
+    current_constraints.emplace(
+        std::make_pair(constraint.submap_id, constraint.node_id), &constraint);
+  }
+  for (auto it = constraint_residual_blocks_.begin();
+       it != constraint_residual_blocks_.end();) {
+    const auto current_it = current_constraints.find(it->first);
+    if (current_it != current_constraints.end() &&
+        IsSameConstraint(*current_it->second, it->second.constraint)) {
+      ++it;
+      continue;
+    }
+    if (it->second.residual_block_id != nullptr) {
+      problem_->RemoveResidualBlock(it->second.residual_block_id);
+    }
+    it = constraint_residual_blocks_.erase(it);
+  }
+
+  // Remove residuals between consecutive nodes of which one was trimmed.
+  for (auto it = consecutive_nodes_residual_blocks_.begin();
+       it != consecutive_nodes_residual_blocks_.end();) {
+    const NodeId& first_node_id = it->first;
+    const NodeId second_node_id{first_node_id.trajectory_id,
+                                first_node_id.node_index + 1};
+    if (node_data_.Contains(first_node_id) &&
+        node_data_.Contains(second_node_id)) {
+      ++it;
+      continue;
+    }
+    problem_->RemoveResidualBlock(it->second.local_slam_pose);
+    if (it->second.odometry != nullptr) {
+      problem_->RemoveResidualBlock(it->second.odometry);
+    }
+    it = consecutive_nodes_residual_blocks_.erase(it);
+  }
+
+  // Remove the poses of trimmed submaps and nodes.
+  std::vector<SubmapId> trimmed_submap_ids;
+  for (const auto& C_submap_id_data : C_submaps_) {
+    if (!submap_data_.Contains(C_submap_id_data.id)) {
+      trimmed_submap_ids.push_back(C_submap_id_data.id);
+    }
+  }
+  for (const SubmapId& submap_id : trimmed_submap_ids) {
+    double* const submap_pose = C_submaps_.at(submap_id).data();
+    if (problem_->HasParameterBlock(submap_pose)) {
+      problem_->RemoveParameterBlock(submap_pose);
+    }
+    C_submaps_.Trim(submap_id);
+  }
+  std::vector<NodeId> trimmed_node_ids;
+  for (const auto& C_node_id_data : C_nodes_) {
+    if (!node_data_.Contains(C_node_id_data.id)) {
+      trimmed_node_ids.push_back(C_node_id_data.id);
+    }
+  }
+  for (const NodeId& node_id : trimmed_node_ids) {
+    double* const node_pose = C_nodes_.at(node_id).data();
+    if (problem_->HasParameterBlock(node_pose)) {
+      problem_->RemoveParameterBlock(node_pose);
+    }
+    C_nodes_.Trim(node_id);
+  }
+}
+
+void OptimizationProblem2D::RemoveOutdatedLandmarkResidualBlocks(
+    const std::map<std::string, LandmarkNode>& landmark_nodes) {
+  const auto is_enclosed =
+      [this](const LandmarkNode::LandmarkObservation& observation,
+             const LandmarkObservationResidualBlock& block) {
+        if (observation.time != block.time ||
+            observation.trajectory_id != block.trajectory_id ||
+            !node_data_.Contains(block.prev_node_id) ||
+            !node_data_.Contains(block.next_node_id)) {
+          return false;
+        }
+        if (block.next_node_id.node_index ==
+            block.prev_node_id.node_index + 1) {
+          return true;
+        }
+        // Nodes between them were trimmed, so a node may have been inserted.
+        NodeId prev_node_id = block.prev_node_id;
+        NodeId next_node_id = block.next_node_id;
+        return FindEnclosingNodes(observation, node_data_, &prev_node_id,
+                                  &next_node_id) &&
+               prev_node_id == block.prev_node_id &&
+               next_node_id == block.next_node_id;
+      };
+  for (auto& landmark_id_blocks : landmark_observation_residual_blocks_) {
+    const auto it = landmark_nodes.find(landmark_id_blocks.first);
+    std::vector<LandmarkObservationResidualBlock>& blocks =
+        landmark_id_blocks.second;
+    const bool observations_changed =
+        it == landmark_nodes.end() ||
+        it->second.landmark_observations.size() < blocks.size();
+    for (size_t i = 0; i != blocks.size(); ++i) {
+      if (blocks[i].residual_block_id == nullptr ||
+          (!observations_changed &&
+           is_enclosed(it->second.landmark_observations[i], blocks[i]))) {
+        continue;
+      }
+      problem_->RemoveResidualBlock(blocks[i].residual_block_id);
+      blocks[i].residual_block_id = nullptr;
+    }
+    if (observations_changed) {
+      blocks.clear();
+    }
+  }
+  // Like in a new problem, landmarks without residual blocks are left out.
+  // They are added again once an observation is enclosed by nodes.
+  for (auto it = C_landmarks_.begin(); it != C_landmarks_.end();) {
+    const std::vector<LandmarkObservationResidualBlock>& blocks =
+        landmark_observation_residual_blocks_[it->first];
+    if (std::any_of(blocks.begin(), blocks.end(),
+                    [](const LandmarkObservationResidualBlock& block) {
+                      return block.residual_block_id != nullptr;
+                    })) {
+      ++it;
+      continue;
+    }
+    problem_->RemoveParameterBlock(it->second.translation());
+    problem_->RemoveParameterBlock(it->second.rotation());
+    it = C_landmarks_.erase(it);
+  }
+}
+
+void OptimizationProblem2D::AddLandmarkResidualBlocks(
+    const std::map<std::string, LandmarkNode>& landmark_nodes) {
+  for (const auto& landmark_node : landmark_nodes) {
+    const std::string& landmark_id = landmark_node.first;
+    const auto& observations = landmark_node.second.landmark_observations;
+    std::vector<LandmarkObservationResidualBlock>& blocks =
+        landmark_observation_residual_blocks_[landmark_id];
+    blocks.resize(observations.size(),
+                  LandmarkObservationResidualBlock{
+                      common::Time::min(), -1, NodeId{-1, -1},
+                      NodeId{-1, -1}, nullptr /* residual_block_id */});
+    for (size_t i = 0; i != observations.size(); ++i) {
+      const auto& observation = observations[i];
+      LandmarkObservationResidualBlock& block = blocks[i];
+      if (block.residual_block_id != nullptr) {
+        continue;
+      }
+      block.time = observation.time;
+      block.trajectory_id = observation.trajectory_id;
+      if (!FindEnclosingNodes(observation, node_data_, &block.prev_node_id,
+                              &block.next_node_id)) {
+        continue;
+      }
+      const NodeSpec2D& prev_node = node_data_.at(block.prev_node_id);
+      const NodeSpec2D& next_node = node_data_.at(block.next_node_id);
+      std::array<double, 3>* const prev_node_pose =
+          &C_nodes_.at(block.prev_node_id);
+      std::array<double, 3>* const next_node_pose =
+          &C_nodes_.at(block.next_node_id);
+      // Add parameter blocks for the landmark ID if they were not added
+      // before.
+      if (!C_landmarks_.count(landmark_id)) {
+        const transform::Rigid3d starting_point =
+            landmark_node.second.global_landmark_pose.has_value()
+                ? landmark_node.second.global_landmark_pose.value()
+                : GetInitialLandmarkPose(observation, prev_node, next_node,
+                                         *prev_node_pose, *next_node_pose);
+        C_landmarks_.emplace(
+            landmark_id,
+            CeresPose(starting_point, nullptr /* translation_parametrization */,
+                      absl::make_unique<ceres::QuaternionParameterization>(),
+                      problem_.get()));
+        // Set landmark constant if it is frozen.
+        if (landmark_node.second.frozen) {
+          problem_->SetParameterBlockConstant(
+              C_landmarks_.at(landmark_id).translation());
+          problem_->SetParameterBlockConstant(
+              C_landmarks_.at(landmark_id).rotation());
+        }
+      }
+      block.residual_block_id = problem_->AddResidualBlock(
+          LandmarkCostFunction2D::CreateAutoDiffCostFunction(
+              observation, prev_node, next_node),
+          new ceres::HuberLoss(options_.huber_scale()),
+          GetPoseParameterBlock(prev_node_pose),
+          GetPoseParameterBlock(next_node_pose),
+          C_landmarks_.at(landmark_id).rotation(),
+          C_landmarks_.at(landmark_id).translation());
+    }
+  }
+}
+
+void OptimizationProblem2D::AddPendingConsecutiveNodes(
+    const NodeId& node_id) {
+  std::set<int>& without_residual_blocks =
+      pending_consecutive_nodes_[node_id.trajectory_id].without_residual_blocks;
+  if (node_id.node_index > 0) {
+    without_residual_blocks.insert(node_id.node_index - 1);
+  }
+  without_residual_blocks.insert(node_id.node_index);
+}
+
+void OptimizationProblem2D::AddConsecutiveNodesResidualBlocks(
+    const std::set<int>& frozen_trajectories) {
   // Add penalties for violating odometry or changes between consecutive nodes
   // if odometry is not available.
-  for (auto node_it = node_data_.begin(); node_it != node_data_.end();) {
-    const int trajectory_id = node_it->id.trajectory_id;
-    const auto trajectory_end = node_data_.EndOfTrajectory(trajectory_id);
+  for (auto& entry : pending_consecutive_nodes_) {
+    const int trajectory_id = entry.first;
+    PendingConsecutiveNodes& pending = entry.second;
     if (frozen_trajectories.count(trajectory_id) != 0) {
-      node_it = trajectory_end;
+      // Frozen trajectories are never unfrozen and do not get new residual
+      // blocks between their nodes.
+      pending.without_residual_blocks.clear();
+      pending.without_odometry.clear();
       continue;
     }
 
-    auto prev_node_it = node_it;
-    for (++node_it; node_it != trajectory_end; ++node_it) {
-      const NodeId first_node_id = prev_node_it->id;
-      const NodeSpec2D& first_node_data = prev_node_it->data;
-      prev_node_it = node_it;
-      const NodeId second_node_id = node_it->id;
-      const NodeSpec2D& second_node_data = node_it->data;
-
-      if (second_node_id.node_index != first_node_id.node_index + 1) {
+    for (const int first_node_index : pending.without_residual_blocks) {
+      const NodeId first_node_id{trajectory_id, first_node_index};
+      const NodeId second_node_id{trajectory_id, first_node_index + 1};
+      // A pair whose second node is not there (yet) becomes pending again
+      // when the second node is inserted.
+      if (!node_data_.Contains(first_node_id) ||
+          !node_data_.Contains(second_node_id) ||
+          consecutive_nodes_residual_blocks_.count(first_node_id) != 0) {
         continue;
       }
 
-      // Add a relative pose constraint based on the odometry (if available).
-      std::unique_ptr<transform::Rigid3d> relative_odometry =
-          CalculateOdometryBetweenNodes(trajectory_id, first_node_data,
+      // Add a relative pose constraint based on consecutive local SLAM poses.
+      const transform::Rigid3d relative_local_slam_pose = transform::Embed3D(
+          node_data_.at(first_node_id).local_pose_2d.inverse() *
+          node_data_.at(second_node_id).local_pose_2d);
+      const ceres::ResidualBlockId local_slam_pose = problem_->AddResidualBlock(
+          CreateAutoDiffSpaCostFunction(Constraint::Pose{
+              relative_local_slam_pose,
+              options_.local_slam_pose_translation_weight(),
+              options_.local_slam_pose_rotation_weight()}),
+          nullptr /* loss function */, C_nodes_.at(first_node_id).data(),
+          C_nodes_.at(second_node_id).data());
+      consecutive_nodes_residual_blocks_.emplace(
+          first_node_id,
+          ConsecutiveNodesResidualBlocks{local_slam_pose, nullptr});
+      pending.without_odometry.insert(first_node_index);
+    }
+    pending.without_residual_blocks.clear();
+
+    // Add a relative pose constraint based on the odometry (if available).
+    // Odometry for the second node may only arrive after the node was added,
+    // so pairs without it are tried again, until there is odometry after the
+    // second node and interpolating it can no longer change.
+    if (!odometry_data_.HasTrajectory(trajectory_id)) {
+      continue;
+    }
+    for (auto it = pending.without_odometry.begin();
+         it != pending.without_odometry.end();) {
+      const NodeId first_node_id{trajectory_id, *it};
+      const auto residual_blocks_it =
+          consecutive_nodes_residual_blocks_.find(first_node_id);
+      if (residual_blocks_it == consecutive_nodes_residual_blocks_.end()) {
+        // One of the nodes was trimmed.
+        it = pending.without_odometry.erase(it);
+        continue;
+      }
+      const NodeId second_node_id{trajectory_id, *it + 1};
+      const NodeSpec2D& second_node_data = node_data_.at(second_node_id);
+      const std::unique_ptr<transform::Rigid3d> relative_odometry =
+          CalculateOdometryBetweenNodes(trajectory_id,
+                                        node_data_.at(first_node_id),
                                         second_node_data);
       if (relative_odometry != nullptr) {
-        problem.AddResidualBlock(
+        residual_blocks_it->second.odometry = problem_->AddResidualBlock(
             CreateAutoDiffSpaCostFunction(Constraint::Pose{
                 *relative_odometry, options_.odometry_translation_weight(),
                 options_.odometry_rotation_weight()}),
-            nullptr /* loss function */, C_nodes.at(first_node_id).data(),
-            C_nodes.at(second_node_id).data());
+            nullptr /* loss function */, C_nodes_.at(first_node_id).data(),
+            C_nodes_.at(second_node_id).data());
+        it = pending.without_odometry.erase(it);
+      } else if (odometry_data_.lower_bound(trajectory_id,
+                                            second_node_data.time) !=
+                 odometry_data_.EndOfTrajectory(trajectory_id)) {
+        it = pending.without_odometry.erase(it);
+      } else {
+        ++it;
       }
-
-      // Add a relative pose constraint based on consecutive local SLAM poses.
-      const transform::Rigid3d relative_local_slam_pose =
-          transform::Embed3D(first_node_data.local_pose_2d.inverse() *
-                             second_node_data.local_pose_2d);
-      problem.AddResidualBlock(
-          CreateAutoDiffSpaCostFunction(
-              Constraint::Pose{relative_local_slam_pose,
-                               options_.local_slam_pose_translation_weight(),
-                               options_.local_slam_pose_rotation_weight()}),
-          nullptr /* loss function */, C_nodes.at(first_node_id).data(),
-          C_nodes.at(second_node_id).data());
     }
   }
+}
 
-  std::map<int, std::array<double, 3>> C_fixed_frames;
+void OptimizationProblem2D::AddFixedFramePoseResidualBlocks() {
   for (auto node_it = node_data_.begin(); node_it != node_data_.end();) {
     const int trajectory_id = node_it->id.trajectory_id;
     const auto trajectory_end = node_data_.EndOfTrajectory(trajectory_id);
@@ -384,47 +925,31 @@ void OptimizationProblem2D::Solve(
               transform::Project2D(constraint_pose.zbar_ij).inverse();
         }
 
-        C_fixed_frames.emplace(trajectory_id,
-                               FromPose(fixed_frame_pose_in_map));
+        C_fixed_frames_.emplace(trajectory_id,
+                                FromPose(fixed_frame_pose_in_map));
         fixed_frame_pose_initialized = true;
       }
 
-      problem.AddResidualBlock(
+      problem_->AddResidualBlock(
           CreateAutoDiffSpaCostFunction(constraint_pose),
           options_.fixed_frame_pose_use_tolerant_loss()
               ? new ceres::TolerantLoss(
                     options_.fixed_frame_pose_tolerant_loss_param_a(),
                     options_.fixed_frame_pose_tolerant_loss_param_b())
               : nullptr,
-          C_fixed_frames.at(trajectory_id).data(), C_nodes.at(node_id).data());
+          C_fixed_frames_.at(trajectory_id).data(),
+          GetPoseParameterBlock(&C_nodes_.at(node_id)));
     }
   }
+}
 
-  // Solve.
-  ceres::Solver::Summary summary;
-  ceres::Solve(
-      common::CreateCeresSolverOptions(options_.ceres_solver_options()),
-      &problem, &summary);
-  if (options_.log_solver_summary()) {
-    LOG(INFO) << summary.FullReport();
-  }
-
-  // Store the result.
-  for (const auto& C_submap_id_data : C_submaps) {
-    submap_data_.at(C_submap_id_data.id).global_pose =
-        ToPose(C_submap_id_data.data);
-  }
-  for (const auto& C_node_id_data : C_nodes) {
-    node_data_.at(C_node_id_data.id).global_pose_2d =
-        ToPose(C_node_id_data.data);
-  }
-  for (const auto& C_fixed_frame : C_fixed_frames) {
-    trajectory_data_.at(C_fixed_frame.first).fixed_frame_origin_in_map =
-        transform::Embed3D(ToPose(C_fixed_frame.second));
-  }
-  for (const auto& C_landmark : C_landmarks) {
-    landmark_data_[C_landmark.first] = C_landmark.second.ToRigid();
+double* OptimizationProblem2D::GetPoseParameterBlock(
+    std::array<double, 3>* const pose) {
+  if (!problem_->HasParameterBlock(pose->data())) {
+    problem_->AddParameterBlock(pose->data(), 3);
+    problem_->SetParameterBlockConstant(pose->data());
   }
+  return pose->data();
 }
 
 std::unique_ptr<transform::Rigid3d> OptimizationProblem2D::InterpolateOdometry(
@@ -20,7 +20,10 @@
 #include <array>
 #include <deque>
 #include <map>
+#include <memory>
 #include <set>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "Eigen/Core"
@@ -28,6 +31,7 @@
 #include "cartographer/common/port.h"
 #include "cartographer/common/time.h"
 #include "cartographer/mapping/id.h"
+#include "cartographer/mapping/internal/optimization/ceres_pose.h"
 #include "cartographer/mapping/internal/optimization/optimization_problem_interface.h"
 #include "cartographer/mapping/pose_graph_interface.h"
 #include "cartographer/mapping/proto/pose_graph/optimization_problem_options.pb.h"
@@ -35,6 +39,7 @@
 #include "cartographer/sensor/map_by_time.h"
 #include "cartographer/sensor/odometry_data.h"
 #include "cartographer/transform/timestamped_transform.h"
+#include "ceres/ceres.h"
 
 namespace cartographer {
 namespace mapping {
@@ -82,6 +87,9 @@ class OptimizationProblem2D
       const std::map<int, PoseGraphInterface::TrajectoryState>&
           trajectories_state,
       const std::map<std::string, LandmarkNode>& landmark_nodes) override;
+  const SolveSummary& last_solve_summary() const override {
+    return last_solve_summary_;
+  }
 
   const MapById<NodeId, NodeSpec2D>& node_data() const override {
     return node_data_;
@@ -116,7 +124,61 @@ class OptimizationProblem2D
     return trajectory_data_;
   }
 
+  // Removes all nodes, submaps and sensor data of 'trajectory_id' at once.
+  // Their residual blocks are removed by the next Solve().
+  void TrimTrajectory(int trajectory_id);
+
+  // Makes the next Solve() optimize all poses even if incremental
+  // optimization is enabled.
+  void RequestFullOptimization();
+
+  // Returns an estimate of the bytes held by the node, submap and sensor data
+  // and by the bookkeeping of the Ceres problem. Memory allocated inside the
+  // Ceres problem itself is not included.
+  size_t MemoryUsageInBytes() const;
+
+  // Visible for testing.
+  int num_residual_blocks() const { return problem_->NumResidualBlocks(); }
+  int num_parameter_blocks() const { return problem_->NumParameterBlocks(); }
+
  private:
+  // Nodes and submaps whose poses are optimized by an incremental
+  // optimization.
+  struct ActiveSet {
+    std::set<NodeId> node_ids;
+    std::set<SubmapId> submap_ids;
+  };
+
+  bool IsFullOptimizationDue() const;
+  // Returns the nodes and submaps within 'incremental_optimization_num_hops'
+  // of a node, submap or constraint added since the last optimization, and
+  // within 'incremental_optimization_radius' of the last node of trajectories
+  // with added nodes.
+  ActiveSet ComputeActiveSet(const std::vector<Constraint>& constraints) const;
+  // Removes residual blocks and poses of 'problem_' which belong to trimmed
+  // nodes, submaps or constraints, or which are added again for every solve.
+  void RemoveOutdatedResidualBlocks(const std::vector<Constraint>& constraints);
+  // Removes residual blocks of landmark observations whose enclosing nodes
+  // were trimmed or are no longer adjacent, and the poses of landmarks which
+  // are left without residual blocks.
+  void RemoveOutdatedLandmarkResidualBlocks(
+      const std::map<std::string, LandmarkNode>& landmark_nodes);
+  // Adds residual blocks for new landmark observations and for those whose
+  // enclosing nodes were not known before.
+  void AddLandmarkResidualBlocks(
+      const std::map<std::string, LandmarkNode>& landmark_nodes);
+  // Marks the pairs of consecutive nodes which 'node_id' is part of as
+  // pending for 'AddConsecutiveNodesResidualBlocks'.
+  void AddPendingConsecutiveNodes(const NodeId& node_id);
+  // Adds residual blocks for pending pairs of consecutive nodes, i.e. those
+  // with a new node and those still waiting for odometry.
+  void AddConsecutiveNodesResidualBlocks(
+      const std::set<int>& frozen_trajectories);
+  void AddFixedFramePoseResidualBlocks();
+  // Returns the parameter block of 'pose', which is one of 'C_submaps_' or
+  // 'C_nodes_'. Poses of frozen trajectories are only added to 'problem_', as
+  // constant, once a residual block uses them.
+  double* GetPoseParameterBlock(std::array<double, 3>* pose);
   std::unique_ptr<transform::Rigid3d> InterpolateOdometry(
       int trajectory_id, common::Time time) const;
   // Computes the relative pose between two nodes based on odometry data.
@@ -125,6 +187,7 @@ class OptimizationProblem2D
       const NodeSpec2D& second_node_data) const;
 
   optimization::proto::OptimizationProblemOptions options_;
+  SolveSummary last_solve_summary_;
   MapById<NodeId, NodeSpec2D> node_data_;
   MapById<SubmapId, SubmapSpec2D> submap_data_;
   std::map<std::string, transform::Rigid3d> landmark_data_;
@@ -132,6 +195,61 @@ class OptimizationProblem2D
   sensor::MapByTime<sensor::OdometryData> odometry_data_;
   sensor::MapByTime<sensor::FixedFramePoseData> fixed_frame_pose_data_;
   std::map<int, PoseGraphInterface::TrajectoryData> trajectory_data_;
+
+  // State of incremental optimization, see
+  // 'incremental_optimization_num_hops' and 'incremental_optimization_radius'.
+  std::set<NodeId> added_node_ids_;
+  std::set<SubmapId> added_submap_ids_;
+  int num_optimizations_since_full_optimization_ = 0;
+  bool full_optimization_requested_ = false;
+
+  // The Ceres problem is kept between solves, so that only residual blocks of
+  // new constraints and nodes have to be created. The poses in it are reset
+  // from 'node_data_' and 'submap_data_' before every solve.
+  struct ConstraintResidualBlock {
+    Constraint constraint;
+    // nullptr for constraints between poses of frozen trajectories, which
+    // are left out.
+    ceres::ResidualBlockId residual_block_id;
+  };
+  struct ConsecutiveNodesResidualBlocks {
+    ceres::ResidualBlockId local_slam_pose;
+    // nullptr if there is no odometry for the nodes (yet).
+    ceres::ResidualBlockId odometry;
+  };
+  std::unique_ptr<ceres::Problem> problem_;
+  MapById<SubmapId, std::array<double, 3>> C_submaps_;
+  MapById<NodeId, std::array<double, 3>> C_nodes_;
+  std::map<std::string, CeresPose> C_landmarks_;
+  std::map<int, std::array<double, 3>> C_fixed_frames_;
+  std::map<std::pair<SubmapId, NodeId>, ConstraintResidualBlock>
+      constraint_residual_blocks_;
+  // Keyed by the first of the two nodes.
+  std::map<NodeId, ConsecutiveNodesResidualBlocks>
+      consecutive_nodes_residual_blocks_;
+  // Per trajectory, the node indices of the first nodes of pairs which a solve
+  // has to visit: pairs without residual blocks yet, and pairs whose odometry
+  // residual block is missing but may still be added once more odometry
+  // arrives. All other pairs are final, so solves do not iterate over all
+  // nodes. Trimming removes the residual blocks of the pairs it touches.
+  struct PendingConsecutiveNodes {
+    std::set<int> without_residual_blocks;
+    std::set<int> without_odometry;
+  };
+  std::map<int, PendingConsecutiveNodes> pending_consecutive_nodes_;
+  // Per landmark, indexed like its 'landmark_observations', which are only
+  // ever appended to. The nodes enclosing each observation are cached, so
+  // that its residual block is only replaced if they change.
+  struct LandmarkObservationResidualBlock {
+    common::Time time;
+    int trajectory_id;
+    NodeId prev_node_id;
+    NodeId next_node_id;
+    // nullptr while the observation is not enclosed by nodes.
+    ceres::ResidualBlockId residual_block_id;
+  };
+  std::map<std::string, std::vector<LandmarkObservationResidualBlock>>
+      landmark_observation_residual_blocks_;
 };
 
 }  // namespace optimization
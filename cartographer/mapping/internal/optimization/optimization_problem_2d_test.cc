@@ -0,0 +1,492 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/optimization/optimization_problem_2d.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "cartographer/common/lua_parameter_dictionary_test_helpers.h"
+#include "cartographer/common/time.h"
+#include "cartographer/mapping/internal/optimization/optimization_problem_options.h"
+#include "cartographer/sensor/odometry_data.h"
+#include "cartographer/transform/rigid_transform_test_helpers.h"
+#include "cartographer/transform/transform.h"
+#include "gmock/gmock.h"
+
+namespace cartographer {
+namespace mapping {
+namespace optimization {
+namespace {
+
+using Constraint = PoseGraphInterface::Constraint;
+using LandmarkNode = PoseGraphInterface::LandmarkNode;
+using TrajectoryState = PoseGraphInterface::TrajectoryState;
+
+constexpr int kTrajectoryId = 0;
+
+// Nodes are 1 m apart along x, and submap 'i' starts at node '2 * i'.
+transform::Rigid2d NodePose(const int node_index) {
+  return transform::Rigid2d::Translation(Eigen::Vector2d(node_index, 0.));
+}
+
+transform::Rigid2d SubmapPose(const int submap_index) {
+  return NodePose(2 * submap_index);
+}
+
+NodeSpec2D CreateNodeSpec(const int node_index,
+                          const transform::Rigid2d& global_pose) {
+  return NodeSpec2D{common::FromUniversal(node_index), NodePose(node_index),
+                    global_pose, Eigen::Quaterniond::Identity()};
+}
+
+// Returns a constraint which places 'node_id' at 'node_pose' relative to
+// 'submap_id' at 'submap_pose'.
+Constraint CreateConstraint(const SubmapId& submap_id,
+                            const transform::Rigid2d& submap_pose,
+                            const NodeId& node_id,
+                            const transform::Rigid2d& node_pose,
+                            const Constraint::Tag tag) {
+  return Constraint{submap_id, node_id,
+                    Constraint::Pose{
+                        transform::Embed3D(submap_pose.inverse() * node_pose),
+                        1e5 /* translation_weight */,
+                        1e5 /* rotation_weight */},
+                    tag};
+}
+
+// Returns an observation of a landmark at 'landmark_pose' from node
+// 'node_index', made at the time of the node.
+LandmarkNode::LandmarkObservation CreateLandmarkObservation(
+    const int node_index, const transform::Rigid2d& landmark_pose) {
+  return LandmarkNode::LandmarkObservation{
+      kTrajectoryId, common::FromUniversal(node_index),
+      transform::Embed3D(NodePose(node_index).inverse() * landmark_pose),
+      1e5 /* translation_weight */, 1e5 /* rotation_weight */};
+}
+
+class OptimizationProblem2DTest : public ::testing::Test {
+ protected:
+  OptimizationProblem2DTest() : options_(CreateOptions()) {}
+
+  static proto::OptimizationProblemOptions CreateOptions() {
+    auto parameter_dictionary = common::MakeDictionary(R"text(
+        return {
+          acceleration_weight = 1.,
+          rotation_weight = 1.,
+          huber_scale = 1e5,
+          local_slam_pose_translation_weight = 1e5,
+          local_slam_pose_rotation_weight = 1e5,
+          odometry_translation_weight = 1e5,
+          odometry_rotation_weight = 1e5,
+          fixed_frame_pose_translation_weight = 1e1,
+          fixed_frame_pose_rotation_weight = 1e2,
+          fixed_frame_pose_use_tolerant_loss = false,
+          fixed_frame_pose_tolerant_loss_param_a = 1,
+          fixed_frame_pose_tolerant_loss_param_b = 1,
+          log_solver_summary = false,
+          use_online_imu_extrinsics_in_3d = true,
+          fix_z_in_3d = false,
+          incremental_optimization_num_hops = 0,
+          incremental_optimization_radius = 0.,
+          full_optimization_every_n_optimizations = 0,
+          eliminate_submaps_first = false,
+          use_analytical_jacobians_in_3d = false,
+          imu_aggregation_duration_in_3d = 0.,
+          ceres_solver_options = {
+            use_nonmonotonic_steps = false,
+            max_num_iterations = 200,
+            num_threads = 1,
+            linear_solver_type = "",
+            sparse_linear_algebra_library_type = "",
+          },
+        })text");
+    return CreateOptimizationProblemOptions(parameter_dictionary.get());
+  }
+
+  // Adds the nodes in ['begin_node_index', 'end_node_index') of a straight
+  // trajectory, the submaps starting at them and an intra-submap constraint
+  // for each node.
+  void AddNodes(const int begin_node_index, const int end_node_index,
+                OptimizationProblem2D* const problem) {
+    for (int node_index = begin_node_index; node_index != end_node_index;
+         ++node_index) {
+      const NodeId node_id{kTrajectoryId, node_index};
+      const SubmapId submap_id{kTrajectoryId, node_index / 2};
+      if (node_index % 2 == 0) {
+        problem->InsertSubmap(submap_id, SubmapPose(submap_id.submap_index));
+      }
+      problem->InsertTrajectoryNode(
+          node_id, CreateNodeSpec(node_index, NodePose(node_index)));
+      constraints_.push_back(CreateConstraint(
+          submap_id, SubmapPose(submap_id.submap_index), node_id,
+          NodePose(node_index), Constraint::INTRA_SUBMAP));
+    }
+  }
+
+  // Adds a loop closure which pulls 'node_index' half a meter towards
+  // 'submap_index'.
+  void AddLoopClosure(const int submap_index, const int node_index) {
+    constraints_.push_back(CreateConstraint(
+        SubmapId{kTrajectoryId, submap_index}, SubmapPose(submap_index),
+        NodeId{kTrajectoryId, node_index},
+        transform::Rigid2d::Translation(Eigen::Vector2d(-0.5, 0.)) *
+            NodePose(node_index),
+        Constraint::INTER_SUBMAP));
+  }
+
+  void RemoveConstraintsOf(const NodeId& node_id) {
+    constraints_.erase(std::remove_if(constraints_.begin(), constraints_.end(),
+                                      [&](const Constraint& constraint) {
+                                        return constraint.node_id == node_id;
+                                      }),
+                       constraints_.end());
+  }
+
+  void RemoveConstraintsOf(const SubmapId& submap_id) {
+    constraints_.erase(std::remove_if(constraints_.begin(), constraints_.end(),
+                                      [&](const Constraint& constraint) {
+                                        return constraint.submap_id ==
+                                               submap_id;
+                                      }),
+                       constraints_.end());
+  }
+
+  void AddLandmarkObservation(const std::string& landmark_id,
+                              const int node_index,
+                              const transform::Rigid2d& landmark_pose) {
+    landmark_nodes_[landmark_id].landmark_observations.push_back(
+        CreateLandmarkObservation(node_index, landmark_pose));
+  }
+
+  void Solve(OptimizationProblem2D* const problem,
+             const std::map<int, TrajectoryState>& trajectories_state = {
+                 {kTrajectoryId, TrajectoryState::ACTIVE}}) {
+    problem->Solve(constraints_, trajectories_state, landmark_nodes_);
+    // Like the pose graph, starts the next solve from the optimized landmark
+    // poses.
+    for (const auto& landmark : problem->landmark_data()) {
+      const auto it = landmark_nodes_.find(landmark.first);
+      if (it != landmark_nodes_.end()) {
+        it->second.global_landmark_pose = landmark.second;
+      }
+    }
+  }
+
+  // Adds odometry for the times of the nodes in ['begin_node_index',
+  // 'end_node_index'), which places them 1.1 m apart instead of 1 m.
+  void AddOdometry(const int begin_node_index, const int end_node_index,
+                   OptimizationProblem2D* const problem) {
+    for (int node_index = begin_node_index; node_index != end_node_index;
+         ++node_index) {
+      problem->AddOdometryData(
+          kTrajectoryId,
+          sensor::OdometryData{
+              common::FromUniversal(node_index),
+              transform::Rigid3d::Translation(
+                  Eigen::Vector3d(1.1 * node_index, 0., 0.))});
+    }
+  }
+
+  // Solves 'problem' and a fresh problem starting from the same poses, and
+  // expects both to arrive at the same problem and poses.
+  void ExpectSolveMatchesFreshProblem(OptimizationProblem2D* const problem) {
+    OptimizationProblem2D fresh_problem(options_);
+    for (const auto& submap_id_data : problem->submap_data()) {
+      fresh_problem.InsertSubmap(submap_id_data.id,
+                                 submap_id_data.data.global_pose);
+    }
+    for (const auto& node_id_data : problem->node_data()) {
+      fresh_problem.InsertTrajectoryNode(node_id_data.id, node_id_data.data);
+    }
+    for (const int trajectory_id : problem->odometry_data().trajectory_ids()) {
+      for (const sensor::OdometryData& odometry_data :
+           problem->odometry_data().trajectory(trajectory_id)) {
+        fresh_problem.AddOdometryData(trajectory_id, odometry_data);
+      }
+    }
+    const std::map<std::string, LandmarkNode> landmark_nodes = landmark_nodes_;
+
+    Solve(problem);
+    fresh_problem.Solve(constraints_,
+                        {{kTrajectoryId, TrajectoryState::ACTIVE}},
+                        landmark_nodes);
+    EXPECT_EQ(problem->num_parameter_blocks(),
+              fresh_problem.num_parameter_blocks());
+    EXPECT_EQ(problem->num_residual_blocks(),
+              fresh_problem.num_residual_blocks());
+    ASSERT_EQ(problem->node_data().size(), fresh_problem.node_data().size());
+    for (const auto& node_id_data : fresh_problem.node_data()) {
+      const transform::Rigid2d& expected = node_id_data.data.global_pose_2d;
+      const transform::Rigid2d& actual =
+          problem->node_data().at(node_id_data.id).global_pose_2d;
+      EXPECT_NEAR(actual.translation().x(), expected.translation().x(), 1e-6);
+      EXPECT_NEAR(actual.translation().y(), expected.translation().y(), 1e-6);
+      EXPECT_NEAR(actual.rotation().angle(), expected.rotation().angle(),
+                  1e-6);
+    }
+    for (const auto& submap_id_data : fresh_problem.submap_data()) {
+      const transform::Rigid2d& expected = submap_id_data.data.global_pose;
+      const transform::Rigid2d& actual =
+          problem->submap_data().at(submap_id_data.id).global_pose;
+      EXPECT_NEAR(actual.translation().x(), expected.translation().x(), 1e-6);
+      EXPECT_NEAR(actual.translation().y(), expected.translation().y(), 1e-6);
+      EXPECT_NEAR(actual.rotation().angle(), expected.rotation().angle(),
+                  1e-6);
+    }
+    for (const auto& landmark : fresh_problem.landmark_data()) {
+      EXPECT_THAT(problem->landmark_data().at(landmark.first),
+                  transform::IsNearly(landmark.second, 1e-6));
+    }
+  }
+
+  // Optimizes a straight trajectory of 10 nodes, then adds an 11th node
+  // together with a loop closure to the first submap which pulls it back.
+  void AddLoopClosureAfterSolve(OptimizationProblem2D* const problem) {
+    AddNodes(0, 10, problem);
+    Solve(problem);
+    AddNodes(10, 11, problem);
+    AddLoopClosure(0, 10);
+  }
+
+  proto::OptimizationProblemOptions options_;
+  std::vector<Constraint> constraints_;
+  std::map<std::string, LandmarkNode> landmark_nodes_;
+};
+
+double NodeX(const OptimizationProblem2D& problem, const int node_index) {
+  return problem.node_data()
+      .at(NodeId{kTrajectoryId, node_index})
+      .global_pose_2d.translation()
+      .x();
+}
+
+double SubmapX(const OptimizationProblem2D& problem, const int submap_index) {
+  return problem.submap_data()
+      .at(SubmapId{kTrajectoryId, submap_index})
+      .global_pose.translation()
+      .x();
+}
+
+TEST_F(OptimizationProblem2DTest, TrimmingRemovesResidualBlocks) {
+  OptimizationProblem2D problem(options_);
+  AddNodes(0, 4, &problem);
+  Solve(&problem);
+  // 4 nodes and 2 submaps, 4 constraints and 3 pairs of consecutive nodes.
+  EXPECT_EQ(problem.num_parameter_blocks(), 6);
+  EXPECT_EQ(problem.num_residual_blocks(), 7);
+
+  const NodeId trimmed_node_id{kTrajectoryId, 3};
+  const SubmapId trimmed_submap_id{kTrajectoryId, 1};
+  problem.TrimTrajectoryNode(trimmed_node_id);
+  problem.TrimSubmap(trimmed_submap_id);
+  RemoveConstraintsOf(trimmed_node_id);
+  RemoveConstraintsOf(trimmed_submap_id);
+  Solve(&problem);
+  // 3 nodes and 1 submap, 2 constraints and 2 pairs of consecutive nodes.
+  EXPECT_EQ(problem.num_parameter_blocks(), 4);
+  EXPECT_EQ(problem.num_residual_blocks(), 4);
+}
+
+TEST_F(OptimizationProblem2DTest, FrozenPosesStayConstant) {
+  constexpr int kFrozenTrajectoryId = 1;
+  const transform::Rigid2d frozen_offset =
+      transform::Rigid2d::Translation(Eigen::Vector2d(0., 2.));
+  OptimizationProblem2D problem(options_);
+  AddNodes(0, 4, &problem);
+  const SubmapId frozen_submap_id{kFrozenTrajectoryId, 0};
+  problem.InsertSubmap(frozen_submap_id, frozen_offset);
+  for (int node_index = 0; node_index != 3; ++node_index) {
+    const NodeId node_id{kFrozenTrajectoryId, node_index};
+    problem.InsertTrajectoryNode(
+        node_id,
+        CreateNodeSpec(node_index, frozen_offset * NodePose(node_index)));
+    constraints_.push_back(CreateConstraint(
+        frozen_submap_id, frozen_offset, node_id,
+        frozen_offset * NodePose(node_index), Constraint::INTRA_SUBMAP));
+  }
+  const std::map<int, TrajectoryState> trajectories_state = {
+      {kTrajectoryId, TrajectoryState::ACTIVE},
+      {kFrozenTrajectoryId, TrajectoryState::FROZEN}};
+  Solve(&problem, trajectories_state);
+  // Only the 4 active nodes and 2 submaps, their 4 constraints and 3 pairs of
+  // consecutive nodes. The frozen trajectory is not connected to them.
+  EXPECT_EQ(problem.num_parameter_blocks(), 6);
+  EXPECT_EQ(problem.num_residual_blocks(), 7);
+
+  // Pulls the last active node away from the frozen submap.
+  const NodeId pulled_node_id{kTrajectoryId, 3};
+  constraints_.push_back(CreateConstraint(
+      frozen_submap_id, frozen_offset, pulled_node_id,
+      transform::Rigid2d::Translation(Eigen::Vector2d(0.5, 0.)) * NodePose(3),
+      Constraint::INTER_SUBMAP));
+  Solve(&problem, trajectories_state);
+  // The frozen submap is added as a constant pose, its nodes stay out.
+  EXPECT_EQ(problem.num_parameter_blocks(), 7);
+  EXPECT_EQ(problem.num_residual_blocks(), 8);
+  EXPECT_EQ(
+      problem.submap_data().at(frozen_submap_id).global_pose.translation(),
+      frozen_offset.translation());
+  for (int node_index = 0; node_index != 3; ++node_index) {
+    EXPECT_EQ(problem.node_data()
+                  .at(NodeId{kFrozenTrajectoryId, node_index})
+                  .global_pose_2d.translation(),
+              (frozen_offset * NodePose(node_index)).translation());
+  }
+  EXPECT_GT(
+      problem.node_data().at(pulled_node_id).global_pose_2d.translation().x(),
+      NodePose(3).translation().x() + 1e-3);
+}
+
+TEST_F(OptimizationProblem2DTest, RepeatedSolvesMatchFreshProblem) {
+  OptimizationProblem2D problem(options_);
+  AddNodes(0, 4, &problem);
+  Solve(&problem);
+  AddNodes(4, 8, &problem);
+  AddLoopClosure(0, 7);
+  Solve(&problem);
+  const NodeId trimmed_node_id{kTrajectoryId, 5};
+  problem.TrimTrajectoryNode(trimmed_node_id);
+  RemoveConstraintsOf(trimmed_node_id);
+  AddNodes(8, 10, &problem);
+  AddLoopClosure(1, 9);
+  ExpectSolveMatchesFreshProblem(&problem);
+}
+
+TEST_F(OptimizationProblem2DTest, AddsOdometryOncePairsAreCovered) {
+  OptimizationProblem2D problem(options_);
+  AddNodes(0, 4, &problem);
+  Solve(&problem);
+  // 4 constraints and 3 pairs of consecutive nodes without odometry.
+  EXPECT_EQ(problem.num_residual_blocks(), 7);
+
+  // Covers the pairs of nodes 0 to 2, but not the pair of nodes 2 and 3.
+  AddOdometry(0, 3, &problem);
+  Solve(&problem);
+  EXPECT_EQ(problem.num_residual_blocks(), 7 + 2);
+
+  AddOdometry(3, 5, &problem);
+  Solve(&problem);
+  EXPECT_EQ(problem.num_residual_blocks(), 7 + 3);
+  // Pairs with odometry are final and not visited again.
+  Solve(&problem);
+  EXPECT_EQ(problem.num_residual_blocks(), 7 + 3);
+
+  // Only the pair of nodes 3 and 4 is covered by odometry.
+  AddNodes(4, 6, &problem);
+  ExpectSolveMatchesFreshProblem(&problem);
+  EXPECT_EQ(problem.num_residual_blocks(), 11 + 4);
+  EXPECT_GT(NodeX(problem, 4), 4. + 1e-3);
+}
+
+TEST_F(OptimizationProblem2DTest,
+       RepeatedSolvesWithLandmarksMatchFreshProblem) {
+  const transform::Rigid2d landmark_pose =
+      transform::Rigid2d::Translation(Eigen::Vector2d(3., 1.));
+  OptimizationProblem2D problem(options_);
+  AddNodes(0, 4, &problem);
+  AddLandmarkObservation("a", 1, landmark_pose);
+  AddLandmarkObservation("a", 2, landmark_pose);
+  // Only enclosed by nodes once node 5 is added.
+  AddLandmarkObservation("a", 5, landmark_pose);
+  AddLandmarkObservation("b", 3, landmark_pose);
+  Solve(&problem);
+  // 4 nodes, 2 submaps and the translation and rotation of 2 landmarks.
+  EXPECT_EQ(problem.num_parameter_blocks(), 10);
+  // 4 constraints, 3 pairs of consecutive nodes and 3 enclosed observations.
+  EXPECT_EQ(problem.num_residual_blocks(), 10);
+
+  AddNodes(4, 8, &problem);
+  AddLoopClosure(0, 7);
+  // Observations are only ever appended. This one pulls landmark "a" along x.
+  AddLandmarkObservation(
+      "a", 6,
+      transform::Rigid2d::Translation(Eigen::Vector2d(0.2, 0.)) *
+          landmark_pose);
+  ExpectSolveMatchesFreshProblem(&problem);
+
+  // Node 2 encloses observations of both landmarks.
+  const NodeId trimmed_node_id{kTrajectoryId, 2};
+  problem.TrimTrajectoryNode(trimmed_node_id);
+  RemoveConstraintsOf(trimmed_node_id);
+  ExpectSolveMatchesFreshProblem(&problem);
+
+  landmark_nodes_.erase("b");
+  AddNodes(8, 10, &problem);
+  ExpectSolveMatchesFreshProblem(&problem);
+  // 9 nodes, 5 submaps and the translation and rotation of landmark "a".
+  EXPECT_EQ(problem.num_parameter_blocks(), 16);
+}
+
+TEST_F(OptimizationProblem2DTest, IncrementalOptimizationFollowsHops) {
+  options_.set_incremental_optimization_num_hops(1);
+  OptimizationProblem2D problem(options_);
+  AddLoopClosureAfterSolve(&problem);
+  Solve(&problem);
+  // Node 10, submap 5 and the submap of the loop closure are new. One hop
+  // away are node 9 and the nodes of submap 0.
+  for (int node_index = 2; node_index != 9; ++node_index) {
+    EXPECT_EQ(NodeX(problem, node_index), node_index);
+  }
+  for (int submap_index = 1; submap_index != 5; ++submap_index) {
+    EXPECT_EQ(SubmapX(problem, submap_index), 2 * submap_index);
+  }
+  EXPECT_LT(NodeX(problem, 9), 9. - 1e-3);
+  EXPECT_LT(NodeX(problem, 10), 10. - 1e-3);
+}
+
+TEST_F(OptimizationProblem2DTest, IncrementalOptimizationFollowsRadius) {
+  options_.set_incremental_optimization_radius(2.5);
+  OptimizationProblem2D problem(options_);
+  AddLoopClosureAfterSolve(&problem);
+  Solve(&problem);
+  // Nodes 8 to 10 and submaps 4 and 5 are close to the new node 10.
+  for (int node_index = 0; node_index != 8; ++node_index) {
+    EXPECT_EQ(NodeX(problem, node_index), node_index);
+  }
+  for (int submap_index = 1; submap_index != 4; ++submap_index) {
+    EXPECT_EQ(SubmapX(problem, submap_index), 2 * submap_index);
+  }
+  EXPECT_LT(NodeX(problem, 8), 8. - 1e-3);
+  EXPECT_LT(NodeX(problem, 10), 10. - 1e-3);
+}
+
+TEST_F(OptimizationProblem2DTest, FullOptimizationEveryNOptimizations) {
+  options_.set_incremental_optimization_num_hops(1);
+  options_.set_full_optimization_every_n_optimizations(3);
+  OptimizationProblem2D problem(options_);
+  AddLoopClosureAfterSolve(&problem);
+  // The second optimization is incremental.
+  Solve(&problem);
+  EXPECT_EQ(NodeX(problem, 5), 5.);
+  const double node_10_x = NodeX(problem, 10);
+  // The third optimization is a full one, even though nothing was added.
+  Solve(&problem);
+  EXPECT_LT(NodeX(problem, 5), 5. - 1e-3);
+  EXPECT_LT(NodeX(problem, 10), node_10_x);
+  // The fourth optimization is incremental again.
+  const double node_5_x = NodeX(problem, 5);
+  AddNodes(11, 12, &problem);
+  Solve(&problem);
+  EXPECT_EQ(NodeX(problem, 5), node_5_x);
+}
+
+}  // namespace
+}  // namespace optimization
+}  // namespace mapping
+}  // namespace cartographer
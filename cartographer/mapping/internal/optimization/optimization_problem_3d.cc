@@ -126,7 +126,7 @@ void AddLandmarkCostFunctions(
     const MapById<NodeId, NodeSpec3D>& node_data,
     MapById<NodeId, CeresPose>* C_nodes,
     std::map<std::string, CeresPose>* C_landmarks, ceres::Problem* problem,
-    double huber_scale) {
+    double huber_scale, bool use_analytical_jacobians) {
   for (const auto& landmark_node : landmark_nodes) {
     // Do not use landmarks that were not optimized for localization.
     for (const auto& observation : landmark_node.second.landmark_observations) {
@@ -172,8 +172,11 @@ void AddLandmarkCostFunctions(
         }
       }
       problem->AddResidualBlock(
-          LandmarkCostFunction3D::CreateAutoDiffCostFunction(
-              observation, prev->data, next->data),
+          use_analytical_jacobians
+              ? LandmarkCostFunction3D::CreateAnalyticalCostFunction(
+                    observation, prev->data, next->data)
+              : LandmarkCostFunction3D::CreateAutoDiffCostFunction(
+                    observation, prev->data, next->data),
           new ceres::HuberLoss(huber_scale), prev_node_pose->rotation(),
           prev_node_pose->translation(), next_node_pose->rotation(),
           next_node_pose->translation(),
@@ -193,7 +196,31 @@ OptimizationProblem3D::~OptimizationProblem3D() {}
 
 void OptimizationProblem3D::AddImuData(const int trajectory_id,
                                        const sensor::ImuData& imu_data) {
+  if (options_.imu_aggregation_duration_in_3d() <= 0.) {
+    AppendImuData(trajectory_id, imu_data);
+    return;
+  }
+  auto it = imu_aggregators_.find(trajectory_id);
+  if (it == imu_aggregators_.end()) {
+    it = imu_aggregators_
+             .emplace(trajectory_id,
+                      ImuAggregator(common::FromSeconds(
+                          options_.imu_aggregation_duration_in_3d())))
+             .first;
+  }
+  const absl::optional<sensor::ImuData> chunk = it->second.Add(imu_data);
+  if (chunk.has_value()) {
+    AppendImuData(trajectory_id, chunk.value());
+  }
+}
+
+void OptimizationProblem3D::AppendImuData(const int trajectory_id,
+                                          const sensor::ImuData& imu_data) {
   imu_data_.Append(trajectory_id, imu_data);
+  const auto it = imu_preintegrations_.find(trajectory_id);
+  if (it != imu_preintegrations_.end()) {
+    it->second.Append(imu_data);
+  }
 }
 
 void OptimizationProblem3D::AddOdometryData(
@@ -211,6 +238,16 @@ void OptimizationProblem3D::AddTrajectoryNode(const int trajectory_id,
                                               const NodeSpec3D& node_data) {
   node_data_.Append(trajectory_id, node_data);
   trajectory_data_[trajectory_id];
+  // Ends the current IMU chunk at the node, so that the IMU integral between
+  // consecutive nodes is not approximated.
+  const auto it = imu_aggregators_.find(trajectory_id);
+  if (it != imu_aggregators_.end()) {
+    const absl::optional<sensor::ImuData> chunk =
+        it->second.Split(node_data.time);
+    if (chunk.has_value()) {
+      AppendImuData(trajectory_id, chunk.value());
+    }
+  }
 }
 
 void OptimizationProblem3D::SetTrajectoryData(
@@ -226,11 +263,13 @@ void OptimizationProblem3D::InsertTrajectoryNode(const NodeId& node_id,
 
 void OptimizationProblem3D::TrimTrajectoryNode(const NodeId& node_id) {
   imu_data_.Trim(node_data_, node_id);
+  imu_preintegrations_.erase(node_id.trajectory_id);
   odometry_data_.Trim(node_data_, node_id);
   fixed_frame_pose_data_.Trim(node_data_, node_id);
   node_data_.Trim(node_id);
   if (node_data_.SizeOfTrajectoryOrZero(node_id.trajectory_id) == 0) {
     trajectory_data_.erase(node_id.trajectory_id);
+    imu_aggregators_.erase(node_id.trajectory_id);
   }
 }
 
@@ -259,6 +298,7 @@ void OptimizationProblem3D::Solve(
     const std::map<int, PoseGraphInterface::TrajectoryState>&
         trajectories_state,
     const std::map<std::string, LandmarkNode>& landmark_nodes) {
+  last_solve_summary_ = SolveSummary();
   if (node_data_.empty()) {
     // Nothing to optimize.
     return;
@@ -274,6 +314,15 @@ void OptimizationProblem3D::Solve(
   ceres::Problem::Options problem_options;
   ceres::Problem problem(problem_options);
 
+  const bool use_analytical_jacobians =
+      options_.use_analytical_jacobians_in_3d();
+  const auto create_spa_cost_function =
+      [use_analytical_jacobians](const Constraint::Pose& pose) {
+        return use_analytical_jacobians
+                   ? SpaCostFunction3D::CreateAnalyticalCostFunction(pose)
+                   : SpaCostFunction3D::CreateAutoDiffCostFunction(pose);
+      };
+
   const auto translation_parameterization =
       [this]() -> std::unique_ptr<ceres::LocalParameterization> {
     return options_.fix_z_in_3d()
@@ -336,7 +385,7 @@ void OptimizationProblem3D::Solve(
   // Add cost functions for intra- and inter-submap constraints.
   for (const Constraint& constraint : constraints) {
     problem.AddResidualBlock(
-        SpaCostFunction3D::CreateAutoDiffCostFunction(constraint.pose),
+        create_spa_cost_function(constraint.pose),
         // Loop closure constraints should have a loss function.
         constraint.tag == Constraint::INTER_SUBMAP
             ? new ceres::HuberLoss(options_.huber_scale())
@@ -348,7 +397,8 @@ void OptimizationProblem3D::Solve(
   }
   // Add cost functions for landmarks.
   AddLandmarkCostFunctions(landmark_nodes, node_data_, &C_nodes, &C_landmarks,
-                           &problem, options_.huber_scale());
+                           &problem, options_.huber_scale(),
+                           use_analytical_jacobians);
   // Add constraints based on IMU observations of angular velocities and
   // linear acceleration.
   if (!options_.fix_z_in_3d()) {
@@ -371,8 +421,14 @@ void OptimizationProblem3D::Solve(
       CHECK(imu_data_.HasTrajectory(trajectory_id));
       const auto imu_data = imu_data_.trajectory(trajectory_id);
       CHECK(imu_data.begin() != imu_data.end());
+      ImuPreintegration& imu_preintegration =
+          imu_preintegrations_[trajectory_id];
+      if (imu_preintegration.empty()) {
+        for (const sensor::ImuData& imu_data_point : imu_data) {
+          imu_preintegration.Append(imu_data_point);
+        }
+      }
 
-      auto imu_it = imu_data.begin();
       auto prev_node_it = node_it;
       for (++node_it; node_it != trajectory_end; ++node_it) {
         const NodeId first_node_id = prev_node_it->id;
@@ -385,15 +441,8 @@ void OptimizationProblem3D::Solve(
           continue;
         }
 
-        // Skip IMU data before the node.
-        while (std::next(imu_it) != imu_data.end() &&
-               std::next(imu_it)->time <= first_node_data.time) {
-          ++imu_it;
-        }
-
-        auto imu_it2 = imu_it;
-        const IntegrateImuResult<double> result = IntegrateImu(
-            imu_data, first_node_data.time, second_node_data.time, &imu_it);
+        const IntegrateImuResult<double> result = imu_preintegration.Integrate(
+            first_node_data.time, second_node_data.time);
         const auto next_node_it = std::next(node_it);
         const common::Time first_time = first_node_data.time;
         const common::Time second_time = second_node_data.time;
@@ -407,9 +456,9 @@ void OptimizationProblem3D::Solve(
           const common::Time first_center = first_time + first_duration / 2;
           const common::Time second_center = second_time + second_duration / 2;
           const IntegrateImuResult<double> result_to_first_center =
-              IntegrateImu(imu_data, first_time, first_center, &imu_it2);
+              imu_preintegration.Integrate(first_time, first_center);
           const IntegrateImuResult<double> result_center_to_center =
-              IntegrateImu(imu_data, first_center, second_center, &imu_it2);
+              imu_preintegration.Integrate(first_center, second_center);
           // 'delta_velocity' is the change in velocity from the point in time
           // halfway between the first and second poses to halfway between
           // second and third pose. It is computed from IMU data and still
@@ -419,12 +468,19 @@ void OptimizationProblem3D::Solve(
               (result.delta_rotation.inverse() *
                result_to_first_center.delta_rotation) *
               result_center_to_center.delta_velocity;
+          const double acceleration_scaling_factor =
+              options_.acceleration_weight() /
+              common::ToSeconds(first_duration + second_duration);
           problem.AddResidualBlock(
-              AccelerationCostFunction3D::CreateAutoDiffCostFunction(
-                  options_.acceleration_weight() /
-                      common::ToSeconds(first_duration + second_duration),
-                  delta_velocity, common::ToSeconds(first_duration),
-                  common::ToSeconds(second_duration)),
+              use_analytical_jacobians
+                  ? AccelerationCostFunction3D::CreateAnalyticalCostFunction(
+                        acceleration_scaling_factor, delta_velocity,
+                        common::ToSeconds(first_duration),
+                        common::ToSeconds(second_duration))
+                  : AccelerationCostFunction3D::CreateAutoDiffCostFunction(
+                        acceleration_scaling_factor, delta_velocity,
+                        common::ToSeconds(first_duration),
+                        common::ToSeconds(second_duration)),
               nullptr /* loss function */,
               C_nodes.at(second_node_id).rotation(),
               C_nodes.at(first_node_id).translation(),
@@ -433,10 +489,14 @@ void OptimizationProblem3D::Solve(
               &trajectory_data.gravity_constant,
               trajectory_data.imu_calibration.data());
         }
+        const double rotation_scaling_factor =
+            options_.rotation_weight() / common::ToSeconds(first_duration);
         problem.AddResidualBlock(
-            RotationCostFunction3D::CreateAutoDiffCostFunction(
-                options_.rotation_weight() / common::ToSeconds(first_duration),
-                result.delta_rotation),
+            use_analytical_jacobians
+                ? RotationCostFunction3D::CreateAnalyticalCostFunction(
+                      rotation_scaling_factor, result.delta_rotation)
+                : RotationCostFunction3D::CreateAutoDiffCostFunction(
+                      rotation_scaling_factor, result.delta_rotation),
             nullptr /* loss function */, C_nodes.at(first_node_id).rotation(),
             C_nodes.at(second_node_id).rotation(),
             trajectory_data.imu_calibration.data());
@@ -476,7 +536,7 @@ void OptimizationProblem3D::Solve(
                                           second_node_data);
         if (relative_odometry != nullptr) {
           problem.AddResidualBlock(
-              SpaCostFunction3D::CreateAutoDiffCostFunction(Constraint::Pose{
+              create_spa_cost_function(Constraint::Pose{
                   *relative_odometry, options_.odometry_translation_weight(),
                   options_.odometry_rotation_weight()}),
               nullptr /* loss function */, C_nodes.at(first_node_id).rotation(),
@@ -489,7 +549,7 @@ void OptimizationProblem3D::Solve(
         const transform::Rigid3d relative_local_slam_pose =
             first_node_data.local_pose.inverse() * second_node_data.local_pose;
         problem.AddResidualBlock(
-            SpaCostFunction3D::CreateAutoDiffCostFunction(
+            create_spa_cost_function(
                 Constraint::Pose{relative_local_slam_pose,
                                  options_.local_slam_pose_translation_weight(),
                                  options_.local_slam_pose_rotation_weight()}),
@@ -552,7 +612,7 @@ void OptimizationProblem3D::Solve(
       }
 
       problem.AddResidualBlock(
-          SpaCostFunction3D::CreateAutoDiffCostFunction(constraint_pose),
+          create_spa_cost_function(constraint_pose),
           options_.fixed_frame_pose_use_tolerant_loss() ?
               new ceres::TolerantLoss(
             options_.fixed_frame_pose_tolerant_loss_param_a(),
@@ -567,6 +627,11 @@ void OptimizationProblem3D::Solve(
   ceres::Solve(
       common::CreateCeresSolverOptions(options_.ceres_solver_options()),
       &problem, &summary);
+  last_solve_summary_.num_iterations =
+      summary.num_successful_steps + summary.num_unsuccessful_steps;
+  last_solve_summary_.final_cost = summary.final_cost;
+  last_solve_summary_.converged =
+      summary.termination_type == ceres::CONVERGENCE;
   if (options_.log_solver_summary()) {
     LOG(INFO) << summary.FullReport();
     for (const auto& trajectory_id_and_data : trajectory_data_) {
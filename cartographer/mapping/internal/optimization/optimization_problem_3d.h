@@ -28,6 +28,8 @@
 #include "cartographer/common/port.h"
 #include "cartographer/common/time.h"
 #include "cartographer/mapping/id.h"
+#include "cartographer/mapping/internal/3d/imu_aggregator.h"
+#include "cartographer/mapping/internal/3d/imu_preintegration.h"
 #include "cartographer/mapping/internal/optimization/optimization_problem_interface.h"
 #include "cartographer/mapping/pose_graph_interface.h"
 #include "cartographer/mapping/proto/pose_graph/optimization_problem_options.pb.h"
@@ -82,6 +84,9 @@ class OptimizationProblem3D
       const std::map<int, PoseGraphInterface::TrajectoryState>&
           trajectories_state,
       const std::map<std::string, LandmarkNode>& landmark_nodes) override;
+  const SolveSummary& last_solve_summary() const override {
+    return last_solve_summary_;
+  }
 
   const MapById<NodeId, NodeSpec3D>& node_data() const override {
     return node_data_;
@@ -121,12 +126,19 @@ class OptimizationProblem3D
   std::unique_ptr<transform::Rigid3d> CalculateOdometryBetweenNodes(
       int trajectory_id, const NodeSpec3D& first_node_data,
       const NodeSpec3D& second_node_data) const;
+  void AppendImuData(int trajectory_id, const sensor::ImuData& imu_data);
 
   optimization::proto::OptimizationProblemOptions options_;
+  SolveSummary last_solve_summary_;
   MapById<NodeId, NodeSpec3D> node_data_;
   MapById<SubmapId, SubmapSpec3D> submap_data_;
   std::map<std::string, transform::Rigid3d> landmark_data_;
   sensor::MapByTime<sensor::ImuData> imu_data_;
+  // Integrals of 'imu_data_' per trajectory. Removed when IMU data gets
+  // trimmed and rebuilt when needed.
+  std::map<int, ImuPreintegration> imu_preintegrations_;
+  // Used per trajectory if 'imu_aggregation_duration_in_3d' is positive.
+  std::map<int, ImuAggregator> imu_aggregators_;
   sensor::MapByTime<sensor::OdometryData> odometry_data_;
   sensor::MapByTime<sensor::FixedFramePoseData> fixed_frame_pose_data_;
   std::map<int, PoseGraphInterface::TrajectoryData> trajectory_data_;
@@ -54,10 +54,18 @@ class OptimizationProblem3DTest : public ::testing::Test {
           log_solver_summary = true,
           use_online_imu_extrinsics_in_3d = true,
           fix_z_in_3d = false,
+          incremental_optimization_num_hops = 0,
+          incremental_optimization_radius = 0.,
+          full_optimization_every_n_optimizations = 0,
+          eliminate_submaps_first = false,
+          use_analytical_jacobians_in_3d = false,
+          imu_aggregation_duration_in_3d = 0.,
           ceres_solver_options = {
             use_nonmonotonic_steps = false,
             max_num_iterations = 200,
             num_threads = 4,
+            linear_solver_type = "",
+            sparse_linear_algebra_library_type = "",
           },
         })text");
     return optimization::CreateOptimizationProblemOptions(
@@ -35,6 +35,15 @@ namespace cartographer {
 namespace mapping {
 namespace optimization {
 
+// Outcome of the last call to 'Solve'.
+struct SolveSummary {
+  int num_iterations = 0;
+  double final_cost = 0.;
+  // False if the solver stopped because it reached the maximum number of
+  // iterations.
+  bool converged = false;
+};
+
 // Implements the SPA loop closure method.
 template <typename NodeDataType, typename SubmapDataType,
           typename RigidTransformType>
@@ -72,6 +81,7 @@ class OptimizationProblemInterface {
       const std::map<int, PoseGraphInterface::TrajectoryState>&
           trajectories_state,
       const std::map<std::string, LandmarkNode>& landmark_nodes) = 0;
+  virtual const SolveSummary& last_solve_summary() const = 0;
 
   virtual const MapById<NodeId, NodeDataType>& node_data() const = 0;
   virtual const MapById<SubmapId, SubmapDataType>& submap_data() const = 0;
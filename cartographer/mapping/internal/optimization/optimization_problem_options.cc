@@ -53,6 +53,20 @@ proto::OptimizationProblemOptions CreateOptimizationProblemOptions(
   options.set_use_online_imu_extrinsics_in_3d(
       parameter_dictionary->GetBool("use_online_imu_extrinsics_in_3d"));
   options.set_fix_z_in_3d(parameter_dictionary->GetBool("fix_z_in_3d"));
+  options.set_incremental_optimization_num_hops(
+      parameter_dictionary->GetNonNegativeInt(
+          "incremental_optimization_num_hops"));
+  options.set_incremental_optimization_radius(
+      parameter_dictionary->GetDouble("incremental_optimization_radius"));
+  options.set_full_optimization_every_n_optimizations(
+      parameter_dictionary->GetNonNegativeInt(
+          "full_optimization_every_n_optimizations"));
+  options.set_eliminate_submaps_first(
+      parameter_dictionary->GetBool("eliminate_submaps_first"));
+  options.set_use_analytical_jacobians_in_3d(
+      parameter_dictionary->GetBool("use_analytical_jacobians_in_3d"));
+  options.set_imu_aggregation_duration_in_3d(
+      parameter_dictionary->GetDouble("imu_aggregation_duration_in_3d"));
   *options.mutable_ceres_solver_options() =
       common::CreateCeresSolverOptionsProto(
           parameter_dictionary->GetDictionary("ceres_solver_options").get());
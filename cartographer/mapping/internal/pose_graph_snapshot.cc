@@ -0,0 +1,164 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/pose_graph_snapshot.h"
+
+namespace cartographer {
+namespace mapping {
+
+PoseGraphSnapshot::PoseGraphSnapshot()
+    : published_(std::make_shared<const Published>(Published{
+          {},
+          {},
+          {},
+          PoseGraphInterface::ConstraintsSnapshot{
+              0, std::make_shared<
+                     const std::vector<PoseGraphInterface::Constraint>>()}})) {
+}
+
+void PoseGraphSnapshot::Publish(
+    MapById<NodeId, TrajectoryNodePose> trajectory_node_poses,
+    MapById<SubmapId, SubmapEntry> submaps,
+    std::map<int, transform::Rigid3d> local_to_global_transforms,
+    std::vector<PoseGraphInterface::Constraint> constraints) {
+  auto shared_constraints =
+      std::make_shared<const std::vector<PoseGraphInterface::Constraint>>(
+          std::move(constraints));
+  std::shared_ptr<const Published> old_published;
+  {
+    absl::MutexLock locker(&mutex_);
+    // The version is assigned under the lock, so that it increases in the
+    // order in which snapshots are published.
+    auto published = std::make_shared<const Published>(Published{
+        std::move(trajectory_node_poses), std::move(submaps),
+        std::move(local_to_global_transforms),
+        PoseGraphInterface::ConstraintsSnapshot{
+            ++num_published_, std::move(shared_constraints)}});
+    old_published = std::move(published_);
+    published_ = std::move(published);
+    added_nodes_.clear();
+    added_submaps_.clear();
+    invalidated_trajectory_ids_.clear();
+  }
+  // 'old_published' is destroyed here, outside of the lock, unless a reader
+  // still uses it.
+}
+
+void PoseGraphSnapshot::AddNode(const NodeId& node_id,
+                                const TrajectoryNodePose& node_pose) {
+  absl::MutexLock locker(&mutex_);
+  added_nodes_.emplace_back(node_id, node_pose);
+}
+
+void PoseGraphSnapshot::AddSubmap(const SubmapId& submap_id,
+                                  const SubmapEntry& submap_entry) {
+  absl::MutexLock locker(&mutex_);
+  added_submaps_.emplace_back(submap_id, submap_entry);
+}
+
+void PoseGraphSnapshot::InvalidateLocalToGlobalTransform(
+    const int trajectory_id) {
+  absl::MutexLock locker(&mutex_);
+  invalidated_trajectory_ids_.insert(trajectory_id);
+}
+
+MapById<NodeId, TrajectoryNodePose> PoseGraphSnapshot::GetTrajectoryNodePoses()
+    const {
+  std::shared_ptr<const Published> published;
+  std::vector<std::pair<NodeId, TrajectoryNodePose>> added_nodes;
+  {
+    absl::MutexLock locker(&mutex_);
+    published = published_;
+    added_nodes = added_nodes_;
+  }
+  MapById<NodeId, TrajectoryNodePose> trajectory_node_poses =
+      published->trajectory_node_poses;
+  for (const auto& node : added_nodes) {
+    trajectory_node_poses.Insert(node.first, node.second);
+  }
+  return trajectory_node_poses;
+}
+
+MapById<SubmapId, PoseGraphInterface::SubmapPose>
+PoseGraphSnapshot::GetAllSubmapPoses(
+    const std::function<transform::Rigid3d(int)>&
+        compute_local_to_global_transform) const {
+  std::shared_ptr<const Published> published;
+  std::vector<std::pair<SubmapId, SubmapEntry>> added_submaps;
+  std::set<int> invalidated_trajectory_ids;
+  {
+    absl::MutexLock locker(&mutex_);
+    published = published_;
+    added_submaps = added_submaps_;
+    invalidated_trajectory_ids = invalidated_trajectory_ids_;
+  }
+  std::map<int, transform::Rigid3d> local_to_global_transforms;
+  for (const auto& entry : published->local_to_global_transforms) {
+    if (invalidated_trajectory_ids.count(entry.first) == 0) {
+      local_to_global_transforms.insert(entry);
+    }
+  }
+  MapById<SubmapId, PoseGraphInterface::SubmapPose> submap_poses;
+  const auto add_submap_pose = [&](const SubmapId& submap_id,
+                                   const SubmapEntry& submap_entry) {
+    transform::Rigid3d pose;
+    if (submap_entry.global_pose.has_value()) {
+      pose = submap_entry.global_pose.value();
+    } else {
+      auto it = local_to_global_transforms.find(submap_id.trajectory_id);
+      if (it == local_to_global_transforms.end()) {
+        it = local_to_global_transforms
+                 .emplace(submap_id.trajectory_id,
+                          compute_local_to_global_transform(
+                              submap_id.trajectory_id))
+                 .first;
+      }
+      pose = it->second * submap_entry.submap->local_pose();
+    }
+    submap_poses.Insert(
+        submap_id, PoseGraphInterface::SubmapPose{
+                       submap_entry.submap->num_range_data(), pose});
+  };
+  for (const auto& submap_id_data : published->submaps) {
+    add_submap_pose(submap_id_data.id, submap_id_data.data);
+  }
+  for (const auto& submap : added_submaps) {
+    add_submap_pose(submap.first, submap.second);
+  }
+  return submap_poses;
+}
+
+absl::optional<transform::Rigid3d> PoseGraphSnapshot::GetLocalToGlobalTransform(
+    const int trajectory_id) const {
+  absl::MutexLock locker(&mutex_);
+  if (invalidated_trajectory_ids_.count(trajectory_id) != 0) {
+    return absl::nullopt;
+  }
+  const auto it = published_->local_to_global_transforms.find(trajectory_id);
+  if (it == published_->local_to_global_transforms.end()) {
+    return absl::nullopt;
+  }
+  return it->second;
+}
+
+PoseGraphInterface::ConstraintsSnapshot PoseGraphSnapshot::GetConstraints()
+    const {
+  absl::MutexLock locker(&mutex_);
+  return published_->constraints;
+}
+
+}  // namespace mapping
+}  // namespace cartographer
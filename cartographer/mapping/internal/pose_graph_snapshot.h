@@ -0,0 +1,123 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_MAPPING_INTERNAL_POSE_GRAPH_SNAPSHOT_H_
+#define CARTOGRAPHER_MAPPING_INTERNAL_POSE_GRAPH_SNAPSHOT_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
+#include "cartographer/mapping/id.h"
+#include "cartographer/mapping/pose_graph_interface.h"
+#include "cartographer/mapping/submaps.h"
+#include "cartographer/transform/rigid_transform.h"
+
+namespace cartographer {
+namespace mapping {
+
+// Poses of a pose graph which can be read without taking the mutex of the
+// pose graph, so that readers do not block global SLAM and vice versa.
+//
+// The pose graph publishes a complete snapshot whenever optimization or
+// trimming changed the poses. Nodes and submaps added in between are appended
+// to the published snapshot, which is cheap since there are only few of them.
+// Readers copy the shared pointer to the published snapshot and the appended
+// entries while holding a mutex which writers only take briefly, the copy of
+// the published snapshot is made without holding a lock.
+//
+// This class is thread-safe.
+class PoseGraphSnapshot {
+ public:
+  struct SubmapEntry {
+    std::shared_ptr<const Submap> submap;
+    // Unset if the submap is not optimized yet.
+    absl::optional<transform::Rigid3d> global_pose;
+  };
+
+  PoseGraphSnapshot();
+
+  PoseGraphSnapshot(const PoseGraphSnapshot&) = delete;
+  PoseGraphSnapshot& operator=(const PoseGraphSnapshot&) = delete;
+
+  // Replaces the snapshot. 'local_to_global_transforms' must only contain
+  // trajectories whose transform only changes with the optimized submap
+  // poses.
+  void Publish(MapById<NodeId, TrajectoryNodePose> trajectory_node_poses,
+               MapById<SubmapId, SubmapEntry> submaps,
+               std::map<int, transform::Rigid3d> local_to_global_transforms,
+               std::vector<PoseGraphInterface::Constraint> constraints)
+      LOCKS_EXCLUDED(mutex_);
+
+  // Adds a node or submap which is not in the published snapshot yet.
+  void AddNode(const NodeId& node_id, const TrajectoryNodePose& node_pose)
+      LOCKS_EXCLUDED(mutex_);
+  void AddSubmap(const SubmapId& submap_id, const SubmapEntry& submap_entry)
+      LOCKS_EXCLUDED(mutex_);
+
+  // Marks the local to global transform of 'trajectory_id' as unknown until
+  // the next snapshot is published.
+  void InvalidateLocalToGlobalTransform(int trajectory_id)
+      LOCKS_EXCLUDED(mutex_);
+
+  MapById<NodeId, TrajectoryNodePose> GetTrajectoryNodePoses() const
+      LOCKS_EXCLUDED(mutex_);
+
+  // Returns the global poses of all submaps. Submaps which are not optimized
+  // yet are extrapolated with the local to global transform of their
+  // trajectory, which 'compute_local_to_global_transform' is called for if
+  // the snapshot does not know it.
+  MapById<SubmapId, PoseGraphInterface::SubmapPose> GetAllSubmapPoses(
+      const std::function<transform::Rigid3d(int)>&
+          compute_local_to_global_transform) const LOCKS_EXCLUDED(mutex_);
+
+  // Returns the local to global transform of 'trajectory_id' if the snapshot
+  // knows it.
+  absl::optional<transform::Rigid3d> GetLocalToGlobalTransform(
+      int trajectory_id) const LOCKS_EXCLUDED(mutex_);
+
+  // Returns the published constraints. Nothing is appended to these between
+  // publications.
+  PoseGraphInterface::ConstraintsSnapshot GetConstraints() const
+      LOCKS_EXCLUDED(mutex_);
+
+ private:
+  struct Published {
+    MapById<NodeId, TrajectoryNodePose> trajectory_node_poses;
+    MapById<SubmapId, SubmapEntry> submaps;
+    std::map<int, transform::Rigid3d> local_to_global_transforms;
+    PoseGraphInterface::ConstraintsSnapshot constraints;
+  };
+
+  mutable absl::Mutex mutex_;
+  std::shared_ptr<const Published> published_ GUARDED_BY(mutex_);
+  int64 num_published_ GUARDED_BY(mutex_) = 0;
+  std::vector<std::pair<NodeId, TrajectoryNodePose>> added_nodes_
+      GUARDED_BY(mutex_);
+  std::vector<std::pair<SubmapId, SubmapEntry>> added_submaps_
+      GUARDED_BY(mutex_);
+  std::set<int> invalidated_trajectory_ids_ GUARDED_BY(mutex_);
+};
+
+}  // namespace mapping
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_MAPPING_INTERNAL_POSE_GRAPH_SNAPSHOT_H_
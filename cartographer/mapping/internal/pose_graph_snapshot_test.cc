@@ -0,0 +1,145 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/pose_graph_snapshot.h"
+
+#include "cartographer/transform/rigid_transform_test_helpers.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+class FakeSubmap : public Submap {
+ public:
+  explicit FakeSubmap(const transform::Rigid3d& local_submap_pose)
+      : Submap(local_submap_pose) {}
+
+  proto::Submap ToProto(bool include_grid_data) const override {
+    return proto::Submap();
+  }
+  void UpdateFromProto(const proto::Submap& proto) override {}
+  void ToResponseProto(
+      const transform::Rigid3d& global_submap_pose,
+      proto::SubmapQuery::Response* response) const override {}
+};
+
+TrajectoryNodePose MakeNodePose(const transform::Rigid3d& global_pose) {
+  return TrajectoryNodePose{
+      global_pose, TrajectoryNodePose::ConstantPoseData{
+                       common::FromUniversal(0), transform::Rigid3d()}};
+}
+
+TEST(PoseGraphSnapshotTest, AddedNodesAreVisibleUntilPublish) {
+  PoseGraphSnapshot snapshot;
+  EXPECT_TRUE(snapshot.GetTrajectoryNodePoses().empty());
+  const transform::Rigid3d pose = transform::Rigid3d::Translation({1., 2., 3.});
+  snapshot.AddNode(NodeId{0, 0}, MakeNodePose(pose));
+  snapshot.AddNode(NodeId{0, 1}, MakeNodePose(pose));
+  auto node_poses = snapshot.GetTrajectoryNodePoses();
+  EXPECT_EQ(node_poses.size(), 2);
+  EXPECT_THAT(node_poses.at(NodeId{0, 1}).global_pose,
+              transform::IsNearly(pose, 1e-9));
+
+  MapById<NodeId, TrajectoryNodePose> published_node_poses;
+  published_node_poses.Insert(NodeId{0, 0},
+                              MakeNodePose(transform::Rigid3d::Identity()));
+  snapshot.Publish(std::move(published_node_poses), {}, {}, {});
+  node_poses = snapshot.GetTrajectoryNodePoses();
+  EXPECT_EQ(node_poses.size(), 1);
+  EXPECT_THAT(node_poses.at(NodeId{0, 0}).global_pose,
+              transform::IsNearly(transform::Rigid3d::Identity(), 1e-9));
+}
+
+TEST(PoseGraphSnapshotTest, SubmapPoses) {
+  PoseGraphSnapshot snapshot;
+  const transform::Rigid3d local_pose =
+      transform::Rigid3d::Translation({1., 0., 0.});
+  const transform::Rigid3d optimized_pose =
+      transform::Rigid3d::Translation({0., 5., 0.});
+  const transform::Rigid3d local_to_global =
+      transform::Rigid3d::Translation({0., 0., 7.});
+  const auto submap = std::make_shared<FakeSubmap>(local_pose);
+  submap->set_num_range_data(3);
+  MapById<SubmapId, PoseGraphSnapshot::SubmapEntry> submaps;
+  submaps.Insert(SubmapId{0, 0},
+                 PoseGraphSnapshot::SubmapEntry{submap, optimized_pose});
+  submaps.Insert(SubmapId{0, 1}, PoseGraphSnapshot::SubmapEntry{submap, {}});
+  snapshot.Publish({}, std::move(submaps), {{0, local_to_global}}, {});
+  snapshot.AddSubmap(SubmapId{1, 0},
+                     PoseGraphSnapshot::SubmapEntry{submap, {}});
+
+  std::vector<int> computed_trajectory_ids;
+  const auto compute_local_to_global_transform =
+      [&computed_trajectory_ids](const int trajectory_id) {
+        computed_trajectory_ids.push_back(trajectory_id);
+        return transform::Rigid3d::Identity();
+      };
+  auto submap_poses =
+      snapshot.GetAllSubmapPoses(compute_local_to_global_transform);
+  EXPECT_EQ(submap_poses.size(), 3);
+  EXPECT_EQ(submap_poses.at(SubmapId{0, 0}).version, 3);
+  EXPECT_THAT(submap_poses.at(SubmapId{0, 0}).pose,
+              transform::IsNearly(optimized_pose, 1e-9));
+  EXPECT_THAT(submap_poses.at(SubmapId{0, 1}).pose,
+              transform::IsNearly(local_to_global * local_pose, 1e-9));
+  EXPECT_THAT(submap_poses.at(SubmapId{1, 0}).pose,
+              transform::IsNearly(local_pose, 1e-9));
+  EXPECT_EQ(computed_trajectory_ids, std::vector<int>{1});
+
+  ASSERT_TRUE(snapshot.GetLocalToGlobalTransform(0).has_value());
+  EXPECT_THAT(snapshot.GetLocalToGlobalTransform(0).value(),
+              transform::IsNearly(local_to_global, 1e-9));
+  EXPECT_FALSE(snapshot.GetLocalToGlobalTransform(1).has_value());
+
+  snapshot.InvalidateLocalToGlobalTransform(0);
+  EXPECT_FALSE(snapshot.GetLocalToGlobalTransform(0).has_value());
+  computed_trajectory_ids.clear();
+  submap_poses = snapshot.GetAllSubmapPoses(compute_local_to_global_transform);
+  EXPECT_THAT(submap_poses.at(SubmapId{0, 1}).pose,
+              transform::IsNearly(local_pose, 1e-9));
+  EXPECT_EQ(computed_trajectory_ids, (std::vector<int>{0, 1}));
+}
+
+TEST(PoseGraphSnapshotTest, ConstraintsAreVersioned) {
+  PoseGraphSnapshot snapshot;
+  const PoseGraphInterface::ConstraintsSnapshot initial =
+      snapshot.GetConstraints();
+  EXPECT_EQ(initial.version, 0);
+  EXPECT_TRUE(initial.constraints->empty());
+
+  const PoseGraphInterface::Constraint constraint{
+      SubmapId{0, 0},
+      NodeId{0, 1},
+      {transform::Rigid3d::Identity(), 1., 2.},
+      PoseGraphInterface::Constraint::INTER_SUBMAP};
+  snapshot.Publish({}, {}, {}, {constraint});
+  const PoseGraphInterface::ConstraintsSnapshot first =
+      snapshot.GetConstraints();
+  EXPECT_EQ(first.version, 1);
+  ASSERT_EQ(first.constraints->size(), 1);
+  EXPECT_EQ(first.constraints->front().node_id, (NodeId{0, 1}));
+
+  snapshot.Publish({}, {}, {}, {constraint, constraint});
+  EXPECT_EQ(snapshot.GetConstraints().version, 2);
+  EXPECT_EQ(snapshot.GetConstraints().constraints->size(), 2);
+  // Readers holding an older snapshot keep seeing it unchanged.
+  EXPECT_EQ(first.constraints->size(), 1);
+}
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
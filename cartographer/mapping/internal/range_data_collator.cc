@@ -16,10 +16,13 @@
 
 #include "cartographer/mapping/internal/range_data_collator.h"
 
+#include <algorithm>
 #include <memory>
+#include <utility>
 
 #include "absl/memory/memory.h"
 #include "cartographer/mapping/local_slam_result_data.h"
+#include "cartographer/sensor/timed_point_cloud_pool.h"
 #include "glog/logging.h"
 
 namespace cartographer {
@@ -30,7 +33,20 @@ constexpr float RangeDataCollator::kDefaultIntensityValue;
 sensor::TimedPointCloudOriginData RangeDataCollator::AddRangeData(
     const std::string& sensor_id,
     sensor::TimedPointCloudData timed_point_cloud_data) {
+  sensor::TimedPointCloudOriginData result;
+  AddRangeData(sensor_id, std::move(timed_point_cloud_data), &result);
+  return result;
+}
+
+void RangeDataCollator::AddRangeData(
+    const std::string& sensor_id,
+    sensor::TimedPointCloudData timed_point_cloud_data,
+    sensor::TimedPointCloudOriginData* const result) {
   CHECK_NE(expected_sensor_ids_.count(sensor_id), 0);
+  if (timed_point_cloud_data.intensities.empty()) {
+    timed_point_cloud_data.intensities =
+        sensor::TimedPointCloudPool::Get()->AcquireIntensities();
+  }
   timed_point_cloud_data.intensities.resize(
       timed_point_cloud_data.ranges.size(), kDefaultIntensityValue);
   // TODO(gaschler): These two cases can probably be one.
@@ -38,95 +54,178 @@ sensor::TimedPointCloudOriginData RangeDataCollator::AddRangeData(
     current_start_ = current_end_;
     // When we have two messages of the same sensor, move forward the older of
     // the two (do not send out current).
-    current_end_ = id_to_pending_data_.at(sensor_id).time;
-    auto result = CropAndMerge();
-    id_to_pending_data_.emplace(sensor_id, std::move(timed_point_cloud_data));
-    return result;
+    current_end_ = id_to_pending_data_.at(sensor_id).data.time;
+    CropAndMerge(result);
+    id_to_pending_data_.emplace(sensor_id,
+                                PendingData{std::move(timed_point_cloud_data)});
+    return;
   }
-  id_to_pending_data_.emplace(sensor_id, std::move(timed_point_cloud_data));
+  id_to_pending_data_.emplace(sensor_id,
+                              PendingData{std::move(timed_point_cloud_data)});
   if (expected_sensor_ids_.size() != id_to_pending_data_.size()) {
-    return {};
+    result->time = common::Time();
+    result->origins.clear();
+    result->ranges.clear();
+    return;
   }
   current_start_ = current_end_;
   // We have messages from all sensors, move forward to oldest.
   common::Time oldest_timestamp = common::Time::max();
   for (const auto& pair : id_to_pending_data_) {
-    oldest_timestamp = std::min(oldest_timestamp, pair.second.time);
+    oldest_timestamp = std::min(oldest_timestamp, pair.second.data.time);
   }
   current_end_ = oldest_timestamp;
-  return CropAndMerge();
+  CropAndMerge(result);
 }
 
-sensor::TimedPointCloudOriginData RangeDataCollator::CropAndMerge() {
-  sensor::TimedPointCloudOriginData result{current_end_, {}, {}};
+void RangeDataCollator::CropAndMerge(
+    sensor::TimedPointCloudOriginData* const result) {
+  result->time = current_end_;
+  result->origins.clear();
+  result->ranges.clear();
+  segments_.clear();
+  size_t num_overlapping_points = 0;
   bool warned_for_dropped_points = false;
-  for (auto it = id_to_pending_data_.begin();
-       it != id_to_pending_data_.end();) {
-    sensor::TimedPointCloudData& data = it->second;
-    const sensor::TimedPointCloud& ranges = it->second.ranges;
-    const std::vector<float>& intensities = it->second.intensities;
+  for (auto& entry : id_to_pending_data_) {
+    PendingData& pending_data = entry.second;
+    const sensor::TimedPointCloudData& data = pending_data.data;
+    const sensor::TimedPointCloud& ranges = data.ranges;
 
-    auto overlap_begin = ranges.begin();
-    while (overlap_begin < ranges.end() &&
-           data.time + common::FromSeconds((*overlap_begin).time) <
+    size_t overlap_begin = pending_data.num_consumed;
+    while (overlap_begin < ranges.size() &&
+           data.time + common::FromSeconds(ranges[overlap_begin].time) <
                current_start_) {
       ++overlap_begin;
     }
-    auto overlap_end = overlap_begin;
-    while (overlap_end < ranges.end() &&
-           data.time + common::FromSeconds((*overlap_end).time) <=
+    size_t overlap_end = overlap_begin;
+    while (overlap_end < ranges.size() &&
+           data.time + common::FromSeconds(ranges[overlap_end].time) <=
                current_end_) {
       ++overlap_end;
     }
-    if (ranges.begin() < overlap_begin && !warned_for_dropped_points) {
-      LOG(WARNING) << "Dropped " << std::distance(ranges.begin(), overlap_begin)
+    if (pending_data.num_consumed < overlap_begin &&
+        !warned_for_dropped_points) {
+      LOG(WARNING) << "Dropped " << overlap_begin - pending_data.num_consumed
                    << " earlier points.";
       warned_for_dropped_points = true;
     }
 
-    // Copy overlapping range.
     if (overlap_begin < overlap_end) {
-      std::size_t origin_index = result.origins.size();
-      result.origins.push_back(data.origin);
-      const float time_correction =
-          static_cast<float>(common::ToSeconds(data.time - current_end_));
-      auto intensities_overlap_it =
-          intensities.begin() + (overlap_begin - ranges.begin());
-      result.ranges.reserve(result.ranges.size() +
-                            std::distance(overlap_begin, overlap_end));
-      for (auto overlap_it = overlap_begin; overlap_it != overlap_end;
-           ++overlap_it, ++intensities_overlap_it) {
-        sensor::TimedPointCloudOriginData::RangeMeasurement point{
-            *overlap_it, *intensities_overlap_it, origin_index};
-        // current_end_ + point_time[3]_after == in_timestamp +
-        // point_time[3]_before
-        point.point_time.time += time_correction;
-        result.ranges.push_back(point);
-      }
+      // current_end_ + point_time[3]_after == in_timestamp +
+      // point_time[3]_before
+      segments_.push_back(Segment{
+          &pending_data, overlap_begin, overlap_end, result->origins.size(),
+          static_cast<float>(common::ToSeconds(data.time - current_end_))});
+      result->origins.push_back(data.origin);
+      num_overlapping_points += overlap_end - overlap_begin;
     }
+    // Points until 'overlap_end' are never looked at again.
+    pending_data.num_consumed = overlap_end;
+  }
 
-    // Drop buffered points until overlap_end.
-    if (overlap_end == ranges.end()) {
+  result->ranges.reserve(num_overlapping_points);
+  Merge(result);
+
+  // Drop fully consumed messages and recycle their storage.
+  for (auto it = id_to_pending_data_.begin();
+       it != id_to_pending_data_.end();) {
+    if (it->second.num_consumed == it->second.data.ranges.size()) {
+      sensor::TimedPointCloudPool::Get()->Recycle(std::move(it->second.data));
       it = id_to_pending_data_.erase(it);
-    } else if (overlap_end == ranges.begin()) {
-      ++it;
     } else {
-      const auto intensities_overlap_end =
-          intensities.begin() + (overlap_end - ranges.begin());
-      data = sensor::TimedPointCloudData{
-          data.time, data.origin,
-          sensor::TimedPointCloud(overlap_end, ranges.end()),
-          std::vector<float>(intensities_overlap_end, intensities.end())};
       ++it;
     }
   }
+}
 
-  std::sort(result.ranges.begin(), result.ranges.end(),
-            [](const sensor::TimedPointCloudOriginData::RangeMeasurement& a,
-               const sensor::TimedPointCloudOriginData::RangeMeasurement& b) {
-              return a.point_time.time < b.point_time.time;
+// Appends the points of all 'segments_' to 'result' sorted by time. Points of
+// each message are already sorted, so only overlapping segments need to be
+// merged. Ties are broken by segment, as a stable sort would.
+void RangeDataCollator::Merge(sensor::TimedPointCloudOriginData* const result) {
+  if (!AppendDisjointSegments(result)) {
+    MergeOverlappingSegments(result);
+  }
+  const auto earlier =
+      [](const sensor::TimedPointCloudOriginData::RangeMeasurement& a,
+         const sensor::TimedPointCloudOriginData::RangeMeasurement& b) {
+        return a.point_time.time < b.point_time.time;
+      };
+  if (!std::is_sorted(result->ranges.begin(), result->ranges.end(),
+                      earlier)) {
+    // Only happens if the points of a message were not sorted by time.
+    std::stable_sort(result->ranges.begin(), result->ranges.end(), earlier);
+  }
+}
+
+// If the time intervals of the segments do not overlap, as for a single sensor
+// or sensors taking turns, appends them one after the other and returns true.
+// Otherwise returns false without changing 'result'.
+bool RangeDataCollator::AppendDisjointSegments(
+    sensor::TimedPointCloudOriginData* const result) {
+  merge_heap_.clear();
+  for (size_t i = 0; i != segments_.size(); ++i) {
+    merge_heap_.push_back(i);
+  }
+  std::sort(merge_heap_.begin(), merge_heap_.end(),
+            [this](const size_t a, const size_t b) {
+              return GetCorrectedTime(segments_[a]) <
+                     GetCorrectedTime(segments_[b]);
             });
-  return result;
+  for (size_t i = 1; i < merge_heap_.size(); ++i) {
+    const Segment& previous = segments_[merge_heap_[i - 1]];
+    const float previous_end_time =
+        previous.pending_data->data.ranges[previous.end - 1].time +
+        previous.time_correction;
+    // Equal times are merged, so that ties are broken by segment.
+    if (previous_end_time >= GetCorrectedTime(segments_[merge_heap_[i]])) {
+      return false;
+    }
+  }
+  for (const size_t index : merge_heap_) {
+    const Segment& segment = segments_[index];
+    const sensor::TimedPointCloudData& data = segment.pending_data->data;
+    for (size_t i = segment.begin; i != segment.end; ++i) {
+      sensor::TimedPointCloudOriginData::RangeMeasurement point{
+          data.ranges[i], data.intensities[i], segment.origin_index};
+      point.point_time.time += segment.time_correction;
+      result->ranges.push_back(point);
+    }
+  }
+  return true;
+}
+
+void RangeDataCollator::MergeOverlappingSegments(
+    sensor::TimedPointCloudOriginData* const result) {
+  const auto comes_later = [this](const size_t a, const size_t b) {
+    const float a_time = GetCorrectedTime(segments_[a]);
+    const float b_time = GetCorrectedTime(segments_[b]);
+    return a_time > b_time || (a_time == b_time && a > b);
+  };
+  merge_heap_.clear();
+  for (size_t i = 0; i != segments_.size(); ++i) {
+    merge_heap_.push_back(i);
+  }
+  std::make_heap(merge_heap_.begin(), merge_heap_.end(), comes_later);
+  while (!merge_heap_.empty()) {
+    std::pop_heap(merge_heap_.begin(), merge_heap_.end(), comes_later);
+    Segment& segment = segments_[merge_heap_.back()];
+    const sensor::TimedPointCloudData& data = segment.pending_data->data;
+    sensor::TimedPointCloudOriginData::RangeMeasurement point{
+        data.ranges[segment.begin], data.intensities[segment.begin],
+        segment.origin_index};
+    point.point_time.time += segment.time_correction;
+    result->ranges.push_back(point);
+    if (++segment.begin == segment.end) {
+      merge_heap_.pop_back();
+    } else {
+      std::push_heap(merge_heap_.begin(), merge_heap_.end(), comes_later);
+    }
+  }
+}
+
+float RangeDataCollator::GetCorrectedTime(const Segment& segment) const {
+  return segment.pending_data->data.ranges[segment.begin].time +
+         segment.time_correction;
 }
 
 }  // namespace mapping
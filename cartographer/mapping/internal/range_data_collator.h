@@ -17,7 +17,11 @@
 #ifndef CARTOGRAPHER_MAPPING_INTERNAL_RANGE_DATA_COLLATOR_H_
 #define CARTOGRAPHER_MAPPING_INTERNAL_RANGE_DATA_COLLATOR_H_
 
+#include <map>
 #include <memory>
+#include <set>
+#include <string>
+#include <vector>
 
 #include "absl/memory/memory.h"
 #include "cartographer/sensor/timed_point_cloud_data.h"
@@ -29,7 +33,8 @@ namespace mapping {
 // monotonous in 'TimedPointCloudData::time', output is monotonous in per-point
 // timing. Up to one message per sensor is buffered, so a delay of the period of
 // the slowest sensor may be introduced, which can be alleviated by passing
-// subdivisions.
+// subdivisions. The storage of fully consumed messages is handed back to
+// 'sensor::TimedPointCloudPool' for reuse by the producers.
 class RangeDataCollator {
  public:
   explicit RangeDataCollator(
@@ -43,12 +48,40 @@ class RangeDataCollator {
       const std::string& sensor_id,
       sensor::TimedPointCloudData timed_point_cloud_data);
 
+  // Like above, but stores the result in 'result', reusing its storage.
+  void AddRangeData(const std::string& sensor_id,
+                    sensor::TimedPointCloudData timed_point_cloud_data,
+                    sensor::TimedPointCloudOriginData* result);
+
  private:
-  sensor::TimedPointCloudOriginData CropAndMerge();
+  struct PendingData {
+    sensor::TimedPointCloudData data;
+    // Number of leading points which have already been merged or dropped.
+    size_t num_consumed = 0;
+  };
+
+  // Points [begin, end) of one pending message which overlap the current
+  // interval.
+  struct Segment {
+    const PendingData* pending_data;
+    size_t begin;
+    size_t end;
+    size_t origin_index;
+    float time_correction;
+  };
+
+  void CropAndMerge(sensor::TimedPointCloudOriginData* result);
+  void Merge(sensor::TimedPointCloudOriginData* result);
+  bool AppendDisjointSegments(sensor::TimedPointCloudOriginData* result);
+  void MergeOverlappingSegments(sensor::TimedPointCloudOriginData* result);
+  float GetCorrectedTime(const Segment& segment) const;
 
   const std::set<std::string> expected_sensor_ids_;
   // Store at most one message for each sensor.
-  std::map<std::string, sensor::TimedPointCloudData> id_to_pending_data_;
+  std::map<std::string, PendingData> id_to_pending_data_;
+  // Reused between calls to avoid allocations.
+  std::vector<Segment> segments_;
+  std::vector<size_t> merge_heap_;
   common::Time current_start_ = common::Time::min();
   common::Time current_end_ = common::Time::min();
 
@@ -200,6 +200,34 @@ TEST(RangeDataCollatorTest, ThreeSensorsWithIntensities) {
   IntensitiesAreConsistent(output_3);
 }
 
+TEST(RangeDataCollatorTest, InterleavedSensorsIntoReusedResult) {
+  const std::string sensor_0 = "sensor_0";
+  const std::string sensor_1 = "sensor_1";
+  const std::string sensor_2 = "sensor_2";
+  RangeDataCollator collator({sensor_0, sensor_1, sensor_2});
+  sensor::TimedPointCloudOriginData output;
+  collator.AddRangeData(sensor_0, CreateFakeRangeData(100, 300, true), &output);
+  EXPECT_TRUE(output.ranges.empty());
+  collator.AddRangeData(sensor_1, CreateFakeRangeData(101, 301, true), &output);
+  EXPECT_TRUE(output.ranges.empty());
+  collator.AddRangeData(sensor_2, CreateFakeRangeData(102, 302, true), &output);
+  EXPECT_EQ(common::ToUniversal(output.time), 300);
+  EXPECT_EQ(output.origins.size(), 3);
+  ASSERT_EQ(output.ranges.size(), 3 * kNumSamples - 2);
+  EXPECT_TRUE(ArePointTimestampsSorted(output));
+  IntensitiesAreConsistent(output);
+  // Points of all three sensors alternate in time.
+  EXPECT_EQ(output.ranges[0].origin_index, 0);
+  EXPECT_EQ(output.ranges[1].origin_index, 1);
+  EXPECT_EQ(output.ranges[2].origin_index, 2);
+  const auto* const ranges_storage = output.ranges.data();
+  collator.AddRangeData(sensor_0, CreateFakeRangeData(300, 400, true), &output);
+  EXPECT_EQ(common::ToUniversal(output.time), 301);
+  EXPECT_EQ(output.ranges.size(), 2);
+  EXPECT_EQ(output.ranges.data(), ranges_storage);
+  EXPECT_TRUE(ArePointTimestampsSorted(output));
+}
+
 }  // namespace
 }  // namespace mapping
 }  // namespace cartographer
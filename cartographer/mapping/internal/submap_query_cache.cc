@@ -0,0 +1,89 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/submap_query_cache.h"
+
+#include <iterator>
+#include <utility>
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+bool IsSamePose(const transform::Rigid3d& a, const transform::Rigid3d& b) {
+  return a.translation() == b.translation() &&
+         a.rotation().coeffs() == b.rotation().coeffs();
+}
+
+}  // namespace
+
+SubmapQueryCache::SubmapQueryCache(const size_t max_size_in_bytes)
+    : max_size_in_bytes_(max_size_in_bytes) {}
+
+bool SubmapQueryCache::Get(const SubmapId& submap_id, const int submap_version,
+                           const transform::Rigid3d& global_submap_pose,
+                           proto::SubmapQuery::Response* const response) {
+  absl::MutexLock locker(&mutex_);
+  auto it = entry_by_submap_id_.find(submap_id);
+  if (it == entry_by_submap_id_.end() ||
+      it->second->submap_version != submap_version ||
+      !IsSamePose(it->second->global_submap_pose, global_submap_pose)) {
+    return false;
+  }
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return response->ParseFromString(it->second->serialized_response);
+}
+
+void SubmapQueryCache::Insert(const SubmapId& submap_id,
+                              const transform::Rigid3d& global_submap_pose,
+                              const proto::SubmapQuery::Response& response) {
+  std::string serialized_response;
+  response.SerializeToString(&serialized_response);
+  if (serialized_response.size() > max_size_in_bytes_) {
+    return;
+  }
+  absl::MutexLock locker(&mutex_);
+  auto it = entry_by_submap_id_.find(submap_id);
+  if (it != entry_by_submap_id_.end()) {
+    if (it->second->submap_version > response.submap_version()) {
+      // A newer version has been inserted concurrently.
+      return;
+    }
+    Erase(it->second);
+  }
+  size_in_bytes_ += serialized_response.size();
+  entries_.push_front(Entry{submap_id, response.submap_version(),
+                            global_submap_pose,
+                            std::move(serialized_response)});
+  entry_by_submap_id_[submap_id] = entries_.begin();
+  while (size_in_bytes_ > max_size_in_bytes_) {
+    Erase(std::prev(entries_.end()));
+  }
+}
+
+size_t SubmapQueryCache::size_in_bytes() const {
+  absl::MutexLock locker(&mutex_);
+  return size_in_bytes_;
+}
+
+void SubmapQueryCache::Erase(const std::list<Entry>::iterator it) {
+  size_in_bytes_ -= it->serialized_response.size();
+  entry_by_submap_id_.erase(it->submap_id);
+  entries_.erase(it);
+}
+
+}  // namespace mapping
+}  // namespace cartographer
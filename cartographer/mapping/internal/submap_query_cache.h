@@ -0,0 +1,84 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_MAPPING_INTERNAL_SUBMAP_QUERY_CACHE_H_
+#define CARTOGRAPHER_MAPPING_INTERNAL_SUBMAP_QUERY_CACHE_H_
+
+#include <list>
+#include <map>
+#include <string>
+
+#include "absl/synchronization/mutex.h"
+#include "cartographer/mapping/id.h"
+#include "cartographer/mapping/proto/submap_visualization.pb.h"
+#include "cartographer/transform/rigid_transform.h"
+
+namespace cartographer {
+namespace mapping {
+
+// Keeps serialized SubmapQuery::Responses so that repeated queries of an
+// unchanged submap do not have to crop, draw and compress its textures again.
+// At most one response is kept per submap, and the least recently used
+// responses are evicted once their total size exceeds 'max_size_in_bytes'.
+//
+// This class is thread-safe.
+class SubmapQueryCache {
+ public:
+  explicit SubmapQueryCache(size_t max_size_in_bytes);
+
+  SubmapQueryCache(const SubmapQueryCache&) = delete;
+  SubmapQueryCache& operator=(const SubmapQueryCache&) = delete;
+
+  // Fills 'response' and returns true if a response for 'submap_id' at
+  // 'submap_version' is cached. 'global_submap_pose' has to match as well, so
+  // callers whose responses do not depend on it should always pass the same
+  // pose.
+  bool Get(const SubmapId& submap_id, int submap_version,
+           const transform::Rigid3d& global_submap_pose,
+           proto::SubmapQuery::Response* response) LOCKS_EXCLUDED(mutex_);
+
+  // Stores 'response' for 'submap_id' at 'response.submap_version()',
+  // replacing any older response for that submap.
+  void Insert(const SubmapId& submap_id,
+              const transform::Rigid3d& global_submap_pose,
+              const proto::SubmapQuery::Response& response)
+      LOCKS_EXCLUDED(mutex_);
+
+  size_t size_in_bytes() const LOCKS_EXCLUDED(mutex_);
+
+ private:
+  struct Entry {
+    SubmapId submap_id;
+    int submap_version;
+    transform::Rigid3d global_submap_pose;
+    std::string serialized_response;
+  };
+
+  void Erase(std::list<Entry>::iterator it) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const size_t max_size_in_bytes_;
+  mutable absl::Mutex mutex_;
+  // Most recently used first.
+  std::list<Entry> entries_ GUARDED_BY(mutex_);
+  std::map<SubmapId, std::list<Entry>::iterator> entry_by_submap_id_
+      GUARDED_BY(mutex_);
+  size_t size_in_bytes_ GUARDED_BY(mutex_) = 0;
+};
+
+}  // namespace mapping
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_MAPPING_INTERNAL_SUBMAP_QUERY_CACHE_H_
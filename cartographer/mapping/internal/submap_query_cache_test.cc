@@ -0,0 +1,85 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/internal/submap_query_cache.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+proto::SubmapQuery::Response CreateResponse(int submap_version,
+                                            int num_cell_bytes) {
+  proto::SubmapQuery::Response response;
+  response.set_submap_version(submap_version);
+  auto* const texture = response.add_textures();
+  texture->set_cells(std::string(num_cell_bytes, 'x'));
+  texture->set_width(num_cell_bytes);
+  texture->set_height(1);
+  return response;
+}
+
+TEST(SubmapQueryCacheTest, ReturnsMatchingResponse) {
+  SubmapQueryCache cache(1 << 20);
+  const SubmapId submap_id{0, 1};
+  const transform::Rigid3d pose = transform::Rigid3d::Translation({1., 2., 3.});
+  cache.Insert(submap_id, pose, CreateResponse(5, 10));
+
+  proto::SubmapQuery::Response response;
+  EXPECT_FALSE(cache.Get(SubmapId{0, 2}, 5, pose, &response));
+  EXPECT_FALSE(cache.Get(submap_id, 6, pose, &response));
+  EXPECT_FALSE(
+      cache.Get(submap_id, 5, transform::Rigid3d::Identity(), &response));
+  ASSERT_TRUE(cache.Get(submap_id, 5, pose, &response));
+  EXPECT_EQ(5, response.submap_version());
+  ASSERT_EQ(1, response.textures_size());
+  EXPECT_EQ(10, response.textures(0).width());
+
+  // A newer version replaces the older one, but not the other way around.
+  cache.Insert(submap_id, pose, CreateResponse(6, 10));
+  cache.Insert(submap_id, pose, CreateResponse(5, 10));
+  EXPECT_FALSE(cache.Get(submap_id, 5, pose, &response));
+  EXPECT_TRUE(cache.Get(submap_id, 6, pose, &response));
+}
+
+TEST(SubmapQueryCacheTest, EvictsLeastRecentlyUsed) {
+  const size_t response_size = CreateResponse(1, 100).ByteSizeLong();
+  SubmapQueryCache cache(2 * response_size);
+  const transform::Rigid3d pose = transform::Rigid3d::Identity();
+  cache.Insert(SubmapId{0, 0}, pose, CreateResponse(1, 100));
+  cache.Insert(SubmapId{0, 1}, pose, CreateResponse(1, 100));
+  EXPECT_EQ(2 * response_size, cache.size_in_bytes());
+
+  proto::SubmapQuery::Response response;
+  EXPECT_TRUE(cache.Get(SubmapId{0, 0}, 1, pose, &response));
+  cache.Insert(SubmapId{0, 2}, pose, CreateResponse(1, 100));
+  EXPECT_EQ(2 * response_size, cache.size_in_bytes());
+  EXPECT_TRUE(cache.Get(SubmapId{0, 0}, 1, pose, &response));
+  EXPECT_FALSE(cache.Get(SubmapId{0, 1}, 1, pose, &response));
+  EXPECT_TRUE(cache.Get(SubmapId{0, 2}, 1, pose, &response));
+
+  // Responses larger than the whole cache are not kept.
+  cache.Insert(SubmapId{0, 3}, pose, CreateResponse(1, 1000));
+  EXPECT_FALSE(cache.Get(SubmapId{0, 3}, 1, pose, &response));
+  EXPECT_EQ(2 * response_size, cache.size_in_bytes());
+}
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
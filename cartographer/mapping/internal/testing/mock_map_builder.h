@@ -49,6 +49,7 @@ class MockMapBuilder : public mapping::MapBuilderInterface {
                            mapping::proto::SubmapQuery::Response *));
   MOCK_METHOD2(SerializeState, void(bool, io::ProtoStreamWriterInterface *));
   MOCK_METHOD2(SerializeStateToFile, bool(bool, const std::string &));
+  MOCK_METHOD2(WriteCheckpoint, bool(bool, const std::string &));
   MOCK_METHOD2(LoadState,
                std::map<int, int>(io::ProtoStreamReaderInterface *, bool));
   MOCK_METHOD2(LoadStateFromFile,
@@ -32,6 +32,7 @@ class MockPoseGraph : public mapping::PoseGraphInterface {
   ~MockPoseGraph() override = default;
 
   MOCK_METHOD0(RunFinalOptimization, void());
+  MOCK_METHOD1(RunFinalOptimizationAsync, void(FinalOptimizationCallback));
   MOCK_CONST_METHOD0(GetAllSubmapData,
                      mapping::MapById<mapping::SubmapId, SubmapData>());
   MOCK_CONST_METHOD1(GetSubmapData, SubmapData(const SubmapId&));
@@ -58,6 +59,7 @@ class MockPoseGraph : public mapping::PoseGraphInterface {
       GetTrajectoryData,
       std::map<int, mapping::PoseGraphInterface::TrajectoryData>());
   MOCK_CONST_METHOD0(constraints, std::vector<Constraint>());
+  MOCK_CONST_METHOD0(GetConstraintsSnapshot, ConstraintsSnapshot());
   MOCK_CONST_METHOD1(ToProto, mapping::proto::PoseGraph(bool));
   MOCK_METHOD1(SetGlobalSlamOptimizationCallback,
                void(GlobalSlamOptimizationCallback callback));
@@ -49,6 +49,7 @@ class MockTrajectoryBuilder : public mapping::TrajectoryBuilderInterface {
                                   local_slam_result_data) override {
     DoAddLocalSlamResultData(local_slam_result_data.get());
   }
+  MOCK_METHOD0(Flush, void());
 };
 
 }  // namespace testing
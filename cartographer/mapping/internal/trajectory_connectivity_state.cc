@@ -26,7 +26,9 @@ void TrajectoryConnectivityState::Add(const int trajectory_id) {
 void TrajectoryConnectivityState::Connect(const int trajectory_id_a,
                                           const int trajectory_id_b,
                                           const common::Time time) {
-  if (TransitivelyConnected(trajectory_id_a, trajectory_id_b)) {
+  const std::shared_ptr<const ConnectedComponents::Snapshot> snapshot =
+      connected_components_.GetSnapshot();
+  if (snapshot->TransitivelyConnected(trajectory_id_a, trajectory_id_b)) {
     // The trajectories are transitively connected, i.e. they belong to the same
     // connected component. In this case we only update the last connection time
     // of those two trajectories.
@@ -40,10 +42,10 @@ void TrajectoryConnectivityState::Connect(const int trajectory_id_a,
     // the two connected components with the connection time. This is to quickly
     // change to a more efficient loop closure search (by constraining the
     // search window) when connected components are joined.
-    std::vector<int> component_a =
-        connected_components_.GetComponent(trajectory_id_a);
-    std::vector<int> component_b =
-        connected_components_.GetComponent(trajectory_id_b);
+    const std::vector<int>& component_a =
+        snapshot->GetComponent(trajectory_id_a);
+    const std::vector<int>& component_b =
+        snapshot->GetComponent(trajectory_id_b);
     for (const auto id_a : component_a) {
       for (const auto id_b : component_b) {
         auto id_pair = std::minmax(id_a, id_b);
@@ -65,9 +67,10 @@ std::vector<std::vector<int>> TrajectoryConnectivityState::Components() const {
 }
 
 common::Time TrajectoryConnectivityState::LastConnectionTime(
-    const int trajectory_id_a, const int trajectory_id_b) {
-  const auto sorted_pair = std::minmax(trajectory_id_a, trajectory_id_b);
-  return last_connection_time_map_[sorted_pair];
+    const int trajectory_id_a, const int trajectory_id_b) const {
+  const auto it = last_connection_time_map_.find(
+      std::minmax(trajectory_id_a, trajectory_id_b));
+  return it != last_connection_time_map_.end() ? it->second : common::Time();
 }
 
 }  // namespace mapping
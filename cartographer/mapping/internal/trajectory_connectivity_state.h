@@ -57,11 +57,12 @@ class TrajectoryConnectivityState {
   // Return the last connection count between the two trajectories. If either of
   // the trajectories is untracked or they have never been connected returns the
   // beginning of time.
-  common::Time LastConnectionTime(int trajectory_id_a, int trajectory_id_b);
+  common::Time LastConnectionTime(int trajectory_id_a,
+                                  int trajectory_id_b) const;
 
  private:
   // ConnectedComponents are thread safe.
-  mutable ConnectedComponents connected_components_;
+  ConnectedComponents connected_components_;
 
   // Tracks the last time a direct connection between two trajectories has
   // been added. The exception is when a connection between two trajectories
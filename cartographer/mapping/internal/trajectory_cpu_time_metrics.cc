@@ -0,0 +1,98 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "cartographer/mapping/internal/trajectory_cpu_time_metrics.h"
+
+#include <string>
+
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+metrics::Family<metrics::Counter>* kCpuTimeMetricFamily =
+    metrics::Family<metrics::Counter>::Null();
+
+std::string ToString(const TrajectoryCpuTimeMetrics::Activity activity) {
+  switch (activity) {
+    case TrajectoryCpuTimeMetrics::Activity::kConstraintSearch:
+      return "constraint_search";
+    case TrajectoryCpuTimeMetrics::Activity::kScanMatcherConstruction:
+      return "scan_matcher_construction";
+    case TrajectoryCpuTimeMetrics::Activity::kOptimization:
+      return "optimization";
+  }
+  LOG(FATAL) << "Unknown activity.";
+}
+
+}  // namespace
+
+void TrajectoryCpuTimeMetrics::RegisterMetrics(
+    metrics::FamilyFactory* family_factory) {
+  kCpuTimeMetricFamily = family_factory->NewCounterFamily(
+      "mapping_pose_graph_trajectory_cpu_time",
+      "Thread CPU time in seconds of background work attributed to a "
+      "trajectory");
+}
+
+void TrajectoryCpuTimeMetrics::Add(const int trajectory_id,
+                                   const Activity activity,
+                                   const double cpu_time_seconds) {
+  absl::MutexLock locker(&mutex_);
+  AddLocked(trajectory_id, activity, cpu_time_seconds);
+}
+
+void TrajectoryCpuTimeMetrics::AddShares(
+    const std::map<int, int>& num_nodes_per_trajectory,
+    const Activity activity, const double cpu_time_seconds) {
+  int num_nodes = 0;
+  for (const auto& trajectory_id_and_num_nodes : num_nodes_per_trajectory) {
+    num_nodes += trajectory_id_and_num_nodes.second;
+  }
+  if (num_nodes == 0) return;
+  absl::MutexLock locker(&mutex_);
+  for (const auto& trajectory_id_and_num_nodes : num_nodes_per_trajectory) {
+    if (trajectory_id_and_num_nodes.second == 0) continue;
+    AddLocked(trajectory_id_and_num_nodes.first, activity,
+              cpu_time_seconds * trajectory_id_and_num_nodes.second /
+                  num_nodes);
+  }
+}
+
+double TrajectoryCpuTimeMetrics::GetCpuTimeSeconds(const int trajectory_id,
+                                                   const Activity activity) {
+  absl::MutexLock locker(&mutex_);
+  const auto it = entries_.find(std::make_pair(trajectory_id, activity));
+  return it == entries_.end() ? 0. : it->second.cpu_time_seconds;
+}
+
+void TrajectoryCpuTimeMetrics::AddLocked(const int trajectory_id,
+                                         const Activity activity,
+                                         const double cpu_time_seconds) {
+  Entry& entry = entries_[std::make_pair(trajectory_id, activity)];
+  if (entry.counter == nullptr) {
+    entry.counter = kCpuTimeMetricFamily->Add(
+        {{"trajectory_id", std::to_string(trajectory_id)},
+         {"activity", ToString(activity)}});
+  }
+  entry.cpu_time_seconds += cpu_time_seconds;
+  entry.counter->Increment(cpu_time_seconds);
+}
+
+}  // namespace mapping
+}  // namespace cartographer
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef CARTOGRAPHER_MAPPING_INTERNAL_TRAJECTORY_CPU_TIME_METRICS_H_
+#define CARTOGRAPHER_MAPPING_INTERNAL_TRAJECTORY_CPU_TIME_METRICS_H_
+
+#include <map>
+#include <utility>
+
+#include "absl/synchronization/mutex.h"
+#include "cartographer/metrics/counter.h"
+#include "cartographer/metrics/family_factory.h"
+
+namespace cartographer {
+namespace mapping {
+
+// Attributes the thread CPU time of the work the pose graph does in the
+// background to the trajectories which caused it, so that it can be seen
+// which trajectories keep the cores of a shared server busy. The totals are
+// exported as a counter per trajectory and activity.
+//
+// This class is thread-safe.
+class TrajectoryCpuTimeMetrics {
+ public:
+  enum class Activity {
+    // Attributed to the trajectory of the node.
+    kConstraintSearch,
+    // Attributed to the trajectory of the submap.
+    kScanMatcherConstruction,
+    // Shared among the trajectories in proportion to their number of nodes.
+    kOptimization,
+  };
+
+  TrajectoryCpuTimeMetrics() {}
+
+  TrajectoryCpuTimeMetrics(const TrajectoryCpuTimeMetrics&) = delete;
+  TrajectoryCpuTimeMetrics& operator=(const TrajectoryCpuTimeMetrics&) =
+      delete;
+
+  static void RegisterMetrics(metrics::FamilyFactory* family_factory);
+
+  void Add(int trajectory_id, Activity activity, double cpu_time_seconds)
+      LOCKS_EXCLUDED(mutex_);
+
+  // Shares 'cpu_time_seconds' among the trajectories in proportion to their
+  // entries in 'num_nodes_per_trajectory'.
+  void AddShares(const std::map<int, int>& num_nodes_per_trajectory,
+                 Activity activity, double cpu_time_seconds)
+      LOCKS_EXCLUDED(mutex_);
+
+  // Returns the CPU time attributed to 'trajectory_id' for 'activity' so far.
+  double GetCpuTimeSeconds(int trajectory_id, Activity activity)
+      LOCKS_EXCLUDED(mutex_);
+
+ private:
+  struct Entry {
+    double cpu_time_seconds = 0.;
+    metrics::Counter* counter = nullptr;
+  };
+
+  void AddLocked(int trajectory_id, Activity activity, double cpu_time_seconds)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  absl::Mutex mutex_;
+  std::map<std::pair<int, Activity>, Entry> entries_ GUARDED_BY(mutex_);
+};
+
+}  // namespace mapping
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_MAPPING_INTERNAL_TRAJECTORY_CPU_TIME_METRICS_H_
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "cartographer/mapping/internal/trajectory_cpu_time_metrics.h"
+
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+using Activity = TrajectoryCpuTimeMetrics::Activity;
+
+TEST(TrajectoryCpuTimeMetricsTest, AddsPerTrajectoryAndActivity) {
+  TrajectoryCpuTimeMetrics trajectory_cpu_time_metrics;
+  trajectory_cpu_time_metrics.Add(0, Activity::kConstraintSearch, 1.);
+  trajectory_cpu_time_metrics.Add(0, Activity::kConstraintSearch, 0.5);
+  trajectory_cpu_time_metrics.Add(0, Activity::kScanMatcherConstruction, 2.);
+  trajectory_cpu_time_metrics.Add(3, Activity::kConstraintSearch, 4.);
+  EXPECT_DOUBLE_EQ(1.5, trajectory_cpu_time_metrics.GetCpuTimeSeconds(
+                            0, Activity::kConstraintSearch));
+  EXPECT_DOUBLE_EQ(2., trajectory_cpu_time_metrics.GetCpuTimeSeconds(
+                           0, Activity::kScanMatcherConstruction));
+  EXPECT_DOUBLE_EQ(4., trajectory_cpu_time_metrics.GetCpuTimeSeconds(
+                           3, Activity::kConstraintSearch));
+  EXPECT_EQ(0., trajectory_cpu_time_metrics.GetCpuTimeSeconds(
+                    3, Activity::kOptimization));
+  EXPECT_EQ(0., trajectory_cpu_time_metrics.GetCpuTimeSeconds(
+                    1, Activity::kConstraintSearch));
+}
+
+TEST(TrajectoryCpuTimeMetricsTest, SharesInProportionToNodes) {
+  TrajectoryCpuTimeMetrics trajectory_cpu_time_metrics;
+  trajectory_cpu_time_metrics.AddShares({{0, 30}, {1, 10}, {2, 0}},
+                                        Activity::kOptimization, 2.);
+  EXPECT_DOUBLE_EQ(1.5, trajectory_cpu_time_metrics.GetCpuTimeSeconds(
+                            0, Activity::kOptimization));
+  EXPECT_DOUBLE_EQ(0.5, trajectory_cpu_time_metrics.GetCpuTimeSeconds(
+                            1, Activity::kOptimization));
+  EXPECT_EQ(0., trajectory_cpu_time_metrics.GetCpuTimeSeconds(
+                    2, Activity::kOptimization));
+  trajectory_cpu_time_metrics.AddShares({}, Activity::kOptimization, 2.);
+  EXPECT_DOUBLE_EQ(1.5, trajectory_cpu_time_metrics.GetCpuTimeSeconds(
+                            0, Activity::kOptimization));
+}
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "cartographer/mapping/internal/trajectory_node_data_store.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace mapping {
+
+TrajectoryNodeDataStore::TrajectoryNodeDataStore(const std::string& directory) {
+  std::string filename = directory + "/cartographer_node_data_XXXXXX";
+  fd_ = mkstemp(&filename[0]);
+  PCHECK(fd_ != -1) << "Failed to create a node data file in '" << directory
+                    << "'.";
+  PCHECK(unlink(filename.c_str()) == 0);
+}
+
+TrajectoryNodeDataStore::~TrajectoryNodeDataStore() { close(fd_); }
+
+void TrajectoryNodeDataStore::Evict(const NodeId& node_id,
+                                    TrajectoryNode* const node) {
+  auto it = entries_.find(node_id);
+  if (it == entries_.end()) {
+    std::string serialized;
+    CHECK(ToProto(*node->constant_data).SerializeToString(&serialized));
+    const ssize_t written = pwrite(fd_, serialized.data(), serialized.size(),
+                                   static_cast<off_t>(file_size_));
+    PCHECK(written == static_cast<ssize_t>(serialized.size()))
+        << "Failed to write the data of node " << node_id << ".";
+    it = entries_
+             .emplace(node_id,
+                      Entry{file_size_, serialized.size(), false /* evicted */})
+             .first;
+    file_size_ += serialized.size();
+  }
+  if (it->second.evicted) {
+    return;
+  }
+  auto data = std::make_shared<TrajectoryNode::Data>(*node->constant_data);
+  data->filtered_gravity_aligned_point_cloud = sensor::PointCloud();
+  data->high_resolution_point_cloud = sensor::PointCloud();
+  data->low_resolution_point_cloud = sensor::PointCloud();
+  node->constant_data = std::move(data);
+  it->second.evicted = true;
+  ++num_evicted_nodes_;
+}
+
+void TrajectoryNodeDataStore::Restore(const NodeId& node_id,
+                                      TrajectoryNode* const node) {
+  const auto it = entries_.find(node_id);
+  if (it == entries_.end() || !it->second.evicted) {
+    return;
+  }
+  node->constant_data = Read(it->second);
+  it->second.evicted = false;
+  --num_evicted_nodes_;
+}
+
+std::shared_ptr<const TrajectoryNode::Data>
+TrajectoryNodeDataStore::GetFullData(const NodeId& node_id,
+                                     const TrajectoryNode& node) const {
+  const auto it = entries_.find(node_id);
+  if (it == entries_.end() || !it->second.evicted) {
+    return node.constant_data;
+  }
+  return Read(it->second);
+}
+
+void TrajectoryNodeDataStore::Erase(const NodeId& node_id) {
+  const auto it = entries_.find(node_id);
+  if (it == entries_.end()) {
+    return;
+  }
+  if (it->second.evicted) {
+    --num_evicted_nodes_;
+  }
+  entries_.erase(it);
+}
+
+std::shared_ptr<const TrajectoryNode::Data> TrajectoryNodeDataStore::Read(
+    const Entry& entry) const {
+  std::vector<char> buffer(entry.size);
+  const ssize_t num_read = pread(fd_, buffer.data(), buffer.size(),
+                                 static_cast<off_t>(entry.offset));
+  PCHECK(num_read == static_cast<ssize_t>(entry.size));
+  proto::TrajectoryNodeData proto;
+  CHECK(proto.ParseFromArray(buffer.data(), buffer.size()));
+  return std::make_shared<const TrajectoryNode::Data>(FromProto(proto));
+}
+
+}  // namespace mapping
+}  // namespace cartographer
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef CARTOGRAPHER_MAPPING_INTERNAL_TRAJECTORY_NODE_DATA_STORE_H_
+#define CARTOGRAPHER_MAPPING_INTERNAL_TRAJECTORY_NODE_DATA_STORE_H_
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "cartographer/common/port.h"
+#include "cartographer/mapping/id.h"
+#include "cartographer/mapping/trajectory_node.h"
+
+namespace cartographer {
+namespace mapping {
+
+// Moves the point clouds of trajectory nodes out of memory into a temporary
+// file and reads them back on demand. Point clouds are stored compressed, i.e.
+// with the same precision as in a serialized state.
+//
+// The data of a node is constant, so it is written at most once and evicting
+// a node again after it was restored does not touch the file. Space of
+// erased nodes is not reclaimed.
+//
+// This class is thread-compatible.
+class TrajectoryNodeDataStore {
+ public:
+  // Creates the backing file in 'directory'. The file is unlinked right away,
+  // so it lives only as long as this store.
+  explicit TrajectoryNodeDataStore(const std::string& directory);
+  ~TrajectoryNodeDataStore();
+
+  TrajectoryNodeDataStore(const TrajectoryNodeDataStore&) = delete;
+  TrajectoryNodeDataStore& operator=(const TrajectoryNodeDataStore&) = delete;
+
+  // Replaces the data of 'node' by a copy without point clouds.
+  void Evict(const NodeId& node_id, TrajectoryNode* node);
+
+  // Replaces the data of 'node' by the full data read back from the file if
+  // it was evicted.
+  void Restore(const NodeId& node_id, TrajectoryNode* node);
+
+  // Returns the full data of 'node' without restoring it.
+  std::shared_ptr<const TrajectoryNode::Data> GetFullData(
+      const NodeId& node_id, const TrajectoryNode& node) const;
+
+  // Forgets 'node_id', e.g. after the node has been trimmed.
+  void Erase(const NodeId& node_id);
+
+  int num_evicted_nodes() const { return num_evicted_nodes_; }
+
+ private:
+  struct Entry {
+    uint64 offset;
+    uint64 size;
+    bool evicted;
+  };
+
+  std::shared_ptr<const TrajectoryNode::Data> Read(const Entry& entry) const;
+
+  int fd_ = -1;
+  uint64 file_size_ = 0;
+  std::map<NodeId, Entry> entries_;
+  int num_evicted_nodes_ = 0;
+};
+
+}  // namespace mapping
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_MAPPING_INTERNAL_TRAJECTORY_NODE_DATA_STORE_H_
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "cartographer/mapping/internal/trajectory_node_data_store.h"
+
+#include "cartographer/sensor/compressed_point_cloud.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+TrajectoryNode CreateNode() {
+  auto data = std::make_shared<TrajectoryNode::Data>();
+  data->time = common::FromUniversal(42);
+  data->gravity_alignment = Eigen::Quaterniond::Identity();
+  std::vector<sensor::RangefinderPoint> points;
+  for (int i = 0; i < 10; ++i) {
+    points.push_back({Eigen::Vector3f(0.5f * i, -0.25f * i, 0.f)});
+  }
+  data->filtered_gravity_aligned_point_cloud = sensor::PointCloud(points);
+  data->high_resolution_point_cloud = sensor::PointCloud(points);
+  data->low_resolution_point_cloud = sensor::PointCloud(points);
+  data->rotational_scan_matcher_histogram = Eigen::VectorXf::Ones(3);
+  data->local_pose = transform::Rigid3d::Translation({1., 2., 3.});
+  return TrajectoryNode{data, transform::Rigid3d::Identity()};
+}
+
+// Point clouds come back as from a serialized state, i.e. compressed.
+void ExpectSamePoints(const sensor::PointCloud& original,
+                      const sensor::PointCloud& actual) {
+  const sensor::PointCloud expected =
+      sensor::CompressedPointCloud(original).Decompress();
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i].position, actual[i].position);
+  }
+}
+
+TEST(TrajectoryNodeDataStoreTest, EvictsAndRestoresPointClouds) {
+  TrajectoryNodeDataStore store(::testing::TempDir());
+  const NodeId node_id{0, 3};
+  const TrajectoryNode original = CreateNode();
+  TrajectoryNode node = original;
+  store.Evict(node_id, &node);
+  EXPECT_EQ(store.num_evicted_nodes(), 1);
+  EXPECT_TRUE(node.constant_data->filtered_gravity_aligned_point_cloud.empty());
+  EXPECT_TRUE(node.constant_data->high_resolution_point_cloud.empty());
+  EXPECT_TRUE(node.constant_data->low_resolution_point_cloud.empty());
+  EXPECT_EQ(node.constant_data->time, original.constant_data->time);
+  EXPECT_EQ(node.constant_data->rotational_scan_matcher_histogram.size(), 3);
+
+  const auto full_data = store.GetFullData(node_id, node);
+  ExpectSamePoints(original.constant_data->low_resolution_point_cloud,
+                   full_data->low_resolution_point_cloud);
+  EXPECT_TRUE(node.constant_data->low_resolution_point_cloud.empty());
+
+  store.Restore(node_id, &node);
+  EXPECT_EQ(store.num_evicted_nodes(), 0);
+  ExpectSamePoints(
+      original.constant_data->filtered_gravity_aligned_point_cloud,
+      node.constant_data->filtered_gravity_aligned_point_cloud);
+  ExpectSamePoints(original.constant_data->high_resolution_point_cloud,
+                   node.constant_data->high_resolution_point_cloud);
+  EXPECT_TRUE(node.constant_data->local_pose.translation().isApprox(
+      original.constant_data->local_pose.translation()));
+  EXPECT_EQ(store.GetFullData(node_id, node), node.constant_data);
+}
+
+TEST(TrajectoryNodeDataStoreTest, EvictsRestoredNodeAgain) {
+  TrajectoryNodeDataStore store(::testing::TempDir());
+  const TrajectoryNode original = CreateNode();
+  TrajectoryNode first = original;
+  TrajectoryNode second = original;
+  store.Evict(NodeId{0, 0}, &first);
+  store.Evict(NodeId{1, 0}, &second);
+  store.Restore(NodeId{0, 0}, &first);
+  store.Evict(NodeId{0, 0}, &first);
+  EXPECT_EQ(store.num_evicted_nodes(), 2);
+  store.Restore(NodeId{1, 0}, &second);
+  store.Restore(NodeId{0, 0}, &first);
+  ExpectSamePoints(original.constant_data->high_resolution_point_cloud,
+                   first.constant_data->high_resolution_point_cloud);
+  ExpectSamePoints(original.constant_data->high_resolution_point_cloud,
+                   second.constant_data->high_resolution_point_cloud);
+}
+
+TEST(TrajectoryNodeDataStoreTest, IgnoresUnknownNodes) {
+  TrajectoryNodeDataStore store(::testing::TempDir());
+  TrajectoryNode node = CreateNode();
+  const auto data = node.constant_data;
+  store.Restore(NodeId{0, 0}, &node);
+  EXPECT_EQ(node.constant_data, data);
+  store.Evict(NodeId{0, 0}, &node);
+  store.Erase(NodeId{0, 0});
+  EXPECT_EQ(store.num_evicted_nodes(), 0);
+  store.Restore(NodeId{0, 0}, &node);
+  EXPECT_TRUE(node.constant_data->high_resolution_point_cloud.empty());
+}
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
@@ -32,6 +32,12 @@ struct WorkItem {
 
   std::chrono::steady_clock::time_point time;
   std::function<Result()> task;
+  // If set, 'task' only does the part of the work item which has to happen in
+  // queue order and 'concurrent_task' does the rest and decides whether to
+  // run the optimization. 'concurrent_task' of adjacent work items may run
+  // concurrently if their 'trajectory_id' differs.
+  int trajectory_id = -1;
+  std::function<Result()> concurrent_task;
 };
 
 using WorkQueue = std::deque<WorkItem>;
@@ -16,9 +16,21 @@
 
 #include "cartographer/mapping/map_builder.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <vector>
+
 #include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
 #include "absl/types/optional.h"
 #include "cartographer/common/time.h"
+#include "cartographer/common/work_stealing_thread_pool.h"
+#include "cartographer/io/internal/checkpoint_journal.h"
 #include "cartographer/io/internal/mapping_state_serialization.h"
 #include "cartographer/io/proto_stream.h"
 #include "cartographer/io/proto_stream_deserializer.h"
@@ -35,6 +47,7 @@
 #include "cartographer/sensor/internal/voxel_filter.h"
 #include "cartographer/transform/rigid_transform.h"
 #include "cartographer/transform/transform.h"
+#include "google/protobuf/arena.h"
 
 namespace cartographer {
 namespace mapping {
@@ -42,6 +55,123 @@ namespace {
 
 using mapping::proto::SerializedData;
 
+// Loads serialized data in three stages: a thread reads and parses the stream,
+// 'thread_pool' converts submaps and nodes, and the caller of GetNext() adds
+// the results to the pose graph in stream order.
+class PipelinedDeserializer {
+ public:
+  struct Item {
+    // Holds 'proto' and all of its nested messages, so that the grids and
+    // point clouds of a submap or node are freed at once with the item.
+    google::protobuf::Arena arena;
+    SerializedData* const proto =
+        google::protobuf::Arena::CreateMessage<SerializedData>(&arena);
+    // Set for submaps and nodes respectively once 'converted' is notified.
+    std::shared_ptr<const Submap> submap;
+    std::shared_ptr<const TrajectoryNode::Data> node_data;
+    absl::Notification converted;
+  };
+
+  // Converts submaps, e.g. PoseGraph::SubmapFromProto(). Must be thread-safe.
+  using SubmapConverter =
+      std::function<std::shared_ptr<const Submap>(const proto::Submap&)>;
+
+  PipelinedDeserializer(io::ProtoStreamDeserializer* const deserializer,
+                        SubmapConverter submap_converter,
+                        common::ThreadPoolInterface* const thread_pool)
+      : deserializer_(deserializer),
+        submap_converter_(std::move(submap_converter)),
+        thread_pool_(thread_pool),
+        reader_thread_([this]() { Read(); }) {}
+
+  ~PipelinedDeserializer() {
+    {
+      absl::MutexLock locker(&mutex_);
+      stopped_ = true;
+    }
+    reader_thread_.join();
+    // Conversions may still refer to items which were never returned.
+    for (const auto& item : items_) {
+      item->converted.WaitForNotification();
+    }
+  }
+
+  PipelinedDeserializer(const PipelinedDeserializer&) = delete;
+  PipelinedDeserializer& operator=(const PipelinedDeserializer&) = delete;
+
+  // Returns the next converted item, or nullptr at the end of the stream.
+  std::unique_ptr<Item> GetNext() LOCKS_EXCLUDED(mutex_) {
+    std::unique_ptr<Item> item;
+    {
+      absl::MutexLock locker(&mutex_);
+      const auto predicate = [this]() EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+        return !items_.empty() || finished_;
+      };
+      mutex_.Await(absl::Condition(&predicate));
+      if (items_.empty()) {
+        return nullptr;
+      }
+      item = std::move(items_.front());
+      items_.pop_front();
+    }
+    item->converted.WaitForNotification();
+    return item;
+  }
+
+ private:
+  // Bounds the memory used by data which was read but not yet added.
+  static constexpr size_t kMaxPendingItems = 128;
+
+  void Read() LOCKS_EXCLUDED(mutex_) {
+    const auto predicate = [this]() EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+      return items_.size() < kMaxPendingItems || stopped_;
+    };
+    for (;;) {
+      auto item = absl::make_unique<Item>();
+      if (!deserializer_->ReadNextSerializedData(item->proto)) {
+        break;
+      }
+      Convert(item.get());
+      absl::MutexLock locker(&mutex_);
+      mutex_.Await(absl::Condition(&predicate));
+      items_.push_back(std::move(item));
+      if (stopped_) {
+        break;
+      }
+    }
+    absl::MutexLock locker(&mutex_);
+    finished_ = true;
+  }
+
+  void Convert(Item* const item) {
+    if (!item->proto->has_submap() && !item->proto->has_node()) {
+      item->converted.Notify();
+      return;
+    }
+    auto task = absl::make_unique<common::Task>();
+    task->SetWorkItem([this, item]() {
+      if (item->proto->has_submap()) {
+        item->submap = submap_converter_(item->proto->submap());
+      } else {
+        item->node_data = std::make_shared<const TrajectoryNode::Data>(
+            FromProto(item->proto->node().node_data()));
+      }
+      item->converted.Notify();
+    });
+    thread_pool_->Schedule(std::move(task));
+  }
+
+  io::ProtoStreamDeserializer* const deserializer_;
+  const SubmapConverter submap_converter_;
+  common::ThreadPoolInterface* const thread_pool_;
+
+  absl::Mutex mutex_;
+  std::deque<std::unique_ptr<Item>> items_ GUARDED_BY(mutex_);
+  bool finished_ GUARDED_BY(mutex_) = false;
+  bool stopped_ GUARDED_BY(mutex_) = false;
+  std::thread reader_thread_;
+};
+
 std::vector<std::string> SelectRangeSensorIds(
     const std::set<MapBuilder::SensorId>& expected_sensor_ids) {
   std::vector<std::string> range_sensor_ids;
@@ -75,27 +205,67 @@ void MaybeAddPureLocalizationTrimmer(
 }  // namespace
 
 MapBuilder::MapBuilder(const proto::MapBuilderOptions& options)
-    : options_(options), thread_pool_(options.num_background_threads()) {
+    : options_(options) {
   CHECK(options.use_trajectory_builder_2d() ^
         options.use_trajectory_builder_3d());
+  const std::vector<int> background_threads_cpu_ids(
+      options.background_threads_cpu_ids().begin(),
+      options.background_threads_cpu_ids().end());
+  std::vector<std::vector<int>> numa_node_cpu_ids;
+  if (options.use_work_stealing_thread_pool() &&
+      options.numa_aware_work_stealing_thread_pool()) {
+    numa_node_cpu_ids =
+        common::GroupCpuIdsByNumaNode(background_threads_cpu_ids);
+    if (numa_node_cpu_ids.size() >
+        static_cast<size_t>(options.num_background_threads())) {
+      numa_node_cpu_ids.resize(options.num_background_threads());
+    }
+  }
+  if (numa_node_cpu_ids.size() > 1) {
+    LOG(INFO) << "Splitting background threads across "
+              << numa_node_cpu_ids.size() << " NUMA nodes.";
+    thread_pool_ = absl::make_unique<common::WorkStealingThreadPool>(
+        options.num_background_threads(),
+        options.background_threads_nice_increment(), numa_node_cpu_ids);
+  } else if (options.use_work_stealing_thread_pool()) {
+    thread_pool_ = absl::make_unique<common::WorkStealingThreadPool>(
+        options.num_background_threads(),
+        options.background_threads_nice_increment(),
+        background_threads_cpu_ids);
+  } else {
+    thread_pool_ = absl::make_unique<common::ThreadPool>(
+        options.num_background_threads(),
+        options.background_threads_nice_increment(),
+        background_threads_cpu_ids);
+  }
   if (options.use_trajectory_builder_2d()) {
     pose_graph_ = absl::make_unique<PoseGraph2D>(
         options_.pose_graph_options(),
         absl::make_unique<optimization::OptimizationProblem2D>(
             options_.pose_graph_options().optimization_problem_options()),
-        &thread_pool_);
+        thread_pool_.get());
   }
   if (options.use_trajectory_builder_3d()) {
     pose_graph_ = absl::make_unique<PoseGraph3D>(
         options_.pose_graph_options(),
         absl::make_unique<optimization::OptimizationProblem3D>(
             options_.pose_graph_options().optimization_problem_options()),
-        &thread_pool_);
+        thread_pool_.get());
   }
+  const common::Duration collator_max_lag =
+      common::FromSeconds(options.collator_max_lag_seconds());
   if (options.collate_by_trajectory()) {
-    sensor_collator_ = absl::make_unique<sensor::TrajectoryCollator>();
+    sensor_collator_ =
+        absl::make_unique<sensor::TrajectoryCollator>(collator_max_lag);
   } else {
-    sensor_collator_ = absl::make_unique<sensor::Collator>();
+    LOG_IF(WARNING, options.use_trajectory_ingestion_threads())
+        << "Ignoring use_trajectory_ingestion_threads, which requires "
+           "collate_by_trajectory.";
+    sensor_collator_ = absl::make_unique<sensor::Collator>(collator_max_lag);
+  }
+  if (options.submap_query_cache_max_bytes() > 0) {
+    submap_query_cache_ = absl::make_unique<SubmapQueryCache>(
+        options.submap_query_cache_max_bytes());
   }
 }
 
@@ -104,6 +274,9 @@ int MapBuilder::AddTrajectoryBuilder(
     const proto::TrajectoryBuilderOptions& trajectory_options,
     LocalSlamResultCallback local_slam_result_callback) {
   const int trajectory_id = trajectory_builders_.size();
+  const bool use_ingestion_thread =
+      options_.collate_by_trajectory() &&
+      options_.use_trajectory_ingestion_threads();
 
   absl::optional<MotionFilter> pose_graph_odometry_motion_filter;
   if (trajectory_options.has_pose_graph_odometry_motion_filter()) {
@@ -126,7 +299,8 @@ int MapBuilder::AddTrajectoryBuilder(
         CreateGlobalTrajectoryBuilder3D(
             std::move(local_trajectory_builder), trajectory_id,
             static_cast<PoseGraph3D*>(pose_graph_.get()),
-            local_slam_result_callback, pose_graph_odometry_motion_filter)));
+            local_slam_result_callback, pose_graph_odometry_motion_filter),
+        use_ingestion_thread));
   } else {
     std::unique_ptr<LocalTrajectoryBuilder2D> local_trajectory_builder;
     if (trajectory_options.has_trajectory_builder_2d_options()) {
@@ -141,7 +315,8 @@ int MapBuilder::AddTrajectoryBuilder(
         CreateGlobalTrajectoryBuilder2D(
             std::move(local_trajectory_builder), trajectory_id,
             static_cast<PoseGraph2D*>(pose_graph_.get()),
-            local_slam_result_callback, pose_graph_odometry_motion_filter)));
+            local_slam_result_callback, pose_graph_odometry_motion_filter),
+        use_ingestion_thread));
   }
   MaybeAddPureLocalizationTrimmer(trajectory_id, trajectory_options,
                                   pose_graph_.get());
@@ -160,7 +335,10 @@ int MapBuilder::AddTrajectoryBuilder(
   }
   *options_with_sensor_ids_proto.mutable_trajectory_builder_options() =
       trajectory_options;
-  all_trajectory_builder_options_.push_back(options_with_sensor_ids_proto);
+  {
+    absl::MutexLock locker(&all_trajectory_builder_options_mutex_);
+    all_trajectory_builder_options_.push_back(options_with_sensor_ids_proto);
+  }
   CHECK_EQ(trajectory_builders_.size(), all_trajectory_builder_options_.size());
   return trajectory_id;
 }
@@ -170,13 +348,20 @@ int MapBuilder::AddTrajectoryForDeserialization(
         options_with_sensor_ids_proto) {
   const int trajectory_id = trajectory_builders_.size();
   trajectory_builders_.emplace_back();
-  all_trajectory_builder_options_.push_back(options_with_sensor_ids_proto);
+  {
+    absl::MutexLock locker(&all_trajectory_builder_options_mutex_);
+    all_trajectory_builder_options_.push_back(options_with_sensor_ids_proto);
+  }
   CHECK_EQ(trajectory_builders_.size(), all_trajectory_builder_options_.size());
   return trajectory_id;
 }
 
 void MapBuilder::FinishTrajectory(const int trajectory_id) {
-  sensor_collator_->FinishTrajectory(trajectory_id);
+  if (trajectory_builders_.at(trajectory_id) != nullptr) {
+    trajectory_builders_.at(trajectory_id)->FinishTrajectory();
+  } else {
+    sensor_collator_->FinishTrajectory(trajectory_id);
+  }
   pose_graph_->FinishTrajectory(trajectory_id);
 }
 
@@ -195,33 +380,121 @@ std::string MapBuilder::SubmapToProto(
            " from trajectory " + std::to_string(submap_id.trajectory_id) +
            " but it does not exist: maybe it has been trimmed.";
   }
+  if (!submap_query_cache_) {
+    submap_data.submap->ToResponseProto(submap_data.pose, response);
+    return "";
+  }
+  // 3D textures are projected using the global submap pose, 2D textures do not
+  // depend on it.
+  const transform::Rigid3d cache_pose = options_.use_trajectory_builder_3d()
+                                            ? submap_data.pose
+                                            : transform::Rigid3d::Identity();
+  if (submap_query_cache_->Get(submap_id, submap_data.submap->num_range_data(),
+                               cache_pose, response)) {
+    return "";
+  }
   submap_data.submap->ToResponseProto(submap_data.pose, response);
+  if (response->textures_size() > 0) {
+    submap_query_cache_->Insert(submap_id, cache_pose, *response);
+  }
   return "";
 }
 
+std::vector<proto::TrajectoryBuilderOptionsWithSensorIds>
+MapBuilder::CopyAllTrajectoryBuilderOptions() {
+  absl::MutexLock locker(&all_trajectory_builder_options_mutex_);
+  return all_trajectory_builder_options_;
+}
+
 void MapBuilder::SerializeState(bool include_unfinished_submaps,
                                 io::ProtoStreamWriterInterface* const writer) {
-  io::WritePbStream(*pose_graph_, all_trajectory_builder_options_, writer,
+  io::WritePbStream(*pose_graph_, CopyAllTrajectoryBuilderOptions(), writer,
                     include_unfinished_submaps);
 }
 
 bool MapBuilder::SerializeStateToFile(bool include_unfinished_submaps,
                                       const std::string& filename) {
-  io::ProtoStreamWriter writer(filename);
-  io::WritePbStream(*pose_graph_, all_trajectory_builder_options_, &writer,
+  {
+    // The complete state replaces any checkpoints of the file.
+    absl::MutexLock locker(&checkpoint_mutex_);
+    if (io::HasCheckpointJournal(filename)) {
+      std::remove(io::CheckpointJournalFilename(filename).c_str());
+    }
+    if (checkpoint_filename_ == filename) {
+      checkpoint_filename_.clear();
+    }
+  }
+  io::IndexedProtoStreamWriter writer(filename,
+                                    options_.num_background_threads());
+  io::WritePbStream(*pose_graph_, CopyAllTrajectoryBuilderOptions(), &writer,
                     include_unfinished_submaps);
   return (writer.Close());
 }
 
+bool MapBuilder::WriteCheckpoint(bool include_unfinished_submaps,
+                                 const std::string& filename) {
+  absl::MutexLock locker(&checkpoint_mutex_);
+  const std::string journal_filename = io::CheckpointJournalFilename(filename);
+  if (filename != checkpoint_filename_) {
+    checkpoint_filename_.clear();
+    // The journal is emptied first, so that an old one is never replayed on
+    // top of the new state.
+    io::AppendingProtoStreamWriter journal(journal_filename, 0);
+    if (!journal.Close()) {
+      LOG(ERROR) << "Failed to start checkpoint journal '" << journal_filename
+                 << "'.";
+      return false;
+    }
+    io::IndexedProtoStreamWriter writer(filename,
+                                      options_.num_background_threads());
+    io::WritePbStream(*pose_graph_, CopyAllTrajectoryBuilderOptions(), &writer,
+                      include_unfinished_submaps, &checkpoint_);
+    if (!writer.Close()) {
+      return false;
+    }
+    checkpoint_filename_ = filename;
+    checkpoint_journal_size_ = journal.size();
+    return true;
+  }
+  // Whatever a failed append left behind is truncated by the next one.
+  io::AppendingProtoStreamWriter journal(journal_filename,
+                                         checkpoint_journal_size_);
+  io::SerializationCheckpoint checkpoint = checkpoint_;
+  io::WritePbStreamIncrement(*pose_graph_, CopyAllTrajectoryBuilderOptions(),
+                             &journal, include_unfinished_submaps,
+                             &checkpoint);
+  if (!journal.Close()) {
+    return false;
+  }
+  checkpoint_ = std::move(checkpoint);
+  checkpoint_journal_size_ = journal.size();
+  return true;
+}
+
 std::map<int, int> MapBuilder::LoadState(
     io::ProtoStreamReaderInterface* const reader, bool load_frozen_state) {
+  return LoadState(reader, load_frozen_state, nullptr /* grid_source */);
+}
+
+std::map<int, int> MapBuilder::LoadState(
+    io::ProtoStreamReaderInterface* const reader, bool load_frozen_state,
+    std::shared_ptr<const io::IndexedProtoStreamReader> grid_source) {
   io::ProtoStreamDeserializer deserializer(reader);
+  const std::map<int, int> trajectory_remapping =
+      AddTrajectoriesForDeserialization(&deserializer, load_frozen_state);
+  LoadDeserializedState(&deserializer, trajectory_remapping, load_frozen_state,
+                        std::move(grid_source));
+  CHECK(reader->eof());
+  return trajectory_remapping;
+}
 
-  // Create a copy of the pose_graph_proto, such that we can re-write the
-  // trajectory ids.
-  proto::PoseGraph pose_graph_proto = deserializer.pose_graph();
+std::map<int, int> MapBuilder::AddTrajectoriesForDeserialization(
+    io::ProtoStreamDeserializer* const deserializer,
+    const bool load_frozen_state) {
+  // The trajectory IDs are re-written in place.
+  proto::PoseGraph& pose_graph_proto = deserializer->pose_graph();
   const auto& all_builder_options_proto =
-      deserializer.all_trajectory_builder_options();
+      deserializer->all_trajectory_builder_options();
 
   std::map<int, int> trajectory_remapping;
   for (int i = 0; i < pose_graph_proto.trajectory_size(); ++i) {
@@ -247,7 +520,15 @@ std::map<int, int> MapBuilder::LoadState(
     constraint_proto.mutable_node_id()->set_trajectory_id(
         trajectory_remapping.at(constraint_proto.node_id().trajectory_id()));
   }
+  return trajectory_remapping;
+}
 
+void MapBuilder::LoadDeserializedState(
+    io::ProtoStreamDeserializer* const deserializer,
+    const std::map<int, int>& trajectory_remapping,
+    const bool load_frozen_state,
+    std::shared_ptr<const io::IndexedProtoStreamReader> grid_source) {
+  const proto::PoseGraph& pose_graph_proto = deserializer->pose_graph();
   MapById<SubmapId, transform::Rigid3d> submap_poses;
   for (const proto::Trajectory& trajectory_proto :
        pose_graph_proto.trajectory()) {
@@ -277,15 +558,51 @@ std::map<int, int> MapBuilder::LoadState(
   }
 
   if (options_.use_trajectory_builder_3d()) {
-    CHECK_NE(deserializer.header().format_version(),
+    CHECK_NE(deserializer->header().format_version(),
              io::kFormatVersionWithoutSubmapHistograms)
         << "The pbstream file contains submaps without rotational histograms. "
            "This can be converted with the 'pbstream migrate' tool, see the "
            "Cartographer documentation for details. ";
   }
 
-  SerializedData proto;
-  while (deserializer.ReadNextSerializedData(&proto)) {
+  PipelinedDeserializer::SubmapConverter submap_converter =
+      [this](const proto::Submap& submap) {
+        return pose_graph_->SubmapFromProto(submap);
+      };
+  if (grid_source != nullptr) {
+    // The stream entries of the submaps by their serialized IDs.
+    auto submap_entry_indices = std::make_shared<std::map<SubmapId, int>>();
+    for (int i = 0; i < grid_source->index().entry_size(); ++i) {
+      const io::proto::ProtoStreamIndex::Entry& entry =
+          grid_source->index().entry(i);
+      if (entry.data_case() == SerializedData::kSubmap) {
+        submap_entry_indices->emplace(
+            SubmapId{entry.trajectory_id(), entry.index()}, i);
+      }
+    }
+    DCHECK(dynamic_cast<PoseGraph2D*>(pose_graph_.get()));
+    auto* const pose_graph_2d = static_cast<PoseGraph2D*>(pose_graph_.get());
+    submap_converter = [pose_graph_2d, grid_source,
+                        submap_entry_indices](const proto::Submap& submap) {
+      const int entry_index = submap_entry_indices->at(
+          SubmapId{submap.submap_id().trajectory_id(),
+                   submap.submap_id().submap_index()});
+      return pose_graph_2d->LazySubmapFromProto(
+          submap, [grid_source, entry_index]() {
+            SerializedData proto;
+            CHECK(grid_source->ReadProto(entry_index, &proto));
+            proto::Grid2D grid;
+            grid.Swap(
+                proto.mutable_submap()->mutable_submap_2d()->mutable_grid());
+            return grid;
+          });
+    };
+  }
+  PipelinedDeserializer pipelined_deserializer(
+      deserializer, std::move(submap_converter), thread_pool_.get());
+  while (std::unique_ptr<PipelinedDeserializer::Item> item =
+             pipelined_deserializer.GetNext()) {
+    SerializedData& proto = *item->proto;
     switch (proto.data_case()) {
       case SerializedData::kPoseGraph:
         LOG(ERROR) << "Found multiple serialized `PoseGraph`. Serialized "
@@ -303,7 +620,7 @@ std::map<int, int> MapBuilder::LoadState(
         const SubmapId submap_id(proto.submap().submap_id().trajectory_id(),
                                  proto.submap().submap_id().submap_index());
         pose_graph_->AddSubmapFromProto(submap_poses.at(submap_id),
-                                        proto.submap());
+                                        submap_id, std::move(item->submap));
         break;
       }
       case SerializedData::kNode: {
@@ -312,7 +629,8 @@ std::map<int, int> MapBuilder::LoadState(
         const NodeId node_id(proto.node().node_id().trajectory_id(),
                              proto.node().node_id().node_index());
         const transform::Rigid3d& node_pose = node_poses.at(node_id);
-        pose_graph_->AddNodeFromProto(node_pose, proto.node());
+        pose_graph_->AddNodeFromProto(node_pose, node_id,
+                                      std::move(item->node_data));
         break;
       }
       case SerializedData::kTrajectoryData: {
@@ -379,11 +697,9 @@ std::map<int, int> MapBuilder::LoadState(
     pose_graph_->AddSerializedConstraints(
         FromProto(pose_graph_proto.constraint()));
   }
-  CHECK(reader->eof());
-  return trajectory_remapping;
 }
 
-std::map<int, int> MapBuilder::LoadStateFromFile(
+MapBuilder::StateFile MapBuilder::OpenStateFile(
     const std::string& state_filename, const bool load_frozen_state) {
   const std::string suffix = ".pbstream";
   if (state_filename.substr(
@@ -392,8 +708,75 @@ std::map<int, int> MapBuilder::LoadStateFromFile(
                     ".pbstream file.";
   }
   LOG(INFO) << "Loading saved state '" << state_filename << "'...";
-  io::ProtoStreamReader stream(state_filename);
-  return LoadState(&stream, load_frozen_state);
+  StateFile state_file;
+  const bool has_checkpoint_journal = io::HasCheckpointJournal(state_filename);
+  if (io::IsIndexedProtoStream(state_filename)) {
+    const auto stream = std::make_shared<io::IndexedProtoStreamReader>(
+        state_filename, options_.num_background_threads());
+    // The stream is kept open by the lazily loaded submaps.
+    if (!has_checkpoint_journal && load_frozen_state &&
+        options_.use_trajectory_builder_2d() &&
+        options_.pose_graph_options().lazy_load_frozen_submaps()) {
+      state_file.grid_source = stream;
+    }
+    state_file.stream = stream;
+  } else {
+    state_file.stream = std::make_shared<io::ProtoStreamReader>(state_filename);
+  }
+  if (has_checkpoint_journal) {
+    state_file.journal_reader = absl::make_unique<io::CheckpointJournalReader>(
+        state_file.stream.get(), io::CheckpointJournalFilename(state_filename));
+    LOG(INFO) << "Replaying " << state_file.journal_reader->num_increments()
+              << " checkpoint increments.";
+  }
+  return state_file;
+}
+
+std::map<int, int> MapBuilder::LoadStateFromFile(
+    const std::string& state_filename, const bool load_frozen_state) {
+  const StateFile state_file = OpenStateFile(state_filename, load_frozen_state);
+  return LoadState(state_file.reader(), load_frozen_state,
+                   state_file.grid_source);
+}
+
+std::vector<std::map<int, int>> MapBuilder::LoadStatesFromFiles(
+    const std::vector<std::string>& filenames, const bool load_frozen_state) {
+  // Only the headers are read while adding the trajectories, so that their
+  // IDs do not depend on the order in which the loading threads finish.
+  std::vector<StateFile> state_files;
+  std::vector<std::unique_ptr<io::ProtoStreamDeserializer>> deserializers;
+  std::vector<std::map<int, int>> trajectory_remappings;
+  for (const std::string& filename : filenames) {
+    state_files.push_back(OpenStateFile(filename, load_frozen_state));
+    deserializers.push_back(absl::make_unique<io::ProtoStreamDeserializer>(
+        state_files.back().reader()));
+    trajectory_remappings.push_back(AddTrajectoriesForDeserialization(
+        deserializers.back().get(), load_frozen_state));
+  }
+
+  // Each state is loaded on a thread of its own instead of 'thread_pool_',
+  // which converts the submaps and nodes of all states meanwhile.
+  std::atomic<size_t> next_state(0);
+  const auto load_states = [this, &state_files, &deserializers,
+                            &trajectory_remappings, &next_state,
+                            load_frozen_state]() {
+    for (size_t i = next_state++; i < state_files.size(); i = next_state++) {
+      LoadDeserializedState(deserializers[i].get(), trajectory_remappings[i],
+                            load_frozen_state, state_files[i].grid_source);
+      CHECK(state_files[i].reader()->eof());
+    }
+  };
+  std::vector<std::thread> threads;
+  const size_t num_threads = std::min<size_t>(
+      filenames.size(), std::max(options_.num_background_threads(), 1));
+  for (size_t i = 1; i < num_threads; ++i) {
+    threads.emplace_back(load_states);
+  }
+  load_states();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return trajectory_remappings;
 }
 
 std::unique_ptr<MapBuilderInterface> CreateMapBuilder(
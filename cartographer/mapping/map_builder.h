@@ -18,8 +18,17 @@
 #define CARTOGRAPHER_MAPPING_MAP_BUILDER_H_
 
 #include <memory>
+#include <vector>
 
+#include "absl/synchronization/mutex.h"
+#include "cartographer/common/port.h"
 #include "cartographer/common/thread_pool.h"
+#include "cartographer/io/internal/checkpoint_journal.h"
+#include "cartographer/io/internal/mapping_state_serialization.h"
+#include "cartographer/io/proto_stream.h"
+#include "cartographer/io/proto_stream_deserializer.h"
+#include "cartographer/mapping/internal/collated_trajectory_builder.h"
+#include "cartographer/mapping/internal/submap_query_cache.h"
 #include "cartographer/mapping/map_builder_interface.h"
 #include "cartographer/mapping/pose_graph.h"
 #include "cartographer/mapping/proto/map_builder_options.pb.h"
@@ -58,12 +67,23 @@ class MapBuilder : public MapBuilderInterface {
   bool SerializeStateToFile(bool include_unfinished_submaps,
                             const std::string &filename) override;
 
+  bool WriteCheckpoint(bool include_unfinished_submaps,
+                       const std::string &filename) override;
+
   std::map<int, int> LoadState(io::ProtoStreamReaderInterface *reader,
                                bool load_frozen_state) override;
 
   std::map<int, int> LoadStateFromFile(const std::string &filename,
                                        const bool load_frozen_state) override;
 
+  // Loads the states in 'filenames' like LoadStateFromFile(), e.g. to merge
+  // several maps, and returns their trajectory remappings in the same order.
+  // The trajectories are added in the order of 'filenames', then the files
+  // are read and their submaps and nodes are added to the pose graph in
+  // parallel.
+  std::vector<std::map<int, int>> LoadStatesFromFiles(
+      const std::vector<std::string> &filenames, bool load_frozen_state);
+
   mapping::PoseGraphInterface *pose_graph() override {
     return pose_graph_.get();
   }
@@ -83,16 +103,68 @@ class MapBuilder : public MapBuilderInterface {
   }
 
  private:
+  // Like LoadState(), but if 'grid_source' is not nullptr, the grids of
+  // finished 2D submaps are read from it when they are used. 'grid_source' must
+  // be the stream read by 'reader'.
+  std::map<int, int> LoadState(
+      io::ProtoStreamReaderInterface *reader, bool load_frozen_state,
+      std::shared_ptr<const io::IndexedProtoStreamReader> grid_source);
+
+  // The streams for reading a state file.
+  struct StateFile {
+    io::ProtoStreamReaderInterface *reader() const {
+      return journal_reader != nullptr ? journal_reader.get() : stream.get();
+    }
+
+    std::shared_ptr<io::ProtoStreamReaderInterface> stream;
+    // Replays the checkpoint journal next to the file on top of 'stream'.
+    // nullptr if there is none.
+    std::unique_ptr<io::CheckpointJournalReader> journal_reader;
+    // See LoadState(). nullptr unless submaps are loaded lazily.
+    std::shared_ptr<const io::IndexedProtoStreamReader> grid_source;
+  };
+
+  StateFile OpenStateFile(const std::string &filename, bool load_frozen_state);
+
+  // Adds a trajectory for each trajectory of the state read by 'deserializer'
+  // and rewrites its trajectory IDs to the new ones. Returns the remapping.
+  std::map<int, int> AddTrajectoriesForDeserialization(
+      io::ProtoStreamDeserializer *deserializer, bool load_frozen_state);
+
+  // Reads the rest of the state into the pose graph, after its trajectories
+  // were added by AddTrajectoriesForDeserialization(). May run concurrently
+  // for different states.
+  void LoadDeserializedState(
+      io::ProtoStreamDeserializer *deserializer,
+      const std::map<int, int> &trajectory_remapping, bool load_frozen_state,
+      std::shared_ptr<const io::IndexedProtoStreamReader> grid_source);
+
+  std::vector<proto::TrajectoryBuilderOptionsWithSensorIds>
+  CopyAllTrajectoryBuilderOptions()
+      LOCKS_EXCLUDED(all_trajectory_builder_options_mutex_);
+
   const proto::MapBuilderOptions options_;
-  common::ThreadPool thread_pool_;
+  std::unique_ptr<common::ThreadPoolInterface> thread_pool_;
 
   std::unique_ptr<PoseGraph> pose_graph_;
+  // nullptr if disabled.
+  std::unique_ptr<SubmapQueryCache> submap_query_cache_;
 
   std::unique_ptr<sensor::CollatorInterface> sensor_collator_;
-  std::vector<std::unique_ptr<mapping::TrajectoryBuilderInterface>>
-      trajectory_builders_;
+  // nullptr for trajectories added for deserialization.
+  std::vector<std::unique_ptr<CollatedTrajectoryBuilder>> trajectory_builders_;
+  // Guards modifications of 'all_trajectory_builder_options_' against
+  // copies made for serialization, which may run on another thread.
+  absl::Mutex all_trajectory_builder_options_mutex_;
   std::vector<proto::TrajectoryBuilderOptionsWithSensorIds>
       all_trajectory_builder_options_;
+
+  // The file written by the last checkpoint, what has been written to it and
+  // the size of its journal.
+  absl::Mutex checkpoint_mutex_;
+  std::string checkpoint_filename_ GUARDED_BY(checkpoint_mutex_);
+  io::SerializationCheckpoint checkpoint_ GUARDED_BY(checkpoint_mutex_);
+  uint64 checkpoint_journal_size_ GUARDED_BY(checkpoint_mutex_) = 0;
 };
 
 std::unique_ptr<MapBuilderInterface> CreateMapBuilder(
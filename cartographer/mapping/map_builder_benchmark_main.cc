@@ -0,0 +1,313 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Replays a sensor log written by 'io::SensorLogWriter' through a 'MapBuilder'
+// as fast as possible and reports throughput, per-stage latencies taken from
+// the metrics, and peak memory as JSON, so that runs can be compared.
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "cartographer/common/configuration_file_resolver.h"
+#include "cartographer/common/lua_parameter_dictionary.h"
+#include "cartographer/io/proto_stream.h"
+#include "cartographer/io/sensor_log.h"
+#include "cartographer/mapping/map_builder.h"
+#include "cartographer/mapping/trajectory_builder_interface.h"
+#include "cartographer/metrics/family_factory.h"
+#include "cartographer/metrics/register.h"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+DEFINE_string(configuration_directory, "",
+              "First directory in which configuration files are searched, "
+              "second is always the Cartographer installation to allow "
+              "including files from there.");
+DEFINE_string(configuration_basename, "",
+              "Basename, i.e. not containing any directory prefix, of the "
+              "configuration file. It must contain a 'map_builder' table and "
+              "may contain a 'trajectory_builder' table which replaces the "
+              "trajectory builder options recorded in the sensor log.");
+DEFINE_string(sensor_log_filename, "",
+              "Sensor log written by 'io::SensorLogWriter' to replay.");
+DEFINE_string(output_filename, "",
+              "File to write the JSON report to. Standard output if empty.");
+DEFINE_string(save_state_filename, "",
+              "If non-empty, the state after the final optimization is "
+              "written to this pbstream file, e.g. to compare the maps of a "
+              "parameter sweep.");
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+// Keeps every observed value, so that exact percentiles can be reported.
+class RecordingHistogram : public metrics::Histogram {
+ public:
+  void Observe(double value) override {
+    absl::MutexLock lock(&mutex_);
+    values_.push_back(value);
+  }
+
+  std::vector<double> values() const {
+    absl::MutexLock lock(&mutex_);
+    return values_;
+  }
+
+ private:
+  mutable absl::Mutex mutex_;
+  std::vector<double> values_ GUARDED_BY(mutex_);
+};
+
+class RecordingHistogramFamily : public metrics::Family<metrics::Histogram> {
+ public:
+  explicit RecordingHistogramFamily(const std::string& name) : name_(name) {}
+
+  metrics::Histogram* Add(
+      const std::map<std::string, std::string>& labels) override {
+    std::string key = name_;
+    if (!labels.empty()) {
+      key += "{";
+      for (auto it = labels.begin(); it != labels.end(); ++it) {
+        if (it != labels.begin()) key += ",";
+        key += it->first + "=" + it->second;
+      }
+      key += "}";
+    }
+    auto& histogram = histograms_[key];
+    if (histogram == nullptr) {
+      histogram = absl::make_unique<RecordingHistogram>();
+    }
+    return histogram.get();
+  }
+
+  const std::map<std::string, std::unique_ptr<RecordingHistogram>>&
+  histograms() const {
+    return histograms_;
+  }
+
+ private:
+  const std::string name_;
+  std::map<std::string, std::unique_ptr<RecordingHistogram>> histograms_;
+};
+
+// Records histograms only, counters and gauges are dropped.
+class RecordingFamilyFactory : public metrics::FamilyFactory {
+ public:
+  metrics::Family<metrics::Counter>* NewCounterFamily(
+      const std::string& name, const std::string& description) override {
+    return metrics::Family<metrics::Counter>::Null();
+  }
+  metrics::Family<metrics::Gauge>* NewGaugeFamily(
+      const std::string& name, const std::string& description) override {
+    return metrics::Family<metrics::Gauge>::Null();
+  }
+  metrics::Family<metrics::Histogram>* NewHistogramFamily(
+      const std::string& name, const std::string& description,
+      const metrics::Histogram::BucketBoundaries& boundaries) override {
+    histogram_families_.push_back(
+        absl::make_unique<RecordingHistogramFamily>(name));
+    return histogram_families_.back().get();
+  }
+
+  const std::vector<std::unique_ptr<RecordingHistogramFamily>>&
+  histogram_families() const {
+    return histogram_families_;
+  }
+
+ private:
+  std::vector<std::unique_ptr<RecordingHistogramFamily>> histogram_families_;
+};
+
+// Returns the value below which 'percentile' percent of the sorted 'values'
+// lie.
+double Percentile(const std::vector<double>& values, const double percentile) {
+  const size_t index = std::min(
+      values.size() - 1,
+      static_cast<size_t>(percentile / 100. * values.size()));
+  return values[index];
+}
+
+void WriteHistogram(std::vector<double> values, std::ostream* out) {
+  std::sort(values.begin(), values.end());
+  double sum = 0.;
+  for (const double value : values) sum += value;
+  *out << "{\"count\": " << values.size()
+       << ", \"mean\": " << sum / values.size()
+       << ", \"p50\": " << Percentile(values, 50.)
+       << ", \"p90\": " << Percentile(values, 90.)
+       << ", \"p99\": " << Percentile(values, 99.)
+       << ", \"max\": " << values.back() << "}";
+}
+
+void Run(const std::string& configuration_directory,
+         const std::string& configuration_basename,
+         const std::string& sensor_log_filename,
+         const std::string& output_filename,
+         const std::string& save_state_filename) {
+  RecordingFamilyFactory family_factory;
+  metrics::RegisterAllMetrics(&family_factory);
+
+  auto file_resolver = absl::make_unique<common::ConfigurationFileResolver>(
+      std::vector<std::string>{configuration_directory});
+  const std::string code =
+      file_resolver->GetFileContentOrDie(configuration_basename);
+  common::LuaParameterDictionary lua_parameter_dictionary(
+      code, std::move(file_resolver));
+
+  io::ProtoStreamReader reader(sensor_log_filename);
+  io::SensorLogReader sensor_log_reader(&reader);
+  const proto::TrajectoryBuilderOptionsWithSensorIds& recorded_options =
+      sensor_log_reader.header().trajectory_builder_options();
+  std::set<TrajectoryBuilderInterface::SensorId> expected_sensor_ids;
+  for (const proto::SensorId& sensor_id : recorded_options.sensor_id()) {
+    expected_sensor_ids.insert(FromProto(sensor_id));
+  }
+  const proto::TrajectoryBuilderOptions trajectory_builder_options =
+      lua_parameter_dictionary.HasKey("trajectory_builder")
+          ? CreateTrajectoryBuilderOptions(
+                lua_parameter_dictionary.GetDictionary("trajectory_builder")
+                    .get())
+          : recorded_options.trajectory_builder_options();
+
+  auto map_builder = CreateMapBuilder(CreateMapBuilderOptions(
+      lua_parameter_dictionary.GetDictionary("map_builder").get()));
+  int num_local_slam_results = 0;
+  int num_nodes = 0;
+  const int trajectory_id = map_builder->AddTrajectoryBuilder(
+      expected_sensor_ids, trajectory_builder_options,
+      [&num_local_slam_results, &num_nodes](
+          const int, const common::Time, const transform::Rigid3d,
+          const sensor::RangeData,
+          std::unique_ptr<
+              const TrajectoryBuilderInterface::InsertionResult>
+              insertion_result) {
+        ++num_local_slam_results;
+        if (insertion_result != nullptr) ++num_nodes;
+      });
+  TrajectoryBuilderInterface* const trajectory_builder =
+      map_builder->GetTrajectoryBuilder(trajectory_id);
+
+  const auto wall_time_start = std::chrono::steady_clock::now();
+  int num_sensor_data = 0;
+  int num_range_data = 0;
+  common::Time first_time = common::Time::max();
+  common::Time last_time = common::Time::min();
+  io::proto::SensorLogEntry entry;
+  while (sensor_log_reader.ReadEntry(&entry)) {
+    const common::Time time = io::AddSensorLogEntry(entry, trajectory_builder);
+    first_time = std::min(first_time, time);
+    last_time = std::max(last_time, time);
+    ++num_sensor_data;
+    if (entry.has_timed_point_cloud_data()) ++num_range_data;
+  }
+  map_builder->FinishTrajectory(trajectory_id);
+  const auto wall_time_replayed = std::chrono::steady_clock::now();
+  map_builder->pose_graph()->RunFinalOptimization();
+  const auto wall_time_end = std::chrono::steady_clock::now();
+  CHECK_GT(num_sensor_data, 0) << "Sensor log '" << sensor_log_filename
+                               << "' is empty.";
+  if (!save_state_filename.empty()) {
+    CHECK(map_builder->SerializeStateToFile(
+        true /* include_unfinished_submaps */, save_state_filename))
+        << "Could not write '" << save_state_filename << "'.";
+  }
+
+  const double wall_time = common::ToSeconds(wall_time_end - wall_time_start);
+  const double replay_wall_time =
+      common::ToSeconds(wall_time_replayed - wall_time_start);
+  const double sensor_time = common::ToSeconds(last_time - first_time);
+  struct rusage usage;
+  CHECK_EQ(getrusage(RUSAGE_SELF, &usage), 0);
+
+  std::ostringstream report;
+  report << "{\n"
+         << "  \"sensor_log\": \"" << sensor_log_filename << "\",\n"
+         << "  \"num_sensor_data\": " << num_sensor_data << ",\n"
+         << "  \"num_range_data\": " << num_range_data << ",\n"
+         << "  \"num_local_slam_results\": " << num_local_slam_results
+         << ",\n"
+         << "  \"num_nodes\": " << num_nodes << ",\n"
+         << "  \"sensor_time_seconds\": " << sensor_time << ",\n"
+         << "  \"replay_wall_time_seconds\": " << replay_wall_time << ",\n"
+         << "  \"final_optimization_wall_time_seconds\": "
+         << common::ToSeconds(wall_time_end - wall_time_replayed) << ",\n"
+         << "  \"wall_time_seconds\": " << wall_time << ",\n"
+         << "  \"real_time_factor\": " << sensor_time / wall_time << ",\n"
+         << "  \"range_data_per_second\": " << num_range_data / wall_time
+         << ",\n"
+         << "  \"nodes_per_second\": " << num_nodes / wall_time << ",\n"
+         // 'ru_maxrss' is in kilobytes on Linux.
+         << "  \"peak_rss_bytes\": " << usage.ru_maxrss * 1024 << ",\n"
+         << "  \"histograms\": {";
+  bool first_histogram = true;
+  for (const auto& family : family_factory.histogram_families()) {
+    for (const auto& key_and_histogram : family->histograms()) {
+      const std::vector<double> values = key_and_histogram.second->values();
+      if (values.empty()) continue;
+      report << (first_histogram ? "\n" : ",\n") << "    \""
+             << key_and_histogram.first << "\": ";
+      WriteHistogram(values, &report);
+      first_histogram = false;
+    }
+  }
+  report << "\n  }\n}\n";
+
+  if (output_filename.empty()) {
+    std::cout << report.str();
+  } else {
+    std::ofstream output(output_filename);
+    output << report.str();
+    output.close();
+    CHECK(output) << "Could not write '" << output_filename << "'.";
+  }
+}
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  FLAGS_logtostderr = true;
+  google::SetUsageMessage(
+      "\n\n"
+      "Replays a sensor log through a MapBuilder and reports throughput, "
+      "latencies and peak memory as JSON.\n");
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  if (FLAGS_configuration_directory.empty() ||
+      FLAGS_configuration_basename.empty() ||
+      FLAGS_sensor_log_filename.empty()) {
+    google::ShowUsageWithFlagsRestrict(argv[0], "map_builder_benchmark_main");
+    return EXIT_FAILURE;
+  }
+  ::cartographer::mapping::Run(
+      FLAGS_configuration_directory, FLAGS_configuration_basename,
+      FLAGS_sensor_log_filename, FLAGS_output_filename,
+      FLAGS_save_state_filename);
+}
@@ -16,6 +16,7 @@
 
 #include "cartographer/mapping/map_builder_interface.h"
 
+#include "cartographer/common/port.h"
 #include "cartographer/mapping/pose_graph.h"
 
 namespace cartographer {
@@ -30,8 +31,26 @@ proto::MapBuilderOptions CreateMapBuilderOptions(
       parameter_dictionary->GetBool("use_trajectory_builder_3d"));
   options.set_num_background_threads(
       parameter_dictionary->GetNonNegativeInt("num_background_threads"));
+  options.set_use_work_stealing_thread_pool(
+      parameter_dictionary->GetBool("use_work_stealing_thread_pool"));
+  options.set_numa_aware_work_stealing_thread_pool(
+      parameter_dictionary->GetBool("numa_aware_work_stealing_thread_pool"));
+  options.set_background_threads_nice_increment(
+      parameter_dictionary->GetInt("background_threads_nice_increment"));
+  for (const double cpu_id :
+       parameter_dictionary->GetDictionary("background_threads_cpu_ids")
+           ->GetArrayValuesAsDoubles()) {
+    options.add_background_threads_cpu_ids(common::RoundToInt(cpu_id));
+  }
+  options.set_submap_query_cache_max_bytes(
+      parameter_dictionary->GetNonNegativeInt("submap_query_cache_max_bytes"));
   options.set_collate_by_trajectory(
       parameter_dictionary->GetBool("collate_by_trajectory"));
+  options.set_use_trajectory_ingestion_threads(
+      parameter_dictionary->GetBool("use_trajectory_ingestion_threads"));
+  options.set_collator_max_lag_seconds(
+      parameter_dictionary->GetDouble("collator_max_lag_seconds"));
+  CHECK_GE(options.collator_max_lag_seconds(), 0.);
   *options.mutable_pose_graph_options() = CreatePoseGraphOptions(
       parameter_dictionary->GetDictionary("pose_graph").get());
   CHECK_NE(options.use_trajectory_builder_2d(),
@@ -93,9 +93,20 @@ class MapBuilderInterface {
   // submaps that have not yet received all rangefinder data insertions, will
   // be included in the serialized state.
   // Returns true if the file was successfully written.
+  //
+  // Unless 'include_unfinished_submaps' is set, both serialization methods may
+  // be called while sensor data is added on another thread.
   virtual bool SerializeStateToFile(bool include_unfinished_submaps,
                                     const std::string& filename) = 0;
 
+  // Writes a checkpoint of the current state to 'filename'. The first
+  // checkpoint to a file writes the complete state like
+  // SerializeStateToFile(), later ones only append what changed since the
+  // previous checkpoint to a journal next to it, which LoadStateFromFile()
+  // replays. Returns true if the checkpoint was successfully written.
+  virtual bool WriteCheckpoint(bool include_unfinished_submaps,
+                               const std::string& filename) = 0;
+
   // Loads the SLAM state from a proto stream. Returns the remapping of new
   // trajectory_ids.
   virtual std::map<int /* trajectory id in proto */, int /* trajectory id */>
@@ -16,9 +16,15 @@
 
 #include "cartographer/mapping/map_builder.h"
 
+#include <cstdio>
+#include <map>
+
+#include "absl/synchronization/mutex.h"
 #include "cartographer/common/config.h"
+#include "cartographer/io/internal/checkpoint_journal.h"
 #include "cartographer/io/proto_stream.h"
 #include "cartographer/mapping/2d/grid_2d.h"
+#include "cartographer/mapping/internal/2d/pose_graph_2d.h"
 #include "cartographer/mapping/internal/testing/test_helpers.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -214,6 +220,48 @@ TEST_F(MapBuilderTest, LocalSlam3D) {
               0.1 * kTravelDistance);
 }
 
+TEST_F(MapBuilderTest, LocalSlam2DWithIngestionThreads) {
+  map_builder_options_.set_collate_by_trajectory(true);
+  map_builder_options_.set_use_trajectory_ingestion_threads(true);
+  BuildMapBuilder();
+  // The callbacks of both trajectories run in their ingestion threads.
+  absl::Mutex mutex;
+  std::map<int, std::vector<transform::Rigid3d>> local_slam_result_poses;
+  const auto callback =
+      [&mutex, &local_slam_result_poses](
+          const int trajectory_id, const common::Time,
+          const transform::Rigid3d local_pose, sensor::RangeData,
+          const std::unique_ptr<
+              const TrajectoryBuilderInterface::InsertionResult>) {
+        absl::MutexLock locker(&mutex);
+        local_slam_result_poses[trajectory_id].push_back(local_pose);
+      };
+  const int trajectory_id_a = map_builder_->AddTrajectoryBuilder(
+      {kRangeSensorId}, trajectory_builder_options_, callback);
+  const int trajectory_id_b = map_builder_->AddTrajectoryBuilder(
+      {kRangeSensorId}, trajectory_builder_options_, callback);
+  const auto measurements = testing::GenerateFakeRangeMeasurements(
+      kTravelDistance, kDuration, kTimeStep);
+  for (const auto& measurement : measurements) {
+    map_builder_->GetTrajectoryBuilder(trajectory_id_a)
+        ->AddSensorData(kRangeSensorId.id, measurement);
+    map_builder_->GetTrajectoryBuilder(trajectory_id_b)
+        ->AddSensorData(kRangeSensorId.id, measurement);
+  }
+  map_builder_->FinishTrajectory(trajectory_id_a);
+  map_builder_->FinishTrajectory(trajectory_id_b);
+  map_builder_->pose_graph()->RunFinalOptimization();
+  absl::MutexLock locker(&mutex);
+  for (const int trajectory_id : {trajectory_id_a, trajectory_id_b}) {
+    const auto& poses = local_slam_result_poses[trajectory_id];
+    ASSERT_EQ(poses.size(), measurements.size());
+    EXPECT_NEAR(kTravelDistance,
+                (poses.back().translation() - poses.front().translation())
+                    .norm(),
+                0.1 * kTravelDistance);
+  }
+}
+
 TEST_P(MapBuilderTestByGridType, GlobalSlam2D) {
   if (GetParam() == GridType::TSDF) SetOptionsToTSDF2D();
   SetOptionsEnableGlobalOptimization();
@@ -364,8 +412,12 @@ TEST_P(MapBuilderTestByGridTypeAndDimensions, SaveLoadState) {
   int num_nodes =
       map_builder_->pose_graph()->GetTrajectoryNodes().SizeOfTrajectoryOrZero(
           trajectory_id);
+  int num_submaps =
+      map_builder_->pose_graph()->GetAllSubmapData().SizeOfTrajectoryOrZero(
+          trajectory_id);
   EXPECT_GT(num_constraints, 0);
   EXPECT_GT(num_nodes, 0);
+  EXPECT_GT(num_submaps, 0);
   // TODO(gaschler): Consider using in-memory to avoid side effects.
   const std::string filename = "temp-SaveLoadState.pbstream";
   io::ProtoStreamWriter writer(filename);
@@ -385,6 +437,110 @@ TEST_P(MapBuilderTestByGridTypeAndDimensions, SaveLoadState) {
       num_nodes,
       map_builder_->pose_graph()->GetTrajectoryNodes().SizeOfTrajectoryOrZero(
           new_trajectory_id));
+  EXPECT_EQ(
+      num_submaps,
+      map_builder_->pose_graph()->GetAllSubmapData().SizeOfTrajectoryOrZero(
+          new_trajectory_id));
+}
+
+TEST_F(MapBuilderTest, WriteCheckpointsAndLoadState) {
+  BuildMapBuilder();
+  int trajectory_id = map_builder_->AddTrajectoryBuilder(
+      {kRangeSensorId}, trajectory_builder_options_,
+      GetLocalSlamResultCallback());
+  TrajectoryBuilderInterface* trajectory_builder =
+      map_builder_->GetTrajectoryBuilder(trajectory_id);
+  const auto measurements = testing::GenerateFakeRangeMeasurements(
+      kTravelDistance, kDuration, kTimeStep);
+  const std::string filename = "temp-WriteCheckpoints.pbstream";
+  for (size_t i = 0; i < measurements.size(); ++i) {
+    trajectory_builder->AddSensorData(kRangeSensorId.id, measurements[i]);
+    if (i == measurements.size() / 2) {
+      EXPECT_TRUE(map_builder_->WriteCheckpoint(
+          /*include_unfinished_submaps=*/true, filename));
+    }
+  }
+  map_builder_->FinishTrajectory(trajectory_id);
+  map_builder_->pose_graph()->RunFinalOptimization();
+  EXPECT_TRUE(map_builder_->WriteCheckpoint(
+      /*include_unfinished_submaps=*/true, filename));
+  int num_constraints = map_builder_->pose_graph()->constraints().size();
+  int num_nodes =
+      map_builder_->pose_graph()->GetTrajectoryNodes().SizeOfTrajectoryOrZero(
+          trajectory_id);
+  int num_submaps =
+      map_builder_->pose_graph()->GetAllSubmapData().SizeOfTrajectoryOrZero(
+          trajectory_id);
+
+  // Reset 'map_builder_'.
+  BuildMapBuilder();
+  auto trajectory_remapping = map_builder_->LoadStateFromFile(
+      filename, false /* load_frozen_state */);
+  map_builder_->pose_graph()->RunFinalOptimization();
+  EXPECT_EQ(num_constraints, map_builder_->pose_graph()->constraints().size());
+  ASSERT_EQ(trajectory_remapping.size(), 1);
+  int new_trajectory_id = trajectory_remapping.begin()->second;
+  EXPECT_EQ(
+      num_nodes,
+      map_builder_->pose_graph()->GetTrajectoryNodes().SizeOfTrajectoryOrZero(
+          new_trajectory_id));
+  EXPECT_EQ(
+      num_submaps,
+      map_builder_->pose_graph()->GetAllSubmapData().SizeOfTrajectoryOrZero(
+          new_trajectory_id));
+  remove(io::CheckpointJournalFilename(filename).c_str());
+  remove(filename.c_str());
+}
+
+TEST_F(MapBuilderTest, LoadStatesFromFilesAndMergeThem2D) {
+  BuildMapBuilder();
+  const int trajectory_id = CreateTrajectoryWithFakeData();
+  map_builder_->pose_graph()->RunFinalOptimization();
+  const int num_nodes =
+      map_builder_->pose_graph()->GetTrajectoryNodes().SizeOfTrajectoryOrZero(
+          trajectory_id);
+  const int num_submaps =
+      map_builder_->pose_graph()->GetAllSubmapData().SizeOfTrajectoryOrZero(
+          trajectory_id);
+  const std::string filename = "temp-LoadStatesFromFiles.pbstream";
+  EXPECT_TRUE(map_builder_->SerializeStateToFile(
+      /*include_unfinished_submaps=*/true, filename));
+
+  // Reset 'map_builder_' and load the same map twice.
+  BuildMapBuilder();
+  const std::vector<std::map<int, int>> trajectory_remappings =
+      static_cast<MapBuilder*>(map_builder_.get())
+          ->LoadStatesFromFiles({filename, filename},
+                                false /* load_frozen_state */);
+  ASSERT_EQ(trajectory_remappings.size(), 2);
+  EXPECT_EQ(trajectory_remappings[0].at(trajectory_id), 0);
+  EXPECT_EQ(trajectory_remappings[1].at(trajectory_id), 1);
+  auto* const pose_graph =
+      static_cast<PoseGraph2D*>(map_builder_->pose_graph());
+  PoseGraph2D::CrossTrajectorySearchOptions search_options;
+  search_options.node_stride = 4;
+  pose_graph->SearchCrossTrajectoryConstraints(search_options);
+  // Completes only if the searches did not count loaded nodes as finished.
+  pose_graph->RunFinalOptimization();
+  EXPECT_EQ(pose_graph->GetTrajectoryNodes().size(),
+            static_cast<size_t>(2 * num_nodes));
+  for (const int new_trajectory_id : {0, 1}) {
+    EXPECT_EQ(num_nodes,
+              pose_graph->GetTrajectoryNodes().SizeOfTrajectoryOrZero(
+                  new_trajectory_id));
+    EXPECT_EQ(num_submaps,
+              pose_graph->GetAllSubmapData().SizeOfTrajectoryOrZero(
+                  new_trajectory_id));
+  }
+  int num_cross_trajectory_constraints = 0;
+  for (const auto& constraint : pose_graph->constraints()) {
+    if (constraint.node_id.trajectory_id !=
+        constraint.submap_id.trajectory_id) {
+      ++num_cross_trajectory_constraints;
+    }
+  }
+  EXPECT_GT(num_cross_trajectory_constraints, 0);
+  remove(filename.c_str());
 }
 
 TEST_P(MapBuilderTestByGridType, LocalizationOnFrozenTrajectory2D) {
@@ -25,6 +25,33 @@
 namespace cartographer {
 namespace mapping {
 
+PoseExtrapolationSnapshot::PoseExtrapolationSnapshot(
+    const common::Time pose_time, const transform::Rigid3d& pose,
+    const Eigen::Quaterniond& orientation_at_pose_time,
+    const Eigen::Vector3d& linear_velocity, const ImuTracker& imu_tracker,
+    const bool use_fake_gravity)
+    : pose_time_(pose_time),
+      pose_(pose),
+      orientation_at_pose_time_inverse_(orientation_at_pose_time.inverse()),
+      linear_velocity_(linear_velocity),
+      imu_tracker_(imu_tracker),
+      use_fake_gravity_(use_fake_gravity) {}
+
+transform::Rigid3d PoseExtrapolationSnapshot::ExtrapolatePose(
+    const common::Time time) const {
+  CHECK_GE(time, imu_tracker_.time());
+  ImuTracker imu_tracker = imu_tracker_;
+  imu_tracker.Advance(time);
+  if (use_fake_gravity_) {
+    imu_tracker.AddImuLinearAccelerationObservation(Eigen::Vector3d::UnitZ());
+  }
+  return transform::Rigid3d(
+      pose_.translation() +
+          common::ToSeconds(time - pose_time_) * linear_velocity_,
+      pose_.rotation() * orientation_at_pose_time_inverse_ *
+          imu_tracker.orientation());
+}
+
 PoseExtrapolator::PoseExtrapolator(const common::Duration pose_queue_duration,
                                    double imu_gravity_time_constant)
     : pose_queue_duration_(pose_queue_duration),
@@ -86,6 +113,16 @@ void PoseExtrapolator::AddPose(const common::Time time,
   TrimOdometryData();
   odometry_imu_tracker_ = absl::make_unique<ImuTracker>(*imu_tracker_);
   extrapolation_imu_tracker_ = absl::make_unique<ImuTracker>(*imu_tracker_);
+  snapshot_imu_tracker_ = absl::make_unique<ImuTracker>(*imu_tracker_);
+  for (auto it = std::lower_bound(
+           imu_data_.begin(), imu_data_.end(), time,
+           [](const sensor::ImuData& imu_data, const common::Time& time) {
+             return imu_data.time < time;
+           });
+       it != imu_data_.end(); ++it) {
+    AddImuDataToSnapshotImuTracker(*it);
+  }
+  snapshot_.reset();
 }
 
 void PoseExtrapolator::AddImuData(const sensor::ImuData& imu_data) {
@@ -93,6 +130,11 @@ void PoseExtrapolator::AddImuData(const sensor::ImuData& imu_data) {
         imu_data.time >= timed_pose_queue_.back().time);
   imu_data_.push_back(imu_data);
   TrimImuData();
+  if (snapshot_imu_tracker_ != nullptr &&
+      imu_data.time >= snapshot_imu_tracker_->time()) {
+    AddImuDataToSnapshotImuTracker(imu_data);
+  }
+  snapshot_.reset();
 }
 
 void PoseExtrapolator::AddOdometryData(
@@ -101,6 +143,7 @@ void PoseExtrapolator::AddOdometryData(
         odometry_data.time >= timed_pose_queue_.back().time);
   odometry_data_.push_back(odometry_data);
   TrimOdometryData();
+  snapshot_.reset();
   if (odometry_data_.size() < 2) {
     return;
   }
@@ -153,6 +196,19 @@ Eigen::Quaterniond PoseExtrapolator::EstimateGravityOrientation(
   return imu_tracker.orientation();
 }
 
+std::shared_ptr<const PoseExtrapolationSnapshot>
+PoseExtrapolator::GetSnapshot() {
+  if (snapshot_ == nullptr && !timed_pose_queue_.empty()) {
+    const TimedPose& newest_timed_pose = timed_pose_queue_.back();
+    // Without IMU data, ExtrapolatePose() adds fake gravity after advancing.
+    snapshot_ = std::make_shared<const PoseExtrapolationSnapshot>(
+        newest_timed_pose.time, newest_timed_pose.pose,
+        imu_tracker_->orientation(), CurrentLinearVelocity(),
+        *snapshot_imu_tracker_, imu_data_.empty());
+  }
+  return snapshot_;
+}
+
 void PoseExtrapolator::UpdateVelocitiesFromPoses() {
   if (timed_pose_queue_.size() < 2) {
     // We need two poses to estimate velocities.
@@ -224,6 +280,20 @@ void PoseExtrapolator::AdvanceImuTracker(const common::Time time,
   imu_tracker->Advance(time);
 }
 
+void PoseExtrapolator::AddImuDataToSnapshotImuTracker(
+    const sensor::ImuData& imu_data) {
+  snapshot_imu_tracker_->Advance(imu_data.time);
+  snapshot_imu_tracker_->AddImuLinearAccelerationObservation(
+      imu_data.linear_acceleration);
+  snapshot_imu_tracker_->AddImuAngularVelocityObservation(
+      imu_data.angular_velocity);
+}
+
+Eigen::Vector3d PoseExtrapolator::CurrentLinearVelocity() const {
+  return odometry_data_.size() < 2 ? linear_velocity_from_poses_
+                                   : linear_velocity_from_odometry_;
+}
+
 Eigen::Quaterniond PoseExtrapolator::ExtrapolateRotation(
     const common::Time time, ImuTracker* const imu_tracker) const {
   CHECK_GE(time, imu_tracker->time());
@@ -236,10 +306,7 @@ Eigen::Vector3d PoseExtrapolator::ExtrapolateTranslation(common::Time time) {
   const TimedPose& newest_timed_pose = timed_pose_queue_.back();
   const double extrapolation_delta =
       common::ToSeconds(time - newest_timed_pose.time);
-  if (odometry_data_.size() < 2) {
-    return extrapolation_delta * linear_velocity_from_poses_;
-  }
-  return extrapolation_delta * linear_velocity_from_odometry_;
+  return extrapolation_delta * CurrentLinearVelocity();
 }
 
 PoseExtrapolator::ExtrapolationResult
@@ -250,11 +317,8 @@ PoseExtrapolator::ExtrapolatePosesWithGravity(
     poses.push_back(ExtrapolatePose(*it).cast<float>());
   }
 
-  const Eigen::Vector3d current_velocity = odometry_data_.size() < 2
-                                               ? linear_velocity_from_poses_
-                                               : linear_velocity_from_odometry_;
   return ExtrapolationResult{poses, ExtrapolatePose(times.back()),
-                             current_velocity,
+                             CurrentLinearVelocity(),
                              EstimateGravityOrientation(times.back())};
 }
 
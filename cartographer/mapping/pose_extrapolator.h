@@ -30,6 +30,36 @@
 namespace cartographer {
 namespace mapping {
 
+// State of a PoseExtrapolator after the data added to it so far. Poses are
+// extrapolated from it in constant time and without touching the extrapolator,
+// so snapshots can be handed to other threads.
+class PoseExtrapolationSnapshot {
+ public:
+  PoseExtrapolationSnapshot(common::Time pose_time,
+                            const transform::Rigid3d& pose,
+                            const Eigen::Quaterniond& orientation_at_pose_time,
+                            const Eigen::Vector3d& linear_velocity,
+                            const ImuTracker& imu_tracker,
+                            bool use_fake_gravity);
+
+  // Poses can be extrapolated to this time or later. It is the time of the
+  // newest pose or IMU data.
+  common::Time time() const { return imu_tracker_.time(); }
+
+  // Returns what the first PoseExtrapolator::ExtrapolatePose() after the data
+  // in this snapshot would return for 'time'.
+  transform::Rigid3d ExtrapolatePose(common::Time time) const;
+
+ private:
+  const common::Time pose_time_;
+  const transform::Rigid3d pose_;
+  const Eigen::Quaterniond orientation_at_pose_time_inverse_;
+  const Eigen::Vector3d linear_velocity_;
+  // Tracks the orientation through all IMU data after 'pose_time_'.
+  const ImuTracker imu_tracker_;
+  const bool use_fake_gravity_;
+};
+
 // Keep poses for a certain duration to estimate linear and angular velocity.
 // Uses the velocities to extrapolate motion. Uses IMU and/or odometry data if
 // available to improve the extrapolation.
@@ -62,11 +92,17 @@ class PoseExtrapolator : public PoseExtrapolatorInterface {
   // the tracking frame into a gravity aligned frame.
   Eigen::Quaterniond EstimateGravityOrientation(common::Time time) override;
 
+  // Returns a snapshot of the current state which stays valid until more data
+  // is added, or nullptr if no pose was added yet.
+  std::shared_ptr<const PoseExtrapolationSnapshot> GetSnapshot();
+
  private:
   void UpdateVelocitiesFromPoses();
   void TrimImuData();
   void TrimOdometryData();
   void AdvanceImuTracker(common::Time time, ImuTracker* imu_tracker) const;
+  void AddImuDataToSnapshotImuTracker(const sensor::ImuData& imu_data);
+  Eigen::Vector3d CurrentLinearVelocity() const;
   Eigen::Quaterniond ExtrapolateRotation(common::Time time,
                                          ImuTracker* imu_tracker) const;
   Eigen::Vector3d ExtrapolateTranslation(common::Time time);
@@ -86,6 +122,10 @@ class PoseExtrapolator : public PoseExtrapolatorInterface {
   std::unique_ptr<ImuTracker> odometry_imu_tracker_;
   std::unique_ptr<ImuTracker> extrapolation_imu_tracker_;
   TimedPose cached_extrapolated_pose_;
+  // Advanced through every IMU data as it is added after the newest pose.
+  std::unique_ptr<ImuTracker> snapshot_imu_tracker_;
+  // Built lazily and reset whenever data is added.
+  std::shared_ptr<const PoseExtrapolationSnapshot> snapshot_;
 
   std::deque<sensor::OdometryData> odometry_data_;
   Eigen::Vector3d linear_velocity_from_odometry_ = Eigen::Vector3d::Zero();
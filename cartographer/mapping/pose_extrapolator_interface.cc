@@ -59,6 +59,8 @@ proto::ImuBasedPoseExtrapolatorOptions CreateImuBasedPoseExtrapolatorOptions(
       parameter_dictionary->GetDouble("odometry_translation_weight"));
   *options.mutable_solver_options() = CreateCeresSolverOptionsProto(
       parameter_dictionary->GetDictionary("solver_options").get());
+  options.set_solve_every_n_poses(
+      parameter_dictionary->GetNonNegativeInt("solve_every_n_poses"));
 
   return options;
 }
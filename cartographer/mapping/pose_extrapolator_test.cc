@@ -176,6 +176,66 @@ TEST(PoseExtrapolatorTest, ExtrapolateWithIMU) {
       kPrecision);
 }
 
+TEST(PoseExtrapolatorTest, SnapshotMatchesExtrapolatePose) {
+  Eigen::Vector3d gravity_acceleration(0.3, 0.1, 9.8);
+  Eigen::Vector3d angular_velocity(0.01, 0.02, 0.1);
+  common::Time current_time = common::FromUniversal(123);
+  auto extrapolator = PoseExtrapolator::InitializeWithImu(
+      common::FromSeconds(kPoseQueueDuration), kGravityTimeConstant,
+      sensor::ImuData{current_time, gravity_acceleration, angular_velocity});
+  transform::Rigid3d current_pose =
+      transform::Rigid3d::Translation(Eigen::Vector3d(0.3, 0.7, 0.2));
+  const transform::Rigid3d motion(
+      Eigen::Vector3d(0.05, 0.01, 0.), Eigen::Quaterniond(Eigen::AngleAxisd(
+                                           0.02, Eigen::Vector3d::UnitZ())));
+  for (int i = 0; i < 10; ++i) {
+    for (int j = 0; j < 5; ++j) {
+      current_time += common::FromSeconds(0.01);
+      extrapolator->AddImuData(sensor::ImuData{
+          current_time, gravity_acceleration, angular_velocity});
+    }
+    current_time += common::FromSeconds(0.005);
+    current_pose = current_pose * motion;
+    extrapolator->AddPose(current_time, current_pose);
+    for (int j = 0; j < 3; ++j) {
+      current_time += common::FromSeconds(0.01);
+      extrapolator->AddImuData(sensor::ImuData{
+          current_time, gravity_acceleration, angular_velocity});
+    }
+    const auto snapshot = extrapolator->GetSnapshot();
+    ASSERT_NE(snapshot, nullptr);
+    EXPECT_EQ(snapshot, extrapolator->GetSnapshot());
+    EXPECT_EQ(common::ToUniversal(snapshot->time()),
+              common::ToUniversal(current_time));
+    const common::Time query_time = current_time + common::FromSeconds(0.003);
+    EXPECT_THAT(snapshot->ExtrapolatePose(query_time),
+                transform::IsNearly(extrapolator->ExtrapolatePose(query_time),
+                                    kPrecision));
+  }
+}
+
+TEST(PoseExtrapolatorTest, SnapshotMatchesExtrapolatePoseWithoutImu) {
+  PoseExtrapolator extrapolator(common::FromSeconds(kPoseQueueDuration),
+                                kGravityTimeConstant);
+  EXPECT_EQ(extrapolator.GetSnapshot(), nullptr);
+  common::Time current_time = common::FromUniversal(123);
+  transform::Rigid3d current_pose =
+      transform::Rigid3d::Translation(Eigen::Vector3d(0.3, 0.7, 0.2));
+  const transform::Rigid3d motion(
+      Eigen::Vector3d(0.05, 0.01, 0.), Eigen::Quaterniond(Eigen::AngleAxisd(
+                                           0.02, Eigen::Vector3d::UnitZ())));
+  for (int i = 0; i < 10; ++i) {
+    current_time += common::FromSeconds(0.1);
+    current_pose = current_pose * motion;
+    extrapolator.AddPose(current_time, current_pose);
+    const auto snapshot = extrapolator.GetSnapshot();
+    const common::Time query_time = current_time + common::FromSeconds(0.05);
+    EXPECT_THAT(snapshot->ExtrapolatePose(query_time),
+                transform::IsNearly(extrapolator.ExtrapolatePose(query_time),
+                                    kPrecision));
+  }
+}
+
 }  // namespace
 }  // namespace mapping
 }  // namespace cartographer
@@ -110,6 +110,23 @@ proto::PoseGraphOptions CreatePoseGraphOptions(
   options.set_global_constraint_search_after_n_seconds(
       parameter_dictionary->GetDouble(
           "global_constraint_search_after_n_seconds"));
+  options.set_compact_loaded_submaps(
+      parameter_dictionary->GetBool("compact_loaded_submaps"));
+  options.set_lazy_load_frozen_submaps(
+      parameter_dictionary->GetBool("lazy_load_frozen_submaps"));
+  options.set_max_work_queue_delay(
+      parameter_dictionary->GetDouble("max_work_queue_delay"));
+  options.set_min_load_shedding_factor(
+      parameter_dictionary->GetDouble("min_load_shedding_factor"));
+  options.set_finished_submap_intra_constraint_stride(
+      parameter_dictionary->GetNonNegativeInt(
+          "finished_submap_intra_constraint_stride"));
+  options.set_evicted_node_data_directory(
+      parameter_dictionary->GetString("evicted_node_data_directory"));
+  options.set_keep_node_data_every_n_nodes(
+      parameter_dictionary->GetNonNegativeInt("keep_node_data_every_n_nodes"));
+  options.set_optimized_pose_table_name(
+      parameter_dictionary->GetString("optimized_pose_table_name"));
   PopulateOverlappingSubmapsTrimmerOptions2D(&options, parameter_dictionary);
   return options;
 }
@@ -91,6 +91,24 @@ class PoseGraph : public PoseGraphInterface {
   virtual void AddNodeFromProto(const transform::Rigid3d& global_pose,
                                 const proto::Node& node) = 0;
 
+  // Converts 'submap' into the submap type of this pose graph, or returns
+  // nullptr if 'submap' does not contain one. Thread-safe, so that submaps can
+  // be converted in parallel before being added in order.
+  virtual std::shared_ptr<const Submap> SubmapFromProto(
+      const proto::Submap& submap) = 0;
+
+  // Adds a 'submap' converted by SubmapFromProto() with the given
+  // 'global_pose'. Does nothing if 'submap' is nullptr.
+  virtual void AddSubmapFromProto(const transform::Rigid3d& global_pose,
+                                  const SubmapId& submap_id,
+                                  std::shared_ptr<const Submap> submap) = 0;
+
+  // Adds a node with already converted 'constant_data' and the given
+  // 'global_pose'.
+  virtual void AddNodeFromProto(
+      const transform::Rigid3d& global_pose, const NodeId& node_id,
+      std::shared_ptr<const TrajectoryNode::Data> constant_data) = 0;
+
   // Sets the trajectory data from a proto.
   virtual void SetTrajectoryDataFromProto(
       const mapping::proto::TrajectoryData& data) = 0;
@@ -18,9 +18,11 @@
 #define CARTOGRAPHER_MAPPING_POSE_GRAPH_INTERFACE_H_
 
 #include <chrono>
+#include <memory>
 #include <vector>
 
 #include "absl/types/optional.h"
+#include "cartographer/common/port.h"
 #include "cartographer/mapping/id.h"
 #include "cartographer/mapping/submaps.h"
 #include "cartographer/transform/rigid_transform.h"
@@ -52,6 +54,12 @@ class PoseGraphInterface {
     enum Tag { INTRA_SUBMAP, INTER_SUBMAP } tag;
   };
 
+  struct ConstraintsSnapshot {
+    // Increases whenever the pose graph publishes new constraints.
+    int64 version;
+    std::shared_ptr<const std::vector<Constraint>> constraints;
+  };
+
   struct LandmarkNode {
     struct LandmarkObservation {
       int trajectory_id;
@@ -87,6 +95,19 @@ class PoseGraphInterface {
       std::function<void(const std::map<int /* trajectory_id */, SubmapId>&,
                          const std::map<int /* trajectory_id */, NodeId>&)>;
 
+  struct FinalOptimizationProgress {
+    // Solver iterations run so far and the cost after the last of them.
+    int num_iterations;
+    double cost;
+    // True for the last call, when the final optimization is complete.
+    bool done;
+  };
+
+  // Called after every round of 'RunFinalOptimizationAsync'. Returning false
+  // cancels the remaining rounds, the poses optimized so far are kept.
+  using FinalOptimizationCallback =
+      std::function<bool(const FinalOptimizationProgress&)>;
+
   PoseGraphInterface() {}
   virtual ~PoseGraphInterface() {}
 
@@ -96,6 +117,16 @@ class PoseGraphInterface {
   // Waits for all computations to finish and computes optimized poses.
   virtual void RunFinalOptimization() = 0;
 
+  // Like 'RunFinalOptimization', but returns immediately. The final
+  // optimization runs in the background in rounds of the usual number of
+  // solver iterations, until it converges or 'max_num_final_iterations' are
+  // used up. 'callback' is called from the background thread after every
+  // round. The optimized poses of the round are already in the pose graph at
+  // that point, so an intermediate solution can be serialized from it. Work
+  // added in the meantime is processed between rounds.
+  virtual void RunFinalOptimizationAsync(
+      FinalOptimizationCallback callback) = 0;
+
   // Returns data for all submaps.
   virtual MapById<SubmapId, SubmapData> GetAllSubmapData() const = 0;
 
@@ -147,6 +178,10 @@ class PoseGraphInterface {
   // Returns the collection of constraints.
   virtual std::vector<Constraint> constraints() const = 0;
 
+  // Returns the constraints as of the last optimization without copying them
+  // or waiting for the pose graph. Constraints found since are missing.
+  virtual ConstraintsSnapshot GetConstraintsSnapshot() const = 0;
+
   // Serializes the constraints and trajectories. If
   // 'include_unfinished_submaps' is set to 'true', unfinished submaps, i.e.
   // submaps that have not yet received all rangefinder data insertions, will
@@ -0,0 +1,330 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/pose_table.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "glog/logging.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+constexpr uint64 kMagic = 0x3165736f50747243;  // "CrtPose1".
+constexpr size_t kCacheLineSize = 64;
+constexpr uint64 kInitialCapacity = 1024;
+
+// A node or submap pose. The layout is fixed so that readers do not need to
+// be built from the same sources as the writer.
+struct Entry {
+  int32 trajectory_id;
+  int32 index;
+  // Universal time of a node.
+  int64 time;
+  double translation[3];
+  // Quaternion in the order w, x, y, z.
+  double rotation[4];
+};
+
+static_assert(sizeof(Entry) == 72, "Unexpected padding in pose table.");
+
+// Tables are written into the buffer 'version % 2'. The version of the latest
+// table is only increased after it was completely written.
+struct Header {
+  uint64 magic;
+  // Number of entries each buffer can hold.
+  uint64 capacity;
+  alignas(kCacheLineSize) std::atomic<uint64> version;
+  // Set once the writer replaced or removed the segment.
+  std::atomic<uint32> replaced;
+};
+
+// 'sequence' is twice the version of the table in the buffer, minus one while
+// it is being written. The nodes are followed by the submaps.
+struct BufferHeader {
+  std::atomic<uint64> sequence;
+  uint64 num_nodes;
+  uint64 num_submaps;
+  uint64 reserved;
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "Shared memory needs lock-free 64-bit atomics.");
+
+size_t RoundUp(const size_t value, const size_t multiple) {
+  return (value + multiple - 1) / multiple * multiple;
+}
+
+size_t BufferSize(const uint64 capacity) {
+  return RoundUp(sizeof(BufferHeader) + capacity * sizeof(Entry),
+                 kCacheLineSize);
+}
+
+size_t MappingSize(const uint64 capacity) {
+  return RoundUp(sizeof(Header), kCacheLineSize) + 2 * BufferSize(capacity);
+}
+
+Header* GetHeader(void* const mapping) { return static_cast<Header*>(mapping); }
+
+BufferHeader* GetBuffer(void* const mapping, const uint64 version) {
+  const uint64 capacity = GetHeader(mapping)->capacity;
+  return reinterpret_cast<BufferHeader*>(
+      static_cast<uint8*>(mapping) + RoundUp(sizeof(Header), kCacheLineSize) +
+      (version % 2) * BufferSize(capacity));
+}
+
+Entry* GetEntries(BufferHeader* const buffer) {
+  return reinterpret_cast<Entry*>(buffer + 1);
+}
+
+Entry ToEntry(const int trajectory_id, const int index, const common::Time time,
+              const transform::Rigid3d& pose) {
+  return Entry{trajectory_id,
+               index,
+               common::ToUniversal(time),
+               {pose.translation().x(), pose.translation().y(),
+                pose.translation().z()},
+               {pose.rotation().w(), pose.rotation().x(), pose.rotation().y(),
+                pose.rotation().z()}};
+}
+
+transform::Rigid3d ToRigid3d(const Entry& entry) {
+  return transform::Rigid3d(
+      Eigen::Vector3d(entry.translation[0], entry.translation[1],
+                      entry.translation[2]),
+      Eigen::Quaterniond(entry.rotation[0], entry.rotation[1],
+                         entry.rotation[2], entry.rotation[3]));
+}
+
+// Returns nullptr on failure.
+void* CreateSegment(const std::string& name, const uint64 capacity) {
+  const size_t mapping_size = MappingSize(capacity);
+  const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd == -1) {
+    PLOG(ERROR) << "Could not create shared memory '" << name << "'";
+    return nullptr;
+  }
+  void* mapping = MAP_FAILED;
+  if (ftruncate(fd, mapping_size) == 0) {
+    mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fd, 0);
+  }
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    PLOG(ERROR) << "Could not map shared memory '" << name << "'";
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+  Header* const header = new (mapping) Header();
+  header->capacity = capacity;
+  header->version.store(0);
+  header->replaced.store(0);
+  for (const uint64 index : {0, 1}) {
+    new (GetBuffer(mapping, index)) BufferHeader();
+    GetBuffer(mapping, index)->sequence.store(0);
+  }
+  // Publishing the magic last lets readers reject a half initialized segment.
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = kMagic;
+  return mapping;
+}
+
+// Returns nullptr without logging on failure, so that readers can retry.
+void* OpenSegment(const std::string& name, size_t* const mapping_size) {
+  const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd == -1) {
+    return nullptr;
+  }
+  struct stat status;
+  void* mapping = MAP_FAILED;
+  if (fstat(fd, &status) == 0 &&
+      static_cast<size_t>(status.st_size) > sizeof(Header)) {
+    mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return nullptr;
+  }
+  const Header* const header = GetHeader(mapping);
+  if (header->magic != kMagic ||
+      MappingSize(header->capacity) != static_cast<size_t>(status.st_size)) {
+    munmap(mapping, status.st_size);
+    return nullptr;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  *mapping_size = status.st_size;
+  return mapping;
+}
+
+}  // namespace
+
+std::unique_ptr<PoseTableWriter> PoseTableWriter::Create(
+    const std::string& name) {
+  void* const mapping = CreateSegment(name, kInitialCapacity);
+  if (mapping == nullptr) {
+    return nullptr;
+  }
+  return std::unique_ptr<PoseTableWriter>(
+      new PoseTableWriter(name, mapping, MappingSize(kInitialCapacity)));
+}
+
+PoseTableWriter::PoseTableWriter(const std::string& name, void* const mapping,
+                                 const size_t mapping_size)
+    : name_(name), mapping_(mapping), mapping_size_(mapping_size) {}
+
+PoseTableWriter::~PoseTableWriter() {
+  GetHeader(mapping_)->replaced.store(1, std::memory_order_release);
+  munmap(mapping_, mapping_size_);
+  shm_unlink(name_.c_str());
+}
+
+void PoseTableWriter::Write(
+    const MapById<NodeId, TrajectoryNodePose>& node_poses,
+    const MapById<SubmapId, transform::Rigid3d>& submap_poses) {
+  const uint64 num_nodes = node_poses.size();
+  const uint64 num_submaps = submap_poses.size();
+  void* const old_mapping = mapping_;
+  uint64 capacity = GetHeader(mapping_)->capacity;
+  if (num_nodes + num_submaps > capacity) {
+    while (num_nodes + num_submaps > capacity) {
+      capacity *= 2;
+    }
+    // Readers of the old segment keep their mapping until the table is in the
+    // new one.
+    shm_unlink(name_.c_str());
+    mapping_ = CreateSegment(name_, capacity);
+    CHECK(mapping_ != nullptr) << "Could not grow pose table '" << name_
+                               << "'.";
+  }
+
+  ++version_;
+  BufferHeader* const buffer = GetBuffer(mapping_, version_);
+  buffer->sequence.store(2 * version_ - 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  buffer->num_nodes = num_nodes;
+  buffer->num_submaps = num_submaps;
+  Entry* entry = GetEntries(buffer);
+  for (const auto& node_id_pose : node_poses) {
+    const auto& constant_pose_data = node_id_pose.data.constant_pose_data;
+    *entry++ = ToEntry(node_id_pose.id.trajectory_id,
+                       node_id_pose.id.node_index,
+                       constant_pose_data.has_value() ? constant_pose_data->time
+                                                      : common::Time::min(),
+                       node_id_pose.data.global_pose);
+  }
+  for (const auto& submap_id_pose : submap_poses) {
+    *entry++ = ToEntry(submap_id_pose.id.trajectory_id,
+                       submap_id_pose.id.submap_index, common::Time::min(),
+                       submap_id_pose.data);
+  }
+  buffer->sequence.store(2 * version_, std::memory_order_release);
+  GetHeader(mapping_)->version.store(version_, std::memory_order_release);
+
+  if (mapping_ != old_mapping) {
+    GetHeader(old_mapping)->replaced.store(1, std::memory_order_release);
+    munmap(old_mapping, mapping_size_);
+    mapping_size_ = MappingSize(capacity);
+  }
+}
+
+std::unique_ptr<PoseTableReader> PoseTableReader::Open(
+    const std::string& name) {
+  size_t mapping_size;
+  void* const mapping = OpenSegment(name, &mapping_size);
+  if (mapping == nullptr) {
+    LOG(ERROR) << "Could not open pose table '" << name << "'.";
+    return nullptr;
+  }
+  return std::unique_ptr<PoseTableReader>(
+      new PoseTableReader(name, mapping, mapping_size));
+}
+
+PoseTableReader::PoseTableReader(const std::string& name, void* const mapping,
+                                 const size_t mapping_size)
+    : name_(name), mapping_(mapping), mapping_size_(mapping_size) {}
+
+PoseTableReader::~PoseTableReader() { munmap(mapping_, mapping_size_); }
+
+bool PoseTableReader::Read(PoseTable* const table) {
+  std::vector<Entry> entries;
+  for (;;) {
+    Header* const header = GetHeader(mapping_);
+    if (header->replaced.load(std::memory_order_acquire) != 0) {
+      size_t mapping_size;
+      void* const mapping = OpenSegment(name_, &mapping_size);
+      if (mapping == nullptr) {
+        return false;
+      }
+      munmap(mapping_, mapping_size_);
+      mapping_ = mapping;
+      mapping_size_ = mapping_size;
+      continue;
+    }
+    const uint64 version = header->version.load(std::memory_order_acquire);
+    if (version == 0) {
+      return false;
+    }
+    BufferHeader* const buffer = GetBuffer(mapping_, version);
+    const uint64 sequence = buffer->sequence.load(std::memory_order_acquire);
+    if (sequence != 2 * version) {
+      // The writer already started to write a newer table into this buffer.
+      std::this_thread::yield();
+      continue;
+    }
+    const uint64 num_nodes = buffer->num_nodes;
+    const uint64 num_submaps = buffer->num_submaps;
+    if (num_nodes + num_submaps <= header->capacity) {
+      entries.resize(num_nodes + num_submaps);
+      std::memcpy(entries.data(), GetEntries(buffer),
+                  entries.size() * sizeof(Entry));
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (buffer->sequence.load(std::memory_order_relaxed) != sequence) {
+      std::this_thread::yield();
+      continue;
+    }
+    CHECK_EQ(entries.size(), num_nodes + num_submaps);
+
+    *table = PoseTable();
+    table->version = version;
+    for (uint64 i = 0; i != num_nodes; ++i) {
+      const Entry& entry = entries[i];
+      table->node_poses.Insert(
+          NodeId{entry.trajectory_id, entry.index},
+          PoseTable::NodePose{common::FromUniversal(entry.time),
+                              ToRigid3d(entry)});
+    }
+    for (uint64 i = num_nodes; i != entries.size(); ++i) {
+      const Entry& entry = entries[i];
+      table->submap_poses.Insert(SubmapId{entry.trajectory_id, entry.index},
+                                 ToRigid3d(entry));
+    }
+    return true;
+  }
+}
+
+}  // namespace mapping
+}  // namespace cartographer
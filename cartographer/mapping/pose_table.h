@@ -0,0 +1,108 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_MAPPING_POSE_TABLE_H_
+#define CARTOGRAPHER_MAPPING_POSE_TABLE_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "cartographer/common/port.h"
+#include "cartographer/common/time.h"
+#include "cartographer/mapping/id.h"
+#include "cartographer/mapping/trajectory_node.h"
+#include "cartographer/transform/rigid_transform.h"
+
+namespace cartographer {
+namespace mapping {
+
+// The optimized poses of one optimization as read by 'PoseTableReader'.
+struct PoseTable {
+  struct NodePose {
+    // common::Time::min() if the time of the node is not known.
+    common::Time time;
+    transform::Rigid3d global_pose;
+  };
+
+  // Increases with every written table, starting at 1.
+  uint64 version = 0;
+  MapById<NodeId, NodePose> node_poses;
+  // Only submaps which were optimized.
+  MapById<SubmapId, transform::Rigid3d> submap_poses;
+};
+
+// Publishes the optimized node and submap poses into a POSIX shared memory
+// segment, so that other processes on the same host can read them without
+// going through the pose graph or the network stack.
+//
+// The segment holds two buffers. Each table is written into the buffer which
+// does not hold the latest table, so that readers copying the latest table are
+// only disturbed if two tables are written while they copy. Not thread-safe.
+class PoseTableWriter {
+ public:
+  // Creates the segment 'name', which must start with a '/'. The segment is
+  // removed again when the returned writer is destroyed. Returns nullptr on
+  // failure, e.g. if the segment already exists.
+  static std::unique_ptr<PoseTableWriter> Create(const std::string& name);
+
+  ~PoseTableWriter();
+
+  PoseTableWriter(const PoseTableWriter&) = delete;
+  PoseTableWriter& operator=(const PoseTableWriter&) = delete;
+
+  // Writes and publishes the next table. If the segment is too small, it is
+  // replaced by a larger one under the same name which readers switch to.
+  void Write(const MapById<NodeId, TrajectoryNodePose>& node_poses,
+             const MapById<SubmapId, transform::Rigid3d>& submap_poses);
+
+ private:
+  PoseTableWriter(const std::string& name, void* mapping, size_t mapping_size);
+
+  const std::string name_;
+  void* mapping_;
+  size_t mapping_size_;
+  uint64 version_ = 0;
+};
+
+// Reads the tables published by a 'PoseTableWriter' in another process.
+class PoseTableReader {
+ public:
+  // Maps the existing segment 'name'. Returns nullptr on failure.
+  static std::unique_ptr<PoseTableReader> Open(const std::string& name);
+
+  ~PoseTableReader();
+
+  PoseTableReader(const PoseTableReader&) = delete;
+  PoseTableReader& operator=(const PoseTableReader&) = delete;
+
+  // Copies the latest table into 'table'. Returns false if no table was
+  // written yet, or if the segment was replaced or removed by the writer and
+  // no new segment can be opened.
+  bool Read(PoseTable* table);
+
+ private:
+  PoseTableReader(const std::string& name, void* mapping, size_t mapping_size);
+
+  const std::string name_;
+  void* mapping_;
+  size_t mapping_size_;
+};
+
+}  // namespace mapping
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_MAPPING_POSE_TABLE_H_
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/mapping/pose_table.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace mapping {
+namespace {
+
+std::string UniqueName(const std::string& suffix) {
+  return "/cartographer_pose_table_test_" + std::to_string(getpid()) + "_" +
+         suffix;
+}
+
+// Nodes and submaps whose x coordinate is 'value'.
+void WriteTable(const int num_nodes, const int num_submaps, const double value,
+                PoseTableWriter* writer) {
+  MapById<NodeId, TrajectoryNodePose> node_poses;
+  for (int i = 0; i != num_nodes; ++i) {
+    node_poses.Insert(
+        NodeId{i % 2, i / 2},
+        TrajectoryNodePose{
+            transform::Rigid3d(Eigen::Vector3d(value, i, 0.),
+                               Eigen::Quaterniond(Eigen::AngleAxisd(
+                                   0.1 * i, Eigen::Vector3d::UnitZ()))),
+            TrajectoryNodePose::ConstantPoseData{common::FromUniversal(i),
+                                                 transform::Rigid3d()}});
+  }
+  MapById<SubmapId, transform::Rigid3d> submap_poses;
+  for (int i = 0; i != num_submaps; ++i) {
+    submap_poses.Insert(SubmapId{0, i}, transform::Rigid3d::Translation(
+                                            Eigen::Vector3d(value, -i, 1.)));
+  }
+  writer->Write(node_poses, submap_poses);
+}
+
+TEST(PoseTableTest, OpenFailsForUnknownName) {
+  EXPECT_EQ(PoseTableReader::Open(UniqueName("unknown")), nullptr);
+}
+
+TEST(PoseTableTest, ReadsLatestTable) {
+  const std::string name = UniqueName("latest");
+  auto writer = PoseTableWriter::Create(name);
+  ASSERT_NE(writer, nullptr);
+  auto reader = PoseTableReader::Open(name);
+  ASSERT_NE(reader, nullptr);
+  PoseTable table;
+  EXPECT_FALSE(reader->Read(&table));
+
+  WriteTable(5, 2, 1., writer.get());
+  WriteTable(7, 3, 2., writer.get());
+  ASSERT_TRUE(reader->Read(&table));
+  EXPECT_EQ(table.version, 2);
+  ASSERT_EQ(table.node_poses.size(), 7);
+  ASSERT_EQ(table.submap_poses.size(), 3);
+  const PoseTable::NodePose& node_pose = table.node_poses.at(NodeId{1, 2});
+  EXPECT_EQ(node_pose.time, common::FromUniversal(5));
+  EXPECT_TRUE(node_pose.global_pose.translation().isApprox(
+      Eigen::Vector3d(2., 5., 0.)));
+  EXPECT_NEAR(node_pose.global_pose.rotation().angularDistance(
+                  Eigen::Quaterniond(
+                      Eigen::AngleAxisd(0.5, Eigen::Vector3d::UnitZ()))),
+              0., 1e-12);
+  EXPECT_TRUE(table.submap_poses.at(SubmapId{0, 2}).translation().isApprox(
+      Eigen::Vector3d(2., -2., 1.)));
+
+  writer.reset();
+  EXPECT_FALSE(reader->Read(&table));
+}
+
+TEST(PoseTableTest, ReaderFollowsGrowingTable) {
+  const std::string name = UniqueName("growing");
+  auto writer = PoseTableWriter::Create(name);
+  ASSERT_NE(writer, nullptr);
+  WriteTable(10, 1, 1., writer.get());
+  auto reader = PoseTableReader::Open(name);
+  ASSERT_NE(reader, nullptr);
+  WriteTable(5000, 100, 2., writer.get());
+  PoseTable table;
+  ASSERT_TRUE(reader->Read(&table));
+  EXPECT_EQ(table.version, 2);
+  EXPECT_EQ(table.node_poses.size(), 5000);
+  EXPECT_EQ(table.submap_poses.size(), 100);
+}
+
+TEST(PoseTableTest, ConcurrentReadsAreConsistent) {
+  const std::string name = UniqueName("concurrent");
+  auto writer = PoseTableWriter::Create(name);
+  ASSERT_NE(writer, nullptr);
+  auto reader = PoseTableReader::Open(name);
+  ASSERT_NE(reader, nullptr);
+  constexpr int kNumTables = 2000;
+  std::atomic<bool> done(false);
+  std::thread writer_thread([&writer, &done]() {
+    for (int i = 1; i <= kNumTables; ++i) {
+      WriteTable(100 + i % 50, 10, i, writer.get());
+    }
+    done = true;
+  });
+  int num_reads = 0;
+  uint64 last_version = 0;
+  PoseTable table;
+  while (!done || last_version != kNumTables) {
+    if (!reader->Read(&table)) {
+      continue;
+    }
+    ++num_reads;
+    EXPECT_GE(table.version, last_version);
+    last_version = table.version;
+    // All poses of a table are written together.
+    EXPECT_EQ(table.node_poses.size(), 100 + table.version % 50);
+    for (const auto& node_id_pose : table.node_poses) {
+      EXPECT_EQ(node_id_pose.data.global_pose.translation().x(),
+                table.version);
+    }
+    for (const auto& submap_id_pose : table.submap_poses) {
+      EXPECT_EQ(submap_id_pose.data.translation().x(), table.version);
+    }
+  }
+  writer_thread.join();
+  EXPECT_GT(num_reads, 0);
+}
+
+}  // namespace
+}  // namespace mapping
+}  // namespace cartographer
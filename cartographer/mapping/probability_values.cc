@@ -65,8 +65,22 @@ std::unique_ptr<std::vector<float>> PrecomputeValueToCorrespondenceCost() {
       kMinCorrespondenceCost, kMaxCorrespondenceCost);
 }
 
+std::unique_ptr<std::vector<uint16>> PrecomputeCompactValueToValue() {
+  auto result = absl::make_unique<std::vector<uint16>>();
+  result->reserve(256);
+  result->push_back(kUnknownCorrespondenceValue);
+  for (int compact_value = 1; compact_value != 256; ++compact_value) {
+    result->push_back(
+        1 + common::RoundToInt((compact_value - 1) * (32766.f / 254.f)));
+  }
+  return result;
+}
+
 }  // namespace
 
+const std::vector<uint16>* const kCompactValueToValue =
+    PrecomputeCompactValueToValue().release();
+
 const std::vector<float>* const kValueToProbability =
     PrecomputeValueToProbability().release();
 
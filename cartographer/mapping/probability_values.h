@@ -139,6 +139,21 @@ inline uint16 CorrespondenceCostValueToProbabilityValue(
   return result;
 }
 
+// 8 bit values for compact storage of finished grids: 0 is unknown, and
+// [1, 255] is spread evenly over the values [1, 32767].
+inline uint8 ValueToCompactValue(const uint16 value) {
+  DCHECK_LT(value, kUpdateMarker);
+  if (value == kUnknownCorrespondenceValue) return 0;
+  return 1 + common::RoundToInt((value - 1) * (254.f / 32766.f));
+}
+
+extern const std::vector<uint16>* const kCompactValueToValue;
+
+// Converts a compact value back to the nearest value without update marker.
+inline uint16 CompactValueToValue(const uint8 compact_value) {
+  return (*kCompactValueToValue)[compact_value];
+}
+
 std::vector<uint16> ComputeLookupTableToApplyOdds(float odds);
 std::vector<uint16> ComputeLookupTableToApplyCorrespondenceCostOdds(float odds);
 
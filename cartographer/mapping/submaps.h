@@ -17,6 +17,7 @@
 #ifndef CARTOGRAPHER_MAPPING_SUBMAPS_H_
 #define CARTOGRAPHER_MAPPING_SUBMAPS_H_
 
+#include <atomic>
 #include <memory>
 #include <vector>
 
@@ -87,7 +88,9 @@ class Submap {
  private:
   const transform::Rigid3d local_pose_;
   int num_range_data_ = 0;
-  bool insertion_finished_ = false;
+  // Atomic, so that serialization on another thread sees the finished grid of
+  // a submap it sees as finished.
+  std::atomic<bool> insertion_finished_{false};
 };
 
 }  // namespace mapping
@@ -96,6 +96,15 @@ class TrajectoryBuilderInterface {
   virtual void AddSensorData(
       const std::string& sensor_id,
       const sensor::TimedPointCloudData& timed_point_cloud_data) = 0;
+  // Like above, but takes ownership of the point cloud so that it can be
+  // passed on without copies and recycled in 'sensor::TimedPointCloudPool'
+  // after it has been consumed.
+  virtual void AddSensorData(
+      const std::string& sensor_id,
+      sensor::TimedPointCloudData&& timed_point_cloud_data) {
+    AddSensorData(sensor_id, static_cast<const sensor::TimedPointCloudData&>(
+                                 timed_point_cloud_data));
+  }
   virtual void AddSensorData(const std::string& sensor_id,
                              const sensor::ImuData& imu_data) = 0;
   virtual void AddSensorData(const std::string& sensor_id,
@@ -110,6 +119,9 @@ class TrajectoryBuilderInterface {
   // 'LocalTrajectoryBuilder2D/3D'.
   virtual void AddLocalSlamResultData(
       std::unique_ptr<mapping::LocalSlamResultData> local_slam_result_data) = 0;
+  // Completes the local SLAM of all sensor data added so far, e.g. results
+  // which are held back by pipelining. Called when the trajectory finishes.
+  virtual void Flush() = 0;
 };
 
 proto::SensorId ToProto(const TrajectoryBuilderInterface::SensorId& sensor_id);
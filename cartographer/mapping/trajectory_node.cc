@@ -24,6 +24,16 @@
 namespace cartographer {
 namespace mapping {
 
+size_t MemoryUsageInBytes(const TrajectoryNode::Data& constant_data) {
+  return sizeof(TrajectoryNode::Data) +
+         constant_data.filtered_gravity_aligned_point_cloud
+             .MemoryUsageInBytes() +
+         constant_data.high_resolution_point_cloud.MemoryUsageInBytes() +
+         constant_data.low_resolution_point_cloud.MemoryUsageInBytes() +
+         constant_data.rotational_scan_matcher_histogram.size() *
+             sizeof(float);
+}
+
 proto::TrajectoryNodeData ToProto(const TrajectoryNode::Data& constant_data) {
   proto::TrajectoryNodeData proto;
   proto.set_timestamp(common::ToUniversal(constant_data.time));
@@ -73,6 +73,10 @@ struct TrajectoryNode {
 };
 
 proto::TrajectoryNodeData ToProto(const TrajectoryNode::Data& constant_data);
+
+// Returns the number of bytes held by 'constant_data', including its point
+// clouds.
+size_t MemoryUsageInBytes(const TrajectoryNode::Data& constant_data);
 TrajectoryNode::Data FromProto(const proto::TrajectoryNodeData& proto);
 
 }  // namespace mapping
@@ -17,6 +17,7 @@
 #include "cartographer/mapping/value_conversion_tables.h"
 
 #include "absl/memory/memory.h"
+#include "cartographer/mapping/probability_values.h"
 #include "glog/logging.h"
 
 namespace cartographer {
@@ -53,8 +54,18 @@ std::unique_ptr<std::vector<float>> PrecomputeValueToBoundedFloat(
 
 const std::vector<float>* ValueConversionTables::GetConversionTable(
     float unknown_result, float lower_bound, float upper_bound) {
+  if (unknown_result == kMaxCorrespondenceCost &&
+      lower_bound == kMinCorrespondenceCost &&
+      upper_bound == kMaxCorrespondenceCost) {
+    return kValueToCorrespondenceCost;
+  }
+  if (unknown_result == kMinProbability && lower_bound == kMinProbability &&
+      upper_bound == kMaxProbability) {
+    return kValueToProbability;
+  }
   std::tuple<float, float, float> bounds =
       std::make_tuple(unknown_result, lower_bound, upper_bound);
+  absl::MutexLock locker(&mutex_);
   auto lookup_table_iterator = bounds_to_lookup_table_.find(bounds);
   if (lookup_table_iterator == bounds_to_lookup_table_.end()) {
     auto insertion_result = bounds_to_lookup_table_.emplace(
@@ -20,6 +20,7 @@
 #include <map>
 #include <vector>
 
+#include "absl/synchronization/mutex.h"
 #include "cartographer/common/port.h"
 #include "glog/logging.h"
 
@@ -28,18 +29,22 @@ namespace mapping {
 
 // Performs lazy computations of lookup tables for mapping from a uint16 value
 // to a float in ['lower_bound', 'upper_bound']. The first element of the table
-// is set to 'unknown_result'.
+// is set to 'unknown_result'. The default bounds of probabilities and
+// correspondence costs use the static tables of probability_values.h, shared
+// by all instances. Thread-safe, so that grids can be deserialized in parallel.
 class ValueConversionTables {
  public:
   const std::vector<float>* GetConversionTable(float unknown_result,
                                                float lower_bound,
-                                               float upper_bound);
+                                               float upper_bound)
+      LOCKS_EXCLUDED(mutex_);
 
  private:
+  absl::Mutex mutex_;
   std::map<const std::tuple<float /* unknown_result */, float /* lower_bound */,
                             float /* upper_bound */>,
            std::unique_ptr<const std::vector<float>>>
-      bounds_to_lookup_table_;
+      bounds_to_lookup_table_ GUARDED_BY(mutex_);
 };
 
 }  // namespace mapping
@@ -18,6 +18,7 @@
 
 #include <random>
 
+#include "cartographer/mapping/probability_values.h"
 #include "gtest/gtest.h"
 
 namespace cartographer {
@@ -42,6 +43,17 @@ TEST(ValueConversionTablesTest, InequalTables) {
   EXPECT_FALSE(reference_table == test_table);
 }
 
+TEST(ValueConversionTablesTest, DefaultBoundsUseStaticTables) {
+  ValueConversionTables value_conversion_tables;
+  EXPECT_EQ(value_conversion_tables.GetConversionTable(
+                kMaxCorrespondenceCost, kMinCorrespondenceCost,
+                kMaxCorrespondenceCost),
+            kValueToCorrespondenceCost);
+  EXPECT_EQ(value_conversion_tables.GetConversionTable(
+                kMinProbability, kMinProbability, kMaxProbability),
+            kValueToProbability);
+}
+
 TEST(ValueConversionTablesTest, ValueConversion) {
   ValueConversionTables value_conversion_tables;
   std::mt19937 rng(42);
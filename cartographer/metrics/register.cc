@@ -23,6 +23,8 @@
 #include "cartographer/mapping/internal/constraints/constraint_builder_2d.h"
 #include "cartographer/mapping/internal/constraints/constraint_builder_3d.h"
 #include "cartographer/mapping/internal/global_trajectory_builder.h"
+#include "cartographer/mapping/internal/trajectory_cpu_time_metrics.h"
+#include "cartographer/sensor/internal/ordered_multi_queue.h"
 #include "cartographer/sensor/internal/trajectory_collator.h"
 
 namespace cartographer {
@@ -36,6 +38,8 @@ void RegisterAllMetrics(FamilyFactory* registry) {
   mapping::LocalTrajectoryBuilder3D::RegisterMetrics(registry);
   mapping::PoseGraph2D::RegisterMetrics(registry);
   mapping::PoseGraph3D::RegisterMetrics(registry);
+  mapping::TrajectoryCpuTimeMetrics::RegisterMetrics(registry);
+  sensor::OrderedMultiQueue::RegisterMetrics(registry);
   sensor::TrajectoryCollator::RegisterMetrics(registry);
 }
 
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/sensor/aligned_point_cloud.h"
+
+namespace cartographer {
+namespace sensor {
+
+void AlignedPointCloud::clear() {
+  x_.clear();
+  y_.clear();
+  z_.clear();
+  time_.clear();
+}
+
+void AlignedPointCloud::reserve(const size_t size) {
+  x_.reserve(size);
+  y_.reserve(size);
+  z_.reserve(size);
+  time_.reserve(size);
+}
+
+void AlignedPointCloud::resize(const size_t size) {
+  x_.resize(size);
+  y_.resize(size);
+  z_.resize(size);
+  time_.resize(size);
+}
+
+void AlignedPointCloud::push_back(const Eigen::Vector3f& position,
+                                  const float time) {
+  x_.push_back(position.x());
+  y_.push_back(position.y());
+  z_.push_back(position.z());
+  time_.push_back(time);
+}
+
+AlignedPointCloud ToAlignedPointCloud(const PointCloud& point_cloud) {
+  AlignedPointCloud result;
+  result.reserve(point_cloud.size());
+  for (const RangefinderPoint& point : point_cloud) {
+    result.push_back(point.position);
+  }
+  return result;
+}
+
+AlignedPointCloud ToAlignedPointCloud(const TimedPointCloud& point_cloud) {
+  AlignedPointCloud result;
+  result.reserve(point_cloud.size());
+  for (const TimedRangefinderPoint& point : point_cloud) {
+    result.push_back(point.position, point.time);
+  }
+  return result;
+}
+
+PointCloud ToPointCloud(const AlignedPointCloud& point_cloud) {
+  PointCloud result;
+  result.reserve(point_cloud.size());
+  for (size_t i = 0; i < point_cloud.size(); ++i) {
+    result.push_back({point_cloud.position(i)});
+  }
+  return result;
+}
+
+TimedPointCloud ToTimedPointCloud(const AlignedPointCloud& point_cloud) {
+  TimedPointCloud result;
+  result.reserve(point_cloud.size());
+  for (size_t i = 0; i < point_cloud.size(); ++i) {
+    result.push_back({point_cloud.position(i), point_cloud.time()[i]});
+  }
+  return result;
+}
+
+void TransformAlignedPointCloud(const transform::Rigid3f& transform,
+                                AlignedPointCloud* const point_cloud) {
+  // Same arithmetic as 'TransformPointCloud()', written per coordinate so
+  // that the compiler vectorizes it across points.
+  const Eigen::Matrix3f rotation = transform.rotation().toRotationMatrix();
+  const Eigen::Vector3f& translation = transform.translation();
+  float* const x = point_cloud->mutable_x();
+  float* const y = point_cloud->mutable_y();
+  float* const z = point_cloud->mutable_z();
+  for (size_t i = 0; i < point_cloud->size(); ++i) {
+    const float px = x[i];
+    const float py = y[i];
+    const float pz = z[i];
+    x[i] = rotation(0, 0) * px + rotation(0, 1) * py + rotation(0, 2) * pz +
+           translation.x();
+    y[i] = rotation(1, 0) * px + rotation(1, 1) * py + rotation(1, 2) * pz +
+           translation.y();
+    z[i] = rotation(2, 0) * px + rotation(2, 1) * py + rotation(2, 2) * pz +
+           translation.z();
+  }
+}
+
+}  // namespace sensor
+}  // namespace cartographer
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_SENSOR_ALIGNED_POINT_CLOUD_H_
+#define CARTOGRAPHER_SENSOR_ALIGNED_POINT_CLOUD_H_
+
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "Eigen/Core"
+#include "cartographer/sensor/point_cloud.h"
+#include "cartographer/transform/rigid_transform.h"
+
+namespace cartographer {
+namespace sensor {
+
+// Allocates storage aligned for aligned loads of 8 floats.
+template <typename T>
+class AlignedAllocator {
+ public:
+  using value_type = T;
+  static constexpr size_t kAlignment = 32;
+
+  AlignedAllocator() = default;
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U>&) {}
+
+  T* allocate(const size_t n) {
+    void* memory = nullptr;
+    if (posix_memalign(&memory, kAlignment, n * sizeof(T)) != 0) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T*>(memory);
+  }
+  void deallocate(T* const memory, size_t) { free(memory); }
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U>&) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const AlignedAllocator<U>&) const {
+    return false;
+  }
+};
+
+// A point cloud stored as separate arrays of x, y, z and time values, each
+// starting at a 32-byte boundary, so that loops over many points can load
+// one coordinate of 8 consecutive points at once. Converted from and to
+// 'PointCloud' and 'TimedPointCloud' where such loops run, intensities are
+// not kept.
+class AlignedPointCloud {
+ public:
+  using FloatVector = std::vector<float, AlignedAllocator<float>>;
+
+  size_t size() const { return x_.size(); }
+  bool empty() const { return x_.empty(); }
+
+  // Removes all points, but keeps the allocated storage.
+  void clear();
+  void reserve(size_t size);
+  void resize(size_t size);
+  void push_back(const Eigen::Vector3f& position, float time = 0.f);
+
+  Eigen::Vector3f position(const size_t index) const {
+    return Eigen::Vector3f(x_[index], y_[index], z_[index]);
+  }
+  // Same as 'position()', so that the point cloud can be used where the
+  // positions of a 'std::vector' of points are read.
+  Eigen::Vector3f operator[](const size_t index) const {
+    return position(index);
+  }
+
+  const float* x() const { return x_.data(); }
+  const float* y() const { return y_.data(); }
+  const float* z() const { return z_.data(); }
+  const float* time() const { return time_.data(); }
+  float* mutable_x() { return x_.data(); }
+  float* mutable_y() { return y_.data(); }
+  float* mutable_z() { return z_.data(); }
+  float* mutable_time() { return time_.data(); }
+
+ private:
+  FloatVector x_;
+  FloatVector y_;
+  FloatVector z_;
+  // Relative measurement time as in 'TimedPointCloud', 0.f if unknown.
+  FloatVector time_;
+};
+
+AlignedPointCloud ToAlignedPointCloud(const PointCloud& point_cloud);
+AlignedPointCloud ToAlignedPointCloud(const TimedPointCloud& point_cloud);
+PointCloud ToPointCloud(const AlignedPointCloud& point_cloud);
+TimedPointCloud ToTimedPointCloud(const AlignedPointCloud& point_cloud);
+
+// Transforms 'point_cloud' in place according to 'transform'.
+void TransformAlignedPointCloud(const transform::Rigid3f& transform,
+                                AlignedPointCloud* point_cloud);
+
+}  // namespace sensor
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_SENSOR_ALIGNED_POINT_CLOUD_H_
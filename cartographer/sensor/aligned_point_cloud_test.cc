@@ -0,0 +1,94 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/sensor/aligned_point_cloud.h"
+
+#include <cstdint>
+#include <random>
+
+#include "Eigen/Geometry"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace sensor {
+namespace {
+
+using ::testing::ElementsAreArray;
+
+TimedPointCloud CreateRandomTimedPointCloud(const int num_points) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> distribution(-5.f, 5.f);
+  TimedPointCloud point_cloud;
+  for (int i = 0; i < num_points; ++i) {
+    point_cloud.push_back(
+        {{distribution(rng), distribution(rng), distribution(rng)},
+         -0.01f * (num_points - 1 - i)});
+  }
+  return point_cloud;
+}
+
+bool IsAligned(const float* const data) {
+  return reinterpret_cast<std::uintptr_t>(data) % 32 == 0;
+}
+
+TEST(AlignedPointCloudTest, ConvertsWithoutLoss) {
+  const TimedPointCloud timed_point_cloud = CreateRandomTimedPointCloud(37);
+  const AlignedPointCloud aligned_point_cloud =
+      ToAlignedPointCloud(timed_point_cloud);
+  ASSERT_EQ(aligned_point_cloud.size(), timed_point_cloud.size());
+  EXPECT_THAT(ToTimedPointCloud(aligned_point_cloud),
+              ElementsAreArray(timed_point_cloud));
+
+  PointCloud point_cloud;
+  for (const TimedRangefinderPoint& point : timed_point_cloud) {
+    point_cloud.push_back({point.position});
+  }
+  EXPECT_THAT(ToPointCloud(ToAlignedPointCloud(point_cloud)).points(),
+              ElementsAreArray(point_cloud.points()));
+}
+
+TEST(AlignedPointCloudTest, ArraysAreAligned) {
+  AlignedPointCloud point_cloud =
+      ToAlignedPointCloud(CreateRandomTimedPointCloud(13));
+  EXPECT_TRUE(IsAligned(point_cloud.x()));
+  EXPECT_TRUE(IsAligned(point_cloud.y()));
+  EXPECT_TRUE(IsAligned(point_cloud.z()));
+  EXPECT_TRUE(IsAligned(point_cloud.time()));
+}
+
+TEST(AlignedPointCloudTest, TransformMatchesPointCloud) {
+  const TimedPointCloud timed_point_cloud = CreateRandomTimedPointCloud(100);
+  const transform::Rigid3f transform(
+      Eigen::Vector3f(1.f, -2.f, 3.f),
+      Eigen::Quaternionf(Eigen::AngleAxisf(
+          0.7f, Eigen::Vector3f(0.1f, -0.2f, 1.f).normalized())));
+  AlignedPointCloud aligned_point_cloud =
+      ToAlignedPointCloud(timed_point_cloud);
+  TransformAlignedPointCloud(transform, &aligned_point_cloud);
+  const TimedPointCloud expected =
+      TransformTimedPointCloud(timed_point_cloud, transform);
+  ASSERT_EQ(aligned_point_cloud.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_TRUE(aligned_point_cloud.position(i).isApprox(expected[i].position,
+                                                         1e-5f));
+    EXPECT_EQ(aligned_point_cloud.time()[i], expected[i].time);
+  }
+}
+
+}  // namespace
+}  // namespace sensor
+}  // namespace cartographer
@@ -17,10 +17,15 @@
 #include "cartographer/sensor/compressed_point_cloud.h"
 
 #include <limits>
+#include <utility>
 
 #include "cartographer/common/math.h"
 #include "cartographer/mapping/3d/hybrid_grid.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 namespace cartographer {
 namespace sensor {
 
@@ -34,6 +39,60 @@ constexpr float kPrecision = 0.001f;  // in meters.
 constexpr int kBitsPerCoordinate = 10;
 constexpr int kCoordinateMask = (1 << kBitsPerCoordinate) - 1;
 constexpr int kMaxBitsPerDirection = 23;
+// Each block starts with the number of points and the block coordinates.
+constexpr int kBlockHeaderSize = 4;
+
+// Decodes the points of the block whose header is at 'block' to 'output'.
+void DecodeBlock(const int32* const block, RangefinderPoint* const output) {
+  const int num_points = block[0];
+  const int32 origin_x = block[1] << kBitsPerCoordinate;
+  const int32 origin_y = block[2] << kBitsPerCoordinate;
+  const int32 origin_z = block[3] << kBitsPerCoordinate;
+  const int32* const encoded_points = block + kBlockHeaderSize;
+  int i = 0;
+#if defined(__AVX2__)
+  // Decodes 8 points at a time, the coordinates are then interleaved.
+  const __m256i mask = _mm256_set1_epi32(kCoordinateMask);
+  const __m256i origin_x_8 = _mm256_set1_epi32(origin_x);
+  const __m256i origin_y_8 = _mm256_set1_epi32(origin_y);
+  const __m256i origin_z_8 = _mm256_set1_epi32(origin_z);
+  const __m256 precision = _mm256_set1_ps(kPrecision);
+  alignas(32) float x[8];
+  alignas(32) float y[8];
+  alignas(32) float z[8];
+  for (; i + 8 <= num_points; i += 8) {
+    const __m256i points = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(encoded_points + i));
+    _mm256_store_ps(
+        x, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(
+                             origin_x_8, _mm256_and_si256(points, mask))),
+                         precision));
+    _mm256_store_ps(
+        y, _mm256_mul_ps(
+               _mm256_cvtepi32_ps(_mm256_add_epi32(
+                   origin_y_8,
+                   _mm256_and_si256(
+                       _mm256_srli_epi32(points, kBitsPerCoordinate), mask))),
+               precision));
+    _mm256_store_ps(
+        z, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(
+                             origin_z_8, _mm256_srli_epi32(
+                                             points, 2 * kBitsPerCoordinate))),
+                         precision));
+    for (int j = 0; j != 8; ++j) {
+      output[i + j].position = Eigen::Vector3f(x[j], y[j], z[j]);
+    }
+  }
+#endif
+  for (; i != num_points; ++i) {
+    const int32 point = encoded_points[i];
+    output[i].position = Eigen::Vector3f(
+        (origin_x + (point & kCoordinateMask)) * kPrecision,
+        (origin_y + ((point >> kBitsPerCoordinate) & kCoordinateMask)) *
+            kPrecision,
+        (origin_z + (point >> (2 * kBitsPerCoordinate))) * kPrecision);
+  }
+}
 
 }  // namespace
 
@@ -143,17 +202,32 @@ CompressedPointCloud::CompressedPointCloud(const PointCloud& point_cloud)
     }
   }
   CHECK_EQ(num_blocks, 0);
+  IndexBlocks();
 }
 
 CompressedPointCloud::CompressedPointCloud(
-    const proto::CompressedPointCloud& proto) {
-  num_points_ = proto.num_points();
-  const int data_size = proto.point_data_size();
-  point_data_.reserve(data_size);
-  // TODO(wohe): Verify that 'point_data_' does not contain malformed data.
-  for (int i = 0; i != data_size; ++i) {
-    point_data_.emplace_back(proto.point_data(i));
+    const proto::CompressedPointCloud& proto)
+    : point_data_(proto.point_data().begin(), proto.point_data().end()),
+      num_points_(proto.num_points()) {
+  IndexBlocks();
+}
+
+void CompressedPointCloud::IndexBlocks() {
+  size_t num_points = 0;
+  size_t offset = 0;
+  while (offset != point_data_.size()) {
+    CHECK_LE(offset + kBlockHeaderSize, point_data_.size())
+        << "Malformed compressed point cloud.";
+    const int32 num_points_in_block = point_data_[offset];
+    CHECK_GT(num_points_in_block, 0) << "Malformed compressed point cloud.";
+    const size_t block_size = kBlockHeaderSize + num_points_in_block;
+    CHECK_LE(offset + block_size, point_data_.size())
+        << "Malformed compressed point cloud.";
+    block_offsets_.push_back(offset);
+    num_points += num_points_in_block;
+    offset += block_size;
   }
+  CHECK_EQ(num_points, num_points_) << "Malformed compressed point cloud.";
 }
 
 bool CompressedPointCloud::empty() const { return num_points_ == 0; }
@@ -169,11 +243,22 @@ CompressedPointCloud::ConstIterator CompressedPointCloud::end() const {
 }
 
 PointCloud CompressedPointCloud::Decompress() const {
-  PointCloud decompressed;
-  for (const RangefinderPoint& point : *this) {
-    decompressed.push_back(point);
+  std::vector<RangefinderPoint> points(num_points_);
+  RangefinderPoint* output = points.data();
+  for (const int block_offset : block_offsets_) {
+    DecodeBlock(point_data_.data() + block_offset, output);
+    output += point_data_[block_offset];
   }
-  return decompressed;
+  return PointCloud(std::move(points));
+}
+
+void CompressedPointCloud::DecompressBlock(
+    const int block_index, std::vector<RangefinderPoint>* const points) const {
+  const int32* const block =
+      point_data_.data() + block_offsets_.at(block_index);
+  const size_t begin = points->size();
+  points->resize(begin + block[0]);
+  DecodeBlock(block, points->data() + begin);
 }
 
 bool CompressedPointCloud::operator==(
@@ -185,6 +270,7 @@ bool CompressedPointCloud::operator==(
 proto::CompressedPointCloud CompressedPointCloud::ToProto() const {
   proto::CompressedPointCloud result;
   result.set_num_points(num_points_);
+  result.mutable_point_data()->Reserve(point_data_.size());
   for (const int32 data : point_data_) {
     result.add_point_data(data);
   }
@@ -41,9 +41,16 @@ class CompressedPointCloud {
   explicit CompressedPointCloud(const PointCloud& point_cloud);
   explicit CompressedPointCloud(const proto::CompressedPointCloud& proto);
 
-  // Returns decompressed point cloud.
+  // Returns decompressed point cloud. Points are decoded a block at a time,
+  // which is much faster than iterating.
   PointCloud Decompress() const;
 
+  // Blocks can be decompressed independently.
+  int num_blocks() const { return static_cast<int>(block_offsets_.size()); }
+  // Appends the points of the block 'block_index' to 'points'.
+  void DecompressBlock(int block_index,
+                       std::vector<RangefinderPoint>* points) const;
+
   bool empty() const;
   size_t size() const;
   ConstIterator begin() const;
@@ -53,8 +60,14 @@ class CompressedPointCloud {
   proto::CompressedPointCloud ToProto() const;
 
  private:
+  // Fills 'block_offsets_' from 'point_data_' and checks that it is
+  // well-formed.
+  void IndexBlocks();
+
   std::vector<int32> point_data_;
   size_t num_points_;
+  // Offsets of the block headers in 'point_data_'.
+  std::vector<int> block_offsets_;
 };
 
 // Forward iterator for compressed point clouds.
@@ -117,6 +117,41 @@ TEST(CompressPointCloudTest, CompressesNoGaps) {
   }
 }
 
+TEST(CompressPointCloudTest, DecompressesLikeIterator) {
+  PointCloud point_cloud;
+  for (int i = 0; i < 1000; ++i) {
+    // Spans several blocks with a remainder of points in each.
+    point_cloud.push_back(
+        {Eigen::Vector3f(0.01f * i - 5.f, 0.003f * i, -0.007f * i)});
+  }
+  const CompressedPointCloud compressed(point_cloud);
+  EXPECT_GT(compressed.num_blocks(), 1);
+  const PointCloud decompressed = compressed.Decompress();
+  ASSERT_EQ(decompressed.size(), compressed.size());
+  std::vector<RangefinderPoint> points_by_block;
+  for (int i = 0; i != compressed.num_blocks(); ++i) {
+    compressed.DecompressBlock(i, &points_by_block);
+  }
+  ASSERT_EQ(points_by_block.size(), compressed.size());
+  size_t i = 0;
+  for (const RangefinderPoint& point : compressed) {
+    EXPECT_EQ(point.position, decompressed[i].position);
+    EXPECT_EQ(point.position, points_by_block[i].position);
+    ++i;
+  }
+}
+
+TEST(CompressPointCloudTest, ProtoRoundTrip) {
+  PointCloud point_cloud;
+  for (int i = 0; i < 100; ++i) {
+    point_cloud.push_back({Eigen::Vector3f(0.1f * i, 0.2f * i, 0.3f * i)});
+  }
+  const CompressedPointCloud compressed(point_cloud);
+  const CompressedPointCloud from_proto(compressed.ToProto());
+  EXPECT_TRUE(compressed == from_proto);
+  EXPECT_EQ(compressed.num_blocks(), from_proto.num_blocks());
+}
+
 }  // namespace
 }  // namespace sensor
 }  // namespace cartographer
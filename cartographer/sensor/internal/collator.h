@@ -33,6 +33,9 @@ namespace sensor {
 class Collator : public CollatorInterface {
  public:
   Collator() {}
+  // Does not wait for sensors lagging more than 'max_lag' behind, see
+  // OrderedMultiQueue.
+  explicit Collator(common::Duration max_lag) : queue_(max_lag) {}
 
   Collator(const Collator&) = delete;
   Collator& operator=(const Collator&) = delete;
@@ -17,33 +17,55 @@
 #ifndef CARTOGRAPHER_SENSOR_INTERNAL_DISPATCHABLE_H_
 #define CARTOGRAPHER_SENSOR_INTERNAL_DISPATCHABLE_H_
 
+#include <cstddef>
+#include <utility>
+
+#include "cartographer/common/internal/pool_allocator.h"
 #include "cartographer/mapping/trajectory_builder_interface.h"
 #include "cartographer/sensor/data.h"
 
 namespace cartographer {
 namespace sensor {
 
+// Owns sensor data until it is dispatched. The data is moved into the
+// trajectory builder, so AddToTrajectoryBuilder() must only be called once and
+// 'data()' is only valid before that.
 template <typename DataType>
 class Dispatchable : public Data {
  public:
-  Dispatchable(const std::string &sensor_id, const DataType &data)
-      : Data(sensor_id), data_(data) {}
+  Dispatchable(const std::string &sensor_id, DataType data)
+      : Data(sensor_id), data_(std::move(data)) {}
+
+  // One is created for every sensor message, so they are allocated from a
+  // pool.
+  static void *operator new(const size_t size) {
+    CHECK_EQ(size, sizeof(Dispatchable));
+    return GetPool()->Allocate();
+  }
+  static void operator delete(void *const pointer) {
+    GetPool()->Deallocate(pointer);
+  }
 
   common::Time GetTime() const override { return data_.time; }
   void AddToTrajectoryBuilder(
       mapping::TrajectoryBuilderInterface *const trajectory_builder) override {
-    trajectory_builder->AddSensorData(sensor_id_, data_);
+    trajectory_builder->AddSensorData(sensor_id_, std::move(data_));
   }
   const DataType &data() const { return data_; }
 
  private:
-  const DataType data_;
+  static auto *GetPool() {
+    return common::FixedSizeBlockPool<sizeof(Dispatchable),
+                                      alignof(Dispatchable)>::Get();
+  }
+
+  DataType data_;
 };
 
 template <typename DataType>
 std::unique_ptr<Dispatchable<DataType>> MakeDispatchable(
-    const std::string &sensor_id, const DataType &data) {
-  return absl::make_unique<Dispatchable<DataType>>(sensor_id, data);
+    const std::string &sensor_id, DataType data) {
+  return absl::make_unique<Dispatchable<DataType>>(sensor_id, std::move(data));
 }
 
 }  // namespace sensor
@@ -18,9 +18,12 @@
 
 #include <algorithm>
 #include <sstream>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "glog/logging.h"
 
 namespace cartographer {
@@ -30,16 +33,41 @@ namespace {
 
 // Number of items that can be queued up before we log which queues are waiting
 // for data.
-const int kMaxQueueSize = 500;
+const size_t kMaxQueueSize = 500;
+
+double ToSeconds(const std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::duration<double>>(duration)
+      .count();
+}
 
 }  // namespace
 
+metrics::Family<metrics::Gauge>* OrderedMultiQueue::depth_metrics_family_ =
+    metrics::Family<metrics::Gauge>::Null();
+metrics::Family<metrics::Gauge>*
+    OrderedMultiQueue::oldest_age_metrics_family_ =
+        metrics::Family<metrics::Gauge>::Null();
+metrics::Family<metrics::Counter>*
+    OrderedMultiQueue::blocking_seconds_metrics_family_ =
+        metrics::Family<metrics::Counter>::Null();
+metrics::Family<metrics::Histogram>*
+    OrderedMultiQueue::wait_seconds_metrics_family_ =
+        metrics::Family<metrics::Histogram>::Null();
+metrics::Family<metrics::Counter>*
+    OrderedMultiQueue::late_data_metrics_family_ =
+        metrics::Family<metrics::Counter>::Null();
+
 inline std::ostream& operator<<(std::ostream& out, const QueueKey& key) {
   return out << '(' << key.trajectory_id << ", " << key.sensor_id << ')';
 }
 
 OrderedMultiQueue::OrderedMultiQueue() {}
 
+OrderedMultiQueue::OrderedMultiQueue(const common::Duration max_lag)
+    : max_lag_(max_lag) {
+  CHECK_GE(max_lag_, common::Duration::zero());
+}
+
 OrderedMultiQueue::~OrderedMultiQueue() {
   for (auto& entry : queues_) {
     CHECK(entry.second.finished);
@@ -48,7 +76,24 @@ OrderedMultiQueue::~OrderedMultiQueue() {
 
 void OrderedMultiQueue::AddQueue(const QueueKey& queue_key, Callback callback) {
   CHECK_EQ(queues_.count(queue_key), 0);
-  queues_[queue_key].callback = std::move(callback);
+  const QueueIterator it =
+      queues_
+          .emplace(std::piecewise_construct, std::forward_as_tuple(queue_key),
+                   std::forward_as_tuple())
+          .first;
+  it->second.callback = std::move(callback);
+  const std::map<std::string, std::string> labels = {
+      {"trajectory_id", absl::StrCat(queue_key.trajectory_id)},
+      {"sensor_id", queue_key.sensor_id}};
+  it->second.depth_metric = depth_metrics_family_->Add(labels);
+  it->second.oldest_age_metric = oldest_age_metrics_family_->Add(labels);
+  it->second.blocking_seconds_metric =
+      blocking_seconds_metrics_family_->Add(labels);
+  it->second.wait_seconds_metric = wait_seconds_metrics_family_->Add(labels);
+  it->second.late_data_metric = late_data_metrics_family_->Add(labels);
+  it->second.heap_index = heap_.size();
+  heap_.push_back(it);
+  UpdateHeap(it->second.heap_index);
 }
 
 void OrderedMultiQueue::MarkQueueAsFinished(const QueueKey& queue_key) {
@@ -57,6 +102,11 @@ void OrderedMultiQueue::MarkQueueAsFinished(const QueueKey& queue_key) {
   auto& queue = it->second;
   CHECK(!queue.finished);
   queue.finished = true;
+  if (queue.lagging) {
+    // Finished queues are removed from the top of the heap.
+    queue.lagging = false;
+    UpdateHeap(queue.heap_index);
+  }
   Dispatch();
 }
 
@@ -68,7 +118,33 @@ void OrderedMultiQueue::Add(const QueueKey& queue_key,
         << "Ignored data for queue: '" << queue_key << "'";
     return;
   }
-  it->second.queue.Push(std::move(data));
+  auto& queue = it->second;
+  if (queue.lagging) {
+    if (data->GetTime() < last_dispatched_time_) {
+      LOG_EVERY_N(WARNING, 100)
+          << "Dropped data of lagging queue '" << queue_key << "', which is "
+          << common::ToSeconds(last_dispatched_time_ - data->GetTime())
+          << " s older than data dispatched already.";
+      queue.late_data_metric->Increment();
+      return;
+    }
+    // Sorted again from here on. The heap is updated below as for any empty
+    // queue receiving data.
+    queue.lagging = false;
+  }
+  queue.last_added_time = data->GetTime();
+  newest_added_time_ = std::max(newest_added_time_, data->GetTime());
+  queue.queue.Push(std::move(data));
+  queue.add_times.push_back(Clock::now());
+  ++num_queued_values_;
+  queue.depth_metric->Set(queue.add_times.size());
+  if (queue.next_data == nullptr) {
+    queue.next_data = queue.queue.Peek<Data>();
+    UpdateHeap(queue.heap_index);
+  }
+  if (queue.queue.Size() == kMaxQueueSize + 1) {
+    ++num_queues_above_max_size_;
+  }
   Dispatch();
 }
 
@@ -89,34 +165,59 @@ QueueKey OrderedMultiQueue::GetBlocker() const {
   return blocker_;
 }
 
+void OrderedMultiQueue::RegisterMetrics(
+    metrics::FamilyFactory* family_factory) {
+  depth_metrics_family_ = family_factory->NewGaugeFamily(
+      "collator_queue_depth", "Sensor data waiting to be dispatched");
+  oldest_age_metrics_family_ = family_factory->NewGaugeFamily(
+      "collator_queue_oldest_age_seconds",
+      "Time the oldest sensor data waiting to be dispatched was added ago");
+  blocking_seconds_metrics_family_ = family_factory->NewCounterFamily(
+      "collator_blocking_seconds_total",
+      "Time other sensor data waited for data of this sensor");
+  // 100us to ~3.3s.
+  wait_seconds_metrics_family_ = family_factory->NewHistogramFamily(
+      "collator_wait_seconds",
+      "Time sensor data waited in the collator until it was dispatched",
+      metrics::Histogram::ScaledPowersOf(2, 1e-4, 3.3));
+  late_data_metrics_family_ = family_factory->NewCounterFamily(
+      "collator_late_data_dropped_total",
+      "Sensor data which arrived after its queue was no longer waited for");
+}
+
 void OrderedMultiQueue::Dispatch() {
+  const Clock::time_point now = Clock::now();
+  // Restarted by 'CannotMakeProgress()' if still blocked.
+  AccountBlockingTime(now);
   while (true) {
-    const Data* next_data = nullptr;
-    Queue* next_queue = nullptr;
-    QueueKey next_queue_key;
-    for (auto it = queues_.begin(); it != queues_.end();) {
-      const auto* data = it->second.queue.Peek<Data>();
-      if (data == nullptr) {
-        if (it->second.finished) {
-          queues_.erase(it++);
-          continue;
-        }
-        CannotMakeProgress(it->first);
-        return;
-      }
-      if (next_data == nullptr || data->GetTime() < next_data->GetTime()) {
-        next_data = data;
-        next_queue = &it->second;
-        next_queue_key = it->first;
-      }
-      CHECK_LE(last_dispatched_time_, next_data->GetTime())
-          << "Non-sorted data added to queue: '" << it->first << "'";
-      ++it;
+    if (heap_.empty()) {
+      CHECK(queues_.empty());
+      return;
     }
+    const QueueIterator next_it = heap_.front();
+    const QueueKey& next_queue_key = next_it->first;
+    Queue* const next_queue = &next_it->second;
+    const Data* const next_data = next_queue->next_data;
     if (next_data == nullptr) {
-      CHECK(queues_.empty());
+      // Empty queues are at the top of the heap ordered by key, so finished
+      // ones are removed until the first unfinished one blocks.
+      if (next_queue->finished) {
+        next_queue->oldest_age_metric->Set(0.);
+        RemoveFromHeap(0);
+        queues_.erase(next_it);
+        continue;
+      }
+      if (!next_queue->lagging && IsLagging(*next_queue)) {
+        // Moves behind all queues with data.
+        next_queue->lagging = true;
+        UpdateHeap(0);
+        continue;
+      }
+      CannotMakeProgress(next_it, now);
       return;
     }
+    CHECK_LE(last_dispatched_time_, next_data->GetTime())
+        << "Non-sorted data added to queue: '" << next_queue_key << "'";
 
     // If we haven't dispatched any data for this trajectory yet, fast forward
     // all queues of this trajectory until a common start time has been reached.
@@ -126,54 +227,184 @@ void OrderedMultiQueue::Dispatch() {
     if (next_data->GetTime() >= common_start_time) {
       // Happy case, we are beyond the 'common_start_time' already.
       last_dispatched_time_ = next_data->GetTime();
-      next_queue->callback(next_queue->queue.Pop());
+      next_queue->callback(Pop(next_it));
     } else if (next_queue->queue.Size() < 2) {
       if (!next_queue->finished) {
         // We cannot decide whether to drop or dispatch this yet.
-        CannotMakeProgress(next_queue_key);
+        CannotMakeProgress(next_it, now);
         return;
       }
       last_dispatched_time_ = next_data->GetTime();
-      next_queue->callback(next_queue->queue.Pop());
+      next_queue->callback(Pop(next_it));
     } else {
       // We take a peek at the time after next data. If it also is not beyond
       // 'common_start_time' we drop 'next_data', otherwise we just found the
       // first packet to dispatch from this queue.
-      std::unique_ptr<Data> next_data_owner = next_queue->queue.Pop();
-      if (next_queue->queue.Peek<Data>()->GetTime() > common_start_time) {
-        last_dispatched_time_ = next_data->GetTime();
+      std::unique_ptr<Data> next_data_owner = Pop(next_it);
+      if (next_queue->next_data->GetTime() > common_start_time) {
+        last_dispatched_time_ = next_data_owner->GetTime();
         next_queue->callback(std::move(next_data_owner));
       }
     }
   }
 }
 
-void OrderedMultiQueue::CannotMakeProgress(const QueueKey& queue_key) {
-  blocker_ = queue_key;
+std::unique_ptr<Data> OrderedMultiQueue::Pop(const QueueIterator it) {
+  auto& queue = it->second;
+  std::unique_ptr<Data> data = queue.queue.Pop();
+  queue.wait_seconds_metric->Observe(
+      ToSeconds(Clock::now() - queue.add_times.front()));
+  queue.add_times.pop_front();
+  --num_queued_values_;
+  queue.depth_metric->Set(queue.add_times.size());
+  if (queue.queue.Size() == kMaxQueueSize) {
+    --num_queues_above_max_size_;
+  }
+  queue.next_data = queue.queue.Peek<Data>();
+  UpdateHeap(queue.heap_index);
+  return data;
+}
+
+void OrderedMultiQueue::CannotMakeProgress(const QueueIterator it,
+                                           const Clock::time_point now) {
+  blocker_ = it->first;
+  // Dispatching stops here until more data arrives.
+  UpdateAgeMetrics(now);
+  // Only counts as blocking if some value is held back.
+  if (num_queued_values_ > 0) {
+    blocking_seconds_metric_ = it->second.blocking_seconds_metric;
+    blocking_since_ = now;
+  }
+  if (num_queues_above_max_size_ > 0) {
+    LOG_EVERY_N(WARNING, 60) << "Queue waiting for data: " << it->first;
+  }
+}
+
+// Returns true if the empty 'queue' should not be waited for, because it fell
+// more than 'max_lag_' behind the newest data. Queues which never had data are
+// always waited for, so that all sensors take part in the common start time.
+bool OrderedMultiQueue::IsLagging(const Queue& queue) const {
+  return max_lag_ > common::Duration::zero() &&
+         queue.last_added_time != common::Time::min() &&
+         newest_added_time_ - queue.last_added_time > max_lag_;
+}
+
+// Adds the time since the last call to the metric of the queue which blocked
+// dispatching, if any. The queue may have been removed since.
+void OrderedMultiQueue::AccountBlockingTime(const Clock::time_point now) {
+  if (blocking_seconds_metric_ != nullptr) {
+    blocking_seconds_metric_->Increment(ToSeconds(now - blocking_since_));
+    blocking_seconds_metric_ = nullptr;
+  }
+}
+
+// Ages are only updated when data arrives, which is frequent enough while
+// sensors are running.
+void OrderedMultiQueue::UpdateAgeMetrics(const Clock::time_point now) {
   for (auto& entry : queues_) {
-    if (entry.second.queue.Size() > kMaxQueueSize) {
-      LOG_EVERY_N(WARNING, 60) << "Queue waiting for data: " << queue_key;
-      return;
-    }
+    const Queue& queue = entry.second;
+    queue.oldest_age_metric->Set(
+        queue.add_times.empty() ? 0. : ToSeconds(now - queue.add_times.front()));
   }
 }
 
 common::Time OrderedMultiQueue::GetCommonStartTime(const int trajectory_id) {
-  auto emplace_result = common_start_time_per_trajectory_.emplace(
-      trajectory_id, common::Time::min());
-  common::Time& common_start_time = emplace_result.first->second;
-  if (emplace_result.second) {
-    for (auto& entry : queues_) {
-      if (entry.first.trajectory_id == trajectory_id) {
-        common_start_time = std::max(
-            common_start_time, entry.second.queue.Peek<Data>()->GetTime());
-      }
+  // Called for every dispatched value. Unlike emplace(), find() does not
+  // allocate if the trajectory is known.
+  const auto it = common_start_time_per_trajectory_.find(trajectory_id);
+  if (it != common_start_time_per_trajectory_.end()) {
+    return it->second;
+  }
+  common::Time common_start_time = common::Time::min();
+  for (auto& entry : queues_) {
+    if (entry.first.trajectory_id == trajectory_id) {
+      common_start_time = std::max(common_start_time,
+                                   entry.second.queue.Peek<Data>()->GetTime());
     }
-    LOG(INFO) << "All sensor data for trajectory " << trajectory_id
-              << " is available starting at '" << common_start_time << "'.";
   }
+  LOG(INFO) << "All sensor data for trajectory " << trajectory_id
+            << " is available starting at '" << common_start_time << "'.";
+  common_start_time_per_trajectory_.emplace(trajectory_id, common_start_time);
   return common_start_time;
 }
 
+void OrderedMultiQueue::UpdateHeap(const size_t heap_index) {
+  if (!SiftUp(heap_index)) {
+    SiftDown(heap_index);
+  }
+}
+
+void OrderedMultiQueue::RemoveFromHeap(const size_t heap_index) {
+  const size_t last_index = heap_.size() - 1;
+  SwapHeapEntries(heap_index, last_index);
+  heap_.pop_back();
+  if (heap_index != last_index) {
+    UpdateHeap(heap_index);
+  }
+}
+
+// Moves the entry at 'heap_index' up until the heap property holds. Returns
+// true if it moved.
+bool OrderedMultiQueue::SiftUp(size_t heap_index) {
+  bool moved = false;
+  while (heap_index > 0) {
+    const size_t parent_index = (heap_index - 1) / 2;
+    if (!HeapLess(heap_[heap_index], heap_[parent_index])) {
+      break;
+    }
+    SwapHeapEntries(heap_index, parent_index);
+    heap_index = parent_index;
+    moved = true;
+  }
+  return moved;
+}
+
+void OrderedMultiQueue::SiftDown(size_t heap_index) {
+  while (true) {
+    size_t smallest_index = heap_index;
+    for (const size_t child_index : {2 * heap_index + 1, 2 * heap_index + 2}) {
+      if (child_index < heap_.size() &&
+          HeapLess(heap_[child_index], heap_[smallest_index])) {
+        smallest_index = child_index;
+      }
+    }
+    if (smallest_index == heap_index) {
+      return;
+    }
+    SwapHeapEntries(heap_index, smallest_index);
+    heap_index = smallest_index;
+  }
+}
+
+void OrderedMultiQueue::SwapHeapEntries(const size_t a, const size_t b) {
+  std::swap(heap_[a], heap_[b]);
+  heap_[a]->second.heap_index = a;
+  heap_[b]->second.heap_index = b;
+}
+
+// Orders empty queues before all others, so that the first unfinished empty
+// queue in key order becomes the blocker. Lagging queues, which are empty, are
+// ordered after all others. Ties in time are broken by key to dispatch in the
+// same order as a scan over 'queues_' would.
+bool OrderedMultiQueue::HeapLess(const QueueIterator a, const QueueIterator b) {
+  const Data* const a_data = a->second.next_data;
+  const Data* const b_data = b->second.next_data;
+  if (a_data == nullptr || b_data == nullptr) {
+    const auto rank = [](const Queue& queue) {
+      return queue.next_data != nullptr ? 1 : (queue.lagging ? 2 : 0);
+    };
+    const int a_rank = rank(a->second);
+    const int b_rank = rank(b->second);
+    if (a_rank != b_rank) {
+      return a_rank < b_rank;
+    }
+    return a->first < b->first;
+  }
+  if (a_data->GetTime() != b_data->GetTime()) {
+    return a_data->GetTime() < b_data->GetTime();
+  }
+  return a->first < b->first;
+}
+
 }  // namespace sensor
 }  // namespace cartographer
@@ -17,15 +17,22 @@
 #ifndef CARTOGRAPHER_SENSOR_INTERNAL_ORDERED_MULTI_QUEUE_H_
 #define CARTOGRAPHER_SENSOR_INTERNAL_ORDERED_MULTI_QUEUE_H_
 
+#include <chrono>
 #include <functional>
 #include <map>
 #include <memory>
 #include <string>
 #include <tuple>
+#include <vector>
 
 #include "cartographer/common/internal/blocking_queue.h"
+#include "cartographer/common/internal/ring_buffer.h"
 #include "cartographer/common/port.h"
 #include "cartographer/common/time.h"
+#include "cartographer/metrics/counter.h"
+#include "cartographer/metrics/family_factory.h"
+#include "cartographer/metrics/gauge.h"
+#include "cartographer/metrics/histogram.h"
 #include "cartographer/sensor/internal/dispatchable.h"
 
 namespace cartographer {
@@ -45,12 +52,21 @@ struct QueueKey {
 // sorted order. It will wait to see at least one value for each unfinished
 // queue before dispatching the next time ordered value across all queues.
 //
+// The queues are kept in a binary min-heap ordered by their next value, so
+// dispatching a value is logarithmic in the number of queues.
+//
+// With a positive 'max_lag', an empty queue is no longer waited for once its
+// last value is more than 'max_lag' older than the newest value added to any
+// queue. Values which such a lagging queue delivers later than the values
+// dispatched in the meantime are dropped.
+//
 // This class is thread-compatible.
 class OrderedMultiQueue {
  public:
   using Callback = std::function<void(std::unique_ptr<Data>)>;
 
   OrderedMultiQueue();
+  explicit OrderedMultiQueue(common::Duration max_lag);
   OrderedMultiQueue(OrderedMultiQueue&& queue) = default;
 
   ~OrderedMultiQueue();
@@ -76,23 +92,81 @@ class OrderedMultiQueue {
   // dispatch data.
   QueueKey GetBlocker() const;
 
+  // Exports, labeled by trajectory and sensor, the number of values in each
+  // queue, how long the oldest of them has been waiting, for how long each
+  // queue held back the values of all others by having no data, how long each
+  // value waited until it was dispatched, and how many late values of lagging
+  // queues were dropped.
+  static void RegisterMetrics(metrics::FamilyFactory* family_factory);
+
  private:
+  using Clock = std::chrono::steady_clock;
+
   struct Queue {
     common::BlockingQueue<std::unique_ptr<Data>> queue;
+    // When each value in 'queue' was added.
+    common::RingBuffer<Clock::time_point> add_times;
     Callback callback;
     bool finished = false;
+    // Set while the queue is empty and not waited for, see 'max_lag_'.
+    bool lagging = false;
+    // Time of the last value added to 'queue'.
+    common::Time last_added_time = common::Time::min();
+    // Next value in 'queue' or nullptr if it is empty.
+    const Data* next_data = nullptr;
+    // Position of this queue in 'heap_'.
+    size_t heap_index = 0;
+    metrics::Gauge* depth_metric = metrics::Gauge::Null();
+    metrics::Gauge* oldest_age_metric = metrics::Gauge::Null();
+    metrics::Counter* blocking_seconds_metric = metrics::Counter::Null();
+    metrics::Histogram* wait_seconds_metric = metrics::Histogram::Null();
+    metrics::Counter* late_data_metric = metrics::Counter::Null();
   };
+  using QueueIterator = std::map<QueueKey, Queue>::iterator;
 
   void Dispatch();
-  void CannotMakeProgress(const QueueKey& queue_key);
+  void UpdateAgeMetrics(Clock::time_point now);
+  void AccountBlockingTime(Clock::time_point now);
+  std::unique_ptr<Data> Pop(QueueIterator it);
+  void UpdateHeap(size_t heap_index);
+  void RemoveFromHeap(size_t heap_index);
+  bool SiftUp(size_t heap_index);
+  void SiftDown(size_t heap_index);
+  void SwapHeapEntries(size_t a, size_t b);
+  static bool HeapLess(QueueIterator a, QueueIterator b);
+  void CannotMakeProgress(QueueIterator it, Clock::time_point now);
+  bool IsLagging(const Queue& queue) const;
   common::Time GetCommonStartTime(int trajectory_id);
 
+  // Zero if queues are always waited for.
+  common::Duration max_lag_ = common::Duration::zero();
+
   // Used to verify that values are dispatched in sorted order.
   common::Time last_dispatched_time_ = common::Time::min();
+  // Time of the newest value added to any queue.
+  common::Time newest_added_time_ = common::Time::min();
 
   std::map<int, common::Time> common_start_time_per_trajectory_;
   std::map<QueueKey, Queue> queues_;
+  // Min-heap over 'queues_'. Empty queues come first ordered by key, since the
+  // first of them blocks dispatching, followed by all others ordered by the
+  // time of their next value. Empty queues which are lagging come last.
+  std::vector<QueueIterator> heap_;
+  // Number of queues holding more than 'kMaxQueueSize' values.
+  int num_queues_above_max_size_ = 0;
+  // Number of values in all queues.
+  size_t num_queued_values_ = 0;
   QueueKey blocker_;
+  // While values wait for the blocker, its metric and since when its blocking
+  // time has not been added to it yet.
+  metrics::Counter* blocking_seconds_metric_ = nullptr;
+  Clock::time_point blocking_since_;
+
+  static metrics::Family<metrics::Gauge>* depth_metrics_family_;
+  static metrics::Family<metrics::Gauge>* oldest_age_metrics_family_;
+  static metrics::Family<metrics::Counter>* blocking_seconds_metrics_family_;
+  static metrics::Family<metrics::Histogram>* wait_seconds_metrics_family_;
+  static metrics::Family<metrics::Counter>* late_data_metrics_family_;
 };
 
 }  // namespace sensor
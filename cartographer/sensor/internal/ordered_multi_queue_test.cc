@@ -16,9 +16,14 @@
 
 #include "cartographer/sensor/internal/ordered_multi_queue.h"
 
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "gtest/gtest.h"
 
 namespace cartographer {
@@ -111,6 +116,174 @@ TEST_F(OrderedMultiQueueTest, CommonStartTimePerTrajectory) {
   EXPECT_EQ(values_.size(), 4);
 }
 
+TEST(OrderedMultiQueueMaxLagTest, DoesNotWaitForLaggingQueues) {
+  OrderedMultiQueue queue(common::Duration(10));
+  std::vector<std::string> dispatched;
+  for (const std::string sensor_id : {"imu", "scan"}) {
+    queue.AddQueue(QueueKey{0, sensor_id},
+                   [&dispatched, sensor_id](std::unique_ptr<Data> data) {
+                     dispatched.push_back(absl::StrCat(
+                         sensor_id, common::ToUniversal(data->GetTime())));
+                   });
+  }
+  const auto add = [&queue](const std::string& sensor_id, const int ordinal) {
+    queue.Add(QueueKey{0, sensor_id},
+              MakeDispatchable(sensor_id,
+                               ImuData{common::FromUniversal(ordinal),
+                                       Eigen::Vector3d::Zero(),
+                                       Eigen::Vector3d::Zero()}));
+  };
+  add("imu", 0);
+  add("scan", 0);
+  add("imu", 5);
+  EXPECT_EQ(dispatched, (std::vector<std::string>{"imu0", "scan0"}));
+  // The IMU is only 3 behind, so the scan waits for it.
+  add("scan", 8);
+  EXPECT_EQ(dispatched, (std::vector<std::string>{"imu0", "scan0", "imu5"}));
+  // Now it is 15 behind and no longer waited for.
+  add("scan", 20);
+  EXPECT_EQ(dispatched, (std::vector<std::string>{"imu0", "scan0", "imu5",
+                                                  "scan8", "scan20"}));
+  // Late IMU data is dropped, newer data is waited for again.
+  add("imu", 12);
+  add("imu", 21);
+  add("scan", 22);
+  EXPECT_EQ(dispatched, (std::vector<std::string>{"imu0", "scan0", "imu5",
+                                                  "scan8", "scan20", "imu21"}));
+  queue.Flush();
+  EXPECT_EQ(dispatched.size(), 7);
+  EXPECT_EQ(dispatched.back(), "scan22");
+}
+
+TEST(OrderedMultiQueueManyQueuesTest, MergesAndReportsBlocker) {
+  const int kNumQueues = 50;
+  OrderedMultiQueue queue;
+  std::vector<std::unique_ptr<Data>> values;
+  for (int i = 0; i != kNumQueues; ++i) {
+    queue.AddQueue(QueueKey{0, std::to_string(100 + i)},
+                   [&values](std::unique_ptr<Data> data) {
+                     values.push_back(std::move(data));
+                   });
+  }
+  const auto make_imu = [](const int ordinal) {
+    return MakeDispatchable("imu", ImuData{common::FromUniversal(ordinal),
+                                           Eigen::Vector3d::Zero(),
+                                           Eigen::Vector3d::Zero()});
+  };
+  // Queue 'i' holds the times 'i', 'i + kNumQueues', ... so each queue in turn
+  // blocks until its next value is added.
+  for (int round = 0; round != 3; ++round) {
+    for (int i = 0; i != kNumQueues; ++i) {
+      if (round != 0 || i != 0) {
+        EXPECT_EQ(std::to_string(100 + i), queue.GetBlocker().sensor_id);
+      }
+      queue.Add(QueueKey{0, std::to_string(100 + i)},
+                make_imu(round * kNumQueues + i));
+    }
+  }
+  queue.Flush();
+  ASSERT_EQ(3 * kNumQueues, values.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(i, common::ToUniversal(values[i]->GetTime()));
+  }
+}
+
+// Keeps the last value of each gauge and the total of each counter, keyed by
+// the 'sensor_id' label.
+class FakeFamilyFactory : public metrics::FamilyFactory {
+ public:
+  class FakeMetric : public metrics::Counter, public metrics::Gauge {
+   public:
+    void Increment() override { value += 1.; }
+    void Increment(const double by_value) override { value += by_value; }
+    void Decrement() override { value -= 1.; }
+    void Decrement(const double by_value) override { value -= by_value; }
+    void Set(const double new_value) override { value = new_value; }
+
+    double value = 0.;
+  };
+
+  template <typename MetricType>
+  class FakeFamily : public metrics::Family<MetricType> {
+   public:
+    MetricType* Add(
+        const std::map<std::string, std::string>& labels) override {
+      return &metrics[labels.at("sensor_id")];
+    }
+
+    std::map<std::string, FakeMetric> metrics;
+  };
+
+  metrics::Family<metrics::Counter>* NewCounterFamily(
+      const std::string& name, const std::string&) override {
+    return &counters[name];
+  }
+  metrics::Family<metrics::Gauge>* NewGaugeFamily(
+      const std::string& name, const std::string&) override {
+    return &gauges[name];
+  }
+  metrics::Family<metrics::Histogram>* NewHistogramFamily(
+      const std::string&, const std::string&,
+      const metrics::Histogram::BucketBoundaries&) override {
+    return metrics::Family<metrics::Histogram>::Null();
+  }
+
+  std::map<std::string, FakeFamily<metrics::Counter>> counters;
+  std::map<std::string, FakeFamily<metrics::Gauge>> gauges;
+};
+
+TEST(OrderedMultiQueueMetricsTest, ExportsDepthAgeAndBlockingTime) {
+  // Outlives the test, since the families are registered globally.
+  static FakeFamilyFactory* const family_factory = new FakeFamilyFactory;
+  OrderedMultiQueue::RegisterMetrics(family_factory);
+  const auto make_imu = [](const int ordinal) {
+    return MakeDispatchable(
+        "imu", ImuData{common::FromUniversal(ordinal), Eigen::Vector3d::Zero(),
+                       Eigen::Vector3d::Zero()});
+  };
+  const auto gauge = [](const std::string& name,
+                        const std::string& sensor_id) {
+    return family_factory->gauges[name].metrics[sensor_id].value;
+  };
+  const auto blocking_seconds = [](const std::string& sensor_id) {
+    return family_factory->counters["collator_blocking_seconds_total"]
+        .metrics[sensor_id]
+        .value;
+  };
+
+  OrderedMultiQueue queue;
+  int num_dispatched = 0;
+  for (const std::string sensor_id : {"depth", "imu"}) {
+    queue.AddQueue(QueueKey{0, sensor_id},
+                   [&num_dispatched](std::unique_ptr<Data>) {
+                     ++num_dispatched;
+                   });
+  }
+  queue.Add(QueueKey{0, "imu"}, make_imu(0));
+  queue.Add(QueueKey{0, "imu"}, make_imu(1));
+  EXPECT_EQ(gauge("collator_queue_depth", "imu"), 2.);
+  EXPECT_EQ(gauge("collator_queue_depth", "depth"), 0.);
+
+  const std::chrono::milliseconds kWait(20);
+  std::this_thread::sleep_for(kWait);
+  queue.Add(QueueKey{0, "imu"}, make_imu(2));
+  EXPECT_EQ(num_dispatched, 0);
+  EXPECT_GE(gauge("collator_queue_oldest_age_seconds", "imu"), 0.02);
+  EXPECT_EQ(gauge("collator_queue_oldest_age_seconds", "depth"), 0.);
+  EXPECT_GE(blocking_seconds("depth"), 0.02);
+  EXPECT_EQ(blocking_seconds("imu"), 0.);
+
+  queue.Add(QueueKey{0, "depth"}, make_imu(0));
+  // Still waits for the next depth data.
+  EXPECT_EQ(num_dispatched, 1);
+  EXPECT_EQ(gauge("collator_queue_depth", "imu"), 3.);
+  queue.Flush();
+  EXPECT_EQ(num_dispatched, 4);
+  EXPECT_EQ(gauge("collator_queue_depth", "imu"), 0.);
+  EXPECT_EQ(gauge("collator_queue_oldest_age_seconds", "imu"), 0.);
+  EXPECT_EQ(blocking_seconds("imu"), 0.);
+}
+
 }  // namespace
 }  // namespace sensor
 }  // namespace cartographer
@@ -29,10 +29,14 @@ void TrajectoryCollator::AddTrajectory(
     const int trajectory_id,
     const absl::flat_hash_set<std::string>& expected_sensor_ids,
     const Callback& callback) {
+  absl::MutexLock locker(&mutex_);
   CHECK_EQ(trajectory_to_queue_.count(trajectory_id), 0);
+  OrderedMultiQueue& queue =
+      trajectory_to_queue_.emplace(trajectory_id, OrderedMultiQueue(max_lag_))
+          .first->second;
   for (const auto& sensor_id : expected_sensor_ids) {
     const auto queue_key = QueueKey{trajectory_id, sensor_id};
-    trajectory_to_queue_[trajectory_id].AddQueue(
+    queue.AddQueue(
         queue_key, [callback, sensor_id](std::unique_ptr<Data> data) {
           callback(sensor_id, std::move(data));
         });
@@ -41,21 +45,29 @@ void TrajectoryCollator::AddTrajectory(
 }
 
 void TrajectoryCollator::FinishTrajectory(const int trajectory_id) {
-  for (const auto& queue_key : trajectory_to_queue_keys_[trajectory_id]) {
-    trajectory_to_queue_.at(trajectory_id).MarkQueueAsFinished(queue_key);
+  std::vector<QueueKey> queue_keys;
+  {
+    absl::MutexLock locker(&mutex_);
+    queue_keys = trajectory_to_queue_keys_[trajectory_id];
+  }
+  OrderedMultiQueue* const queue = GetQueue(trajectory_id);
+  for (const auto& queue_key : queue_keys) {
+    queue->MarkQueueAsFinished(queue_key);
   }
 }
 
 void TrajectoryCollator::AddSensorData(const int trajectory_id,
                                        std::unique_ptr<Data> data) {
   QueueKey queue_key{trajectory_id, data->GetSensorId()};
-  auto* metric = GetOrCreateSensorMetric(data->GetSensorId(), trajectory_id);
-  metric->Increment();
-  trajectory_to_queue_.at(trajectory_id)
-      .Add(std::move(queue_key), std::move(data));
+  {
+    absl::MutexLock locker(&mutex_);
+    GetOrCreateSensorMetric(data->GetSensorId(), trajectory_id)->Increment();
+  }
+  GetQueue(trajectory_id)->Add(std::move(queue_key), std::move(data));
 }
 
 void TrajectoryCollator::Flush() {
+  absl::MutexLock locker(&mutex_);
   for (auto& it : trajectory_to_queue_) {
     it.second.Flush();
   }
@@ -71,21 +83,26 @@ void TrajectoryCollator::RegisterMetrics(
       "collator_input_total", "Sensor data received");
 }
 
+OrderedMultiQueue* TrajectoryCollator::GetQueue(const int trajectory_id) {
+  absl::MutexLock locker(&mutex_);
+  return &trajectory_to_queue_.at(trajectory_id);
+}
+
 metrics::Counter* TrajectoryCollator::GetOrCreateSensorMetric(
     const std::string& sensor_id, int trajectory_id) {
-  const std::string trajectory_id_str = absl::StrCat(trajectory_id);
-  const std::string map_key = absl::StrCat(sensor_id, "/", trajectory_id_str);
-
-  auto metrics_map_itr = metrics_map_.find(map_key);
-  if (metrics_map_itr != metrics_map_.end()) {
+  auto& sensor_to_counter = metrics_map_[trajectory_id];
+  auto metrics_map_itr = sensor_to_counter.find(sensor_id);
+  if (metrics_map_itr != sensor_to_counter.end()) {
     return metrics_map_itr->second;
   }
 
-  LOG(INFO) << "Create metrics handler for key: " << map_key;
+  const std::string trajectory_id_str = absl::StrCat(trajectory_id);
+  LOG(INFO) << "Create metrics handler for key: " << sensor_id << "/"
+            << trajectory_id_str;
   auto new_counter = collator_metrics_family_->Add(
       {{"sensor_id", sensor_id}, {"trajectory_id", trajectory_id_str}});
 
-  metrics_map_[map_key] = new_counter;
+  sensor_to_counter[sensor_id] = new_counter;
   return new_counter;
 }
 
@@ -21,6 +21,8 @@
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/node_hash_map.h"
+#include "absl/synchronization/mutex.h"
 #include "cartographer/metrics/counter.h"
 #include "cartographer/metrics/family_factory.h"
 #include "cartographer/sensor/collator_interface.h"
@@ -35,9 +37,14 @@ namespace sensor {
 // Also contrary to 'Collator', whose output is deterministic, the sequence in
 // which data is dispatched is not sorted, so non-deterministic input sequences
 // will result in non-deterministic output.
+// Data of different trajectories may be added concurrently, but data of each
+// trajectory must be added from one thread at a time.
 class TrajectoryCollator : public CollatorInterface {
  public:
   TrajectoryCollator() {}
+  // Does not wait for sensors lagging more than 'max_lag' behind, see
+  // OrderedMultiQueue.
+  explicit TrajectoryCollator(common::Duration max_lag) : max_lag_(max_lag) {}
 
   TrajectoryCollator(const TrajectoryCollator&) = delete;
   TrajectoryCollator& operator=(const TrajectoryCollator&) = delete;
@@ -59,18 +66,32 @@ class TrajectoryCollator : public CollatorInterface {
 
  private:
   metrics::Counter* GetOrCreateSensorMetric(const std::string& sensor_id,
-                                            int trajectory_id);
+                                            int trajectory_id)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  OrderedMultiQueue* GetQueue(int trajectory_id) LOCKS_EXCLUDED(mutex_);
 
   static cartographer::metrics::Family<metrics::Counter>*
       collator_metrics_family_;
 
-  // Holds individual counters for each trajectory/sensor pair.
-  absl::flat_hash_map<std::string, metrics::Counter*> metrics_map_;
+  const common::Duration max_lag_ = common::Duration::zero();
 
-  absl::flat_hash_map<int, OrderedMultiQueue> trajectory_to_queue_;
+  // Guards the maps, not the queues themselves, which dispatch data without
+  // holding it.
+  absl::Mutex mutex_;
+
+  // Holds individual counters for each trajectory/sensor pair. Keyed by
+  // trajectory first, so that looking up a counter does not build a key.
+  absl::flat_hash_map<int,
+                      absl::flat_hash_map<std::string, metrics::Counter*>>
+      metrics_map_ GUARDED_BY(mutex_);
+
+  // Node based, so that queues stay in place while trajectories are added.
+  absl::node_hash_map<int, OrderedMultiQueue> trajectory_to_queue_
+      GUARDED_BY(mutex_);
 
   // Map of trajectory ID to all associated QueueKeys.
-  absl::flat_hash_map<int, std::vector<QueueKey>> trajectory_to_queue_keys_;
+  absl::flat_hash_map<int, std::vector<QueueKey>> trajectory_to_queue_keys_
+      GUARDED_BY(mutex_);
 };
 
 }  // namespace sensor
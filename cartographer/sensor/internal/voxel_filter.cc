@@ -16,11 +16,12 @@
 
 #include "cartographer/sensor/internal/voxel_filter.h"
 
+#include <array>
 #include <cmath>
+#include <limits>
 #include <random>
 #include <utility>
 
-#include "absl/container/flat_hash_map.h"
 #include "cartographer/common/math.h"
 
 namespace cartographer {
@@ -28,24 +29,37 @@ namespace sensor {
 
 namespace {
 
-PointCloud FilterByMaxRange(const PointCloud& point_cloud,
-                            const float max_range) {
-  return point_cloud.copy_if([max_range](const RangefinderPoint& point) {
-    return point.position.norm() <= max_range;
-  });
+void FilterByMaxRange(const PointCloud& point_cloud, const float max_range,
+                      PointCloud* const result) {
+  result->clear();
+  if (point_cloud.intensities().empty()) {
+    for (const RangefinderPoint& point : point_cloud) {
+      if (point.position.norm() <= max_range) {
+        result->push_back(point);
+      }
+    }
+  } else {
+    for (size_t i = 0; i < point_cloud.size(); ++i) {
+      if (point_cloud[i].position.norm() <= max_range) {
+        result->push_back(point_cloud[i], point_cloud.intensities()[i]);
+      }
+    }
+  }
 }
 
-PointCloud AdaptivelyVoxelFiltered(
-    const proto::AdaptiveVoxelFilterOptions& options,
-    const PointCloud& point_cloud) {
+void AdaptivelyVoxelFiltered(const proto::AdaptiveVoxelFilterOptions& options,
+                             const PointCloud& point_cloud,
+                             VoxelFilterScratch* const scratch,
+                             PointCloud* const result) {
   if (point_cloud.size() <= options.min_num_points()) {
     // 'point_cloud' is already sparse enough.
-    return point_cloud;
+    *result = point_cloud;
+    return;
   }
-  PointCloud result = VoxelFilter(point_cloud, options.max_length());
-  if (result.size() >= options.min_num_points()) {
+  VoxelFilter(point_cloud, options.max_length(), scratch, result);
+  if (result->size() >= options.min_num_points()) {
     // Filtering with 'max_length' resulted in a sufficiently dense point cloud.
-    return result;
+    return;
   }
   // Search for a 'low_length' that is known to result in a sufficiently
   // dense point cloud. We give up and use the full 'point_cloud' if reducing
@@ -53,25 +67,24 @@ PointCloud AdaptivelyVoxelFiltered(
   for (float high_length = options.max_length();
        high_length > 1e-2f * options.max_length(); high_length /= 2.f) {
     float low_length = high_length / 2.f;
-    result = VoxelFilter(point_cloud, low_length);
-    if (result.size() >= options.min_num_points()) {
+    VoxelFilter(point_cloud, low_length, scratch, result);
+    if (result->size() >= options.min_num_points()) {
       // Binary search to find the right amount of filtering. 'low_length' gave
       // a sufficiently dense 'result', 'high_length' did not. We stop when the
       // edge length is at most 10% off.
       while ((high_length - low_length) / low_length > 1e-1f) {
         const float mid_length = (low_length + high_length) / 2.f;
-        const PointCloud candidate = VoxelFilter(point_cloud, mid_length);
-        if (candidate.size() >= options.min_num_points()) {
+        VoxelFilter(point_cloud, mid_length, scratch, &scratch->candidate);
+        if (scratch->candidate.size() >= options.min_num_points()) {
           low_length = mid_length;
-          result = candidate;
+          std::swap(*result, scratch->candidate);
         } else {
           high_length = mid_length;
         }
       }
-      return result;
+      return;
     }
   }
-  return result;
 }
 
 using VoxelKeyType = uint64_t;
@@ -85,52 +98,256 @@ VoxelKeyType GetVoxelCellIndex(const Eigen::Vector3f& point,
   return (x << 42) + (y << 21) + z;
 }
 
-template <class T, class PointFunction>
-std::vector<bool> RandomizedVoxelFilterIndices(
-    const std::vector<T>& point_cloud, const float resolution,
-    PointFunction&& point_function) {
+// Returns the voxel for 'key' in 'scratch->voxels', which has 2^'num_bits'
+// entries. If the voxel is not there yet, an unused entry is returned.
+VoxelFilterScratch::Voxel* FindVoxel(const VoxelKeyType key, const int num_bits,
+                                     VoxelFilterScratch* const scratch) {
+  const size_t mask = scratch->voxels.size() - 1;
+  size_t index = (key * uint64_t{0x9e3779b97f4a7c15}) >> (64 - num_bits);
+  while (scratch->voxels[index].num_points != 0 &&
+         scratch->voxels[index].key != key) {
+    index = (index + 1) & mask;
+  }
+  return &scratch->voxels[index];
+}
+
+// Sorts 'scratch->keys_and_indices' by the 'num_key_bits' bits above the
+// lower 32 bits. The sort is stable, so point indices stay ordered within each
+// voxel.
+void RadixSortByVoxelKey(const int num_key_bits,
+                         VoxelFilterScratch* const scratch) {
+  constexpr int kRadixBits = 11;
+  constexpr int kNumBuckets = 1 << kRadixBits;
+  std::array<size_t, kNumBuckets> offsets;
+  std::vector<uint64_t>& keys = scratch->keys_and_indices;
+  std::vector<uint64_t>& buffer = scratch->radix_sort_buffer;
+  buffer.resize(keys.size());
+  for (int shift = 32; shift < 32 + num_key_bits; shift += kRadixBits) {
+    offsets.fill(0);
+    for (const uint64_t key : keys) {
+      ++offsets[(key >> shift) & (kNumBuckets - 1)];
+    }
+    size_t offset = 0;
+    for (size_t& bucket_offset : offsets) {
+      const size_t bucket_size = bucket_offset;
+      bucket_offset = offset;
+      offset += bucket_size;
+    }
+    for (const uint64_t key : keys) {
+      buffer[offsets[(key >> shift) & (kNumBuckets - 1)]++] = key;
+    }
+    keys.swap(buffer);
+  }
+}
+
+// Sets 'scratch->points_used' by numbering the voxels in the bounding box of
+// the points. Returns false if there are too many voxels for a 32-bit key.
+//
+// If the points occupy a good fraction of these voxels, points are counted per
+// voxel in an array. Otherwise, they are grouped with a radix sort by voxel,
+// which finds for each point how many points of its voxel come before it. In
+// both cases, reservoir sampling makes the same random draws in the same order
+// as with the hash table below, so the result is the same.
+//
+// 'PointContainer' is a 'std::vector' of points or an 'AlignedPointCloud'.
+template <class PointContainer, class PointFunction>
+bool SortedVoxelFilterIndices(const PointContainer& point_cloud,
+                              const float resolution,
+                              PointFunction&& point_function,
+                              VoxelFilterScratch* const scratch) {
+  const size_t num_points = point_cloud.size();
+  if (num_points == 0 || num_points > std::numeric_limits<uint32_t>::max()) {
+    return false;
+  }
+  std::vector<Eigen::Array3i>& cell_indices = scratch->cell_indices;
+  cell_indices.resize(num_points);
+  Eigen::Array3i min_cell_index =
+      Eigen::Array3i::Constant(std::numeric_limits<int>::max());
+  Eigen::Array3i max_cell_index =
+      Eigen::Array3i::Constant(std::numeric_limits<int>::min());
+  for (size_t i = 0; i < num_points; ++i) {
+    const Eigen::Array3f index =
+        point_function(point_cloud[i]).array() / resolution;
+    cell_indices[i] =
+        Eigen::Array3i(common::RoundToInt(index.x()),
+                       common::RoundToInt(index.y()),
+                       common::RoundToInt(index.z()));
+    min_cell_index = min_cell_index.min(cell_indices[i]);
+    max_cell_index = max_cell_index.max(cell_indices[i]);
+  }
+  const Eigen::Array3d extent =
+      (max_cell_index.cast<double>() - min_cell_index.cast<double>()) + 1.;
+  if (extent.prod() > std::numeric_limits<uint32_t>::max()) {
+    return false;
+  }
+  const uint64_t num_y_cells = static_cast<uint64_t>(extent.y());
+  const uint64_t num_z_cells = static_cast<uint64_t>(extent.z());
+  scratch->keys_and_indices.resize(num_points);
+  for (size_t i = 0; i < num_points; ++i) {
+    const Eigen::Array3i offset = cell_indices[i] - min_cell_index;
+    const uint64_t key = (offset.x() * num_y_cells + offset.y()) * num_z_cells +
+                         offset.z();
+    scratch->keys_and_indices[i] = (key << 32) | i;
+  }
+  const uint64_t max_key = static_cast<uint64_t>(extent.prod()) - 1;
+  // According to https://en.wikipedia.org/wiki/Reservoir_sampling
+  std::minstd_rand0 generator;
+  scratch->points_used.assign(num_points, false);
+  if (max_key < 4 * num_points) {
+    // Few enough voxels to count the points of each without sorting.
+    scratch->rank_in_voxel.assign(max_key + 1, 0);
+    scratch->sampled_point_index.resize(max_key + 1);
+    for (size_t i = 0; i < num_points; ++i) {
+      const uint32_t key =
+          static_cast<uint32_t>(scratch->keys_and_indices[i] >> 32);
+      const int num_points_in_voxel = ++scratch->rank_in_voxel[key];
+      if (num_points_in_voxel == 1) {
+        scratch->sampled_point_index[key] = i;
+      } else {
+        std::uniform_int_distribution<> distribution(1, num_points_in_voxel);
+        if (distribution(generator) == num_points_in_voxel) {
+          scratch->sampled_point_index[key] = i;
+        }
+      }
+    }
+    for (uint64_t key = 0; key <= max_key; ++key) {
+      if (scratch->rank_in_voxel[key] != 0) {
+        scratch->points_used[scratch->sampled_point_index[key]] = true;
+      }
+    }
+    return true;
+  }
+
+  int num_key_bits = 0;
+  while (num_key_bits < 32 && (max_key >> num_key_bits) != 0) {
+    ++num_key_bits;
+  }
+  RadixSortByVoxelKey(num_key_bits, scratch);
+
+  scratch->voxel_index_of_point.resize(num_points);
+  scratch->rank_in_voxel.resize(num_points);
+  int num_voxels = 0;
+  int rank = 0;
+  uint64_t previous_key = std::numeric_limits<uint64_t>::max();
+  for (const uint64_t key_and_index : scratch->keys_and_indices) {
+    const uint64_t key = key_and_index >> 32;
+    if (key != previous_key) {
+      previous_key = key;
+      ++num_voxels;
+      rank = 0;
+    }
+    const uint32_t point_index = static_cast<uint32_t>(key_and_index);
+    scratch->voxel_index_of_point[point_index] = num_voxels - 1;
+    scratch->rank_in_voxel[point_index] = ++rank;
+  }
+
+  scratch->sampled_point_index.resize(num_voxels);
+  for (size_t i = 0; i < num_points; ++i) {
+    const int rank_in_voxel = scratch->rank_in_voxel[i];
+    if (rank_in_voxel == 1) {
+      scratch->sampled_point_index[scratch->voxel_index_of_point[i]] = i;
+    } else {
+      std::uniform_int_distribution<> distribution(1, rank_in_voxel);
+      if (distribution(generator) == rank_in_voxel) {
+        scratch->sampled_point_index[scratch->voxel_index_of_point[i]] = i;
+      }
+    }
+  }
+  for (const int point_index : scratch->sampled_point_index) {
+    scratch->points_used[point_index] = true;
+  }
+  return true;
+}
+
+// Sets 'scratch->points_used' to mark one randomly selected point per voxel.
+template <class PointContainer, class PointFunction>
+void RandomizedVoxelFilterIndices(const PointContainer& point_cloud,
+                                  const float resolution,
+                                  PointFunction&& point_function,
+                                  VoxelFilterScratch* const scratch) {
+  if (SortedVoxelFilterIndices(point_cloud, resolution, point_function,
+                               scratch)) {
+    return;
+  }
+  // The table is kept at most half full.
+  int num_bits = 4;
+  while ((size_t{1} << num_bits) < 2 * point_cloud.size()) {
+    ++num_bits;
+  }
+  scratch->voxels.assign(size_t{1} << num_bits,
+                         VoxelFilterScratch::Voxel{0, 0, 0});
   // According to https://en.wikipedia.org/wiki/Reservoir_sampling
   std::minstd_rand0 generator;
-  absl::flat_hash_map<VoxelKeyType, std::pair<int, int>>
-      voxel_count_and_point_index;
   for (size_t i = 0; i < point_cloud.size(); i++) {
-    auto& voxel = voxel_count_and_point_index[GetVoxelCellIndex(
-        point_function(point_cloud[i]), resolution)];
-    voxel.first++;
-    if (voxel.first == 1) {
-      voxel.second = i;
+    const VoxelKeyType key =
+        GetVoxelCellIndex(point_function(point_cloud[i]), resolution);
+    VoxelFilterScratch::Voxel& voxel = *FindVoxel(key, num_bits, scratch);
+    voxel.key = key;
+    voxel.num_points++;
+    if (voxel.num_points == 1) {
+      voxel.point_index = i;
     } else {
-      std::uniform_int_distribution<> distribution(1, voxel.first);
-      if (distribution(generator) == voxel.first) {
-        voxel.second = i;
+      std::uniform_int_distribution<> distribution(1, voxel.num_points);
+      if (distribution(generator) == voxel.num_points) {
+        voxel.point_index = i;
       }
     }
   }
-  std::vector<bool> points_used(point_cloud.size(), false);
-  for (const auto& voxel_and_index : voxel_count_and_point_index) {
-    points_used[voxel_and_index.second.second] = true;
+  scratch->points_used.assign(point_cloud.size(), false);
+  for (const VoxelFilterScratch::Voxel& voxel : scratch->voxels) {
+    if (voxel.num_points != 0) {
+      scratch->points_used[voxel.point_index] = true;
+    }
   }
-  return points_used;
 }
 
 template <class T, class PointFunction>
 std::vector<T> RandomizedVoxelFilter(const std::vector<T>& point_cloud,
                                      const float resolution,
                                      PointFunction&& point_function) {
-  const std::vector<bool> points_used =
-      RandomizedVoxelFilterIndices(point_cloud, resolution, point_function);
+  VoxelFilterScratch scratch;
+  RandomizedVoxelFilterIndices(point_cloud, resolution, point_function,
+                               &scratch);
 
   std::vector<T> results;
   for (size_t i = 0; i < point_cloud.size(); i++) {
-    if (points_used[i]) {
+    if (scratch.points_used[i]) {
       results.push_back(point_cloud[i]);
     }
   }
   return results;
 }
 
+template <class T, class PointFunction>
+void RandomizedVoxelFilterInPlace(const float resolution,
+                                  PointFunction&& point_function,
+                                  VoxelFilterScratch* const scratch,
+                                  std::vector<T>* const point_cloud) {
+  RandomizedVoxelFilterIndices(*point_cloud, resolution, point_function,
+                               scratch);
+  size_t num_used = 0;
+  for (size_t i = 0; i < point_cloud->size(); i++) {
+    if (scratch->points_used[i]) {
+      (*point_cloud)[num_used++] = std::move((*point_cloud)[i]);
+    }
+  }
+  point_cloud->erase(point_cloud->begin() + num_used, point_cloud->end());
+}
+
 }  // namespace
 
+size_t VoxelFilterScratch::MemoryUsageInBytes() const {
+  return voxels.capacity() * sizeof(Voxel) +
+         cell_indices.capacity() * sizeof(Eigen::Array3i) +
+         (keys_and_indices.capacity() + radix_sort_buffer.capacity()) *
+             sizeof(uint64_t) +
+         (voxel_index_of_point.capacity() + rank_in_voxel.capacity() +
+          sampled_point_index.capacity()) *
+             sizeof(int) +
+         points_used.capacity() / 8 + points_in_range.MemoryUsageInBytes() +
+         candidate.MemoryUsageInBytes();
+}
+
 std::vector<RangefinderPoint> VoxelFilter(
     const std::vector<RangefinderPoint>& points, const float resolution) {
   return RandomizedVoxelFilter(
@@ -139,25 +356,49 @@ std::vector<RangefinderPoint> VoxelFilter(
 }
 
 PointCloud VoxelFilter(const PointCloud& point_cloud, const float resolution) {
-  const std::vector<bool> points_used = RandomizedVoxelFilterIndices(
+  VoxelFilterScratch scratch;
+  PointCloud result;
+  VoxelFilter(point_cloud, resolution, &scratch, &result);
+  return result;
+}
+
+void VoxelFilter(const PointCloud& point_cloud, const float resolution,
+                 VoxelFilterScratch* const scratch, PointCloud* const result) {
+  CHECK_NE(result, &point_cloud);
+  RandomizedVoxelFilterIndices(
       point_cloud.points(), resolution,
-      [](const RangefinderPoint& point) { return point.position; });
+      [](const RangefinderPoint& point) { return point.position; }, scratch);
 
-  std::vector<RangefinderPoint> filtered_points;
-  for (size_t i = 0; i < point_cloud.size(); i++) {
-    if (points_used[i]) {
-      filtered_points.push_back(point_cloud[i]);
+  CHECK_LE(point_cloud.intensities().size(), point_cloud.points().size());
+  result->clear();
+  if (point_cloud.intensities().empty()) {
+    for (size_t i = 0; i < point_cloud.size(); i++) {
+      if (scratch->points_used[i]) {
+        result->push_back(point_cloud[i]);
+      }
+    }
+  } else {
+    for (size_t i = 0; i < point_cloud.size(); i++) {
+      if (scratch->points_used[i]) {
+        result->push_back(point_cloud[i], point_cloud.intensities()[i]);
+      }
     }
   }
-  std::vector<float> filtered_intensities;
-  CHECK_LE(point_cloud.intensities().size(), point_cloud.points().size());
-  for (size_t i = 0; i < point_cloud.intensities().size(); i++) {
-    if (points_used[i]) {
-      filtered_intensities.push_back(point_cloud.intensities()[i]);
+}
+
+void VoxelFilter(const AlignedPointCloud& point_cloud, const float resolution,
+                 VoxelFilterScratch* const scratch,
+                 AlignedPointCloud* const result) {
+  CHECK_NE(result, &point_cloud);
+  RandomizedVoxelFilterIndices(
+      point_cloud, resolution,
+      [](const Eigen::Vector3f& position) { return position; }, scratch);
+  result->clear();
+  for (size_t i = 0; i < point_cloud.size(); i++) {
+    if (scratch->points_used[i]) {
+      result->push_back(point_cloud.position(i), point_cloud.time()[i]);
     }
   }
-  return PointCloud(std::move(filtered_points),
-                    std::move(filtered_intensities));
 }
 
 TimedPointCloud VoxelFilter(const TimedPointCloud& timed_point_cloud,
@@ -179,6 +420,19 @@ std::vector<sensor::TimedPointCloudOriginData::RangeMeasurement> VoxelFilter(
       });
 }
 
+void VoxelFilter(
+    const float resolution, VoxelFilterScratch* const scratch,
+    std::vector<sensor::TimedPointCloudOriginData::RangeMeasurement>* const
+        range_measurements) {
+  RandomizedVoxelFilterInPlace(
+      resolution,
+      [](const sensor::TimedPointCloudOriginData::RangeMeasurement&
+             range_measurement) {
+        return range_measurement.point_time.position;
+      },
+      scratch, range_measurements);
+}
+
 proto::AdaptiveVoxelFilterOptions CreateAdaptiveVoxelFilterOptions(
     common::LuaParameterDictionary* const parameter_dictionary) {
   proto::AdaptiveVoxelFilterOptions options;
@@ -192,8 +446,20 @@ proto::AdaptiveVoxelFilterOptions CreateAdaptiveVoxelFilterOptions(
 PointCloud AdaptiveVoxelFilter(
     const PointCloud& point_cloud,
     const proto::AdaptiveVoxelFilterOptions& options) {
-  return AdaptivelyVoxelFiltered(
-      options, FilterByMaxRange(point_cloud, options.max_range()));
+  VoxelFilterScratch scratch;
+  PointCloud result;
+  AdaptiveVoxelFilter(point_cloud, options, &scratch, &result);
+  return result;
+}
+
+void AdaptiveVoxelFilter(const PointCloud& point_cloud,
+                         const proto::AdaptiveVoxelFilterOptions& options,
+                         VoxelFilterScratch* const scratch,
+                         PointCloud* const result) {
+  CHECK_NE(result, &point_cloud);
+  FilterByMaxRange(point_cloud, options.max_range(),
+                   &scratch->points_in_range);
+  AdaptivelyVoxelFiltered(options, scratch->points_in_range, scratch, result);
 }
 
 }  // namespace sensor
@@ -18,8 +18,10 @@
 #define CARTOGRAPHER_SENSOR_INTERNAL_VOXEL_FILTER_H_
 
 #include <bitset>
+#include <vector>
 
 #include "cartographer/common/lua_parameter_dictionary.h"
+#include "cartographer/sensor/aligned_point_cloud.h"
 #include "cartographer/sensor/point_cloud.h"
 #include "cartographer/sensor/proto/adaptive_voxel_filter_options.pb.h"
 #include "cartographer/sensor/timed_point_cloud_data.h"
@@ -27,15 +29,61 @@
 namespace cartographer {
 namespace sensor {
 
+// Storage reused between calls of the voxel filters which take it. Once it has
+// grown to the largest point cloud seen, filtering does not allocate. Only to
+// be used by the functions in voxel_filter.cc.
+struct VoxelFilterScratch {
+  struct Voxel {
+    uint64_t key;
+    int num_points;
+    int point_index;
+  };
+  // Open addressing hash table with a power of two size, unused entries have
+  // 'num_points' == 0. Only used if the points span too many voxels to sort
+  // them by a 32-bit key.
+  std::vector<Voxel> voxels;
+  // Cell index of each point at the current resolution.
+  std::vector<Eigen::Array3i> cell_indices;
+  // Voxel keys in the upper and point indices in the lower 32 bits. If sorted,
+  // ordered by point index within each voxel.
+  std::vector<uint64_t> keys_and_indices;
+  std::vector<uint64_t> radix_sort_buffer;
+  // For each point, the index of its voxel and the number of points up to and
+  // including it in that voxel. Without sorting, 'rank_in_voxel' is instead
+  // indexed by voxel key and counts the points seen so far.
+  std::vector<int> voxel_index_of_point;
+  std::vector<int> rank_in_voxel;
+  // The point currently sampled for each voxel.
+  std::vector<int> sampled_point_index;
+  std::vector<bool> points_used;
+  PointCloud points_in_range;
+  PointCloud candidate;
+
+  // Returns the number of bytes allocated for the buffers above.
+  size_t MemoryUsageInBytes() const;
+};
+
 std::vector<RangefinderPoint> VoxelFilter(
     const std::vector<RangefinderPoint>& points, const float resolution);
 PointCloud VoxelFilter(const PointCloud& point_cloud, const float resolution);
+// Like above, but stores the result in 'result', reusing its storage.
+// 'result' must not be 'point_cloud'.
+void VoxelFilter(const PointCloud& point_cloud, float resolution,
+                 VoxelFilterScratch* scratch, PointCloud* result);
+// Like above for an 'AlignedPointCloud', keeping the same points.
+void VoxelFilter(const AlignedPointCloud& point_cloud, float resolution,
+                 VoxelFilterScratch* scratch, AlignedPointCloud* result);
 TimedPointCloud VoxelFilter(const TimedPointCloud& timed_point_cloud,
                             const float resolution);
 std::vector<sensor::TimedPointCloudOriginData::RangeMeasurement> VoxelFilter(
     const std::vector<sensor::TimedPointCloudOriginData::RangeMeasurement>&
         range_measurements,
     const float resolution);
+// Like above, but filters 'range_measurements' in place.
+void VoxelFilter(
+    float resolution, VoxelFilterScratch* scratch,
+    std::vector<sensor::TimedPointCloudOriginData::RangeMeasurement>*
+        range_measurements);
 
 proto::AdaptiveVoxelFilterOptions CreateAdaptiveVoxelFilterOptions(
     common::LuaParameterDictionary* const parameter_dictionary);
@@ -43,6 +91,11 @@ proto::AdaptiveVoxelFilterOptions CreateAdaptiveVoxelFilterOptions(
 PointCloud AdaptiveVoxelFilter(
     const PointCloud& point_cloud,
     const proto::AdaptiveVoxelFilterOptions& options);
+// Like above, but stores the result in 'result', reusing its storage.
+// 'result' must not be 'point_cloud'.
+void AdaptiveVoxelFilter(const PointCloud& point_cloud,
+                         const proto::AdaptiveVoxelFilterOptions& options,
+                         VoxelFilterScratch* scratch, PointCloud* result);
 
 }  // namespace sensor
 }  // namespace cartographer
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <random>
+
+#include "benchmark/benchmark.h"
+#include "cartographer/sensor/internal/voxel_filter.h"
+
+namespace cartographer {
+namespace sensor {
+namespace {
+
+// Returns 'num_points' points uniformly distributed in a 40 m x 40 m x 4 m
+// box, the rough extent of a range scan.
+PointCloud CreatePointCloud(const int num_points) {
+  std::mt19937 prng(42);
+  std::uniform_real_distribution<float> xy_distribution(-20.f, 20.f);
+  std::uniform_real_distribution<float> z_distribution(-2.f, 2.f);
+  PointCloud point_cloud;
+  for (int i = 0; i != num_points; ++i) {
+    point_cloud.push_back({Eigen::Vector3f(xy_distribution(prng),
+                                           xy_distribution(prng),
+                                           z_distribution(prng))});
+  }
+  return point_cloud;
+}
+
+// The argument is the number of points.
+void BM_VoxelFilter(benchmark::State& state) {
+  const PointCloud point_cloud = CreatePointCloud(state.range(0));
+  VoxelFilterScratch scratch;
+  PointCloud result;
+  for (auto _ : state) {
+    VoxelFilter(point_cloud, 0.05f /* resolution */, &scratch, &result);
+    benchmark::DoNotOptimize(result);
+  }
+  state.SetItemsProcessed(state.iterations() * point_cloud.size());
+}
+BENCHMARK(BM_VoxelFilter)->Arg(1000)->Arg(100000);
+
+// The argument is the number of points.
+void BM_AdaptiveVoxelFilter(benchmark::State& state) {
+  const PointCloud point_cloud = CreatePointCloud(state.range(0));
+  proto::AdaptiveVoxelFilterOptions options;
+  options.set_max_length(0.5f);
+  options.set_min_num_points(200);
+  options.set_max_range(50.f);
+  VoxelFilterScratch scratch;
+  PointCloud result;
+  for (auto _ : state) {
+    AdaptiveVoxelFilter(point_cloud, options, &scratch, &result);
+    benchmark::DoNotOptimize(result);
+  }
+  state.SetItemsProcessed(state.iterations() * point_cloud.size());
+}
+BENCHMARK(BM_AdaptiveVoxelFilter)->Arg(1000)->Arg(100000);
+
+}  // namespace
+}  // namespace sensor
+}  // namespace cartographer
+
+BENCHMARK_MAIN();
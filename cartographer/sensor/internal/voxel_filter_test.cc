@@ -17,7 +17,12 @@
 #include "cartographer/sensor/internal/voxel_filter.h"
 
 #include <cmath>
+#include <map>
+#include <random>
+#include <tuple>
+#include <vector>
 
+#include "cartographer/common/port.h"
 #include "gmock/gmock.h"
 
 namespace cartographer {
@@ -25,8 +30,22 @@ namespace sensor {
 namespace {
 
 using ::testing::Contains;
+using ::testing::ElementsAreArray;
 using ::testing::IsEmpty;
 
+PointCloud CreateRandomPointCloud(const int num_points, const int seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> distribution(-5.f, 5.f);
+  std::vector<RangefinderPoint> points;
+  std::vector<float> intensities;
+  for (int i = 0; i < num_points; ++i) {
+    points.push_back(
+        {{distribution(rng), distribution(rng), distribution(rng)}});
+    intensities.push_back(static_cast<float>(i));
+  }
+  return PointCloud(points, intensities);
+}
+
 TEST(VoxelFilterTest, ReturnsOnePointInEachVoxel) {
   const PointCloud point_cloud({{{0.f, 0.f, 0.f}},
                                 {{0.1f, -0.1f, 0.1f}},
@@ -81,6 +100,117 @@ TEST(VoxelFilterTest, IgnoresTime) {
   EXPECT_THAT(timed_point_cloud, Contains(result[0]));
 }
 
+// Straightforward reservoir sampling of one point per voxel.
+std::vector<RangefinderPoint> ReferenceVoxelFilter(
+    const std::vector<RangefinderPoint>& points, const float resolution) {
+  std::minstd_rand0 generator;
+  std::map<std::tuple<int, int, int>, std::pair<int, size_t>> voxels;
+  for (size_t i = 0; i < points.size(); ++i) {
+    const Eigen::Array3f index = points[i].position.array() / resolution;
+    auto& voxel = voxels[std::make_tuple(common::RoundToInt(index.x()),
+                                         common::RoundToInt(index.y()),
+                                         common::RoundToInt(index.z()))];
+    ++voxel.first;
+    if (voxel.first == 1) {
+      voxel.second = i;
+    } else {
+      std::uniform_int_distribution<> distribution(1, voxel.first);
+      if (distribution(generator) == voxel.first) {
+        voxel.second = i;
+      }
+    }
+  }
+  std::vector<bool> points_used(points.size(), false);
+  for (const auto& voxel : voxels) {
+    points_used[voxel.second.second] = true;
+  }
+  std::vector<RangefinderPoint> result;
+  for (size_t i = 0; i < points.size(); ++i) {
+    if (points_used[i]) {
+      result.push_back(points[i]);
+    }
+  }
+  return result;
+}
+
+TEST(VoxelFilterTest, MatchesReferenceImplementation) {
+  const std::vector<RangefinderPoint> points =
+      CreateRandomPointCloud(3000, 7).points();
+  // Far apart points, so that there are too many voxels in the bounding box
+  // to number them with 32 bits.
+  std::vector<RangefinderPoint> far_apart_points = points;
+  far_apart_points.push_back({{-1e5f, -1e5f, -1e5f}});
+  far_apart_points.push_back({{1e5f, 1e5f, 1e5f}});
+  for (const float resolution : {0.05f, 0.3f, 2.f}) {
+    EXPECT_THAT(VoxelFilter(points, resolution),
+                ElementsAreArray(ReferenceVoxelFilter(points, resolution)));
+    EXPECT_THAT(
+        VoxelFilter(far_apart_points, resolution),
+        ElementsAreArray(ReferenceVoxelFilter(far_apart_points, resolution)));
+  }
+}
+
+TEST(VoxelFilterTest, ReusedScratchGivesSameResults) {
+  VoxelFilterScratch scratch;
+  PointCloud result;
+  for (int seed = 0; seed < 3; ++seed) {
+    // Different sizes make the scratch both grow and shrink.
+    const PointCloud point_cloud =
+        CreateRandomPointCloud(seed == 1 ? 100 : 2000, seed);
+    const PointCloud expected = VoxelFilter(point_cloud, 0.5f);
+    VoxelFilter(point_cloud, 0.5f, &scratch, &result);
+    EXPECT_THAT(result.points(), ElementsAreArray(expected.points()));
+    EXPECT_THAT(result.intensities(), ElementsAreArray(expected.intensities()));
+  }
+}
+
+TEST(VoxelFilterTest, AlignedPointCloudKeepsSamePoints) {
+  VoxelFilterScratch scratch;
+  AlignedPointCloud result;
+  for (int seed = 0; seed < 3; ++seed) {
+    const PointCloud point_cloud = CreateRandomPointCloud(2000, seed);
+    const PointCloud expected = VoxelFilter(point_cloud, 0.5f);
+    VoxelFilter(ToAlignedPointCloud(point_cloud), 0.5f, &scratch, &result);
+    EXPECT_THAT(ToPointCloud(result).points(),
+                ElementsAreArray(expected.points()));
+  }
+}
+
+TEST(VoxelFilterTest, AdaptiveVoxelFilterWithScratch) {
+  proto::AdaptiveVoxelFilterOptions options;
+  options.set_max_length(2.f);
+  options.set_min_num_points(150);
+  options.set_max_range(6.f);
+  VoxelFilterScratch scratch;
+  PointCloud result;
+  for (int seed = 0; seed < 3; ++seed) {
+    const PointCloud point_cloud = CreateRandomPointCloud(1000, seed);
+    const PointCloud expected = AdaptiveVoxelFilter(point_cloud, options);
+    EXPECT_GE(expected.size(), options.min_num_points());
+    AdaptiveVoxelFilter(point_cloud, options, &scratch, &result);
+    EXPECT_THAT(result.points(), ElementsAreArray(expected.points()));
+    EXPECT_THAT(result.intensities(), ElementsAreArray(expected.intensities()));
+  }
+}
+
+TEST(VoxelFilterTest, FiltersRangeMeasurementsInPlace) {
+  const PointCloud point_cloud = CreateRandomPointCloud(1000, 42);
+  std::vector<TimedPointCloudOriginData::RangeMeasurement> range_measurements;
+  for (size_t i = 0; i < point_cloud.size(); ++i) {
+    range_measurements.push_back(
+        {{point_cloud[i].position, -0.001f * i}, point_cloud.intensities()[i],
+         /*origin_index=*/0});
+  }
+  const auto expected = VoxelFilter(range_measurements, 1.f);
+  VoxelFilterScratch scratch;
+  VoxelFilter(1.f, &scratch, &range_measurements);
+  ASSERT_EQ(range_measurements.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(range_measurements[i].point_time, expected[i].point_time);
+    EXPECT_EQ(range_measurements[i].intensity, expected[i].intensity);
+  }
+}
+
 }  // namespace
 }  // namespace sensor
 }  // namespace cartographer
@@ -18,6 +18,7 @@
 #define CARTOGRAPHER_SENSOR_MAP_BY_TIME_H_
 
 #include <algorithm>
+#include <deque>
 #include <iterator>
 #include <map>
 #include <memory>
@@ -32,6 +33,11 @@ namespace cartographer {
 namespace sensor {
 
 // 'DataType' must contain a 'time' member of type common::Time.
+//
+// The data of each trajectory is kept sorted by time in a std::deque, which
+// stores it in contiguous chunks. Lookups by time are binary searches over
+// these chunks, and trimming moves only the data on the shorter side of the
+// erased range, which makes trimming the oldest nodes cheap.
 template <typename DataType>
 class MapByTime {
  public:
@@ -40,9 +46,9 @@ class MapByTime {
     CHECK_GE(trajectory_id, 0);
     auto& trajectory = data_[trajectory_id];
     if (!trajectory.empty()) {
-      CHECK_GT(data.time, std::prev(trajectory.end())->first);
+      CHECK_GT(data.time, trajectory.back().time);
     }
-    trajectory.emplace(data.time, data);
+    trajectory.push_back(data);
   }
 
   // Removes data no longer needed once 'node_id' gets removed from 'nodes'.
@@ -72,8 +78,10 @@ class MapByTime {
     CHECK_LT(gap_start, gap_end);
 
     auto& trajectory = data_.at(trajectory_id);
-    auto data_it = trajectory.lower_bound(gap_start);
-    auto data_end = trajectory.upper_bound(gap_end);
+    auto data_it = std::lower_bound(trajectory.begin(), trajectory.end(),
+                                    gap_start, &IsBefore);
+    auto data_end = std::upper_bound(trajectory.begin(), trajectory.end(),
+                                     gap_end, &IsAfter);
     if (data_it == data_end) {
       return;
     }
@@ -88,18 +96,28 @@ class MapByTime {
       // Retain the first data inside the gap.
       data_it = std::next(data_it);
     }
-    while (data_it != data_end) {
-      data_it = trajectory.erase(data_it);
-    }
+    trajectory.erase(data_it, data_end);
     if (trajectory.empty()) {
       data_.erase(trajectory_id);
     }
   }
 
+  // Removes all data of 'trajectory_id'.
+  void TrimTrajectory(const int trajectory_id) { data_.erase(trajectory_id); }
+
   bool HasTrajectory(const int trajectory_id) const {
     return data_.count(trajectory_id) != 0;
   }
 
+  // Returns the number of data of all trajectories.
+  size_t size() const {
+    size_t result = 0;
+    for (const auto& trajectory : data_) {
+      result += trajectory.second.size();
+    }
+    return result;
+  }
+
   class ConstIterator {
    public:
     using iterator_category = std::bidirectional_iterator_tag;
@@ -109,12 +127,12 @@ class MapByTime {
     using reference = const DataType&;
 
     explicit ConstIterator(
-        typename std::map<common::Time, DataType>::const_iterator iterator)
+        typename std::deque<DataType>::const_iterator iterator)
         : iterator_(iterator) {}
 
-    const DataType& operator*() const { return iterator_->second; }
+    const DataType& operator*() const { return *iterator_; }
 
-    const DataType* operator->() const { return &iterator_->second; }
+    const DataType* operator->() const { return &*iterator_; }
 
     ConstIterator& operator++() {
       ++iterator_;
@@ -133,7 +151,7 @@ class MapByTime {
     bool operator!=(const ConstIterator& it) const { return !operator==(it); }
 
    private:
-    typename std::map<common::Time, DataType>::const_iterator iterator_;
+    typename std::deque<DataType>::const_iterator iterator_;
   };
 
   class ConstTrajectoryIterator {
@@ -145,7 +163,7 @@ class MapByTime {
     using reference = const int&;
 
     explicit ConstTrajectoryIterator(
-        typename std::map<int, std::map<common::Time, DataType>>::const_iterator
+        typename std::map<int, std::deque<DataType>>::const_iterator
             current_trajectory)
         : current_trajectory_(current_trajectory) {}
 
@@ -170,7 +188,7 @@ class MapByTime {
     }
 
    private:
-    typename std::map<int, std::map<common::Time, DataType>>::const_iterator
+    typename std::map<int, std::deque<DataType>>::const_iterator
         current_trajectory_;
   };
 
@@ -200,11 +218,21 @@ class MapByTime {
   // before 'time'. 'trajectory_id' must refer to an existing trajectory.
   ConstIterator lower_bound(const int trajectory_id,
                             const common::Time time) const {
-    return ConstIterator(data_.at(trajectory_id).lower_bound(time));
+    const std::deque<DataType>& trajectory = data_.at(trajectory_id);
+    return ConstIterator(std::lower_bound(trajectory.begin(), trajectory.end(),
+                                          time, &IsBefore));
   }
 
  private:
-  std::map<int, std::map<common::Time, DataType>> data_;
+  static bool IsBefore(const DataType& data, const common::Time time) {
+    return data.time < time;
+  }
+
+  static bool IsAfter(const common::Time time, const DataType& data) {
+    return time < data.time;
+  }
+
+  std::map<int, std::deque<DataType>> data_;
 };
 
 }  // namespace sensor
@@ -51,6 +51,20 @@ TEST(MapByTimeTest, AppendAndViewTrajectory) {
   EXPECT_TRUE(expected_data.empty());
 }
 
+TEST(MapByTimeTest, LowerBound) {
+  MapByTime<Data> map_by_time;
+  for (int i = 0; i != 10000; ++i) {
+    map_by_time.Append(0, Data{CreateTime(2 * i)});
+  }
+  EXPECT_EQ(map_by_time.lower_bound(0, CreateTime(-1))->time, CreateTime(0));
+  EXPECT_EQ(map_by_time.lower_bound(0, CreateTime(2000))->time,
+            CreateTime(2000));
+  EXPECT_EQ(map_by_time.lower_bound(0, CreateTime(2001))->time,
+            CreateTime(2002));
+  EXPECT_TRUE(map_by_time.lower_bound(0, CreateTime(19999)) ==
+              map_by_time.EndOfTrajectory(0));
+}
+
 TEST(MapByTimeTest, Trimming) {
   MapByTime<Data> map_by_time;
   EXPECT_FALSE(map_by_time.HasTrajectory(42));
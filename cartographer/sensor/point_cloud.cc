@@ -21,6 +21,29 @@
 
 namespace cartographer {
 namespace sensor {
+namespace {
+
+// Applies a rigid transform to the positions of points. The rotation is
+// converted to a matrix once, which is cheaper to apply to many points than
+// the quaternion.
+class PositionTransformer {
+ public:
+  explicit PositionTransformer(const transform::Rigid3f& transform)
+      : rotation_(transform.rotation().toRotationMatrix()),
+        translation_(transform.translation()) {}
+
+  template <typename PointType>
+  PointType operator()(PointType point) const {
+    point.position = rotation_ * point.position + translation_;
+    return point;
+  }
+
+ private:
+  const Eigen::Matrix3f rotation_;
+  const Eigen::Vector3f translation_;
+};
+
+}  // namespace
 
 PointCloud::PointCloud() {}
 PointCloud::PointCloud(std::vector<PointCloud::PointType> points)
@@ -53,24 +76,90 @@ void PointCloud::push_back(PointCloud::PointType value) {
   points_.push_back(std::move(value));
 }
 
+void PointCloud::push_back(PointCloud::PointType value, const float intensity) {
+  DCHECK_EQ(points_.size(), intensities_.size());
+  points_.push_back(std::move(value));
+  intensities_.push_back(intensity);
+}
+
+void PointCloud::clear() {
+  points_.clear();
+  intensities_.clear();
+}
+
+void PointCloud::reserve(const size_t size) {
+  points_.reserve(size);
+  intensities_.reserve(size);
+}
+
+size_t PointCloud::MemoryUsageInBytes() const {
+  return points_.capacity() * sizeof(PointType) +
+         intensities_.capacity() * sizeof(float);
+}
+
 PointCloud TransformPointCloud(const PointCloud& point_cloud,
                                const transform::Rigid3f& transform) {
+  const PositionTransformer transformer(transform);
   std::vector<RangefinderPoint> points;
   points.reserve(point_cloud.size());
   for (const RangefinderPoint& point : point_cloud.points()) {
-    points.emplace_back(transform * point);
+    points.emplace_back(transformer(point));
   }
   return PointCloud(points, point_cloud.intensities());
 }
 
+void TransformPointCloud(const PointCloud& point_cloud,
+                         const transform::Rigid3f& transform,
+                         PointCloud* const result) {
+  CHECK_NE(result, &point_cloud);
+  const PositionTransformer transformer(transform);
+  result->clear();
+  result->reserve(point_cloud.size());
+  if (point_cloud.intensities().empty()) {
+    for (const RangefinderPoint& point : point_cloud.points()) {
+      result->push_back(transformer(point));
+    }
+  } else {
+    for (size_t i = 0; i < point_cloud.size(); ++i) {
+      result->push_back(transformer(point_cloud[i]),
+                        point_cloud.intensities()[i]);
+    }
+  }
+}
+
+void TransformPointCloud(const transform::Rigid3f& transform,
+                         PointCloud* const point_cloud) {
+  const PositionTransformer transformer(transform);
+  for (RangefinderPoint& point : point_cloud->points_) {
+    point = transformer(point);
+  }
+}
+
 TimedPointCloud TransformTimedPointCloud(const TimedPointCloud& point_cloud,
                                          const transform::Rigid3f& transform) {
   TimedPointCloud result;
-  result.reserve(point_cloud.size());
+  TransformTimedPointCloud(point_cloud, transform, &result);
+  return result;
+}
+
+void TransformTimedPointCloud(const TimedPointCloud& point_cloud,
+                              const transform::Rigid3f& transform,
+                              TimedPointCloud* const result) {
+  CHECK_NE(result, &point_cloud);
+  const PositionTransformer transformer(transform);
+  result->clear();
+  result->reserve(point_cloud.size());
   for (const TimedRangefinderPoint& point : point_cloud) {
-    result.push_back(transform * point);
+    result->push_back(transformer(point));
+  }
+}
+
+void TransformTimedPointCloud(const transform::Rigid3f& transform,
+                              TimedPointCloud* const point_cloud) {
+  const PositionTransformer transformer(transform);
+  for (TimedRangefinderPoint& point : *point_cloud) {
+    point = transformer(point);
   }
-  return result;
 }
 
 PointCloud CropPointCloud(const PointCloud& point_cloud, const float min_z,
@@ -80,5 +169,31 @@ PointCloud CropPointCloud(const PointCloud& point_cloud, const float min_z,
   });
 }
 
+void TransformAndCropPointCloud(const PointCloud& point_cloud,
+                                const transform::Rigid3f& transform,
+                                const float min_z, const float max_z,
+                                PointCloud* const result) {
+  CHECK_NE(result, &point_cloud);
+  const PositionTransformer transformer(transform);
+  result->clear();
+  if (point_cloud.intensities().empty()) {
+    for (const RangefinderPoint& point : point_cloud.points()) {
+      const RangefinderPoint transformed_point = transformer(point);
+      if (min_z <= transformed_point.position.z() &&
+          transformed_point.position.z() <= max_z) {
+        result->push_back(transformed_point);
+      }
+    }
+  } else {
+    for (size_t i = 0; i < point_cloud.size(); ++i) {
+      const RangefinderPoint transformed_point = transformer(point_cloud[i]);
+      if (min_z <= transformed_point.position.z() &&
+          transformed_point.position.z() <= max_z) {
+        result->push_back(transformed_point, point_cloud.intensities()[i]);
+      }
+    }
+  }
+}
+
 }  // namespace sensor
 }  // namespace cartographer
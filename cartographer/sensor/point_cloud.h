@@ -53,6 +53,18 @@ class PointCloud {
   ConstIterator end() const;
 
   void push_back(PointType value);
+  // Appends a point together with its intensity. Must not be mixed with the
+  // overload above on the same point cloud.
+  void push_back(PointType value, float intensity);
+
+  // Removes all points and intensities, but keeps the allocated storage, so
+  // that refilling a point cloud of similar size does not allocate.
+  void clear();
+  // Reserves storage for 'size' points and intensities.
+  void reserve(size_t size);
+
+  // Returns the number of bytes allocated for points and intensities.
+  size_t MemoryUsageInBytes() const;
 
   // Creates a PointCloud consisting of all the points for which `predicate`
   // returns true, together with the corresponding intensities.
@@ -84,6 +96,9 @@ class PointCloud {
   }
 
  private:
+  friend void TransformPointCloud(const transform::Rigid3f& transform,
+                                  PointCloud* point_cloud);
+
   // For 2D points, the third entry is 0.f.
   std::vector<PointType> points_;
   // Intensities are optional. If non-empty, they must have the same size as
@@ -109,15 +124,43 @@ struct PointCloudWithIntensities {
 PointCloud TransformPointCloud(const PointCloud& point_cloud,
                                const transform::Rigid3f& transform);
 
+// Transforms 'point_cloud' according to 'transform' and stores the result in
+// 'result', reusing its storage. 'result' must not be 'point_cloud'.
+void TransformPointCloud(const PointCloud& point_cloud,
+                         const transform::Rigid3f& transform,
+                         PointCloud* result);
+
+// Transforms 'point_cloud' in place according to 'transform'.
+void TransformPointCloud(const transform::Rigid3f& transform,
+                         PointCloud* point_cloud);
+
 // Transforms 'point_cloud' according to 'transform'.
 TimedPointCloud TransformTimedPointCloud(const TimedPointCloud& point_cloud,
                                          const transform::Rigid3f& transform);
 
+// Transforms 'point_cloud' according to 'transform' and stores the result in
+// 'result', reusing its storage. 'result' must not be 'point_cloud'.
+void TransformTimedPointCloud(const TimedPointCloud& point_cloud,
+                              const transform::Rigid3f& transform,
+                              TimedPointCloud* result);
+
+// Transforms 'point_cloud' in place according to 'transform'.
+void TransformTimedPointCloud(const transform::Rigid3f& transform,
+                              TimedPointCloud* point_cloud);
+
 // Returns a new point cloud without points that fall outside the region defined
 // by 'min_z' and 'max_z'.
 PointCloud CropPointCloud(const PointCloud& point_cloud, float min_z,
                           float max_z);
 
+// Transforms 'point_cloud' according to 'transform' and keeps only the points
+// whose transformed z is within 'min_z' and 'max_z', in a single pass. Stores
+// the result in 'result', reusing its storage. 'result' must not be
+// 'point_cloud'.
+void TransformAndCropPointCloud(const PointCloud& point_cloud,
+                                const transform::Rigid3f& transform,
+                                float min_z, float max_z, PointCloud* result);
+
 }  // namespace sensor
 }  // namespace cartographer
 
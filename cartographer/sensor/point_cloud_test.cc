@@ -42,6 +42,38 @@ TEST(PointCloudTest, TransformPointCloud) {
   EXPECT_NEAR(3.5f, transformed_point_cloud[1].position.y(), 1e-6);
 }
 
+TEST(PointCloudTest, TransformPointCloudIntoBuffer) {
+  const PointCloud point_cloud({{{0.5f, 0.5f, 1.f}}, {{3.5f, 0.5f, 42.f}}},
+                               {1.f, 2.f});
+  PointCloud transformed_point_cloud({{{1.f, 2.f, 3.f}}});
+  TransformPointCloud(point_cloud,
+                      transform::Embed3D(transform::Rigid2f::Rotation(M_PI_2)),
+                      &transformed_point_cloud);
+  ASSERT_EQ(transformed_point_cloud.size(), 2);
+  EXPECT_NEAR(-0.5f, transformed_point_cloud[0].position.x(), 1e-6);
+  EXPECT_NEAR(0.5f, transformed_point_cloud[0].position.y(), 1e-6);
+  EXPECT_NEAR(-0.5f, transformed_point_cloud[1].position.x(), 1e-6);
+  EXPECT_NEAR(3.5f, transformed_point_cloud[1].position.y(), 1e-6);
+  EXPECT_THAT(transformed_point_cloud.intensities(),
+              ElementsAre(FloatNear(1.f, 1e-6), FloatNear(2.f, 1e-6)));
+}
+
+TEST(PointCloudTest, TransformPointCloudInPlace) {
+  PointCloud point_cloud({{{0.5f, 0.5f, 1.f}}, {{3.5f, 0.5f, 42.f}}},
+                         {1.f, 2.f});
+  const transform::Rigid3f transform(
+      Eigen::Vector3f(1.f, 2.f, 3.f),
+      Eigen::Quaternionf(Eigen::AngleAxisf(0.3f, Eigen::Vector3f::UnitX())));
+  const PointCloud expected = TransformPointCloud(point_cloud, transform);
+  TransformPointCloud(transform, &point_cloud);
+  ASSERT_EQ(point_cloud.size(), 2);
+  for (size_t i = 0; i < point_cloud.size(); ++i) {
+    EXPECT_TRUE(point_cloud[i].position.isApprox(expected[i].position, 1e-6f));
+  }
+  EXPECT_THAT(point_cloud.intensities(),
+              ElementsAre(FloatNear(1.f, 1e-6), FloatNear(2.f, 1e-6)));
+}
+
 TEST(PointCloudTest, TransformTimedPointCloud) {
   TimedPointCloud point_cloud;
   point_cloud.push_back({Eigen::Vector3f{0.5f, 0.5f, 1.f}, 0.f});
@@ -54,6 +86,37 @@ TEST(PointCloudTest, TransformTimedPointCloud) {
   EXPECT_NEAR(3.5f, transformed_point_cloud[1].position.y(), 1e-6);
 }
 
+TEST(PointCloudTest, TransformTimedPointCloudInPlace) {
+  TimedPointCloud point_cloud;
+  point_cloud.push_back({Eigen::Vector3f{0.5f, 0.5f, 1.f}, -0.5f});
+  point_cloud.push_back({Eigen::Vector3f{3.5f, 0.5f, 42.f}, 0.f});
+  TransformTimedPointCloud(
+      transform::Embed3D(transform::Rigid2f::Rotation(M_PI_2)), &point_cloud);
+  EXPECT_NEAR(-0.5f, point_cloud[0].position.x(), 1e-6);
+  EXPECT_NEAR(0.5f, point_cloud[0].position.y(), 1e-6);
+  EXPECT_EQ(-0.5f, point_cloud[0].time);
+  EXPECT_NEAR(-0.5f, point_cloud[1].position.x(), 1e-6);
+  EXPECT_NEAR(3.5f, point_cloud[1].position.y(), 1e-6);
+  EXPECT_NEAR(42.f, point_cloud[1].position.z(), 1e-6);
+}
+
+TEST(PointCloudTest, TransformAndCropPointCloud) {
+  const PointCloud point_cloud(
+      {{{0.5f, 0.5f, 1.f}}, {{3.5f, 0.5f, 42.f}}, {{1.5f, 0.5f, -1.f}}},
+      {1.f, 2.f, 3.f});
+  const transform::Rigid3f transform =
+      transform::Embed3D(transform::Rigid2f::Rotation(M_PI_2));
+  PointCloud transformed_point_cloud({{{1.f, 2.f, 3.f}}});
+  TransformAndCropPointCloud(point_cloud, transform, -1.f, 2.f,
+                             &transformed_point_cloud);
+  const PointCloud expected =
+      CropPointCloud(TransformPointCloud(point_cloud, transform), -1.f, 2.f);
+  EXPECT_THAT(transformed_point_cloud.points(),
+              ::testing::ContainerEq(expected.points()));
+  EXPECT_THAT(transformed_point_cloud.intensities(),
+              ElementsAre(FloatNear(1.f, 1e-6), FloatNear(3.f, 1e-6)));
+}
+
 TEST(PointCloudTest, CopyIf) {
   std::vector<RangefinderPoint> points = {
       {{0.f, 0.f, 0.f}}, {{1.f, 1.f, 1.f}}, {{2.f, 2.f, 2.f}}};
@@ -31,6 +31,14 @@ RangeData TransformRangeData(const RangeData& range_data,
   };
 }
 
+void TransformRangeData(const RangeData& range_data,
+                        const transform::Rigid3f& transform,
+                        RangeData* const result) {
+  result->origin = transform * range_data.origin;
+  TransformPointCloud(range_data.returns, transform, &result->returns);
+  TransformPointCloud(range_data.misses, transform, &result->misses);
+}
+
 RangeData CropRangeData(const RangeData& range_data, const float min_z,
                         const float max_z) {
   return RangeData{range_data.origin,
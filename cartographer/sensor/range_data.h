@@ -38,6 +38,11 @@ struct RangeData {
 RangeData TransformRangeData(const RangeData& range_data,
                              const transform::Rigid3f& transform);
 
+// Like above, but stores the transformed data in 'result', reusing its storage.
+// 'result' must not be 'range_data'.
+void TransformRangeData(const RangeData& range_data,
+                        const transform::Rigid3f& transform, RangeData* result);
+
 // Crops 'range_data' according to the region defined by 'min_z' and 'max_z'.
 RangeData CropRangeData(const RangeData& range_data, float min_z, float max_z);
 
@@ -16,11 +16,54 @@
 
 #include "cartographer/sensor/timed_point_cloud_data.h"
 
+#include <cstring>
+
+#include "cartographer/common/port.h"
 #include "cartographer/transform/proto/transform.pb.h"
 #include "cartographer/transform/transform.h"
 
 namespace cartographer {
 namespace sensor {
+namespace {
+
+// x, y, z and time as 32-bit floats.
+constexpr size_t kPackedPointSize = 4 * sizeof(uint32);
+
+void PackFloat(const float value, char* const out) {
+  uint32 bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  out[0] = static_cast<char>(bits);
+  out[1] = static_cast<char>(bits >> 8);
+  out[2] = static_cast<char>(bits >> 16);
+  out[3] = static_cast<char>(bits >> 24);
+}
+
+float UnpackFloat(const char* const in) {
+  const auto* const bytes = reinterpret_cast<const unsigned char*>(in);
+  const uint32 bits = static_cast<uint32>(bytes[0]) |
+                      static_cast<uint32>(bytes[1]) << 8 |
+                      static_cast<uint32>(bytes[2]) << 16 |
+                      static_cast<uint32>(bytes[3]) << 24;
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+TimedPointCloud UnpackPointData(const std::string& packed_point_data) {
+  CHECK_EQ(packed_point_data.size() % kPackedPointSize, 0);
+  const size_t num_points = packed_point_data.size() / kPackedPointSize;
+  TimedPointCloud timed_point_cloud(num_points);
+  const char* in = packed_point_data.data();
+  for (TimedRangefinderPoint& point : timed_point_cloud) {
+    point.position = Eigen::Vector3f(UnpackFloat(in), UnpackFloat(in + 4),
+                                     UnpackFloat(in + 8));
+    point.time = UnpackFloat(in + 12);
+    in += kPackedPointSize;
+  }
+  return timed_point_cloud;
+}
+
+}  // namespace
 
 proto::TimedPointCloudData ToProto(
     const TimedPointCloudData& timed_point_cloud_data) {
@@ -37,11 +80,35 @@ proto::TimedPointCloudData ToProto(
   return proto;
 }
 
+proto::TimedPointCloudData ToPackedProto(
+    const TimedPointCloudData& timed_point_cloud_data) {
+  proto::TimedPointCloudData proto;
+  proto.set_timestamp(common::ToUniversal(timed_point_cloud_data.time));
+  *proto.mutable_origin() = transform::ToProto(timed_point_cloud_data.origin);
+  std::string* const packed_point_data = proto.mutable_packed_point_data();
+  packed_point_data->resize(timed_point_cloud_data.ranges.size() *
+                            kPackedPointSize);
+  char* out = &(*packed_point_data)[0];
+  for (const TimedRangefinderPoint& range : timed_point_cloud_data.ranges) {
+    PackFloat(range.position.x(), out);
+    PackFloat(range.position.y(), out + 4);
+    PackFloat(range.position.z(), out + 8);
+    PackFloat(range.time, out + 12);
+    out += kPackedPointSize;
+  }
+  proto.mutable_intensities()->Reserve(
+      timed_point_cloud_data.intensities.size());
+  for (const float intensity : timed_point_cloud_data.intensities) {
+    proto.add_intensities(intensity);
+  }
+  return proto;
+}
+
 TimedPointCloudData FromProto(const proto::TimedPointCloudData& proto) {
-  CHECK(proto.intensities().size() == 0 ||
-        proto.intensities().size() == proto.point_data().size());
   TimedPointCloud timed_point_cloud;
-  if (proto.point_data().size() > 0) {
+  if (!proto.packed_point_data().empty()) {
+    timed_point_cloud = UnpackPointData(proto.packed_point_data());
+  } else if (proto.point_data().size() > 0) {
     timed_point_cloud.reserve(proto.point_data().size());
     for (const auto& timed_point_proto : proto.point_data()) {
       timed_point_cloud.push_back(FromProto(timed_point_proto));
@@ -53,6 +120,9 @@ TimedPointCloudData FromProto(const proto::TimedPointCloudData& proto) {
       timed_point_cloud.push_back({timed_point.head<3>(), timed_point[3]});
     }
   }
+  CHECK(proto.intensities().size() == 0 ||
+        static_cast<size_t>(proto.intensities().size()) ==
+            timed_point_cloud.size());
   return TimedPointCloudData{common::FromUniversal(proto.timestamp()),
                              transform::ToEigen(proto.origin()),
                              timed_point_cloud,
@@ -47,6 +47,11 @@ struct TimedPointCloudOriginData {
 proto::TimedPointCloudData ToProto(
     const TimedPointCloudData& timed_point_cloud_data);
 
+// Like ToProto(), but stores the points in 'packed_point_data' which is much
+// cheaper to serialize and parse than one message per point.
+proto::TimedPointCloudData ToPackedProto(
+    const TimedPointCloudData& timed_point_cloud_data);
+
 // Converts 'proto' to TimedPointCloudData.
 TimedPointCloudData FromProto(const proto::TimedPointCloudData& proto);
 
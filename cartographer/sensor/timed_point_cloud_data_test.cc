@@ -0,0 +1,65 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/sensor/timed_point_cloud_data.h"
+
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace sensor {
+namespace {
+
+TimedPointCloudData CreateTimedPointCloudData() {
+  return TimedPointCloudData{
+      common::FromUniversal(123),
+      Eigen::Vector3f(1.f, -2.f, 3.f),
+      {{Eigen::Vector3f(0.5f, 1.25f, -7.f), -0.1f},
+       {Eigen::Vector3f(-1e-6f, 1e6f, 0.f), 0.f}},
+      {10.f, 20.f}};
+}
+
+void ExpectEqual(const TimedPointCloudData& expected,
+                 const TimedPointCloudData& actual) {
+  EXPECT_EQ(expected.time, actual.time);
+  EXPECT_EQ(expected.origin, actual.origin);
+  ASSERT_EQ(expected.ranges.size(), actual.ranges.size());
+  for (size_t i = 0; i < expected.ranges.size(); ++i) {
+    EXPECT_EQ(expected.ranges[i].position, actual.ranges[i].position);
+    EXPECT_EQ(expected.ranges[i].time, actual.ranges[i].time);
+  }
+  EXPECT_EQ(expected.intensities, actual.intensities);
+}
+
+TEST(TimedPointCloudDataTest, ToProtoAndBack) {
+  const TimedPointCloudData data = CreateTimedPointCloudData();
+  const proto::TimedPointCloudData proto = ToProto(data);
+  EXPECT_EQ(2, proto.point_data_size());
+  EXPECT_TRUE(proto.packed_point_data().empty());
+  ExpectEqual(data, FromProto(proto));
+}
+
+TEST(TimedPointCloudDataTest, ToPackedProtoAndBack) {
+  const TimedPointCloudData data = CreateTimedPointCloudData();
+  const proto::TimedPointCloudData proto = ToPackedProto(data);
+  EXPECT_EQ(0, proto.point_data_size());
+  EXPECT_EQ(2 * 4 * sizeof(float), proto.packed_point_data().size());
+  ExpectEqual(data, FromProto(proto));
+  EXPECT_LT(proto.ByteSize(), ToProto(data).ByteSize());
+}
+
+}  // namespace
+}  // namespace sensor
+}  // namespace cartographer
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/sensor/timed_point_cloud_pool.h"
+
+#include <utility>
+
+namespace cartographer {
+namespace sensor {
+
+namespace {
+
+template <typename T>
+std::vector<T> TakeBuffer(std::vector<std::vector<T>>* const buffers) {
+  if (buffers->empty()) {
+    return {};
+  }
+  std::vector<T> buffer = std::move(buffers->back());
+  buffers->pop_back();
+  return buffer;
+}
+
+template <typename T>
+void KeepBuffer(std::vector<T>&& buffer, const size_t max_buffers,
+                std::vector<std::vector<T>>* const buffers) {
+  if (buffer.capacity() == 0 || buffers->size() == max_buffers) {
+    return;
+  }
+  buffer.clear();
+  buffers->push_back(std::move(buffer));
+}
+
+}  // namespace
+
+constexpr size_t TimedPointCloudPool::kMaxPooledBuffers;
+
+TimedPointCloudPool* TimedPointCloudPool::Get() {
+  static TimedPointCloudPool* const pool = new TimedPointCloudPool();
+  return pool;
+}
+
+TimedPointCloudPool::TimedPointCloudPool() {
+  // Reserving up front keeps Recycle() from allocating.
+  ranges_.reserve(kMaxPooledBuffers);
+  intensities_.reserve(kMaxPooledBuffers);
+}
+
+TimedPointCloud TimedPointCloudPool::AcquireRanges() {
+  absl::MutexLock locker(&mutex_);
+  return TakeBuffer(&ranges_);
+}
+
+std::vector<float> TimedPointCloudPool::AcquireIntensities() {
+  absl::MutexLock locker(&mutex_);
+  return TakeBuffer(&intensities_);
+}
+
+void TimedPointCloudPool::Recycle(TimedPointCloudData&& data) {
+  absl::MutexLock locker(&mutex_);
+  KeepBuffer(std::move(data.ranges), kMaxPooledBuffers, &ranges_);
+  KeepBuffer(std::move(data.intensities), kMaxPooledBuffers, &intensities_);
+}
+
+size_t TimedPointCloudPool::num_pooled_ranges() {
+  absl::MutexLock locker(&mutex_);
+  return ranges_.size();
+}
+
+}  // namespace sensor
+}  // namespace cartographer
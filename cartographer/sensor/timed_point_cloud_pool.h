@@ -0,0 +1,70 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_SENSOR_TIMED_POINT_CLOUD_POOL_H_
+#define CARTOGRAPHER_SENSOR_TIMED_POINT_CLOUD_POOL_H_
+
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "cartographer/sensor/point_cloud.h"
+#include "cartographer/sensor/timed_point_cloud_data.h"
+
+namespace cartographer {
+namespace sensor {
+
+// A thread-safe pool of the storage of 'TimedPointCloudData'. Producers of
+// range data take empty buffers from the pool, which keep the capacity of the
+// range data they were recycled from, and the consumer hands them back once
+// it no longer needs the data. In steady state, no point cloud storage is
+// allocated per message.
+class TimedPointCloudPool {
+ public:
+  // Returns the pool shared by all producers and consumers of range data. It
+  // is never destroyed, so that buffers may be recycled during static
+  // destruction.
+  static TimedPointCloudPool* Get();
+
+  TimedPointCloudPool();
+
+  TimedPointCloudPool(const TimedPointCloudPool&) = delete;
+  TimedPointCloudPool& operator=(const TimedPointCloudPool&) = delete;
+
+  // Returns an empty point cloud, reusing recycled storage if available.
+  TimedPointCloud AcquireRanges() LOCKS_EXCLUDED(mutex_);
+  // Returns an empty intensity buffer, reusing recycled storage if available.
+  std::vector<float> AcquireIntensities() LOCKS_EXCLUDED(mutex_);
+
+  // Keeps the storage of 'data' for reuse. Storage beyond what the pool holds
+  // is freed.
+  void Recycle(TimedPointCloudData&& data) LOCKS_EXCLUDED(mutex_);
+
+  // Returns the number of point clouds held for reuse.
+  size_t num_pooled_ranges() LOCKS_EXCLUDED(mutex_);
+
+ private:
+  // Bounds the memory held by the pool to a few messages per sensor.
+  static constexpr size_t kMaxPooledBuffers = 32;
+
+  absl::Mutex mutex_;
+  std::vector<TimedPointCloud> ranges_ GUARDED_BY(mutex_);
+  std::vector<std::vector<float>> intensities_ GUARDED_BY(mutex_);
+};
+
+}  // namespace sensor
+}  // namespace cartographer
+
+#endif  // CARTOGRAPHER_SENSOR_TIMED_POINT_CLOUD_POOL_H_
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer/sensor/timed_point_cloud_pool.h"
+
+#include <utility>
+
+#include "gtest/gtest.h"
+
+namespace cartographer {
+namespace sensor {
+namespace {
+
+TEST(TimedPointCloudPoolTest, ReusesRecycledStorage) {
+  TimedPointCloudPool pool;
+  TimedPointCloudData data{common::FromUniversal(0), Eigen::Vector3f::Zero(),
+                           pool.AcquireRanges(), pool.AcquireIntensities()};
+  for (int i = 0; i != 100; ++i) {
+    data.ranges.push_back({Eigen::Vector3f::Zero(), 0.f});
+    data.intensities.push_back(1.f);
+  }
+  const TimedRangefinderPoint* const points = data.ranges.data();
+  pool.Recycle(std::move(data));
+  EXPECT_EQ(1, pool.num_pooled_ranges());
+
+  const TimedPointCloud ranges = pool.AcquireRanges();
+  EXPECT_TRUE(ranges.empty());
+  EXPECT_GE(ranges.capacity(), 100);
+  EXPECT_EQ(points, ranges.data());
+  EXPECT_GE(pool.AcquireIntensities().capacity(), 100);
+  EXPECT_EQ(0, pool.num_pooled_ranges());
+}
+
+TEST(TimedPointCloudPoolTest, DropsBuffersWithoutStorage) {
+  TimedPointCloudPool pool;
+  pool.Recycle(TimedPointCloudData{});
+  EXPECT_EQ(0, pool.num_pooled_ranges());
+  EXPECT_EQ(0, pool.AcquireRanges().capacity());
+}
+
+}  // namespace
+}  // namespace sensor
+}  // namespace cartographer
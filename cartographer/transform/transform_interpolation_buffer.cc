@@ -74,6 +74,55 @@ transform::Rigid3d TransformInterpolationBuffer::Lookup(
   return Interpolate(*start, *end, time).transform;
 }
 
+std::vector<transform::Rigid3d> TransformInterpolationBuffer::Lookup(
+    const std::vector<common::Time>& times) const {
+  Cursor cursor(this);
+  std::vector<transform::Rigid3d> result;
+  result.reserve(times.size());
+  for (const common::Time time : times) {
+    result.push_back(cursor.Lookup(time));
+  }
+  return result;
+}
+
+TransformInterpolationBuffer::Cursor::Cursor(
+    const TransformInterpolationBuffer* const buffer)
+    : buffer_(buffer) {}
+
+transform::Rigid3d TransformInterpolationBuffer::Cursor::Lookup(
+    const common::Time time) {
+  CHECK(buffer_->Has(time)) << "Missing transform for: " << time;
+  const std::deque<TimestampedTransform>& transforms =
+      buffer_->timestamped_transforms_;
+  if (index_ >= transforms.size() ||
+      (index_ > 0 && transforms[index_ - 1].time >= time)) {
+    index_ = 0;
+  }
+  // All transforms before 'index_' are before 'time'. We search forward in
+  // steps of increasing size until we passed 'time', and then do a binary
+  // search in the last step.
+  size_t bound = index_;
+  size_t step = 1;
+  while (bound < transforms.size() && transforms[bound].time < time) {
+    index_ = bound + 1;
+    bound += step;
+    step *= 2;
+  }
+  index_ = std::lower_bound(
+               transforms.begin() + index_,
+               transforms.begin() + std::min(bound, transforms.size()), time,
+               [](const TimestampedTransform& timestamped_transform,
+                  const common::Time time) {
+                 return timestamped_transform.time < time;
+               }) -
+           transforms.begin();
+  const TimestampedTransform& end = transforms[index_];
+  if (end.time == time) {
+    return end.transform;
+  }
+  return Interpolate(transforms[index_ - 1], end, time).transform;
+}
+
 void TransformInterpolationBuffer::RemoveOldTransformsIfNeeded() {
   while (timestamped_transforms_.size() > buffer_size_limit_) {
     timestamped_transforms_.pop_front();
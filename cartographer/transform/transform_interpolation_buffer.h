@@ -19,6 +19,7 @@
 
 #include <deque>
 #include <limits>
+#include <vector>
 
 #include "cartographer/common/time.h"
 #include "cartographer/mapping/proto/trajectory.pb.h"
@@ -34,6 +35,25 @@ constexpr size_t kUnlimitedBufferSize = std::numeric_limits<size_t>::max();
 // Unless explicitly set, the buffer size is unlimited.
 class TransformInterpolationBuffer {
  public:
+  // Looks up transforms starting the search where the previous lookup ended.
+  // For increasing times, a sequence of lookups takes amortized constant time
+  // per lookup, instead of the binary search of Lookup(). Earlier times are
+  // supported as well, but search again from the start. The buffer must not
+  // be modified while a cursor is used.
+  class Cursor {
+   public:
+    explicit Cursor(const TransformInterpolationBuffer* buffer);
+
+    // Returns an interpolated transform at 'time'. CHECK()s that a transform
+    // at 'time' is available.
+    transform::Rigid3d Lookup(common::Time time);
+
+   private:
+    const TransformInterpolationBuffer* const buffer_;
+    // Index of the first transform not before the time of the last lookup.
+    size_t index_ = 0;
+  };
+
   TransformInterpolationBuffer() = default;
   explicit TransformInterpolationBuffer(
       const mapping::proto::Trajectory& trajectory);
@@ -56,6 +76,12 @@ class TransformInterpolationBuffer {
   // 'time' is available.
   transform::Rigid3d Lookup(common::Time time) const;
 
+  // Returns interpolated transforms at 'times' using a Cursor, which is most
+  // efficient if 'times' are sorted. CHECK()s that all transforms are
+  // available.
+  std::vector<transform::Rigid3d> Lookup(
+      const std::vector<common::Time>& times) const;
+
   // Returns the timestamp of the earliest transform in the buffer or 0 if the
   // buffer is empty.
   common::Time earliest_time() const;
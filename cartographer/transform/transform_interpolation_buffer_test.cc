@@ -86,6 +86,37 @@ TEST(TransformInterpolationBufferTest, testSetSizeLimit) {
   EXPECT_FALSE(buffer.Has(common::FromUniversal(1)));
 }
 
+TEST(TransformInterpolationBufferTest, testCursorLookup) {
+  TransformInterpolationBuffer buffer;
+  for (int i = 0; i < 100; ++i) {
+    buffer.Push(common::FromUniversal(10 * i),
+                transform::Rigid3d::Translation(Eigen::Vector3d(i, 0., 0.)) *
+                    transform::Rigid3d::Rotation(Eigen::AngleAxisd(
+                        0.01 * i * i, Eigen::Vector3d::UnitZ())));
+  }
+  TransformInterpolationBuffer::Cursor cursor(&buffer);
+  // Increasing times with small and large gaps, followed by earlier times.
+  for (const int64 time : {0, 3, 3, 10, 15, 17, 250, 251, 990, 5, 500, 499}) {
+    EXPECT_THAT(cursor.Lookup(common::FromUniversal(time)),
+                IsNearly(buffer.Lookup(common::FromUniversal(time)), 1e-9));
+  }
+}
+
+TEST(TransformInterpolationBufferTest, testBatchLookup) {
+  TransformInterpolationBuffer buffer;
+  buffer.Push(common::FromUniversal(50), transform::Rigid3d::Identity());
+  buffer.Push(common::FromUniversal(100),
+              transform::Rigid3d::Translation(Eigen::Vector3d(10., 10., 10.)));
+  const std::vector<common::Time> times = {
+      common::FromUniversal(50), common::FromUniversal(60),
+      common::FromUniversal(75), common::FromUniversal(100)};
+  const std::vector<transform::Rigid3d> transforms = buffer.Lookup(times);
+  ASSERT_EQ(transforms.size(), times.size());
+  for (size_t i = 0; i < times.size(); ++i) {
+    EXPECT_THAT(transforms[i], IsNearly(buffer.Lookup(times[i]), 1e-9));
+  }
+}
+
 }  // namespace
 }  // namespace transform
 }  // namespace cartographer
@@ -24,6 +24,7 @@
 #include "cartographer/common/configuration_file_resolver.h"
 #include "cartographer/common/math.h"
 #include "cartographer/io/file_writer.h"
+#include "cartographer/io/points_cache.h"
 #include "cartographer/io/points_processor.h"
 #include "cartographer/io/points_processor_pipeline_builder.h"
 #include "cartographer/io/proto_stream.h"
@@ -52,6 +53,8 @@ namespace cartographer_ros {
 namespace {
 
 constexpr char kTfStaticTopic[] = "/tf_static";
+// Enough batches to fill the queues of a concurrent pipeline.
+constexpr size_t kMaxNumPooledPointsBatches = 256;
 namespace carto = ::cartographer;
 
 std::unique_ptr<carto::io::PointsProcessorPipelineBuilder>
@@ -94,10 +97,14 @@ std::unique_ptr<carto::io::PointsBatch> HandleMessage(
     const T& message, const std::string& tracking_frame,
     const tf2_ros::Buffer& tf_buffer,
     const carto::transform::TransformInterpolationBuffer&
-        transform_interpolation_buffer) {
+        transform_interpolation_buffer,
+    carto::transform::TransformInterpolationBuffer::Cursor* const
+        transform_cursor,
+    carto::io::PointsBatchPool* const points_batch_pool) {
   const carto::common::Time start_time = FromRos(message.header.stamp);
 
-  auto points_batch = absl::make_unique<carto::io::PointsBatch>();
+  std::unique_ptr<carto::io::PointsBatch> points_batch =
+      points_batch_pool->Acquire();
   points_batch->start_time = start_time;
   points_batch->frame_id = message.header.frame_id;
 
@@ -106,6 +113,8 @@ std::unique_ptr<carto::io::PointsBatch> HandleMessage(
   std::tie(point_cloud, point_cloud_time) =
       ToPointCloudWithIntensities(message);
   CHECK_EQ(point_cloud.intensities.size(), point_cloud.points.size());
+  points_batch->points.reserve(point_cloud.points.size());
+  points_batch->intensities.reserve(point_cloud.points.size());
 
   for (size_t i = 0; i < point_cloud.points.size(); ++i) {
     const carto::common::Time time =
@@ -115,7 +124,7 @@ std::unique_ptr<carto::io::PointsBatch> HandleMessage(
       continue;
     }
     const carto::transform::Rigid3d tracking_to_map =
-        transform_interpolation_buffer.Lookup(time);
+        transform_cursor->Lookup(time);
     const carto::transform::Rigid3d sensor_to_tracking =
         ToRigid3d(tf_buffer.lookupTransform(
             tracking_frame, message.header.frame_id, ToRos(time)));
@@ -129,6 +138,7 @@ std::unique_ptr<carto::io::PointsBatch> HandleMessage(
     points_batch->origin = sensor_to_map * Eigen::Vector3f::Zero();
   }
   if (points_batch->points.empty()) {
+    points_batch_pool->Release(std::move(points_batch));
     return nullptr;
   }
   return points_batch;
@@ -141,8 +151,11 @@ AssetsWriter::AssetsWriter(const std::string& pose_graph_filename,
                            const std::string& output_file_prefix)
     : bag_filenames_(bag_filenames),
       pose_graph_(
-          carto::io::DeserializePoseGraphFromFile(pose_graph_filename)) {
-  CHECK_EQ(pose_graph_.trajectory_size(), bag_filenames_.size())
+          carto::io::DeserializePoseGraphFromFile(pose_graph_filename)),
+      points_batch_pool_(kMaxNumPooledPointsBatches) {
+  CHECK(bag_filenames_.empty() ||
+        static_cast<size_t>(pose_graph_.trajectory_size()) ==
+            bag_filenames_.size())
       << "Pose graphs contains " << pose_graph_.trajectory_size()
       << " trajectories while " << bag_filenames_.size()
       << " bags were provided. This tool requires one bag for each "
@@ -158,6 +171,7 @@ AssetsWriter::AssetsWriter(const std::string& pose_graph_filename,
                                       : bag_filenames_.front() + "_";
   point_pipeline_builder_ =
       CreatePipelineBuilder(all_trajectories_, file_prefix);
+  point_pipeline_builder_->set_points_batch_pool(&points_batch_pool_);
 }
 
 void AssetsWriter::RegisterPointsProcessor(
@@ -166,16 +180,32 @@ void AssetsWriter::RegisterPointsProcessor(
   point_pipeline_builder_->Register(name, factory);
 }
 
+std::vector<std::unique_ptr<carto::io::PointsProcessor>>
+AssetsWriter::CreatePipeline(
+    carto::common::LuaParameterDictionary* const lua_parameter_dictionary) {
+  // Unless 'num_parallel_workers' is set, all points processors run on this
+  // thread.
+  const int num_parallel_workers =
+      lua_parameter_dictionary->HasKey("num_parallel_workers")
+          ? lua_parameter_dictionary->GetNonNegativeInt("num_parallel_workers")
+          : 0;
+  return num_parallel_workers > 0
+             ? point_pipeline_builder_->CreateConcurrentPipeline(
+                   lua_parameter_dictionary->GetDictionary("pipeline").get(),
+                   num_parallel_workers)
+             : point_pipeline_builder_->CreatePipeline(
+                   lua_parameter_dictionary->GetDictionary("pipeline").get());
+}
+
 void AssetsWriter::Run(const std::string& configuration_directory,
                        const std::string& configuration_basename,
                        const std::string& urdf_filename,
                        const bool use_bag_transforms) {
+  CHECK(!bag_filenames_.empty());
   const auto lua_parameter_dictionary =
       LoadLuaDictionary(configuration_directory, configuration_basename);
-
   std::vector<std::unique_ptr<carto::io::PointsProcessor>> pipeline =
-      point_pipeline_builder_->CreatePipeline(
-          lua_parameter_dictionary->GetDictionary("pipeline").get());
+      CreatePipeline(lua_parameter_dictionary.get());
   const std::string tracking_frame =
       lua_parameter_dictionary->GetString("tracking_frame");
 
@@ -196,6 +226,9 @@ void AssetsWriter::Run(const std::string& configuration_directory,
 
       const carto::transform::TransformInterpolationBuffer
           transform_interpolation_buffer(trajectory_proto);
+      // Points are mostly looked up in order of time.
+      carto::transform::TransformInterpolationBuffer::Cursor transform_cursor(
+          &transform_interpolation_buffer);
       rosbag::Bag bag;
       bag.open(bag_filename, rosbag::bagmode::Read);
       rosbag::View view(bag);
@@ -233,16 +266,19 @@ void AssetsWriter::Run(const std::string& configuration_directory,
           if (delayed_message.isType<sensor_msgs::PointCloud2>()) {
             points_batch = HandleMessage(
                 *delayed_message.instantiate<sensor_msgs::PointCloud2>(),
-                tracking_frame, tf_buffer, transform_interpolation_buffer);
+                tracking_frame, tf_buffer, transform_interpolation_buffer,
+                &transform_cursor, &points_batch_pool_);
           } else if (delayed_message
                          .isType<sensor_msgs::MultiEchoLaserScan>()) {
             points_batch = HandleMessage(
                 *delayed_message.instantiate<sensor_msgs::MultiEchoLaserScan>(),
-                tracking_frame, tf_buffer, transform_interpolation_buffer);
+                tracking_frame, tf_buffer, transform_interpolation_buffer,
+                &transform_cursor, &points_batch_pool_);
           } else if (delayed_message.isType<sensor_msgs::LaserScan>()) {
             points_batch = HandleMessage(
                 *delayed_message.instantiate<sensor_msgs::LaserScan>(),
-                tracking_frame, tf_buffer, transform_interpolation_buffer);
+                tracking_frame, tf_buffer, transform_interpolation_buffer,
+                &transform_cursor, &points_batch_pool_);
           }
           if (points_batch != nullptr) {
             points_batch->trajectory_id = trajectory_id;
@@ -261,6 +297,33 @@ void AssetsWriter::Run(const std::string& configuration_directory,
            carto::io::PointsProcessor::FlushResult::kRestartStream);
 }
 
+void AssetsWriter::RunFromPointsCache(
+    const std::string& configuration_directory,
+    const std::string& configuration_basename,
+    const std::string& points_cache_filename) {
+  const auto lua_parameter_dictionary =
+      LoadLuaDictionary(configuration_directory, configuration_basename);
+  std::vector<std::unique_ptr<carto::io::PointsProcessor>> pipeline =
+      CreatePipeline(lua_parameter_dictionary.get());
+  // The points in the cache are already in the map frame, but configurations
+  // are usually shared with Run().
+  if (lua_parameter_dictionary->HasKey("tracking_frame")) {
+    lua_parameter_dictionary->GetString("tracking_frame");
+  }
+
+  const carto::io::PointsCacheReader reader(points_cache_filename);
+  do {
+    for (size_t i = 0; i < reader.chunks().size(); ++i) {
+      for (auto& points_batch : reader.ReadChunk(i, &points_batch_pool_)) {
+        pipeline.back()->Process(std::move(points_batch));
+      }
+      LOG_EVERY_N(INFO, 100) << "Processed " << i + 1 << " of "
+                             << reader.chunks().size() << " chunks...";
+    }
+  } while (pipeline.back()->Flush() ==
+           carto::io::PointsProcessor::FlushResult::kRestartStream);
+}
+
 ::cartographer::io::FileWriterFactory AssetsWriter::CreateFileWriterFactory(
     const std::string& file_path) {
   const auto file_writer_factory = [file_path](const std::string& filename) {
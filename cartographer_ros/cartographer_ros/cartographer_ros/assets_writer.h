@@ -18,6 +18,8 @@
 #include <vector>
 
 #include "cartographer/common/configuration_file_resolver.h"
+#include "cartographer/common/lua_parameter_dictionary.h"
+#include "cartographer/io/points_batch_pool.h"
 #include "cartographer/io/points_processor_pipeline_builder.h"
 #include "cartographer/mapping/proto/pose_graph.pb.h"
 #include "cartographer/mapping/proto/trajectory_builder_options.pb.h"
@@ -29,6 +31,7 @@ namespace cartographer_ros {
 
 class AssetsWriter {
  public:
+  // 'bag_filenames' may be empty if only RunFromPointsCache() is used.
   AssetsWriter(const std::string& pose_graph_filename,
                const std::vector<std::string>& bag_filenames,
                const std::string& output_file_prefix);
@@ -46,14 +49,27 @@ class AssetsWriter {
            const std::string& configuration_basename,
            const std::string& urdf_filename, bool use_bag_transforms);
 
+  // Like Run(), but pushes the points from 'points_cache_filename', written by
+  // a 'write_points_cache' stage of an earlier run, through the pipeline. This
+  // skips reading the bags and transforming the points, which is much faster
+  // when iterating on the configuration of the later stages.
+  void RunFromPointsCache(const std::string& configuration_directory,
+                          const std::string& configuration_basename,
+                          const std::string& points_cache_filename);
+
   // Creates a FileWriterFactory which creates a FileWriter for storing assets.
   static ::cartographer::io::FileWriterFactory CreateFileWriterFactory(
       const std::string& file_path);
 
  private:
+  std::vector<std::unique_ptr<::cartographer::io::PointsProcessor>>
+  CreatePipeline(
+      ::cartographer::common::LuaParameterDictionary* lua_parameter_dictionary);
+
   std::vector<std::string> bag_filenames_;
   std::vector<::cartographer::mapping::proto::Trajectory> all_trajectories_;
   ::cartographer::mapping::proto::PoseGraph pose_graph_;
+  ::cartographer::io::PointsBatchPool points_batch_pool_;
   std::unique_ptr<::cartographer::io::PointsProcessorPipelineBuilder>
       point_pipeline_builder_;
 };
@@ -32,6 +32,10 @@ DEFINE_string(
 DEFINE_string(bag_filenames, "",
               "Bags to process, must be in the same order as the trajectories "
               "in 'pose_graph_filename'.");
+DEFINE_string(points_cache_filename, "",
+              "If set and -bag_filenames is empty, the points are read from "
+              "this cache, written by a 'write_points_cache' stage of an "
+              "earlier run, instead of from the bags.");
 DEFINE_string(pose_graph_filename, "",
               "Proto stream file containing the pose graph.");
 DEFINE_bool(use_bag_transforms, true,
@@ -50,15 +54,26 @@ int main(int argc, char** argv) {
       << "-configuration_directory is missing.";
   CHECK(!FLAGS_configuration_basename.empty())
       << "-configuration_basename is missing.";
-  CHECK(!FLAGS_bag_filenames.empty()) << "-bag_filenames is missing.";
+  CHECK(!FLAGS_bag_filenames.empty() || !FLAGS_points_cache_filename.empty())
+      << "-bag_filenames is missing.";
   CHECK(!FLAGS_pose_graph_filename.empty())
       << "-pose_graph_filename is missing.";
 
+  const bool use_points_cache = FLAGS_bag_filenames.empty();
   ::cartographer_ros::AssetsWriter asset_writer(
       FLAGS_pose_graph_filename,
       absl::StrSplit(FLAGS_bag_filenames, ',', absl::SkipEmpty()),
-      FLAGS_output_file_prefix);
+      use_points_cache && FLAGS_output_file_prefix.empty()
+          ? FLAGS_points_cache_filename + "_"
+          : FLAGS_output_file_prefix);
 
-  asset_writer.Run(FLAGS_configuration_directory, FLAGS_configuration_basename,
-                   FLAGS_urdf_filename, FLAGS_use_bag_transforms);
+  if (use_points_cache) {
+    asset_writer.RunFromPointsCache(FLAGS_configuration_directory,
+                                    FLAGS_configuration_basename,
+                                    FLAGS_points_cache_filename);
+  } else {
+    asset_writer.Run(FLAGS_configuration_directory,
+                     FLAGS_configuration_basename, FLAGS_urdf_filename,
+                     FLAGS_use_bag_transforms);
+  }
 }
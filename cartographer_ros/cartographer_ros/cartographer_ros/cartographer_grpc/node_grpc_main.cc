@@ -52,6 +52,9 @@ DEFINE_bool(upload_load_state_file, false,
             "server instead of loading it from the server file system.");
 DEFINE_string(client_id, "",
               "Cartographer client ID to use when connecting to the server.");
+DEFINE_bool(use_shared_memory, false,
+            "Pass sensor data and local SLAM results through shared memory "
+            "if the server runs on the same host and allows it.");
 
 namespace cartographer_ros {
 namespace {
@@ -66,7 +69,8 @@ void Run() {
       LoadOptions(FLAGS_configuration_directory, FLAGS_configuration_basename);
 
   auto map_builder = absl::make_unique<::cartographer::cloud::MapBuilderStub>(
-      FLAGS_server_address, FLAGS_client_id);
+      FLAGS_server_address, FLAGS_client_id,
+      false /* compress_state_transfers */, FLAGS_use_shared_memory);
 
   if (!FLAGS_load_state_filename.empty() && !FLAGS_upload_load_state_file) {
     map_builder->LoadStateFromFile(FLAGS_load_state_filename,
@@ -25,6 +25,9 @@ DEFINE_string(server_address, "localhost:50051",
               "stream the sensor data to.");
 DEFINE_string(client_id, "",
               "Cartographer client ID to use when connecting to the server.");
+DEFINE_bool(use_shared_memory, false,
+            "Pass sensor data and local SLAM results through shared memory "
+            "if the server runs on the same host and allows it.");
 
 int main(int argc, char** argv) {
   google::InitGoogleLogging(argv[0]);
@@ -40,7 +43,8 @@ int main(int argc, char** argv) {
   const cartographer_ros::MapBuilderFactory map_builder_factory =
       [](const ::cartographer::mapping::proto::MapBuilderOptions&) {
         return absl::make_unique< ::cartographer::cloud::MapBuilderStub>(
-            FLAGS_server_address, FLAGS_client_id);
+            FLAGS_server_address, FLAGS_client_id,
+            false /* compress_state_transfers */, FLAGS_use_shared_memory);
       };
 
   cartographer_ros::RunOfflineNode(map_builder_factory);
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "cartographer_ros/cpu_profiler.h"
+
+#ifdef __linux__
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <sys/time.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <thread>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "glog/logging.h"
+
+namespace cartographer_ros {
+namespace {
+
+// The handler and the trampoline of the signal are the innermost frames.
+constexpr int kNumSignalFrames = 2;
+
+// State shared with the signal handler.
+std::atomic<bool> profile_running{false};
+std::atomic<void*> samples_data{nullptr};
+std::atomic<int> max_num_samples{0};
+std::atomic<int> next_sample_index{0};
+// Handlers currently running, so that Stop() can wait for them to finish.
+std::atomic<int> num_running_handlers{0};
+
+#ifdef __linux__
+struct sigaction previous_sigprof_action;
+
+// Returns a readable name for the code at 'address', preferring the demangled
+// symbol and otherwise the object file and offset.
+std::string Symbolize(void* const address) {
+  Dl_info info;
+  if (dladdr(address, &info) == 0) {
+    return absl::StrCat("0x", absl::Hex(reinterpret_cast<uintptr_t>(address)));
+  }
+  if (info.dli_sname != nullptr) {
+    int status;
+    char* const demangled =
+        abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    std::string result = status == 0 ? demangled : info.dli_sname;
+    free(demangled);
+    return result;
+  }
+  std::string object = info.dli_fname != nullptr ? info.dli_fname : "?";
+  object = object.substr(object.find_last_of('/') + 1);
+  return absl::StrCat(
+      object, "+0x",
+      absl::Hex(reinterpret_cast<uintptr_t>(address) -
+                reinterpret_cast<uintptr_t>(info.dli_fbase)));
+}
+#endif
+
+}  // namespace
+
+constexpr int CpuProfile::kMaxStackDepth;
+
+#ifdef __linux__
+extern "C" void HandleSigprof(int, siginfo_t*, void*);
+#endif
+
+CpuProfile::CpuProfile(const int max_num_samples) : samples_(max_num_samples) {}
+
+std::unique_ptr<CpuProfile> CpuProfile::Start(const int frequency_hz,
+                                              const int max_num_samples_arg) {
+#ifdef __linux__
+  CHECK_GT(frequency_hz, 0);
+  CHECK_GT(max_num_samples_arg, 0);
+  if (profile_running.exchange(true)) {
+    return nullptr;
+  }
+  std::unique_ptr<CpuProfile> profile(new CpuProfile(max_num_samples_arg));
+  // The first call of backtrace() may allocate, which must not happen in the
+  // signal handler.
+  void* frames[kMaxStackDepth];
+  backtrace(frames, kMaxStackDepth);
+  max_num_samples.store(max_num_samples_arg);
+  next_sample_index.store(0);
+  samples_data.store(profile->samples_.data());
+
+  struct sigaction action = {};
+  action.sa_sigaction = &HandleSigprof;
+  action.sa_flags = SA_RESTART | SA_SIGINFO;
+  sigemptyset(&action.sa_mask);
+  PCHECK(sigaction(SIGPROF, &action, &previous_sigprof_action) == 0);
+  struct itimerval timer = {};
+  timer.it_interval.tv_sec = 0;
+  timer.it_interval.tv_usec = std::max(1, 1000000 / frequency_hz);
+  timer.it_value = timer.it_interval;
+  PCHECK(setitimer(ITIMER_PROF, &timer, nullptr) == 0);
+  return profile;
+#else
+  return nullptr;
+#endif
+}
+
+CpuProfile::~CpuProfile() { Stop(); }
+
+void CpuProfile::Stop() {
+  if (!running_) return;
+  running_ = false;
+#ifdef __linux__
+  const struct itimerval timer = {};
+  PCHECK(setitimer(ITIMER_PROF, &timer, nullptr) == 0);
+  samples_data.store(nullptr);
+  // Signals already delivered may still be handled by other threads.
+  while (num_running_handlers.load() > 0) {
+    std::this_thread::yield();
+  }
+  PCHECK(sigaction(SIGPROF, &previous_sigprof_action, nullptr) == 0);
+  const int num_taken_samples = next_sample_index.load();
+  num_samples_ = std::min(num_taken_samples, static_cast<int>(samples_.size()));
+  num_dropped_samples_ = num_taken_samples - num_samples_;
+  profile_running.store(false);
+#endif
+}
+
+void CpuProfile::WriteCollapsedStacks(std::ostream* const out) const {
+  CHECK(!running_);
+#ifdef __linux__
+  std::map<void*, std::string> symbols;
+  std::map<std::string, int> stack_counts;
+  for (int i = 0; i != num_samples_; ++i) {
+    const Sample& sample = samples_[i];
+    std::vector<std::string> frames;
+    for (int j = sample.depth - 1; j >= kNumSignalFrames; --j) {
+      void* const address = sample.frames[j];
+      auto it = symbols.find(address);
+      if (it == symbols.end()) {
+        it = symbols.emplace(address, Symbolize(address)).first;
+      }
+      // ';' separates the frames and is part of some demangled names.
+      std::string frame = it->second;
+      std::replace(frame.begin(), frame.end(), ';', ':');
+      frames.push_back(std::move(frame));
+    }
+    if (!frames.empty()) {
+      ++stack_counts[absl::StrJoin(frames, ";")];
+    }
+  }
+  for (const auto& stack_count : stack_counts) {
+    *out << stack_count.first << " " << stack_count.second << "\n";
+  }
+#endif
+}
+
+#ifdef __linux__
+// Only uses async-signal-safe functions, backtrace() once initialized.
+extern "C" void HandleSigprof(int, siginfo_t*, void*) {
+  const int saved_errno = errno;
+  num_running_handlers.fetch_add(1);
+  auto* const samples =
+      static_cast<CpuProfile::Sample*>(samples_data.load());
+  if (samples != nullptr) {
+    const int index = next_sample_index.fetch_add(1);
+    if (index < max_num_samples.load()) {
+      CpuProfile::Sample& sample = samples[index];
+      sample.depth = backtrace(sample.frames, CpuProfile::kMaxStackDepth);
+    }
+  }
+  num_running_handlers.fetch_sub(1);
+  errno = saved_errno;
+}
+#endif
+
+}  // namespace cartographer_ros
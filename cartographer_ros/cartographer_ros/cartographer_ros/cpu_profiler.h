@@ -0,0 +1,78 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_CPU_PROFILER_H
+#define CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_CPU_PROFILER_H
+
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace cartographer_ros {
+
+// Samples the call stacks of the threads of this process while they use CPU
+// time, driven by SIGPROF. Only one profile can run at a time. The signal
+// handler and the profiling timer are only installed while a profile runs, so
+// there is no cost otherwise. Only samples on Linux.
+class CpuProfile {
+ public:
+  static constexpr int kMaxStackDepth = 32;
+
+  // Return addresses of the innermost 'depth' frames, written by the signal
+  // handler.
+  struct Sample {
+    int depth;
+    void* frames[kMaxStackDepth];
+  };
+
+  // Starts sampling 'frequency_hz' times per second of CPU time used by the
+  // process, keeping the first 'max_num_samples' samples. Returns nullptr if
+  // another profile is running or sampling is not supported.
+  static std::unique_ptr<CpuProfile> Start(int frequency_hz,
+                                           int max_num_samples);
+
+  // Stops sampling if still running.
+  ~CpuProfile();
+
+  CpuProfile(const CpuProfile&) = delete;
+  CpuProfile& operator=(const CpuProfile&) = delete;
+
+  void Stop();
+
+  // Only valid after Stop().
+  int num_samples() const { return num_samples_; }
+  // Samples which were taken after 'max_num_samples' was reached.
+  int num_dropped_samples() const { return num_dropped_samples_; }
+
+  // Writes one line per distinct call stack with its frames from the
+  // outermost to the innermost, separated by ';', followed by the number of
+  // samples of the stack. This is the collapsed stack format read by
+  // flamegraph.pl and speedscope. Must be called after Stop().
+  void WriteCollapsedStacks(std::ostream* out) const;
+
+ private:
+  explicit CpuProfile(int max_num_samples);
+
+  std::vector<Sample> samples_;
+  bool running_ = true;
+  int num_samples_ = 0;
+  int num_dropped_samples_ = 0;
+};
+
+}  // namespace cartographer_ros
+
+#endif  // CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_CPU_PROFILER_H
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "cartographer_ros/cpu_profiler.h"
+
+#include <chrono>
+#include <cmath>
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+namespace cartographer_ros {
+namespace {
+
+double BurnCpu(const std::chrono::milliseconds duration) {
+  const auto end = std::chrono::steady_clock::now() + duration;
+  double sum = 0.;
+  while (std::chrono::steady_clock::now() < end) {
+    for (int i = 0; i != 1000; ++i) sum += std::sqrt(i + sum);
+  }
+  return sum;
+}
+
+TEST(CpuProfileTest, SamplesCallStacks) {
+  std::unique_ptr<CpuProfile> profile =
+      CpuProfile::Start(1000 /* frequency_hz */, 10000 /* max_num_samples */);
+  ASSERT_NE(profile, nullptr);
+  EXPECT_EQ(CpuProfile::Start(1000, 10000), nullptr);
+  EXPECT_GT(BurnCpu(std::chrono::milliseconds(300)), 0.);
+  profile->Stop();
+  EXPECT_GT(profile->num_samples(), 0);
+  EXPECT_EQ(profile->num_dropped_samples(), 0);
+  std::ostringstream out;
+  profile->WriteCollapsedStacks(&out);
+  EXPECT_NE(out.str().find("__libc_start"), std::string::npos);
+  // Another profile can be started once this one stopped.
+  EXPECT_NE(CpuProfile::Start(1000, 10000), nullptr);
+}
+
+TEST(CpuProfileTest, DropsSamplesBeyondMaximum) {
+  std::unique_ptr<CpuProfile> profile =
+      CpuProfile::Start(1000 /* frequency_hz */, 5 /* max_num_samples */);
+  ASSERT_NE(profile, nullptr);
+  EXPECT_GT(BurnCpu(std::chrono::milliseconds(300)), 0.);
+  profile->Stop();
+  EXPECT_EQ(profile->num_samples(), 5);
+  EXPECT_GT(profile->num_dropped_samples(), 0);
+}
+
+}  // namespace
+}  // namespace cartographer_ros
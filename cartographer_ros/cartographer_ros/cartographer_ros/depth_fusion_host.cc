@@ -0,0 +1,53 @@
+/*
+ * Copyright 2021 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "cartographer_ros/depth_fusion_host.h"
+
+#include "boost/bind.hpp"
+#include "cartographer_ros/time_conversion.h"
+#include "glog/logging.h"
+
+namespace cartographer_ros {
+
+DepthFusionHost::DepthFusionHost(Node* const node, const int trajectory_id,
+                                 const std::string& sensor_id)
+    : node_(node),
+      trajectory_id_(trajectory_id),
+      sensor_id_(sensor_id),
+      node_handle_("~depth_fusion"),
+      fusion_(depthimage_to_laserscan::DepthLidarFusion::ScanCallback()) {
+  fusion_.setStampedFusedCallback(
+      boost::bind(&DepthFusionHost::HandleFusedScan, this, _1, _2));
+  fusion_.configureFromParams(node_handle_);
+  fusion_.subscribe(*node->node_handle());
+  LOG(INFO) << "Fusing depth camera and lidar in-process for trajectory "
+            << trajectory_id_ << " as sensor '" << sensor_id_ << "'.";
+}
+
+DepthFusionHost::~DepthFusionHost() { fusion_.unsubscribe(); }
+
+void DepthFusionHost::HandleFusedScan(
+    const sensor_msgs::LaserScan::ConstPtr& msg,
+    const depthimage_to_laserscan::DepthLidarFusion::StageStamps& stamps) {
+  node_->HandleStampedLaserScanMessage(
+      trajectory_id_, sensor_id_, msg,
+      LatencyBudget::UpstreamStamps{FromRos(stamps.received),
+                                    FromRos(stamps.synchronized),
+                                    FromRos(stamps.fused)});
+}
+
+}  // namespace cartographer_ros
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2021 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_DEPTH_FUSION_HOST_H
+#define CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_DEPTH_FUSION_HOST_H
+
+#include <string>
+
+#include "cartographer_ros/node.h"
+#include "depthimage_to_laserscan/DepthLidarFusion.h"
+#include "ros/ros.h"
+#include "sensor_msgs/LaserScan.h"
+
+namespace cartographer_ros {
+
+// Runs the depth camera / lidar fusion of the depthimage_to_laserscan package
+// inside the Cartographer node. Fused scans are handed to
+// Node::HandleLaserScanMessage() directly instead of being published on /scan
+// and deserialized again, which saves one message round-trip per scan and the
+// latency jitter of the ROS transport. The times at which the fusion
+// received, synchronized and fused each scan are passed along for the
+// 'range_data_latency_budget_sec' breakdown.
+//
+// Conversion parameters are read from the '~depth_fusion' namespace with the
+// same names as in the depthimage_to_laserscan node.
+class DepthFusionHost {
+ public:
+  DepthFusionHost(Node* node, int trajectory_id, const std::string& sensor_id);
+  ~DepthFusionHost();
+
+  DepthFusionHost(const DepthFusionHost&) = delete;
+  DepthFusionHost& operator=(const DepthFusionHost&) = delete;
+
+ private:
+  void HandleFusedScan(
+      const sensor_msgs::LaserScan::ConstPtr& msg,
+      const depthimage_to_laserscan::DepthLidarFusion::StageStamps& stamps);
+
+  Node* const node_;
+  const int trajectory_id_;
+  const std::string sensor_id_;
+  ::ros::NodeHandle node_handle_;
+  depthimage_to_laserscan::DepthLidarFusion fusion_;
+};
+
+}  // namespace cartographer_ros
+
+#endif  // CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_DEPTH_FUSION_HOST_H
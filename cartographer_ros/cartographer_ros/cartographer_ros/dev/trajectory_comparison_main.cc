@@ -77,6 +77,8 @@ void Run(const std::string& pbstream_filename,
       *pose_graph_proto.mutable_trajectory()->rbegin();
   const cartographer::transform::TransformInterpolationBuffer
       transform_interpolation_buffer(last_trajectory_proto);
+  cartographer::transform::TransformInterpolationBuffer::Cursor
+      transform_cursor(&transform_interpolation_buffer);
 
   rosbag::Bag bag;
   bag.open(bag_filename, rosbag::bagmode::Read);
@@ -100,8 +102,7 @@ void Run(const std::string& pbstream_filename,
         deviation_rotation.push_back(signal_maximum);
         continue;
       }
-      auto optimized_transform =
-          transform_interpolation_buffer.Lookup(transform_time);
+      auto optimized_transform = transform_cursor.Lookup(transform_time);
       auto published_transform = ToRigid3d(transform);
       deviation_translation.push_back((published_transform.translation() -
                                        optimized_transform.translation())
@@ -0,0 +1,178 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer_ros/latency_budget.h"
+
+#include <iterator>
+
+#include "absl/strings/str_cat.h"
+#include "cartographer/metrics/counter.h"
+#include "cartographer/metrics/histogram.h"
+#include "glog/logging.h"
+
+namespace cartographer_ros {
+
+namespace carto = ::cartographer;
+
+namespace {
+
+// Scans of trajectories without pose updates, e.g. because local SLAM drops
+// them, must not accumulate.
+constexpr size_t kMaxPendingScansPerTrajectory = 64;
+
+constexpr const char* kStageNames[LatencyBudget::kNumStages] = {
+    "to_fusion", "fusion_sync", "fusion", "to_node", "in_node"};
+
+carto::metrics::Histogram* kStageLatencyMetrics[LatencyBudget::kNumStages] = {
+    carto::metrics::Histogram::Null(), carto::metrics::Histogram::Null(),
+    carto::metrics::Histogram::Null(), carto::metrics::Histogram::Null(),
+    carto::metrics::Histogram::Null()};
+carto::metrics::Histogram* kTotalLatencyMetric =
+    carto::metrics::Histogram::Null();
+carto::metrics::Counter* kOverBudgetMetric = carto::metrics::Counter::Null();
+
+double ToSeconds(const carto::common::Time begin,
+                 const carto::common::Time end) {
+  return carto::common::ToSeconds(end - begin);
+}
+
+}  // namespace
+
+LatencyBudget::LatencyBudget(const double budget_sec)
+    : budget_sec_(budget_sec) {
+  CHECK_GT(budget_sec_, 0.);
+}
+
+void LatencyBudget::AddScan(const int trajectory_id,
+                            const carto::common::Time stamp,
+                            const UpstreamStamps* const upstream,
+                            const carto::common::Time received) {
+  PendingScan scan{stamp, absl::nullopt, received};
+  if (upstream != nullptr) {
+    scan.upstream = *upstream;
+  }
+  absl::MutexLock lock(&mutex_);
+  auto& pending_scans = pending_scans_[trajectory_id];
+  if (pending_scans.size() == kMaxPendingScansPerTrajectory) {
+    pending_scans.pop_front();
+  }
+  // Scans of the same trajectory are almost always in order, but several
+  // sensors may interleave.
+  auto it = pending_scans.end();
+  while (it != pending_scans.begin() && std::prev(it)->stamp > stamp) {
+    --it;
+  }
+  pending_scans.insert(it, scan);
+}
+
+std::vector<LatencyBudget::Breakdown> LatencyBudget::OnLocalSlamResult(
+    const int trajectory_id, const carto::common::Time time,
+    const carto::common::Time now) {
+  std::vector<Breakdown> breakdowns;
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = pending_scans_.find(trajectory_id);
+    if (it == pending_scans_.end()) {
+      return breakdowns;
+    }
+    auto& pending_scans = it->second;
+    while (!pending_scans.empty() && pending_scans.front().stamp <= time) {
+      breakdowns.push_back(ComputeBreakdown(pending_scans.front(), now));
+      pending_scans.pop_front();
+    }
+  }
+  for (const Breakdown& breakdown : breakdowns) {
+    for (int stage = 0; stage != kNumStages; ++stage) {
+      if (breakdown.stage_seconds[stage].has_value()) {
+        kStageLatencyMetrics[stage]->Observe(*breakdown.stage_seconds[stage]);
+      }
+    }
+    kTotalLatencyMetric->Observe(breakdown.total_seconds);
+    if (breakdown.total_seconds > budget_sec_) {
+      kOverBudgetMetric->Increment();
+      LOG_EVERY_N(WARNING, 100)
+          << "Trajectory " << trajectory_id << " took "
+          << breakdown.total_seconds << " s from scan to pose, budget is "
+          << budget_sec_ << " s: " << ToString(breakdown);
+    }
+  }
+  return breakdowns;
+}
+
+void LatencyBudget::FinishTrajectory(const int trajectory_id) {
+  absl::MutexLock lock(&mutex_);
+  pending_scans_.erase(trajectory_id);
+}
+
+LatencyBudget::Breakdown LatencyBudget::ComputeBreakdown(
+    const PendingScan& scan, const carto::common::Time now) const {
+  Breakdown breakdown;
+  if (scan.upstream.has_value()) {
+    const UpstreamStamps& upstream = *scan.upstream;
+    breakdown.stage_seconds[kToFusion] =
+        ToSeconds(scan.stamp, upstream.received);
+    breakdown.stage_seconds[kFusionSync] =
+        ToSeconds(upstream.received, upstream.synchronized);
+    breakdown.stage_seconds[kFusion] =
+        ToSeconds(upstream.synchronized, upstream.fused);
+    breakdown.stage_seconds[kToNode] = ToSeconds(upstream.fused, scan.received);
+  } else {
+    breakdown.stage_seconds[kToNode] = ToSeconds(scan.stamp, scan.received);
+  }
+  breakdown.stage_seconds[kInNode] = ToSeconds(scan.received, now);
+  breakdown.total_seconds = ToSeconds(scan.stamp, now);
+  return breakdown;
+}
+
+void LatencyBudget::RegisterMetrics(
+    carto::metrics::FamilyFactory* family_factory) {
+  // 100us to ~3.3s
+  const auto boundaries =
+      carto::metrics::Histogram::ScaledPowersOf(2, 1e-4, 3.3);
+  auto* stage_latency = family_factory->NewHistogramFamily(
+      "range_data_stage_latency",
+      "Time range data spent in each stage from the sensor to the local SLAM "
+      "pose update in seconds",
+      boundaries);
+  for (int stage = 0; stage != kNumStages; ++stage) {
+    kStageLatencyMetrics[stage] =
+        stage_latency->Add({{"stage", kStageNames[stage]}});
+  }
+  auto* total_latency = family_factory->NewHistogramFamily(
+      "range_data_total_latency",
+      "Time from the last measurement of range data to the local SLAM pose "
+      "update in seconds",
+      boundaries);
+  kTotalLatencyMetric = total_latency->Add({});
+  auto* over_budget = family_factory->NewCounterFamily(
+      "range_data_over_latency_budget_total",
+      "Range data which took longer than the latency budget");
+  kOverBudgetMetric = over_budget->Add({});
+}
+
+std::string ToString(const LatencyBudget::Breakdown& breakdown) {
+  std::string result;
+  for (int stage = 0; stage != LatencyBudget::kNumStages; ++stage) {
+    if (!breakdown.stage_seconds[stage].has_value()) {
+      continue;
+    }
+    absl::StrAppend(&result, result.empty() ? "" : ", ", kStageNames[stage],
+                    ": ", *breakdown.stage_seconds[stage]);
+  }
+  return result;
+}
+
+}  // namespace cartographer_ros
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_LATENCY_BUDGET_H
+#define CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_LATENCY_BUDGET_H
+
+#include <array>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
+#include "cartographer/common/time.h"
+#include "cartographer/metrics/family_factory.h"
+
+namespace cartographer_ros {
+
+// Breaks down the latency of laser scans from the time of their last
+// measurement, which is also the time Cartographer uses for them, to the local
+// SLAM pose update which includes them. The stages before the node are only known if the scans come
+// from an in-process stage such as the depth camera / lidar fusion, otherwise
+// they are all part of 'kToNode'. Time spent in the collator and in local SLAM
+// is broken down further by the 'collator_wait_seconds' and local trajectory
+// builder latency metrics of Cartographer.
+//
+// All times are ROS times converted to Cartographer times. Thread-safe, since
+// local SLAM results may arrive on other threads than the sensor data.
+class LatencyBudget {
+ public:
+  enum Stage {
+    kToFusion = 0,  // To the fusion receiving the lidar scan.
+    kFusionSync,    // Waiting for the depth frames.
+    kFusion,        // Conversion and fusion.
+    kToNode,        // To the node receiving the scan.
+    kInNode,        // To the pose update, see above.
+    kNumStages
+  };
+
+  // When an in-process stage received, synchronized and finished the scan.
+  struct UpstreamStamps {
+    ::cartographer::common::Time received;
+    ::cartographer::common::Time synchronized;
+    ::cartographer::common::Time fused;
+  };
+
+  struct Breakdown {
+    // Stages before 'kToNode' are not set if the upstream stamps are unknown.
+    std::array<absl::optional<double>, kNumStages> stage_seconds;
+    double total_seconds;
+  };
+
+  // Scans taking longer than 'budget_sec' in total are logged together with
+  // their breakdown and counted.
+  explicit LatencyBudget(double budget_sec);
+
+  LatencyBudget(const LatencyBudget&) = delete;
+  LatencyBudget& operator=(const LatencyBudget&) = delete;
+
+  // Records a scan of 'trajectory_id' measured until 'stamp', which the
+  // node received at 'received'. Must be called before the scan is handed to
+  // Cartographer, which may already produce its pose update in that call.
+  void AddScan(int trajectory_id, ::cartographer::common::Time stamp,
+               const UpstreamStamps* upstream,
+               ::cartographer::common::Time received) LOCKS_EXCLUDED(mutex_);
+
+  // Completes the scans of 'trajectory_id' which started at or before 'time',
+  // for which local SLAM estimated a pose at 'now'. Returns their breakdowns.
+  std::vector<Breakdown> OnLocalSlamResult(int trajectory_id,
+                                           ::cartographer::common::Time time,
+                                           ::cartographer::common::Time now)
+      LOCKS_EXCLUDED(mutex_);
+
+  // Forgets the scans of 'trajectory_id' which never got a pose update.
+  void FinishTrajectory(int trajectory_id) LOCKS_EXCLUDED(mutex_);
+
+  // Exports histograms of the stages and the total latency, and a counter of
+  // the scans over budget.
+  static void RegisterMetrics(
+      ::cartographer::metrics::FamilyFactory* family_factory);
+
+ private:
+  struct PendingScan {
+    ::cartographer::common::Time stamp;
+    absl::optional<UpstreamStamps> upstream;
+    ::cartographer::common::Time received;
+  };
+
+  Breakdown ComputeBreakdown(const PendingScan& scan,
+                             ::cartographer::common::Time now) const;
+
+  const double budget_sec_;
+  absl::Mutex mutex_;
+  // Sorted by stamp per trajectory.
+  std::map<int, std::deque<PendingScan>> pending_scans_ GUARDED_BY(mutex_);
+};
+
+// Returns the breakdown as "stage: seconds" pairs for logging.
+std::string ToString(const LatencyBudget::Breakdown& breakdown);
+
+}  // namespace cartographer_ros
+
+#endif  // CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_LATENCY_BUDGET_H
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2018 The Cartographer Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cartographer_ros/latency_budget.h"
+
+#include "gtest/gtest.h"
+
+namespace cartographer_ros {
+namespace {
+
+using ::cartographer::common::FromUniversal;
+using ::cartographer::common::Time;
+
+// Universal time is in 100ns units.
+Time AtMilliseconds(const int milliseconds) {
+  return FromUniversal(10000 * milliseconds);
+}
+
+TEST(LatencyBudgetTest, BreaksDownUpstreamStages) {
+  LatencyBudget latency_budget(0.1);
+  const LatencyBudget::UpstreamStamps upstream{
+      AtMilliseconds(2), AtMilliseconds(12), AtMilliseconds(15)};
+  latency_budget.AddScan(0, AtMilliseconds(0), &upstream, AtMilliseconds(16));
+  const auto breakdowns = latency_budget.OnLocalSlamResult(
+      0, AtMilliseconds(0), AtMilliseconds(40));
+  ASSERT_EQ(breakdowns.size(), 1);
+  const auto& stage_seconds = breakdowns[0].stage_seconds;
+  EXPECT_NEAR(*stage_seconds[LatencyBudget::kToFusion], 0.002, 1e-9);
+  EXPECT_NEAR(*stage_seconds[LatencyBudget::kFusionSync], 0.010, 1e-9);
+  EXPECT_NEAR(*stage_seconds[LatencyBudget::kFusion], 0.003, 1e-9);
+  EXPECT_NEAR(*stage_seconds[LatencyBudget::kToNode], 0.001, 1e-9);
+  EXPECT_NEAR(*stage_seconds[LatencyBudget::kInNode], 0.024, 1e-9);
+  EXPECT_NEAR(breakdowns[0].total_seconds, 0.040, 1e-9);
+  EXPECT_EQ(ToString(breakdowns[0]),
+            "to_fusion: 0.002, fusion_sync: 0.01, fusion: 0.003, to_node: "
+            "0.001, in_node: 0.024");
+}
+
+TEST(LatencyBudgetTest, CompletesScansUpToResultTime) {
+  LatencyBudget latency_budget(0.1);
+  latency_budget.AddScan(0, AtMilliseconds(20), nullptr, AtMilliseconds(25));
+  latency_budget.AddScan(0, AtMilliseconds(0), nullptr, AtMilliseconds(30));
+  latency_budget.AddScan(0, AtMilliseconds(40), nullptr, AtMilliseconds(45));
+  latency_budget.AddScan(1, AtMilliseconds(10), nullptr, AtMilliseconds(45));
+
+  auto breakdowns = latency_budget.OnLocalSlamResult(0, AtMilliseconds(20),
+                                                     AtMilliseconds(50));
+  ASSERT_EQ(breakdowns.size(), 2);
+  EXPECT_FALSE(breakdowns[0].stage_seconds[LatencyBudget::kFusion].has_value());
+  EXPECT_NEAR(*breakdowns[0].stage_seconds[LatencyBudget::kToNode], 0.030,
+              1e-9);
+  EXPECT_NEAR(breakdowns[0].total_seconds, 0.050, 1e-9);
+  EXPECT_NEAR(breakdowns[1].total_seconds, 0.030, 1e-9);
+  EXPECT_TRUE(latency_budget
+                  .OnLocalSlamResult(0, AtMilliseconds(30), AtMilliseconds(60))
+                  .empty());
+
+  latency_budget.FinishTrajectory(1);
+  EXPECT_TRUE(latency_budget
+                  .OnLocalSlamResult(1, AtMilliseconds(30), AtMilliseconds(60))
+                  .empty());
+  EXPECT_EQ(latency_budget
+                .OnLocalSlamResult(0, AtMilliseconds(40), AtMilliseconds(60))
+                .size(),
+            1);
+}
+
+}  // namespace
+}  // namespace cartographer_ros
@@ -33,6 +33,12 @@ using ::cartographer::transform::Rigid3d;
 constexpr double kTrajectoryLineStripMarkerScale = 0.07;
 constexpr double kLandmarkMarkerScale = 0.2;
 constexpr double kConstraintMarkerScale = 0.025;
+// Incrementally published trajectory markers cover this many node indices,
+// well below the 16384 point limit of RViz.
+constexpr int kNodesPerTrajectoryMarker = 1000;
+// Incrementally published trajectory markers are only republished if one of
+// their points moved farther than this, in meters.
+constexpr double kTrajectoryMarkerUpdateTolerance = 0.01;
 
 ::std_msgs::ColorRGBA ToMessage(const cartographer::io::FloatColor& color) {
   ::std_msgs::ColorRGBA result;
@@ -43,6 +49,23 @@ constexpr double kConstraintMarkerScale = 0.025;
   return result;
 }
 
+// Appends the textures of 'response_proto' to 'textures'.
+void AppendTextures(
+    const cartographer::mapping::proto::SubmapQuery::Response& response_proto,
+    std::vector<cartographer_ros_msgs::SubmapTexture>* const textures) {
+  for (const auto& texture_proto : response_proto.textures()) {
+    textures->emplace_back();
+    auto& texture = textures->back();
+    texture.cells.insert(texture.cells.begin(), texture_proto.cells().begin(),
+                         texture_proto.cells().end());
+    texture.width = texture_proto.width();
+    texture.height = texture_proto.height();
+    texture.resolution = texture_proto.resolution();
+    texture.slice_pose = ToGeometryMsgPose(
+        cartographer::transform::ToRigid3(texture_proto.slice_pose()));
+  }
+}
+
 visualization_msgs::Marker CreateTrajectoryMarker(const int trajectory_id,
                                                   const std::string& frame_id) {
   visualization_msgs::Marker marker;
@@ -94,6 +117,58 @@ void PushAndResetLineMarker(visualization_msgs::Marker* marker,
   marker->points.clear();
 }
 
+// Returns the alpha of the trajectory line starting at 'node_index'. The line
+// fades after the last nodes with inter-submap constraints.
+float GetTrajectoryLineAlpha(const int node_index,
+                             const int last_inter_submap_constrained_node,
+                             const int last_inter_trajectory_constrained_node) {
+  if (node_index >= last_inter_submap_constrained_node) {
+    return 0.25f;
+  }
+  if (node_index >= last_inter_trajectory_constrained_node) {
+    return 0.5f;
+  }
+  return 1.f;
+}
+
+// Returns true if 'markers' differ from 'previous_markers' by more than
+// 'kTrajectoryMarkerUpdateTolerance'.
+bool TrajectoryMarkersChanged(
+    const std::vector<visualization_msgs::Marker>& previous_markers,
+    const std::vector<visualization_msgs::Marker>& markers) {
+  if (previous_markers.size() != markers.size()) {
+    return true;
+  }
+  for (size_t i = 0; i != markers.size(); ++i) {
+    if (previous_markers[i].color.a != markers[i].color.a ||
+        previous_markers[i].points.size() != markers[i].points.size()) {
+      return true;
+    }
+    for (size_t j = 0; j != markers[i].points.size(); ++j) {
+      const auto& previous_point = previous_markers[i].points[j];
+      const auto& point = markers[i].points[j];
+      const double dx = point.x - previous_point.x;
+      const double dy = point.y - previous_point.y;
+      const double dz = point.z - previous_point.z;
+      if (dx * dx + dy * dy + dz * dz >
+          kTrajectoryMarkerUpdateTolerance * kTrajectoryMarkerUpdateTolerance) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Appends DELETE actions for 'markers' to 'marker_array'.
+void AppendDeleteMarkers(const std::vector<visualization_msgs::Marker>& markers,
+                         visualization_msgs::MarkerArray* marker_array) {
+  for (visualization_msgs::Marker marker : markers) {
+    marker.action = visualization_msgs::Marker::DELETE;
+    marker.points.clear();
+    marker_array->markers.push_back(marker);
+  }
+}
+
 }  // namespace
 
 MapBuilderBridge::MapBuilderBridge(
@@ -102,7 +177,11 @@ MapBuilderBridge::MapBuilderBridge(
     tf2_ros::Buffer* const tf_buffer)
     : node_options_(node_options),
       map_builder_(std::move(map_builder)),
-      tf_buffer_(tf_buffer) {}
+      tf_buffer_(tf_buffer),
+      latency_budget_(node_options.range_data_latency_budget_sec > 0.
+                          ? absl::make_unique<LatencyBudget>(
+                                node_options.range_data_latency_budget_sec)
+                          : nullptr) {}
 
 void MapBuilderBridge::LoadState(const std::string& state_filename,
                                  bool load_frozen_state) {
@@ -122,15 +201,21 @@ int MapBuilderBridge::AddTrajectory(
     const std::set<cartographer::mapping::TrajectoryBuilderInterface::SensorId>&
         expected_sensor_ids,
     const TrajectoryOptions& trajectory_options) {
+  // The callback keeps the slot alive in case it still runs after
+  // FinishTrajectory().
+  auto local_slam_data_slot = std::make_shared<LocalSlamDataSlot>();
   const int trajectory_id = map_builder_->AddTrajectoryBuilder(
       expected_sensor_ids, trajectory_options.trajectory_builder_options,
-      [this](const int trajectory_id, const ::cartographer::common::Time time,
-             const Rigid3d local_pose,
-             ::cartographer::sensor::RangeData range_data_in_local,
-             const std::unique_ptr<
-                 const ::cartographer::mapping::TrajectoryBuilderInterface::
-                     InsertionResult>) {
-        OnLocalSlamResult(trajectory_id, time, local_pose, range_data_in_local);
+      [this, local_slam_data_slot](
+          const int trajectory_id, const ::cartographer::common::Time time,
+          const Rigid3d local_pose,
+          ::cartographer::sensor::RangeData range_data_in_local,
+          const std::unique_ptr<
+              const ::cartographer::mapping::TrajectoryBuilderInterface::
+                  InsertionResult>) {
+        OnLocalSlamResult(trajectory_id, time, local_pose,
+                          std::move(range_data_in_local),
+                          local_slam_data_slot.get());
       });
   LOG(INFO) << "Added trajectory with ID '" << trajectory_id << "'.";
 
@@ -141,6 +226,8 @@ int MapBuilderBridge::AddTrajectory(
       trajectory_options.tracking_frame,
       node_options_.lookup_transform_timeout_sec, tf_buffer_,
       map_builder_->GetTrajectoryBuilder(trajectory_id));
+  local_slam_data_slots_.emplace(trajectory_id,
+                                 std::move(local_slam_data_slot));
   auto emplace_result =
       trajectory_options_.emplace(trajectory_id, trajectory_options);
   CHECK(emplace_result.second == true);
@@ -154,6 +241,10 @@ void MapBuilderBridge::FinishTrajectory(const int trajectory_id) {
   CHECK(GetTrajectoryStates().count(trajectory_id));
   map_builder_->FinishTrajectory(trajectory_id);
   sensor_bridges_.erase(trajectory_id);
+  local_slam_data_slots_.erase(trajectory_id);
+  if (latency_budget_ != nullptr) {
+    latency_budget_->FinishTrajectory(trajectory_id);
+  }
 }
 
 void MapBuilderBridge::RunFinalOptimization() {
@@ -183,16 +274,53 @@ void MapBuilderBridge::HandleSubmapQuery(
   }
 
   response.submap_version = response_proto.submap_version();
-  for (const auto& texture_proto : response_proto.textures()) {
-    response.textures.emplace_back();
-    auto& texture = response.textures.back();
-    texture.cells.insert(texture.cells.begin(), texture_proto.cells().begin(),
-                         texture_proto.cells().end());
-    texture.width = texture_proto.width();
-    texture.height = texture_proto.height();
-    texture.resolution = texture_proto.resolution();
-    texture.slice_pose = ToGeometryMsgPose(
-        cartographer::transform::ToRigid3(texture_proto.slice_pose()));
+  AppendTextures(response_proto, &response.textures);
+  response.status.message = "Success.";
+  response.status.code = cartographer_ros_msgs::StatusCode::OK;
+}
+
+void MapBuilderBridge::HandleSubmapTexturesQuery(
+    cartographer_ros_msgs::SubmapTexturesQuery::Request& request,
+    cartographer_ros_msgs::SubmapTexturesQuery::Response& response) {
+  if (request.trajectory_ids.size() != request.submap_indices.size() ||
+      (!request.known_submap_versions.empty() &&
+       request.known_submap_versions.size() != request.submap_indices.size())) {
+    response.status.code = cartographer_ros_msgs::StatusCode::INVALID_ARGUMENT;
+    response.status.message =
+        "'trajectory_ids', 'submap_indices' and 'known_submap_versions' "
+        "differ in size.";
+    return;
+  }
+  for (size_t i = 0; i < request.submap_indices.size(); ++i) {
+    const cartographer::mapping::SubmapId submap_id{request.trajectory_ids[i],
+                                                    request.submap_indices[i]};
+    response.submaps.emplace_back();
+    auto& submap = response.submaps.back();
+    submap.trajectory_id = submap_id.trajectory_id;
+    submap.submap_index = submap_id.submap_index;
+    // The version is the number of range data in the submap, which we can
+    // check without computing the textures.
+    const auto submap_data =
+        map_builder_->pose_graph()->GetSubmapData(submap_id);
+    if (!request.known_submap_versions.empty() &&
+        submap_data.submap != nullptr &&
+        submap_data.submap->num_range_data() ==
+            request.known_submap_versions[i]) {
+      submap.submap_version = request.known_submap_versions[i];
+      submap.status.code = cartographer_ros_msgs::StatusCode::OK;
+      continue;
+    }
+    cartographer::mapping::proto::SubmapQuery::Response response_proto;
+    const std::string error =
+        map_builder_->SubmapToProto(submap_id, &response_proto);
+    if (!error.empty()) {
+      submap.status.code = cartographer_ros_msgs::StatusCode::NOT_FOUND;
+      submap.status.message = error;
+      continue;
+    }
+    submap.submap_version = response_proto.submap_version();
+    AppendTextures(response_proto, &submap.textures);
+    submap.status.code = cartographer_ros_msgs::StatusCode::OK;
   }
   response.status.message = "Success.";
   response.status.code = cartographer_ros_msgs::StatusCode::OK;
@@ -236,13 +364,10 @@ MapBuilderBridge::GetLocalTrajectoryData() {
     const int trajectory_id = entry.first;
     const SensorBridge& sensor_bridge = *entry.second;
 
-    std::shared_ptr<const LocalTrajectoryData::LocalSlamData> local_slam_data;
-    {
-      absl::MutexLock lock(&mutex_);
-      if (local_slam_data_.count(trajectory_id) == 0) {
-        continue;
-      }
-      local_slam_data = local_slam_data_.at(trajectory_id);
+    const std::shared_ptr<const LocalTrajectoryData::LocalSlamData>
+        local_slam_data = local_slam_data_slots_.at(trajectory_id)->Load();
+    if (local_slam_data == nullptr) {
+      continue;
     }
 
     // Make sure there is a trajectory with 'trajectory_id'.
@@ -382,6 +507,209 @@ visualization_msgs::MarkerArray MapBuilderBridge::GetTrajectoryNodeList() {
   return trajectory_node_list;
 }
 
+visualization_msgs::MarkerArray MapBuilderBridge::GetTrajectoryNodeListUpdate(
+    const bool publish_all) {
+  visualization_msgs::MarkerArray trajectory_node_list;
+  // Node poses are copied from the last published pose graph snapshot and do
+  // not change until the next one, whose constraints have a new version.
+  const auto node_poses = map_builder_->pose_graph()->GetTrajectoryNodePoses();
+  const auto constraints =
+      map_builder_->pose_graph()->GetConstraintsSnapshot();
+  const bool constraints_changed =
+      constraints.version != trajectory_markers_constraints_version_;
+  trajectory_markers_constraints_version_ = constraints.version;
+
+  for (auto it = trajectory_markers_.begin();
+       it != trajectory_markers_.end();) {
+    if (node_poses.SizeOfTrajectoryOrZero(it->first) != 0) {
+      ++it;
+      continue;
+    }
+    for (const auto& chunk : it->second.chunk_markers) {
+      AppendDeleteMarkers(chunk.second, &trajectory_node_list);
+    }
+    it = trajectory_markers_.erase(it);
+  }
+  bool has_new_trajectory = false;
+  for (const int trajectory_id : node_poses.trajectory_ids()) {
+    if (trajectory_markers_.count(trajectory_id) == 0 &&
+        node_poses.SizeOfTrajectoryOrZero(trajectory_id) != 0) {
+      has_new_trajectory = true;
+    }
+  }
+
+  // Same as in GetTrajectoryNodeList(), but only as of the last optimization.
+  const bool update_constrained_nodes =
+      constraints_changed || has_new_trajectory;
+  std::map<int, int /* node_index */>
+      trajectory_to_last_inter_submap_constrained_node;
+  std::map<int, int /* node_index */>
+      trajectory_to_last_inter_trajectory_constrained_node;
+  if (update_constrained_nodes) {
+    for (const auto& constraint : *constraints.constraints) {
+      if (constraint.tag !=
+          cartographer::mapping::PoseGraphInterface::Constraint::INTER_SUBMAP) {
+        continue;
+      }
+      int& last_constrained_node =
+          constraint.node_id.trajectory_id ==
+                  constraint.submap_id.trajectory_id
+              ? trajectory_to_last_inter_submap_constrained_node
+                    [constraint.node_id.trajectory_id]
+              : trajectory_to_last_inter_trajectory_constrained_node
+                    [constraint.node_id.trajectory_id];
+      last_constrained_node =
+          std::max(last_constrained_node, constraint.node_id.node_index);
+    }
+  }
+
+  for (const int trajectory_id : node_poses.trajectory_ids()) {
+    const auto trajectory = node_poses.trajectory(trajectory_id);
+    if (trajectory.begin() == trajectory.end()) {
+      continue;
+    }
+    TrajectoryMarkers& markers = trajectory_markers_[trajectory_id];
+    const int first_node_index = trajectory.begin()->id.node_index;
+    const int last_node_index = (--trajectory.end())->id.node_index;
+    bool constrained_nodes_changed = false;
+    if (update_constrained_nodes) {
+      int last_inter_trajectory_constrained_node = std::max(
+          first_node_index,
+          trajectory_to_last_inter_trajectory_constrained_node[trajectory_id]);
+      int last_inter_submap_constrained_node = std::max(
+          {first_node_index,
+           trajectory_to_last_inter_submap_constrained_node[trajectory_id],
+           last_inter_trajectory_constrained_node});
+      if (map_builder_->pose_graph()->IsTrajectoryFrozen(trajectory_id)) {
+        last_inter_submap_constrained_node = last_node_index;
+        last_inter_trajectory_constrained_node = last_node_index;
+      }
+      constrained_nodes_changed =
+          last_inter_submap_constrained_node !=
+              markers.last_inter_submap_constrained_node ||
+          last_inter_trajectory_constrained_node !=
+              markers.last_inter_trajectory_constrained_node;
+      markers.last_inter_submap_constrained_node =
+          last_inter_submap_constrained_node;
+      markers.last_inter_trajectory_constrained_node =
+          last_inter_trajectory_constrained_node;
+    }
+
+    // Without a new snapshot, only nodes after the last returned one were
+    // added, so the chunks before it are unchanged.
+    int first_chunk_index = first_node_index / kNodesPerTrajectoryMarker;
+    if (!publish_all && !constraints_changed && !constrained_nodes_changed) {
+      if (last_node_index == markers.last_node_index) {
+        continue;
+      }
+      first_chunk_index = std::max(first_chunk_index,
+                                   markers.last_node_index /
+                                       kNodesPerTrajectoryMarker);
+    }
+    markers.last_node_index = last_node_index;
+
+    // Each chunk starts with the last node of the chunk before, so that the
+    // lines appear connected.
+    std::map<int, std::vector<visualization_msgs::Marker>> chunk_markers;
+    visualization_msgs::Marker marker =
+        CreateTrajectoryMarker(trajectory_id, node_options_.map_frame);
+    int chunk_index = -1;
+    bool has_previous_node = false;
+    int previous_node_index = 0;
+    ::geometry_msgs::Point previous_node_point;
+    const auto push_marker = [&marker, &chunk_markers, &chunk_index]() {
+      // A single point is not drawn as a line.
+      if (marker.points.size() > 1) {
+        chunk_markers[chunk_index].push_back(marker);
+      }
+      marker.points.clear();
+    };
+    for (const auto& node_id_data : trajectory) {
+      const int node_index = node_id_data.id.node_index;
+      const int node_chunk_index = node_index / kNodesPerTrajectoryMarker;
+      if (node_chunk_index >= first_chunk_index &&
+          node_chunk_index != chunk_index) {
+        if (chunk_index != -1) {
+          push_marker();
+        }
+        chunk_index = node_chunk_index;
+        chunk_markers[chunk_index];
+        if (has_previous_node) {
+          marker.points.push_back(previous_node_point);
+          marker.color.a = GetTrajectoryLineAlpha(
+              previous_node_index, markers.last_inter_submap_constrained_node,
+              markers.last_inter_trajectory_constrained_node);
+        }
+      }
+      if (!node_id_data.data.constant_pose_data.has_value()) {
+        if (chunk_index != -1) {
+          push_marker();
+        }
+        has_previous_node = false;
+        continue;
+      }
+      const ::geometry_msgs::Point node_point =
+          ToGeometryMsgPoint(node_id_data.data.global_pose.translation());
+      has_previous_node = true;
+      previous_node_index = node_index;
+      previous_node_point = node_point;
+      if (chunk_index == -1) {
+        continue;
+      }
+      const float alpha = GetTrajectoryLineAlpha(
+          node_index, markers.last_inter_submap_constrained_node,
+          markers.last_inter_trajectory_constrained_node);
+      if (marker.points.empty()) {
+        marker.color.a = alpha;
+      }
+      marker.points.push_back(node_point);
+      if (alpha != marker.color.a) {
+        push_marker();
+        marker.points.push_back(node_point);
+        marker.color.a = alpha;
+      }
+    }
+    push_marker();
+
+    // Chunks without nodes anymore, e.g. after trimming, are deleted.
+    for (auto it = markers.chunk_markers.lower_bound(first_chunk_index);
+         it != markers.chunk_markers.end();) {
+      if (chunk_markers.count(it->first) != 0) {
+        ++it;
+        continue;
+      }
+      AppendDeleteMarkers(it->second, &trajectory_node_list);
+      it = markers.chunk_markers.erase(it);
+    }
+    for (auto& chunk : chunk_markers) {
+      std::vector<visualization_msgs::Marker>& previous_markers =
+          markers.chunk_markers[chunk.first];
+      if (!publish_all &&
+          !TrajectoryMarkersChanged(previous_markers, chunk.second)) {
+        continue;
+      }
+      // Marker IDs of a chunk are kept, surplus ones are deleted.
+      for (size_t i = 0; i != chunk.second.size(); ++i) {
+        chunk.second[i].id = i < previous_markers.size()
+                                 ? previous_markers[i].id
+                                 : markers.next_marker_id++;
+      }
+      if (previous_markers.size() > chunk.second.size()) {
+        AppendDeleteMarkers(
+            std::vector<visualization_msgs::Marker>(
+                previous_markers.begin() + chunk.second.size(),
+                previous_markers.end()),
+            &trajectory_node_list);
+      }
+      trajectory_node_list.markers.insert(trajectory_node_list.markers.end(),
+                                          chunk.second.begin(),
+                                          chunk.second.end());
+      previous_markers = std::move(chunk.second);
+    }
+  }
+  return trajectory_node_list;
+}
+
 visualization_msgs::MarkerArray MapBuilderBridge::GetLandmarkPosesList() {
   visualization_msgs::MarkerArray landmark_poses_list;
   const std::map<std::string, Rigid3d> landmark_poses =
@@ -395,6 +723,26 @@ visualization_msgs::MarkerArray MapBuilderBridge::GetLandmarkPosesList() {
 }
 
 visualization_msgs::MarkerArray MapBuilderBridge::GetConstraintList() {
+  return CreateConstraintList(map_builder_->pose_graph()->constraints());
+}
+
+visualization_msgs::MarkerArray MapBuilderBridge::GetConstraintListUpdate(
+    const bool publish_all) {
+  // Unlike constraints(), the snapshot is neither copied nor does it wait for
+  // the pose graph.
+  const auto constraints =
+      map_builder_->pose_graph()->GetConstraintsSnapshot();
+  if (!publish_all && constraints.version == constraint_list_version_) {
+    return visualization_msgs::MarkerArray();
+  }
+  constraint_list_version_ = constraints.version;
+  return CreateConstraintList(*constraints.constraints);
+}
+
+visualization_msgs::MarkerArray MapBuilderBridge::CreateConstraintList(
+    const std::vector<
+        ::cartographer::mapping::PoseGraphInterface::Constraint>&
+        constraints) {
   visualization_msgs::MarkerArray constraint_list;
   int marker_id = 0;
   visualization_msgs::Marker constraint_intra_marker;
@@ -444,7 +792,6 @@ visualization_msgs::MarkerArray MapBuilderBridge::GetConstraintList() {
   const auto trajectory_node_poses =
       map_builder_->pose_graph()->GetTrajectoryNodePoses();
   const auto submap_poses = map_builder_->pose_graph()->GetAllSubmapPoses();
-  const auto constraints = map_builder_->pose_graph()->constraints();
 
   for (const auto& constraint : constraints) {
     visualization_msgs::Marker *constraint_marker, *residual_marker;
@@ -523,16 +870,31 @@ SensorBridge* MapBuilderBridge::sensor_bridge(const int trajectory_id) {
   return sensor_bridges_.at(trajectory_id).get();
 }
 
+void MapBuilderBridge::LocalSlamDataSlot::Store(
+    std::shared_ptr<const LocalTrajectoryData::LocalSlamData> local_slam_data) {
+  // The previous result is released outside of the exchange, usually freeing
+  // its range data unless the publisher still holds it.
+  std::atomic_exchange(&local_slam_data_, std::move(local_slam_data));
+}
+
+std::shared_ptr<const MapBuilderBridge::LocalTrajectoryData::LocalSlamData>
+MapBuilderBridge::LocalSlamDataSlot::Load() const {
+  return std::atomic_load(&local_slam_data_);
+}
+
 void MapBuilderBridge::OnLocalSlamResult(
     const int trajectory_id, const ::cartographer::common::Time time,
     const Rigid3d local_pose,
-    ::cartographer::sensor::RangeData range_data_in_local) {
-  std::shared_ptr<const LocalTrajectoryData::LocalSlamData> local_slam_data =
+    ::cartographer::sensor::RangeData range_data_in_local,
+    LocalSlamDataSlot* const local_slam_data_slot) {
+  if (latency_budget_ != nullptr) {
+    latency_budget_->OnLocalSlamResult(trajectory_id, time,
+                                       FromRos(::ros::Time::now()));
+  }
+  local_slam_data_slot->Store(
       std::make_shared<LocalTrajectoryData::LocalSlamData>(
           LocalTrajectoryData::LocalSlamData{time, local_pose,
-                                             std::move(range_data_in_local)});
-  absl::MutexLock lock(&mutex_);
-  local_slam_data_[trajectory_id] = std::move(local_slam_data);
+                                             std::move(range_data_in_local)}));
 }
 
 }  // namespace cartographer_ros
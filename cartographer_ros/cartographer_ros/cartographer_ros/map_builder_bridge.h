@@ -17,16 +17,19 @@
 #ifndef CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_MAP_BUILDER_BRIDGE_H
 #define CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_MAP_BUILDER_BRIDGE_H
 
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
-#include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
 #include "cartographer/mapping/map_builder_interface.h"
 #include "cartographer/mapping/pose_graph_interface.h"
 #include "cartographer/mapping/proto/trajectory_builder_options.pb.h"
 #include "cartographer/mapping/trajectory_builder_interface.h"
+#include "cartographer_ros/latency_budget.h"
 #include "cartographer_ros/node_options.h"
 #include "cartographer_ros/sensor_bridge.h"
 #include "cartographer_ros/tf_bridge.h"
@@ -34,6 +37,7 @@
 #include "cartographer_ros_msgs/SubmapEntry.h"
 #include "cartographer_ros_msgs/SubmapList.h"
 #include "cartographer_ros_msgs/SubmapQuery.h"
+#include "cartographer_ros_msgs/SubmapTexturesQuery.h"
 #include "cartographer_ros_msgs/TrajectoryQuery.h"
 #include "geometry_msgs/TransformStamped.h"
 #include "nav_msgs/OccupancyGrid.h"
@@ -60,7 +64,7 @@ class MapBuilderBridge {
     };
     std::shared_ptr<const LocalSlamData> local_slam_data;
     cartographer::transform::Rigid3d local_to_map;
-    std::unique_ptr<cartographer::transform::Rigid3d> published_to_tracking;
+    absl::optional<cartographer::transform::Rigid3d> published_to_tracking;
     TrajectoryOptions trajectory_options;
   };
 
@@ -86,6 +90,11 @@ class MapBuilderBridge {
   void HandleSubmapQuery(
       cartographer_ros_msgs::SubmapQuery::Request& request,
       cartographer_ros_msgs::SubmapQuery::Response& response);
+  // Like HandleSubmapQuery() for several submaps. Textures of submaps whose
+  // version the client already has are not computed.
+  void HandleSubmapTexturesQuery(
+      cartographer_ros_msgs::SubmapTexturesQuery::Request& request,
+      cartographer_ros_msgs::SubmapTexturesQuery::Response& response);
   void HandleTrajectoryQuery(
       cartographer_ros_msgs::TrajectoryQuery::Request& request,
       cartographer_ros_msgs::TrajectoryQuery::Response& response);
@@ -94,35 +103,80 @@ class MapBuilderBridge {
            ::cartographer::mapping::PoseGraphInterface::TrajectoryState>
   GetTrajectoryStates();
   cartographer_ros_msgs::SubmapList GetSubmapList();
-  std::unordered_map<int, LocalTrajectoryData> GetLocalTrajectoryData()
-      LOCKS_EXCLUDED(mutex_);
+  std::unordered_map<int, LocalTrajectoryData> GetLocalTrajectoryData();
   visualization_msgs::MarkerArray GetTrajectoryNodeList();
+  // Like GetTrajectoryNodeList(), but only returns the markers which changed
+  // since the last call, or all of them if 'publish_all' is true. Each marker
+  // covers a fixed range of node indices and is only returned again if nodes
+  // were added to it or moved noticeably.
+  visualization_msgs::MarkerArray GetTrajectoryNodeListUpdate(bool publish_all);
   visualization_msgs::MarkerArray GetLandmarkPosesList();
   visualization_msgs::MarkerArray GetConstraintList();
+  // Like GetConstraintList(), but returns no markers if the constraints were
+  // not published anew by the pose graph since the last call and
+  // 'publish_all' is false.
+  visualization_msgs::MarkerArray GetConstraintListUpdate(bool publish_all);
 
   SensorBridge* sensor_bridge(int trajectory_id);
+  // nullptr unless 'range_data_latency_budget_sec' is set.
+  LatencyBudget* latency_budget() { return latency_budget_.get(); }
 
  private:
+  // Hands the latest local SLAM result of a trajectory from its local SLAM
+  // thread to the publisher. Only the pointer is exchanged atomically, so
+  // neither side waits for the other or for other trajectories, and the
+  // publisher keeps the result it loaded alive for as long as it needs it.
+  class LocalSlamDataSlot {
+   public:
+    void Store(std::shared_ptr<const LocalTrajectoryData::LocalSlamData>
+                   local_slam_data);
+    // nullptr until the first result is stored.
+    std::shared_ptr<const LocalTrajectoryData::LocalSlamData> Load() const;
+
+   private:
+    std::shared_ptr<const LocalTrajectoryData::LocalSlamData> local_slam_data_;
+  };
+
   void OnLocalSlamResult(const int trajectory_id,
                          const ::cartographer::common::Time time,
                          const ::cartographer::transform::Rigid3d local_pose,
-                         ::cartographer::sensor::RangeData range_data_in_local)
-      LOCKS_EXCLUDED(mutex_);
+                         ::cartographer::sensor::RangeData range_data_in_local,
+                         LocalSlamDataSlot* local_slam_data_slot);
+  visualization_msgs::MarkerArray CreateConstraintList(
+      const std::vector<
+          ::cartographer::mapping::PoseGraphInterface::Constraint>&
+          constraints);
 
-  absl::Mutex mutex_;
   const NodeOptions node_options_;
-  std::unordered_map<int,
-                     std::shared_ptr<const LocalTrajectoryData::LocalSlamData>>
-      local_slam_data_ GUARDED_BY(mutex_);
   std::unique_ptr<cartographer::mapping::MapBuilderInterface> map_builder_;
   tf2_ros::Buffer* const tf_buffer_;
+  const std::unique_ptr<LatencyBudget> latency_budget_;
 
   std::unordered_map<std::string /* landmark ID */, int> landmark_to_index_;
 
   // These are keyed with 'trajectory_id'.
   std::unordered_map<int, TrajectoryOptions> trajectory_options_;
   std::unordered_map<int, std::unique_ptr<SensorBridge>> sensor_bridges_;
+  // Shared with the local SLAM callback of the trajectory.
+  std::unordered_map<int, std::shared_ptr<LocalSlamDataSlot>>
+      local_slam_data_slots_;
   std::unordered_map<int, size_t> trajectory_to_highest_marker_id_;
+
+  // State of GetTrajectoryNodeListUpdate() for each trajectory.
+  struct TrajectoryMarkers {
+    int last_inter_submap_constrained_node = -1;
+    int last_inter_trajectory_constrained_node = -1;
+    int last_node_index = -1;
+    int next_marker_id = 0;
+    // The markers last returned for each chunk of node indices.
+    std::map<int /* chunk_index */, std::vector<visualization_msgs::Marker>>
+        chunk_markers;
+  };
+  std::map<int /* trajectory_id */, TrajectoryMarkers> trajectory_markers_;
+  // Versions of the constraints last used by GetTrajectoryNodeListUpdate() and
+  // GetConstraintListUpdate().
+  int64_t trajectory_markers_constraints_version_ = -1;
+  int64_t constraint_list_version_ = -1;
 };
 
 }  // namespace cartographer_ros
@@ -27,53 +27,62 @@ namespace metrics {
 using BucketBoundaries = ::cartographer::metrics::Histogram::BucketBoundaries;
 
 Counter* CounterFamily::Add(const std::map<std::string, std::string>& labels) {
-  auto wrapper = absl::make_unique<Counter>(labels);
-  auto* ptr = wrapper.get();
-  wrappers_.emplace_back(std::move(wrapper));
-  return ptr;
+  absl::MutexLock lock(&mutex_);
+  auto& wrapper = wrappers_[labels];
+  if (wrapper == nullptr) {
+    wrapper = absl::make_unique<Counter>(labels);
+  }
+  return wrapper.get();
 }
 
 cartographer_ros_msgs::MetricFamily CounterFamily::ToRosMessage() {
   cartographer_ros_msgs::MetricFamily family_msg;
   family_msg.name = name_;
   family_msg.description = description_;
-  for (const auto& wrapper : wrappers_) {
-    family_msg.metrics.push_back(wrapper->ToRosMessage());
+  absl::MutexLock lock(&mutex_);
+  for (const auto& labels_and_wrapper : wrappers_) {
+    family_msg.metrics.push_back(labels_and_wrapper.second->ToRosMessage());
   }
   return family_msg;
 }
 
 Gauge* GaugeFamily::Add(const std::map<std::string, std::string>& labels) {
-  auto wrapper = absl::make_unique<Gauge>(labels);
-  auto* ptr = wrapper.get();
-  wrappers_.emplace_back(std::move(wrapper));
-  return ptr;
+  absl::MutexLock lock(&mutex_);
+  auto& wrapper = wrappers_[labels];
+  if (wrapper == nullptr) {
+    wrapper = absl::make_unique<Gauge>(labels);
+  }
+  return wrapper.get();
 }
 
 cartographer_ros_msgs::MetricFamily GaugeFamily::ToRosMessage() {
   cartographer_ros_msgs::MetricFamily family_msg;
   family_msg.name = name_;
   family_msg.description = description_;
-  for (const auto& wrapper : wrappers_) {
-    family_msg.metrics.push_back(wrapper->ToRosMessage());
+  absl::MutexLock lock(&mutex_);
+  for (const auto& labels_and_wrapper : wrappers_) {
+    family_msg.metrics.push_back(labels_and_wrapper.second->ToRosMessage());
   }
   return family_msg;
 }
 
 Histogram* HistogramFamily::Add(
     const std::map<std::string, std::string>& labels) {
-  auto wrapper = absl::make_unique<Histogram>(labels, boundaries_);
-  auto* ptr = wrapper.get();
-  wrappers_.emplace_back(std::move(wrapper));
-  return ptr;
+  absl::MutexLock lock(&mutex_);
+  auto& wrapper = wrappers_[labels];
+  if (wrapper == nullptr) {
+    wrapper = absl::make_unique<Histogram>(labels, boundaries_);
+  }
+  return wrapper.get();
 }
 
 cartographer_ros_msgs::MetricFamily HistogramFamily::ToRosMessage() {
   cartographer_ros_msgs::MetricFamily family_msg;
   family_msg.name = name_;
   family_msg.description = description_;
-  for (const auto& wrapper : wrappers_) {
-    family_msg.metrics.push_back(wrapper->ToRosMessage());
+  absl::MutexLock lock(&mutex_);
+  for (const auto& labels_and_wrapper : wrappers_) {
+    family_msg.metrics.push_back(labels_and_wrapper.second->ToRosMessage());
   }
   return family_msg;
 }
@@ -17,9 +17,12 @@
 #ifndef CARTOGRAPHER_ROS_METRICS_INTERNAL_FAMILY_H
 #define CARTOGRAPHER_ROS_METRICS_INTERNAL_FAMILY_H
 
+#include <map>
 #include <memory>
 #include <string>
 
+#include "absl/synchronization/mutex.h"
+
 #include "cartographer/metrics/family_factory.h"
 #include "cartographer_ros/metrics/internal/counter.h"
 #include "cartographer_ros/metrics/internal/gauge.h"
@@ -39,7 +42,11 @@ class CounterFamily
  private:
   std::string name_;
   std::string description_;
-  std::vector<std::unique_ptr<Counter>> wrappers_;
+  absl::Mutex mutex_;
+  // Metrics by their labels, so that adding the same labels again returns the
+  // same metric.
+  std::map<std::map<std::string, std::string>, std::unique_ptr<Counter>>
+      wrappers_ GUARDED_BY(mutex_);
 };
 
 class GaugeFamily
@@ -54,7 +61,11 @@ class GaugeFamily
  private:
   std::string name_;
   std::string description_;
-  std::vector<std::unique_ptr<Gauge>> wrappers_;
+  absl::Mutex mutex_;
+  // Metrics by their labels, so that adding the same labels again returns the
+  // same metric.
+  std::map<std::map<std::string, std::string>, std::unique_ptr<Gauge>>
+      wrappers_ GUARDED_BY(mutex_);
 };
 
 class HistogramFamily : public ::cartographer::metrics::Family<
@@ -71,7 +82,11 @@ class HistogramFamily : public ::cartographer::metrics::Family<
  private:
   std::string name_;
   std::string description_;
-  std::vector<std::unique_ptr<Histogram>> wrappers_;
+  absl::Mutex mutex_;
+  // Metrics by their labels, so that adding the same labels again returns the
+  // same metric.
+  std::map<std::map<std::string, std::string>, std::unique_ptr<Histogram>>
+      wrappers_ GUARDED_BY(mutex_);
   const BucketBoundaries boundaries_;
 };
 
@@ -17,7 +17,13 @@
 #include "cartographer_ros/msg_conversion.h"
 
 #include <cmath>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
 
+#include "absl/types/optional.h"
 #include "cartographer/common/math.h"
 #include "cartographer/common/port.h"
 #include "cartographer/common/time.h"
@@ -31,6 +37,7 @@
 #include "geometry_msgs/TransformStamped.h"
 #include "geometry_msgs/Vector3.h"
 #include "glog/logging.h"
+#include "map_msgs/OccupancyGridUpdate.h"
 #include "nav_msgs/OccupancyGrid.h"
 #include "pcl/point_cloud.h"
 #include "pcl/point_types.h"
@@ -128,10 +135,39 @@ float GetFirstEcho(const sensor_msgs::LaserEcho& echo) {
   return echo.echoes[0];
 }
 
+// Returns the unit vectors in the direction of the beams of a laser scan with
+// the given geometry. The geometry is fixed per sensor, so the directions are
+// only computed for the first message of each sensor. Conversions run on the
+// ROS callback threads, hence each thread keeps its own cache.
+const std::vector<Eigen::Vector2f>& GetBeamDirections(
+    const float angle_min, const float angle_increment,
+    const size_t num_beams) {
+  using ScanGeometry = std::tuple<float, float, size_t>;
+  // Bounds the cache in case the geometry varies between messages.
+  constexpr size_t kMaxCachedScanGeometries = 16;
+  thread_local std::map<ScanGeometry, std::vector<Eigen::Vector2f>> cache;
+  const ScanGeometry scan_geometry(angle_min, angle_increment, num_beams);
+  auto it = cache.find(scan_geometry);
+  if (it != cache.end()) {
+    return it->second;
+  }
+  if (cache.size() == kMaxCachedScanGeometries) {
+    cache.clear();
+  }
+  std::vector<Eigen::Vector2f> beam_directions;
+  beam_directions.reserve(num_beams);
+  float angle = angle_min;
+  for (size_t i = 0; i < num_beams; ++i) {
+    beam_directions.emplace_back(std::cos(angle), std::sin(angle));
+    angle += angle_increment;
+  }
+  return cache.emplace(scan_geometry, std::move(beam_directions)).first->second;
+}
+
 // For sensor_msgs::LaserScan and sensor_msgs::MultiEchoLaserScan.
 template <typename LaserMessageType>
-std::tuple<PointCloudWithIntensities, ::cartographer::common::Time>
-LaserScanToPointCloudWithIntensities(const LaserMessageType& msg) {
+::cartographer::common::Time LaserScanToPointCloudWithIntensities(
+    const LaserMessageType& msg, PointCloudWithIntensities* const point_cloud) {
   CHECK_GE(msg.range_min, 0.f);
   CHECK_GE(msg.range_max, msg.range_min);
   if (msg.angle_increment > 0.f) {
@@ -139,39 +175,45 @@ LaserScanToPointCloudWithIntensities(const LaserMessageType& msg) {
   } else {
     CHECK_GT(msg.angle_min, msg.angle_max);
   }
-  PointCloudWithIntensities point_cloud;
-  float angle = msg.angle_min;
+  const bool has_intensities = !msg.intensities.empty();
+  if (has_intensities) {
+    CHECK_EQ(msg.intensities.size(), msg.ranges.size());
+  }
+  const std::vector<Eigen::Vector2f>& beam_directions = GetBeamDirections(
+      msg.angle_min, msg.angle_increment, msg.ranges.size());
+  point_cloud->points.clear();
+  point_cloud->intensities.clear();
+  point_cloud->points.reserve(msg.ranges.size());
+  point_cloud->intensities.reserve(msg.ranges.size());
   for (size_t i = 0; i < msg.ranges.size(); ++i) {
     const auto& echoes = msg.ranges[i];
     if (HasEcho(echoes)) {
       const float first_echo = GetFirstEcho(echoes);
       if (msg.range_min <= first_echo && first_echo <= msg.range_max) {
-        const Eigen::AngleAxisf rotation(angle, Eigen::Vector3f::UnitZ());
-        const cartographer::sensor::TimedRangefinderPoint point{
-            rotation * (first_echo * Eigen::Vector3f::UnitX()),
-            i * msg.time_increment};
-        point_cloud.points.push_back(point);
-        if (msg.intensities.size() > 0) {
-          CHECK_EQ(msg.intensities.size(), msg.ranges.size());
+        const Eigen::Vector2f position = first_echo * beam_directions[i];
+        point_cloud->points.push_back(
+            cartographer::sensor::TimedRangefinderPoint{
+                Eigen::Vector3f(position.x(), position.y(), 0.f),
+                i * msg.time_increment});
+        if (has_intensities) {
           const auto& echo_intensities = msg.intensities[i];
           CHECK(HasEcho(echo_intensities));
-          point_cloud.intensities.push_back(GetFirstEcho(echo_intensities));
+          point_cloud->intensities.push_back(GetFirstEcho(echo_intensities));
         } else {
-          point_cloud.intensities.push_back(0.f);
+          point_cloud->intensities.push_back(0.f);
         }
       }
     }
-    angle += msg.angle_increment;
   }
   ::cartographer::common::Time timestamp = FromRos(msg.header.stamp);
-  if (!point_cloud.points.empty()) {
-    const double duration = point_cloud.points.back().time;
+  if (!point_cloud->points.empty()) {
+    const double duration = point_cloud->points.back().time;
     timestamp += cartographer::common::FromSeconds(duration);
-    for (auto& point : point_cloud.points) {
+    for (auto& point : point_cloud->points) {
       point.time -= duration;
     }
   }
-  return std::make_tuple(point_cloud, timestamp);
+  return timestamp;
 }
 
 bool PointCloud2HasField(const sensor_msgs::PointCloud2& pc2,
@@ -184,37 +226,10 @@ bool PointCloud2HasField(const sensor_msgs::PointCloud2& pc2,
   return false;
 }
 
-}  // namespace
-
-sensor_msgs::PointCloud2 ToPointCloud2Message(
-    const int64_t timestamp, const std::string& frame_id,
-    const ::cartographer::sensor::TimedPointCloud& point_cloud) {
-  auto msg = PreparePointCloud2Message(timestamp, frame_id, point_cloud.size());
-  ::ros::serialization::OStream stream(msg.data.data(), msg.data.size());
-  for (const cartographer::sensor::TimedRangefinderPoint& point : point_cloud) {
-    stream.next(point.position.x());
-    stream.next(point.position.y());
-    stream.next(point.position.z());
-    stream.next(kPointCloudComponentFourMagic);
-  }
-  return msg;
-}
-
-std::tuple<::cartographer::sensor::PointCloudWithIntensities,
-           ::cartographer::common::Time>
-ToPointCloudWithIntensities(const sensor_msgs::LaserScan& msg) {
-  return LaserScanToPointCloudWithIntensities(msg);
-}
-
-std::tuple<::cartographer::sensor::PointCloudWithIntensities,
-           ::cartographer::common::Time>
-ToPointCloudWithIntensities(const sensor_msgs::MultiEchoLaserScan& msg) {
-  return LaserScanToPointCloudWithIntensities(msg);
-}
-
-std::tuple<::cartographer::sensor::PointCloudWithIntensities,
-           ::cartographer::common::Time>
-ToPointCloudWithIntensities(const sensor_msgs::PointCloud2& msg) {
+// Converts through PCL, which supports any layout PCL can map onto its point
+// types, but copies the data twice.
+PointCloudWithIntensities PointCloud2ToPointCloudWithIntensitiesUsingPcl(
+    const sensor_msgs::PointCloud2& msg) {
   PointCloudWithIntensities point_cloud;
   // We check for intensity field here to avoid run-time warnings if we pass in
   // a PointCloud2 without intensity.
@@ -264,6 +279,176 @@ ToPointCloudWithIntensities(const sensor_msgs::PointCloud2& msg) {
       }
     }
   }
+  return point_cloud;
+}
+
+// Location and type of a field in the points of a sensor_msgs::PointCloud2.
+struct PointCloud2Field {
+  uint32_t offset;
+  uint8_t datatype;
+  // Factor to convert the value, e.g. from nanoseconds to seconds.
+  float scale;
+};
+
+template <typename T>
+float ReadAsFloat(const uint8_t* const data) {
+  T value;
+  std::memcpy(&value, data, sizeof(T));
+  return static_cast<float>(value);
+}
+
+float ReadField(const uint8_t* const point, const PointCloud2Field& field) {
+  const uint8_t* const data = point + field.offset;
+  switch (field.datatype) {
+    case sensor_msgs::PointField::FLOAT32:
+      return ReadAsFloat<float>(data) * field.scale;
+    case sensor_msgs::PointField::FLOAT64:
+      return ReadAsFloat<double>(data) * field.scale;
+    case sensor_msgs::PointField::INT8:
+      return ReadAsFloat<int8_t>(data) * field.scale;
+    case sensor_msgs::PointField::UINT8:
+      return ReadAsFloat<uint8_t>(data) * field.scale;
+    case sensor_msgs::PointField::INT16:
+      return ReadAsFloat<int16_t>(data) * field.scale;
+    case sensor_msgs::PointField::UINT16:
+      return ReadAsFloat<uint16_t>(data) * field.scale;
+    case sensor_msgs::PointField::INT32:
+      return ReadAsFloat<int32_t>(data) * field.scale;
+    case sensor_msgs::PointField::UINT32:
+      return ReadAsFloat<uint32_t>(data) * field.scale;
+  }
+  LOG(FATAL) << "Unsupported datatype " << static_cast<int>(field.datatype);
+  return 0.f;
+}
+
+// Returns the scalar field 'field_name' of 'msg' if it exists and has one of
+// the standard datatypes.
+absl::optional<PointCloud2Field> FindPointCloud2Field(
+    const sensor_msgs::PointCloud2& msg, const std::string& field_name,
+    const float scale) {
+  for (const auto& field : msg.fields) {
+    if (field.name == field_name && field.count == 1 &&
+        field.datatype >= sensor_msgs::PointField::INT8 &&
+        field.datatype <= sensor_msgs::PointField::FLOAT64) {
+      return PointCloud2Field{field.offset, field.datatype, scale};
+    }
+  }
+  return absl::nullopt;
+}
+
+// Decodes 'msg' by striding through its data with the field offsets, which
+// are looked up once per message. This covers the layouts of the common
+// drivers, e.g. Velodyne ('time' in seconds), Ouster ('t' in nanoseconds) and
+// Livox (no per-point time). Returns false for layouts it does not handle.
+bool DecodePointCloud2(const sensor_msgs::PointCloud2& msg,
+                       PointCloudWithIntensities* const point_cloud) {
+  if (msg.is_bigendian) {
+    return false;
+  }
+  const auto x = FindPointCloud2Field(msg, "x", 1.f);
+  const auto y = FindPointCloud2Field(msg, "y", 1.f);
+  const auto z = FindPointCloud2Field(msg, "z", 1.f);
+  if (!x || !y || !z || x->datatype != sensor_msgs::PointField::FLOAT32 ||
+      y->datatype != sensor_msgs::PointField::FLOAT32 ||
+      z->datatype != sensor_msgs::PointField::FLOAT32) {
+    return false;
+  }
+  const auto intensity = FindPointCloud2Field(msg, "intensity", 1.f);
+  auto time = FindPointCloud2Field(msg, "time", 1.f);
+  if (!time) {
+    time = FindPointCloud2Field(msg, "t", 1e-9f);
+  }
+
+  const size_t num_points = static_cast<size_t>(msg.width) * msg.height;
+  CHECK_GE(msg.data.size(), static_cast<size_t>(msg.row_step) * msg.height);
+  point_cloud->points.clear();
+  point_cloud->intensities.clear();
+  point_cloud->points.reserve(num_points);
+  point_cloud->intensities.reserve(num_points);
+  for (uint32_t row = 0; row != msg.height; ++row) {
+    const uint8_t* point = msg.data.data() + row * msg.row_step;
+    for (uint32_t column = 0; column != msg.width;
+         ++column, point += msg.point_step) {
+      point_cloud->points.push_back(
+          {Eigen::Vector3f{ReadAsFloat<float>(point + x->offset),
+                           ReadAsFloat<float>(point + y->offset),
+                           ReadAsFloat<float>(point + z->offset)},
+           time ? ReadField(point, *time) : 0.f});
+      // Without an intensity field, we fill in 1.0f.
+      point_cloud->intensities.push_back(
+          intensity ? ReadField(point, *intensity) : 1.f);
+    }
+  }
+  return true;
+}
+
+// Converts a pixel painted by ::cartographer::io::PaintSubmapSlices(...) into
+// an occupancy grid cell value.
+int8_t ToOccupancyGridValue(const uint32_t packed) {
+  const unsigned char color = packed >> 16;
+  const unsigned char observed = packed >> 8;
+  const int value =
+      observed == 0
+          ? -1
+          : ::cartographer::common::RoundToInt((1. - color / 255.) * 100.);
+  CHECK_LE(-1, value);
+  CHECK_GE(100, value);
+  return value;
+}
+
+}  // namespace
+
+sensor_msgs::PointCloud2 ToPointCloud2Message(
+    const int64_t timestamp, const std::string& frame_id,
+    const ::cartographer::sensor::TimedPointCloud& point_cloud) {
+  auto msg = PreparePointCloud2Message(timestamp, frame_id, point_cloud.size());
+  ::ros::serialization::OStream stream(msg.data.data(), msg.data.size());
+  for (const cartographer::sensor::TimedRangefinderPoint& point : point_cloud) {
+    stream.next(point.position.x());
+    stream.next(point.position.y());
+    stream.next(point.position.z());
+    stream.next(kPointCloudComponentFourMagic);
+  }
+  return msg;
+}
+
+std::tuple<::cartographer::sensor::PointCloudWithIntensities,
+           ::cartographer::common::Time>
+ToPointCloudWithIntensities(const sensor_msgs::LaserScan& msg) {
+  PointCloudWithIntensities point_cloud;
+  const ::cartographer::common::Time time =
+      LaserScanToPointCloudWithIntensities(msg, &point_cloud);
+  return std::make_tuple(std::move(point_cloud), time);
+}
+
+::cartographer::common::Time ToPointCloudWithIntensities(
+    const sensor_msgs::LaserScan& msg,
+    PointCloudWithIntensities* const point_cloud) {
+  return LaserScanToPointCloudWithIntensities(msg, point_cloud);
+}
+
+std::tuple<::cartographer::sensor::PointCloudWithIntensities,
+           ::cartographer::common::Time>
+ToPointCloudWithIntensities(const sensor_msgs::MultiEchoLaserScan& msg) {
+  PointCloudWithIntensities point_cloud;
+  const ::cartographer::common::Time time =
+      LaserScanToPointCloudWithIntensities(msg, &point_cloud);
+  return std::make_tuple(std::move(point_cloud), time);
+}
+
+::cartographer::common::Time ToPointCloudWithIntensities(
+    const sensor_msgs::MultiEchoLaserScan& msg,
+    PointCloudWithIntensities* const point_cloud) {
+  return LaserScanToPointCloudWithIntensities(msg, point_cloud);
+}
+
+std::tuple<::cartographer::sensor::PointCloudWithIntensities,
+           ::cartographer::common::Time>
+ToPointCloudWithIntensities(const sensor_msgs::PointCloud2& msg) {
+  PointCloudWithIntensities point_cloud;
+  if (!DecodePointCloud2(msg, &point_cloud)) {
+    point_cloud = PointCloud2ToPointCloudWithIntensitiesUsingPcl(msg);
+  }
   ::cartographer::common::Time timestamp = FromRos(msg.header.stamp);
   if (!point_cloud.points.empty()) {
     const double duration = point_cloud.points.back().time;
@@ -401,20 +586,59 @@ std::unique_ptr<nav_msgs::OccupancyGrid> CreateOccupancyGridMsg(
   occupancy_grid->data.reserve(width * height);
   for (int y = height - 1; y >= 0; --y) {
     for (int x = 0; x < width; ++x) {
-      const uint32_t packed = pixel_data[y * width + x];
-      const unsigned char color = packed >> 16;
-      const unsigned char observed = packed >> 8;
-      const int value =
-          observed == 0
-              ? -1
-              : ::cartographer::common::RoundToInt((1. - color / 255.) * 100.);
-      CHECK_LE(-1, value);
-      CHECK_GE(100, value);
-      occupancy_grid->data.push_back(value);
+      occupancy_grid->data.push_back(
+          ToOccupancyGridValue(pixel_data[y * width + x]));
     }
   }
 
   return occupancy_grid;
 }
 
+map_msgs::OccupancyGridUpdate UpdateOccupancyGrid(
+    const cartographer::io::PaintSubmapSlicesResult& painted_slices,
+    nav_msgs::OccupancyGrid* const occupancy_grid) {
+  const int width = cairo_image_surface_get_width(painted_slices.surface.get());
+  const int height =
+      cairo_image_surface_get_height(painted_slices.surface.get());
+  const double resolution = occupancy_grid->info.resolution;
+  const int grid_width = occupancy_grid->info.width;
+  const int grid_height = occupancy_grid->info.height;
+
+  // Offset from pixels of 'painted_slices' to pixels of the surface the grid
+  // was created from, inverting the origin computation in
+  // CreateOccupancyGridMsg().
+  const int x_offset = ::cartographer::common::RoundToInt(
+      -occupancy_grid->info.origin.position.x / resolution -
+      painted_slices.origin.x());
+  const int y_offset = ::cartographer::common::RoundToInt(
+      occupancy_grid->info.origin.position.y / resolution + grid_height -
+      painted_slices.origin.y());
+
+  map_msgs::OccupancyGridUpdate update;
+  update.header = occupancy_grid->header;
+  update.x = x_offset;
+  update.y = grid_height - height - y_offset;
+  update.width = width;
+  update.height = height;
+  CHECK_GE(update.x, 0);
+  CHECK_GE(update.y, 0);
+  CHECK_LE(update.x + width, grid_width);
+  CHECK_LE(update.y + height, grid_height);
+
+  const uint32_t* pixel_data = reinterpret_cast<uint32_t*>(
+      cairo_image_surface_get_data(painted_slices.surface.get()));
+  update.data.reserve(width * height);
+  for (int y = height - 1; y >= 0; --y) {
+    int8_t* const grid_row =
+        occupancy_grid->data.data() +
+        (grid_height - 1 - (y + y_offset)) * grid_width + update.x;
+    for (int x = 0; x < width; ++x) {
+      const int8_t value = ToOccupancyGridValue(pixel_data[y * width + x]);
+      grid_row[x] = value;
+      update.data.push_back(value);
+    }
+  }
+  return update;
+}
+
 }  // namespace cartographer_ros
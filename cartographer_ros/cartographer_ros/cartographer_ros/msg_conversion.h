@@ -26,6 +26,7 @@
 #include "geometry_msgs/Pose.h"
 #include "geometry_msgs/Transform.h"
 #include "geometry_msgs/TransformStamped.h"
+#include "map_msgs/OccupancyGridUpdate.h"
 #include "nav_msgs/OccupancyGrid.h"
 #include "sensor_msgs/Imu.h"
 #include "sensor_msgs/LaserScan.h"
@@ -61,6 +62,16 @@ std::tuple<::cartographer::sensor::PointCloudWithIntensities,
            ::cartographer::common::Time>
 ToPointCloudWithIntensities(const sensor_msgs::PointCloud2& msg);
 
+// Like above, but converts into 'point_cloud', whose storage is reused, and
+// returns the time.
+::cartographer::common::Time ToPointCloudWithIntensities(
+    const sensor_msgs::LaserScan& msg,
+    ::cartographer::sensor::PointCloudWithIntensities* point_cloud);
+
+::cartographer::common::Time ToPointCloudWithIntensities(
+    const sensor_msgs::MultiEchoLaserScan& msg,
+    ::cartographer::sensor::PointCloudWithIntensities* point_cloud);
+
 ::cartographer::sensor::LandmarkData ToLandmarkData(
     const cartographer_ros_msgs::LandmarkList& landmark_list);
 
@@ -89,6 +100,14 @@ std::unique_ptr<nav_msgs::OccupancyGrid> CreateOccupancyGridMsg(
     const double resolution, const std::string& frame_id,
     const ros::Time& time);
 
+// Copies painted submap slices into the cells of 'occupancy_grid' they cover
+// and returns the update message for that rectangle. The slices must have been
+// painted at the grid's resolution and with pixel aligned origins, e.g. by
+// ::cartographer::io::PaintSubmapSlicesInBox(...), and lie within the grid.
+map_msgs::OccupancyGridUpdate UpdateOccupancyGrid(
+    const cartographer::io::PaintSubmapSlicesResult& painted_slices,
+    nav_msgs::OccupancyGrid* occupancy_grid);
+
 }  // namespace cartographer_ros
 
 #endif  // CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_MSG_CONVERSION_H
@@ -17,13 +17,16 @@
 #include "cartographer_ros/msg_conversion.h"
 
 #include <cmath>
+#include <cstring>
 #include <random>
+#include <tuple>
 
 #include "cartographer/transform/rigid_transform_test_helpers.h"
 #include "cartographer_ros/time_conversion.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "sensor_msgs/LaserScan.h"
+#include "sensor_msgs/PointCloud2.h"
 
 namespace cartographer_ros {
 namespace {
@@ -37,6 +40,22 @@ using ::testing::Field;
 
 constexpr double kEps = 1e-6;
 
+void AddPointField(const std::string& name, const uint32_t offset,
+                   const uint8_t datatype, sensor_msgs::PointCloud2* msg) {
+  sensor_msgs::PointField field;
+  field.name = name;
+  field.offset = offset;
+  field.datatype = datatype;
+  field.count = 1;
+  msg->fields.push_back(field);
+}
+
+template <typename T>
+void WritePointField(const T value, const size_t byte_offset,
+                     sensor_msgs::PointCloud2* msg) {
+  std::memcpy(msg->data.data() + byte_offset, &value, sizeof(T));
+}
+
 TEST(MsgConversion, LaserScanToPointCloud) {
   sensor_msgs::LaserScan laser_scan;
   for (int i = 0; i < 8; ++i) {
@@ -72,6 +91,71 @@ TEST(MsgConversion, LaserScanToPointCloud) {
   }
 }
 
+TEST(MsgConversion, LaserScansWithChangingGeometry) {
+  sensor_msgs::LaserScan laser_scan;
+  laser_scan.ranges = {1.f, 2.f, 3.f};
+  laser_scan.angle_min = 0.f;
+  laser_scan.angle_max = static_cast<float>(M_PI);
+  laser_scan.angle_increment = static_cast<float>(M_PI_2);
+  laser_scan.range_min = 0.f;
+  laser_scan.range_max = 10.f;
+  auto point_cloud =
+      std::get<0>(ToPointCloudWithIntensities(laser_scan)).points;
+  ASSERT_EQ(point_cloud.size(), 3);
+  EXPECT_TRUE(
+      point_cloud[1].position.isApprox(Eigen::Vector3f(0.f, 2.f, 0.f), kEps));
+
+  // Same geometry, different ranges.
+  laser_scan.ranges = {4.f, 5.f, 6.f};
+  point_cloud = std::get<0>(ToPointCloudWithIntensities(laser_scan)).points;
+  ASSERT_EQ(point_cloud.size(), 3);
+  EXPECT_TRUE(
+      point_cloud[2].position.isApprox(Eigen::Vector3f(-6.f, 0.f, 0.f), kEps));
+
+  // Different geometry.
+  laser_scan.angle_min = static_cast<float>(-M_PI_2);
+  laser_scan.angle_max = static_cast<float>(M_PI_2);
+  point_cloud = std::get<0>(ToPointCloudWithIntensities(laser_scan)).points;
+  ASSERT_EQ(point_cloud.size(), 3);
+  EXPECT_TRUE(
+      point_cloud[0].position.isApprox(Eigen::Vector3f(0.f, -4.f, 0.f), kEps));
+  EXPECT_TRUE(
+      point_cloud[2].position.isApprox(Eigen::Vector3f(0.f, 6.f, 0.f), kEps));
+}
+
+TEST(MsgConversion, LaserScanIntoReusedPointCloud) {
+  sensor_msgs::LaserScan laser_scan;
+  laser_scan.ranges = {1.f, 20.f, 3.f, 4.f};
+  laser_scan.intensities = {5.f, 6.f, 7.f, 8.f};
+  laser_scan.angle_min = 0.f;
+  laser_scan.angle_max = static_cast<float>(M_PI);
+  laser_scan.angle_increment = static_cast<float>(M_PI / 3.);
+  laser_scan.time_increment = 0.1f;
+  laser_scan.range_min = 0.f;
+  laser_scan.range_max = 10.f;
+  ::cartographer::sensor::PointCloudWithIntensities point_cloud;
+  ToPointCloudWithIntensities(laser_scan, &point_cloud);
+  const auto* const points_data = point_cloud.points.data();
+
+  laser_scan.ranges = {2.f, 3.f, 4.f, 20.f};
+  const ::cartographer::common::Time time =
+      ToPointCloudWithIntensities(laser_scan, &point_cloud);
+  ::cartographer::sensor::PointCloudWithIntensities expected_point_cloud;
+  ::cartographer::common::Time expected_time;
+  std::tie(expected_point_cloud, expected_time) =
+      ToPointCloudWithIntensities(laser_scan);
+  EXPECT_EQ(time, expected_time);
+  EXPECT_EQ(point_cloud.points.data(), points_data);
+  ASSERT_EQ(point_cloud.points.size(), 3);
+  EXPECT_THAT(point_cloud.intensities, ElementsAre(5.f, 6.f, 7.f));
+  for (size_t i = 0; i != point_cloud.points.size(); ++i) {
+    EXPECT_TRUE(point_cloud.points[i].position.isApprox(
+        expected_point_cloud.points[i].position, kEps));
+    EXPECT_NEAR(point_cloud.points[i].time,
+                expected_point_cloud.points[i].time, kEps);
+  }
+}
+
 TEST(MsgConversion, LaserScanToPointCloudWithInfinityAndNaN) {
   sensor_msgs::LaserScan laser_scan;
   laser_scan.ranges.push_back(1.f);
@@ -109,6 +193,67 @@ TEST(MsgConversion, LaserScanToPointCloudWithInfinityAndNaN) {
             DoubleNear(expected.rotation_weight, kEps)));
 }
 
+TEST(MsgConversion, PointCloud2WithNanosecondTimeAndRowPadding) {
+  // Ouster-like layout, organized in 2 rows of 1 point each.
+  sensor_msgs::PointCloud2 msg;
+  msg.header.stamp = ros::Time(100.);
+  AddPointField("x", 0, sensor_msgs::PointField::FLOAT32, &msg);
+  AddPointField("y", 4, sensor_msgs::PointField::FLOAT32, &msg);
+  AddPointField("z", 8, sensor_msgs::PointField::FLOAT32, &msg);
+  AddPointField("intensity", 16, sensor_msgs::PointField::FLOAT32, &msg);
+  AddPointField("t", 20, sensor_msgs::PointField::UINT32, &msg);
+  AddPointField("ring", 24, sensor_msgs::PointField::UINT16, &msg);
+  msg.height = 2;
+  msg.width = 1;
+  msg.point_step = 32;
+  msg.row_step = 40;
+  msg.data.resize(msg.row_step * msg.height);
+  for (int i = 0; i < 2; ++i) {
+    const size_t point_offset = i * msg.row_step;
+    WritePointField(1.f + i, point_offset + 0, &msg);
+    WritePointField(2.f + i, point_offset + 4, &msg);
+    WritePointField(3.f + i, point_offset + 8, &msg);
+    WritePointField(10.f * (i + 1), point_offset + 16, &msg);
+    WritePointField(static_cast<uint32_t>(i * 100000000), point_offset + 20,
+                    &msg);
+  }
+
+  ::cartographer::sensor::PointCloudWithIntensities point_cloud;
+  ::cartographer::common::Time time;
+  std::tie(point_cloud, time) = ToPointCloudWithIntensities(msg);
+  ASSERT_EQ(point_cloud.points.size(), 2);
+  EXPECT_TRUE(point_cloud.points[1].position.isApprox(
+      Eigen::Vector3f(2.f, 3.f, 4.f), kEps));
+  EXPECT_NEAR(point_cloud.points[0].time, -0.1f, kEps);
+  EXPECT_NEAR(point_cloud.points[1].time, 0.f, kEps);
+  EXPECT_THAT(point_cloud.intensities, ElementsAre(10.f, 20.f));
+  EXPECT_NEAR(
+      ::cartographer::common::ToSeconds(time - FromRos(ros::Time(100.))), 0.1,
+      kEps);
+}
+
+TEST(MsgConversion, PointCloud2WithoutTimeAndIntensity) {
+  sensor_msgs::PointCloud2 msg;
+  AddPointField("x", 0, sensor_msgs::PointField::FLOAT32, &msg);
+  AddPointField("y", 4, sensor_msgs::PointField::FLOAT32, &msg);
+  AddPointField("z", 8, sensor_msgs::PointField::FLOAT32, &msg);
+  msg.height = 1;
+  msg.width = 3;
+  msg.point_step = 16;
+  msg.row_step = msg.point_step * msg.width;
+  msg.data.resize(msg.row_step);
+  for (int i = 0; i < 3; ++i) {
+    WritePointField(static_cast<float>(i), i * msg.point_step + 8, &msg);
+  }
+
+  const auto point_cloud = std::get<0>(ToPointCloudWithIntensities(msg));
+  ASSERT_EQ(point_cloud.points.size(), 3);
+  EXPECT_TRUE(point_cloud.points[2].position.isApprox(
+      Eigen::Vector3f(0.f, 0.f, 2.f), kEps));
+  EXPECT_EQ(point_cloud.points[2].time, 0.f);
+  EXPECT_THAT(point_cloud.intensities, ElementsAre(1.f, 1.f, 1.f));
+}
+
 TEST(MsgConversion, LandmarkListToLandmarkData) {
   cartographer_ros_msgs::LandmarkList message;
   message.header.stamp.fromSec(10);
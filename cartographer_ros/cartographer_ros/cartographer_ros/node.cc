@@ -17,6 +17,7 @@
 #include "cartographer_ros/node.h"
 
 #include <chrono>
+#include <fstream>
 #include <string>
 #include <vector>
 
@@ -27,12 +28,14 @@
 #include "cartographer/common/lua_parameter_dictionary.h"
 #include "cartographer/common/port.h"
 #include "cartographer/common/time.h"
+#include "cartographer/common/tracing.h"
 #include "cartographer/mapping/pose_graph_interface.h"
 #include "cartographer/mapping/proto/submap_visualization.pb.h"
 #include "cartographer/metrics/register.h"
 #include "cartographer/sensor/point_cloud.h"
 #include "cartographer/transform/rigid_transform.h"
 #include "cartographer/transform/transform.h"
+#include "cartographer_ros/cpu_profiler.h"
 #include "cartographer_ros/metrics/family_factory.h"
 #include "cartographer_ros/msg_conversion.h"
 #include "cartographer_ros/sensor_bridge.h"
@@ -48,6 +51,10 @@
 #include "tf2_eigen/tf2_eigen.h"
 #include "visualization_msgs/MarkerArray.h"
 
+#ifdef CARTOGRAPHER_ROS_HAS_DEPTH_FUSION
+#include "depthimage_to_laserscan/FusionMetrics.h"
+#endif
+
 namespace cartographer_ros {
 
 namespace carto = ::cartographer;
@@ -76,6 +83,20 @@ template <typename MessageType>
           }));
 }
 
+bool SubmapEntryChanged(const ::cartographer_ros_msgs::SubmapEntry& previous,
+                        const ::cartographer_ros_msgs::SubmapEntry& current) {
+  const geometry_msgs::Pose& a = previous.pose;
+  const geometry_msgs::Pose& b = current.pose;
+  return previous.submap_version != current.submap_version ||
+         previous.is_frozen != current.is_frozen ||
+         a.position.x != b.position.x || a.position.y != b.position.y ||
+         a.position.z != b.position.z ||
+         a.orientation.w != b.orientation.w ||
+         a.orientation.x != b.orientation.x ||
+         a.orientation.y != b.orientation.y ||
+         a.orientation.z != b.orientation.z;
+}
+
 std::string TrajectoryStateToString(const TrajectoryState trajectory_state) {
   switch (trajectory_state) {
     case TrajectoryState::ACTIVE:
@@ -92,16 +113,92 @@ std::string TrajectoryStateToString(const TrajectoryState trajectory_state) {
 
 }  // namespace
 
+std::set<cartographer::mapping::TrajectoryBuilderInterface::SensorId>
+ComputeExpectedSensorIds(const NodeOptions& node_options,
+                         const TrajectoryOptions& options) {
+  using SensorId = cartographer::mapping::TrajectoryBuilderInterface::SensorId;
+  using SensorType = SensorId::SensorType;
+  std::set<SensorId> expected_topics;
+  // Subscribe to all laser scan, multi echo laser scan, and point cloud topics.
+  for (const std::string& topic :
+       ComputeRepeatedTopicNames(kLaserScanTopic, options.num_laser_scans)) {
+    expected_topics.insert(SensorId{SensorType::RANGE, topic});
+  }
+  for (const std::string& topic : ComputeRepeatedTopicNames(
+           kMultiEchoLaserScanTopic, options.num_multi_echo_laser_scans)) {
+    expected_topics.insert(SensorId{SensorType::RANGE, topic});
+  }
+  for (const std::string& topic :
+       ComputeRepeatedTopicNames(kPointCloud2Topic, options.num_point_clouds)) {
+    expected_topics.insert(SensorId{SensorType::RANGE, topic});
+  }
+  // For 2D SLAM, subscribe to the IMU if we expect it. For 3D SLAM, the IMU is
+  // required.
+  if (node_options.map_builder_options.use_trajectory_builder_3d() ||
+      (node_options.map_builder_options.use_trajectory_builder_2d() &&
+       options.trajectory_builder_options.trajectory_builder_2d_options()
+           .use_imu_data())) {
+    expected_topics.insert(SensorId{SensorType::IMU, kImuTopic});
+  }
+  // Odometry is optional.
+  if (options.use_odometry) {
+    expected_topics.insert(SensorId{SensorType::ODOMETRY, kOdometryTopic});
+  }
+  // NavSatFix is optional.
+  if (options.use_nav_sat) {
+    expected_topics.insert(
+        SensorId{SensorType::FIXED_FRAME_POSE, kNavSatFixTopic});
+  }
+  // Landmark is optional.
+  if (options.use_landmarks) {
+    expected_topics.insert(SensorId{SensorType::LANDMARK, kLandmarkTopic});
+  }
+  return expected_topics;
+}
+
+std::vector<
+    std::set<cartographer::mapping::TrajectoryBuilderInterface::SensorId>>
+ComputeDefaultSensorIdsForMultipleBags(
+    const NodeOptions& node_options,
+    const std::vector<TrajectoryOptions>& bags_options) {
+  using SensorId = cartographer::mapping::TrajectoryBuilderInterface::SensorId;
+  std::vector<std::set<SensorId>> bags_sensor_ids;
+  for (size_t i = 0; i < bags_options.size(); ++i) {
+    std::string prefix;
+    if (bags_options.size() > 1) {
+      prefix = "bag_" + std::to_string(i + 1) + "_";
+    }
+    std::set<SensorId> unique_sensor_ids;
+    for (const auto& sensor_id : ComputeExpectedSensorIds(node_options,
+                                                         bags_options.at(i))) {
+      unique_sensor_ids.insert(SensorId{sensor_id.type, prefix + sensor_id.id});
+    }
+    bags_sensor_ids.push_back(unique_sensor_ids);
+  }
+  return bags_sensor_ids;
+}
+
 Node::Node(
     const NodeOptions& node_options,  //选项
     std::unique_ptr<cartographer::mapping::MapBuilderInterface> map_builder,  //地图匹配
     tf2_ros::Buffer* const tf_buffer, const bool collect_metrics)//函数后面的冒号表示一个实例的赋值
     : node_options_(node_options),
-      map_builder_bridge_(node_options_, std::move(map_builder), tf_buffer) {//构造函数的主体
+      map_builder_(map_builder.get()),
+      map_builder_bridge_(node_options_, std::move(map_builder), tf_buffer),
+      write_state_spinner_(1 /* thread_count */,
+                           &write_state_callback_queue_),
+      write_profile_spinner_(1 /* thread_count */,
+                             &write_profile_callback_queue_) {//构造函数的主体
   absl::MutexLock lock(&mutex_);//设置一个互斥锁；
   if (collect_metrics) {
     metrics_registry_ = absl::make_unique<metrics::FamilyFactory>();
     carto::metrics::RegisterAllMetrics(metrics_registry_.get());
+    LatencyBudget::RegisterMetrics(metrics_registry_.get());
+#ifdef CARTOGRAPHER_ROS_HAS_DEPTH_FUSION
+    // Exported with the SLAM metrics when the fusion runs in this process.
+    ::depthimage_to_laserscan::FusionMetrics::RegisterMetrics(
+        metrics_registry_.get());
+#endif
   }
 
 
@@ -113,6 +210,13 @@ Node::Node(
   submap_list_publisher_ =
       node_handle_.advertise<::cartographer_ros_msgs::SubmapList>(
           kSubmapListTopic, kLatestOnlyPublisherQueueSize);
+  // Updates are deltas, so none of them may be dropped.
+  submap_list_updates_publisher_ =
+      node_handle_.advertise<::cartographer_ros_msgs::SubmapListUpdate>(
+          kSubmapListUpdatesTopic, kInfinitePublisherQueueSize,
+          [this](const ::ros::SingleSubscriberPublisher& publisher) {
+            HandleSubmapListUpdatesSubscriber(publisher);
+          });
 
 //同样的，向kTrajectoryNodeListTopic这个Topic上发布了一个
 // ::visualization_msgs::MarkerArray型的message
@@ -145,6 +249,8 @@ Node::Node(
 // 可以提供查询submap_query服务
   service_servers_.push_back(node_handle_.advertiseService(
       kSubmapQueryServiceName, &Node::HandleSubmapQuery, this));
+  service_servers_.push_back(node_handle_.advertiseService(
+      kSubmapTexturesQueryServiceName, &Node::HandleSubmapTexturesQuery, this));
 
 // 同样的，注册Service名字为kStartTrajectoryServiceName，
 // 函数句柄为Node::HandleStartTrajectory
@@ -168,7 +274,14 @@ Node::Node(
 // 函数句柄为Node::HandleWriteState
 // 将当前状态写入磁盘文件中
   service_servers_.push_back(node_handle_.advertiseService(
-      kWriteStateServiceName, &Node::HandleWriteState, this));
+      ::ros::AdvertiseServiceOptions::create<cartographer_ros_msgs::WriteState>(
+          kWriteStateServiceName,
+          [this](cartographer_ros_msgs::WriteState::Request& request,
+                 cartographer_ros_msgs::WriteState::Response& response) {
+            return HandleWriteState(request, response);
+          },
+          ::ros::VoidConstPtr(), &write_state_callback_queue_)));
+  write_state_spinner_.start();
  
 // 同样的，注册Service名字为kGetTrajectoryStatesServiceName，
 // 函数句柄为Node::HandleGetTrajectoryStates
@@ -181,6 +294,16 @@ Node::Node(
 // 
   service_servers_.push_back(node_handle_.advertiseService(
       kReadMetricsServiceName, &Node::HandleReadMetrics, this));
+  service_servers_.push_back(node_handle_.advertiseService(
+      ::ros::AdvertiseServiceOptions::create<
+          cartographer_ros_msgs::WriteProfile>(
+          kWriteProfileServiceName,
+          [this](cartographer_ros_msgs::WriteProfile::Request& request,
+                 cartographer_ros_msgs::WriteProfile::Response& response) {
+            return HandleWriteProfile(request, response);
+          },
+          ::ros::VoidConstPtr(), &write_profile_callback_queue_)));
+  write_profile_spinner_.start();
 
 // 又发布了一个跟点云相关的Topic
   scan_matched_point_cloud_publisher_ =
@@ -226,6 +349,14 @@ bool Node::HandleSubmapQuery(
   return true;
 }
 
+bool Node::HandleSubmapTexturesQuery(
+    ::cartographer_ros_msgs::SubmapTexturesQuery::Request& request,
+    ::cartographer_ros_msgs::SubmapTexturesQuery::Response& response) {
+  absl::MutexLock lock(&mutex_);
+  map_builder_bridge_.HandleSubmapTexturesQuery(request, response);
+  return true;
+}
+
 bool Node::HandleTrajectoryQuery(
     ::cartographer_ros_msgs::TrajectoryQuery::Request& request,
     ::cartographer_ros_msgs::TrajectoryQuery::Response& response) {
@@ -245,7 +376,52 @@ bool Node::HandleTrajectoryQuery(
 
 void Node::PublishSubmapList(const ::ros::WallTimerEvent& unused_timer_event) {
   absl::MutexLock lock(&mutex_);
-  submap_list_publisher_.publish(map_builder_bridge_.GetSubmapList());
+  const ::cartographer_ros_msgs::SubmapList submap_list =
+      map_builder_bridge_.GetSubmapList();
+  submap_list_publisher_.publish(submap_list);
+
+  ::cartographer_ros_msgs::SubmapListUpdate update;
+  update.header = submap_list.header;
+  update.is_full_list = false;
+  std::map<carto::mapping::SubmapId, ::cartographer_ros_msgs::SubmapEntry>
+      submap_entries;
+  for (const auto& submap_entry : submap_list.submap) {
+    const carto::mapping::SubmapId id{submap_entry.trajectory_id,
+                                      submap_entry.submap_index};
+    const auto it = published_submap_entries_.find(id);
+    if (it == published_submap_entries_.end() ||
+        SubmapEntryChanged(it->second, submap_entry)) {
+      update.submap.push_back(submap_entry);
+    }
+    if (it != published_submap_entries_.end()) {
+      published_submap_entries_.erase(it);
+    }
+    submap_entries.emplace(id, submap_entry);
+  }
+  // Whatever is left was not part of the current submap list.
+  for (const auto& id_and_entry : published_submap_entries_) {
+    ::cartographer_ros_msgs::SubmapEntry removed_entry;
+    removed_entry.trajectory_id = id_and_entry.first.trajectory_id;
+    removed_entry.submap_index = id_and_entry.first.submap_index;
+    update.removed_submap.push_back(removed_entry);
+  }
+  published_submap_entries_ = std::move(submap_entries);
+  if (!update.submap.empty() || !update.removed_submap.empty()) {
+    submap_list_updates_publisher_.publish(update);
+  }
+}
+
+void Node::HandleSubmapListUpdatesSubscriber(
+    const ::ros::SingleSubscriberPublisher& publisher) {
+  absl::MutexLock lock(&mutex_);
+  ::cartographer_ros_msgs::SubmapListUpdate update;
+  update.header.stamp = ::ros::Time::now();
+  update.header.frame_id = node_options_.map_frame;
+  update.is_full_list = true;
+  for (const auto& id_and_entry : published_submap_entries_) {
+    update.submap.push_back(id_and_entry.second);
+  }
+  publisher.publish(update);
 }
 
 void Node::AddExtrapolator(const int trajectory_id,
@@ -277,59 +453,85 @@ void Node::AddSensorSamplers(const int trajectory_id,
 }
 
 void Node::PublishLocalTrajectoryData(const ::ros::TimerEvent& timer_event) {
-  absl::MutexLock lock(&mutex_);
-  for (const auto& entry : map_builder_bridge_.GetLocalTrajectoryData()) {
-    const auto& trajectory_data = entry.second;
-
-    auto& extrapolator = extrapolators_.at(entry.first);
-    // We only publish a point cloud if it has changed. It is not needed at high
-    // frequency, and republishing it would be computationally wasteful.
-    if (trajectory_data.local_slam_data->time !=
-        extrapolator.GetLastPoseTime()) {
-      if (scan_matched_point_cloud_publisher_.getNumSubscribers() > 0) {
-        // TODO(gaschler): Consider using other message without time
-        // information.
-        carto::sensor::TimedPointCloud point_cloud;
-        point_cloud.reserve(trajectory_data.local_slam_data->range_data_in_local
-                                .returns.size());
-        for (const cartographer::sensor::RangefinderPoint point :
-             trajectory_data.local_slam_data->range_data_in_local.returns) {
-          point_cloud.push_back(cartographer::sensor::ToTimedRangefinderPoint(
-              point, 0.f /* time */));
+  // Only new poses are added to the extrapolators under 'mutex_'. Poses are
+  // extrapolated from snapshots, and transforms, poses and point clouds are
+  // collected and published after releasing it.
+  struct ScanMatchedPointCloud {
+    std::shared_ptr<
+        const MapBuilderBridge::LocalTrajectoryData::LocalSlamData>
+        local_slam_data;
+    Rigid3d local_to_map;
+  };
+  struct PublishedTrajectoryData {
+    MapBuilderBridge::LocalTrajectoryData trajectory_data;
+    std::shared_ptr<const carto::mapping::PoseExtrapolationSnapshot>
+        extrapolation_snapshot;
+    ::cartographer::common::Time time;
+    ::ros::Time stamp;
+  };
+  std::vector<ScanMatchedPointCloud> scan_matched_point_clouds;
+  std::vector<PublishedTrajectoryData> published_trajectory_data;
+  const bool publish_scan_matched_point_clouds =
+      scan_matched_point_cloud_publisher_.getNumSubscribers() > 0;
+  {
+    absl::MutexLock lock(&mutex_);
+    for (auto& entry : map_builder_bridge_.GetLocalTrajectoryData()) {
+      auto& trajectory_data = entry.second;
+
+      auto& extrapolator = extrapolators_.at(entry.first);
+      // We only publish a point cloud if it has changed. It is not needed at
+      // high frequency, and republishing it would be computationally wasteful.
+      if (trajectory_data.local_slam_data->time !=
+          extrapolator.GetLastPoseTime()) {
+        int& num_scans_since_point_cloud =
+            num_scans_since_scan_matched_point_cloud_[entry.first];
+        ++num_scans_since_point_cloud;
+        if (publish_scan_matched_point_clouds &&
+            num_scans_since_point_cloud >=
+                node_options_.scan_matched_point_cloud_publish_decimation) {
+          num_scans_since_point_cloud = 0;
+          scan_matched_point_clouds.push_back(ScanMatchedPointCloud{
+              trajectory_data.local_slam_data, trajectory_data.local_to_map});
         }
-        scan_matched_point_cloud_publisher_.publish(ToPointCloud2Message(
-            carto::common::ToUniversal(trajectory_data.local_slam_data->time),
-            node_options_.map_frame,
-            carto::sensor::TransformTimedPointCloud(
-                point_cloud, trajectory_data.local_to_map.cast<float>())));
+        extrapolator.AddPose(trajectory_data.local_slam_data->time,
+                             trajectory_data.local_slam_data->local_pose);
       }
-      extrapolator.AddPose(trajectory_data.local_slam_data->time,
-                           trajectory_data.local_slam_data->local_pose);
+
+      // If we do not publish a new point cloud, we still allow time of the
+      // published poses to advance. If we already know newer sensor data, we
+      // use its time instead. Since tf knows how to interpolate, providing
+      // newer information is better.
+      auto extrapolation_snapshot = extrapolator.GetSnapshot();
+      const ::cartographer::common::Time now = std::max(
+          FromRos(ros::Time::now()), extrapolation_snapshot->time());
+      const ::ros::Time stamp =
+          node_options_.use_pose_extrapolator
+              ? ToRos(now)
+              : ToRos(trajectory_data.local_slam_data->time);
+
+      // Suppress publishing if we already published a transform at this time.
+      // Due to 2020-07 changes to geometry2, tf buffer will issue warnings for
+      // repeated transforms with the same timestamp.
+      if (last_published_tf_stamps_.count(entry.first) &&
+          last_published_tf_stamps_[entry.first] == stamp)
+        continue;
+      last_published_tf_stamps_[entry.first] = stamp;
+      published_trajectory_data.push_back(PublishedTrajectoryData{
+          std::move(trajectory_data), std::move(extrapolation_snapshot), now,
+          stamp});
     }
+  }
 
+  std::vector<geometry_msgs::TransformStamped> stamped_transforms;
+  std::vector<::geometry_msgs::PoseStamped> tracked_poses;
+  for (const PublishedTrajectoryData& published : published_trajectory_data) {
+    const auto& trajectory_data = published.trajectory_data;
     geometry_msgs::TransformStamped stamped_transform;
-    // If we do not publish a new point cloud, we still allow time of the
-    // published poses to advance. If we already know a newer pose, we use its
-    // time instead. Since tf knows how to interpolate, providing newer
-    // information is better.
-    const ::cartographer::common::Time now = std::max(
-        FromRos(ros::Time::now()), extrapolator.GetLastExtrapolatedTime());
-    stamped_transform.header.stamp =
-        node_options_.use_pose_extrapolator
-            ? ToRos(now)
-            : ToRos(trajectory_data.local_slam_data->time);
-
-    // Suppress publishing if we already published a transform at this time.
-    // Due to 2020-07 changes to geometry2, tf buffer will issue warnings for
-    // repeated transforms with the same timestamp.
-    if (last_published_tf_stamps_.count(entry.first) &&
-        last_published_tf_stamps_[entry.first] == stamped_transform.header.stamp)
-      continue;
-    last_published_tf_stamps_[entry.first] = stamped_transform.header.stamp;
+    stamped_transform.header.stamp = published.stamp;
 
     const Rigid3d tracking_to_local_3d =
         node_options_.use_pose_extrapolator
-            ? extrapolator.ExtrapolatePose(now)
+            ? published.extrapolation_snapshot->ExtrapolatePose(published.time)
             : trajectory_data.local_slam_data->local_pose;
     const Rigid3d tracking_to_local = [&] {
       if (trajectory_data.trajectory_options.publish_frame_projected_to_2d) {
@@ -342,11 +544,9 @@ void Node::PublishLocalTrajectoryData(const ::ros::TimerEvent& timer_event) {
     const Rigid3d tracking_to_map =
         trajectory_data.local_to_map * tracking_to_local;
 
-    if (trajectory_data.published_to_tracking != nullptr) {
+    if (trajectory_data.published_to_tracking.has_value()) {
       if (node_options_.publish_to_tf) {
         if (trajectory_data.trajectory_options.provide_odom_frame) {
-          std::vector<geometry_msgs::TransformStamped> stamped_transforms;
-
           stamped_transform.header.frame_id = node_options_.map_frame;
           stamped_transform.child_frame_id =
               trajectory_data.trajectory_options.odom_frame;
@@ -361,15 +561,13 @@ void Node::PublishLocalTrajectoryData(const ::ros::TimerEvent& timer_event) {
           stamped_transform.transform = ToGeometryMsgTransform(
               tracking_to_local * (*trajectory_data.published_to_tracking));
           stamped_transforms.push_back(stamped_transform);
-
-          tf_broadcaster_.sendTransform(stamped_transforms);
         } else {
           stamped_transform.header.frame_id = node_options_.map_frame;
           stamped_transform.child_frame_id =
               trajectory_data.trajectory_options.published_frame;
           stamped_transform.transform = ToGeometryMsgTransform(
               tracking_to_map * (*trajectory_data.published_to_tracking));
-          tf_broadcaster_.sendTransform(stamped_transform);
+          stamped_transforms.push_back(stamped_transform);
         }
       }
       if (node_options_.publish_tracked_pose) {
@@ -377,19 +575,56 @@ void Node::PublishLocalTrajectoryData(const ::ros::TimerEvent& timer_event) {
         pose_msg.header.frame_id = node_options_.map_frame;
         pose_msg.header.stamp = stamped_transform.header.stamp;
         pose_msg.pose = ToGeometryMsgPose(tracking_to_map);
-        tracked_pose_publisher_.publish(pose_msg);
+        tracked_poses.push_back(pose_msg);
       }
     }
   }
+
+  if (!stamped_transforms.empty()) {
+    tf_broadcaster_.sendTransform(stamped_transforms);
+  }
+  for (const auto& pose_msg : tracked_poses) {
+    tracked_pose_publisher_.publish(pose_msg);
+  }
+  for (const ScanMatchedPointCloud& scan_matched_point_cloud :
+       scan_matched_point_clouds) {
+    const auto& local_slam_data = *scan_matched_point_cloud.local_slam_data;
+    const carto::transform::Rigid3f local_to_map =
+        scan_matched_point_cloud.local_to_map.cast<float>();
+    // TODO(gaschler): Consider using other message without time information.
+    carto::sensor::TimedPointCloud point_cloud;
+    point_cloud.reserve(local_slam_data.range_data_in_local.returns.size());
+    for (const cartographer::sensor::RangefinderPoint& point :
+         local_slam_data.range_data_in_local.returns) {
+      point_cloud.push_back(cartographer::sensor::ToTimedRangefinderPoint(
+          local_to_map * point, 0.f /* time */));
+    }
+    scan_matched_point_cloud_publisher_.publish(ToPointCloud2Message(
+        carto::common::ToUniversal(local_slam_data.time),
+        node_options_.map_frame, point_cloud));
+  }
 }
 
 void Node::PublishTrajectoryNodeList(
     const ::ros::WallTimerEvent& unused_timer_event) {
-  if (trajectory_node_list_publisher_.getNumSubscribers() > 0) {
-    absl::MutexLock lock(&mutex_);
-    trajectory_node_list_publisher_.publish(
-        map_builder_bridge_.GetTrajectoryNodeList());
+  const uint32_t num_subscribers =
+      trajectory_node_list_publisher_.getNumSubscribers();
+  absl::MutexLock lock(&mutex_);
+  if (num_subscribers > 0) {
+    if (node_options_.publish_incremental_markers) {
+      // New subscribers have not seen the markers published before.
+      const visualization_msgs::MarkerArray update =
+          map_builder_bridge_.GetTrajectoryNodeListUpdate(
+              num_subscribers > num_trajectory_node_list_subscribers_);
+      if (!update.markers.empty()) {
+        trajectory_node_list_publisher_.publish(update);
+      }
+    } else {
+      trajectory_node_list_publisher_.publish(
+          map_builder_bridge_.GetTrajectoryNodeList());
+    }
   }
+  num_trajectory_node_list_subscribers_ = num_subscribers;
 }
 
 void Node::PublishLandmarkPosesList(
@@ -403,52 +638,28 @@ void Node::PublishLandmarkPosesList(
 
 void Node::PublishConstraintList(
     const ::ros::WallTimerEvent& unused_timer_event) {
-  if (constraint_list_publisher_.getNumSubscribers() > 0) {
-    absl::MutexLock lock(&mutex_);
-    constraint_list_publisher_.publish(map_builder_bridge_.GetConstraintList());
+  const uint32_t num_subscribers =
+      constraint_list_publisher_.getNumSubscribers();
+  absl::MutexLock lock(&mutex_);
+  if (num_subscribers > 0) {
+    if (node_options_.publish_incremental_markers) {
+      const visualization_msgs::MarkerArray update =
+          map_builder_bridge_.GetConstraintListUpdate(
+              num_subscribers > num_constraint_list_subscribers_);
+      if (!update.markers.empty()) {
+        constraint_list_publisher_.publish(update);
+      }
+    } else {
+      constraint_list_publisher_.publish(
+          map_builder_bridge_.GetConstraintList());
+    }
   }
+  num_constraint_list_subscribers_ = num_subscribers;
 }
 
 std::set<cartographer::mapping::TrajectoryBuilderInterface::SensorId>
 Node::ComputeExpectedSensorIds(const TrajectoryOptions& options) const {
-  using SensorId = cartographer::mapping::TrajectoryBuilderInterface::SensorId;
-  using SensorType = SensorId::SensorType;
-  std::set<SensorId> expected_topics;
-  // Subscribe to all laser scan, multi echo laser scan, and point cloud topics.
-  for (const std::string& topic :
-       ComputeRepeatedTopicNames(kLaserScanTopic, options.num_laser_scans)) {
-    expected_topics.insert(SensorId{SensorType::RANGE, topic});
-  }
-  for (const std::string& topic : ComputeRepeatedTopicNames(
-           kMultiEchoLaserScanTopic, options.num_multi_echo_laser_scans)) {
-    expected_topics.insert(SensorId{SensorType::RANGE, topic});
-  }
-  for (const std::string& topic :
-       ComputeRepeatedTopicNames(kPointCloud2Topic, options.num_point_clouds)) {
-    expected_topics.insert(SensorId{SensorType::RANGE, topic});
-  }
-  // For 2D SLAM, subscribe to the IMU if we expect it. For 3D SLAM, the IMU is
-  // required.
-  if (node_options_.map_builder_options.use_trajectory_builder_3d() ||
-      (node_options_.map_builder_options.use_trajectory_builder_2d() &&
-       options.trajectory_builder_options.trajectory_builder_2d_options()
-           .use_imu_data())) {
-    expected_topics.insert(SensorId{SensorType::IMU, kImuTopic});
-  }
-  // Odometry is optional.
-  if (options.use_odometry) {
-    expected_topics.insert(SensorId{SensorType::ODOMETRY, kOdometryTopic});
-  }
-  // NavSatFix is optional.
-  if (options.use_nav_sat) {
-    expected_topics.insert(
-        SensorId{SensorType::FIXED_FRAME_POSE, kNavSatFixTopic});
-  }
-  // Landmark is optional.
-  if (options.use_landmarks) {
-    expected_topics.insert(SensorId{SensorType::LANDMARK, kLandmarkTopic});
-  }
-  return expected_topics;
+  return ::cartographer_ros::ComputeExpectedSensorIds(node_options_, options);
 }
 
 int Node::AddTrajectory(const TrajectoryOptions& options) {
@@ -698,30 +909,18 @@ bool Node::HandleStartTrajectory(
   return true;
 }
 
-void Node::StartTrajectoryWithDefaultTopics(const TrajectoryOptions& options) {
+int Node::StartTrajectoryWithDefaultTopics(const TrajectoryOptions& options) {
   absl::MutexLock lock(&mutex_);
   CHECK(ValidateTrajectoryOptions(options));
-  AddTrajectory(options);
+  return AddTrajectory(options);
 }
 
 std::vector<
     std::set<cartographer::mapping::TrajectoryBuilderInterface::SensorId>>
 Node::ComputeDefaultSensorIdsForMultipleBags(
     const std::vector<TrajectoryOptions>& bags_options) const {
-  using SensorId = cartographer::mapping::TrajectoryBuilderInterface::SensorId;
-  std::vector<std::set<SensorId>> bags_sensor_ids;
-  for (size_t i = 0; i < bags_options.size(); ++i) {
-    std::string prefix;
-    if (bags_options.size() > 1) {
-      prefix = "bag_" + std::to_string(i + 1) + "_";
-    }
-    std::set<SensorId> unique_sensor_ids;
-    for (const auto& sensor_id : ComputeExpectedSensorIds(bags_options.at(i))) {
-      unique_sensor_ids.insert(SensorId{sensor_id.type, prefix + sensor_id.id});
-    }
-    bags_sensor_ids.push_back(unique_sensor_ids);
-  }
-  return bags_sensor_ids;
+  return ::cartographer_ros::ComputeDefaultSensorIdsForMultipleBags(
+      node_options_, bags_options);
 }
 
 int Node::AddOfflineTrajectory(
@@ -779,9 +978,17 @@ bool Node::HandleFinishTrajectory(
 bool Node::HandleWriteState(
     ::cartographer_ros_msgs::WriteState::Request& request,
     ::cartographer_ros_msgs::WriteState::Response& response) {
-  absl::MutexLock lock(&mutex_);
-  if (map_builder_bridge_.SerializeState(request.filename,
-                                         request.include_unfinished_submaps)) {
+  bool success;
+  if (request.include_unfinished_submaps) {
+    // Unfinished submaps are changed by the sensor data handlers.
+    absl::MutexLock lock(&mutex_);
+    success = map_builder_bridge_.SerializeState(
+        request.filename, true /* include_unfinished_submaps */);
+  } else {
+    success = map_builder_->SerializeStateToFile(
+        false /* include_unfinished_submaps */, request.filename);
+  }
+  if (success) {
     response.status.code = cartographer_ros_msgs::StatusCode::OK;
     response.status.message =
         absl::StrCat("State written to '", request.filename, "'.");
@@ -793,6 +1000,55 @@ bool Node::HandleWriteState(
   return true;
 }
 
+bool Node::HandleWriteProfile(
+    ::cartographer_ros_msgs::WriteProfile::Request& request,
+    ::cartographer_ros_msgs::WriteProfile::Response& response) {
+  constexpr double kMaxProfileDurationSec = 600.;
+  constexpr int kMaxNumProfileSamples = 100000;
+  const double duration_sec = request.duration.toSec();
+  if (duration_sec <= 0. || duration_sec > kMaxProfileDurationSec) {
+    response.status.code = cartographer_ros_msgs::StatusCode::INVALID_ARGUMENT;
+    response.status.message = absl::StrCat(
+        "The duration must be positive and at most ", kMaxProfileDurationSec,
+        " seconds.");
+    return true;
+  }
+  const int frequency_hz =
+      request.frequency_hz > 0 ? request.frequency_hz : 100;
+  std::unique_ptr<CpuProfile> profile =
+      CpuProfile::Start(frequency_hz, kMaxNumProfileSamples);
+  if (profile == nullptr) {
+    response.status.code = cartographer_ros_msgs::StatusCode::UNAVAILABLE;
+    response.status.message =
+        "A profile is already being taken or profiling is not supported.";
+    return true;
+  }
+  ::ros::WallDuration(duration_sec).sleep();
+  profile->Stop();
+
+  std::ofstream profile_file(request.filename);
+  profile->WriteCollapsedStacks(&profile_file);
+  const std::string trace_filename = request.filename + ".trace.json";
+  const std::vector<carto::common::tracing::Span> spans =
+      carto::common::tracing::GetSpans();
+  std::ofstream trace_file(trace_filename);
+  carto::common::tracing::WriteChromeTrace(spans, &trace_file);
+  profile_file.close();
+  trace_file.close();
+  if (!profile_file || !trace_file) {
+    response.status.code = cartographer_ros_msgs::StatusCode::INVALID_ARGUMENT;
+    response.status.message =
+        absl::StrCat("Failed to write '", request.filename, "'.");
+    return true;
+  }
+  response.status.code = cartographer_ros_msgs::StatusCode::OK;
+  response.status.message = absl::StrCat(
+      "Wrote ", profile->num_samples(), " samples (",
+      profile->num_dropped_samples(), " dropped) to '", request.filename,
+      "' and ", spans.size(), " tracing spans to '", trace_filename, "'.");
+  return true;
+}
+
 bool Node::HandleReadMetrics(
     ::cartographer_ros_msgs::ReadMetrics::Request& request,
     ::cartographer_ros_msgs::ReadMetrics::Response& response) {
@@ -901,10 +1157,35 @@ void Node::HandleImuMessage(const int trajectory_id,
 void Node::HandleLaserScanMessage(const int trajectory_id,
                                   const std::string& sensor_id,
                                   const sensor_msgs::LaserScan::ConstPtr& msg) {
+  HandleLaserScan(trajectory_id, sensor_id, msg, nullptr /* upstream */);
+}
+
+void Node::HandleStampedLaserScanMessage(
+    const int trajectory_id, const std::string& sensor_id,
+    const sensor_msgs::LaserScan::ConstPtr& msg,
+    const LatencyBudget::UpstreamStamps& upstream) {
+  HandleLaserScan(trajectory_id, sensor_id, msg, &upstream);
+}
+
+void Node::HandleLaserScan(const int trajectory_id,
+                           const std::string& sensor_id,
+                           const sensor_msgs::LaserScan::ConstPtr& msg,
+                           const LatencyBudget::UpstreamStamps* upstream) {
+  const carto::common::Time received = FromRos(::ros::Time::now());
   absl::MutexLock lock(&mutex_);
   if (!sensor_samplers_.at(trajectory_id).rangefinder_sampler.Pulse()) {
     return;
   }
+  LatencyBudget* const latency_budget = map_builder_bridge_.latency_budget();
+  if (latency_budget != nullptr && !msg->ranges.empty()) {
+    // Local SLAM reports the time of the last measurement of the range data.
+    latency_budget->AddScan(
+        trajectory_id,
+        FromRos(msg->header.stamp) +
+            carto::common::FromSeconds(msg->time_increment *
+                                       (msg->ranges.size() - 1)),
+        upstream, received);
+  }
   map_builder_bridge_.sensor_bridge(trajectory_id)
       ->HandleLaserScanMessage(sensor_id, msg);
 }
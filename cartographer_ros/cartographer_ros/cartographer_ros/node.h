@@ -28,6 +28,7 @@
 #include "cartographer/common/fixed_ratio_sampler.h"
 #include "cartographer/mapping/map_builder_interface.h"
 #include "cartographer/mapping/pose_extrapolator.h"
+#include "cartographer_ros/latency_budget.h"
 #include "cartographer_ros/map_builder_bridge.h"
 #include "cartographer_ros/metrics/family_factory.h"
 #include "cartographer_ros/node_constants.h"
@@ -40,9 +41,13 @@
 #include "cartographer_ros_msgs/StatusResponse.h"
 #include "cartographer_ros_msgs/SubmapEntry.h"
 #include "cartographer_ros_msgs/SubmapList.h"
+#include "cartographer_ros_msgs/SubmapListUpdate.h"
 #include "cartographer_ros_msgs/SubmapQuery.h"
+#include "cartographer_ros_msgs/SubmapTexturesQuery.h"
+#include "cartographer_ros_msgs/WriteProfile.h"
 #include "cartographer_ros_msgs/WriteState.h"
 #include "nav_msgs/Odometry.h"
+#include "ros/callback_queue.h"
 #include "ros/ros.h"
 #include "sensor_msgs/Imu.h"
 #include "sensor_msgs/LaserScan.h"
@@ -53,6 +58,21 @@
 
 namespace cartographer_ros {
 
+// Returns the set of SensorIds expected for a trajectory.
+// 'SensorId::id' is the expected ROS topic name.
+std::set<::cartographer::mapping::TrajectoryBuilderInterface::SensorId>
+ComputeExpectedSensorIds(const NodeOptions& node_options,
+                         const TrajectoryOptions& options);
+
+// Returns unique SensorIds for multiple input bag files based on
+// their TrajectoryOptions.
+// 'SensorId::id' is the expected ROS topic name.
+std::vector<
+    std::set<::cartographer::mapping::TrajectoryBuilderInterface::SensorId>>
+ComputeDefaultSensorIdsForMultipleBags(
+    const NodeOptions& node_options,
+    const std::vector<TrajectoryOptions>& bags_options);
+
 // Wires up ROS topics to SLAM.
 class Node {
  public:
@@ -73,8 +93,8 @@ class Node {
   // Runs final optimization. All trajectories have to be finished when calling.
   void RunFinalOptimization();
 
-  // Starts the first trajectory with the default topics.
-  void StartTrajectoryWithDefaultTopics(const TrajectoryOptions& options);
+  // Starts the first trajectory with the default topics. Returns its id.
+  int StartTrajectoryWithDefaultTopics(const TrajectoryOptions& options);
 
   // Returns unique SensorIds for multiple input bag files based on
   // their TrajectoryOptions.
@@ -103,6 +123,12 @@ class Node {
                         const sensor_msgs::Imu::ConstPtr& msg);
   void HandleLaserScanMessage(int trajectory_id, const std::string& sensor_id,
                               const sensor_msgs::LaserScan::ConstPtr& msg);
+  // Like HandleLaserScanMessage() for scans of an in-process stage, which
+  // passes the times of its stages for the latency budget.
+  void HandleStampedLaserScanMessage(
+      int trajectory_id, const std::string& sensor_id,
+      const sensor_msgs::LaserScan::ConstPtr& msg,
+      const LatencyBudget::UpstreamStamps& upstream);
   void HandleMultiEchoLaserScanMessage(
       int trajectory_id, const std::string& sensor_id,
       const sensor_msgs::MultiEchoLaserScan::ConstPtr& msg);
@@ -136,6 +162,9 @@ class Node {
   bool HandleSubmapQuery(
       cartographer_ros_msgs::SubmapQuery::Request& request,
       cartographer_ros_msgs::SubmapQuery::Response& response);
+  bool HandleSubmapTexturesQuery(
+      cartographer_ros_msgs::SubmapTexturesQuery::Request& request,
+      cartographer_ros_msgs::SubmapTexturesQuery::Response& response);
   bool HandleTrajectoryQuery(
       ::cartographer_ros_msgs::TrajectoryQuery::Request& request,
       ::cartographer_ros_msgs::TrajectoryQuery::Response& response);
@@ -145,14 +174,21 @@ class Node {
   bool HandleFinishTrajectory(
       cartographer_ros_msgs::FinishTrajectory::Request& request,
       cartographer_ros_msgs::FinishTrajectory::Response& response);
+  // Runs on 'write_state_spinner_', so that sensor data keeps being processed
+  // while the state is written.
   bool HandleWriteState(cartographer_ros_msgs::WriteState::Request& request,
-                        cartographer_ros_msgs::WriteState::Response& response);
+                        cartographer_ros_msgs::WriteState::Response& response)
+      LOCKS_EXCLUDED(mutex_);
   bool HandleGetTrajectoryStates(
       ::cartographer_ros_msgs::GetTrajectoryStates::Request& request,
       ::cartographer_ros_msgs::GetTrajectoryStates::Response& response);
   bool HandleReadMetrics(
       cartographer_ros_msgs::ReadMetrics::Request& request,
       cartographer_ros_msgs::ReadMetrics::Response& response);
+  // Runs on 'write_profile_spinner_', since it blocks while sampling.
+  bool HandleWriteProfile(
+      cartographer_ros_msgs::WriteProfile::Request& request,
+      cartographer_ros_msgs::WriteProfile::Response& response);
 
   // Returns the set of SensorIds expected for a trajectory.
   // 'SensorId::id' is the expected ROS topic name.
@@ -163,8 +199,17 @@ class Node {
   int AddTrajectory(const TrajectoryOptions& options);  //增加轨迹
   void LaunchSubscribers(const TrajectoryOptions& options, int trajectory_id);  
   void PublishSubmapList(const ::ros::WallTimerEvent& timer_event);
+  // Sends the full submap list to a new subscriber of the submap list updates
+  // so that it can apply the deltas that follow.
+  void HandleSubmapListUpdatesSubscriber(
+      const ::ros::SingleSubscriberPublisher& publisher);
   void AddExtrapolator(int trajectory_id, const TrajectoryOptions& options);
   void AddSensorSamplers(int trajectory_id, const TrajectoryOptions& options);
+  // 'upstream' may be nullptr if the times of earlier stages are unknown.
+  void HandleLaserScan(int trajectory_id, const std::string& sensor_id,
+                       const sensor_msgs::LaserScan::ConstPtr& msg,
+                       const LatencyBudget::UpstreamStamps* upstream)
+      LOCKS_EXCLUDED(mutex_);
   void PublishLocalTrajectoryData(const ::ros::TimerEvent& timer_event);
   void PublishTrajectoryNodeList(const ::ros::WallTimerEvent& timer_event);
   void PublishLandmarkPosesList(const ::ros::WallTimerEvent& timer_event);
@@ -188,10 +233,23 @@ class Node {
 
   absl::Mutex mutex_;
   std::unique_ptr<cartographer_ros::metrics::FamilyFactory> metrics_registry_;
+  // Owned by 'map_builder_bridge_'. Only used without holding 'mutex_' to
+  // serialize the state, which the map builder allows concurrently with
+  // adding sensor data.
+  ::cartographer::mapping::MapBuilderInterface* const map_builder_;
   MapBuilderBridge map_builder_bridge_ GUARDED_BY(mutex_);
+  // The submap entries as of the last published submap list update.
+  std::map<::cartographer::mapping::SubmapId,
+           ::cartographer_ros_msgs::SubmapEntry>
+      published_submap_entries_ GUARDED_BY(mutex_);
+  // Subscribers of the marker topics as of their last publication, to
+  // republish all markers to new subscribers in incremental mode.
+  uint32_t num_trajectory_node_list_subscribers_ GUARDED_BY(mutex_) = 0;
+  uint32_t num_constraint_list_subscribers_ GUARDED_BY(mutex_) = 0;
 
   ::ros::NodeHandle node_handle_;
   ::ros::Publisher submap_list_publisher_;
+  ::ros::Publisher submap_list_updates_publisher_;
   ::ros::Publisher trajectory_node_list_publisher_;
   ::ros::Publisher landmark_poses_list_publisher_;
   ::ros::Publisher constraint_list_publisher_;
@@ -222,6 +280,7 @@ class Node {
   // These are keyed with 'trajectory_id'.
   std::map<int, ::cartographer::mapping::PoseExtrapolator> extrapolators_;
   std::map<int, ::ros::Time> last_published_tf_stamps_;
+  std::map<int, int> num_scans_since_scan_matched_point_cloud_;
   std::unordered_map<int, TrajectorySensorSamplers> sensor_samplers_;
   // unordered_map存储订阅
   std::unordered_map<int, std::vector<Subscriber>> subscribers_;
@@ -237,6 +296,14 @@ class Node {
   // simulation time is standing still. This prevents overflowing the transform
   // listener buffer by publishing the same transforms over and over again.
   ::ros::Timer publish_local_trajectory_data_timer_;
+
+  // Serve the write state and write profile services on their own threads.
+  // Declared last, so that they are stopped before the members used by the
+  // services are destroyed.
+  ::ros::CallbackQueue write_state_callback_queue_;
+  ::ros::AsyncSpinner write_state_spinner_;
+  ::ros::CallbackQueue write_profile_callback_queue_;
+  ::ros::AsyncSpinner write_profile_spinner_;
 };
 
 }  // namespace cartographer_ros
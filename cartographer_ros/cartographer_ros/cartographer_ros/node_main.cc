@@ -16,7 +16,11 @@
 
 #include "absl/memory/memory.h"
 #include "cartographer/mapping/map_builder.h"
+#ifdef CARTOGRAPHER_ROS_HAS_DEPTH_FUSION
+#include "cartographer_ros/depth_fusion_host.h"
+#endif
 #include "cartographer_ros/node.h"
+#include "cartographer_ros/node_constants.h"
 #include "cartographer_ros/node_options.h"
 #include "cartographer_ros/ros_log_sink.h"
 #include "gflags/gflags.h"
@@ -43,6 +47,13 @@ DEFINE_bool(
 DEFINE_string(
     save_state_filename, "",
     "If non-empty, serialize state and write it to disk before shutting down.");
+#ifdef CARTOGRAPHER_ROS_HAS_DEPTH_FUSION
+DEFINE_bool(in_process_depth_fusion, false,
+            "Fuse the depth camera into the lidar scan inside this node and "
+            "feed the result to the default trajectory directly, instead of "
+            "subscribing to a fused scan topic. Do not run the "
+            "depthimage_to_laserscan node at the same time.");
+#endif
 
 namespace cartographer_ros {
 namespace {
@@ -82,14 +93,31 @@ void Run() {
     node.LoadState(FLAGS_load_state_filename, FLAGS_load_frozen_state);//加载数据包数据
   }
 
+#ifdef CARTOGRAPHER_ROS_HAS_DEPTH_FUSION
+  std::unique_ptr<DepthFusionHost> depth_fusion_host;
+#endif
   if (FLAGS_start_trajectory_with_default_topics) {
-    node.StartTrajectoryWithDefaultTopics(trajectory_options);
+    const int trajectory_id =
+        node.StartTrajectoryWithDefaultTopics(trajectory_options);
+#ifdef CARTOGRAPHER_ROS_HAS_DEPTH_FUSION
+    if (FLAGS_in_process_depth_fusion) {
+      depth_fusion_host = absl::make_unique<DepthFusionHost>(
+          &node, trajectory_id, kLaserScanTopic);
+    }
+#else
+    (void)trajectory_id;
+#endif
   }
     /**
      * ros::spin() 将会进入循环， 一直调用回调函数chatterCallback(),
      */
   ::ros::spin();//ROS消息回调处理函数;
 
+#ifdef CARTOGRAPHER_ROS_HAS_DEPTH_FUSION
+  // Stop feeding scans before the trajectories are finished.
+  depth_fusion_host.reset();
+#endif
+
   node.FinishAllTrajectories();
   node.RunFinalOptimization();
 
@@ -19,11 +19,147 @@
 #include <vector>
 
 #include "cartographer/common/configuration_file_resolver.h"
+#include "cartographer/common/options_cache.h"
 #include "cartographer/mapping/map_builder_interface.h"
+#include "gflags/gflags.h"
 #include "glog/logging.h"
+#include "google/protobuf/struct.pb.h"
+
+DEFINE_string(options_cache_directory, "",
+              "If non-empty, existing directory in which the options computed "
+              "from the configuration files are cached for later launches and "
+              "StartTrajectory calls.");
 
 namespace cartographer_ros {
 
+namespace {
+
+using ::google::protobuf::Struct;
+
+// The options which are not protos are cached as a 'Struct'.
+Struct ToStruct(const NodeOptions& options) {
+  Struct result;
+  auto& fields = *result.mutable_fields();
+  fields["map_frame"].set_string_value(options.map_frame);
+  fields["lookup_transform_timeout_sec"].set_number_value(
+      options.lookup_transform_timeout_sec);
+  fields["submap_publish_period_sec"].set_number_value(
+      options.submap_publish_period_sec);
+  fields["pose_publish_period_sec"].set_number_value(
+      options.pose_publish_period_sec);
+  fields["trajectory_publish_period_sec"].set_number_value(
+      options.trajectory_publish_period_sec);
+  fields["publish_to_tf"].set_bool_value(options.publish_to_tf);
+  fields["publish_tracked_pose"].set_bool_value(options.publish_tracked_pose);
+  fields["use_pose_extrapolator"].set_bool_value(
+      options.use_pose_extrapolator);
+  fields["scan_matched_point_cloud_publish_decimation"].set_number_value(
+      options.scan_matched_point_cloud_publish_decimation);
+  fields["publish_incremental_markers"].set_bool_value(
+      options.publish_incremental_markers);
+  fields["range_data_latency_budget_sec"].set_number_value(
+      options.range_data_latency_budget_sec);
+  return result;
+}
+
+void FromStruct(const Struct& proto, NodeOptions* options) {
+  const auto& fields = proto.fields();
+  options->map_frame = fields.at("map_frame").string_value();
+  options->lookup_transform_timeout_sec =
+      fields.at("lookup_transform_timeout_sec").number_value();
+  options->submap_publish_period_sec =
+      fields.at("submap_publish_period_sec").number_value();
+  options->pose_publish_period_sec =
+      fields.at("pose_publish_period_sec").number_value();
+  options->trajectory_publish_period_sec =
+      fields.at("trajectory_publish_period_sec").number_value();
+  options->publish_to_tf = fields.at("publish_to_tf").bool_value();
+  options->publish_tracked_pose =
+      fields.at("publish_tracked_pose").bool_value();
+  options->use_pose_extrapolator =
+      fields.at("use_pose_extrapolator").bool_value();
+  // Entries cached before this option existed do not contain it.
+  const auto decimation =
+      fields.find("scan_matched_point_cloud_publish_decimation");
+  if (decimation != fields.end()) {
+    options->scan_matched_point_cloud_publish_decimation =
+        static_cast<int>(decimation->second.number_value());
+  }
+  const auto incremental_markers = fields.find("publish_incremental_markers");
+  if (incremental_markers != fields.end()) {
+    options->publish_incremental_markers =
+        incremental_markers->second.bool_value();
+  }
+  const auto latency_budget = fields.find("range_data_latency_budget_sec");
+  if (latency_budget != fields.end()) {
+    options->range_data_latency_budget_sec =
+        latency_budget->second.number_value();
+  }
+}
+
+Struct ToStruct(const TrajectoryOptions& options) {
+  Struct result;
+  auto& fields = *result.mutable_fields();
+  fields["tracking_frame"].set_string_value(options.tracking_frame);
+  fields["published_frame"].set_string_value(options.published_frame);
+  fields["odom_frame"].set_string_value(options.odom_frame);
+  fields["provide_odom_frame"].set_bool_value(options.provide_odom_frame);
+  fields["use_odometry"].set_bool_value(options.use_odometry);
+  fields["use_nav_sat"].set_bool_value(options.use_nav_sat);
+  fields["use_landmarks"].set_bool_value(options.use_landmarks);
+  fields["publish_frame_projected_to_2d"].set_bool_value(
+      options.publish_frame_projected_to_2d);
+  fields["num_laser_scans"].set_number_value(options.num_laser_scans);
+  fields["num_multi_echo_laser_scans"].set_number_value(
+      options.num_multi_echo_laser_scans);
+  fields["num_subdivisions_per_laser_scan"].set_number_value(
+      options.num_subdivisions_per_laser_scan);
+  fields["num_point_clouds"].set_number_value(options.num_point_clouds);
+  fields["rangefinder_sampling_ratio"].set_number_value(
+      options.rangefinder_sampling_ratio);
+  fields["odometry_sampling_ratio"].set_number_value(
+      options.odometry_sampling_ratio);
+  fields["fixed_frame_pose_sampling_ratio"].set_number_value(
+      options.fixed_frame_pose_sampling_ratio);
+  fields["imu_sampling_ratio"].set_number_value(options.imu_sampling_ratio);
+  fields["landmarks_sampling_ratio"].set_number_value(
+      options.landmarks_sampling_ratio);
+  return result;
+}
+
+void FromStruct(const Struct& proto, TrajectoryOptions* options) {
+  const auto& fields = proto.fields();
+  options->tracking_frame = fields.at("tracking_frame").string_value();
+  options->published_frame = fields.at("published_frame").string_value();
+  options->odom_frame = fields.at("odom_frame").string_value();
+  options->provide_odom_frame = fields.at("provide_odom_frame").bool_value();
+  options->use_odometry = fields.at("use_odometry").bool_value();
+  options->use_nav_sat = fields.at("use_nav_sat").bool_value();
+  options->use_landmarks = fields.at("use_landmarks").bool_value();
+  options->publish_frame_projected_to_2d =
+      fields.at("publish_frame_projected_to_2d").bool_value();
+  options->num_laser_scans =
+      static_cast<int>(fields.at("num_laser_scans").number_value());
+  options->num_multi_echo_laser_scans =
+      static_cast<int>(fields.at("num_multi_echo_laser_scans").number_value());
+  options->num_subdivisions_per_laser_scan =
+      static_cast<int>(
+          fields.at("num_subdivisions_per_laser_scan").number_value());
+  options->num_point_clouds =
+      static_cast<int>(fields.at("num_point_clouds").number_value());
+  options->rangefinder_sampling_ratio =
+      fields.at("rangefinder_sampling_ratio").number_value();
+  options->odometry_sampling_ratio =
+      fields.at("odometry_sampling_ratio").number_value();
+  options->fixed_frame_pose_sampling_ratio =
+      fields.at("fixed_frame_pose_sampling_ratio").number_value();
+  options->imu_sampling_ratio = fields.at("imu_sampling_ratio").number_value();
+  options->landmarks_sampling_ratio =
+      fields.at("landmarks_sampling_ratio").number_value();
+}
+
+}  // namespace
+
 NodeOptions CreateNodeOptions(
     ::cartographer::common::LuaParameterDictionary* const
         lua_parameter_dictionary) {
@@ -52,6 +188,22 @@ NodeOptions CreateNodeOptions(
     options.use_pose_extrapolator =
         lua_parameter_dictionary->GetBool("use_pose_extrapolator");
   }
+  if (lua_parameter_dictionary->HasKey(
+          "scan_matched_point_cloud_publish_decimation")) {
+    options.scan_matched_point_cloud_publish_decimation =
+        lua_parameter_dictionary->GetInt(
+            "scan_matched_point_cloud_publish_decimation");
+    CHECK_GE(options.scan_matched_point_cloud_publish_decimation, 1);
+  }
+  if (lua_parameter_dictionary->HasKey("publish_incremental_markers")) {
+    options.publish_incremental_markers =
+        lua_parameter_dictionary->GetBool("publish_incremental_markers");
+  }
+  if (lua_parameter_dictionary->HasKey("range_data_latency_budget_sec")) {
+    options.range_data_latency_budget_sec =
+        lua_parameter_dictionary->GetDouble("range_data_latency_budget_sec");
+    CHECK_GE(options.range_data_latency_budget_sec, 0.);
+  }
   return options;
 }
 
@@ -61,6 +213,31 @@ std::tuple<NodeOptions, TrajectoryOptions> LoadOptions(
   auto file_resolver =
       absl::make_unique<cartographer::common::ConfigurationFileResolver>(
           std::vector<std::string>{configuration_directory});
+  if (!FLAGS_options_cache_directory.empty()) {
+    NodeOptions node_options;
+    TrajectoryOptions trajectory_options;
+    Struct node_options_fields;
+    Struct trajectory_options_fields;
+    const bool cached =
+        cartographer::common::OptionsCache(FLAGS_options_cache_directory)
+            .Load(configuration_basename, std::move(file_resolver),
+                  [&](cartographer::common::LuaParameterDictionary*
+                          lua_parameter_dictionary) {
+                    node_options = CreateNodeOptions(lua_parameter_dictionary);
+                    trajectory_options =
+                        CreateTrajectoryOptions(lua_parameter_dictionary);
+                    node_options_fields = ToStruct(node_options);
+                    trajectory_options_fields = ToStruct(trajectory_options);
+                  },
+                  {&node_options.map_builder_options, &node_options_fields,
+                   &trajectory_options.trajectory_builder_options,
+                   &trajectory_options_fields});
+    if (cached) {
+      FromStruct(node_options_fields, &node_options);
+      FromStruct(trajectory_options_fields, &trajectory_options);
+    }
+    return std::make_tuple(node_options, trajectory_options);
+  }
   const std::string code =
       file_resolver->GetFileContentOrDie(configuration_basename);
   cartographer::common::LuaParameterDictionary lua_parameter_dictionary(
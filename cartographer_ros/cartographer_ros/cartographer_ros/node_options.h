@@ -38,6 +38,15 @@ struct NodeOptions {
   bool publish_to_tf = true;
   bool publish_tracked_pose = false;
   bool use_pose_extrapolator = true;
+  // Only every n-th scan matched point cloud of a trajectory is published.
+  int scan_matched_point_cloud_publish_decimation = 1;
+  // If enabled, the trajectory node and constraint lists only contain the
+  // markers which changed since they were last published.
+  bool publish_incremental_markers = false;
+  // If positive, the latency of range data from its header stamp to the local
+  // SLAM pose update is broken down into stages and checked against this
+  // budget in seconds.
+  double range_data_latency_budget_sec = 0.;
 };
 
 NodeOptions CreateNodeOptions(
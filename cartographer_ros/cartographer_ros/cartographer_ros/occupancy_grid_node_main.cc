@@ -15,6 +15,9 @@
  */
 
 #include <cmath>
+#include <map>
+#include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -31,15 +34,18 @@
 #include "cartographer_ros/node_constants.h"
 #include "cartographer_ros/ros_log_sink.h"
 #include "cartographer_ros/submap.h"
-#include "cartographer_ros_msgs/SubmapList.h"
-#include "cartographer_ros_msgs/SubmapQuery.h"
+#include "cartographer_ros_msgs/SubmapListUpdate.h"
+#include "cartographer_ros_msgs/SubmapTexturesQuery.h"
 #include "gflags/gflags.h"
+#include "map_msgs/OccupancyGridUpdate.h"
 #include "nav_msgs/OccupancyGrid.h"
 #include "ros/ros.h"
 
 DEFINE_double(resolution, 0.05,
               "Resolution of a grid cell in the published occupancy grid.");
 DEFINE_double(publish_period_sec, 1.0, "OccupancyGrid publishing period.");
+DEFINE_int32(num_painting_threads, 4,
+             "Number of threads painting the submaps into the occupancy grid.");
 DEFINE_bool(include_frozen_submaps, true,
             "Include frozen submaps in the occupancy grid.");
 DEFINE_bool(include_unfrozen_submaps, true,
@@ -54,6 +60,10 @@ using ::cartographer::io::PaintSubmapSlicesResult;
 using ::cartographer::io::SubmapSlice;
 using ::cartographer::mapping::SubmapId;
 
+// Margin added around the map whenever the occupancy grid has to grow, so
+// that it is not resized and republished in full for every new submap.
+constexpr double kGridMarginMeters = 10.;
+
 class Node {
  public:
   explicit Node(double resolution, double publish_period_sec);
@@ -63,8 +73,16 @@ class Node {
   Node& operator=(const Node&) = delete;
 
  private:
-  void HandleSubmapList(const cartographer_ros_msgs::SubmapList::ConstPtr& msg);
+  void HandleSubmapListUpdate(
+      const cartographer_ros_msgs::SubmapListUpdate::ConstPtr& msg);
+  void HandleOccupancyGridSubscriber(
+      const ::ros::SingleSubscriberPublisher& publisher);
   void DrawAndPublish(const ::ros::WallTimerEvent& timer_event);
+  // Fetches the textures of submaps whose version changed in a single call.
+  void FetchSubmapTextures() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Marks the area covered by 'submap_slice' as needing a repaint.
+  void MarkDirty(const SubmapSlice& submap_slice)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   ::ros::NodeHandle node_handle_;
   const double resolution_;
@@ -73,7 +91,15 @@ class Node {
   ::ros::ServiceClient client_ GUARDED_BY(mutex_);
   ::ros::Subscriber submap_list_subscriber_ GUARDED_BY(mutex_);
   ::ros::Publisher occupancy_grid_publisher_ GUARDED_BY(mutex_);
+  ::ros::Publisher occupancy_grid_updates_publisher_ GUARDED_BY(mutex_);
   std::map<SubmapId, SubmapSlice> submap_slices_ GUARDED_BY(mutex_);
+  // Pixel boxes as returned by GetSubmapSliceBoundingBox(). 'map_box_' covers
+  // all submaps ever painted, 'dirty_box_' the area changed since the last
+  // publish and 'grid_box_' the area of 'occupancy_grid_'.
+  Eigen::AlignedBox2f map_box_ GUARDED_BY(mutex_);
+  Eigen::AlignedBox2f dirty_box_ GUARDED_BY(mutex_);
+  Eigen::AlignedBox2i grid_box_ GUARDED_BY(mutex_);
+  std::unique_ptr<nav_msgs::OccupancyGrid> occupancy_grid_ GUARDED_BY(mutex_);
   ::ros::WallTimer occupancy_grid_publisher_timer_;
   std::string last_frame_id_;
   ros::Time last_timestamp_;
@@ -81,65 +107,124 @@ class Node {
 
 Node::Node(const double resolution, const double publish_period_sec)
     : resolution_(resolution),
-      client_(node_handle_.serviceClient<::cartographer_ros_msgs::SubmapQuery>(
-          kSubmapQueryServiceName)),
+      client_(node_handle_
+                  .serviceClient<::cartographer_ros_msgs::SubmapTexturesQuery>(
+                      kSubmapTexturesQueryServiceName)),
       submap_list_subscriber_(node_handle_.subscribe(
-          kSubmapListTopic, kLatestOnlyPublisherQueueSize,
+          kSubmapListUpdatesTopic, kInfiniteSubscriberQueueSize,
           boost::function<void(
-              const cartographer_ros_msgs::SubmapList::ConstPtr&)>(
-              [this](const cartographer_ros_msgs::SubmapList::ConstPtr& msg) {
-                HandleSubmapList(msg);
-              }))),
+              const cartographer_ros_msgs::SubmapListUpdate::ConstPtr&)>(
+              [this](const cartographer_ros_msgs::SubmapListUpdate::ConstPtr&
+                         msg) { HandleSubmapListUpdate(msg); }))),
       occupancy_grid_publisher_(
           node_handle_.advertise<::nav_msgs::OccupancyGrid>(
               FLAGS_occupancy_grid_topic, kLatestOnlyPublisherQueueSize,
-              true /* latched */)),
+              [this](const ::ros::SingleSubscriberPublisher& publisher) {
+                HandleOccupancyGridSubscriber(publisher);
+              })),
+      occupancy_grid_updates_publisher_(
+          node_handle_.advertise<::map_msgs::OccupancyGridUpdate>(
+              FLAGS_occupancy_grid_topic + "_updates",
+              kInfinitePublisherQueueSize)),
       occupancy_grid_publisher_timer_(
           node_handle_.createWallTimer(::ros::WallDuration(publish_period_sec),
                                        &Node::DrawAndPublish, this)) {}
 
-void Node::HandleSubmapList(
-    const cartographer_ros_msgs::SubmapList::ConstPtr& msg) {
+void Node::HandleSubmapListUpdate(
+    const cartographer_ros_msgs::SubmapListUpdate::ConstPtr& msg) {
   absl::MutexLock locker(&mutex_);
 
-  // We do not do any work if nobody listens.
-  if (occupancy_grid_publisher_.getNumSubscribers() == 0) {
-    return;
-  }
-
-  // Keep track of submap IDs that don't appear in the message anymore.
+  // Only metadata is tracked here, textures are fetched when drawing. Updates
+  // are deltas, so they have to be applied even if nobody listens.
   std::set<SubmapId> submap_ids_to_delete;
-  for (const auto& pair : submap_slices_) {
-    submap_ids_to_delete.insert(pair.first);
+  if (msg->is_full_list) {
+    for (const auto& pair : submap_slices_) {
+      submap_ids_to_delete.insert(pair.first);
+    }
+  }
+  for (const auto& submap_msg : msg->removed_submap) {
+    submap_ids_to_delete.insert(
+        SubmapId{submap_msg.trajectory_id, submap_msg.submap_index});
   }
 
   for (const auto& submap_msg : msg->submap) {
     const SubmapId id{submap_msg.trajectory_id, submap_msg.submap_index};
-    submap_ids_to_delete.erase(id);
     if ((submap_msg.is_frozen && !FLAGS_include_frozen_submaps) ||
         (!submap_msg.is_frozen && !FLAGS_include_unfrozen_submaps)) {
+      submap_ids_to_delete.insert(id);
       continue;
     }
+    submap_ids_to_delete.erase(id);
     SubmapSlice& submap_slice = submap_slices_[id];
-    submap_slice.pose = ToRigid3d(submap_msg.pose);
-    submap_slice.metadata_version = submap_msg.submap_version;
+    const ::cartographer::transform::Rigid3d pose = ToRigid3d(submap_msg.pose);
     if (submap_slice.surface != nullptr &&
-        submap_slice.version == submap_msg.submap_version) {
+        (pose.translation() != submap_slice.pose.translation() ||
+         pose.rotation().coeffs() != submap_slice.pose.rotation().coeffs())) {
+      MarkDirty(submap_slice);
+      submap_slice.pose = pose;
+      MarkDirty(submap_slice);
+    }
+    submap_slice.pose = pose;
+    submap_slice.metadata_version = submap_msg.submap_version;
+  }
+
+  for (const auto& id : submap_ids_to_delete) {
+    const auto it = submap_slices_.find(id);
+    if (it == submap_slices_.end()) {
       continue;
     }
+    if (it->second.surface != nullptr) {
+      MarkDirty(it->second);
+    }
+    submap_slices_.erase(it);
+  }
+
+  last_timestamp_ = msg->header.stamp;
+  last_frame_id_ = msg->header.frame_id;
+}
 
-    auto fetched_textures =
-        ::cartographer_ros::FetchSubmapTextures(id, &client_);
-    if (fetched_textures == nullptr) {
+void Node::HandleOccupancyGridSubscriber(
+    const ::ros::SingleSubscriberPublisher& publisher) {
+  absl::MutexLock locker(&mutex_);
+  if (occupancy_grid_ != nullptr) {
+    publisher.publish(*occupancy_grid_);
+  }
+}
+
+void Node::FetchSubmapTextures() {
+  std::map<SubmapId, int> known_submap_versions;
+  for (const auto& pair : submap_slices_) {
+    const SubmapSlice& submap_slice = pair.second;
+    if (submap_slice.surface != nullptr &&
+        submap_slice.version == submap_slice.metadata_version) {
       continue;
     }
-    CHECK(!fetched_textures->textures.empty());
-    submap_slice.version = fetched_textures->version;
+    known_submap_versions[pair.first] =
+        submap_slice.surface != nullptr ? submap_slice.version : -1;
+  }
+  if (known_submap_versions.empty()) {
+    return;
+  }
+
+  std::map<SubmapId, std::unique_ptr<::cartographer::io::SubmapTextures>>
+      fetched_submap_textures;
+  if (!::cartographer_ros::FetchSubmapTextures(
+          known_submap_versions, &client_, &fetched_submap_textures)) {
+    return;
+  }
+  for (const auto& pair : fetched_submap_textures) {
+    SubmapSlice& submap_slice = submap_slices_.at(pair.first);
+    const ::cartographer::io::SubmapTextures& fetched_textures = *pair.second;
+    CHECK(!fetched_textures.textures.empty());
+    if (submap_slice.surface != nullptr) {
+      MarkDirty(submap_slice);
+    }
+    submap_slice.version = fetched_textures.version;
 
     // We use the first texture only. By convention this is the highest
     // resolution texture and that is the one we want to use to construct the
     // map for ROS.
-    const auto fetched_texture = fetched_textures->textures.begin();
+    const auto fetched_texture = fetched_textures.textures.begin();
     submap_slice.width = fetched_texture->width;
     submap_slice.height = fetched_texture->height;
     submap_slice.slice_pose = fetched_texture->slice_pose;
@@ -149,26 +234,65 @@ void Node::HandleSubmapList(
         fetched_texture->pixels.intensity, fetched_texture->pixels.alpha,
         fetched_texture->width, fetched_texture->height,
         &submap_slice.cairo_data);
+    MarkDirty(submap_slice);
   }
+}
 
-  // Delete all submaps that didn't appear in the message.
-  for (const auto& id : submap_ids_to_delete) {
-    submap_slices_.erase(id);
-  }
-
-  last_timestamp_ = msg->header.stamp;
-  last_frame_id_ = msg->header.frame_id;
+void Node::MarkDirty(const SubmapSlice& submap_slice) {
+  const Eigen::AlignedBox2f box =
+      ::cartographer::io::GetSubmapSliceBoundingBox(submap_slice, resolution_);
+  dirty_box_.extend(box);
+  map_box_.extend(box);
 }
 
 void Node::DrawAndPublish(const ::ros::WallTimerEvent& unused_timer_event) {
   absl::MutexLock locker(&mutex_);
-  if (submap_slices_.empty() || last_frame_id_.empty()) {
+  // We do not do any work if nobody listens.
+  if (last_frame_id_.empty() ||
+      (occupancy_grid_publisher_.getNumSubscribers() == 0 &&
+       occupancy_grid_updates_publisher_.getNumSubscribers() == 0)) {
+    return;
+  }
+  FetchSubmapTextures();
+  if (dirty_box_.isEmpty()) {
+    return;
+  }
+
+  const Eigen::AlignedBox2i dirty_box(
+      Eigen::Vector2i(std::floor(dirty_box_.min().x()),
+                      std::floor(dirty_box_.min().y())),
+      Eigen::Vector2i(std::ceil(dirty_box_.max().x()),
+                      std::ceil(dirty_box_.max().y())));
+  dirty_box_.setEmpty();
+  const Eigen::AlignedBox2i map_box(
+      Eigen::Vector2i(std::floor(map_box_.min().x()),
+                      std::floor(map_box_.min().y())),
+      Eigen::Vector2i(std::ceil(map_box_.max().x()),
+                      std::ceil(map_box_.max().y())));
+
+  if (occupancy_grid_ == nullptr || !grid_box_.contains(map_box)) {
+    // The map outgrew the grid, so it is repainted and published in full.
+    const int margin = std::ceil(kGridMarginMeters / resolution_);
+    grid_box_ = map_box;
+    grid_box_.min().array() -= margin;
+    grid_box_.max().array() += margin;
+    const PaintSubmapSlicesResult painted_slices =
+        ::cartographer::io::PaintSubmapSlicesInBox(
+            submap_slices_, resolution_, grid_box_, FLAGS_num_painting_threads);
+    occupancy_grid_ = CreateOccupancyGridMsg(painted_slices, resolution_,
+                                             last_frame_id_, last_timestamp_);
+    occupancy_grid_publisher_.publish(*occupancy_grid_);
     return;
   }
-  auto painted_slices = PaintSubmapSlices(submap_slices_, resolution_);
-  std::unique_ptr<nav_msgs::OccupancyGrid> msg_ptr = CreateOccupancyGridMsg(
-      painted_slices, resolution_, last_frame_id_, last_timestamp_);
-  occupancy_grid_publisher_.publish(*msg_ptr);
+
+  const PaintSubmapSlicesResult painted_slices =
+      ::cartographer::io::PaintSubmapSlicesInBox(
+          submap_slices_, resolution_, dirty_box.intersection(grid_box_),
+          FLAGS_num_painting_threads);
+  occupancy_grid_->header.stamp = last_timestamp_;
+  occupancy_grid_->header.frame_id = last_frame_id_;
+  occupancy_grid_updates_publisher_.publish(
+      UpdateOccupancyGrid(painted_slices, occupancy_grid_.get()));
 }
 
 }  // namespace
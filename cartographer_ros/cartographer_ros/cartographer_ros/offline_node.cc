@@ -24,10 +24,16 @@
 #include <time.h>
 
 #include <chrono>
+#include <functional>
 
+#include "absl/memory/memory.h"
 #include "absl/strings/str_split.h"
+#include "cartographer/common/fixed_ratio_sampler.h"
+#include "cartographer/io/proto_stream.h"
+#include "cartographer/io/sensor_log.h"
 #include "cartographer_ros/node.h"
 #include "cartographer_ros/playable_bag.h"
+#include "cartographer_ros/sensor_bridge.h"
 #include "cartographer_ros/urdf_reader.h"
 #include "gflags/gflags.h"
 #include "ros/callback_queue.h"
@@ -74,9 +80,23 @@ DEFINE_bool(keep_running, false,
 DEFINE_double(skip_seconds, 0,
               "Optional amount of seconds to skip from the beginning "
               "(i.e. when the earliest bag starts.). ");
+DEFINE_bool(headless, false,
+            "Feed the bags straight into the map builder without publishing "
+            "anything, neither tf, /clock, submaps nor visualization. Sensor "
+            "frames must be connected to the tracking frame by static "
+            "transforms from the URDF files or, if -use_bag_transforms is set, "
+            "from /tf_static in the bags; other transforms are not used.");
+DEFINE_string(sensor_log_prefix, "",
+              "Only with -headless: if non-empty, the sensor data of each "
+              "trajectory is also recorded, after conversion, as it is added "
+              "to the map builder. It is written to "
+              "'<prefix><trajectory_id>.sensorlog' which can be replayed "
+              "without ROS, e.g. by 'cartographer_map_builder_benchmark'.");
 
 namespace cartographer_ros {
 
+using SensorId = ::cartographer::mapping::TrajectoryBuilderInterface::SensorId;
+
 constexpr char kClockTopic[] = "clock";
 constexpr char kTfStaticTopic[] = "/tf_static";
 constexpr char kTfTopic[] = "tf";
@@ -87,121 +107,239 @@ constexpr int kSingleThreaded = 1;
 // always interpolate.
 const ::ros::Duration kDelay = ::ros::Duration(1.0);
 
-void RunOfflineNode(const MapBuilderFactory& map_builder_factory) {
-  CHECK(!FLAGS_configuration_directory.empty())
-      << "-configuration_directory is missing.";
-  CHECK(!FLAGS_configuration_basenames.empty())
-      << "-configuration_basenames is missing.";
-  CHECK(!(FLAGS_bag_filenames.empty() && FLAGS_load_state_filename.empty()))
-      << "-bag_filenames and -load_state_filename cannot both be unspecified.";
-  const std::vector<std::string> bag_filenames =
-      absl::StrSplit(FLAGS_bag_filenames, ',', absl::SkipEmpty());
-  cartographer_ros::NodeOptions node_options;
-  const std::vector<std::string> configuration_basenames =
-      absl::StrSplit(FLAGS_configuration_basenames, ',', absl::SkipEmpty());
-  std::vector<TrajectoryOptions> bag_trajectory_options(1);
-  std::tie(node_options, bag_trajectory_options.at(0)) =
-      LoadOptions(FLAGS_configuration_directory, configuration_basenames.at(0));
-
-  for (size_t bag_index = 1; bag_index < bag_filenames.size(); ++bag_index) {
-    TrajectoryOptions current_trajectory_options;
-    if (bag_index < configuration_basenames.size()) {
-      std::tie(std::ignore, current_trajectory_options) = LoadOptions(
-          FLAGS_configuration_directory, configuration_basenames.at(bag_index));
-    } else {
-      current_trajectory_options = bag_trajectory_options.at(0);
-    }
-    bag_trajectory_options.push_back(current_trajectory_options);
-  }
-  if (bag_filenames.size() > 0) {
-    CHECK_EQ(bag_trajectory_options.size(), bag_filenames.size());
+namespace {
+
+// Adds sensor data straight to the map builder. Contrary to 'Node', there are
+// no publishers, services or timers, and there is no tf2_ros::Buffer: sensor
+// data is transformed into the tracking frame using the static transforms
+// known when its trajectory is added.
+class HeadlessNode {
+ public:
+  // If 'sensor_log_prefix' is non-empty, the sensor data of each trajectory is
+  // recorded to '<sensor_log_prefix><trajectory_id>.sensorlog'.
+  HeadlessNode(
+      std::unique_ptr<::cartographer::mapping::MapBuilderInterface> map_builder,
+      std::vector<geometry_msgs::TransformStamped> static_transforms,
+      const std::string& sensor_log_prefix)
+      : map_builder_(std::move(map_builder)),
+        static_transforms_(std::move(static_transforms)),
+        sensor_log_prefix_(sensor_log_prefix) {}
+
+  HeadlessNode(const HeadlessNode&) = delete;
+  HeadlessNode& operator=(const HeadlessNode&) = delete;
+
+  void AddStaticTransforms(
+      const std::vector<geometry_msgs::TransformStamped>& transforms) {
+    static_transforms_.insert(static_transforms_.end(), transforms.begin(),
+                              transforms.end());
   }
 
-  // Since we preload the transform buffer, we should never have to wait for a
-  // transform. When we finish processing the bag, we will simply drop any
-  // remaining sensor data that cannot be transformed due to missing transforms.
-  node_options.lookup_transform_timeout_sec = 0.;
-
-  auto map_builder = map_builder_factory(node_options.map_builder_options);
+  void LoadState(const std::string& state_filename,
+                 const bool load_frozen_state) {
+    LOG(INFO) << "Loading saved state '" << state_filename << "'...";
+    ::cartographer::io::ProtoStreamReader stream(state_filename);
+    map_builder_->LoadState(&stream, load_frozen_state);
+  }
 
-  const std::chrono::time_point<std::chrono::steady_clock> start_time =
-      std::chrono::steady_clock::now();
+  int AddOfflineTrajectory(const std::set<SensorId>& expected_sensor_ids,
+                           const TrajectoryOptions& options) {
+    const int trajectory_id = map_builder_->AddTrajectoryBuilder(
+        expected_sensor_ids, options.trajectory_builder_options,
+        nullptr /* local_slam_result_callback */);
+    LOG(INFO) << "Added trajectory with ID '" << trajectory_id << "'.";
+    ::cartographer::mapping::TrajectoryBuilderInterface* trajectory_builder =
+        map_builder_->GetTrajectoryBuilder(trajectory_id);
+    if (!sensor_log_prefix_.empty()) {
+      const std::string filename =
+          absl::StrCat(sensor_log_prefix_, trajectory_id, ".sensorlog");
+      LOG(INFO) << "Recording sensor log '" << filename << "'.";
+      auto sensor_log = absl::make_unique<SensorLog>(
+          filename,
+          map_builder_->GetAllTrajectoryBuilderOptions().at(trajectory_id),
+          trajectory_builder);
+      trajectory_builder = &sensor_log->recording_trajectory_builder;
+      CHECK(sensor_logs_.emplace(trajectory_id, std::move(sensor_log)).second);
+    }
+    CHECK(trajectories_
+              .emplace(std::piecewise_construct,
+                       std::forward_as_tuple(trajectory_id),
+                       std::forward_as_tuple(
+                           options,
+                           ResolveStaticTransforms(static_transforms_,
+                                                   options.tracking_frame),
+                           trajectory_builder))
+              .second);
+    return trajectory_id;
+  }
 
-  tf2_ros::Buffer tf_buffer;
+  void HandleOdometryMessage(const int trajectory_id,
+                             const std::string& sensor_id,
+                             const nav_msgs::Odometry::ConstPtr& msg) {
+    Trajectory& trajectory = trajectories_.at(trajectory_id);
+    if (trajectory.odometry_sampler.Pulse()) {
+      trajectory.sensor_bridge.HandleOdometryMessage(sensor_id, msg);
+    }
+  }
 
-  std::vector<geometry_msgs::TransformStamped> urdf_transforms;
-  const std::vector<std::string> urdf_filenames =
-      absl::StrSplit(FLAGS_urdf_filenames, ',', absl::SkipEmpty());
-  for (const auto& urdf_filename : urdf_filenames) {
-    const auto current_urdf_transforms =
-        ReadStaticTransformsFromUrdf(urdf_filename, &tf_buffer);
-    urdf_transforms.insert(urdf_transforms.end(),
-                           current_urdf_transforms.begin(),
-                           current_urdf_transforms.end());
+  void HandleNavSatFixMessage(const int trajectory_id,
+                              const std::string& sensor_id,
+                              const sensor_msgs::NavSatFix::ConstPtr& msg) {
+    Trajectory& trajectory = trajectories_.at(trajectory_id);
+    if (trajectory.fixed_frame_pose_sampler.Pulse()) {
+      trajectory.sensor_bridge.HandleNavSatFixMessage(sensor_id, msg);
+    }
   }
 
-  tf_buffer.setUsingDedicatedThread(true);
+  void HandleLandmarkMessage(
+      const int trajectory_id, const std::string& sensor_id,
+      const cartographer_ros_msgs::LandmarkList::ConstPtr& msg) {
+    Trajectory& trajectory = trajectories_.at(trajectory_id);
+    if (trajectory.landmark_sampler.Pulse()) {
+      trajectory.sensor_bridge.HandleLandmarkMessage(sensor_id, msg);
+    }
+  }
 
-  Node node(node_options, std::move(map_builder), &tf_buffer,
-            FLAGS_collect_metrics);
-  if (!FLAGS_load_state_filename.empty()) {
-    node.LoadState(FLAGS_load_state_filename, FLAGS_load_frozen_state);
+  void HandleImuMessage(const int trajectory_id, const std::string& sensor_id,
+                        const sensor_msgs::Imu::ConstPtr& msg) {
+    Trajectory& trajectory = trajectories_.at(trajectory_id);
+    if (trajectory.imu_sampler.Pulse()) {
+      trajectory.sensor_bridge.HandleImuMessage(sensor_id, msg);
+    }
   }
 
-  ::ros::Publisher tf_publisher =
-      node.node_handle()->advertise<tf2_msgs::TFMessage>(
-          kTfTopic, kLatestOnlyPublisherQueueSize);
+  void HandleLaserScanMessage(const int trajectory_id,
+                              const std::string& sensor_id,
+                              const sensor_msgs::LaserScan::ConstPtr& msg) {
+    Trajectory& trajectory = trajectories_.at(trajectory_id);
+    if (trajectory.rangefinder_sampler.Pulse()) {
+      trajectory.sensor_bridge.HandleLaserScanMessage(sensor_id, msg);
+    }
+  }
 
-  ::tf2_ros::StaticTransformBroadcaster static_tf_broadcaster;
+  void HandleMultiEchoLaserScanMessage(
+      const int trajectory_id, const std::string& sensor_id,
+      const sensor_msgs::MultiEchoLaserScan::ConstPtr& msg) {
+    Trajectory& trajectory = trajectories_.at(trajectory_id);
+    if (trajectory.rangefinder_sampler.Pulse()) {
+      trajectory.sensor_bridge.HandleMultiEchoLaserScanMessage(sensor_id, msg);
+    }
+  }
 
-  ::ros::Publisher clock_publisher =
-      node.node_handle()->advertise<rosgraph_msgs::Clock>(
-          kClockTopic, kLatestOnlyPublisherQueueSize);
+  void HandlePointCloud2Message(const int trajectory_id,
+                                const std::string& sensor_id,
+                                const sensor_msgs::PointCloud2::ConstPtr& msg) {
+    Trajectory& trajectory = trajectories_.at(trajectory_id);
+    if (trajectory.rangefinder_sampler.Pulse()) {
+      trajectory.sensor_bridge.HandlePointCloud2Message(sensor_id, msg);
+    }
+  }
 
-  if (urdf_transforms.size() > 0) {
-    static_tf_broadcaster.sendTransform(urdf_transforms);
+  bool FinishTrajectory(const int trajectory_id) {
+    LOG(INFO) << "Finishing trajectory with ID '" << trajectory_id << "'...";
+    CHECK_EQ(trajectories_.erase(trajectory_id), 1);
+    map_builder_->FinishTrajectory(trajectory_id);
+    const auto it = sensor_logs_.find(trajectory_id);
+    if (it != sensor_logs_.end()) {
+      CHECK(it->second->writer.Close())
+          << "Could not write the sensor log of trajectory " << trajectory_id
+          << ".";
+      sensor_logs_.erase(it);
+    }
+    return true;
   }
 
-  ros::AsyncSpinner async_spinner(kSingleThreaded);
-  async_spinner.start();
-  rosgraph_msgs::Clock clock;
-  auto clock_republish_timer = node.node_handle()->createWallTimer(
-      ::ros::WallDuration(kClockPublishFrequencySec),
-      [&clock_publisher, &clock](const ::ros::WallTimerEvent&) {
-        clock_publisher.publish(clock);
-      },
-      false /* oneshot */, false /* autostart */);
+  void RunFinalOptimization() {
+    while (!trajectories_.empty()) {
+      FinishTrajectory(trajectories_.begin()->first);
+    }
+    LOG(INFO) << "Running final trajectory optimization...";
+    map_builder_->pose_graph()->RunFinalOptimization();
+  }
 
-  std::vector<
-      std::set<cartographer::mapping::TrajectoryBuilderInterface::SensorId>>
-      bag_expected_sensor_ids;
-  if (configuration_basenames.size() == 1) {
-    const auto current_bag_expected_sensor_ids =
-        node.ComputeDefaultSensorIdsForMultipleBags(
-            {bag_trajectory_options.front()});
-    bag_expected_sensor_ids = {bag_filenames.size(),
-                               current_bag_expected_sensor_ids.front()};
-  } else {
-    bag_expected_sensor_ids =
-        node.ComputeDefaultSensorIdsForMultipleBags(bag_trajectory_options);
+  void SerializeState(const std::string& filename,
+                      const bool include_unfinished_submaps) {
+    CHECK(map_builder_->SerializeStateToFile(include_unfinished_submaps,
+                                             filename))
+        << "Could not write state.";
   }
-  CHECK_EQ(bag_expected_sensor_ids.size(), bag_filenames.size());
 
-  std::map<std::pair<int /* bag_index */, std::string>,
-           cartographer::mapping::TrajectoryBuilderInterface::SensorId>
+ private:
+  struct Trajectory {
+    Trajectory(const TrajectoryOptions& options,
+               std::map<std::string, ::cartographer::transform::Rigid3d>
+                   static_frame_id_to_tracking,
+               ::cartographer::mapping::TrajectoryBuilderInterface* const
+                   trajectory_builder)
+        : sensor_bridge(options.num_subdivisions_per_laser_scan,
+                        options.tracking_frame,
+                        std::move(static_frame_id_to_tracking),
+                        trajectory_builder),
+          rangefinder_sampler(options.rangefinder_sampling_ratio),
+          odometry_sampler(options.odometry_sampling_ratio),
+          fixed_frame_pose_sampler(options.fixed_frame_pose_sampling_ratio),
+          imu_sampler(options.imu_sampling_ratio),
+          landmark_sampler(options.landmarks_sampling_ratio) {}
+
+    SensorBridge sensor_bridge;
+    ::cartographer::common::FixedRatioSampler rangefinder_sampler;
+    ::cartographer::common::FixedRatioSampler odometry_sampler;
+    ::cartographer::common::FixedRatioSampler fixed_frame_pose_sampler;
+    ::cartographer::common::FixedRatioSampler imu_sampler;
+    ::cartographer::common::FixedRatioSampler landmark_sampler;
+  };
+
+  // Records the sensor data passed on to the trajectory builder.
+  struct SensorLog {
+    SensorLog(const std::string& filename,
+              const ::cartographer::mapping::proto::
+                  TrajectoryBuilderOptionsWithSensorIds& options,
+              ::cartographer::mapping::TrajectoryBuilderInterface* const
+                  trajectory_builder)
+        : writer(filename),
+          sensor_log_writer(options, &writer),
+          recording_trajectory_builder(trajectory_builder,
+                                       &sensor_log_writer) {}
+
+    ::cartographer::io::ProtoStreamWriter writer;
+    ::cartographer::io::SensorLogWriter sensor_log_writer;
+    ::cartographer::io::SensorLogRecordingTrajectoryBuilder
+        recording_trajectory_builder;
+  };
+
+  std::unique_ptr<::cartographer::mapping::MapBuilderInterface> map_builder_;
+  std::vector<geometry_msgs::TransformStamped> static_transforms_;
+  const std::string sensor_log_prefix_;
+  // Unfinished trajectories, keyed by 'trajectory_id'. Each 'SensorLog' must
+  // outlive the 'Trajectory' writing to it.
+  std::map<int, std::unique_ptr<SensorLog>> sensor_logs_;
+  std::map<int, Trajectory> trajectories_;
+};
+
+// Plays 'bag_filenames' into 'node', adding one trajectory per bag when its
+// first message arrives. 'handle_tf_message' gets an early peek at the tf
+// messages, which are filtered afterwards, and 'handle_message_time' is called
+// with the time of every other message. Returns false if ROS was shut down.
+template <typename NodeType>
+bool PlayBags(const std::vector<std::string>& bag_filenames,
+              const std::vector<TrajectoryOptions>& bag_trajectory_options,
+              const std::vector<std::set<SensorId>>& bag_expected_sensor_ids,
+              const std::function<void(const BagMessage&)>& handle_tf_message,
+              const std::function<void(const ros::Time&)>& handle_message_time,
+              ::ros::NodeHandle* const node_handle, NodeType* const node) {
+  std::map<std::pair<int /* bag_index */, std::string>, SensorId>
       bag_topic_to_sensor_id;
   PlayableBagMultiplexer playable_bag_multiplexer;
   for (size_t current_bag_index = 0; current_bag_index < bag_filenames.size();
        ++current_bag_index) {
     const std::string& bag_filename = bag_filenames.at(current_bag_index);
     if (!::ros::ok()) {
-      return;
+      return false;
     }
     for (const auto& expected_sensor_id :
          bag_expected_sensor_ids.at(current_bag_index)) {
-      const auto bag_resolved_topic = std::make_pair(
-          static_cast<int>(current_bag_index),
-          node.node_handle()->resolveName(expected_sensor_id.id));
+      const auto bag_resolved_topic =
+          std::make_pair(static_cast<int>(current_bag_index),
+                         node_handle->resolveName(expected_sensor_id.id));
       if (bag_topic_to_sensor_id.count(bag_resolved_topic) != 0) {
         LOG(ERROR) << "Sensor " << expected_sensor_id.id << " of bag "
                    << current_bag_index << " resolves to topic "
@@ -215,28 +353,13 @@ void RunOfflineNode(const MapBuilderFactory& map_builder_factory) {
     playable_bag_multiplexer.AddPlayableBag(PlayableBag(
         bag_filename, current_bag_index, ros::TIME_MIN, ros::TIME_MAX, kDelay,
         // PlayableBag::FilteringEarlyMessageHandler is used to get an early
-        // peek at the tf messages in the bag and insert them into 'tf_buffer'.
-        // When a message is retrieved by GetNextMessage() further below,
-        // we will have already inserted further 'kDelay' seconds worth of
-        // transforms into 'tf_buffer' via this lambda.
-        [&tf_publisher, &tf_buffer](const rosbag::MessageInstance& msg) {
+        // peek at the tf messages in the bag. When a message is retrieved by
+        // GetNextMessage() further below, 'handle_tf_message' will already
+        // have seen further 'kDelay' seconds worth of transforms.
+        [&handle_tf_message](const BagMessage& msg) {
           if (msg.isType<tf2_msgs::TFMessage>()) {
             if (FLAGS_use_bag_transforms) {
-              const auto tf_message = msg.instantiate<tf2_msgs::TFMessage>();
-              tf_publisher.publish(tf_message);
-
-              for (const auto& transform : tf_message->transforms) {
-                try {
-                  // We need to keep 'tf_buffer' small because it becomes very
-                  // inefficient otherwise. We make sure that tf_messages are
-                  // published before any data messages, so that tf lookups
-                  // always work.
-                  tf_buffer.setTransform(transform, "unused_authority",
-                                         msg.getTopic() == kTfStaticTopic);
-                } catch (const tf2::TransformException& ex) {
-                  LOG(WARNING) << ex.what();
-                }
-              }
+              handle_tf_message(msg);
             }
             // Tell 'PlayableBag' to filter the tf message since there is no
             // further use for it.
@@ -250,7 +373,7 @@ void RunOfflineNode(const MapBuilderFactory& map_builder_factory) {
   std::set<std::string> bag_topics;
   std::stringstream bag_topics_string;
   for (const auto& topic : playable_bag_multiplexer.topics()) {
-    std::string resolved_topic = node.node_handle()->resolveName(topic, false);
+    std::string resolved_topic = node_handle->resolveName(topic, false);
     bag_topics.insert(resolved_topic);
     bag_topics_string << resolved_topic << ",";
   }
@@ -276,11 +399,11 @@ void RunOfflineNode(const MapBuilderFactory& map_builder_factory) {
           : ros::Time();
   while (playable_bag_multiplexer.IsMessageAvailable()) {
     if (!::ros::ok()) {
-      return;
+      return false;
     }
 
     const auto next_msg_tuple = playable_bag_multiplexer.GetNextMessage();
-    const rosbag::MessageInstance& msg = std::get<0>(next_msg_tuple);
+    const BagMessage& msg = std::get<0>(next_msg_tuple);
     const int bag_index = std::get<1>(next_msg_tuple);
     const bool is_last_message_in_bag = std::get<2>(next_msg_tuple);
 
@@ -293,8 +416,8 @@ void RunOfflineNode(const MapBuilderFactory& map_builder_factory) {
     // to avoid blocking the sensor queue.
     if (bag_index_to_trajectory_id.count(bag_index) == 0) {
       trajectory_id =
-          node.AddOfflineTrajectory(bag_expected_sensor_ids.at(bag_index),
-                                    bag_trajectory_options.at(bag_index));
+          node->AddOfflineTrajectory(bag_expected_sensor_ids.at(bag_index),
+                                     bag_trajectory_options.at(bag_index));
       CHECK(bag_index_to_trajectory_id
                 .emplace(std::piecewise_construct,
                          std::forward_as_tuple(bag_index),
@@ -308,55 +431,58 @@ void RunOfflineNode(const MapBuilderFactory& map_builder_factory) {
 
     const auto bag_topic = std::make_pair(
         bag_index,
-        node.node_handle()->resolveName(msg.getTopic(), false /* resolve */));
+        node_handle->resolveName(msg.getTopic(), false /* resolve */));
     auto it = bag_topic_to_sensor_id.find(bag_topic);
     if (it != bag_topic_to_sensor_id.end()) {
       const std::string& sensor_id = it->second.id;
       if (msg.isType<sensor_msgs::LaserScan>()) {
-        node.HandleLaserScanMessage(trajectory_id, sensor_id,
-                                    msg.instantiate<sensor_msgs::LaserScan>());
+        node->HandleLaserScanMessage(trajectory_id, sensor_id,
+                                     msg.instantiate<sensor_msgs::LaserScan>());
       }
       if (msg.isType<sensor_msgs::MultiEchoLaserScan>()) {
-        node.HandleMultiEchoLaserScanMessage(
+        node->HandleMultiEchoLaserScanMessage(
             trajectory_id, sensor_id,
             msg.instantiate<sensor_msgs::MultiEchoLaserScan>());
       }
       if (msg.isType<sensor_msgs::PointCloud2>()) {
-        node.HandlePointCloud2Message(
+        node->HandlePointCloud2Message(
             trajectory_id, sensor_id,
             msg.instantiate<sensor_msgs::PointCloud2>());
       }
       if (msg.isType<sensor_msgs::Imu>()) {
-        node.HandleImuMessage(trajectory_id, sensor_id,
-                              msg.instantiate<sensor_msgs::Imu>());
+        node->HandleImuMessage(trajectory_id, sensor_id,
+                               msg.instantiate<sensor_msgs::Imu>());
       }
       if (msg.isType<nav_msgs::Odometry>()) {
-        node.HandleOdometryMessage(trajectory_id, sensor_id,
-                                   msg.instantiate<nav_msgs::Odometry>());
+        node->HandleOdometryMessage(trajectory_id, sensor_id,
+                                    msg.instantiate<nav_msgs::Odometry>());
       }
       if (msg.isType<sensor_msgs::NavSatFix>()) {
-        node.HandleNavSatFixMessage(trajectory_id, sensor_id,
-                                    msg.instantiate<sensor_msgs::NavSatFix>());
+        node->HandleNavSatFixMessage(trajectory_id, sensor_id,
+                                     msg.instantiate<sensor_msgs::NavSatFix>());
       }
       if (msg.isType<cartographer_ros_msgs::LandmarkList>()) {
-        node.HandleLandmarkMessage(
+        node->HandleLandmarkMessage(
             trajectory_id, sensor_id,
             msg.instantiate<cartographer_ros_msgs::LandmarkList>());
       }
     }
-    clock.clock = msg.getTime();
-    clock_publisher.publish(clock);
+    handle_message_time(msg.getTime());
 
     if (is_last_message_in_bag) {
-      node.FinishTrajectory(trajectory_id);
+      node->FinishTrajectory(trajectory_id);
     }
   }
+  return true;
+}
 
-  // Ensure the clock is republished after the bag has been finished, during the
-  // final optimization, serialization, and optional indefinite spinning at the
-  // end.
-  clock_republish_timer.start();
-  node.RunFinalOptimization();
+// Runs the final optimization, logs resource usage and serializes the state.
+template <typename NodeType>
+void FinishOfflineNode(
+    const std::vector<std::string>& bag_filenames,
+    const std::chrono::time_point<std::chrono::steady_clock> start_time,
+    NodeType* const node) {
+  node->RunFinalOptimization();
 
   const std::chrono::time_point<std::chrono::steady_clock> end_time =
       std::chrono::steady_clock::now();
@@ -384,8 +510,8 @@ void RunOfflineNode(const MapBuilderFactory& map_builder_factory) {
             ? absl::StrCat(bag_filenames.front(), ".pbstream")
             : FLAGS_save_state_filename;
     LOG(INFO) << "Writing state to '" << state_output_filename << "'...";
-    node.SerializeState(state_output_filename,
-                        true /* include_unfinished_submaps */);
+    node->SerializeState(state_output_filename,
+                         true /* include_unfinished_submaps */);
   }
   if (FLAGS_keep_running) {
     LOG(INFO) << "Finished processing and waiting for shutdown.";
@@ -393,4 +519,195 @@ void RunOfflineNode(const MapBuilderFactory& map_builder_factory) {
   }
 }
 
+void RunHeadless(
+    std::unique_ptr<::cartographer::mapping::MapBuilderInterface> map_builder,
+    const std::vector<std::string>& bag_filenames,
+    const std::vector<TrajectoryOptions>& bag_trajectory_options,
+    const std::vector<std::set<SensorId>>& bag_expected_sensor_ids,
+    const std::chrono::time_point<std::chrono::steady_clock> start_time) {
+  std::vector<geometry_msgs::TransformStamped> urdf_transforms;
+  const std::vector<std::string> urdf_filenames =
+      absl::StrSplit(FLAGS_urdf_filenames, ',', absl::SkipEmpty());
+  for (const auto& urdf_filename : urdf_filenames) {
+    const auto current_urdf_transforms =
+        ReadStaticTransformsFromUrdf(urdf_filename, nullptr /* tf_buffer */);
+    urdf_transforms.insert(urdf_transforms.end(),
+                           current_urdf_transforms.begin(),
+                           current_urdf_transforms.end());
+  }
+
+  HeadlessNode node(std::move(map_builder), std::move(urdf_transforms),
+                    FLAGS_sensor_log_prefix);
+  if (!FLAGS_load_state_filename.empty()) {
+    node.LoadState(FLAGS_load_state_filename, FLAGS_load_frozen_state);
+  }
+
+  // Only used to resolve topic names.
+  ::ros::NodeHandle node_handle;
+  if (!PlayBags(
+          bag_filenames, bag_trajectory_options, bag_expected_sensor_ids,
+          [&node](const BagMessage& msg) {
+            if (msg.getTopic() == kTfStaticTopic) {
+              node.AddStaticTransforms(
+                  msg.instantiate<tf2_msgs::TFMessage>()->transforms);
+            }
+          },
+          [](const ros::Time&) {}, &node_handle, &node)) {
+    return;
+  }
+  FinishOfflineNode(bag_filenames, start_time, &node);
+}
+
+void RunWithNode(
+    const NodeOptions& node_options,
+    std::unique_ptr<::cartographer::mapping::MapBuilderInterface> map_builder,
+    const std::vector<std::string>& bag_filenames,
+    const std::vector<TrajectoryOptions>& bag_trajectory_options,
+    const std::vector<std::set<SensorId>>& bag_expected_sensor_ids,
+    const std::chrono::time_point<std::chrono::steady_clock> start_time) {
+  tf2_ros::Buffer tf_buffer;
+
+  std::vector<geometry_msgs::TransformStamped> urdf_transforms;
+  const std::vector<std::string> urdf_filenames =
+      absl::StrSplit(FLAGS_urdf_filenames, ',', absl::SkipEmpty());
+  for (const auto& urdf_filename : urdf_filenames) {
+    const auto current_urdf_transforms =
+        ReadStaticTransformsFromUrdf(urdf_filename, &tf_buffer);
+    urdf_transforms.insert(urdf_transforms.end(),
+                           current_urdf_transforms.begin(),
+                           current_urdf_transforms.end());
+  }
+
+  tf_buffer.setUsingDedicatedThread(true);
+
+  Node node(node_options, std::move(map_builder), &tf_buffer,
+            FLAGS_collect_metrics);
+  if (!FLAGS_load_state_filename.empty()) {
+    node.LoadState(FLAGS_load_state_filename, FLAGS_load_frozen_state);
+  }
+
+  ::ros::Publisher tf_publisher =
+      node.node_handle()->advertise<tf2_msgs::TFMessage>(
+          kTfTopic, kLatestOnlyPublisherQueueSize);
+
+  ::tf2_ros::StaticTransformBroadcaster static_tf_broadcaster;
+
+  ::ros::Publisher clock_publisher =
+      node.node_handle()->advertise<rosgraph_msgs::Clock>(
+          kClockTopic, kLatestOnlyPublisherQueueSize);
+
+  if (urdf_transforms.size() > 0) {
+    static_tf_broadcaster.sendTransform(urdf_transforms);
+  }
+
+  ros::AsyncSpinner async_spinner(kSingleThreaded);
+  async_spinner.start();
+  rosgraph_msgs::Clock clock;
+  auto clock_republish_timer = node.node_handle()->createWallTimer(
+      ::ros::WallDuration(kClockPublishFrequencySec),
+      [&clock_publisher, &clock](const ::ros::WallTimerEvent&) {
+        clock_publisher.publish(clock);
+      },
+      false /* oneshot */, false /* autostart */);
+
+  if (!PlayBags(
+          bag_filenames, bag_trajectory_options, bag_expected_sensor_ids,
+          [&tf_publisher, &tf_buffer](const BagMessage& msg) {
+            const auto tf_message = msg.instantiate<tf2_msgs::TFMessage>();
+            tf_publisher.publish(tf_message);
+
+            for (const auto& transform : tf_message->transforms) {
+              try {
+                // We need to keep 'tf_buffer' small because it becomes very
+                // inefficient otherwise. We make sure that tf_messages are
+                // published before any data messages, so that tf lookups
+                // always work.
+                tf_buffer.setTransform(transform, "unused_authority",
+                                       msg.getTopic() == kTfStaticTopic);
+              } catch (const tf2::TransformException& ex) {
+                LOG(WARNING) << ex.what();
+              }
+            }
+          },
+          [&clock_publisher, &clock](const ros::Time& time) {
+            clock.clock = time;
+            clock_publisher.publish(clock);
+          },
+          node.node_handle(), &node)) {
+    return;
+  }
+
+  // Ensure the clock is republished after the bag has been finished, during the
+  // final optimization, serialization, and optional indefinite spinning at the
+  // end.
+  clock_republish_timer.start();
+  FinishOfflineNode(bag_filenames, start_time, &node);
+}
+
+}  // namespace
+
+void RunOfflineNode(const MapBuilderFactory& map_builder_factory) {
+  CHECK(!FLAGS_configuration_directory.empty())
+      << "-configuration_directory is missing.";
+  CHECK(!FLAGS_configuration_basenames.empty())
+      << "-configuration_basenames is missing.";
+  CHECK(!(FLAGS_bag_filenames.empty() && FLAGS_load_state_filename.empty()))
+      << "-bag_filenames and -load_state_filename cannot both be unspecified.";
+  const std::vector<std::string> bag_filenames =
+      absl::StrSplit(FLAGS_bag_filenames, ',', absl::SkipEmpty());
+  cartographer_ros::NodeOptions node_options;
+  const std::vector<std::string> configuration_basenames =
+      absl::StrSplit(FLAGS_configuration_basenames, ',', absl::SkipEmpty());
+  std::vector<TrajectoryOptions> bag_trajectory_options(1);
+  std::tie(node_options, bag_trajectory_options.at(0)) =
+      LoadOptions(FLAGS_configuration_directory, configuration_basenames.at(0));
+
+  for (size_t bag_index = 1; bag_index < bag_filenames.size(); ++bag_index) {
+    TrajectoryOptions current_trajectory_options;
+    if (bag_index < configuration_basenames.size()) {
+      std::tie(std::ignore, current_trajectory_options) = LoadOptions(
+          FLAGS_configuration_directory, configuration_basenames.at(bag_index));
+    } else {
+      current_trajectory_options = bag_trajectory_options.at(0);
+    }
+    bag_trajectory_options.push_back(current_trajectory_options);
+  }
+  if (bag_filenames.size() > 0) {
+    CHECK_EQ(bag_trajectory_options.size(), bag_filenames.size());
+  }
+
+  // Since we preload the transform buffer, we should never have to wait for a
+  // transform. When we finish processing the bag, we will simply drop any
+  // remaining sensor data that cannot be transformed due to missing transforms.
+  node_options.lookup_transform_timeout_sec = 0.;
+
+  auto map_builder = map_builder_factory(node_options.map_builder_options);
+
+  const std::chrono::time_point<std::chrono::steady_clock> start_time =
+      std::chrono::steady_clock::now();
+
+  std::vector<std::set<SensorId>> bag_expected_sensor_ids;
+  if (configuration_basenames.size() == 1) {
+    const auto current_bag_expected_sensor_ids =
+        ComputeDefaultSensorIdsForMultipleBags(
+            node_options, {bag_trajectory_options.front()});
+    bag_expected_sensor_ids = {bag_filenames.size(),
+                               current_bag_expected_sensor_ids.front()};
+  } else {
+    bag_expected_sensor_ids = ComputeDefaultSensorIdsForMultipleBags(
+        node_options, bag_trajectory_options);
+  }
+  CHECK_EQ(bag_expected_sensor_ids.size(), bag_filenames.size());
+
+  CHECK(FLAGS_headless || FLAGS_sensor_log_prefix.empty())
+      << "-sensor_log_prefix requires -headless.";
+  if (FLAGS_headless) {
+    RunHeadless(std::move(map_builder), bag_filenames, bag_trajectory_options,
+                bag_expected_sensor_ids, start_time);
+  } else {
+    RunWithNode(node_options, std::move(map_builder), bag_filenames,
+                bag_trajectory_options, bag_expected_sensor_ids, start_time);
+  }
+}
+
 }  // namespace cartographer_ros
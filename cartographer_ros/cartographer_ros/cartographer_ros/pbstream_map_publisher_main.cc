@@ -45,16 +45,22 @@ namespace {
 
 std::unique_ptr<nav_msgs::OccupancyGrid> LoadOccupancyGridMsg(
     const std::string& pbstream_filename, const double resolution) {
-  ::cartographer::io::ProtoStreamReader reader(pbstream_filename);
-  ::cartographer::io::ProtoStreamDeserializer deserializer(&reader);
-
   LOG(INFO) << "Loading submap slices from serialized data.";
   std::map<::cartographer::mapping::SubmapId, ::cartographer::io::SubmapSlice>
       submap_slices;
   ::cartographer::mapping::ValueConversionTables conversion_tables;
-  ::cartographer::io::DeserializeAndFillSubmapSlices(
-      &deserializer, &submap_slices, &conversion_tables);
-  CHECK(reader.eof());
+  if (::cartographer::io::IsIndexedProtoStream(pbstream_filename)) {
+    const ::cartographer::io::IndexedProtoStreamReader reader(
+        pbstream_filename, 1 /* num_threads */);
+    ::cartographer::io::FillSubmapSlicesFromIndexedProtoStream(
+        reader, &submap_slices, &conversion_tables);
+  } else {
+    ::cartographer::io::ProtoStreamReader reader(pbstream_filename);
+    ::cartographer::io::ProtoStreamDeserializer deserializer(&reader);
+    ::cartographer::io::DeserializeAndFillSubmapSlices(
+        &deserializer, &submap_slices, &conversion_tables);
+    CHECK(reader.eof());
+  }
 
   LOG(INFO) << "Generating combined map image from submap slices.";
   const auto painted_slices =
@@ -31,26 +31,48 @@ DEFINE_string(pbstream_filename, "",
               "Filename of a pbstream to draw a map from.");
 DEFINE_string(map_filestem, "map", "Stem of the output files.");
 DEFINE_double(resolution, 0.05, "Resolution of a grid cell in the drawn map.");
+DEFINE_int32(num_painting_threads, 4,
+             "Number of threads painting the submaps into the map.");
+DEFINE_int32(tile_size, 0,
+             "If positive, the map is written as square tiles of this many "
+             "pixels instead of one image, see -num_zoom_levels.");
+DEFINE_int32(num_zoom_levels, 1,
+             "Number of zoom levels of the tiled map. Each level halves the "
+             "resolution of the previous one. Requires -tile_size.");
 
 namespace cartographer_ros {
 namespace {
 
 void Run(const std::string& pbstream_filename, const std::string& map_filestem,
          const double resolution) {
-  ::cartographer::io::ProtoStreamReader reader(pbstream_filename);
-  ::cartographer::io::ProtoStreamDeserializer deserializer(&reader);
-
   LOG(INFO) << "Loading submap slices from serialized data.";
   std::map<::cartographer::mapping::SubmapId, ::cartographer::io::SubmapSlice>
       submap_slices;
   ::cartographer::mapping::ValueConversionTables conversion_tables;
-  ::cartographer::io::DeserializeAndFillSubmapSlices(
-      &deserializer, &submap_slices, &conversion_tables);
-  CHECK(reader.eof());
+  if (::cartographer::io::IsIndexedProtoStream(pbstream_filename)) {
+    const ::cartographer::io::IndexedProtoStreamReader reader(
+        pbstream_filename, 1 /* num_threads */);
+    ::cartographer::io::FillSubmapSlicesFromIndexedProtoStream(
+        reader, &submap_slices, &conversion_tables);
+  } else {
+    ::cartographer::io::ProtoStreamReader reader(pbstream_filename);
+    ::cartographer::io::ProtoStreamDeserializer deserializer(&reader);
+    ::cartographer::io::DeserializeAndFillSubmapSlices(
+        &deserializer, &submap_slices, &conversion_tables);
+    CHECK(reader.eof());
+  }
+
+  if (FLAGS_tile_size > 0) {
+    LOG(INFO) << "Generating tiled map from submap slices.";
+    WriteTiledMap(submap_slices, resolution, FLAGS_tile_size,
+                  FLAGS_num_zoom_levels, FLAGS_num_painting_threads,
+                  map_filestem);
+    return;
+  }
 
   LOG(INFO) << "Generating combined map image from submap slices.";
-  auto result =
-      ::cartographer::io::PaintSubmapSlices(submap_slices, resolution);
+  auto result = ::cartographer::io::PaintSubmapSlices(
+      submap_slices, resolution, FLAGS_num_painting_threads);
 
   ::cartographer::io::StreamFileWriter pgm_writer(map_filestem + ".pgm");
 
@@ -75,6 +97,8 @@ int main(int argc, char** argv) {
 
   CHECK(!FLAGS_pbstream_filename.empty()) << "-pbstream_filename is missing.";
   CHECK(!FLAGS_map_filestem.empty()) << "-map_filestem is missing.";
+  CHECK(FLAGS_num_zoom_levels == 1 || FLAGS_tile_size > 0)
+      << "-num_zoom_levels requires -tile_size.";
 
   ::cartographer_ros::Run(FLAGS_pbstream_filename, FLAGS_map_filestem,
                           FLAGS_resolution);
@@ -23,6 +23,68 @@
 
 namespace cartographer_ros {
 
+namespace {
+
+// Upper bound on the decompressed messages read ahead per bag.
+constexpr size_t kMaxReadAheadBytes = 64 << 20;
+
+}  // namespace
+
+BagMessage::BagMessage(const rosbag::MessageInstance& message_instance)
+    : topic_(message_instance.getTopic()),
+      time_(message_instance.getTime()),
+      shape_shifter_(
+          message_instance.instantiate<topic_tools::ShapeShifter>()) {}
+
+PlayableBag::MessageReader::MessageReader(rosbag::View* const view)
+    : view_(view), thread_([this]() { ReadMessages(); }) {}
+
+PlayableBag::MessageReader::~MessageReader() {
+  {
+    absl::MutexLock lock(&mutex_);
+    stopped_ = true;
+  }
+  thread_.join();
+}
+
+absl::optional<BagMessage> PlayableBag::MessageReader::GetNextMessage() {
+  absl::MutexLock lock(&mutex_);
+  const auto predicate = [this]() EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return !messages_.empty() || finished_;
+  };
+  mutex_.Await(absl::Condition(&predicate));
+  if (messages_.empty()) {
+    return absl::nullopt;
+  }
+  BagMessage message = std::move(messages_.front());
+  messages_.pop_front();
+  num_buffered_bytes_ -= message.size();
+  return message;
+}
+
+void PlayableBag::MessageReader::ReadMessages() {
+  const auto predicate = [this]() EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return num_buffered_bytes_ < kMaxReadAheadBytes || stopped_;
+  };
+  try {
+    for (const rosbag::MessageInstance& message_instance : *view_) {
+      // Reading and decompressing happens outside the lock.
+      BagMessage message(message_instance);
+      absl::MutexLock lock(&mutex_);
+      mutex_.Await(absl::Condition(&predicate));
+      if (stopped_) {
+        return;
+      }
+      num_buffered_bytes_ += message.size();
+      messages_.push_back(std::move(message));
+    }
+  } catch (const rosbag::BagException& e) {
+    LOG(FATAL) << "Failed to read bag: " << e.what();
+  }
+  absl::MutexLock lock(&mutex_);
+  finished_ = true;
+}
+
 PlayableBag::PlayableBag(
     const std::string& bag_filename, const int bag_id,
     const ros::Time start_time, const ros::Time end_time,
@@ -30,20 +92,22 @@ PlayableBag::PlayableBag(
     FilteringEarlyMessageHandler filtering_early_message_handler)
     : bag_(absl::make_unique<rosbag::Bag>(bag_filename, rosbag::bagmode::Read)),
       view_(absl::make_unique<rosbag::View>(*bag_, start_time, end_time)),
-      view_iterator_(view_->begin()),
+      begin_time_(view_->getBeginTime()),
+      end_time_(view_->getEndTime()),
+      num_messages_(view_->size()),
       finished_(false),
       bag_id_(bag_id),
       bag_filename_(bag_filename),
-      duration_in_seconds_(
-          (view_->getEndTime() - view_->getBeginTime()).toSec()),
+      duration_in_seconds_((end_time_ - begin_time_).toSec()),
       message_counter_(0),
       buffer_delay_(buffer_delay),
       filtering_early_message_handler_(
           std::move(filtering_early_message_handler)) {
-  AdvanceUntilMessageAvailable();
   for (const auto* connection_info : view_->getConnections()) {
     topics_.insert(connection_info->topic);
   }
+  message_reader_ = absl::make_unique<MessageReader>(view_.get());
+  AdvanceUntilMessageAvailable();
 }
 
 ros::Time PlayableBag::PeekMessageTime() const {
@@ -52,16 +116,16 @@ ros::Time PlayableBag::PeekMessageTime() const {
 }
 
 std::tuple<ros::Time, ros::Time> PlayableBag::GetBeginEndTime() const {
-  return std::make_tuple(view_->getBeginTime(), view_->getEndTime());
+  return std::make_tuple(begin_time_, end_time_);
 }
 
-rosbag::MessageInstance PlayableBag::GetNextMessage(
+BagMessage PlayableBag::GetNextMessage(
     cartographer_ros_msgs::BagfileProgress* progress) {
   CHECK(IsMessageAvailable());
-  const rosbag::MessageInstance msg = buffered_messages_.front();
+  BagMessage msg = std::move(buffered_messages_.front());
   buffered_messages_.pop_front();
   AdvanceUntilMessageAvailable();
-  double processed_seconds = (msg.getTime() - view_->getBeginTime()).toSec();
+  double processed_seconds = (msg.getTime() - begin_time_).toSec();
   if ((message_counter_ % 10000) == 0) {
     LOG(INFO) << "Processed " << processed_seconds << " of "
               << duration_in_seconds_ << " seconds of bag " << bag_filename_;
@@ -70,7 +134,7 @@ rosbag::MessageInstance PlayableBag::GetNextMessage(
   if (progress) {
     progress->current_bagfile_name = bag_filename_;
     progress->current_bagfile_id = bag_id_;
-    progress->total_messages = view_->size();
+    progress->total_messages = num_messages_;
     progress->processed_messages = message_counter_;
     progress->total_seconds = duration_in_seconds_;
     progress->processed_seconds = processed_seconds;
@@ -89,16 +153,15 @@ int PlayableBag::bag_id() const { return bag_id_; }
 
 void PlayableBag::AdvanceOneMessage() {
   CHECK(!finished_);
-  if (view_iterator_ == view_->end()) {
+  absl::optional<BagMessage> msg = message_reader_->GetNextMessage();
+  if (!msg.has_value()) {
     finished_ = true;
     return;
   }
-  rosbag::MessageInstance& msg = *view_iterator_;
   if (!filtering_early_message_handler_ ||
-      filtering_early_message_handler_(msg)) {
-    buffered_messages_.push_back(msg);
+      filtering_early_message_handler_(msg.value())) {
+    buffered_messages_.push_back(std::move(msg.value()));
   }
-  ++view_iterator_;
   ++message_counter_;
 }
 
@@ -133,13 +196,12 @@ bool PlayableBagMultiplexer::IsMessageAvailable() const {
   return !next_message_queue_.empty();
 }
 
-std::tuple<rosbag::MessageInstance, int, bool>
-PlayableBagMultiplexer::GetNextMessage() {
+std::tuple<BagMessage, int, bool> PlayableBagMultiplexer::GetNextMessage() {
   CHECK(IsMessageAvailable());
   const int current_bag_index = next_message_queue_.top().bag_index;
   PlayableBag& current_bag = playable_bags_.at(current_bag_index);
   cartographer_ros_msgs::BagfileProgress progress;
-  rosbag::MessageInstance msg = current_bag.GetNextMessage(&progress);
+  BagMessage msg = current_bag.GetNextMessage(&progress);
   const bool publish_progress =
       current_bag.finished() ||
       ros::Time::now() - bag_progress_time_map_[current_bag.bag_id()] >=
@@ -17,32 +17,66 @@
 #ifndef CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_PLAYABLE_BAG_H
 #define CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_PLAYABLE_BAG_H
 
+#include <deque>
 #include <functional>
 #include <queue>
+#include <thread>
 
+#include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
 #include "cartographer_ros_msgs/BagfileProgress.h"
+#include "ros/message_traits.h"
 #include "ros/node_handle.h"
 #include "rosbag/bag.h"
 #include "rosbag/view.h"
 #include "tf2_ros/buffer.h"
+#include "topic_tools/shape_shifter.h"
 
 namespace cartographer_ros {
 
+// A message read from a bag. Unlike rosbag::MessageInstance, whose interface
+// it mirrors, it owns the decompressed message data, so instantiating it does
+// not access the bag again.
+class BagMessage {
+ public:
+  explicit BagMessage(const rosbag::MessageInstance& message_instance);
+
+  const std::string& getTopic() const { return topic_; }
+  const ros::Time& getTime() const { return time_; }
+  // Size of the serialized message in bytes.
+  uint32_t size() const { return shape_shifter_->size(); }
+
+  template <typename T>
+  bool isType() const {
+    const char* const md5sum = ros::message_traits::MD5Sum<T>::value();
+    return std::string(md5sum) == "*" ||
+           shape_shifter_->getMD5Sum() == md5sum;
+  }
+
+  template <typename T>
+  boost::shared_ptr<T> instantiate() const {
+    return shape_shifter_->instantiate<T>();
+  }
+
+ private:
+  std::string topic_;
+  ros::Time time_;
+  boost::shared_ptr<const topic_tools::ShapeShifter> shape_shifter_;
+};
+
 class PlayableBag {
  public:
   // Handles messages early, i.e. when they are about to enter the buffer.
   // Returns a boolean indicating whether the message should enter the buffer.
   using FilteringEarlyMessageHandler =
-      std::function<bool /* forward_message_to_buffer */ (
-          const rosbag::MessageInstance&)>;
+      std::function<bool /* forward_message_to_buffer */ (const BagMessage&)>;
 
   PlayableBag(const std::string& bag_filename, int bag_id, ros::Time start_time,
               ros::Time end_time, ros::Duration buffer_delay,
               FilteringEarlyMessageHandler filtering_early_message_handler);
 
   ros::Time PeekMessageTime() const;
-  rosbag::MessageInstance GetNextMessage(
-      cartographer_ros_msgs::BagfileProgress* progress);
+  BagMessage GetNextMessage(cartographer_ros_msgs::BagfileProgress* progress);
   bool IsMessageAvailable() const;
   std::tuple<ros::Time, ros::Time> GetBeginEndTime() const;
 
@@ -52,21 +86,53 @@ class PlayableBag {
   bool finished() const { return finished_; }
 
  private:
+  // Reads and decompresses messages of 'view' ahead of time on its own thread,
+  // so that bag decoding does not limit the SLAM thread.
+  class MessageReader {
+   public:
+    explicit MessageReader(rosbag::View* view);
+    ~MessageReader();
+
+    MessageReader(const MessageReader&) = delete;
+    MessageReader& operator=(const MessageReader&) = delete;
+
+    // Blocks until the next message has been read. Returns nothing once all
+    // messages have been returned.
+    absl::optional<BagMessage> GetNextMessage() LOCKS_EXCLUDED(mutex_);
+
+   private:
+    void ReadMessages() LOCKS_EXCLUDED(mutex_);
+
+    rosbag::View* const view_;
+    absl::Mutex mutex_;
+    std::deque<BagMessage> messages_ GUARDED_BY(mutex_);
+    size_t num_buffered_bytes_ GUARDED_BY(mutex_) = 0;
+    bool finished_ GUARDED_BY(mutex_) = false;
+    bool stopped_ GUARDED_BY(mutex_) = false;
+    std::thread thread_;
+  };
+
   void AdvanceOneMessage();
   void AdvanceUntilMessageAvailable();
 
   std::unique_ptr<rosbag::Bag> bag_;
   std::unique_ptr<rosbag::View> view_;
-  rosbag::View::const_iterator view_iterator_;
+  // Only 'message_reader_' accesses 'view_' after construction, the view's
+  // properties are cached below.
+  const ros::Time begin_time_;
+  const ros::Time end_time_;
+  const uint32_t num_messages_;
+  std::set<std::string> topics_;
+  // Declared after 'bag_' and 'view_' so that its thread stops first.
+  std::unique_ptr<MessageReader> message_reader_;
   bool finished_;
   const int bag_id_;
   const std::string bag_filename_;
   const double duration_in_seconds_;
   int message_counter_;
-  std::deque<rosbag::MessageInstance> buffered_messages_;
+  std::deque<BagMessage> buffered_messages_;
   const ::ros::Duration buffer_delay_;
   FilteringEarlyMessageHandler filtering_early_message_handler_;
-  std::set<std::string> topics_;
 };
 
 class PlayableBagMultiplexer {
@@ -77,8 +143,7 @@ class PlayableBagMultiplexer {
   // Returns the next message from the multiplexed (merge-sorted) message
   // stream, along with the bag id corresponding to the message, and whether
   // this was the last message in that bag.
-  std::tuple<rosbag::MessageInstance, int /* bag_id */,
-             bool /* is_last_message_in_bag */>
+  std::tuple<BagMessage, int /* bag_id */, bool /* is_last_message_in_bag */>
   GetNextMessage();
 
   bool IsMessageAvailable() const;
@@ -16,7 +16,14 @@
 
 #include "cartographer_ros/ros_map.h"
 
+#include <atomic>
+#include <cmath>
+#include <set>
+#include <thread>
+#include <vector>
+
 #include "absl/strings/str_cat.h"
+#include "glog/logging.h"
 
 namespace cartographer_ros {
 
@@ -26,11 +33,12 @@ void WritePgm(const ::cartographer::io::Image& image, const double resolution,
       absl::StrCat("P5\n# Cartographer map; ", resolution, " m/pixel\n",
                    image.width(), " ", image.height(), "\n255\n");
   file_writer->Write(header.data(), header.size());
+  std::string row(image.width(), 0);
   for (int y = 0; y < image.height(); ++y) {
     for (int x = 0; x < image.width(); ++x) {
-      const char color = image.GetPixel(x, y)[0];
-      file_writer->Write(&color, 1);
+      row[x] = image.GetPixel(x, y)[0];
     }
+    file_writer->Write(row.data(), row.size());
   }
 }
 
@@ -46,4 +54,104 @@ void WriteYaml(const double resolution, const Eigen::Vector2d& origin,
   file_writer->Write(output.data(), output.size());
 }
 
+void WriteTiledMap(
+    const std::map<::cartographer::mapping::SubmapId,
+                   ::cartographer::io::SubmapSlice>& submap_slices,
+    const double resolution, const int tile_size, const int num_levels,
+    const int num_threads, const std::string& map_filestem) {
+  CHECK_GT(tile_size, 0);
+  CHECK_GT(num_levels, 0);
+  struct Tile {
+    int level;
+    Eigen::Vector2i index;
+  };
+  std::vector<Tile> tiles;
+  std::vector<double> level_resolutions;
+  for (int level = 0; level < num_levels; ++level) {
+    const double level_resolution = resolution * std::pow(2., level);
+    level_resolutions.push_back(level_resolution);
+    // Only tiles overlapping the bounding box of at least one slice are
+    // painted, so sparse maps do not produce empty tiles.
+    std::set<std::pair<int, int>> tile_indices;
+    for (const auto& entry : submap_slices) {
+      if (entry.second.surface == nullptr) {
+        continue;
+      }
+      const Eigen::AlignedBox2f box =
+          ::cartographer::io::GetSubmapSliceBoundingBox(entry.second,
+                                                        level_resolution);
+      const Eigen::Vector2i min_index(
+          std::floor(box.min().x() / tile_size),
+          std::floor(box.min().y() / tile_size));
+      const Eigen::Vector2i max_index(
+          std::floor(box.max().x() / tile_size),
+          std::floor(box.max().y() / tile_size));
+      for (int x = min_index.x(); x <= max_index.x(); ++x) {
+        for (int y = min_index.y(); y <= max_index.y(); ++y) {
+          tile_indices.emplace(x, y);
+        }
+      }
+    }
+    for (const auto& tile_index : tile_indices) {
+      tiles.push_back(
+          Tile{level, Eigen::Vector2i(tile_index.first, tile_index.second)});
+    }
+  }
+
+  std::vector<std::string> tile_yaml_filenames(tiles.size());
+  std::atomic<size_t> next_tile(0);
+  const auto paint_tiles = [&]() {
+    for (size_t i = next_tile++; i < tiles.size(); i = next_tile++) {
+      const Tile& tile = tiles[i];
+      const double level_resolution = level_resolutions[tile.level];
+      const Eigen::Vector2i pixel_min = tile.index * tile_size;
+      const Eigen::AlignedBox2i pixel_box(
+          pixel_min, pixel_min + Eigen::Vector2i::Constant(tile_size));
+      auto result = ::cartographer::io::PaintSubmapSlicesInBox(
+          submap_slices, level_resolution, pixel_box);
+      const ::cartographer::io::Image image(std::move(result.surface));
+      const std::string tile_filestem =
+          absl::StrCat(map_filestem, "_", tile.level, "_", tile.index.x(), "_",
+                       tile.index.y());
+      ::cartographer::io::StreamFileWriter pgm_writer(tile_filestem + ".pgm");
+      WritePgm(image, level_resolution, &pgm_writer);
+      CHECK(pgm_writer.Close());
+      const Eigen::Vector2d origin(
+          -result.origin.x() * level_resolution,
+          (result.origin.y() - image.height()) * level_resolution);
+      ::cartographer::io::StreamFileWriter yaml_writer(tile_filestem +
+                                                       ".yaml");
+      WriteYaml(level_resolution, origin, pgm_writer.GetFilename(),
+                &yaml_writer);
+      CHECK(yaml_writer.Close());
+      tile_yaml_filenames[i] = yaml_writer.GetFilename();
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < num_threads; ++i) {
+    threads.emplace_back(paint_tiles);
+  }
+  paint_tiles();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  std::string index = absl::StrCat("tile_size: ", tile_size, "\nlevels:\n");
+  for (int level = 0; level < num_levels; ++level) {
+    absl::StrAppend(&index, "  - resolution: ", level_resolutions[level],
+                    "\n    tiles:\n");
+    for (size_t i = 0; i < tiles.size(); ++i) {
+      if (tiles[i].level == level) {
+        absl::StrAppend(&index, "      - {x: ", tiles[i].index.x(),
+                        ", y: ", tiles[i].index.y(), ", yaml: ",
+                        tile_yaml_filenames[i], "}\n");
+      }
+    }
+  }
+  ::cartographer::io::StreamFileWriter index_writer(map_filestem +
+                                                    "_tiles.yaml");
+  index_writer.Write(index.data(), index.size());
+  CHECK(index_writer.Close());
+}
+
 }  // namespace cartographer_ros
@@ -17,11 +17,13 @@
 #ifndef CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_ROS_MAP_H
 #define CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_ROS_MAP_H
 
+#include <map>
 #include <string>
 
 #include "Eigen/Core"
 #include "cartographer/io/file_writer.h"
 #include "cartographer/io/image.h"
+#include "cartographer/io/submap_painter.h"
 #include "cartographer/mapping/2d/map_limits.h"
 
 namespace cartographer_ros {
@@ -36,6 +38,19 @@ void WriteYaml(const double resolution, const Eigen::Vector2d& origin,
                const std::string& pgm_filename,
                ::cartographer::io::FileWriter* file_writer);
 
+// Paints 'submap_slices' into square tiles of 'tile_size' pixels on
+// 'num_levels' zoom levels, where level 0 has 'resolution' and every further
+// level half the resolution of the previous one. Each tile is written as
+// '<map_filestem>_<level>_<x>_<y>.pgm' with a matching yaml, tiles no submap
+// overlaps are skipped. Tiles are painted one at a time per thread, so memory
+// is bounded by 'num_threads' tiles instead of the whole map. The tiles are
+// listed in '<map_filestem>_tiles.yaml'.
+void WriteTiledMap(
+    const std::map<::cartographer::mapping::SubmapId,
+                   ::cartographer::io::SubmapSlice>& submap_slices,
+    double resolution, int tile_size, int num_levels, int num_threads,
+    const std::string& map_filestem);
+
 }  // namespace cartographer_ros
 
 #endif  // CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_ROS_MAP_H
@@ -51,6 +51,7 @@ RosMapWritingPointsProcessor::FromDictionary(
 
 void RosMapWritingPointsProcessor::Process(
     std::unique_ptr<::cartographer::io::PointsBatch> batch) {
+  ::cartographer::io::CompactPoints(batch.get());
   range_data_inserter_.Insert(
       {batch->origin, ::cartographer::sensor::PointCloud(batch->points), {}},
       &probability_grid_);
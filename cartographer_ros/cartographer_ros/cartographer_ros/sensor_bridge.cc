@@ -16,7 +16,10 @@
 
 #include "cartographer_ros/sensor_bridge.h"
 
+#include <iterator>
+
 #include "absl/memory/memory.h"
+#include "cartographer/sensor/timed_point_cloud_pool.h"
 #include "cartographer_ros/msg_conversion.h"
 #include "cartographer_ros/time_conversion.h"
 
@@ -48,12 +51,22 @@ SensorBridge::SensorBridge(
       tf_bridge_(tracking_frame, lookup_transform_timeout_sec, tf_buffer),
       trajectory_builder_(trajectory_builder) {}
 
+SensorBridge::SensorBridge(
+    const int num_subdivisions_per_laser_scan,
+    const std::string& tracking_frame,
+    std::map<std::string, carto::transform::Rigid3d>
+        static_frame_id_to_tracking,
+    carto::mapping::TrajectoryBuilderInterface* const trajectory_builder)
+    : num_subdivisions_per_laser_scan_(num_subdivisions_per_laser_scan),
+      tf_bridge_(tracking_frame, std::move(static_frame_id_to_tracking)),
+      trajectory_builder_(trajectory_builder) {}
+
 std::unique_ptr<carto::sensor::OdometryData> SensorBridge::ToOdometryData(
     const nav_msgs::Odometry::ConstPtr& msg) {
   const carto::common::Time time = FromRos(msg->header.stamp);
   const auto sensor_to_tracking = tf_bridge_.LookupToTracking(
       time, CheckNoLeadingSlash(msg->child_frame_id));
-  if (sensor_to_tracking == nullptr) {
+  if (!sensor_to_tracking.has_value()) {
     return nullptr;
   }
   return absl::make_unique<carto::sensor::OdometryData>(
@@ -104,7 +117,7 @@ void SensorBridge::HandleLandmarkMessage(
 
   auto tracking_from_landmark_sensor = tf_bridge_.LookupToTracking(
       landmark_data.time, CheckNoLeadingSlash(msg->header.frame_id));
-  if (tracking_from_landmark_sensor != nullptr) {
+  if (tracking_from_landmark_sensor.has_value()) {
     for (auto& observation : landmark_data.landmark_observations) {
       observation.landmark_to_tracking_transform =
           *tracking_from_landmark_sensor *
@@ -130,7 +143,7 @@ std::unique_ptr<carto::sensor::ImuData> SensorBridge::ToImuData(
   const carto::common::Time time = FromRos(msg->header.stamp);
   const auto sensor_to_tracking = tf_bridge_.LookupToTracking(
       time, CheckNoLeadingSlash(msg->header.frame_id));
-  if (sensor_to_tracking == nullptr) {
+  if (!sensor_to_tracking.has_value()) {
     return nullptr;
   }
   CHECK(sensor_to_tracking->translation().norm() < 1e-5)
@@ -155,19 +168,19 @@ void SensorBridge::HandleImuMessage(const std::string& sensor_id,
 
 void SensorBridge::HandleLaserScanMessage(
     const std::string& sensor_id, const sensor_msgs::LaserScan::ConstPtr& msg) {
-  carto::sensor::PointCloudWithIntensities point_cloud;
-  carto::common::Time time;
-  std::tie(point_cloud, time) = ToPointCloudWithIntensities(*msg);
-  HandleLaserScan(sensor_id, time, msg->header.frame_id, point_cloud);
+  const carto::common::Time time =
+      ToPointCloudWithIntensities(*msg, &laser_scan_point_cloud_);
+  HandleLaserScan(sensor_id, time, msg->header.frame_id,
+                  laser_scan_point_cloud_);
 }
 
 void SensorBridge::HandleMultiEchoLaserScanMessage(
     const std::string& sensor_id,
     const sensor_msgs::MultiEchoLaserScan::ConstPtr& msg) {
-  carto::sensor::PointCloudWithIntensities point_cloud;
-  carto::common::Time time;
-  std::tie(point_cloud, time) = ToPointCloudWithIntensities(*msg);
-  HandleLaserScan(sensor_id, time, msg->header.frame_id, point_cloud);
+  const carto::common::Time time =
+      ToPointCloudWithIntensities(*msg, &laser_scan_point_cloud_);
+  HandleLaserScan(sensor_id, time, msg->header.frame_id,
+                  laser_scan_point_cloud_);
 }
 
 void SensorBridge::HandlePointCloud2Message(
@@ -195,12 +208,10 @@ void SensorBridge::HandleLaserScan(
         points.points.size() * i / num_subdivisions_per_laser_scan_;
     const size_t end_index =
         points.points.size() * (i + 1) / num_subdivisions_per_laser_scan_;
-    carto::sensor::TimedPointCloud subdivision(
-        points.points.begin() + start_index, points.points.begin() + end_index);
     if (start_index == end_index) {
       continue;
     }
-    const double time_to_subdivision_end = subdivision.back().time;
+    const float time_to_subdivision_end = points.points[end_index - 1].time;
     // `subdivision_time` is the end of the measurement so sensor::Collator will
     // send all other sensor data first.
     const carto::common::Time subdivision_time =
@@ -215,28 +226,47 @@ void SensorBridge::HandleLaserScan(
       continue;
     }
     sensor_to_previous_subdivision_time_[sensor_id] = subdivision_time;
-    for (auto& point : subdivision) {
-      point.time -= time_to_subdivision_end;
-    }
-    CHECK_EQ(subdivision.back().time, 0.f);
-    HandleRangefinder(sensor_id, subdivision_time, frame_id, subdivision);
+    HandleRangefinder(sensor_id, subdivision_time, frame_id,
+                      points.points.begin() + start_index,
+                      points.points.begin() + end_index,
+                      -time_to_subdivision_end);
   }
 }
 
 void SensorBridge::HandleRangefinder(
     const std::string& sensor_id, const carto::common::Time time,
     const std::string& frame_id, const carto::sensor::TimedPointCloud& ranges) {
-  if (!ranges.empty()) {
-    CHECK_LE(ranges.back().time, 0.f);
+  HandleRangefinder(sensor_id, time, frame_id, ranges.begin(), ranges.end(),
+                    0.f);
+}
+
+void SensorBridge::HandleRangefinder(
+    const std::string& sensor_id, const carto::common::Time time,
+    const std::string& frame_id,
+    const carto::sensor::TimedPointCloud::const_iterator begin,
+    const carto::sensor::TimedPointCloud::const_iterator end,
+    const float time_offset) {
+  if (begin != end) {
+    CHECK_LE(std::prev(end)->time + time_offset, 0.f);
   }
   const auto sensor_to_tracking =
       tf_bridge_.LookupToTracking(time, CheckNoLeadingSlash(frame_id));
-  if (sensor_to_tracking != nullptr) {
+  if (sensor_to_tracking.has_value()) {
+    // The point cloud is handed over to Cartographer, which recycles its
+    // storage once it has been consumed.
+    carto::sensor::TimedPointCloud transformed_ranges =
+        carto::sensor::TimedPointCloudPool::Get()->AcquireRanges();
+    transformed_ranges.reserve(std::distance(begin, end));
+    const carto::transform::Rigid3f transform =
+        sensor_to_tracking->cast<float>();
+    for (auto it = begin; it != end; ++it) {
+      transformed_ranges.push_back(transform * *it);
+      transformed_ranges.back().time += time_offset;
+    }
     trajectory_builder_->AddSensorData(
         sensor_id, carto::sensor::TimedPointCloudData{
                        time, sensor_to_tracking->translation().cast<float>(),
-                       carto::sensor::TransformTimedPointCloud(
-                           ranges, sensor_to_tracking->cast<float>())});
+                       std::move(transformed_ranges)});
   }
 }
 
@@ -47,6 +47,13 @@ class SensorBridge {
       int num_subdivisions_per_laser_scan, const std::string& tracking_frame,
       double lookup_transform_timeout_sec, tf2_ros::Buffer* tf_buffer,
       ::cartographer::mapping::TrajectoryBuilderInterface* trajectory_builder);
+  // Only uses the given static transforms from sensor frames to
+  // 'tracking_frame', see TfBridge.
+  SensorBridge(
+      int num_subdivisions_per_laser_scan, const std::string& tracking_frame,
+      std::map<std::string, ::cartographer::transform::Rigid3d>
+          static_frame_id_to_tracking,
+      ::cartographer::mapping::TrajectoryBuilderInterface* trajectory_builder);
 
   SensorBridge(const SensorBridge&) = delete;
   SensorBridge& operator=(const SensorBridge&) = delete;
@@ -84,8 +91,20 @@ class SensorBridge {
                          ::cartographer::common::Time time,
                          const std::string& frame_id,
                          const ::cartographer::sensor::TimedPointCloud& ranges);
+  // Like above, but for the points in [begin, end) with 'time_offset' added to
+  // their times. These are transformed straight into the point cloud which is
+  // handed to Cartographer, so that subdivisions need no copies of their own.
+  void HandleRangefinder(
+      const std::string& sensor_id, ::cartographer::common::Time time,
+      const std::string& frame_id,
+      ::cartographer::sensor::TimedPointCloud::const_iterator begin,
+      ::cartographer::sensor::TimedPointCloud::const_iterator end,
+      float time_offset);
 
   const int num_subdivisions_per_laser_scan_;
+  // Laser scans are converted into this, so that its storage is reused for
+  // every message.
+  ::cartographer::sensor::PointCloudWithIntensities laser_scan_point_cloud_;
   std::map<std::string, cartographer::common::Time>
       sensor_to_previous_subdivision_time_;
   const TfBridge tf_bridge_;
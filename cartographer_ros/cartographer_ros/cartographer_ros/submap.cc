@@ -22,8 +22,29 @@
 #include "cartographer_ros/msg_conversion.h"
 #include "cartographer_ros_msgs/StatusCode.h"
 #include "cartographer_ros_msgs/SubmapQuery.h"
+#include "cartographer_ros_msgs/SubmapTexturesQuery.h"
 
 namespace cartographer_ros {
+namespace {
+
+std::unique_ptr<::cartographer::io::SubmapTextures> ToSubmapTextures(
+    const int submap_version,
+    const std::vector<::cartographer_ros_msgs::SubmapTexture>& textures) {
+  auto response = absl::make_unique<::cartographer::io::SubmapTextures>();
+  response->version = submap_version;
+  for (const auto& texture : textures) {
+    const std::string compressed_cells(texture.cells.begin(),
+                                       texture.cells.end());
+    response->textures.emplace_back(::cartographer::io::SubmapTexture{
+        ::cartographer::io::UnpackTextureData(compressed_cells, texture.width,
+                                              texture.height),
+        texture.width, texture.height, texture.resolution,
+        ToRigid3d(texture.slice_pose)});
+  }
+  return response;
+}
+
+}  // namespace
 
 std::unique_ptr<::cartographer::io::SubmapTextures> FetchSubmapTextures(
     const ::cartographer::mapping::SubmapId& submap_id,
@@ -38,18 +59,36 @@ std::unique_ptr<::cartographer::io::SubmapTextures> FetchSubmapTextures(
   if (srv.response.textures.empty()) {
     return nullptr;
   }
-  auto response = absl::make_unique<::cartographer::io::SubmapTextures>();
-  response->version = srv.response.submap_version;
-  for (const auto& texture : srv.response.textures) {
-    const std::string compressed_cells(texture.cells.begin(),
-                                       texture.cells.end());
-    response->textures.emplace_back(::cartographer::io::SubmapTexture{
-        ::cartographer::io::UnpackTextureData(compressed_cells, texture.width,
-                                              texture.height),
-        texture.width, texture.height, texture.resolution,
-        ToRigid3d(texture.slice_pose)});
+  return ToSubmapTextures(srv.response.submap_version, srv.response.textures);
+}
+
+bool FetchSubmapTextures(
+    const std::map<::cartographer::mapping::SubmapId, int>&
+        known_submap_versions,
+    ros::ServiceClient* const client,
+    std::map<::cartographer::mapping::SubmapId,
+             std::unique_ptr<::cartographer::io::SubmapTextures>>* const
+        submap_textures) {
+  ::cartographer_ros_msgs::SubmapTexturesQuery srv;
+  for (const auto& entry : known_submap_versions) {
+    srv.request.trajectory_ids.push_back(entry.first.trajectory_id);
+    srv.request.submap_indices.push_back(entry.first.submap_index);
+    srv.request.known_submap_versions.push_back(entry.second);
   }
-  return response;
+  if (!client->call(srv) ||
+      srv.response.status.code != ::cartographer_ros_msgs::StatusCode::OK) {
+    return false;
+  }
+  for (const auto& submap : srv.response.submaps) {
+    if (submap.status.code != ::cartographer_ros_msgs::StatusCode::OK ||
+        submap.textures.empty()) {
+      continue;
+    }
+    (*submap_textures)[::cartographer::mapping::SubmapId{
+        submap.trajectory_id, submap.submap_index}] =
+        ToSubmapTextures(submap.submap_version, submap.textures);
+  }
+  return true;
 }
 
 }  // namespace cartographer_ros
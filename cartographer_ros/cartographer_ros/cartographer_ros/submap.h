@@ -17,6 +17,7 @@
 #ifndef CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_SUBMAP_H
 #define CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_SUBMAP_H
 
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -35,6 +36,19 @@ std::unique_ptr<::cartographer::io::SubmapTextures> FetchSubmapTextures(
     const ::cartographer::mapping::SubmapId& submap_id,
     ros::ServiceClient* client);
 
+// Fetches the textures of the submaps in 'known_submap_versions' in a single
+// call using 'client', which has to be a client of the SubmapTexturesQuery
+// service. Each value is the version of the textures the caller already has,
+// or -1. Only submaps whose version differs are added to 'submap_textures'.
+// Returns false if the call failed.
+bool FetchSubmapTextures(
+    const std::map<::cartographer::mapping::SubmapId, int>&
+        known_submap_versions,
+    ros::ServiceClient* client,
+    std::map<::cartographer::mapping::SubmapId,
+             std::unique_ptr<::cartographer::io::SubmapTextures>>*
+        submap_textures);
+
 }  // namespace cartographer_ros
 
 #endif  // CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_SUBMAP_H
@@ -16,7 +16,6 @@
 
 #include "cartographer_ros/tf_bridge.h"
 
-#include "absl/memory/memory.h"
 #include "cartographer_ros/msg_conversion.h"
 
 namespace cartographer_ros {
@@ -28,30 +27,56 @@ TfBridge::TfBridge(const std::string& tracking_frame,
       lookup_transform_timeout_sec_(lookup_transform_timeout_sec),
       buffer_(buffer) {}
 
-std::unique_ptr<::cartographer::transform::Rigid3d> TfBridge::LookupToTracking(
+TfBridge::TfBridge(const std::string& tracking_frame,
+                   std::map<std::string, ::cartographer::transform::Rigid3d>
+                       static_frame_id_to_tracking)
+    : tracking_frame_(tracking_frame),
+      lookup_transform_timeout_sec_(0.),
+      buffer_(nullptr),
+      static_frame_id_to_tracking_(std::move(static_frame_id_to_tracking)) {}
+
+absl::optional<::cartographer::transform::Rigid3d> TfBridge::LookupToTracking(
     const ::cartographer::common::Time time,
     const std::string& frame_id) const {
+  {
+    absl::MutexLock lock(&mutex_);
+    const auto it = static_frame_id_to_tracking_.find(frame_id);
+    if (it != static_frame_id_to_tracking_.end()) {
+      return it->second;
+    }
+  }
+  if (buffer_ == nullptr) {
+    LOG(WARNING) << "No static transform from \"" << frame_id << "\" to \""
+                 << tracking_frame_ << "\".";
+    return absl::nullopt;
+  }
   ::ros::Duration timeout(lookup_transform_timeout_sec_);
-  std::unique_ptr<::cartographer::transform::Rigid3d> frame_id_to_tracking;
   try {
-    const ::ros::Time latest_tf_time =
-        buffer_
-            ->lookupTransform(tracking_frame_, frame_id, ::ros::Time(0.),
-                              timeout)
-            .header.stamp;
+    const geometry_msgs::TransformStamped latest_tf = buffer_->lookupTransform(
+        tracking_frame_, frame_id, ::ros::Time(0.), timeout);
+    const ::ros::Time& latest_tf_time = latest_tf.header.stamp;
+    if (latest_tf_time.isZero()) {
+      // tf2 stamps the latest transform with time 0 iff all transforms between
+      // the two frames are static, so it is valid at any time.
+      const ::cartographer::transform::Rigid3d static_frame_id_to_tracking =
+          ToRigid3d(latest_tf);
+      absl::MutexLock lock(&mutex_);
+      static_frame_id_to_tracking_.emplace(frame_id,
+                                           static_frame_id_to_tracking);
+      return static_frame_id_to_tracking;
+    }
     const ::ros::Time requested_time = ToRos(time);
     if (latest_tf_time >= requested_time) {
       // We already have newer data, so we do not wait. Otherwise, we would wait
       // for the full 'timeout' even if we ask for data that is too old.
       timeout = ::ros::Duration(0.);
     }
-    return absl::make_unique<::cartographer::transform::Rigid3d>(
-        ToRigid3d(buffer_->lookupTransform(tracking_frame_, frame_id,
-                                           requested_time, timeout)));
+    return ToRigid3d(buffer_->lookupTransform(tracking_frame_, frame_id,
+                                              requested_time, timeout));
   } catch (const tf2::TransformException& ex) {
     LOG(WARNING) << ex.what();
   }
-  return nullptr;
+  return absl::nullopt;
 }
 
 }  // namespace cartographer_ros
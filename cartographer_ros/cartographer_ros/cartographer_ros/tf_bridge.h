@@ -17,8 +17,11 @@
 #ifndef CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_TF_BRIDGE_H
 #define CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_TF_BRIDGE_H
 
-#include <memory>
+#include <map>
+#include <string>
 
+#include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
 #include "cartographer/transform/rigid_transform.h"
 #include "cartographer_ros/time_conversion.h"
 #include "tf2_ros/buffer.h"
@@ -29,20 +32,33 @@ class TfBridge {
  public:
   TfBridge(const std::string& tracking_frame,
            double lookup_transform_timeout_sec, const tf2_ros::Buffer* buffer);
+  // Only knows the given static transforms from frames to 'tracking_frame',
+  // lookups of other frames fail.
+  TfBridge(const std::string& tracking_frame,
+           std::map<std::string, ::cartographer::transform::Rigid3d>
+               static_frame_id_to_tracking);
   ~TfBridge() {}
 
   TfBridge(const TfBridge&) = delete;
   TfBridge& operator=(const TfBridge&) = delete;
 
   // Returns the transform for 'frame_id' to 'tracking_frame_' if it exists at
-  // 'time'.
-  std::unique_ptr<::cartographer::transform::Rigid3d> LookupToTracking(
-      ::cartographer::common::Time time, const std::string& frame_id) const;
+  // 'time'. Transforms which only involve static frames, i.e. those published
+  // on /tf_static, are cached and later returned without querying 'buffer_'.
+  // Looked up for every sensor message, so the result is returned by value.
+  absl::optional<::cartographer::transform::Rigid3d> LookupToTracking(
+      ::cartographer::common::Time time, const std::string& frame_id) const
+      LOCKS_EXCLUDED(mutex_);
 
  private:
   const std::string tracking_frame_;
   const double lookup_transform_timeout_sec_;
+  // nullptr if only static transforms are known.
   const tf2_ros::Buffer* const buffer_;
+
+  mutable absl::Mutex mutex_;
+  mutable std::map<std::string, ::cartographer::transform::Rigid3d>
+      static_frame_id_to_tracking_ GUARDED_BY(mutex_);
 };
 
 }  // namespace cartographer_ros
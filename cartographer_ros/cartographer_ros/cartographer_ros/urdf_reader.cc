@@ -50,10 +50,51 @@ std::vector<geometry_msgs::TransformStamped> ReadStaticTransformsFromUrdf(
                                pose.rotation.y, pose.rotation.z)));
     transform.child_frame_id = link->name;
     transform.header.frame_id = link->getParent()->name;
-    tf_buffer->setTransform(transform, "urdf", true /* is_static */);
+    if (tf_buffer != nullptr) {
+      tf_buffer->setTransform(transform, "urdf", true /* is_static */);
+    }
     transforms.push_back(transform);
   }
   return transforms;
 }
 
+std::map<std::string, ::cartographer::transform::Rigid3d>
+ResolveStaticTransforms(
+    const std::vector<geometry_msgs::TransformStamped>& static_transforms,
+    const std::string& target_frame) {
+  using ::cartographer::transform::Rigid3d;
+  // Transforms form a tree, each frame has at most one parent.
+  std::map<std::string, std::pair<std::string, Rigid3d>> child_to_parent;
+  for (const auto& transform : static_transforms) {
+    child_to_parent[transform.child_frame_id] = {transform.header.frame_id,
+                                                 ToRigid3d(transform)};
+  }
+  // Returns the root of 'frame_id' and the transform from it into the root.
+  const auto to_root = [&child_to_parent](const std::string& frame_id) {
+    std::pair<std::string, Rigid3d> result{frame_id, Rigid3d::Identity()};
+    for (size_t i = 0; i <= child_to_parent.size(); ++i) {
+      const auto it = child_to_parent.find(result.first);
+      if (it == child_to_parent.end()) {
+        return result;
+      }
+      result = {it->second.first, it->second.second * result.second};
+    }
+    LOG(FATAL) << "Cycle in static transforms at \"" << frame_id << "\".";
+    return result;
+  };
+  const auto target_to_root = to_root(target_frame);
+  const Rigid3d root_to_target = target_to_root.second.inverse();
+  std::map<std::string, Rigid3d> frame_id_to_target;
+  frame_id_to_target[target_frame] = Rigid3d::Identity();
+  for (const auto& entry : child_to_parent) {
+    for (const std::string& frame_id : {entry.first, entry.second.first}) {
+      const auto frame_to_root = to_root(frame_id);
+      if (frame_to_root.first == target_to_root.first) {
+        frame_id_to_target[frame_id] = root_to_target * frame_to_root.second;
+      }
+    }
+  }
+  return frame_id_to_target;
+}
+
 }  // namespace cartographer_ros
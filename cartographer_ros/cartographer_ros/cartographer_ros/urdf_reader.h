@@ -17,16 +17,28 @@
 #ifndef CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_URDF_READER_H
 #define CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_URDF_READER_H
 
+#include <map>
+#include <string>
 #include <vector>
 
 #include "cartographer/common/port.h"
+#include "cartographer/transform/rigid_transform.h"
 #include "tf2_ros/buffer.h"
 
 namespace cartographer_ros {
 
+// Returns the fixed joints of the URDF as transforms. They are also added to
+// 'tf_buffer' as static transforms, unless it is nullptr.
 std::vector<geometry_msgs::TransformStamped> ReadStaticTransformsFromUrdf(
     const std::string& urdf_filename, tf2_ros::Buffer* tf_buffer);
 
+// Composes 'static_transforms' into the transform from each frame connected
+// to 'target_frame' into 'target_frame', without a tf2_ros::Buffer.
+std::map<std::string, ::cartographer::transform::Rigid3d>
+ResolveStaticTransforms(
+    const std::vector<geometry_msgs::TransformStamped>& static_transforms,
+    const std::string& target_frame);
+
 }  // namespace cartographer_ros
 
 #endif  // CARTOGRAPHER_ROS_CARTOGRAPHER_ROS_URDF_READER_H
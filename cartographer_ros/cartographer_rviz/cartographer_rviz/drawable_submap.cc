@@ -16,6 +16,7 @@
 
 #include "cartographer_rviz/drawable_submap.h"
 
+#include <algorithm>
 #include <chrono>
 #include <future>
 #include <sstream>
@@ -41,6 +42,42 @@ const Eigen::Vector3d kSubmapIdPosition(0.0, 0.0, 0.3);
 constexpr float kSubmapIdCharHeight = 0.2f;
 constexpr int kNumberOfSlicesPerSubmap = 2;
 
+// Returns 'texture' with its resolution reduced by 'factor' in both
+// directions. Each pixel averages a block of 'factor' x 'factor' pixels, which
+// is correct for the pre-multiplied alpha of the textures.
+::cartographer::io::SubmapTexture DownsampleSubmapTexture(
+    const ::cartographer::io::SubmapTexture& texture, const int factor) {
+  ::cartographer::io::SubmapTexture result;
+  result.width = (texture.width + factor - 1) / factor;
+  result.height = (texture.height + factor - 1) / factor;
+  result.resolution = texture.resolution * factor;
+  result.slice_pose = texture.slice_pose;
+  result.pixels.intensity.reserve(result.width * result.height);
+  result.pixels.alpha.reserve(result.width * result.height);
+  for (int y = 0; y < result.height; ++y) {
+    for (int x = 0; x < result.width; ++x) {
+      int intensity_sum = 0;
+      int alpha_sum = 0;
+      int num_pixels = 0;
+      for (int j = y * factor; j < std::min((y + 1) * factor, texture.height);
+           ++j) {
+        for (int i = x * factor; i < std::min((x + 1) * factor, texture.width);
+             ++i) {
+          const int index = j * texture.width + i;
+          intensity_sum +=
+              static_cast<unsigned char>(texture.pixels.intensity[index]);
+          alpha_sum += static_cast<unsigned char>(texture.pixels.alpha[index]);
+          ++num_pixels;
+        }
+      }
+      result.pixels.intensity.push_back(
+          static_cast<char>(intensity_sum / num_pixels));
+      result.pixels.alpha.push_back(static_cast<char>(alpha_sum / num_pixels));
+    }
+  }
+  return result;
+}
+
 }  // namespace
 
 DrawableSubmap::DrawableSubmap(const ::cartographer::mapping::SubmapId& id,
@@ -81,12 +118,11 @@ DrawableSubmap::DrawableSubmap(const ::cartographer::mapping::SubmapId& id,
   submap_id_text_node_->setPosition(ToOgre(kSubmapIdPosition));
   submap_id_text_node_->attachObject(&submap_id_text_);
   TogglePoseMarkerVisibility();
-  connect(this, SIGNAL(RequestSucceeded()), this, SLOT(UpdateSceneNode()));
 }
 
 DrawableSubmap::~DrawableSubmap() {
-  // 'query_in_progress_' must be true until the Q_EMIT has happened. Qt then
-  // makes sure that 'RequestSucceeded' is not called after our destruction.
+  // The RPC callback accesses members, so it has to finish before we are
+  // destroyed.
   if (QueryInProgress()) {
     rpc_request_future_.wait();
   }
@@ -135,11 +171,10 @@ bool DrawableSubmap::MaybeFetchTexture(ros::ServiceClient* const client) {
     absl::MutexLock locker(&mutex_);
     query_in_progress_ = false;
     if (submap_textures != nullptr) {
-      // We emit a signal to update in the right thread, and pass via the
-      // 'submap_texture_' member to simplify the signal-slot connection
-      // slightly.
+      // The textures are uploaded later by MaybeUploadTexture() which is
+      // called from the Ogre thread.
       submap_textures_ = std::move(submap_textures);
-      Q_EMIT RequestSucceeded();
+      texture_upload_pending_ = true;
     }
   });
   return true;
@@ -150,6 +185,30 @@ bool DrawableSubmap::QueryInProgress() {
   return query_in_progress_;
 }
 
+bool DrawableSubmap::MaybeUploadTexture(const int lod_level) {
+  absl::MutexLock locker(&mutex_);
+  if (submap_textures_ == nullptr ||
+      (!texture_upload_pending_ && lod_level == uploaded_lod_level_)) {
+    return false;
+  }
+  for (size_t slice_index = 0; slice_index < ogre_slices_.size() &&
+                               slice_index < submap_textures_->textures.size();
+       ++slice_index) {
+    const ::cartographer::io::SubmapTexture& texture =
+        submap_textures_->textures[slice_index];
+    if (lod_level == 0) {
+      ogre_slices_[slice_index]->Update(texture);
+    } else {
+      ogre_slices_[slice_index]->Update(
+          DownsampleSubmapTexture(texture, 1 << lod_level));
+    }
+  }
+  texture_upload_pending_ = false;
+  uploaded_lod_level_ = lod_level;
+  display_context_->queueRender();
+  return true;
+}
+
 void DrawableSubmap::SetAlpha(const double current_tracking_z,
                               const float fade_out_start_distance_in_meters) {
   const float fade_out_distance_in_meters =
@@ -176,15 +235,6 @@ void DrawableSubmap::SetSliceVisibility(size_t slice_index, bool visible) {
   ToggleVisibility();
 }
 
-void DrawableSubmap::UpdateSceneNode() {
-  absl::MutexLock locker(&mutex_);
-  for (size_t slice_index = 0; slice_index < ogre_slices_.size() &&
-                               slice_index < submap_textures_->textures.size();
-       ++slice_index) {
-    ogre_slices_[slice_index]->Update(submap_textures_->textures[slice_index]);
-  }
-  display_context_->queueRender();
-}
 
 void DrawableSubmap::ToggleVisibility() {
   for (auto& ogre_slice : ogre_slices_) {
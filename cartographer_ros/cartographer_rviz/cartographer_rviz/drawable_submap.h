@@ -68,6 +68,13 @@ class DrawableSubmap : public QObject {
   // Returns whether an RPC is in progress.
   bool QueryInProgress();
 
+  // Uploads the textures of the submap to the GPU if new textures were fetched
+  // or 'lod_level' differs from the level of the uploaded textures. Level 0 is
+  // the full resolution, every further level halves the resolution of the
+  // textures, which are downsampled on the CPU. Returns true if textures were
+  // uploaded.
+  bool MaybeUploadTexture(int lod_level);
+
   // Sets the alpha of the submap taking into account its slice height and the
   // 'current_tracking_z'. 'fade_out_start_distance_in_meters' defines the
   // distance in z direction in meters, before which the submap will be shown
@@ -79,6 +86,10 @@ class DrawableSubmap : public QObject {
   void SetSliceVisibility(size_t slice_index, bool visible);
 
   ::cartographer::mapping::SubmapId id() const { return id_; }
+  ::cartographer::transform::Rigid3d pose() {
+    absl::MutexLock locker(&mutex_);
+    return pose_;
+  }
   int version() const { return metadata_version_; }
   bool visibility() const { return visibility_->getBool(); }
   void set_visibility(const bool visibility) {
@@ -89,13 +100,7 @@ class DrawableSubmap : public QObject {
     TogglePoseMarkerVisibility();
   }
 
- Q_SIGNALS:
-  // RPC request succeeded.
-  void RequestSucceeded();
-
  private Q_SLOTS:
-  // Callback when an rpc request succeeded.
-  void UpdateSceneNode();
   void ToggleVisibility();
   void TogglePoseMarkerVisibility();
 
@@ -117,6 +122,9 @@ class DrawableSubmap : public QObject {
   std::future<void> rpc_request_future_;
   std::unique_ptr<::cartographer::io::SubmapTextures> submap_textures_
       GUARDED_BY(mutex_);
+  // Whether 'submap_textures_' has not been uploaded yet.
+  bool texture_upload_pending_ GUARDED_BY(mutex_) = false;
+  int uploaded_lod_level_ GUARDED_BY(mutex_) = 0;
   float current_alpha_ = 0.f;
   std::unique_ptr<::rviz::BoolProperty> visibility_;
 };
@@ -16,6 +16,12 @@
 
 #include "cartographer_rviz/submaps_display.h"
 
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "Eigen/Core"
 #include "OgreResourceGroupManager.h"
 #include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
@@ -36,12 +42,29 @@ namespace cartographer_rviz {
 namespace {
 
 constexpr int kMaxOnGoingRequestsPerTrajectory = 6;
+constexpr int kMaxTextureLodLevel = 3;
 constexpr char kMaterialsDirectory[] = "/ogre_media/materials";
 constexpr char kGlsl120Directory[] = "/glsl120";
 constexpr char kScriptsDirectory[] = "/scripts";
 constexpr char kDefaultTrackingFrame[] = "base_link";
 constexpr char kDefaultSubmapQueryServiceName[] = "/submap_query";
 
+// Returns the level of detail for a submap at 'distance' from the tracking
+// frame. Submaps closer than 'lod_distance' get the full resolution, beyond
+// that the resolution halves every time the distance doubles. A non-positive
+// 'lod_distance' disables the level of detail.
+int ComputeTextureLodLevel(const double distance, const double lod_distance) {
+  if (lod_distance <= 0.) {
+    return 0;
+  }
+  int lod_level = 0;
+  while (lod_level < kMaxTextureLodLevel &&
+         distance > lod_distance * (1 << lod_level)) {
+    ++lod_level;
+  }
+  return lod_level;
+}
+
 }  // namespace
 
 SubmapsDisplay::SubmapsDisplay() : tf_listener_(tf_buffer_) {
@@ -50,7 +73,9 @@ SubmapsDisplay::SubmapsDisplay() : tf_listener_(tf_buffer_) {
       "Submap query service to connect to.", this, SLOT(Reset()));
   tracking_frame_property_ = new ::rviz::StringProperty(
       "Tracking frame", kDefaultTrackingFrame,
-      "Tracking frame, used for fading out submaps.", this);
+      "Tracking frame, used for fading out submaps and for fetching and "
+      "showing nearby submaps at full resolution first.",
+      this);
   slice_high_resolution_enabled_ = new ::rviz::BoolProperty(
       "High Resolution", true, "Display high resolution slices.", this,
       SLOT(ResolutionToggled()), this);
@@ -74,6 +99,19 @@ SubmapsDisplay::SubmapsDisplay() : tf_listener_(tf_buffer_) {
                                 "Distance in meters in z-direction beyond "
                                 "which submaps will start to fade out.",
                                 this);
+  lod_distance_in_meters_ = new ::rviz::FloatProperty(
+      "LOD distance", 0.f,
+      "Distance in meters from the tracking frame beyond which submap "
+      "textures are shown at a reduced resolution. The resolution halves each "
+      "time the distance doubles. Set to 0 to always use the full resolution.",
+      this);
+  lod_distance_in_meters_->setMin(0.f);
+  texture_uploads_per_frame_ = new ::rviz::IntProperty(
+      "Texture uploads per frame", 8,
+      "Maximum number of submap textures uploaded to the GPU per frame, "
+      "nearest submaps first. Set to 0 for no limit.",
+      this);
+  texture_uploads_per_frame_->setMin(0);
   const std::string package_path = ::ros::package::getPath(ROS_PACKAGE_NAME);
   Ogre::ResourceGroupManager::getSingleton().addResourceLocation(
       package_path + kMaterialsDirectory, "FileSystem", ROS_PACKAGE_NAME);
@@ -203,42 +241,82 @@ void SubmapsDisplay::processMessage(
 
 void SubmapsDisplay::update(const float wall_dt, const float ros_dt) {
   absl::MutexLock locker(&mutex_);
-  // Schedule fetching of new submap textures.
-  for (const auto& trajectory_by_id : trajectories_) {
-    int num_ongoing_requests = 0;
-    for (const auto& submap_entry : trajectory_by_id.second->submaps) {
-      if (submap_entry.second->QueryInProgress()) {
-        ++num_ongoing_requests;
-      }
-    }
-    for (auto it = trajectory_by_id.second->submaps.rbegin();
-         it != trajectory_by_id.second->submaps.rend() &&
-         num_ongoing_requests < kMaxOnGoingRequestsPerTrajectory;
-         ++it) {
-      if (it->second->MaybeFetchTexture(&client_)) {
-        ++num_ongoing_requests;
-      }
-    }
-  }
   if (map_frame_ == nullptr) {
     return;
   }
-  // Update the fading by z distance.
   const ros::Time kLatest(0);
+  bool tracking_position_known = false;
+  Eigen::Vector3d tracking_position = Eigen::Vector3d::Zero();
   try {
     const ::geometry_msgs::TransformStamped transform_stamped =
         tf_buffer_.lookupTransform(
             *map_frame_, tracking_frame_property_->getStdString(), kLatest);
-    for (auto& trajectory_by_id : trajectories_) {
-      for (auto& submap_entry : trajectory_by_id.second->submaps) {
-        submap_entry.second->SetAlpha(
-            transform_stamped.transform.translation.z,
-            fade_out_start_distance_in_meters_->getFloat());
-      }
-    }
+    tracking_position = Eigen::Vector3d(
+        transform_stamped.transform.translation.x,
+        transform_stamped.transform.translation.y,
+        transform_stamped.transform.translation.z);
+    tracking_position_known = true;
   } catch (const tf2::TransformException& ex) {
     ROS_WARN_THROTTLE(1., "Could not compute submap fading: %s", ex.what());
   }
+
+  // Sort the submaps by distance to the tracking frame, so that nearby submaps
+  // are fetched and uploaded first. Without a tracking position, the newest
+  // submaps of each trajectory come first.
+  std::vector<std::pair<double, DrawableSubmap*>> submaps_by_distance;
+  for (const auto& trajectory_by_id : trajectories_) {
+    const auto& submaps = trajectory_by_id.second->submaps;
+    for (auto it = submaps.rbegin(); it != submaps.rend(); ++it) {
+      const double distance =
+          tracking_position_known
+              ? (it->second->pose().translation() - tracking_position).norm()
+              : 0.;
+      submaps_by_distance.emplace_back(distance, it->second.get());
+    }
+  }
+  std::stable_sort(submaps_by_distance.begin(), submaps_by_distance.end(),
+                   [](const std::pair<double, DrawableSubmap*>& lhs,
+                      const std::pair<double, DrawableSubmap*>& rhs) {
+                     return lhs.first < rhs.first;
+                   });
+
+  // Schedule fetching of new submap textures.
+  std::map<int, int> num_ongoing_requests_per_trajectory;
+  for (const auto& entry : submaps_by_distance) {
+    if (entry.second->QueryInProgress()) {
+      ++num_ongoing_requests_per_trajectory[entry.second->id().trajectory_id];
+    }
+  }
+  for (const auto& entry : submaps_by_distance) {
+    int& num_ongoing_requests =
+        num_ongoing_requests_per_trajectory[entry.second->id().trajectory_id];
+    if (num_ongoing_requests < kMaxOnGoingRequestsPerTrajectory &&
+        entry.second->MaybeFetchTexture(&client_)) {
+      ++num_ongoing_requests;
+    }
+  }
+
+  // Upload fetched textures and textures whose level of detail changed, within
+  // the budget per frame.
+  const int max_texture_uploads = texture_uploads_per_frame_->getInt();
+  int num_texture_uploads = 0;
+  for (const auto& entry : submaps_by_distance) {
+    if (max_texture_uploads > 0 && num_texture_uploads >= max_texture_uploads) {
+      break;
+    }
+    if (entry.second->MaybeUploadTexture(ComputeTextureLodLevel(
+            entry.first, lod_distance_in_meters_->getFloat()))) {
+      ++num_texture_uploads;
+    }
+  }
+
+  // Update the fading by z distance.
+  if (tracking_position_known) {
+    for (const auto& entry : submaps_by_distance) {
+      entry.second->SetAlpha(tracking_position.z(),
+                             fade_out_start_distance_in_meters_->getFloat());
+    }
+  }
   // Update the map frame to fixed frame transform.
   Ogre::Vector3 position;
   Ogre::Quaternion orientation;
@@ -29,6 +29,7 @@
 #include "rviz/message_filter_display.h"
 #include "rviz/properties/bool_property.h"
 #include "rviz/properties/float_property.h"
+#include "rviz/properties/int_property.h"
 #include "tf2_ros/buffer.h"
 #include "tf2_ros/transform_listener.h"
 
@@ -101,6 +102,8 @@ class SubmapsDisplay
   ::rviz::BoolProperty* visibility_all_enabled_;
   ::rviz::BoolProperty* pose_markers_all_enabled_;
   ::rviz::FloatProperty* fade_out_start_distance_in_meters_;
+  ::rviz::FloatProperty* lod_distance_in_meters_;
+  ::rviz::IntProperty* texture_uploads_per_frame_;
 };
 
 }  // namespace cartographer_rviz
@@ -0,0 +1,30 @@
+-- Copyright 2016 The Cartographer Authors
+--
+-- Licensed under the Apache License, Version 2.0 (the "License");
+-- you may not use this file except in compliance with the License.
+-- You may obtain a copy of the License at
+--
+--      http://www.apache.org/licenses/LICENSE-2.0
+--
+-- Unless required by applicable law or agreed to in writing, software
+-- distributed under the License is distributed on an "AS IS" BASIS,
+-- WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+-- See the License for the specific language governing permissions and
+-- limitations under the License.
+
+include "pose_graph.lua"
+
+MAP_BUILDER = {
+  use_trajectory_builder_2d = false,
+  use_trajectory_builder_3d = false,
+  num_background_threads = 4,
+  use_work_stealing_thread_pool = false,
+  numa_aware_work_stealing_thread_pool = false,
+  background_threads_nice_increment = 10,
+  background_threads_cpu_ids = {},
+  submap_query_cache_max_bytes = 32 * 1024 * 1024,
+  pose_graph = POSE_GRAPH,
+  collate_by_trajectory = false,
+  use_trajectory_ingestion_threads = false,
+  collator_max_lag_seconds = 0.,
+}
@@ -0,0 +1,33 @@
+-- Copyright 2016 The Cartographer Authors
+--
+-- Licensed under the Apache License, Version 2.0 (the "License");
+-- you may not use this file except in compliance with the License.
+-- You may obtain a copy of the License at
+--
+--      http://www.apache.org/licenses/LICENSE-2.0
+--
+-- Unless required by applicable law or agreed to in writing, software
+-- distributed under the License is distributed on an "AS IS" BASIS,
+-- WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+-- See the License for the specific language governing permissions and
+-- limitations under the License.
+
+include "map_builder.lua"
+
+MAP_BUILDER_SERVER = {
+  map_builder = MAP_BUILDER,
+  num_event_threads = 4,
+  num_grpc_threads = 4,
+  server_address = "0.0.0.0:50051",
+  uplink_server_address = "",
+  upload_batch_size = 100,
+  upload_max_batch_bytes = 0,
+  upload_max_batch_delay_seconds = 0.,
+  num_upload_rpcs_in_flight = 1,
+  enable_upload_compression = false,
+  import_frozen_state_from_shards = {},
+  num_sensor_data_threads = 1,
+  enable_shared_memory_transport = false,
+  enable_ssl_encryption = false,
+  enable_google_auth = false,
+}
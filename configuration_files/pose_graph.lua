@@ -0,0 +1,129 @@
+-- Copyright 2016 The Cartographer Authors
+--
+-- Licensed under the Apache License, Version 2.0 (the "License");
+-- you may not use this file except in compliance with the License.
+-- You may obtain a copy of the License at
+--
+--      http://www.apache.org/licenses/LICENSE-2.0
+--
+-- Unless required by applicable law or agreed to in writing, software
+-- distributed under the License is distributed on an "AS IS" BASIS,
+-- WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+-- See the License for the specific language governing permissions and
+-- limitations under the License.
+
+POSE_GRAPH = {
+  optimize_every_n_nodes = 90,
+  constraint_builder = {
+    sampling_ratio = 0.3,
+    max_constraint_distance = 15.,
+    min_score = 0.55,
+    global_localization_min_score = 0.6,
+    loop_closure_translation_weight = 1.1e4,
+    loop_closure_rotation_weight = 1e5,
+    log_matches = true,
+    max_submap_scan_matchers_memory_in_mb = 0,
+    scan_matcher_cells_pool_size_in_mb = 0,
+    early_termination_score = 0.,
+    use_global_localization_grid = false,
+    global_localization_grid_linear_search_window = 0.,
+    global_search_num_candidates = 0,
+    global_search_descriptor_max_range = 30.,
+    loop_closure_consistency_max_translation_error = 0.,
+    loop_closure_consistency_max_rotation_error = 0.,
+    fast_correlative_scan_matcher = {
+      linear_search_window = 7.,
+      angular_search_window = math.rad(30.),
+      branch_and_bound_depth = 7,
+      full_submap_match_num_tasks = 1,
+      precomputation_num_tasks = 1,
+    },
+    ceres_scan_matcher = {
+      occupied_space_weight = 20.,
+      translation_weight = 10.,
+      rotation_weight = 1.,
+      warm_start = false,
+      function_tolerance = 0.,
+      ceres_solver_options = {
+        use_nonmonotonic_steps = true,
+        max_num_iterations = 10,
+        num_threads = 1,
+        linear_solver_type = "",
+        sparse_linear_algebra_library_type = "",
+      },
+    },
+    fast_correlative_scan_matcher_3d = {
+      branch_and_bound_depth = 8,
+      full_resolution_depth = 3,
+      min_rotational_score = 0.77,
+      min_low_resolution_score = 0.55,
+      linear_xy_search_window = 5.,
+      linear_z_search_window = 1.,
+      angular_search_window = math.rad(15.),
+    },
+    ceres_scan_matcher_3d = {
+      occupied_space_weight_0 = 5.,
+      occupied_space_weight_1 = 30.,
+      translation_weight = 10.,
+      rotation_weight = 1.,
+      only_optimize_yaw = false,
+      num_points_per_residual_block = 0,
+      ceres_solver_options = {
+        use_nonmonotonic_steps = false,
+        max_num_iterations = 10,
+        num_threads = 1,
+        linear_solver_type = "",
+        sparse_linear_algebra_library_type = "",
+      },
+    },
+  },
+  matcher_translation_weight = 5e2,
+  matcher_rotation_weight = 1.6e3,
+  optimization_problem = {
+    huber_scale = 1e1,
+    acceleration_weight = 1.1e2,
+    rotation_weight = 1.6e4,
+    local_slam_pose_translation_weight = 1e5,
+    local_slam_pose_rotation_weight = 1e5,
+    odometry_translation_weight = 1e5,
+    odometry_rotation_weight = 1e5,
+    fixed_frame_pose_translation_weight = 1e1,
+    fixed_frame_pose_rotation_weight = 1e2,
+    fixed_frame_pose_use_tolerant_loss = false,
+    fixed_frame_pose_tolerant_loss_param_a = 1,
+    fixed_frame_pose_tolerant_loss_param_b = 1,
+    log_solver_summary = false,
+    use_online_imu_extrinsics_in_3d = true,
+    fix_z_in_3d = false,
+    incremental_optimization_num_hops = 0,
+    incremental_optimization_radius = 0.,
+    full_optimization_every_n_optimizations = 0,
+    eliminate_submaps_first = false,
+    use_analytical_jacobians_in_3d = false,
+    imu_aggregation_duration_in_3d = 0.,
+    ceres_solver_options = {
+      use_nonmonotonic_steps = false,
+      max_num_iterations = 50,
+      num_threads = 7,
+      linear_solver_type = "",
+      sparse_linear_algebra_library_type = "",
+    },
+  },
+  max_num_final_iterations = 200,
+  global_sampling_ratio = 0.003,
+  log_residual_histograms = true,
+  global_constraint_search_after_n_seconds = 10.,
+  compact_loaded_submaps = false,
+  lazy_load_frozen_submaps = false,
+  max_work_queue_delay = 0.,
+  min_load_shedding_factor = 0.1,
+  finished_submap_intra_constraint_stride = 0,
+  evicted_node_data_directory = "",
+  keep_node_data_every_n_nodes = 0,
+  optimized_pose_table_name = "",
+  --  overlapping_submaps_trimmer_2d = {
+  --    fresh_submaps_count = 1,
+  --    min_covered_area = 2,
+  --    min_added_submaps_count = 5,
+  --  },
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DEPTH_SCAN_KERNELS_COLUMN_REDUCE
+#define DEPTH_SCAN_KERNELS_COLUMN_REDUCE
+
+#include <stdint.h>
+#include <algorithm>
+#include <limits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+namespace depthimage_to_laserscan {
+
+// Column-wise minimum over a band of depth rows, in the raw units of the image.
+// 对一段深度图行做逐列最小值归约，单位为图像原始深度单位。
+//
+// For every column u, 'out[u]' becomes the smallest depth d over the 'num_rows' rows such that lo[u] <= d <= hi[u].
+// Columns without such a value are left at ColumnReduceTraits<T>::none(). Values which are not ordered (NaN) never
+// pass the bounds check. The rows are streamed one after the other so the working set is a single row plus 'out'.
+template<typename T> struct ColumnReduceTraits {};
+
+template<>
+struct ColumnReduceTraits<uint16_t>
+{
+  static inline uint16_t none() { return std::numeric_limits<uint16_t>::max(); }
+};
+
+template<>
+struct ColumnReduceTraits<float>
+{
+  static inline float none() { return std::numeric_limits<float>::infinity(); }
+};
+
+template<typename T>
+inline void column_min_reduce_scalar(const T* row, const int width, const T* lo, const T* hi, T* out, int u)
+{
+  for(; u < width; ++u){
+    const T depth = row[u];
+    if(lo[u] <= depth && depth <= hi[u] && depth < out[u]){
+      out[u] = depth;
+    }
+  }
+}
+
+inline void column_min_reduce_row(const uint16_t* row, const int width, const uint16_t* lo, const uint16_t* hi,
+                                  uint16_t* out)
+{
+  int u = 0;
+#if defined(__AVX2__)
+  const __m256i none = _mm256_set1_epi16((short)ColumnReduceTraits<uint16_t>::none());
+  for(; u + 16 <= width; u += 16){
+    const __m256i depth = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + u));
+    const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lo + u));
+    const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hi + u));
+    // Unsigned compares: d >= lo <=> max(d, lo) == d, d <= hi <=> min(d, hi) == d.
+    const __m256i in_range = _mm256_and_si256(_mm256_cmpeq_epi16(_mm256_max_epu16(depth, low), depth),
+                                              _mm256_cmpeq_epi16(_mm256_min_epu16(depth, high), depth));
+    const __m256i candidate = _mm256_blendv_epi8(none, depth, in_range);
+    __m256i* acc = reinterpret_cast<__m256i*>(out + u);
+    _mm256_storeu_si256(acc, _mm256_min_epu16(_mm256_loadu_si256(acc), candidate));
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  const uint16x8_t none = vdupq_n_u16(ColumnReduceTraits<uint16_t>::none());
+  for(; u + 8 <= width; u += 8){
+    const uint16x8_t depth = vld1q_u16(row + u);
+    const uint16x8_t in_range = vandq_u16(vcgeq_u16(depth, vld1q_u16(lo + u)), vcleq_u16(depth, vld1q_u16(hi + u)));
+    const uint16x8_t candidate = vbslq_u16(in_range, depth, none);
+    vst1q_u16(out + u, vminq_u16(vld1q_u16(out + u), candidate));
+  }
+#endif
+  column_min_reduce_scalar(row, width, lo, hi, out, u);
+}
+
+inline void column_min_reduce_row(const float* row, const int width, const float* lo, const float* hi, float* out)
+{
+  int u = 0;
+#if defined(__AVX2__)
+  const __m256 none = _mm256_set1_ps(ColumnReduceTraits<float>::none());
+  for(; u + 8 <= width; u += 8){
+    const __m256 depth = _mm256_loadu_ps(row + u);
+    // Ordered compares are false for NaN.
+    const __m256 in_range = _mm256_and_ps(_mm256_cmp_ps(depth, _mm256_loadu_ps(lo + u), _CMP_GE_OQ),
+                                          _mm256_cmp_ps(depth, _mm256_loadu_ps(hi + u), _CMP_LE_OQ));
+    const __m256 candidate = _mm256_blendv_ps(none, depth, in_range);
+    _mm256_storeu_ps(out + u, _mm256_min_ps(_mm256_loadu_ps(out + u), candidate));
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  const float32x4_t none = vdupq_n_f32(ColumnReduceTraits<float>::none());
+  for(; u + 4 <= width; u += 4){
+    const float32x4_t depth = vld1q_f32(row + u);
+    const uint32x4_t in_range = vandq_u32(vcgeq_f32(depth, vld1q_f32(lo + u)), vcleq_f32(depth, vld1q_f32(hi + u)));
+    const float32x4_t candidate = vbslq_f32(in_range, depth, none);
+    vst1q_f32(out + u, vminq_f32(vld1q_f32(out + u), candidate));
+  }
+#endif
+  column_min_reduce_scalar(row, width, lo, hi, out, u);
+}
+
+/**
+ * Reduces 'num_rows' rows starting at 'rows' (with a stride of 'row_step' elements) into 'out'.
+ * 将从'rows'开始的'num_rows'行归约到'out'中。
+ *
+ * @param rows First row of the band.
+ * @param row_step Distance between two rows in elements.
+ * @param num_rows Number of rows in the band.
+ * @param width Number of columns.
+ * @param lo Per-column lower bound (inclusive) in raw depth units.
+ * @param hi Per-column upper bound (inclusive) in raw depth units.
+ * @param out Per-column result, overwritten.
+ *
+ */
+template<typename T>
+inline void column_min_reduce(const T* rows, const int row_step, const int num_rows, const int width,
+                              const T* lo, const T* hi, T* out)
+{
+  std::fill(out, out + width, ColumnReduceTraits<T>::none());
+  for(int v = 0; v < num_rows; ++v, rows += row_step){
+    column_min_reduce_row(rows, width, lo, hi, out);
+  }
+}
+
+} // namespace depthimage_to_laserscan
+
+#endif
@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DEPTH_SCAN_KERNELS_SCAN_CONVERSION
+#define DEPTH_SCAN_KERNELS_SCAN_CONVERSION
+
+#include <depth_scan_kernels/column_reduce.h>
+#include <depth_scan_kernels/depth_traits.h>
+#include <stdint.h>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace depthimage_to_laserscan {
+
+// Conversion of a band of depth rows into laser scan ranges, shared by depthimage_to_laserscan and
+// fusion_camera_lidar. Everything here works on raw buffers so it does not depend on ROS messages.
+// 深度图扫描带到激光距离的转换，由depthimage_to_laserscan和fusion_camera_lidar共用，只处理原始缓冲区，不依赖ROS消息。
+
+/**
+ * Per-column lookup table of the conversion.
+ *
+ * The angle bin and the factor turning depth into range only depend on the column, the camera intrinsics and the
+ * output scan angles, so they are computed once and reused until the CameraInfo or the image width changes.
+ * 每列的角度索引和深度到距离的缩放系数只与列号、相机内参和输出扫描角度有关，因此只在CameraInfo或图像宽度变化时重新计算。
+ */
+struct ColumnLut
+{
+  std::vector<int> index; ///< Output scan bin of each image column, -1 if outside the scan. 每列对应的激光索引
+  std::vector<float> scale; ///< Factor converting depth in meters to range for each image column. 每列深度到距离的缩放系数
+
+  size_t width() const { return index.size(); }
+};
+
+/**
+ * Rebuilds lut for an image of the given width.
+ *
+ * @param center_x Principal point of the camera in pixels.
+ * @param fx Focal length of the camera in pixels.
+ * @param width Width of the depth image in pixels.
+ * @param angle_min First angle of the output scan.
+ * @param angle_increment Angle between two bins of the output scan.
+ * @param num_ranges Number of bins of the output scan.
+ * @param lut The rebuilt table.
+ *
+ */
+void build_column_lut(double center_x, double fx, uint32_t width, double angle_min, double angle_increment,
+                      int num_ranges, ColumnLut* lut);
+
+/**
+ * Determines whether or not new_value should replace old_value in the LaserScan.
+ *
+ * Uses the values of range_min, and range_max to determine how the new_value should be used.  Updates
+ * old_value only if new_value is in range and closer than old_value, finite values win over Infs and Infs
+ * win over NaNs.
+ *
+ * @param new_value The current calculated range.
+ * @param old_value The current range in the output LaserScan.
+ * @param range_min The minimum acceptable range for the output LaserScan.
+ * @param range_max The maximum acceptable range for the output LaserScan.
+ * @return If true, insert new_value into the output LaserScan.
+ *
+ */
+bool use_point(float new_value, float old_value, float range_min, float range_max);
+
+/**
+ * Raw depth bounds used by the column reduction, widened by a tiny margin so no in-range value is cut off.
+ */
+template<typename T>
+inline T raw_lower_bound(const double raw)
+{
+  if(std::numeric_limits<T>::is_integer){
+    // 0 marks invalid uint16 pixels and is never a candidate.
+    return (T)std::max(1.0, std::floor(raw) - 1.0);
+  }
+  return (T)(raw * (1.0 - 1e-5));
+}
+
+template<typename T>
+inline T raw_upper_bound(const double raw)
+{
+  if(std::numeric_limits<T>::is_integer){
+    // Keep none() out of reach so it always means 'no candidate'.
+    const double max_value = ColumnReduceTraits<T>::none() - 1.0;
+    return (T)std::min(max_value, std::ceil(raw) + 1.0);
+  }
+  return (T)(raw * (1.0 + 1e-5));
+}
+
+/**
+ * Scratch space of convert_band(), kept by the caller so that steady state conversions do not allocate.
+ * convert_band()的临时缓冲区，由调用者持有，稳定运行时不再分配内存
+ */
+class ColumnScratch
+{
+public:
+  /**
+   * Fills the per-column raw bounds for [range_min, range_max] and returns them, see column_min_reduce().
+   */
+  template<typename T>
+  void bounds(const ColumnLut& lut, const float range_min, const float range_max, T** lo, T** hi, T** reduced)
+  {
+    const size_t width = lut.width();
+    bounds_.resize(2 * width * sizeof(T));
+    min_.resize(width * sizeof(T));
+    *lo = reinterpret_cast<T*>(&bounds_[0]);
+    *hi = *lo + width;
+    *reduced = reinterpret_cast<T*>(&min_[0]);
+    const double unit_scaling = DepthTraits<T>::toMeters( T(1) );
+    for(size_t u = 0; u < width; ++u){
+      const double scale = lut.scale[u] * unit_scaling;
+      (*lo)[u] = raw_lower_bound<T>(range_min / scale);
+      (*hi)[u] = raw_upper_bound<T>(range_max / scale);
+    }
+  }
+
+private:
+  std::vector<uint8_t> bounds_; ///< Per-column raw depth bounds.
+  std::vector<uint8_t> min_; ///< Per-column minimum depth.
+};
+
+/**
+ * Feeds the num_rows pixels of column u starting at depth_row into range.
+ */
+template<typename T>
+inline void convert_column(const T* depth_row, const int row_step, const int num_rows, const int u, const float scale,
+                           const float range_min, const float range_max, float& range)
+{
+  for(int v = 0; v < num_rows; ++v, depth_row += row_step){
+    const T depth = depth_row[u];
+
+    float r = depth; // Assign to pass through NaNs and Infs
+    if (DepthTraits<T>::valid(depth)){ // Not NaN or Inf
+      // hypot(x, z) with x = (u - cx) * z / fx, 计算激光的真实距离
+      r = DepthTraits<T>::toMeters(depth) * scale;
+    }
+
+    // Determine if this point should be used. 判断激光距离是否超出预设的有效范围
+    if(use_point(r, range, range_min, range_max)){
+      range = r;
+    }
+  }
+}
+
+/**
+ * Per-pixel conversion of a band, the reference implementation of convert_band().
+ * 逐像素转换，convert_band()的参考实现
+ */
+template<typename T>
+inline void convert_band_scalar(const T* band, const int row_step, const int num_rows, const ColumnLut& lut,
+                                const float range_min, const float range_max, float* ranges)
+{
+  const int width = (int)lut.width();
+  for(int u = 0; u < width; ++u){
+    const int index = lut.index[u];
+    if(index >= 0){
+      convert_column<T>(band, row_step, num_rows, u, lut.scale[u], range_min, range_max, ranges[index]);
+    }
+  }
+}
+
+// column_min_reduce() as a functor, the default reduction of convert_band().
+struct CpuColumnMinReduce
+{
+  template<typename T>
+  void operator()(const T* rows, const int row_step, const int num_rows, const int width,
+                  const T* lo, const T* hi, T* out) const
+  {
+    column_min_reduce(rows, row_step, num_rows, width, lo, hi, out);
+  }
+};
+
+/**
+ * Converts num_rows rows starting at band into ranges, keeping the closest valid range of every bin.
+ *
+ * The band is first reduced to its per-column minimum within the raw bounds of [range_min, range_max], which is
+ * vectorized (or offloaded by the reduce functor). Only columns holding nothing but NaN/Inf and minima on the edge
+ * of the bounds then take the per-pixel path, so the result equals convert_band_scalar().
+ * 先在[range_min, range_max]对应的原始深度范围内对扫描带逐列求最小值（向量化，或由reduce交给其他后端），只有全为NaN/Inf的列和
+ * 落在范围边缘的最小值才走逐像素路径，结果与convert_band_scalar()相同。
+ *
+ * @param band First row of the band.
+ * @param row_step Distance between two rows in elements.
+ * @param num_rows Number of rows in the band.
+ * @param lut Column lookup table of the image, its width is the image width.
+ * @param range_min The minimum acceptable range.
+ * @param range_max The maximum acceptable range.
+ * @param scratch Reused scratch space.
+ * @param ranges Output ranges, indexed by lut.index.
+ * @param reduce Called like column_min_reduce().
+ *
+ */
+template<typename T, typename Reduce>
+inline void convert_band(const T* band, const int row_step, const int num_rows, const ColumnLut& lut,
+                         const float range_min, const float range_max, ColumnScratch* scratch, float* ranges,
+                         const Reduce& reduce)
+{
+  // With range_min <= 0 invalid uint16 pixels (0) become valid zero ranges, only the per-pixel path handles that.
+  if(std::numeric_limits<T>::is_integer && range_min <= 0.0f){
+    convert_band_scalar<T>(band, row_step, num_rows, lut, range_min, range_max, ranges);
+    return;
+  }
+
+  const int width = (int)lut.width();
+  T* lo;
+  T* hi;
+  T* reduced;
+  scratch->bounds<T>(lut, range_min, range_max, &lo, &hi, &reduced);
+  reduce(band, row_step, num_rows, width, lo, hi, reduced);
+
+  for(int u = 0; u < width; ++u){
+    const int index = lut.index[u];
+    if(index < 0){
+      continue;
+    }
+    const T depth = reduced[u];
+    if(depth != ColumnReduceTraits<T>::none()){
+      const float r = DepthTraits<T>::toMeters(depth) * lut.scale[u];
+      if(range_min <= r && r <= range_max){
+        if(use_point(r, ranges[index], range_min, range_max)){
+          ranges[index] = r;
+        }
+        continue;
+      }
+    }
+    // Integer depths are always finite, so no candidate means nothing in range for this column.
+    if(std::numeric_limits<T>::is_integer && depth == ColumnReduceTraits<T>::none()){
+      continue;
+    }
+    // NaN/Inf only columns and values on the edge of the bounds take the per-pixel path.
+    convert_column<T>(band, row_step, num_rows, u, lut.scale[u], range_min, range_max, ranges[index]);
+  }
+}
+
+template<typename T>
+inline void convert_band(const T* band, const int row_step, const int num_rows, const ColumnLut& lut,
+                         const float range_min, const float range_max, ColumnScratch* scratch, float* ranges)
+{
+  convert_band(band, row_step, num_rows, lut, range_min, range_max, scratch, ranges, CpuColumnMinReduce());
+}
+
+} // namespace depthimage_to_laserscan
+
+#endif
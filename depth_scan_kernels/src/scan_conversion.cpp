@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <depth_scan_kernels/scan_conversion.h>
+
+namespace depthimage_to_laserscan {
+
+void build_column_lut(const double center_x, const double fx, const uint32_t width, const double angle_min,
+                      const double angle_increment, const int num_ranges, ColumnLut* lut){
+  const double inverse_fx = 1.0 / fx;
+  lut->index.resize(width);
+  lut->scale.resize(width);
+  for(uint32_t u = 0; u < width; ++u){
+    // x / z of the ray through this column, the depth divides out.
+    const double x_over_z = (u - center_x) * inverse_fx;
+    const double th = -atan2(x_over_z, 1.0);
+    const int index = (th - angle_min) / angle_increment;
+    lut->index[u] = (index >= 0 && index < num_ranges) ? index : -1;
+    lut->scale[u] = hypot(x_over_z, 1.0);
+  }
+}
+
+bool use_point(const float new_value, const float old_value, const float range_min, const float range_max){
+  // Check for NaNs and Infs, a real number within our limits is more desirable than these.
+  // 检查NaNs和infs，选择在限制范围内的实数
+  const bool new_finite = std::isfinite(new_value);
+  const bool old_finite = std::isfinite(old_value);
+
+  // Infs are preferable over NaNs (more information)
+  // Infs比NaNs包含更多信息
+  if(!new_finite && !old_finite){ // Both are not NaN or Inf.
+    if(!std::isnan(new_value)){ // new is not NaN, so use it's +-Inf value.
+      return true;
+    }
+    return false; // Do not replace old_value
+  }
+
+  // If not in range, don't bother
+  // 不在范围内不用理会
+  const bool range_check = range_min <= new_value && new_value <= range_max;
+  if(!range_check){
+    return false;
+  }
+
+  if(!old_finite){ // New value is in range and finite, use it.
+    return true;
+  }
+
+  // Finally, if they are both numerical and new_value is closer than old_value, use new_value.
+  // 全都有效，则选取更接近的那个
+  const bool shorter_check = new_value < old_value;
+  return shorter_check;
+}
+
+} // namespace depthimage_to_laserscan
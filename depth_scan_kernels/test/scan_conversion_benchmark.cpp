@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Benchmarks of the shared band conversion, the same code runs in depthimage_to_laserscan and fusion_camera_lidar.
+// 共用扫描带转换的性能测试，depthimage_to_laserscan和fusion_camera_lidar运行的是同一份代码
+//
+// Run with: rosrun depth_scan_kernels benchmark_scan_conversion
+
+#include <depth_scan_kernels/scan_conversion.h>
+#include <benchmark/benchmark.h>
+
+#include <random>
+
+using namespace depthimage_to_laserscan;
+
+namespace {
+
+const int kWidth = 640;
+const int kHeight = 480;
+
+ColumnLut makeLut(){
+  ColumnLut lut;
+  const double fx = 525.0;
+  const double center_x = 319.5;
+  const double angle_max = atan2(center_x, fx);
+  const double angle_min = -atan2(kWidth - 1 - center_x, fx);
+  build_column_lut(center_x, fx, kWidth, angle_min, (angle_max - angle_min) / (kWidth - 1), kWidth, &lut);
+  return lut;
+}
+
+template<typename T>
+std::vector<T> makeImage(){
+  std::mt19937 prng(42);
+  std::uniform_int_distribution<int> distribution(0, 12000); // Includes invalid (0) and out of range values
+  std::vector<T> image(kWidth * kHeight);
+  for(size_t i = 0; i < image.size(); ++i){
+    image[i] = DepthTraits<T>::fromMeters(distribution(prng) * 0.001f);
+  }
+  return image;
+}
+
+// Argument: number of rows in the band (scan_height).
+template<typename T>
+void BM_ConvertBand(benchmark::State& state){
+  const std::vector<T> image = makeImage<T>();
+  const ColumnLut lut = makeLut();
+  ColumnScratch scratch;
+  std::vector<float> ranges(kWidth);
+  const int num_rows = state.range(0);
+  for(auto _ : state){
+    ranges.assign(kWidth, std::numeric_limits<float>::quiet_NaN());
+    convert_band<T>(&image[(kHeight - num_rows) / 2 * kWidth], kWidth, num_rows, lut, 0.45f, 10.0f, &scratch,
+                    &ranges[0]);
+    benchmark::DoNotOptimize(ranges.data());
+  }
+  state.SetItemsProcessed(state.iterations() * num_rows * kWidth);
+}
+
+template<typename T>
+void BM_ConvertBandScalar(benchmark::State& state){
+  const std::vector<T> image = makeImage<T>();
+  const ColumnLut lut = makeLut();
+  std::vector<float> ranges(kWidth);
+  const int num_rows = state.range(0);
+  for(auto _ : state){
+    ranges.assign(kWidth, std::numeric_limits<float>::quiet_NaN());
+    convert_band_scalar<T>(&image[(kHeight - num_rows) / 2 * kWidth], kWidth, num_rows, lut, 0.45f, 10.0f,
+                           &ranges[0]);
+    benchmark::DoNotOptimize(ranges.data());
+  }
+  state.SetItemsProcessed(state.iterations() * num_rows * kWidth);
+}
+
+void BM_BuildColumnLut(benchmark::State& state){
+  for(auto _ : state){
+    benchmark::DoNotOptimize(makeLut());
+  }
+}
+
+} // namespace
+
+BENCHMARK_TEMPLATE(BM_ConvertBand, uint16_t)->Arg(1)->Arg(10)->Arg(100);
+BENCHMARK_TEMPLATE(BM_ConvertBandScalar, uint16_t)->Arg(1)->Arg(10)->Arg(100);
+BENCHMARK_TEMPLATE(BM_ConvertBand, float)->Arg(1)->Arg(10)->Arg(100);
+BENCHMARK_TEMPLATE(BM_ConvertBandScalar, float)->Arg(1)->Arg(10)->Arg(100);
+BENCHMARK(BM_BuildColumnLut);
+
+BENCHMARK_MAIN();
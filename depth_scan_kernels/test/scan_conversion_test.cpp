@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <depth_scan_kernels/scan_conversion.h>
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+
+using namespace depthimage_to_laserscan;
+
+namespace {
+
+const int kWidth = 83; // Not a multiple of the vector width, so the scalar tail is covered.
+const int kRows = 24;
+
+ColumnLut makeLut(){
+  ColumnLut lut;
+  const double fx = 60.0;
+  const double center_x = 40.5;
+  const double angle_max = atan2(center_x, fx);
+  const double angle_min = -atan2(kWidth - 1 - center_x, fx);
+  build_column_lut(center_x, fx, kWidth, angle_min, (angle_max - angle_min) / (kWidth - 1), kWidth, &lut);
+  return lut;
+}
+
+// Expects convert_band() to match the per-pixel reference bit for bit, including NaN and Inf bins.
+template<typename T>
+void expectSameRanges(const std::vector<T>& image, const float range_min, const float range_max){
+  const ColumnLut lut = makeLut();
+  ColumnScratch scratch;
+  std::vector<float> expected(kWidth, std::numeric_limits<float>::quiet_NaN());
+  std::vector<float> actual(expected);
+  convert_band_scalar<T>(&image[0], kWidth, kRows, lut, range_min, range_max, &expected[0]);
+  convert_band<T>(&image[0], kWidth, kRows, lut, range_min, range_max, &scratch, &actual[0]);
+  for(int i = 0; i < kWidth; ++i){
+    if(std::isnan(expected[i])){
+      EXPECT_TRUE(std::isnan(actual[i])) << i;
+    }
+    else{
+      EXPECT_EQ(expected[i], actual[i]) << i;
+    }
+  }
+}
+
+} // namespace
+
+TEST(ScanConversionTest, testColumnLut)
+{
+  const ColumnLut lut = makeLut();
+  ASSERT_EQ(lut.width(), (size_t)kWidth);
+  for(int u = 0; u < kWidth; ++u){
+    EXPECT_GE(lut.scale[u], 1.0f);
+    if(u > 0 && lut.index[u] >= 0 && lut.index[u-1] >= 0){
+      EXPECT_LE(lut.index[u], lut.index[u-1]); // Columns go right to left in the scan.
+    }
+  }
+}
+
+TEST(ScanConversionTest, testUInt16)
+{
+  srand ( 8675309 ); // Set seed for repeatable tests
+  std::vector<uint16_t> image(kWidth * kRows);
+  for(size_t i = 0; i < image.size(); ++i){
+    image[i] = rand() % 12000; // Includes invalid (0) and out of range values
+  }
+  expectSameRanges(image, 0.45f, 10.0f);
+  expectSameRanges(image, 0.0f, 10.0f);
+}
+
+TEST(ScanConversionTest, testFloat)
+{
+  srand ( 8675309 ); // Set seed for repeatable tests
+  std::vector<float> image(kWidth * kRows);
+  for(size_t i = 0; i < image.size(); ++i){
+    const int r = rand() % 20;
+    image[i] = r == 0 ? std::numeric_limits<float>::quiet_NaN() :
+               r == 1 ? std::numeric_limits<float>::infinity() : (rand() % 12000) * 0.001f;
+  }
+  // Columns without any finite value.
+  for(int v = 0; v < kRows; ++v){
+    image[v * kWidth + 3] = std::numeric_limits<float>::quiet_NaN();
+    image[v * kWidth + 4] = v % 2 ? std::numeric_limits<float>::quiet_NaN() : -std::numeric_limits<float>::infinity();
+  }
+  expectSameRanges(image, 0.45f, 10.0f);
+}
+
+// The bounds are widened, values right on range_min and range_max still have to be exact.
+TEST(ScanConversionTest, testRangeEdges)
+{
+  const ColumnLut lut = makeLut();
+  std::vector<float> image(kWidth * kRows, 20.0f);
+  for(int u = 0; u < kWidth; ++u){
+    image[(u % kRows) * kWidth + u] = 0.45f / lut.scale[u];
+    image[((u + 1) % kRows) * kWidth + u] = 10.0f / lut.scale[u];
+  }
+  expectSameRanges(image, 0.45f, 10.0f);
+}
+
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -38,7 +38,7 @@
 #include <sensor_msgs/LaserScan.h>
 #include <sensor_msgs/image_encodings.h>
 #include <image_geometry/pinhole_camera_model.h>
-#include <depthimage_to_laserscan/depth_traits.h>
+#include <depth_scan_kernels/scan_conversion.h>
 #include <sstream>
 #include <limits.h>
 #include <math.h>
@@ -210,55 +210,18 @@ namespace depthimage_to_laserscan
   // 
     template<typename T>
     void convert(const sensor_msgs::ImageConstPtr& depth_msg, const image_geometry::PinholeCameraModel& cam_model,
-        const sensor_msgs::LaserScanPtr& scan_msg, const int& scan_height) const{
-      // Use correct principal point from calibration
-      // 使用校准的正确主要的点
-      const float center_x = cam_model.cx();  //图像中心位置x
-      const float center_y = cam_model.cy();  //图像中心位置y
-
-      // Combine unit conversion (if necessary) with scaling by focal length for computing (X,Y)
-      // 结合单位转换和焦距缩放计算(x,y)
-      const double unit_scaling = depthimage_to_laserscan::DepthTraits<T>::toMeters( T(1) );
-      const float constant_x = unit_scaling / cam_model.fx();
-
+        const sensor_msgs::LaserScanPtr& scan_msg, const int& scan_height){
       const T* depth_row = reinterpret_cast<const T*>(&depth_msg->data[0]);
       const int row_step = depth_msg->step / sizeof(T);
 
-      const int offset = (int)(center_y - scan_height/2);
+      const int offset = (int)(cam_model.cy() - scan_height/2);
       depth_row += offset*row_step; // 偏移到图像中心
 
-      for(int v = offset; v < offset+scan_height_; ++v, depth_row += row_step){
-        for (int u = 0; u < (int)depth_msg->width; ++u) // 在行中的每个像素上循环
-        {
-          const T depth = depth_row[u];
-
-          double r = depth; // Assign to pass through NaNs and Infs
-          const double th = -atan2((double)(u - center_x) * constant_x, unit_scaling); // Atan2(x, z), but depth divides out 计算夹角
-          const int index = (th - scan_msg->angle_min) / scan_msg->angle_increment;   //计算对应激光数据索引
-
-          if (depthimage_to_laserscan::DepthTraits<T>::valid(depth)){ // Not NaN or Inf
-            // Calculate in XYZ
-            double x = (u - center_x) * depth * constant_x;
-            double z = depthimage_to_laserscan::DepthTraits<T>::toMeters(depth);
-
-            // Calculate actual distance 
-            // 计算激光的真实距离
-            r = hypot(x, z);
-          }
-
-          // Determine if this point should be used.
-          // 判断激光距离是否超过预设的有效范围
-          if(use_point(r, scan_msg->ranges[index], scan_msg->range_min, scan_msg->range_max)){
-            scan_msg->ranges[index] = r;
-          }
-        }
-      }
+      // Column-wise min over the band with the cached lookup table, see depth_scan_kernels. 使用缓存的查找表逐列求最小值
+      convert_band<T>(depth_row, row_step, scan_height, column_lut_, scan_msg->range_min, scan_msg->range_max,
+                      &column_scratch_, &scan_msg->ranges[0]);
     }
 
-  
-  
-
-
 // sensor_msgs/CameraInfo 参数  http://docs.ros.org/en/api/sensor_msgs/html/msg/CameraInfo.html
 
     image_geometry::PinholeCameraModel cam_model_; ///< image_geometry helper class for managing sensor_msgs/CameraInfo messages.
@@ -268,6 +231,8 @@ namespace depthimage_to_laserscan
     float range_max_; ///< Stores the current maximum range to use.存储要使用的最大范围
     int scan_height_; ///< Number of pixel rows to use when producing a laserscan from an area.从区域内生成激光扫描时使用的像素行数
     std::string output_frame_id_; ///< Output frame_id for each laserscan.  This is likely NOT the camera's frame_id.输出的帧的id是每个激光帧的id，但不一定是相机帧的id
+    ColumnLut column_lut_; ///< Scan bin and depth to range factor of each image column. 每列对应的激光索引和缩放系数
+    ColumnScratch column_scratch_; ///< Scratch space of convert().
   };
 
 
@@ -58,35 +58,7 @@ double DepthImageToLaserScan::angle_between_rays(const cv::Point3d& ray1, const
 }
 
 bool DepthImageToLaserScan::use_point(const float new_value, const float old_value, const float range_min, const float range_max) const{
-  // Check for NaNs and Infs, a real number within our limits is more desirable than these.
-  // 检查NaNs和infs，选择在限制范围内的实数
-  const bool new_finite = std::isfinite(new_value);
-  const bool old_finite = std::isfinite(old_value);
-
-  // Infs are preferable over NaNs (more information)
-  // Infs比NaNs包含更多信息
-  if(!new_finite && !old_finite){ // Both are not NaN or Inf.
-    if(!std::isnan(new_value)){ // new is not NaN, so use it's +-Inf value.
-      return true;
-    }
-    return false; // Do not replace old_value
-  }
-
-  // If not in range, don't bother
-  // 不在范围内不用理会
-  const bool range_check = range_min <= new_value && new_value <= range_max;
-  if(!range_check){
-    return false;
-  }
-
-  if(!old_finite){ // New value is in range and finite, use it.
-    return true;
-  }
-
-  // Finally, if they are both numerical and new_value is closer than old_value, use new_value.
-  // 全都有效，则选取更接近的那个
-  const bool shorter_check = new_value < old_value;
-  return shorter_check;
+  return depthimage_to_laserscan::use_point(new_value, old_value, range_min, range_max);
 }
 
 
@@ -97,7 +69,7 @@ sensor_msgs::LaserScanPtr DepthImageToLaserScan::convert_msg(const sensor_msgs::
         const sensor_msgs::CameraInfoConstPtr& info_msg){
   // Set camera model
   // 设置相机模式
-  cam_model_.fromCameraInfo(info_msg);
+  const bool camera_changed = cam_model_.fromCameraInfo(info_msg);
 
   // Calculate angle_min and angle_max by measuring angles between the left ray, right ray, and optical center ray
   // 计算角度
@@ -145,6 +117,13 @@ sensor_msgs::LaserScanPtr DepthImageToLaserScan::convert_msg(const sensor_msgs::
   const uint32_t ranges_size = depth_msg->width;
   scan_msg->ranges.assign(ranges_size, std::numeric_limits<float>::quiet_NaN());
 
+  // Only rebuild the column LUT when the intrinsics or the image size changed.
+  // 只有相机参数或图像宽度变化时才重新计算查找表
+  if(camera_changed || column_lut_.width() != depth_msg->width){
+    build_column_lut(cam_model_.cx(), cam_model_.fx(), depth_msg->width, scan_msg->angle_min,
+                     scan_msg->angle_increment, ranges_size, &column_lut_);
+  }
+
   // 深度图转化为虚拟激光雷达信号
   if (depth_msg->encoding == sensor_msgs::image_encodings::TYPE_16UC1)
   {
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DEPTH_IMAGE_TO_LASERSCAN_DEPTH_BAND_CROP
+#define DEPTH_IMAGE_TO_LASERSCAN_DEPTH_BAND_CROP
+
+#include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/Image.h>
+
+namespace depthimage_to_laserscan
+{
+  /**
+   * Crops a depth image to the band of rows around the optical center which convert_msg() reads.
+   * 将深度图裁剪为convert_msg()实际读取的光心附近的若干行
+   *
+   * The band is band_height rows centered like the rows of convert_msg() with scan_height = band_height, plus one row
+   * on either side, so any scan_height <= band_height reads exactly the same pixels from the band as from the full
+   * image. The full width is kept. The principal point of K and P in band_info is moved up by the number of dropped
+   * rows, so the angles and the column lookup table of the converter do not change.
+   * 裁剪后的高度为band_height加上下各一行，任意scan_height <= band_height读取的像素与完整图像相同，宽度不变。
+   * band_info中K和P的光心按裁掉的行数平移，转换得到的角度和查找表不变。
+   *
+   * @param image Full resolution depth image.
+   * @param info CameraInfo of image, without ROI or binning.
+   * @param band_height Number of rows convert_msg() may read, the largest scan_height in use.
+   * @param band The cropped image, all fields are overwritten.
+   * @param band_info CameraInfo of band, all fields are overwritten.
+   *
+   */
+  void crop_band(const sensor_msgs::Image& image, const sensor_msgs::CameraInfo& info, int band_height,
+                 sensor_msgs::Image& band, sensor_msgs::CameraInfo& band_info);
+
+}; // depthimage_to_laserscan
+
+#endif
@@ -41,15 +41,20 @@
 
 #include <sensor_msgs/Image.h>
 #include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
 #include <sensor_msgs/image_encodings.h>
 #include <image_geometry/pinhole_camera_model.h>
-#include <depthimage_to_laserscan/depth_traits.h>
+#include <depth_scan_kernels/scan_conversion.h>
+#include <boost/shared_ptr.hpp>
 #include <sstream>
 #include <limits.h>
 #include <math.h>
 
 namespace depthimage_to_laserscan
 {
+  class CudaBackend;
+
   /**
    * -类DepthImageToLaserScan
    * --参数
@@ -68,6 +73,7 @@ namespace depthimage_to_laserscan
    * ---void set_range_limits(const float range_min, const float range_max);
    * ---void set_scan_height(const int scan_height);
    *  ---void set_output_frame(const std::string& output_frame_id);
+   *  ---void set_use_extrinsics(const bool use_extrinsics);
    *  ---double magnitude_of_ray(const cv::Point3d& ray) const;
    *  ---double angle_between_rays(const cv::Point3d& ray1, const cv::Point3d& ray2) const;
    *  ---bool use_point(const float new_value, const float old_value, const float range_min, const float range_max) const;
@@ -97,6 +103,53 @@ namespace depthimage_to_laserscan
     sensor_msgs::LaserScanPtr convert_msg(const sensor_msgs::ImageConstPtr& depth_msg,
 					   const sensor_msgs::CameraInfoConstPtr& info_msg);
     sensor_msgs::LaserScanPtr fusion_msg(sensor_msgs::LaserScanPtr& laser_scan, sensor_msgs::LaserScanPtr& scan_msg);
+
+    /**
+     * Converts the scan_height band into num_bands stacked rings of 3D points.
+     * 将扫描带分为num_bands个垂直子带，每个子带输出一圈三维点
+     *
+     * The band is split into num_bands sub-bands of scan_height / num_bands rows (remaining bottom rows are unused),
+     * num_bands is limited to scan_height.
+     * Every image column yields at most one point per sub-band: the closest depth within the range limits, placed at
+     * the elevation of the center row of the sub-band. The points are in output_frame_id with x forward, y left and
+     * z up, like the virtual scan, with the fields x, y, z (float32) and ring (uint16, 0 for the top sub-band).
+     * This keeps the height information of the band for 3D SLAM at a fraction of the size of a dense depth cloud.
+     * 每列在每个子带中最多输出一个点（范围内最近的深度，高度取子带中心行），坐标系与虚拟激光相同，字段为x、y、z和ring。
+     * 用于3D SLAM时保留高度信息，点数远小于稠密深度点云。
+     *
+     * @param depth_msg UInt16 or Float32 encoded depth image.
+     * @param info_msg CameraInfo associated with depth_msg
+     * @return The rings, empty if num_bands is 0.
+     *
+     */
+    sensor_msgs::PointCloud2Ptr convert_bands_msg(const sensor_msgs::ImageConstPtr& depth_msg,
+                                                  const sensor_msgs::CameraInfoConstPtr& info_msg);
+
+    /**
+     * Fuses a lidar scan with a virtual scan into a caller owned message.
+     * 将激光雷达数据与虚拟激光数据融合到调用者提供的消息中
+     *
+     * Unlike fusion_msg() the lidar scan is never copied or modified: the fused ranges are written straight into
+     * fused_msg, whose buffers are reused if they are already large enough. This allows recycling output messages.
+     * 与fusion_msg()不同，输入的雷达数据不会被拷贝或修改，融合结果直接写入fused_msg，已有的缓冲区会被复用。
+     *
+     * @param laser_msg The lidar scan.
+     * @param scan_msg The virtual scan from convert_msg().
+     * @param fused_msg The output, all fields are overwritten.
+     *
+     */
+    void fusion_into(const sensor_msgs::LaserScan& laser_msg, const sensor_msgs::LaserScan& scan_msg,
+                     sensor_msgs::LaserScan& fused_msg);
+
+    /**
+     * Fuses a virtual scan into an already fused scan, e.g. the output of fusion_into() for another camera.
+     * 将虚拟激光融合到已经融合过的数据中（例如另一个相机fusion_into()的结果）
+     *
+     * @param fused_msg Fused scan, updated in place.
+     * @param scan_msg The virtual scan from convert_msg().
+     *
+     */
+    void fusion_in_place(sensor_msgs::LaserScan& fused_msg, const sensor_msgs::LaserScan& scan_msg);
   
     /**
      * Sets the scan time parameter. 
@@ -151,6 +204,44 @@ namespace depthimage_to_laserscan
      */
     void set_output_frame(const std::string& output_frame_id);
 
+    /**
+     * Selects how the lidar beams are matched with the virtual scan.
+     * 选择雷达光束与虚拟激光的对应方式
+     *
+     * By default the virtual scan is expected to be rotated by 180° into the lidar frame and beams are matched by
+     * angle. With use_extrinsics each lidar beam is projected into the camera through the calibrated R/T/inv matrices
+     * (laser_to_kinect / kinect_to_laser_dis), and the virtual scan must be left in the camera frame.
+     * 默认虚拟激光旋转180°后按角度与雷达数据对应；开启use_extrinsics后通过标定的外参矩阵把雷达点投影到相机坐标系中，此时虚拟激光不需要旋转。
+     *
+     * @param use_extrinsics Whether to use the calibrated extrinsics.
+     *
+     */
+    void set_use_extrinsics(const bool use_extrinsics);
+    bool use_extrinsics() const { return use_extrinsics_; }
+
+    /**
+     * Runs the column reduction of convert_msg() and the angle matched fusion on the GPU.
+     * 在GPU上运行convert_msg()的逐列归约和按角度对应的融合
+     *
+     * Only has an effect when built with DEPTHIMAGE_TO_LASERSCAN_USE_CUDA and a CUDA device is present, otherwise (or
+     * when the device fails) the CPU path is used. The output is the same either way, see CudaBackend.
+     * 只有使用DEPTHIMAGE_TO_LASERSCAN_USE_CUDA编译且存在CUDA设备时生效，否则（或设备出错时）使用CPU，两者结果相同。
+     *
+     * @param use_gpu Whether to use the GPU.
+     *
+     */
+    void set_use_gpu(const bool use_gpu);
+    bool use_gpu() const { return use_gpu_; }
+
+    /**
+     * Sets the number of rings of convert_bands_msg(), 0 disables it. 设置convert_bands_msg()的子带数，0为不输出
+     *
+     * @param num_bands Number of sub-bands, values above scan_height give one ring per row.
+     *
+     */
+    void set_num_bands(const int num_bands);
+    int num_bands() const { return num_bands_; }
+
   private:
     /**
      * Computes euclidean length of a cv::Point3d (as a ray from origin)
@@ -216,50 +307,122 @@ namespace depthimage_to_laserscan
   // 
    template<typename T>
     void convert(const sensor_msgs::ImageConstPtr& depth_msg, const image_geometry::PinholeCameraModel& cam_model,
-        const sensor_msgs::LaserScanPtr& scan_msg, const int& scan_height) const{
-      // Use correct principal point from calibration
-      const float center_x = cam_model.cx();
-      const float center_y = cam_model.cy();
-
-      // Combine unit conversion (if necessary) with scaling by focal length for computing (X,Y)
-      const double unit_scaling = depthimage_to_laserscan::DepthTraits<T>::toMeters( T(1) );
-      const float constant_x = unit_scaling / cam_model.fx();
-
+        const sensor_msgs::LaserScanPtr& scan_msg, const int& scan_height){
       const T* depth_row = reinterpret_cast<const T*>(&depth_msg->data[0]);
       const int row_step = depth_msg->step / sizeof(T);
-
-      const int offset = (int)(center_y - scan_height/2);
+      const int offset = (int)(cam_model.cy() - scan_height/2);
       depth_row += offset*row_step; // Offset to center of image
-        // depth_row += (int)center_y*row_step;
-      for(int v = offset; v < offset+scan_height_; ++v, depth_row += row_step){
-        // for(int v = (int)center_y; v < center_y+scan_height_; ++v, depth_row += row_step){
-        //depth_msg->width = 1280
-        for (int u = 0; u < (int)depth_msg->width; ++u) // Loop over each pixel in row
-        {
-          const T depth = depth_row[u];
-
-          double r = depth; // Assign to pass through NaNs and Infs
-          const double th = -atan2((double)(u - center_x) * constant_x, unit_scaling); // Atan2(x, z), but depth divides out
-          const int index = (th - scan_msg->angle_min) / scan_msg->angle_increment;
-
-          if (depthimage_to_laserscan::DepthTraits<T>::valid(depth)){ // Not NaN or Inf
-            // Calculate in XYZ
-            double x = (u - center_x) * depth * constant_x;
-            double z = depthimage_to_laserscan::DepthTraits<T>::toMeters(depth);
-
-            // Calculate actual distance 计算激光的真实距离
-            r = hypot(x, z);
-          }
 
-          // Determine if this point should be used. 判断激光距离是否超出预设的有效范围
-          if(use_point(r, scan_msg->ranges[index], scan_msg->range_min, scan_msg->range_max)){
-            scan_msg->ranges[index] = r;
+      // Vertical min over the band, on the GPU or vectorized where available. 对扫描带逐列求最小值
+      convert_band<T>(depth_row, row_step, scan_height, column_lut_, scan_msg->range_min, scan_msg->range_max,
+                      &column_scratch_, &scan_msg->ranges[0], GpuColumnMinReduce(this));
+    }
+
+    // column_min_reduce() through gpu_column_min_reduce(), for convert_band().
+    struct GpuColumnMinReduce
+    {
+      explicit GpuColumnMinReduce(DepthImageToLaserScan* dtl) : dtl(dtl) {}
+
+      template<typename T>
+      void operator()(const T* rows, const int row_step, const int num_rows, const int width,
+                      const T* lo, const T* hi, T* out) const{
+        if(!dtl->gpu_column_min_reduce(rows, row_step, num_rows, width, lo, hi, out)){
+          column_min_reduce(rows, row_step, num_rows, width, lo, hi, out);
+        }
+      }
+
+      DepthImageToLaserScan* dtl;
+    };
+
+    /**
+     * Fills cloud with num_bands rings, see convert_bands_msg().
+     */
+    template<typename T>
+    void convert_bands(const sensor_msgs::Image& depth_msg, const int num_bands, sensor_msgs::PointCloud2& cloud){
+      const T* depth_row = reinterpret_cast<const T*>(&depth_msg.data[0]);
+      const int row_step = depth_msg.step / sizeof(T);
+      const int width = (int)depth_msg.width;
+      const int offset = (int)(cam_model_.cy() - scan_height_/2);
+      const int rows_per_band = scan_height_ / num_bands;
+      depth_row += offset*row_step;
+
+      // Same bounds as convert(). 与convert()相同的上下限
+      T* lo;
+      T* hi;
+      T* reduced;
+      column_scratch_.bounds<T>(column_lut_, range_min_, range_max_, &lo, &hi, &reduced);
+
+      sensor_msgs::PointCloud2Modifier modifier(cloud);
+      modifier.resize(width * num_bands);
+      sensor_msgs::PointCloud2Iterator<float> iter_x(cloud, "x");
+      sensor_msgs::PointCloud2Iterator<float> iter_y(cloud, "y");
+      sensor_msgs::PointCloud2Iterator<float> iter_z(cloud, "z");
+      sensor_msgs::PointCloud2Iterator<uint16_t> iter_ring(cloud, "ring");
+      size_t num_points = 0;
+      const double inverse_fx = 1.0 / cam_model_.fx();
+      const double inverse_fy = 1.0 / cam_model_.fy();
+      for(int band = 0; band < num_bands; ++band, depth_row += rows_per_band*row_step){
+        column_min_reduce(depth_row, row_step, rows_per_band, width, lo, hi, reduced);
+        const double center_row = offset + band*rows_per_band + 0.5*(rows_per_band - 1);
+        const double y_over_z = (center_row - cam_model_.cy()) * inverse_fy;
+        for(int u = 0; u < width; ++u){
+          if(reduced[u] == ColumnReduceTraits<T>::none()){
+            continue; // Nothing finite in range.
+          }
+          float depth = depthimage_to_laserscan::DepthTraits<T>::toMeters(reduced[u]);
+          float r = depth * column_lut_.scale[u];
+          if(r < range_min_ || r > range_max_){
+            // The minimum lies in the widened margin of the bounds, look for the closest exact match.
+            depth = std::numeric_limits<float>::infinity();
+            const T* pixel = depth_row + u;
+            for(int v = 0; v < rows_per_band; ++v, pixel += row_step){
+              if(!depthimage_to_laserscan::DepthTraits<T>::valid(*pixel)) continue;
+              const float d = depthimage_to_laserscan::DepthTraits<T>::toMeters(*pixel);
+              const float candidate = d * column_lut_.scale[u];
+              if(range_min_ <= candidate && candidate <= range_max_ && d < depth){
+                depth = d;
+              }
+            }
+            if(!std::isfinite(depth)){
+              continue;
+            }
           }
+          // Optical frame (x right, y down, z forward) to x forward, y left, z up.
+          *iter_x = depth;
+          *iter_y = -(u - cam_model_.cx()) * inverse_fx * depth;
+          *iter_z = -y_over_z * depth;
+          *iter_ring = band;
+          ++iter_x; ++iter_y; ++iter_z; ++iter_ring;
+          ++num_points;
         }
       }
-      
+      modifier.resize(num_points);
     }
 
+    /**
+     * CudaBackend versions of column_min_reduce() and of the angle matched loop of fuse_ranges(). They return false
+     * if the GPU is disabled, not available or failed, the caller then runs the CPU version.
+     */
+    bool gpu_column_min_reduce(const uint16_t* rows, int row_step, int num_rows, int width,
+                               const uint16_t* lo, const uint16_t* hi, uint16_t* out);
+    bool gpu_column_min_reduce(const float* rows, int row_step, int num_rows, int width,
+                               const float* lo, const float* hi, float* out);
+    bool gpu_fuse_ranges(const float* lidar, int num_beams, const sensor_msgs::LaserScan& scan_msg, float* fused);
+
+    /**
+     * Creates the CudaBackend on first use, disables the GPU if there is none.
+     */
+    CudaBackend* gpu_backend();
+
+    /**
+     * Rebuilds the per-column lookup table used by convert(), see build_column_lut().
+     *
+     * @param scan_msg The output LaserScan with angle_min and angle_increment already filled in.
+     * @param width Width of the depth image in pixels.
+     *
+     */
+    void update_column_lut(const sensor_msgs::LaserScanPtr& scan_msg, const uint32_t width);
+
     /**
      * sensor_msgs::LaserScan
      * 
@@ -335,21 +498,88 @@ namespace depthimage_to_laserscan
   // 数据融合代码
   sensor_msgs::LaserScanPtr fusion(sensor_msgs::LaserScanPtr& laser_msg,sensor_msgs::LaserScanPtr& scan_msg){
     // laser_msg为激光雷达数据，scan_msg为深度图转换的虚拟激光雷达数据
-    int scan_msg_num_direction = std::ceil((scan_msg->angle_max - scan_msg->angle_min) / scan_msg->angle_increment);
-    int laser_msg_num_direction = std::ceil((laser_msg->angle_max - laser_msg->angle_min) / laser_msg->angle_increment);
+    fuse_ranges(*laser_msg, *scan_msg, &laser_msg->ranges[0]);
+    return laser_msg;
+  }
+
+  // Writes min(lidar, virtual) for every lidar beam into 'fused', which may alias laser_msg.ranges.
+  // 将每个雷达光束的融合结果写入fused，fused可以与laser_msg.ranges为同一块内存
+  void fuse_ranges(const sensor_msgs::LaserScan& laser_msg, const sensor_msgs::LaserScan& scan_msg, float* fused){
+    if(fused != &laser_msg.ranges[0]){
+      std::copy(laser_msg.ranges.begin(), laser_msg.ranges.end(), fused);
+    }
+    update_fusion_map(laser_msg, scan_msg);
+    const int num_beams = fusion_bin_.size();
+    const float* lidar = &laser_msg.ranges[0];
+    const float* virtual_ranges = &scan_msg.ranges[0];
+
+    if(use_extrinsics_){
+      for(int i = 0; i < num_beams; ++i){
+        if(!std::isfinite(lidar[i])) continue;
+        // laser_to_kinect() with the angle dependent part taken from the map: p = r * a + b.
+        const double x = lidar[i] * extrinsic_ax_[i] + extrinsic_bx_;
+        const double z = lidar[i] * extrinsic_az_[i] + extrinsic_bz_;
+        if(z <= 0.0) continue; // Behind the camera
+        // Same convention as convert(): th = -atan2(x, z). 与convert()中的角度定义一致
+        const int j = (-std::atan2(x, z) - scan_msg.angle_min) / scan_msg.angle_increment;
+        if(j < 0 || j >= (int)scan_msg.ranges.size()) continue;
+        const float s = virtual_ranges[j];
+        const double d = std::sqrt(x*x + z*z);
+        if(std::isfinite(s) && s < d){
+          // The virtual obstacle lies on the same camera ray at range s, move it back into the lidar frame.
+          fused[i] = kinect_to_laser_dis(s * x / d, s * z / d);
+        }
+      }
+      return;
+    }
+
+    if(gpu_fuse_ranges(lidar, num_beams, scan_msg, fused)){
+      return;
+    }
+    for(int i = 0; i < num_beams; ++i){
+      if(!std::isfinite(lidar[i])) continue;  //循环遍历每个二元组(r,a)
+      float r = fused[i];
+      const int k0 = fusion_bin_[i].first;
+      const int k1 = fusion_bin_[i].second;
+      // NaN virtual ranges never compare smaller. 虚拟激光为NaN时比较结果为false
+      if(k0 >= 0) r = virtual_ranges[k0] < r ? virtual_ranges[k0] : r;
+      if(k1 >= 0) r = virtual_ranges[k1] < r ? virtual_ranges[k1] : r;
+      fused[i] = r;
+    }
+  }
+
+  // Rebuilds fusion_bin_ (and the extrinsic coefficients) when the geometry of either scan changes.
+  // 只有当两个扫描的角度参数变化时才重新计算雷达光束到虚拟激光的索引
+  void update_fusion_map(const sensor_msgs::LaserScan& laser_msg, const sensor_msgs::LaserScan& scan_msg){
+    const FusionMapKey key = {laser_msg.angle_min, laser_msg.angle_max, laser_msg.angle_increment,
+                              laser_msg.ranges.size(), scan_msg.angle_min, scan_msg.angle_max,
+                              scan_msg.angle_increment, scan_msg.ranges.size(), use_extrinsics_};
+    if(key == fusion_map_key_ && !fusion_bin_.empty()){
+      return;
+    }
+    fusion_map_key_ = key;
+    ++fusion_map_generation_;
+
+    int laser_msg_num_direction = std::ceil((laser_msg.angle_max - laser_msg.angle_min) / laser_msg.angle_increment);
+    laser_msg_num_direction = std::max(0, std::min(laser_msg_num_direction, (int)laser_msg.ranges.size()));
+    const int num_bins = scan_msg.ranges.size();
+    fusion_bin_.assign(laser_msg_num_direction, std::make_pair(-1, -1));
+    extrinsic_ax_.resize(laser_msg_num_direction);
+    extrinsic_az_.resize(laser_msg_num_direction);
+
+    // l is the height offset between camera and lidar used by laser_to_kinect().
+    const double l = 0.01;
+    extrinsic_bx_ = R[1][2]*l + T[1][1];
+    extrinsic_bz_ = R[3][2]*l + T[3][1];
+
     for(int i = 0; i < laser_msg_num_direction; ++i){
-      
-      if(!std::isfinite(laser_msg->ranges[i])) continue;  //循环遍历每个二元组(r,a)
       /**
        * 思路：因为雷达和相机在实际的摆放中距离很近，并且是平行放置，所以与障碍物之间的差值选择了忽略，
-       * 如果放置的较远、非平行放置或对精度有要求，可以使用kinect_to_laser_dis()函数
+       * 如果放置的较远、非平行放置或对精度有要求，可以使用kinect_to_laser_dis()函数（use_extrinsics）
        * */
-      // kinect_Triplet kinect_Triplet_temp = laser_to_kinect(laser_msg->ranges[i],(laser_msg->angle_min+laser_msg->angle_increment*i));
-      // std::pair<double,double> virtual_laser_scan_temp = virtual_laser_scan(kinect_Triplet_temp); //temp.first = d,temp.second = a
-      // int j = (virtual_laser_scan_temp.second - scan_msg->angle_min) / scan_msg->angle_increment; //获取该点在scan_msg中是第几个点
-      // double range = 0.0;
-      // if(!std::isfinite(scan_msg->ranges[j])) continue;
-      
+      double l_angle = laser_msg.angle_min+laser_msg.angle_increment*i;
+      extrinsic_ax_[i] = R[1][1]*std::sin(l_angle) + R[1][3]*std::cos(l_angle);
+      extrinsic_az_[i] = R[3][1]*std::sin(l_angle) + R[3][3]*std::cos(l_angle);
 
       /**
        * 测试直接相机坐标系旋转
@@ -361,30 +591,40 @@ namespace depthimage_to_laserscan
        *           而zed2是双目视觉形成的深度图这一点也是在师兄的提醒下才发现的。使用zed2标定出现问题后在代码中直接进行旋转，而后续换成d435i后因为
        *           时间问题就忘记了标定，而直接只用了该代码。因为两种相机形成深度图的原理不同，所以出现这种尴尬的境况。
        * */
-      double l_angle = laser_msg->angle_min+laser_msg->angle_increment*i;
       double pi = 3.1415926535;
       
-      if(l_angle > scan_msg->angle_min && l_angle < scan_msg->angle_max){ //如果对应角度在虚拟激光范围内，则对两个数据进行对比，选择较小的作为融合数据
-        int k = (l_angle - scan_msg->angle_min )/scan_msg->angle_increment;
+      if(l_angle > scan_msg.angle_min && l_angle < scan_msg.angle_max){ //如果对应角度在虚拟激光范围内，则对两个数据进行对比，选择较小的作为融合数据
+        int k = (l_angle - scan_msg.angle_min )/scan_msg.angle_increment;
         //如果深度图抖动的比较厉害，可以选择添加条件fabs(scan_msg->ranges[k] - laser_msg->ranges[i]) > 0.1 ,
         // 即虚拟数据与激光数据的差值大于10厘米才更新，好处是可以消除一些散乱点，坏处是对墙边的障碍物信息有较大影响
         // 好在TOF得到的深度图虽然抖动，但是抖动幅度很小，基本上可以忽略
 	// 如果想提高精度最好还是滤波，但是。。。我太菜了，没学
-          if(scan_msg->ranges[k] < laser_msg->ranges[i])  
-            laser_msg->ranges[i] = scan_msg->ranges[k];
-
+        // 现在可以在融合之前用TemporalFilter对虚拟激光做中值/滑动平均滤波（参数temporal_filter）
+        if(k < num_bins) fusion_bin_[i].first = k;
       }
-      if(l_angle+2.0*pi > scan_msg->angle_min && l_angle+2.0*pi < scan_msg->angle_max){ //手动旋转的角度可能会导致虚拟激光角度大于pi，所以需要额外判断大于pi的部分
-        int k = (l_angle+2*pi - scan_msg->angle_min )/scan_msg->angle_increment;
-        if(scan_msg->ranges[k] < laser_msg->ranges[i])
-          laser_msg->ranges[i] = scan_msg->ranges[k];
+      if(l_angle+2.0*pi > scan_msg.angle_min && l_angle+2.0*pi < scan_msg.angle_max){ //手动旋转的角度可能会导致虚拟激光角度大于pi，所以需要额外判断大于pi的部分
+        int k = (l_angle+2*pi - scan_msg.angle_min )/scan_msg.angle_increment;
+        if(k < num_bins) fusion_bin_[i].second = k;
       }
-    
-
     }
-
-    return laser_msg;
   }
+
+  // Geometry the fusion map was built for. 索引表对应的扫描参数
+  struct FusionMapKey{
+    float laser_angle_min, laser_angle_max, laser_angle_increment;
+    size_t laser_size;
+    float scan_angle_min, scan_angle_max, scan_angle_increment;
+    size_t scan_size;
+    bool use_extrinsics;
+
+    bool operator==(const FusionMapKey& other) const{
+      return laser_angle_min == other.laser_angle_min && laser_angle_max == other.laser_angle_max &&
+             laser_angle_increment == other.laser_angle_increment && laser_size == other.laser_size &&
+             scan_angle_min == other.scan_angle_min && scan_angle_max == other.scan_angle_max &&
+             scan_angle_increment == other.scan_angle_increment && scan_size == other.scan_size &&
+             use_extrinsics == other.use_extrinsics;
+    }
+  };
   
 
 
@@ -397,6 +637,22 @@ namespace depthimage_to_laserscan
     float range_max_; ///< Stores the current maximum range to use.存储要使用的最大范围
     int scan_height_; ///< Number of pixel rows to use when producing a laserscan from an area.从区域内生成激光扫描时使用的像素行数
     std::string output_frame_id_; ///< Output frame_id for each laserscan.  This is likely NOT the camera's frame_id.输出的帧的id是每个激光帧的id，但不一定是相机帧的id
+
+    ColumnLut column_lut_; ///< Scan bin and depth to range factor of each image column. 每列对应的激光索引和缩放系数
+    ColumnScratch column_scratch_; ///< Scratch space of convert() and convert_bands().
+
+    bool use_extrinsics_; ///< Fuse through the calibrated extrinsics instead of the fixed 180° rotation. 是否使用标定的外参进行融合
+    FusionMapKey fusion_map_key_; ///< Scan geometry fusion_bin_ was computed for.
+    int fusion_map_generation_; ///< Incremented whenever fusion_bin_ is rebuilt.
+    std::vector<std::pair<int, int> > fusion_bin_; ///< Virtual scan bins of each lidar beam (direct, +2pi), -1 if none. 雷达光束对应的虚拟激光索引
+    std::vector<double> extrinsic_ax_; ///< Per-beam x coefficient of the lidar to camera projection.
+    std::vector<double> extrinsic_az_; ///< Per-beam z coefficient of the lidar to camera projection.
+    double extrinsic_bx_; ///< Constant x offset of the lidar to camera projection.
+    double extrinsic_bz_; ///< Constant z offset of the lidar to camera projection.
+
+    int num_bands_; ///< Number of rings of convert_bands_msg(). 子带数
+    bool use_gpu_; ///< Run the column reduction and the fusion on the GPU. 是否使用GPU
+    boost::shared_ptr<CudaBackend> gpu_; ///< Created on first use, never without DEPTHIMAGE_TO_LASERSCAN_USE_CUDA.
   };
 
 
@@ -43,10 +43,7 @@
 #include <depthimage_to_laserscan/DepthConfig.h>
 
 #include <depthimage_to_laserscan/DepthImageToLaserScan.h>
-#include <message_filters/subscriber.h>
-#include <message_filters/synchronizer.h>
-#include <message_filters/sync_policies/approximate_time.h>
-#include <message_filters/sync_policies/exact_time.h>
+#include <depthimage_to_laserscan/DepthLidarFusion.h>
 
 namespace depthimage_to_laserscan
 {
@@ -75,11 +72,23 @@ namespace depthimage_to_laserscan
      * laserscan的订阅回调
      * */
     void laserCb(const sensor_msgs::LaserScan::ConstPtr& laser_msg);
+
     /**
-     * 时间同步回调
-     * */
-    void syncCb(const sensor_msgs::ImageConstPtr& ori_depth,const sensor_msgs::CameraInfoConstPtr& ori_camera,
-              const sensor_msgs::LaserScanConstPtr& ori_laser);
+     * Publish callbacks of fusion_ for the fused scan (/scan) and the virtual scan (/depth_scan).
+     * 融合结果（/scan）与虚拟激光（/depth_scan）的发布回调
+     */
+    void fusedCb(const sensor_msgs::LaserScanConstPtr& msg);
+    void virtualCb(const sensor_msgs::LaserScanConstPtr& msg);
+
+    /**
+     * Publish callback of fusion_ for the rings of the depth band (/depth_bands). 多子带三维点（/depth_bands）的发布回调
+     */
+    void bandsCb(const sensor_msgs::PointCloud2ConstPtr& msg);
+
+    /**
+     * Publish callback of fusion_ for the voxel filtered point cloud (/depth_cloud). 体素点云（/depth_cloud）的发布回调
+     */
+    void cloudCb(const sensor_msgs::PointCloud2ConstPtr& msg);
     /**
      * Callback that is called when there is a new subscriber.
      * 当有新订阅时调用的回调函数
@@ -124,18 +133,14 @@ namespace depthimage_to_laserscan
      *             )	
      * */
     image_transport::CameraSubscriber sub_; ///< Subscriber for image_transport 图像传输订阅
-    message_filters::Subscriber<sensor_msgs::LaserScan> *scan_sub_;
-    message_filters::Subscriber<sensor_msgs::CameraInfo> *camera_sub_;
-    message_filters::Subscriber<sensor_msgs::Image> *image_sub_;
-    typedef message_filters::sync_policies::ApproximateTime<sensor_msgs::Image,sensor_msgs::CameraInfo,sensor_msgs::LaserScan> MySyncPolicy;
-    message_filters::Synchronizer<MySyncPolicy> *sync_;
-
     ros::Subscriber* laser_sub_;
     ros::Publisher pub_; ///< Publisher for output LaserScan messages 输出激光扫描信息的发布者
     ros::Publisher pubs_;
+    ros::Publisher bands_pub_; ///< Rings of convert_bands_msg(), only filled while num_bands > 0.
+    ros::Publisher cloud_pub_; ///< DepthVoxelCloud output, only filled while voxel_cloud_size > 0.
     dynamic_reconfigure::Server<depthimage_to_laserscan::DepthConfig> srv_; ///< Dynamic reconfigure server 动态重新配置服务器
 
-    depthimage_to_laserscan::DepthImageToLaserScan dtl_; ///< Instance of the DepthImageToLaserScan conversion class. deptimageTolaserscan转换类的实例。
+    depthimage_to_laserscan::DepthLidarFusion fusion_; ///< Synchronization, conversion and fusion pipeline. 同步、转换与融合流程
 
     boost::mutex connect_mutex_; ///< Prevents the connectCb and disconnectCb from being called until everything is initialized. 防止在初始化所有内容之前调用connectCb和disconnectCb。
   };
@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DEPTH_IMAGE_TO_LASERSCAN_DEPTH_LIDAR_FUSION
+#define DEPTH_IMAGE_TO_LASERSCAN_DEPTH_LIDAR_FUSION
+
+#include <ros/ros.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <deque>
+#include <utility>
+
+#include <depthimage_to_laserscan/DepthImageToLaserScan.h>
+#include <depthimage_to_laserscan/DepthVoxelCloud.h>
+#include <depthimage_to_laserscan/FusionMetrics.h>
+#include <depthimage_to_laserscan/TemporalFilter.h>
+#include <message_filters/subscriber.h>
+#include <message_filters/synchronizer.h>
+#include <message_filters/sync_policies/approximate_time.h>
+
+namespace depthimage_to_laserscan
+{
+  /**
+   * Depth camera / lidar fusion pipeline without any publisher.
+   * 不依赖发布者的深度相机/激光雷达融合流程
+   *
+   * Synchronizes depth image, camera info and lidar scan, converts the depth image into a virtual scan and fuses it
+   * into the lidar scan. Results are handed to callbacks, so the pipeline can either be wrapped by a ROS node
+   * (DepthImageToLaserScanROS) or hosted in-process by a consumer such as the Cartographer node, which avoids the
+   * serialization and the topic hop of /scan.
+   * 同步深度图、相机参数和雷达数据，将深度图转换为虚拟激光并与雷达数据融合。结果通过回调函数交出，既可以由ROS节点发布，
+   * 也可以直接在Cartographer节点进程内使用，省去/scan话题的序列化和传输。
+   *
+   * Without cameras added through addCamera() a single depth camera is used and every fused scan waits for the
+   * ApproximateTime synchronization of the three topics. With one or more cameras added, every camera converts its
+   * frames on its own worker thread with its own lookup tables, and every lidar scan is fused with the latest virtual
+   * scan of each camera that is not older than that camera's staleness limit, so a slow camera never stalls the lidar.
+   * 通过addCamera()添加相机后，每个相机在各自的线程中使用各自的查找表进行转换；每帧雷达数据与各相机最新且未过期的虚拟激光融合，
+   * 慢的相机不会阻塞雷达的发布频率。
+   */
+  class DepthLidarFusion
+  {
+  public:
+    typedef boost::function<void(const sensor_msgs::LaserScanConstPtr&)> ScanCallback;
+    typedef boost::function<void(const sensor_msgs::PointCloud2ConstPtr&)> CloudCallback;
+
+    /**
+     * When a fused scan passed the stages of the fusion, in ROS time like its header stamp, so that a consumer can
+     * break down the latency from the sensor to its own processing of the scan.
+     * 融合结果经过各阶段的时间（ROS时间），用于统计从传感器到下游处理的延迟
+     */
+    struct StageStamps
+    {
+      ros::Time received; ///< The lidar scan was received. 收到雷达数据
+      ros::Time synchronized; ///< The synchronizer emitted it, same as received without the sync. 同步完成
+      ros::Time fused; ///< The fused scan was handed to the callback. 融合完成
+    };
+    typedef boost::function<void(const sensor_msgs::LaserScanConstPtr&, const StageStamps&)> StampedScanCallback;
+
+    /**
+     * @param fused_callback Called with every fused scan. 每帧融合结果的回调
+     * @param virtual_callback Optional, called with every virtual scan converted from the depth image. 虚拟激光的回调（可选）
+     */
+    explicit DepthLidarFusion(const ScanCallback& fused_callback,
+                              const ScanCallback& virtual_callback = ScanCallback());
+
+    ~DepthLidarFusion();
+
+    /**
+     * Sets the callback for the rings of DepthImageToLaserScan::convert_bands_msg(), called for every converted depth
+     * image while num_bands is positive. Must be called before subscribe().
+     * 设置多子带三维点的回调，num_bands大于0时每帧深度图调用一次，必须在subscribe()之前调用
+     */
+    void setBandsCallback(const CloudCallback& bands_callback);
+
+    /**
+     * Makes fused scans go to stamped_callback together with their StageStamps instead of to the fused callback.
+     * Must be called before subscribe().
+     * 设置带各阶段时间的融合结果回调，替代构造时的回调，必须在subscribe()之前调用
+     */
+    void setStampedFusedCallback(const StampedScanCallback& stamped_callback);
+
+    /**
+     * Sets the callback for the voxel filtered point clouds of DepthVoxelCloud, called for every converted depth image
+     * while the voxel size is positive. The single-camera mode fuses the synchronized lidar scan into the cloud.
+     * Must be called before subscribe().
+     * 设置体素点云的回调，单相机模式下同步的雷达数据也加入点云，必须在subscribe()之前调用
+     */
+    void setCloudCallback(const CloudCallback& cloud_callback);
+
+    /**
+     * Adds a depth camera, switching to multi-camera mode. Must be called before subscribe().
+     * 添加一个深度相机（多相机模式），必须在subscribe()之前调用
+     *
+     * @param name Name used in log messages.
+     * @param depth_topic Depth image topic of this camera.
+     * @param info_topic CameraInfo topic of this camera.
+     * @param yaw_offset Rotation added to the virtual scan angles to bring them into the lidar frame (ignored with
+     *                   use_extrinsics). 虚拟激光旋转到雷达坐标系的角度
+     * @param max_staleness Maximum time in seconds between a lidar scan and a virtual scan fused into it.
+     *                      雷达数据与虚拟激光之间允许的最大时间差
+     */
+    void addCamera(const std::string& name, const std::string& depth_topic, const std::string& info_topic,
+                   double yaw_offset, double max_staleness);
+
+    /**
+     * Adds the cameras listed in the 'cameras' parameter of nh. For every name, 'name/depth_topic',
+     * 'name/info_topic', 'name/yaw_offset' and 'name/max_staleness' are read. Without 'cameras', setting
+     * 'lidar_fast_path' adds the default camera so that lidar scans are published without waiting for depth
+     * frames, fused only with a virtual scan at most 'max_depth_age' seconds away.
+     * 根据参数'cameras'中列出的名字添加相机；未设置时可以通过'lidar_fast_path'使用单相机非阻塞模式
+     */
+    void addCamerasFromParams(const ros::NodeHandle& nh);
+
+    /**
+     * Subscribes to the depth image, camera info and lidar topics through nh.
+     * 通过nh订阅深度图、相机参数和雷达话题
+     */
+    void subscribe(ros::NodeHandle& nh);
+
+    /**
+     * Stops all subscriptions. 取消所有订阅
+     */
+    void unsubscribe();
+
+    bool subscribed() const { return sync_ != nullptr || laser_sub_; }
+
+    /**
+     * Converts and fuses one synchronized triple and invokes the callbacks.
+     * 对一组同步的数据进行转换和融合，并调用回调函数
+     *
+     * @throw std::runtime_error if the depth image cannot be converted.
+     */
+    void process(const sensor_msgs::ImageConstPtr& depth_msg, const sensor_msgs::CameraInfoConstPtr& info_msg,
+                 const sensor_msgs::LaserScanConstPtr& laser_msg);
+
+    /**
+     * Reads scan_height, scan_time, range_min, range_max, output_frame_id, use_extrinsics, use_gpu, num_bands, the
+     * voxel_cloud_* parameters and lidar_to_camera from nh, using the
+     * defaults of cfg/Depth.cfg for missing parameters. Also adds the cameras from addCamerasFromParams().
+     * 从参数服务器读取转换参数，缺省值与cfg/Depth.cfg一致
+     */
+    void configureFromParams(const ros::NodeHandle& nh);
+
+    /**
+     * Applies f to every converter, e.g. for dynamic reconfigure. 对所有转换对象调用f（例如动态参数配置）
+     */
+    void configureConverters(const boost::function<void(DepthImageToLaserScan&)>& f);
+
+    /**
+     * Configures the temporal filter applied to the virtual scans of every camera before fusion, see TemporalFilter.
+     * 配置融合前对各相机虚拟激光进行的时间滤波
+     */
+    void configureTemporalFilter(TemporalFilter::Mode mode, int window, double alpha);
+
+    /**
+     * Configures the voxel cloud of every camera, see DepthVoxelCloud::configure(). 配置各相机的体素点云
+     */
+    void configureVoxelCloud(double voxel_size, int stride, double max_range);
+
+    /**
+     * Sets the lidar to camera transform of the voxel clouds, see DepthVoxelCloud::set_lidar_to_camera().
+     */
+    void setLidarToCamera(const std::vector<double>& lidar_to_camera);
+
+  private:
+    typedef message_filters::sync_policies::ApproximateTime<sensor_msgs::Image,sensor_msgs::CameraInfo,sensor_msgs::LaserScan> SyncPolicy;
+    typedef message_filters::sync_policies::ApproximateTime<sensor_msgs::Image,sensor_msgs::CameraInfo> CameraSyncPolicy;
+
+    // One depth camera of the multi-camera mode. 多相机模式中的一个深度相机
+    struct Camera{
+      std::string name;
+      std::string depth_topic;
+      std::string info_topic;
+      double yaw_offset;
+      double max_staleness;
+
+      boost::mutex convert_mutex; ///< Held by the worker while converting. 转换时持有
+      DepthImageToLaserScan converter; ///< Guarded by convert_mutex. 由convert_mutex保护
+      TemporalFilter filter; ///< Guarded by convert_mutex.
+      DepthVoxelCloud voxel_cloud; ///< Guarded by convert_mutex.
+      DepthImageToLaserScan fuser; ///< Only used by laserCb, keeps the fusion map of this camera. 仅由laserCb使用
+
+      boost::scoped_ptr<message_filters::Subscriber<sensor_msgs::Image> > image_sub;
+      boost::scoped_ptr<message_filters::Subscriber<sensor_msgs::CameraInfo> > info_sub;
+      boost::scoped_ptr<message_filters::Synchronizer<CameraSyncPolicy> > sync;
+
+      boost::mutex mutex;
+      boost::condition_variable condition;
+      bool running; ///< Guarded by mutex.
+      sensor_msgs::ImageConstPtr pending_depth; ///< Latest frame not yet converted, guarded by mutex.
+      sensor_msgs::CameraInfoConstPtr pending_info; ///< Guarded by mutex.
+      sensor_msgs::LaserScanConstPtr latest_scan; ///< Latest virtual scan, guarded by mutex.
+      boost::thread worker;
+    };
+
+    void cameraCb(Camera* camera, const sensor_msgs::ImageConstPtr& depth_msg,
+                  const sensor_msgs::CameraInfoConstPtr& info_msg);
+    void cameraWorker(Camera* camera);
+    void laserCb(const sensor_msgs::LaserScanConstPtr& laser_msg);
+    void countQueued(FusionMetrics::Topic topic);
+    // Remembers when the lidar scan was received, for its StageStamps.
+    void laserReceived(const sensor_msgs::LaserScanConstPtr& laser_msg);
+    // Converts and fuses like process(), with the stamps of the stages before.
+    void processStamped(const sensor_msgs::ImageConstPtr& depth_msg, const sensor_msgs::CameraInfoConstPtr& info_msg,
+                        const sensor_msgs::LaserScanConstPtr& laser_msg, StageStamps stamps);
+    // Hands msg to the fused callback and records the publish latency and the scan age.
+    void publishFused(const sensor_msgs::LaserScanConstPtr& msg, StageStamps stamps);
+
+    void syncCb(const sensor_msgs::ImageConstPtr& depth_msg, const sensor_msgs::CameraInfoConstPtr& info_msg,
+                const sensor_msgs::LaserScanConstPtr& laser_msg);
+
+    /**
+     * Returns an output message for the fused scan, recycled from fused_pool_ when possible.
+     * 从fused_pool_中取出一个可复用的融合输出消息
+     *
+     * A pooled message is only reused once nobody else holds it, i.e. every subscriber (including intra-process
+     * nodelet subscribers, which receive the same shared pointer) and the publisher queue have released it.
+     * 只有当所有订阅者和发布队列都释放了消息之后才会复用
+     */
+    sensor_msgs::LaserScanPtr acquireFusedMsg();
+
+    ScanCallback fused_callback_;
+    StampedScanCallback stamped_callback_;
+    ScanCallback virtual_callback_;
+    CloudCallback bands_callback_;
+    CloudCallback cloud_callback_;
+
+    boost::scoped_ptr<message_filters::Subscriber<sensor_msgs::Image> > image_sub_;
+    boost::scoped_ptr<message_filters::Subscriber<sensor_msgs::CameraInfo> > camera_sub_;
+    boost::scoped_ptr<message_filters::Subscriber<sensor_msgs::LaserScan> > scan_sub_;
+    boost::scoped_ptr<message_filters::Synchronizer<SyncPolicy> > sync_;
+    ros::Subscriber laser_sub_; ///< Lidar subscriber of the multi-camera mode.
+    int queued_[FusionMetrics::NUM_TOPICS]; ///< Messages per topic received since the last synchronized set.
+    std::deque<std::pair<ros::Time, ros::Time> > laser_received_; ///< Header stamp and receive time of queued scans.
+    std::vector<boost::shared_ptr<Camera> > cameras_;
+
+    depthimage_to_laserscan::DepthImageToLaserScan dtl_; ///< Instance of the DepthImageToLaserScan conversion class. deptimageTolaserscan转换类的实例。
+    TemporalFilter filter_; ///< Temporal filter of the single-camera sync path.
+    DepthVoxelCloud voxel_cloud_; ///< Voxel cloud of the single-camera sync path.
+    std::vector<sensor_msgs::LaserScanPtr> fused_pool_; ///< Recycled fused scan messages, see acquireFusedMsg(). 可复用的融合消息
+  };
+
+}; // depthimage_to_laserscan
+
+#endif
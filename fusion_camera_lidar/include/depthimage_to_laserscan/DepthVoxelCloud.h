@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DEPTH_IMAGE_TO_LASERSCAN_DEPTH_VOXEL_CLOUD
+#define DEPTH_IMAGE_TO_LASERSCAN_DEPTH_VOXEL_CLOUD
+
+#include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <stdint.h>
+#include <vector>
+
+namespace depthimage_to_laserscan
+{
+  /**
+   * Back-projects a depth image straight into a voxel filtered point cloud for Cartographer 3D.
+   * 将深度图直接反投影为体素滤波后的点云，供Cartographer 3D使用
+   *
+   * Every 'stride'-th pixel of every 'stride'-th row is back-projected and only the first point of each voxel is
+   * kept, using the same voxel indexing as Cartographer's VoxelFilter. With voxel_size equal to the trajectory
+   * builder's voxel_filter_size most of the points are dropped here instead of being serialized and filtered again.
+   * Lidar returns are inserted before the depth points, so a voxel seen by both keeps the lidar point.
+   * 每隔stride行、stride列反投影一个像素，每个体素只保留第一个点（体素索引与Cartographer的VoxelFilter相同）。
+   * voxel_size与voxel_filter_size相同时大部分点在这里就被去掉。雷达点先于深度点插入，两者落在同一体素时保留雷达点。
+   *
+   * The cloud is in the optical frame of the depth image (x right, y down, z forward) with float32 x, y, z fields.
+   * The voxel table is reused between frames and only grows.
+   */
+  class DepthVoxelCloud
+  {
+  public:
+    DepthVoxelCloud();
+
+    /**
+     * @param voxel_size Edge length of the voxels in meters, 0 disables the cloud.
+     * @param stride Pixel step in both image directions, at least 1.
+     * @param max_range Depth points farther than this (in meters) are dropped.
+     *
+     */
+    void configure(double voxel_size, int stride, double max_range);
+
+    /**
+     * Sets the 3x4 row-major transform from the lidar frame to the optical frame of the camera.
+     * 设置雷达坐标系到相机光学坐标系的3x4变换矩阵（按行存储）
+     *
+     * The default is the convention of the angle matched fusion: the lidar sits at the camera, rotated by 180°
+     * about the vertical axis.
+     */
+    void set_lidar_to_camera(const std::vector<double>& lidar_to_camera);
+
+    bool enabled() const { return voxel_size_ > 0.0; }
+
+    /**
+     * Fills cloud from depth_msg and, if not NULL, the returns of laser_msg.
+     * 由深度图（以及可选的雷达数据）生成点云
+     *
+     * @param depth_msg UInt16 or Float32 encoded depth image.
+     * @param info_msg CameraInfo associated with depth_msg.
+     * @param laser_msg Optional lidar scan fused into the cloud.
+     * @param cloud The output, all fields are overwritten.
+     * @throw std::runtime_error for unsupported encodings.
+     *
+     */
+    void convert(const sensor_msgs::Image& depth_msg, const sensor_msgs::CameraInfo& info_msg,
+                 const sensor_msgs::LaserScan* laser_msg, sensor_msgs::PointCloud2& cloud);
+
+  private:
+    struct Voxel
+    {
+      uint64_t key;
+      uint32_t generation; ///< The voxel is empty unless this is the current generation.
+    };
+
+    template<typename T>
+    void insert_depth(const sensor_msgs::Image& depth_msg, const sensor_msgs::CameraInfo& info_msg);
+    void insert_laser(const sensor_msgs::LaserScan& laser_msg);
+
+    // Appends the point unless its voxel is taken already.
+    void insert(float x, float y, float z);
+    // Makes room for max_points points and starts a new generation.
+    void reset(size_t max_points);
+
+    double voxel_size_;
+    int stride_;
+    double max_range_;
+    double lidar_to_camera_[12];
+
+    std::vector<Voxel> voxels_; ///< Open addressing table, size is a power of two.
+    int num_bits_; ///< log2 of voxels_.size().
+    uint32_t generation_;
+    std::vector<float> points_; ///< x, y, z of the kept points.
+  };
+
+}; // depthimage_to_laserscan
+
+#endif
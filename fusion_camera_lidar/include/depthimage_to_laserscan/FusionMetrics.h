@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DEPTH_IMAGE_TO_LASERSCAN_FUSION_METRICS
+#define DEPTH_IMAGE_TO_LASERSCAN_FUSION_METRICS
+
+namespace cartographer
+{
+  namespace metrics
+  {
+    class FamilyFactory;
+  }
+}
+
+namespace depthimage_to_laserscan
+{
+  /**
+   * Latency and drop metrics of DepthLidarFusion, recorded through the cartographer::metrics families.
+   * 融合流程各阶段的耗时与丢帧统计，使用cartographer::metrics记录
+   *
+   * All metrics are no-ops until RegisterMetrics() is called, so that the Cartographer node can export them next to
+   * the SLAM metrics when the fusion runs in-process (cartographer_node -collect_metrics -in_process_depth_fusion).
+   * The package has to be built against libcartographer for this, see DEPTHIMAGE_TO_LASERSCAN_HAS_METRICS.
+   * 调用RegisterMetrics()之前所有统计均不生效；在cartographer_node进程内运行融合时，这些统计与SLAM的统计一起导出。
+   */
+  class FusionMetrics
+  {
+  public:
+    enum Stage
+    {
+      SYNC_WAIT = 0, ///< Newest header stamp of a synchronized set to its callback. 同步等待
+      CONVERT, ///< convert_msg(). 深度图转换
+      FILTER, ///< TemporalFilter::apply(). 时间滤波
+      FUSION, ///< fusion_into() / fusion_in_place(). 数据融合
+      PUBLISH, ///< The fused scan callback, i.e. publishing or handing the scan to Cartographer. 发布
+      NUM_STAGES
+    };
+
+    enum Topic
+    {
+      DEPTH = 0,
+      CAMERA_INFO,
+      LASER,
+      NUM_TOPICS
+    };
+
+    enum Drop
+    {
+      SYNC = 0, ///< Lidar scans the synchronizer never emitted in a set. 未被同步器输出的雷达数据
+      STALE_DEPTH, ///< Lidar scans published without or with fewer virtual scans because a camera was late.
+      OVERWRITTEN_DEPTH, ///< Depth frames replaced by a newer one before being converted. 未转换就被覆盖的深度图
+      NUM_DROPS
+    };
+
+    /**
+     * Creates the metric families in family_factory. Not thread-safe, call before subscribing.
+     * 在family_factory中创建统计项，需要在订阅之前调用
+     */
+    static void RegisterMetrics(cartographer::metrics::FamilyFactory* family_factory);
+
+    static void ObserveStage(Stage stage, double seconds);
+
+    /**
+     * Records the age of a published scan, i.e. the time between its header stamp and the end of PUBLISH.
+     * 记录发布时距离数据时间戳的时间
+     */
+    static void ObserveScanAge(double seconds);
+
+    /**
+     * Records the number of messages of topic received since the last synchronized set. 同步队列长度
+     */
+    static void SetSyncQueueDepth(Topic topic, int depth);
+
+    static void IncrementDropped(Drop reason, int count = 1);
+  };
+
+}; // depthimage_to_laserscan
+
+#endif
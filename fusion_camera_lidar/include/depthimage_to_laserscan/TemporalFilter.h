@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DEPTH_IMAGE_TO_LASERSCAN_TEMPORAL_FILTER
+#define DEPTH_IMAGE_TO_LASERSCAN_TEMPORAL_FILTER
+
+#include <sensor_msgs/LaserScan.h>
+#include <boost/align/aligned_allocator.hpp>
+#include <vector>
+
+namespace depthimage_to_laserscan
+{
+  /**
+   * Per-bin temporal filter over the last virtual scans of one camera, applied before fusion.
+   * 对同一相机最近若干帧虚拟激光逐个角度做时间滤波，在融合之前使用
+   *
+   * A single spurious near return wins the min-selection of the fusion and makes the grid flip cells back and forth.
+   * The median over the last 'window' scans removes such outliers, the exponential moving average smooths the
+   * jitter of the depth image. Ranges are kept in a ring buffer of 'window' rows, each row aligned to a cache line;
+   * memory is only allocated when the configuration or the number of bins changes.
+   * 单帧的近距离噪点会在融合的最小值选择中胜出，使栅格反复翻转。中值滤波去除这类噪点，指数滑动平均用于平滑深度抖动。
+   * 数据保存在按缓存行对齐的环形缓冲区中，只有配置或角度个数变化时才会分配内存。
+   */
+  class TemporalFilter
+  {
+  public:
+    enum Mode
+    {
+      NONE = 0, ///< Scans are passed through. 不滤波
+      MEDIAN = 1, ///< Median of the non NaN ranges of the last 'window' scans. 中值滤波
+      EMA = 2 ///< Exponential moving average of the finite ranges. 指数滑动平均
+    };
+
+    static const int kMaxWindow = 15; ///< Upper bound of the median window.
+
+    TemporalFilter();
+
+    /**
+     * Sets the filter mode, clearing the history.
+     * 设置滤波方式，并清空历史数据
+     *
+     * @param mode Filter mode.
+     * @param window Number of scans of the median, clamped to [1, kMaxWindow].
+     * @param alpha Weight of the newest scan for the EMA, clamped to (0, 1].
+     *
+     */
+    void configure(Mode mode, int window, double alpha);
+
+    /**
+     * Filters the ranges of scan in place. The history is restarted whenever the number of ranges changes.
+     * 原地滤波scan的距离值，角度个数变化时重新开始
+     *
+     * @param scan Newest virtual scan.
+     *
+     */
+    void apply(sensor_msgs::LaserScan& scan);
+
+    /**
+     * Drops the history, e.g. after the camera was unsubscribed. 清空历史数据
+     */
+    void reset();
+
+    Mode mode() const { return mode_; }
+
+  private:
+    void applyMedian(std::vector<float>& ranges);
+    void applyEma(std::vector<float>& ranges);
+
+    typedef std::vector<float, boost::alignment::aligned_allocator<float, 64> > AlignedBuffer;
+
+    Mode mode_;
+    int window_;
+    float alpha_;
+
+    AlignedBuffer history_; ///< 'window_' rows of 'stride_' floats, row 'head_' is the oldest one.
+    size_t bins_; ///< Number of ranges of the buffered scans.
+    size_t stride_; ///< Row length, 'bins_' rounded up to a cache line.
+    int head_;
+    int count_; ///< Number of valid rows.
+  };
+
+}; // depthimage_to_laserscan
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DEPTH_IMAGE_TO_LASERSCAN_CUDA_BACKEND
+#define DEPTH_IMAGE_TO_LASERSCAN_CUDA_BACKEND
+
+#include <stdint.h>
+#include <utility>
+
+namespace depthimage_to_laserscan
+{
+  /**
+   * CUDA versions of the column reduction of convert() and of the lidar fusion, built with
+   * DEPTHIMAGE_TO_LASERSCAN_USE_CUDA.
+   * convert()中逐列最小值归约和雷达融合的CUDA实现，使用DEPTHIMAGE_TO_LASERSCAN_USE_CUDA编译
+   *
+   * All buffers are pinned host memory mapped into the device address space. On integrated GPUs (Jetson) the kernels
+   * read and write them in place, there is no cudaMemcpy in either direction. The depth image itself is owned by the
+   * ROS message, so the band of scan_height rows is staged into the mapped buffer with a single host memcpy. Every
+   * instance has its own stream, the converters of several cameras run concurrently on the device.
+   * 所有缓冲区都是映射到设备地址空间的锁页内存，在集成GPU（Jetson）上核函数直接读写，不需要cudaMemcpy。
+   * 深度图属于ROS消息，只把scan_height行的扫描带用一次memcpy放入映射缓冲区。每个实例使用独立的stream，多个相机可以并行使用GPU。
+   *
+   * The results are identical to column_min_reduce() and DepthImageToLaserScan::fuse_ranges().
+   */
+  class CudaBackend
+  {
+  public:
+    CudaBackend();
+    ~CudaBackend();
+
+    /**
+     * Whether a CUDA device which can map host memory is present. 是否有可以映射锁页内存的CUDA设备
+     */
+    static bool available();
+
+    /**
+     * Same contract as column_min_reduce(). Returns false if the device failed, 'out' is undefined then.
+     * 与column_min_reduce()相同，设备出错时返回false
+     */
+    bool column_min_reduce(const uint16_t* rows, int row_step, int num_rows, int width,
+                           const uint16_t* lo, const uint16_t* hi, uint16_t* out);
+    bool column_min_reduce(const float* rows, int row_step, int num_rows, int width,
+                           const float* lo, const float* hi, float* out);
+
+    /**
+     * For every lidar beam i with a finite range, fused[i] becomes the minimum of lidar[i] and the virtual ranges at
+     * the (direct, +2pi) bins of 'bins'. 'bins' is only uploaded when 'bins_generation' changes.
+     * 对每个有效的雷达光束取雷达距离与对应虚拟激光距离的最小值，bins只在bins_generation变化时重新上传
+     *
+     * @return false if the device failed, 'fused' is undefined then.
+     */
+    bool fuse_ranges(const float* lidar, int num_beams, const float* virtual_ranges, int num_bins,
+                     const std::pair<int, int>* bins, int bins_generation, float* fused);
+
+  private:
+    CudaBackend(const CudaBackend&);
+    CudaBackend& operator=(const CudaBackend&);
+
+    struct Impl;
+    Impl* impl_;
+  };
+
+}; // depthimage_to_laserscan
+
+#endif
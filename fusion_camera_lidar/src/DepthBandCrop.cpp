@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <depthimage_to_laserscan/DepthBandCrop.h>
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+using namespace depthimage_to_laserscan;
+
+void depthimage_to_laserscan::crop_band(const sensor_msgs::Image& image, const sensor_msgs::CameraInfo& info,
+                                        const int band_height, sensor_msgs::Image& band,
+                                        sensor_msgs::CameraInfo& band_info){
+  const sensor_msgs::RegionOfInterest& roi = info.roi;
+  const bool has_roi = roi.x_offset != 0 || roi.y_offset != 0 ||
+                       (roi.width != 0 && roi.width != info.width) || (roi.height != 0 && roi.height != info.height);
+  if(has_roi || info.binning_x > 1 || info.binning_y > 1){
+    throw std::runtime_error("Depth band cropping needs a full resolution image without ROI or binning.");
+  }
+  if(band_height < 1){
+    std::stringstream ss;
+    ss << "band_height (" << band_height << " pixels) must be positive.";
+    throw std::runtime_error(ss.str());
+  }
+
+  // convert_msg() starts at row (int)(cy - scan_height/2) with cy = P[6], see image_geometry's cy().
+  const int height = image.height;
+  const int first_row = std::max(0, std::min(height, (int)(info.P[6] - band_height/2) - 1));
+  const int num_rows = std::min(band_height + 2, height - first_row);
+
+  band.header = image.header;
+  band.height = num_rows;
+  band.width = image.width;
+  band.encoding = image.encoding;
+  band.is_bigendian = image.is_bigendian;
+  band.step = image.step;
+  const std::vector<uint8_t>::const_iterator begin = image.data.begin() + (size_t)first_row * image.step;
+  band.data.assign(begin, begin + (size_t)num_rows * image.step);
+
+  band_info = info;
+  band_info.height = num_rows;
+  band_info.roi = sensor_msgs::RegionOfInterest();
+  band_info.K[5] -= first_row;
+  band_info.P[6] -= first_row;
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <depthimage_to_laserscan/DepthBandCrop.h>
+#include <image_transport/image_transport.h>
+#include <nodelet/nodelet.h>
+#include <boost/thread/mutex.hpp>
+
+namespace depthimage_to_laserscan
+{
+
+/**
+ * Publishes the band of the depth image which the fusion reads, see crop_band().
+ * 只发布融合实际读取的深度图扫描带
+ *
+ * Loaded into the nodelet manager of the camera driver, the full frames are passed by pointer and only the band
+ * (band/image, band/camera_info) is serialized and sent to the fusion node. Like the fusion node it only subscribes
+ * to the camera while the band has subscribers.
+ * 与相机驱动在同一个nodelet manager中运行时完整的深度图只传递指针，只有扫描带被序列化发送给融合节点。
+ *
+ * Parameters: ~band_height (int, default 100), the largest scan_height the fusion node will use.
+ */
+class DepthBandCropNodelet : public nodelet::Nodelet
+{
+public:
+  DepthBandCropNodelet() : band_height_(100) {};
+
+  ~DepthBandCropNodelet() {}
+
+private:
+  virtual void onInit()
+  {
+    getPrivateNodeHandle().param("band_height", band_height_, 100);
+    it_.reset(new image_transport::ImageTransport(getNodeHandle()));
+    boost::mutex::scoped_lock lock(connect_mutex_);
+    const image_transport::SubscriberStatusCallback image_connect_cb =
+        boost::bind(&DepthBandCropNodelet::connectCb, this);
+    const ros::SubscriberStatusCallback info_connect_cb = boost::bind(&DepthBandCropNodelet::connectCb, this);
+    pub_ = it_->advertiseCamera("band/image", 1, image_connect_cb, image_connect_cb, info_connect_cb,
+                                info_connect_cb);
+  };
+
+  void connectCb()
+  {
+    boost::mutex::scoped_lock lock(connect_mutex_);
+    if(pub_.getNumSubscribers() == 0){
+      sub_.shutdown();
+    }else if(!sub_){
+      sub_ = it_->subscribeCamera("image", 1, &DepthBandCropNodelet::imageCb, this);
+    }
+  }
+
+  void imageCb(const sensor_msgs::ImageConstPtr& image, const sensor_msgs::CameraInfoConstPtr& info)
+  {
+    sensor_msgs::ImagePtr band(new sensor_msgs::Image());
+    sensor_msgs::CameraInfoPtr band_info(new sensor_msgs::CameraInfo());
+    try{
+      crop_band(*image, *info, band_height_, *band, *band_info);
+    }
+    catch(std::runtime_error& e){
+      NODELET_ERROR_THROTTLE(1.0, "Could not crop depth image: %s", e.what());
+      return;
+    }
+    pub_.publish(band, band_info);
+  }
+
+  int band_height_;
+  boost::shared_ptr<image_transport::ImageTransport> it_;
+  boost::mutex connect_mutex_;
+  image_transport::CameraSubscriber sub_;
+  image_transport::CameraPublisher pub_;
+};
+
+}
+
+#include <pluginlib/class_list_macros.h>
+PLUGINLIB_EXPORT_CLASS(depthimage_to_laserscan::DepthBandCropNodelet, nodelet::Nodelet)
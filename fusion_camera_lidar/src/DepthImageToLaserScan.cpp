@@ -32,6 +32,11 @@
  */
 
 #include <depthimage_to_laserscan/DepthImageToLaserScan.h>
+#include <ros/console.h>
+
+#ifdef DEPTHIMAGE_TO_LASERSCAN_HAS_CUDA
+#include <depthimage_to_laserscan/cuda_backend.h>
+#endif
 
 using namespace depthimage_to_laserscan;
 
@@ -40,6 +45,13 @@ DepthImageToLaserScan::DepthImageToLaserScan()
   , range_min_(0.35)
   , range_max_(4.0)
   , scan_height_(100)
+  , use_extrinsics_(false)
+  , fusion_map_key_()
+  , fusion_map_generation_(0)
+  , extrinsic_bx_(0.0)
+  , extrinsic_bz_(0.0)
+  , num_bands_(0)
+  , use_gpu_(false)
 {
 }
 
@@ -58,35 +70,7 @@ double DepthImageToLaserScan::angle_between_rays(const cv::Point3d& ray1, const
 }
 
 bool DepthImageToLaserScan::use_point(const float new_value, const float old_value, const float range_min, const float range_max) const{
-  // Check for NaNs and Infs, a real number within our limits is more desirable than these.
-  // 检查NaNs和infs，选择在限制范围内的实数
-  const bool new_finite = std::isfinite(new_value);
-  const bool old_finite = std::isfinite(old_value);
-
-  // Infs are preferable over NaNs (more information)
-  // Infs比NaNs包含更多信息
-  if(!new_finite && !old_finite){ // Both are not NaN or Inf.
-    if(!std::isnan(new_value)){ // new is not NaN, so use it's +-Inf value.
-      return true;
-    }
-    return false; // Do not replace old_value
-  }
-
-  // If not in range, don't bother
-  // 不在范围内不用理会
-  const bool range_check = range_min <= new_value && new_value <= range_max;
-  if(!range_check){
-    return false;
-  }
-
-  if(!old_finite){ // New value is in range and finite, use it.
-    return true;
-  }
-
-  // Finally, if they are both numerical and new_value is closer than old_value, use new_value.
-  // 全都有效，则选取更接近的那个
-  const bool shorter_check = new_value < old_value;
-  return shorter_check;
+  return depthimage_to_laserscan::use_point(new_value, old_value, range_min, range_max);
 }
 
 /**
@@ -98,6 +82,30 @@ sensor_msgs::LaserScanPtr DepthImageToLaserScan::fusion_msg(sensor_msgs::LaserSc
    return fusion(laser_msg,scan_msg);
 }
 
+void DepthImageToLaserScan::fusion_into(const sensor_msgs::LaserScan& laser_msg, const sensor_msgs::LaserScan& scan_msg,
+        sensor_msgs::LaserScan& fused_msg){
+  fused_msg.header = laser_msg.header;
+  fused_msg.angle_min = laser_msg.angle_min;
+  fused_msg.angle_max = laser_msg.angle_max;
+  fused_msg.angle_increment = laser_msg.angle_increment;
+  fused_msg.time_increment = laser_msg.time_increment;
+  fused_msg.scan_time = laser_msg.scan_time;
+  fused_msg.range_min = laser_msg.range_min;
+  fused_msg.range_max = laser_msg.range_max;
+  // assign() and resize() keep the existing capacity, a recycled message does not allocate.
+  fused_msg.intensities.assign(laser_msg.intensities.begin(), laser_msg.intensities.end());
+  fused_msg.ranges.resize(laser_msg.ranges.size());
+  if(!laser_msg.ranges.empty()){
+    fuse_ranges(laser_msg, scan_msg, &fused_msg.ranges[0]);
+  }
+}
+
+void DepthImageToLaserScan::fusion_in_place(sensor_msgs::LaserScan& fused_msg, const sensor_msgs::LaserScan& scan_msg){
+  if(!fused_msg.ranges.empty()){
+    fuse_ranges(fused_msg, scan_msg, &fused_msg.ranges[0]);
+  }
+}
+
 /**
  * laser scan 信息填写
  * */
@@ -105,7 +113,7 @@ sensor_msgs::LaserScanPtr DepthImageToLaserScan::convert_msg(const sensor_msgs::
         const sensor_msgs::CameraInfoConstPtr& info_msg){
   // Set camera model
   // 设置相机模式
-  cam_model_.fromCameraInfo(info_msg);
+  const bool camera_changed = cam_model_.fromCameraInfo(info_msg);
 
   // Calculate angle_min and angle_max by measuring angles between the left ray, right ray, and optical center ray
   // 计算角度
@@ -153,6 +161,12 @@ sensor_msgs::LaserScanPtr DepthImageToLaserScan::convert_msg(const sensor_msgs::
   const uint32_t ranges_size = depth_msg->width;
   scan_msg->ranges.assign(ranges_size, std::numeric_limits<float>::quiet_NaN());
 
+  // Only rebuild the column LUT when the intrinsics or the image size changed.
+  // 只有相机参数或图像宽度变化时才重新计算查找表
+  if(camera_changed || column_lut_.width() != depth_msg->width){
+    update_column_lut(scan_msg, depth_msg->width);
+  }
+
   // 深度图转化为虚拟激光雷达信号
   if (depth_msg->encoding == sensor_msgs::image_encodings::TYPE_16UC1)
   {
@@ -171,6 +185,56 @@ sensor_msgs::LaserScanPtr DepthImageToLaserScan::convert_msg(const sensor_msgs::
   return scan_msg;
 }
 
+sensor_msgs::PointCloud2Ptr DepthImageToLaserScan::convert_bands_msg(const sensor_msgs::ImageConstPtr& depth_msg,
+        const sensor_msgs::CameraInfoConstPtr& info_msg){
+  sensor_msgs::PointCloud2Ptr cloud(new sensor_msgs::PointCloud2());
+  cloud->header = depth_msg->header;
+  if(output_frame_id_.length() > 0){
+    cloud->header.frame_id = output_frame_id_;
+  }
+  sensor_msgs::PointCloud2Modifier modifier(*cloud);
+  modifier.setPointCloud2Fields(4, "x", 1, sensor_msgs::PointField::FLOAT32,
+                                   "y", 1, sensor_msgs::PointField::FLOAT32,
+                                   "z", 1, sensor_msgs::PointField::FLOAT32,
+                                   "ring", 1, sensor_msgs::PointField::UINT16);
+  cloud->is_dense = true;
+  if(num_bands_ == 0){
+    return cloud;
+  }
+
+  // The depth to range factors are built together with the scan bins, which need the scan angles of convert_msg().
+  // 深度到距离的缩放系数与激光索引一起计算，需要convert_msg()中的扫描角度
+  if(cam_model_.fromCameraInfo(info_msg) || column_lut_.width() != depth_msg->width){
+    column_lut_.index.clear();
+    convert_msg(depth_msg, info_msg);
+  }
+  if(scan_height_/2 > cam_model_.cy() || scan_height_/2 > depth_msg->height - cam_model_.cy()){
+    std::stringstream ss;
+    ss << "scan_height ( " << scan_height_ << " pixels) is too large for the image height.";
+    throw std::runtime_error(ss.str());
+  }
+
+  if (depth_msg->encoding == sensor_msgs::image_encodings::TYPE_16UC1)
+  {
+    convert_bands<uint16_t>(*depth_msg, std::min(num_bands_, scan_height_), *cloud);
+  }
+  else if (depth_msg->encoding == sensor_msgs::image_encodings::TYPE_32FC1)
+  {
+    convert_bands<float>(*depth_msg, std::min(num_bands_, scan_height_), *cloud);
+  }
+  else
+  {
+    std::stringstream ss;
+    ss << "Depth image has unsupported encoding: " << depth_msg->encoding;
+    throw std::runtime_error(ss.str());
+  }
+  return cloud;
+}
+
+void DepthImageToLaserScan::update_column_lut(const sensor_msgs::LaserScanPtr& scan_msg, const uint32_t width){
+  build_column_lut(cam_model_.cx(), cam_model_.fx(), width, scan_msg->angle_min, scan_msg->angle_increment,
+                   scan_msg->ranges.size(), &column_lut_);
+}
 
 void DepthImageToLaserScan::set_scan_time(const float scan_time){
   scan_time_ = scan_time;
@@ -188,3 +252,106 @@ void DepthImageToLaserScan::set_scan_height(const int scan_height){
 void DepthImageToLaserScan::set_output_frame(const std::string& output_frame_id){
   output_frame_id_ = output_frame_id;
 }
+
+void DepthImageToLaserScan::set_use_extrinsics(const bool use_extrinsics){
+  use_extrinsics_ = use_extrinsics;
+}
+
+void DepthImageToLaserScan::set_num_bands(const int num_bands){
+  num_bands_ = num_bands;
+}
+
+void DepthImageToLaserScan::set_use_gpu(const bool use_gpu){
+  use_gpu_ = use_gpu;
+}
+
+#ifdef DEPTHIMAGE_TO_LASERSCAN_HAS_CUDA
+
+CudaBackend* DepthImageToLaserScan::gpu_backend(){
+  if(!use_gpu_){
+    return NULL;
+  }
+  if(!gpu_){
+    if(!CudaBackend::available()){
+      ROS_WARN("use_gpu is set but there is no CUDA device which can map host memory, using the CPU.");
+      use_gpu_ = false;
+      return NULL;
+    }
+    gpu_.reset(new CudaBackend());
+  }
+  return gpu_.get();
+}
+
+// The CPU path takes over for good after a device error, a failing GPU would otherwise fail again every frame.
+bool DepthImageToLaserScan::gpu_column_min_reduce(const uint16_t* rows, const int row_step, const int num_rows,
+                                                  const int width, const uint16_t* lo, const uint16_t* hi,
+                                                  uint16_t* out){
+  CudaBackend* const gpu = gpu_backend();
+  if(gpu == NULL){
+    return false;
+  }
+  if(!gpu->column_min_reduce(rows, row_step, num_rows, width, lo, hi, out)){
+    ROS_ERROR("CUDA column reduction failed, using the CPU.");
+    use_gpu_ = false;
+    return false;
+  }
+  return true;
+}
+
+bool DepthImageToLaserScan::gpu_column_min_reduce(const float* rows, const int row_step, const int num_rows,
+                                                  const int width, const float* lo, const float* hi, float* out){
+  CudaBackend* const gpu = gpu_backend();
+  if(gpu == NULL){
+    return false;
+  }
+  if(!gpu->column_min_reduce(rows, row_step, num_rows, width, lo, hi, out)){
+    ROS_ERROR("CUDA column reduction failed, using the CPU.");
+    use_gpu_ = false;
+    return false;
+  }
+  return true;
+}
+
+bool DepthImageToLaserScan::gpu_fuse_ranges(const float* lidar, const int num_beams,
+                                            const sensor_msgs::LaserScan& scan_msg, float* fused){
+  CudaBackend* const gpu = gpu_backend();
+  if(gpu == NULL || num_beams == 0 || scan_msg.ranges.empty()){
+    return false;
+  }
+  if(!gpu->fuse_ranges(lidar, num_beams, &scan_msg.ranges[0], scan_msg.ranges.size(), &fusion_bin_[0],
+                       fusion_map_generation_, fused)){
+    ROS_ERROR("CUDA fusion failed, using the CPU.");
+    use_gpu_ = false;
+    return false;
+  }
+  return true;
+}
+
+#else
+
+CudaBackend* DepthImageToLaserScan::gpu_backend(){
+  if(use_gpu_){
+    ROS_WARN("use_gpu is set but depthimage_to_laserscan was built without DEPTHIMAGE_TO_LASERSCAN_USE_CUDA, "
+             "using the CPU.");
+    use_gpu_ = false;
+  }
+  return NULL;
+}
+
+bool DepthImageToLaserScan::gpu_column_min_reduce(const uint16_t*, int, int, int, const uint16_t*, const uint16_t*,
+                                                  uint16_t*){
+  gpu_backend();
+  return false;
+}
+
+bool DepthImageToLaserScan::gpu_column_min_reduce(const float*, int, int, int, const float*, const float*, float*){
+  gpu_backend();
+  return false;
+}
+
+bool DepthImageToLaserScan::gpu_fuse_ranges(const float*, int, const sensor_msgs::LaserScan&, float*){
+  gpu_backend();
+  return false;
+}
+
+#endif
@@ -32,14 +32,12 @@
  */
 
 #include <depthimage_to_laserscan/DepthImageToLaserScanROS.h>
-#include <message_filters/subscriber.h>
-#include <message_filters/synchronizer.h>
-#include <message_filters/sync_policies/approximate_time.h>
-#include <message_filters/sync_policies/exact_time.h>
 
 using namespace depthimage_to_laserscan;
 
-DepthImageToLaserScanROS::DepthImageToLaserScanROS(ros::NodeHandle& n, ros::NodeHandle& pnh):pnh_(pnh), it_(n), srv_(pnh) {
+DepthImageToLaserScanROS::DepthImageToLaserScanROS(ros::NodeHandle& n, ros::NodeHandle& pnh):pnh_(pnh), it_(n), srv_(pnh),
+    fusion_(boost::bind(&DepthImageToLaserScanROS::fusedCb, this, _1),
+            boost::bind(&DepthImageToLaserScanROS::virtualCb, this, _1)) {
   boost::mutex::scoped_lock lock(connect_mutex_);
 
   // Dynamic Reconfigure
@@ -52,6 +50,17 @@ DepthImageToLaserScanROS::DepthImageToLaserScanROS(ros::NodeHandle& n, ros::Node
   // 延迟订阅深度图topic
   pub_ = n.advertise<sensor_msgs::LaserScan>("/scan", 10, boost::bind(&DepthImageToLaserScanROS::connectCb, this, _1), boost::bind(&DepthImageToLaserScanROS::disconnectCb, this, _1));
   pubs_ = n.advertise<sensor_msgs::LaserScan>("/depth_scan", 10);
+  bands_pub_ = n.advertise<sensor_msgs::PointCloud2>("/depth_bands", 10);
+  fusion_.setBandsCallback(boost::bind(&DepthImageToLaserScanROS::bandsCb, this, _1));
+  cloud_pub_ = n.advertise<sensor_msgs::PointCloud2>("/depth_cloud", 10);
+  fusion_.setCloudCallback(boost::bind(&DepthImageToLaserScanROS::cloudCb, this, _1));
+
+  // Optional list of depth cameras, see DepthLidarFusion::addCamerasFromParams(). 可选的多相机配置
+  fusion_.addCamerasFromParams(pnh_);
+  std::vector<double> lidar_to_camera;
+  if(pnh_.getParam("lidar_to_camera", lidar_to_camera)){
+    fusion_.setLidarToCamera(lidar_to_camera);
+  }
 }          
 
 DepthImageToLaserScanROS::~DepthImageToLaserScanROS(){
@@ -113,60 +122,28 @@ DepthImageToLaserScanROS::~DepthImageToLaserScanROS(){
 //     ROS_ERROR_THROTTLE(1.0, "Could not convert depth image to laserscan: %s", e.what());
 //   }
 // }
-void DepthImageToLaserScanROS::syncCb(const sensor_msgs::ImageConstPtr& ori_depth,const sensor_msgs::CameraInfoConstPtr& ori_camera,
-              const sensor_msgs::LaserScanConstPtr& ori_laser){
-  try{
-    sensor_msgs::LaserScanPtr s_msg = dtl_.convert_msg(ori_depth, ori_camera);
-    double d = 2.0*3.1415926535;
-    s_msg->angle_min += 3.1415926;
-    s_msg->angle_max += 3.1415926;
-    pubs_.publish(s_msg); //发布虚拟激光图 topic名称为/depth_scan
-
-    sensor_msgs::LaserScanPtr laser_msg_(new sensor_msgs::LaserScan()); //去除订阅时const的影响
-    laser_msg_->angle_increment = ori_laser->angle_increment;
-    laser_msg_->angle_max = ori_laser->angle_max;
-    laser_msg_->angle_min = ori_laser->angle_min;
-    laser_msg_->header = ori_laser->header;
-    laser_msg_->intensities = ori_laser->intensities;
-    laser_msg_->range_max = ori_laser->range_max;
-    laser_msg_->range_min = ori_laser->range_min;
-    laser_msg_->scan_time = ori_laser->scan_time;
-    laser_msg_->time_increment = ori_laser->time_increment;
-    laser_msg_->ranges = ori_laser->ranges;
-    sensor_msgs::LaserScanPtr msg = dtl_.fusion_msg(laser_msg_,s_msg);  //数据融合
-    pub_.publish(msg);  // 发布融合后的激光图
-  }
-  catch (std::runtime_error& e)
-  {
-    ROS_ERROR_THROTTLE(1.0, "Could not syncCb: %s", e.what());
-  }
+void DepthImageToLaserScanROS::fusedCb(const sensor_msgs::LaserScanConstPtr& msg){
+  // Publishing the shared pointer lets nodelets in the same manager receive it without serialization.
+  pub_.publish(msg);  // 发布融合后的激光图
 }
 
-void DepthImageToLaserScanROS::connectCb(const ros::SingleSubscriberPublisher& pub) {
-  boost::mutex::scoped_lock lock(connect_mutex_);
-  if (!sub_ && pub_.getNumSubscribers() > 0) {
-    ROS_DEBUG("Connecting to depth topic.");
-
-
-    //时间戳同步
-    image_sub_ = new message_filters::Subscriber<sensor_msgs::Image>(pnh_,"/camera/depth/image_rect_raw",1);
-    camera_sub_ = new message_filters::Subscriber<sensor_msgs::CameraInfo>(pnh_,"/camera/depth/camera_info",1);
-    scan_sub_ = new message_filters::Subscriber<sensor_msgs::LaserScan>(pnh_,"/laser_scan",1);
-    sync_ = new message_filters::Synchronizer<MySyncPolicy>(MySyncPolicy(10), *image_sub_, *camera_sub_,*scan_sub_);
-    sync_->registerCallback(boost::bind(&DepthImageToLaserScanROS::syncCb,this,_1,_2,_3));
-
-
-    //订阅深度图
-    // image_transport::TransportHints hints("raw", ros::TransportHints(), pnh_);
-    // sub_ = it_.subscribeCamera("image", 10, &DepthImageToLaserScanROS::depthCb, this, hints);
+void DepthImageToLaserScanROS::virtualCb(const sensor_msgs::LaserScanConstPtr& msg){
+  pubs_.publish(msg); //发布虚拟激光图 topic名称为/depth_scan
+}
 
-    //订阅雷达信息
-    /**
-     * ros::Subscriber laser_sub_ = pnh_.subscribe("/laser_scan", 10, DepthImageToLaserScanROS::laserCb); 报错，需要用下面这句话
-     * */
-    // ros::Subscriber* laser_sub_ = new ros::Subscriber(pnh_.subscribe<sensor_msgs::LaserScan>("/laser_scan", 10, &DepthImageToLaserScanROS::laserCb,this));
+void DepthImageToLaserScanROS::bandsCb(const sensor_msgs::PointCloud2ConstPtr& msg){
+  bands_pub_.publish(msg); //发布多子带三维点 topic名称为/depth_bands
+}
 
+void DepthImageToLaserScanROS::cloudCb(const sensor_msgs::PointCloud2ConstPtr& msg){
+  cloud_pub_.publish(msg); //发布体素点云 topic名称为/depth_cloud
+}
 
+void DepthImageToLaserScanROS::connectCb(const ros::SingleSubscriberPublisher& pub) {
+  boost::mutex::scoped_lock lock(connect_mutex_);
+  if (!fusion_.subscribed() && pub_.getNumSubscribers() > 0) {
+    ROS_DEBUG("Connecting to depth topic.");
+    fusion_.subscribe(pnh_);
   }
 }
 
@@ -174,14 +151,22 @@ void DepthImageToLaserScanROS::disconnectCb(const ros::SingleSubscriberPublisher
   boost::mutex::scoped_lock lock(connect_mutex_);
   if (pub_.getNumSubscribers() == 0) {
     ROS_DEBUG("Unsubscribing from depth topic.");
-    sub_.shutdown();
+    fusion_.unsubscribe();
   }
 }
 
 //重要
 void DepthImageToLaserScanROS::reconfigureCb(depthimage_to_laserscan::DepthConfig& config, uint32_t level){
-    dtl_.set_scan_time(config.scan_time);
-    dtl_.set_range_limits(config.range_min, config.range_max);
-    dtl_.set_scan_height(config.scan_height);
-    dtl_.set_output_frame(config.output_frame_id);
+    fusion_.configureConverters([&config](DepthImageToLaserScan& dtl){
+      dtl.set_scan_time(config.scan_time);
+      dtl.set_range_limits(config.range_min, config.range_max);
+      dtl.set_scan_height(config.scan_height);
+      dtl.set_output_frame(config.output_frame_id);
+      dtl.set_use_extrinsics(config.use_extrinsics);
+      dtl.set_use_gpu(config.use_gpu);
+      dtl.set_num_bands(config.num_bands);
+    });
+    fusion_.configureTemporalFilter(static_cast<TemporalFilter::Mode>(config.temporal_filter),
+                                    config.temporal_filter_window, config.temporal_filter_alpha);
+    fusion_.configureVoxelCloud(config.voxel_cloud_size, config.voxel_cloud_stride, config.voxel_cloud_max_range);
 }
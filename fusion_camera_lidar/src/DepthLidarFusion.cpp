@@ -0,0 +1,476 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <depthimage_to_laserscan/DepthLidarFusion.h>
+#include <depthimage_to_laserscan/FusionMetrics.h>
+
+#include <chrono>
+
+using namespace depthimage_to_laserscan;
+
+namespace
+{
+  // Seconds since start on a monotonic clock, for the stage latency metrics.
+  double secondsSince(const std::chrono::steady_clock::time_point& start){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+}
+
+DepthLidarFusion::DepthLidarFusion(const ScanCallback& fused_callback, const ScanCallback& virtual_callback)
+  : fused_callback_(fused_callback)
+  , virtual_callback_(virtual_callback)
+{
+  std::fill(queued_, queued_ + FusionMetrics::NUM_TOPICS, 0);
+}
+
+DepthLidarFusion::~DepthLidarFusion(){
+  unsubscribe();
+}
+
+void DepthLidarFusion::setBandsCallback(const CloudCallback& bands_callback){
+  bands_callback_ = bands_callback;
+}
+
+void DepthLidarFusion::setCloudCallback(const CloudCallback& cloud_callback){
+  cloud_callback_ = cloud_callback;
+}
+
+void DepthLidarFusion::setStampedFusedCallback(const StampedScanCallback& stamped_callback){
+  stamped_callback_ = stamped_callback;
+}
+
+void DepthLidarFusion::addCamera(const std::string& name, const std::string& depth_topic, const std::string& info_topic,
+                                 const double yaw_offset, const double max_staleness){
+  if(subscribed()){
+    throw std::runtime_error("DepthLidarFusion::addCamera() called after subscribe().");
+  }
+  boost::shared_ptr<Camera> camera(new Camera());
+  camera->name = name;
+  camera->depth_topic = depth_topic;
+  camera->info_topic = info_topic;
+  camera->yaw_offset = yaw_offset;
+  camera->max_staleness = max_staleness;
+  camera->running = false;
+  cameras_.push_back(camera);
+}
+
+void DepthLidarFusion::addCamerasFromParams(const ros::NodeHandle& nh){
+  std::vector<std::string> names;
+  if(!nh.getParam("cameras", names)){
+    // Single camera without waiting for the depth frames: the lidar keeps its own rate.
+    // 单相机非阻塞模式：雷达数据立即发布，不等待深度图
+    bool lidar_fast_path;
+    double max_depth_age;
+    nh.param("lidar_fast_path", lidar_fast_path, false);
+    nh.param("max_depth_age", max_depth_age, 0.1);
+    if(lidar_fast_path){
+      addCamera("camera", "/camera/depth/image_rect_raw", "/camera/depth/camera_info", 3.1415926, max_depth_age);
+    }
+    return;
+  }
+  for(size_t i = 0; i < names.size(); ++i){
+    const std::string& name = names[i];
+    std::string depth_topic, info_topic;
+    double yaw_offset, max_staleness;
+    nh.param(name + "/depth_topic", depth_topic, std::string("/" + name + "/depth/image_rect_raw"));
+    nh.param(name + "/info_topic", info_topic, std::string("/" + name + "/depth/camera_info"));
+    nh.param(name + "/yaw_offset", yaw_offset, 3.1415926);
+    nh.param(name + "/max_staleness", max_staleness, 0.1);
+    addCamera(name, depth_topic, info_topic, yaw_offset, max_staleness);
+  }
+}
+
+void DepthLidarFusion::configureConverters(const boost::function<void(DepthImageToLaserScan&)>& f){
+  f(dtl_);
+  for(size_t i = 0; i < cameras_.size(); ++i){
+    // The fuser is only used from the ROS callback thread, as is this function.
+    Camera& camera = *cameras_[i];
+    boost::mutex::scoped_lock lock(camera.convert_mutex);
+    f(camera.converter);
+    f(camera.fuser);
+  }
+}
+
+void DepthLidarFusion::configureTemporalFilter(const TemporalFilter::Mode mode, const int window, const double alpha){
+  filter_.configure(mode, window, alpha);
+  for(size_t i = 0; i < cameras_.size(); ++i){
+    Camera& camera = *cameras_[i];
+    boost::mutex::scoped_lock lock(camera.convert_mutex);
+    camera.filter.configure(mode, window, alpha);
+  }
+}
+
+void DepthLidarFusion::configureVoxelCloud(const double voxel_size, const int stride, const double max_range){
+  voxel_cloud_.configure(voxel_size, stride, max_range);
+  for(size_t i = 0; i < cameras_.size(); ++i){
+    Camera& camera = *cameras_[i];
+    boost::mutex::scoped_lock lock(camera.convert_mutex);
+    camera.voxel_cloud.configure(voxel_size, stride, max_range);
+  }
+}
+
+void DepthLidarFusion::setLidarToCamera(const std::vector<double>& lidar_to_camera){
+  voxel_cloud_.set_lidar_to_camera(lidar_to_camera);
+  for(size_t i = 0; i < cameras_.size(); ++i){
+    Camera& camera = *cameras_[i];
+    boost::mutex::scoped_lock lock(camera.convert_mutex);
+    camera.voxel_cloud.set_lidar_to_camera(lidar_to_camera);
+  }
+}
+
+void DepthLidarFusion::subscribe(ros::NodeHandle& nh){
+  if(subscribed()){
+    return;
+  }
+  if(!cameras_.empty()){
+    for(size_t i = 0; i < cameras_.size(); ++i){
+      Camera* camera = cameras_[i].get();
+      camera->running = true;
+      camera->worker = boost::thread(boost::bind(&DepthLidarFusion::cameraWorker, this, camera));
+      camera->image_sub.reset(new message_filters::Subscriber<sensor_msgs::Image>(nh,camera->depth_topic,1));
+      camera->info_sub.reset(new message_filters::Subscriber<sensor_msgs::CameraInfo>(nh,camera->info_topic,1));
+      camera->sync.reset(new message_filters::Synchronizer<CameraSyncPolicy>(CameraSyncPolicy(10), *camera->image_sub, *camera->info_sub));
+      camera->sync->registerCallback(boost::bind(&DepthLidarFusion::cameraCb,this,camera,_1,_2));
+    }
+    laser_sub_ = nh.subscribe<sensor_msgs::LaserScan>("/laser_scan", 1, &DepthLidarFusion::laserCb, this);
+    return;
+  }
+  //时间戳同步
+  image_sub_.reset(new message_filters::Subscriber<sensor_msgs::Image>(nh,"/camera/depth/image_rect_raw",1));
+  camera_sub_.reset(new message_filters::Subscriber<sensor_msgs::CameraInfo>(nh,"/camera/depth/camera_info",1));
+  scan_sub_.reset(new message_filters::Subscriber<sensor_msgs::LaserScan>(nh,"/laser_scan",1));
+  // Count arrivals for the sync queue depth and dropped lidar scans. Subscribers
+  // call back in registration order, so this runs before the synchronizer sees
+  // the message. 统计同步队列长度和丢弃的雷达数据，须在同步器之前注册
+  std::fill(queued_, queued_ + FusionMetrics::NUM_TOPICS, 0);
+  laser_received_.clear();
+  image_sub_->registerCallback([this](const sensor_msgs::ImageConstPtr&){ countQueued(FusionMetrics::DEPTH); });
+  camera_sub_->registerCallback([this](const sensor_msgs::CameraInfoConstPtr&){ countQueued(FusionMetrics::CAMERA_INFO); });
+  scan_sub_->registerCallback([this](const sensor_msgs::LaserScanConstPtr& laser_msg){
+    countQueued(FusionMetrics::LASER);
+    laserReceived(laser_msg);
+  });
+  sync_.reset(new message_filters::Synchronizer<SyncPolicy>(SyncPolicy(10), *image_sub_, *camera_sub_, *scan_sub_));
+  sync_->registerCallback(boost::bind(&DepthLidarFusion::syncCb,this,_1,_2,_3));
+}
+
+void DepthLidarFusion::unsubscribe(){
+  // The synchronizer references the subscribers, tear it down first.
+  sync_.reset();
+  scan_sub_.reset();
+  camera_sub_.reset();
+  image_sub_.reset();
+
+  laser_sub_.shutdown();
+  laser_sub_ = ros::Subscriber();
+  for(size_t i = 0; i < cameras_.size(); ++i){
+    Camera& camera = *cameras_[i];
+    camera.sync.reset();
+    camera.info_sub.reset();
+    camera.image_sub.reset();
+    {
+      boost::mutex::scoped_lock lock(camera.mutex);
+      camera.running = false;
+      camera.pending_depth.reset();
+      camera.pending_info.reset();
+      camera.latest_scan.reset();
+    }
+    camera.condition.notify_all();
+    if(camera.worker.joinable()){
+      camera.worker.join();
+    }
+  }
+}
+
+void DepthLidarFusion::configureFromParams(const ros::NodeHandle& nh){
+  int scan_height;
+  double scan_time, range_min, range_max;
+  std::string output_frame_id;
+  bool use_extrinsics;
+  nh.param("scan_height", scan_height, 1);
+  nh.param("scan_time", scan_time, 0.033);
+  nh.param("range_min", range_min, 0.45);
+  nh.param("range_max", range_max, 10.0);
+  nh.param("output_frame_id", output_frame_id, std::string("camera_depth_frame"));
+  nh.param("use_extrinsics", use_extrinsics, false);
+  bool use_gpu;
+  nh.param("use_gpu", use_gpu, false);
+  int num_bands;
+  nh.param("num_bands", num_bands, 0);
+  double voxel_cloud_size, voxel_cloud_max_range;
+  int voxel_cloud_stride;
+  nh.param("voxel_cloud_size", voxel_cloud_size, 0.0);
+  nh.param("voxel_cloud_stride", voxel_cloud_stride, 2);
+  nh.param("voxel_cloud_max_range", voxel_cloud_max_range, 5.0);
+  int temporal_filter, temporal_filter_window;
+  double temporal_filter_alpha;
+  nh.param("temporal_filter", temporal_filter, static_cast<int>(TemporalFilter::NONE));
+  nh.param("temporal_filter_window", temporal_filter_window, 5);
+  nh.param("temporal_filter_alpha", temporal_filter_alpha, 0.5);
+  addCamerasFromParams(nh);
+  configureTemporalFilter(static_cast<TemporalFilter::Mode>(temporal_filter), temporal_filter_window,
+                          temporal_filter_alpha);
+  configureVoxelCloud(voxel_cloud_size, voxel_cloud_stride, voxel_cloud_max_range);
+  std::vector<double> lidar_to_camera;
+  if(nh.getParam("lidar_to_camera", lidar_to_camera)){
+    setLidarToCamera(lidar_to_camera);
+  }
+  configureConverters([&](DepthImageToLaserScan& dtl){
+    dtl.set_scan_height(scan_height);
+    dtl.set_scan_time(scan_time);
+    dtl.set_range_limits(range_min, range_max);
+    dtl.set_output_frame(output_frame_id);
+    dtl.set_use_extrinsics(use_extrinsics);
+    dtl.set_use_gpu(use_gpu);
+    dtl.set_num_bands(num_bands);
+  });
+}
+
+void DepthLidarFusion::process(const sensor_msgs::ImageConstPtr& depth_msg, const sensor_msgs::CameraInfoConstPtr& info_msg,
+                               const sensor_msgs::LaserScanConstPtr& laser_msg){
+  StageStamps stamps;
+  stamps.received = ros::Time::now();
+  stamps.synchronized = stamps.received;
+  processStamped(depth_msg, info_msg, laser_msg, stamps);
+}
+
+void DepthLidarFusion::processStamped(const sensor_msgs::ImageConstPtr& depth_msg,
+                                      const sensor_msgs::CameraInfoConstPtr& info_msg,
+                                      const sensor_msgs::LaserScanConstPtr& laser_msg, const StageStamps stamps){
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  sensor_msgs::LaserScanPtr s_msg = dtl_.convert_msg(depth_msg, info_msg);
+  if(bands_callback_ && dtl_.num_bands() > 0){
+    bands_callback_(dtl_.convert_bands_msg(depth_msg, info_msg));
+  }
+  if(cloud_callback_ && voxel_cloud_.enabled()){
+    sensor_msgs::PointCloud2Ptr cloud(new sensor_msgs::PointCloud2());
+    voxel_cloud_.convert(*depth_msg, *info_msg, laser_msg.get(), *cloud);
+    cloud_callback_(cloud);
+  }
+  FusionMetrics::ObserveStage(FusionMetrics::CONVERT, secondsSince(start));
+  if(filter_.mode() != TemporalFilter::NONE){
+    start = std::chrono::steady_clock::now();
+    filter_.apply(*s_msg); //时间滤波
+    FusionMetrics::ObserveStage(FusionMetrics::FILTER, secondsSince(start));
+  }
+  if(!dtl_.use_extrinsics()){
+    // Without calibration the virtual scan only needs a 180° rotation to line up with the lidar.
+    s_msg->angle_min += 3.1415926;
+    s_msg->angle_max += 3.1415926;
+  }
+  if(virtual_callback_){
+    virtual_callback_(s_msg); //虚拟激光图
+  }
+
+  // The const lidar message is only read, the result goes into a recycled output message.
+  // 只读取const的雷达数据，融合结果写入可复用的输出消息
+  start = std::chrono::steady_clock::now();
+  sensor_msgs::LaserScanPtr msg = acquireFusedMsg();
+  dtl_.fusion_into(*laser_msg, *s_msg, *msg);  //数据融合
+  FusionMetrics::ObserveStage(FusionMetrics::FUSION, secondsSince(start));
+  publishFused(msg, stamps);
+}
+
+void DepthLidarFusion::syncCb(const sensor_msgs::ImageConstPtr& depth_msg, const sensor_msgs::CameraInfoConstPtr& info_msg,
+                              const sensor_msgs::LaserScanConstPtr& laser_msg){
+  const ros::Time newest = std::max(std::max(depth_msg->header.stamp, info_msg->header.stamp), laser_msg->header.stamp);
+  FusionMetrics::ObserveStage(FusionMetrics::SYNC_WAIT, (ros::Time::now() - newest).toSec());
+  for(int i = 0; i < FusionMetrics::NUM_TOPICS; ++i){
+    FusionMetrics::SetSyncQueueDepth(static_cast<FusionMetrics::Topic>(i), queued_[i]);
+  }
+  // Every lidar scan received since the previous set but this one was never fused.
+  if(queued_[FusionMetrics::LASER] > 1){
+    FusionMetrics::IncrementDropped(FusionMetrics::SYNC, queued_[FusionMetrics::LASER] - 1);
+  }
+  std::fill(queued_, queued_ + FusionMetrics::NUM_TOPICS, 0);
+  StageStamps stamps;
+  stamps.synchronized = ros::Time::now();
+  stamps.received = stamps.synchronized;
+  // Scans older than this one will never be emitted anymore.
+  while(!laser_received_.empty() && laser_received_.front().first <= laser_msg->header.stamp){
+    if(laser_received_.front().first == laser_msg->header.stamp){
+      stamps.received = laser_received_.front().second;
+    }
+    laser_received_.pop_front();
+  }
+  try{
+    processStamped(depth_msg, info_msg, laser_msg, stamps);
+  }
+  catch (std::runtime_error& e)
+  {
+    ROS_ERROR_THROTTLE(1.0, "Could not syncCb: %s", e.what());
+  }
+}
+
+void DepthLidarFusion::cameraCb(Camera* camera, const sensor_msgs::ImageConstPtr& depth_msg,
+                                const sensor_msgs::CameraInfoConstPtr& info_msg){
+  {
+    // Only the newest frame matters, an unconverted older one is dropped.
+    boost::mutex::scoped_lock lock(camera->mutex);
+    if(camera->pending_depth){
+      FusionMetrics::IncrementDropped(FusionMetrics::OVERWRITTEN_DEPTH);
+    }
+    camera->pending_depth = depth_msg;
+    camera->pending_info = info_msg;
+  }
+  camera->condition.notify_one();
+}
+
+void DepthLidarFusion::cameraWorker(Camera* camera){
+  boost::mutex::scoped_lock lock(camera->mutex);
+  while(true){
+    while(camera->running && !camera->pending_depth){
+      camera->condition.wait(lock);
+    }
+    if(!camera->running){
+      return;
+    }
+    sensor_msgs::ImageConstPtr depth_msg;
+    sensor_msgs::CameraInfoConstPtr info_msg;
+    depth_msg.swap(camera->pending_depth);
+    info_msg.swap(camera->pending_info);
+    lock.unlock();
+
+    sensor_msgs::LaserScanPtr s_msg;
+    try{
+      boost::mutex::scoped_lock convert_lock(camera->convert_mutex);
+      const double yaw_offset = camera->converter.use_extrinsics() ? 0.0 : camera->yaw_offset;
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      s_msg = camera->converter.convert_msg(depth_msg, info_msg);
+      if(bands_callback_ && camera->converter.num_bands() > 0){
+        bands_callback_(camera->converter.convert_bands_msg(depth_msg, info_msg));
+      }
+      if(cloud_callback_ && camera->voxel_cloud.enabled()){
+        // The lidar is not synchronized with the cameras here, the cloud only holds depth points.
+        sensor_msgs::PointCloud2Ptr cloud(new sensor_msgs::PointCloud2());
+        camera->voxel_cloud.convert(*depth_msg, *info_msg, NULL, *cloud);
+        cloud_callback_(cloud);
+      }
+      FusionMetrics::ObserveStage(FusionMetrics::CONVERT, secondsSince(start));
+      if(camera->filter.mode() != TemporalFilter::NONE){
+        start = std::chrono::steady_clock::now();
+        camera->filter.apply(*s_msg);
+        FusionMetrics::ObserveStage(FusionMetrics::FILTER, secondsSince(start));
+      }
+      s_msg->angle_min += yaw_offset;
+      s_msg->angle_max += yaw_offset;
+      if(virtual_callback_){
+        virtual_callback_(s_msg); //虚拟激光图
+      }
+    }
+    catch (std::runtime_error& e)
+    {
+      ROS_ERROR_THROTTLE(1.0, "Could not convert depth image of camera %s: %s", camera->name.c_str(), e.what());
+    }
+
+    lock.lock();
+    if(s_msg){
+      camera->latest_scan = s_msg;
+    }
+  }
+}
+
+void DepthLidarFusion::laserCb(const sensor_msgs::LaserScanConstPtr& laser_msg){
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  // Nothing to wait for, the lidar scan is fused right away.
+  StageStamps stamps;
+  stamps.received = ros::Time::now();
+  stamps.synchronized = stamps.received;
+  sensor_msgs::LaserScanPtr msg;
+  bool stale = false;
+  for(size_t i = 0; i < cameras_.size(); ++i){
+    Camera& camera = *cameras_[i];
+    sensor_msgs::LaserScanConstPtr s_msg;
+    {
+      boost::mutex::scoped_lock lock(camera.mutex);
+      s_msg = camera.latest_scan;
+    }
+    if(!s_msg || std::fabs((laser_msg->header.stamp - s_msg->header.stamp).toSec()) > camera.max_staleness){
+      stale = true;
+      continue; // Late or missing camera, the lidar does not wait for it. 相机数据过期时不等待
+    }
+    // Fusing the cameras one after the other is the same as fusing their merged virtual scan.
+    if(!msg){
+      msg = acquireFusedMsg();
+      camera.fuser.fusion_into(*laser_msg, *s_msg, *msg);
+    } else {
+      camera.fuser.fusion_in_place(*msg, *s_msg);
+    }
+  }
+  if(stale){
+    FusionMetrics::IncrementDropped(FusionMetrics::STALE_DEPTH);
+  }
+  if(msg){
+    FusionMetrics::ObserveStage(FusionMetrics::FUSION, secondsSince(start));
+    publishFused(msg, stamps);
+  } else {
+    // No fresh depth at all, forward the lidar scan untouched. 没有可用的深度数据，直接转发雷达数据
+    publishFused(laser_msg, stamps);
+  }
+}
+
+void DepthLidarFusion::countQueued(const FusionMetrics::Topic topic){
+  ++queued_[topic];
+}
+
+void DepthLidarFusion::laserReceived(const sensor_msgs::LaserScanConstPtr& laser_msg){
+  // As many as the synchronizer queues. 与同步器的队列长度一致
+  const size_t kMaxReceivedScans = 10;
+  if(laser_received_.size() == kMaxReceivedScans){
+    laser_received_.pop_front();
+  }
+  laser_received_.push_back(std::make_pair(laser_msg->header.stamp, ros::Time::now()));
+}
+
+void DepthLidarFusion::publishFused(const sensor_msgs::LaserScanConstPtr& msg, StageStamps stamps){
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  if(stamped_callback_){
+    stamps.fused = ros::Time::now();
+    stamped_callback_(msg, stamps);
+  } else {
+    fused_callback_(msg);
+  }
+  FusionMetrics::ObserveStage(FusionMetrics::PUBLISH, secondsSince(start));
+  FusionMetrics::ObserveScanAge((ros::Time::now() - msg->header.stamp).toSec());
+}
+
+sensor_msgs::LaserScanPtr DepthLidarFusion::acquireFusedMsg(){
+  // Enough for a few messages in flight to subscribers with queue_size > 1.
+  const size_t kMaxPoolSize = 4;
+  for(size_t i = 0; i < fused_pool_.size(); ++i){
+    if(fused_pool_[i].unique()){
+      return fused_pool_[i];
+    }
+  }
+  sensor_msgs::LaserScanPtr msg(new sensor_msgs::LaserScan());
+  if(fused_pool_.size() < kMaxPoolSize){
+    fused_pool_.push_back(msg);
+  }
+  return msg;
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <depthimage_to_laserscan/DepthVoxelCloud.h>
+#include <depth_scan_kernels/depth_traits.h>
+#include <sensor_msgs/image_encodings.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+using namespace depthimage_to_laserscan;
+
+namespace
+{
+  // Lidar x forward, y left, z up to camera x right, y down, z forward with the lidar turned by 180°.
+  const double kDefaultLidarToCamera[12] = {0, 1, 0, 0,
+                                            0, 0, -1, 0,
+                                            -1, 0, 0, 0};
+}
+
+DepthVoxelCloud::DepthVoxelCloud()
+  : voxel_size_(0.0), stride_(1), max_range_(5.0), num_bits_(0), generation_(0){
+  std::copy(kDefaultLidarToCamera, kDefaultLidarToCamera + 12, lidar_to_camera_);
+}
+
+void DepthVoxelCloud::configure(const double voxel_size, const int stride, const double max_range){
+  voxel_size_ = std::max(0.0, voxel_size);
+  stride_ = std::max(1, stride);
+  max_range_ = max_range;
+}
+
+void DepthVoxelCloud::set_lidar_to_camera(const std::vector<double>& lidar_to_camera){
+  if(lidar_to_camera.size() != 12){
+    std::stringstream ss;
+    ss << "lidar_to_camera needs 12 values (3x4 row-major), got " << lidar_to_camera.size() << ".";
+    throw std::runtime_error(ss.str());
+  }
+  std::copy(lidar_to_camera.begin(), lidar_to_camera.end(), lidar_to_camera_);
+}
+
+void DepthVoxelCloud::convert(const sensor_msgs::Image& depth_msg, const sensor_msgs::CameraInfo& info_msg,
+                              const sensor_msgs::LaserScan* laser_msg, sensor_msgs::PointCloud2& cloud){
+  cloud.header = depth_msg.header;
+  sensor_msgs::PointCloud2Modifier modifier(cloud);
+  modifier.setPointCloud2Fields(3, "x", 1, sensor_msgs::PointField::FLOAT32,
+                                   "y", 1, sensor_msgs::PointField::FLOAT32,
+                                   "z", 1, sensor_msgs::PointField::FLOAT32);
+  cloud.is_dense = true;
+  points_.clear();
+  if(enabled()){
+    const size_t num_pixels = ((depth_msg.height + stride_ - 1) / stride_) * ((depth_msg.width + stride_ - 1) / stride_);
+    reset(num_pixels + (laser_msg != NULL ? laser_msg->ranges.size() : 0));
+    if(laser_msg != NULL){
+      insert_laser(*laser_msg);
+    }
+    if(depth_msg.encoding == sensor_msgs::image_encodings::TYPE_16UC1){
+      insert_depth<uint16_t>(depth_msg, info_msg);
+    }else if(depth_msg.encoding == sensor_msgs::image_encodings::TYPE_32FC1){
+      insert_depth<float>(depth_msg, info_msg);
+    }else{
+      std::stringstream ss;
+      ss << "Depth image has unsupported encoding: " << depth_msg.encoding;
+      throw std::runtime_error(ss.str());
+    }
+  }
+  modifier.resize(points_.size() / 3);
+  if(!points_.empty()){
+    std::memcpy(&cloud.data[0], &points_[0], points_.size() * sizeof(float));
+  }
+}
+
+template<typename T>
+void DepthVoxelCloud::insert_depth(const sensor_msgs::Image& depth_msg, const sensor_msgs::CameraInfo& info_msg){
+  // Rectified image, the projection matrix holds its intrinsics (as image_geometry's fx(), cx(), ...).
+  const double inverse_fx = 1.0 / info_msg.P[0];
+  const double inverse_fy = 1.0 / info_msg.P[5];
+  const double cx = info_msg.P[2];
+  const double cy = info_msg.P[6];
+  const int row_step = depth_msg.step / sizeof(T);
+  const T* depth_row = reinterpret_cast<const T*>(&depth_msg.data[0]);
+  for(int v = 0; v < (int)depth_msg.height; v += stride_, depth_row += stride_ * row_step){
+    const float y_over_z = (v - cy) * inverse_fy;
+    for(int u = 0; u < (int)depth_msg.width; u += stride_){
+      const T depth = depth_row[u];
+      if(!DepthTraits<T>::valid(depth)){
+        continue;
+      }
+      const float z = DepthTraits<T>::toMeters(depth);
+      if(z <= 0.0f || z > max_range_){
+        continue;
+      }
+      insert((u - cx) * inverse_fx * z, y_over_z * z, z);
+    }
+  }
+}
+
+void DepthVoxelCloud::insert_laser(const sensor_msgs::LaserScan& laser_msg){
+  const double* m = lidar_to_camera_;
+  for(size_t i = 0; i < laser_msg.ranges.size(); ++i){
+    const float r = laser_msg.ranges[i];
+    if(!std::isfinite(r) || r < laser_msg.range_min || r > laser_msg.range_max){
+      continue;
+    }
+    const double angle = laser_msg.angle_min + i * laser_msg.angle_increment;
+    const double x = r * std::cos(angle);
+    const double y = r * std::sin(angle);
+    insert(m[0]*x + m[1]*y + m[3], m[4]*x + m[5]*y + m[7], m[8]*x + m[9]*y + m[11]);
+  }
+}
+
+void DepthVoxelCloud::insert(const float x, const float y, const float z){
+  // Same cell index as Cartographer's VoxelFilter.
+  const double inverse_size = 1.0 / voxel_size_;
+  const uint64_t ix = (uint64_t)(int64_t)std::lround(x * inverse_size);
+  const uint64_t iy = (uint64_t)(int64_t)std::lround(y * inverse_size);
+  const uint64_t iz = (uint64_t)(int64_t)std::lround(z * inverse_size);
+  const uint64_t key = (ix << 42) + (iy << 21) + iz;
+
+  const size_t mask = voxels_.size() - 1;
+  size_t index = (key * 0x9e3779b97f4a7c15ull) >> (64 - num_bits_);
+  while(voxels_[index].generation == generation_){
+    if(voxels_[index].key == key){
+      return;
+    }
+    index = (index + 1) & mask;
+  }
+  voxels_[index].key = key;
+  voxels_[index].generation = generation_;
+  points_.push_back(x);
+  points_.push_back(y);
+  points_.push_back(z);
+}
+
+void DepthVoxelCloud::reset(const size_t max_points){
+  // The table is kept at most half full.
+  int num_bits = 4;
+  while(((size_t)1 << num_bits) < 2 * max_points){
+    ++num_bits;
+  }
+  ++generation_;
+  if(num_bits > num_bits_ || generation_ == 0){
+    num_bits_ = std::max(num_bits, num_bits_);
+    Voxel empty = {0, 0};
+    voxels_.assign((size_t)1 << num_bits_, empty);
+    generation_ = 1;
+  }
+  points_.reserve(3 * max_points);
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <depthimage_to_laserscan/FusionMetrics.h>
+
+#include <ros/ros.h>
+
+#ifdef DEPTHIMAGE_TO_LASERSCAN_HAS_METRICS
+#include "cartographer/metrics/family_factory.h"
+#endif
+
+using namespace depthimage_to_laserscan;
+
+#ifdef DEPTHIMAGE_TO_LASERSCAN_HAS_METRICS
+
+namespace
+{
+  namespace metrics = ::cartographer::metrics;
+
+  metrics::Histogram* kStageLatencyMetrics[FusionMetrics::NUM_STAGES] = {
+    metrics::Histogram::Null(), metrics::Histogram::Null(), metrics::Histogram::Null(),
+    metrics::Histogram::Null(), metrics::Histogram::Null()};
+  metrics::Histogram* kScanAgeMetric = metrics::Histogram::Null();
+  metrics::Gauge* kSyncQueueDepthMetrics[FusionMetrics::NUM_TOPICS] = {
+    metrics::Gauge::Null(), metrics::Gauge::Null(), metrics::Gauge::Null()};
+  metrics::Counter* kDroppedMetrics[FusionMetrics::NUM_DROPS] = {
+    metrics::Counter::Null(), metrics::Counter::Null(), metrics::Counter::Null()};
+}
+
+void FusionMetrics::RegisterMetrics(metrics::FamilyFactory* family_factory){
+  // 10us to ~1.3s
+  const metrics::Histogram::BucketBoundaries latency_boundaries = metrics::Histogram::ScaledPowersOf(2, 1e-5, 1.5);
+  metrics::Family<metrics::Histogram>* latency = family_factory->NewHistogramFamily(
+      "depth_fusion_stage_latency", "Duration of the stages of the camera/lidar fusion in seconds",
+      latency_boundaries);
+  const char* const stages[NUM_STAGES] = {"sync_wait", "convert", "filter", "fusion", "publish"};
+  for(int i = 0; i < NUM_STAGES; ++i){
+    kStageLatencyMetrics[i] = latency->Add({{"stage", stages[i]}});
+  }
+  metrics::Family<metrics::Histogram>* age = family_factory->NewHistogramFamily(
+      "depth_fusion_scan_age", "Time from the lidar header stamp to the end of publishing in seconds",
+      latency_boundaries);
+  kScanAgeMetric = age->Add({});
+
+  metrics::Family<metrics::Gauge>* queue = family_factory->NewGaugeFamily(
+      "depth_fusion_sync_queue_depth", "Messages received since the last synchronized set");
+  const char* const topics[NUM_TOPICS] = {"depth", "camera_info", "laser"};
+  for(int i = 0; i < NUM_TOPICS; ++i){
+    kSyncQueueDepthMetrics[i] = queue->Add({{"topic", topics[i]}});
+  }
+
+  metrics::Family<metrics::Counter>* dropped = family_factory->NewCounterFamily(
+      "depth_fusion_dropped", "Messages not or only partially fused");
+  const char* const reasons[NUM_DROPS] = {"sync", "stale_depth", "overwritten_depth"};
+  for(int i = 0; i < NUM_DROPS; ++i){
+    kDroppedMetrics[i] = dropped->Add({{"reason", reasons[i]}});
+  }
+}
+
+void FusionMetrics::ObserveStage(const Stage stage, const double seconds){
+  kStageLatencyMetrics[stage]->Observe(seconds);
+}
+
+void FusionMetrics::ObserveScanAge(const double seconds){
+  kScanAgeMetric->Observe(seconds);
+}
+
+void FusionMetrics::SetSyncQueueDepth(const Topic topic, const int depth){
+  kSyncQueueDepthMetrics[topic]->Set(depth);
+}
+
+void FusionMetrics::IncrementDropped(const Drop reason, const int count){
+  kDroppedMetrics[reason]->Increment(count);
+}
+
+#else
+
+void FusionMetrics::RegisterMetrics(cartographer::metrics::FamilyFactory*){
+  ROS_WARN("depthimage_to_laserscan was built without libcartographer, fusion metrics are not collected.");
+}
+
+void FusionMetrics::ObserveStage(Stage, double){
+}
+
+void FusionMetrics::ObserveScanAge(double){
+}
+
+void FusionMetrics::SetSyncQueueDepth(Topic, int){
+}
+
+void FusionMetrics::IncrementDropped(Drop, int){
+}
+
+#endif
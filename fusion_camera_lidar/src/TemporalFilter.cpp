@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <depthimage_to_laserscan/TemporalFilter.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace depthimage_to_laserscan;
+
+const int TemporalFilter::kMaxWindow;
+
+TemporalFilter::TemporalFilter()
+  : mode_(NONE), window_(1), alpha_(1.0f), bins_(0), stride_(0), head_(0), count_(0){
+}
+
+void TemporalFilter::configure(const Mode mode, const int window, const double alpha){
+  mode_ = mode;
+  window_ = std::max(1, std::min(window, kMaxWindow));
+  alpha_ = static_cast<float>(std::max(1e-3, std::min(alpha, 1.0)));
+  reset();
+}
+
+void TemporalFilter::reset(){
+  bins_ = 0;
+  head_ = 0;
+  count_ = 0;
+}
+
+void TemporalFilter::apply(sensor_msgs::LaserScan& scan){
+  std::vector<float>& ranges = scan.ranges;
+  if(mode_ == NONE || ranges.empty()){
+    return;
+  }
+  if(ranges.size() != bins_){
+    bins_ = ranges.size();
+    stride_ = (bins_ + 15) & ~static_cast<size_t>(15); // 16 floats per 64 byte line
+    const size_t rows = (mode_ == MEDIAN) ? window_ : 1;
+    if(history_.size() < rows * stride_){
+      history_.resize(rows * stride_);
+    }
+    head_ = 0;
+    count_ = 0;
+  }
+  if(mode_ == MEDIAN){
+    applyMedian(ranges);
+  } else {
+    applyEma(ranges);
+  }
+}
+
+void TemporalFilter::applyMedian(std::vector<float>& ranges){
+  // Overwrite the oldest row with the newest scan.
+  // 用最新的数据覆盖最旧的一行
+  const int row = (head_ + count_) % window_;
+  std::copy(ranges.begin(), ranges.end(), history_.begin() + row * stride_);
+  if(count_ < window_){
+    ++count_;
+  } else {
+    head_ = (head_ + 1) % window_;
+  }
+
+  const float* rows = &history_[0];
+  float samples[kMaxWindow];
+  for(size_t i = 0; i < bins_; ++i){
+    // NaN (no information) is skipped, +-Inf take part as the extremes of the ordering.
+    int n = 0;
+    for(int k = 0; k < count_; ++k){
+      const float r = rows[k * stride_ + i];
+      if(!std::isnan(r)){
+        samples[n++] = r;
+      }
+    }
+    if(n == 0){
+      continue; // ranges[i] is NaN already
+    }
+    std::nth_element(samples, samples + n / 2, samples + n);
+    ranges[i] = samples[n / 2];
+  }
+}
+
+void TemporalFilter::applyEma(std::vector<float>& ranges){
+  float* state = &history_[0];
+  if(count_ == 0){
+    std::copy(ranges.begin(), ranges.end(), state);
+    count_ = 1;
+    return;
+  }
+  const float alpha = alpha_;
+  for(size_t i = 0; i < bins_; ++i){
+    const float r = ranges[i];
+    // A bin without a finite history or measurement restarts from the newest value.
+    if(std::isfinite(r) && std::isfinite(state[i])){
+      state[i] += alpha * (r - state[i]);
+      ranges[i] = state[i];
+    } else {
+      state[i] = r;
+    }
+  }
+}
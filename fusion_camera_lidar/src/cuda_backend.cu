@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <depthimage_to_laserscan/cuda_backend.h>
+
+#include <cuda_runtime.h>
+
+#include <cstring>
+#include <limits>
+
+using namespace depthimage_to_laserscan;
+
+namespace
+{
+  const int kThreadsPerBlock = 128;
+
+  // One thread per column, consecutive threads read consecutive pixels of a row.
+  template<typename T>
+  __global__ void column_min_kernel(const T* rows, const int row_step, const int num_rows, const int width,
+                                    const T* lo, const T* hi, const T none, T* out)
+  {
+    const int u = blockIdx.x * blockDim.x + threadIdx.x;
+    if(u >= width){
+      return;
+    }
+    const T low = lo[u];
+    const T high = hi[u];
+    T result = none;
+    for(int v = 0; v < num_rows; ++v){
+      const T depth = rows[v * row_step + u];
+      // Comparisons with NaN are false, as in column_min_reduce_scalar().
+      if(low <= depth && depth <= high && depth < result){
+        result = depth;
+      }
+    }
+    out[u] = result;
+  }
+
+  __global__ void fuse_kernel(const float* lidar, const int num_beams, const float* virtual_ranges, const int2* bins,
+                              float* fused)
+  {
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if(i >= num_beams){
+      return;
+    }
+    float r = lidar[i];
+    if(isfinite(r)){
+      const int2 bin = bins[i];
+      // NaN virtual ranges never compare smaller.
+      if(bin.x >= 0 && virtual_ranges[bin.x] < r) r = virtual_ranges[bin.x];
+      if(bin.y >= 0 && virtual_ranges[bin.y] < r) r = virtual_ranges[bin.y];
+    }
+    fused[i] = r;
+  }
+
+  // Pinned host allocation mapped into the device address space, only grows.
+  struct MappedBuffer
+  {
+    MappedBuffer() : host(NULL), device(NULL), size(0) {}
+    ~MappedBuffer() { if(host != NULL) cudaFreeHost(host); }
+
+    bool reserve(const size_t bytes){
+      if(bytes <= size){
+        return true;
+      }
+      if(host != NULL){
+        cudaFreeHost(host);
+        host = NULL;
+        device = NULL;
+        size = 0;
+      }
+      if(cudaHostAlloc(&host, bytes, cudaHostAllocMapped) != cudaSuccess){
+        host = NULL;
+        return false;
+      }
+      if(cudaHostGetDevicePointer(&device, host, 0) != cudaSuccess){
+        cudaFreeHost(host);
+        host = NULL;
+        return false;
+      }
+      size = bytes;
+      return true;
+    }
+
+    template<typename T> T* host_ptr() const { return static_cast<T*>(host); }
+    template<typename T> T* device_ptr() const { return static_cast<T*>(device); }
+
+    void* host;
+    void* device;
+    size_t size;
+  };
+
+  int num_blocks(const int n){
+    return (n + kThreadsPerBlock - 1) / kThreadsPerBlock;
+  }
+}
+
+struct CudaBackend::Impl
+{
+  Impl() : stream(NULL), bins_generation(-1) {}
+  ~Impl() { if(stream != NULL) cudaStreamDestroy(stream); }
+
+  template<typename T>
+  bool column_min_reduce(const T* rows, const int row_step, const int num_rows, const int width,
+                         const T* lo, const T* hi, T* out){
+    const size_t band_size = ((num_rows - 1) * (size_t)row_step + width) * sizeof(T);
+    const size_t row_size = width * sizeof(T);
+    if(!band.reserve(band_size) || !bounds.reserve(2 * row_size) || !result.reserve(row_size)){
+      return false;
+    }
+    std::memcpy(band.host, rows, band_size);
+    std::memcpy(bounds.host_ptr<T>(), lo, row_size);
+    std::memcpy(bounds.host_ptr<T>() + width, hi, row_size);
+    const T none = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
+                                                        : std::numeric_limits<T>::max();
+    column_min_kernel<T><<<num_blocks(width), kThreadsPerBlock, 0, stream>>>(
+        band.device_ptr<T>(), row_step, num_rows, width, bounds.device_ptr<T>(), bounds.device_ptr<T>() + width, none,
+        result.device_ptr<T>());
+    if(cudaGetLastError() != cudaSuccess || cudaStreamSynchronize(stream) != cudaSuccess){
+      return false;
+    }
+    std::memcpy(out, result.host, row_size);
+    return true;
+  }
+
+  cudaStream_t stream;
+  MappedBuffer band; ///< The scan_height rows of the depth image.
+  MappedBuffer bounds; ///< lo followed by hi.
+  MappedBuffer result; ///< Per-column minimum or fused ranges.
+  MappedBuffer lidar;
+  MappedBuffer virtual_ranges;
+  MappedBuffer bins;
+  int bins_generation; ///< Generation of the fusion map held in 'bins'.
+};
+
+CudaBackend::CudaBackend()
+  : impl_(new Impl()){
+  if(cudaStreamCreateWithFlags(&impl_->stream, cudaStreamNonBlocking) != cudaSuccess){
+    impl_->stream = NULL;
+  }
+}
+
+CudaBackend::~CudaBackend(){
+  delete impl_;
+}
+
+bool CudaBackend::available(){
+  int device_count = 0;
+  if(cudaGetDeviceCount(&device_count) != cudaSuccess || device_count == 0){
+    return false;
+  }
+  int device = 0;
+  cudaDeviceProp prop;
+  if(cudaGetDevice(&device) != cudaSuccess || cudaGetDeviceProperties(&prop, device) != cudaSuccess){
+    return false;
+  }
+  // Mapping has to be enabled before the context is created, afterwards it is on already (or this fails harmlessly).
+  cudaSetDeviceFlags(cudaDeviceMapHost);
+  cudaGetLastError();
+  return prop.canMapHostMemory;
+}
+
+bool CudaBackend::column_min_reduce(const uint16_t* rows, const int row_step, const int num_rows, const int width,
+                                    const uint16_t* lo, const uint16_t* hi, uint16_t* out){
+  return impl_->stream != NULL && width > 0 && num_rows > 0 &&
+         impl_->column_min_reduce(rows, row_step, num_rows, width, lo, hi, out);
+}
+
+bool CudaBackend::column_min_reduce(const float* rows, const int row_step, const int num_rows, const int width,
+                                    const float* lo, const float* hi, float* out){
+  return impl_->stream != NULL && width > 0 && num_rows > 0 &&
+         impl_->column_min_reduce(rows, row_step, num_rows, width, lo, hi, out);
+}
+
+bool CudaBackend::fuse_ranges(const float* lidar, const int num_beams, const float* virtual_ranges, const int num_bins,
+                              const std::pair<int, int>* bins, const int bins_generation, float* fused){
+  if(impl_->stream == NULL || num_beams <= 0 || num_bins <= 0){
+    return false;
+  }
+  Impl& impl = *impl_;
+  const size_t beam_size = num_beams * sizeof(float);
+  const size_t bins_capacity = impl.bins.size;
+  if(!impl.lidar.reserve(beam_size) || !impl.result.reserve(beam_size) ||
+     !impl.virtual_ranges.reserve(num_bins * sizeof(float)) || !impl.bins.reserve(num_beams * sizeof(int2))){
+    return false;
+  }
+  // A reallocated buffer has lost the map as well.
+  if(bins_generation != impl.bins_generation || impl.bins.size != bins_capacity){
+    int2* device_bins = impl.bins.host_ptr<int2>();
+    for(int i = 0; i < num_beams; ++i){
+      device_bins[i] = make_int2(bins[i].first, bins[i].second);
+    }
+    impl.bins_generation = bins_generation;
+  }
+  std::memcpy(impl.lidar.host, lidar, beam_size);
+  std::memcpy(impl.virtual_ranges.host, virtual_ranges, num_bins * sizeof(float));
+  fuse_kernel<<<num_blocks(num_beams), kThreadsPerBlock, 0, impl.stream>>>(
+      impl.lidar.device_ptr<float>(), num_beams, impl.virtual_ranges.device_ptr<float>(), impl.bins.device_ptr<int2>(),
+      impl.result.device_ptr<float>());
+  if(cudaGetLastError() != cudaSuccess || cudaStreamSynchronize(impl.stream) != cudaSuccess){
+    return false;
+  }
+  std::memcpy(fused, impl.result.host, beam_size);
+  return true;
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Benchmarks of the depth image conversion and the lidar fusion.
+// 深度图转换与雷达融合的性能测试
+//
+// Besides the time per frame every benchmark reports "allocs/frame", the number of heap allocations per iteration,
+// counted by replacing the global operator new below.
+// 除每帧耗时外，每个测试还输出allocs/frame，即每帧的堆内存分配次数。
+//
+// Run with: rosrun depthimage_to_laserscan benchmark_dtl --benchmark_filter=Convert
+
+#include <depthimage_to_laserscan/DepthImageToLaserScan.h>
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <random>
+
+namespace {
+
+std::atomic<size_t> allocation_count(0);
+
+}  // namespace
+
+void* operator new(size_t size){
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if(void* p = std::malloc(size ? size : 1)){
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept{
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept{
+  std::free(p);
+}
+
+namespace {
+
+enum Encoding { ENCODING_16UC1 = 0, ENCODING_32FC1 = 1 };
+
+sensor_msgs::CameraInfoPtr MakeInfo(const int width, const int height){
+  sensor_msgs::CameraInfoPtr info_msg(new sensor_msgs::CameraInfo);
+  info_msg->header.frame_id = "frame";
+  info_msg->height = height;
+  info_msg->width = width;
+  info_msg->distortion_model = "plumb_bob";
+  info_msg->D.resize(5);
+  const double f = 0.89 * width; // roughly the 70 degree field of view of the RGBD cameras in use
+  info_msg->K[0] = f;
+  info_msg->K[2] = 0.5 * (width - 1);
+  info_msg->K[4] = f;
+  info_msg->K[5] = 0.5 * (height - 1);
+  info_msg->K[8] = 1.0;
+  info_msg->R[0] = 1.0;
+  info_msg->R[4] = 1.0;
+  info_msg->R[8] = 1.0;
+  info_msg->P[0] = f;
+  info_msg->P[2] = info_msg->K[2];
+  info_msg->P[5] = f;
+  info_msg->P[6] = info_msg->K[5];
+  info_msg->P[10] = 1.0;
+  return info_msg;
+}
+
+// Depth between 0.3m and 8m, 'nan_percent' of the pixels invalid (0 for 16UC1, NaN for 32FC1).
+sensor_msgs::ImagePtr MakeDepth(const int width, const int height, const int encoding, const int nan_percent){
+  sensor_msgs::ImagePtr depth_msg(new sensor_msgs::Image);
+  depth_msg->header.frame_id = "frame";
+  depth_msg->header.stamp.fromNSec(1234567890);
+  depth_msg->height = height;
+  depth_msg->width = width;
+  depth_msg->is_bigendian = false;
+  std::mt19937 prng(42);
+  std::uniform_real_distribution<float> depth(0.3f, 8.0f);
+  std::uniform_int_distribution<int> percent(0, 99);
+  if(encoding == ENCODING_16UC1){
+    depth_msg->encoding = sensor_msgs::image_encodings::TYPE_16UC1;
+    depth_msg->step = width * sizeof(uint16_t);
+    depth_msg->data.resize(height * depth_msg->step);
+    uint16_t* data = reinterpret_cast<uint16_t*>(&depth_msg->data[0]);
+    for(int i = 0; i < width * height; ++i){
+      data[i] = percent(prng) < nan_percent ? 0 : static_cast<uint16_t>(depth(prng) * 1000.0f);
+    }
+  } else {
+    depth_msg->encoding = sensor_msgs::image_encodings::TYPE_32FC1;
+    depth_msg->step = width * sizeof(float);
+    depth_msg->data.resize(height * depth_msg->step);
+    float* data = reinterpret_cast<float*>(&depth_msg->data[0]);
+    for(int i = 0; i < width * height; ++i){
+      data[i] = percent(prng) < nan_percent ? std::numeric_limits<float>::quiet_NaN() : depth(prng);
+    }
+  }
+  return depth_msg;
+}
+
+sensor_msgs::LaserScanPtr MakeLidar(){
+  sensor_msgs::LaserScanPtr laser_msg(new sensor_msgs::LaserScan);
+  laser_msg->header.frame_id = "laser";
+  laser_msg->angle_min = -M_PI;
+  laser_msg->angle_max = M_PI;
+  laser_msg->angle_increment = M_PI / 360.0;
+  laser_msg->range_min = 0.1;
+  laser_msg->range_max = 12.0;
+  laser_msg->ranges.assign(721, 4.0f);
+  laser_msg->intensities.assign(721, 100.0f);
+  return laser_msg;
+}
+
+void SetUp(depthimage_to_laserscan::DepthImageToLaserScan& dtl, const int scan_height){
+  dtl.set_scan_time(1.0 / 30.0);
+  dtl.set_range_limits(0.45, 10.0);
+  dtl.set_scan_height(scan_height);
+  dtl.set_output_frame("camera_depth_frame");
+}
+
+void ReportAllocations(benchmark::State& state, const size_t allocations){
+  state.counters["allocs/frame"] =
+      benchmark::Counter(static_cast<double>(allocations), benchmark::Counter::kAvgIterations);
+}
+
+// Arguments: width, height, scan_height, encoding, nan_percent.
+void BM_ConvertMsg(benchmark::State& state){
+  const int width = state.range(0);
+  const int height = state.range(1);
+  depthimage_to_laserscan::DepthImageToLaserScan dtl;
+  SetUp(dtl, state.range(2));
+  const sensor_msgs::ImageConstPtr depth_msg = MakeDepth(width, height, state.range(3), state.range(4));
+  const sensor_msgs::CameraInfoConstPtr info_msg = MakeInfo(width, height);
+  dtl.convert_msg(depth_msg, info_msg); // builds the lookup tables
+
+  const size_t allocations = allocation_count.load();
+  for(auto _ : state){
+    sensor_msgs::LaserScanPtr scan_msg = dtl.convert_msg(depth_msg, info_msg);
+    benchmark::DoNotOptimize(scan_msg->ranges.data());
+  }
+  ReportAllocations(state, allocation_count.load() - allocations);
+}
+
+// Arguments: width, nan_percent of the virtual scan.
+void BM_FusionMsg(benchmark::State& state){
+  const int width = state.range(0);
+  depthimage_to_laserscan::DepthImageToLaserScan dtl;
+  SetUp(dtl, 10);
+  sensor_msgs::LaserScanPtr scan_msg =
+      dtl.convert_msg(MakeDepth(width, width * 3 / 4, ENCODING_32FC1, state.range(1)), MakeInfo(width, width * 3 / 4));
+  scan_msg->angle_min += M_PI;
+  scan_msg->angle_max += M_PI;
+  const sensor_msgs::LaserScanPtr lidar = MakeLidar();
+
+  size_t allocations = 0;
+  for(auto _ : state){
+    // fusion_msg() works on the lidar message in place, hand it a fresh copy every frame.
+    state.PauseTiming();
+    sensor_msgs::LaserScanPtr laser_msg(new sensor_msgs::LaserScan(*lidar));
+    const size_t before = allocation_count.load();
+    state.ResumeTiming();
+    sensor_msgs::LaserScanPtr fused = dtl.fusion_msg(laser_msg, scan_msg);
+    benchmark::DoNotOptimize(fused->ranges.data());
+    allocations += allocation_count.load() - before;
+  }
+  ReportAllocations(state, allocations);
+}
+
+// As BM_FusionMsg, through the recycled output message of fusion_into().
+void BM_FusionInto(benchmark::State& state){
+  const int width = state.range(0);
+  depthimage_to_laserscan::DepthImageToLaserScan dtl;
+  SetUp(dtl, 10);
+  sensor_msgs::LaserScanPtr scan_msg =
+      dtl.convert_msg(MakeDepth(width, width * 3 / 4, ENCODING_32FC1, state.range(1)), MakeInfo(width, width * 3 / 4));
+  scan_msg->angle_min += M_PI;
+  scan_msg->angle_max += M_PI;
+  const sensor_msgs::LaserScanPtr lidar = MakeLidar();
+  sensor_msgs::LaserScan fused;
+  dtl.fusion_into(*lidar, *scan_msg, fused);
+
+  const size_t allocations = allocation_count.load();
+  for(auto _ : state){
+    dtl.fusion_into(*lidar, *scan_msg, fused);
+    benchmark::DoNotOptimize(fused.ranges.data());
+  }
+  ReportAllocations(state, allocation_count.load() - allocations);
+}
+
+void ConvertArguments(benchmark::internal::Benchmark* b){
+  const int resolutions[][2] = {{640, 480}, {1280, 720}};
+  const int scan_heights[] = {10, 100, 220};
+  const int encodings[] = {ENCODING_16UC1, ENCODING_32FC1};
+  const int nan_percents[] = {0, 10, 50};
+  for(const auto& resolution : resolutions){
+    for(const int scan_height : scan_heights){
+      for(const int encoding : encodings){
+        for(const int nan_percent : nan_percents){
+          b->Args({resolution[0], resolution[1], scan_height, encoding, nan_percent});
+        }
+      }
+    }
+  }
+  b->ArgNames({"width", "height", "scan_height", "encoding", "nan_percent"});
+}
+
+void FusionArguments(benchmark::internal::Benchmark* b){
+  b->ArgsProduct({{640, 1280}, {0, 10, 50}});
+  b->ArgNames({"width", "nan_percent"});
+}
+
+}  // namespace
+
+BENCHMARK(BM_ConvertMsg)->Apply(ConvertArguments)->Unit(benchmark::kNanosecond);
+BENCHMARK(BM_FusionMsg)->Apply(FusionArguments)->Unit(benchmark::kNanosecond);
+BENCHMARK(BM_FusionInto)->Apply(FusionArguments)->Unit(benchmark::kNanosecond);
+
+BENCHMARK_MAIN();
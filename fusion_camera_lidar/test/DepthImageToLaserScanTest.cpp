@@ -33,12 +33,17 @@
 
 // Bring in my package's API, which is what I'm testing
 #include <depthimage_to_laserscan/DepthImageToLaserScan.h>
+#include <depthimage_to_laserscan/TemporalFilter.h>
+#include <depthimage_to_laserscan/DepthBandCrop.h>
+#include <depthimage_to_laserscan/DepthVoxelCloud.h>
 // Bring in gtest
 #include <gtest/gtest.h>
 
 #include <limits.h>
 #include <math.h>
 
+#include <set>
+#include <tuple>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
@@ -278,6 +283,421 @@ TEST(ConvertTest, testNegativeInf)
 }
 
 
+// Check that the column lookup table matches the direct projection and follows CameraInfo changes
+TEST(ConvertTest, testColumnLut)
+{
+  const uint16_t value = 2000; // 2m
+  uint16_t* data = reinterpret_cast<uint16_t*>(&depth_msg_->data[0]);
+  for(size_t i = 0; i < depth_msg_->width*depth_msg_->height; i++){
+    data[i] = value;
+  }
+
+  for(int pass = 0; pass < 2; pass++){
+    sensor_msgs::CameraInfoPtr info_msg(new sensor_msgs::CameraInfo(*info_msg_));
+    if(pass == 1){
+      // Change the focal length so the table has to be rebuilt.
+      info_msg->K[0] = info_msg->K[4] = info_msg->P[0] = info_msg->P[5] = 450.0;
+    }
+    const double fx = info_msg->K[0];
+    const double cx = info_msg->K[2];
+
+    sensor_msgs::LaserScanPtr scan_msg = dtl_.convert_msg(depth_msg_, info_msg);
+
+    // Several columns can fall into one bin, the closest one wins.
+    std::vector<double> expected(scan_msg->ranges.size(), std::numeric_limits<double>::infinity());
+    for(size_t u = 0; u < depth_msg_->width; u++){
+      const double x_over_z = (u - cx) / fx;
+      const int index = (-atan2(x_over_z, 1.0) - scan_msg->angle_min) / scan_msg->angle_increment;
+      if(index >= 0 && index < (int)expected.size()){
+        expected[index] = std::min(expected[index], 2.0 * hypot(x_over_z, 1.0));
+      }
+    }
+    for(size_t i = 0; i < expected.size(); i++){
+      if(std::isfinite(expected[i])){
+        EXPECT_NEAR(scan_msg->ranges[i], expected[i], 1e-4);
+      }
+    }
+  }
+}
+
+// Check the band min-reduction against a per-pixel reference for both encodings
+TEST(ConvertTest, testBandReduction)
+{
+  srand ( 4242 ); // Set seed for repeatable tests
+  const int scan_height = 40;
+  dtl_.set_scan_height(scan_height);
+
+  sensor_msgs::ImagePtr float_msg(new sensor_msgs::Image(*depth_msg_));
+  float_msg->encoding = sensor_msgs::image_encodings::TYPE_32FC1;
+  float_msg->step = float_msg->width*4; // 4 bytes per pixel
+  float_msg->data.resize(float_msg->step * float_msg->height);
+
+  uint16_t* data = reinterpret_cast<uint16_t*>(&depth_msg_->data[0]);
+  float* float_data = reinterpret_cast<float*>(&float_msg->data[0]);
+  for(size_t i = 0; i < depth_msg_->width*depth_msg_->height; i++){
+    data[i] = rand() % 12000; // Includes invalid (0) and out of range values
+    float_data[i] = (rand() % 10 == 0) ? std::numeric_limits<float>::quiet_NaN() : data[i] * 0.001f;
+  }
+
+  const sensor_msgs::ImagePtr msgs[] = {depth_msg_, float_msg};
+  for(const sensor_msgs::ImagePtr& msg : msgs){
+    sensor_msgs::LaserScanPtr scan_msg = dtl_.convert_msg(msg, info_msg_);
+
+    std::vector<float> expected(scan_msg->ranges.size(), std::numeric_limits<float>::infinity());
+    const int offset = (int)(info_msg_->K[5] - scan_height/2);
+    for(int v = offset; v < offset + scan_height; v++){
+      for(size_t u = 0; u < msg->width; u++){
+        const double x_over_z = (u - info_msg_->K[2]) / info_msg_->K[0];
+        const int index = (-atan2(x_over_z, 1.0) - scan_msg->angle_min) / scan_msg->angle_increment;
+        const size_t i = v * msg->width + u;
+        const float depth = (msg == depth_msg_) ? (data[i] == 0 ? NAN : data[i] * 0.001f) : float_data[i];
+        const float r = depth * hypot(x_over_z, 1.0);
+        if(index >= 0 && index < (int)expected.size() && scan_msg->range_min <= r && r <= scan_msg->range_max){
+          expected[index] = std::min(expected[index], r);
+        }
+      }
+    }
+    for(size_t i = 0; i < expected.size(); i++){
+      if(std::isfinite(expected[i])){
+        EXPECT_NEAR(scan_msg->ranges[i], expected[i], 1e-5);
+      } else {
+        EXPECT_FALSE(std::isfinite(scan_msg->ranges[i]));
+      }
+    }
+  }
+
+  // Revert to 1 scan height
+  dtl_.set_scan_height(1);
+}
+
+// Check that fusion_into leaves the lidar scan untouched and matches fusion_msg
+TEST(FusionTest, testFusionInto)
+{
+  sensor_msgs::LaserScanPtr scan_msg = dtl_.convert_msg(depth_msg_, info_msg_);
+  scan_msg->angle_min += M_PI;
+  scan_msg->angle_max += M_PI;
+  for(size_t i = 0; i < scan_msg->ranges.size(); i++){
+    scan_msg->ranges[i] = (i % 3 == 0) ? 0.5f : std::numeric_limits<float>::quiet_NaN();
+  }
+
+  sensor_msgs::LaserScanPtr laser_msg(new sensor_msgs::LaserScan);
+  laser_msg->header.frame_id = "laser";
+  laser_msg->angle_min = -M_PI;
+  laser_msg->angle_max = M_PI;
+  laser_msg->angle_increment = M_PI / 180.0;
+  laser_msg->range_min = 0.1;
+  laser_msg->range_max = 12.0;
+  laser_msg->ranges.assign(361, 2.0f);
+  laser_msg->ranges[10] = std::numeric_limits<float>::infinity();
+  laser_msg->intensities.assign(361, 100.0f);
+  const sensor_msgs::LaserScan original = *laser_msg;
+
+  sensor_msgs::LaserScan fused;
+  dtl_.fusion_into(*laser_msg, *scan_msg, fused);
+  const float* buffer = &fused.ranges[0];
+  dtl_.fusion_into(*laser_msg, *scan_msg, fused);
+
+  EXPECT_EQ(buffer, &fused.ranges[0]); // Recycled message does not reallocate
+  EXPECT_EQ(laser_msg->ranges, original.ranges);
+  EXPECT_EQ(fused.header.frame_id, original.header.frame_id);
+  EXPECT_EQ(fused.intensities, original.intensities);
+
+  sensor_msgs::LaserScanPtr reference = dtl_.fusion_msg(laser_msg, scan_msg);
+  ASSERT_EQ(fused.ranges.size(), reference->ranges.size());
+  size_t fused_count = 0;
+  for(size_t i = 0; i < fused.ranges.size(); i++){
+    EXPECT_EQ(fused.ranges[i], reference->ranges[i]);
+    if(fused.ranges[i] == 0.5f){
+      fused_count++;
+    }
+  }
+  EXPECT_GT(fused_count, 0u);
+}
+
+// Check that the cached beam to bin map follows changes of the lidar geometry
+TEST(FusionTest, testFusionMapRebuild)
+{
+  sensor_msgs::LaserScan scan_msg;
+  scan_msg.angle_min = M_PI - 0.5;
+  scan_msg.angle_max = M_PI + 0.5;
+  scan_msg.angle_increment = 0.01;
+  for(int k = 0; k < 100; k++){
+    scan_msg.ranges.push_back(1.0f + 0.01f * k);
+  }
+
+  sensor_msgs::LaserScan laser_msg;
+  laser_msg.ranges.assign(360, 5.0f);
+  sensor_msgs::LaserScan fused;
+  const double offsets[] = {0.0, 0.2, 0.0};
+  for(double offset : offsets){
+    laser_msg.angle_min = -M_PI + offset;
+    laser_msg.angle_increment = M_PI / 180.0;
+    laser_msg.angle_max = laser_msg.angle_min + 359 * laser_msg.angle_increment;
+    dtl_.fusion_into(laser_msg, scan_msg, fused);
+
+    for(int i = 0; i < 359; i++){
+      double l_angle = laser_msg.angle_min + laser_msg.angle_increment * i;
+      float expected = 5.0f;
+      for(int turn = 0; turn < 2; turn++, l_angle += 2.0 * 3.1415926535){
+        if(l_angle > scan_msg.angle_min && l_angle < scan_msg.angle_max){
+          const int k = (l_angle - scan_msg.angle_min) / scan_msg.angle_increment;
+          if(k < (int)scan_msg.ranges.size()){
+            expected = std::min(expected, scan_msg.ranges[k]);
+          }
+        }
+      }
+      EXPECT_EQ(fused.ranges[i], expected);
+    }
+  }
+}
+
+// Check that fusing two cameras one after the other matches fusing each into the lidar scan and taking the minimum
+TEST(FusionTest, testFusionInPlace)
+{
+  sensor_msgs::LaserScan front, back;
+  front.angle_min = M_PI - 0.5;
+  front.angle_max = M_PI + 0.5;
+  front.angle_increment = 0.01;
+  back = front;
+  back.angle_min = -0.5;
+  back.angle_max = 0.5;
+  for(int k = 0; k < 100; k++){
+    front.ranges.push_back(1.0f + 0.01f * k);
+    back.ranges.push_back((k % 2 == 0) ? 0.8f : std::numeric_limits<float>::quiet_NaN());
+  }
+
+  sensor_msgs::LaserScan laser_msg;
+  laser_msg.angle_min = -M_PI;
+  laser_msg.angle_max = M_PI;
+  laser_msg.angle_increment = M_PI / 180.0;
+  laser_msg.ranges.assign(361, 3.0f);
+
+  depthimage_to_laserscan::DepthImageToLaserScan front_fuser, back_fuser;
+  sensor_msgs::LaserScan fused, front_only, back_only;
+  front_fuser.fusion_into(laser_msg, front, fused);
+  back_fuser.fusion_in_place(fused, back);
+  front_fuser.fusion_into(laser_msg, front, front_only);
+  back_fuser.fusion_into(laser_msg, back, back_only);
+
+  ASSERT_EQ(fused.ranges.size(), laser_msg.ranges.size());
+  size_t front_count = 0, back_count = 0;
+  for(size_t i = 0; i < fused.ranges.size(); i++){
+    EXPECT_EQ(fused.ranges[i], std::min(front_only.ranges[i], back_only.ranges[i]));
+    front_count += front_only.ranges[i] < 3.0f;
+    back_count += back_only.ranges[i] < 3.0f;
+  }
+  EXPECT_GT(front_count, 0u);
+  EXPECT_GT(back_count, 0u);
+}
+
+// Check that use_gpu gives the same scans as the CPU path (without CUDA both run on the CPU)
+TEST(ConvertTest, testUseGpu)
+{
+  srand ( 4343 ); // Set seed for repeatable tests
+  sensor_msgs::ImagePtr image(new sensor_msgs::Image(*depth_msg_));
+  uint16_t* data = reinterpret_cast<uint16_t*>(&image->data[0]);
+  for(size_t i = 0; i < image->width*image->height; i++){
+    data[i] = rand() % 12000;
+  }
+
+  sensor_msgs::LaserScan laser_msg;
+  laser_msg.angle_min = -M_PI;
+  laser_msg.angle_max = M_PI;
+  laser_msg.angle_increment = M_PI / 180.0;
+  laser_msg.ranges.assign(361, 3.0f);
+
+  depthimage_to_laserscan::DepthImageToLaserScan cpu, gpu;
+  gpu.set_use_gpu(true);
+  depthimage_to_laserscan::DepthImageToLaserScan* const converters[] = {&cpu, &gpu};
+  sensor_msgs::LaserScanPtr scans[2];
+  sensor_msgs::LaserScan fused[2];
+  for(int i = 0; i < 2; i++){
+    converters[i]->set_scan_height(40);
+    scans[i] = converters[i]->convert_msg(image, info_msg_);
+    scans[i]->angle_min += M_PI;
+    scans[i]->angle_max += M_PI;
+    converters[i]->fusion_into(laser_msg, *scans[i], fused[i]);
+  }
+
+  ASSERT_EQ(scans[0]->ranges.size(), scans[1]->ranges.size());
+  for(size_t i = 0; i < scans[0]->ranges.size(); i++){
+    if(std::isnan(scans[0]->ranges[i])){
+      EXPECT_TRUE(std::isnan(scans[1]->ranges[i]));
+    } else {
+      EXPECT_EQ(scans[0]->ranges[i], scans[1]->ranges[i]);
+    }
+  }
+  EXPECT_EQ(fused[0].ranges, fused[1].ranges);
+}
+
+// Check that converting the cropped band gives the same scan as the full image for every scan_height it covers
+TEST(ConvertTest, testCropBand)
+{
+  srand ( 4444 ); // Set seed for repeatable tests
+  sensor_msgs::ImagePtr image(new sensor_msgs::Image(*depth_msg_));
+  uint16_t* data = reinterpret_cast<uint16_t*>(&image->data[0]);
+  for(size_t i = 0; i < image->width*image->height; i++){
+    data[i] = rand() % 12000;
+  }
+
+  const int band_height = 40;
+  sensor_msgs::ImagePtr band(new sensor_msgs::Image());
+  sensor_msgs::CameraInfoPtr band_info(new sensor_msgs::CameraInfo());
+  depthimage_to_laserscan::crop_band(*image, *info_msg_, band_height, *band, *band_info);
+  EXPECT_EQ(band->height, (uint32_t)band_height + 2);
+  EXPECT_EQ(band->width, image->width);
+  EXPECT_EQ(band->data.size(), band->height * band->step);
+
+  const int scan_heights[] = {1, 11, band_height - 1, band_height};
+  for(int scan_height : scan_heights){
+    depthimage_to_laserscan::DepthImageToLaserScan full_converter, band_converter;
+    full_converter.set_scan_height(scan_height);
+    band_converter.set_scan_height(scan_height);
+    sensor_msgs::LaserScanPtr full_scan = full_converter.convert_msg(image, info_msg_);
+    sensor_msgs::LaserScanPtr band_scan = band_converter.convert_msg(band, band_info);
+    EXPECT_FLOAT_EQ(full_scan->angle_min, band_scan->angle_min);
+    EXPECT_FLOAT_EQ(full_scan->angle_max, band_scan->angle_max);
+    ASSERT_EQ(full_scan->ranges.size(), band_scan->ranges.size());
+    for(size_t i = 0; i < full_scan->ranges.size(); i++){
+      if(std::isnan(full_scan->ranges[i])){
+        EXPECT_TRUE(std::isnan(band_scan->ranges[i]));
+      } else {
+        EXPECT_EQ(full_scan->ranges[i], band_scan->ranges[i]);
+      }
+    }
+  }
+
+  sensor_msgs::CameraInfo roi_info = *info_msg_;
+  roi_info.roi.y_offset = 10;
+  EXPECT_THROW(depthimage_to_laserscan::crop_band(*image, roi_info, band_height, *band, *band_info),
+               std::runtime_error);
+}
+
+// Check the rings of convert_bands_msg() on a flat wall with one closer pixel
+TEST(ConvertTest, testBands)
+{
+  sensor_msgs::ImagePtr image(new sensor_msgs::Image(*depth_msg_));
+  uint16_t* data = reinterpret_cast<uint16_t*>(&image->data[0]);
+  for(size_t i = 0; i < image->width*image->height; i++){
+    data[i] = 2000; // 2m
+  }
+  const int scan_height = 40;
+  const int num_bands = 4;
+  const int offset = (int)(info_msg_->P[6] - scan_height/2);
+  data[(offset + 15) * image->width + 100] = 1000; // Second ring, 1m
+
+  depthimage_to_laserscan::DepthImageToLaserScan converter;
+  converter.set_scan_height(scan_height);
+  EXPECT_EQ(converter.convert_bands_msg(image, info_msg_)->width, 0u); // Disabled by default
+  converter.set_num_bands(num_bands);
+  sensor_msgs::PointCloud2Ptr cloud = converter.convert_bands_msg(image, info_msg_);
+  ASSERT_EQ(cloud->width * cloud->height, num_bands * image->width);
+
+  sensor_msgs::PointCloud2ConstIterator<float> iter_x(*cloud, "x");
+  sensor_msgs::PointCloud2ConstIterator<float> iter_y(*cloud, "y");
+  sensor_msgs::PointCloud2ConstIterator<float> iter_z(*cloud, "z");
+  sensor_msgs::PointCloud2ConstIterator<uint16_t> iter_ring(*cloud, "ring");
+  for(int i = 0; iter_x != iter_x.end(); ++i, ++iter_x, ++iter_y, ++iter_z, ++iter_ring){
+    const int ring = i / image->width;
+    const int u = i % image->width;
+    const float depth = (ring == 1 && u == 100) ? 1.0f : 2.0f;
+    const double center_row = offset + ring * (scan_height / num_bands) + 0.5 * (scan_height / num_bands - 1);
+    EXPECT_EQ(*iter_ring, ring);
+    EXPECT_FLOAT_EQ(*iter_x, depth);
+    EXPECT_NEAR(*iter_y, -(u - info_msg_->P[2]) / info_msg_->P[0] * depth, 1e-5);
+    EXPECT_NEAR(*iter_z, -(center_row - info_msg_->P[6]) / info_msg_->P[5] * depth, 1e-5);
+  }
+
+  converter.set_num_bands(scan_height + 1); // One ring per row
+  cloud = converter.convert_bands_msg(image, info_msg_);
+  EXPECT_EQ(cloud->width * cloud->height, scan_height * image->width);
+}
+
+// Check that the voxel cloud keeps one point per voxel and prefers lidar returns
+TEST(VoxelCloudTest, testVoxelCloud)
+{
+  sensor_msgs::ImagePtr image(new sensor_msgs::Image(*depth_msg_));
+  uint16_t* data = reinterpret_cast<uint16_t*>(&image->data[0]);
+  for(size_t i = 0; i < image->width*image->height; i++){
+    data[i] = 2000 + (i % 7) * 3; // Around 2m
+  }
+  sensor_msgs::LaserScan laser_msg;
+  laser_msg.angle_min = -M_PI;
+  laser_msg.angle_increment = M_PI / 180.0;
+  laser_msg.angle_max = laser_msg.angle_min + 359 * laser_msg.angle_increment;
+  laser_msg.range_min = 0.1;
+  laser_msg.range_max = 10.0;
+  laser_msg.ranges.assign(360, 2.0f);
+
+  depthimage_to_laserscan::DepthVoxelCloud voxel_cloud;
+  sensor_msgs::PointCloud2 cloud;
+  voxel_cloud.convert(*image, *info_msg_, &laser_msg, cloud);
+  EXPECT_EQ(cloud.width * cloud.height, 0u); // Disabled by default
+
+  const double voxel_size = 0.05;
+  voxel_cloud.configure(voxel_size, 2, 5.0);
+  voxel_cloud.convert(*image, *info_msg_, &laser_msg, cloud);
+  ASSERT_GT(cloud.width * cloud.height, 0u);
+  EXPECT_LT(cloud.width * cloud.height, image->width * image->height / 100);
+
+  std::set<std::tuple<long, long, long> > voxels;
+  size_t num_lidar_points = 0;
+  for(sensor_msgs::PointCloud2ConstIterator<float> iter(cloud, "x"); iter != iter.end(); ++iter){
+    const float x = iter[0], y = iter[1], z = iter[2];
+    EXPECT_TRUE(voxels.insert(std::make_tuple(lround(x / voxel_size), lround(y / voxel_size),
+                                              lround(z / voxel_size))).second);
+    // With the default transform the lidar returns lie in the camera's y = 0 plane, depth points never do exactly.
+    if(y == 0.0f){
+      ++num_lidar_points;
+    }
+  }
+  EXPECT_GT(num_lidar_points, 0u);
+
+  // The table is reused, a second frame gives the same cloud.
+  const std::vector<uint8_t> first = cloud.data;
+  voxel_cloud.convert(*image, *info_msg_, &laser_msg, cloud);
+  EXPECT_EQ(cloud.data, first);
+}
+
+// Check that the median filter removes a single-frame outlier and that the EMA converges to the measurement
+TEST(TemporalFilterTest, testMedianAndEma)
+{
+  depthimage_to_laserscan::TemporalFilter filter;
+  filter.configure(depthimage_to_laserscan::TemporalFilter::MEDIAN, 3, 1.0);
+  sensor_msgs::LaserScan scan;
+  for(int frame = 0; frame < 6; frame++){
+    scan.ranges.assign(37, 2.0f);
+    if(frame == 3){
+      scan.ranges[5] = 0.3f; // spurious near return
+      scan.ranges[6] = std::numeric_limits<float>::quiet_NaN();
+    }
+    const float* buffer = &scan.ranges[0];
+    filter.apply(scan);
+    EXPECT_EQ(buffer, &scan.ranges[0]);
+    for(size_t i = 0; i < scan.ranges.size(); i++){
+      EXPECT_EQ(scan.ranges[i], 2.0f);
+    }
+  }
+  // A new number of bins restarts the history
+  scan.ranges.assign(10, 0.5f);
+  filter.apply(scan);
+  EXPECT_EQ(scan.ranges[0], 0.5f);
+
+  filter.configure(depthimage_to_laserscan::TemporalFilter::EMA, 1, 0.5);
+  scan.ranges.assign(4, 4.0f);
+  filter.apply(scan);
+  EXPECT_EQ(scan.ranges[0], 4.0f);
+  scan.ranges.assign(4, 2.0f);
+  scan.ranges[3] = std::numeric_limits<float>::infinity();
+  filter.apply(scan);
+  EXPECT_FLOAT_EQ(scan.ranges[0], 3.0f);
+  EXPECT_TRUE(std::isinf(scan.ranges[3])); // restarts from the newest value
+  scan.ranges.assign(4, 2.0f);
+  filter.apply(scan);
+  EXPECT_FLOAT_EQ(scan.ranges[0], 2.5f);
+  EXPECT_FLOAT_EQ(scan.ranges[3], 2.0f);
+}
+
 // Run all the tests that were declared with TEST()
 int main(int argc, char **argv){
 testing::InitGoogleTest(&argc, argv);